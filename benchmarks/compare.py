@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+
+#****************************************************************************
+#**
+#** qutIM instant messenger
+#**
+#** Copyright (c) 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+#**
+#*****************************************************************************
+#**
+#** $QUTIM_BEGIN_LICENSE$
+#** This program is free software: you can redistribute it and/or modify
+#** it under the terms of the GNU General Public License as published by
+#** the Free Software Foundation, either version 3 of the License, or
+#** (at your option) any later version.
+#**
+#** This program is distributed in the hope that it will be useful,
+#** but WITHOUT ANY WARRANTY; without even the implied warranty of
+#** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+#** See the GNU General Public License for more details.
+#**
+#** You should have received a copy of the GNU General Public License
+#** along with this program.  If not, see http://www.gnu.org/licenses/.
+#** $QUTIM_END_LICENSE$
+#**
+#****************************************************************************/
+
+# Compares two benchmark reports and fails on regressions:
+#   compare.py baseline.json candidate.json --threshold 5
+# Accepts files written by run.py as well as reports of single benchmarks.
+
+import argparse
+import json
+import sys
+
+
+def load(file_name):
+    with open(file_name) as f:
+        data = json.load(f)
+    if "reports" in data:
+        return data.get("host", {}), data.get("commit", ""), data["reports"]
+    return data.get("host", {}), data.get("commit", ""), {data["benchmark"]: data}
+
+
+def change(baseline, candidate, better):
+    # Positive change is always a regression, whatever direction is better
+    if baseline == 0:
+        return 0.0
+    delta = (candidate - baseline) / abs(baseline) * 100.0
+    return -delta if better == "higher" else delta
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compares qutIM benchmark reports.")
+    parser.add_argument("baseline", help="report of reference build")
+    parser.add_argument("candidate", help="report of tested build")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="allowed slowdown in percents, default is 5")
+    args = parser.parse_args()
+
+    baseline_host, baseline_commit, baseline = load(args.baseline)
+    candidate_host, candidate_commit, candidate = load(args.candidate)
+    if baseline_host != candidate_host:
+        print("warning: reports come from different hosts, numbers are not comparable")
+        for key in sorted(set(baseline_host) | set(candidate_host)):
+            if baseline_host.get(key) != candidate_host.get(key):
+                print("  %s: %s vs %s" % (key, baseline_host.get(key), candidate_host.get(key)))
+    print("baseline %s, candidate %s" % (baseline_commit[:12] or "unknown", candidate_commit[:12] or "unknown"))
+
+    regressions = []
+    for benchmark in sorted(set(baseline) & set(candidate)):
+        old = baseline[benchmark]
+        new = candidate[benchmark]
+        if old.get("parameters") != new.get("parameters"):
+            print("warning: %s was run with different parameters" % benchmark)
+        print("\n%s" % benchmark)
+        for name in sorted(set(old["results"]) & set(new["results"])):
+            before = old["results"][name]
+            after = new["results"][name]
+            percent = change(before["value"], after["value"], after["better"])
+            if percent > args.threshold:
+                mark = "REGRESSION"
+                regressions.append("%s/%s" % (benchmark, name))
+            elif percent < -args.threshold:
+                mark = "improvement"
+            else:
+                mark = ""
+            delta = (after["value"] - before["value"]) / abs(before["value"]) * 100.0 if before["value"] else 0.0
+            print("  %-32s %14.3f -> %14.3f %-12s %+7.1f%% %s"
+                  % (name, before["value"], after["value"], after["unit"], delta, mark))
+        for name in sorted(set(old["results"]) ^ set(new["results"])):
+            print("  %-32s only in %s" % (name, "baseline" if name in old["results"] else "candidate"))
+    for benchmark in sorted(set(baseline) ^ set(candidate)):
+        print("\n%s is only in %s" % (benchmark, "baseline" if benchmark in baseline else "candidate"))
+
+    if regressions:
+        print("\n%d regressions over %.1f%%:" % (len(regressions), args.threshold))
+        for name in regressions:
+            print("  " + name)
+        return 1
+    print("\nno regressions over %.1f%%" % args.threshold)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
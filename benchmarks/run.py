@@ -0,0 +1,154 @@
+#!/usr/bin/env python
+
+#****************************************************************************
+#**
+#** qutIM instant messenger
+#**
+#** Copyright (c) 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+#**
+#*****************************************************************************
+#**
+#** $QUTIM_BEGIN_LICENSE$
+#** This program is free software: you can redistribute it and/or modify
+#** it under the terms of the GNU General Public License as published by
+#** the Free Software Foundation, either version 3 of the License, or
+#** (at your option) any later version.
+#**
+#** This program is distributed in the hope that it will be useful,
+#** but WITHOUT ANY WARRANTY; without even the implied warranty of
+#** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+#** See the GNU General Public License for more details.
+#**
+#** You should have received a copy of the GNU General Public License
+#** along with this program.  If not, see http://www.gnu.org/licenses/.
+#** $QUTIM_END_LICENSE$
+#**
+#****************************************************************************/
+
+# Runs built benchmarks and merges their reports into one JSON file:
+#   run.py --build-dir <qbs build dir> --output results.json
+# Every benchmark is run --repeat times, best value of each metric is kept.
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+BENCHMARKS = ["historybench", "chatbench", "configbench", "contactbench", "parserbench"]
+# These need plugins of qutIM itself, like chat layer and icons
+WITH_PLUGINS = ["chatbench", "contactbench"]
+
+
+def find_executable(build_dir, name):
+    names = [name, name + ".exe"]
+    for root, dirs, files in os.walk(build_dir):
+        for candidate in names:
+            path = os.path.join(root, candidate)
+            if candidate in files and os.access(path, os.X_OK):
+                return path
+    return None
+
+
+def git_commit():
+    try:
+        source_dir = os.path.dirname(os.path.abspath(__file__))
+        return subprocess.check_output(["git", "rev-parse", "HEAD"], cwd=source_dir).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+
+def best(results, run):
+    for name, result in run.items():
+        previous = results.get(name)
+        if previous is None:
+            results[name] = result
+            continue
+        if result["better"] == "higher":
+            better = result["value"] > previous["value"]
+        else:
+            better = result["value"] < previous["value"]
+        if better:
+            results[name] = result
+
+
+def run_benchmark(path, name, args, env):
+    report = None
+    results = {}
+    for i in range(args.repeat):
+        handle, output = tempfile.mkstemp(prefix=name + "-", suffix=".json")
+        os.close(handle)
+        command = [path, "--json", output]
+        if name in WITH_PLUGINS and args.plugin_dir:
+            command += ["--plugin-dir", args.plugin_dir]
+        command += args.extra.get(name, [])
+        print("running %s (%d/%d)" % (" ".join(command), i + 1, args.repeat))
+        sys.stdout.flush()
+        try:
+            code = subprocess.call(command, env=env)
+            if code != 0:
+                print("%s failed with code %d" % (name, code))
+                return None
+            with open(output) as f:
+                report = json.load(f)
+        finally:
+            os.remove(output)
+        best(results, report["results"])
+    report["results"] = results
+    report["repeat"] = args.repeat
+    return report
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runs qutIM benchmarks and collects JSON report.")
+    parser.add_argument("--build-dir", required=True, help="directory with built benchmarks")
+    parser.add_argument("--plugin-dir", help="directory with built plugins for chatbench and contactbench")
+    parser.add_argument("--output", default="benchmarks.json", help="merged report file")
+    parser.add_argument("--repeat", type=int, default=3, help="runs of every benchmark")
+    parser.add_argument("--only", action="append", choices=BENCHMARKS, help="run only this benchmark")
+    parser.add_argument("--arg", action="append", default=[], metavar="BENCH=ARG",
+                        help="extra argument for one benchmark, like chatbench=--messages=1000")
+    args = parser.parse_args()
+    args.repeat = max(1, args.repeat)
+    args.extra = {}
+    for value in args.arg:
+        name, _, arg = value.partition("=")
+        args.extra.setdefault(name, []).append(arg)
+
+    env = dict(os.environ)
+    commit = env.get("QUTIM_BENCH_COMMIT") or git_commit()
+    env["QUTIM_BENCH_COMMIT"] = commit
+    env.setdefault("QT_QPA_PLATFORM", "offscreen")
+
+    merged = {
+        "commit": commit,
+        "date": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+        "host": {},
+        "reports": {},
+    }
+    failed = []
+    for name in args.only or BENCHMARKS:
+        path = find_executable(args.build_dir, name)
+        if not path:
+            print("%s is not built, skipped" % name)
+            continue
+        report = run_benchmark(path, name, args, env)
+        if report is None:
+            failed.append(name)
+            continue
+        # All benchmarks run on the same host, first one describes it
+        if not merged["host"]:
+            merged["host"] = report.get("host", {"os": platform.platform()})
+        merged["reports"][report["benchmark"]] = report
+
+    with open(args.output, "w") as f:
+        json.dump(merged, f, indent=4, sort_keys=True)
+    print("report written to %s" % args.output)
+    return 1 if failed or not merged["reports"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
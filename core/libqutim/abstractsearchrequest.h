@@ -55,6 +55,11 @@ namespace qutim_sdk_0_3
 		virtual QVariant data(int row, int column, int role = Qt::DisplayRole) = 0;
 	signals:
 		void done(bool ok);
+		// Results are appended to the end only and rowCount() includes
+		// them when the signal is emitted, so the whole batch received
+		// from network should be announced by single rowsAdded
+		void rowsAdded(int first, int last);
+		// Single row variants kept for older requests
 		void rowAboutToBeAdded(int row);
 		void rowAdded(int row);
 		void fieldsUpdated();
@@ -31,6 +31,7 @@
 #include "groupchatmanager.h"
 #include "inforequest.h"
 #include "metaobjectbuilder.h"
+#include "memoryaccounting.h"
 
 #include "libqutim_global.h"
 
@@ -41,6 +42,16 @@ Account::Account(const QString &id, Protocol *protocol)
     : Account(*new AccountPrivate(this), protocol)
 {
     d_func()->id = id;
+
+    MemoryAccounting::add(MemoryAccounting::Accounts, this, protocol->id() % QLatin1Char('/') % id, [this] () {
+        // Units are counted by their identity only, their own data is protocol specific
+        qint64 result = sizeof(AccountPrivate);
+        foreach (ChatUnit *unit, findChildren<ChatUnit*>()) {
+            result += 256 + MemoryAccounting::stringSize(unit->id())
+                    + MemoryAccounting::stringSize(unit->title());
+        }
+        return result;
+    });
 }
 
 Account::Account(AccountPrivate &p, Protocol *protocol)
@@ -294,6 +305,26 @@ InfoRequestFactory *Account::infoRequestFactory()
 	return feature<InfoRequestFactory>();
 }
 
+void Account::beginRosterUpdate()
+{
+	Q_D(Account);
+	if (d->rosterUpdateDepth++ == 0)
+		emit rosterUpdateStarted();
+}
+
+void Account::endRosterUpdate()
+{
+	Q_D(Account);
+	Q_ASSERT(d->rosterUpdateDepth > 0);
+	if (--d->rosterUpdateDepth == 0)
+		emit rosterUpdateFinished();
+}
+
+bool Account::isRosterUpdating() const
+{
+	return d_func()->rosterUpdateDepth > 0;
+}
+
 void Account::resetGroupChatManager(GroupChatManager *manager)
 {
 	setFeature<GroupChatManager>(manager);
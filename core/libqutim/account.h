@@ -204,6 +204,25 @@ public:
 	ContactsFactory *contactsFactory();
 	InfoRequestFactory *infoRequestFactory();
 
+	/*!
+	 * Starts bulk roster update, i.e. loading of roster from storage or
+	 * receiving it from server.
+	 *
+	 * Calls may be nested, contact list listens for \ref rosterUpdateFinished
+	 * to apply all contacts created in between at once.
+	 *
+	 * \sa endRosterUpdate
+	 */
+	void beginRosterUpdate();
+	/*!
+	 * Finishes bulk roster update started by \ref beginRosterUpdate.
+	 */
+	void endRosterUpdate();
+	/*!
+	 * Returns true if account is inside of bulk roster update.
+	 */
+	bool isRosterUpdating() const;
+
 protected:
 	/*!
 	 * Set \a feature by it's type.
@@ -258,6 +277,14 @@ signals:
 	  Signal is emitted when new \a contact was created.
 	*/
 	void contactCreated(qutim_sdk_0_3::Contact *contact);
+	/*!
+	  Signal is emitted when outermost bulk roster update is started.
+	*/
+	void rosterUpdateStarted();
+	/*!
+	  Signal is emitted when outermost bulk roster update is finished.
+	*/
+	void rosterUpdateFinished();
 	/*!
 	  Signal is emitted when new \a conference was created.
 	*/
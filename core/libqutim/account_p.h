@@ -46,7 +46,7 @@ class AccountPrivate : public MenuControllerPrivate
 {
 	Q_DECLARE_PUBLIC(Account)
 public:
-	AccountPrivate(Account *a) : MenuControllerPrivate(a), state(Account::Disconnected) {}
+	AccountPrivate(Account *a) : MenuControllerPrivate(a), state(Account::Disconnected), rosterUpdateDepth(0) {}
 	~AccountPrivate()
     {
 	}
@@ -59,6 +59,7 @@ public:
 	Account::State state;
 	Status status;
 	Status userStatus;
+	int rosterUpdateDepth;
 
     QMap<QByteArray, AccountInterface> interfaces;
 };
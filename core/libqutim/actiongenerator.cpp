@@ -167,7 +167,7 @@ void ActionGeneratorPrivate::ensureConnectionType()
 ActionGeneratorPrivate::ActionGeneratorPrivate():
 	q_ptr(0),type(0), priority(0),
 	connectionType(ActionConnectionSimple),
-	menuRole(QAction::NoRole)
+	menuRole(QAction::NoRole), shared(false)
 {
 	iconVisibleInMenu = qApp->testAttribute(Qt::AA_DontShowIconsInMenus);
 }
@@ -507,5 +507,15 @@ bool ActionGenerator::iconVisibleInMenu() const
 	return d_func()->iconVisibleInMenu;
 }
 
+void ActionGenerator::setShared(bool shared)
+{
+	d_func()->shared = shared;
+}
+
+bool ActionGenerator::isShared() const
+{
+	return d_func()->shared;
+}
+
 }
 
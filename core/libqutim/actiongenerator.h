@@ -155,6 +155,13 @@ void MyObject::onAction(QObject *obj)
 	QAction::MenuRole menuRole() const;
 	void setIconVisibleInMenu(bool visible);
 	bool iconVisibleInMenu() const;
+	/*!
+	  Shared generator creates only one QAction which is used by menus of all
+	  controllers, so createImpl() must not depend on controller passed to it.
+	  Use showImpl() for controller-specific changes.
+	*/
+	void setShared(bool shared);
+	bool isShared() const;
 	QList<QAction*> actions(QObject *object) const;
 	QMap<QObject*, QAction*> actions() const;
 	static ActionGenerator *get(QAction *);
@@ -78,6 +78,7 @@ public:
 	ActionData *data;
 	QAction::MenuRole menuRole;
 	bool iconVisibleInMenu;
+	bool shared;
 	static ActionGeneratorPrivate *get(ActionGenerator *gen) { return gen->d_func(); }
 	static const ActionGeneratorPrivate *get(const ActionGenerator *gen) { return gen->d_func(); }
 	void ensureConnectionType();
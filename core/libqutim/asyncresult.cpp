@@ -1,12 +1,62 @@
 #include "asyncresult.h"
+#include <QCoreApplication>
+#include <QThreadStorage>
+#include <QEvent>
 
 namespace qutim_sdk_0_3 {
 
+namespace Detail {
+
+class AsyncCallbackEvent : public QEvent
+{
+public:
+	AsyncCallbackEvent(Callback &&callback)
+		: QEvent(eventType()), callback(std::move(callback))
+	{
+	}
+
+	static QEvent::Type eventType()
+	{
+		static QEvent::Type type = QEvent::Type(QEvent::registerEventType());
+		return type;
+	}
+
+	Callback callback;
+};
+
+}
+
+Q_GLOBAL_STATIC(QThreadStorage<Detail::AsyncInvoker *>, invokers)
+
 Detail::AsyncInvoker::AsyncInvoker()
 {
 	qRegisterMetaType<Callback>();
 }
 
+Detail::AsyncInvoker *Detail::AsyncInvoker::current()
+{
+	QThreadStorage<AsyncInvoker *> *storage = invokers();
+	if (!storage)
+		return 0;
+	if (!storage->hasLocalData())
+		storage->setLocalData(new AsyncInvoker);
+	return storage->localData();
+}
+
+void Detail::AsyncInvoker::post(std::function<void ()> callback)
+{
+	QCoreApplication::postEvent(this, new AsyncCallbackEvent(Callback(std::move(callback))));
+}
+
+bool Detail::AsyncInvoker::event(QEvent *event)
+{
+	if (event->type() == AsyncCallbackEvent::eventType()) {
+		static_cast<AsyncCallbackEvent *>(event)->callback();
+		return true;
+	}
+	return QObject::event(event);
+}
+
 Detail::AsyncInvoker::~AsyncInvoker()
 {
 }
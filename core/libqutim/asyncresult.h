@@ -3,11 +3,13 @@
 
 #include <QObject>
 #include <QPointer>
-#include <QMutex>
+#include <QAtomicInt>
 #include <tuple>
 #include <memory>
 #include <vector>
 #include <functional>
+#include <type_traits>
+#include <utility>
 
 #include "libqutim_global.h"
 
@@ -52,10 +54,57 @@ public:
 	AsyncInvoker();
 	~AsyncInvoker();
 
+	/**
+	 * Returns dispatcher of current thread, it is created on first use and
+	 * shared by all results created in this thread.
+	 */
+	static AsyncInvoker *current();
+	// Queues callback to the thread of invoker
+	void post(std::function<void ()> callback);
+
+protected:
+	bool event(QEvent *event) override;
+
 public slots:
 	void invoke(const qutim_sdk_0_3::Detail::Callback &callback);
 };
 
+/**
+ * Binary state of result combined with spin lock bit. Producer and consumer
+ * only touch it for a few pointer moves, so no mutex is needed.
+ */
+class AsyncState
+{
+public:
+	enum { Empty = 0, HasValue = 1, Locked = 2 };
+
+	AsyncState() : m_value(Empty)
+	{
+	}
+
+	bool hasValue() const
+	{
+		return m_value.loadAcquire() & HasValue;
+	}
+
+	void lock()
+	{
+		forever {
+			int value = m_value.loadAcquire() & ~Locked;
+			if (m_value.testAndSetAcquire(value, value | Locked))
+				return;
+		}
+	}
+
+	void unlock(bool hasValue)
+	{
+		m_value.storeRelease(hasValue ? HasValue : Empty);
+	}
+
+private:
+	QAtomicInt m_value;
+};
+
 template <typename... Args>
 class AsyncResultData
 {
@@ -64,17 +113,18 @@ class AsyncResultData
 public:
 	typedef std::function<void (const Args &...args)> Function;
 
-	AsyncResultData() : m_invoker(new AsyncInvoker)
+	AsyncResultData() : m_invoker(AsyncInvoker::current())
 	{
 	}
 
-	AsyncResultData(Args ...args) : m_args(new Tuple(std::forward<Args>(args)...)), m_invoker(new AsyncInvoker)
+	// Tag keeps it distinct from default constructor for AsyncResult<>
+	AsyncResultData(std::true_type, Args ...args) : m_args(new Tuple(std::forward<Args>(args)...)), m_invoker(AsyncInvoker::current())
 	{
+		m_state.unlock(true);
 	}
 
 	~AsyncResultData()
 	{
-		m_invoker->deleteLater();
 	}
 
 	AsyncResultData(const AsyncResultData &) = delete;
@@ -96,10 +146,14 @@ public:
 
 	void handle(Args ...args)
 	{
-		QMutexLocker locker(&m_lock);
-		m_args = std::make_shared<Tuple>(std::forward<Args>(args)...);
+		TuplePtr value = std::make_shared<Tuple>(std::forward<Args>(args)...);
 
+		m_state.lock();
+		m_args = std::move(value);
 		std::vector<Function> callbacks = std::move(m_callbacks);
+		m_callbacks.clear();
+		m_state.unlock(true);
+
 		for (Function &callback : callbacks) {
 			call(std::move(callback));
 		}
@@ -108,12 +162,16 @@ public:
 private:
 	void connect_impl(Function function)
 	{
-		QMutexLocker locker(&m_lock);
-		if (m_args) {
-			call(std::move(function));
-		} else {
-			m_callbacks.emplace_back(std::move(function));
+		if (!m_state.hasValue()) {
+			m_state.lock();
+			if (!m_args) {
+				m_callbacks.emplace_back(std::move(function));
+				m_state.unlock(false);
+				return;
+			}
+			m_state.unlock(true);
 		}
+		call(std::move(function));
 	}
 
 	template <size_t ...S>
@@ -137,13 +195,11 @@ private:
 	void call(Function function)
 	{
 		TuplePtr args = m_args;
-        auto lambda = [args, function] () {
-            AsyncResultData::call(args, SequenceType(), function);
-        };
-        Callback callback(lambda);
-
-		QMetaObject::invokeMethod(m_invoker, "invoke", Qt::QueuedConnection,
-								  Q_ARG(qutim_sdk_0_3::Detail::Callback, callback));
+		if (!m_invoker)
+			return;
+		m_invoker->post([args, function] () {
+			AsyncResultData::call(args, SequenceType(), function);
+		});
 	}
 
 	template <size_t ...S>
@@ -154,10 +210,10 @@ private:
 
 	friend class AsyncResult<Args...>;
 
-	QMutex m_lock;
+	AsyncState m_state;
 	std::vector<Function> m_callbacks;
 	std::shared_ptr<Tuple> m_args;
-	AsyncInvoker *m_invoker;
+	QPointer<AsyncInvoker> m_invoker;
 };
 
 } // namespace Detail
@@ -165,6 +221,21 @@ private:
 template <typename... Args>
 class AsyncResultHandler;
 
+namespace Detail {
+
+template <typename T>
+struct AsyncThenTraits;
+
+template <typename F, typename... Args>
+struct AsyncThen
+{
+	typedef decltype(std::declval<F &>()(std::declval<const Args &>()...)) Value;
+	typedef AsyncThenTraits<typename std::decay<Value>::type> Traits;
+	typedef typename Traits::Result Result;
+};
+
+} // namespace Detail
+
 template <typename... Args>
 class AsyncResult
 {
@@ -196,7 +267,7 @@ public:
 	static AsyncResult create(Args ...args)
 	{
 		AsyncResult result;
-		result.m_data = std::make_shared<Data>(std::forward<Args>(args)...);
+		result.m_data = std::make_shared<Data>(std::true_type(), std::forward<Args>(args)...);
 		return result;
 	}
 
@@ -210,6 +281,25 @@ public:
 		m_data->connect(std::forward<Function>(function));
 	}
 
+	/**
+	 * Sequentially chains @a function after this result, it's called in the
+	 * thread of @a object while the object is alive.
+	 *
+	 * If @a function returns AsyncResult, the returned result is finished
+	 * when the inner one is, otherwise it is finished by the returned value.
+	 * This allows to write long chains without nesting handlers:
+	 * @code
+	 * history()->contacts(account).then(this, [] (const QVector<History::ContactInfo> &contacts) {
+	 *     return history()->months(contacts.value(0), QRegularExpression());
+	 * }).then(this, [this] (const QList<QDate> &months) {
+	 *     showMonths(months);
+	 * });
+	 * @endcode
+	 * If the object is destroyed before, the rest of the chain is never called.
+	 */
+	template <typename F>
+	typename Detail::AsyncThen<F, Args...>::Result then(QObject *object, F function);
+
 private:
 	friend class AsyncResultHandler<Args...>;
 
@@ -248,6 +338,65 @@ private:
 	std::shared_ptr<Data> m_data;
 };
 
+namespace Detail {
+
+template <typename T>
+struct AsyncThenTraits
+{
+	typedef AsyncResult<T> Result;
+	typedef AsyncResultHandler<T> Handler;
+
+	template <typename F, typename... Args>
+	static void invoke(const Handler &handler, F &function, const Args &...args)
+	{
+		handler.handle(function(args...));
+	}
+};
+
+template <>
+struct AsyncThenTraits<void>
+{
+	typedef AsyncResult<> Result;
+	typedef AsyncResultHandler<> Handler;
+
+	template <typename F, typename... Args>
+	static void invoke(const Handler &handler, F &function, const Args &...args)
+	{
+		function(args...);
+		handler.handle();
+	}
+};
+
+template <typename... R>
+struct AsyncThenTraits<AsyncResult<R...>>
+{
+	typedef AsyncResult<R...> Result;
+	typedef AsyncResultHandler<R...> Handler;
+
+	template <typename F, typename... Args>
+	static void invoke(const Handler &handler, F &function, const Args &...args)
+	{
+		AsyncResult<R...> inner = function(args...);
+		inner.connect([handler] (const R &...result) {
+			handler.handle(result...);
+		});
+	}
+};
+
+} // namespace Detail
+
+template <typename... Args>
+template <typename F>
+typename Detail::AsyncThen<F, Args...>::Result AsyncResult<Args...>::then(QObject *object, F function)
+{
+	typedef typename Detail::AsyncThen<F, Args...>::Traits Traits;
+	typename Traits::Handler handler;
+	m_data->connect(object, [handler, function] (const Args &...args) mutable {
+		Traits::invoke(handler, function, args...);
+	});
+	return handler.result();
+}
+
 } // namespace qutim_sdk_0_3
 
 Q_DECLARE_METATYPE(qutim_sdk_0_3::Detail::Callback)
@@ -0,0 +1,322 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "avatarstore.h"
+#include "systeminfo.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QMutex>
+#include <QPointer>
+#include <QSaveFile>
+#include <QSet>
+#include <QTimer>
+#include <algorithm>
+
+namespace qutim_sdk_0_3
+{
+
+enum { SyncDelay = 10 * 1000, DefaultSizeLimit = 64 };
+
+struct AvatarStoreItem
+{
+	qint64 size;
+	// Seconds since epoch
+	qint64 used;
+};
+
+class AvatarStoreData
+{
+public:
+	AvatarStoreData() : loaded(false), dirty(false), totalSize(0) {}
+
+	void ensureLoaded();
+	QString resolve(const QString &hashOrAlias) const;
+	void touch(const QString &hash);
+	void markDirty();
+	void collectGarbage();
+	void save();
+
+	QMutex mutex;
+	QDir dir;
+	QHash<QString, AvatarStoreItem> items;
+	QHash<QString, QString> aliases;
+	QHash<QString, QString> bindings;
+	QPointer<QTimer> timer;
+	bool loaded;
+	bool dirty;
+	qint64 totalSize;
+};
+
+static AvatarStoreData *data()
+{
+	static AvatarStoreData *self = new AvatarStoreData;
+	return self;
+}
+
+static QVariantMap toVariantMap(const QHash<QString, QString> &hash)
+{
+	QVariantMap result;
+	for (auto it = hash.constBegin(); it != hash.constEnd(); ++it)
+		result.insert(it.key(), it.value());
+	return result;
+}
+
+void AvatarStoreData::ensureLoaded()
+{
+	if (loaded)
+		return;
+	loaded = true;
+	dir.setPath(AvatarStore::directory());
+	if (!dir.exists())
+		dir.mkpath(dir.path());
+
+	Config config(QStringLiteral("avatars"));
+	config.beginGroup(QStringLiteral("store"));
+	const QVariantMap used = config.value(QStringLiteral("used"), QVariantMap());
+	foreach (const QFileInfo &info, dir.entryInfoList(QDir::Files)) {
+		const QString hash = info.fileName();
+		if (hash.size() != 40)
+			continue;
+		AvatarStoreItem item;
+		item.size = info.size();
+		item.used = used.value(hash, info.lastModified().toMSecsSinceEpoch() / 1000).toLongLong();
+		items.insert(hash, item);
+		totalSize += item.size;
+	}
+
+	// Entries of removed files are dropped here, so the maps don't grow forever
+	const QVariantMap aliasMap = config.value(QStringLiteral("aliases"), QVariantMap());
+	for (auto it = aliasMap.constBegin(); it != aliasMap.constEnd(); ++it) {
+		const QString hash = it.value().toString();
+		if (items.contains(hash))
+			aliases.insert(it.key(), hash);
+	}
+	const QVariantMap bindingMap = config.value(QStringLiteral("bindings"), QVariantMap());
+	for (auto it = bindingMap.constBegin(); it != bindingMap.constEnd(); ++it)
+		bindings.insert(it.key(), it.value().toString());
+}
+
+QString AvatarStoreData::resolve(const QString &hashOrAlias) const
+{
+	if (items.contains(hashOrAlias))
+		return hashOrAlias;
+	return aliases.value(hashOrAlias);
+}
+
+void AvatarStoreData::touch(const QString &hash)
+{
+	auto it = items.find(hash);
+	if (it == items.end())
+		return;
+	const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+	// Day precision is enough for eviction and keeps config writes rare
+	if (now - it->used > 24 * 60 * 60) {
+		it->used = now;
+		markDirty();
+	}
+}
+
+void AvatarStoreData::markDirty()
+{
+	if (dirty)
+		return;
+	dirty = true;
+	QCoreApplication *app = QCoreApplication::instance();
+	if (!app)
+		return;
+	if (!timer) {
+		timer = new QTimer;
+		timer->setSingleShot(true);
+		timer->setInterval(SyncDelay);
+		timer->moveToThread(app->thread());
+		QObject::connect(timer.data(), &QTimer::timeout, [] () { AvatarStore::sync(); });
+		QObject::connect(app, &QCoreApplication::aboutToQuit, [] () { AvatarStore::sync(); });
+	}
+	QMetaObject::invokeMethod(timer.data(), "start", Qt::QueuedConnection);
+}
+
+static bool usedEarlier(const QPair<QString, AvatarStoreItem> &a, const QPair<QString, AvatarStoreItem> &b)
+{
+	return a.second.used < b.second.used;
+}
+
+void AvatarStoreData::collectGarbage()
+{
+	Config config(QStringLiteral("avatars"));
+	const qint64 limit = qint64(config.value(QStringLiteral("store/sizeLimit"), int(DefaultSizeLimit))) * 1024 * 1024;
+	if (limit <= 0 || totalSize <= limit)
+		return;
+
+	QList<QPair<QString, AvatarStoreItem> > sorted;
+	for (auto it = items.constBegin(); it != items.constEnd(); ++it)
+		sorted << qMakePair(it.key(), it.value());
+	std::sort(sorted.begin(), sorted.end(), usedEarlier);
+
+	// Leave some room, otherwise every new avatar would trigger collection
+	const qint64 target = limit - limit / 8;
+	QSet<QString> removed;
+	for (int i = 0; i < sorted.size() && totalSize > target; ++i) {
+		const QString &hash = sorted.at(i).first;
+		if (!dir.remove(hash) && dir.exists(hash))
+			continue;
+		totalSize -= sorted.at(i).second.size;
+		items.remove(hash);
+		removed.insert(hash);
+	}
+	for (auto it = aliases.begin(); it != aliases.end();) {
+		if (removed.contains(it.value()))
+			it = aliases.erase(it);
+		else
+			++it;
+	}
+	dirty = dirty || !removed.isEmpty();
+}
+
+void AvatarStoreData::save()
+{
+	QVariantMap used;
+	for (auto it = items.constBegin(); it != items.constEnd(); ++it)
+		used.insert(it.key(), it->used);
+
+	Config config(QStringLiteral("avatars"));
+	config.beginGroup(QStringLiteral("store"));
+	config.setValue(QStringLiteral("used"), used);
+	config.setValue(QStringLiteral("aliases"), toVariantMap(aliases));
+	config.setValue(QStringLiteral("bindings"), toVariantMap(bindings));
+	config.endGroup();
+	config.sync();
+	dirty = false;
+}
+
+QString AvatarStore::directory()
+{
+	return SystemInfo::getPath(SystemInfo::ConfigDir) + QLatin1String("/avatars/store");
+}
+
+QString AvatarStore::hash(const QByteArray &data)
+{
+	return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+QString AvatarStore::store(const QByteArray &image, const QString &alias)
+{
+	if (image.isEmpty())
+		return QString();
+	const QString digest = hash(image);
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->ensureLoaded();
+
+	if (!d->items.contains(digest)) {
+		QSaveFile file(d->dir.filePath(digest));
+		if (!file.open(QIODevice::WriteOnly) || file.write(image) != image.size() || !file.commit()) {
+			qWarning("Can't store avatar %s", qPrintable(file.fileName()));
+			return QString();
+		}
+		AvatarStoreItem item = { image.size(), QDateTime::currentMSecsSinceEpoch() / 1000 };
+		d->items.insert(digest, item);
+		d->totalSize += item.size;
+		d->markDirty();
+	} else {
+		d->touch(digest);
+	}
+
+	if (!alias.isEmpty() && d->aliases.value(alias) != digest) {
+		d->aliases.insert(alias, digest);
+		d->markDirty();
+	}
+	return d->dir.filePath(digest);
+}
+
+bool AvatarStore::contains(const QString &hashOrAlias)
+{
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->ensureLoaded();
+	return !d->resolve(hashOrAlias).isEmpty();
+}
+
+QString AvatarStore::path(const QString &hashOrAlias)
+{
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->ensureLoaded();
+	const QString digest = d->resolve(hashOrAlias);
+	if (digest.isEmpty())
+		return QString();
+	d->touch(digest);
+	return d->dir.filePath(digest);
+}
+
+void AvatarStore::bind(const QString &key, const QString &hashOrAlias)
+{
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->ensureLoaded();
+	if (hashOrAlias.isEmpty()) {
+		if (d->bindings.remove(key))
+			d->markDirty();
+	} else if (d->bindings.value(key) != hashOrAlias) {
+		d->bindings.insert(key, hashOrAlias);
+		d->markDirty();
+	}
+}
+
+QString AvatarStore::binding(const QString &key)
+{
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->ensureLoaded();
+	return d->bindings.value(key);
+}
+
+QHash<QString, QString> AvatarStore::bindings(const QString &prefix)
+{
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->ensureLoaded();
+	QHash<QString, QString> result;
+	for (auto it = d->bindings.constBegin(); it != d->bindings.constEnd(); ++it) {
+		if (it.key().startsWith(prefix))
+			result.insert(it.key().mid(prefix.size()), it.value());
+	}
+	return result;
+}
+
+void AvatarStore::sync()
+{
+	AvatarStoreData *d = data();
+	QMutexLocker locker(&d->mutex);
+	if (!d->loaded)
+		return;
+	d->collectGarbage();
+	if (d->dirty)
+		d->save();
+}
+
+}
@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_AVATARSTORE_H
+#define QUTIM_SDK_0_3_AVATARSTORE_H
+
+#include "libqutim_global.h"
+#include <QHash>
+#include <QString>
+
+namespace qutim_sdk_0_3
+{
+
+/**
+ * Content addressed storage of avatars shared by all protocols and accounts.
+ *
+ * Every image is stored once in "<config dir>/avatars/store/<sha1>", where
+ * sha1 is hex digest of its data. Protocols usually know avatars by their own
+ * identifiers before they have the data: md5 of the image, url and so on, so
+ * such identifiers may be remembered as aliases of stored images.
+ *
+ * Which avatar belongs to which contact is remembered by bindings, keys are
+ * chosen by protocols, e.g. "icq/<account>/<contact>".
+ *
+ * List of stored files is read once, aliases, bindings and usage times are
+ * written in batches. When total size exceeds the limit from "avatars" config
+ * ("store/sizeLimit", MiB), least recently used images are removed.
+ */
+class LIBQUTIM_EXPORT AvatarStore
+{
+public:
+	static QString directory();
+	static QString hash(const QByteArray &data);
+
+	// Stores data, optionally under an alias, and returns path of the file
+	static QString store(const QByteArray &data, const QString &alias = QString());
+	// Both accept hashes and aliases, path is empty if there is no such avatar
+	static bool contains(const QString &hashOrAlias);
+	static QString path(const QString &hashOrAlias);
+
+	// Empty hash removes the binding
+	static void bind(const QString &key, const QString &hashOrAlias);
+	static QString binding(const QString &key);
+	// Bindings with given key prefix, the prefix is removed from returned keys
+	static QHash<QString, QString> bindings(const QString &prefix);
+
+	// Writes pending changes and removes images over the size limit
+	static void sync();
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_AVATARSTORE_H
@@ -33,12 +33,106 @@
 #include <QBasicTimer>
 #include <QDateTime>
 #include <numeric>
+#include <algorithm>
+#include <string.h>
 
 namespace qutim_sdk_0_3
 {
-typedef QMap<quint64, ChatSession*> MessageHookMap;
+// Sessions of messages being handled, MessageHandlerHook finds them by id.
+// Ids grow monotonically, so messages in flight almost never share a slot
+// and nothing is allocated per message. Colliding ones go to the hash.
+class MessageHookMap
+{
+public:
+	enum { Size = 256 };
+	MessageHookMap()
+	{
+		memset(m_slots, 0, sizeof(m_slots));
+	}
+
+	void insert(quint64 id, ChatSession *session)
+	{
+		Slot &slot = m_slots[id % Size];
+		if (!slot.session) {
+			slot.id = id;
+			slot.session = session;
+		} else {
+			m_overflow.insert(id, session);
+		}
+	}
+
+	ChatSession *value(quint64 id) const
+	{
+		const Slot &slot = m_slots[id % Size];
+		if (slot.session && slot.id == id)
+			return slot.session;
+		return m_overflow.isEmpty() ? 0 : m_overflow.value(id);
+	}
+
+	void remove(quint64 id)
+	{
+		Slot &slot = m_slots[id % Size];
+		if (slot.session && slot.id == id)
+			slot.session = 0;
+		else if (!m_overflow.isEmpty())
+			m_overflow.remove(id);
+	}
+
+private:
+	struct Slot
+	{
+		quint64 id;
+		ChatSession *session;
+	};
+	Slot m_slots[Size];
+	QHash<quint64, ChatSession*> m_overflow;
+};
 Q_GLOBAL_STATIC(MessageHookMap, messageHookMap)
 
+// Last activity is used for ordering of contacts, so a second is precise enough
+enum { LastActivityPrecision = 1000 };
+
+static inline bool isFlagSet(const Message &message, Message::Property key)
+{
+	return message.property(key).toBool();
+}
+
+class ChatSessionPrivate
+{
+public:
+	ChatSessionPrivate() : active(false), appendDepth(0) {}
+	void storeHistoryBatch();
+
+	bool active;
+	int appendDepth;
+	MessageList historyBatch;
+	QDateTime dateOpened;
+};
+
+static bool messageTimeLessThan(const Message &a, const Message &b)
+{
+	return a.time() < b.time();
+}
+
+void ChatSessionPrivate::storeHistoryBatch()
+{
+	MessageList messages;
+	qSwap(messages, historyBatch);
+	// Conference messages may belong to different units
+	while (!messages.isEmpty()) {
+		const History::ContactInfo contact = History::info(messages.first().chatUnit());
+		MessageList batch;
+		for (int i = 0; i < messages.size();) {
+			if (History::info(messages.at(i).chatUnit()) == contact)
+				batch << messages.takeAt(i);
+			else
+				++i;
+		}
+		std::stable_sort(batch.begin(), batch.end(), messageTimeLessThan);
+		History::instance()->storeBatch(contact, batch);
+	}
+}
+
 class MessageHandlerHook : public MessageHandler
 {
 public:
@@ -51,17 +145,21 @@ public:
 		m_storeServiceMessages = cfg.value(QLatin1String("storeServiceMessages"), true);
 	}
 	
-	MessageHandlerAsyncResult doHandle(Message &message) override
+	Result doHandleSync(Message &message, QString *reason) override
 	{
+		Q_UNUSED(reason);
 		ChatSession *session = messageHookMap()->value(originalMessageId());
 		if (session) {
 			session->doAppendMessage(message);
-			if (m_storeMessages && message.property("store", true)
-					&& (m_storeServiceMessages || !message.property("service", false))) {
-				History::instance()->store(message);
+			if (m_storeMessages && message.property(Message::StoreProperty, true)
+					&& (m_storeServiceMessages || !isFlagSet(message, Message::ServiceProperty))) {
+				if (session->d_func()->appendDepth > 0)
+					session->d_func()->historyBatch << message;
+				else
+					History::instance()->store(message);
 			}
 		}
-		return makeAsyncResult(Accept, QString());
+		return Accept;
 	}
 	
 private:
@@ -72,29 +170,21 @@ private:
 class ChatUnitSenderMessageHandler : public MessageHandler
 {
 public:
-	MessageHandlerAsyncResult doHandle(Message &message) override
+	Result doHandleSync(Message &message, QString *reason) override
 	{
+		Q_UNUSED(reason);
 		if (!message.isIncoming()
-		        && !message.property("service", false)
-		        && !message.property("history", false)
-		        && !message.property("donotsend", false)) {
+		        && !message.property(Message::ServiceProperty, false)
+		        && !message.property(Message::HistoryProperty, false)
+		        && !message.property(Message::DoNotSendProperty, false)) {
             if (!message.chatUnit()->send(message)) {
-				return makeAsyncResult(Error, QString());
+				return Error;
             }
 		}
-		return makeAsyncResult(Accept, QString());
+		return Accept;
 	}
 };
 
-class ChatSessionPrivate
-{
-public:
-	ChatSessionPrivate() : active(false) {}
-
-	bool active;
-	QDateTime dateOpened;
-};
-
 struct ChatLayerData
 {
 	ServicePointer<ChatLayer> self;
@@ -137,8 +227,12 @@ void ChatSession::append(const Message &originalMessage, const ChatSession::Appe
                 handler(-result, message, reason);
             return;
         }
-        if (!message.property("service", false) && !message.property("autoreply", false))
-            message.chatUnit()->setLastActivity(message.time());
+        if (!isFlagSet(message, Message::ServiceProperty) && !isFlagSet(message, Message::AutoReplyProperty)) {
+            ChatUnit *unit = message.chatUnit();
+            const QDateTime last = unit->lastActivity();
+            if (!last.isValid() || qAbs(last.msecsTo(message.time())) >= LastActivityPrecision)
+                unit->setLastActivity(message.time());
+        }
         
         if (handler)
             handler(messageId, message, reason);
@@ -150,6 +244,30 @@ void ChatSession::append(const qutim_sdk_0_3::Message &message)
     append(message, AppendHandler());
 }
 
+void ChatSession::append(const MessageList &messages)
+{
+	// Lets the session pass synchronously handled messages to the view at once,
+	// the ones delayed by handlers are still appended one by one.
+	// History of the synchronous ones is written by one storeBatch() call too
+	Q_D(ChatSession);
+	d->appendDepth++;
+	virtual_hook(BeginAppendHook, 0);
+	foreach (const Message &message, messages)
+		append(message);
+	virtual_hook(EndAppendHook, 0);
+	if (--d->appendDepth == 0 && !d->historyBatch.isEmpty())
+		d->storeHistoryBatch();
+}
+
+void ChatSession::addContacts(const QList<Buddy*> &contacts)
+{
+	// Lets the session update its participants view only once
+	virtual_hook(BeginAddContactsHook, 0);
+	foreach (Buddy *contact, contacts)
+		addContact(contact);
+	virtual_hook(EndAddContactsHook, 0);
+}
+
 void ChatSession::appendMessage(const qutim_sdk_0_3::Message &message)
 {
 	append(message);
@@ -184,10 +302,36 @@ void ChatSession::setActive(bool active)
 	emit activated(active);
 }
 
+int ChatSession::unreadCount() const
+{
+	int count = 0;
+	const_cast<ChatSession*>(this)->virtual_hook(UnreadCountHook, &count);
+	return count;
+}
+
+void ChatSession::markReadUntil(quint64 id)
+{
+	virtual_hook(MarkReadUntilHook, &id);
+}
+
 void ChatSession::virtual_hook(int id, void *data)
 {
-	Q_UNUSED(id);
-	Q_UNUSED(data);
+	// Fallbacks for sessions, which don't index their unread messages
+	switch (id) {
+	case UnreadCountHook:
+		*reinterpret_cast<int*>(data) = unread().count();
+		break;
+	case MarkReadUntilHook: {
+		const quint64 last = *reinterpret_cast<quint64*>(data);
+		foreach (const Message &message, unread()) {
+			if (message.id() <= last)
+				markRead(message.id());
+		}
+		break;
+	}
+	default:
+		break;
+	}
 }
 
 class ChatLayerPrivate
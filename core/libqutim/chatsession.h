@@ -46,6 +46,7 @@ class LIBQUTIM_EXPORT ChatSession : public QObject
 	Q_DECLARE_PRIVATE(ChatSession)
 	Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activated)
 	Q_PROPERTY(qutim_sdk_0_3::MessageList unread READ unread NOTIFY unreadChanged)
+	Q_PROPERTY(int unreadCount READ unreadCount NOTIFY unreadCountChanged)
 	Q_PROPERTY(QDateTime dateOpened READ dateOpened WRITE setDateOpened NOTIFY dateOpenedChanged)
 	Q_PROPERTY(qutim_sdk_0_3::ChatUnit *unit READ unit WRITE setChatUnit NOTIFY unitChanged)
 public:
@@ -58,12 +59,18 @@ public:
 	virtual void setChatUnit(qutim_sdk_0_3::ChatUnit* unit) = 0;
 	Q_INVOKABLE void append(const qutim_sdk_0_3::Message &message);
     void append(const Message &message, const AppendHandler &handler);
+	void append(const qutim_sdk_0_3::MessageList &messages);
 	virtual QTextDocument *getInputField() = 0;
 	virtual void markRead(quint64 id) = 0;
 	virtual MessageList unread() const = 0;
+	int unreadCount() const;
+	// Marks all unread messages with ids up to the given one as read
+	void markReadUntil(quint64 id);
 	bool isActive();
 	QDateTime dateOpened() const;
 	void setDateOpened(const QDateTime &date);
+	// Adds many participants at once, e.g. when conference is joined
+	void addContacts(const QList<qutim_sdk_0_3::Buddy*> &contacts);
 public slots:
 	virtual void addContact(qutim_sdk_0_3::Buddy *c) = 0;
 	virtual void removeContact(qutim_sdk_0_3::Buddy *c) = 0;
@@ -83,9 +90,25 @@ signals:
 	void contactRemoved(qutim_sdk_0_3::Buddy *c);
 	void activated(bool active);
 	void unitChanged(qutim_sdk_0_3::ChatUnit *unit);
+	// Emitted only if somebody listens it, as the whole list is copied.
+	// Prefer unreadAdded, unreadRemoved and unreadCountChanged
 	void unreadChanged(const qutim_sdk_0_3::MessageList &);
+	void unreadAdded(const qutim_sdk_0_3::Message &message);
+	// All unread messages with ids in [first, last] were marked as read
+	void unreadRemoved(quint64 first, quint64 last);
+	void unreadCountChanged(int count);
 protected:
 	ChatSession(ChatLayer *chat);
+
+	enum ChatSessionHook {
+		BeginAppendHook = 1,
+		EndAppendHook,
+		BeginAddContactsHook,
+		EndAddContactsHook,
+		UnreadCountHook,
+		MarkReadUntilHook
+	};
+
 	virtual void virtual_hook(int id, void *data);
 	friend class MessageHandlerHook;
 private:
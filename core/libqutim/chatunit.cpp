@@ -28,6 +28,7 @@
 #include "chatsession.h"
 #include <QCoreApplication>
 #include <QSet>
+#include <QTimer>
 #include "message.h"
 #include "metacontact.h"
 #include "conference.h"
@@ -35,6 +36,8 @@
 
 namespace qutim_sdk_0_3
 {
+enum { PausedTimeout = 1500 };
+
 #ifndef QT_NO_DEBUG
 Q_GLOBAL_STATIC(QSet<ChatUnit*>, all_chat_units)
 #endif
@@ -123,13 +126,29 @@ void ChatUnit::setChatState(ChatState state)
         ChatState old = d->chatState;
         d->chatState = state;
         emit chatStateChanged(state, old);
-        if (d->composingNotification)
-            d->composingNotification.data()->reject();
         if (state == ChatUnit::ChatStateComposing) {
-            NotificationRequest request(Notification::UserTyping);
-            request.setObject(this);
-            d->composingNotification = request.send();
+            // Typing resumed after a short pause keeps the same notification
+            if (!d->composingNotification) {
+                NotificationRequest request(Notification::UserTyping);
+                request.setObject(this);
+                d->composingNotification = request.send();
+            }
             setLastActivity(QDateTime::currentDateTime());
+        } else if (state == ChatUnit::ChatStatePaused && d->composingNotification) {
+            // Paused often comes for a moment between words, so the notification
+            // is rejected only if typing is not resumed soon
+            QPointer<Notification> notification = d->composingNotification;
+            QTimer::singleShot(PausedTimeout, this, [this, notification] () {
+                Q_D(ChatUnit);
+                if (!notification || d->chatState == ChatUnit::ChatStateComposing)
+                    return;
+                if (d->composingNotification == notification)
+                    d->composingNotification.clear();
+                notification.data()->reject();
+            });
+        } else if (d->composingNotification) {
+            d->composingNotification.data()->reject();
+            d->composingNotification.clear();
         }
     }
 }
@@ -28,6 +28,8 @@
 #include "systeminfo.h"
 #include "metaobjectbuilder.h"
 #include "debug.h"
+#include "metrics.h"
+#include "executor.h"
 #include <QSet>
 #include <QStringList>
 #include <QFileInfo>
@@ -39,6 +41,20 @@
 #include <QStringBuilder>
 #include <QTimer>
 #include <QPointer>
+#include <QFile>
+#include <QDataStream>
+#include <QScopedPointer>
+#include <QtEndian>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+
+#if defined(Q_OS_WIN)
+# include <windows.h>
+# include <io.h>
+#elif defined(Q_OS_UNIX)
+# include <unistd.h>
+#endif
 
 #define CONFIG_MAKE_DIRTY_ONLY_AT_SET_VALUE 1
 
@@ -110,20 +126,49 @@ public:
         return QFileInfo(fileName).lastModified() == lastModified;
     }
     void sync();
-    void makeDirty() { dirty = true; }
+    void makeDirty(const ConfigPath &path)
+    {
+        dirty = true;
+        // Names look like "/group/key", empty group means the root itself
+        const QString group = path.name().section(QLatin1Char('/'), 1, 1);
+        if (group.isEmpty())
+            dirtyRoot = true;
+        else
+            dirtyGroups.insert(group);
+    }
     QString fileName;
     ConfigBackend *backend;
     bool dirty;
+    bool dirtyRoot;
+    QSet<QString> dirtyGroups;
     bool isAtLoop;
     QSharedPointer<ConfigAtom> data;
     QDateTime lastModified;
+
+    // Changed top-level groups of large files are appended to "<file>.journal"
+    // instead of rewriting the whole file, the journal is replayed on load and
+    // merged back once it grows too big or at exit
+    bool appendJournal();
+    void replayJournal(QVariant &value);
+    void syncJournal();
+    void clearJournal();
+    void compact();
+    QScopedPointer<QFile> journal;
+    qint64 journalSize;
+    bool journalPending;
 };
 
 class ConfigNotifier
 {
 public:
+    typedef QPair<QString, QString> Key;
+
     void mark(const ConfigPath &path)
     {
+        // Nobody waits for this value, so don't even remember it
+        if (!isListened(path))
+            return;
+
         m_changedPaths.insert(qMakePair(path.path(), path.name()));
 
         if (!m_eventSent) {
@@ -144,7 +189,17 @@ public:
             guard,
             callback
         };
-        m_callbacks.insert(qMakePair(path.path(), path.name()), entry);
+        const Key key = qMakePair(path.path(), path.name());
+        m_callbacks.insert(key, entry);
+        forEachPrefix(key, [this] (const Key &prefix) {
+            ++m_prefixes[prefix];
+        });
+    }
+
+    // Returns true if there are listeners of the path itself or any of its children
+    bool hasListenersBelow(const ConfigPath &path) const
+    {
+        return m_prefixes.contains(qMakePair(path.path(), path.name()));
     }
 
 private:
@@ -154,8 +209,46 @@ private:
         std::function<void (const QVariant &)> callback;
     };
 
-    QSet<QPair<QString, QString>> m_changedPaths;
-    QMultiHash<QPair<QString, QString>, Entry> m_callbacks;
+    bool isListened(const ConfigPath &path) const
+    {
+        if (m_callbacks.isEmpty())
+            return false;
+        Key key = qMakePair(path.path(), path.name());
+        if (m_prefixes.contains(key))
+            return true;
+        int index;
+        while ((index = key.second.lastIndexOf(QLatin1Char('/'))) >= 0) {
+            key.second.resize(index);
+            if (m_callbacks.contains(key))
+                return true;
+        }
+        return false;
+    }
+
+    template <typename Callback>
+    static void forEachPrefix(Key key, const Callback &callback)
+    {
+        callback(key);
+        int index;
+        while ((index = key.second.lastIndexOf(QLatin1Char('/'))) >= 0) {
+            key.second.resize(index);
+            callback(key);
+        }
+    }
+
+    void release(const Key &key)
+    {
+        forEachPrefix(key, [this] (const Key &prefix) {
+            auto it = m_prefixes.find(prefix);
+            if (it != m_prefixes.end() && --it.value() <= 0)
+                m_prefixes.erase(it);
+        });
+    }
+
+    QSet<Key> m_changedPaths;
+    QMultiHash<Key, Entry> m_callbacks;
+    // Number of listeners at each path or below it
+    QHash<Key, int> m_prefixes;
     bool m_eventSent = false;
 };
 
@@ -197,21 +290,16 @@ public:
         if (!variant.isValid())
             return result;
 
+        // Children of maps and lists are created only when they are accessed,
+        // until then the atom keeps implicitly shared variant
         switch (variant.type()) {
-        case QVariant::Map: {
-            const auto &input = variant.toMap();
-            auto &map = result->ensureMap();
-            for (auto it = input.begin(); it != input.end(); ++it)
-                map.insert(it.key(), fromVariant(source, it.value(), readOnly, path.child(it.key())));
-        }
+        case QVariant::Map:
+            result->ensureMap();
+            result->m_pending = variant;
             break;
-        case QVariant::List: {
-            const auto &input = variant.toList();
-            auto &list = result->ensureList();
-            list.reserve(input.size());
-            for (const auto &value : input)
-                list.append(fromVariant(source, value, readOnly, path.freeze()));
-        }
+        case QVariant::List:
+            result->ensureList();
+            result->m_pending = variant;
             break;
         default:
             result->ensureValue() = variant;
@@ -253,6 +341,9 @@ public:
 
     QVariant toVariant()
     {
+        if (m_pending.isValid())
+            return m_pending;
+
         switch (m_type) {
         case Map: {
             QVariantMap result;
@@ -308,6 +399,8 @@ public:
     int arraySize()
     {
         Q_ASSERT(isList());
+        if (m_pending.isValid())
+            return m_pending.toList().size();
         auto &list = asList();
         return list.size();
     }
@@ -364,10 +457,14 @@ public:
 
             switch (other->type()) {
             case Map:
-                ensureMap() = other->asMap();
+                clear();
+                ensureMap();
+                m_pending = other->m_pending;
                 break;
             case List:
-                ensureList() = other->asList();
+                clear();
+                ensureList();
+                m_pending = other->m_pending;
                 break;
             case Value:
                 ensureValue() = other->asValue();
@@ -413,12 +510,20 @@ private:
     {
         markMeAndChildren();
         if (auto source = m_source.toStrongRef())
-            source->makeDirty();
+            source->makeDirty(m_path);
     }
 
     void markMeAndChildren()
     {
         mark();
+        // Children are interesting only if someone listens to them
+        if (!config_notifier()->hasListenersBelow(m_path))
+            return;
+        if (m_pending.isValid()) {
+            if (isMap() && !m_path.isFrozen())
+                markVariant(m_path, m_pending);
+            return;
+        }
         if (isMap() && !m_path.isFrozen()) {
             iterateMap([] (const QString &key, const Ptr &child) {
                 Q_UNUSED(key);
@@ -432,6 +537,37 @@ private:
         config_notifier()->mark(m_path);
     }
 
+    // Same as markMeAndChildren for children, which are not created yet
+    static void markVariant(const ConfigPath &path, const QVariant &value)
+    {
+        const QVariantMap map = value.toMap();
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            const ConfigPath child = path.child(it.key());
+            config_notifier()->mark(child);
+            if (it.value().type() == QVariant::Map && config_notifier()->hasListenersBelow(child))
+                markVariant(child, it.value());
+        }
+    }
+
+    void materialize()
+    {
+        QVariant pending;
+        pending.swap(m_pending);
+
+        if (m_type == Map) {
+            const auto &input = pending.toMap();
+            auto &map = *data<ConfigMap>();
+            for (auto it = input.begin(); it != input.end(); ++it)
+                map.insert(it.key(), fromVariant(m_source, it.value(), m_readOnly, m_path.child(it.key())));
+        } else if (m_type == List) {
+            const auto &input = pending.toList();
+            auto &list = *data<ConfigList>();
+            list.reserve(input.size());
+            for (const auto &value : input)
+                list.append(fromVariant(m_source, value, m_readOnly, m_path.freeze()));
+        }
+    }
+
     ConfigMap &asMap()
     {
         Q_ASSERT(isMap());
@@ -458,6 +594,8 @@ private:
             clear();
             new (map) ConfigMap();
             m_type = Map;
+        } else if (m_pending.isValid()) {
+            materialize();
         }
 
         return *map;
@@ -471,6 +609,8 @@ private:
             clear();
             new (list) ConfigList();
             m_type = List;
+        } else if (m_pending.isValid()) {
+            materialize();
         }
 
         return *list;
@@ -492,6 +632,7 @@ private:
 private:
     void clear()
     {
+        m_pending = QVariant();
         switch (m_type) {
         case Map:
             data<ConfigMap>()->~ConfigMap();
@@ -518,6 +659,8 @@ private:
 
     ConfigSource::WeakPtr m_source;
     ConfigPath m_path;
+    // Not yet materialized value of map or list
+    QVariant m_pending;
     union {
         char m_map_buffer[sizeof(ConfigMap)];
         char m_list_buffer[sizeof(ConfigList)];
@@ -557,6 +700,14 @@ public:
         it->config = value;
 	}
 
+	QList<ConfigSource::Ptr> sources() const
+	{
+		QList<ConfigSource::Ptr> result;
+		for (auto it = m_hash.begin(); it != m_hash.end(); ++it)
+			result << it->config;
+		return result;
+	}
+
 	void timerEvent(QTimerEvent *event)
 	{
 		QString key = m_timers.take(event->timerId());
@@ -577,41 +728,132 @@ private:
 
 Q_GLOBAL_STATIC(ConfigSourceHash, sourceHash)
 
+// Files parsed ahead of their opening by Config::preload
+struct ConfigPreloader
+{
+    QMutex mutex;
+    QWaitCondition finished;
+    QHash<QString, QVariant> values;
+    QSet<QString> pending;
+    // Files already read by backends, their state may depend on them
+    QSet<QString> loaded;
+
+    bool take(const QString &fileName, QVariant &value)
+    {
+        QMutexLocker locker(&mutex);
+        loaded.insert(fileName);
+        while (pending.contains(fileName))
+            finished.wait(&mutex);
+        auto it = values.find(fileName);
+        if (it == values.end())
+            return false;
+        value = it.value();
+        values.erase(it);
+        return true;
+    }
+};
+
+Q_GLOBAL_STATIC(ConfigPreloader, configPreloader)
+
 void ConfigNotifier::notify()
 {
     m_eventSent = false;
     auto changedPaths = m_changedPaths;
     m_changedPaths.clear();
-    foreach (auto pair, changedPaths) {
+    const int changedCount = changedPaths.size();
+    foreach (const Key &pair, changedPaths) {
         QString path = pair.second;
         int index;
         while ((index = path.lastIndexOf(QLatin1Char('/'))) >= 0) {
             path.resize(index);
-            changedPaths.insert(qMakePair(pair.first, path));
+            const Key parent = qMakePair(pair.first, path);
+            if (m_callbacks.contains(parent))
+                changedPaths.insert(parent);
         }
     }
     auto sortedPaths = changedPaths.toList();
-    typedef const QPair<QString, QString> & Pair;
+    typedef const Key & Pair;
     std::sort(sortedPaths.begin(), sortedPaths.end(), [] (Pair first, Pair second) {
         return std::make_tuple(first.first, -first.second.size(), first.second)
                 < std::make_tuple(second.first, -second.second.size(), second.second);
     });
+    int callbacks = 0;
     foreach (Pair path, sortedPaths) {
         auto it = m_callbacks.find(path);
         while (it != m_callbacks.end() && it.key() == path) {
             if (!it.value().guard) {
                 auto it2 = it++;
                 m_callbacks.erase(it2);
+                release(path);
                 continue;
             }
             QVariant value = Config(path.first).value(path.second);
             it.value().callback(value);
+            ++callbacks;
             ++it;
         }
     }
+
+    static Counter *notifications = Metrics::counter("qutim_config_notifications_total");
+    static Counter *changes = Metrics::counter("qutim_config_changed_paths_total");
+    static Counter *calls = Metrics::counter("qutim_config_callbacks_total");
+    notifications->add();
+    changes->add(changedCount);
+    calls->add(callbacks);
+}
+
+enum {
+    JournalMagic = 0x514a524e,
+    JournalHeaderSize = 10,
+    // Files smaller than this are cheap enough to be rewritten on every save
+    JournalMinFileSize = 64 * 1024,
+    JournalMaxSize = 256 * 1024
+};
+
+enum JournalRecordType : quint8 { JournalSet, JournalRemove };
+
+static QString journalFileName(const QString &fileName)
+{
+    return fileName + QStringLiteral(".journal");
+}
+
+// Record is magic, payload size and checksum followed by the payload itself,
+// so torn tail left by a crash is recognized and dropped on replay
+static bool appendJournalRecord(QByteArray &records, JournalRecordType type,
+                                const QString &group, const QVariant &value)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint8(type) << group;
+    if (type == JournalSet)
+        out << value;
+    // Values of types without stream operators can be saved only by backend
+    if (out.status() != QDataStream::Ok)
+        return false;
+
+    uchar header[JournalHeaderSize];
+    qToBigEndian<quint32>(JournalMagic, header);
+    qToBigEndian<quint32>(payload.size(), header + 4);
+    qToBigEndian<quint16>(qChecksum(payload.constData(), payload.size()), header + 8);
+    records.append(reinterpret_cast<const char *>(header), JournalHeaderSize);
+    records.append(payload);
+    return true;
 }
 
-ConfigSource::ConfigSource() : backend(nullptr), dirty(false), isAtLoop(false)
+static void syncFile(QFile *file)
+{
+    file->flush();
+#if defined(Q_OS_WIN)
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file->handle())));
+#elif defined(Q_OS_UNIX)
+    ::fsync(file->handle());
+#endif
+}
+
+ConfigSource::ConfigSource()
+    : backend(nullptr), dirty(false), dirtyRoot(false), isAtLoop(false),
+      journalSize(0), journalPending(false)
 {
 }
 
@@ -619,6 +861,136 @@ ConfigSource::~ConfigSource()
 {
     if (dirty)
         sync();
+    syncJournal();
+}
+
+bool ConfigSource::appendJournal()
+{
+    if (journalSize == 0 && QFileInfo(fileName).size() < JournalMinFileSize)
+        return false;
+    // Time to compact, caller rewrites the whole file
+    if (journalSize > JournalMaxSize)
+        return false;
+
+    QByteArray records;
+    QSet<QString> existing;
+    bool ok = true;
+    data->iterateMap([this, &records, &existing, &ok] (const QString &key, const QSharedPointer<ConfigAtom> &child) {
+        if (ok && dirtyGroups.contains(key)) {
+            existing.insert(key);
+            ok = appendJournalRecord(records, JournalSet, key, child->toVariant());
+        }
+    });
+    foreach (const QString &group, dirtyGroups) {
+        if (ok && !existing.contains(group))
+            ok = appendJournalRecord(records, JournalRemove, group, QVariant());
+    }
+    if (!ok)
+        return false;
+
+    if (!journal) {
+        journal.reset(new QFile(journalFileName(fileName)));
+        if (!journal->open(QIODevice::ReadWrite)) {
+            journal.reset();
+            return false;
+        }
+        // Records after the torn tail would never be replayed
+        journal->resize(journalSize);
+        journal->seek(journalSize);
+    }
+
+    if (journal->write(records) != records.size() || !journal->flush()) {
+        qWarning() << "Can't append config journal" << journal->fileName();
+        journal.reset();
+        return false;
+    }
+    journalSize += records.size();
+    journalPending = true;
+    return true;
+}
+
+void ConfigSource::replayJournal(QVariant &value)
+{
+    if (value.isValid() && value.type() != QVariant::Map)
+        return;
+
+    QFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const QByteArray records = file.readAll();
+    file.close();
+
+    QVariantMap map = value.toMap();
+    int offset = 0;
+    int count = 0;
+    while (records.size() - offset >= JournalHeaderSize) {
+        const uchar *header = reinterpret_cast<const uchar *>(records.constData() + offset);
+        const quint32 size = qFromBigEndian<quint32>(header + 4);
+        if (qFromBigEndian<quint32>(header) != JournalMagic
+                || size > quint32(records.size() - offset - JournalHeaderSize)) {
+            break;
+        }
+        const char *payload = records.constData() + offset + JournalHeaderSize;
+        if (qChecksum(payload, size) != qFromBigEndian<quint16>(header + 8))
+            break;
+
+        QDataStream in(QByteArray::fromRawData(payload, size));
+        in.setVersion(QDataStream::Qt_5_0);
+        quint8 type;
+        QString group;
+        QVariant groupValue;
+        in >> type >> group;
+        if (type == JournalSet)
+            in >> groupValue;
+        if (in.status() != QDataStream::Ok)
+            break;
+
+        if (type == JournalSet)
+            map.insert(group, groupValue);
+        else
+            map.remove(group);
+        offset += JournalHeaderSize + size;
+        ++count;
+    }
+
+    if (offset == 0) {
+        QFile::remove(file.fileName());
+        return;
+    }
+    if (offset < records.size())
+        qWarning() << "Dropped torn tail of config journal" << file.fileName();
+    static Counter *replayed = Metrics::counter("qutim_config_journal_replayed_total");
+    replayed->add(count);
+    journalSize = offset;
+    value = map;
+}
+
+void ConfigSource::syncJournal()
+{
+    if (journalPending && journal) {
+        syncFile(journal.data());
+        journalPending = false;
+    }
+}
+
+void ConfigSource::clearJournal()
+{
+    // Backend has just written everything, so the journal is obsolete
+    if (journalSize == 0 && !journal)
+        return;
+    journal.reset();
+    QFile::remove(journalFileName(fileName));
+    journalSize = 0;
+    journalPending = false;
+}
+
+void ConfigSource::compact()
+{
+    if (journalSize == 0 || !data)
+        return;
+    backend->save(fileName, data->toVariant());
+    clearJournal();
+    update();
 }
 
 ConfigSource::Ptr ConfigSource::open(const QString &path, bool systemDir, bool create, ConfigBackend *backend)
@@ -644,6 +1016,8 @@ ConfigSource::Ptr ConfigSource::open(const QString &path, bool systemDir, bool c
 		return result;
 	
 	const QList<ConfigBackend*> &backends = *all_config_backends();
+	ConfigBackend *migrateBackend = nullptr;
+	QString migrateFileName;
 	if (!backend) {
 		QByteArray suffix = info.suffix().toLatin1().toLower();
 	
@@ -660,6 +1034,7 @@ ConfigSource::Ptr ConfigSource::open(const QString &path, bool systemDir, bool c
 		}
 		if (!backend) {
             backend = backends.first();
+			const QString baseName = fileName;
 			fileName += QLatin1Char('.');
 			fileName += QLatin1String(backend->name());
 	
@@ -667,10 +1042,21 @@ ConfigSource::Ptr ConfigSource::open(const QString &path, bool systemDir, bool c
 			if (result && result->isValid())
 				return result;
 			info.setFile(fileName);
+
+			// Profile was switched to another backend, convert the old file
+			if (!info.exists()) {
+				for (int i = 0; i < backends.size() && !migrateBackend; i++) {
+					const QString otherName = baseName % QLatin1Char('.') % QLatin1String(backends.at(i)->name());
+					if (backends.at(i) != backend && QFileInfo::exists(otherName)) {
+						migrateBackend = backends.at(i);
+						migrateFileName = otherName;
+					}
+				}
+			}
 		}
 	}
 
-	if (!info.exists() && !create)
+	if (!info.exists() && !create && !migrateBackend)
 		return result;
 
 	QDir dir = info.absoluteDir();
@@ -689,7 +1075,13 @@ ConfigSource::Ptr ConfigSource::open(const QString &path, bool systemDir, bool c
     const bool readOnly = !info.isWritable() && (systemDir || info.exists());
 
 	d->update();
-    const QVariant value = d->backend->load(d->fileName);
+    QVariant value;
+    if (migrateBackend)
+        value = migrateBackend->load(migrateFileName);
+    else if (!configPreloader()->take(d->fileName, value))
+        value = d->backend->load(d->fileName);
+    if (!migrateBackend)
+        d->replayJournal(value);
     ConfigPath configPath = readOnly ? ConfigPath(ConfigPath::Invalid) : ConfigPath(originalPath, QString());
     d->data = ConfigAtom::fromVariant(result, value, readOnly, configPath);
 
@@ -700,15 +1092,46 @@ ConfigSource::Ptr ConfigSource::open(const QString &path, bool systemDir, bool c
         d->data = ConfigAtom::fromVariant(result, QVariantMap(), readOnly, configPath);
     }
 
+    if (migrateBackend && !readOnly)
+        d->sync();
+
 	sourceHash()->insert(fileName, result);
 	return result;
 }
 
 void ConfigSource::sync()
 {
-    backend->save(fileName, data->toVariant());
+    static Counter *saves = Metrics::counter("qutim_config_saves_total");
+    static Histogram *latency = Metrics::histogram("qutim_config_save_latency_microseconds");
+    MetricTimer timer(latency);
+    saves->add();
+
+    // Changed groups of large files are only appended to the journal
+    const bool journaled = !dirtyRoot && data->isMap() && appendJournal();
+    if (journaled) {
+        static Counter *journalWrites = Metrics::counter("qutim_config_journal_writes_total");
+        journalWrites->add();
+    } else {
+        // Let backend rewrite only changed top-level groups if it's able to
+        bool saved = false;
+        if (!dirtyRoot && data->isMap()) {
+            QStringList groups;
+            QVariantMap changed;
+            data->iterateMap([this, &groups, &changed] (const QString &key, const QSharedPointer<ConfigAtom> &child) {
+                groups << key;
+                if (dirtyGroups.contains(key))
+                    changed.insert(key, child->toVariant());
+            });
+            saved = backend->saveGroups(fileName, groups, changed);
+        }
+        if (!saved)
+            backend->save(fileName, data->toVariant());
+        clearJournal();
+        update();
+    }
     dirty = false;
-    update();
+    dirtyRoot = false;
+    dirtyGroups.clear();
 }
 
 class PostConfigSaveEvent : public QEvent
@@ -723,10 +1146,12 @@ public:
 	ConfigSource::Ptr source;
 };
 
+// Collects changed sources and saves them once per delay, so bursts of
+// setValue calls (roster updates at login) end up as one write per file
 class PostConfigSaver : public QObject
 {
 public:
-	PostConfigSaver()
+	PostConfigSaver() : m_delay(500)
 	{
 		qAddPostRoutine(cleanup);
 	}
@@ -735,14 +1160,44 @@ public:
 	{
 		if (ev->type() == PostConfigSaveEvent::eventType()) {
 			PostConfigSaveEvent *saveEvent = static_cast<PostConfigSaveEvent*>(ev);
-			saveEvent->source->sync();
-			saveEvent->source->isAtLoop = false;
+			m_sources << saveEvent->source;
+			if (!m_timer.isActive())
+				m_timer.start(m_delay.load(), this);
 			return true;
 		}
 		return QObject::event(ev);
 	}
+
+	void flush()
+	{
+		m_timer.stop();
+		QList<ConfigSource::Ptr> sources;
+		sources.swap(m_sources);
+		foreach (const ConfigSource::Ptr &source, sources) {
+			source->sync();
+			source->isAtLoop = false;
+		}
+		// Journals of the whole batch hit the disk together
+		foreach (const ConfigSource::Ptr &source, sources)
+			source->syncJournal();
+	}
+
+	QAtomicInt m_delay;
+
+protected:
+	virtual void timerEvent(QTimerEvent *ev)
+	{
+		if (ev->timerId() == m_timer.timerId())
+			flush();
+		else
+			QObject::timerEvent(ev);
+	}
+
 private:
 	static void cleanup();
+
+	QBasicTimer m_timer;
+	QList<ConfigSource::Ptr> m_sources;
 };
 
 Q_GLOBAL_STATIC(PostConfigSaver, postConfigSaver)
@@ -750,6 +1205,10 @@ Q_GLOBAL_STATIC(PostConfigSaver, postConfigSaver)
 void PostConfigSaver::cleanup()
 {
 	QCoreApplication::sendPostedEvents(postConfigSaver(), PostConfigSaveEvent::eventType());
+	postConfigSaver()->flush();
+	// Start next session from compact files
+	foreach (const ConfigSource::Ptr &source, sourceHash()->sources())
+		source->compact();
 }
 
 class ConfigLevel
@@ -1264,6 +1723,65 @@ void Config::sync()
 	d_func()->sync();
 }
 
+void Config::setSaveDelay(int msecs)
+{
+	postConfigSaver()->m_delay.store(qMax(0, msecs));
+}
+
+int Config::saveDelay()
+{
+	return postConfigSaver()->m_delay.load();
+}
+
+void Config::preload(const QStringList &paths)
+{
+    const QList<ConfigBackend*> &backends = *all_config_backends();
+    if (backends.isEmpty())
+        return;
+    ConfigPreloader *preloader = configPreloader();
+    Executor *executor = Executor::named(QStringLiteral("config"), QThread::idealThreadCount());
+
+    foreach (const QString &path, paths) {
+        // Same lookup as ConfigSource::open does for existing user files
+        QFileInfo info(path);
+        QString fileName = info.isAbsolute() ? path : SystemInfo::getDir(SystemInfo::ConfigDir).filePath(path);
+        fileName = QDir::cleanPath(fileName);
+        const QByteArray suffix = info.suffix().toLatin1().toLower();
+        ConfigBackend *backend = 0;
+        for (int i = 0; i < backends.size() && !suffix.isEmpty(); i++) {
+            if (backends.at(i)->name() == suffix)
+                backend = backends.at(i);
+        }
+        if (!backend) {
+            backend = backends.first();
+            fileName += QLatin1Char('.');
+            fileName += QLatin1String(backend->name());
+        }
+        if (!QFileInfo::exists(fileName))
+            continue;
+
+        {
+            QMutexLocker locker(&preloader->mutex);
+            if (preloader->loaded.contains(fileName)
+                    || preloader->pending.contains(fileName)
+                    || preloader->values.contains(fileName)) {
+                continue;
+            }
+            preloader->pending.insert(fileName);
+        }
+
+        executor->run([preloader, backend, fileName] () {
+            QVariant value;
+            const bool loaded = backend->loadConcurrently(fileName, value);
+            QMutexLocker locker(&preloader->mutex);
+            preloader->pending.remove(fileName);
+            if (loaded)
+                preloader->values.insert(fileName, value);
+            preloader->finished.wakeAll();
+        }, Executor::InteractivePriority);
+    }
+}
+
 void Config::listen(const QString &name, QObject *guard, const std::function<void (const QVariant &)> &callback)
 {
     const QStringList names = parseNames(name);
@@ -1309,6 +1827,21 @@ QByteArray ConfigBackend::name() const
 	return d->extension;
 }
 
+bool ConfigBackend::saveGroups(const QString &file, const QStringList &groups, const QVariantMap &changed)
+{
+	Q_UNUSED(file);
+	Q_UNUSED(groups);
+	Q_UNUSED(changed);
+	return false;
+}
+
+bool ConfigBackend::loadConcurrently(const QString &file, QVariant &entry)
+{
+	Q_UNUSED(file);
+	Q_UNUSED(entry);
+	return false;
+}
+
 void ConfigBackend::virtual_hook(int id, void *data)
 {
 	Q_UNUSED(id);
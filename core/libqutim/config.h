@@ -151,6 +151,19 @@ public:
     void setValue(const QString &key, const char (&value)[N], ValueFlags type = Normal);
 
     void sync();
+    /**
+     * Changed configs are written to disk at most once per @a msecs,
+     * all changes made during this time are saved together. Default is 500.
+     */
+    static void setSaveDelay(int msecs);
+    static int saveDelay();
+    /**
+     * Parses files of given config @a paths at worker threads, so their
+     * later opening doesn't wait for the disk and parser. Only files which
+     * weren't opened yet are preloaded, and only by backends supporting
+     * ConfigBackend::loadConcurrently.
+     */
+    static void preload(const QStringList &paths);
 
     void listen(const QString &name, QObject *guard, const std::function<void (const QVariant &)> &callback);
 
@@ -199,6 +212,23 @@ public:
 
     virtual QVariant load(const QString &file) = 0;
     virtual void save(const QString &file, const QVariant &entry) = 0;
+    /**
+     * Optional capability for backends, which are able to update a file
+     * partially. Called instead of save() when only top-level groups from
+     * @a changed were modified since the previous save of @a file.
+     * @a groups lists all top-level groups of the config in their order.
+     * Returns false if file has to be saved as whole with save(), that's
+     * what default implementation does.
+     */
+    virtual bool saveGroups(const QString &file, const QStringList &groups, const QVariantMap &changed);
+    /**
+     * Optional capability for backends, which are able to read a file
+     * from any thread without touching their own state. Used for files
+     * which were never loaded or saved by this backend before.
+     * Returns false if file can be read only by load(), that's what
+     * default implementation does.
+     */
+    virtual bool loadConcurrently(const QString &file, QVariant &entry);
 
     QByteArray name() const;
 protected:
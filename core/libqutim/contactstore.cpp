@@ -0,0 +1,273 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "contactstore.h"
+#include "contact.h"
+#include "memoryaccounting.h"
+#include <QPointer>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+namespace qutim_sdk_0_3
+{
+
+class ContactStorePrivate
+{
+public:
+	bool isValid(ContactStore::Handle handle) const
+	{
+		return handle >= 0 && handle < ids.size() && !ids.at(handle).isEmpty();
+	}
+	int internTags(const QStringList &tags);
+
+	ContactStore::Factory factory;
+	QVector<QString> ids;
+	QVector<QString> names;
+	QVector<QString> avatars;
+	QVector<int> tags;
+	QVector<Status> statuses;
+	QVector<int> flags;
+	QVector<QPointer<Contact> > contacts;
+	QVector<ContactStore::Handle> freeHandles;
+	QHash<QString, ContactStore::Handle> index;
+	// Rosters have few distinct groups, so entries refer to shared lists of them
+	QVector<QStringList> tagLists;
+	QHash<QString, int> tagListIndex;
+	QSet<QString> tagNames;
+};
+
+int ContactStorePrivate::internTags(const QStringList &list)
+{
+	if (list.isEmpty())
+		return -1;
+	const QString key = list.join(QLatin1Char('\n'));
+	auto it = tagListIndex.constFind(key);
+	if (it != tagListIndex.constEnd())
+		return it.value();
+
+	QStringList interned;
+	interned.reserve(list.size());
+	foreach (const QString &tag, list) {
+		auto jt = tagNames.constFind(tag);
+		if (jt == tagNames.constEnd())
+			jt = tagNames.insert(tag);
+		interned << *jt;
+	}
+	tagLists << interned;
+	tagListIndex.insert(key, tagLists.size() - 1);
+	return tagLists.size() - 1;
+}
+
+ContactStore::ContactStore() : d_ptr(new ContactStorePrivate)
+{
+}
+
+ContactStore::~ContactStore()
+{
+}
+
+void ContactStore::setFactory(const Factory &factory)
+{
+	d_func()->factory = factory;
+}
+
+int ContactStore::count() const
+{
+	return d_func()->index.size();
+}
+
+QList<ContactStore::Handle> ContactStore::handles() const
+{
+	return d_func()->index.values();
+}
+
+ContactStore::Handle ContactStore::find(const QString &id) const
+{
+	return d_func()->index.value(id, InvalidHandle);
+}
+
+ContactStore::Handle ContactStore::insert(const QString &id)
+{
+	Q_D(ContactStore);
+	Q_ASSERT(!id.isEmpty());
+	auto it = d->index.constFind(id);
+	if (it != d->index.constEnd())
+		return it.value();
+
+	Handle handle;
+	if (!d->freeHandles.isEmpty()) {
+		handle = d->freeHandles.takeLast();
+	} else {
+		handle = d->ids.size();
+		d->ids.append(QString());
+		d->names.append(QString());
+		d->avatars.append(QString());
+		d->tags.append(-1);
+		d->statuses.append(Status(Status::Offline));
+		d->flags.append(0);
+		d->contacts.append(QPointer<Contact>());
+	}
+	d->ids[handle] = id;
+	d->index.insert(id, handle);
+	return handle;
+}
+
+void ContactStore::remove(Handle handle)
+{
+	Q_D(ContactStore);
+	if (!d->isValid(handle))
+		return;
+	d->index.remove(d->ids.at(handle));
+	d->ids[handle].clear();
+	d->names[handle].clear();
+	d->avatars[handle].clear();
+	d->tags[handle] = -1;
+	d->statuses[handle] = Status(Status::Offline);
+	d->flags[handle] = 0;
+	d->contacts[handle].clear();
+	d->freeHandles.append(handle);
+}
+
+QString ContactStore::id(Handle handle) const
+{
+	Q_D(const ContactStore);
+	return d->isValid(handle) ? d->ids.at(handle) : QString();
+}
+
+QString ContactStore::name(Handle handle) const
+{
+	Q_D(const ContactStore);
+	return d->isValid(handle) ? d->names.at(handle) : QString();
+}
+
+void ContactStore::setName(Handle handle, const QString &name)
+{
+	Q_D(ContactStore);
+	if (d->isValid(handle))
+		d->names[handle] = name;
+}
+
+QStringList ContactStore::tags(Handle handle) const
+{
+	Q_D(const ContactStore);
+	if (!d->isValid(handle) || d->tags.at(handle) < 0)
+		return QStringList();
+	return d->tagLists.at(d->tags.at(handle));
+}
+
+void ContactStore::setTags(Handle handle, const QStringList &tags)
+{
+	Q_D(ContactStore);
+	if (d->isValid(handle))
+		d->tags[handle] = d->internTags(tags);
+}
+
+Status ContactStore::status(Handle handle) const
+{
+	Q_D(const ContactStore);
+	return d->isValid(handle) ? d->statuses.at(handle) : Status(Status::Offline);
+}
+
+void ContactStore::setStatus(Handle handle, const Status &status)
+{
+	Q_D(ContactStore);
+	if (d->isValid(handle))
+		d->statuses[handle] = Status::intern(status);
+}
+
+QString ContactStore::avatar(Handle handle) const
+{
+	Q_D(const ContactStore);
+	return d->isValid(handle) ? d->avatars.at(handle) : QString();
+}
+
+void ContactStore::setAvatar(Handle handle, const QString &avatar)
+{
+	Q_D(ContactStore);
+	if (d->isValid(handle))
+		d->avatars[handle] = avatar;
+}
+
+int ContactStore::flags(Handle handle) const
+{
+	Q_D(const ContactStore);
+	return d->isValid(handle) ? d->flags.at(handle) : 0;
+}
+
+void ContactStore::setFlags(Handle handle, int flags)
+{
+	Q_D(ContactStore);
+	if (d->isValid(handle))
+		d->flags[handle] = flags;
+}
+
+Contact *ContactStore::contact(Handle handle) const
+{
+	Q_D(const ContactStore);
+	return d->isValid(handle) ? d->contacts.at(handle).data() : 0;
+}
+
+Contact *ContactStore::materialize(Handle handle)
+{
+	Q_D(ContactStore);
+	if (!d->isValid(handle))
+		return 0;
+	if (Contact *contact = d->contacts.at(handle))
+		return contact;
+	if (!d->factory)
+		return 0;
+	Contact *contact = d->factory(handle);
+	d->contacts[handle] = contact;
+	return contact;
+}
+
+void ContactStore::setContact(Handle handle, Contact *contact)
+{
+	Q_D(ContactStore);
+	if (d->isValid(handle))
+		d->contacts[handle] = contact;
+}
+
+qint64 ContactStore::memoryUsage() const
+{
+	Q_D(const ContactStore);
+	// Columns and index node per entry, interned tags and statuses are shared
+	qint64 result = qint64(d->ids.capacity()) * (3 * sizeof(QString) + 2 * sizeof(int)
+												  + sizeof(Status) + sizeof(QPointer<Contact>));
+	for (auto it = d->index.constBegin(); it != d->index.constEnd(); ++it) {
+		const Handle handle = it.value();
+		result += 32 + MemoryAccounting::stringSize(it.key())
+				+ MemoryAccounting::stringSize(d->names.at(handle))
+				+ MemoryAccounting::stringSize(d->avatars.at(handle));
+	}
+	foreach (const QStringList &list, d->tagLists)
+		result += 32 + list.size() * sizeof(QString);
+	foreach (const QString &tag, d->tagNames)
+		result += 16 + MemoryAccounting::stringSize(tag);
+	return result;
+}
+
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_CONTACTSTORE_H
+#define QUTIM_SDK_0_3_CONTACTSTORE_H
+
+#include "status.h"
+#include <QScopedPointer>
+#include <QStringList>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+
+class Contact;
+class ContactStorePrivate;
+
+/**
+ * Compact storage of roster entries for accounts with huge rosters.
+ *
+ * Entries are kept in columns, tag lists and statuses are interned, so an
+ * entry costs a few dozens of bytes instead of a whole Contact object.
+ * Protocol keeps all roster items here and creates Contacts only for the
+ * used ones (online contacts, chats, menus, scripts), the store creates them
+ * by the factory on materialize() and remembers them until they are destroyed.
+ */
+class LIBQUTIM_EXPORT ContactStore
+{
+	Q_DISABLE_COPY(ContactStore)
+	Q_DECLARE_PRIVATE(ContactStore)
+public:
+	// Handle is stable until its entry is removed, then it may be reused
+	typedef int Handle;
+	enum { InvalidHandle = -1 };
+	typedef std::function<Contact *(Handle handle)> Factory;
+
+	ContactStore();
+	~ContactStore();
+
+	void setFactory(const Factory &factory);
+
+	int count() const;
+	QList<Handle> handles() const;
+	Handle find(const QString &id) const;
+	// Returns already existing entry if there is one
+	Handle insert(const QString &id);
+	void remove(Handle handle);
+
+	QString id(Handle handle) const;
+	QString name(Handle handle) const;
+	void setName(Handle handle, const QString &name);
+	QStringList tags(Handle handle) const;
+	void setTags(Handle handle, const QStringList &tags);
+	Status status(Handle handle) const;
+	void setStatus(Handle handle, const Status &status);
+	QString avatar(Handle handle) const;
+	void setAvatar(Handle handle, const QString &avatar);
+	// Protocol specific bits like subscription type
+	int flags(Handle handle) const;
+	void setFlags(Handle handle, int flags);
+
+	// Returns materialized contact or null
+	Contact *contact(Handle handle) const;
+	// Returns materialized contact, it's created by factory if there is no one
+	Contact *materialize(Handle handle);
+	void setContact(Handle handle, Contact *contact);
+
+	// Approximate heap size of entries, materialized contacts are not counted
+	qint64 memoryUsage() const;
+
+private:
+	QScopedPointer<ContactStorePrivate> d_ptr;
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_CONTACTSTORE_H
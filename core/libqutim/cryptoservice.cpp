@@ -64,6 +64,34 @@ QVariant CryptoService::decrypt(const QVariant &value)
     return self.isNull() ? value : self.data()->decryptImpl(value);
 }
 
+QVariantList CryptoService::cryptList(const QVariantList &values)
+{
+    return self.isNull() ? values : self.data()->cryptListImpl(values);
+}
+
+QVariantList CryptoService::decryptList(const QVariantList &values)
+{
+    return self.isNull() ? values : self.data()->decryptListImpl(values);
+}
+
+QVariantList CryptoService::cryptListImpl(const QVariantList &values) const
+{
+    QVariantList result;
+    result.reserve(values.size());
+    foreach (const QVariant &value, values)
+        result << cryptImpl(value);
+    return result;
+}
+
+QVariantList CryptoService::decryptListImpl(const QVariantList &values) const
+{
+    QVariantList result;
+    result.reserve(values.size());
+    foreach (const QVariant &value, values)
+        result << decryptImpl(value);
+    return result;
+}
+
 QVariant CryptoService::variantFromData(const QByteArray &data) const
 {
     QVariant result;
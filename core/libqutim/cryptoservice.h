@@ -40,6 +40,9 @@ class LIBQUTIM_EXPORT CryptoService : public QObject
 public:
     static QVariant crypt(const QVariant &value);
     static QVariant decrypt(const QVariant &value);
+    // Batch versions let the service set up the cipher once for all values
+    static QVariantList cryptList(const QVariantList &values);
+    static QVariantList decryptList(const QVariantList &values);
     virtual QVariant cryptImpl(const QVariant &value) const = 0;
     virtual QVariant decryptImpl(const QVariant &value) const = 0;
     virtual void setPassword(const QString &password, const QVariant &data) = 0;
@@ -50,6 +53,10 @@ protected:
 public:
     CryptoService();
     virtual ~CryptoService();
+    // Default implementations call cryptImpl and decryptImpl for every value.
+    // They are declared last, so vtable of older services stays the same
+    virtual QVariantList cryptListImpl(const QVariantList &values) const;
+    virtual QVariantList decryptListImpl(const QVariantList &values) const;
 };
 }
 
@@ -78,30 +78,34 @@ public:
 
 namespace CompiledProperty
 {
-static QList<QByteArray> names = QList<QByteArray>()
-	<< "name"
-	<< "title"
-	<< "data"
-	<< "maxCount"
-	<< "defaultSubitem"
-	<< "onDataChangedReceiver"
-	<< "onDataChangedMethod";
-static QList<Getter> getters = QList<Getter>()
-	<< static_cast<Getter>(&DataItemPrivate::getName)
-	<< static_cast<Getter>(&DataItemPrivate::getTitle)
-	<< static_cast<Getter>(&DataItemPrivate::getData)
-	<< static_cast<Getter>(&DataItemPrivate::getMaxCount)
-	<< static_cast<Getter>(&DataItemPrivate::getDefaultSubitem)
-	<< static_cast<Getter>(&DataItemPrivate::getOnDataChangedReceiver)
-	<< static_cast<Getter>(&DataItemPrivate::getOnDataChangedMethod);
-static QList<Setter> setters = QList<Setter>()
-	<< static_cast<Setter>(&DataItemPrivate::setName)
-	<< static_cast<Setter>(&DataItemPrivate::setTitle)
-	<< static_cast<Setter>(&DataItemPrivate::setData)
-	<< static_cast<Setter>(&DataItemPrivate::setMaxCount)
-	<< static_cast<Setter>(&DataItemPrivate::setDefaultSubitem)
-	<< static_cast<Setter>(&DataItemPrivate::setOnDataChangedReceiver)
-	<< static_cast<Setter>(&DataItemPrivate::setOnDataChangedMethod);
+static const char * const names[] = {
+	"name",
+	"title",
+	"data",
+	"maxCount",
+	"defaultSubitem",
+	"onDataChangedReceiver",
+	"onDataChangedMethod"
+};
+static const Getter getters[] = {
+	static_cast<Getter>(&DataItemPrivate::getName),
+	static_cast<Getter>(&DataItemPrivate::getTitle),
+	static_cast<Getter>(&DataItemPrivate::getData),
+	static_cast<Getter>(&DataItemPrivate::getMaxCount),
+	static_cast<Getter>(&DataItemPrivate::getDefaultSubitem),
+	static_cast<Getter>(&DataItemPrivate::getOnDataChangedReceiver),
+	static_cast<Getter>(&DataItemPrivate::getOnDataChangedMethod)
+};
+static const Setter setters[] = {
+	static_cast<Setter>(&DataItemPrivate::setName),
+	static_cast<Setter>(&DataItemPrivate::setTitle),
+	static_cast<Setter>(&DataItemPrivate::setData),
+	static_cast<Setter>(&DataItemPrivate::setMaxCount),
+	static_cast<Setter>(&DataItemPrivate::setDefaultSubitem),
+	static_cast<Setter>(&DataItemPrivate::setOnDataChangedReceiver),
+	static_cast<Setter>(&DataItemPrivate::setOnDataChangedMethod)
+};
+static const Table table(names, getters, setters, sizeof(names) / sizeof(names[0]));
 }
 
 static inline void ensure_data(QSharedDataPointer<DataItemPrivate> &d)
@@ -343,17 +347,18 @@ DataItem &DataItem::operator<<(const DataItem &subitem)
 
 QVariant DataItemPrivate::property(const char *name, const QVariant &def) const
 {
-	QByteArray prop = QByteArray::fromRawData(name, strlen(name));
-	int id = CompiledProperty::names.indexOf(prop);
+	const int key = findKey(name);
+	if (key < 0)
+		return def;
+	const int id = CompiledProperty::table.indexOf(key);
 	if (id < 0) {
 		for (const DataItemPrivate *p = this; p != 0; p = p->parent) {
-			id = p->names.indexOf(prop);
-			if (id >= 0)
-				return p->values.at(id);
+			if (const QVariant *value = p->dynamicProperty(key))
+				return *value;
 		}
 		return def;
 	}
-	return (this->*CompiledProperty::getters.at(id))();
+	return (this->*CompiledProperty::table.getter(id))();
 }
 
 QVariant DataItem::property(const char *name, const QVariant &def) const
@@ -365,7 +370,7 @@ QVariant DataItem::property(const char *name, const QVariant &def) const
 
 QList<QByteArray> DataItem::dynamicPropertyNames() const
 {
-    return d ? d->names : QList<QByteArray>();
+    return d ? d->dynamicPropertyNames() : QList<QByteArray>();
 }
 
 QVariantList DataItem::qmlSubItmes() const
@@ -379,7 +384,7 @@ QVariantList DataItem::qmlSubItmes() const
 void DataItem::setProperty(const char *name, const QVariant &value)
 {
 	ensure_data(d);
-	d->setProperty(name, value, CompiledProperty::names, CompiledProperty::setters);
+	d->setProperty(name, value, CompiledProperty::table);
 }
 
 ReadOnlyDataItem::ReadOnlyDataItem(const LocalizedString &title, const QStringList &data) :
@@ -604,6 +609,13 @@ AbstractDataForm *AbstractDataForm::get(const DataItem &item)
 		return 0;
 }
 
+bool AbstractDataForm::updateItem(const DataItem &item)
+{
+	UpdateItemArgument argument = { item, false };
+	virtual_hook(UpdateItemHook, &argument);
+	return argument.updated;
+}
+
 void AbstractDataForm::virtual_hook(int id, void *data)
 {
 	Q_UNUSED(id);
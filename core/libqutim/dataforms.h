@@ -555,6 +555,13 @@ public:
 	  it was when the data form was being created.
 	*/
 	virtual void setData(const QString &fieldName, const QVariant &data) = 0;
+	/**
+	  Updates the fields to values of \a item reusing already created widgets.
+
+	  Returns false if \a item has another set of fields or properties,
+	  a new data form should be created for it in this case.
+	*/
+	bool updateItem(const DataItem &item);
 
 	static AbstractDataForm *get(const DataItem &item);
 signals:
@@ -571,6 +578,15 @@ signals:
 	*/
 	void completeChanged(bool complete);
 protected:
+	enum AbstractDataFormHook {
+		UpdateItemHook = 1
+	};
+	struct UpdateItemArgument
+	{
+		const DataItem &item;
+		bool updated;
+	};
+
 	virtual void virtual_hook(int id, void *data);
 };
 
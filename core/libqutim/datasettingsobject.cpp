@@ -87,6 +87,9 @@ void DataSettingsWidget::setController(QObject *controller)
 
 void DataSettingsWidget::onItemChanged(const DataItem &item)
 {
+    // Page is reloaded on every load and cancel, usually with the same fields
+    if (m_form && m_form->updateItem(item))
+        return;
     delete m_form;
     m_form = AbstractDataForm::get(item);
     if (m_form) {
@@ -27,7 +27,7 @@
 #include "config.h"
 #include "objectgenerator.h"
 #include "metaobjectbuilder.h"
-#include <QTime>
+#include <QMutex>
 
 namespace qutim_sdk_0_3
 {
@@ -42,10 +42,16 @@ public:
 };
 Q_GLOBAL_STATIC(NoDebugStream, devnull)
 
+QIODevice *debug_devnull()
+{
+	return devnull();
+}
+
 struct DebugData
 {
 	enum Level {
-		Default = -1,
+		Default = DebugNone - 1,
+		None = DebugNone,
 		Info = DebugInfo,
 		Verbose = DebugVerbose,
 		VeryVerbose = DebugVeryVerbose
@@ -97,13 +103,42 @@ inline DebugData::Level DebugData::fixedLevel() const
 
 Q_GLOBAL_STATIC(DebugData, coreData)
 
+// Areas are named by QUTIM_PLUGIN_NAME of the code which logs
+struct DebugAreas
+{
+	QMutex mutex;
+	QHash<QByteArray, QBasicAtomicInt *> levels;
+	QHash<QByteArray, int> config;
+
+	int levelFor(const QByteArray &name) const
+	{
+		int level = config.value(name, DebugData::Default);
+		if (level == DebugData::Default)
+			level = debugLevel;
+		return level == DebugData::Default ? DebugData::VeryVerbose : level;
+	}
+};
+Q_GLOBAL_STATIC(DebugAreas, debugAreas)
+
+QBasicAtomicInt *debug_area(const char *name)
+{
+	DebugAreas *areas = debugAreas();
+	const QByteArray key(name ? name : "");
+	QMutexLocker locker(&areas->mutex);
+	QBasicAtomicInt *&level = areas->levels[key];
+	if (!level) {
+		level = new QBasicAtomicInt;
+		level->store(areas->levelFor(key));
+	}
+	return level;
+}
+
 QDebug debug_helper(quint64 debugId, DebugLevel level, QtMsgType type)
 {
 	const DebugData * const data = debugAreaMap()->value(debugId, coreData());
 	if (data->fixedLevel() <= static_cast<DebugData::Level>(level)) {
-		return (QDebug(type)
-				<< qPrintable(QTime::currentTime().toString(QLatin1String("[hh:mm:ss]")))
-				<< data->name.constData());
+		// Time is added by the message handler, there is no need to format it here
+		return (QDebug(type) << data->name.constData());
 	} else {
 		return QDebug(devnull());
 	}
@@ -139,6 +174,16 @@ void debugClearConfig()
 		data->level = config.value(levelStr, DebugData::Default);
 		config.endGroup();
 	}
+
+	DebugAreas *areas = debugAreas();
+	QMutexLocker locker(&areas->mutex);
+	areas->config.clear();
+	config.beginGroup(QLatin1String("areas"));
+	foreach (const QString &name, config.childKeys())
+		areas->config.insert(name.toUtf8(), config.value(name, int(DebugData::Default)));
+	config.endGroup();
+	for (auto jt = areas->levels.begin(); jt != areas->levels.end(); ++jt)
+		jt.value()->store(areas->levelFor(jt.key()));
 }
 
 QtMsgType debug_level(const char *name)
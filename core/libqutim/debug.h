@@ -34,6 +34,7 @@ namespace qutim_sdk_0_3
 {
 	enum DebugLevel
 	{
+		DebugNone = -1,
 		DebugInfo = 0,
 		DebugVerbose,
 		DebugVeryVerbose
@@ -43,12 +44,68 @@ namespace qutim_sdk_0_3
 	LIBQUTIM_EXPORT void debugAddPluginId(quint64, const QMetaObject *meta);
 	LIBQUTIM_EXPORT void debugClearConfig();
     LIBQUTIM_EXPORT QtMsgType debug_level(const char *name);
+	// Verbosity of the area with the given name, it's kept up to date
+	// by debugClearConfig(), so the pointer may be cached
+	LIBQUTIM_EXPORT QBasicAtomicInt *debug_area(const char *name);
+	LIBQUTIM_EXPORT QIODevice *debug_devnull();
+
+#ifdef QUTIM_PLUGIN_NAME
+	static inline QBasicAtomicInt *debug_area_level()
+	{
+		static QBasicAtomicInt * const level = debug_area(QUTIM_PLUGIN_NAME);
+		return level;
+	}
+
+	static inline bool debug_enabled(DebugLevel level)
+	{
+		return debug_area_level()->load() >= level;
+	}
+
+	static inline QDebug debug(DebugLevel level = DebugInfo)
+	{
+		if (debug_enabled(level))
+			return QMessageLogger(0, 0, 0, QUTIM_PLUGIN_NAME).debug();
+		return QDebug(debug_devnull());
+	}
+
+	// Logger behind qDebug(), which checks verbosity of the area first.
+	// Streams of disabled areas write to null device, printf-like calls
+	// are not formatted at all
+	class DebugLogger
+	{
+	public:
+		DebugLogger(const char *file, int line, const char *function)
+			: m_logger(file, line, function, QUTIM_PLUGIN_NAME), m_enabled(debug_enabled(DebugInfo))
+		{
+		}
+
+		QDebug debug() const
+		{
+			return m_enabled ? m_logger.debug() : QDebug(debug_devnull());
+		}
+
+		template <typename... Args>
+		void debug(const char *format, Args... args) const
+		{
+			if (m_enabled)
+				m_logger.debug(format, args...);
+		}
+
+	private:
+		QMessageLogger m_logger;
+		bool m_enabled;
+	};
+#endif
 
 #undef qDebug
 #undef qWarning
 #undef qCritical
 #undef qFatal
-#define qDebug QMessageLogger(__FILE__, __LINE__, Q_FUNC_INFO, QUTIM_PLUGIN_NAME).debug
+// Stays an expression as Qt's one, so "QDebug d = qDebug();" still works
+#define qDebug qutim_sdk_0_3::DebugLogger(__FILE__, __LINE__, Q_FUNC_INFO).debug
+// Statement for hot paths, arguments are not even evaluated if debug
+// output is disabled for the area
+#define qutimDebug() if (!qutim_sdk_0_3::debug_enabled(qutim_sdk_0_3::DebugInfo)) {} else qDebug()
 #define qWarning QMessageLogger(__FILE__, __LINE__, Q_FUNC_INFO, QUTIM_PLUGIN_NAME).warning
 #define qCritical QMessageLogger(__FILE__, __LINE__, Q_FUNC_INFO, QUTIM_PLUGIN_NAME).critical
 #define qFatal QMessageLogger(__FILE__, __LINE__, Q_FUNC_INFO, QUTIM_PLUGIN_NAME).fatal
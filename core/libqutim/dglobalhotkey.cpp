@@ -94,7 +94,11 @@ bool dGlobalHotKey::eventFilter( void *e )
 		MSG *m = ( MSG * ) e;
 
 		if ( m->message == WM_HOTKEY )
-			dGlobalHotKey::instance()->hotKeyPressed( HIWORD( m->lParam ) ^ LOWORD( m->lParam ) );
+		{
+			quint32 k = HIWORD( m->lParam ) ^ LOWORD( m->lParam );
+			if ( dGlobalHotKey::instance()->m_keys.contains( k ) )
+				dGlobalHotKey::instance()->hotKeyPressed( k );
+		}
 #elif defined( Q_WS_X11 )
 		XEvent *event = ( XEvent * ) e;
 
@@ -122,9 +126,12 @@ bool dGlobalHotKey::eventFilter( void *e )
 bool dGlobalHotKey::nativeEventFilter(const QByteArray &eventType, void *message, long *result)
 {
     Q_UNUSED(eventType);
-    Q_UNUSED(message);
     Q_UNUSED(result);
-    return false;
+    // Most of native events are not key ones, so nothing is done for them
+    // until at least one hot key is grabbed
+    if (m_keys.isEmpty())
+        return false;
+    return eventFilter(message);
 }
 
 Q_GLOBAL_STATIC(dGlobalHotKey, dGlobalHotKeySelf)
@@ -139,6 +146,17 @@ bool dGlobalHotKey::shortcut( const QString &s, bool a )
 	quint32 key, mods;
 	native( s, key, mods );
 
+	bool ok = grab( key, mods, a );
+	if ( ok && a )
+		m_keys.insert( mods ^ key );
+	else if ( !a )
+		m_keys.remove( mods ^ key );
+	return ok;
+}
+
+bool dGlobalHotKey::grab( quint32 key, quint32 mods, bool a )
+{
+
 	#if defined( Q_OS_WIN )
 		if ( a )
 			return RegisterHotKey( 0, mods ^ key, mods | MOD_NOREPEAT, key );
@@ -207,6 +225,8 @@ bool dGlobalHotKey::shortcut( const QString &s, bool a )
 			return !UnregisterEventHotKey( ref );
 		}
 	#else
+		Q_UNUSED(key);
+		Q_UNUSED(mods);
 		Q_UNUSED(a);
 		return false;
 	#endif
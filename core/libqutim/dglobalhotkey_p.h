@@ -32,6 +32,7 @@
 #include <QKeySequence>
 #include <QMap>
 #include <QHash>
+#include <QSet>
 
 class dGlobalHotKey : public QObject, public QAbstractNativeEventFilter
 {
@@ -55,9 +56,13 @@ signals:
 
 private:
 	void native( const QString &s, quint32 &k, quint32 &m );
+	bool grab( quint32 key, quint32 mods, bool a );
 
 	quint32 nativeModifiers( Qt::KeyboardModifiers m );
 	quint32 nativeKeycode( Qt::Key k );
+
+	// Ids of grabbed hot keys, native events are not inspected while it's empty
+	QSet<quint32> m_keys;
 #if defined( Q_WS_X11 )
     bool error;
 #endif
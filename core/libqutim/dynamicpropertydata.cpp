@@ -24,48 +24,221 @@
 ****************************************************************************/
 #include "dynamicpropertydata_p.h"
 
+#include <QHash>
+#include <QReadWriteLock>
+
 namespace qutim_sdk_0_3
 {
-	QVariant DynamicPropertyData::property(const char *name, const QVariant &def,
-										   const QList<QByteArray> &gNames,
-										   const QList<Getter> &gGetters) const
+	class PropertyKeyRegistry
 	{
-		QByteArray prop = QByteArray::fromRawData(name, strlen(name));
-		int id = gNames.indexOf(prop);
-		if (id < 0) {
-			id = names.indexOf(prop);
-			if(id < 0)
-				return def;
-			return values.at(id);
+	public:
+		int find(const char *name)
+		{
+			const QByteArray raw = QByteArray::fromRawData(name, qstrlen(name));
+			QReadLocker locker(&m_lock);
+			return m_keys.value(raw, -1);
 		}
-		return (this->*gGetters.at(id))();
-	}
 
-	void DynamicPropertyData::setProperty(const char *name, const QVariant &value,
-										  const QList<QByteArray> &gNames,
-										  const QList<Setter> &gSetters)
+		int key(const char *name)
+		{
+			int result = find(name);
+			if (result >= 0)
+				return result;
+			QWriteLocker locker(&m_lock);
+			const QByteArray raw = QByteArray::fromRawData(name, qstrlen(name));
+			auto it = m_keys.constFind(raw);
+			if (it != m_keys.constEnd())
+				return it.value();
+			const QByteArray copy(name);
+			result = m_names.size();
+			m_names.append(copy);
+			m_keys.insert(copy, result);
+			return result;
+		}
+
+		QByteArray name(int key)
+		{
+			QReadLocker locker(&m_lock);
+			return m_names.value(key);
+		}
+
+	private:
+		QReadWriteLock m_lock;
+		QHash<QByteArray, int> m_keys;
+		QVector<QByteArray> m_names;
+	};
+
+	Q_GLOBAL_STATIC(PropertyKeyRegistry, keyRegistry)
+
+	namespace CompiledProperty
 	{
-		QByteArray prop = QByteArray::fromRawData(name, strlen(name));
-		int id = gNames.indexOf(prop);
-		if (id < 0) {
-			id = names.indexOf(prop);
-			if (!value.isValid()) {
-				if(id < 0)
-					return;
-				names.removeAt(id);
-				values.removeAt(id);
-			} else {
-				if (id < 0) {
-					prop.detach();
-					names.append(prop);
-					values.append(value);
-				} else {
-					values[id] = value;
+		Table::Table(const char * const *names, const Getter *getters, const Setter *setters, int count) :
+			m_mask(0), m_getters(getters), m_setters(setters)
+		{
+			m_keys.reserve(count);
+			int maxKey = 0;
+			for (int i = 0; i < count; ++i) {
+				m_keys.append(DynamicPropertyData::key(names[i]));
+				maxKey = qMax(maxKey, m_keys.last());
+			}
+			// Keys are small integers, so some power of two mask separates them,
+			// the one greater than all keys does it for sure
+			int size = 1;
+			while (size < count)
+				size <<= 1;
+			for (;; size <<= 1) {
+				m_slots.fill(-1, size);
+				bool collision = false;
+				for (int i = 0; i < count && !collision; ++i) {
+					int &slot = m_slots[m_keys.at(i) & (size - 1)];
+					collision = slot >= 0;
+					slot = i;
 				}
+				if (!collision || size > maxKey)
+					break;
 			}
-		} else {
-			(this->*gSetters.at(id))(value);
+			m_mask = size - 1;
+		}
+
+		int Table::indexOf(int key) const
+		{
+			if (key < 0 || m_keys.isEmpty())
+				return -1;
+			const int index = m_slots.at(key & m_mask);
+			return index >= 0 && m_keys.at(index) == key ? index : -1;
 		}
 	}
-}
 
+	const QVariant *DynamicPropertyMap::find(int key) const
+	{
+		if (slots.isEmpty())
+			return 0;
+		const int mask = slots.size() - 1;
+		for (int i = key & mask;; i = (i + 1) & mask) {
+			const Slot &slot = slots.at(i);
+			if (slot.key == key)
+				return &slot.value;
+			if (slot.key < 0)
+				return 0;
+		}
+	}
+
+	void DynamicPropertyMap::insert(int key, const QVariant &value)
+	{
+		// Keep load factor under 3/4, so there is always an empty slot
+		if ((count + 1) * 4 > slots.size() * 3)
+			rehash(qMax(8, slots.size() * 2));
+		const int mask = slots.size() - 1;
+		for (int i = key & mask;; i = (i + 1) & mask) {
+			Slot &slot = slots[i];
+			if (slot.key == key) {
+				slot.value = value;
+				return;
+			}
+			if (slot.key < 0) {
+				slot.key = key;
+				slot.value = value;
+				++count;
+				return;
+			}
+		}
+	}
+
+	void DynamicPropertyMap::remove(int key)
+	{
+		if (slots.isEmpty())
+			return;
+		const int mask = slots.size() - 1;
+		int i = key & mask;
+		while (slots.at(i).key != key) {
+			if (slots.at(i).key < 0)
+				return;
+			i = (i + 1) & mask;
+		}
+		// Shift following entries of the cluster back, so lookups
+		// never stop at the hole
+		for (int j = (i + 1) & mask; slots.at(j).key >= 0; j = (j + 1) & mask) {
+			const int home = slots.at(j).key & mask;
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				slots[i] = slots.at(j);
+				i = j;
+			}
+		}
+		slots[i] = Slot();
+		--count;
+	}
+
+	void DynamicPropertyMap::rehash(int capacity)
+	{
+		QVector<Slot> old(capacity);
+		qSwap(old, slots);
+		count = 0;
+		for (int i = 0; i < old.size(); ++i) {
+			if (old.at(i).key >= 0)
+				insert(old.at(i).key, old.at(i).value);
+		}
+	}
+
+	int DynamicPropertyData::key(const char *name)
+	{
+		return keyRegistry()->key(name);
+	}
+
+	int DynamicPropertyData::findKey(const char *name)
+	{
+		return keyRegistry()->find(name);
+	}
+
+	QByteArray DynamicPropertyData::name(int key)
+	{
+		return keyRegistry()->name(key);
+	}
+
+	QList<QByteArray> DynamicPropertyData::dynamicPropertyNames() const
+	{
+		QList<QByteArray> result;
+		if (!dynamic)
+			return result;
+		foreach (const DynamicPropertyMap::Slot &slot, dynamic->slots) {
+			if (slot.key >= 0)
+				result << name(slot.key);
+		}
+		return result;
+	}
+
+	QVariant DynamicPropertyData::property(const char *name, const QVariant &def,
+										   const CompiledProperty::Table &table) const
+	{
+		const int key = findKey(name);
+		if (key < 0)
+			return def;
+		const int index = table.indexOf(key);
+		if (index >= 0 && table.getter(index))
+			return (this->*table.getter(index))();
+		const QVariant *value = dynamicProperty(key);
+		return value ? *value : def;
+	}
+
+	void DynamicPropertyData::setProperty(const char *name, const QVariant &value,
+										  const CompiledProperty::Table &table)
+	{
+		if (!value.isValid()) {
+			const int key = findKey(name);
+			const int index = table.indexOf(key);
+			if (index >= 0 && table.setter(index))
+				(this->*table.setter(index))(value);
+			else if (key >= 0 && dynamicProperty(key))
+				dynamic->remove(key);
+			return;
+		}
+		const int key = DynamicPropertyData::key(name);
+		const int index = table.indexOf(key);
+		if (index >= 0 && table.setter(index)) {
+			(this->*table.setter(index))(value);
+			return;
+		}
+		if (!dynamic)
+			dynamic = new DynamicPropertyMap;
+		dynamic->insert(key, value);
+	}
+}
@@ -28,6 +28,7 @@
 
 #include <QSharedData>
 #include <QVariant>
+#include <QVector>
 #include "libqutim_global.h"
 
 namespace qutim_sdk_0_3
@@ -38,8 +39,46 @@ namespace qutim_sdk_0_3
 	{
 		typedef QVariant (DynamicPropertyData::*Getter)() const;
 		typedef void (DynamicPropertyData::*Setter)(const QVariant &variant);
+
+		// Properties backed by members of the private class. Names are mapped
+		// to indexes by a collision-free table over interned keys
+		class Table
+		{
+		public:
+			Table(const char * const *names, const Getter *getters, const Setter *setters, int count);
+			int indexOf(int key) const;
+			Getter getter(int index) const { return m_getters ? m_getters[index] : 0; }
+			Setter setter(int index) const { return m_setters ? m_setters[index] : 0; }
+		private:
+			QVector<int> m_keys;
+			QVector<int> m_slots;
+			int m_mask;
+			const Getter *m_getters;
+			const Setter *m_setters;
+		};
 	}
 
+	// Open-addressing map of dynamic properties, shared between copies
+	// of the owner until one of them is changed
+	class DynamicPropertyMap : public QSharedData
+	{
+	public:
+		DynamicPropertyMap() : count(0) {}
+		struct Slot
+		{
+			Slot() : key(-1) {}
+			int key;
+			QVariant value;
+		};
+		const QVariant *find(int key) const;
+		void insert(int key, const QVariant &value);
+		void remove(int key);
+		QVector<Slot> slots;
+		int count;
+	private:
+		void rehash(int capacity);
+	};
+
 	class DynamicPropertyData : public QSharedData
 	{
 	public:
@@ -47,14 +86,22 @@ namespace qutim_sdk_0_3
 		typedef CompiledProperty::Setter Setter;
 		DynamicPropertyData() {}
 		DynamicPropertyData(const DynamicPropertyData &o) :
-				QSharedData(o), names(o.names), values(o.values) {}
-		QList<QByteArray> names;
-		QList<QVariant> values;
-
-		QVariant property(const char *name, const QVariant &def, const QList<QByteArray> &names,
-						  const QList<Getter> &getters) const;
-		void setProperty(const char *name, const QVariant &value, const QList<QByteArray> &names,
-						 const QList<Setter> &setters);
+				QSharedData(o), dynamic(o.dynamic) {}
+
+		// Interned property keys, same name always gets the same key
+		static int key(const char *name);
+		// Returns -1 for names which were never used as property
+		static int findKey(const char *name);
+		static QByteArray name(int key);
+
+		const QVariant *dynamicProperty(int key) const
+		{ return dynamic ? dynamic->find(key) : 0; }
+		bool hasDynamicProperties() const { return dynamic && dynamic->count > 0; }
+		QList<QByteArray> dynamicPropertyNames() const;
+		QVariant property(const char *name, const QVariant &def, const CompiledProperty::Table &table) const;
+		void setProperty(const char *name, const QVariant &value, const CompiledProperty::Table &table);
+	private:
+		QSharedDataPointer<DynamicPropertyMap> dynamic;
 	};
 }
 
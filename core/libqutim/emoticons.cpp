@@ -26,9 +26,14 @@
 #include "emoticons.h"
 #include "configbase.h"
 #include "objectgenerator.h"
+#include "memoryaccounting.h"
 #include <QStringList>
 #include <QSet>
 #include <QHash>
+#include <QMap>
+#include <QSharedPointer>
+#include <QVector>
+#include <algorithm>
 #include <QImageReader>
 #include <QStringBuilder>
 #include <QTextDocument>
@@ -66,13 +71,114 @@ struct EmoticonsThemeData : public QSharedData
 	EmoticonsProvider *provider;
 };
 
+// Immutable trie of escaped emoticon codes, rebuilt after every change of provider
+class EmoticonsMatcher
+{
+public:
+	typedef EmoticonsProvider::Emoticon Emoticon;
+	typedef QSharedPointer<const EmoticonsMatcher> Ptr;
+
+	EmoticonsMatcher(const QHash<QChar, QList<Emoticon> > &indexes);
+	// Returns the longest emoticon at text, which is followed by space in strict mode
+	const Emoticon *match(const QChar *text, bool strict, int *length) const;
+
+private:
+	struct Node
+	{
+		int firstEdge;
+		int edgeCount;
+		int emoticon;
+	};
+	struct Edge
+	{
+		QChar c;
+		int node;
+	};
+	static bool edgeLessThan(const Edge &edge, QChar c) { return edge.c < c; }
+	int child(int node, QChar c) const;
+
+	QVector<Node> m_nodes;
+	QVector<Edge> m_edges;
+	QVector<Emoticon> m_emoticons;
+};
+
 struct EmoticonsProviderPrivate
 {
 	QStringList order;
 	QHash<QString, QStringList> map;
 	QHash<QChar, QList<EmoticonsProvider::Emoticon> > indexes;
+	EmoticonsMatcher::Ptr matcher;
 };
 
+EmoticonsMatcher::EmoticonsMatcher(const QHash<QChar, QList<Emoticon> > &indexes)
+{
+	// Build the trie with maps first and flatten it to sorted edge arrays after that
+	QVector<QMap<QChar, int> > children(1);
+	QVector<int> terminals(1, -1);
+	for (QHash<QChar, QList<Emoticon> >::const_iterator it = indexes.constBegin(); it != indexes.constEnd(); ++it) {
+		foreach (const Emoticon &emo, it.value()) {
+			const QString &code = emo.matchTextEscaped;
+			// tokenize looks up only by lower-case of escaped code, so other keys are never matched
+			if (code.at(0) != it.key())
+				continue;
+			int node = 0;
+			for (int i = 0; i < code.size(); ++i) {
+				int next = children[node].value(code.at(i), -1);
+				if (next == -1) {
+					next = children.size();
+					children[node].insert(code.at(i), next);
+					children.append(QMap<QChar, int>());
+					terminals.append(-1);
+				}
+				node = next;
+			}
+			// Equal codes are resolved in favour of the earlier entry of the list
+			if (terminals[node] == -1) {
+				terminals[node] = m_emoticons.size();
+				m_emoticons.append(emo);
+			}
+		}
+	}
+
+	m_nodes.resize(children.size());
+	for (int i = 0; i < children.size(); ++i) {
+		Node &node = m_nodes[i];
+		node.firstEdge = m_edges.size();
+		node.edgeCount = children.at(i).size();
+		node.emoticon = terminals.at(i);
+		for (QMap<QChar, int>::const_iterator it = children.at(i).constBegin(); it != children.at(i).constEnd(); ++it) {
+			Edge edge = { it.key(), it.value() };
+			m_edges.append(edge);
+		}
+	}
+}
+
+int EmoticonsMatcher::child(int node, QChar c) const
+{
+	const Node &n = m_nodes.at(node);
+	const Edge *begin = m_edges.constData() + n.firstEdge;
+	const Edge *end = begin + n.edgeCount;
+	const Edge *edge = std::lower_bound(begin, end, c, edgeLessThan);
+	return (edge != end && edge->c == c) ? edge->node : -1;
+}
+
+const EmoticonsMatcher::Emoticon *EmoticonsMatcher::match(const QChar *text, bool strict, int *length) const
+{
+	const Emoticon *result = 0;
+	int node = 0;
+	for (int i = 0; !text[i].isNull(); ++i) {
+		node = child(node, text[i].toLower());
+		if (node == -1)
+			break;
+		const int emoticon = m_nodes.at(node).emoticon;
+		if (emoticon != -1 && (!strict || text[i + 1].isNull() || text[i + 1].isSpace())) {
+			result = &m_emoticons.at(emoticon);
+			*length = i + 1;
+		}
+	}
+	return result;
+}
+
 namespace Emoticons
 {
 void ensurePrivate_helper()
@@ -81,6 +187,24 @@ void ensurePrivate_helper()
 	GeneratorList exts = ObjectGenerator::module<EmoticonsBackend>();
 	foreach (const ObjectGenerator *gen, exts)
 		p->backends << gen->generate<EmoticonsBackend>();
+
+	MemoryAccounting::add(MemoryAccounting::EmoticonsCache, 0, QStringLiteral("emoticons"), [] () {
+		qint64 result = 0;
+		if (!p)
+			return result;
+		foreach (EmoticonsThemeData *data, p->cache) {
+			const QHash<QChar, QList<EmoticonsProvider::Emoticon> > indexes = data->provider->emoticonsByChar();
+			for (auto it = indexes.constBegin(); it != indexes.constEnd(); ++it) {
+				foreach (const EmoticonsProvider::Emoticon &emo, it.value()) {
+					result += 32 + MemoryAccounting::stringSize(emo.matchText)
+							+ MemoryAccounting::stringSize(emo.matchTextEscaped)
+							+ MemoryAccounting::stringSize(emo.picPath)
+							+ MemoryAccounting::stringSize(emo.picHTMLCode);
+				}
+			}
+		}
+		return result;
+	});
 }
 
 inline void ensurePrivate()
@@ -154,6 +278,7 @@ void EmoticonsProvider::clearEmoticons()
 	p->order.clear();
 	p->map.clear();
 	p->indexes.clear();
+	p->matcher.clear();
 }
 
 inline void appendEmoticonToHash(QList<EmoticonsProvider::Emoticon> &ls, const EmoticonsProvider::Emoticon &e)
@@ -170,8 +295,16 @@ void EmoticonsProvider::appendEmoticon(const QString &imgPath, const QStringList
 		if (!size.isValid())
 			return;
 	}
+	appendEmoticon(imgPath, size, codes);
+}
+
+void EmoticonsProvider::appendEmoticon(const QString &imgPath, const QSize &size, const QStringList &codes)
+{
+	if (codes.isEmpty() || !size.isValid())
+		return;
 	p->order.append(imgPath);
 	p->map.insert(imgPath, codes);
+	p->matcher.clear();
 	QString imgHtml = QLatin1Literal("<img src=\"")
 			% imgPath
 			% QLatin1Literal("\" width=\"")
@@ -199,6 +332,7 @@ void EmoticonsProvider::removeEmoticon(const QString &imgPath, const QStringList
 {
 	p->order.removeAll(imgPath);
 	p->map.remove(imgPath);
+	p->matcher.clear();
 	foreach (const QString &code, codes) {
 		QString escaped = code.toHtmlEscaped();
 		if (code.isEmpty() || escaped.isEmpty())
@@ -280,6 +414,7 @@ QString EmoticonsTheme::parseEmoticons(const QString &text, ParseMode mode, cons
 	if (isNull())
 		return text;
 	QString result;
+	result.reserve(text.size());
 	QList<Token> tokens = tokenize(text, mode);
 	for (QList<Token>::iterator it = tokens.begin(); it != tokens.end(); it++) {
 		switch(it->type) {
@@ -305,18 +440,6 @@ enum HtmlState
 	SecondTag
 };
 
-inline bool compareEmoticon(const QChar *c, const QString &smile)
-{
-	const QChar *s = smile.constData();
-	while (c->toLower() == *s) {
-		if (s->isNull())
-			return true;
-		s++;
-		c++;
-	}
-	return s->isNull();
-}
-
 inline void appendEmoticon(QString &text, const QString &url, const QStringRef &emo)
 {
 	int i = 0, last = 0;
@@ -335,15 +458,20 @@ QList<EmoticonsTheme::Token> EmoticonsTheme::tokenize(const QString &message, Pa
 		tokens << Token(message);
 		return tokens;
 	}
+	EmoticonsProviderPrivate *provider = p->provider->p.data();
+	if (!provider->matcher)
+		provider->matcher = EmoticonsMatcher::Ptr(new EmoticonsMatcher(provider->indexes));
+	// Keep the reference, so provider may change while we are parsing
+	const EmoticonsMatcher::Ptr matcher = provider->matcher;
+
 	HtmlState state = OutsideHtml;
 	bool at_amp = false;
+	const bool strict = mode & StrictParse;
 	const QChar *begin = message.constData();
 	const QChar *chars = message.constData();
+	// Plain text is always a continuous part of message, so copy it at once
+	const QChar *textBegin = chars;
 	QChar cur;
-	QString text;
-	typedef EmoticonsProvider::Emoticon Emoticon;
-	const QHash<QChar, QList<Emoticon> > allEmoticons = p->provider->emoticonsByChar();
-	QList<Emoticon>::const_iterator it;
 	while (!chars->isNull()) {
 		cur = *chars;
 		if (cur == '<') {
@@ -358,7 +486,7 @@ QList<EmoticonsTheme::Token> EmoticonsTheme::tokenize(const QString &message, Pa
 				break;
 			case L'"':
 			case L'\'':
-				do text += *(chars++);
+				do chars++;
 				while(!chars->isNull() && *chars != cur);
 				break;
 			case L'>':
@@ -368,45 +496,33 @@ QList<EmoticonsTheme::Token> EmoticonsTheme::tokenize(const QString &message, Pa
 				break;
 			}
 		} else if (state != TagText && at_amp) {
-			do text += *(chars++);
+			do chars++;
 			while(!chars->isNull() && *chars != ';');
-			cur = *chars;
 			at_amp = false;
 		} else if (state != TagText) {
-			bool found = false;
 			at_amp = cur == '&';
-			if (!(mode & StrictParse) || chars == begin || (chars-1)->isSpace()) {
-				const QList<Emoticon> emoticons = allEmoticons.value(cur.toLower());
-				for (it = emoticons.constBegin(); it != emoticons.constEnd(); it++ ) {
-					const Emoticon &emo = *it;
-					int length = emo.matchTextEscaped.length();
-					if (compareEmoticon(chars, emo.matchTextEscaped)
-							&& (!(mode&StrictParse) || (chars+length)->isNull() || (chars+length)->isSpace())) {
-						if (!text.isEmpty()) {
-							tokens << Token(text);
-							text = QString();
-						}
-						QString htmlCode;
-						appendEmoticon(htmlCode, emo.picHTMLCode, QStringRef(&message, chars - begin, length));
-						tokens << Token(QString(chars, length), emo.picPath, htmlCode);
-						found = true;
-						at_amp = false;
-						chars += length;
-						cur = *chars;
-						break;
-					}
-				}
-				if (found)
+			if (!strict || chars == begin || (chars-1)->isSpace()) {
+				int length = 0;
+				if (const EmoticonsProvider::Emoticon *emo = matcher->match(chars, strict, &length)) {
+					if (chars != textBegin)
+						tokens << Token(QString(textBegin, chars - textBegin));
+					QString htmlCode;
+					htmlCode.reserve(emo->picHTMLCode.size() + 3 * length);
+					appendEmoticon(htmlCode, emo->picHTMLCode, QStringRef(&message, chars - begin, length));
+					tokens << Token(QString(chars, length), emo->picPath, htmlCode);
+					at_amp = false;
+					chars += length;
+					textBegin = chars;
 					continue;
+				}
 			}
 		}
-		if (cur.isNull())
+		if (chars->isNull())
 			break;
-		text += cur;
 		chars++;
 	}
-	if (!text.isEmpty())
-		tokens << Token(text);
+	if (chars != textBegin)
+		tokens << Token(QString(textBegin, chars - textBegin));
 
 	return tokens;
 }
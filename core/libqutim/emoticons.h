@@ -29,6 +29,7 @@
 #include "libqutim_global.h"
 #include <QSharedData>
 #include <QStringList>
+#include <QSize>
 
 namespace qutim_sdk_0_3
 {
@@ -112,8 +113,11 @@ public:
 protected:
 	void clearEmoticons();
 	void appendEmoticon(const QString &imgPath, const QStringList &codes);
+	// Same as above, but doesn't read the image to get its size
+	void appendEmoticon(const QString &imgPath, const QSize &size, const QStringList &codes);
 	void removeEmoticon(const QString &imgPath, const QStringList &codes);
 private:
+	friend class EmoticonsTheme;
 	QScopedPointer<EmoticonsProviderPrivate> p;
 };
 
@@ -27,17 +27,88 @@
 #include <QDebug>
 #include <QSharedData>
 #include <QCoreApplication>
+#include <QHash>
+#include <QPointer>
+#include <QTimer>
 
 namespace qutim_sdk_0_3
 {
 Q_GLOBAL_STATIC(QObject, eventManagerHandler)
 
+struct EventHandlerEntry
+{
+    QPointer<QObject> receiver;
+    Event::Handler handler;
+    Event::DeliveryMode mode;
+};
+
+typedef QVector<EventHandlerEntry> EventHandlerList;
+
+static QVector<QByteArray> event_ids;
+static QHash<QByteArray, quint16> event_indexes;
+static QVector<EventHandlerList> event_handlers;
+
 void Event::send()
 {
+    if (id < event_handlers.size() && !event_handlers.at(id).isEmpty()) {
+        // Copy is shared, so handlers may safely add or remove other ones
+        const EventHandlerList handlers = event_handlers.at(id);
+        bool expired = false;
+        for (const EventHandlerEntry &entry : handlers) {
+            QObject *receiver = entry.receiver.data();
+            if (!receiver) {
+                expired = true;
+            } else if (entry.mode == DirectDelivery) {
+                entry.handler(*this);
+            } else {
+                const quint16 eventId = id;
+                const QVarLengthArray<QVariant, 5> eventArgs = args;
+                const Handler handler = entry.handler;
+                QTimer::singleShot(0, receiver, [eventId, eventArgs, handler] () {
+                    Event event(eventId);
+                    event.args = eventArgs;
+                    handler(event);
+                });
+            }
+        }
+        if (expired && id < event_handlers.size()) {
+            EventHandlerList &list = event_handlers[id];
+            for (int i = list.size() - 1; i >= 0; --i) {
+                if (!list.at(i).receiver)
+                    list.remove(i);
+            }
+        }
+    }
+    // Legacy listeners filter events of event manager
     QCoreApplication::sendEvent(eventManagerHandler(), this);
 }
 
-static QVector<QByteArray> event_ids;
+void Event::addHandler(quint16 id, QObject *receiver, const Handler &handler, DeliveryMode mode)
+{
+    if (id == 0xffff || !receiver)
+        return;
+    if (id >= event_handlers.size())
+        event_handlers.resize(id + 1);
+    EventHandlerEntry entry = { receiver, handler, mode };
+    event_handlers[id].append(entry);
+}
+
+void Event::removeHandlers(quint16 id, QObject *receiver)
+{
+    if (id >= event_handlers.size())
+        return;
+    EventHandlerList &list = event_handlers[id];
+    for (int i = list.size() - 1; i >= 0; --i) {
+        QObject *current = list.at(i).receiver.data();
+        if (!current || current == receiver)
+            list.remove(i);
+    }
+}
+
+bool Event::hasHandlers(quint16 id)
+{
+    return id < event_handlers.size() && !event_handlers.at(id).isEmpty();
+}
 
 QEvent::Type Event::eventType()
 {
@@ -49,11 +120,14 @@ quint16 Event::registerType(const char *id)
 {
     if(!id)
         return 0xffff;
-    for(int i = 0; i < event_ids.size(); i++)
-        if(event_ids[i] == id)
-            return i;
+    const QByteArray key = QByteArray::fromRawData(id, qstrlen(id));
+    auto it = event_indexes.constFind(key);
+    if (it != event_indexes.constEnd())
+        return it.value();
+    const quint16 index = event_ids.size();
     event_ids.append(id);
-    return event_ids.size() - 1;
+    event_indexes.insert(event_ids.last(), index);
+    return index;
 }
 
 const char *Event::getId(quint16 id)
@@ -31,6 +31,7 @@
 #include <QtCore/QVarLengthArray>
 #include <QtCore/QObject>
 #include <QtCore/QEvent>
+#include <functional>
 
 namespace qutim_sdk_0_3
 {
@@ -50,6 +51,26 @@ public:
     static const char *getId(quint16 id);
     static QObject *eventManager();
 
+    enum DeliveryMode
+    {
+        // Handler is called directly from send()
+        DirectDelivery,
+        // Handler is called from event loop of receiver's thread
+        QueuedDelivery
+    };
+    typedef std::function<void (const Event &event)> Handler;
+
+    /**
+     * Registers @a handler for events with @a id, it is alive while
+     * @a receiver is. Handlers are looked up by index of id, so it's
+     * much cheaper than filtering all events of eventManager().
+     * Should be called from main thread only.
+     */
+    static void addHandler(quint16 id, QObject *receiver, const Handler &handler,
+                           DeliveryMode mode = DirectDelivery);
+    static void removeHandlers(quint16 id, QObject *receiver);
+    static bool hasHandlers(quint16 id);
+
     template<typename T>
     T at(int index) const { return args[index].value<T>(); }
     void send();
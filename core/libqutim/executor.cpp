@@ -0,0 +1,175 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "executor.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+
+namespace qutim_sdk_0_3
+{
+
+class ExecutorPrivate
+{
+public:
+	QString name;
+	QThreadPool pool;
+	mutable QMutex lock;
+	Executor::Statistics statistics[Executor::PriorityCount];
+};
+
+class ExecutorTask : public QRunnable
+{
+public:
+	ExecutorTask(ExecutorPrivate *d, const std::function<void ()> &task, Executor::Priority priority)
+		: m_d(d), m_task(task), m_priority(priority)
+	{
+		m_timer.start();
+		setAutoDelete(true);
+	}
+
+	void run() override
+	{
+		const qint64 wait = m_timer.restart();
+		{
+			QMutexLocker locker(&m_d->lock);
+			Executor::Statistics &stats = m_d->statistics[m_priority];
+			stats.queued--;
+			stats.running++;
+			stats.totalWait += wait;
+			stats.maxWait = qMax<qint64>(stats.maxWait, wait);
+		}
+
+		m_task();
+
+		const qint64 elapsed = m_timer.elapsed();
+		QMutexLocker locker(&m_d->lock);
+		Executor::Statistics &stats = m_d->statistics[m_priority];
+		stats.running--;
+		stats.completed++;
+		stats.totalRun += elapsed;
+	}
+
+private:
+	ExecutorPrivate *m_d;
+	std::function<void ()> m_task;
+	Executor::Priority m_priority;
+	QElapsedTimer m_timer;
+};
+
+struct ExecutorRegistry
+{
+	QMutex lock;
+	QHash<QString, Executor *> executors;
+
+	~ExecutorRegistry()
+	{
+		qDeleteAll(executors);
+	}
+};
+
+Q_GLOBAL_STATIC(ExecutorRegistry, registry)
+
+Executor::Executor(const QString &name, int maxThreadCount) : d_ptr(new ExecutorPrivate)
+{
+	Q_D(Executor);
+	d->name = name;
+	d->pool.setMaxThreadCount(qMax(1, maxThreadCount));
+	for (int i = 0; i < PriorityCount; ++i) {
+		Statistics &stats = d->statistics[i];
+		stats.queued = 0;
+		stats.running = 0;
+		stats.completed = 0;
+		stats.totalWait = 0;
+		stats.maxWait = 0;
+		stats.totalRun = 0;
+	}
+}
+
+Executor::~Executor()
+{
+	Q_D(Executor);
+	d->pool.clear();
+	d->pool.waitForDone();
+}
+
+Executor *Executor::named(const QString &name, int maxThreadCount)
+{
+	ExecutorRegistry *r = registry();
+	QMutexLocker locker(&r->lock);
+	Executor *&executor = r->executors[name];
+	if (!executor)
+		executor = new Executor(name, maxThreadCount);
+	return executor;
+}
+
+QStringList Executor::names()
+{
+	ExecutorRegistry *r = registry();
+	QMutexLocker locker(&r->lock);
+	return r->executors.keys();
+}
+
+QString Executor::name() const
+{
+	return d_func()->name;
+}
+
+int Executor::maxThreadCount() const
+{
+	return d_func()->pool.maxThreadCount();
+}
+
+void Executor::setMaxThreadCount(int count)
+{
+	d_func()->pool.setMaxThreadCount(qMax(1, count));
+}
+
+void Executor::run(const std::function<void ()> &task, Priority priority)
+{
+	Q_D(Executor);
+	{
+		QMutexLocker locker(&d->lock);
+		d->statistics[priority].queued++;
+	}
+	// QThreadPool starts runnables with higher priority first
+	d->pool.start(new ExecutorTask(d, task, priority), priority);
+}
+
+void Executor::waitForDone()
+{
+	d_func()->pool.waitForDone();
+}
+
+Executor::Statistics Executor::statistics(Priority priority) const
+{
+	Q_D(const Executor);
+	QMutexLocker locker(&d->lock);
+	return d->statistics[priority];
+}
+
+}
@@ -0,0 +1,114 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_EXECUTOR_H
+#define QUTIM_SDK_0_3_EXECUTOR_H
+
+#include "libqutim_global.h"
+#include "asyncresult.h"
+#include <QScopedPointer>
+#include <QStringList>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+
+class ExecutorPrivate;
+
+/**
+ * Bounded pool of worker threads with prioritized queue.
+ *
+ * Subsystems get their own named executor instead of
+ * QThreadPool::globalInstance(), so slow bulk jobs of one plugin
+ * can't starve interactive requests of another one.
+ */
+class LIBQUTIM_EXPORT Executor
+{
+	Q_DISABLE_COPY(Executor)
+	Q_DECLARE_PRIVATE(Executor)
+public:
+	enum Priority
+	{
+		BulkPriority = 0,
+		BackgroundPriority,
+		InteractivePriority,
+		PriorityCount
+	};
+
+	struct Statistics
+	{
+		int queued;
+		int running;
+		qint64 completed;
+		// Time tasks spent in queue before start, in milliseconds
+		qint64 totalWait;
+		int maxWait;
+		qint64 totalRun;
+	};
+
+	Executor(const QString &name, int maxThreadCount);
+	~Executor();
+
+	/**
+	 * Returns executor with given name, it is created with @a maxThreadCount
+	 * threads on the first call.
+	 */
+	static Executor *named(const QString &name, int maxThreadCount = 2);
+	static QStringList names();
+
+	QString name() const;
+	int maxThreadCount() const;
+	void setMaxThreadCount(int count);
+
+	void run(const std::function<void ()> &task, Priority priority = InteractivePriority);
+	// Blocks until all already queued tasks are finished
+	void waitForDone();
+
+	Statistics statistics(Priority priority) const;
+
+private:
+	QScopedPointer<ExecutorPrivate> d_ptr;
+};
+
+/**
+ * Runs @a function at @a executor and returns its value as AsyncResult,
+ * so the caller doesn't have to capture handler by itself. Result may be
+ * chained further by AsyncResult::then.
+ */
+template <typename F>
+typename Detail::AsyncThen<F>::Result runAsync(Executor *executor, F function,
+                                               Executor::Priority priority = Executor::InteractivePriority)
+{
+	typedef typename Detail::AsyncThen<F>::Traits Traits;
+	typename Traits::Handler handler;
+	executor->run([handler, function] () mutable {
+		Traits::invoke(handler, function);
+	}, priority);
+	return handler.result();
+}
+
+}
+
+#endif // QUTIM_SDK_0_3_EXECUTOR_H
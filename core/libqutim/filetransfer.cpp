@@ -35,6 +35,19 @@
 #include <QDir>
 #include <QDirIterator>
 #include <QBitArray>
+#include <QAbstractSocket>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QTimer>
+#include <QFile>
+#include <QElapsedTimer>
+#ifdef Q_OS_LINUX
+#  include <sys/sendfile.h>
+#  include <poll.h>
+#  include <errno.h>
+#endif
 
 namespace qutim_sdk_0_3
 {
@@ -508,6 +521,621 @@ void FileTransferJob::virtual_hook(int id, void *data)
 	Q_UNUSED(data);
 }
 
+enum {
+	PumpChunkSize = 256 * 1024,
+	// Data posted to socket but not written to network yet
+	PumpMaxInFlight = 4 * PumpChunkSize,
+	PumpProgressInterval = 250
+};
+
+enum {
+	// Smaller grants would make pumps spin around the scheduler
+	SchedulerMinGrant = 4096,
+	SchedulerMinBurst = 16 * 1024,
+	SchedulerWaitInterval = 20,
+	StatisticsSeconds = 5
+};
+
+struct FileTransferFlow
+{
+	FileTransferFlow() :
+		account(0), weight(1), upload(false), canceled(false),
+		admitted(false), waiting(false), virtualTime(0) {}
+	// Used only as a key, never dereferenced by worker threads
+	const void *account;
+	int weight;
+	bool upload;
+	// Fields below are guarded by scheduler's mutex
+	bool canceled;
+	bool admitted;
+	bool waiting;
+	// Bytes granted divided by weight, flow with least one is served first
+	double virtualTime;
+};
+
+/*
+ * Shapes uploads of all pumps: limits number of simultaneous ones,
+ * caps global and per-account bandwidth with token buckets and shares
+ * it between flows by weighted fair queuing.
+ */
+class FileTransferScheduler
+{
+public:
+	FileTransferScheduler();
+	void reloadLimits();
+	// Blocks until the flow may start, returns false if it's canceled
+	bool admit(FileTransferFlow *flow);
+	void release(FileTransferFlow *flow);
+	// Blocks until some bytes may be sent, returns zero if the flow is canceled
+	qint64 acquire(FileTransferFlow *flow, qint64 wanted);
+	void refund(FileTransferFlow *flow, qint64 bytes);
+	void record(qint64 bytes);
+	void cancel(FileTransferFlow *flow);
+	FileTransferManager::Statistics statistics();
+private:
+	struct Bucket
+	{
+		Bucket() : rate(0), tokens(0), updated(0) {}
+		void refill(qint64 now);
+		qint64 rate;
+		double tokens;
+		qint64 updated;
+	};
+	void addTraffic(qint64 bytes, bool upload);
+	void rotateSlots();
+
+	QMutex mutex;
+	QWaitCondition condition;
+	QElapsedTimer clock;
+	Bucket global;
+	qint64 accountRate;
+	QHash<const void*, Bucket> accounts;
+	int maxActive;
+	int active;
+	QList<FileTransferFlow*> flows;
+	QList<FileTransferFlow*> queue;
+	qint64 slotsSecond;
+	qint64 uploadSlots[StatisticsSeconds];
+	qint64 downloadSlots[StatisticsSeconds];
+	qint64 uploaded;
+	qint64 downloaded;
+};
+
+Q_GLOBAL_STATIC(FileTransferScheduler, scheduler)
+
+void FileTransferScheduler::Bucket::refill(qint64 now)
+{
+	if (!rate)
+		return;
+	const double burst = qMax<qint64>(rate, SchedulerMinBurst);
+	tokens = qMin(burst, tokens + double(rate) * (now - updated) / 1000);
+	updated = now;
+}
+
+FileTransferScheduler::FileTransferScheduler() :
+	accountRate(0), maxActive(0), active(0), slotsSecond(0), uploaded(0), downloaded(0)
+{
+	clock.start();
+	memset(uploadSlots, 0, sizeof(uploadSlots));
+	memset(downloadSlots, 0, sizeof(downloadSlots));
+	reloadLimits();
+}
+
+void FileTransferScheduler::reloadLimits()
+{
+	Config cfg = Config().group(QStringLiteral("filetransfer"));
+	QMutexLocker locker(&mutex);
+	// Limits are stored in KiB/s, zero means unlimited
+	global.rate = qMax(0, cfg.value(QStringLiteral("uploadLimit"), 0)) * Q_INT64_C(1024);
+	accountRate = qMax(0, cfg.value(QStringLiteral("accountUploadLimit"), 0)) * Q_INT64_C(1024);
+	maxActive = qMax(0, cfg.value(QStringLiteral("maxActiveUploads"), 3));
+	for (auto it = accounts.begin(); it != accounts.end(); ++it)
+		it->rate = accountRate;
+	condition.wakeAll();
+}
+
+bool FileTransferScheduler::admit(FileTransferFlow *flow)
+{
+	QMutexLocker locker(&mutex);
+	// Newcomer shouldn't take the whole bandwidth until it catches up with others
+	double virtualTime = -1;
+	foreach (FileTransferFlow *other, flows) {
+		if (other->admitted && (virtualTime < 0 || other->virtualTime < virtualTime))
+			virtualTime = other->virtualTime;
+	}
+	flow->virtualTime = qMax(0.0, virtualTime);
+	flows << flow;
+	if (!flow->upload) {
+		flow->admitted = true;
+		return true;
+	}
+	queue << flow;
+	while (!flow->canceled && maxActive > 0 && (active >= maxActive || queue.first() != flow))
+		condition.wait(&mutex);
+	queue.removeOne(flow);
+	if (flow->canceled) {
+		flows.removeOne(flow);
+		condition.wakeAll();
+		return false;
+	}
+	flow->admitted = true;
+	++active;
+	condition.wakeAll();
+	return true;
+}
+
+void FileTransferScheduler::release(FileTransferFlow *flow)
+{
+	QMutexLocker locker(&mutex);
+	if (flow->admitted && flow->upload)
+		--active;
+	flow->admitted = false;
+	flow->waiting = false;
+	flows.removeOne(flow);
+	condition.wakeAll();
+}
+
+qint64 FileTransferScheduler::acquire(FileTransferFlow *flow, qint64 wanted)
+{
+	QMutexLocker locker(&mutex);
+	if (flow->canceled)
+		return 0;
+	if (!global.rate && !accountRate) {
+		addTraffic(wanted, true);
+		return wanted;
+	}
+
+	Bucket &account = accounts[flow->account];
+	account.rate = accountRate;
+	flow->waiting = true;
+	while (!flow->canceled) {
+		const qint64 now = clock.elapsed();
+		global.refill(now);
+		account.refill(now);
+
+		bool first = true;
+		foreach (FileTransferFlow *other, flows) {
+			if (other != flow && other->waiting && other->virtualTime < flow->virtualTime
+					&& (global.rate || other->account == flow->account)) {
+				first = false;
+				break;
+			}
+		}
+		if (first) {
+			double available = wanted;
+			if (global.rate)
+				available = qMin(available, global.tokens);
+			if (account.rate)
+				available = qMin(available, account.tokens);
+			if (available >= qMin<qint64>(wanted, SchedulerMinGrant)) {
+				const qint64 granted = qint64(available);
+				if (global.rate)
+					global.tokens -= granted;
+				if (account.rate)
+					account.tokens -= granted;
+				flow->virtualTime += double(granted) / flow->weight;
+				flow->waiting = false;
+				addTraffic(granted, true);
+				// Order of waiting flows has changed
+				condition.wakeAll();
+				return granted;
+			}
+		}
+		condition.wait(&mutex, SchedulerWaitInterval);
+	}
+	flow->waiting = false;
+	return 0;
+}
+
+void FileTransferScheduler::refund(FileTransferFlow *flow, qint64 bytes)
+{
+	if (bytes <= 0)
+		return;
+	QMutexLocker locker(&mutex);
+	if (global.rate)
+		global.tokens += bytes;
+	auto it = accounts.find(flow->account);
+	if (it != accounts.end() && it->rate)
+		it->tokens += bytes;
+	flow->virtualTime -= double(bytes) / flow->weight;
+	addTraffic(-bytes, true);
+	condition.wakeAll();
+}
+
+void FileTransferScheduler::record(qint64 bytes)
+{
+	QMutexLocker locker(&mutex);
+	addTraffic(bytes, false);
+}
+
+void FileTransferScheduler::cancel(FileTransferFlow *flow)
+{
+	QMutexLocker locker(&mutex);
+	flow->canceled = true;
+	condition.wakeAll();
+}
+
+void FileTransferScheduler::rotateSlots()
+{
+	const qint64 second = clock.elapsed() / 1000;
+	for (qint64 i = slotsSecond + 1; i <= second && i <= slotsSecond + StatisticsSeconds; ++i) {
+		uploadSlots[i % StatisticsSeconds] = 0;
+		downloadSlots[i % StatisticsSeconds] = 0;
+	}
+	slotsSecond = second;
+}
+
+void FileTransferScheduler::addTraffic(qint64 bytes, bool upload)
+{
+	rotateSlots();
+	const int slot = slotsSecond % StatisticsSeconds;
+	if (upload) {
+		uploadSlots[slot] += bytes;
+		uploaded += bytes;
+	} else {
+		downloadSlots[slot] += bytes;
+		downloaded += bytes;
+	}
+}
+
+FileTransferManager::Statistics FileTransferScheduler::statistics()
+{
+	QMutexLocker locker(&mutex);
+	rotateSlots();
+	FileTransferManager::Statistics result;
+	result.activeTransfers = flows.size() - queue.size();
+	result.queuedTransfers = queue.size();
+	// Current second is not finished yet, so it's not counted
+	qint64 up = 0;
+	qint64 down = 0;
+	const int current = slotsSecond % StatisticsSeconds;
+	for (int i = 0; i < StatisticsSeconds; ++i) {
+		if (i == current)
+			continue;
+		up += uploadSlots[i];
+		down += downloadSlots[i];
+	}
+	result.uploadRate = up / (StatisticsSeconds - 1);
+	result.downloadRate = down / (StatisticsSeconds - 1);
+	result.uploaded = uploaded;
+	result.downloaded = downloaded;
+	return result;
+}
+
+class FileTransferPumpThread : public QThread
+{
+public:
+	FileTransferPumpThread(FileTransferPumpPrivate *d) : d(d) {}
+protected:
+	void run();
+private:
+	FileTransferPumpPrivate *d;
+};
+
+class FileTransferPumpPrivate
+{
+	Q_DECLARE_PUBLIC(FileTransferPump)
+public:
+	enum Mode { Idle, Sending, Receiving };
+
+	FileTransferPumpPrivate(FileTransferPump *q) :
+		q_ptr(q), device(0), mode(Idle), generation(0), begin(0), end(0), position(0),
+		inFlight(0), canceled(false), thread(this) {}
+	void start(Mode mode, QIODevice *device, qint64 offset, qint64 size);
+	void run();
+	FileTransferJob::ErrorType runSending();
+	FileTransferJob::ErrorType runSendfile();
+	FileTransferJob::ErrorType runReceiving();
+	void setPosition(qint64 pos);
+	void _q_write(int generation, const QByteArray &data);
+	void _q_bytesWritten(qint64 bytes);
+	void _q_updateProgress();
+	void _q_finished(int generation, int error);
+
+	FileTransferPump *q_ptr;
+	QPointer<FileTransferJob> job;
+	QPointer<QAbstractSocket> socket;
+	FileTransferPump::Framer framer;
+	FileTransferPump::Observer observer;
+	QIODevice *device;
+	Mode mode;
+	// Queued calls of previous runs are ignored
+	int generation;
+	bool useSendfile;
+	int socketDescriptor;
+	qint64 begin;
+	qint64 end;
+	// Fields below are shared with worker thread
+	QMutex mutex;
+	QWaitCondition condition;
+	qint64 position;
+	qint64 inFlight;
+	QQueue<QByteArray> incoming;
+	bool canceled;
+	FileTransferPumpThread thread;
+	QTimer progressTimer;
+	FileTransferFlow flow;
+};
+
+void FileTransferPumpThread::run()
+{
+	d->run();
+}
+
+void FileTransferPumpPrivate::start(Mode m, QIODevice *dev, qint64 offset, qint64 size)
+{
+	Q_Q(FileTransferPump);
+	q->stop();
+	mode = m;
+	++generation;
+	device = dev;
+	begin = offset;
+	end = offset + size;
+	position = offset;
+	inFlight = 0;
+	incoming.clear();
+	canceled = false;
+	useSendfile = false;
+#ifdef Q_OS_LINUX
+	// Data must get to the socket through its buffer if it's encrypted or framed
+	QFile *file = qobject_cast<QFile*>(device);
+	useSendfile = mode == Sending && !framer && !observer && file && file->handle() != -1
+			&& socket && !socket->inherits("QSslSocket")
+			&& socket->socketDescriptor() != -1 && socket->bytesToWrite() == 0;
+#endif
+	socketDescriptor = socket ? int(socket->socketDescriptor()) : -1;
+	// Scheduler is created at GUI thread as it reads config
+	scheduler();
+	flow.canceled = false;
+	flow.upload = mode == Sending;
+	flow.account = job && job->chatUnit() ? job->chatUnit()->account() : 0;
+	progressTimer.start();
+	thread.start();
+}
+
+void FileTransferPumpPrivate::run()
+{
+	FileTransferJob::ErrorType error = FileTransferJob::Canceled;
+	if (scheduler()->admit(&flow)) {
+		if (mode == Receiving)
+			error = runReceiving();
+		else if (useSendfile)
+			error = runSendfile();
+		else
+			error = runSending();
+		scheduler()->release(&flow);
+	}
+	QMetaObject::invokeMethod(q_func(), "_q_finished", Qt::QueuedConnection,
+							  Q_ARG(int, generation), Q_ARG(int, error));
+}
+
+FileTransferJob::ErrorType FileTransferPumpPrivate::runSending()
+{
+	if (!device->isSequential() && !device->seek(begin))
+		return FileTransferJob::IOError;
+	qint64 pos = begin;
+	while (pos < end) {
+		{
+			QMutexLocker locker(&mutex);
+			while (inFlight >= PumpMaxInFlight && !canceled)
+				condition.wait(&mutex);
+			if (canceled)
+				return FileTransferJob::Canceled;
+		}
+		const qint64 granted = scheduler()->acquire(&flow, qMin<qint64>(PumpChunkSize, end - pos));
+		if (!granted)
+			return FileTransferJob::Canceled;
+		const QByteArray data = device->read(granted);
+		if (data.isEmpty())
+			return FileTransferJob::IOError;
+		if (observer)
+			observer(data.constData(), data.size(), pos);
+		const QByteArray frame = framer ? framer(data, pos) : data;
+		pos += data.size();
+		{
+			QMutexLocker locker(&mutex);
+			inFlight += frame.size();
+			position = pos;
+		}
+		QMetaObject::invokeMethod(q_func(), "_q_write", Qt::QueuedConnection,
+								  Q_ARG(int, generation), Q_ARG(QByteArray, frame));
+	}
+	return FileTransferJob::NoError;
+}
+
+FileTransferJob::ErrorType FileTransferPumpPrivate::runSendfile()
+{
+#ifdef Q_OS_LINUX
+	const int fileDescriptor = static_cast<QFile*>(device)->handle();
+	off_t offset = begin;
+	while (offset < end) {
+		{
+			QMutexLocker locker(&mutex);
+			if (canceled)
+				return FileTransferJob::Canceled;
+		}
+		const qint64 granted = scheduler()->acquire(&flow, qMin<qint64>(PumpMaxInFlight, end - offset));
+		if (!granted)
+			return FileTransferJob::Canceled;
+		const ssize_t written = ::sendfile(socketDescriptor, fileDescriptor, &offset, granted);
+		scheduler()->refund(&flow, granted - qMax<ssize_t>(written, 0));
+		if (written > 0) {
+			setPosition(offset);
+		} else if (written == 0) {
+			// File is shorter than it was told
+			return FileTransferJob::IOError;
+		} else if (errno == EAGAIN || errno == EINTR) {
+			// Socket is non-blocking, wake up sometimes to check for cancel
+			pollfd fd;
+			fd.fd = socketDescriptor;
+			fd.events = POLLOUT;
+			fd.revents = 0;
+			::poll(&fd, 1, 100);
+		} else {
+			return FileTransferJob::NetworkError;
+		}
+	}
+	return FileTransferJob::NoError;
+#else
+	return FileTransferJob::NotSupported;
+#endif
+}
+
+FileTransferJob::ErrorType FileTransferPumpPrivate::runReceiving()
+{
+	qint64 pos = begin;
+	while (pos < end) {
+		QQueue<QByteArray> queue;
+		{
+			QMutexLocker locker(&mutex);
+			while (incoming.isEmpty() && !canceled)
+				condition.wait(&mutex);
+			if (canceled)
+				return FileTransferJob::Canceled;
+			qSwap(queue, incoming);
+		}
+		foreach (const QByteArray &data, queue) {
+			const qint64 size = qMin<qint64>(data.size(), end - pos);
+			if (device->write(data.constData(), size) != size)
+				return FileTransferJob::IOError;
+			if (observer)
+				observer(data.constData(), size, pos);
+			pos += size;
+			scheduler()->record(size);
+		}
+		setPosition(pos);
+	}
+	if (QFile *file = qobject_cast<QFile*>(device))
+		file->flush();
+	return FileTransferJob::NoError;
+}
+
+void FileTransferPumpPrivate::setPosition(qint64 pos)
+{
+	QMutexLocker locker(&mutex);
+	position = pos;
+}
+
+void FileTransferPumpPrivate::_q_write(int gen, const QByteArray &data)
+{
+	if (gen != generation || mode == Idle)
+		return;
+	if (!socket) {
+		QMutexLocker locker(&mutex);
+		canceled = true;
+		condition.wakeAll();
+		return;
+	}
+	socket->write(data);
+}
+
+void FileTransferPumpPrivate::_q_bytesWritten(qint64 bytes)
+{
+	if (mode != Sending || useSendfile)
+		return;
+	QMutexLocker locker(&mutex);
+	inFlight = qMax<qint64>(0, inFlight - bytes);
+	if (inFlight < PumpMaxInFlight)
+		condition.wakeAll();
+}
+
+void FileTransferPumpPrivate::_q_updateProgress()
+{
+	qint64 pos;
+	{
+		QMutexLocker locker(&mutex);
+		pos = position;
+	}
+	if (job)
+		job->setFileProgress(pos);
+}
+
+void FileTransferPumpPrivate::_q_finished(int gen, int error)
+{
+	Q_Q(FileTransferPump);
+	if (gen != generation || mode == Idle)
+		return;
+	thread.wait();
+	progressTimer.stop();
+	mode = Idle;
+	_q_updateProgress();
+	if (error == FileTransferJob::NoError)
+		emit q->finished();
+	else if (error != FileTransferJob::Canceled)
+		emit q->error(static_cast<FileTransferJob::ErrorType>(error));
+}
+
+FileTransferPump::FileTransferPump(FileTransferJob *job, QAbstractSocket *socket) :
+	QObject(job), d_ptr(new FileTransferPumpPrivate(this))
+{
+	Q_D(FileTransferPump);
+	d->job = job;
+	d->socket = socket;
+	d->progressTimer.setInterval(PumpProgressInterval);
+	connect(&d->progressTimer, SIGNAL(timeout()), SLOT(_q_updateProgress()));
+	if (socket)
+		connect(socket, SIGNAL(bytesWritten(qint64)), SLOT(_q_bytesWritten(qint64)));
+}
+
+FileTransferPump::~FileTransferPump()
+{
+	stop();
+}
+
+void FileTransferPump::setFramer(const Framer &framer)
+{
+	d_func()->framer = framer;
+}
+
+void FileTransferPump::setObserver(const Observer &observer)
+{
+	d_func()->observer = observer;
+}
+
+void FileTransferPump::setWeight(int weight)
+{
+	d_func()->flow.weight = qMax(1, weight);
+}
+
+void FileTransferPump::send(QIODevice *device, qint64 offset, qint64 size)
+{
+	d_func()->start(FileTransferPumpPrivate::Sending, device, offset, size);
+}
+
+void FileTransferPump::receive(QIODevice *device, qint64 offset, qint64 size)
+{
+	d_func()->start(FileTransferPumpPrivate::Receiving, device, offset, size);
+}
+
+void FileTransferPump::write(const QByteArray &data)
+{
+	Q_D(FileTransferPump);
+	if (data.isEmpty())
+		return;
+	QMutexLocker locker(&d->mutex);
+	d->incoming.enqueue(data);
+	d->condition.wakeAll();
+}
+
+void FileTransferPump::stop()
+{
+	Q_D(FileTransferPump);
+	{
+		QMutexLocker locker(&d->mutex);
+		d->canceled = true;
+		d->condition.wakeAll();
+	}
+	scheduler()->cancel(&d->flow);
+	d->thread.wait();
+	d->progressTimer.stop();
+	d->mode = FileTransferPumpPrivate::Idle;
+}
+
+bool FileTransferPump::isActive() const
+{
+	return d_func()->mode != FileTransferPumpPrivate::Idle;
+}
+
 class FileTransferObserverPrivate
 {
 	Q_DECLARE_PUBLIC(FileTransferObserver)
@@ -812,6 +1440,16 @@ void FileTransferManager::updateFactories(const QStringList &factoryClassNames)
 	oldFactories = newFactories;
 }
 
+FileTransferManager::Statistics FileTransferManager::statistics()
+{
+	return scheduler()->statistics();
+}
+
+void FileTransferManager::reloadLimits()
+{
+	scheduler()->reloadLimits();
+}
+
 void FileTransferManager::virtual_hook(int id, void *data)
 {
 	Q_UNUSED(id);
@@ -30,10 +30,12 @@
 #include <QHostAddress>
 #include <QStringList>
 #include <QSharedData>
+#include <functional>
 
 class QDir;
 class QUrl;
 class QIcon;
+class QAbstractSocket;
 
 namespace qutim_sdk_0_3
 {
@@ -48,6 +50,7 @@ class FileTransferInfoPrivate;
 class FileTransferObserverPrivate;
 class FileTransferFactoryPrivate;
 class FileTransferManagerPrivate;
+class FileTransferPumpPrivate;
 
 class LIBQUTIM_EXPORT FileTransferInfo
 {
@@ -146,9 +149,57 @@ private: // don't tell moc, doxygen or kdevelop, but those signals are in fact p
 	void accepted();
 private:
 	friend class FileTransferManager;
+	friend class FileTransferPumpPrivate;
 	QScopedPointer<FileTransferJobPrivate> d_ptr;
 };
 
+/**
+ * Moves data of the current file between local device and the socket
+ * of the job by worker thread, so protocols don't copy it by small chunks
+ * at GUI thread. Unframed data is sent with sendfile where it is possible.
+ *
+ * Socket must not be written by anyone else while data is being sent.
+ * Progress of the job is updated by the pump a few times per second.
+ * Uploads are shaped and queued according to limits of FileTransferManager.
+ */
+class LIBQUTIM_EXPORT FileTransferPump : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(FileTransferPump)
+public:
+	// Called at worker thread for chunks read from file, returns data for socket
+	typedef std::function<QByteArray (const QByteArray &data, qint64 offset)> Framer;
+	// Called at worker thread for all file data passing through the pump
+	typedef std::function<void (const char *data, qint64 size, qint64 offset)> Observer;
+
+	FileTransferPump(FileTransferJob *job, QAbstractSocket *socket);
+	~FileTransferPump();
+
+	void setFramer(const Framer &framer);
+	void setObserver(const Observer &observer);
+	// Share of upload bandwidth relative to other pumps, 1 by default
+	void setWeight(int weight);
+
+	// Sends @a size bytes of opened @a device starting at @a offset
+	void send(QIODevice *device, qint64 offset, qint64 size);
+	// Writes @a size bytes passed by write() to opened @a device, @a offset is position of the first one
+	void receive(QIODevice *device, qint64 offset, qint64 size);
+	// Data received from socket and already unframed by protocol
+	void write(const QByteArray &data);
+	// Blocks until worker thread is stopped, device may be closed after that
+	void stop();
+	bool isActive() const;
+signals:
+	void finished();
+	void error(qutim_sdk_0_3::FileTransferJob::ErrorType error);
+private:
+	Q_PRIVATE_SLOT(d_func(), void _q_write(int generation, const QByteArray &data))
+	Q_PRIVATE_SLOT(d_func(), void _q_bytesWritten(qint64 bytes))
+	Q_PRIVATE_SLOT(d_func(), void _q_updateProgress())
+	Q_PRIVATE_SLOT(d_func(), void _q_finished(int generation, int error))
+	QScopedPointer<FileTransferPumpPrivate> d_ptr;
+};
+
 class LIBQUTIM_EXPORT FileTransferObserver : public QObject
 {
 	Q_OBJECT
@@ -201,6 +252,18 @@ class LIBQUTIM_EXPORT FileTransferManager : public QObject
 	Q_DECLARE_PRIVATE(FileTransferManager)
 	Q_CLASSINFO("Service", "FileTransferManager")
 public:
+	struct Statistics
+	{
+		int activeTransfers;
+		// Uploads waiting for others to finish
+		int queuedTransfers;
+		// Averages over last few seconds, in bytes per second
+		qint64 uploadRate;
+		qint64 downloadRate;
+		qint64 uploaded;
+		qint64 downloaded;
+	};
+
 	FileTransferManager();
 	~FileTransferManager();
 	
@@ -217,6 +280,11 @@ public:
 	// factories.
 	// TODO: come up with a more appropriate name
 	static void updateFactories(const QStringList &factoryClassNames);
+	// Traffic of all file transfer pumps
+	static Statistics statistics();
+	// Rereads bandwidth and concurrency limits from "filetransfer" config group,
+	// must be called by the file transfer settings layer once they're changed
+	static void reloadLimits();
 protected:
 	virtual QIODevice *doOpenFile(FileTransferJob *job) = 0;
 	virtual void handleJob(FileTransferJob *job, FileTransferJob *oldJob) = 0;
@@ -24,14 +24,85 @@
 ****************************************************************************/
 #include "groupchatmanager_p.h"
 #include "accountmanager.h"
+#include "account.h"
+#include "chatsession.h"
+#include "conference.h"
+#include "config.h"
+#include <QPointer>
 
 namespace qutim_sdk_0_3
 {
 
+enum { MaxParallelJoins = 3, JoinInterval = 500, JoinTimeout = 15000 };
+
+void GroupChatManagerPrivate::start(const PendingJoin &pending)
+{
+    Conference *conference = pending.handler();
+    if (!conference || conference->isJoined())
+        return;
+    QObject *object = conference;
+    joining.insert(object);
+    QObject::connect(conference, &Conference::joinedChanged, q, [this, object] () {
+        release(object);
+    });
+    QObject::connect(conference, &QObject::destroyed, q, [this, object] () {
+        release(object);
+    });
+    // Server may never answer, don't let one room block the rest
+    QPointer<Conference> guard(conference);
+    QTimer::singleShot(JoinTimeout, q, [this, guard, object] () {
+        if (guard)
+            release(object);
+    });
+}
+
+void GroupChatManagerPrivate::release(QObject *conference)
+{
+    if (joining.remove(conference) && !timer.isActive())
+        timer.start();
+}
+
+void GroupChatManagerPrivate::next()
+{
+    if (queue.isEmpty() || joining.size() >= MaxParallelJoins)
+        return;
+    start(queue.takeFirst());
+    if (!queue.isEmpty())
+        timer.start();
+}
+
+void GroupChatManagerPrivate::saveOpened()
+{
+    ChatLayer *layer = ChatLayer::instance();
+    if (!layer)
+        return;
+    QStringList ids;
+    foreach (ChatSession *session, layer->sessions()) {
+        Conference *conference = qobject_cast<Conference *>(session->unit());
+        if (conference && conference->account() == account)
+            ids << conference->id();
+    }
+    opened = ids.toSet();
+    account->config().setValue(QLatin1String("openedConferences"), ids);
+}
+
 GroupChatManager::GroupChatManager(Account *account) :
     d(new GroupChatManagerPrivate)
 {
     d->account = account;
+    d->q = this;
+    d->opened = account->config().value(QLatin1String("openedConferences"), QStringList()).toSet();
+    d->timer.setSingleShot(true);
+    d->timer.setInterval(JoinInterval);
+    connect(&d->timer, &QTimer::timeout, this, [this] () {
+        d->next();
+    });
+    connect(account, &Account::statusChanged, this, [this] (const Status &current, const Status &previous) {
+        if (current.type() == Status::Offline && previous.type() != Status::Offline) {
+            clearJoinQueue();
+            d->saveOpened();
+        }
+    });
 }
 
 GroupChatManager::~GroupChatManager()
@@ -55,5 +126,29 @@ QList<GroupChatManager*> GroupChatManager::allManagers()
 	return result;
 }
 
+void GroupChatManager::scheduleJoin(const QString &id, const JoinHandler &handler)
+{
+	GroupChatManagerPrivate::PendingJoin pending = { id, handler };
+	if (d->opened.contains(id)) {
+		d->start(pending);
+		return;
+	}
+	d->queue << pending;
+	if (!d->timer.isActive())
+		d->timer.start();
+}
+
+void GroupChatManager::clearJoinQueue()
+{
+	d->queue.clear();
+	d->joining.clear();
+	d->timer.stop();
+}
+
+bool GroupChatManager::hadOpenSession(const QString &id) const
+{
+	return d->opened.contains(id);
+}
+
 }
 
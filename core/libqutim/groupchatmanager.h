@@ -26,6 +26,7 @@
 #define GROUPCHATMANAGER_H
 
 #include "libqutim_global.h"
+#include <functional>
 
 namespace qutim_sdk_0_3
 {
@@ -33,6 +34,7 @@ namespace qutim_sdk_0_3
 class DataItem;
 class Protocol;
 class Account;
+class Conference;
 class GroupChatManagerPrivate;
 
 class LIBQUTIM_EXPORT GroupChatManager : public QObject
@@ -40,6 +42,11 @@ class LIBQUTIM_EXPORT GroupChatManager : public QObject
 	Q_OBJECT
 	Q_CLASSINFO("Feature", "GroupChatManager")
 public:
+	/**
+		Starts joining of a conference and returns it, or 0 if joining
+		could not be started.
+	*/
+	typedef std::function<Conference *()> JoinHandler;
 	/**
 		Constructs a new GroupChatManager with the given \a account.
 	*/
@@ -86,6 +93,27 @@ public:
 		\see Account::getGroupChatManager()
 	*/
 	static QList<GroupChatManager*> allManagers();
+	/**
+		Queues joining of the conference with the given \a id, \a handler
+		is called when it's the conference's turn.
+
+		Conferences which had an open chat session when the account went offline
+		last time are joined at once, the rest are joined a few at a time
+		so the server and the chat layer are not flooded after connect.
+
+		\see hadOpenSession()
+	*/
+	void scheduleJoin(const QString &id, const JoinHandler &handler);
+	/**
+		Drops all conferences which are not joined yet from the queue.
+	*/
+	void clearJoinQueue();
+	/**
+		Returns true if conference with the given \a id had an open chat session
+		when the account went offline last time. Protocols should not create
+		sessions for autojoined conferences which did not, until the user opens them.
+	*/
+	bool hadOpenSession(const QString &id) const;
 private:
 	QScopedPointer<GroupChatManagerPrivate> d;
 };
@@ -27,6 +27,9 @@
 
 #include "groupchatmanager.h"
 #include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
 
 namespace qutim_sdk_0_3
 {
@@ -34,7 +37,24 @@ namespace qutim_sdk_0_3
 class GroupChatManagerPrivate
 {
 public:
+    struct PendingJoin
+    {
+        QString id;
+        GroupChatManager::JoinHandler handler;
+    };
+
     Account *account;
+    GroupChatManager *q;
+    QList<PendingJoin> queue;
+    // Conferences which are being joined right now
+    QSet<QObject *> joining;
+    QSet<QString> opened;
+    QTimer timer;
+
+    void start(const PendingJoin &pending);
+    void release(QObject *conference);
+    void next();
+    void saveOpened();
 };
 
 }
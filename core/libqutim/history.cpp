@@ -30,8 +30,15 @@
 #include "account.h"
 #include "protocol.h"
 #include "servicemanager.h"
+#include "executor.h"
+#include "debug.h"
 #include <QEventLoop>
 #include <QTimer>
+#include <QMutex>
+#include <QHash>
+#include <QRegularExpression>
+#include <algorithm>
+#include <iterator>
 #include <tuple>
 
 namespace qutim_sdk_0_3
@@ -73,6 +80,79 @@ namespace qutim_sdk_0_3
         }
     };
 
+    class GenericHistoryStream : public History::Stream
+    {
+    public:
+        GenericHistoryStream(History *history, const History::ContactInfo &contact,
+                             const QDateTime &from, const QDateTime &to)
+            : m_history(history), m_state(new State)
+        {
+            m_state->contact = contact;
+            m_state->from = from;
+            m_state->to = to;
+            m_state->skip = 0;
+            m_state->done = false;
+        }
+
+        AsyncResult<MessageList> fetch(int count) override
+        {
+            QMutexLocker locker(&m_state->lock);
+            if (m_state->done || !m_history)
+                return AsyncResult<MessageList>::create(MessageList());
+
+            // Backends compare time strictly, so to don't lose messages with
+            // the same timestamp as the oldest fetched one we ask for them
+            // again and throw away already returned ones
+            const QDateTime to = m_state->skip > 0 ? m_state->to.addMSecs(1) : m_state->to;
+            AsyncResultHandler<MessageList> handler;
+            std::shared_ptr<State> state = m_state;
+            m_history->read(state->contact, state->from, to, count + state->skip)
+                    .connect([state, handler, count] (const MessageList &messages) {
+                MessageList result = messages;
+                {
+                    QMutexLocker locker(&state->lock);
+                    int skip = state->skip;
+                    while (skip > 0 && !result.isEmpty() && result.last().time() == state->to) {
+                        result.removeLast();
+                        --skip;
+                    }
+                    while (result.size() > count)
+                        result.removeFirst();
+
+                    if (result.isEmpty()) {
+                        state->done = true;
+                    } else {
+                        const QDateTime oldest = result.first().time();
+                        int same = 0;
+                        for (const Message &message : result) {
+                            if (message.time() != oldest)
+                                break;
+                            ++same;
+                        }
+                        state->skip = (oldest == state->to ? state->skip : 0) + same;
+                        state->to = oldest;
+                    }
+                }
+                handler.handle(result);
+            });
+            return handler.result();
+        }
+
+    private:
+        struct State
+        {
+            QMutex lock;
+            History::ContactInfo contact;
+            QDateTime from;
+            QDateTime to;
+            int skip;
+            bool done;
+        };
+
+        QPointer<History> m_history;
+        std::shared_ptr<State> m_state;
+    };
+
     struct Private
     {
         ServicePointer<History> service;
@@ -81,6 +161,15 @@ namespace qutim_sdk_0_3
 
     Q_GLOBAL_STATIC(Private, self)
 
+    // Executors are kept aside, so History keeps its size for binary plugins
+    struct Executors
+    {
+        QMutex lock;
+        QHash<const History *, Executor *> hash;
+    };
+
+    Q_GLOBAL_STATIC(Executors, executors)
+
     bool History::AccountInfo::operator ==(const History::AccountInfo &other) const
     {
         return protocol == other.protocol &&
@@ -113,6 +202,11 @@ namespace qutim_sdk_0_3
 
     History::~History()
     {
+        // Null history may outlive the storage at exit
+        if (Executors *e = executors()) {
+            QMutexLocker locker(&e->lock);
+            e->hash.remove(this);
+        }
     }
 
     History *History::instance()
@@ -121,6 +215,86 @@ namespace qutim_sdk_0_3
         return p->service ? p->service.data() : &p->null;
     }
 
+    void History::storeBatch(const ContactInfo &contact, const MessageList &messages)
+    {
+        StoreBatchArgument argument = { contact, messages, false };
+        virtual_hook(StoreBatchHook, &argument);
+        if (argument.handled)
+            return;
+
+        int skipped = 0;
+        for (const Message &message : messages) {
+            if (message.chatUnit())
+                store(message);
+            else
+                ++skipped;
+        }
+        if (skipped > 0)
+            qWarning() << "History backend can't store" << skipped << "messages without chat unit for" << contact.contact;
+    }
+
+    static bool isSameMessage(const Message &a, const Message &b)
+    {
+        return a.time() == b.time()
+                && a.isIncoming() == b.isIncoming()
+                && a.text() == b.text();
+    }
+
+    MessageList History::merge(const MessageList &history, MessageList messages)
+    {
+        auto timeLess = [] (const Message &a, const Message &b) {
+            return a.time() < b.time();
+        };
+        std::stable_sort(messages.begin(), messages.end(), timeLess);
+
+        MessageList merged;
+        merged.reserve(history.size() + messages.size());
+        std::merge(history.begin(), history.end(), messages.begin(), messages.end(),
+                   std::back_inserter(merged), timeLess);
+
+        // Duplicates always have the same time, so only runs of equal
+        // timestamps are compared
+        MessageList result;
+        result.reserve(merged.size());
+        int runStart = 0;
+        for (const Message &message : merged) {
+            if (runStart < result.size() && result.at(runStart).time() != message.time())
+                runStart = result.size();
+            bool duplicate = false;
+            for (int i = runStart; i < result.size() && !duplicate; ++i)
+                duplicate = isSameMessage(result.at(i), message);
+            if (!duplicate)
+                result << message;
+        }
+        return result;
+    }
+
+    QString History::literal(const QRegularExpression &regex)
+    {
+        QString pattern = regex.pattern();
+        if (pattern.startsWith(QLatin1Char('(')) && pattern.endsWith(QLatin1Char(')'))
+                && !pattern.endsWith(QStringLiteral("\\)"))) {
+            pattern = pattern.mid(1, pattern.size() - 2);
+        }
+
+        static const QString special = QStringLiteral(".*+?[](){}|^$");
+        QString result;
+        for (int i = 0; i < pattern.size(); ++i) {
+            QChar c = pattern.at(i);
+            if (c == QLatin1Char('\\')) {
+                if (++i >= pattern.size())
+                    return QString();
+                c = pattern.at(i);
+                if (c.isLetterOrNumber())
+                    return QString();
+            } else if (special.contains(c)) {
+                return QString();
+            }
+            result += c;
+        }
+        return result;
+    }
+
     AsyncResult<MessageList> History::read(const ChatUnit *unit, const QDateTime &to, int max_num)
     {
         return read(info(unit), QDateTime(), to, max_num);
@@ -150,6 +324,51 @@ namespace qutim_sdk_0_3
         return result;
     }
 
+    void History::showHistory(const ChatUnit *unit)
+    {
+        if (QObject *window = ServiceManager::getByName("HistoryWindow"))
+            QMetaObject::invokeMethod(window, "showHistory", Q_ARG(const qutim_sdk_0_3::ChatUnit*, unit));
+    }
+
+    History::Stream::~Stream()
+    {
+    }
+
+    History::StreamPtr History::readStream(const ContactInfo &contact, const QDateTime &from, const QDateTime &to)
+    {
+        ReadStreamArgument argument = { contact, from, to, StreamPtr() };
+        virtual_hook(ReadStreamHook, &argument);
+        if (argument.stream)
+            return argument.stream;
+        return StreamPtr(new GenericHistoryStream(this, contact, from, to));
+    }
+
+    History::StreamPtr History::readStream(const ChatUnit *unit)
+    {
+        return readStream(info(unit), QDateTime(), QDateTime::currentDateTime());
+    }
+
+    Executor *History::executor() const
+    {
+        Executors *e = executors();
+        {
+            QMutexLocker locker(&e->lock);
+            if (Executor *executor = e->hash.value(this))
+                return executor;
+        }
+        return Executor::named(QStringLiteral("history"), 2);
+    }
+
+    void History::setExecutor(Executor *executor)
+    {
+        Executors *e = executors();
+        QMutexLocker locker(&e->lock);
+        if (executor)
+            e->hash.insert(this, executor);
+        else
+            e->hash.remove(this);
+    }
+
     History::ContactInfo History::info(const ChatUnit *unit)
     {
         unit = unit->getHistoryUnit();
@@ -29,10 +29,12 @@
 #include "message.h"
 #include "asyncresult.h"
 #include <QDateTime>
+#include <QSharedPointer>
 
 namespace qutim_sdk_0_3
 {
 	class ChatUnit;
+	class Executor;
 
 	class LIBQUTIM_EXPORT History : public QObject
 	{
@@ -60,6 +62,25 @@ namespace qutim_sdk_0_3
             bool operator <(const ContactInfo &other) const;
         };
 
+        /**
+         * Lazy reader of history, which walks from newest messages to oldest.
+         * Every fetch continues where previous one stopped, so chat views
+         * may load older messages chunk by chunk while user scrolls up.
+         */
+        class LIBQUTIM_EXPORT Stream
+        {
+        public:
+            virtual ~Stream();
+
+            /**
+             * Read up to count messages older than already fetched ones.
+             * Messages are returned in chronological order, empty list
+             * means that there is nothing more to read.
+             */
+            virtual AsyncResult<MessageList> fetch(int count) = 0;
+        };
+        typedef QSharedPointer<Stream> StreamPtr;
+
         virtual void store(const Message &message) = 0;
         virtual AsyncResult<MessageList> read(const ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num) = 0;
         virtual AsyncResult<QVector<AccountInfo>> accounts() = 0;
@@ -67,17 +88,84 @@ namespace qutim_sdk_0_3
         virtual AsyncResult<QList<QDate>> months(const ContactInfo &contact, const QRegularExpression &regex) = 0;
         virtual AsyncResult<QList<QDate>> dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex) = 0;
 
+        /**
+         * Store many messages of one contact at once, used by importers and
+         * batched ChatSession::append().
+         * Messages must be sorted by time. Backends implement it by
+         * StoreBatchHook, merge messages with already stored history, skipping
+         * duplicates, and write every touched month once. Otherwise store() is
+         * called for messages, which have chat unit set.
+         */
+        void storeBatch(const ContactInfo &contact, const MessageList &messages);
+        /**
+         * Create stream of messages with time in [from, to) range.
+         * Backends are expected to implement it by ReadStreamHook and keep
+         * read position between fetches, otherwise stream is built on top
+         * of read().
+         */
+        StreamPtr readStream(const ContactInfo &contact, const QDateTime &from, const QDateTime &to);
+
         AsyncResult<MessageList> read(const ChatUnit *unit, const QDateTime &to, int max_num);
         AsyncResult<MessageList> read(const ChatUnit *unit, int max_num);
 
-        MessageList readSync(const ChatUnit *unit, int max_num);
+        /**
+         * Blocks in nested event loop until read() finishes.
+         * \deprecated Use read(), chat views load history asynchronously
+         */
+        Q_DECL_DEPRECATED MessageList readSync(const ChatUnit *unit, int max_num);
+        StreamPtr readStream(const ChatUnit *unit);
 
         static ContactInfo info(const ChatUnit *unit);
 
+        /**
+         * Merge messages into history sorted by time. Messages may come in
+         * any order, the ones already present in history or repeated are
+         * skipped. Messages are the same if they have equal time, direction
+         * and text.
+         */
+        static MessageList merge(const MessageList &history, MessageList messages);
+        /**
+         * Text searched by regex, if it is an escaped literal optionally
+         * wrapped by one capturing group, as history search builds it.
+         * Null string is returned for any other pattern, so backends with
+         * text indexes know that the index can't be used.
+         */
+        static QString literal(const QRegularExpression &regex);
+
+        /**
+         * Executor used by backend for its jobs, "history" executor is used
+         * by default. Reads should be queued with InteractivePriority,
+         * searches with BackgroundPriority and imports with BulkPriority.
+         */
+        Executor *executor() const;
+        void setExecutor(Executor *executor);
+
 	public slots:
-        virtual void showHistory(const ChatUnit *unit) = 0;
+        /**
+         * Show history of unit. Default implementation opens window of
+         * "HistoryWindow" service, which works on top of any backend.
+         */
+        virtual void showHistory(const ChatUnit *unit);
 
     protected:
+        enum HistoryHook {
+            StoreBatchHook = 1,
+            ReadStreamHook
+        };
+        struct StoreBatchArgument
+        {
+            const ContactInfo &contact;
+            const MessageList &messages;
+            bool handled;
+        };
+        struct ReadStreamArgument
+        {
+            const ContactInfo &contact;
+            const QDateTime &from;
+            const QDateTime &to;
+            StreamPtr stream;
+        };
+
         History();
 
         virtual void virtual_hook(int id, void *data);
@@ -72,6 +72,21 @@ InfoRequestFactory::~InfoRequestFactory()
 {
 }
 
+QList<InfoRequest*> InfoRequestFactory::createDataFormRequests(const QList<QObject*> &objects)
+{
+	BulkDataFormRequestArgument argument = { objects, QList<InfoRequest*>(), false };
+	virtual_hook(BulkDataFormRequestHook, &argument);
+	if (argument.handled)
+		return argument.requests;
+
+	QList<InfoRequest*> requests;
+	foreach (QObject *object, objects) {
+		if (InfoRequest *request = createrDataFormRequest(object))
+			requests << request;
+	}
+	return requests;
+}
+
 InfoRequest *InfoRequestFactory::dataFormRequest(QObject *object)
 {
 	InfoRequestFactory *f = 0;
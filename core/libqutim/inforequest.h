@@ -56,10 +56,29 @@ public:
 	virtual ~InfoRequestFactory();
 	virtual SupportLevel supportLevel(QObject *object) = 0;
 	virtual InfoRequest *createrDataFormRequest(QObject *object) = 0;
+	/**
+	 * Creates not yet started requests for all @a objects of this factory.
+	 *
+	 * Protocols able to fetch several objects by one query reimplement it
+	 * by BulkDataFormRequestHook and send one batched query once all the
+	 * requests are started. Default implementation creates requests by
+	 * createrDataFormRequest() one by one.
+	 */
+	QList<InfoRequest*> createDataFormRequests(const QList<QObject*> &objects);
 	static InfoRequest *dataFormRequest(QObject *object);
 	static InfoRequestFactory *factory(QObject *object);
 
 protected:
+	enum InfoRequestFactoryHook {
+		BulkDataFormRequestHook = 1
+	};
+	struct BulkDataFormRequestArgument
+	{
+		const QList<QObject*> &objects;
+		QList<InfoRequest*> requests;
+		bool handled;
+	};
+
 	friend class InfoObserver;
 	InfoRequestFactory();
 	void setSupportLevel(QObject *object, SupportLevel level);
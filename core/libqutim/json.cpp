@@ -33,11 +33,210 @@
 #include "../3rdparty/k8json/k8json.h"
 //#include <k8json/k8json.h>
 #include <QMetaProperty>
+#include <QIODevice>
+#include <QStringList>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define QUTIM_JSON_SSE2
+#endif
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
 
 namespace qutim_sdk_0_3
 {
 	namespace Json
 	{
+		/*
+		  Structural scanner for the common case of records, which are plain
+		  objects or arrays of double-quoted strings without comments.
+		  Input is classified by 64-byte blocks into bitmasks, escaped quotes
+		  and string interiors are found with carries and prefix xor, so only
+		  brackets outside of strings are visited one by one. Everything
+		  unusual is left to k8json.
+		*/
+		namespace Scanner
+		{
+			enum { BlockSize = 64, MaxDepth = 64 };
+
+			struct Masks
+			{
+				quint64 quote;
+				quint64 backslash;
+				quint64 open;
+				quint64 close;
+				quint64 curly;
+				// Characters the fast path doesn't handle outside of strings:
+				// comments and other quotes
+				quint64 unusual;
+			};
+
+			static inline int trailingZeros(quint64 value)
+			{
+#if defined(__GNUC__)
+				return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+				unsigned long index;
+				_BitScanForward64(&index, value);
+				return int(index);
+#else
+				int result = 0;
+				while (!(value & 1)) {
+					value >>= 1;
+					++result;
+				}
+				return result;
+#endif
+			}
+
+			static inline quint64 prefixXor(quint64 value)
+			{
+				value ^= value << 1;
+				value ^= value << 2;
+				value ^= value << 4;
+				value ^= value << 8;
+				value ^= value << 16;
+				value ^= value << 32;
+				return value;
+			}
+
+#ifdef QUTIM_JSON_SSE2
+			static inline quint64 compare(const __m128i *chunks, char c)
+			{
+				const __m128i pattern = _mm_set1_epi8(c);
+				quint64 result = 0;
+				for (int i = 0; i < 4; ++i) {
+					const quint64 mask = quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], pattern)));
+					result |= mask << (i * 16);
+				}
+				return result;
+			}
+#endif
+
+			static inline void classify(const uchar *block, Masks &masks)
+			{
+#ifdef QUTIM_JSON_SSE2
+				__m128i chunks[4];
+				for (int i = 0; i < 4; ++i)
+					chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+				masks.quote = compare(chunks, '"');
+				masks.backslash = compare(chunks, '\\');
+				const quint64 openCurly = compare(chunks, '{');
+				const quint64 closeCurly = compare(chunks, '}');
+				masks.open = openCurly | compare(chunks, '[');
+				masks.close = closeCurly | compare(chunks, ']');
+				masks.curly = openCurly | closeCurly;
+				masks.unusual = compare(chunks, '/') | compare(chunks, '\'') | compare(chunks, '`');
+#else
+				memset(&masks, 0, sizeof(masks));
+				for (int i = 0; i < BlockSize; ++i) {
+					const quint64 bit = quint64(1) << i;
+					switch (block[i]) {
+					case '"': masks.quote |= bit; break;
+					case '\\': masks.backslash |= bit; break;
+					case '{': masks.open |= bit; masks.curly |= bit; break;
+					case '[': masks.open |= bit; break;
+					case '}': masks.close |= bit; masks.curly |= bit; break;
+					case ']': masks.close |= bit; break;
+					case '/': case '\'': case '`': masks.unusual |= bit; break;
+					default: break;
+					}
+				}
+#endif
+			}
+
+			// Returns mask of characters escaped by backslashes, carrying
+			// odd backslash sequences over block boundary
+			static inline quint64 escaped(quint64 backslash, quint64 &carry)
+			{
+				if (!backslash) {
+					const quint64 result = carry;
+					carry = 0;
+					return result;
+				}
+				const quint64 evenBits = Q_UINT64_C(0x5555555555555555);
+				backslash &= ~carry;
+				const quint64 followsEscape = (backslash << 1) | carry;
+				const quint64 oddStarts = backslash & ~evenBits & ~followsEscape;
+				const quint64 sequences = oddStarts + backslash;
+				carry = sequences < oddStarts ? 1 : 0;
+				const quint64 invertMask = sequences << 1;
+				return (evenBits ^ invertMask) & followsEscape;
+			}
+
+			// Returns length of the record starting at s, or -1 if it's
+			// not a simple one
+			static int skip(const uchar *s, int length)
+			{
+				if (length <= 0 || (*s != '{' && *s != '['))
+					return -1;
+				quint64 escapeCarry = 0;
+				quint64 inStringCarry = 0;
+				// Bit per nesting level, set for objects
+				quint64 stack = 0;
+				int depth = 0;
+				uchar tail[BlockSize];
+				for (int offset = 0; offset < length; offset += BlockSize) {
+					const int size = qMin(int(BlockSize), length - offset);
+					const uchar *block = s + offset;
+					if (size < BlockSize) {
+						memset(tail, ' ', sizeof(tail));
+						memcpy(tail, block, size);
+						block = tail;
+					}
+					Masks masks;
+					classify(block, masks);
+					const quint64 quotes = masks.quote & ~escaped(masks.backslash, escapeCarry);
+					const quint64 inString = prefixXor(quotes) ^ inStringCarry;
+					inStringCarry = quint64(qint64(inString) >> 63);
+					// Only matters before the end of record
+					const quint64 unusual = (masks.unusual | masks.backslash) & ~inString;
+					quint64 structural = (masks.open | masks.close) & ~inString;
+					while (structural) {
+						const int index = trailingZeros(structural);
+						const quint64 bit = quint64(1) << index;
+						structural &= structural - 1;
+						const bool curly = masks.curly & bit;
+						if (masks.open & bit) {
+							if (depth == MaxDepth)
+								return -1;
+							stack = (stack << 1) | (curly ? 1 : 0);
+							++depth;
+						} else {
+							if (depth == 0 || bool(stack & 1) != curly)
+								return -1;
+							stack >>= 1;
+							if (--depth == 0)
+								return (unusual & (bit - 1)) ? -1 : offset + index + 1;
+						}
+					}
+					if (unusual)
+						return -1;
+				}
+				return -1;
+			}
+
+			static inline bool isAscii(const uchar *s, int length, bool zeroInvalid, int *checked)
+			{
+				int i = 0;
+#ifdef QUTIM_JSON_SSE2
+				const __m128i zero = _mm_setzero_si128();
+				for (; i + 16 <= length; i += 16) {
+					const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+					int mask = _mm_movemask_epi8(chunk);
+					if (zeroInvalid)
+						mask |= _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+					if (mask)
+						break;
+				}
+#endif
+				*checked = i;
+				return i == length;
+			}
+		}
+
 		QString quote(const QString &str)
 		{
 			return K8JSON::quote(str);
@@ -45,7 +244,11 @@ namespace qutim_sdk_0_3
 
 		bool isValidUtf8(const uchar *s, int maxLen, bool zeroInvalid)
 		{
-			return K8JSON::isValidUtf8(s, maxLen, zeroInvalid);
+			// Most of data is ASCII, so only the rest is checked char by char
+			int checked = 0;
+			if (s && maxLen > 0 && Scanner::isAscii(s, maxLen, zeroInvalid, &checked))
+				return true;
+			return K8JSON::isValidUtf8(s + checked, maxLen - checked, zeroInvalid);
 		}
 
 		bool isValidUtf8(const char *s, int maxLen, bool zeroInvalid)
@@ -55,9 +258,9 @@ namespace qutim_sdk_0_3
 
 		bool isValidUtf8(const QByteArray &data, bool zeroInvalid)
 		{
-			return K8JSON::isValidUtf8(reinterpret_cast<const uchar *>(data.data()),
-									   data.size(),
-									   zeroInvalid);
+			return isValidUtf8(reinterpret_cast<const uchar *>(data.constData()),
+							   data.size(),
+							   zeroInvalid);
 		}
 
 		const uchar *skipBlanks(const uchar *s, int *maxLength)
@@ -72,7 +275,19 @@ namespace qutim_sdk_0_3
 
 		const uchar *skipRecord(const uchar *s, int *maxLength)
 		{
-			return K8JSON::skipRec(s, maxLength);
+			if (!s || !maxLength)
+				return K8JSON::skipRec(s, maxLength);
+			int length = *maxLength;
+			const uchar *begin = s;
+			while (length > 0 && (*begin == ' ' || *begin == '\n' || *begin == '\r' || *begin == '\t')) {
+				++begin;
+				--length;
+			}
+			const int size = Scanner::skip(begin, length);
+			if (size < 0)
+				return K8JSON::skipRec(s, maxLength);
+			*maxLength = length - size;
+			return begin + size;
 		}
 
 		const char *skipRecord(const char *s, int *maxLength)
@@ -177,6 +392,327 @@ namespace qutim_sdk_0_3
 				}
 			}
 		}
+
+		static inline char hexDigit(int value)
+		{
+			return "0123456789abcdef"[value & 0xF];
+		}
+
+		static inline char *escapeChar(char *out, uint c)
+		{
+			*out++ = '\\';
+			switch (c) {
+			case '"': *out++ = '"'; break;
+			case '\\': *out++ = '\\'; break;
+			case '\b': *out++ = 'b'; break;
+			case '\f': *out++ = 'f'; break;
+			case '\n': *out++ = 'n'; break;
+			case '\r': *out++ = 'r'; break;
+			case '\t': *out++ = 't'; break;
+			default:
+				*out++ = 'u';
+				*out++ = hexDigit(c >> 12);
+				*out++ = hexDigit(c >> 8);
+				*out++ = hexDigit(c >> 4);
+				*out++ = hexDigit(c);
+				break;
+			}
+			return out;
+		}
+
+		Writer::Writer(QByteArray *output)
+			: m_device(0), m_output(output), m_start(output->size()), m_used(output->size()),
+			  m_written(0), m_bufferSize(0), m_error(false)
+		{
+		}
+
+		Writer::Writer(QIODevice *device, int bufferSize)
+			: m_device(device), m_output(&m_buffer), m_start(0), m_used(0), m_written(0),
+			  m_bufferSize(qMax(bufferSize, 256)), m_error(false)
+		{
+			m_buffer.resize(m_bufferSize);
+		}
+
+		Writer::~Writer()
+		{
+			flush();
+		}
+
+		char *Writer::reserve(int size)
+		{
+			// Keep chunks written to device close to the buffer size
+			if (m_device && m_used > 0 && m_used + size > m_bufferSize)
+				flush();
+			if (m_output->size() - m_used < size)
+				m_output->resize(qMax(m_output->size() * 2, m_used + size));
+			return m_output->data() + m_used;
+		}
+
+		Writer &Writer::append(const char *data, int size)
+		{
+			memcpy(reserve(size), data, size);
+			m_used += size;
+			return *this;
+		}
+
+		Writer &Writer::append(const char *data)
+		{
+			return append(data, int(strlen(data)));
+		}
+
+		Writer &Writer::append(const QByteArray &data)
+		{
+			return append(data.constData(), data.size());
+		}
+
+		Writer &Writer::append(char c)
+		{
+			*reserve(1) = c;
+			++m_used;
+			return *this;
+		}
+
+		Writer &Writer::quote(const QString &str)
+		{
+			const ushort *s = str.utf16();
+			const int size = str.size();
+			// Every UTF-16 unit takes at most 6 bytes as \uXXXX
+			char *begin = reserve(size * 6 + 2);
+			char *out = begin;
+			*out++ = '"';
+			int i = 0;
+			forever {
+#ifdef QUTIM_JSON_SSE2
+				// Copy printable ASCII by 8 units, most of messages are such
+				const __m128i space = _mm_set1_epi16(0x20);
+				const __m128i ascii = _mm_set1_epi16(0x7F);
+				const __m128i quoteChar = _mm_set1_epi16('"');
+				const __m128i backslash = _mm_set1_epi16('\\');
+				for (; i + 8 <= size; i += 8) {
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+					// Units above 0x7FFF are negative, so they are less than space
+					const __m128i special = _mm_or_si128(
+								_mm_or_si128(_mm_cmplt_epi16(v, space), _mm_cmpgt_epi16(v, ascii)),
+								_mm_or_si128(_mm_cmpeq_epi16(v, quoteChar), _mm_cmpeq_epi16(v, backslash)));
+					if (_mm_movemask_epi8(special))
+						break;
+					_mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(v, v));
+					out += 8;
+				}
+#endif
+				if (i >= size)
+					break;
+				uint c = s[i++];
+				if (c == '"' || c == '\\' || c < 0x20) {
+					out = escapeChar(out, c);
+				} else if (c < 0x80) {
+					*out++ = char(c);
+				} else if (c < 0x800) {
+					*out++ = char(0xC0 | (c >> 6));
+					*out++ = char(0x80 | (c & 0x3F));
+				} else if (c >= 0xD800 && c < 0xE000) {
+					if (c < 0xDC00 && i < size && s[i] >= 0xDC00 && s[i] < 0xE000) {
+						c = 0x10000 + ((c - 0xD800) << 10) + (s[i++] - 0xDC00);
+						*out++ = char(0xF0 | (c >> 18));
+						*out++ = char(0x80 | ((c >> 12) & 0x3F));
+						*out++ = char(0x80 | ((c >> 6) & 0x3F));
+						*out++ = char(0x80 | (c & 0x3F));
+					} else {
+						// Lone surrogate has no UTF-8 representation
+						out = escapeChar(out, c);
+					}
+				} else {
+					*out++ = char(0xE0 | (c >> 12));
+					*out++ = char(0x80 | ((c >> 6) & 0x3F));
+					*out++ = char(0x80 | (c & 0x3F));
+				}
+			}
+			*out++ = '"';
+			m_used += out - begin;
+			return *this;
+		}
+
+		Writer &Writer::quote(const QByteArray &utf8)
+		{
+			const uchar *s = reinterpret_cast<const uchar *>(utf8.constData());
+			const int size = utf8.size();
+			char *begin = reserve(size * 6 + 2);
+			char *out = begin;
+			*out++ = '"';
+			int i = 0;
+			forever {
+				int clean = i;
+#ifdef QUTIM_JSON_SSE2
+				const __m128i control = _mm_set1_epi8(0x1F);
+				const __m128i quoteChar = _mm_set1_epi8('"');
+				const __m128i backslash = _mm_set1_epi8('\\');
+				for (; clean + 16 <= size; clean += 16) {
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + clean));
+					const __m128i special = _mm_or_si128(
+								_mm_cmpeq_epi8(_mm_max_epu8(v, control), control),
+								_mm_or_si128(_mm_cmpeq_epi8(v, quoteChar), _mm_cmpeq_epi8(v, backslash)));
+					if (_mm_movemask_epi8(special))
+						break;
+				}
+#endif
+				while (clean < size && s[clean] >= 0x20 && s[clean] != '"' && s[clean] != '\\')
+					++clean;
+				memcpy(out, s + i, clean - i);
+				out += clean - i;
+				i = clean;
+				if (i >= size)
+					break;
+				out = escapeChar(out, s[i++]);
+			}
+			*out++ = '"';
+			m_used += out - begin;
+			return *this;
+		}
+
+		template <typename T>
+		static inline void appendNumber(Writer &out, const char *format, T value)
+		{
+			char buffer[32];
+			const int size = qsnprintf(buffer, sizeof(buffer), format, value);
+			out.append(buffer, size);
+		}
+
+		static inline void appendIndent(Writer &out, int indent)
+		{
+			for (int c = indent; c > 0; c--)
+				out.append(' ');
+		}
+
+		bool Writer::generate(const QVariant &val, int indent, generatorExt cb)
+		{
+			switch (val.type()) {
+			case QVariant::Invalid:
+				append("null", 4);
+				break;
+			case QVariant::Bool:
+				append(val.toBool() ? "true" : "false");
+				break;
+			case QVariant::Char:
+				quote(QString(val.toChar()));
+				break;
+			case QVariant::Int:
+				appendNumber(*this, "%d", val.toInt());
+				break;
+			case QVariant::UInt:
+				appendNumber(*this, "%u", val.toUInt());
+				break;
+			case QVariant::LongLong:
+				appendNumber(*this, "%lld", val.toLongLong());
+				break;
+			case QVariant::ULongLong:
+				appendNumber(*this, "%llu", val.toULongLong());
+				break;
+			case QVariant::String:
+				quote(*reinterpret_cast<const QString *>(val.constData()));
+				break;
+			case QVariant::Map: {
+				append('{');
+				indent++;
+				bool comma = false;
+				const QVariantMap &map = *reinterpret_cast<const QVariantMap *>(val.constData());
+				for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+					append(comma ? ",\n" : "\n");
+					comma = true;
+					appendIndent(*this, indent);
+					quote(it.key());
+					append(": ", 2);
+					if (!generate(it.value(), indent, cb))
+						return false;
+				}
+				indent--;
+				if (comma) {
+					append('\n');
+					appendIndent(*this, indent);
+				}
+				append('}');
+				break;
+			}
+			case QVariant::List: {
+				append('[');
+				indent++;
+				bool comma = false;
+				const QVariantList &list = *reinterpret_cast<const QVariantList *>(val.constData());
+				foreach (const QVariant &value, list) {
+					append(comma ? ",\n" : "\n");
+					comma = true;
+					appendIndent(*this, indent);
+					if (!generate(value, indent, cb))
+						return false;
+				}
+				indent--;
+				if (comma) {
+					append('\n');
+					appendIndent(*this, indent);
+				}
+				append(']');
+				break;
+			}
+			case QVariant::StringList: {
+				append('[');
+				indent++;
+				bool comma = false;
+				const QStringList &list = *reinterpret_cast<const QStringList *>(val.constData());
+				foreach (const QString &value, list) {
+					append(comma ? ",\n" : "\n");
+					comma = true;
+					appendIndent(*this, indent);
+					quote(value);
+				}
+				indent--;
+				if (comma) {
+					append('\n');
+					appendIndent(*this, indent);
+				}
+				append(']');
+				break;
+			}
+			default: {
+				// Doubles and custom types are left to k8json and extension
+				QByteArray data;
+				if (!Json::generate(data, val, indent, cb))
+					return false;
+				append(data);
+				break;
+			}
+			}
+			return true;
+		}
+
+		bool Writer::flush()
+		{
+			if (!m_device) {
+				m_output->resize(m_used);
+				return !m_error;
+			}
+			if (m_used > 0) {
+				if (m_device->write(m_buffer.constData(), m_used) != m_used)
+					m_error = true;
+				m_written += m_used;
+				m_used = 0;
+			}
+			return !m_error;
+		}
+
+		bool Writer::hasError() const
+		{
+			return m_error;
+		}
+
+		qint64 Writer::size() const
+		{
+			return m_written + m_used - m_start;
+		}
+
+		void Writer::truncate(qint64 size)
+		{
+			const qint64 used = m_start + size - m_written;
+			if (used >= m_start && used < m_used)
+				m_used = int(used);
+		}
 	}
 }
-
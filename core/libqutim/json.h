@@ -32,6 +32,7 @@
 #include <QVariant>
 #include <QByteArray>
 class QObject;
+class QIODevice;
 
 namespace qutim_sdk_0_3
 {
@@ -164,6 +165,83 @@ namespace qutim_sdk_0_3
 									  generatorExt cb = 0, QString *err = 0);
 
 		LIBQUTIM_EXPORT bool generate(QByteArray &res, const QVariant &val, int indent, QString *err);
+
+		/**
+		* @brief Streaming JSON generator
+		*
+		* Writer either appends generated data to the given QByteArray or
+		* collects it in own buffer, which is written to QIODevice once it
+		* becomes big enough and at flush(). Strings are quoted directly from
+		* their UTF-16 data or UTF-8 bytes without intermediate copies.
+		*
+		* Output of generate() is the same as of Json::generate().
+		*/
+		class LIBQUTIM_EXPORT Writer
+		{
+			Q_DISABLE_COPY(Writer)
+		public:
+			/**
+			* @brief Construct writer which appends data to @a output
+			*/
+			explicit Writer(QByteArray *output);
+			/**
+			* @brief Construct writer which writes data to @a device
+			* by chunks of about @a bufferSize bytes
+			*/
+			explicit Writer(QIODevice *device, int bufferSize = 16 * 1024);
+			/**
+			* @brief Destructor, flushes all remaining data
+			*/
+			~Writer();
+
+			/**
+			* @brief Append raw bytes
+			*/
+			Writer &append(const char *data, int size);
+			Writer &append(const char *data);
+			Writer &append(const QByteArray &data);
+			Writer &append(char c);
+			/**
+			* @brief Append quoted and escaped string just like Json::quote() does
+			*/
+			Writer &quote(const QString &str);
+			/**
+			* @brief Append quoted and escaped string given by UTF-8 data
+			*/
+			Writer &quote(const QByteArray &utf8);
+			/**
+			* @brief Append JSON representation of @a val
+			* @return @b False if value can not be represented
+			*/
+			bool generate(const QVariant &val, int indent = 0, generatorExt cb = 0);
+			/**
+			* @brief Write all buffered data to device or shrink output
+			* to the data size
+			* @return @b False if device failed to write some data
+			*/
+			bool flush();
+			bool hasError() const;
+			/**
+			* @brief Number of bytes generated by this writer
+			*/
+			qint64 size() const;
+			/**
+			* @brief Drop data generated after first @a size bytes,
+			* data already written to device is kept
+			*/
+			void truncate(qint64 size);
+
+		private:
+			char *reserve(int size);
+			QIODevice *m_device;
+			QByteArray *m_output;
+			QByteArray m_buffer;
+			int m_start;
+			int m_used;
+			qint64 m_written;
+			int m_bufferSize;
+			bool m_error;
+		};
 	}
 }
 
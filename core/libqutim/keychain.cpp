@@ -1,17 +1,105 @@
 #include "keychain.h"
 #include "account.h"
+#include "accountmanager.h"
 #include "protocol.h"
+#include "config.h"
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
 #include <QStringBuilder>
+#include <QTimer>
 
 namespace qutim_sdk_0_3 {
 
-KeyChain::KeyChain()
+class KeyChainPrivate
 {
+public:
+	struct Entry
+	{
+		KeyChain::ReadResult result;
+		qint64 expires;
+	};
+
+	void store(const QString &key, const KeyChain::ReadResult &result);
+	void drop(const QString &key);
+	void expire();
+
+	// Cache is touched by results delivered to threads of their callers
+	QMutex mutex;
+	QHash<QString, Entry> cache;
+	QHash<QString, QList<AsyncResultHandler<KeyChain::ReadResult> > > waiting;
+	QElapsedTimer clock;
+	QTimer expireTimer;
+	int timeout;
+};
+
+// Overwrites secrets before they are freed, copies made by callers are
+// their own responsibility
+static void wipe(KeyChain::ReadResult &result)
+{
+	result.textData.fill(QChar(0));
+	result.binaryData.fill(0);
+}
+
+void KeyChainPrivate::store(const QString &key, const KeyChain::ReadResult &result)
+{
+	QMutexLocker locker(&mutex);
+	drop(key);
+	Entry entry = { result, clock.elapsed() + timeout };
+	cache.insert(key, entry);
+}
+
+void KeyChainPrivate::drop(const QString &key)
+{
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		wipe(it->result);
+		cache.erase(it);
+	}
+}
+
+void KeyChainPrivate::expire()
+{
+	QMutexLocker locker(&mutex);
+	const qint64 now = clock.elapsed();
+	for (auto it = cache.begin(); it != cache.end();) {
+		if (it->expires <= now) {
+			wipe(it->result);
+			it = cache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+KeyChain::KeyChain() : d_ptr(new KeyChainPrivate)
+{
+	Q_D(KeyChain);
+	d->clock.start();
+	d->timeout = Config().group(QStringLiteral("keychain")).value(QStringLiteral("cacheTimeout"), 15 * 60) * 1000;
+	d->expireTimer.setInterval(60 * 1000);
+	connect(&d->expireTimer, &QTimer::timeout, this, [d] () { d->expire(); });
+	d->expireTimer.start();
+
+	// Accounts are loaded before services are used, read all their secrets
+	// in one go instead of a round trip per login
+	QTimer::singleShot(0, this, [this] () {
+		AccountManager *manager = AccountManager::instance();
+		if (!manager)
+			return;
+		QList<Account *> accounts;
+		foreach (Account *account, manager->accounts()) {
+			if (account->userStatus() != Status::Offline)
+				accounts << account;
+		}
+		prefetch(accounts);
+	});
 }
 
 KeyChain::~KeyChain()
 {
+	clearCache();
 }
 
 static QString generateId(Account *account)
@@ -21,22 +109,99 @@ static QString generateId(Account *account)
 
 AsyncResult<KeyChain::ReadResult> KeyChain::read(Account *account)
 {
-	return doRead(generateId(account));
+	Q_D(KeyChain);
+	const QString key = generateId(account);
+	AsyncResultHandler<ReadResult> handler;
+	{
+		QMutexLocker locker(&d->mutex);
+		auto it = d->cache.find(key);
+		if (it != d->cache.end() && it->expires > d->clock.elapsed())
+			return makeAsyncResult(it->result);
+
+		QList<AsyncResultHandler<ReadResult> > &handlers = d->waiting[key];
+		handlers << handler;
+		if (handlers.size() > 1)
+			return handler.result();
+	}
+
+	doRead(key).connect(this, [d, key] (const ReadResult &result) {
+		if (result.error == NoError)
+			d->store(key, result);
+		QList<AsyncResultHandler<ReadResult> > handlers;
+		{
+			QMutexLocker locker(&d->mutex);
+			handlers = d->waiting.take(key);
+		}
+		foreach (const AsyncResultHandler<ReadResult> &handler, handlers)
+			handler.handle(result);
+	});
+	return handler.result();
+}
+
+void KeyChain::prefetch(const QList<Account *> &accounts)
+{
+	foreach (Account *account, accounts)
+		read(account);
+}
+
+void KeyChain::clearCache()
+{
+	Q_D(KeyChain);
+	QMutexLocker locker(&d->mutex);
+	for (auto it = d->cache.begin(); it != d->cache.end(); ++it)
+		wipe(it->result);
+	d->cache.clear();
 }
 
 AsyncResult<KeyChain::Result> KeyChain::write(Account *account, const QString &value)
 {
-	return doWrite(generateId(account), value);
+	Q_D(KeyChain);
+	const QString key = generateId(account);
+	AsyncResultHandler<Result> handler;
+	doWrite(key, value).connect(this, [d, key, value, handler] (const Result &result) {
+		if (result.error == NoError) {
+			ReadResult read;
+			read.error = NoError;
+			read.textData = value;
+			d->store(key, read);
+		} else {
+			QMutexLocker locker(&d->mutex);
+			d->drop(key);
+		}
+		handler.handle(result);
+	});
+	return handler.result();
 }
 
 AsyncResult<KeyChain::Result> KeyChain::write(Account *account, const QByteArray &value)
 {
-	return doWrite(generateId(account), value);
+	Q_D(KeyChain);
+	const QString key = generateId(account);
+	AsyncResultHandler<Result> handler;
+	doWrite(key, value).connect(this, [d, key, value, handler] (const Result &result) {
+		if (result.error == NoError) {
+			ReadResult read;
+			read.error = NoError;
+			read.binaryData = value;
+			d->store(key, read);
+		} else {
+			QMutexLocker locker(&d->mutex);
+			d->drop(key);
+		}
+		handler.handle(result);
+	});
+	return handler.result();
 }
 
 AsyncResult<KeyChain::Result> KeyChain::remove(Account *account)
 {
-	return doRemove(generateId(account));
+	Q_D(KeyChain);
+	const QString key = generateId(account);
+	{
+		QMutexLocker locker(&d->mutex);
+		d->drop(key);
+	}
+	return doRemove(key);
 }
 
 } // namespace qutim_sdk_0_3
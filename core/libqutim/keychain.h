@@ -2,15 +2,18 @@
 #define QUTIM_SDK_0_3_KEYCHAIN_H
 
 #include "asyncresult.h"
+#include <QScopedPointer>
 
 namespace qutim_sdk_0_3 {
 
 class Account;
+class KeyChainPrivate;
 
 class LIBQUTIM_EXPORT KeyChain : public QObject
 {
 	Q_OBJECT
 	Q_CLASSINFO("Service", "KeyChain")
+	Q_DECLARE_PRIVATE(KeyChain)
 public:
 	enum Error
 	{
@@ -34,7 +37,16 @@ public:
 		QByteArray binaryData;
 	};
 
+	/**
+	 * Successful reads are kept in memory for "keychain/cacheTimeout"
+	 * seconds, 15 minutes by default, so reconnections don't wait for the
+	 * secret store. Concurrent reads of one account share single request.
+	 */
 	AsyncResult<ReadResult> read(Account *account);
+	// Requests secrets of all given accounts at once, later reads hit the cache
+	void prefetch(const QList<Account *> &accounts);
+	// Wipes all cached secrets
+	void clearCache();
 	AsyncResult<Result> write(Account *account, const QString &value);
 	AsyncResult<Result> write(Account *account, const QByteArray &value);
 	AsyncResult<Result> remove(Account *account);
@@ -44,6 +56,9 @@ protected:
 	virtual AsyncResult<Result> doWrite(const QString &key, const QString &value) = 0;
 	virtual AsyncResult<Result> doWrite(const QString &key, const QByteArray &value) = 0;
 	virtual AsyncResult<Result> doRemove(const QString &key) = 0;
+
+private:
+	QScopedPointer<KeyChainPrivate> d_ptr;
 };
 
 } // namespace qutim_sdk_0_3
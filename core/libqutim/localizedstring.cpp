@@ -27,6 +27,8 @@
 #include <QtCore/QCoreApplication>
 #include <QSharedData>
 #include <QDataStream>
+#include <QThread>
+#include <QHash>
 
 namespace qutim_sdk_0_3
 {
@@ -51,11 +53,52 @@ namespace qutim_sdk_0_3
 		QList<QString> args;
 	};
 	
+	// Menus, roster and notifications resolve the same strings over and over,
+	// while every translation walks all installed translators
+	class TranslationCache : public QObject
+	{
+	public:
+		enum { MaxSize = 4096 };
+
+		TranslationCache()
+		{
+			// Installing and removing translators sends LanguageChange to the application
+			qApp->installEventFilter(this);
+		}
+
+		virtual bool eventFilter(QObject *obj, QEvent *event)
+		{
+			if (event->type() == QEvent::LanguageChange)
+				strings.clear();
+			return QObject::eventFilter(obj, event);
+		}
+
+		QHash<QPair<QByteArray, QByteArray>, QString> strings;
+	};
+
+	Q_GLOBAL_STATIC(TranslationCache, translationCache)
+
 	QString LocalizedString::toString() const
 	{
 		if (m_ctx.isEmpty())
 			return QString::fromUtf8(m_str);
-		return QCoreApplication::translate(m_ctx.constData(), m_str.constData());
+		// Cache is used from the gui thread only, so it needs no locking
+		QCoreApplication *app = QCoreApplication::instance();
+		TranslationCache *cache = 0;
+		if (app && app->thread() == QThread::currentThread())
+			cache = translationCache();
+		if (!cache)
+			return QCoreApplication::translate(m_ctx.constData(), m_str.constData());
+
+		const QPair<QByteArray, QByteArray> key(m_ctx, m_str);
+		QHash<QPair<QByteArray, QByteArray>, QString>::const_iterator it = cache->strings.constFind(key);
+		if (it != cache->strings.constEnd())
+			return it.value();
+		const QString result = QCoreApplication::translate(m_ctx.constData(), m_str.constData());
+		if (cache->strings.size() >= TranslationCache::MaxSize)
+			cache->strings.clear();
+		cache->strings.insert(key, result);
+		return result;
 	}
 
 	struct StaticConstructor
@@ -0,0 +1,266 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "memoryaccounting.h"
+#include "message.h"
+#include "metrics.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QMutex>
+#include <QPointer>
+#include <QTimer>
+#include <algorithm>
+
+namespace qutim_sdk_0_3
+{
+
+enum { EnforceInterval = 60 * 1000 };
+
+static const char * const subsystemIds[] = {
+	"accounts",
+	"chatsessions",
+	"contactlist",
+	"history",
+	"emoticons",
+	"avatars"
+};
+
+struct MemoryReporter
+{
+	MemoryAccounting::Subsystem subsystem;
+	// Null for process-wide caches
+	QObject *owner;
+	QString name;
+	MemoryAccounting::Usage usage;
+	MemoryAccounting::Trim trim;
+};
+
+class MemoryAccountingData : public QObject
+{
+public:
+	MemoryAccountingData() : budgetsLoaded(false)
+	{
+		for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i) {
+			const QString labels = Metrics::label("subsystem", QLatin1String(subsystemIds[i]));
+			gauges[i] = Metrics::gauge("qutim_memory_bytes", labels);
+			budgets[i] = 0;
+		}
+	}
+
+	void ensureTimer()
+	{
+		// Budgets are checked at the main thread, as most of owners live there
+		if (timer || !QCoreApplication::instance())
+			return;
+		timer = new QTimer;
+		timer->moveToThread(QCoreApplication::instance()->thread());
+		timer->setInterval(EnforceInterval);
+		QObject::connect(timer.data(), &QTimer::timeout, [] () {
+			MemoryAccounting::enforceBudgets();
+		});
+		QMetaObject::invokeMethod(timer.data(), "start", Qt::QueuedConnection);
+	}
+
+	void loadBudgets()
+	{
+		if (budgetsLoaded)
+			return;
+		budgetsLoaded = true;
+		Config config(QStringLiteral("memory"));
+		config.beginGroup(QStringLiteral("budgets"));
+		for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i)
+			budgets[i] = config.value(QLatin1String(subsystemIds[i]), qint64(0)) * 1024;
+	}
+
+	QMutex mutex;
+	QList<MemoryReporter> reporters;
+	qint64 budgets[MemoryAccounting::SubsystemCount];
+	Gauge *gauges[MemoryAccounting::SubsystemCount];
+	QPointer<QTimer> timer;
+	bool budgetsLoaded;
+};
+
+// Never deleted, reporters may be removed by owners destroyed at exit
+static MemoryAccountingData *data()
+{
+	static MemoryAccountingData *self = new MemoryAccountingData;
+	return self;
+}
+
+// Usage functions may lock owners' mutexes, so they are called without ours
+static QList<MemoryReporter> reporters()
+{
+	MemoryAccountingData *d = data();
+	QMutexLocker locker(&d->mutex);
+	return d->reporters;
+}
+
+void MemoryAccounting::add(Subsystem subsystem, QObject *owner, const QString &name,
+						   const Usage &usage, const Trim &trim)
+{
+	MemoryAccountingData *d = data();
+	MemoryReporter reporter = { subsystem, owner, name, usage, trim };
+	{
+		QMutexLocker locker(&d->mutex);
+		d->reporters << reporter;
+		d->ensureTimer();
+	}
+	if (owner) {
+		QObject::connect(owner, &QObject::destroyed, [owner] () {
+			MemoryAccounting::remove(owner);
+		});
+	}
+}
+
+void MemoryAccounting::remove(QObject *owner)
+{
+	MemoryAccountingData *d = data();
+	QMutexLocker locker(&d->mutex);
+	for (int i = d->reporters.size() - 1; i >= 0; --i) {
+		if (d->reporters.at(i).owner == owner)
+			d->reporters.removeAt(i);
+	}
+}
+
+static bool entryGreaterThan(const MemoryAccounting::Entry &a, const MemoryAccounting::Entry &b)
+{
+	return a.bytes > b.bytes;
+}
+
+QList<MemoryAccounting::Entry> MemoryAccounting::top(int count)
+{
+	QList<Entry> result;
+	foreach (const MemoryReporter &reporter, reporters()) {
+		Entry entry = { reporter.subsystem, reporter.name, reporter.usage() };
+		result << entry;
+	}
+	std::sort(result.begin(), result.end(), entryGreaterThan);
+	if (count >= 0 && result.size() > count)
+		result.erase(result.begin() + count, result.end());
+	return result;
+}
+
+qint64 MemoryAccounting::usage(Subsystem subsystem)
+{
+	qint64 result = 0;
+	foreach (const MemoryReporter &reporter, reporters()) {
+		if (reporter.subsystem == subsystem)
+			result += reporter.usage();
+	}
+	return result;
+}
+
+qint64 MemoryAccounting::budget(Subsystem subsystem)
+{
+	MemoryAccountingData *d = data();
+	QMutexLocker locker(&d->mutex);
+	d->loadBudgets();
+	return d->budgets[subsystem];
+}
+
+void MemoryAccounting::setBudget(Subsystem subsystem, qint64 bytes)
+{
+	MemoryAccountingData *d = data();
+	{
+		QMutexLocker locker(&d->mutex);
+		d->loadBudgets();
+		d->budgets[subsystem] = qMax<qint64>(0, bytes);
+	}
+	Config config(QStringLiteral("memory"));
+	config.beginGroup(QStringLiteral("budgets"));
+	config.setValue(subsystemId(subsystem), qMax<qint64>(0, bytes) / 1024);
+}
+
+void MemoryAccounting::enforceBudgets()
+{
+	struct Consumer
+	{
+		MemoryReporter reporter;
+		qint64 bytes;
+	};
+	QList<Consumer> usages[SubsystemCount];
+	qint64 totals[SubsystemCount] = { 0 };
+	foreach (const MemoryReporter &reporter, reporters()) {
+		Consumer usage = { reporter, reporter.usage() };
+		usages[reporter.subsystem] << usage;
+		totals[reporter.subsystem] += usage.bytes;
+	}
+
+	MemoryAccountingData *d = data();
+	for (int i = 0; i < SubsystemCount; ++i) {
+		const qint64 limit = budget(static_cast<Subsystem>(i));
+		qint64 excess = limit > 0 ? totals[i] - limit : 0;
+		if (excess > 0) {
+			std::sort(usages[i].begin(), usages[i].end(), [] (const Consumer &a, const Consumer &b) {
+				return a.bytes > b.bytes;
+			});
+			foreach (const Consumer &usage, usages[i]) {
+				if (excess <= 0)
+					break;
+				if (!usage.reporter.trim)
+					continue;
+				usage.reporter.trim(qMax<qint64>(0, usage.bytes - excess));
+				const qint64 bytes = usage.reporter.usage();
+				excess -= usage.bytes - bytes;
+				totals[i] -= usage.bytes - bytes;
+			}
+		}
+		d->gauges[i]->set(totals[i]);
+	}
+}
+
+QString MemoryAccounting::subsystemId(Subsystem subsystem)
+{
+	return QLatin1String(subsystemIds[subsystem]);
+}
+
+QString MemoryAccounting::subsystemTitle(Subsystem subsystem)
+{
+	static const char * const titles[] = {
+		QT_TRANSLATE_NOOP("MemoryAccounting", "Accounts"),
+		QT_TRANSLATE_NOOP("MemoryAccounting", "Chat sessions"),
+		QT_TRANSLATE_NOOP("MemoryAccounting", "Contact list"),
+		QT_TRANSLATE_NOOP("MemoryAccounting", "History caches"),
+		QT_TRANSLATE_NOOP("MemoryAccounting", "Emoticons"),
+		QT_TRANSLATE_NOOP("MemoryAccounting", "Avatars")
+	};
+	return QCoreApplication::translate("MemoryAccounting", titles[subsystem]);
+}
+
+qint64 MemoryAccounting::stringSize(const QString &string)
+{
+	// Header of shared data and utf-16 characters
+	return string.isEmpty() ? 0 : 24 + string.capacity() * 2;
+}
+
+qint64 MemoryAccounting::messageSize(const Message &message)
+{
+	qint64 result = 128 + stringSize(message.text()) + stringSize(message.html());
+	foreach (const QByteArray &name, message.dynamicPropertyNames())
+		result += 32 + name.size();
+	return result;
+}
+
+}
@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_MEMORYACCOUNTING_H
+#define QUTIM_SDK_0_3_MEMORYACCOUNTING_H
+
+#include "libqutim_global.h"
+#include <QList>
+#include <QString>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+
+class Message;
+
+/**
+ * Attribution of memory to the objects which hold it.
+ *
+ * Owners report approximate size of their data by usage functions, they are
+ * queried only when diagnostics are requested and once a minute, when budgets
+ * are checked. Subsystem, which exceeds its budget, is asked to trim its
+ * largest consumers first. Reporters are removed with their owners.
+ */
+class LIBQUTIM_EXPORT MemoryAccounting
+{
+public:
+	enum Subsystem
+	{
+		Accounts,
+		ChatSessions,
+		ContactList,
+		HistoryCaches,
+		EmoticonsCache,
+		AvatarsCache,
+		SubsystemCount
+	};
+
+	typedef std::function<qint64 ()> Usage;
+	// Argument is desired usage in bytes, owner should drop caches to fit it
+	typedef std::function<void (qint64)> Trim;
+
+	struct Entry
+	{
+		Subsystem subsystem;
+		QString name;
+		qint64 bytes;
+	};
+
+	static void add(Subsystem subsystem, QObject *owner, const QString &name,
+					const Usage &usage, const Trim &trim = Trim());
+	static void remove(QObject *owner);
+
+	// Largest consumers first, all of them if count is negative
+	static QList<Entry> top(int count = -1);
+	static qint64 usage(Subsystem subsystem);
+
+	// Bytes, zero means no limit. Budgets are stored in "memory" config
+	static qint64 budget(Subsystem subsystem);
+	static void setBudget(Subsystem subsystem, qint64 bytes);
+	// Trims all subsystems, which exceed their budgets
+	static void enforceBudgets();
+
+	// Stable identifier used in config, metrics and D-Bus
+	static QString subsystemId(Subsystem subsystem);
+	static QString subsystemTitle(Subsystem subsystem);
+
+	// Approximate heap size of common data
+	static qint64 stringSize(const QString &string);
+	static qint64 messageSize(const Message &message);
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_MEMORYACCOUNTING_H
@@ -41,6 +41,46 @@ Q_GLOBAL_STATIC(ActionMap, actionMap)
 Q_GLOBAL_STATIC(ActionControllerMap, actionControllerMap)
 Q_GLOBAL_STATIC(MenuActionMap, globalActions)
 Q_GLOBAL_STATIC(QSet<QByteArray>, menuNameSet)
+Q_GLOBAL_STATIC(QList<MenuController*>, activatedControllers)
+
+// Actions of shared generators are kept alive even when no menu uses them
+typedef QHash<const ActionGenerator*, ActionValue::Ptr> SharedActionMap;
+Q_GLOBAL_STATIC(SharedActionMap, sharedActions)
+
+bool actionLessThan(const ActionInfo &a, const ActionInfo &b);
+
+// Sorted global actions of class with all its superclasses, it is the same
+// for every controller of the class, so there is no need to collect it each time
+struct GlobalActionsCacheEntry
+{
+	int revision;
+	QList<ActionInfo> infos;
+};
+typedef QHash<const QMetaObject*, GlobalActionsCacheEntry> GlobalActionsCache;
+Q_GLOBAL_STATIC(GlobalActionsCache, globalActionsCache)
+static int globalActionsRevision = 0;
+
+static const QList<ActionInfo> &cachedGlobalActions(const QMetaObject *meta)
+{
+	GlobalActionsCacheEntry &entry = (*globalActionsCache())[meta];
+	if (entry.revision != globalActionsRevision || entry.infos.isEmpty()) {
+		entry.revision = globalActionsRevision;
+		entry.infos.clear();
+		for (const QMetaObject *super = meta; super; super = super->superClass())
+			entry.infos << globalActions()->values(super);
+		qSort(entry.infos.begin(), entry.infos.end(), actionLessThan);
+	}
+	return entry.infos;
+}
+
+static inline void showAction(const ActionGenerator *gen, QAction *action, QObject *controller)
+{
+	ActionGeneratorPrivate *p = const_cast<ActionGeneratorPrivate*>(ActionGeneratorPrivate::get(gen));
+	// Shared action is triggered for controller, which has shown it last time
+	if (p->shared)
+		actionControllerMap()->insert(action, controller);
+	p->show(action, controller);
+}
 
 ActionValue::ActionValue(const ActionKey &k) : key(k)
 {
@@ -64,6 +104,12 @@ QObject *ActionValue::controller(QAction *action)
 
 ActionValue::Ptr ActionValue::get(const ActionGenerator *gen, QObject *controller)
 {
+	if (ActionGeneratorPrivate::get(gen)->shared) {
+		ActionValue::Ptr &value = (*sharedActions())[gen];
+		if (!value)
+			value = ActionValue::Ptr(new ActionValue(ActionKey(0, gen)));
+		return value;
+	}
 	ActionKey key(controller, gen);
 	ActionMap::ConstIterator it = actionMap()->constFind(key);
 	if (it != actionMap()->constEnd())
@@ -99,8 +145,11 @@ void ActionValue::handleDeath(const ActionGenerator *gen)
 {
 	MenuActionMap::Iterator it;
 	MenuActionMap::Iterator endit = globalActions()->end();
+	++globalActionsRevision;
 	foreach (const ActionValue::WeakPtr &valuePtr, find(gen)) {
 		ActionValue *value = valuePtr.data();
+		if (!value)
+			continue;
 		MenuController *controller = qobject_cast<MenuController*>(value->key.first);
 		if (controller) {
 			MenuControllerPrivate *p = MenuControllerPrivate::get(controller);
@@ -127,6 +176,19 @@ void ActionValue::handleDeath(const ActionGenerator *gen)
 		else
 			++it;
 	}
+	if (sharedActions()->contains(gen)) {
+		// Shared action isn't bound to any controller, so look through all alive menus
+		foreach (MenuController *controller, *activatedControllers()) {
+			ActionCollectionPrivate *p = ActionCollectionPrivate::get(MenuControllerPrivate::get(controller)->actions);
+			for (int i = p->actionInfos.size() - 1; i >= 0; --i) {
+				if (p->actionInfos.at(i).gen == gen) {
+					const ActionInfoV2 info = p->actionInfos.at(i);
+					p->removeAction(info);
+				}
+			}
+		}
+		sharedActions()->remove(gen);
+	}
 }
 
 const QByteArray &menuNameBySet(const QByteArray &name)
@@ -140,8 +202,6 @@ ActionHandlerHelper *handler()
 	return &handler;
 }
 
-Q_GLOBAL_STATIC(QList<MenuController*>, activatedControllers)
-
 MenuControllerPrivate::MenuControllerPrivate(MenuController *c):
 	owner(0), flags(0xffff), q_ptr(c), actions(c)
 {
@@ -428,6 +488,7 @@ void MenuController::addAction(const ActionGenerator *gen, const QMetaObject *me
 {
 	Q_ASSERT(gen && meta);
 	const ActionInfo &info = *globalActions()->insert(meta, ActionInfo(gen, menu));
+	++globalActionsRevision;
 	foreach (MenuController *controller, *activatedControllers()) {
 		MenuController *owner = controller;
 		int flags = owner->d_ptr->flags;
@@ -501,7 +562,7 @@ QAction* ActionCollection::action(int index) const
 	QAction *action = d->actions.at(index)->action.data();
 	ActionGenerator *gen = ActionGenerator::get(action);
 	if (gen)
-		ActionGeneratorPrivate::get(gen)->show(action,d->controller);
+		showAction(gen, action, d->controller);
 	return action;
 }
 
@@ -555,8 +616,7 @@ void ActionCollection::showRef()
 	if (1 == ++d->showRef) {
 		for (int i = 0; i < d->actions.size(); ++i) {
 			const ActionInfoV2 &info = d->actionInfos.at(i);
-			ActionGenerator *gen = const_cast<ActionGenerator*>(info.gen);
-			ActionGeneratorPrivate::get(gen)->show(d->actions.at(i)->action.data(), info.controller);
+			showAction(info.gen, d->actions.at(i)->action.data(), info.controller);
 		}
 	}
 }
@@ -638,7 +698,7 @@ void ActionCollectionPrivate::setController(MenuController *newController)
 				const ActionGeneratorPrivate *cp = ActionGeneratorPrivate::get(a.gen);
 				ActionGeneratorPrivate *p = const_cast<ActionGeneratorPrivate*>(cp);
 				p->hide(action, oldController);
-				p->show(action, newController);
+				showAction(a.gen, action, newController);
 			}
 			++l;
 			++j;
@@ -709,11 +769,8 @@ void ActionCollectionPrivate::addAction(const ActionInfoV2 &info)
 void ActionCollectionPrivate::insertAction(int index, const ActionInfoV2 &info)
 {
 	ActionValue::Ptr action = ActionValue::get(info);
-	if (showRef > 0) {
-		const ActionGeneratorPrivate *cp = ActionGeneratorPrivate::get(info.gen);
-		ActionGeneratorPrivate *p = const_cast<ActionGeneratorPrivate*>(cp);
-		p->show(action->action.data(), controller);
-	}
+	if (showRef > 0)
+		showAction(info.gen, action->action.data(), controller);
     actionInfos.insert(index, info);
     actions.insert(index, action);
     for (int i = 0; i < handlers.size(); ++i)
@@ -727,7 +784,35 @@ void ActionCollectionPrivate::ensureActionInfos()
     actionInfos.clear();
 	QSet<const QMetaObject *> metaObjects;
 	MenuController *owner = controller;
+	bool needSort = false;
+	{
+		// Fast path for controller's own class, it's already sorted
+		int flags = MenuControllerPrivate::get(owner)->flags;
+		const QMetaObject *meta = owner->metaObject();
+		if (flags & MenuController::ShowSuperActions) {
+			const QList<ActionInfo> &infos = cachedGlobalActions(meta);
+			actionInfos.reserve(infos.size());
+			for (int i = 0; i < infos.size(); ++i)
+				actionInfos << ActionInfoV2(infos.at(i), owner);
+			for (; meta; meta = meta->superClass())
+				metaObjects.insert(meta);
+		}
+		const QList<ActionInfoV2> &local = ActionCollectionPrivate::get(MenuControllerPrivate::get(owner)->actions)->localActions;
+		if (!local.isEmpty()) {
+			actionInfos.append(local);
+			needSort = true;
+		}
+		if (!(flags & MenuController::ShowSuperActions)) {
+			foreach (const ActionInfo &info, globalActions()->values(meta))
+				actionInfos << ActionInfoV2(info, owner);
+			metaObjects.insert(meta);
+			needSort = true;
+		}
+		owner = (flags & MenuController::ShowOwnerActions)
+				? MenuControllerPrivate::get(owner)->owner : 0;
+	}
 	while (owner) {
+		needSort = true;
 		int flags = MenuControllerPrivate::get(owner)->flags;
 		ActionCollection collection = MenuControllerPrivate::get(owner)->actions;
 		ActionCollectionPrivate *p = ActionCollectionPrivate::get(collection);
@@ -744,7 +829,8 @@ void ActionCollectionPrivate::ensureActionInfos()
 		owner = (flags & MenuController::ShowOwnerActions)
 				? MenuControllerPrivate::get(owner)->owner : 0;
 	}
-	qSort(actionInfos.begin(), actionInfos.end(), actionLessThan);
+	if (needSort)
+		qSort(actionInfos.begin(), actionInfos.end(), actionLessThan);
 }
 
 void ActionCollectionPrivate::recalc()
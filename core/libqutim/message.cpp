@@ -24,8 +24,11 @@
 ****************************************************************************/
 
 #include "message.h"
-#include "dynamicpropertydata_p.h"
 #include <QDateTime>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QVarLengthArray>
+#include <QAtomicInteger>
 #include <QScriptEngine>
 #include <QScriptValue>
 #include <QScriptValueIterator>
@@ -105,17 +108,87 @@ void Message::scriptRegister(QScriptEngine *engine)
 	qScriptRegisterMetaType(engine, &messageToScriptValue, &messageFromScriptValue);
 }
 
-static quint64 message_id = 0;
+class MessagePropertyRegistry
+{
+public:
+	MessagePropertyRegistry()
+	{
+		static const char *const wellKnown[] = {
+			"text", "html", "time", "in", "chatUnit",
+			"spam", "hide", "service", "history", "silent", "store", "fake",
+			"mention", "topic", "focus", "firstFocus", "autoreply", "donotsend",
+			"senderName", "senderId", "senderAvatar"
+		};
+		Q_STATIC_ASSERT(sizeof(wellKnown) / sizeof(wellKnown[0]) == Message::LastWellKnownProperty + 1);
+		for (const char *name : wellKnown)
+			insert(QByteArray(name));
+	}
+
+	int key(const char *name)
+	{
+		const QByteArray raw = QByteArray::fromRawData(name, qstrlen(name));
+		{
+			QReadLocker locker(&m_lock);
+			auto it = m_keys.constFind(raw);
+			if (it != m_keys.constEnd())
+				return it.value();
+		}
+		QWriteLocker locker(&m_lock);
+		auto it = m_keys.constFind(raw);
+		if (it != m_keys.constEnd())
+			return it.value();
+		return insert(QByteArray(name));
+	}
+
+	QByteArray name(int key)
+	{
+		QReadLocker locker(&m_lock);
+		return m_names.value(key);
+	}
+
+private:
+	int insert(const QByteArray &name)
+	{
+		const int key = m_names.size();
+		m_names.append(name);
+		m_keys.insert(name, key);
+		return key;
+	}
+
+	QReadWriteLock m_lock;
+	QHash<QByteArray, int> m_keys;
+	QVector<QByteArray> m_names;
+};
+
+Q_GLOBAL_STATIC(MessagePropertyRegistry, propertyRegistry)
+
+static QAtomicInteger<quint64> message_id;
 
-class MessagePrivate : public DynamicPropertyData
+static inline quint64 nextMessageId()
+{
+	return message_id.fetchAndAddRelaxed(1) + 1;
+}
+
+class MessagePrivate : public QSharedData
 {
 public:
+	struct Entry
+	{
+		int key;
+		QVariant value;
+	};
+	// Most of messages have less than 8 dynamic properties, so keep
+	// them inside of the message itself
+	typedef QVarLengthArray<Entry, 8> Entries;
+
 	MessagePrivate() :
 		time(QDateTime::currentDateTime()), in(false),
-		id(++message_id) {}
+		id(nextMessageId()), hasFormattedHtml(false) {}
 	MessagePrivate(const MessagePrivate &o) :
-		DynamicPropertyData(o), text(o.text), html(o.html), time(o.time),
-		in(o.in), chatUnit(o.chatUnit), id(++message_id) {}
+		QSharedData(o), text(o.text), html(o.html), time(o.time),
+		in(o.in), chatUnit(o.chatUnit), id(nextMessageId()), entries(o.entries),
+		hasFormattedHtml(o.hasFormattedHtml), formattedHtml(o.formattedHtml),
+		formattedTheme(o.formattedTheme) {}
 	~MessagePrivate() {}
 	QString text;
 	QString html;
@@ -123,52 +196,160 @@ public:
 	bool in;
 	QPointer<ChatUnit> chatUnit;
 	quint64 id;
-	QVariant getText() const { return text; }
-	void setText(const QVariant &val) { text = val.toString(); }
-	QVariant getHtml() const {
-		if (html.isEmpty()) {
-			QString &mutableHtml = const_cast<QString&>(html);
-			mutableHtml = text.toHtmlEscaped();
-			// keep leading whitespaces
-			mutableHtml.replace(QLatin1String("\n "), QLatin1String("<br/>&nbsp;"));
-			mutableHtml.replace(QLatin1Char('\n'), QLatin1String("<br/>"));
-			// replace tabs by 4 spaces
-			mutableHtml.replace(QLatin1Char('\t'), QLatin1String("&nbsp; &nbsp; "));
-			// keep multiple whitespaces
-			mutableHtml.replace(QLatin1String("  "), QLatin1String(" &nbsp;"));
-		}
+	Entries entries;
+	// Html with links and emoticons, shared by all views of the message
+	bool hasFormattedHtml;
+	QString formattedHtml;
+	QString formattedTheme;
+
+	const QString &getHtml() const {
+		if (html.isEmpty())
+			const_cast<QString&>(html) = escapeText(text);
 		return html;
 	}
-	void setHtml(const QVariant &val) { html = val.toString(); }
-	QVariant getTime() const { return time; }
-	void setTime(const QVariant &val) { time = val.toDateTime(); }
-	QVariant getIn() const { return in;}
-	void setIn(const QVariant &input) { in = input.toBool(); }
-	void setChatUnit (const QVariant &val) { chatUnit = val.value<ChatUnit *>(); }
-	QVariant getChatUnit() const { return QVariant::fromValue(chatUnit.data()); }
-};
 
-namespace CompiledProperty
-{
-static QList<QByteArray> names = QList<QByteArray>()
-								 << "text"
-								 << "html"
-								 << "time"
-								 << "in"
-								 << "chatUnit";
-static QList<Getter> getters   = QList<Getter>()
-								 << static_cast<Getter>(&MessagePrivate::getText)
-								 << static_cast<Getter>(&MessagePrivate::getHtml)
-								 << static_cast<Getter>(&MessagePrivate::getTime)
-								 << static_cast<Getter>(&MessagePrivate::getIn)
-								 << static_cast<Getter>(&MessagePrivate::getChatUnit);
-static QList<Setter> setters   = QList<Setter>()
-								 << static_cast<Setter>(&MessagePrivate::setText)
-								 << static_cast<Setter>(&MessagePrivate::setHtml)
-								 << static_cast<Setter>(&MessagePrivate::setTime)
-								 << static_cast<Setter>(&MessagePrivate::setIn)
-								 << static_cast<Setter>(&MessagePrivate::setChatUnit);
-}
+	const QString &getFormattedHtml(bool topic) const {
+		EmoticonsTheme theme = topic ? EmoticonsTheme(0) : Emoticons::theme();
+		const QString themeName = theme.themeName();
+		if (!hasFormattedHtml || formattedTheme != themeName) {
+			MessagePrivate *d = const_cast<MessagePrivate*>(this);
+			d->formattedHtml = UrlParser::parseUrls(getHtml(), UrlParser::Html);
+			if (!theme.isNull())
+				d->formattedHtml = theme.parseEmoticons(d->formattedHtml);
+			d->formattedTheme = themeName;
+			d->hasFormattedHtml = true;
+		}
+		return formattedHtml;
+	}
+
+	void resetFormattedHtml()
+	{
+		hasFormattedHtml = false;
+		formattedHtml.clear();
+	}
+
+	static QString escapeText(const QString &text)
+	{
+		// Same as toHtmlEscaped followed by whitespace replacements, but in single pass
+		QString result;
+		result.reserve(text.size() + text.size() / 8);
+		bool unpairedSpace = false;
+		const int size = text.size();
+		for (int i = 0; i < size; ++i) {
+			const QChar c = text.at(i);
+			bool space = false;
+			switch (c.unicode()) {
+			case '<':
+				result += QLatin1String("&lt;");
+				break;
+			case '>':
+				result += QLatin1String("&gt;");
+				break;
+			case '&':
+				result += QLatin1String("&amp;");
+				break;
+			case '"':
+				result += QLatin1String("&quot;");
+				break;
+			case '\n':
+				// keep leading whitespaces
+				if (i + 1 < size && text.at(i + 1) == QLatin1Char(' ')) {
+					result += QLatin1String("<br/>&nbsp;");
+					++i;
+				} else {
+					result += QLatin1String("<br/>");
+				}
+				break;
+			case '\t':
+				// replace tabs by 4 spaces
+				result += QLatin1String("&nbsp; &nbsp; ");
+				space = true;
+				break;
+			case ' ':
+				// keep multiple whitespaces
+				if (unpairedSpace) {
+					result += QLatin1String("&nbsp;");
+				} else {
+					result += c;
+					space = true;
+				}
+				break;
+			default:
+				result += c;
+				break;
+			}
+			unpairedSpace = space;
+		}
+		return result;
+	}
+
+	int indexOf(int key) const
+	{
+		for (int i = 0; i < entries.size(); ++i) {
+			if (entries.at(i).key == key)
+				return i;
+		}
+		return -1;
+	}
+
+	QVariant property(int key, const QVariant &def) const
+	{
+		switch (key) {
+		case Message::TextProperty:
+			return text;
+		case Message::HtmlProperty:
+			return getHtml();
+		case Message::TimeProperty:
+			return time;
+		case Message::InProperty:
+			return in;
+		case Message::ChatUnitProperty:
+			return QVariant::fromValue(chatUnit.data());
+		default: {
+			int index = indexOf(key);
+			return index < 0 ? def : entries.at(index).value;
+		}
+		}
+	}
+
+	void setProperty(int key, const QVariant &value)
+	{
+		switch (key) {
+		case Message::TextProperty:
+			text = value.toString();
+			resetFormattedHtml();
+			break;
+		case Message::HtmlProperty:
+			html = value.toString();
+			resetFormattedHtml();
+			break;
+		case Message::TimeProperty:
+			time = value.toDateTime();
+			break;
+		case Message::InProperty:
+			in = value.toBool();
+			break;
+		case Message::ChatUnitProperty:
+			chatUnit = value.value<ChatUnit *>();
+			break;
+		default: {
+			if (key == Message::TopicProperty)
+				resetFormattedHtml();
+			int index = indexOf(key);
+			if (!value.isValid()) {
+				if (index >= 0)
+					entries.remove(index);
+			} else if (index < 0) {
+				Entry entry = { key, value };
+				entries.append(entry);
+			} else {
+				entries[index].value = value;
+			}
+			break;
+		}
+		}
+	}
+};
 
 Message::Message() : p(new MessagePrivate)
 {
@@ -195,17 +376,41 @@ Message &Message::operator =(const Message &other)
 
 QVariant Message::property(const char *name, const QVariant &def) const
 {
-	return p->property(name, def, CompiledProperty::names, CompiledProperty::getters);
+	return p->property(propertyKey(name), def);
 }
 
 void Message::setProperty(const char *name, const QVariant &value)
 {
-	return p->setProperty(name, value, CompiledProperty::names, CompiledProperty::setters);
+	p->setProperty(propertyKey(name), value);
+}
+
+QVariant Message::property(Property key, const QVariant &def) const
+{
+	return p->property(key, def);
+}
+
+void Message::setProperty(Property key, const QVariant &value)
+{
+	p->setProperty(key, value);
 }
 
 QList<QByteArray> Message::dynamicPropertyNames() const
 {
-    return p->names;
+	QList<QByteArray> names;
+	names.reserve(p->entries.size());
+	for (const MessagePrivate::Entry &entry : p->entries)
+		names << propertyRegistry()->name(entry.key);
+	return names;
+}
+
+Message::Property Message::propertyKey(const char *name)
+{
+	return static_cast<Property>(propertyRegistry()->key(name));
+}
+
+QByteArray Message::propertyName(Property key)
+{
+	return propertyRegistry()->name(key);
 }
 
 QVariant Message::property(const QString &name, const QVariant &def) const
@@ -215,17 +420,13 @@ QVariant Message::property(const QString &name, const QVariant &def) const
 
 bool Message::hasProperty(const QString &name) const
 {
-    return dynamicPropertyNames().contains(name.toUtf8().constData());
+    return p->indexOf(propertyKey(name.toUtf8().constData())) >= 0;
 }
 
 QString Message::formattedHtml() const
 {
-    QString html = UrlParser::parseUrls(this->html(), UrlParser::Html);
-
-    if (property("topic", false))
-        return html;
-
-    return Emoticons::theme().parseEmoticons(html);
+    // We don't want emoticons in topic
+    return p->getFormattedHtml(property(TopicProperty, false));
 }
 
 bool Message::isSimiliar(const Message &other, int flags) const
@@ -236,10 +437,10 @@ bool Message::isSimiliar(const Message &other, int flags) const
     if (a.chatUnit() == b.chatUnit()
             && ((flags & IgnoreActions) || (!a.isAction() && !b.isAction()))
             && a.isIncoming() == b.isIncoming()
-            && a.property("senderName", QString()) == b.property("senderName", QString())
-            && a.property("service", false) == b.property("service", false)
-            && a.property("history", false) == b.property("history", false)
-            && a.property("mention", false) == b.property("mention", false)) {
+            && a.property(SenderNameProperty, QString()) == b.property(SenderNameProperty, QString())
+            && a.property(ServiceProperty, false) == b.property(ServiceProperty, false)
+            && a.property(HistoryProperty, false) == b.property(HistoryProperty, false)
+            && a.property(MentionProperty, false) == b.property(MentionProperty, false)) {
         // TODO: Make configurable
         return qAbs(a.time().secsTo(b.time())) < 300;
     }
@@ -254,16 +455,18 @@ const QString &Message::text() const
 void Message::setText(const QString &text)
 {
 	p->text = text;
+	p->resetFormattedHtml();
 }
 
 QString Message::html() const
 {
-	return p->getHtml().toString();
+	return p->getHtml();
 }
 
 void Message::setHtml(const QString &html)
 {
 	p->html = html;
+	p->resetFormattedHtml();
 }
 
 const QDateTime &Message::time() const
@@ -304,9 +507,9 @@ ChatUnit* Message::chatUnit() const
 MessageUnitData Message::unitData() const
 {
     QObject *source = 0;
-    QString id = property("senderId", QString());
-    QString title = property("senderName", QString());
-    QString avatar = property("senderAvatar", QString());
+    QString id = property(SenderIdProperty, QString());
+    QString title = property(SenderNameProperty, QString());
+    QString avatar = property(SenderAvatarProperty, QString());
     if (!title.isEmpty()) {
         if (avatar.isEmpty()) {
             if (!id.isEmpty())
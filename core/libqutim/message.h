@@ -78,6 +78,37 @@ public:
 		QString avatar;
     };
 
+    /**
+     * Interned keys of message properties. Well-known keys have fixed ids,
+     * other names are registered on first use by propertyKey(), so lookup by
+     * key never compares strings and never allocates.
+     */
+    enum Property
+    {
+        TextProperty = 0,
+        HtmlProperty,
+        TimeProperty,
+        InProperty,
+        ChatUnitProperty,
+        SpamProperty,
+        HideProperty,
+        ServiceProperty,
+        HistoryProperty,
+        SilentProperty,
+        StoreProperty,
+        FakeProperty,
+        MentionProperty,
+        TopicProperty,
+        FocusProperty,
+        FirstFocusProperty,
+        AutoReplyProperty,
+        DoNotSendProperty,
+        SenderNameProperty,
+        SenderIdProperty,
+        SenderAvatarProperty,
+        LastWellKnownProperty = SenderAvatarProperty
+    };
+
     enum SimiliarFlag
     {
         NoFlag = 0x00,
@@ -112,8 +143,16 @@ public:
 	template<typename T>
     T property(const char *name, const T &def) const;
 	void setProperty(const char *name, const QVariant &value);
+	QVariant property(Property key, const QVariant &def = QVariant()) const;
+	template<typename T>
+	T property(Property key, const T &def) const;
+	void setProperty(Property key, const QVariant &value);
 	QList<QByteArray> dynamicPropertyNames() const;
 
+	// Thread-safe, returns the same key for the same name during application's life
+	static Property propertyKey(const char *name);
+	static QByteArray propertyName(Property key);
+
     Q_INVOKABLE QVariant property(const QString &name, const QVariant &def) const;
     Q_INVOKABLE bool hasProperty(const QString &name) const;
     Q_INVOKABLE QString formattedHtml() const;
@@ -130,6 +169,13 @@ T Message::property(const char *name, const T &def) const
     return var.value<T>();
 }
 
+template<typename T>
+T Message::property(Property key, const T &def) const
+{
+    QVariant var = property(key, QVariant::fromValue<T>(def));
+    return var.value<T>();
+}
+
 
 class LIBQUTIM_EXPORT MessageReceiptEvent : public QEvent
 {
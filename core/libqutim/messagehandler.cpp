@@ -25,6 +25,7 @@
 
 #include "messagehandler.h"
 #include "debug.h"
+#include "metrics.h"
 #include <memory>
 #include <QThreadStorage>
 
@@ -95,34 +96,111 @@ void MessageHandler::unregisterHandler(MessageHandler *handler)
 
 static quint64 currentMessageIdHook = -1;
 
+MessageHandler::Result MessageHandler::doHandleSync(Message &message, QString *reason)
+{
+	Q_UNUSED(message);
+	Q_UNUSED(reason);
+	return Pending;
+}
+
+MessageHandlerAsyncResult MessageHandler::doHandle(Message &message)
+{
+	QString reason;
+	Result result = doHandleSync(message, &reason);
+	return makeAsyncResult(result == Pending ? Accept : result, reason);
+}
+
+// Runs synchronous handlers starting from index, stops at the first one, which
+// wants to be asynchronous, index points to it in such case
+static MessageHandler::Result runSync(const MessageHandlerList &list, int &index, Message &message,
+									  quint64 messageId, QString &reason,
+									  MessageHandler::Result (*call)(MessageHandler *, Message &, QString *))
+{
+	while (index < list.size()) {
+		currentMessageIdHook = messageId;
+		MessageHandler::Result result = call(list.at(index).handler, message, &reason);
+		if (result == MessageHandler::Pending)
+			return result;
+		++index;
+		if (result != MessageHandler::Accept)
+			return result;
+	}
+	return MessageHandler::Accept;
+}
+
+struct HandlerMetrics
+{
+	Counter *handled;
+	Histogram *latency;
+};
+
+// Whole chain is measured, including time asynchronous handlers wait for
+static HandlerMetrics *handlerMetrics(bool incoming)
+{
+	static HandlerMetrics metrics[] = {
+		{
+			Metrics::counter("qutim_messages_handled_total", QStringLiteral("direction=\"outgoing\"")),
+			Metrics::histogram("qutim_message_handlers_latency_microseconds", QStringLiteral("direction=\"outgoing\""))
+		},
+		{
+			Metrics::counter("qutim_messages_handled_total", QStringLiteral("direction=\"incoming\"")),
+			Metrics::histogram("qutim_message_handlers_latency_microseconds", QStringLiteral("direction=\"incoming\""))
+		}
+	};
+	return &metrics[incoming ? 1 : 0];
+}
+
+static void reportHandled(const Message &message, const QElapsedTimer &timer)
+{
+	HandlerMetrics *metrics = handlerMetrics(message.isIncoming());
+	metrics->handled->add();
+	metrics->latency->observe(timer.nsecsElapsed() / 1000);
+}
+
 struct MessageHandler::StateType : public std::enable_shared_from_this<StateType>
 {
-	StateType(const Message &message, const MessageHandlerList &list)
-		: index(0), message(message), messageId(message.id()), list(list)
+	StateType(const Message &message, const MessageHandlerList &list, int index, quint64 messageId,
+			  const QElapsedTimer &timer)
+		: index(index), message(message), messageId(messageId), list(list), timer(timer)
     {
         this->message.setChatUnit(message.chatUnit());
     }
 
+	static Result callSync(MessageHandler *handler, Message &message, QString *reason)
+	{
+		return handler->doHandleSync(message, reason);
+	}
+
     void onResult(MessageHandler::Result result, const QString &error)
     {
         if (result != MessageHandler::Accept) {
+			reportHandled(message, timer);
 			handler.handle(message, result, error);
             return;
         }
+        next();
+    }
+
+    void next()
+    {
+		QString reason;
+		Result result = runSync(list, index, message, messageId, reason, &StateType::callSync);
+		if (result != Pending) {
+			reportHandled(message, timer);
+			handler.handle(message, result, reason);
+			return;
+		}
 
         using namespace std::placeholders;
-        if (index < list.size()) {
-            currentMessageIdHook = messageId;
-			list[index++].handler->doHandle(message).connect(std::bind(&StateType::onResult, shared_from_this(), _1, _2));
-        } else {
-			handler.handle(message, MessageHandler::Accept, QString());
-        }
+		currentMessageIdHook = messageId;
+		list[index++].handler->doHandle(message).connect(std::bind(&StateType::onResult, shared_from_this(), _1, _2));
     }
 
     int index;
     Message message;
     quint64 messageId;
     const MessageHandlerList list;
+	QElapsedTimer timer;
 	AsyncResultHandler<Message, MessageHandler::Result, QString> handler;
 };
 
@@ -134,8 +212,20 @@ AsyncResult<Message, MessageHandler::Result, QString> MessageHandler::handle(con
 		return makeAsyncResult(message, Accept, QString());
     }
 
-	auto state = std::make_shared<StateType>(message, list);
-    state->onResult(Accept, QString());
+	// Fast path, most of handlers are synchronous, so no state is needed
+	QElapsedTimer timer;
+	timer.start();
+	Message copy = message;
+	int index = 0;
+	QString reason;
+	Result result = runSync(list, index, copy, message.id(), reason, &StateType::callSync);
+	if (result != Pending) {
+		reportHandled(copy, timer);
+		return makeAsyncResult(copy, result, reason);
+	}
+
+	auto state = std::make_shared<StateType>(copy, list, index, message.id(), timer);
+	state->next();
 
 	return state->handler.result();
 }
@@ -146,7 +236,7 @@ void MessageHandler::traceHandlers()
 	const char *titles[] = { "Incoming handlers:", "Outgoing handlers:" };
 	for (int i = 0; i < 2; ++i) {
 		MessageHandlerList &list = *lists[i];
-		QDebug dbg = qDebug();
+		QDebug dbg = debug();
 		dbg << titles[i];
 		dbg.nospace();
 		for (int j = 0; j < list.size(); ++j) {
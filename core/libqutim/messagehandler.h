@@ -39,7 +39,9 @@ public:
 	{
 		Accept,
 		Reject,
-		Error
+		Error,
+		// Returned only by doHandleSync, never by handle()
+		Pending
 	};
 	enum Priority
 	{
@@ -66,7 +68,16 @@ public:
 	
 protected:
     struct StateType;
-	virtual AsyncResult<MessageHandler::Result, QString> doHandle(Message &message) = 0;
+	/**
+	 * Handlers which always know the result immediately should reimplement
+	 * this method instead of doHandle(). Chain of such handlers is run inline,
+	 * without allocation of any intermediate results.
+	 *
+	 * Default implementation returns Pending, so doHandle() is called.
+	 * Message must not be changed if Pending is returned.
+	 */
+	virtual Result doHandleSync(Message &message, QString *reason);
+	virtual AsyncResult<MessageHandler::Result, QString> doHandle(Message &message);
 };
 
 typedef AsyncResult<MessageHandler::Result, QString> MessageHandlerAsyncResult;
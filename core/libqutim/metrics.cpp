@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "metrics.h"
+#include "account.h"
+#include "protocol.h"
+#include <QMap>
+#include <QMutex>
+
+namespace qutim_sdk_0_3
+{
+
+struct MetricsRegistry
+{
+	QMutex mutex;
+	// Sorted by name, so text output keeps metrics of one family together
+	QMap<QByteArray, Metric *> metrics;
+};
+
+// Metrics are never deleted, pointers to them are kept by static variables
+Q_GLOBAL_STATIC(MetricsRegistry, registry)
+
+Metric::Metric(Type type, const QByteArray &name, const QByteArray &labels)
+	: m_type(type), m_name(name), m_labels(labels)
+{
+}
+
+Metric::~Metric()
+{
+}
+
+Counter::Counter(const QByteArray &name, const QByteArray &labels)
+	: Metric(CounterType, name, labels), m_value(0)
+{
+}
+
+Gauge::Gauge(const QByteArray &name, const QByteArray &labels)
+	: Metric(GaugeType, name, labels), m_value(0)
+{
+}
+
+Histogram::Histogram(const QByteArray &name, const QByteArray &labels)
+	: Metric(HistogramType, name, labels), m_count(0), m_sum(0)
+{
+	for (int i = 0; i < BucketCount; ++i)
+		m_buckets[i].store(0);
+}
+
+void Histogram::observe(qint64 value)
+{
+	int index = 0;
+	while (index < BucketCount - 1 && (Q_INT64_C(1) << index) < value)
+		++index;
+	m_buckets[index].fetchAndAddRelaxed(1);
+	m_count.fetchAndAddRelaxed(1);
+	m_sum.fetchAndAddRelaxed(value);
+}
+
+qint64 Histogram::bucketBound(int index)
+{
+	return index < BucketCount - 1 ? Q_INT64_C(1) << index : -1;
+}
+
+qint64 Histogram::quantile(double share) const
+{
+	const qint64 total = count();
+	if (total == 0)
+		return 0;
+	qint64 seen = 0;
+	for (int i = 0; i < BucketCount - 1; ++i) {
+		seen += bucket(i);
+		if (seen >= total * share)
+			return bucketBound(i);
+	}
+	return bucketBound(BucketCount - 2);
+}
+
+template <typename T>
+static T *metric(const char *name, const QString &labels)
+{
+	const QByteArray labelsData = labels.toUtf8();
+	QByteArray key = name;
+	if (!labelsData.isEmpty())
+		key += '{' + labelsData + '}';
+
+	MetricsRegistry *d = registry();
+	QMutexLocker locker(&d->mutex);
+	Metric *&result = d->metrics[key];
+	if (!result)
+		result = new T(name, labelsData);
+	return static_cast<T *>(result);
+}
+
+Counter *Metrics::counter(const char *name, const QString &labels)
+{
+	return metric<Counter>(name, labels);
+}
+
+Gauge *Metrics::gauge(const char *name, const QString &labels)
+{
+	return metric<Gauge>(name, labels);
+}
+
+Histogram *Metrics::histogram(const char *name, const QString &labels)
+{
+	return metric<Histogram>(name, labels);
+}
+
+QString Metrics::label(const char *key, const QString &value)
+{
+	QString escaped = value;
+	escaped.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+	escaped.replace(QLatin1Char('"'), QLatin1String("\\\""));
+	escaped.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+	QString result = QLatin1String(key);
+	result += QLatin1String("=\"");
+	result += escaped;
+	result += QLatin1Char('"');
+	return result;
+}
+
+QString Metrics::accountLabels(const Account *account)
+{
+	return label("protocol", account->protocol()->id())
+			+ QLatin1Char(',') + label("account", account->id());
+}
+
+SocketMetrics::SocketMetrics()
+	: m_receivedBytes(0), m_sentBytes(0), m_receivedPackets(0), m_sentPackets(0),
+	  m_queueLength(0), m_queueDelay(0), m_connectLatency(0), m_connectFailures(0)
+{
+}
+
+SocketMetrics::SocketMetrics(const Account *account)
+{
+	const QString labels = Metrics::accountLabels(account);
+	m_receivedBytes = Metrics::counter("qutim_socket_received_bytes_total", labels);
+	m_sentBytes = Metrics::counter("qutim_socket_sent_bytes_total", labels);
+	m_receivedPackets = Metrics::counter("qutim_socket_received_packets_total", labels);
+	m_sentPackets = Metrics::counter("qutim_socket_sent_packets_total", labels);
+	m_queueLength = Metrics::gauge("qutim_socket_queue_length", labels);
+	m_queueDelay = Metrics::histogram("qutim_socket_queue_delay_microseconds", labels);
+	m_connectLatency = Metrics::histogram("qutim_socket_connect_latency_milliseconds", labels);
+	m_connectFailures = Metrics::counter("qutim_socket_connect_failures_total", labels);
+}
+
+static QByteArray sample(const QByteArray &name, const QByteArray &labels, qint64 value)
+{
+	QByteArray result = name;
+	if (!labels.isEmpty())
+		result += '{' + labels + '}';
+	result += ' ';
+	result += QByteArray::number(value);
+	result += '\n';
+	return result;
+}
+
+static QList<Metric *> allMetrics()
+{
+	MetricsRegistry *d = registry();
+	QMutexLocker locker(&d->mutex);
+	return d->metrics.values();
+}
+
+QByteArray Metrics::toText()
+{
+	static const char * const types[] = { "counter", "gauge", "histogram" };
+	QByteArray result;
+	QByteArray family;
+	foreach (Metric *metric, allMetrics()) {
+		if (metric->name() != family) {
+			family = metric->name();
+			result += "# TYPE " + family + ' ' + types[metric->type()] + '\n';
+		}
+		switch (metric->type()) {
+		case Metric::CounterType:
+			result += sample(family, metric->labels(), static_cast<Counter *>(metric)->value());
+			break;
+		case Metric::GaugeType:
+			result += sample(family, metric->labels(), static_cast<Gauge *>(metric)->value());
+			break;
+		case Metric::HistogramType: {
+			Histogram *histogram = static_cast<Histogram *>(metric);
+			const QByteArray prefix = metric->labels().isEmpty() ? QByteArray() : metric->labels() + ',';
+			qint64 cumulative = 0;
+			for (int i = 0; i < Histogram::BucketCount; ++i) {
+				cumulative += histogram->bucket(i);
+				const qint64 bound = Histogram::bucketBound(i);
+				const QByteArray le = bound < 0 ? QByteArray("+Inf") : QByteArray::number(bound);
+				result += sample(family + "_bucket", prefix + "le=\"" + le + '"', cumulative);
+			}
+			result += sample(family + "_sum", metric->labels(), histogram->sum());
+			result += sample(family + "_count", metric->labels(), histogram->count());
+			break;
+		}
+		}
+	}
+	return result;
+}
+
+QVariantMap Metrics::toMap()
+{
+	QVariantMap result;
+	foreach (Metric *metric, allMetrics()) {
+		QString key = QString::fromLatin1(metric->name());
+		if (!metric->labels().isEmpty())
+			key += QLatin1Char('{') + QString::fromUtf8(metric->labels()) + QLatin1Char('}');
+		switch (metric->type()) {
+		case Metric::CounterType:
+			result.insert(key, static_cast<Counter *>(metric)->value());
+			break;
+		case Metric::GaugeType:
+			result.insert(key, static_cast<Gauge *>(metric)->value());
+			break;
+		case Metric::HistogramType: {
+			Histogram *histogram = static_cast<Histogram *>(metric);
+			QVariantList buckets;
+			qint64 cumulative = 0;
+			for (int i = 0; i < Histogram::BucketCount; ++i) {
+				cumulative += histogram->bucket(i);
+				buckets << cumulative;
+			}
+			QVariantMap data;
+			data.insert(QStringLiteral("count"), histogram->count());
+			data.insert(QStringLiteral("sum"), histogram->sum());
+			data.insert(QStringLiteral("p50"), histogram->quantile(0.5));
+			data.insert(QStringLiteral("p99"), histogram->quantile(0.99));
+			data.insert(QStringLiteral("buckets"), buckets);
+			result.insert(key, data);
+			break;
+		}
+		}
+	}
+	return result;
+}
+
+}
@@ -0,0 +1,209 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_METRICS_H
+#define QUTIM_SDK_0_3_METRICS_H
+
+#include "libqutim_global.h"
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+namespace qutim_sdk_0_3
+{
+
+class Account;
+
+class LIBQUTIM_EXPORT Metric
+{
+	Q_DISABLE_COPY(Metric)
+public:
+	enum Type
+	{
+		CounterType,
+		GaugeType,
+		HistogramType
+	};
+
+	virtual ~Metric();
+
+	Type type() const { return m_type; }
+	QByteArray name() const { return m_name; }
+	// Comma separated list of key="value" pairs, may be empty
+	QByteArray labels() const { return m_labels; }
+
+protected:
+	Metric(Type type, const QByteArray &name, const QByteArray &labels);
+
+private:
+	Type m_type;
+	QByteArray m_name;
+	QByteArray m_labels;
+};
+
+class LIBQUTIM_EXPORT Counter : public Metric
+{
+public:
+	void add(qint64 value = 1) { m_value.fetchAndAddRelaxed(value); }
+	qint64 value() const { return m_value.load(); }
+
+private:
+	friend class Metrics;
+	Counter(const QByteArray &name, const QByteArray &labels);
+	QAtomicInteger<qint64> m_value;
+};
+
+class LIBQUTIM_EXPORT Gauge : public Metric
+{
+public:
+	void set(qint64 value) { m_value.store(value); }
+	void add(qint64 value) { m_value.fetchAndAddRelaxed(value); }
+	qint64 value() const { return m_value.load(); }
+
+private:
+	friend class Metrics;
+	Gauge(const QByteArray &name, const QByteArray &labels);
+	QAtomicInteger<qint64> m_value;
+};
+
+/**
+ * Distribution of observed values, usually durations in microseconds.
+ * Bucket i counts values up to 2^i, the last one counts all the rest.
+ */
+class LIBQUTIM_EXPORT Histogram : public Metric
+{
+public:
+	enum { BucketCount = 28 };
+
+	void observe(qint64 value);
+	qint64 count() const { return m_count.load(); }
+	qint64 sum() const { return m_sum.load(); }
+	qint64 bucket(int index) const { return m_buckets[index].load(); }
+	// Upper bound of the bucket, -1 for the last one
+	static qint64 bucketBound(int index);
+	// Approximate value, which is not exceeded by given share of observations
+	qint64 quantile(double share) const;
+
+private:
+	friend class Metrics;
+	Histogram(const QByteArray &name, const QByteArray &labels);
+	QAtomicInteger<qint64> m_buckets[BucketCount];
+	QAtomicInteger<qint64> m_count;
+	QAtomicInteger<qint64> m_sum;
+};
+
+/**
+ * Process-wide registry of runtime metrics.
+ *
+ * Metrics are created on the first request and live until exit, so callers
+ * keep returned pointers, usually in static variables. Updates are lock-free
+ * and may be done from any thread.
+ *
+ * @code
+ * static Counter *saves = Metrics::counter("qutim_config_saves_total");
+ * saves->add();
+ * @endcode
+ */
+class LIBQUTIM_EXPORT Metrics
+{
+public:
+	static Counter *counter(const char *name, const QString &labels = QString());
+	static Gauge *gauge(const char *name, const QString &labels = QString());
+	static Histogram *histogram(const char *name, const QString &labels = QString());
+
+	// Returns escaped key="value" pair
+	static QString label(const char *key, const QString &value);
+	// Labels of per-account metrics
+	static QString accountLabels(const Account *account);
+
+	// Prometheus text exposition format
+	static QByteArray toText();
+	// Names with labels mapped to values, histograms are maps of count, sum,
+	// p50, p99 and cumulative buckets
+	static QVariantMap toMap();
+};
+
+/**
+ * Network I/O metrics of the account, shared by all its connections.
+ *
+ * Default constructed object is not bound to any account and must not be
+ * updated. Queue length is changed by deltas, as several connections of
+ * the account may have own outgoing queues.
+ */
+class LIBQUTIM_EXPORT SocketMetrics
+{
+public:
+	SocketMetrics();
+	explicit SocketMetrics(const Account *account);
+
+	bool isValid() const { return m_receivedBytes; }
+
+	void received(qint64 bytes, qint64 packets = 0)
+	{
+		m_receivedBytes->add(bytes);
+		m_receivedPackets->add(packets);
+	}
+	void sent(qint64 bytes, qint64 packets = 1)
+	{
+		m_sentBytes->add(bytes);
+		m_sentPackets->add(packets);
+	}
+	void queued(int delta) { m_queueLength->add(delta); }
+	// Time spent by the packet in the outgoing queue in microseconds
+	void dequeued(qint64 delay)
+	{
+		m_queueLength->add(-1);
+		m_queueDelay->observe(delay);
+	}
+	// Time from connection start till it was established in milliseconds
+	void connected(qint64 latency) { m_connectLatency->observe(latency); }
+	void connectFailed() { m_connectFailures->add(); }
+
+private:
+	Counter *m_receivedBytes;
+	Counter *m_sentBytes;
+	Counter *m_receivedPackets;
+	Counter *m_sentPackets;
+	Gauge *m_queueLength;
+	Histogram *m_queueDelay;
+	Histogram *m_connectLatency;
+	Counter *m_connectFailures;
+};
+
+// Observes time spent by the scope in microseconds
+class MetricTimer
+{
+	Q_DISABLE_COPY(MetricTimer)
+public:
+	MetricTimer(Histogram *histogram) : m_histogram(histogram) { m_timer.start(); }
+	~MetricTimer() { m_histogram->observe(m_timer.nsecsElapsed() / 1000); }
+private:
+	Histogram *m_histogram;
+	QElapsedTimer m_timer;
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_METRICS_H
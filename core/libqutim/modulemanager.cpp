@@ -42,6 +42,8 @@
 #include "servicemanager_p.h"
 #include "libqutim_version.h"
 #include "sound_p.h"
+#include "executor.h"
+#include "startuptrace_p.h"
 #include <QPluginLoader>
 #include <QSettings>
 #include <QDir>
@@ -54,6 +56,12 @@
 #include <QTime>
 #include <QQueue>
 #include <QUrl>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QJsonObject>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <qendian.h>
 #include "objectgenerator.h"
 
@@ -253,6 +261,155 @@ static bool checkQutIMPluginData(const char *data, quint64 *debugId, QString *er
 	return isValidPattern && isValidQutimVersion;
 }
 
+struct PluginCheck
+{
+	enum Status
+	{
+		Valid,
+		// Library can't be opened now, probably it depends on plugin which is not loaded yet
+		LoadFailed,
+		Invalid,
+		// Some other Qt plugin, not worth opening
+		Foreign
+	};
+
+	PluginCheck() : status(Valid), debugId(0), loadTime(0), verifyTime(0), verified(false) {}
+
+	QFileInfo fileInfo;
+	QString fileName;
+	QString error;
+	Status status;
+	quint64 debugId;
+	int loadTime;
+	int verifyTime;
+	// Result is known from plugin cache, library only has to be opened
+	bool verified;
+};
+
+struct PluginCacheEntry
+{
+	qint64 size;
+	qint64 modified;
+	quint8 status;
+	quint64 debugId;
+	QString error;
+};
+
+typedef QHash<QString, PluginCacheEntry> PluginCache;
+
+enum { PluginCacheMagic = 0x51504c43, PluginCacheVersion = 1 };
+
+// Plugins are loaded before profile is chosen, so cache is shared by all profiles
+static QString pluginCacheFileName()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+			+ QStringLiteral("/plugins.cache");
+}
+
+static PluginCache loadPluginCache()
+{
+	PluginCache cache;
+	QFile file(pluginCacheFileName());
+	if (!file.open(QIODevice::ReadOnly))
+		return cache;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, version;
+	QByteArray libqutimVersion;
+	in >> magic >> version >> libqutimVersion;
+	// Verification result depends on libqutim's version too
+	if (magic != PluginCacheMagic || version != PluginCacheVersion || libqutimVersion != versionString())
+		return cache;
+	quint32 count;
+	in >> count;
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		QString fileName;
+		PluginCacheEntry entry;
+		in >> fileName >> entry.size >> entry.modified >> entry.status >> entry.debugId >> entry.error;
+		cache.insert(fileName, entry);
+	}
+	if (in.status() != QDataStream::Ok)
+		cache.clear();
+	return cache;
+}
+
+static void savePluginCache(const PluginCache &cache)
+{
+	const QString fileName = pluginCacheFileName();
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qWarning() << "Can't save plugin cache" << fileName;
+		return;
+	}
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint32(PluginCacheMagic) << quint32(PluginCacheVersion)
+		<< QByteArray(versionString()) << quint32(cache.size());
+	for (PluginCache::const_iterator it = cache.constBegin(); it != cache.constEnd(); ++it) {
+		const PluginCacheEntry &entry = it.value();
+		out << it.key() << entry.size << entry.modified << entry.status << entry.debugId << entry.error;
+	}
+	file.commit();
+}
+
+// Runs at worker thread, metadata is read from the file without loading it,
+// so no code of the plugin is executed here
+static void inspectPlugin(PluginCheck *check)
+{
+	if (check->verified)
+		return;
+	StartupTrace::Scope trace("plugin", QStringLiteral("inspect ") + check->fileInfo.fileName());
+	QPluginLoader loader(check->fileName);
+	const QString iid = loader.metaData().value(QStringLiteral("IID")).toString();
+	if (!iid.isEmpty() && iid != QLatin1String("org.qutim.Plugin"))
+		check->status = PluginCheck::Foreign;
+}
+
+// Runs at main thread, as static initializers of the library may create
+// global QObjects, which must not get affinity of a worker thread
+static void loadPlugin(PluginCheck *check)
+{
+	const QString &filename = check->fileName;
+	StartupTrace::Scope trace("plugin", QStringLiteral("open ") + check->fileInfo.fileName());
+	if (check->verified) {
+		QLibrary lib(filename);
+		if (!lib.load()) {
+			check->status = PluginCheck::LoadFailed;
+			check->error = lib.errorString();
+		}
+		return;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	// Just don't load old plugins
+	typedef const char * (*QutimPluginVerificationFunction)();
+	QScopedPointer<QLibrary> lib(new QLibrary(filename));
+	if (!lib->load()) {
+		check->status = PluginCheck::LoadFailed;
+		check->error = lib->errorString();
+		return;
+	}
+	check->loadTime = timer.restart();
+	QutimPluginVerificationFunction verificationFunction = reinterpret_cast<QutimPluginVerificationFunction>(
+				lib->resolve("qutim_plugin_query_verification_data"));
+	if (!verificationFunction) {
+		lib->unload();
+		check->status = PluginCheck::Invalid;
+		check->error = filename + " has no valid verification data";
+		return;
+	}
+	QString error;
+	if (!checkQutIMPluginData(verificationFunction(), &check->debugId, &error)) {
+		lib->unload();
+		check->status = PluginCheck::Invalid;
+		check->error = "Error while loading plugin " + filename + ": " + error;
+		return;
+	}
+	check->verifyTime = timer.elapsed();
+}
+
 void ModuleManagerPrivate::initLocalPeer(const QString &message, bool *shouldExit)
 {
 	*shouldExit = false;
@@ -322,6 +479,8 @@ ModuleManager::~ModuleManager()
   */
 void ModuleManager::loadPlugins(const QStringList &additional_paths)
 {
+	// Tracing is enabled by command line, so remember the start time beforehand
+	const qint64 traceStart = StartupTrace::timestamp();
 #ifndef NO_COMMANDS
 	const QStringList args = qApp->arguments();
 
@@ -348,6 +507,9 @@ void ModuleManager::loadPlugins(const QStringList &additional_paths)
 	QCommandLineOption configDir("config", "Custom config directory", "path");
 	parser.addOption(configDir);
 
+	QCommandLineOption traceStartup("trace-startup", "Write startup timeline in Chrome trace format", "file");
+	parser.addOption(traceStartup);
+
 	if(!parser.parse(args)) {
 		parser.showHelp(0);
 		exit(0);
@@ -385,6 +547,9 @@ void ModuleManager::loadPlugins(const QStringList &additional_paths)
 		Profile::instance()->setCustomProfilePath(parser.value("config"));
 	}
 
+	if (parser.isSet(traceStartup))
+		StartupTrace::setOutput(parser.value(traceStartup));
+
 	if (!messageToServer.isEmpty()) {
 		bool shouldExit = false;
 		d->initLocalPeer(messageToServer, &shouldExit);
@@ -467,59 +632,91 @@ void ModuleManager::loadPlugins(const QStringList &additional_paths)
 	QSet<QString> pluginPathsList;
 	QMap<QString, QString> errors;
 
+	// Metadata of libraries is read in parallel, so foreign Qt plugins are
+	// skipped without opening them. Libraries are opened and plugin
+	// instances are created at main thread in original order, as static
+	// initializers and init() may create QObjects
+	Executor *executor = Executor::named(QStringLiteral("plugins"), QThread::idealThreadCount());
+	const PluginCache cache = loadPluginCache();
+	PluginCache updatedCache;
+	bool cacheChanged = false;
+
 	foreach (const QString &path, paths) {
 		QDir plugins_dir = path;
 		QFileInfoList files = plugins_dir.entryInfoList(QDir::AllEntries);
 		QFileInfoList nextTry;
 		forever {
+			QList<PluginCheck> checks;
 			for (int i = 0; i < files.count(); ++i) {
 				QString filename = files[i].canonicalFilePath();
 				if(pluginPathsList.contains(filename) || !QLibrary::isLibrary(filename) || !files[i].isFile())
 					continue;
 				pluginPathsList << filename;
-				// Just don't load old plugins
-				typedef const char * (*QutimPluginVerificationFunction)();
-				QutimPluginVerificationFunction verificationFunction = NULL;
+				PluginCheck check;
+				check.fileInfo = files[i];
+				check.fileName = filename;
+				PluginCache::const_iterator it = cache.constFind(filename);
+				if (it != cache.constEnd() && it->size == files[i].size()
+						&& it->modified == files[i].lastModified().toMSecsSinceEpoch()) {
+					check.status = static_cast<PluginCheck::Status>(it->status);
+					check.debugId = it->debugId;
+					check.error = it->error;
+					check.verified = true;
+				}
+				checks << check;
+			}
+			for (int i = 0; i < checks.size(); ++i) {
+				PluginCheck *check = &checks[i];
+				if (check->status != PluginCheck::Valid)
+					continue;
+				executor->run([check] () { inspectPlugin(check); });
+			}
+			executor->waitForDone();
+			for (int i = 0; i < checks.size(); ++i) {
+				if (checks.at(i).status == PluginCheck::Valid)
+					loadPlugin(&checks[i]);
+			}
+
+			for (int i = 0; i < checks.size(); ++i) {
+				const PluginCheck &check = checks.at(i);
+				if (check.status == PluginCheck::LoadFailed || check.verified) {
+					if (check.verified && check.status != PluginCheck::LoadFailed)
+						updatedCache.insert(check.fileName, cache.value(check.fileName));
+					continue;
+				}
+				cacheChanged = true;
+				PluginCacheEntry entry;
+				entry.size = check.fileInfo.size();
+				entry.modified = check.fileInfo.lastModified().toMSecsSinceEpoch();
+				entry.status = check.status;
+				entry.debugId = check.debugId;
+				entry.error = check.error;
+				updatedCache.insert(check.fileName, entry);
+			}
+
+			for (int i = 0; i < checks.size(); ++i) {
+				const PluginCheck &check = checks.at(i);
+				const QString &filename = check.fileName;
+				if (check.status == PluginCheck::LoadFailed) {
+					errors.insert(filename, check.error);
+					nextTry << check.fileInfo;
+					pluginPathsList.remove(filename);
+					continue;
+				}
+				errors.remove(filename);
+				if (check.status == PluginCheck::Invalid) {
+					errors.insert(filename, check.error);
+					continue;
+				} else if (check.status == PluginCheck::Foreign) {
+					continue;
+				}
+				const quint64 debugId = check.debugId;
+				StartupTrace::Scope trace("plugin", QStringLiteral("init ") + check.fileInfo.fileName());
 #ifdef QUTIM_TEST_PERFOMANCE
 				QTime timer;
-				int libLoadTime, verifyTime, instanceTime, initTime;
-				quint64 debugId = 0;
-#endif // QUTIM_TEST_PERFOMANCE
-				{
-#ifdef QUTIM_TEST_PERFOMANCE
-					timer.start();
-#endif // QUTIM_TEST_PERFOMANCE
-					QScopedPointer<QLibrary> lib(new QLibrary(filename));
-					if (lib->load()) {
-						errors.remove(filename);
-#ifdef QUTIM_TEST_PERFOMANCE
-						libLoadTime = timer.elapsed();
-						timer.restart();
-#endif // QUTIM_TEST_PERFOMANCE
-						verificationFunction = reinterpret_cast<QutimPluginVerificationFunction>(
-									lib->resolve("qutim_plugin_query_verification_data"));
-#ifdef QUTIM_TEST_PERFOMANCE
-						verifyTime = timer.elapsed();
-						timer.restart();
+				int instanceTime, initTime;
+				timer.start();
 #endif // QUTIM_TEST_PERFOMANCE
-						if (!verificationFunction) {
-							lib->unload();
-							errors.insert(filename, filename + " has no valid verification data");
-							continue;
-						}
-						QString error;
-						if (!checkQutIMPluginData(verificationFunction(), &debugId, &error)) {
-							lib->unload();
-							errors.insert(filename, "Error while loading plugin " + filename + ": " + error);
-							continue;
-						}
-					} else {
-						errors.insert(filename, lib->errorString());
-						nextTry << files[i];
-						pluginPathsList.remove(filename);
-						continue;
-					}
-				}
 				QPluginLoader *loader = new QPluginLoader(filename);
 				QObject *object = loader->instance();
 #ifdef QUTIM_TEST_PERFOMANCE
@@ -532,8 +729,8 @@ void ModuleManager::loadPlugins(const QStringList &additional_paths)
 					plugin->init();
 #ifdef QUTIM_TEST_PERFOMANCE
 					initTime = timer.elapsed();
-					qDebug() << files[i].fileName();
-                    qDebug() << "load:" << libLoadTime << "ms, verify:" << verifyTime
+					qDebug() << check.fileInfo.fileName();
+                    qDebug() << "load:" << check.loadTime << "ms, verify:" << check.verifyTime
 							<< "ms, instance:" << instanceTime << "ms, init:" << initTime << "ms";
 #endif // QUTIM_TEST_PERFOMANCE
                     if (plugin->p->validate()) {
@@ -573,6 +770,10 @@ void ModuleManager::loadPlugins(const QStringList &additional_paths)
 			qDebug() << error;
 	}
 
+	// Entries of removed libraries are dropped as well
+	if (cacheChanged || updatedCache.size() != cache.size())
+		savePluginCache(updatedCache);
+
 #ifndef NO_COMMANDS
 //	{
 //		QMap<QString, Plugin *> handlers;
@@ -610,6 +811,7 @@ void ModuleManager::loadPlugins(const QStringList &additional_paths)
 		addExtension(info);
         d->extensionsHash.insert(info.generator()->metaObject()->className(), info);
 	}
+	StartupTrace::complete("startup", QStringLiteral("loadPlugins"), traceStart, StartupTrace::timestamp());
 }
 
 ExtensionInfoList ModuleManager::extensions(const char *iid) const
@@ -663,6 +865,7 @@ QObject *ModuleManager::initExtension(const QMetaObject *meta)
   */
 void ModuleManager::initExtensions()
 {
+	const qint64 traceStart = StartupTrace::timestamp();
 	Q_UNUSED(Sound::instance());
 	// TODO: remove old API and this hack
 	QList<ConfigBackend*> &configBackends = get_config_backends();
@@ -718,6 +921,7 @@ void ModuleManager::initExtensions()
 				if (name.isEmpty() || name != it.key())
 					continue;
 				qDebug() << name << meta->className();
+				StartupTrace::Scope trace("protocol", QString::fromLatin1(meta->className()));
 				Protocol *protocol = info.generator()->generate<Protocol>();
 				AccountManagerPrivate::getPrivate(&d->accountManager)->addProtocol(protocol);
 				choosedProtocols.insert(it.key());
@@ -734,6 +938,7 @@ void ModuleManager::initExtensions()
 			QString name = QLatin1String(MetaObjectBuilder::info(meta, "Protocol"));
             if (name.isEmpty() || choosedProtocols.contains(name))
 				continue;
+			StartupTrace::Scope trace("protocol", QString::fromLatin1(meta->className()));
 			Protocol *protocol = gen->generate<Protocol>();
 			AccountManagerPrivate::getPrivate(&d->accountManager)->addProtocol(protocol);
 			choosedProtocols.insert(name);
@@ -757,7 +962,10 @@ void ModuleManager::initExtensions()
 			}
 		}
 	}
-	ServiceManagerPrivate::get(ServiceManager::instance())->init();
+	{
+		StartupTrace::Scope trace("startup", QStringLiteral("services"));
+		ServiceManagerPrivate::get(ServiceManager::instance())->init();
+	}
 #ifndef Q_OS_MAC
 	qApp->setWindowIcon(Icon("qutim"));
 #endif
@@ -772,6 +980,7 @@ void ModuleManager::initExtensions()
 			QTime timer;
 			timer.start();
 #endif
+			StartupTrace::Scope trace("startup", QString::fromLatin1(exts.at(i).generator()->metaObject()->className()));
 			exts.at(i).generator()->generate<StartupModule>();
 #ifdef QUTIM_TEST_PERFOMANCE
 			qDebug() << "Startup:" << exts.at(i).generator()->metaObject()->className() << "," << timer.elapsed() << "ms";
@@ -779,11 +988,24 @@ void ModuleManager::initExtensions()
 		}
 	}
 
+	{
+		// Account configs keep rosters, so they are parsed in parallel
+		// while protocols create their accounts one by one
+		StartupTrace::Scope trace("account", QStringLiteral("preload"));
+		QStringList paths;
+		foreach (Protocol *proto, Protocol::all()) {
+			foreach (const QString &id, proto->config("general").value("accounts", QStringList()))
+				paths << proto->id() + QLatin1Char('.') + id + QLatin1String("/account");
+		}
+		Config::preload(paths);
+	}
+
 	foreach(Protocol *proto, Protocol::all()) {
 #ifdef QUTIM_TEST_PERFOMANCE
 		QTime timer;
 		timer.start();
 #endif
+		StartupTrace::Scope trace("account", QStringLiteral("loadAccounts ") + proto->id());
 		proto->loadAccounts();
 #ifdef QUTIM_TEST_PERFOMANCE
 		qDebug() << proto->id() << ", load:" << timer.elapsed() << "ms";
@@ -802,6 +1024,7 @@ void ModuleManager::initExtensions()
 				QTime timer;
 				timer.start();
 #endif
+				StartupTrace::Scope trace("plugin", QStringLiteral("load ") + QString::fromLatin1(plugin->metaObject()->className()));
 				if (plugin->load()) {
 					plugin->info().data()->loaded = 1;
 				} else {
@@ -828,10 +1051,13 @@ void ModuleManager::initExtensions()
 		qDebug() << i << d->plugins.size() << d->plugins.at(i).data()->metaObject()->className();
 	}
 	Event("startup").send();
+	StartupTrace::complete("startup", QStringLiteral("initExtensions"), traceStart, StartupTrace::timestamp());
+	StartupTrace::flush();
 }
 
 void ModuleManager::onQuit()
 {
+	StartupTrace::flush();
 	foreach (Account *account, d->accountManager.accounts()) {
 		Status status = account->status();
 		account->config().setValue("lastStatus", status);
@@ -0,0 +1,119 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "networkaccess.h"
+#include "networkproxy.h"
+#include "sslcontext.h"
+#include "systeminfo.h"
+#include "config.h"
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QNetworkProxy>
+#include <QThreadStorage>
+#include <QThread>
+#include <QMutex>
+#include <QTimer>
+#include <QDir>
+
+namespace qutim_sdk_0_3
+{
+
+struct NetworkAccessScope
+{
+	QMutex mutex;
+	QList<QNetworkAccessManager*> managers;
+	// Deletes manager of every thread on its exit
+	QThreadStorage<QNetworkAccessManager*> local;
+};
+
+Q_GLOBAL_STATIC(NetworkAccessScope, scope)
+
+static QNetworkProxy globalProxy()
+{
+	QNetworkProxy proxy = NetworkProxyManager::toNetworkProxy(NetworkProxyManager::settings());
+	// Disabled proxy means system defaults, not the direct connection
+	if (proxy.type() == QNetworkProxy::NoProxy)
+		proxy.setType(QNetworkProxy::DefaultProxy);
+	return proxy;
+}
+
+static QNetworkAccessManager *createManager()
+{
+	QNetworkAccessManager *manager = new QNetworkAccessManager;
+	if (QThread::currentThread() == qApp->thread()) {
+		// QNetworkDiskCache can't be used by several threads
+		Config config(QLatin1String("network"));
+		QNetworkDiskCache *cache = new QNetworkDiskCache(manager);
+		cache->setCacheDirectory(SystemInfo::getDir(SystemInfo::ConfigDir)
+								 .filePath(QLatin1String("cache/network")));
+		cache->setMaximumCacheSize(config.value(QLatin1String("cacheSize"), 50) * 1024 * 1024);
+		manager->setCache(cache);
+	}
+	manager->setProxy(globalProxy());
+
+	NetworkAccessScope *d = scope();
+	QMutexLocker locker(&d->mutex);
+	d->managers << manager;
+	QObject::connect(manager, &QObject::destroyed, [d, manager] () {
+		QMutexLocker locker(&d->mutex);
+		d->managers.removeOne(manager);
+	});
+	return manager;
+}
+
+QNetworkAccessManager *NetworkAccess::manager()
+{
+	NetworkAccessScope *d = scope();
+	if (!d->local.hasLocalData())
+		d->local.setLocalData(createManager());
+	return d->local.localData();
+}
+
+QNetworkRequest NetworkAccess::request(const QUrl &url)
+{
+	QNetworkRequest request(url);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+	request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+	// Shares CA bundle and lets the manager resume TLS sessions
+	request.setSslConfiguration(SslContext::configuration());
+#endif
+	return request;
+}
+
+void NetworkAccess::updateProxy()
+{
+	const QNetworkProxy proxy = globalProxy();
+	NetworkAccessScope *d = scope();
+	QMutexLocker locker(&d->mutex);
+	foreach (QNetworkAccessManager *manager, d->managers) {
+		// Managers are used only by their own threads
+		QTimer::singleShot(0, manager, [manager, proxy] () {
+			manager->setProxy(proxy);
+		});
+	}
+}
+
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_NETWORKACCESS_H
+#define QUTIM_SDK_0_3_NETWORKACCESS_H
+
+#include "libqutim_global.h"
+#include <QNetworkRequest>
+
+class QNetworkAccessManager;
+
+namespace qutim_sdk_0_3
+{
+
+/**
+ * Network access shared by plugins, so they share connection pools, DNS
+ * lookups and HTTP cache instead of creating own managers.
+ *
+ * There is one QNetworkAccessManager per thread, it's owned by libqutim and
+ * must not be deleted. Manager of the main thread has a disk cache in
+ * "<config dir>/cache/network" limited by "network/cacheSize" (MiB).
+ * Global proxy from NetworkProxyManager::settings() is applied to every one.
+ *
+ * Requests made by request() allow HTTP/2. Connections per host are limited
+ * by QNetworkAccessManager itself, so sharing one manager keeps the limit
+ * for the whole application.
+ */
+class LIBQUTIM_EXPORT NetworkAccess
+{
+public:
+	static QNetworkAccessManager *manager();
+	static QNetworkRequest request(const QUrl &url);
+	// Reapplies global proxy settings to all managers
+	static void updateProxy();
+private:
+	NetworkAccess();
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_NETWORKACCESS_H
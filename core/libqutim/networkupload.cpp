@@ -0,0 +1,339 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "networkupload.h"
+#include <QNetworkAccessManager>
+#include <QHttpMultiPart>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QBuffer>
+#include <QTimer>
+
+namespace qutim_sdk_0_3
+{
+
+enum {
+	UploadProgressInterval = 250,
+	UploadRetryDelay = 1000,
+	UploadMaxChunkSize = 8 * 1024 * 1024
+};
+
+class NetworkUploadPrivate
+{
+	Q_DECLARE_PUBLIC(NetworkUpload)
+public:
+	NetworkUploadPrivate(NetworkUpload *q) :
+		q_ptr(q), verb("PUT"), multipart(false), chunkSize(0), maxRetries(3),
+		device(0), total(0), offset(0), size(0), attempt(0) {}
+	void send();
+	QNetworkReply *sendPlain(QNetworkRequest request);
+	QNetworkReply *sendMultipart(const QNetworkRequest &request);
+	QNetworkReply *sendChunk(QNetworkRequest request);
+	void onProgress(qint64 sent);
+	void onFinished();
+	bool isTransient(QNetworkReply *reply) const;
+	void finish(QNetworkReply *reply);
+
+	NetworkUpload *q_ptr;
+	QPointer<QNetworkAccessManager> manager;
+	QNetworkRequest request;
+	QByteArray verb;
+	bool multipart;
+	QByteArray fileField;
+	QString fileName;
+	QByteArray contentType;
+	NetworkUpload::FormFields fields;
+	qint64 chunkSize;
+	int maxRetries;
+	QIODevice *device;
+	QPointer<QNetworkReply> reply;
+	// Total size of the device, acknowledged offset and size of current chunk
+	qint64 total;
+	qint64 offset;
+	qint64 size;
+	int attempt;
+	QElapsedTimer progressTime;
+	QTimer retryTimer;
+};
+
+void NetworkUploadPrivate::send()
+{
+	Q_Q(NetworkUpload);
+	if (reply)
+		reply->deleteLater();
+	if (!manager) {
+		finish(0);
+		return;
+	}
+
+	if (chunkSize > 0)
+		reply = sendChunk(request);
+	else if (multipart)
+		reply = sendMultipart(request);
+	else
+		reply = sendPlain(request);
+
+	if (!reply) {
+		finish(0);
+		return;
+	}
+	QNetworkReply *current = reply;
+	QObject::connect(current, &QNetworkReply::uploadProgress, q, [this, current] (qint64 sent, qint64) {
+		if (current == reply)
+			onProgress(sent);
+	});
+	QObject::connect(current, &QNetworkReply::finished, q, [this, current] () {
+		if (current == reply)
+			onFinished();
+	});
+}
+
+QNetworkReply *NetworkUploadPrivate::sendPlain(QNetworkRequest request)
+{
+	if (!device->isSequential() && !device->seek(0))
+		return 0;
+	size = total;
+	request.setHeader(QNetworkRequest::ContentLengthHeader, total);
+	if (verb == "PUT")
+		return manager->put(request, device);
+	if (verb == "POST")
+		return manager->post(request, device);
+	return manager->sendCustomRequest(request, verb, device);
+}
+
+QNetworkReply *NetworkUploadPrivate::sendMultipart(const QNetworkRequest &request)
+{
+	if (!device->isSequential() && !device->seek(0))
+		return 0;
+	size = total;
+	QHttpMultiPart *parts = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+	foreach (const NetworkUpload::FormFields::value_type &field, fields) {
+		QHttpPart part;
+		part.setHeader(QNetworkRequest::ContentDispositionHeader,
+					   QByteArray("form-data; name=\"" + field.first + "\""));
+		part.setBody(field.second);
+		parts->append(part);
+	}
+	QHttpPart filePart;
+	filePart.setHeader(QNetworkRequest::ContentDispositionHeader,
+					   QByteArray("form-data; name=\"" + fileField + "\"; filename=\""
+								  + fileName.toUtf8() + "\""));
+	filePart.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+	// Multipart reads the device by itself, it's not copied
+	filePart.setBodyDevice(device);
+	parts->append(filePart);
+
+	QNetworkReply *result = verb == "POST"
+			? manager->post(request, parts)
+			: manager->put(request, parts);
+	parts->setParent(result);
+	return result;
+}
+
+QNetworkReply *NetworkUploadPrivate::sendChunk(QNetworkRequest request)
+{
+	size = qMin(qMin(chunkSize, qint64(UploadMaxChunkSize)), total - offset);
+	if (!device->seek(offset))
+		return 0;
+	QBuffer *buffer = new QBuffer;
+	buffer->setData(device->read(size));
+	if (buffer->size() != size) {
+		delete buffer;
+		return 0;
+	}
+	buffer->open(QIODevice::ReadOnly);
+	request.setHeader(QNetworkRequest::ContentLengthHeader, size);
+	if (size > 0) {
+		request.setRawHeader("Content-Range", "bytes " + QByteArray::number(offset)
+							 + '-' + QByteArray::number(offset + size - 1)
+							 + '/' + QByteArray::number(total));
+	}
+	QNetworkReply *result = manager->sendCustomRequest(request, verb, buffer);
+	buffer->setParent(result);
+	return result;
+}
+
+void NetworkUploadPrivate::onProgress(qint64 sent)
+{
+	Q_Q(NetworkUpload);
+	// Qt reports progress for every written block, it's too often for UI
+	if (sent < size && progressTime.isValid() && progressTime.elapsed() < UploadProgressInterval)
+		return;
+	progressTime.start();
+	emit q->progress(offset + qMin(sent, size), total);
+}
+
+bool NetworkUploadPrivate::isTransient(QNetworkReply *reply) const
+{
+	const int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if (code == 502 || code == 503 || code == 504)
+		return true;
+	if (code != 0)
+		return false;
+	switch (reply->error()) {
+	case QNetworkReply::RemoteHostClosedError:
+	case QNetworkReply::TimeoutError:
+	case QNetworkReply::TemporaryNetworkFailureError:
+	case QNetworkReply::NetworkSessionFailedError:
+	case QNetworkReply::ProxyTimeoutError:
+	case QNetworkReply::UnknownNetworkError:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void NetworkUploadPrivate::onFinished()
+{
+	if (isTransient(reply)) {
+		// Data of sequential device is already consumed and can't be resent
+		if (attempt < maxRetries && !device->isSequential()) {
+			retryTimer.start(UploadRetryDelay << attempt++);
+			return;
+		}
+		finish(reply);
+		return;
+	}
+
+	const int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	// 308 is sent by resumable protocols for accepted intermediate chunks
+	const bool accepted = reply->error() == QNetworkReply::NoError || code == 308;
+	if (chunkSize > 0 && accepted && offset + size < total) {
+		offset += size;
+		attempt = 0;
+		send();
+		return;
+	}
+	finish(reply);
+}
+
+void NetworkUploadPrivate::finish(QNetworkReply *reply)
+{
+	Q_Q(NetworkUpload);
+	device = 0;
+	emit q->finished(reply);
+}
+
+NetworkUpload::NetworkUpload(QNetworkAccessManager *manager, QObject *parent) :
+	QObject(parent), d_ptr(new NetworkUploadPrivate(this))
+{
+	Q_D(NetworkUpload);
+	d->manager = manager;
+	d->retryTimer.setSingleShot(true);
+	connect(&d->retryTimer, &QTimer::timeout, this, [d] () { d->send(); });
+}
+
+NetworkUpload::~NetworkUpload()
+{
+	abort();
+	Q_D(NetworkUpload);
+	if (d->reply)
+		d->reply->deleteLater();
+}
+
+void NetworkUpload::setRequest(const QNetworkRequest &request, const QByteArray &verb)
+{
+	Q_D(NetworkUpload);
+	d->request = request;
+	d->verb = verb;
+}
+
+QNetworkRequest NetworkUpload::request() const
+{
+	return d_func()->request;
+}
+
+void NetworkUpload::setMultipart(const QByteArray &fileField, const QString &fileName,
+								 const FormFields &fields, const QByteArray &contentType)
+{
+	Q_D(NetworkUpload);
+	d->multipart = true;
+	d->fileField = fileField;
+	d->fileName = fileName;
+	d->fields = fields;
+	d->contentType = contentType;
+}
+
+void NetworkUpload::setChunkSize(qint64 size)
+{
+	d_func()->chunkSize = qMax<qint64>(0, size);
+}
+
+qint64 NetworkUpload::chunkSize() const
+{
+	return d_func()->chunkSize;
+}
+
+void NetworkUpload::setMaxRetries(int retries)
+{
+	d_func()->maxRetries = qMax(0, retries);
+}
+
+int NetworkUpload::maxRetries() const
+{
+	return d_func()->maxRetries;
+}
+
+void NetworkUpload::start(QIODevice *device)
+{
+	Q_D(NetworkUpload);
+	abort();
+	Q_ASSERT(device && device->isOpen());
+	if (device->isSequential())
+		qWarning("NetworkUpload: sequential device is buffered into memory");
+	d->device = device;
+	d->total = device->size();
+	d->offset = 0;
+	d->size = 0;
+	d->attempt = 0;
+	d->progressTime.invalidate();
+	d->send();
+}
+
+void NetworkUpload::abort()
+{
+	Q_D(NetworkUpload);
+	d->retryTimer.stop();
+	d->device = 0;
+	if (d->reply && d->reply->isRunning()) {
+		QNetworkReply *reply = d->reply;
+		d->reply = 0;
+		reply->abort();
+		reply->deleteLater();
+	}
+}
+
+bool NetworkUpload::isActive() const
+{
+	Q_D(const NetworkUpload);
+	return d->device != 0;
+}
+
+QNetworkReply *NetworkUpload::reply() const
+{
+	return d_func()->reply;
+}
+
+}
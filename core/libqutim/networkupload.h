@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_NETWORKUPLOAD_H
+#define QUTIM_SDK_0_3_NETWORKUPLOAD_H
+
+#include "libqutim_global.h"
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QPair>
+
+class QIODevice;
+class QNetworkAccessManager;
+
+namespace qutim_sdk_0_3
+{
+
+class NetworkUploadPrivate;
+
+/**
+ * Uploads content of QIODevice by http without reading it into memory.
+ *
+ * Device is sent as a request body or as a file part of multipart/form-data.
+ * It must be opened and random access, Qt buffers the whole content of
+ * sequential devices itself.
+ *
+ * If service accepts partial uploads, setChunkSize() makes the file to be
+ * sent by chunks with Content-Range header. Only one chunk is held in memory
+ * at the time and network failure resends only the unacknowledged one.
+ * Otherwise failed upload is restarted from the beginning.
+ * Either way there are at most maxRetries() attempts after transient
+ * network errors, http errors are reported as is.
+ *
+ * progress() is emitted at most a few times per second.
+ */
+class LIBQUTIM_EXPORT NetworkUpload : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(NetworkUpload)
+public:
+	typedef QList<QPair<QByteArray, QByteArray> > FormFields;
+
+	NetworkUpload(QNetworkAccessManager *manager, QObject *parent = 0);
+	~NetworkUpload();
+
+	void setRequest(const QNetworkRequest &request, const QByteArray &verb = "PUT");
+	QNetworkRequest request() const;
+	// Sends device as @a fileField part with @a fileName, @a fields go before it
+	void setMultipart(const QByteArray &fileField, const QString &fileName,
+					  const FormFields &fields = FormFields(),
+					  const QByteArray &contentType = "application/octet-stream");
+	// Zero disables chunked mode, chunks are limited by 8 MiB
+	void setChunkSize(qint64 size);
+	qint64 chunkSize() const;
+	void setMaxRetries(int retries);
+	int maxRetries() const;
+
+	void start(QIODevice *device);
+	void abort();
+	bool isActive() const;
+	// Reply of the last request, it's valid until the upload is deleted or restarted
+	QNetworkReply *reply() const;
+signals:
+	void progress(qint64 sent, qint64 total);
+	void finished(QNetworkReply *reply);
+private:
+	QScopedPointer<NetworkUploadPrivate> d_ptr;
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_NETWORKUPLOAD_H
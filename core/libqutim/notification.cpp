@@ -364,16 +364,8 @@ void NotificationAction::trigger() const
 
 namespace CompiledProperty
 {
-static QList<QByteArray> names = QList<QByteArray>() << "type"
-													 << "text"
-													 << "title"
-													 << "object"
-													 << "image"
-													 << "actions";
-static QList<Getter> getters   = QList<Getter>() //TODO
-;
-static QList<Setter> setters   = QList<Setter>() //TODO
-;
+// Members of the request have their own accessors, so all properties are dynamic
+static const Table table(0, 0, 0, 0);
 }
 
 NotificationRequest::NotificationRequest() :
@@ -516,12 +508,12 @@ bool NotificationRequest::isBackendBlocked(const QByteArray &backendType)
 
 QVariant NotificationRequest::property(const char *name, const QVariant &def) const
 {
-	return d_ptr->property(name, def, CompiledProperty::names, CompiledProperty::getters);
+	return d_ptr->property(name, def, CompiledProperty::table);
 }
 
 void NotificationRequest::setProperty(const char *name, const QVariant &value)
 {
-	d_ptr->setProperty(name, value, CompiledProperty::names, CompiledProperty::setters);
+	d_ptr->setProperty(name, value, CompiledProperty::table);
 }
 
 void NotificationRequest::addAction(const NotificationAction &action_helper)
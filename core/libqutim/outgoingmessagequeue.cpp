@@ -0,0 +1,368 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "outgoingmessagequeue.h"
+#include "account.h"
+#include "chatsession.h"
+#include "message.h"
+#include "config.h"
+#include <QBasicTimer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QQueue>
+#include <QTimerEvent>
+
+namespace qutim_sdk_0_3
+{
+
+enum { RetryInterval = 500, ReceiptCheckInterval = 1000 };
+
+class OutgoingMessageQueuePrivate
+{
+public:
+	struct Waiting
+	{
+		Message message;
+		QPointer<ChatUnit> unit;
+		// Units of messages restored from config are resolved at sending
+		QString unitId;
+	};
+
+	struct Pending
+	{
+		QPointer<ChatUnit> unit;
+		qint64 deadline;
+	};
+
+	bool isOnline() const;
+	void post(ChatUnit *unit, quint64 id, bool success);
+	void expire(qint64 now);
+	void scheduleFlush(OutgoingMessageQueue *q, int msec);
+	void save();
+	void load();
+
+	Account *account;
+	OutgoingMessageQueue::Sender sender;
+	QQueue<Waiting> waiting;
+	QHash<quint64, Pending> pending;
+	// Send order of pending ids, acknowledged ones are skipped lazily
+	QQueue<quint64> pendingOrder;
+	// Times of the last rateCount sends
+	QQueue<qint64> sendTimes;
+	QElapsedTimer clock;
+	QBasicTimer flushTimer;
+	QBasicTimer receiptTimer;
+	int rateCount;
+	int rateInterval;
+	int window;
+	int receiptTimeout;
+	bool failOnTimeout;
+	bool persistent;
+};
+
+bool OutgoingMessageQueuePrivate::isOnline() const
+{
+	const Status::Type type = account->status().type();
+	return type != Status::Offline && type != Status::Connecting;
+}
+
+void OutgoingMessageQueuePrivate::post(ChatUnit *unit, quint64 id, bool success)
+{
+	if (!unit)
+		return;
+	if (ChatSession *session = ChatLayer::get(unit, false))
+		QCoreApplication::postEvent(session, new MessageReceiptEvent(id, success));
+}
+
+void OutgoingMessageQueuePrivate::expire(qint64 now)
+{
+	while (!pendingOrder.isEmpty()) {
+		auto it = pending.find(pendingOrder.head());
+		if (it == pending.end()) {
+			pendingOrder.dequeue();
+			continue;
+		}
+		if (it->deadline > now)
+			break;
+		if (failOnTimeout)
+			post(it->unit, it.key(), false);
+		pending.erase(it);
+		pendingOrder.dequeue();
+	}
+	if (pendingOrder.isEmpty())
+		receiptTimer.stop();
+}
+
+void OutgoingMessageQueuePrivate::scheduleFlush(OutgoingMessageQueue *q, int msec)
+{
+	if (!flushTimer.isActive())
+		flushTimer.start(qMax(0, msec), q);
+}
+
+void OutgoingMessageQueuePrivate::save()
+{
+	if (!persistent)
+		return;
+	QVariantList list;
+	foreach (const Waiting &item, waiting) {
+		const QString unitId = item.unit ? item.unit->id() : item.unitId;
+		if (unitId.isEmpty())
+			continue;
+		QVariantMap map;
+		map.insert(QStringLiteral("unit"), unitId);
+		map.insert(QStringLiteral("text"), item.message.text());
+		const QString html = item.message.html();
+		if (!html.isEmpty())
+			map.insert(QStringLiteral("html"), html);
+		map.insert(QStringLiteral("time"), item.message.time());
+		list << map;
+	}
+	Config cfg = account->config();
+	if (list.isEmpty())
+		cfg.remove(QStringLiteral("outgoingQueue"));
+	else
+		cfg.setValue(QStringLiteral("outgoingQueue"), list);
+}
+
+void OutgoingMessageQueuePrivate::load()
+{
+	const QVariantList list = account->config().value(QStringLiteral("outgoingQueue"), QVariantList());
+	foreach (const QVariant &value, list) {
+		const QVariantMap map = value.toMap();
+		Waiting item;
+		item.unitId = map.value(QStringLiteral("unit")).toString();
+		if (item.unitId.isEmpty())
+			continue;
+		item.message.setText(map.value(QStringLiteral("text")).toString());
+		const QString html = map.value(QStringLiteral("html")).toString();
+		if (!html.isEmpty())
+			item.message.setHtml(html);
+		item.message.setTime(map.value(QStringLiteral("time")).toDateTime());
+		item.message.setIncoming(false);
+		waiting << item;
+	}
+}
+
+OutgoingMessageQueue::OutgoingMessageQueue(Account *account, const Sender &sender, QObject *parent)
+	: QObject(parent ? parent : account), d_ptr(new OutgoingMessageQueuePrivate)
+{
+	Q_D(OutgoingMessageQueue);
+	d->account = account;
+	d->sender = sender;
+	d->rateCount = 0;
+	d->rateInterval = 0;
+	d->window = 16;
+	d->receiptTimeout = 60000;
+	d->failOnTimeout = false;
+	d->persistent = false;
+	d->clock.start();
+
+	connect(account, &Account::statusChanged, this, [this] (const Status &current, const Status &) {
+		Q_D(OutgoingMessageQueue);
+		if (current.type() == Status::Offline) {
+			// Receipts don't survive reconnection
+			d->pending.clear();
+			d->pendingOrder.clear();
+			d->receiptTimer.stop();
+		} else if (d->isOnline()) {
+			d->scheduleFlush(this, 0);
+		}
+	});
+}
+
+OutgoingMessageQueue::~OutgoingMessageQueue()
+{
+}
+
+Account *OutgoingMessageQueue::account() const
+{
+	return d_func()->account;
+}
+
+void OutgoingMessageQueue::setRate(int count, int interval)
+{
+	Q_D(OutgoingMessageQueue);
+	d->rateCount = qMax(0, count);
+	d->rateInterval = qMax(0, interval);
+	d->sendTimes.clear();
+}
+
+void OutgoingMessageQueue::setWindow(int count)
+{
+	d_func()->window = qMax(1, count);
+}
+
+void OutgoingMessageQueue::setReceiptTimeout(int msec, bool failed)
+{
+	Q_D(OutgoingMessageQueue);
+	d->receiptTimeout = msec;
+	d->failOnTimeout = failed;
+}
+
+void OutgoingMessageQueue::setPersistent(bool persistent)
+{
+	Q_D(OutgoingMessageQueue);
+	if (d->persistent == persistent)
+		return;
+	d->persistent = persistent;
+	if (persistent) {
+		d->load();
+		if (!d->waiting.isEmpty() && d->isOnline())
+			d->scheduleFlush(this, 0);
+	} else {
+		d->account->config().remove(QStringLiteral("outgoingQueue"));
+	}
+}
+
+void OutgoingMessageQueue::append(const Message &message)
+{
+	Q_D(OutgoingMessageQueue);
+	OutgoingMessageQueuePrivate::Waiting item;
+	item.message = message;
+	item.unit = const_cast<ChatUnit*>(message.chatUnit());
+	d->waiting << item;
+	// Try to send it immediately, so common case doesn't wait for the loop
+	flush();
+	if (!d->waiting.isEmpty())
+		d->save();
+}
+
+bool OutgoingMessageQueue::acknowledge(quint64 id, bool success)
+{
+	Q_D(OutgoingMessageQueue);
+	auto it = d->pending.find(id);
+	if (it == d->pending.end())
+		return false;
+	d->post(it->unit, id, success);
+	d->pending.erase(it);
+	if (!d->waiting.isEmpty())
+		d->scheduleFlush(this, 0);
+	return true;
+}
+
+bool OutgoingMessageQueue::contains(quint64 id) const
+{
+	Q_D(const OutgoingMessageQueue);
+	if (d->pending.contains(id))
+		return true;
+	foreach (const OutgoingMessageQueuePrivate::Waiting &item, d->waiting) {
+		if (item.message.id() == id)
+			return true;
+	}
+	return false;
+}
+
+int OutgoingMessageQueue::count() const
+{
+	Q_D(const OutgoingMessageQueue);
+	return d->waiting.size() + d->pending.size();
+}
+
+void OutgoingMessageQueue::flush()
+{
+	Q_D(OutgoingMessageQueue);
+	d->flushTimer.stop();
+	if (!d->isOnline())
+		return;
+
+	const qint64 now = d->clock.elapsed();
+	d->expire(now);
+
+	bool changed = false;
+	while (!d->waiting.isEmpty() && d->pending.size() < d->window) {
+		if (d->rateCount > 0) {
+			while (!d->sendTimes.isEmpty() && now - d->sendTimes.head() >= d->rateInterval)
+				d->sendTimes.dequeue();
+			if (d->sendTimes.size() >= d->rateCount) {
+				d->scheduleFlush(this, d->rateInterval - (now - d->sendTimes.head()));
+				break;
+			}
+		}
+
+		OutgoingMessageQueuePrivate::Waiting &item = d->waiting.head();
+		if (!item.unit && !item.unitId.isEmpty())
+			item.unit = d->account->getUnit(item.unitId, false);
+		if (!item.unit) {
+			// Unit was removed while message was waiting
+			d->waiting.dequeue();
+			changed = true;
+			continue;
+		}
+		item.message.setChatUnit(item.unit);
+
+		const SendResult result = d->sender(item.message);
+		if (result == SendLater) {
+			d->scheduleFlush(this, RetryInterval);
+			break;
+		}
+
+		const OutgoingMessageQueuePrivate::Waiting sent = d->waiting.dequeue();
+		changed = true;
+		if (d->rateCount > 0)
+			d->sendTimes.enqueue(now);
+
+		if (result == SendAwaitingReceipt) {
+			OutgoingMessageQueuePrivate::Pending pending = { sent.unit, now + d->receiptTimeout };
+			d->pending.insert(sent.message.id(), pending);
+			d->pendingOrder.enqueue(sent.message.id());
+			if (!d->receiptTimer.isActive())
+				d->receiptTimer.start(ReceiptCheckInterval, this);
+		} else if (result == SendFailed) {
+			d->post(sent.unit, sent.message.id(), false);
+		}
+	}
+
+	if (changed)
+		d->save();
+}
+
+void OutgoingMessageQueue::clear()
+{
+	Q_D(OutgoingMessageQueue);
+	d->waiting.clear();
+	d->pending.clear();
+	d->pendingOrder.clear();
+	d->flushTimer.stop();
+	d->receiptTimer.stop();
+	d->save();
+}
+
+void OutgoingMessageQueue::timerEvent(QTimerEvent *event)
+{
+	Q_D(OutgoingMessageQueue);
+	if (event->timerId() == d->flushTimer.timerId()) {
+		flush();
+	} else if (event->timerId() == d->receiptTimer.timerId()) {
+		d->expire(d->clock.elapsed());
+		// Expired receipts free the window
+		if (!d->waiting.isEmpty() && d->pending.size() < d->window)
+			flush();
+	} else {
+		QObject::timerEvent(event);
+	}
+}
+
+}
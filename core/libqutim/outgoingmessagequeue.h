@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_OUTGOINGMESSAGEQUEUE_H
+#define QUTIM_SDK_0_3_OUTGOINGMESSAGEQUEUE_H
+
+#include "libqutim_global.h"
+#include <QObject>
+#include <QScopedPointer>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+
+class Account;
+class Message;
+class OutgoingMessageQueuePrivate;
+
+/**
+ * Queue of outgoing messages of one account.
+ *
+ * Protocol supplies only the step, which encodes and sends single message,
+ * the queue takes care of rate limit, the window of messages sent but not
+ * acknowledged yet and delivery receipts. Messages are sent only while the
+ * account is online, ones not sent yet are kept in account's config
+ * "outgoingQueue" if the queue is persistent and are sent after restart.
+ *
+ * Receipts are looked up by message id in constant time and are posted
+ * as MessageReceiptEvent to the session of the message's unit.
+ */
+class LIBQUTIM_EXPORT OutgoingMessageQueue : public QObject
+{
+	Q_OBJECT
+	Q_DECLARE_PRIVATE(OutgoingMessageQueue)
+public:
+	enum SendResult
+	{
+		// Protocol can't send it now, e.g. its own rate limit is hit
+		SendLater,
+		// Message is sent, receipt is expected
+		SendAwaitingReceipt,
+		// Message is sent, no receipt will come
+		SendDone,
+		SendFailed
+	};
+
+	typedef std::function<SendResult (const Message &message)> Sender;
+
+	explicit OutgoingMessageQueue(Account *account, const Sender &sender, QObject *parent = 0);
+	~OutgoingMessageQueue();
+
+	Account *account() const;
+
+	/**
+	 * At most @a count messages are sent for every @a interval milliseconds,
+	 * zero @a count disables the limit, which is the default.
+	 */
+	void setRate(int count, int interval);
+	// Messages awaiting receipts, new ones wait for free place, 16 by default
+	void setWindow(int count);
+	/**
+	 * Message without receipt leaves the window after @a msec, if @a failed
+	 * is true it's reported as not delivered. Default is 60 seconds.
+	 */
+	void setReceiptTimeout(int msec, bool failed = false);
+	void setPersistent(bool persistent);
+
+	void append(const Message &message);
+	/**
+	 * Reports receipt for message with given @a id, returns false if it's
+	 * unknown to the queue, e.g. it was sent before restart.
+	 */
+	bool acknowledge(quint64 id, bool success = true);
+	bool contains(quint64 id) const;
+	int count() const;
+
+public slots:
+	void flush();
+	// Drops all waiting messages and forgets pending receipts
+	void clear();
+
+protected:
+	void timerEvent(QTimerEvent *event);
+
+private:
+	QScopedPointer<OutgoingMessageQueuePrivate> d_ptr;
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_OUTGOINGMESSAGEQUEUE_H
@@ -26,6 +26,7 @@
 #include "rosterstorage.h"
 #include "objectgenerator.h"
 #include "servicemanager.h"
+#include "account.h"
 #include <QPointer>
 
 namespace qutim_sdk_0_3
@@ -36,6 +37,51 @@ class RosterStoragePrivate
 public:
 };
 
+RosterSchema::RosterSchema()
+{
+}
+
+RosterSchema::RosterSchema(const QStringList &keys) : m_keys(keys)
+{
+	for (int i = 0; i < m_keys.size(); i++)
+		m_indexes.insert(m_keys.at(i), i);
+}
+
+QVariantList RosterSchema::pack(const QVariantMap &data, QVariantMap *rest) const
+{
+	QVariantList values;
+	values.reserve(m_keys.size());
+	int known = 0;
+	for (int i = 0; i < m_keys.size(); i++) {
+		auto it = data.constFind(m_keys.at(i));
+		if (it == data.constEnd()) {
+			values << QVariant();
+		} else {
+			values << it.value();
+			known++;
+		}
+	}
+	if (rest && known < data.size()) {
+		for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+			if (!m_indexes.contains(it.key()))
+				rest->insert(it.key(), it.value());
+		}
+	}
+	// Absent trailing fields are not stored at all
+	while (!values.isEmpty() && !values.last().isValid())
+		values.removeLast();
+	return values;
+}
+
+void RosterSchema::unpack(const QVariantList &values, QVariantMap &data) const
+{
+	const int size = qMin(values.size(), m_keys.size());
+	for (int i = 0; i < size; i++) {
+		if (values.at(i).isValid())
+			data.insert(m_keys.at(i), values.at(i));
+	}
+}
+
 ContactsFactory::ContactsFactory()
 {
 }
@@ -44,12 +90,50 @@ ContactsFactory::~ContactsFactory()
 {
 }
 
+const RosterSchema *ContactsFactory::schema() const
+{
+	return 0;
+}
+
+LazyContactsFactory::LazyContactsFactory()
+{
+}
+
+LazyContactsFactory::~LazyContactsFactory()
+{
+}
+
+RosterTransaction::RosterTransaction(Account *account) : m_account(account)
+{
+	if (m_account)
+		m_account->beginRosterUpdate();
+}
+
+RosterTransaction::~RosterTransaction()
+{
+	if (m_account)
+		m_account->endRosterUpdate();
+}
+
 RosterStorage *RosterStorage::instance()
 {
 	static ServicePointer<RosterStorage> self;
 	return self.data();
 }
 
+void RosterStorage::applyDiff(Account *account, const QList<Contact*> &added,
+							  const QList<Contact*> &updated, const QList<Contact*> &removed,
+							  const QString &version)
+{
+	Q_UNUSED(account);
+	foreach (Contact *contact, added)
+		addContact(contact, version);
+	foreach (Contact *contact, updated)
+		updateContact(contact, version);
+	foreach (Contact *contact, removed)
+		removeContact(contact, version);
+}
+
 RosterStorage::RosterStorage() : d_ptr(new RosterStoragePrivate)
 {
 }
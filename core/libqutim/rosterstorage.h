@@ -27,7 +27,11 @@
 #define ROSTERSTORAGE_H
 
 #include "libqutim_global.h"
+#include "status.h"
 #include <QVariantMap>
+#include <QStringList>
+#include <QPointer>
+#include <functional>
 
 namespace qutim_sdk_0_3
 {
@@ -35,6 +39,40 @@ class RosterStoragePrivate;
 class Contact;
 class Account;
 
+/*!
+ * Fixed set of fields of roster records of some protocol.
+ *
+ * Keys are created once, so maps filled by \ref key share their data instead of
+ * allocating new strings for every contact, and storages may write records as
+ * plain lists of values in schema order.
+ */
+class LIBQUTIM_EXPORT RosterSchema
+{
+public:
+	RosterSchema();
+	explicit RosterSchema(const QStringList &keys);
+
+	int count() const { return m_keys.size(); }
+	bool isEmpty() const { return m_keys.isEmpty(); }
+	const QString &key(int field) const { return m_keys.at(field); }
+	QStringList keys() const { return m_keys; }
+	int indexOf(const QString &key) const { return m_indexes.value(key, -1); }
+
+	/*!
+	 * Packs \a data into list of values in schema order, values of keys unknown
+	 * to schema are put to \a rest.
+	 */
+	QVariantList pack(const QVariantMap &data, QVariantMap *rest = 0) const;
+	/*!
+	 * Unpacks \a values into \a data, missed trailing values are left untouched.
+	 */
+	void unpack(const QVariantList &values, QVariantMap &data) const;
+
+private:
+	QStringList m_keys;
+	QHash<QString, int> m_indexes;
+};
+
 class LIBQUTIM_EXPORT ContactsFactory : public QObject
 {
 	Q_OBJECT
@@ -43,8 +81,77 @@ public:
 	ContactsFactory();
 	virtual ~ContactsFactory();
 
+	/*!
+	 * Creates contact from stored \a data. Protocols, which keep huge rosters
+	 * in ContactStore, may return null and create the contact later.
+	 */
 	virtual Contact *addContact(const QString &id, const QVariantMap &data) = 0;
 	virtual void serialize(Contact *contact, QVariantMap &data) = 0;
+	/*!
+	 * Returns fields which \ref serialize fills, storage keeps records of
+	 * factories without schema as maps.
+	 */
+	virtual const RosterSchema *schema() const;
+};
+
+/*!
+ * Lightweight copy of roster entry, which is enough to list the contact
+ * without creating it.
+ */
+struct RosterStub
+{
+	RosterStub() : flags(0) {}
+
+	QString id;
+	QString name;
+	QStringList tags;
+	// Status at the moment entry was stored last time
+	Status status;
+	QString avatar;
+	// Protocol specific bits like subscription type
+	int flags;
+};
+
+/*!
+ * Opt-in extension of ContactsFactory for lazy roster loading.
+ *
+ * Storage keeps compact snapshot of stubs next to the roster and passes only
+ * them to \ref addStubs on load, so cold start doesn't depend on size of the
+ * stored data. Full data of the contact is read by the loader, when protocol
+ * creates it: the contact is shown, opened in a chat or changed by the server
+ * roster. Until the snapshot is built storage uses \ref addContact as usual,
+ * so protocols may switch to this factory one by one.
+ */
+class LIBQUTIM_EXPORT LazyContactsFactory : public ContactsFactory
+{
+	Q_OBJECT
+public:
+	typedef std::function<QVariantMap (const QString &id)> DataLoader;
+
+	LazyContactsFactory();
+	virtual ~LazyContactsFactory();
+
+	virtual void addStubs(const QList<RosterStub> &stubs, const DataLoader &loader) = 0;
+	/*!
+	 * Fills \a stub by stored \a data of the contact, id and status are set
+	 * by storage.
+	 */
+	virtual void fillStub(const QVariantMap &data, RosterStub &stub) = 0;
+};
+
+/*!
+ * Helper for bulk roster updates, it calls Account::beginRosterUpdate
+ * at construction and Account::endRosterUpdate at destruction.
+ */
+class LIBQUTIM_EXPORT RosterTransaction
+{
+	Q_DISABLE_COPY(RosterTransaction)
+public:
+	explicit RosterTransaction(Account *account);
+	~RosterTransaction();
+
+private:
+	QPointer<Account> m_account;
 };
 
 class LIBQUTIM_EXPORT RosterStorage : public QObject
@@ -59,6 +166,15 @@ public:
 	virtual void addContact(Contact *contact, const QString &version = QString()) = 0;
 	virtual void updateContact(Contact *contact, const QString &version = QString()) = 0;
 	virtual void removeContact(Contact *contact, const QString &version = QString()) = 0;
+	/*!
+	 * Stores difference between stored roster and the server one at once.
+	 *
+	 * Protocols should pass only really changed contacts, default implementation
+	 * calls \ref addContact, \ref updateContact and \ref removeContact for each of them.
+	 */
+	virtual void applyDiff(Account *account, const QList<Contact*> &added,
+						   const QList<Contact*> &updated, const QList<Contact*> &removed,
+						   const QString &version);
 protected:
     RosterStorage();
 	virtual ~RosterStorage();
@@ -27,6 +27,7 @@
 #include "servicemanager_p.h"
 #include "modulemanager_p.h"
 #include "metaobjectbuilder.h"
+#include "startuptrace_p.h"
 #include <QHash>
 #include <QMetaClassInfo>
 
@@ -86,6 +87,7 @@ void ServiceManagerPrivate::init(const QByteArray &service, const ExtensionInfo
 			init(id, checked.value(id), used);
 		}
 	}
+	StartupTrace::Scope trace("service", QString::fromLatin1(service));
 	QObject *object = info.generator()->generate();
 	initializationOrder << data(service);
 	initializationOrder.last()->object = object;
@@ -199,6 +201,7 @@ ServicePointerData::Ptr ServiceManager::getData(const QByteArray &name)
 	if (!data) {
 		data = QSharedPointer<ServicePointerData>::create();
 		data->name = name;
+		StartupTrace::instant("service", QStringLiteral("first request ") + QString::fromLatin1(name));
 	}
     return data.toWeakRef();
 }
@@ -27,6 +27,7 @@
 #include "config.h"
 #include "objectgenerator.h"
 #include "dglobalhotkey_p.h"
+#include <QPointer>
 
 namespace qutim_sdk_0_3
 {
@@ -60,23 +61,54 @@ namespace qutim_sdk_0_3
 		QSet<GlobalShortcut*> shortcuts;
 	};
 	
+	Q_GLOBAL_STATIC(ShortcutSelf, __self)
+
 	void GlobalShortcutInfo::update(const QKeySequence &from, const QKeySequence &to)
 	{
+		static bool connected = false;
+		if (!connected) {
+			connected = true;
+			QObject::connect(dGlobalHotKey::instance(), &dGlobalHotKey::hotKeyPressed,
+							 &ShortcutSelf::onHotKeyPressed);
+		}
+
+		QMultiHash<quint32, GlobalShortcutInfo *> &keys = __self()->globalKeys;
+		foreach (int nativeKey, contexts)
+			keys.remove(nativeKey, this);
 		contexts.clear();
 		for (uint i = 0, count = from.count(); i < count; i++) {
 			QString str = QKeySequence(from[i]).toString();
-			dGlobalHotKey::instance()->shortcut(str, false);
+			// Other shortcuts may still be bound to the same key
+			if (!keys.contains(dGlobalHotKey::instance()->id(str)))
+				dGlobalHotKey::instance()->shortcut(str, false);
 		}
 		
 		for (uint i = 0, count = to.count(); i < count; i++) {
 			QString str = QKeySequence(to[i]).toString();
 			int nativeKey = dGlobalHotKey::instance()->id(str);
-			if (dGlobalHotKey::instance()->shortcut(str, true))
+			if (keys.contains(nativeKey) || dGlobalHotKey::instance()->shortcut(str, true)) {
 				contexts.append(nativeKey);
+				keys.insert(nativeKey, this);
+			}
+		}
+	}
+
+	void ShortcutSelf::onHotKeyPressed(quint32 key)
+	{
+		const QList<GlobalShortcutInfo *> infos = __self()->globalKeys.values(key);
+		if (infos.isEmpty())
+			return;
+		// Slots may create or destroy shortcuts
+		QList<QPointer<GlobalShortcut> > shortcuts;
+		foreach (GlobalShortcutInfo *info, infos) {
+			foreach (GlobalShortcut *shortcut, info->shortcuts)
+				shortcuts << shortcut;
+		}
+		foreach (const QPointer<GlobalShortcut> &shortcut, shortcuts) {
+			if (shortcut)
+				emit shortcut->activated();
 		}
 	}
-	
-	Q_GLOBAL_STATIC(ShortcutSelf, __self)
 	
 	ShortcutSelf *self()
 	{
@@ -302,9 +334,8 @@ namespace qutim_sdk_0_3
 		}
 		if (info->global) {
 			d->info = static_cast<GlobalShortcutInfo*>(info);
+			// Hot keys are dispatched by ShortcutSelf::onHotKeyPressed
 			d->info->shortcuts.insert(this);
-			connect(dGlobalHotKey::instance(), SIGNAL(hotKeyPressed(quint32)),
-					this, SLOT(onHotKeyPressed(quint32)));
 		}
 	}
 
@@ -349,9 +380,9 @@ namespace qutim_sdk_0_3
 
 	void GlobalShortcut::onHotKeyPressed(quint32 k)
 	{
-		Q_D(GlobalShortcut);
-		if (d->info && d->info->contexts.contains(k))
-			emit activated();
+		// Kept for binary compatibility only, hot keys are dispatched
+		// by ShortcutSelf::onHotKeyPressed
+		Q_UNUSED(k);
 	}
 
 	QStringList Shortcut::ids()
@@ -78,6 +78,7 @@ public:
 signals:
 	void activated();
 private slots:
+	// Unused, kept for binary compatibility
 	void onHotKeyPressed(quint32);
 protected:
 	QScopedPointer<GlobalShortcutPrivate> d_ptr;
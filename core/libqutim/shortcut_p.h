@@ -27,11 +27,13 @@
 #define SHORTCUT_P_H
 
 #include "shortcut.h"
+#include <QMultiHash>
 #include <QSet>
 
 namespace qutim_sdk_0_3
 {
 class GeneralShortcutInfo;
+class GlobalShortcutInfo;
 
 typedef QHash<QString, GeneralShortcutInfo *> ShortcutInfoHash;
 typedef void (*ShortcutHandler)(const QString &id, const QKeySequence &sequence);
@@ -43,9 +45,12 @@ struct ShortcutSelf
 	void updateSequence(const QString &id, const QKeySequence &secuence);
 	static void addUpdateHandler(ShortcutHandler handler);
 	static void removeUpdateHandler(ShortcutHandler handler);
+	static void onHotKeyPressed(quint32 key);
 	
 	bool inited;
 	ShortcutInfoHash hash;
+	// Native hot key id to the shortcuts bound to it
+	QMultiHash<quint32, GlobalShortcutInfo *> globalKeys;
 	QList<ShortcutHandler> handlers;
 };
 }
@@ -0,0 +1,81 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "socketoptions.h"
+#include "account.h"
+#include "config.h"
+#include "systemintegration.h"
+#include <QAbstractSocket>
+
+namespace qutim_sdk_0_3
+{
+
+SocketOptions::SocketOptions()
+	: noDelay(false), keepAlive(true), keepAliveIdle(0), keepAliveInterval(0),
+	  keepAliveCount(0), receiveBuffer(0)
+{
+}
+
+SocketOptions SocketOptions::load(Account *account)
+{
+	SocketOptions options;
+	Config cfg = account->config(QStringLiteral("socket"));
+	options.noDelay = cfg.value(QStringLiteral("noDelay"), options.noDelay);
+	options.keepAlive = cfg.value(QStringLiteral("keepAlive"), options.keepAlive);
+	options.keepAliveIdle = cfg.value(QStringLiteral("keepAliveIdle"), options.keepAliveIdle);
+	options.keepAliveInterval = cfg.value(QStringLiteral("keepAliveInterval"), options.keepAliveInterval);
+	options.keepAliveCount = cfg.value(QStringLiteral("keepAliveCount"), options.keepAliveCount);
+	options.receiveBuffer = cfg.value(QStringLiteral("receiveBuffer"), options.receiveBuffer);
+	return options;
+}
+
+void SocketOptions::save(Account *account) const
+{
+	Config cfg = account->config(QStringLiteral("socket"));
+	cfg.setValue(QStringLiteral("noDelay"), noDelay);
+	cfg.setValue(QStringLiteral("keepAlive"), keepAlive);
+	cfg.setValue(QStringLiteral("keepAliveIdle"), keepAliveIdle);
+	cfg.setValue(QStringLiteral("keepAliveInterval"), keepAliveInterval);
+	cfg.setValue(QStringLiteral("keepAliveCount"), keepAliveCount);
+	cfg.setValue(QStringLiteral("receiveBuffer"), receiveBuffer);
+}
+
+void SocketOptions::apply(QAbstractSocket *socket) const
+{
+	socket->setSocketOption(QAbstractSocket::LowDelayOption, noDelay ? 1 : 0);
+	if (receiveBuffer > 0)
+		socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeOption, receiveBuffer);
+	socket->setSocketOption(QAbstractSocket::KeepAliveOption, keepAlive ? 1 : 0);
+	if (!keepAlive)
+		return;
+	// Integrations read timings from the socket itself, so they are able
+	// to apply them again on reconnection
+	socket->setProperty("keepAliveIdle", keepAliveIdle);
+	socket->setProperty("keepAliveInterval", keepAliveInterval);
+	socket->setProperty("keepAliveCount", keepAliveCount);
+	SystemIntegration::keepAlive(socket);
+}
+
+}
@@ -0,0 +1,70 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_SOCKETOPTIONS_H
+#define QUTIM_SDK_0_3_SOCKETOPTIONS_H
+
+#include "libqutim_global.h"
+
+class QAbstractSocket;
+
+namespace qutim_sdk_0_3
+{
+
+class Account;
+
+/**
+ * Per-account tuning of protocol sockets.
+ *
+ * Options are stored in "socket" group of the account's config:
+ * noDelay disables Nagle's algorithm, keepAlive enables TCP keep-alive
+ * probes sent after keepAliveIdle seconds of silence every
+ * keepAliveInterval seconds up to keepAliveCount times, receiveBuffer
+ * sets the kernel receive buffer size in bytes. Zero values mean system
+ * defaults. Keep-alive timings are applied by the platform integration
+ * handling SystemIntegration::KeepAliveSocket.
+ */
+class LIBQUTIM_EXPORT SocketOptions
+{
+public:
+	SocketOptions();
+	static SocketOptions load(Account *account);
+	void save(Account *account) const;
+
+	// Should be called once the socket is connected, as native options
+	// of unconnected sockets are lost
+	void apply(QAbstractSocket *socket) const;
+
+	bool noDelay;
+	bool keepAlive;
+	int keepAliveIdle;
+	int keepAliveInterval;
+	int keepAliveCount;
+	int receiveBuffer;
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_SOCKETOPTIONS_H
@@ -41,6 +41,11 @@ SoundBackend::SoundBackend()
 	Q_UNUSED(QT_TRANSLATE_NOOP("Service","Sound"));
 }
 
+void SoundBackend::preloadSounds(const QStringList &files)
+{
+	virtual_hook(PreloadSoundsHook, const_cast<QStringList*>(&files));
+}
+
 void SoundBackend::virtual_hook(int type, void *data)
 {
 	Q_UNUSED(type);
@@ -53,6 +58,7 @@ struct SoundPrivate
 	QList<SoundThemeBackend*> soundThemeBackends;
 	QHash<QString, SoundThemeData*> soundThemeCache;
 	QString currentTheme;
+	QString preloadedTheme;
 	SoundHandler *soundHandler;
 
 	bool soundIsInited;
@@ -66,6 +72,7 @@ struct SoundPrivate
 		soundIsInited = true;
 	}
 	inline void ensureSound() { if (!soundIsInited) initSound(); }
+	void preload(const SoundTheme &theme);
 };
 
 static SoundPrivate *p = 0;
@@ -101,6 +108,22 @@ SoundTheme &SoundTheme::operator =(const SoundTheme &other)
 	return *this;
 }
 
+void SoundPrivate::preload(const SoundTheme &theme)
+{
+	if (!soundBackend || preloadedTheme == theme.themeName())
+		return;
+	preloadedTheme = theme.themeName();
+	const QStringList formats = soundBackend->supportedFormats();
+	QStringList files;
+	for (int type = 0; type <= Notification::LastType; ++type) {
+		const QString file = theme.path(static_cast<Notification::Type>(type));
+		if (!file.isEmpty() && formats.contains(QFileInfo(file).suffix()))
+			files << file;
+	}
+	files.removeDuplicates();
+	soundBackend->preloadSounds(files);
+}
+
 QString SoundTheme::path(Notification::Type type) const
 {
 	return isNull() ? QString() : d->provider->soundPath(type);
@@ -209,7 +232,10 @@ SoundTheme Sound::theme(const QString &name)
 
 void Sound::play(Notification::Type type)
 {
-	theme().play(type);
+	SoundTheme current = theme();
+	// Backend may appear later than the theme is chosen, so check it here too
+	p->preload(current);
+	current.play(type);
 }
 
 QString Sound::currentThemeName()
@@ -233,6 +259,8 @@ void Sound::setTheme(const QString &name)
 	Config group = Config("appearance").group("sound");
 	group.setValue("theme", name);
 	p->currentTheme = name;
+	if (!name.isEmpty())
+		p->preload(theme(name));
 	emit instance()->currentThemeChanged(name);
 
 	if (!name.isEmpty()) {
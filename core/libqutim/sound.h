@@ -45,7 +45,17 @@ public:
 	virtual ~SoundBackend() {}
 	virtual void playSound(const QString &filename) = 0;
 	virtual QStringList supportedFormats() = 0;
+	/*!
+	  Hints backend that \a files are going to be played, so it can decode
+	  them in advance and drop previously preloaded ones.
+	*/
+	void preloadSounds(const QStringList &files);
 protected:
+	enum SoundBackendHook
+	{
+		// data is const QStringList*
+		PreloadSoundsHook = 1
+	};
 	virtual void virtual_hook(int type, void *data);
 };
 
@@ -46,6 +46,8 @@ public:
 	virtual ~SpellChecker();
 	/**
 	  Returns whether the \a word is spelled correctly.
+	  Checkers which set "threadSafe" property to true may be called
+	  by worker threads.
 	*/
 	virtual bool isCorrect(const QString &word) const = 0;
 	/**
@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "sslcontext.h"
+#include <QCache>
+#include <QMutex>
+#include <QSslSocket>
+
+namespace qutim_sdk_0_3
+{
+
+enum { MaxSessions = 64 };
+
+#define SESSION_KEY_PROPERTY "qutim_ssl_session_key"
+
+struct SslContextScope
+{
+	SslContextScope() : sessions(MaxSessions)
+	{
+		base = QSslConfiguration::defaultConfiguration();
+		base.setCaCertificates(base.caCertificates());
+		base.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+		base.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+		base.setOcspStaplingEnabled(true);
+#endif
+	}
+
+	QMutex mutex;
+	QSslConfiguration base;
+	QCache<QString, QByteArray> sessions;
+};
+
+Q_GLOBAL_STATIC(SslContextScope, scope)
+
+static QString sessionKey(const QString &host, quint16 port)
+{
+	return host.toLower() + QLatin1Char(':') + QString::number(port);
+}
+
+QSslConfiguration SslContext::configuration()
+{
+	SslContextScope *d = scope();
+	QMutexLocker locker(&d->mutex);
+	return d->base;
+}
+
+void SslContext::prepare(QSslSocket *socket, const QString &host, quint16 port)
+{
+	SslContextScope *d = scope();
+	const QString key = sessionKey(host, port);
+
+	QSslConfiguration config = socket->sslConfiguration();
+	{
+		QMutexLocker locker(&d->mutex);
+		config.setCaCertificates(d->base.caCertificates());
+		if (QByteArray *ticket = d->sessions.object(key))
+			config.setSessionTicket(*ticket);
+		else
+			config.setSessionTicket(QByteArray());
+	}
+	config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+	config.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+	config.setOcspStaplingEnabled(true);
+#endif
+	socket->setSslConfiguration(config);
+
+	// Sockets are often reused for reconnection, so connect only once
+	const bool connected = socket->property(SESSION_KEY_PROPERTY).isValid();
+	socket->setProperty(SESSION_KEY_PROPERTY, key);
+	if (connected)
+		return;
+	QObject::connect(socket, &QSslSocket::encrypted, [socket] () {
+		const QByteArray ticket = socket->sslConfiguration().sessionTicket();
+		if (ticket.isEmpty())
+			return;
+		SslContextScope *d = scope();
+		QMutexLocker locker(&d->mutex);
+		d->sessions.insert(socket->property(SESSION_KEY_PROPERTY).toString(), new QByteArray(ticket));
+	});
+}
+
+void SslContext::clearSessions()
+{
+	SslContextScope *d = scope();
+	QMutexLocker locker(&d->mutex);
+	d->sessions.clear();
+}
+
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QUTIM_SDK_0_3_SSLCONTEXT_H
+#define QUTIM_SDK_0_3_SSLCONTEXT_H
+
+#include "libqutim_global.h"
+#include <QSslConfiguration>
+
+class QSslSocket;
+
+namespace qutim_sdk_0_3
+{
+
+/**
+ * TLS settings shared by all connections of the application.
+ *
+ * CA bundle is loaded once and shared implicitly by every configuration.
+ * Session tickets received from servers are kept per host and port, so
+ * reconnection resumes the session instead of making full handshake.
+ * OCSP stapling is requested when Qt supports it.
+ */
+class LIBQUTIM_EXPORT SslContext
+{
+public:
+	static QSslConfiguration configuration();
+	/**
+	 * Prepares @a socket for connection to @a host, its own verify mode and
+	 * protocol are kept. Must be called before connectToHostEncrypted or
+	 * startClientEncryption.
+	 */
+	static void prepare(QSslSocket *socket, const QString &host, quint16 port);
+	// Forgets all sessions, e.g. after certificates were changed
+	static void clearSessions();
+private:
+	SslContext();
+};
+
+}
+
+#endif // QUTIM_SDK_0_3_SSLCONTEXT_H
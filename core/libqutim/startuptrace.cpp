@@ -0,0 +1,150 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "startuptrace_p.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <QCoreApplication>
+#include <QDebug>
+
+namespace qutim_sdk_0_3
+{
+
+struct StartupTraceData
+{
+	StartupTraceData() : enabled(false) { timer.start(); }
+
+	QMutex mutex;
+	QElapsedTimer timer;
+	QString fileName;
+	QJsonArray events;
+	QHash<Qt::HANDLE, int> threads;
+	bool enabled;
+
+	int threadId()
+	{
+		const Qt::HANDLE thread = QThread::currentThreadId();
+		auto it = threads.find(thread);
+		if (it == threads.end())
+			it = threads.insert(thread, threads.size() + 1);
+		return it.value();
+	}
+};
+
+Q_GLOBAL_STATIC(StartupTraceData, traceData)
+
+StartupTrace::Scope::Scope(const char *category, const QString &name)
+    : m_category(category), m_start(-1)
+{
+	if (isEnabled()) {
+		m_name = name;
+		m_start = timestamp();
+	}
+}
+
+StartupTrace::Scope::~Scope()
+{
+	if (m_start >= 0)
+		complete(m_category, m_name, m_start, timestamp());
+}
+
+void StartupTrace::setOutput(const QString &fileName)
+{
+	StartupTraceData *d = traceData();
+	QMutexLocker locker(&d->mutex);
+	d->fileName = fileName;
+	d->enabled = !fileName.isEmpty();
+}
+
+bool StartupTrace::isEnabled()
+{
+	return traceData()->enabled;
+}
+
+qint64 StartupTrace::timestamp()
+{
+	// Chrome expects microseconds
+	return traceData()->timer.nsecsElapsed() / 1000;
+}
+
+void StartupTrace::instant(const char *category, const QString &name)
+{
+	StartupTraceData *d = traceData();
+	if (!d->enabled)
+		return;
+	const qint64 ts = timestamp();
+	QMutexLocker locker(&d->mutex);
+	QJsonObject event;
+	event.insert(QStringLiteral("name"), name);
+	event.insert(QStringLiteral("cat"), QLatin1String(category));
+	event.insert(QStringLiteral("ph"), QStringLiteral("i"));
+	event.insert(QStringLiteral("s"), QStringLiteral("g"));
+	event.insert(QStringLiteral("ts"), double(ts));
+	event.insert(QStringLiteral("pid"), double(QCoreApplication::applicationPid()));
+	event.insert(QStringLiteral("tid"), d->threadId());
+	d->events.append(event);
+}
+
+void StartupTrace::complete(const char *category, const QString &name, qint64 start, qint64 end)
+{
+	StartupTraceData *d = traceData();
+	if (!d->enabled)
+		return;
+	QMutexLocker locker(&d->mutex);
+	QJsonObject event;
+	event.insert(QStringLiteral("name"), name);
+	event.insert(QStringLiteral("cat"), QLatin1String(category));
+	event.insert(QStringLiteral("ph"), QStringLiteral("X"));
+	event.insert(QStringLiteral("ts"), double(start));
+	event.insert(QStringLiteral("dur"), double(end - start));
+	event.insert(QStringLiteral("pid"), double(QCoreApplication::applicationPid()));
+	event.insert(QStringLiteral("tid"), d->threadId());
+	d->events.append(event);
+}
+
+void StartupTrace::flush()
+{
+	StartupTraceData *d = traceData();
+	if (!d->enabled)
+		return;
+	QMutexLocker locker(&d->mutex);
+	QFile file(d->fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning() << "Can't write startup trace to" << d->fileName;
+		return;
+	}
+	QJsonObject root;
+	root.insert(QStringLiteral("traceEvents"), d->events);
+	root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+	file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
+
+}
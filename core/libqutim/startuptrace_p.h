@@ -0,0 +1,64 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef STARTUPTRACE_P_H
+#define STARTUPTRACE_P_H
+
+#include "libqutim_global.h"
+
+namespace qutim_sdk_0_3
+{
+
+/*
+ * Records startup phases as Chrome trace events, see chrome://tracing.
+ * Everything is no-op until setOutput() is called by --trace-startup.
+ */
+class StartupTrace
+{
+public:
+	class Scope
+	{
+		Q_DISABLE_COPY(Scope)
+	public:
+		Scope(const char *category, const QString &name);
+		~Scope();
+	private:
+		const char *m_category;
+		QString m_name;
+		qint64 m_start;
+	};
+
+	static void setOutput(const QString &fileName);
+	static bool isEnabled();
+	static void instant(const char *category, const QString &name);
+	static void complete(const char *category, const QString &name, qint64 start, qint64 end);
+	static qint64 timestamp();
+	// Writes all events recorded so far, may be called several times
+	static void flush();
+};
+
+}
+
+#endif // STARTUPTRACE_P_H
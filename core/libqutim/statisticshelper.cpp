@@ -28,6 +28,7 @@
 #include "systeminfo.h"
 #include "libqutim_version.h"
 #include "profile.h"
+#include "networkaccess.h"
 #include <QApplication>
 #include <QLocale>
 #include <QNetworkAccessManager>
@@ -50,7 +51,6 @@ public:
 	StatisticsHelper *q_ptr;
 	QVariantMap systemInfo;
 	StatisticsHelper::Action action;
-	QNetworkAccessManager manager;
 };
 
 void StatisticsHelperPrivate::init()
@@ -109,7 +109,7 @@ void StatisticsHelperPrivate::sendInfo()
 		query.addQueryItem(it.key(), it.value().toString());
 	}
     url.setQuery(query);
-	QObject::connect(manager.get(QNetworkRequest(url)), SIGNAL(finished()),
+	QObject::connect(NetworkAccess::manager()->get(NetworkAccess::request(url)), SIGNAL(finished()),
 	                 q_func(), SLOT(_q_on_finished()));
 }
 
@@ -117,6 +117,7 @@ void StatisticsHelperPrivate::_q_on_finished()
 {
 	QNetworkReply *reply = qobject_cast<QNetworkReply*>(q_func()->sender());
 	Q_ASSERT(reply);
+	reply->deleteLater();
 	if (reply->error() == QNetworkReply::NoError) {
 		QString key = QLatin1String(reply->readAll());
 		if (!key.isEmpty()) {
@@ -27,6 +27,7 @@
 #include "dynamicpropertydata_p.h"
 #include "icon.h"
 #include <QDebug>
+#include <QMutex>
 
 #include <unordered_map>
 
@@ -95,6 +96,8 @@ public:
     void setExtendedStatuses(const QVariant &val) { extStatuses = val.value<ExtendedStatus>(); }
 
 	void generateName();
+	uint internHash() const;
+	bool isEqual(const StatusPrivate &o) const;
 };
 
 class StatusPrivateList : public QVector<QSharedDataPointer<StatusPrivate> >
@@ -117,6 +120,51 @@ public:
 
 Q_GLOBAL_STATIC(StatusPrivateList, statusList)
 
+uint StatusPrivate::internHash() const
+{
+	uint hash = qHash(text) ^ (uint(type) << 24) ^ uint(subtype) ^ qHash(name.original());
+	// Values are checked by isEqual(), names are enough to spread the hash
+	for (auto it = extStatuses.constBegin(); it != extStatuses.constEnd(); ++it) {
+		hash ^= qHash(it.key());
+		for (auto jt = it->constBegin(); jt != it->constEnd(); ++jt)
+			hash += qHash(jt.key());
+	}
+	return hash;
+}
+
+bool StatusPrivate::isEqual(const StatusPrivate &o) const
+{
+	return type == o.type
+			&& subtype == o.subtype
+			&& changeReason == o.changeReason
+			&& text == o.text
+			&& name.original() == o.name.original()
+			&& icon.cacheKey() == o.icon.cacheKey()
+			&& extStatuses == o.extStatuses
+			&& !hasDynamicProperties()
+			&& !o.hasDynamicProperties();
+}
+
+struct StatusPool
+{
+	enum { MaxSize = 1024 };
+	QMutex lock;
+	QMultiHash<uint, QSharedDataPointer<StatusPrivate> > statuses;
+
+	// Drops statuses, which are not used by anybody except the pool
+	void purge()
+	{
+		for (auto it = statuses.begin(); it != statuses.end();) {
+			if (it.value().constData()->ref.load() == 1)
+				it = statuses.erase(it);
+			else
+				++it;
+		}
+	}
+};
+
+Q_GLOBAL_STATIC(StatusPool, statusPool)
+
 static QSharedDataPointer<StatusPrivate> get_status_private(Status::Type type)
 {
 	int index = type - Status::Connecting;
@@ -127,30 +175,34 @@ static QSharedDataPointer<StatusPrivate> get_status_private(Status::Type type)
 
 namespace CompiledProperty
 {
-static QList<QByteArray> names = QList<QByteArray>()
-<< "text"
-<< "name"
-<< "icon"
-<< "type"
-<< "subtype"
-<< "changeReason"
-<< "extendedStatuses";
-static QList<Getter> getters   = QList<Getter>()
-<< static_cast<Getter>(&StatusPrivate::getText)
-<< static_cast<Getter>(&StatusPrivate::getName)
-<< static_cast<Getter>(&StatusPrivate::getIcon)
-<< static_cast<Getter>(&StatusPrivate::getType)
-<< static_cast<Getter>(&StatusPrivate::getSubtype)
-<< static_cast<Getter>(&StatusPrivate::getChangeReason)
-<< static_cast<Getter>(&StatusPrivate::getExtendedStatuses);
-static QList<Setter> setters   = QList<Setter>()
-<< static_cast<Setter>(&StatusPrivate::setText)
-<< static_cast<Setter>(&StatusPrivate::setName)
-<< static_cast<Setter>(&StatusPrivate::setIcon)
-<< static_cast<Setter>(&StatusPrivate::setType)
-<< static_cast<Setter>(&StatusPrivate::setSubtype)
-<< static_cast<Setter>(&StatusPrivate::setChangeReason)
-<< static_cast<Setter>(&StatusPrivate::setExtendedStatuses);
+static const char * const names[] = {
+	"text",
+	"name",
+	"icon",
+	"type",
+	"subtype",
+	"changeReason",
+	"extendedStatuses"
+};
+static const Getter getters[] = {
+	static_cast<Getter>(&StatusPrivate::getText),
+	static_cast<Getter>(&StatusPrivate::getName),
+	static_cast<Getter>(&StatusPrivate::getIcon),
+	static_cast<Getter>(&StatusPrivate::getType),
+	static_cast<Getter>(&StatusPrivate::getSubtype),
+	static_cast<Getter>(&StatusPrivate::getChangeReason),
+	static_cast<Getter>(&StatusPrivate::getExtendedStatuses)
+};
+static const Setter setters[] = {
+	static_cast<Setter>(&StatusPrivate::setText),
+	static_cast<Setter>(&StatusPrivate::setName),
+	static_cast<Setter>(&StatusPrivate::setIcon),
+	static_cast<Setter>(&StatusPrivate::setType),
+	static_cast<Setter>(&StatusPrivate::setSubtype),
+	static_cast<Setter>(&StatusPrivate::setChangeReason),
+	static_cast<Setter>(&StatusPrivate::setExtendedStatuses)
+};
+static const Table table(names, getters, setters, sizeof(names) / sizeof(names[0]));
 }
 
 void StatusPrivate::generateName()
@@ -217,6 +269,34 @@ bool Status::operator ==(Type type) const
 	return d->type == type;
 }
 
+bool Status::operator ==(const Status &other) const
+{
+	return d.constData() == other.d.constData() || d->isEqual(*other.d);
+}
+
+Status Status::intern(const Status &status)
+{
+	const StatusPrivate *p = status.d.constData();
+	// Default statuses are shared already
+	if (p == get_status_private(p->type).constData() || p->hasDynamicProperties())
+		return status;
+
+	const uint hash = p->internHash();
+	StatusPool *pool = statusPool();
+	QMutexLocker locker(&pool->lock);
+	for (auto it = pool->statuses.constFind(hash); it != pool->statuses.constEnd() && it.key() == hash; ++it) {
+		if (it.value().constData() == p || it.value()->isEqual(*p)) {
+			Status result;
+			result.d = it.value();
+			return result;
+		}
+	}
+	if (pool->statuses.size() >= StatusPool::MaxSize)
+		pool->purge();
+	pool->statuses.insert(hash, status.d);
+	return status;
+}
+
 QString Status::text() const
 {
 	return d->text;
@@ -284,12 +364,12 @@ void Status::setChangeReason(Status::ChangeReason reason)
 
 QVariant Status::property(const char *name, const QVariant &def) const
 {
-	return d->property(name, def, CompiledProperty::names, CompiledProperty::getters);
+	return d->property(name, def, CompiledProperty::table);
 }
 
 void Status::setProperty(const char *name, const QVariant &value)
 {
-	d->setProperty(name, value, CompiledProperty::names, CompiledProperty::setters);
+	d->setProperty(name, value, CompiledProperty::table);
 }
 
 void Status::initIcon(const QString &protocol)
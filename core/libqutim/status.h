@@ -83,6 +83,9 @@ public:
 
 	bool operator ==(Type type) const;
 	inline bool operator !=(Type type) const { return !operator ==(type); }
+	// Interned statuses are compared by pointer, others field by field
+	bool operator ==(const Status &other) const;
+	inline bool operator !=(const Status &other) const { return !operator ==(other); }
 
 	QString text() const;
 	void setText(const QString &text);
@@ -108,6 +111,12 @@ public:
 	static QIcon createIcon(Type type, const QString &protocol = QString());
 	static QString iconName(Type type, const QString &protocol = QString());
 	static Status instance(Type type, const char *proto, int subtype = 0);
+	/**
+	  Returns status equal to the given one, which shares its data with all
+	  other interned equal statuses. Protocols should intern statuses of
+	  their contacts, as large rosters usually have only a few distinct ones.
+	*/
+	static Status intern(const Status &status);
 	static bool remember(const Status &status, const char *proto);
     static Status createConnecting(const Status &status, const char *proto);
     static Status connectingGoal(const Status &status);
@@ -23,21 +23,135 @@
 **
 ****************************************************************************/
 
-#include "tcpsocket.h"
+#include "tcpsocket_p.h"
+#include <QCoreApplication>
+#include <QNetworkProxy>
+#include <QThread>
+#ifdef Q_OS_WIN
+# include <winsock2.h>
+#else
+# include <unistd.h>
+#endif
 
 namespace qutim_sdk_0_3
 {
+	enum { StaggerInterval = 250, HostCacheTtl = 5 * 60 * 1000 };
+
 	class NetworkProxy
 	{
 	};
 
-	TcpSocket::TcpSocket(QObject *parent) : QTcpSocket(parent), p(0)
+	HostCache::HostCache()
+	{
+		m_clock.start();
+	}
+
+	HostCache *HostCache::instance()
+	{
+		static QPointer<HostCache> self;
+		if (!self) {
+			self = new HostCache;
+			self->moveToThread(qApp->thread());
+			self->setParent(qApp);
+		}
+		return self.data();
+	}
+
+	void HostCache::lookup(const QString &hostName, QObject *guard, const Callback &callback)
+	{
+		const QString key = hostName.toLower();
+		auto it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			if (it->expires > m_clock.elapsed()) {
+				callback(it->addresses);
+				return;
+			}
+			m_entries.erase(it);
+		}
+
+		QList<Waiter> &waiters = m_waiters[key];
+		const Waiter waiter = { guard, callback };
+		waiters << waiter;
+		if (waiters.size() == 1)
+			m_lookups.insert(QHostInfo::lookupHost(key, this, SLOT(onLookupFinished(QHostInfo))), key);
+	}
+
+	void HostCache::onLookupFinished(const QHostInfo &info)
+	{
+		const QString key = m_lookups.take(info.lookupId());
+		if (key.isEmpty())
+			return;
+		// Failures aren't cached, network may just be not ready yet
+		if (info.error() == QHostInfo::NoError && !info.addresses().isEmpty()) {
+			const Entry entry = { info.addresses(), m_clock.elapsed() + HostCacheTtl };
+			m_entries.insert(key, entry);
+		}
+		foreach (const Waiter &waiter, m_waiters.take(key)) {
+			if (waiter.guard)
+				waiter.callback(info.addresses());
+		}
+	}
+
+	// Descriptor of the winning attempt is duplicated, so the attempt can be
+	// destroyed without closing the connection
+	static qintptr duplicateDescriptor(qintptr descriptor)
 	{
+#ifdef Q_OS_WIN
+		WSAPROTOCOL_INFO info;
+		if (WSADuplicateSocket(SOCKET(descriptor), GetCurrentProcessId(), &info) != 0)
+			return -1;
+		SOCKET result = WSASocket(FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO, FROM_PROTOCOL_INFO,
+								  &info, 0, WSA_FLAG_OVERLAPPED);
+		return result == INVALID_SOCKET ? -1 : qintptr(result);
+#else
+		return ::dup(int(descriptor));
+#endif
+	}
+
+	// Interleaves IPv6 and IPv4 addresses, so both families are tried early
+	static QList<QHostAddress> sortAddresses(const QList<QHostAddress> &addresses,
+											 QAbstractSocket::NetworkLayerProtocol protocol)
+	{
+		QList<QHostAddress> ipv6, ipv4, result;
+		foreach (const QHostAddress &address, addresses) {
+			if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+				if (protocol != QAbstractSocket::IPv4Protocol)
+					ipv6 << address;
+			} else if (protocol != QAbstractSocket::IPv6Protocol) {
+				ipv4 << address;
+			}
+		}
+		for (int i = 0; i < qMax(ipv6.size(), ipv4.size()); ++i) {
+			if (i < ipv6.size())
+				result << ipv6.at(i);
+			if (i < ipv4.size())
+				result << ipv4.at(i);
+		}
+		return result;
+	}
+
+	TcpSocket::TcpSocket(QObject *parent) : QTcpSocket(parent), p(new TcpSocketPrivate)
+	{
+		p->port = 0;
+		p->mode = ReadWrite;
+		p->protocol = AnyIPProtocol;
+		p->next = 0;
+		p->latency = -1;
+		p->generation = 0;
+		p->lastError = UnknownSocketError;
+		p->stagger.setInterval(StaggerInterval);
+		connect(&p->stagger, &QTimer::timeout, this, [this] () {
+			if (p->next < p->addresses.size())
+				startAttempt();
+			else
+				p->stagger.stop();
+		});
 	}
 
 	TcpSocket::~TcpSocket()
 	{
-	//	delete p;
+		abortRace();
+		delete p;
 	}
 
 	void TcpSocket::setProxy(const NetworkProxy &networkProxy)
@@ -50,15 +164,170 @@ namespace qutim_sdk_0_3
 		return NetworkProxy();
 	}
 
+	void TcpSocket::connectToHost(const QString &hostName, quint16 port, OpenMode mode,
+								  NetworkLayerProtocol protocol)
+	{
+		abortRace();
+		p->latency = -1;
+
+		QNetworkProxy proxy = QTcpSocket::proxy();
+		if (proxy.type() == QNetworkProxy::DefaultProxy)
+			proxy = QNetworkProxy::applicationProxy();
+		if (state() != UnconnectedState
+				|| proxy.type() != QNetworkProxy::NoProxy
+				|| !QHostAddress(hostName).isNull()
+				|| thread() != qApp->thread()) {
+			p->hostName.clear();
+			QTcpSocket::connectToHost(hostName, port, mode, protocol);
+			return;
+		}
+
+		p->hostName = hostName;
+		p->port = port;
+		p->mode = mode;
+		p->protocol = protocol;
+		setPeerName(hostName);
+		setPeerPort(port);
+		setSocketState(HostLookupState);
+		emit stateChanged(HostLookupState);
+
+		const quint64 generation = p->generation;
+		HostCache::instance()->lookup(hostName, this, [this, generation] (const QList<QHostAddress> &addresses) {
+			if (p->generation == generation && state() == HostLookupState)
+				startRace(addresses);
+		});
+	}
+
+	void TcpSocket::disconnectFromHost()
+	{
+		if (!p->attempts.isEmpty() || (state() == HostLookupState && !p->hostName.isEmpty())) {
+			abortRace();
+			setSocketState(UnconnectedState);
+			emit stateChanged(UnconnectedState);
+			return;
+		}
+		QTcpSocket::disconnectFromHost();
+	}
+
+	int TcpSocket::connectLatency() const
+	{
+		return p->latency;
+	}
+
+	void TcpSocket::setMetrics(const SocketMetrics &metrics)
+	{
+		p->metrics = metrics;
+	}
+
+	void TcpSocket::startRace(const QList<QHostAddress> &addresses)
+	{
+		p->addresses = sortAddresses(addresses, p->protocol);
+		p->next = 0;
+		if (p->addresses.isEmpty()) {
+			fail(HostNotFoundError, QCoreApplication::translate("TcpSocket", "Host %1 not found").arg(p->hostName));
+			return;
+		}
+		emit hostFound();
+		setSocketState(ConnectingState);
+		emit stateChanged(ConnectingState);
+		p->started.start();
+		startAttempt();
+		if (p->next < p->addresses.size())
+			p->stagger.start();
+	}
+
+	void TcpSocket::startAttempt()
+	{
+		QTcpSocket *attempt = new QTcpSocket(this);
+		attempt->setProxy(QNetworkProxy::NoProxy);
+		p->attempts << attempt;
+		connect(attempt, &QTcpSocket::connected, this, [this, attempt] () {
+			onAttemptConnected(attempt);
+		});
+		connect(attempt, static_cast<void (QTcpSocket::*)(SocketError)>(&QTcpSocket::error),
+				this, [this, attempt] (SocketError) {
+			onAttemptFailed(attempt);
+		});
+		attempt->connectToHost(p->addresses.at(p->next++), p->port);
+	}
+
+	void TcpSocket::onAttemptConnected(QTcpSocket *attempt)
+	{
+		const qint64 latency = p->started.elapsed();
+		const QHostAddress address = attempt->peerAddress();
+		const qintptr descriptor = duplicateDescriptor(attempt->socketDescriptor());
+		abortRace();
+		if (descriptor == -1) {
+			fail(UnknownSocketError, QCoreApplication::translate("TcpSocket", "Can't take connected socket"));
+			return;
+		}
+
+		setSocketState(UnconnectedState);
+		if (!setSocketDescriptor(descriptor, ConnectedState, p->mode)) {
+			fail(error(), errorString());
+			return;
+		}
+		setPeerName(p->hostName);
+		p->latency = int(latency);
+		if (p->metrics.isValid())
+			p->metrics.connected(latency);
+		emit endpointChosen(address, p->latency);
+		emit connected();
+	}
+
+	void TcpSocket::onAttemptFailed(QTcpSocket *attempt)
+	{
+		if (!p->attempts.removeOne(attempt))
+			return;
+		p->lastError = attempt->error();
+		p->lastErrorString = attempt->errorString();
+		attempt->disconnect(this);
+		attempt->deleteLater();
+
+		if (!p->attempts.isEmpty())
+			return;
+		if (p->next < p->addresses.size()) {
+			// Nothing is in progress, so don't wait for the stagger
+			startAttempt();
+			p->stagger.start();
+		} else {
+			fail(p->lastError, p->lastErrorString);
+		}
+	}
+
+	void TcpSocket::abortRace()
+	{
+		++p->generation;
+		p->stagger.stop();
+		foreach (QTcpSocket *attempt, p->attempts) {
+			attempt->disconnect(this);
+			attempt->abort();
+			attempt->deleteLater();
+		}
+		p->attempts.clear();
+		p->addresses.clear();
+		p->next = 0;
+	}
+
+	void TcpSocket::fail(SocketError error, const QString &errorString)
+	{
+		abortRace();
+		if (p->metrics.isValid())
+			p->metrics.connectFailed();
+		setSocketError(error);
+		setErrorString(errorString);
+		setSocketState(UnconnectedState);
+		emit stateChanged(UnconnectedState);
+		emit this->error(error);
+	}
+
 	void TcpSocket::connectToHostImplementation(const QString &hostName, quint16 port, OpenMode mode)
 	{
-		Q_UNUSED(hostName);
-		Q_UNUSED(port);
-		Q_UNUSED(mode);
+		connectToHost(hostName, port, mode);
 	}
 
 	void TcpSocket::disconnectFromHostImplementation()
 	{
+		disconnectFromHost();
 	}
 }
-
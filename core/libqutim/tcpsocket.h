@@ -28,12 +28,23 @@
 
 #include "libqutim_global.h"
 #include <QTcpSocket>
+#include <QHostAddress>
 
 namespace qutim_sdk_0_3
 {
 	class NetworkProxy;
+	class SocketMetrics;
 	class TcpSocketPrivate;
 
+	/**
+	 * TCP socket which connects to all resolved addresses of the host.
+	 *
+	 * Host names are resolved through a cache shared by all sockets of the
+	 * application. Attempts to IPv6 and IPv4 addresses are interleaved and
+	 * started with 250 ms stagger, the first connected one is used and all
+	 * others are aborted. Connections through proxy and to literal addresses
+	 * are made by QTcpSocket itself.
+	 */
 	class LIBQUTIM_EXPORT TcpSocket : public QTcpSocket
 	{
 		Q_OBJECT
@@ -43,12 +54,32 @@ namespace qutim_sdk_0_3
 		void setProxy(const NetworkProxy &networkProxy);
 		NetworkProxy proxy() const;
 
+		using QTcpSocket::connectToHost;
+		void connectToHost(const QString &hostName, quint16 port, OpenMode mode = ReadWrite,
+						   NetworkLayerProtocol protocol = AnyIPProtocol) Q_DECL_OVERRIDE;
+		void disconnectFromHost() Q_DECL_OVERRIDE;
+		// Milliseconds from the start of the last connection till it was established, -1 if unknown
+		int connectLatency() const;
+		// Connection latencies and failures of raced connections are reported to metrics
+		void setMetrics(const SocketMetrics &metrics);
+
+	Q_SIGNALS:
+		void endpointChosen(const QHostAddress &address, int latency);
+
 	protected Q_SLOTS:
 		void connectToHostImplementation(const QString &hostName, quint16 port, OpenMode mode = ReadWrite);
 		void disconnectFromHostImplementation();
 
 	protected:
 		TcpSocketPrivate *p;
+
+	private:
+		void startRace(const QList<QHostAddress> &addresses);
+		void startAttempt();
+		void onAttemptConnected(QTcpSocket *attempt);
+		void onAttemptFailed(QTcpSocket *attempt);
+		void abortRace();
+		void fail(SocketError error, const QString &errorString);
 	};
 }
 
@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2011 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TCPSOCKET_P_H
+#define TCPSOCKET_P_H
+
+#include "tcpsocket.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostInfo>
+#include <QPointer>
+#include <QTimer>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+	// Results of host lookups shared by all accounts, concurrent lookups
+	// of the same host are made only once
+	class HostCache : public QObject
+	{
+		Q_OBJECT
+	public:
+		typedef std::function<void (const QList<QHostAddress> &)> Callback;
+
+		HostCache();
+		static HostCache *instance();
+		void lookup(const QString &hostName, QObject *guard, const Callback &callback);
+
+	private Q_SLOTS:
+		void onLookupFinished(const QHostInfo &info);
+
+	private:
+		struct Entry
+		{
+			QList<QHostAddress> addresses;
+			qint64 expires;
+		};
+		struct Waiter
+		{
+			QPointer<QObject> guard;
+			Callback callback;
+		};
+
+		QHash<QString, Entry> m_entries;
+		QHash<int, QString> m_lookups;
+		QHash<QString, QList<Waiter> > m_waiters;
+		QElapsedTimer m_clock;
+	};
+
+	class TcpSocketPrivate
+	{
+	public:
+		QString hostName;
+		quint16 port;
+		QIODevice::OpenMode mode;
+		QAbstractSocket::NetworkLayerProtocol protocol;
+		QList<QHostAddress> addresses;
+		int next;
+		QList<QTcpSocket*> attempts;
+		QTimer stagger;
+		QElapsedTimer started;
+		int latency;
+		// Lookups answered after abort or reconnection are ignored
+		quint64 generation;
+		QAbstractSocket::SocketError lastError;
+		QString lastErrorString;
+		SocketMetrics metrics;
+	};
+}
+
+#endif // TCPSOCKET_P_H
@@ -0,0 +1,201 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "avatarcache_p.h"
+#include "../executor.h"
+#include "../config.h"
+#include "../memoryaccounting.h"
+#include <QApplication>
+#include <QWidget>
+#include <QImageReader>
+#include <QPainter>
+#include <QStringBuilder>
+
+namespace qutim_sdk_0_3
+{
+
+enum { MaxFailedCount = 256, MaxSizesCount = 1024, UpdateDelay = 50 };
+
+AvatarCache *AvatarCache::instance()
+{
+	static AvatarCache *self = new AvatarCache;
+	return self;
+}
+
+AvatarCache::AvatarCache()
+{
+	// Budget is in kilobytes, the same units pixmaps cost is counted in
+	Config cfg = Config().group(QStringLiteral("appearance"));
+	m_pixmaps.setMaxCost(qMax(1024, cfg.value(QStringLiteral("avatarCacheSize"), 8192)));
+	m_updateTimer.setSingleShot(true);
+	m_updateTimer.setInterval(UpdateDelay);
+	connect(&m_updateTimer, &QTimer::timeout, this, &AvatarCache::onUpdateTimeout);
+
+	MemoryAccounting::add(MemoryAccounting::AvatarsCache, this, QStringLiteral("avatars"), [this] () {
+		return qint64(m_pixmaps.totalCost()) * 1024;
+	}, [this] (qint64 target) {
+		// Lowering of max cost evicts least recently used pixmaps
+		const int maxCost = m_pixmaps.maxCost();
+		m_pixmaps.setMaxCost(int(target / 1024));
+		m_pixmaps.setMaxCost(maxCost);
+	});
+}
+
+QPixmap AvatarCache::pixmap(const QString &path, const QSize &size, qreal devicePixelRatio,
+							int radius, LoadMode mode, bool *pending)
+{
+	if (pending)
+		*pending = false;
+	const QSize pixelSize = size * devicePixelRatio;
+	if (path.isEmpty() || pixelSize.isEmpty())
+		return QPixmap();
+
+	const QString key = QString::number(pixelSize.width())
+			% QLatin1Char('_')
+			% QString::number(pixelSize.height())
+			% QLatin1Char('_')
+			% QString::number(radius)
+			% QLatin1Char('_')
+			% path;
+	if (QPixmap *pixmap = m_pixmaps.object(key)) {
+		QPixmap result = *pixmap;
+		result.setDevicePixelRatio(devicePixelRatio);
+		return result;
+	}
+
+	if (mode == Wait) {
+		const QImage image = render(path, pixelSize, radius * devicePixelRatio);
+		m_pending.remove(key);
+		if (image.isNull())
+			return QPixmap();
+		insert(key, image);
+		QPixmap result = *m_pixmaps.object(key);
+		result.setDevicePixelRatio(devicePixelRatio);
+		return result;
+	}
+
+	if (m_failed.contains(key))
+		return QPixmap();
+	if (pending)
+		*pending = true;
+	if (m_pending.contains(key))
+		return QPixmap();
+	m_pending.insert(key);
+
+	const int pixelRadius = radius * devicePixelRatio;
+	AvatarCache *self = this;
+	Executor::named(QStringLiteral("avatars"))->run([self, key, path, pixelSize, pixelRadius] () {
+		const QImage image = render(path, pixelSize, pixelRadius);
+		QMetaObject::invokeMethod(self, "onRendered", Qt::QueuedConnection,
+								  Q_ARG(QString, key), Q_ARG(QImage, image));
+	});
+	return QPixmap();
+}
+
+QSize AvatarCache::imageSize(const QString &path)
+{
+	auto it = m_sizes.constFind(path);
+	if (it != m_sizes.constEnd())
+		return it.value();
+	// Only header is read here
+	const QSize size = QImageReader(path).size();
+	if (m_sizes.size() >= MaxSizesCount)
+		m_sizes.clear();
+	m_sizes.insert(path, size);
+	return size;
+}
+
+void AvatarCache::onRendered(const QString &key, const QImage &image)
+{
+	if (!m_pending.remove(key))
+		return;
+	if (image.isNull()) {
+		if (m_failed.size() >= MaxFailedCount)
+			m_failed.clear();
+		m_failed.insert(key);
+		return;
+	}
+	insert(key, image);
+	if (!m_updateTimer.isActive())
+		m_updateTimer.start();
+}
+
+void AvatarCache::onUpdateTimeout()
+{
+	// Views painted placeholders instead of these avatars, so repaint them
+	foreach (QWidget *widget, QApplication::topLevelWidgets()) {
+		if (widget->isVisible())
+			widget->update();
+	}
+}
+
+QImage AvatarCache::render(const QString &path, const QSize &size, int radius)
+{
+	QImageReader reader(path);
+	QImage image;
+	const QSize imageSize = reader.size();
+	if (imageSize.isValid()) {
+		// Let the decoder crop and downscale huge images itself, it's much
+		// cheaper for jpeg than decoding them completely
+		const int cropSize = qMin(imageSize.width(), imageSize.height());
+		reader.setClipRect(QRect(0, 0, cropSize, cropSize));
+		if (cropSize > size.width() * 2)
+			reader.setScaledSize(size * 2);
+		image = reader.read();
+	} else {
+		image = reader.read();
+		const int cropSize = qMin(image.width(), image.height());
+		image = image.copy(0, 0, cropSize, cropSize);
+	}
+	if (image.isNull())
+		return image;
+	if (image.size() != size)
+		image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+	QImage alpha(size, QImage::Format_ARGB32_Premultiplied);
+	alpha.fill(Qt::transparent);
+	QPainter painter(&alpha);
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(Qt::black);
+	painter.drawRoundedRect(QRectF(0, 0, size.width() - 1, size.height() - 1), radius, radius);
+	painter.end();
+
+	painter.begin(&image);
+	painter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+	painter.drawImage(0, 0, alpha);
+	painter.end();
+	return image;
+}
+
+void AvatarCache::insert(const QString &key, const QImage &image)
+{
+	QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+	const int cost = qMax(1, pixmap->width() * pixmap->height() * pixmap->depth() / (8 * 1024));
+	m_pixmaps.insert(key, pixmap, cost);
+}
+
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef AVATARCACHE_P_H
+#define AVATARCACHE_P_H
+
+#include <QObject>
+#include <QCache>
+#include <QPixmap>
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+
+namespace qutim_sdk_0_3
+{
+
+/*
+ * Process-wide cache of scaled and masked avatars shared by all views.
+ * Images are decoded and scaled by worker threads, only conversion to
+ * QPixmap is done at GUI thread. Least recently used pixmaps are evicted
+ * when memory budget is exceeded.
+ */
+class AvatarCache : public QObject
+{
+	Q_OBJECT
+public:
+	enum LoadMode
+	{
+		// Return null pixmap and schedule decoding if there is no cached one
+		Async,
+		// Decode right now at calling thread
+		Wait
+	};
+
+	static AvatarCache *instance();
+
+	// Size is logical one, pixmap has it multiplied by devicePixelRatio
+	QPixmap pixmap(const QString &path, const QSize &size, qreal devicePixelRatio,
+				   int radius, LoadMode mode, bool *pending = 0);
+	// Size of image at path without decoding it, invalid if there is no image
+	QSize imageSize(const QString &path);
+
+private slots:
+	void onRendered(const QString &key, const QImage &image);
+	void onUpdateTimeout();
+
+private:
+	AvatarCache();
+	static QImage render(const QString &path, const QSize &size, int radius);
+	void insert(const QString &key, const QImage &image);
+
+	QCache<QString, QPixmap> m_pixmaps;
+	QHash<QString, QSize> m_sizes;
+	QSet<QString> m_failed;
+	QSet<QString> m_pending;
+	QTimer m_updateTimer;
+};
+
+}
+
+#endif // AVATARCACHE_P_H
@@ -27,10 +27,9 @@
 #include "avatarfilter.h"
 #include <QPainter>
 #include <QIcon>
-#include <QStringBuilder>
-#include <QPixmapCache>
-#include <QDebug>
+#include <QApplication>
 #include "avatariconengine_p.h"
+#include "avatarcache_p.h"
 
 namespace qutim_sdk_0_3
 {
@@ -38,11 +37,44 @@ namespace qutim_sdk_0_3
 class AvatarFilterPrivate
 {
 public:
+	bool draw(QPainter *painter, int x, int y, const QString &path,
+			  const QIcon &overlayIcon, AvatarCache::LoadMode mode) const;
+	void drawOverlay(QPainter *painter, int x, int y, const QIcon &overlayIcon) const;
+
 	QSize defaultSize;
 	Qt::AspectRatioMode mode;
 	int radius;
 };
 
+bool AvatarFilterPrivate::draw(QPainter *painter, int x, int y, const QString &path,
+							   const QIcon &overlayIcon, AvatarCache::LoadMode mode) const
+{
+	if (path.isEmpty())
+		return false;
+	const qreal devicePixelRatio = painter->device()->devicePixelRatio();
+	QPixmap pixmap = AvatarCache::instance()->pixmap(path, defaultSize, devicePixelRatio, radius, mode);
+	// Not decoded yet, caller draws its usual placeholder instead, view
+	// is repainted as soon as avatar is ready
+	if (pixmap.isNull())
+		return false;
+	painter->drawPixmap(QRect(QPoint(x, y), defaultSize), pixmap);
+	drawOverlay(painter, x, y, overlayIcon);
+	return true;
+}
+
+void AvatarFilterPrivate::drawOverlay(QPainter *painter, int x, int y, const QIcon &overlayIcon) const
+{
+	if (overlayIcon.isNull())
+		return;
+	QSize overlaySize = defaultSize/(defaultSize.width() <= 16 ? 1.3 : 2);
+	QPixmap overlayPixmap = overlayIcon.pixmap(overlaySize);
+	overlaySize = overlayPixmap.size() / overlayPixmap.devicePixelRatio();
+	painter->drawPixmap(x + defaultSize.width() - overlaySize.width(),
+						y + defaultSize.height() - overlaySize.height(),
+						overlayPixmap
+						);
+}
+
 AvatarFilter::AvatarFilter(const QSize& defaultSize/*, Qt::AspectRatioMode mode*/) :
 	d_ptr(new AvatarFilterPrivate)
 {
@@ -62,64 +94,38 @@ AvatarFilter::~AvatarFilter()
 
 bool AvatarFilter::draw(QPainter *painter, int x, int y,
 						const QString &path, const QIcon &overlayIcon) const
+{
+	return d_func()->draw(painter, x, y, path, overlayIcon, AvatarCache::Async);
+}
+
+bool AvatarFilter::drawNow(QPainter *painter, int x, int y,
+						   const QString &path, const QIcon &overlayIcon) const
+{
+	return d_func()->draw(painter, x, y, path, overlayIcon, AvatarCache::Wait);
+}
+
+QPixmap AvatarFilter::pixmap(const QString &path, const QIcon &overlayIcon) const
 {
 	Q_D(const AvatarFilter);
-	if (path.isEmpty())
-		return false;
+	const qreal devicePixelRatio = qApp->devicePixelRatio();
+	bool pending = false;
+	QPixmap avatar = AvatarCache::instance()->pixmap(path, d->defaultSize, devicePixelRatio,
+													 d->radius, AvatarCache::Async, &pending);
+	if (avatar.isNull() && !pending)
+		return avatar;
+	if (!avatar.isNull() && overlayIcon.isNull())
+		return avatar;
 
-	QString key = QLatin1Literal("qutim_avatar_")
-			% QString::number(d->defaultSize.width())
-			% QLatin1Char('_')
-			% QString::number(d->defaultSize.height())
-			% QLatin1Char('_')
-			% path;
-	QPixmap pixmap;
-	if (!QPixmapCache::find(key, &pixmap)) {
-		if (!pixmap.load(path))
-			return false;
-		QString alphaKey = QLatin1Literal("qutim_avatar_alpha_")
-				% QString::number(d->defaultSize.width())
-				% QLatin1Char('_')
-				% QString::number(d->defaultSize.height());
-		QPixmap alpha;
-		if (!QPixmapCache::find(alphaKey, &alpha)) {
-			alpha = QPixmap(d->defaultSize);
-			alpha.fill(QColor(0,0,0));
-			QPainter painter(&alpha);
-			QPen pen(QColor(127,127,127));
-			painter.setRenderHint(QPainter::Antialiasing);
-			pen.setWidth(0);
-			painter.setPen(pen);
-			painter.setBrush(QBrush(QColor(255,255,255)));	
-			painter.drawRoundedRect(QRectF(QPointF(0, 0),
-										   QSize(d->defaultSize.width() - 1,
-												 d->defaultSize.height() -1 )),
-									d->radius, d->radius);
-			painter.end();
-			QPixmapCache::insert(alphaKey, alpha);
-		}
-		int cropSize = qMin(pixmap.width(), pixmap.height());
-		pixmap = pixmap.copy(0, 0, cropSize, cropSize);
-		if (cropSize > d->defaultSize.width() * 2)
-			pixmap = pixmap.scaled(d->defaultSize * 2, d->mode, Qt::FastTransformation);
-		pixmap = pixmap.scaled(d->defaultSize, d->mode, Qt::SmoothTransformation);
-        {
-//            pixmap.setAlphaChannel(alpha);
-            QImage image = pixmap.toImage();
-            image.setAlphaChannel(alpha.toImage());
-            pixmap = QPixmap::fromImage(image);
-        }
-		QPixmapCache::insert(key, pixmap);
+	QPixmap result(d->defaultSize * devicePixelRatio);
+	result.setDevicePixelRatio(devicePixelRatio);
+	result.fill(Qt::transparent);
+	// Transparent placeholder keeps layout of the view until avatar is ready
+	if (!avatar.isNull()) {
+		QPainter painter(&result);
+		painter.drawPixmap(QRect(QPoint(0, 0), d->defaultSize), avatar);
+		d->drawOverlay(&painter, 0, 0, overlayIcon);
 	}
-	painter->drawPixmap(x, y, pixmap.width(), pixmap.height(), pixmap);
-	QSize overlaySize = d->defaultSize/(d->defaultSize.width() <= 16 ? 1.3 : 2);
-    QPixmap overlayPixmap = overlayIcon.pixmap(overlaySize);
-    overlaySize = overlayPixmap.size() / overlayPixmap.devicePixelRatio();
-	painter->drawPixmap(x + d->defaultSize.width() - overlaySize.width(),
-						y + d->defaultSize.height() - overlaySize.height(),
-						overlayPixmap
-						);
-	return true;
+	return result;
 }
 
 QIcon AvatarFilter::icon(const QString &path, const QIcon &overlayIcon)
@@ -44,7 +44,19 @@ class LIBQUTIM_EXPORT AvatarFilter
 public:
 	AvatarFilter(const QSize &defaultSize);
 	~AvatarFilter();
+	/**
+	 * Draws cached avatar, returns false if there is no image at @a path
+	 * or it is still being decoded in background. View is repainted
+	 * once it is ready, so caller should draw its usual placeholder.
+	 */
 	bool draw(QPainter *painter, int x, int y, const QString &path,const QIcon &overlayIcon) const;
+	// Same as draw(), but decodes the avatar at calling thread if it's not cached yet
+	bool drawNow(QPainter *painter, int x, int y, const QString &path, const QIcon &overlayIcon) const;
+	/**
+	 * Returns cached avatar of default size, transparent placeholder if
+	 * it's still being decoded and null pixmap if there is no image.
+	 */
+	QPixmap pixmap(const QString &path, const QIcon &overlayIcon = QIcon()) const;
 	static QIcon icon(const QString &path,const QIcon &overlayIcon = QIcon());
 private:
 	QScopedPointer<AvatarFilterPrivate> d_ptr;
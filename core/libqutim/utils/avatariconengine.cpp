@@ -26,6 +26,7 @@
 
 #include "avatariconengine_p.h"
 #include "avatarfilter.h"
+#include "avatarcache_p.h"
 #include <QPainter>
 #include <QApplication>
 
@@ -55,11 +56,11 @@ void AvatarIconEngine::paint(QPainter *painter, const QRect &rect,
 
 QSize AvatarIconEngine::actualSize(const QSize &size, QIcon::Mode mode, QIcon::State state)
 {
-	QPixmap img(m_path);
-	if(img.isNull())
+	const QSize imageSize = AvatarCache::instance()->imageSize(m_path);
+	if(!imageSize.isValid())
 		return m_overlay.actualSize(size,mode,state);
-	if(img.size().width() < size.width() || img.size().height() < size.height())
-		return img.size();
+	if(imageSize.width() < size.width() || imageSize.height() < size.height())
+		return imageSize;
 	return size;
 }
 
@@ -80,7 +81,7 @@ QPixmap AvatarIconEngine::pixmap(const QSize &size, QIcon::Mode mode, QIcon::Sta
 	QPainter p;
 	if (!pixmap.size().isNull()) {
 		p.begin(&pixmap);
-		bool hasAvatar = AvatarFilter(size).draw(&p,0,0,m_path,m_overlay);
+		bool hasAvatar = AvatarFilter(size).drawNow(&p,0,0,m_path,m_overlay);
 		p.end();
 
 		if(!hasAvatar)
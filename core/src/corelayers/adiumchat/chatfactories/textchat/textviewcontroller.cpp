@@ -31,6 +31,8 @@
 #include <QPainter>
 #include <QDesktopServices>
 #include <QPlainTextEdit>
+#include <QImageReader>
+#include <QTimerEvent>
 #include <qutim/servicemanager.h>
 #include <qutim/chatunit.h>
 #include <qutim/message.h>
@@ -50,13 +52,81 @@ namespace Core
 {
 namespace AdiumChat
 {
-enum { EmoticonObjectType = 0x666 };
+enum { EmoticonObjectType = 0x666, MaxReceipts = 40 };
+
+enum { MinFrameDelay = 20 };
+
+static bool receiptLessThan(const MessageReceipt &receipt, qint64 id)
+{
+	return receipt.id < id;
+}
+
+QSharedPointer<EmoticonFrames> EmoticonFrames::get(const QString &fileName)
+{
+	// Frames live while any view shows the emoticon
+	static QHash<QString, QWeakPointer<EmoticonFrames> > cache;
+	QSharedPointer<EmoticonFrames> frames = cache.value(fileName).toStrongRef();
+	if (!frames) {
+		frames = QSharedPointer<EmoticonFrames>(new EmoticonFrames(fileName));
+		cache.insert(fileName, frames);
+	}
+	return frames;
+}
+
+EmoticonFrames::EmoticonFrames(const QString &fileName)
+	: m_fileName(fileName), m_decoded(false)
+{
+	QImageReader reader(fileName);
+	m_animated = reader.supportsAnimation() && reader.imageCount() != 1;
+	const QImage image = reader.read();
+	m_frames << QPixmap::fromImage(image);
+	m_delays << reader.nextImageDelay();
+	m_size = image.size();
+	if (!m_animated)
+		m_decoded = true;
+}
+
+int EmoticonFrames::frameCount()
+{
+	if (!m_decoded)
+		decode();
+	return m_frames.size();
+}
+
+const QPixmap &EmoticonFrames::frame(int index) const
+{
+	return m_frames.at(index < m_frames.size() ? index : 0);
+}
+
+int EmoticonFrames::delay(int index) const
+{
+	return m_delays.value(index);
+}
+
+void EmoticonFrames::decode()
+{
+	m_decoded = true;
+	QImageReader reader(m_fileName);
+	reader.read();
+	while (reader.canRead()) {
+		const QImage image = reader.read();
+		if (image.isNull())
+			break;
+		m_frames << QPixmap::fromImage(image);
+		m_delays << reader.nextImageDelay();
+	}
+	if (m_frames.size() == 1)
+		m_animated = false;
+}
 
 TextViewController::TextViewController()
 {
-	m_cache.setMaxCost(40);
+	// Undo stack would keep every inserted message forever
+	setUndoRedoEnabled(false);
 	m_isLastIncoming = false;
 	m_scrollBarPosition = 0;
+	m_historyPending = false;
+	m_historyGeneration = 0;
 	Config cfg = Config(QLatin1String("appearance")).group(QLatin1String("chat"));
 	m_groupUntil = cfg.value<ushort>(QLatin1String("groupUntil"), 900);
 	cfg.beginGroup(QLatin1String("textview"));
@@ -74,6 +144,8 @@ TextViewController::TextViewController()
 	m_bulletReceivedColor.setNamedColor(cfg.value(QLatin1String("bulletReceivedColor"),
 	                                              QLatin1String("#00990b")));
 	m_bulletSize = cfg.value("bulletSize", 5);
+	// Older blocks are removed from the top, zero means unlimited scrollback
+	m_maxBlockCount = cfg.value(QLatin1String("maxBlockCount"), 5000);
 	cfg.beginGroup(QLatin1String("font"));
 #ifdef Q_WS_MAEMO_5
 	m_font.setFamily(cfg.value(QLatin1String("family"), QLatin1String("Nokia Sans")));
@@ -88,6 +160,7 @@ TextViewController::TextViewController()
 	cfg.endGroup();
 	cfg.endGroup();
 	documentLayout()->registerHandler(EmoticonObjectType, this);
+	m_animationClock.start();
 	init();
 }
 
@@ -109,11 +182,48 @@ ChatSession *TextViewController::getSession() const
 
 void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 {
-	if (msg.text().isEmpty())
+	if (!msg.text().isEmpty())
+		appendMessages(MessageList() << msg);
+}
+
+void TextViewController::appendMessages(const MessageList &messages)
+{
+	if (m_historyPending) {
+		// History goes above messages received while it is being read
+		MessageList history;
+		foreach (const Message &msg, messages) {
+			if (msg.property("history", false))
+				history << msg;
+			else
+				m_pendingMessages << msg;
+		}
+		if (history.isEmpty())
+			return;
+		insertMessages(history);
 		return;
+	}
+	insertMessages(messages);
+}
+
+void TextViewController::insertMessages(const MessageList &messages)
+{
 	QTextCursor cursor(this);
 	cursor.beginEditBlock();
 	bool shouldScroll = isNearBottom();
+	foreach (const Message &msg, messages) {
+		if (!msg.text().isEmpty())
+			insertMessage(cursor, msg);
+	}
+	if (shouldScroll)
+		QTimer::singleShot(0, this, SLOT(ensureScrolling()));
+	cursor.endEditBlock();
+	// Don't move the text while user reads older messages
+	if (shouldScroll)
+		trimScrollback();
+}
+
+void TextViewController::insertMessage(QTextCursor &cursor, const Message &msg)
+{
 	QTextCharFormat defaultFormat;
 	defaultFormat.setFont(m_font);
 	defaultFormat.setForeground(m_baseColor);
@@ -175,16 +285,44 @@ void TextViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 		bool showReceived = msg.isIncoming();
 		if (msg.property("history", false))
 			showReceived = true;
-		if (!showReceived)
-			m_cache.insert(msg.id(), new int(cursor.position()));
+		if (!showReceived) {
+			if (m_receipts.size() >= MaxReceipts)
+				m_receipts.remove(0);
+			MessageReceipt receipt = { msg.id(), cursor.position() };
+			m_receipts.insert(qLowerBound(m_receipts.begin(), m_receipts.end(),
+			                              msg.id(), receiptLessThan), receipt);
+		}
 		cursor.insertImage(QLatin1String(showReceived ? "bullet-received" : "bullet-send"));
 
 		cursor.insertText(QLatin1String(" "), defaultFormat);
 		appendText(cursor, msg.text(), defaultFormat, true);
 	}
-	if (shouldScroll)
-		QTimer::singleShot(0, this, SLOT(ensureScrolling()));
-	cursor.endEditBlock();
+}
+
+void TextViewController::trimScrollback()
+{
+	// Trim by chunks so the layout isn't rebuilt on every message
+	if (m_maxBlockCount <= 0 || blockCount() <= m_maxBlockCount + m_maxBlockCount / 10)
+		return;
+	const int removed = findBlockByNumber(blockCount() - m_maxBlockCount).position();
+	QTextCursor cursor(this);
+	cursor.setPosition(removed, QTextCursor::KeepAnchor);
+	cursor.removeSelectedText();
+
+	for (int i = m_receipts.size() - 1; i >= 0; --i) {
+		MessageReceipt &receipt = m_receipts[i];
+		if (receipt.position < removed)
+			m_receipts.remove(i);
+		else
+			receipt.position -= removed;
+	}
+	for (int i = 0; i < m_emoticons.size(); i++) {
+		QVector<int> &indexes = m_emoticons[i].indexes;
+		int *begin = qLowerBound(indexes.data(), indexes.data() + indexes.size(), removed);
+		indexes.remove(0, begin - indexes.data());
+		for (int j = 0; j < indexes.size(); ++j)
+			indexes[j] -= removed;
+	}
 }
 
 void TextViewController::appendText(QTextCursor &cursor, const QString &text,
@@ -215,7 +353,7 @@ void TextViewController::appendText(QTextCursor &cursor, const QString &text,
 				if (m_animateEmoticons) {
 					emoticonIndex = addEmoticon(token.imgPath);
 					emoticonFormat.setProperty(QTextFormat::UserProperty, emoticonIndex);
-					m_emoticons.at(emoticonIndex).movie->indexes << cursor.position();
+					m_emoticons[emoticonIndex].indexes << cursor.position();
 					cursor.insertText(objectReplacement, emoticonFormat);
 				} else {
 					if (!m_images.contains(token.imgPath)) {
@@ -254,8 +392,7 @@ void TextViewController::drawObject(QPainter *painter, const QRectF &rect, QText
 	Q_UNUSED(doc);
 	int index = format.intProperty(QTextFormat::UserProperty);
 	const EmoticonTrack &track = m_emoticons.at(index);
-	QPixmap pixmap = track.movie->currentPixmap();
-	painter->drawPixmap(rect, pixmap, track.movie->frameRect());
+	painter->drawPixmap(rect, track.frames->frame(track.frame), QRectF(QPointF(), track.frames->size()));
 }
 
 QSizeF TextViewController::intrinsicSize(QTextDocument *doc, int posInDocument, const QTextFormat &format)
@@ -264,7 +401,7 @@ QSizeF TextViewController::intrinsicSize(QTextDocument *doc, int posInDocument,
 	Q_UNUSED(doc);
 	int index = format.intProperty(QTextFormat::UserProperty);
 	const EmoticonTrack &track = m_emoticons.at(index);
-	return track.movie->frameRect().size();
+	return track.frames->size();
 }
 
 int TextViewController::addEmoticon(const QString &filename)
@@ -273,12 +410,12 @@ int TextViewController::addEmoticon(const QString &filename)
 	if (index == m_emoticons.size()) {
 		m_emoticons.append(EmoticonTrack());
 		EmoticonTrack &track = m_emoticons.last();
-		track.movie = new EmoticonMovie(filename, index, this);
-		connect(track.movie, SIGNAL(frameChanged(int)), this, SLOT(animate()));
-		track.movie->setCacheMode(QMovie::CacheAll);
-//		QTimer::singleShot(0, track.movie, SLOT(start()));
+		track.frames = EmoticonFrames::get(filename);
+		track.frame = 0;
+		track.nextFrame = 0;
 		m_hash.insert(filename, index);
-		track.movie->start();
+		if (track.frames->isAnimated())
+			scheduleAnimation();
 	}
 	return index;
 }
@@ -320,35 +457,91 @@ void TextViewController::onAnchorClicked(const QUrl &url)
 	}
 }
 
+bool TextViewController::isAnimationVisible() const
+{
+	if (!m_textEdit || m_emoticons.isEmpty())
+		return false;
+	QWidget *viewport = m_textEdit.data()->viewport();
+	QWidget *window = viewport->window();
+	return viewport->isVisible() && window->isActiveWindow() && !window->isMinimized();
+}
+
+void TextViewController::scheduleAnimation()
+{
+	if (!isAnimationVisible())
+		m_animationTimer.stop();
+	else if (!m_animationTimer.isActive())
+		m_animationTimer.start(0, this);
+}
+
+void TextViewController::updateWindow()
+{
+	QWidget *window = m_textEdit ? m_textEdit.data()->window() : 0;
+	if (m_window.data() == window)
+		return;
+	if (m_window && m_window.data() != m_textEdit.data())
+		m_window.data()->removeEventFilter(this);
+	m_window = window;
+	if (m_window)
+		m_window.data()->installEventFilter(this);
+}
+
 void TextViewController::animate()
 {
-	EmoticonMovie *movie = static_cast<EmoticonMovie*>(sender());
-	if (!m_textEdit) {
-		movie->stop();
+	if (!isAnimationVisible()) {
+		m_animationTimer.stop();
 		return;
 	}
 	QAbstractTextDocumentLayout *layout = documentLayout();
+	QWidget *viewport = m_textEdit.data()->viewport();
 	QRect visibleRect(0, m_textEdit.data()->verticalScrollBar()->value(),
-					  m_textEdit.data()->viewport()->width(),
-					  m_textEdit.data()->viewport()->height());
+					  viewport->width(), viewport->height());
 	int begin = layout->hitTest(visibleRect.topLeft(), Qt::FuzzyHit);
 	int end = layout->hitTest(visibleRect.bottomRight(), Qt::FuzzyHit);
-	int *indexesEnd = movie->indexes.data() + movie->indexes.size();
-	int *beginIndex = qLowerBound(movie->indexes.data(), indexesEnd, begin);
-	int *endIndex = qUpperBound(beginIndex, indexesEnd, end);
-	if (beginIndex == endIndex)
-		return;
+
+	const qint64 now = m_animationClock.elapsed();
+	qint64 next = -1;
 	QRegion region;
 	QTextCursor cursor(this);
-	QSize emoticonSize = movie->frameRect().size();
-	for (int *i = beginIndex; i != endIndex; i++) {
-		cursor.setPosition(*i);
-		QRect cursorRect = m_textEdit.data()->cursorRect(cursor);
-		region += QRectF(cursorRect.topLeft(), emoticonSize).toAlignedRect();
+	for (int i = 0; i < m_emoticons.size(); ++i) {
+		EmoticonTrack &track = m_emoticons[i];
+		if (!track.frames->isAnimated())
+			continue;
+		const int *indexesEnd = track.indexes.constData() + track.indexes.size();
+		const int *beginIndex = qLowerBound(track.indexes.constData(), indexesEnd, begin);
+		const int *endIndex = qUpperBound(beginIndex, indexesEnd, end);
+		// Emoticons out of the viewport are frozen
+		if (beginIndex == endIndex)
+			continue;
+		if (track.nextFrame <= now) {
+			track.frame = (track.frame + 1) % track.frames->frameCount();
+			track.nextFrame = now + qMax<int>(track.frames->delay(track.frame), MinFrameDelay);
+			const QSize emoticonSize = track.frames->size();
+			for (const int *it = beginIndex; it != endIndex; ++it) {
+				cursor.setPosition(*it);
+				QRect cursorRect = m_textEdit.data()->cursorRect(cursor);
+				region += QRectF(cursorRect.topLeft(), emoticonSize).toAlignedRect();
+			}
+		}
+		if (next < 0 || track.nextFrame < next)
+			next = track.nextFrame;
 	}
-	region &= m_textEdit.data()->viewport()->visibleRegion();
+	region &= viewport->visibleRegion();
 	if (!region.isEmpty())
-		m_textEdit.data()->viewport()->update(region);
+		viewport->update(region);
+
+	if (next < 0)
+		m_animationTimer.stop();
+	else
+		m_animationTimer.start(int(qMax<qint64>(0, next - now)), this);
+}
+
+void TextViewController::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_animationTimer.timerId())
+		animate();
+	else
+		QTextDocument::timerEvent(event);
 }
 
 QPixmap TextViewController::createBullet(const QColor &color)
@@ -371,11 +564,11 @@ void TextViewController::init()
 	            createBullet(m_bulletReceivedColor));
 	addResource(QTextDocument::ImageResource, QUrl(QLatin1String("bullet-send")),
 	            createBullet(m_bulletSentColor));
-	for (int i = 0; i < m_emoticons.size(); i++)
-		m_emoticons.at(i).movie->deleteLater();
-	m_cache.clear();
+	m_animationTimer.stop();
+	m_receipts.clear();
 	m_images.clear();
 	m_emoticons.clear();
+	m_hash.clear();
 	m_lastSender.clear();
 	m_lastTime = QDateTime();
 	m_isLastIncoming = false;
@@ -386,16 +579,28 @@ void TextViewController::loadHistory()
 	qDebug() << Q_FUNC_INFO;
 	Config config = Config(QLatin1String("appearance")).group(QLatin1String("chat/history"));
 	int max_num = config.value(QLatin1String("maxDisplayMessages"), 5);
-    MessageList messages = History::instance()->readSync(m_session->getUnit(), max_num);
-	foreach (Message mess, messages) {
-		mess.setProperty("silent", true);
-		mess.setProperty("store", false);
-		mess.setProperty("history", true);
-		if (!mess.chatUnit()) //TODO FIXME
-			mess.setChatUnit(m_session->getUnit());
-		m_session->append(mess);
-	}
-	m_lastSender.clear();
+	const int generation = ++m_historyGeneration;
+	m_historyPending = true;
+	History::instance()->read(m_session->getUnit(), max_num).connect(this, [this, generation] (const MessageList &result) {
+		if (generation != m_historyGeneration || !m_session)
+			return;
+		MessageList messages = result;
+		for (int i = 0; i < messages.size(); ++i) {
+			Message &mess = messages[i];
+			mess.setProperty("silent", true);
+			mess.setProperty("store", false);
+			mess.setProperty("history", true);
+			if (!mess.chatUnit()) //TODO FIXME
+				mess.setChatUnit(m_session->getUnit());
+		}
+		m_session->append(messages);
+		m_lastSender.clear();
+		m_historyPending = false;
+		MessageList pending;
+		qSwap(pending, m_pendingMessages);
+		if (!pending.isEmpty())
+			insertMessages(pending);
+	});
 }
 
 QString TextViewController::makeName(const Message &mes)
@@ -439,29 +644,60 @@ QString TextViewController::quote()
 
 void TextViewController::setTextEdit(QTextBrowser *edit)
 {
-	if (m_textEdit)
+	if (m_textEdit) {
 		disconnect(m_textEdit.data(), 0, this, 0);
+		disconnect(m_textEdit.data()->verticalScrollBar(), 0, this, 0);
+		m_textEdit.data()->removeEventFilter(this);
+		m_textEdit.data()->viewport()->removeEventFilter(this);
+	}
 	m_textEdit = edit;
 	if (m_textEdit) {
 		connect(m_textEdit.data(), SIGNAL(anchorClicked(QUrl)), this, SLOT(onAnchorClicked(QUrl)));
+		// Scrolled in emoticons start to move again
+		connect(m_textEdit.data()->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scheduleAnimation()));
+		m_textEdit.data()->installEventFilter(this);
+		m_textEdit.data()->viewport()->installEventFilter(this);
 		QPalette p = m_textEdit.data()->viewport()->palette();
 		p.setColor(QPalette::Base, m_backgroundColor);
 		m_textEdit.data()->viewport()->setPalette(p);
 	}
-	for (int i = 0; i < m_emoticons.size(); i++)
-		m_emoticons.at(i).movie->setPaused(!edit);
+	updateWindow();
+	scheduleAnimation();
 }
 
 bool TextViewController::eventFilter(QObject *obj, QEvent *ev)
 {
+	if (obj->isWidgetType()) {
+		switch (ev->type()) {
+		case QEvent::ParentChange:
+			// Chat may be moved to another window
+			updateWindow();
+			scheduleAnimation();
+			break;
+		case QEvent::Show:
+		case QEvent::Hide:
+		case QEvent::WindowActivate:
+		case QEvent::WindowDeactivate:
+		case QEvent::WindowStateChange:
+			scheduleAnimation();
+			break;
+		default:
+			break;
+		}
+		return false;
+	}
 	if (ev->type() == MessageReceiptEvent::eventType()) {
 		MessageReceiptEvent *msgEvent = static_cast<MessageReceiptEvent *>(ev);
-		int *pos = m_cache.take(msgEvent->id());
-		qDebug() << msgEvent->id() << (pos ? *pos : -1);
-		if (pos) {
+		QVector<MessageReceipt>::iterator it = qLowerBound(m_receipts.begin(), m_receipts.end(),
+		                                                   msgEvent->id(), receiptLessThan);
+		const bool found = it != m_receipts.end() && it->id == msgEvent->id();
+		qDebug() << msgEvent->id() << (found ? it->position : -1);
+		if (found) {
+			const int pos = it->position;
+			m_receipts.erase(it);
 			QTextCursor cursor(this);
 			cursor.beginEditBlock();
-			cursor.setPosition(*pos);
+			cursor.setPosition(pos);
 			cursor.deleteChar();
 			if (msgEvent->success())
 				cursor.insertImage(QLatin1String("bullet-received"));
@@ -472,7 +708,6 @@ bool TextViewController::eventFilter(QObject *obj, QEvent *ev)
 //			QTextImageFormat format;
 //			format.setName(QLatin1String("bullet-received"));
 //			cursor.setCharFormat(format);
-			delete pos;
 		}
 		return true;
 	}
@@ -29,35 +29,55 @@
 #include <qutim/adiumchat/chatviewfactory.h>
 #include <QTextDocument>
 #include <QTextBrowser>
-#include <QCache>
+#include <QVector>
 #include <QPointer>
 #include <QDateTime>
 #include <QTextObjectInterface>
-#include <QMovie>
+#include <QSharedPointer>
+#include <QBasicTimer>
+#include <QElapsedTimer>
 
 namespace Core
 {
 namespace AdiumChat
 {
-class EmoticonMovie : public QMovie
+// Frames of emoticon image decoded once and shared by all chat views
+class EmoticonFrames
 {
 public:
-	EmoticonMovie(const QString &fileName, int index, QObject *parent) :
-	    QMovie(fileName, QByteArray(), parent)
-	{
-		m_index = index;
-	}
-	
-	QVector<int> indexes;
-	
-	int index() const { return m_index; }
+	static QSharedPointer<EmoticonFrames> get(const QString &fileName);
+
+	QSize size() const { return m_size; }
+	bool isAnimated() const { return m_animated; }
+	// Other frames than the first one are decoded on first access
+	int frameCount();
+	const QPixmap &frame(int index) const;
+	int delay(int index) const;
 private:
-	int m_index;
+	explicit EmoticonFrames(const QString &fileName);
+	void decode();
+
+	QString m_fileName;
+	QVector<QPixmap> m_frames;
+	QVector<int> m_delays;
+	QSize m_size;
+	bool m_animated;
+	bool m_decoded;
 };
 
 struct EmoticonTrack
 {
-	EmoticonMovie *movie;
+	QSharedPointer<EmoticonFrames> frames;
+	// Positions of emoticon in the document, sorted
+	QVector<int> indexes;
+	int frame;
+	qint64 nextFrame;
+};
+
+struct MessageReceipt
+{
+	qint64 id;
+	int position;
 };
 
 class TextViewController : public QTextDocument, public ChatViewController, public QTextObjectInterface
@@ -70,6 +90,7 @@ public:
 	virtual void setChatSession(qutim_sdk_0_3::ChatSession *session);
 	virtual qutim_sdk_0_3::ChatSession *getSession() const;
 	virtual void appendMessage(const qutim_sdk_0_3::Message &msg);
+	virtual void appendMessages(const qutim_sdk_0_3::MessageList &messages);
 	void appendText(QTextCursor &cursor, const QString &text, const QTextCharFormat &format, bool emo);
 	virtual void clearChat();
 	virtual QString quote();
@@ -89,26 +110,36 @@ public slots:
 	void ensureScrolling();
 protected slots:
 	void onAnchorClicked(const QUrl &url);
-	void animate();
+	void scheduleAnimation();
+protected:
+	void timerEvent(QTimerEvent *event);
 private:
+	void animate();
+	// Emoticons are animated only in visible part of shown and active window
+	bool isAnimationVisible() const;
+	void updateWindow();
 	QPixmap createBullet(const QColor &color);
 	void init();
 	void loadHistory();
+	void insertMessages(const qutim_sdk_0_3::MessageList &messages);
+	void insertMessage(QTextCursor &cursor, const qutim_sdk_0_3::Message &msg);
 	int addEmoticon(const QString &filename);
 	QString makeName(const qutim_sdk_0_3::Message &mes);
 	bool shouldBreak(const QDateTime &time);
+	void trimScrollback();
 	
 	QPointer<QTextBrowser> m_textEdit;
 	qutim_sdk_0_3::ChatSession *m_session;
-	QCache<qint64, int> m_cache;
+	// Positions of bullets of not yet delivered messages, sorted by id
+	QVector<MessageReceipt> m_receipts;
 	QDateTime m_lastTime;
 	QString m_lastSender;
 	bool m_isLastIncoming;
 	bool m_animateEmoticons;
-	bool m_atAnimation;
 	short m_groupUntil;
 	int m_scrollBarPosition;
 	int m_bulletSize;
+	int m_maxBlockCount;
 	QFont m_font;
 	QColor m_backgroundColor;
 	QColor m_incomingColor;
@@ -122,6 +153,13 @@ private:
 	QSet<QString> m_images;
 	QHash<QString, int> m_hash;
 	QList<EmoticonTrack> m_emoticons;
+	QBasicTimer m_animationTimer;
+	QElapsedTimer m_animationClock;
+	QPointer<QWidget> m_window;
+	// Messages appended while history is being read
+	qutim_sdk_0_3::MessageList m_pendingMessages;
+	bool m_historyPending;
+	int m_historyGeneration;
 };
 }
 }
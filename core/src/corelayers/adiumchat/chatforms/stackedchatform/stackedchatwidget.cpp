@@ -264,7 +264,7 @@ void StackedChatWidget::addSession(ChatSessionImpl *session)
 	qDebug() << Q_FUNC_INFO;
 	m_sessionList->addSession(session);
 	connect(session,SIGNAL(activated(bool)),SLOT(onSessionActivated(bool)));
-	connect(session,SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),SLOT(onUnreadChanged()));
+	connect(session,SIGNAL(unreadCountChanged(int)),SLOT(onUnreadChanged()));
 }
 
 void StackedChatWidget::removeSession(ChatSessionImpl *session)
@@ -305,7 +305,7 @@ void StackedChatWidget::onSessionActivated(bool active)
 
 void StackedChatWidget::activate(ChatSessionImpl *session)
 {
-	if(!session->unread().isEmpty())
+	if(session->unreadCount())
 		session->markRead();
 
 	bool isActivateWindow = false;
@@ -36,6 +36,10 @@
 #include <QAbstractButton>
 #include <QStyleOption>
 #include <QPainter>
+#include <QBasicTimer>
+#include <QHash>
+#include <QSet>
+#include <QTimerEvent>
 #include <qutim/conference.h>
 
 namespace Core
@@ -43,11 +47,27 @@ namespace Core
 namespace AdiumChat
 {
 
+// Updates of busy sessions are applied once per frame
+enum { UpdateInterval = 16 };
+
+// What is currently shown by the tab, QTabBar relayouts all tabs on every
+// text or icon change, so equal values are not set again
+struct TabState
+{
+	QString text;
+	QColor color;
+	QIcon icon;
+};
+
 struct TabBarPrivate
 {
 	bool closableActiveTab;
 	ChatSessionList sessions;
 	QMenu *sessionList;
+	QHash<ChatSessionImpl*, TabState> states;
+	QSet<ChatSessionImpl*> dirtySessions;
+	QBasicTimer updateTimer;
+	QIcon unreadIcon;
 };
 
 class CloseButton : public QAbstractButton
@@ -275,6 +295,12 @@ void TabBar::addSession(ChatSessionImpl *session)
 	connect(session,SIGNAL(destroyed(QObject*)),SLOT(onRemoveSession(QObject*)));
 	connect(session,SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),
 			this,SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+
+	TabState &state = p->states[session];
+	state.text = u->title();
+	state.icon = icon;
+	if (!session->unread().isEmpty())
+		updateTab(session);
 }
 
 void TabBar::removeSession(ChatSessionImpl *session)
@@ -338,6 +364,8 @@ void TabBar::onRemoveSession(QObject *obj)
 	ChatSessionImpl *s = static_cast<ChatSessionImpl*>(obj);
 	int index = p->sessions.indexOf(s);
 	p->sessions.removeAll(s);
+	p->states.remove(s);
+	p->dirtySessions.remove(s);
 	p->sessionList->removeAction(p->sessionList->actions().at(index));
 	QTabBar::removeTab(index);
 }
@@ -357,7 +385,9 @@ void TabBar::onTitleChanged(const QString &title)
 {
 	ChatUnit *u = qobject_cast<ChatUnit*>(sender());
 	ChatSessionImpl *s = static_cast<ChatSessionImpl*>(ChatLayer::get(u,false));
-	setTabText(indexOf(s),title);
+	Q_UNUSED(title);
+	if (s)
+		scheduleUpdate(s);
 }
 
 void TabBar::onChatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState now, qutim_sdk_0_3::ChatUnit::ChatState)
@@ -426,63 +456,92 @@ bool TabBar::event(QEvent *event)
 
 void TabBar::chatStateChanged(ChatUnit::ChatState state, ChatSessionImpl *session)
 {
-	if(session->unread().count())
-		return;
-	QIcon icon = ChatLayerImpl::iconForState(state, session->getUnit());
-	setSessionIcon(session, icon);
+	Q_UNUSED(state);
+	scheduleUpdate(session);
 }
 
 void TabBar::statusChanged(const Status &status, ChatSessionImpl *session)
 {
-	if(session->unread().count())
-		return;
-	setSessionIcon(session, status.icon());
+	Q_UNUSED(status);
+	scheduleUpdate(session);
 }
 
 void TabBar::setSessionIcon(ChatSessionImpl *session, const QIcon &icon)
 {
-#ifdef Q_OS_MAC
 	const int index = indexOf(session);
+#ifdef Q_OS_MAC
 	CloseButton *button = static_cast<CloseButton*>(tabButton(index, closeButtonSide(this)));
 	button->setIcon(icon);
 #else
-	setTabIcon(indexOf(session), icon);
+	setTabIcon(index, icon);
 #endif
-	p->sessionList->actions().at(indexOf(session))->setIcon(icon);
+	p->sessionList->actions().at(index)->setIcon(icon);
 }
 
 void TabBar::onUnreadChanged(const qutim_sdk_0_3::MessageList &unread)
 {
-	ChatSessionImpl *session = static_cast<ChatSessionImpl*>(sender());
-	int index = indexOf(session);
-	QIcon icon;
-	QString title = session->getUnit()->title();
-	if (unread.isEmpty()) {
-		ChatUnit::ChatState state = static_cast<ChatUnit::ChatState>(session->property("currentChatState").toInt());//FIXME remove in future
-		icon =  ChatLayerImpl::iconForState(state,session->getUnit());
-	} else {
-		icon = Icon("mail-unread-new");
+	Q_UNUSED(unread);
+	scheduleUpdate(static_cast<ChatSessionImpl*>(sender()));
+}
+
+void TabBar::scheduleUpdate(ChatSessionImpl *session)
+{
+	p->dirtySessions.insert(session);
+	if (!p->updateTimer.isActive())
+		p->updateTimer.start(UpdateInterval, this);
+}
+
+void TabBar::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != p->updateTimer.timerId()) {
+		QTabBar::timerEvent(event);
+		return;
 	}
+	p->updateTimer.stop();
+	const QSet<ChatSessionImpl*> sessions = p->dirtySessions;
+	p->dirtySessions.clear();
+	foreach (ChatSessionImpl *session, sessions)
+		updateTab(session);
+}
+
+void TabBar::updateTab(ChatSessionImpl *session)
+{
+	const int index = indexOf(session);
+	if (index == -1)
+		return;
+	ChatUnit *unit = session->getUnit();
+	const MessageList unread = session->unread();
 
-	QPalette pal;
-	int unreadMessages = 0;
 	bool messagesForMe = false;
-	QString str = title;
-	setTabTextColor(index, pal.color(QPalette::WindowText));
-	setSessionIcon(session, icon);
-	setTabText(index, title);
-	for (int i = 0; i < unread.size(); ++i) {
-		qutim_sdk_0_3::Message message = unread.at(i);
-		unreadMessages ++;
-		messagesForMe |= (message.property("mention") == true || !qobject_cast<Conference*>(message.chatUnit()));
+	for (int i = 0; i < unread.size() && !messagesForMe; ++i) {
+		const qutim_sdk_0_3::Message &message = unread.at(i);
+		messagesForMe = message.property("mention") == true || !qobject_cast<Conference*>(message.chatUnit());
 	}
-	if (messagesForMe) {
-		str.prepend(QLatin1Char('*'));
-		setTabTextColor(index, pal.color(QPalette::Highlight));
+
+	TabState state;
+	state.text = unit->title();
+	if (messagesForMe)
+		state.text.prepend(QLatin1Char('*'));
+	if (!unread.isEmpty())
+		state.text += QLatin1String(" (") + QString::number(unread.size()) + QLatin1Char(')');
+	state.color = QPalette().color(messagesForMe ? QPalette::Highlight : QPalette::WindowText);
+	if (unread.isEmpty()) {
+		state.icon = ChatLayerImpl::iconForState(unit->chatState(), unit);
+	} else {
+		if (p->unreadIcon.isNull())
+			p->unreadIcon = Icon("mail-unread-new");
+		state.icon = p->unreadIcon;
 	}
-	if (unreadMessages > 0)
-		str.append(" (" + QString::number(unreadMessages) + ")");
-	setTabText(index, str);
+
+	TabState &current = p->states[session];
+	if (current.color != state.color)
+		setTabTextColor(index, state.color);
+	if (current.icon.cacheKey() != state.icon.cacheKey())
+		setSessionIcon(session, state.icon);
+	if (current.text != state.text)
+		setTabText(index, state.text);
+	p->sessionList->actions().at(index)->setText(unit->title());
+	current = state;
 }
 
 void TabBar::onContextMenu(const QPoint &pos)
@@ -72,6 +72,7 @@ protected:
 	void chatStateChanged(ChatUnit::ChatState state, ChatSessionImpl *session);
 	void statusChanged(const Status &status, ChatSessionImpl *session);
 	void setSessionIcon(ChatSessionImpl *session, const QIcon &icon);
+	virtual void timerEvent(QTimerEvent *event);
 private slots:
 	void onCurrentChanged(int index);
 	void onCloseRequested(int index);
@@ -85,6 +86,9 @@ private slots:
 	void onStatusChanged(const qutim_sdk_0_3::Status &status);
 	void onCloseButtonClicked();
 private:
+	void scheduleUpdate(ChatSessionImpl *session);
+	void updateTab(ChatSessionImpl *session);
+
 	QScopedPointer<TabBarPrivate> p;
 };
 
@@ -358,7 +358,7 @@ void TabbedChatWidget::addSession(ChatSessionImpl *session)
     m_tabBar->addSession(session);
 
     connect(session, SIGNAL(activated(bool)), SLOT(onSessionActivated(bool)));
-    connect(session, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)), SLOT(onUnreadChanged()));
+    connect(session, SIGNAL(unreadCountChanged(int)), SLOT(onUnreadChanged()));
     connect(session, SIGNAL(controllerDestroyed(QObject*)),
             this, SLOT(onControllerDestroyed(QObject*)));
 }
@@ -388,7 +388,7 @@ void TabbedChatWidget::onSessionActivated(bool active)
 
 void TabbedChatWidget::activate(ChatSessionImpl *session)
 {
-    if (!session->unread().isEmpty())
+    if (session->unreadCount())
         session->markRead();
 
     activateWindow();
@@ -202,11 +202,17 @@ AbstractChatWidget *AbstractChatForm::widget(const QString &key)
 void AbstractChatForm::onSessionCreated(ChatSession *session)
 {
 	ChatSessionImpl *s = static_cast<ChatSessionImpl*>(session);
+	connect(s, SIGNAL(activated(bool)), SLOT(onSessionActivated(bool)));
+	// Background sessions (e.g. rooms joined on startup) don't build any
+	// window, it's created by onSessionActivated when user opens them
 	QString key = getWidgetId(s);
-	AbstractChatWidget *w = widget(key);
+	AbstractChatWidget *w = m_chatWidgets.value(key);
+	if (!w && !s->isActive())
+		return;
+	if (!w)
+		w = widget(key);
 	if (!w->contains(s))
 		w->addSession(s);
-	connect(s, SIGNAL(activated(bool)), SLOT(onSessionActivated(bool)));
 }
 
 AbstractChatForm::~AbstractChatForm()
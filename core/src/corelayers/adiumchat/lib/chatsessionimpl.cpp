@@ -36,18 +36,22 @@
 #include <qutim/conference.h>
 #include <qutim/debug.h>
 #include <qutim/servicemanager.h>
+#include <qutim/memoryaccounting.h>
 #include "chatviewfactory.h"
+#include "chatstateengine.h"
 
 namespace Core
 {
 namespace AdiumChat
 {
 
-enum { LastMessagesCount = 5 };
+enum { LastMessagesCount = 5, HeadlessMessagesCount = 500 };
 
 ChatSessionImplPrivate::ChatSessionImplPrivate() :
 	hasJavaScript(false),
 	focus(InFocus),
+	headlessMessages(HeadlessMessagesCount),
+	creatingController(false),
 	myselfChatState(ChatUnit::ChatStateInActive),
 	m_showReceiverId(false)
 {
@@ -67,19 +71,45 @@ ChatSessionImpl::ChatSessionImpl(ChatUnit* unit, ChatLayer* chat)
 	d->q_ptr = this;
 	d->chatUnit = unit;
 	d->lastMessagesIndex = 0;
+	d->appendDepth = 0;
+	d->addContactsDepth = 0;
 	Config cfg = Config("appearance").group("chat");
 	d->sendToLastActiveResource = cfg.value("sendToLastActiveResource", false);
 	d->inactive_timer.setSingleShot(true);
+	d->chatStateEngine = new ChatStateEngine(d);
+	connect(d->chatStateEngine, SIGNAL(stateChanged(qutim_sdk_0_3::ChatUnit::ChatState)),
+			d, SLOT(sendChatState(qutim_sdk_0_3::ChatUnit::ChatState)));
 
 	connect(&d->inactive_timer,SIGNAL(timeout()),d,SLOT(onActiveTimeout()));
 	d->chatUnit.clear();
 	setChatUnit(unit);
+
+	MemoryAccounting::add(MemoryAccounting::ChatSessions, this, unit->id(), [d] () {
+		qint64 result = sizeof(ChatSessionImplPrivate) + d->input->characterCount() * 2;
+		foreach (const Message &message, d->unread)
+			result += MemoryAccounting::messageSize(message);
+		for (const MessageList *list : { &d->lastMessages, &d->pendingMessages }) {
+			foreach (const Message &message, *list)
+				result += MemoryAccounting::messageSize(message);
+		}
+		for (int i = d->headlessMessages.firstIndex(); i <= d->headlessMessages.lastIndex(); ++i)
+			result += MemoryAccounting::messageSize(d->headlessMessages.at(i));
+		return result;
+	}, [d] (qint64) {
+		// Only the messages kept for reopened chat views may be dropped,
+		// headless ones are in history anyway
+		d->lastMessages.clear();
+		d->lastMessagesIndex = 0;
+		d->headlessMessages.clear();
+	});
 }
 
 void ChatSessionImpl::clearChat()
 {
 	Q_D(ChatSessionImpl);
-	d->getController()->clearChat();
+	d->headlessMessages.clear();
+	if (d->controller)
+		d->getController()->clearChat();
 }
 
 QString ChatSessionImpl::quote()
@@ -87,6 +117,49 @@ QString ChatSessionImpl::quote()
 	return d_func()->getController()->quote();
 }
 
+void ChatSessionImpl::virtual_hook(int id, void *data)
+{
+	Q_D(ChatSessionImpl);
+	switch (id) {
+	case BeginAppendHook:
+		d->appendDepth++;
+		break;
+	case EndAppendHook:
+		if (d->appendDepth == 1 && !d->pendingNotifications.isEmpty())
+			d->sendPendingNotifications();
+		if (--d->appendDepth == 0 && !d->pendingMessages.isEmpty()) {
+			MessageList messages;
+			qSwap(messages, d->pendingMessages);
+			if (d->controller) {
+				d->getController()->appendMessages(messages);
+			} else {
+				foreach (const Message &message, messages)
+					d->headlessMessages.append(message);
+			}
+		}
+		break;
+	case BeginAddContactsHook:
+		if (d->addContactsDepth++ == 0)
+			d->model.data()->beginBulkInsert();
+		break;
+	case EndAddContactsHook:
+		if (--d->addContactsDepth == 0) {
+			d->model.data()->endBulkInsert();
+			emit buddiesChanged();
+		}
+		break;
+	case UnreadCountHook:
+		*reinterpret_cast<int*>(data) = d->unread.size();
+		break;
+	case MarkReadUntilHook:
+		eraseUnreadUntil(d->unread.upperBound(*reinterpret_cast<quint64*>(data)));
+		break;
+	default:
+		ChatSession::virtual_hook(id, data);
+		break;
+	}
+}
+
 ChatSessionImpl::~ChatSessionImpl()
 {
 	Q_D(ChatSessionImpl);
@@ -98,8 +171,10 @@ ChatSessionImpl::~ChatSessionImpl()
 void ChatSessionImpl::addContact(Buddy* c)
 {
 	//		connect(c,SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),SLOT(statusChanged(qutim_sdk_0_3::Status)));
-	d_func()->model.data()->addContact(c);
-	emit buddiesChanged();
+	Q_D(ChatSessionImpl);
+	d->model.data()->addContact(c);
+	if (!d->addContactsDepth)
+		emit buddiesChanged();
 }
 
 qint64 ChatSessionImpl::doAppendMessage(Message &message)
@@ -115,33 +190,37 @@ qint64 ChatSessionImpl::doAppendMessage(Message &message)
     else
         emit messageSent(&message);
 
-	if (message.property("spam", false) || message.property("hide", false))
+	if (message.property(Message::SpamProperty, false) || message.property(Message::HideProperty, false))
 		return message.id();
 
-	if ((!isActive() && !message.property("service", false))
+	if ((!isActive() && !message.property(Message::ServiceProperty, false))
 			&& message.isIncoming()
-			&& !message.property("history", false)) {
-		d->unread.append(message);
-        emit unreadChanged(d->unread);
+			&& !message.property(Message::HistoryProperty, false)) {
+		d->unread.insert(message.id(), message);
+		emit unreadAdded(message);
+		emitUnreadChanged();
 	}
 
 	//if (!message.isIncoming())
 	//	setChatState(ChatUnit::ChatStateActive);
 
-	bool service = message.property("service").isValid();
+	if (message.isIncoming() && !message.property(Message::HistoryProperty, false) && d->model)
+		d->model.data()->markActive(qobject_cast<Buddy*>(const_cast<ChatUnit*>(message.chatUnit())));
+
+	bool service = message.property(Message::ServiceProperty).isValid();
 	const Conference *conf = qobject_cast<const Conference *>(message.chatUnit());
 	if (!service && !conf
 			&& message.chatUnit() != d->current_unit.data()
 			&& message.isIncoming()
-			&& !message.property("history", false))
+			&& !message.property(Message::HistoryProperty, false))
 	{
 		d->last_active_unit = const_cast<ChatUnit*>(message.chatUnit());
 	}
 
-	if (!message.property("service", false)
-			&& (!conf || message.property("mention", false))
+	if (!message.property(Message::ServiceProperty, false)
+			&& (!conf || message.property(Message::MentionProperty, false))
 			&& message.isIncoming()
-			&& !message.property("history", false)) {
+			&& !message.property(Message::HistoryProperty, false)) {
         ChatLayer::instance()->alert(300);
 		if (conf) {
 			ServicePointer<AbstractChatForm> form("ChatForm");
@@ -153,17 +232,28 @@ qint64 ChatSessionImpl::doAppendMessage(Message &message)
 		}
 	}
 
-	if (!message.property("silent", false))
-		Notification::send(message);
+	if (!message.property(Message::SilentProperty, false)) {
+		if (d->appendDepth > 0)
+			d->pendingNotifications << message;
+		else
+			Notification::send(message);
+	}
 
-	if(!message.property("fake",false)) {
+	if(!message.property(Message::FakeProperty,false)) {
 		if (d->focus == ChatSessionImplPrivate::FirstOutOfFocus)
-			message.setProperty("firstFocus", true);
+			message.setProperty(Message::FirstFocusProperty, true);
 		if (d->focus & ChatSessionImplPrivate::OutOfFocus)
-			message.setProperty("focus", true);
+			message.setProperty(Message::FocusProperty, true);
 		d->focus &= ChatSessionImplPrivate::OutOfFocus;
-		d->getController()->appendMessage(message);
-		if (!message.property("service", false) && !message.property("topic", false)) {
+		if (d->creatingController && message.property(Message::HistoryProperty, false))
+			d->controllerHistory << message;
+		if (!d->controller)
+			d->headlessMessages.append(message);
+		else if (d->appendDepth > 0)
+			d->pendingMessages << message;
+		else
+			d->getController()->appendMessage(message);
+		if (!message.property(Message::ServiceProperty, false) && !message.property(Message::TopicProperty, false)) {
 			if (d->lastMessages.count() < LastMessagesCount) {
 				d->lastMessages << message;
 			} else {
@@ -223,13 +313,72 @@ void ChatSessionImplPrivate::ensureController()
 		controller = factory->createViewController();
 		ChatViewController *c = qobject_cast<ChatViewController*>(controller.data());
 		Q_ASSERT(c);
+		creatingController = true;
 		c->setChatSession(q_ptr);
+		creatingController = false;
+		replayHeadlessMessages();
 		hasJavaScript = controller.data()->metaObject()->indexOfMethod("evaluateJavaScript(QString)") != -1;
 		emit q->javaScriptSupportChanged(hasJavaScript); //hack, because getController is a const method
 		connect(controller.data(), SIGNAL(destroyed(QObject*)), q, SIGNAL(controllerDestroyed(QObject*)));
 	}
 }
 
+void ChatSessionImplPrivate::sendPendingNotifications()
+{
+	MessageList messages;
+	qSwap(messages, pendingNotifications);
+	if (messages.size() == 1) {
+		Notification::send(messages.first());
+		return;
+	}
+	enum { MaxNotificationTexts = 5 };
+	// One popup and one sound for the whole batch, like offline messages
+	// replayed after login, with the text of the latest messages
+	NotificationRequest request(messages.last());
+	QStringList texts;
+	const int first = qMax(0, messages.size() - MaxNotificationTexts);
+	if (first > 0)
+		texts << ChatSessionImpl::tr("%n more message(s)", 0, first);
+	for (int i = first; i < messages.size(); ++i)
+		texts << messages.at(i).text();
+	request.setText(texts.join(QLatin1Char('\n')));
+	request.send();
+}
+
+static bool isSameMessage(const Message &a, const Message &b)
+{
+	return a.time() == b.time()
+			&& a.isIncoming() == b.isIncoming()
+			&& a.text() == b.text();
+}
+
+void ChatSessionImplPrivate::replayHeadlessMessages()
+{
+	MessageList loadedHistory;
+	qSwap(loadedHistory, controllerHistory);
+	if (headlessMessages.isEmpty())
+		return;
+
+	// Controller has just shown the tail of history, which may already
+	// contain the oldest buffered messages
+	MessageList messages;
+	for (int i = headlessMessages.firstIndex(); i <= headlessMessages.lastIndex(); ++i) {
+		const Message &message = headlessMessages.at(i);
+		bool duplicate = false;
+		foreach (const Message &historyMessage, loadedHistory) {
+			if (isSameMessage(message, historyMessage)) {
+				duplicate = true;
+				break;
+			}
+		}
+		if (!duplicate)
+			messages << message;
+	}
+	headlessMessages.clear();
+	if (!messages.isEmpty())
+		getController()->appendMessages(messages);
+}
+
 ChatUnit* ChatSessionImpl::getCurrentUnit() const
 {
 	Q_D(const ChatSessionImpl);
@@ -286,23 +435,47 @@ void ChatSessionImpl::markRead(quint64 id)
 {
 	Q_D(ChatSessionImpl);
 	if (id == Q_UINT64_C(0xffffffffffffffff)) {
-		d->unread.clear();
-		unreadChanged(d->unread);
+		eraseUnreadUntil(d->unread.end());
 		return;
 	}
-	MessageList::iterator it = d->unread.begin();
-	for (; it != d->unread.end(); it++) {
-		if (it->id() == id) {
-			d->unread.erase(it);
-			unreadChanged(d->unread);
-			return;
-		}
+	QMap<quint64, Message>::iterator it = d->unread.find(id);
+	if (it == d->unread.end())
+		return;
+	d->unread.erase(it);
+	emit unreadRemoved(id, id);
+	emitUnreadChanged();
+}
+
+void ChatSessionImpl::eraseUnreadUntil(QMap<quint64, Message>::iterator end)
+{
+	Q_D(ChatSessionImpl);
+	if (end == d->unread.begin())
+		return;
+	const quint64 first = d->unread.firstKey();
+	const quint64 last = (end - 1).key();
+	if (end == d->unread.end()) {
+		d->unread.clear();
+	} else {
+		while (d->unread.begin() != end)
+			d->unread.erase(d->unread.begin());
 	}
+	emit unreadRemoved(first, last);
+	emitUnreadChanged();
+}
+
+void ChatSessionImpl::emitUnreadChanged()
+{
+	Q_D(ChatSessionImpl);
+	emit unreadCountChanged(d->unread.size());
+	// Building of the list is the expensive part, skip it if nobody needs it
+	static const QMetaMethod unreadChangedSignal = QMetaMethod::fromSignal(&ChatSession::unreadChanged);
+	if (isSignalConnected(unreadChangedSignal))
+		emit unreadChanged(d->unread.values());
 }
 
 MessageList ChatSessionImpl::unread() const
 {
-	return d_func()->unread;
+	return d_func()->unread.values();
 }
 
 void ChatSessionImpl::setChatUnit(ChatUnit* unit)
@@ -357,6 +530,15 @@ void ChatSessionImplPrivate::onActiveTimeout()
 	}
 }
 
+void ChatSessionImplPrivate::sendChatState(ChatUnit::ChatState state)
+{
+	Q_Q(ChatSessionImpl);
+	if (ChatUnit *currentUnit = q->getCurrentUnit()) {
+		ChatStateEvent event(state);
+		qApp->sendEvent(currentUnit, &event);
+	}
+}
+
 void ChatSessionImpl::setChatState(ChatUnit::ChatState state)
 {
 	Q_D(ChatSessionImpl);
@@ -364,10 +546,7 @@ void ChatSessionImpl::setChatState(ChatUnit::ChatState state)
 		d->inactive_timer.start();
 		return;
 	}
-	if (ChatUnit *currentUnit = getCurrentUnit()) {
-		ChatStateEvent event(state);
-		qApp->sendEvent(currentUnit, &event);
-	}
+	d->chatStateEngine->setState(state);
 	d->myselfChatState = state;
 	switch(state) {
 	case ChatUnit::ChatStateComposing:
@@ -29,6 +29,7 @@
 #include <QTextDocument>
 #include <QDateTime>
 #include <QTimer>
+#include <QMap>
 #include "chatlayer_global.h"
 #include <qutim/chatsession.h>
 
@@ -88,7 +89,11 @@ public slots:
 	QVariant evaluateJavaScript(const QString &scriptSource);
 	void clearChat();
 	QString quote();
+protected:
+	virtual void virtual_hook(int id, void *data);
 private:
+	void eraseUnreadUntil(QMap<quint64, Message>::iterator end);
+	void emitUnreadChanged();
 	QScopedPointer<ChatSessionImplPrivate> d_ptr;
 };
 
@@ -29,6 +29,8 @@
 #include <QPointer>
 #include <QTimer>
 #include <QDateTime>
+#include <QMap>
+#include <QContiguousCache>
 #include <qutim/message.h>
 #include <qutim/status.h>
 #include <qutim/chatunit.h>
@@ -50,6 +52,7 @@ using namespace qutim_sdk_0_3;
 
 class ChatSessionModel;
 class ChatSessionImpl;
+class ChatStateEngine;
 class ChatViewController;
 class ChatSessionImplPrivate : public QObject
 {
@@ -67,6 +70,8 @@ public:
 	void fillMenu(QMenu *menu, ChatUnit *unit, const ChatUnitList &lowerUnits, bool root = true);
 	ChatViewController *getController();
 	void ensureController();
+	void replayHeadlessMessages();
+	void sendPendingNotifications();
 	QPointer<QObject> controller;
     QPointer<ChatUnit> chatUnit;
     QPointer<ChatUnit> current_unit; // the unit chosen by user as receiver
@@ -80,14 +85,30 @@ public:
 	mutable bool hasJavaScript;
 	qint8 focus;
 	qint8 lastMessagesIndex;
+	int appendDepth;
+	int addContactsDepth;
 	QTimer inactive_timer;
-	MessageList unread;
+	// Message ids grow monotonically, so the map keeps unread in order
+	// and any prefix of it may be marked read at once
+	QMap<quint64, Message> unread;
 	MessageList lastMessages;
+	// Messages waiting for the end of batch append to be passed to the view
+	MessageList pendingMessages;
+	// Messages of batch append, which are announced by one notification
+	MessageList pendingNotifications;
+	// Session without controller doesn't build any view for background
+	// messages, last of them are kept here until the view is requested
+	QContiguousCache<Message> headlessMessages;
+	// History messages loaded by controller while it's being created
+	MessageList controllerHistory;
+	bool creatingController;
 	ChatUnit::ChatState myselfChatState;
+	ChatStateEngine *chatStateEngine;
 	ChatSessionImpl *q_ptr;
 	bool m_showReceiverId;
 public slots:
 	void onActiveTimeout();
+	void sendChatState(qutim_sdk_0_3::ChatUnit::ChatState state);
 	void onResourceChosen(bool active);
 	void onSendToLastActiveResourceActivated(bool active);
 	void onLowerUnitAdded();
@@ -27,8 +27,8 @@
 #ifndef CHATSESSIONMODEL_H
 #define CHATSESSIONMODEL_H
 
-#include <QAbstractListModel>
 #include "chatsessionimpl.h"
+#include "conferenceparticipantsmodel.h"
 
 enum ContactItemRole
 {
@@ -53,40 +53,12 @@ namespace AdiumChat
 {
 using namespace qutim_sdk_0_3;
 
-class ChatSessionModel : public QAbstractListModel
+class ChatSessionModel : public ConferenceParticipantsModel
 {
 	Q_OBJECT
 public:
 	explicit ChatSessionModel(ChatSessionImpl *parent = 0);
-	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
 	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
-	void addContact(qutim_sdk_0_3::Buddy *c);
-	void removeContact(qutim_sdk_0_3::Buddy *c);
-private slots:
-	void onNameChanged(const QString &title, const QString &oldTitle);
-	void onStatusChanged(const qutim_sdk_0_3::Status &status);
-	void onContactDestroyed(QObject *obj);
-	void onPriorityChanged(const int &oldPriority, const int &newPriority);
-private:
-	struct Node {
-		Node(qutim_sdk_0_3::Buddy *u, const QString &t) : title(t), unit(u) {}
-		Node(qutim_sdk_0_3::Buddy *u) : title(u->title()), unit(u) {}
-		Node(qutim_sdk_0_3::Buddy *u, const int &p) : title(u->title()), unit(u), priority(p) {}
-		Node() : unit(NULL) {}
-		QString title;
-		qutim_sdk_0_3::Buddy *unit;
-		int priority = unit->property("priority").toInt();
-		
-		bool operator <(const Node &o) const
-		{
-			int cmp = o.priority - priority;
-			if (cmp == 0)
-				cmp = title.compare(o.title, Qt::CaseInsensitive);
-			return cmp < 0 || (cmp == 0 && unit < o.unit);
-		}
-	};
-
-	QList<Node> m_units;
 };
 }
 }
@@ -0,0 +1,92 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "chatstateengine.h"
+#include <qutim/config.h>
+#include <QTimerEvent>
+
+namespace Core
+{
+namespace AdiumChat
+{
+
+using namespace qutim_sdk_0_3;
+
+ChatStateEngine::ChatStateEngine(QObject *parent)
+	: QObject(parent),
+	  m_state(ChatUnit::ChatStateInActive),
+	  m_sentState(ChatUnit::ChatStateInActive)
+{
+	Config cfg = Config("appearance").group("chat");
+	m_delay = qMax(0, cfg.value("chatStateDelay", 2000));
+	m_interval = qMax(0, cfg.value("chatStateInterval", 1000));
+}
+
+void ChatStateEngine::setState(ChatUnit::ChatState state)
+{
+	if (state == m_state)
+		return;
+	m_state = state;
+	if (m_state == m_sentState) {
+		// Typing was resumed before anything was sent
+		m_timer.stop();
+		return;
+	}
+	if (m_state == ChatUnit::ChatStateGone) {
+		flush();
+		return;
+	}
+
+	int delay = 0;
+	if (m_sentTime.isValid())
+		delay = qMax(0, m_interval - int(m_sentTime.msecsTo(QDateTime::currentDateTimeUtc())));
+	if (m_sentState == ChatUnit::ChatStateComposing)
+		delay = qMax(delay, m_delay);
+	if (delay == 0)
+		flush();
+	else
+		m_timer.start(delay, this);
+}
+
+void ChatStateEngine::flush()
+{
+	m_timer.stop();
+	if (m_state == m_sentState)
+		return;
+	m_sentState = m_state;
+	m_sentTime = QDateTime::currentDateTimeUtc();
+	emit stateChanged(m_state);
+}
+
+void ChatStateEngine::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_timer.timerId())
+		flush();
+	else
+		QObject::timerEvent(event);
+}
+
+}
+}
@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef CHATSTATEENGINE_H
+#define CHATSTATEENGINE_H
+
+#include <QObject>
+#include <QBasicTimer>
+#include <QDateTime>
+#include <qutim/chatunit.h>
+
+namespace Core
+{
+namespace AdiumChat
+{
+
+// Filters chat states of the user before protocols turn them into packets.
+// Composing is sent at once, but the state after it is delayed, so short
+// stops in typing don't become composing/active pairs, states equal to the
+// last sent one are dropped and no more than one state per interval is sent
+class ChatStateEngine : public QObject
+{
+	Q_OBJECT
+public:
+	ChatStateEngine(QObject *parent = 0);
+
+	void setState(qutim_sdk_0_3::ChatUnit::ChatState state);
+	// Sends the pending state immediately
+	void flush();
+
+signals:
+	void stateChanged(qutim_sdk_0_3::ChatUnit::ChatState state);
+
+protected:
+	virtual void timerEvent(QTimerEvent *event);
+
+private:
+	qutim_sdk_0_3::ChatUnit::ChatState m_state;
+	qutim_sdk_0_3::ChatUnit::ChatState m_sentState;
+	QDateTime m_sentTime;
+	QBasicTimer m_timer;
+	int m_delay;
+	int m_interval;
+};
+
+}
+}
+
+#endif // CHATSTATEENGINE_H
@@ -26,13 +26,13 @@
 #define CHATVIEWFACTORY_H
 
 #include <QWidget>
+#include <qutim/message.h>
 #include "chatlayer_global.h"
 
 namespace qutim_sdk_0_3
 {
 class ChatSession;
 class ChatUnit;
-class Message;
 }
 
 namespace Core
@@ -66,6 +66,12 @@ public:
 	virtual void setChatSession(qutim_sdk_0_3::ChatSession *session) = 0;
 	virtual qutim_sdk_0_3::ChatSession *getSession() const = 0;
 	virtual void appendMessage(const qutim_sdk_0_3::Message &msg) = 0;
+	// Views should reimplement it to lay out and scroll only once per batch
+	virtual void appendMessages(const qutim_sdk_0_3::MessageList &messages)
+	{
+		foreach (const qutim_sdk_0_3::Message &msg, messages)
+			appendMessage(msg);
+	}
 	virtual void clearChat() {}
 	virtual QString quote() { return QString(); }
 };
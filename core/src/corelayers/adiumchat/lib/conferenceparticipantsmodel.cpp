@@ -0,0 +1,303 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "conferenceparticipantsmodel.h"
+#include <qutim/metrics.h>
+#include <QMetaMethod>
+#include <algorithm>
+
+namespace Core
+{
+namespace AdiumChat
+{
+using namespace qutim_sdk_0_3;
+
+static int statusRank(const Status &status)
+{
+	// Connecting ones go after everybody else
+	return status.type() == Status::Connecting ? Status::Offline + 1 : status.type();
+}
+
+ConferenceParticipantsModel::ConferenceParticipantsModel(QObject *parent) :
+	QAbstractListModel(parent), m_activityTick(0), m_bulkInsert(false)
+{
+}
+
+ConferenceParticipantsModel::~ConferenceParticipantsModel()
+{
+}
+
+int ConferenceParticipantsModel::rowCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : m_order.size();
+}
+
+Buddy *ConferenceParticipantsModel::buddy(int row) const
+{
+	if (row < 0 || row >= m_order.size())
+		return 0;
+	return m_order.at(row).unit;
+}
+
+Buddy *ConferenceParticipantsModel::participant(const QString &nick) const
+{
+	return m_nicks.value(nick);
+}
+
+int ConferenceParticipantsModel::indexOf(Buddy *unit) const
+{
+	const QHash<Buddy*, Key>::const_iterator it = m_keys.constFind(unit);
+	return it == m_keys.constEnd() ? -1 : m_order.indexOf(*it);
+}
+
+ConferenceParticipantsModel::Key ConferenceParticipantsModel::createKey(Buddy *unit) const
+{
+	Key key;
+	key.priority = unit->property("priority").toInt();
+	key.status = statusRank(unit->status());
+	key.title = unit->title();
+	key.unit = unit;
+	return key;
+}
+
+void ConferenceParticipantsModel::addContact(Buddy *unit)
+{
+	if (m_keys.contains(unit))
+		return;
+	const Key key = createKey(unit);
+	m_keys.insert(unit, key);
+	m_nicks.insert(key.title, unit);
+	insertNick(key);
+	connectContact(unit);
+	if (m_bulkInsert) {
+		m_order.insert(key);
+		return;
+	}
+	const int index = m_order.rank(key);
+	beginInsertRows(QModelIndex(), index, index);
+	m_order.insert(key);
+	endInsertRows();
+}
+
+void ConferenceParticipantsModel::removeContact(Buddy *unit)
+{
+	const QHash<Buddy*, Key>::iterator it = m_keys.find(unit);
+	if (it == m_keys.end())
+		return;
+	const Key key = *it;
+	m_keys.erase(it);
+	disconnect(unit, 0, this, 0);
+	removeKey(key);
+}
+
+void ConferenceParticipantsModel::removeKey(const Key &key)
+{
+	if (m_nicks.value(key.title) == key.unit)
+		m_nicks.remove(key.title);
+	removeNick(key);
+	m_activity.remove(key.unit);
+	if (m_bulkInsert) {
+		m_order.remove(key);
+		return;
+	}
+	const int index = m_order.indexOf(key);
+	Q_ASSERT(index >= 0);
+	beginRemoveRows(QModelIndex(), index, index);
+	m_order.remove(key);
+	endRemoveRows();
+}
+
+void ConferenceParticipantsModel::beginBulkInsert()
+{
+	Q_ASSERT(!m_bulkInsert);
+	beginResetModel();
+	m_bulkInsert = true;
+}
+
+void ConferenceParticipantsModel::endBulkInsert()
+{
+	Q_ASSERT(m_bulkInsert);
+	m_bulkInsert = false;
+	endResetModel();
+	static Counter *resets = Metrics::counter("qutim_model_resets_total", QStringLiteral("model=\"conferenceparticipants\""));
+	resets->add();
+}
+
+QStringList ConferenceParticipantsModel::completions(const QString &prefix) const
+{
+	const QString folded = prefix.toCaseFolded();
+	QList<const Nick*> active;
+	QStringList result;
+	for (auto it = completionsBegin(folded); it != m_sortedNicks.constEnd() && it->folded.startsWith(folded); ++it) {
+		if (m_activity.contains(it->unit))
+			active << &*it;
+		else
+			result << it->unit->title();
+	}
+	if (active.isEmpty())
+		return result;
+
+	std::sort(active.begin(), active.end(), [this] (const Nick *a, const Nick *b) {
+		return m_activity.value(a->unit) > m_activity.value(b->unit);
+	});
+	QStringList ranked;
+	ranked.reserve(active.size() + result.size());
+	foreach (const Nick *nick, active)
+		ranked << nick->unit->title();
+	return ranked + result;
+}
+
+QString ConferenceParticipantsModel::commonPrefix(const QString &prefix) const
+{
+	// Range is sorted, so the first and the last nicks differ the most
+	const QString folded = prefix.toCaseFolded();
+	auto first = completionsBegin(folded);
+	if (first == m_sortedNicks.constEnd() || !first->folded.startsWith(folded))
+		return QString();
+	auto last = std::partition_point(first, m_sortedNicks.constEnd(), [&folded] (const Nick &nick) {
+		return nick.folded.startsWith(folded);
+	}) - 1;
+	const QString &a = first->folded;
+	const QString &b = last->folded;
+	int length = folded.size();
+	while (length < a.size() && length < b.size() && a.at(length) == b.at(length))
+		++length;
+	return a.left(length);
+}
+
+void ConferenceParticipantsModel::markActive(Buddy *unit)
+{
+	if (unit && m_keys.contains(unit))
+		m_activity.insert(unit, ++m_activityTick);
+}
+
+void ConferenceParticipantsModel::insertNick(const Key &key)
+{
+	const Nick nick = { key.title.toCaseFolded(), key.unit };
+	m_sortedNicks.insert(std::lower_bound(m_sortedNicks.begin(), m_sortedNicks.end(), nick), nick);
+}
+
+void ConferenceParticipantsModel::removeNick(const Key &key)
+{
+	const Nick nick = { key.title.toCaseFolded(), key.unit };
+	auto it = std::lower_bound(m_sortedNicks.begin(), m_sortedNicks.end(), nick);
+	if (it != m_sortedNicks.end() && it->unit == key.unit)
+		m_sortedNicks.erase(it);
+}
+
+QVector<ConferenceParticipantsModel::Nick>::const_iterator ConferenceParticipantsModel::completionsBegin(const QString &folded) const
+{
+	return std::lower_bound(m_sortedNicks.constBegin(), m_sortedNicks.constEnd(), folded,
+							[] (const Nick &nick, const QString &value) {
+		return nick.folded < value;
+	});
+}
+
+void ConferenceParticipantsModel::connectContact(Buddy *unit)
+{
+	auto unitMeta = unit->metaObject();
+	int funcIndex = unitMeta->indexOfProperty("priority");
+	if (funcIndex != -1) {
+		QMetaMethod prioritySignal = unitMeta->property(funcIndex).notifySignal();
+		funcIndex = metaObject()->indexOfSlot("onPriorityChanged(int,int)");
+		connect(unit, prioritySignal, this, metaObject()->method(funcIndex));
+	}
+	connect(unit, SIGNAL(titleChanged(QString,QString)),
+			this, SLOT(onTitleChanged(QString,QString)));
+	connect(unit, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
+			this, SLOT(onStatusChanged(qutim_sdk_0_3::Status)));
+	connect(unit, SIGNAL(destroyed(QObject*)),
+			this, SLOT(onContactDestroyed(QObject*)));
+}
+
+void ConferenceParticipantsModel::updateContact(Buddy *unit)
+{
+	const QHash<Buddy*, Key>::iterator it = m_keys.find(unit);
+	if (it == m_keys.end())
+		return;
+	const Key oldKey = *it;
+	const Key newKey = createKey(unit);
+	*it = newKey;
+	if (oldKey.title != newKey.title) {
+		if (m_nicks.value(oldKey.title) == unit)
+			m_nicks.remove(oldKey.title);
+		m_nicks.insert(newKey.title, unit);
+		removeNick(oldKey);
+		insertNick(newKey);
+	}
+
+	if (m_bulkInsert) {
+		m_order.remove(oldKey);
+		m_order.insert(newKey);
+		return;
+	}
+
+	const int from = m_order.indexOf(oldKey);
+	Q_ASSERT(from >= 0);
+	// Position among other participants, the moved one excluded
+	int to = m_order.rank(newKey);
+	if (oldKey < newKey)
+		--to;
+	if (to != from) {
+		beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+		m_order.remove(oldKey);
+		m_order.insert(newKey);
+		endMoveRows();
+	} else {
+		m_order.remove(oldKey);
+		m_order.insert(newKey);
+	}
+	const QModelIndex index = createIndex(to, 0);
+	emit dataChanged(index, index);
+}
+
+void ConferenceParticipantsModel::onTitleChanged(const QString &, const QString &)
+{
+	updateContact(static_cast<Buddy*>(sender()));
+}
+
+void ConferenceParticipantsModel::onStatusChanged(const Status &)
+{
+	updateContact(static_cast<Buddy*>(sender()));
+}
+
+void ConferenceParticipantsModel::onPriorityChanged(const int &, const int &)
+{
+	updateContact(static_cast<Buddy*>(sender()));
+}
+
+void ConferenceParticipantsModel::onContactDestroyed(QObject *object)
+{
+	// Only address of the object is used, it's already half-destroyed
+	const QHash<Buddy*, Key>::iterator it = m_keys.find(static_cast<Buddy*>(object));
+	if (it == m_keys.end())
+		return;
+	const Key key = *it;
+	m_keys.erase(it);
+	removeKey(key);
+}
+
+}
+}
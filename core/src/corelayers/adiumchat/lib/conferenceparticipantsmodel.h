@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef CONFERENCEPARTICIPANTSMODEL_H
+#define CONFERENCEPARTICIPANTSMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <qutim/buddy.h>
+#include "chatlayer_global.h"
+#include "orderstatistictree.h"
+
+namespace Core
+{
+namespace AdiumChat
+{
+
+// Participants sorted by role, status and nick, all updates of
+// a participant are single row moves found in O(log n)
+class ADIUMCHAT_EXPORT ConferenceParticipantsModel : public QAbstractListModel
+{
+	Q_OBJECT
+public:
+	explicit ConferenceParticipantsModel(QObject *parent = 0);
+	virtual ~ConferenceParticipantsModel();
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	qutim_sdk_0_3::Buddy *buddy(int row) const;
+	qutim_sdk_0_3::Buddy *participant(const QString &nick) const;
+	int indexOf(qutim_sdk_0_3::Buddy *unit) const;
+	void addContact(qutim_sdk_0_3::Buddy *unit);
+	void removeContact(qutim_sdk_0_3::Buddy *unit);
+	// Contacts changed in between are applied by single model reset
+	void beginBulkInsert();
+	void endBulkInsert();
+
+	/*!
+	 * Returns nicks starting with \a prefix case insensitively, recently
+	 * active participants go first, others are sorted by nick.
+	 */
+	QStringList completions(const QString &prefix) const;
+	// Longest case folded prefix shared by all completions of \a prefix
+	QString commonPrefix(const QString &prefix) const;
+	// Participants who spoke or were addressed recently are completed first
+	void markActive(qutim_sdk_0_3::Buddy *unit);
+private slots:
+	void onTitleChanged(const QString &title, const QString &oldTitle);
+	void onStatusChanged(const qutim_sdk_0_3::Status &status);
+	void onPriorityChanged(const int &oldPriority, const int &newPriority);
+	void onContactDestroyed(QObject *object);
+private:
+	struct Key
+	{
+		Key() : priority(0), status(0), unit(0) {}
+		int priority;
+		int status;
+		QString title;
+		qutim_sdk_0_3::Buddy *unit;
+
+		bool operator <(const Key &o) const
+		{
+			if (priority != o.priority)
+				return priority > o.priority;
+			if (status != o.status)
+				return status < o.status;
+			const int cmp = title.compare(o.title, Qt::CaseInsensitive);
+			return cmp < 0 || (cmp == 0 && unit < o.unit);
+		}
+	};
+
+	// Case folded nicks sorted for binary search of completions
+	struct Nick
+	{
+		QString folded;
+		qutim_sdk_0_3::Buddy *unit;
+
+		bool operator <(const Nick &o) const
+		{
+			return folded < o.folded || (folded == o.folded && unit < o.unit);
+		}
+	};
+
+	Key createKey(qutim_sdk_0_3::Buddy *unit) const;
+	void insertNick(const Key &key);
+	void removeNick(const Key &key);
+	QVector<Nick>::const_iterator completionsBegin(const QString &folded) const;
+	void connectContact(qutim_sdk_0_3::Buddy *unit);
+	void updateContact(qutim_sdk_0_3::Buddy *unit);
+	void removeKey(const Key &key);
+
+	OrderStatisticTree<Key> m_order;
+	QHash<qutim_sdk_0_3::Buddy*, Key> m_keys;
+	QHash<QString, qutim_sdk_0_3::Buddy*> m_nicks;
+	QVector<Nick> m_sortedNicks;
+	QHash<qutim_sdk_0_3::Buddy*, quint64> m_activity;
+	quint64 m_activityTick;
+	bool m_bulkInsert;
+};
+
+}
+}
+
+#endif // CONFERENCEPARTICIPANTSMODEL_H
@@ -90,28 +90,9 @@ void ConfTabCompletion::moveCursorToOffset(QTextCursor &cur, int offset, QTextCu
 	}
 }
 
-/** Find longest common (case insensitive) prefix of \a list.
-  */
-QString ConfTabCompletion::longestCommonPrefix(QStringList list) {
-	QString candidate = list.first().toLower();
-	int len = candidate.length();
-	while (len > 0) {
-		bool found = true;
-		foreach(QString str, list) {
-			if (str.left(len).toLower() != candidate) {
-				found = false;
-				break;
-			}
-		}
-
-		if (found) {
-			break;
-		}
-
-		--len;
-		candidate = candidate.left(len);
-	}
-	return candidate;
+ConferenceParticipantsModel *ConfTabCompletion::participants() const
+{
+	return m_chatSession ? qobject_cast<ConferenceParticipantsModel*>(m_chatSession->getModel()) : 0;
 }
 
 void ConfTabCompletion::setup(QString text, int pos, int &start, int &end) {
@@ -148,8 +129,12 @@ QString ConfTabCompletion::suggestCompletion(bool *replaced) {
 	if (suggestedCompletion_.count() == 1) {
 		*replaced = true;
 		newText = suggestedCompletion_.first();
+		if (ConferenceParticipantsModel *model = participants()) {
+			const QString postAdd = atStart_ ? nickSep + " " : "";
+			model->markActive(model->participant(newText.left(newText.size() - postAdd.size())));
+		}
 	} else if (suggestedCompletion_.count() > 1) {
-		newText = longestCommonPrefix(suggestedCompletion_);
+		newText = participants()->commonPrefix(toComplete_);
 		if (newText.isEmpty()) {
 			return toComplete_; // FIXME is this right?
 		}
@@ -258,14 +243,15 @@ void ConfTabCompletion::tryComplete() {
 
 
 QStringList ConfTabCompletion::possibleCompletions() {
-	QStringList suggestedNicks;
-	QStringList nicks = getUsers();
-
-	QString postAdd = atStart_ ? nickSep + " " : "";
+	ConferenceParticipantsModel *model = participants();
+	if (!model)
+		return QStringList();
+	QStringList suggestedNicks = model->completions(toComplete_);
 
-	foreach(QString nick, nicks) {
-		if (nick.left(toComplete_.length()).toLower() == toComplete_.toLower()) {
-			suggestedNicks << nick + postAdd;
+	if (atStart_) {
+		QStringList::Iterator it = suggestedNicks.begin();
+		for ( ; it != suggestedNicks.end(); ++it) {
+			*it = *it + nickSep + " ";
 		}
 	}
 	return suggestedNicks;
@@ -288,12 +274,8 @@ QStringList ConfTabCompletion::allChoices(QString &guess) {
 	return all;
 }
 QStringList ConfTabCompletion::getUsers(){
-	QStringList users;
-	QAbstractItemModel *model = m_chatSession->getModel();
-	for (int i =0;i!=model->rowCount();i++)
-		users.append(model->index(i,0).data(Qt::DisplayRole).toString());
-
-	return users;
+	ConferenceParticipantsModel *model = participants();
+	return model ? model->completions(QString()) : QStringList();
 }
 
 bool ConfTabCompletion::eventFilter(QObject* obj, QEvent* ev)
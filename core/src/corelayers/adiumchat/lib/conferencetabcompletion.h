@@ -32,6 +32,7 @@
 #include <QObject>
 #include <QTextEdit>
 #include "chatsessionimpl.h"
+#include "conferenceparticipantsmodel.h"
 namespace Core
 {
 
@@ -69,7 +70,7 @@ private:
 	virtual void highlight(bool set);
 	QColor highlight_;
 
-	QString longestCommonPrefix(QStringList list);
+	ConferenceParticipantsModel *participants() const;
 	QString suggestCompletion(bool *replaced);
 	virtual bool eventFilter(QObject* , QEvent* );
 
@@ -0,0 +1,203 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef ORDERSTATISTICTREE_H
+#define ORDERSTATISTICTREE_H
+
+#include <QtGlobal>
+
+namespace Core
+{
+namespace AdiumChat
+{
+
+// Treap of unique keys which also knows position of every key,
+// so both lookups by key and by row are O(log n)
+template <typename Key>
+class OrderStatisticTree
+{
+	Q_DISABLE_COPY(OrderStatisticTree)
+public:
+	OrderStatisticTree() : m_root(0), m_seed(0x9e3779b9u) {}
+	~OrderStatisticTree() { destroy(m_root); }
+
+	int size() const { return size(m_root); }
+	bool isEmpty() const { return !m_root; }
+	void clear() { destroy(m_root); m_root = 0; }
+
+	// Number of keys less than the given one
+	int rank(const Key &key) const
+	{
+		int result = 0;
+		for (Node *node = m_root; node;) {
+			if (node->key < key) {
+				result += size(node->left) + 1;
+				node = node->right;
+			} else {
+				node = node->left;
+			}
+		}
+		return result;
+	}
+
+	// Position of the key or -1 if there is no such one
+	int indexOf(const Key &key) const
+	{
+		int result = 0;
+		for (Node *node = m_root; node;) {
+			if (node->key < key) {
+				result += size(node->left) + 1;
+				node = node->right;
+			} else if (key < node->key) {
+				node = node->left;
+			} else {
+				return result + size(node->left);
+			}
+		}
+		return -1;
+	}
+
+	const Key &at(int index) const
+	{
+		Q_ASSERT(index >= 0 && index < size());
+		Node *node = m_root;
+		forever {
+			const int leftSize = size(node->left);
+			if (index < leftSize) {
+				node = node->left;
+			} else if (index == leftSize) {
+				return node->key;
+			} else {
+				index -= leftSize + 1;
+				node = node->right;
+			}
+		}
+	}
+
+	// Returns position of the inserted key
+	int insert(const Key &key)
+	{
+		const int index = rank(key);
+		Node *left, *right;
+		split(m_root, key, left, right);
+		m_root = merge(merge(left, new Node(key, nextPriority())), right);
+		return index;
+	}
+
+	// Returns former position of the key or -1 if there was no such one
+	int remove(const Key &key)
+	{
+		const int index = indexOf(key);
+		if (index >= 0)
+			remove(m_root, key);
+		return index;
+	}
+
+private:
+	struct Node
+	{
+		Node(const Key &k, quint32 p) : key(k), priority(p), size(1), left(0), right(0) {}
+		Key key;
+		quint32 priority;
+		int size;
+		Node *left;
+		Node *right;
+	};
+
+	static int size(Node *node) { return node ? node->size : 0; }
+	static void update(Node *node) { node->size = size(node->left) + size(node->right) + 1; }
+
+	static void destroy(Node *node)
+	{
+		if (!node)
+			return;
+		destroy(node->left);
+		destroy(node->right);
+		delete node;
+	}
+
+	// Left tree gets keys less than the given one
+	static void split(Node *node, const Key &key, Node *&left, Node *&right)
+	{
+		if (!node) {
+			left = right = 0;
+		} else if (node->key < key) {
+			split(node->right, key, node->right, right);
+			left = node;
+			update(node);
+		} else {
+			split(node->left, key, left, node->left);
+			right = node;
+			update(node);
+		}
+	}
+
+	static Node *merge(Node *left, Node *right)
+	{
+		if (!left || !right)
+			return left ? left : right;
+		if (left->priority > right->priority) {
+			left->right = merge(left->right, right);
+			update(left);
+			return left;
+		} else {
+			right->left = merge(left, right->left);
+			update(right);
+			return right;
+		}
+	}
+
+	static void remove(Node *&node, const Key &key)
+	{
+		if (node->key < key) {
+			remove(node->right, key);
+			update(node);
+		} else if (key < node->key) {
+			remove(node->left, key);
+			update(node);
+		} else {
+			Node *removed = node;
+			node = merge(node->left, node->right);
+			delete removed;
+		}
+	}
+
+	quint32 nextPriority()
+	{
+		// xorshift is enough to keep the tree balanced
+		m_seed ^= m_seed << 13;
+		m_seed ^= m_seed >> 17;
+		m_seed ^= m_seed << 5;
+		return m_seed;
+	}
+
+	Node *m_root;
+	quint32 m_seed;
+};
+
+}
+}
+
+#endif // ORDERSTATISTICTREE_H
@@ -33,17 +33,43 @@
 #include <qutim/mimeobjectdata.h>
 #include <qutim/servicemanager.h>
 #include <qutim/avatarfilter.h>
+#include <QBasicTimer>
+#include <QTimerEvent>
+#include <QCache>
+#include <QSet>
 
 namespace Core {
 namespace AdiumChat {
 
+enum { UpdateInterval = 16, IconCacheSize = 64 };
+
 class SessionListWidgetPrivate
 {
 public:
+	SessionListWidgetPrivate() : icons(IconCacheSize) {}
+	QIcon icon(ChatUnit *unit, const QIcon &overlay);
+
 	ChatSessionList sessions;
 	QAction *action;
+	QSet<ChatSessionImpl*> dirtySessions;
+	QBasicTimer updateTimer;
+	// Avatars composed with status icons, keyed by avatar and icon's cache key
+	QCache<QString, QIcon> icons;
 };
 
+QIcon SessionListWidgetPrivate::icon(ChatUnit *unit, const QIcon &overlay)
+{
+	Buddy *buddy = qobject_cast<Buddy*>(unit);
+	if (!buddy)
+		return overlay;
+	const QString key = buddy->avatar() + QLatin1Char('\n') + QString::number(overlay.cacheKey());
+	if (QIcon *icon = icons.object(key))
+		return *icon;
+	const QIcon result = AvatarFilter::icon(buddy->avatar(), overlay);
+	icons.insert(key, new QIcon(result));
+	return result;
+}
+
 SessionListWidget::SessionListWidget(QWidget *parent) :
 	QListWidget(parent),
 	d_ptr(new SessionListWidgetPrivate)
@@ -64,15 +90,13 @@ void SessionListWidget::addSession(ChatSessionImpl *session)
 {
 	QListWidgetItem *item = new QListWidgetItem(session->unit()->title(),this);
 	QIcon icon = ChatLayerImpl::iconForState(ChatUnit::ChatStateInActive,session->getUnit());
-	if(Buddy *b = qobject_cast<Buddy*>(session->unit()))
-		icon = AvatarFilter::icon(b->avatar(),icon);
-	item->setIcon(icon);
+	item->setIcon(d_func()->icon(session->unit(), icon));
 	d_func()->sessions.append(session);
 	connect(session->getUnit(),SIGNAL(titleChanged(QString,QString)),
 			this,SLOT(onTitleChanged(QString)));
 	connect(session,SIGNAL(destroyed(QObject*)),SLOT(onRemoveSession(QObject*)));
-	connect(session,SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),
-			this,SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+	connect(session,SIGNAL(unreadCountChanged(int)),
+			this,SLOT(onUnreadCountChanged(int)));
 	connect(session->getUnit(),
 			SIGNAL(chatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState,qutim_sdk_0_3::ChatUnit::ChatState)),
 			this,
@@ -131,7 +155,8 @@ void SessionListWidget::onRemoveSession(QObject *obj)
 	Q_D(SessionListWidget);
 	ChatSessionImpl *s = reinterpret_cast<ChatSessionImpl*>(obj);
 	int index = d->sessions.indexOf(s);
-	d->sessions.removeAll(s);	
+	d->sessions.removeAll(s);
+	d->dirtySessions.remove(s);
 	delete takeItem(index);
 }
 
@@ -149,7 +174,9 @@ void SessionListWidget::onTitleChanged(const QString &title)
 {
 	ChatUnit *u = qobject_cast<ChatUnit*>(sender());
 	ChatSessionImpl *s = static_cast<ChatSessionImpl*>(ChatLayer::get(u,false));
-	item(indexOf(s))->setText(title);
+	Q_UNUSED(title);
+	if (s)
+		scheduleUpdate(s);
 }
 
 bool SessionListWidget::event(QEvent *event)
@@ -199,33 +226,58 @@ bool SessionListWidget::event(QEvent *event)
 
 void SessionListWidget::chatStateChanged(ChatUnit::ChatState state, ChatSessionImpl *session)
 {
-	if(session->unread().count())
+	Q_UNUSED(state);
+	scheduleUpdate(session);
+}
+
+void SessionListWidget::onUnreadCountChanged(int count)
+{
+	Q_UNUSED(count);
+	scheduleUpdate(static_cast<ChatSessionImpl*>(sender()));
+}
+
+void SessionListWidget::scheduleUpdate(ChatSessionImpl *session)
+{
+	Q_D(SessionListWidget);
+	d->dirtySessions.insert(session);
+	if (!d->updateTimer.isActive())
+		d->updateTimer.start(UpdateInterval, this);
+}
+
+void SessionListWidget::timerEvent(QTimerEvent *event)
+{
+	Q_D(SessionListWidget);
+	if (event->timerId() != d->updateTimer.timerId()) {
+		QListWidget::timerEvent(event);
 		return;
-	QIcon icon = ChatLayerImpl::iconForState(state,session->getUnit());
-	if(Buddy *b = qobject_cast<Buddy*>(session->unit()))
-		icon = AvatarFilter::icon(b->avatar(),icon);
-	item(indexOf(session))->setIcon(icon);
+	}
+	d->updateTimer.stop();
+	const QSet<ChatSessionImpl*> sessions = d->dirtySessions;
+	d->dirtySessions.clear();
+	foreach (ChatSessionImpl *session, sessions)
+		updateItem(session);
 }
 
-void SessionListWidget::onUnreadChanged(const qutim_sdk_0_3::MessageList &unread)
+void SessionListWidget::updateItem(ChatSessionImpl *session)
 {
-	ChatSessionImpl *session = static_cast<ChatSessionImpl*>(sender());
-	int index = indexOf(session);
+	Q_D(SessionListWidget);
+	const int index = indexOf(session);
+	if (index == -1)
+		return;
 	QIcon icon;
 	QString title = session->getUnit()->title();
-	if (unread.isEmpty()) {
-		ChatUnit::ChatState state = static_cast<ChatUnit::ChatState>(session->property("currentChatState").toInt());//FIXME remove in future
-		icon =  ChatLayerImpl::iconForState(state,session->getUnit());
-		if(Buddy *b = qobject_cast<Buddy*>(session->unit()))
-			icon = AvatarFilter::icon(b->avatar(),icon);
-
+	if (!session->unreadCount()) {
+		icon = d->icon(session->unit(), ChatLayerImpl::iconForState(session->getUnit()->chatState(), session->getUnit()));
 	} else {
 		icon = Icon("mail-unread-new");
 		title.insert(0,QChar('*'));
 	}
+	// Every change of the item makes the view to relayout it
 	QListWidgetItem *i = item(index);
-	i->setIcon(icon);
-	i->setText(title);
+	if (i->icon().cacheKey() != icon.cacheKey())
+		i->setIcon(icon);
+	if (i->text() != title)
+		i->setText(title);
 }
 
 void SessionListWidget::onChatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState now, qutim_sdk_0_3::ChatUnit::ChatState)
@@ -59,15 +59,19 @@ protected:
 	virtual bool event(QEvent *event);
 	void changeEvent(QEvent *ev);
 	void chatStateChanged(ChatUnit::ChatState state,ChatSessionImpl *session);
+	virtual void timerEvent(QTimerEvent *event);
 private slots:
 	void onActivated(QListWidgetItem*);
 	void onRemoveSession(QObject *obj);
 	void onTitleChanged(const QString &title);
-	void onUnreadChanged(const qutim_sdk_0_3::MessageList &unread);
+	void onUnreadCountChanged(int count);
 	void onChatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState now, qutim_sdk_0_3::ChatUnit::ChatState old);
 	void onCloseSessionTriggered();
 	void initScrolling();
 private:
+	void scheduleUpdate(ChatSessionImpl *session);
+	void updateItem(ChatSessionImpl *session);
+
 	QScopedPointer<SessionListWidgetPrivate> d_ptr;
 };
 
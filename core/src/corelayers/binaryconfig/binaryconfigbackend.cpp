@@ -0,0 +1,363 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "binaryconfigbackend.h"
+#include <qutim/debug.h>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+#include <climits>
+
+namespace qutim_sdk_0_3
+{
+LIBQUTIM_EXPORT QList<ConfigBackend*> &get_config_backends();
+}
+
+namespace Core
+{
+	static const char binaryConfigMagic[] = "QCFG";
+	enum { BinaryConfigVersion = 1 };
+
+	enum Tag
+	{
+		NullTag = 0,
+		FalseTag,
+		TrueTag,
+		IntTag,
+		UIntTag,
+		DoubleTag,
+		StringTag,
+		ByteArrayTag,
+		ListTag,
+		MapTag,
+		// Any other type, serialized by QDataStream
+		VariantTag
+	};
+
+	static void writeVarUInt(QByteArray &out, quint64 value)
+	{
+		while (value >= 0x80) {
+			out += char((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += char(value);
+	}
+
+	static void writeBytes(QByteArray &out, const QByteArray &data)
+	{
+		writeVarUInt(out, data.size());
+		out += data;
+	}
+
+	static void encodeValue(QByteArray &out, const QVariant &value)
+	{
+		switch (value.type()) {
+		case QVariant::Invalid:
+			out += char(NullTag);
+			break;
+		case QVariant::Bool:
+			out += char(value.toBool() ? TrueTag : FalseTag);
+			break;
+		case QVariant::Int:
+		case QVariant::LongLong: {
+			// Zigzag encoding keeps small negative numbers short
+			const qint64 number = value.toLongLong();
+			out += char(IntTag);
+			writeVarUInt(out, (quint64(number) << 1) ^ quint64(number >> 63));
+			break;
+		}
+		case QVariant::UInt:
+		case QVariant::ULongLong:
+			out += char(UIntTag);
+			writeVarUInt(out, value.toULongLong());
+			break;
+		case QVariant::Double: {
+			const double number = value.toDouble();
+			quint64 bits;
+			memcpy(&bits, &number, sizeof(bits));
+			out += char(DoubleTag);
+			for (int i = 0; i < 8; ++i)
+				out += char(bits >> (i * 8));
+			break;
+		}
+		case QVariant::String:
+			out += char(StringTag);
+			writeBytes(out, value.toString().toUtf8());
+			break;
+		case QVariant::ByteArray:
+			out += char(ByteArrayTag);
+			writeBytes(out, value.toByteArray());
+			break;
+		case QVariant::StringList:
+		case QVariant::List: {
+			const QVariantList list = value.toList();
+			out += char(ListTag);
+			writeVarUInt(out, list.size());
+			foreach (const QVariant &item, list)
+				encodeValue(out, item);
+			break;
+		}
+		case QVariant::Map: {
+			const QVariantMap map = value.toMap();
+			out += char(MapTag);
+			writeVarUInt(out, map.size());
+			for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+				writeBytes(out, it.key().toUtf8());
+				encodeValue(out, it.value());
+			}
+			break;
+		}
+		default: {
+			QByteArray data;
+			{
+				QDataStream stream(&data, QIODevice::WriteOnly);
+				stream.setVersion(QDataStream::Qt_4_5);
+				stream << value;
+			}
+			out += char(VariantTag);
+			writeBytes(out, data);
+			break;
+		}
+		}
+	}
+
+	class BinaryConfigReader
+	{
+	public:
+		BinaryConfigReader(const uchar *begin, const uchar *end) : m_pos(begin), m_end(end) {}
+
+		bool readVarUInt(quint64 &value)
+		{
+			value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (m_pos >= m_end)
+					return false;
+				const uchar c = *m_pos++;
+				value |= quint64(c & 0x7f) << shift;
+				if (!(c & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool readBytes(QByteArray &data)
+		{
+			quint64 size;
+			if (!readVarUInt(size) || size > quint64(m_end - m_pos))
+				return false;
+			data = QByteArray(reinterpret_cast<const char *>(m_pos), size);
+			m_pos += size;
+			return true;
+		}
+
+		bool readValue(QVariant &value, int depth = 0)
+		{
+			if (m_pos >= m_end || depth > 256)
+				return false;
+
+			switch (*m_pos++) {
+			case NullTag:
+				value = QVariant();
+				return true;
+			case FalseTag:
+				value = false;
+				return true;
+			case TrueTag:
+				value = true;
+				return true;
+			case IntTag: {
+				quint64 raw;
+				if (!readVarUInt(raw))
+					return false;
+				const qint64 number = qint64(raw >> 1) ^ -qint64(raw & 1);
+				if (number >= INT_MIN && number <= INT_MAX)
+					value = int(number);
+				else
+					value = number;
+				return true;
+			}
+			case UIntTag: {
+				quint64 number;
+				if (!readVarUInt(number))
+					return false;
+				if (number <= UINT_MAX)
+					value = uint(number);
+				else
+					value = number;
+				return true;
+			}
+			case DoubleTag: {
+				if (m_end - m_pos < 8)
+					return false;
+				quint64 bits = 0;
+				for (int i = 0; i < 8; ++i)
+					bits |= quint64(*m_pos++) << (i * 8);
+				double number;
+				memcpy(&number, &bits, sizeof(number));
+				value = number;
+				return true;
+			}
+			case StringTag: {
+				QByteArray data;
+				if (!readBytes(data))
+					return false;
+				value = QString::fromUtf8(data);
+				return true;
+			}
+			case ByteArrayTag: {
+				QByteArray data;
+				if (!readBytes(data))
+					return false;
+				value = data;
+				return true;
+			}
+			case ListTag: {
+				quint64 count;
+				if (!readVarUInt(count) || count > quint64(m_end - m_pos))
+					return false;
+				QVariantList list;
+				list.reserve(count);
+				for (quint64 i = 0; i < count; ++i) {
+					QVariant item;
+					if (!readValue(item, depth + 1))
+						return false;
+					list << item;
+				}
+				value = list;
+				return true;
+			}
+			case MapTag: {
+				quint64 count;
+				if (!readVarUInt(count) || count > quint64(m_end - m_pos))
+					return false;
+				QVariantMap map;
+				for (quint64 i = 0; i < count; ++i) {
+					QByteArray key;
+					QVariant item;
+					if (!readBytes(key) || !readValue(item, depth + 1))
+						return false;
+					map.insert(QString::fromUtf8(key), item);
+				}
+				value = map;
+				return true;
+			}
+			case VariantTag: {
+				QByteArray data;
+				if (!readBytes(data))
+					return false;
+				QDataStream stream(data);
+				stream.setVersion(QDataStream::Qt_4_5);
+				stream >> value;
+				return stream.status() == QDataStream::Ok;
+			}
+			default:
+				return false;
+			}
+		}
+
+		bool atEnd() const { return m_pos == m_end; }
+
+	private:
+		const uchar *m_pos;
+		const uchar *m_end;
+	};
+
+	static ConfigBackend *jsonBackend()
+	{
+		foreach (ConfigBackend *backend, get_config_backends()) {
+			if (backend->name() == "json")
+				return backend;
+		}
+		return 0;
+	}
+
+	static QString jsonFileName(const QString &fileName)
+	{
+		const QFileInfo info(fileName);
+		return info.dir().filePath(info.completeBaseName() + QLatin1String(".json"));
+	}
+
+	QByteArray BinaryConfigBackend::encode(const QVariant &entry)
+	{
+		QByteArray data = binaryConfigMagic;
+		data += char(BinaryConfigVersion);
+		encodeValue(data, entry);
+		return data;
+	}
+
+	bool BinaryConfigBackend::decode(const QByteArray &data, QVariant &entry)
+	{
+		if (data.size() < 5 || !data.startsWith(binaryConfigMagic) || data.at(4) != BinaryConfigVersion)
+			return false;
+		const uchar *begin = reinterpret_cast<const uchar *>(data.constData());
+		BinaryConfigReader reader(begin + 5, begin + data.size());
+		return reader.readValue(entry) && reader.atEnd();
+	}
+
+	QVariant BinaryConfigBackend::load(const QString &fileName)
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly))
+			return QVariant();
+
+		QVariant entry;
+		const uchar *map = file.map(0, file.size());
+		const QByteArray data = map
+				? QByteArray::fromRawData(reinterpret_cast<const char *>(map), file.size())
+				: file.readAll();
+		if (!decode(data, entry)) {
+			qWarning() << "Broken binary config" << fileName;
+			entry = QVariant();
+		}
+		// Everything is copied out of the map by decoder
+		if (map)
+			file.unmap(const_cast<uchar *>(map));
+		return entry;
+	}
+
+	bool BinaryConfigBackend::loadConcurrently(const QString &fileName, QVariant &entry)
+	{
+		// Backend has no state, so load() is safe for any thread
+		entry = load(fileName);
+		return true;
+	}
+
+	void BinaryConfigBackend::save(const QString &fileName, const QVariant &entry)
+	{
+		QSaveFile file(fileName);
+		if (file.open(QIODevice::WriteOnly)) {
+			file.write(encode(entry));
+			if (!file.commit())
+				qWarning() << "Can't save config" << fileName << file.errorString();
+		}
+
+		if (qEnvironmentVariableIsSet("QUTIM_CONFIG_JSON_EXPORT")) {
+			if (ConfigBackend *backend = jsonBackend())
+				backend->save(jsonFileName(fileName), entry);
+		}
+	}
+}
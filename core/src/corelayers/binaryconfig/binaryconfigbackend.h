@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef BINARYCONFIGBACKEND_H
+#define BINARYCONFIGBACKEND_H
+
+#include <qutim/config.h>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+	/**
+	 * Stores config tree in compact binary form with typed values, byte
+	 * arrays are stored as is instead of base64 strings.
+	 *
+	 * Existing JSON configs are converted by Config on first open, so
+	 * switching profile to this backend keeps all settings.
+	 * Setting QUTIM_CONFIG_JSON_EXPORT environment variable makes every save
+	 * write JSON copy of the file next to it for debugging.
+	 */
+	class BinaryConfigBackend : public qutim_sdk_0_3::ConfigBackend
+	{
+		Q_OBJECT
+		Q_CLASSINFO("Extension", "qcfg")
+	public:
+		virtual QVariant load(const QString &file);
+		virtual void save(const QString &file, const QVariant &entry);
+		virtual bool loadConcurrently(const QString &file, QVariant &entry);
+
+		static QByteArray encode(const QVariant &entry);
+		static bool decode(const QByteArray &data, QVariant &entry);
+	};
+}
+using namespace Core;
+
+#endif // BINARYCONFIGBACKEND_H
@@ -25,13 +25,29 @@
 
 #include "chatspellchecker.h"
 #include <qutim/servicemanager.h>
+#include <qutim/executor.h>
+#include <qutim/asyncresult.h>
+#include <QPointer>
+#include <QVarLengthArray>
 #include <QTextEdit>
 #include <QPlainTextEdit>
 #include <QContextMenuEvent>
 
 namespace Core {
 
-SpellHighlighter::SpellHighlighter(QTextDocument *doc) : QSyntaxHighlighter(doc)
+enum {
+	WordCacheSize = 4096,
+	// Pasted text with more unknown words is checked by worker thread
+	AsyncWordCount = 32
+};
+
+static inline bool isWord(QChar ch)
+{
+	return ch.isLetterOrNumber() || ch.isMark() || ch == QLatin1Char('_');
+}
+
+SpellHighlighter::SpellHighlighter(QTextDocument *doc)
+	: QSyntaxHighlighter(doc), m_cache(WordCacheSize), m_generation(0)
 {
 	m_format.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
 	m_format.setUnderlineColor(Qt::red);
@@ -42,17 +58,92 @@ void SpellHighlighter::highlightBlock(const QString &text)
 	if (!m_speller)
 		return;
 
-	static QRegExp expression(QLatin1String("\\b\\w+\\b"));
+	struct Word
+	{
+		int index;
+		int length;
+	};
+	QVarLengthArray<Word, 64> unknown;
+	const int size = text.size();
+	for (int index = 0; index < size;) {
+		if (!isWord(text.at(index))) {
+			++index;
+			continue;
+		}
+		int end = index + 1;
+		while (end < size && isWord(text.at(end)))
+			++end;
+		const QString word = text.mid(index, end - index);
+		if (bool *correct = m_cache.object(word)) {
+			if (!*correct)
+				setFormat(index, end - index, m_format);
+		} else if (!m_pending.contains(word)) {
+			const Word item = { index, end - index };
+			unknown.append(item);
+		}
+		index = end;
+	}
 
-	int index = text.indexOf(expression);
-	while (index >= 0) {
-		int length = expression.matchedLength();
-		if (!m_speller->isCorrect(expression.cap(0)))
-			setFormat(index, length, m_format);
-		index = text.indexOf(expression, index + length);
+	if (unknown.size() > AsyncWordCount && m_speller->property("threadSafe").toBool()) {
+		QStringList words;
+		for (int i = 0; i < unknown.size(); ++i)
+			words << text.mid(unknown[i].index, unknown[i].length);
+		checkAsync(words);
+		return;
+	}
+
+	for (int i = 0; i < unknown.size(); ++i) {
+		const Word &item = unknown[i];
+		const QString word = text.mid(item.index, item.length);
+		const bool correct = m_speller->isCorrect(word);
+		m_cache.insert(word, new bool(correct));
+		if (!correct)
+			setFormat(item.index, item.length, m_format);
 	}
 }
 
+void SpellHighlighter::checkAsync(const QStringList &words)
+{
+	foreach (const QString &word, words)
+		m_pending.insert(word);
+
+	AsyncResultHandler<QHash<QString, bool>> handler;
+	QPointer<SpellChecker> speller = m_speller.data();
+	Executor::named(QStringLiteral("SpellChecker"), 1)->run([speller, words, handler] () {
+		QHash<QString, bool> result;
+		foreach (const QString &word, words) {
+			if (!speller)
+				break;
+			if (!result.contains(word))
+				result.insert(word, speller->isCorrect(word));
+		}
+		handler.handle(result);
+	}, Executor::InteractivePriority);
+
+	const int generation = m_generation;
+	handler.result().connect(this, [this, generation, words] (const QHash<QString, bool> &result) {
+		if (generation != m_generation)
+			return;
+		foreach (const QString &word, words)
+			m_pending.remove(word);
+		for (auto it = result.constBegin(); it != result.constEnd(); ++it)
+			m_cache.insert(it.key(), new bool(it.value()));
+		rehighlight();
+	});
+}
+
+void SpellHighlighter::clearCache()
+{
+	m_cache.clear();
+	m_pending.clear();
+	++m_generation;
+}
+
+void SpellHighlighter::forget(const QString &word)
+{
+	m_cache.remove(word);
+}
+
 ChatSpellChecker::ChatSpellChecker() : m_chatForm("ChatForm")
 {
 	if (m_speller)
@@ -69,13 +160,11 @@ void ChatSpellChecker::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 	QTextDocument *inputField = session->getInputField();
 	if (inputField) {
 		SpellHighlighter *highlighter = new SpellHighlighter(inputField);
-		if (m_chatForm) {
+		// Highlighters are needed to drop their caches on dictionary change
+		m_highlighters.insert(inputField, highlighter);
+		connect(inputField, SIGNAL(destroyed(QObject*)), SLOT(onInputFieldDestroyed(QObject*)));
+		if (m_chatForm)
 			connect(session, SIGNAL(activated(bool)), SLOT(onSessionActivated(bool)));
-			// We use m_highlighter only in onAddToDictionaryTriggered
-			// which run only when ChatForm service is enabled (i.e., m_chatForm != 0).
-			m_highlighters.insert(inputField, highlighter);
-			connect(inputField, SIGNAL(destroyed(QObject*)), SLOT(onInputFieldDestroyed(QObject*)));
-		}
 	}
 }
 
@@ -182,13 +271,16 @@ void ChatSpellChecker::onAddToDictionaryTriggered()
 	m_speller->store(m_word);
 	SpellHighlighter *highlighter = m_highlighters.value(m_cursor.document());
 	Q_ASSERT(highlighter);
+	highlighter->forget(m_word);
 	highlighter->rehighlightBlock(m_cursor.block());
 }
 
 void ChatSpellChecker::onDictionaryChanged()
 {
-	foreach (SpellHighlighter *highlighter, m_highlighters)
+	foreach (SpellHighlighter *highlighter, m_highlighters) {
+		highlighter->clearCache();
 		highlighter->rehighlight();
+	}
 }
 
 void ChatSpellChecker::onServiceChanged(const QByteArray &name)
@@ -196,8 +288,10 @@ void ChatSpellChecker::onServiceChanged(const QByteArray &name)
 	if (name != "SpellChecker")
 		return;
 	connect(m_speller, SIGNAL(dictionaryChanged()), SLOT(onDictionaryChanged()));
-	foreach (SpellHighlighter *highlighter, m_highlighters)
+	foreach (SpellHighlighter *highlighter, m_highlighters) {
+		highlighter->clearCache();
 		highlighter->rehighlight();
+	}
 }
 
 void ChatSpellChecker::insertAction(QMenu *menu, QAction *before, const QString &text, const char *slot)
@@ -34,6 +34,8 @@
 #include <QSyntaxHighlighter>
 #include <QTextCursor>
 #include <QMetaMethod>
+#include <QCache>
+#include <QSet>
 
 namespace Core {
 
@@ -47,9 +49,19 @@ class SpellHighlighter : public QSyntaxHighlighter
 public:
 	explicit SpellHighlighter(QTextDocument *doc);
 	virtual void highlightBlock(const QString &text);
+	// Forget all checked words, i.e. after dictionary change
+	void clearCache();
+	void forget(const QString &word);
 private:
+	void checkAsync(const QStringList &words);
+
 	qutim_sdk_0_3::ServicePointer<SpellChecker> m_speller;
 	QTextCharFormat m_format;
+	// Results of already checked words, so only edited word is passed
+	// to the speller on every keystroke
+	QCache<QString, bool> m_cache;
+	QSet<QString> m_pending;
+	int m_generation;
 };
 
 class ChatSpellChecker : public QObject, public StartupModule
@@ -7,18 +7,17 @@ LastActivityComparator::LastActivityComparator()
 	Q_UNUSED(QT_TRANSLATE_NOOP("ContactList", "Sort by contact's last activity"));
 }
 
-int LastActivityComparator::compare(qutim_sdk_0_3::Contact *a, qutim_sdk_0_3::Contact *b)
+quint64 LastActivityComparator::sortRank(qutim_sdk_0_3::Contact *contact) const
 {
-	int result = b->lastActivity().toTime_t() - a->lastActivity().toTime_t();
-	if (result)
-		return result;
-    return StatusComparator::compare(a, b);
+	// Recently active contacts go first, status is used for equal activity
+	const quint32 activity = contact->lastActivity().toTime_t();
+	return (quint64(~activity) << 32) | StatusComparator::sortRank(contact);
 }
 
 void LastActivityComparator::doStartListen(qutim_sdk_0_3::Contact *contact)
 {
     StatusComparator::doStartListen(contact);
-	connect(contact, SIGNAL(lastActivityChanged(QDateTime,QDateTime)), SLOT(onContactChanged()));
+	connect(contact, SIGNAL(lastActivityChanged(QDateTime,QDateTime)), SLOT(onRankChanged()));
 }
 
 } // namespace Core
@@ -9,26 +9,72 @@ StatusComparator::StatusComparator()
 
 int StatusComparator::compare(qutim_sdk_0_3::Contact *a, qutim_sdk_0_3::Contact *b)
 {
-	int result = a->status().type() - b->status().type();
-	if (result)
-		return result;
-	return a->title().compare(b->title(), Qt::CaseInsensitive);
+	const SortKey first = sortKey(a);
+	const SortKey second = sortKey(b);
+	if (first.rank != second.rank)
+		return first.rank < second.rank ? -1 : 1;
+	return first.title.compare(second.title);
+}
+
+quint64 StatusComparator::sortRank(qutim_sdk_0_3::Contact *contact) const
+{
+	// Connecting is -1, so shift all types to be non-negative
+	return quint64(contact->status().type() + 1);
+}
+
+StatusComparator::SortKey StatusComparator::sortKey(qutim_sdk_0_3::Contact *contact) const
+{
+	auto it = m_keys.constFind(contact);
+	if (it != m_keys.constEnd())
+		return it.value();
+	return createSortKey(contact);
+}
+
+StatusComparator::SortKey StatusComparator::createSortKey(qutim_sdk_0_3::Contact *contact) const
+{
+	SortKey key = {
+		sortRank(contact),
+		contact->title().toCaseFolded()
+	};
+	return key;
 }
 
 void StatusComparator::doStartListen(qutim_sdk_0_3::Contact *contact)
 {
-	connect(contact, SIGNAL(nameChanged(QString,QString)), SLOT(onContactChanged()));
-	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)), SLOT(onContactChanged()));
+	m_keys.insert(contact, createSortKey(contact));
+	connect(contact, SIGNAL(nameChanged(QString,QString)), SLOT(onTitleChanged()));
+	connect(contact, SIGNAL(titleChanged(QString,QString)), SLOT(onTitleChanged()));
+	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)), SLOT(onRankChanged()));
+	connect(contact, SIGNAL(destroyed(QObject*)), SLOT(onContactDestroyed(QObject*)));
 }
 
 void StatusComparator::doStopListen(qutim_sdk_0_3::Contact *contact)
 {
 	contact->disconnect(this);
+	m_keys.remove(contact);
+}
+
+void StatusComparator::onRankChanged()
+{
+	qutim_sdk_0_3::Contact *contact = static_cast<qutim_sdk_0_3::Contact*>(sender());
+	auto it = m_keys.find(contact);
+	if (it != m_keys.end())
+		it->rank = sortRank(contact);
+	emit contactChanged(contact);
+}
+
+void StatusComparator::onTitleChanged()
+{
+	qutim_sdk_0_3::Contact *contact = static_cast<qutim_sdk_0_3::Contact*>(sender());
+	auto it = m_keys.find(contact);
+	if (it != m_keys.end())
+		it->title = contact->title().toCaseFolded();
+	emit contactChanged(contact);
 }
 
-void StatusComparator::onContactChanged()
+void StatusComparator::onContactDestroyed(QObject *object)
 {
-	emit contactChanged(static_cast<qutim_sdk_0_3::Contact*>(sender()));
+	m_keys.remove(static_cast<qutim_sdk_0_3::Contact*>(object));
 }
 
 } // namespace Core
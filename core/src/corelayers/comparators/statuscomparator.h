@@ -1,6 +1,7 @@
 #ifndef CORE_STATUSCOMPARATOR_H
 #define CORE_STATUSCOMPARATOR_H
 #include <qutim/contact.h>
+#include <QHash>
 
 namespace Core {
 
@@ -14,8 +15,36 @@ public:
 protected:
 	virtual void doStartListen(qutim_sdk_0_3::Contact *contact);
 	virtual void doStopListen(qutim_sdk_0_3::Contact *contact);
-private slots:
+
+	/*!
+	 * Packed sort key, contacts are ordered by rank and then by title.
+	 * It is cached for listened contacts and updated only by signals
+	 * which may change the corresponding part.
+	 */
+	struct SortKey
+	{
+		quint64 rank;
+		// Folded title gives the same order as case insensitive comparison
+		QString title;
+	};
+	virtual quint64 sortRank(qutim_sdk_0_3::Contact *contact) const;
+	SortKey sortKey(qutim_sdk_0_3::Contact *contact) const;
+	SortKey createSortKey(qutim_sdk_0_3::Contact *contact) const;
+protected slots:
+	void onRankChanged();
+	void onTitleChanged();
+	void onContactDestroyed(QObject *object);
+private:
+	QHash<qutim_sdk_0_3::Contact*, SortKey> m_keys;
+};
+	SortKey sortKey(qutim_sdk_0_3::Contact *contact) const;
+	static SortKey createSortKey(qutim_sdk_0_3::Contact *contact);
+	static int compareKeys(const SortKey &a, const SortKey &b);
+protected slots:
 	void onContactChanged();
+	void onContactDestroyed(QObject *object);
+private:
+	QHash<qutim_sdk_0_3::Contact*, SortKey> m_keys;
 };
 
 } // namespace Core
@@ -29,6 +29,8 @@
 #include <qutim/icon.h>
 #include <qutim/event.h>
 #include <qutim/accountmanager.h>
+#include <qutim/metrics.h>
+#include <qutim/memoryaccounting.h>
 
 #include <QCoreApplication>
 #include <QStringBuilder>
@@ -39,6 +41,16 @@
 
 using namespace qutim_sdk_0_3;
 
+enum { ChangesInterval = 16 };
+
+template <typename Callback>
+static void forEachTrigram(const QString &text, const Callback &callback)
+{
+	const ushort *data = text.utf16();
+	for (int i = 0; i + 2 < text.size(); ++i)
+		callback((quint64(data[i]) << 32) | (quint64(data[i + 1]) << 16) | quint64(data[i + 2]));
+}
+
 ContactListBaseModel::ContactListBaseModel(QObject *parent) :
 	QAbstractItemModel(parent), NotificationBackend("ContactList")
 {
@@ -46,6 +58,9 @@ ContactListBaseModel::ContactListBaseModel(QObject *parent) :
 	allowRejectedNotifications("confMessageWithoutUserNick");
 
 	m_showNotificationIcon = false;
+	m_bulkInsert = false;
+	m_bulkDepth = 0;
+	m_revision = 0;
 
 	m_mailIcon = Icon(QLatin1String("mail-message-new-qutim"));
 	m_typingIcon = Icon(QLatin1String("im-status-message-edit"));
@@ -58,6 +73,18 @@ ContactListBaseModel::ContactListBaseModel(QObject *parent) :
 
 	m_realAccountRequestId = Event::registerType("real-account-request");
 	m_realUnitRequestId = Event::registerType("real-chatunit-request");
+
+	MemoryAccounting::add(MemoryAccounting::ContactList, this, QLatin1String(metaObject()->className()), [this] () {
+		// Every contact has a node per tag and an entry in counters of its parents
+		qint64 result = 0;
+		for (auto it = m_contactHash.constBegin(); it != m_contactHash.constEnd(); ++it)
+			result += 32 + it->size() * (sizeof(ContactNode) + 3 * 32);
+		for (auto it = m_trigrams.constBegin(); it != m_trigrams.constEnd(); ++it)
+			result += 32 + it->size() * 16;
+		for (auto it = m_indexedText.constBegin(); it != m_indexedText.constEnd(); ++it)
+			result += 32 + MemoryAccounting::stringSize(it.value());
+		return result;
+	});
 }
 
 QModelIndex ContactListBaseModel::index(int row, int column, const QModelIndex &parent) const
@@ -127,6 +154,10 @@ bool ContactListBaseModel::hasChildren(const QModelIndex &parent) const
 
 QVariant ContactListBaseModel::data(const QModelIndex &index, int role) const
 {
+	if (role == RevisionRole) {
+		BaseNode *node = index.isValid() ? extractNode(index) : NULL;
+		return node ? revision(node) : QVariant();
+	}
 	if (AccountNode *node = extractNode<AccountNode>(index)) {
 		if (!node->account)
 			return QVariant();
@@ -234,6 +265,94 @@ QVariant ContactListBaseModel::data(const QModelIndex &index, int role) const
 	return QVariant();
 }
 
+ContactListItemType ContactListBaseModel::itemType(const QModelIndex &index) const
+{
+	BaseNode *node = index.isValid() ? extractNode(index) : NULL;
+	switch (node ? node->type() : RootNodeType) {
+	case AccountNodeType:
+		return AccountType;
+	case TagNodeType:
+		return TagType;
+	case ContactNodeType:
+		return ContactType;
+	default:
+		return InvalidType;
+	}
+}
+
+Contact *ContactListBaseModel::contact(const QModelIndex &index) const
+{
+	ContactNode *node = extractNode<ContactNode>(index);
+	if (!node || !node->contact)
+		return NULL;
+	return node->contact.data();
+}
+
+QSet<Contact*> ContactListBaseModel::searchContacts(const QString &text) const
+{
+	const QString folded = text.toCaseFolded();
+	QSet<Contact*> result;
+
+	if (folded.size() < 3) {
+		for (auto it = m_indexedText.constBegin(); it != m_indexedText.constEnd(); ++it) {
+			if (it.value().contains(folded))
+				result.insert(it.key());
+		}
+		return result;
+	}
+
+	QList<const QSet<Contact*> *> postings;
+	bool missed = false;
+	forEachTrigram(folded, [this, &postings, &missed] (quint64 trigram) {
+		auto it = m_trigrams.constFind(trigram);
+		if (it == m_trigrams.constEnd())
+			missed = true;
+		else
+			postings << &it.value();
+	});
+	if (missed || postings.isEmpty())
+		return result;
+
+	std::sort(postings.begin(), postings.end(), [] (const QSet<Contact*> *a, const QSet<Contact*> *b) {
+		return a->size() < b->size();
+	});
+	result = *postings.first();
+	for (int i = 1; i < postings.size() && !result.isEmpty(); ++i)
+		result.intersect(*postings.at(i));
+	return result;
+}
+
+void ContactListBaseModel::indexContact(Contact *contact)
+{
+	const QString text = contact->id().toCaseFolded() % QLatin1Char('\n') % contact->name().toCaseFolded();
+	auto it = m_indexedText.find(contact);
+	if (it != m_indexedText.end()) {
+		if (it.value() == text)
+			return;
+		unindexContact(contact);
+	}
+
+	m_indexedText.insert(contact, text);
+	forEachTrigram(text, [this, contact] (quint64 trigram) {
+		m_trigrams[trigram].insert(contact);
+	});
+	emit contactIndexed(contact);
+}
+
+void ContactListBaseModel::unindexContact(Contact *contact)
+{
+	auto it = m_indexedText.find(contact);
+	if (it == m_indexedText.end())
+		return;
+	forEachTrigram(it.value(), [this, contact] (quint64 trigram) {
+		auto jt = m_trigrams.find(trigram);
+		if (jt != m_trigrams.end() && jt->remove(contact) && jt->isEmpty())
+			m_trigrams.erase(jt);
+	});
+	m_indexedText.erase(it);
+	emit contactUnindexed(contact);
+}
+
 void ContactListBaseModel::handleNotification(Notification *notification)
 {
 	Contact *contact = findRealContact(notification);
@@ -260,6 +379,10 @@ void ContactListBaseModel::handleNotification(Notification *notification)
 
 void ContactListBaseModel::timerEvent(QTimerEvent *event)
 {
+	if (event->timerId() == m_changesTimer.timerId()) {
+		flushChanges();
+		return;
+	}
 	if (event->timerId() == m_notificationTimer.timerId()) {
 		m_showNotificationIcon = !m_showNotificationIcon;
 
@@ -367,11 +490,13 @@ void ContactListBaseModel::setCollapsed(const QModelIndex &itemIndex, bool colla
 {
     if (ContactListNode *node = extractNode<ContactListNode>(itemIndex)) {
         node->collapsed = collapsed;
-        const QVector<int> roles = { CollapsedRole };
+        node->revision = 0;
+        const QVector<int> roles = { CollapsedRole, RevisionRole };
         dataChanged(itemIndex, itemIndex, roles);
         int count = rowCount(itemIndex);
         for (int i = 0; i < count; ++i) {
             QModelIndex childIndex = index(i, 0, itemIndex);
+            extractNode(childIndex)->revision = 0;
             dataChanged(childIndex, childIndex, roles);
         }
     }
@@ -398,7 +523,11 @@ void ContactListBaseModel::onAccountCreated(Account *account, bool addContacts)
 {
 	addAccount(account);
 
+	if (account->isRosterUpdating())
+		m_updatingAccounts.insert(account);
+
 	if (addContacts) {
+		++m_bulkDepth;
 		foreach (Contact *contact, account->findChildren<Contact*>()) {
 			if (!contact->metaContact())
 				onContactAdded(contact);
@@ -409,17 +538,27 @@ void ContactListBaseModel::onAccountCreated(Account *account, bool addContacts)
 				}
 			}
 		}
+		--m_bulkDepth;
+		if (!isBulkUpdate())
+			flushPendingContacts();
 	}
 
 	connect(account, SIGNAL(destroyed(QObject*)),
 			this, SLOT(onAccountDestroyed(QObject*)));
 	connect(account, SIGNAL(contactCreated(qutim_sdk_0_3::Contact*)),
 			this, SLOT(onContactAdded(qutim_sdk_0_3::Contact*)));
+	connect(account, SIGNAL(rosterUpdateStarted()),
+			this, SLOT(onRosterUpdateStarted()));
+	connect(account, SIGNAL(rosterUpdateFinished()),
+			this, SLOT(onRosterUpdateFinished()));
 }
 
 void ContactListBaseModel::onAccountDestroyed(QObject *obj)
 {
-	removeAccountNode(static_cast<Account*>(obj), &m_root);
+	Account *account = static_cast<Account*>(obj);
+	removeAccountNode(account, &m_root);
+	if (m_updatingAccounts.remove(account) && !isBulkUpdate())
+		flushPendingContacts();
 }
 
 void ContactListBaseModel::onAccountRemoved(Account *account)
@@ -437,12 +576,92 @@ void ContactListBaseModel::onAccountRemoved(Account *account)
 	removeAccount(account);
 
 	removeAccountNode(account, &m_root);
+
+	if (m_updatingAccounts.remove(account) && !isBulkUpdate())
+		flushPendingContacts();
+}
+
+void ContactListBaseModel::onRosterUpdateStarted()
+{
+	if (Account *account = qobject_cast<Account*>(sender()))
+		m_updatingAccounts.insert(account);
+}
+
+void ContactListBaseModel::onRosterUpdateFinished()
+{
+	Account *account = qobject_cast<Account*>(sender());
+	if (account && m_updatingAccounts.remove(account) && !isBulkUpdate())
+		flushPendingContacts();
+}
+
+void ContactListBaseModel::flushPendingContacts()
+{
+	QHash<Contact*, QStringList> pendingTags;
+	qSwap(pendingTags, m_pendingTags);
+	for (auto it = pendingTags.constBegin(); it != pendingTags.constEnd(); ++it) {
+		Contact *contact = it.key();
+		const QStringList current = contact->tags();
+		if (current == it.value())
+			continue;
+		addTags(current);
+		updateContactTags(contact, current, it.value());
+		onContactChanged(contact);
+	}
+
+	QVector<QPointer<Contact> > pending;
+	qSwap(pending, m_pendingContacts);
+
+	QList<Contact*> contacts;
+	QSet<Contact*> used;
+	QStringList tags;
+	contacts.reserve(pending.size());
+	foreach (const QPointer<Contact> &contact, pending) {
+		if (!contact || used.contains(contact.data()))
+			continue;
+		used.insert(contact.data());
+		contacts << contact.data();
+		tags << contact->tags();
+	}
+	if (contacts.isEmpty())
+		return;
+
+	// Nodes are kept sorted by pointer, so sorted input touches each list in order
+	std::sort(contacts.begin(), contacts.end());
+	addTags(tags);
+	foreach (Contact *contact, contacts)
+		indexContact(contact);
+
+	emit layoutAboutToBeChanged();
+	const QModelIndexList persistentIndexes = persistentIndexList();
+	QList<BaseNode*> persistentNodes;
+	persistentNodes.reserve(persistentIndexes.size());
+	foreach (const QModelIndex &index, persistentIndexes)
+		persistentNodes << extractNode(index);
+
+	m_bulkInsert = true;
+	foreach (Contact *contact, contacts) {
+		addContact(contact);
+		connectContact(contact);
+	}
+	m_bulkInsert = false;
+
+	QModelIndexList updatedIndexes;
+	updatedIndexes.reserve(persistentNodes.size());
+	foreach (BaseNode *node, persistentNodes)
+		updatedIndexes << createIndex(node);
+	changePersistentIndexList(persistentIndexes, updatedIndexes);
+	emit layoutChanged();
+	static Counter *resets = Metrics::counter("qutim_model_resets_total", QStringLiteral("model=\"contactlist\""));
+	resets->add();
 }
 
 void ContactListBaseModel::onContactDestroyed(QObject *obj)
 {
 	Contact *contact = static_cast<Contact*>(obj);
 
+	m_changedContacts.remove(contact);
+	m_pendingTags.remove(contact);
+	unindexContact(contact);
 	if (m_notificationHash.remove(contact) > 0 && m_notificationHash.isEmpty())
 		m_notificationTimer.stop();
 
@@ -470,8 +689,14 @@ void ContactListBaseModel::onContactDestroyed(QObject *obj)
 
 void ContactListBaseModel::onContactAdded(Contact *contact)
 {
+	if (isBulkUpdate()) {
+		m_pendingContacts << contact;
+		return;
+	}
+
 	addTags(contact->tags());
 
+	indexContact(contact);
 	addContact(contact);
 
 	connectContact(contact);
@@ -479,61 +704,135 @@ void ContactListBaseModel::onContactAdded(Contact *contact)
 
 void ContactListBaseModel::onContactRemoved(Contact *contact)
 {
+	if (!m_pendingContacts.isEmpty()) {
+		const int count = m_pendingContacts.size();
+		m_pendingContacts.removeAll(contact);
+		if (count != m_pendingContacts.size())
+			return;
+	}
+
 	if (m_notificationHash.remove(contact) > 0 && m_notificationHash.isEmpty())
 		m_notificationTimer.stop();
 
+	// Node of contact is found by its current tags, moves are not delayed anymore
+	auto pendingTags = m_pendingTags.find(contact);
+	if (pendingTags != m_pendingTags.end()) {
+		const QStringList previous = pendingTags.value();
+		m_pendingTags.erase(pendingTags);
+		updateContactTags(contact, contact->tags(), previous);
+	}
+
 	removeContact(contact);
+	unindexContact(contact);
 
 	disconnectContact(contact);
 }
 
 void ContactListBaseModel::onContactChanged(Contact *contact, bool parentsChanged)
 {
-	ContactHash::Iterator it = m_contactHash.find(contact);
-
-	QSet<BaseNode*> used;
-	QQueue<BaseNode*> queue;
-
-	if (it != m_contactHash.end()) {
-		if (!parentsChanged) {
-			foreach (ContactNode *node, *it) {
-				QModelIndex index = createIndex(node);
-				dataChanged(index, index);
-			}
-		} else {
-			// Restricted nodes
-			used << NULL << &m_root;
+	if (m_contactHash.contains(contact))
+		markContactChanged(contact, parentsChanged);
+}
 
-			foreach (ContactNode *node, *it) {
-				used << node;
-				queue.enqueue(node);
-			}
+void ContactListBaseModel::markContactChanged(Contact *contact, bool parentsChanged)
+{
+	bool &value = m_changedContacts[contact];
+	value = value || parentsChanged;
+	if (!m_changesTimer.isActive())
+		m_changesTimer.start(ChangesInterval, this);
+}
 
-			while (!queue.isEmpty()) {
-				BaseNode *node = queue.dequeue();
-				QModelIndex index = createIndex(node);
-				dataChanged(index, index);
+void ContactListBaseModel::markNodeChanged(BaseNode *node)
+{
+	m_changedNodes.insert(node);
+	if (!m_changesTimer.isActive())
+		m_changesTimer.start(ChangesInterval, this);
+}
 
-				if (!used.contains(node->parent())) {
-					used << node->parent();
-					queue.enqueue(node->parent());
-				}
-			}
+void ContactListBaseModel::flushChanges()
+{
+	m_changesTimer.stop();
+
+	QHash<Contact*, bool> contacts;
+	qSwap(contacts, m_changedContacts);
+	QSet<BaseNode*> nodes;
+	qSwap(nodes, m_changedNodes);
+
+	// Rows of changed nodes grouped by their parents
+	QHash<BaseNode*, QMap<int, BaseNode*> > rows;
+	auto addNode = [this, &rows] (BaseNode *node) {
+		node->revision = 0;
+		const QModelIndex index = createIndex(node);
+		if (index.isValid())
+			rows[node->parent()].insert(index.row(), node);
+	};
+
+	for (auto it = contacts.constBegin(); it != contacts.constEnd(); ++it) {
+		ContactHash::ConstIterator jt = m_contactHash.constFind(it.key());
+		if (jt == m_contactHash.constEnd())
+			continue;
+		foreach (ContactNode *node, *jt) {
+			addNode(node);
+			if (!it.value())
+				continue;
+			for (BaseNode *parent = node->parent(); parent && parent != &m_root; parent = parent->parent())
+				nodes.insert(parent);
+		}
+	}
+	foreach (BaseNode *node, nodes)
+		addNode(node);
+
+	// Emit single dataChanged for every continuous range of rows
+	for (auto it = rows.constBegin(); it != rows.constEnd(); ++it) {
+		const QMap<int, BaseNode*> &childRows = it.value();
+		auto jt = childRows.constBegin();
+		while (jt != childRows.constEnd()) {
+			auto first = jt;
+			auto last = jt;
+			while (++jt != childRows.constEnd() && jt.key() == last.key() + 1)
+				last = jt;
+			dataChanged(createIndex(*first.value(), first.key()), createIndex(*last.value(), last.key()));
 		}
 	}
 }
 
+quint32 ContactListBaseModel::revision(BaseNode *node) const
+{
+	// Revisions are unique through the whole model, so they identify
+	// the row as well as its state
+	if (!node->revision) {
+		if (!++m_revision)
+			++m_revision;
+		node->revision = m_revision;
+	}
+	return node->revision;
+}
+
 void ContactListBaseModel::onContactChanged()
 {
 	if (Contact *contact = qobject_cast<Contact*>(sender()))
 		onContactChanged(contact);
 }
 
+void ContactListBaseModel::onContactNameChanged()
+{
+	if (Contact *contact = qobject_cast<Contact*>(sender()))
+		indexContact(contact);
+}
+
 void ContactListBaseModel::onContactTagsChanged(const QStringList &current, const QStringList &previous)
 {
+	Contact *contact = qobject_cast<Contact*>(sender());
+	// Contacts moved during roster update are moved in the tree once it's finished
+	if (contact && isBulkUpdate()) {
+		if (!m_pendingTags.contains(contact))
+			m_pendingTags.insert(contact, previous);
+		return;
+	}
+
 	addTags(current);
 
-	if (Contact *contact = qobject_cast<Contact*>(sender())) {
+	if (contact) {
 		updateContactTags(contact, current, previous);
 		onContactChanged(contact);
 	}
@@ -541,6 +840,9 @@ void ContactListBaseModel::onContactTagsChanged(const QStringList &current, cons
 
 void ContactListBaseModel::onStatusChanged(const Status &current, const Status &previous)
 {
+	// Interned statuses make this a pointer compare
+	if (current == previous)
+		return;
 	Contact *contact = static_cast<Contact*>(sender());
 	const bool wasOnline = (previous != Status::Offline);
 	const bool online = (current != Status::Offline);
@@ -550,12 +852,9 @@ void ContactListBaseModel::onStatusChanged(const Status &current, const Status &
 	} else {
 		ContactHash::Iterator it = m_contactHash.find(contact);
 		if (it != m_contactHash.end()) {
-			foreach (ContactNode *node, *it) {
-				QModelIndex contactIndex = createIndex(node);
-				dataChanged(contactIndex, contactIndex);
-
+			markContactChanged(contact, false);
+			foreach (ContactNode *node, *it)
 				updateItemCount(contact, node->parent(), online ? 1 : -1, 0);
-			}
 		}
 	}
 }
@@ -564,17 +863,17 @@ ContactListBaseModel::AccountNode *ContactListBaseModel::ensureAccount(Account *
 {
 	account = findRealAccount(account);
 
-	QModelIndex index = createIndex(parent);
-
 	for (int i = 0; i < parent->accounts.size(); ++i) {
 		if (parent->accounts[i].account == account)
 			return &parent->accounts[i];
 	}
 
-	beginInsertRows(index, parent->accounts.size(), parent->accounts.size());
+	if (!m_bulkInsert)
+		beginInsertRows(createIndex(parent), parent->accounts.size(), parent->accounts.size());
 	parent->accounts.append(AccountNode(account, m_root));
 	AccountNode *node = &parent->accounts.last();
-	endInsertRows();
+	if (!m_bulkInsert)
+		endInsertRows();
 
 	return node;
 }
@@ -588,8 +887,6 @@ void ContactListBaseModel::eraseAccount(Account *account, ContactListBaseModel::
 
 ContactListBaseModel::TagNode *ContactListBaseModel::ensureTag(const QString &name, ContactListBaseModel::TagListNode *parent)
 {
-	QModelIndex parentIndex = createIndex(parent);
-
 	QList<TagNode>::iterator it = qLowerBound(parent->tags.begin(),
 											  parent->tags.end(),
 											  name,
@@ -598,17 +895,17 @@ ContactListBaseModel::TagNode *ContactListBaseModel::ensureTag(const QString &na
 		return &*it;
 	int index = it - parent->tags.begin();
 
-	beginInsertRows(parentIndex, index, index);
+	if (!m_bulkInsert)
+		beginInsertRows(createIndex(parent), index, index);
 	it = parent->tags.insert(it, TagNode(name, *parent));
-	endInsertRows();
+	if (!m_bulkInsert)
+		endInsertRows();
 
 	return &*it;
 }
 
 ContactListBaseModel::ContactNode *ContactListBaseModel::ensureContact(Contact *contact, ContactListBaseModel::ContactListNode *parent)
 {
-	QModelIndex parentIndex = createIndex(parent);
-
 	QList<ContactNode>::iterator it = qLowerBound(parent->contacts.begin(),
 												  parent->contacts.end(),
 												  contact,
@@ -617,12 +914,14 @@ ContactListBaseModel::ContactNode *ContactListBaseModel::ensureContact(Contact *
 	if (it == parent->contacts.end() || it->contact != contact) {
 		int index = it - parent->contacts.begin();
 
-		beginInsertRows(parentIndex, index, index);
+		if (!m_bulkInsert)
+			beginInsertRows(createIndex(parent), index, index);
 		it = parent->contacts.insert(it, ContactNode(contact, *parent));
 		ContactNode &node = *it;
 		m_contactHash[contact].append(&node);
 		Q_ASSERT(m_contactHash[contact].count(&node) == 1);
-		endInsertRows();
+		if (!m_bulkInsert)
+			endInsertRows();
 
 		const bool online = (contact->status() != Status::Offline);
 		updateItemCount(contact, parent, online ? 1 : 0, 1);
@@ -791,10 +1090,8 @@ void ContactListBaseModel::updateItemCount(Contact *contact, ContactListBaseMode
 		modified |= fix_hash(parent->onlineContacts, contact, online);
 		modified |= fix_hash(parent->totalContacts, contact, total);
 
-		if (modified) {
-			QModelIndex index = createIndex(parent);
-			dataChanged(index, index);
-		}
+		if (modified && !m_bulkInsert)
+			markNodeChanged(parent);
 		parent = node_cast<ContactListNode *>(parent->parent());
 	}
 }
@@ -805,6 +1102,11 @@ void ContactListBaseModel::removeAccountNode(Account *account, ContactListBaseMo
 		for (int index = 0; index < node->accounts.size(); ++index) {
 			AccountNode *accountNode = &node->accounts[index];
 			if (accountNode->account == account) {
+				if (!m_changedNodes.isEmpty()) {
+					m_changedNodes.remove(accountNode);
+					for (int i = 0; i < accountNode->tags.size(); ++i)
+						m_changedNodes.remove(&accountNode->tags[i]);
+				}
 				beginRemoveRows(createIndex(parent), index, index);
 				clearContacts(accountNode);
 				node->accounts.removeAt(index);
@@ -818,8 +1120,11 @@ void ContactListBaseModel::removeAccountNode(Account *account, ContactListBaseMo
 void ContactListBaseModel::clearContacts(ContactListBaseModel::BaseNode *current)
 {
 	if (ContactListNode *list = node_cast<ContactListNode*>(current)) {
-		for (int i = 0; i < list->contacts.size(); ++i)
-			m_contactHash.remove(list->contacts[i].contact.data());
+		for (int i = 0; i < list->contacts.size(); ++i) {
+			Contact *contact = list->contacts[i].contact.data();
+			m_contactHash.remove(contact);
+			unindexContact(contact);
+		}
 	}
 	if (TagListNode *list = node_cast<TagListNode*>(current)) {
 		for (int i = 0; i < list->tags.size(); ++i)
@@ -881,6 +1186,8 @@ void ContactListBaseModel::connectContact(Contact *contact)
 			this, SLOT(onContactChanged()));
 	connect(contact, SIGNAL(titleChanged(QString,QString)),
 			this, SLOT(onContactChanged()));
+	connect(contact, SIGNAL(nameChanged(QString,QString)),
+			this, SLOT(onContactNameChanged()));
 	connect(contact, SIGNAL(avatarChanged(QString)),
 			this, SLOT(onContactChanged()));
 	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
@@ -32,6 +32,9 @@
 #include <qutim/notification.h>
 #include <QAbstractItemModel>
 #include <QBasicTimer>
+#include <QPointer>
+#include <QSet>
+#include <QVector>
 
 class ContactListFrontModel;
 
@@ -56,6 +59,8 @@ enum ContactListItemRole
     CollapsedRole,
     FirstItemRole,
     LastItemRole,
+    // Changes every time other data of the row changes, delegates may key their caches on it
+    RevisionRole
 };
 
 enum ContactListItemType
@@ -87,6 +92,16 @@ public:
 
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 
+	// Same as ItemTypeRole and BuddyRole, but without QVariant round trip
+	ContactListItemType itemType(const QModelIndex &index) const;
+	qutim_sdk_0_3::Contact *contact(const QModelIndex &index) const;
+
+	/*!
+	 * Returns contacts which may contain \a text in id or name case insensitively.
+	 * Result is a superset of real matches, it comes from trigram index.
+	 */
+	QSet<qutim_sdk_0_3::Contact*> searchContacts(const QString &text) const;
+
 	virtual void handleNotification(qutim_sdk_0_3::Notification *notification);
 
 	virtual void timerEvent(QTimerEvent *event);
@@ -149,11 +164,14 @@ protected:
     class BaseNode
 	{
     public:
-		inline BaseNode(NodeType type, BaseNode *parent) : m_type(type), m_parent(parent) {}
+		inline BaseNode(NodeType type, BaseNode *parent) : revision(0), m_type(type), m_parent(parent) {}
 
 		inline NodeType type() const { return m_type; }
 		inline BaseNode *parent() const { return m_parent; }
 
+		// Zero means the node is changed and gets new revision on request
+		mutable quint32 revision;
+
 	private:
 		NodeType m_type;
 		BaseNode *m_parent;
@@ -258,16 +276,23 @@ protected:
 
 signals:
 	void tagsChanged(const QStringList &tags);
+	// Emitted after search index of the contact is updated, before its rows are changed
+	void contactIndexed(qutim_sdk_0_3::Contact *contact);
+	// Contact may be already destroyed, so it must not be dereferenced
+	void contactUnindexed(qutim_sdk_0_3::Contact *contact);
 
 private slots:
 	void onAccountCreated(qutim_sdk_0_3::Account *account, bool addContacts = true);
 	void onAccountDestroyed(QObject *obj);
 	void onAccountRemoved(qutim_sdk_0_3::Account *account);
+	void onRosterUpdateStarted();
+	void onRosterUpdateFinished();
 	void onContactDestroyed(QObject *obj);
 	void onContactAdded(qutim_sdk_0_3::Contact *contact);
 	void onContactRemoved(qutim_sdk_0_3::Contact *contact);
 	void onContactChanged(qutim_sdk_0_3::Contact *contact, bool parentsChanged = false);
 	void onContactChanged();
+	void onContactNameChanged();
 	void onContactTagsChanged(const QStringList &current, const QStringList &previous);
 	void onStatusChanged(const qutim_sdk_0_3::Status &current, const qutim_sdk_0_3::Status &previous);
 	void onNotificationFinished();
@@ -307,6 +332,18 @@ private:
 	QIcon findNotificationIcon(qutim_sdk_0_3::Notification *notification) const;
 	static int findNotificationPriority(qutim_sdk_0_3::Notification *notification);
 	void addTags(const QStringList &tags);
+	void indexContact(qutim_sdk_0_3::Contact *contact);
+	void unindexContact(qutim_sdk_0_3::Contact *contact);
+
+	// Contacts created during roster updates are collected and inserted at once
+	bool isBulkUpdate() const { return m_bulkDepth > 0 || !m_updatingAccounts.isEmpty(); }
+	void flushPendingContacts();
+
+	// Changes of contacts and counters are collected and emitted at most once per frame
+	void markContactChanged(qutim_sdk_0_3::Contact *contact, bool parentsChanged);
+	void markNodeChanged(BaseNode *node);
+	void flushChanges();
+	quint32 revision(BaseNode *node) const;
 
 	void updateItemCount(qutim_sdk_0_3::Contact *contact, ContactListNode *parent, int online, int total);
 	void removeAccountNode(qutim_sdk_0_3::Account *account, BaseNode *parent);
@@ -341,9 +378,24 @@ private:
 	QIcon m_birthdayIcon;
 	QIcon m_defaultNotificationIcon;
 	QBasicTimer m_notificationTimer;
+	QBasicTimer m_changesTimer;
+	// Value is true if parents of contact should be updated too
+	QHash<qutim_sdk_0_3::Contact*, bool> m_changedContacts;
+	QSet<BaseNode*> m_changedNodes;
+	mutable quint32 m_revision;
+	// Trigrams of case folded ids and names
+	QHash<quint64, QSet<qutim_sdk_0_3::Contact*> > m_trigrams;
+	QHash<qutim_sdk_0_3::Contact*, QString> m_indexedText;
 	quint16 m_realAccountRequestId;
 	quint16 m_realUnitRequestId;
 	bool m_showNotificationIcon;
+	// Set while pending contacts are inserted, model signals are suppressed
+	bool m_bulkInsert;
+	int m_bulkDepth;
+	QSet<qutim_sdk_0_3::Account*> m_updatingAccounts;
+	QVector<QPointer<qutim_sdk_0_3::Contact> > m_pendingContacts;
+	// Tags which contacts had before the first change during roster update
+	QHash<qutim_sdk_0_3::Contact*, QStringList> m_pendingTags;
 };
 
 #endif // CONTACTLISTMODELBASE_H
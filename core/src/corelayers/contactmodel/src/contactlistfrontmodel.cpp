@@ -27,6 +27,8 @@
 #include "contactlistmimedata.h"
 #include <qutim/protocol.h>
 #include <qutim/accountmanager.h>
+#include <qutim/rosterstorage.h>
+#include <QSharedPointer>
 #include <QDebug>
 #include <QMetaMethod>
 
@@ -98,6 +100,7 @@ QHash<int, QByteArray> ContactListFrontModel::roleNames() const
     roleNames.insert(FirstItemRole, "isFirst");
     roleNames.insert(LastItemRole, "isLast");
     roleNames.insert(CollapsedRole, "collapsed");
+    roleNames.insert(RevisionRole, "revision");
 	return roleNames;
 }
 
@@ -158,16 +161,30 @@ bool ContactListFrontModel::dropMimeData(const QMimeData *genericData, Qt::DropA
 	const ContactListItemType type = static_cast<ContactListItemType>(index.data(ItemTypeRole).toInt());
 	if (parentType == TagType && type == ContactType) {
 		const QString tag = parent.data(TagNameRole).toString();
-		Contact *contact = qobject_cast<Contact*>(index.data(ContactRole).value<QObject*>());
-		Q_ASSERT(contact);
-		QStringList tags = contact->tags();
-		if (tags.contains(tag))
-			return false;
-		if (action == Qt::MoveAction)
-			tags.removeOne(index.parent().data(TagNameRole).toString());
-		tags.append(tag);
-		contact->setTags(tags);
-		return true;
+		// All selected contacts are moved at once, changes of every account
+		// are sent to server and applied to the model as single transaction
+		QHash<Account*, QSharedPointer<RosterTransaction> > transactions;
+		QSet<Contact*> moved;
+		foreach (const QPersistentModelIndex &contactIndex, data->indexes()) {
+			if (contactIndex.data(ItemTypeRole).toInt() != ContactType)
+				continue;
+			Contact *contact = qobject_cast<Contact*>(contactIndex.data(ContactRole).value<QObject*>());
+			Q_ASSERT(contact);
+			if (!contact || moved.contains(contact))
+				continue;
+			QStringList tags = contact->tags();
+			if (tags.contains(tag))
+				continue;
+			if (action == Qt::MoveAction)
+				tags.removeOne(contactIndex.parent().data(TagNameRole).toString());
+			tags.append(tag);
+			moved.insert(contact);
+			Account *account = contact->account();
+			if (!transactions.contains(account))
+				transactions.insert(account, QSharedPointer<RosterTransaction>(new RosterTransaction(account)));
+			contact->setTags(tags);
+		}
+		return !moved.isEmpty();
 	} else if (parent == index.parent()) {
 		const QString parentName = parent.data(TagNameRole).toString();
 		const QString indexName = index.data(TagNameRole).toString();
@@ -302,6 +319,10 @@ void ContactListFrontModel::onServiceChanged(const QByteArray &name, QObject *ne
 		if (newModel) {
 			connect(newModel, &ContactListBaseModel::tagsChanged,
 					this, &ContactListFrontModel::tagsChanged);
+			connect(newModel, &ContactListBaseModel::contactIndexed,
+					this, &ContactListFrontModel::onContactIndexed);
+			connect(newModel, &ContactListBaseModel::contactUnindexed,
+					this, &ContactListFrontModel::onContactUnindexed);
 			connect(m_comparator, SIGNAL(contactChanged(qutim_sdk_0_3::Contact*)),
 					newModel, SLOT(onContactChanged(qutim_sdk_0_3::Contact*)));
 
@@ -319,10 +340,13 @@ void ContactListFrontModel::onServiceChanged(const QByteArray &name, QObject *ne
 			if (oldModel) {
 				QSet<Contact*> contacts;
 				oldModel->findContacts(contacts, oldModel->rootNode());
-				foreach (Contact *contact, contacts)
+				foreach (Contact *contact, contacts) {
+					newModel->indexContact(contact);
 					newModel->addContact(contact);
+				}
 			}
 		}
+		updateFilterMatches(newModel, false);
 		setSourceModel(newModel);
 	} else if (name == m_metaManager.name()) {
 		if (MetaContactManager *oldManager = qobject_cast<MetaContactManager*>(oldObject))
@@ -332,6 +356,56 @@ void ContactListFrontModel::onServiceChanged(const QByteArray &name, QObject *ne
     }
 }
 
+void ContactListFrontModel::setFilterFixedString(const QString &pattern)
+{
+	const QRegExp previous = m_filterPattern;
+	m_filterPattern = QRegExp(pattern, filterCaseSensitivity(), QRegExp::FixedString);
+
+	// Every contact matching longer pattern matches the previous one too,
+	// so only currently visible contacts have to be checked
+	const bool incremental = !previous.isEmpty()
+			&& previous.caseSensitivity() == m_filterPattern.caseSensitivity()
+			&& pattern.contains(previous.pattern(), previous.caseSensitivity());
+	updateFilterMatches(static_cast<ContactListBaseModel*>(sourceModel()), incremental);
+
+	QSortFilterProxyModel::setFilterFixedString(pattern);
+}
+
+void ContactListFrontModel::updateFilterMatches(ContactListBaseModel *model, bool incremental)
+{
+	QSet<Contact*> candidates;
+	if (incremental)
+		qSwap(candidates, m_filterMatches);
+	else if (!m_filterPattern.isEmpty() && model)
+		candidates = model->searchContacts(m_filterPattern.pattern());
+	m_filterMatches.clear();
+
+	foreach (Contact *contact, candidates) {
+		if (matchesFilter(contact))
+			m_filterMatches.insert(contact);
+	}
+}
+
+bool ContactListFrontModel::matchesFilter(Contact *contact) const
+{
+	return contact->id().contains(m_filterPattern) || contact->name().contains(m_filterPattern);
+}
+
+void ContactListFrontModel::onContactIndexed(Contact *contact)
+{
+	if (m_filterPattern.isEmpty())
+		return;
+	if (matchesFilter(contact))
+		m_filterMatches.insert(contact);
+	else
+		m_filterMatches.remove(contact);
+}
+
+void ContactListFrontModel::onContactUnindexed(Contact *contact)
+{
+	m_filterMatches.remove(contact);
+}
+
 void ContactListFrontModel::connectNotify(const QMetaMethod &signal)
 {
     if (m_insideConnectNotify)
@@ -391,11 +465,14 @@ bool ContactListFrontModel::filterAcceptsRowImpl(int sourceRow, const QModelInde
     if (m_filterTags.isEmpty() && m_showOffline && regexp.isEmpty())
         return true;
 
-    switch (index.data(ItemTypeRole).toInt()) {
+    const ContactListBaseModel *model = static_cast<ContactListBaseModel*>(sourceModel());
+    switch (model->itemType(index)) {
     case ContactType: {
-        Contact *contact = qobject_cast<Contact*>(index.data(BuddyRole).value<Buddy*>());
+        Contact *contact = model->contact(index);
         Q_ASSERT(contact);
         if (!regexp.isEmpty()) {
+            if (regexp == m_filterPattern)
+                return m_filterMatches.contains(contact);
             return contact->id().contains(regexp) || contact->name().contains(regexp);
         } else {
             if (index.data(NotificationRole).toInt() >= Notification::IncomingMessage)
@@ -440,15 +517,16 @@ bool ContactListFrontModel::filterAcceptsRow(int sourceRow, const QModelIndex &s
 
 bool ContactListFrontModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
-	const ContactListItemType leftType = static_cast<ContactListItemType>(left.data(ItemTypeRole).toInt());
-	const ContactListItemType rightType = static_cast<ContactListItemType>(right.data(ItemTypeRole).toInt());
+	const ContactListBaseModel *model = static_cast<ContactListBaseModel*>(sourceModel());
+	const ContactListItemType leftType = model->itemType(left);
+	const ContactListItemType rightType = model->itemType(right);
 	if (leftType != rightType)
 		return leftType < rightType;
 
 	switch (leftType) {
 	case ContactType: {
-		Contact *leftContact = qobject_cast<Contact*>(left.data(BuddyRole).value<Buddy*>());
-		Contact *rightContact = qobject_cast<Contact*>(right.data(BuddyRole).value<Buddy*>());
+		Contact *leftContact = model->contact(left);
+		Contact *rightContact = model->contact(right);
 		Q_ASSERT(leftContact);
 		Q_ASSERT(rightContact);
 		return m_comparator->compare(leftContact, rightContact) < 0;
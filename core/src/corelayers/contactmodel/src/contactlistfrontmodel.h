@@ -64,6 +64,8 @@ public:
     virtual QVariant data(const QModelIndex &index, int role) const override;
 
 public slots:
+	// Hides QSortFilterProxyModel's slot to filter incrementally
+	void setFilterFixedString(const QString &pattern);
 	void setFilterTags(const QStringList &filterTags);
 	void inverseOfflineVisibility();
 
@@ -88,12 +90,19 @@ protected:
     bool filterAcceptsRowImpl(int sourceRow, const QModelIndex &sourceParent, bool checkCollapse) const;
     bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
     bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+    void onContactIndexed(qutim_sdk_0_3::Contact *contact);
+    void onContactUnindexed(qutim_sdk_0_3::Contact *contact);
+    void updateFilterMatches(ContactListBaseModel *model, bool incremental);
+    bool matchesFilter(qutim_sdk_0_3::Contact *contact) const;
 
 	bool m_showOffline;
     bool m_insideConnectNotify = false;
     QMetaObject::Connection m_rowsInsertedConnection;
     QMetaObject::Connection m_rowsRemovedConnection;
 	QStringList m_filterTags;
+	// Contacts matching m_filterPattern, kept in sync with search index of base model
+	QRegExp m_filterPattern;
+	QSet<qutim_sdk_0_3::Contact*> m_filterMatches;
 	QHash<QString, QStringList> m_order;
 	qutim_sdk_0_3::ServicePointer<ContactListBaseModel> m_model;
 	qutim_sdk_0_3::ServicePointer<qutim_sdk_0_3::MetaContactManager> m_metaManager;
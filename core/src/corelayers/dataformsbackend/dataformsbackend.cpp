@@ -26,6 +26,7 @@
 #include "modifiablewidget.h"
 #include "datalayout.h"
 #include "widgetgenerator.h"
+#include "widgets.h"
 #include <QDialogButtonBox>
 #include <QPushButton>
 #include <QKeyEvent>
@@ -37,9 +38,66 @@ Q_DECLARE_METATYPE(QList<QIcon>)
 namespace Core
 {
 
+// Everything but values of editable fields must be the same for update
+static bool isSameLayout(const DataItem &a, const DataItem &b)
+{
+	if (a.name() != b.name()
+			|| a.title() != b.title()
+			|| a.isReadOnly() != b.isReadOnly()
+			|| a.isAllowedModifySubitems()
+			|| b.isAllowedModifySubitems()
+			|| a.data().userType() != b.data().userType()
+			|| a.dataChangedReceiver() != b.dataChangedReceiver()
+			|| qstrcmp(a.dataChangedMethod(), b.dataChangedMethod()) != 0) {
+		return false;
+	}
+
+	const QList<QByteArray> names = a.dynamicPropertyNames();
+	if (names != b.dynamicPropertyNames())
+		return false;
+	foreach (const QByteArray &name, names) {
+		if (a.property(name.constData()) != b.property(name.constData()))
+			return false;
+	}
+
+	const QList<DataItem> first = a.subitems();
+	const QList<DataItem> second = b.subitems();
+	if (first.size() != second.size())
+		return false;
+	for (int i = 0; i < first.size(); ++i) {
+		if (!isSameLayout(first.at(i), second.at(i)))
+			return false;
+	}
+	return true;
+}
+
+static bool collectValues(const DataItem &a, const DataItem &b, QList<QPair<QString, QVariant> > &values)
+{
+	if (b.hasSubitems()) {
+		const QList<DataItem> first = a.subitems();
+		const QList<DataItem> second = b.subitems();
+		for (int i = 0; i < second.size(); ++i) {
+			if (!collectValues(first.at(i), second.at(i), values))
+				return false;
+		}
+		return true;
+	}
+
+	QVariant data = b.data();
+	const bool isList = data.type() == QVariant::StringList || data.canConvert<LocalizedStringList>();
+	if (b.isReadOnly() || b.name().isEmpty() || isList)
+		return a.data() == data;
+	if (data.canConvert<LocalizedString>())
+		data = data.value<LocalizedString>().toString();
+	values << qMakePair(b.name(), data);
+	return true;
+}
+
 DefaultDataForm::DefaultDataForm(const DataItem &item) :
 	m_widget(0),
+	m_source(item),
 	m_isChanged(false),
+	m_updating(false),
 	m_incompleteWidgets(0),
 	m_buttonsBox(0),
 	m_hasSubitems(item.hasSubitems() || item.isAllowedModifySubitems())
@@ -109,10 +167,42 @@ void DefaultDataForm::setData(const QString &name, const QVariant &data)
 {
 	foreach (AbstractDataWidget *widget, m_widgets.values(name))
 		widget->setData(data);
+	foreach (const QPointer<DataGroup> &group, m_lazyGroups) {
+		if (group)
+			group->setPendingData(name, data);
+	}
+}
+
+bool DefaultDataForm::update(const DataItem &item)
+{
+	// Values entered by user are overwritten too, so every editable field
+	// is set and only untouchable ones are checked for changes
+	QList<QPair<QString, QVariant> > values;
+	if (!isSameLayout(m_source, item) || !collectValues(m_source, item, values))
+		return false;
+
+	m_updating = true;
+	for (int i = 0; i < values.size(); ++i)
+		setData(values.at(i).first, values.at(i).second);
+	m_updating = false;
+	m_source = item;
+	return true;
+}
+
+void DefaultDataForm::virtual_hook(int id, void *data)
+{
+	if (id == UpdateItemHook) {
+		UpdateItemArgument *argument = reinterpret_cast<UpdateItemArgument*>(data);
+		argument->updated = update(argument->item);
+	} else {
+		AbstractDataForm::virtual_hook(id, data);
+	}
 }
 
 void DefaultDataForm::dataChanged()
 {
+	if (m_updating)
+		return;
 	if (!m_isChanged) {
 		emit changed();
 		m_isChanged = true;
@@ -26,6 +26,7 @@
 #define DATAFORMSBACKEND_H
 
 #include <qutim/dataforms.h>
+#include <QPointer>
 #include "abstractdatawidget.h"
 
 class QAbstractButton;
@@ -36,6 +37,8 @@ namespace Core
 
 using namespace qutim_sdk_0_3;
 
+class DataGroup;
+
 class DefaultDataForm : public AbstractDataForm
 {
 	Q_OBJECT
@@ -50,12 +53,22 @@ public:
 	{
 		m_widgets.insert(name, widget);
 	}
+	inline void addLazyGroup(DataGroup *group)
+	{
+		m_lazyGroups << group;
+	}
 public slots:
 	void dataChanged();
 	void completeChanged(bool complete);
+protected:
+	virtual void virtual_hook(int id, void *data);
 private:
+	bool update(const DataItem &item);
 	AbstractDataWidget *m_widget;
+	DataItem m_source;
 	bool m_isChanged;
+	bool m_updating;
+	QList<QPointer<DataGroup> > m_lazyGroups;
 	int m_incompleteWidgets;
 	QMultiHash<QString, AbstractDataWidget*> m_widgets;
 	QDialogButtonBox *m_buttonsBox;
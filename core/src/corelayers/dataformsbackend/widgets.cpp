@@ -341,6 +341,11 @@ DataItem TextEdit::item() const
 	return item;
 }
 
+void TextEdit::setData(const QVariant &data)
+{
+	setText(data.toString());
+}
+
 inline QVariant TextEdit::data() const
 {
 	QString val = toPlainText();
@@ -720,13 +725,70 @@ DataItem ModifiableGroup::item() const
 	return item;
 }
 
+static bool canBuildLazily(const DataItem &item)
+{
+	// Incomplete fields must be known by the form from the very beginning
+	foreach (const DataItem &subitem, item.subitems()) {
+		if (subitem.property("mandatory", false)
+				|| !subitem.property("validator").isNull()
+				|| !subitem.property("titleValidator").isNull()
+				|| !canBuildLazily(subitem)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool setSubitemData(DataItem &item, const QString &name, const QVariant &data)
+{
+	bool found = false;
+	QList<DataItem> subitems = item.subitems();
+	for (int i = 0; i < subitems.size(); ++i) {
+		DataItem &subitem = subitems[i];
+		if (subitem.name() == name) {
+			subitem.setData(data);
+			found = true;
+		}
+		if (subitem.hasSubitems())
+			found = setSubitemData(subitem, name, data) || found;
+	}
+	if (found)
+		item.setSubitems(subitems);
+	return found;
+}
+
 DataGroup::DataGroup(DefaultDataForm *dataForm, const DataItem &items, QWidget *parent) :
-	QGroupBox(parent), AbstractDataWidget(items, dataForm)
+	QGroupBox(parent), AbstractDataWidget(items, dataForm), m_layout(0)
 {
 	if (!items.property("hideTitle", false))
 		setTitle(items.title());
 	setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
-	m_layout = new DataLayout(items, dataForm, items.property<quint16>("columns", 1), this);
+	m_pending = items;
+	if (canBuildLazily(items))
+		dataForm->addLazyGroup(this);
+	else
+		ensureBuilt();
+}
+
+DataItem DataGroup::item() const
+{
+	if (!m_layout) {
+		DataItem item = m_pending;
+		item.setName(objectName());
+		return item;
+	}
+	DataItem item = m_layout->item();
+	item.setName(objectName());
+	return item;
+}
+
+void DataGroup::ensureBuilt()
+{
+	if (m_layout)
+		return;
+	const DataItem items = m_pending;
+	m_pending = DataItem();
+	m_layout = new DataLayout(items, dataForm(), items.property<quint16>("columns", 1), this);
 	m_layout->addDataItems(items.subitems());
 
 	QVariant spacing = items.property("horizontalSpacing");
@@ -737,11 +799,15 @@ DataGroup::DataGroup(DefaultDataForm *dataForm, const DataItem &items, QWidget *
 		m_layout->setVerticalSpacing(spacing.toInt());
 }
 
-DataItem DataGroup::item() const
+bool DataGroup::setPendingData(const QString &name, const QVariant &data)
 {
-	DataItem item = m_layout->item();
-	item.setName(objectName());
-	return item;
+	return !m_layout && setSubitemData(m_pending, name, data);
+}
+
+void DataGroup::showEvent(QShowEvent *event)
+{
+	ensureBuilt();
+	QGroupBox::showEvent(event);
 }
 
 StringListGroup::StringListGroup(DefaultDataForm *dataForm, const DataItem &item, QWidget *parent) :
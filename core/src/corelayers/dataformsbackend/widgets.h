@@ -128,6 +128,7 @@ class TextEdit : public QTextEdit, public AbstractDataWidget
 public:
 	TextEdit(DefaultDataForm *dataForm, const DataItem &item, QWidget *parent = 0);
 	virtual DataItem item() const;
+	virtual void setData(const QVariant &data);
 	QVariant data() const;
 signals:
 	void changed(const QString &name, const QVariant &data, qutim_sdk_0_3::AbstractDataForm *dataForm);
@@ -245,8 +246,14 @@ class DataGroup : public QGroupBox, public AbstractDataWidget
 public:
 	DataGroup(DefaultDataForm *dataForm, const DataItem &item, QWidget *parent = 0);
 	DataItem item() const;
+	// Groups without mandatory or validated fields are filled on first show
+	void ensureBuilt();
+	bool setPendingData(const QString &name, const QVariant &data);
+protected:
+	void showEvent(QShowEvent *event);
 private:
 	DataLayout *m_layout;
+	DataItem m_pending;
 };
 
 class StringListGroup : public ModifiableWidget
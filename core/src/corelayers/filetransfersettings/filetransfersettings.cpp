@@ -31,12 +31,26 @@
 #include <qutim/icon.h>
 #include <QListWidget>
 #include <QVBoxLayout>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QLabel>
+#include <QTimer>
 #include <qutim/itemdelegate.h>
 
 namespace Core {
 
 const int FactoryClassNameRole = Qt::UserRole + 123;
 
+static QSpinBox *createLimitBox(QWidget *parent)
+{
+	QSpinBox *box = new QSpinBox(parent);
+	box->setRange(0, 1024 * 1024);
+	box->setSingleStep(16);
+	box->setSuffix(QCoreApplication::translate("FileTransferSettingsWidget", " KiB/s"));
+	box->setSpecialValueText(QCoreApplication::translate("FileTransferSettingsWidget", "Unlimited"));
+	return box;
+}
+
 FileTransferSettingsWidget::FileTransferSettingsWidget() :
 	m_changed(false)
 {
@@ -52,6 +66,27 @@ FileTransferSettingsWidget::FileTransferSettingsWidget() :
 	connect(m_factoriesWidget->model(),
 			SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)),
 			SLOT(onChanged()));
+
+	QFormLayout *limitsLayout = new QFormLayout();
+	m_uploadLimit = createLimitBox(this);
+	limitsLayout->addRow(tr("Upload limit:"), m_uploadLimit);
+	m_accountUploadLimit = createLimitBox(this);
+	limitsLayout->addRow(tr("Upload limit per account:"), m_accountUploadLimit);
+	m_maxActiveUploads = new QSpinBox(this);
+	m_maxActiveUploads->setRange(0, 64);
+	m_maxActiveUploads->setSpecialValueText(tr("Unlimited"));
+	limitsLayout->addRow(tr("Simultaneous uploads:"), m_maxActiveUploads);
+	m_statistics = new QLabel(this);
+	limitsLayout->addRow(tr("Current traffic:"), m_statistics);
+	layout->addLayout(limitsLayout);
+	foreach (QSpinBox *box, QList<QSpinBox*>() << m_uploadLimit << m_accountUploadLimit << m_maxActiveUploads)
+		connect(box, SIGNAL(valueChanged(int)), SLOT(onChanged()));
+
+	m_statisticsTimer = new QTimer(this);
+	m_statisticsTimer->setInterval(1000);
+	connect(m_statisticsTimer, SIGNAL(timeout()), SLOT(updateStatistics()));
+	m_statisticsTimer->start();
+	updateStatistics();
 }
 
 void FileTransferSettingsWidget::clearState()
@@ -71,6 +106,11 @@ void FileTransferSettingsWidget::loadImpl()
 		item->setData(DescriptionRole, qVariantFromValue(factory->description()));
 		item->setData(FactoryClassNameRole, factory->metaObject()->className());
 	}
+	Config cfg = Config().group(QStringLiteral("filetransfer"));
+	m_uploadLimit->setValue(cfg.value(QStringLiteral("uploadLimit"), 0));
+	m_accountUploadLimit->setValue(cfg.value(QStringLiteral("accountUploadLimit"), 0));
+	m_maxActiveUploads->setValue(cfg.value(QStringLiteral("maxActiveUploads"), 3));
+	clearState();
 }
 
 void FileTransferSettingsWidget::saveImpl()
@@ -84,6 +124,13 @@ void FileTransferSettingsWidget::saveImpl()
 	}
 
 	FileTransferManager::updateFactories(factories);
+
+	Config cfg = Config().group(QStringLiteral("filetransfer"));
+	cfg.setValue(QStringLiteral("uploadLimit"), m_uploadLimit->value());
+	cfg.setValue(QStringLiteral("accountUploadLimit"), m_accountUploadLimit->value());
+	cfg.setValue(QStringLiteral("maxActiveUploads"), m_maxActiveUploads->value());
+	cfg.sync();
+	FileTransferManager::reloadLimits();
 	clearState();
 }
 
@@ -100,6 +147,16 @@ void FileTransferSettingsWidget::onChanged()
 	}
 }
 
+void FileTransferSettingsWidget::updateStatistics()
+{
+	const FileTransferManager::Statistics stats = FileTransferManager::statistics();
+	m_statistics->setText(tr("%1 KiB/s up, %2 KiB/s down, %n active", 0, stats.activeTransfers)
+						  .arg(stats.uploadRate / 1024).arg(stats.downloadRate / 1024)
+						  + (stats.queuedTransfers
+							 ? tr(", %n queued", 0, stats.queuedTransfers)
+							 : QString()));
+}
+
 FileTransferSettings::FileTransferSettings()
 {
 	GeneralSettingsItem<FileTransferSettingsWidget> *item =
@@ -30,6 +30,9 @@
 #include <qutim/startupmodule.h>
 
 class QListWidget;
+class QSpinBox;
+class QLabel;
+class QTimer;
 
 namespace Core {
 
@@ -47,8 +50,14 @@ protected:
 	virtual void cancelImpl();
 private slots:
 	void onChanged();
+	void updateStatistics();
 private:
 	QListWidget *m_factoriesWidget;
+	QSpinBox *m_uploadLimit;
+	QSpinBox *m_accountUploadLimit;
+	QSpinBox *m_maxActiveUploads;
+	QLabel *m_statistics;
+	QTimer *m_statisticsTimer;
 	bool m_changed;
 };
 
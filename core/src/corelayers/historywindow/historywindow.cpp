@@ -42,6 +42,7 @@
 
 namespace Core
 {
+enum { ChunkSize = 100 };
 
 static inline History *history()
 {
@@ -65,6 +66,7 @@ static inline ChatUnit *findContact(const History::ContactInfo &info)
 }
 
 HistoryWindow::HistoryWindow(const ChatUnit *unit)
+    : m_streamGeneration(0), m_inCount(0), m_outCount(0), m_fetching(false), m_streamFinished(false)
 {
 	ui.setupUi(this);
 	
@@ -91,6 +93,7 @@ HistoryWindow::HistoryWindow(const ChatUnit *unit)
     m_unitInfo = unit ? History::info(unit) : History::ContactInfo();
 
     connect(ui.dateTreeWidget, &QTreeWidget::itemExpanded, this, &HistoryWindow::fillMonth);
+    connect(ui.historyLog->verticalScrollBar(), &QScrollBar::valueChanged, this, &HistoryWindow::onScrolled);
 
     fillAccountComboBox();
 
@@ -197,6 +200,7 @@ void HistoryWindow::fillDateTreeWidget(int index)
     if (ui.fromComboBox->count() == 0)
         return;
     auto contactInfo = ui.fromComboBox->itemData(index).value<History::ContactInfo>();
+    resetStream();
     ui.dateTreeWidget->clear();
 
     setWindowTitle(QStringLiteral("%1 (%2)").arg(ui.fromComboBox->currentText(), ui.accountComboBox->currentText()));
@@ -288,86 +292,136 @@ void HistoryWindow::on_dateTreeWidget_currentItemChanged(QTreeWidgetItem *dayIte
         return;
 
     auto contactIndex = ui.fromComboBox->currentIndex();
-    auto contactInfo = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
     auto date = dayItem->data(0, Qt::UserRole).toDate();
     QDateTime from(date, QTime(0, 0));
     QDateTime to(date, QTime(23, 59, 59, 999));
-    int count = std::numeric_limits<int>::max();
 
-    history()->read(contactInfo, from, to, count).connect(this, [this, contactInfo, date] (const MessageList &messages) {
-        int contactIndex = ui.fromComboBox->currentIndex();
-        auto currentContactInfo = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
-        if (!(currentContactInfo == contactInfo))
+    // Day is read from its end by chunks, older ones are fetched only when
+    // user scrolls up to them
+    resetStream();
+    m_streamContact = ui.fromComboBox->itemData(contactIndex).value<History::ContactInfo>();
+    m_stream = history()->readStream(m_streamContact, from, to);
+    fetchChunk();
+}
+
+void HistoryWindow::resetStream()
+{
+    ++m_streamGeneration;
+    m_stream.clear();
+    m_fetching = false;
+    m_streamFinished = false;
+    m_inCount = 0;
+    m_outCount = 0;
+}
+
+void HistoryWindow::fetchChunk()
+{
+    if (!m_stream || m_fetching || m_streamFinished)
+        return;
+    m_fetching = true;
+
+    const int generation = m_streamGeneration;
+    const bool first = m_inCount + m_outCount == 0;
+    m_stream->fetch(ChunkSize).connect(this, [this, generation, first] (const MessageList &messages) {
+        if (generation != m_streamGeneration)
             return;
+        if (messages.size() < ChunkSize)
+            m_streamFinished = true;
+        if (first || !messages.isEmpty())
+            insertMessages(messages, first);
+        m_fetching = false;
+        // Short chunk may not fill the viewport, so there is nothing to scroll
+        if (ui.historyLog->verticalScrollBar()->maximum() == 0)
+            fetchChunk();
+    });
+}
 
-        QTextDocument *doc = ui.historyLog->document();
+void HistoryWindow::onScrolled(int value)
+{
+    QScrollBar *scrollBar = ui.historyLog->verticalScrollBar();
+    if (value <= scrollBar->pageStep() / 2)
+        fetchChunk();
+}
+
+void HistoryWindow::insertMessages(const MessageList &messages, bool first)
+{
+    QTextDocument *doc = ui.historyLog->document();
+    QScrollBar *scrollBar = ui.historyLog->verticalScrollBar();
+    const int distanceFromBottom = scrollBar->maximum() - scrollBar->value();
+    if (first) {
         doc->setParent(0);
         ui.historyLog->setDocument(0);
         doc->clear();
-        QTextCursor cursor = QTextCursor(doc);
-        QTextCharFormat defaultFont = cursor.charFormat();
-        QTextCharFormat serviceFont = cursor.charFormat();
-        serviceFont.setForeground(Qt::darkGreen);
-        serviceFont.setFontWeight(QFont::Bold);
-        QTextCharFormat incomingFont = cursor.charFormat();
-        incomingFont.setForeground(Qt::red);
-        incomingFont.setFontWeight(QFont::Bold);
-        QTextCharFormat outgoingFont = cursor.charFormat();
-        outgoingFont.setForeground(Qt::blue);
-        outgoingFont.setFontWeight(QFont::Bold);
-        const QString serviceMessageTitle = tr("Service message");
-        const QString resultString = QStringLiteral("<span style='background: #ffff00'>\\1</span>");
-        cursor.beginEditBlock();
-
-        Account *account = findAccount(contactInfo);
-        ChatUnit *unit = findContact(contactInfo);
-
-        QString accountNickname = account ? account->name() : contactInfo.account;
-        QString fromNickname = unit ? unit->title() : contactInfo.contact;
-        int in_count = 0;
-        int out_count = 0;
-
-        for (const Message &message : messages) {
-            bool service = message.property("service", false);
-            QDateTime time = message.time();
-            bool incoming = message.isIncoming();
-            QString historyMessage = message.html();
-            QString sender = message.property("senderName", incoming ? fromNickname : accountNickname);
-
-            incoming ? in_count++ : out_count++;
-            if (service) {
-                cursor.setCharFormat(serviceFont);
-                cursor.insertText(serviceMessageTitle);
-            } else {
-                cursor.setCharFormat(incoming ? incomingFont : outgoingFont);
-                cursor.insertText(sender);
-            }
-            cursor.insertText(QStringLiteral(" (")
-                              % time.toString(QStringLiteral("dd.MM.yyyy hh:mm:ss"))
-                              % QStringLiteral(")"));
-            cursor.setCharFormat(defaultFont);
+    }
+
+    // Older chunks are inserted before already shown ones
+    QTextCursor cursor = QTextCursor(doc);
+    QTextCharFormat defaultFont = cursor.charFormat();
+    QTextCharFormat serviceFont = cursor.charFormat();
+    serviceFont.setForeground(Qt::darkGreen);
+    serviceFont.setFontWeight(QFont::Bold);
+    QTextCharFormat incomingFont = cursor.charFormat();
+    incomingFont.setForeground(Qt::red);
+    incomingFont.setFontWeight(QFont::Bold);
+    QTextCharFormat outgoingFont = cursor.charFormat();
+    outgoingFont.setForeground(Qt::blue);
+    outgoingFont.setFontWeight(QFont::Bold);
+    const QString serviceMessageTitle = tr("Service message");
+    const QString resultString = QStringLiteral("<span style='background: #ffff00'>\\1</span>");
+    cursor.beginEditBlock();
+
+    Account *account = findAccount(m_streamContact);
+    ChatUnit *unit = findContact(m_streamContact);
+
+    QString accountNickname = account ? account->name() : m_streamContact.account;
+    QString fromNickname = unit ? unit->title() : m_streamContact.contact;
+
+    for (const Message &message : messages) {
+        bool service = message.property("service", false);
+        QDateTime time = message.time();
+        bool incoming = message.isIncoming();
+        QString historyMessage = message.html();
+        QString sender = message.property("senderName", incoming ? fromNickname : accountNickname);
+
+        incoming ? m_inCount++ : m_outCount++;
+        if (service) {
+            cursor.setCharFormat(serviceFont);
+            cursor.insertText(serviceMessageTitle);
+        } else {
+            cursor.setCharFormat(incoming ? incomingFont : outgoingFont);
+            cursor.insertText(sender);
+        }
+        cursor.insertText(QStringLiteral(" (")
+                          % time.toString(QStringLiteral("dd.MM.yyyy hh:mm:ss"))
+                          % QStringLiteral(")"));
+        cursor.setCharFormat(defaultFont);
+        cursor.insertText(QStringLiteral("\n"));
+        if (m_search_word.isEmpty()) {
+            cursor.insertHtml(historyMessage);
+            cursor.insertText(QStringLiteral("\n"));
+        } else {
+            cursor.insertHtml(historyMessage.replace(m_search, resultString));
             cursor.insertText(QStringLiteral("\n"));
-            if (m_search_word.isEmpty()) {
-                cursor.insertHtml(historyMessage);
-                cursor.insertText(QStringLiteral("\n"));
-            } else {
-                cursor.insertHtml(historyMessage.replace(m_search, resultString));
-                cursor.insertText(QStringLiteral("\n"));
-            }
         }
-        cursor.endEditBlock();
+    }
+    cursor.endEditBlock();
+
+    if (first) {
         doc->setParent(ui.historyLog);
         ui.historyLog->setDocument(doc);
         if (m_search_word.isEmpty())
             ui.historyLog->moveCursor(QTextCursor::End);
         else
             ui.historyLog->find(m_search_word);
-        ui.historyLog->verticalScrollBar()->setValue(ui.historyLog->verticalScrollBar()->maximum());
+        scrollBar->setValue(scrollBar->maximum());
+    } else {
+        // Keep viewport at the same messages
+        scrollBar->setValue(scrollBar->maximum() - distanceFromBottom);
+    }
 
-        ui.label_in->setText(tr("In: %L1").arg(in_count));
-        ui.label_out->setText(tr("Out: %L1").arg(out_count));
-        ui.label_all->setText(tr("All: %L1").arg(in_count + out_count));
-    });
+    ui.label_in->setText(tr("In: %L1").arg(m_inCount));
+    ui.label_out->setText(tr("Out: %L1").arg(m_outCount));
+    ui.label_all->setText(tr("All: %L1").arg(m_inCount + m_outCount));
 }
 
 void HistoryWindow::on_searchButton_clicked()
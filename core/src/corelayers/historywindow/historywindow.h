@@ -55,15 +55,27 @@ private slots:
 	void on_dateTreeWidget_currentItemChanged( QTreeWidgetItem* current, QTreeWidgetItem* previous );
 	void on_searchButton_clicked();
 	void findPrevious();
+    void onScrolled(int value);
     
 private:
 	void fillAccountComboBox();
 	void setIcons();
+    // Drops current stream, results of its in-flight fetches are ignored
+    void resetStream();
+    void fetchChunk();
+    void insertMessages(const MessageList &messages, bool first);
     Ui::HistoryWindowClass ui;
     QMetaObject::Connection m_contactConnection;
     History::ContactInfo m_unitInfo;
     QRegularExpression m_search;
 	QString m_search_word;
+    History::StreamPtr m_stream;
+    History::ContactInfo m_streamContact;
+    int m_streamGeneration;
+    int m_inCount;
+    int m_outCount;
+    bool m_fetching;
+    bool m_streamFinished;
 };
 
 }
@@ -2,7 +2,7 @@
 **
 ** qutIM - instant messenger
 **
-** Copyright © 2011 Alexander Kazarin <boiler@co.ru>
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
 **
 *****************************************************************************
 **
@@ -23,31 +23,32 @@
 **
 ****************************************************************************/
 
-#ifndef SQLHISTORY_H
-#define SQLHISTORY_H
+#ifndef HISTORYWINDOWMODULE_H
+#define HISTORYWINDOWMODULE_H
 
-#include "sqlengine.h"
+#include <qutim/chatunit.h>
+#include <QPointer>
 
-using namespace qutim_sdk_0_2;
+namespace Core
+{
+class HistoryWindow;
 
-class SqlHistory : public QObject, public LayerPluginInterface {
+// Window is shared by all history backends, History::showHistory opens it
+class HistoryWindowModule : public QObject
+{
 	Q_OBJECT
-	Q_DISABLE_COPY(SqlHistory)
-	Q_INTERFACES(qutim_sdk_0_2::PluginInterface qutim_sdk_0_2::LayerPluginInterface)
+	Q_CLASSINFO("Service", "HistoryWindow")
+	Q_CLASSINFO("Uses", "IconLoader")
 public:
-	SqlHistory(QObject *parent = 0);
-	virtual bool init(PluginSystemInterface *plugin_system);
-	virtual void release();
-	virtual QString name();
-	virtual QString description();
-	virtual QIcon *icon();
-	virtual void setProfileName(const QString &profile_name);
+	HistoryWindowModule();
+	virtual ~HistoryWindowModule();
+
 public slots:
-	void itemAdded(const TreeModelItem &item, const QString &name);
+	void showHistory(const qutim_sdk_0_3::ChatUnit *unit);
+
 private:
-	SqlHistoryNamespace::SqlEngine *m_engine;
-	QIcon *m_icon;
+	QPointer<HistoryWindow> m_window;
 };
+}
 
-#endif // SQLHISTORY_H
-
+#endif // HISTORYWINDOWMODULE_H
@@ -28,19 +28,23 @@
 #include <QCursor>
 #include <QDateTime>
 #include <QTimer>
+#include <QMetaMethod>
+#include <algorithm>
 
 namespace Psi
 {
 static IdlePlatform *platform = 0;
 static int platform_ref = 0;
 
-
+// While user is away and platform can't tell about input, check it that often
+enum { ResumeInterval = 2000 };
 
 Idle::Idle()
 {
     d = new Private;
     d->active = false;
     d->idleTime = 0;
+    d->lastLevel = 0;
 
     // try to use platform idle
     if(!platform) {
@@ -50,9 +54,12 @@ Idle::Idle()
         else
             delete p;
     }
-    if(platform)
+    if(platform) {
         ++platform_ref;
+        connect(platform, SIGNAL(alarm()), SLOT(doCheck()));
+    }
 
+    d->checkTimer.setSingleShot(true);
     connect(&d->checkTimer, SIGNAL(timeout()), SLOT(doCheck()));
     start();
 }
@@ -60,6 +67,7 @@ Idle::Idle()
 Idle::~Idle()
 {
     if(platform) {
+        disconnect(platform, 0, this, 0);
         --platform_ref;
         if(platform_ref == 0) {
             delete platform;
@@ -89,13 +97,17 @@ void Idle::start()
         d->idleSince = QDateTime::currentDateTime();
     }
 
-    // poll every second (use a lower value if you need more accuracy)
-    d->checkTimer.start(1000);
+    d->active = true;
+    d->lastLevel = 0;
+    schedule(0);
 }
 
 void Idle::stop()
 {
+    d->active = false;
     d->checkTimer.stop();
+    if (platform && platform->hasAlarms())
+        platform->setAlarms(-1, false);
 }
 
 int Idle::secondsIdle()
@@ -134,9 +146,110 @@ int Idle::secondsIdle()
     return idleTime;
 }
 
+void Idle::setThresholds(QObject *watcher, const QList<int> &seconds)
+{
+    if (seconds.isEmpty()) {
+        d->watchers.remove(watcher);
+    } else {
+        d->watchers.insert(watcher, seconds);
+        connect(watcher, SIGNAL(destroyed(QObject*)), SLOT(onWatcherDestroyed(QObject*)),
+                Qt::UniqueConnection);
+    }
+
+    d->thresholds.clear();
+    foreach (const QList<int> &list, d->watchers) {
+        foreach (int secs, list) {
+            if (!d->thresholds.contains(secs))
+                d->thresholds << secs;
+        }
+    }
+    std::sort(d->thresholds.begin(), d->thresholds.end());
+    QMetaObject::invokeMethod(this, "doCheck", Qt::QueuedConnection);
+}
+
+void Idle::connectNotify(const QMetaMethod &signal)
+{
+    // New receiver may need per second updates
+    if (signal == QMetaMethod::fromSignal(static_cast<void (Idle::*)(int)>(&Idle::secondsIdle)))
+        QMetaObject::invokeMethod(this, "doCheck", Qt::QueuedConnection);
+}
+
+void Idle::disconnectNotify(const QMetaMethod &signal)
+{
+    connectNotify(signal);
+}
+
 void Idle::doCheck()
 {
-    secondsIdle(secondsIdle());
+    if (!d->active)
+        return;
+    const int secs = secondsIdle();
+    const int current = level(secs);
+    if (current != d->lastLevel || isPolling()) {
+        d->lastLevel = current;
+        secondsIdle(secs);
+    }
+    schedule(secs);
 }
+
+void Idle::onWatcherDestroyed(QObject *watcher)
+{
+    setThresholds(watcher, QList<int>());
 }
 
+void Idle::schedule(int secs)
+{
+    if (!d->active)
+        return;
+
+    if (isPolling()) {
+        if (platform && platform->hasAlarms())
+            platform->setAlarms(-1, false);
+        // poll every second (use a lower value if you need more accuracy)
+        d->checkTimer.start(1000);
+        return;
+    }
+
+    // Threshold is crossed once idle time is greater than it
+    int next = -1;
+    foreach (int threshold, d->thresholds) {
+        if (threshold >= secs) {
+            next = threshold + 1;
+            break;
+        }
+    }
+    const bool away = d->lastLevel > 0;
+
+    if (platform->hasAlarms()) {
+        d->checkTimer.stop();
+        // Alarms use platform idle time, which may be ahead of ours after start()
+        const int offset = qMax(0, platform->secondsIdle() - secs);
+        platform->setAlarms(next < 0 ? -1 : (next + offset) * 1000, away);
+        return;
+    }
+
+    int interval = next < 0 ? -1 : (next - secs) * 1000;
+    if (away && (interval < 0 || interval > ResumeInterval))
+        interval = ResumeInterval;
+    if (interval < 0)
+        d->checkTimer.stop();
+    else
+        d->checkTimer.start(interval);
+}
+
+int Idle::level(int secs) const
+{
+    int result = 0;
+    while (result < d->thresholds.size() && secs > d->thresholds.at(result))
+        ++result;
+    return result;
+}
+
+bool Idle::isPolling() const
+{
+    // Generic idle watches mouse position, so it can't sleep
+    if (!platform)
+        return true;
+    return receivers(SIGNAL(secondsIdle(int))) > d->watchers.size();
+}
+}
@@ -30,6 +30,7 @@
 #include <QCursor>
 #include <QDateTime>
 #include <QTimer>
+#include <QHash>
 
 namespace Psi
 {
@@ -49,19 +50,34 @@ public:
     void stop();
     int secondsIdle();
 
+    // Idle time is checked only around thresholds of watchers, secondsIdle(int)
+    // is emitted once idle time exceeds one of them and once user is back.
+    // Connected receivers which are not watchers get it every second.
+    Q_INVOKABLE void setThresholds(QObject *watcher, const QList<int> &seconds);
+
 signals:
     void secondsIdle(int);
 
+protected:
+    void connectNotify(const QMetaMethod &signal);
+    void disconnectNotify(const QMetaMethod &signal);
+
 private slots:
     void doCheck();
+    void onWatcherDestroyed(QObject *watcher);
 
 private:
+    void schedule(int secs);
+    int level(int secs) const;
+    bool isPolling() const;
+
     class Private;
     Private *d;
 };
 
-class IdlePlatform
+class IdlePlatform : public QObject
 {
+    Q_OBJECT
 public:
     IdlePlatform();
     ~IdlePlatform();
@@ -69,6 +85,14 @@ public:
     bool init();
     int secondsIdle();
 
+    // Platforms with idle alarms emit alarm() once idle time reaches msecs
+    // (negative means never) or, if watchActivity is set, on user input
+    bool hasAlarms() const;
+    void setAlarms(int msecs, bool watchActivity);
+
+signals:
+    void alarm();
+
 private:
     class Private;
     Private *d;
@@ -84,8 +108,12 @@ public:
 
     bool active;
     int idleTime;
+    int lastLevel;
     QDateTime startTime;
     QTimer checkTimer;
+    QHash<QObject*, QList<int> > watchers;
+    // Sorted thresholds of all watchers
+    QList<int> thresholds;
 };
 }
 
@@ -166,6 +166,13 @@ bool IdlePlatform::init() {
 int IdlePlatform::secondsIdle() {
     return d->mSecondsIdle;
 }
+
+bool IdlePlatform::hasAlarms() const {
+    return false;
+}
+
+void IdlePlatform::setAlarms(int, bool) {
+}
 }
 
 #endif
@@ -110,6 +110,16 @@ int IdlePlatform::secondsIdle()
 
     return (GetTickCount() - i) / 1000;
 }
+
+bool IdlePlatform::hasAlarms() const
+{
+    // Idle checks are scheduled around thresholds by Idle instead
+    return false;
+}
+
+void IdlePlatform::setAlarms(int, bool)
+{
+}
 }
 
 #endif
@@ -27,33 +27,167 @@
 #if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
 
 #include <QApplication>
+#include <QAbstractNativeEventFilter>
 #include <QDesktopWidget>
 #include <xcb/xcb.h>
 #include <xcb/screensaver.h>
+#include <xcb/sync.h>
 #include <QtX11Extras/QX11Info>
 
 namespace Psi {
-static xcb_screen_t * screen;
+
+// IDLETIME counter of XSync is used to get alarms instead of polling
+class IdlePlatform::Private : public QAbstractNativeEventFilter
+{
+public:
+    Private(IdlePlatform *q)
+        : q(q), connection(0), root(XCB_NONE), counter(XCB_NONE), syncEvent(0),
+          idleAlarm(XCB_NONE), resetAlarm(XCB_NONE)
+    {
+    }
+
+    bool initSync();
+    xcb_sync_alarm_t createAlarm();
+    void changeAlarm(xcb_sync_alarm_t alarm, uint32_t testType, qint64 value, bool enabled);
+    qint64 counterValue();
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *result) override;
+
+    IdlePlatform *q;
+    xcb_connection_t *connection;
+    xcb_window_t root;
+    xcb_sync_counter_t counter;
+    uint8_t syncEvent;
+    xcb_sync_alarm_t idleAlarm;
+    xcb_sync_alarm_t resetAlarm;
+};
+
+bool IdlePlatform::Private::initSync()
+{
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(connection, &xcb_sync_id);
+    if (!extension || !extension->present)
+        return false;
+    syncEvent = extension->first_event;
+
+    xcb_sync_initialize_reply_t *version = xcb_sync_initialize_reply(connection,
+            xcb_sync_initialize(connection, XCB_SYNC_MAJOR_VERSION, XCB_SYNC_MINOR_VERSION), NULL);
+    if (!version)
+        return false;
+    free(version);
+
+    xcb_sync_list_system_counters_reply_t *counters = xcb_sync_list_system_counters_reply(connection,
+            xcb_sync_list_system_counters(connection), NULL);
+    if (!counters)
+        return false;
+    xcb_sync_systemcounter_iterator_t it = xcb_sync_list_system_counters_counters_iterator(counters);
+    for (; it.rem; xcb_sync_systemcounter_next(&it)) {
+        const QByteArray name(xcb_sync_systemcounter_name(it.data), it.data->name_len);
+        if (name == "IDLETIME") {
+            counter = it.data->counter;
+            break;
+        }
+    }
+    free(counters);
+    if (counter == XCB_NONE)
+        return false;
+
+    idleAlarm = createAlarm();
+    resetAlarm = createAlarm();
+    qApp->installNativeEventFilter(this);
+    return true;
+}
+
+xcb_sync_alarm_t IdlePlatform::Private::createAlarm()
+{
+    xcb_sync_alarm_t alarm = xcb_generate_id(connection);
+    xcb_sync_create_alarm_value_list_t values;
+    values.counter = counter;
+    values.valueType = XCB_SYNC_VALUETYPE_ABSOLUTE;
+    values.value.hi = 0;
+    values.value.lo = 0;
+    values.testType = XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON;
+    values.delta.hi = 0;
+    values.delta.lo = 0;
+    values.events = 0;
+    xcb_sync_create_alarm_aux(connection, alarm,
+                              XCB_SYNC_CA_COUNTER | XCB_SYNC_CA_VALUE_TYPE | XCB_SYNC_CA_VALUE
+                              | XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_DELTA | XCB_SYNC_CA_EVENTS,
+                              &values);
+    return alarm;
+}
+
+void IdlePlatform::Private::changeAlarm(xcb_sync_alarm_t alarm, uint32_t testType, qint64 value, bool enabled)
+{
+    xcb_sync_change_alarm_value_list_t values;
+    values.value.hi = int32_t(value >> 32);
+    values.value.lo = uint32_t(value);
+    values.testType = testType;
+    values.events = enabled;
+    xcb_sync_change_alarm_aux(connection, alarm,
+                              XCB_SYNC_CA_VALUE | XCB_SYNC_CA_TEST_TYPE | XCB_SYNC_CA_EVENTS,
+                              &values);
+}
+
+qint64 IdlePlatform::Private::counterValue()
+{
+    xcb_sync_query_counter_reply_t *reply = xcb_sync_query_counter_reply(connection,
+            xcb_sync_query_counter(connection, counter), NULL);
+    if (!reply)
+        return 0;
+    const qint64 value = (qint64(reply->counter_value.hi) << 32) | reply->counter_value.lo;
+    free(reply);
+    return value;
+}
+
+bool IdlePlatform::Private::nativeEventFilter(const QByteArray &eventType, void *message, long *result)
+{
+    Q_UNUSED(result);
+    if (eventType != "xcb_generic_event_t")
+        return false;
+    xcb_generic_event_t *event = static_cast<xcb_generic_event_t *>(message);
+    if ((event->response_type & ~0x80) != syncEvent + XCB_SYNC_ALARM_NOTIFY)
+        return false;
+    xcb_sync_alarm_notify_event_t *notify = reinterpret_cast<xcb_sync_alarm_notify_event_t *>(event);
+    if ((notify->alarm == idleAlarm || notify->alarm == resetAlarm)
+            && notify->state != XCB_SYNC_ALARMSTATE_DESTROYED) {
+        // Idle state is queried back, so don't do it inside of native event handling
+        QMetaObject::invokeMethod(q, "alarm", Qt::QueuedConnection);
+    }
+    return false;
+}
 
 IdlePlatform::IdlePlatform()
 {
-    screen = xcb_setup_roots_iterator (xcb_get_setup (QX11Info::connection())).data;
+    d = new Private(this);
 }
 
 IdlePlatform::~IdlePlatform()
 {
-
+    if (d->counter != XCB_NONE) {
+        qApp->removeNativeEventFilter(d);
+        xcb_sync_destroy_alarm(d->connection, d->idleAlarm);
+        xcb_sync_destroy_alarm(d->connection, d->resetAlarm);
+        xcb_flush(d->connection);
+    }
+    delete d;
 }
 
 bool IdlePlatform::init()
 {
+    if (!QX11Info::isPlatformX11())
+        return false;
+    d->connection = QX11Info::connection();
+    d->root = xcb_setup_roots_iterator(xcb_get_setup(d->connection)).data->root;
+    // Without XSync Idle polls us by timer
+    d->initSync();
     return true;
 }
 
 int IdlePlatform::secondsIdle()
 {
-    xcb_screensaver_query_info_cookie_t cookie = xcb_screensaver_query_info (QX11Info::connection(), screen->root);
-    xcb_screensaver_query_info_reply_t *info = xcb_screensaver_query_info_reply (QX11Info::connection(), cookie, NULL);
+    xcb_screensaver_query_info_cookie_t cookie = xcb_screensaver_query_info (d->connection, d->root);
+    xcb_screensaver_query_info_reply_t *info = xcb_screensaver_query_info_reply (d->connection, cookie, NULL);
+    if (!info)
+        return 0;
 
     uint idle = info->ms_since_user_input;
     free (info);
@@ -61,9 +195,22 @@ int IdlePlatform::secondsIdle()
     return idle/1000;
 }
 
-} // namespace Psi
-
-#endif
+bool IdlePlatform::hasAlarms() const
+{
+    return d->counter != XCB_NONE;
+}
 
+void IdlePlatform::setAlarms(int msecs, bool watchActivity)
+{
+    if (!hasAlarms())
+        return;
+    d->changeAlarm(d->idleAlarm, XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON, qMax(msecs, 0), msecs >= 0);
+    // Counter is reset by any input, so wait for it to go below current value
+    const qint64 current = watchActivity ? d->counterValue() : 0;
+    d->changeAlarm(d->resetAlarm, XCB_SYNC_TESTTYPE_NEGATIVE_COMPARISON, current - 1, current > 0);
+    xcb_flush(d->connection);
+}
 
+} // namespace Psi
 
+#endif
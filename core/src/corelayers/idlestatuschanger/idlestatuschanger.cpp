@@ -37,10 +37,10 @@ namespace Core
 IdleStatusChanger::IdleStatusChanger() :
 	m_awayStatus(Status::Away), m_naStatus(Status::NA)
 {
-	QObject *idle = ServiceManager::getByName("Idle");
-	reloadSettings();
 	m_state = Active;
+	QObject *idle = ServiceManager::getByName("Idle");
 	connect(idle, SIGNAL(secondsIdle(int)), this, SLOT(onIdle(int)));
+	reloadSettings();
 	SettingsItem *settings = new QmlSettingsItem(
                 QStringLiteral("idlestatuschanger"),
 				Settings::General,
@@ -107,6 +107,18 @@ void IdleStatusChanger::reloadSettings()
 	m_naSecs   = conf.value("na-secs",   NA_DEF_SECS);
 	m_awayStatus.setText(conf.value("away-text", ""));
 	m_naStatus.  setText(conf.value("na-text",   ""));
+
+	// Idle service wakes us up only when these are crossed
+	QList<int> thresholds;
+	if (m_awayEnabled)
+		thresholds << m_awaySecs;
+	if (m_naEnabled)
+		thresholds << m_naSecs;
+	QObject *idle = ServiceManager::getByName("Idle");
+	if (idle) {
+		QMetaObject::invokeMethod(idle, "setThresholds",
+		                          Q_ARG(QObject*, this), Q_ARG(QList<int>, thresholds));
+	}
 }
 }
 
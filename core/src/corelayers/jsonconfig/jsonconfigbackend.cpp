@@ -204,7 +204,7 @@ namespace Core
 		}
 	}
 
-	QVariant JsonConfigBackend::load(const QString &fileName)
+	QVariant JsonConfigBackend::read(const QString &fileName)
 	{
 		JsonFile file(fileName);
 		QVariant var;
@@ -216,16 +216,89 @@ namespace Core
 		return var;
 	}
 
+	QVariant JsonConfigBackend::load(const QString &fileName)
+	{
+		// File is (re)loaded because it was changed outside, forget it
+		m_groups.remove(fileName);
+		return read(fileName);
+	}
+
+	bool JsonConfigBackend::loadConcurrently(const QString &fileName, QVariant &entry)
+	{
+		// Never loaded files have no groups cached, so there is nothing to forget
+		entry = read(fileName);
+		return true;
+	}
+
+	static QByteArray generateGroup(const QString &name, const QVariant &value)
+	{
+		QByteArray data;
+		Json::Writer out(&data);
+		out.append("  ", 2).quote(name).append(": ", 2);
+		out.generate(value, 2, variantGeneratorExt);
+		out.flush();
+		return data;
+	}
+
 	void JsonConfigBackend::save(const QString &fileName, const QVariant &entry)
 	{
+		if (entry.type() == QVariant::Map) {
+			const QVariantMap map = entry.toMap();
+			QHash<QString, QByteArray> &groups = m_groups[fileName];
+			groups.clear();
+			for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it)
+				groups.insert(it.key(), generateGroup(it.key(), it.value()));
+			if (!write(fileName, map.keys()))
+				m_groups.remove(fileName);
+			return;
+		}
+
+		m_groups.remove(fileName);
 		QSaveFile file(fileName);
 		if (file.open(QFile::WriteOnly | QIODevice::Text)) {
-			QByteArray data;
-			Json::generate(data, entry, 2, variantGeneratorExt);
-//			qDebug() << QString::fromUtf8(data, data.size());
-			file.write(data);
-			file.commit();
+			Json::Writer out(&file);
+			out.generate(entry, 2, variantGeneratorExt);
+			if (out.flush())
+				file.commit();
 		}
 	}
-}
 
+	bool JsonConfigBackend::saveGroups(const QString &fileName, const QStringList &groups, const QVariantMap &changed)
+	{
+		QHash<QString, QHash<QString, QByteArray>>::iterator cache = m_groups.find(fileName);
+		if (cache == m_groups.end())
+			return false;
+
+		foreach (const QString &group, groups) {
+			if (!changed.contains(group) && !cache->contains(group))
+				return false;
+		}
+		for (QVariantMap::const_iterator it = changed.constBegin(); it != changed.constEnd(); ++it)
+			cache->insert(it.key(), generateGroup(it.key(), it.value()));
+
+		// Removed groups always come with changed root, so nothing else to drop
+		if (!write(fileName, groups)) {
+			m_groups.erase(cache);
+			return false;
+		}
+		return true;
+	}
+
+	bool JsonConfigBackend::write(const QString &fileName, const QStringList &groups)
+	{
+		const QHash<QString, QByteArray> &cache = m_groups.value(fileName);
+		QSaveFile file(fileName);
+		if (!file.open(QFile::WriteOnly | QIODevice::Text))
+			return false;
+
+		Json::Writer out(&file);
+		out.append("{\n", 2);
+		for (int i = 0; i < groups.size(); ++i) {
+			if (i > 0)
+				out.append(",\n", 2);
+			out.append(cache.value(groups.at(i)));
+		}
+		out.append("\n}", 2);
+		return out.flush() && file.commit();
+	}
+}
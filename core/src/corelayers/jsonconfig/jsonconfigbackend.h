@@ -27,6 +27,8 @@
 #define JSONCONFIGBACKEND_H
 
 #include <qutim/config.h>
+#include <QHash>
+#include <QStringList>
 
 using namespace qutim_sdk_0_3;
 
@@ -39,6 +41,15 @@ namespace Core
 	public:
 		virtual QVariant load(const QString &file);
 		virtual void save(const QString &file, const QVariant &entry);
+		virtual bool saveGroups(const QString &file, const QStringList &groups, const QVariantMap &changed);
+		virtual bool loadConcurrently(const QString &file, QVariant &entry);
+	private:
+		static QVariant read(const QString &file);
+		bool write(const QString &file, const QStringList &groups);
+
+		// Serialized top-level groups of saved files, so unchanged groups
+		// are not generated again on partial save
+		QHash<QString, QHash<QString, QByteArray>> m_groups;
 	};
 }
 using namespace Core;
@@ -30,124 +30,19 @@
 #include <qutim/systeminfo.h>
 #include <qutim/json.h>
 #include <QStringBuilder>
-#include <QThreadPool>
-#include "historywindow.h"
+#include <qutim/executor.h>
+#include "jsonhistoryreader.h"
+#include "jsonhistorydecoder.h"
+#include "jsonhistoryarchive.h"
+#include "jsonhistorywriter.h"
+#include <qutim/config.h>
 #include <qutim/icon.h>
 #include <qutim/debug.h>
+#include <qutim/memoryaccounting.h>
 //#include <QElapsedTimer>
 
 namespace Core
 {
-JsonHistoryStoreJob::JsonHistoryStoreJob(JsonHistoryScope::Ptr scope) : d(scope)
-{
-	d->hasRunnable = true;
-	setAutoDelete(true);
-}
-
-void JsonHistoryStoreJob::run()
-{
-	forever {
-		d->mutex.lock();
-		if (d->queue.isEmpty()) {
-			d->hasRunnable = false;
-			d->mutex.unlock();
-			break;
-		}
-        auto it = d->queue.begin();
-        QDate date = it->second.time().date();
-        auto firstContact = it->first;
-        QList<QPair<History::ContactInfo, Message>> queue;
-		while (it != d->queue.end()) {
-            if (firstContact == it->first
-                    && date == it->second.time().date()) {
-				queue << *it;
-				d->queue.erase(it++);
-			} else {
-				++it;
-			}
-		}
-		d->mutex.unlock();
-		
-        QString fileName = d->getFileName(firstContact, date);
-		QFile file(fileName);
-		QDateTime lastModified = QFileInfo(fileName).lastModified();
-		bool new_file = !file.exists();
-		if(!file.open(QIODevice::ReadWrite))
-			return;
-		if(new_file) {
-			file.write("[\n");
-		} else {
-			JsonHistoryScope::EndCache::iterator it = d->cache.find(fileName);
-			uint end;
-			if (it != d->cache.end() && it->lastModified == lastModified)
-				end = it->end;
-			else
-				end = d->findEnd(file);
-			file.resize(end);
-			file.seek(end);
-			file.write(",\n");
-		}
-		for (int i = 0; i < queue.size(); ++i) {
-            const Message &message = queue.at(i).second;
-			if (i > 0)
-				file.write(",\n");
-			file.write(" {\n");
-			foreach(const QByteArray &name, message.dynamicPropertyNames()) {
-				QByteArray data;
-				if(!Json::generate(data, message.property(name), 2))
-					continue;
-				file.write("  ");
-				file.write(Json::quote(QString::fromUtf8(name)).toUtf8());
-				file.write(": ");
-				file.write(data);
-				file.write(",\n");
-			}
-			file.write("  \"datetime\": \"");
-			QDateTime time = message.time();
-			if(!time.isValid())
-				time = QDateTime::currentDateTime();
-			file.write(time.toString(Qt::ISODate).toLatin1());
-			file.write("\",\n  \"in\": ");
-			file.write(message.isIncoming() ? "true" : "false");
-			file.write(",\n  \"text\": ");
-			file.write(Json::quote(message.text()).toUtf8());
-			file.write(",\n  \"html\": ");
-			file.write(Json::quote(message.html()).toUtf8());
-			file.write("\n }");
-		}
-		uint end = file.pos();
-		file.write("\n]");
-		file.close();
-		lastModified = QFileInfo(fileName).lastModified();
-		d->cache.insert(fileName, JsonHistoryScope::EndValue(lastModified, end));
-	//	It will produce something like this:
-	//	{
-	//	 "datetime": "2009-06-20T01:42:22",
-	//	 "type": 1,
-	//	 "in": true,
-	//	 "text": "some cool text"
-	//	}
-	}
-}
-
-
-JsonHistoryJob::JsonHistoryJob(const std::function<void ()> &handler)
-    : m_handler(handler)
-{
-}
-
-void JsonHistoryJob::run()
-{
-    m_handler();
-}
-
-template <typename Method>
-static void runJob(Method method)
-{
-    JsonHistoryJob *job = new JsonHistoryJob(std::move(method));
-    QThreadPool::globalInstance()->start(job);
-}
-
 void init(History *history)
 {
 	ActionGenerator *gen = new ActionGenerator(Icon("view-history"),
@@ -166,11 +61,32 @@ JsonHistory::JsonHistory() : m_scope(new JsonHistoryScope)
 		inited = true;
 		init(this);
 	}
-    m_scope->hasRunnable = false;
+    Config config = Config(QStringLiteral("history")).group(QStringLiteral("json"));
+    m_scope->writer.reset(new JsonHistoryWriter(m_scope.data(),
+                                         config.value(QStringLiteral("flushInterval"), 250),
+                                         config.value(QStringLiteral("openFiles"), 16)));
+    m_scope->writer->start(QThread::LowPriority);
+
+    auto scope = m_scope;
+    MemoryAccounting::add(MemoryAccounting::HistoryCaches, this, QStringLiteral("jsonhistory"),
+                          [scope] () { return scope->index.memoryUsage(); },
+                          [scope] (qint64 target) { scope->index.trim(target); });
+
+    // Months are never changed after they are over, so old ones may be
+    // compressed. Zero disables archiving
+    const int archiveAfter = config.value(QStringLiteral("archiveAfter"), 0);
+    if (archiveAfter > 0) {
+        const QDate today = QDate::currentDate();
+        const QDate before = QDate(today.year(), today.month(), 1).addMonths(1 - archiveAfter);
+        executor()->run([scope, before] () {
+            scope->archive(before);
+        }, Executor::BulkPriority);
+    }
 }
 
 JsonHistory::~JsonHistory()
 {
+    m_scope->writer->stop();
 }
 
 uint JsonHistoryScope::findEnd(QFile &file)
@@ -231,22 +147,146 @@ QString JsonHistoryScope::getFileName(const Message &message) const
 
 QString JsonHistoryScope::getFileName(const History::ContactInfo &info, const QDate &time) const
 {
-    QDir accountDir = getAccountDir(info);
+    QString fileName = quotedContact(info);
+    fileName += (time.isValid() ? time : QDate::currentDate())
+            .toString(QStringLiteral(".yyyyMM.'json'"));
+    return getAccountDir(info).filePath(fileName);
+}
+
+QString JsonHistoryScope::fileName(const QDir &accountDir, const History::ContactInfo &info, const QDate &time)
+{
     QString fileName = JsonHistory::quote(info.contact);
     fileName += (time.isValid() ? time : QDate::currentDate())
             .toString(QStringLiteral(".yyyyMM.'json'"));
     return accountDir.filePath(fileName);
 }
 
+enum { MaxCachedPaths = 1024 };
+
+static inline QString pathKey(const History::AccountInfo &info)
+{
+    return info.protocol % QChar(0) % info.account;
+}
+
 QDir JsonHistoryScope::getAccountDir(const History::AccountInfo &info) const
 {
+    const QString key = pathKey(info);
+    {
+        QMutexLocker locker(&m_pathLock);
+        auto it = m_accountDirs.constFind(key);
+        if (it != m_accountDirs.constEnd())
+            return QDir(it.value());
+    }
+
 	QDir history_dir = SystemInfo::getDir(SystemInfo::HistoryDir);
     QString path = JsonHistory::quote(info.protocol);
     path += QLatin1Char('.');
     path += JsonHistory::quote(info.account);
 	if(!history_dir.exists(path))
 		history_dir.mkpath(path);
-	return history_dir.filePath(path);
+    path = history_dir.filePath(path);
+
+    QMutexLocker locker(&m_pathLock);
+    if (m_accountDirs.size() >= MaxCachedPaths)
+        m_accountDirs.clear();
+    m_accountDirs.insert(key, path);
+	return QDir(path);
+}
+
+QString JsonHistoryScope::quotedContact(const History::ContactInfo &info) const
+{
+    const QString key = pathKey(info) % QChar(0) % info.contact;
+    QMutexLocker locker(&m_pathLock);
+    auto it = m_quotedContacts.constFind(key);
+    if (it != m_quotedContacts.constEnd())
+        return it.value();
+    if (m_quotedContacts.size() >= MaxCachedPaths)
+        m_quotedContacts.clear();
+    const QString quoted = JsonHistory::quote(info.contact);
+    m_quotedContacts.insert(key, quoted);
+    return quoted;
+}
+
+static bool readRecordsData(const uchar *fmap, int len, const std::function<void (const QVariantMap &)> &handler)
+{
+    const uchar *s = Json::skipBlanks(fmap, &len);
+    if (!s || (*s != '[' && *s != '{'))
+        return false;
+    uchar qch = (*s == '{' ? '}' : ']');
+    s++;
+    len--;
+    bool first = true;
+    QVariant val;
+    while (s) {
+        val.clear();
+        s = Json::skipBlanks(s, &len);
+        if (len < 2 || (s && *s == qch))
+            break;
+        if ((!first && *s != ',') || (first && *s == ','))
+            break;
+        first = false;
+        if (*s == ',') {
+            s++;
+            len--;
+        }
+        if (!(s = Json::parseRecord(val, s, &len)))
+            break;
+        handler(val.toMap());
+    }
+    return true;
+}
+
+bool JsonHistoryScope::readRecords(const QString &fileName, const std::function<void (const QVariantMap &)> &handler)
+{
+    QString archiveName = JsonHistoryArchive::isArchive(fileName) ? fileName : QString();
+    if (archiveName.isEmpty() && !QFile::exists(fileName)) {
+        archiveName = JsonHistoryArchive::archiveName(fileName);
+        if (!QFile::exists(archiveName))
+            return false;
+    }
+
+    if (!archiveName.isEmpty()) {
+        JsonHistoryArchive archive;
+        if (!archive.open(archiveName))
+            return false;
+        for (int i = 0; i < archive.frameCount(); ++i) {
+            const QByteArray data = "[\n" + archive.frame(i) + "\n]";
+            readRecordsData(reinterpret_cast<const uchar *>(data.constData()), data.size(), handler);
+        }
+        return true;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QByteArray data;
+    const uchar *fmap = file.map(0, file.size());
+    if (!fmap) {
+        data = file.readAll();
+        fmap = (uchar *)data.constData();
+    }
+    return readRecordsData(fmap, file.size(), handler);
+}
+
+void JsonHistoryScope::archive(const QDate &before)
+{
+    const QString beforeMonth = before.toString(QStringLiteral("yyyyMM"));
+    QDir historyDir = SystemInfo::getDir(SystemInfo::HistoryDir);
+    const QStringList filter = QStringList() << QStringLiteral("*.*.json");
+    foreach (const QString &account, historyDir.entryList(QDir::AllDirs | QDir::NoDotAndDotDot)) {
+        QDir accountDir = historyDir.filePath(account);
+        foreach (const QString &entry, accountDir.entryList(filter, QDir::Files | QDir::NoDotAndDotDot)) {
+            const QString month = entry.section(QLatin1Char('.'), -2, -2);
+            if (month.length() != 6 || month >= beforeMonth)
+                continue;
+            const QString fileName = accountDir.filePath(entry);
+            QMutexLocker locker(&fileLock);
+            writer->forget(fileName);
+            if (!JsonHistoryArchive::create(fileName))
+                qWarning() << "Can't archive history file" << fileName;
+        }
+    }
 }
 
 void JsonHistory::store(const Message &message)
@@ -254,115 +294,203 @@ void JsonHistory::store(const Message &message)
     if (!message.chatUnit())
         return;
 
-    QMutexLocker locker(&m_scope->mutex);
-    m_scope->queue << qMakePair(info(message.chatUnit()), message);
-    if (!m_scope->hasRunnable)
-        QThreadPool::globalInstance()->start(new JsonHistoryStoreJob(m_scope));
+    m_scope->writer->enqueue(info(message.chatUnit()), message);
 }
 
-AsyncResult<MessageList> JsonHistory::read(const ContactInfo &info, const QDateTime &from, const QDateTime &to, int max_num)
+void JsonHistory::virtual_hook(int id, void *data)
 {
-    AsyncResultHandler<MessageList> handler;
-    auto scope = m_scope;
+    switch (id) {
+    case StoreBatchHook: {
+        StoreBatchArgument &argument = *reinterpret_cast<StoreBatchArgument*>(data);
+        doStoreBatch(argument.contact, argument.messages);
+        argument.handled = true;
+        break;
+    }
+    case ReadStreamHook: {
+        ReadStreamArgument &argument = *reinterpret_cast<ReadStreamArgument*>(data);
+        argument.stream = doReadStream(argument.contact, argument.from, argument.to);
+        break;
+    }
+    default:
+        History::virtual_hook(id, data);
+    }
+}
 
-    runJob([scope, info, from, to, max_num, handler] () {
-        QDir dir = scope->getAccountDir(info);
-        QString filter = quote(info.contact);
-        filter += ".*.json";
+void JsonHistory::doStoreBatch(const ContactInfo &contact, const MessageList &messages)
+{
+    m_scope->writer->enqueueBatch(contact, messages);
+}
 
-        MessageList items;
-        QStringList files = dir.entryList(QStringList() << filter, QDir::Readable | QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-        if (files.isEmpty()) {
-            handler.handle(items);
-            return;
-        }
-        for (int i = files.size() - 1; i >= 0; i--) {
-            QList<const uchar *> pointers;
-            QFile file(dir.filePath(files[i]));
-            if (!file.open(QIODevice::ReadOnly))
+int JsonHistory::queueDepth() const
+{
+    return m_scope->writer->statistics().queueDepth;
+}
+
+int JsonHistory::lastFlushLatency() const
+{
+    return m_scope->writer->statistics().lastFlushLatency;
+}
+
+int JsonHistory::maxFlushLatency() const
+{
+    return m_scope->writer->statistics().maxFlushLatency;
+}
+
+struct JsonHistoryReadState
+{
+    JsonHistoryReadState(JsonHistoryScope::Ptr scope, const History::ContactInfo &contact,
+                         const QDateTime &from, const QDateTime &to)
+        : scope(scope), executor(0), contact(contact), from(from), to(to),
+          fileIndex(-1), initialized(false), opened(false), done(false)
+    {
+    }
+
+    void init()
+    {
+        initialized = true;
+        dir = scope->getAccountDir(contact);
+        const QString filter = JsonHistory::quote(contact.contact);
+        QStringList filters;
+        filters << filter + QStringLiteral(".*.json") << filter + QStringLiteral(".*.jsonz");
+        QStringList entries = dir.entryList(filters, QDir::Readable | QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+
+        const QString fromMonth = from.isValid() ? from.toString(QStringLiteral("yyyyMM")) : QString();
+        const QString toMonth = to.isValid() ? to.toString(QStringLiteral("yyyyMM")) : QString();
+        foreach (const QString &entry, entries) {
+            const QString month = entry.section(QLatin1Char('.'), -2, -2);
+            if ((!fromMonth.isEmpty() && month < fromMonth) || (!toMonth.isEmpty() && month > toMonth))
                 continue;
-            int len = file.size();
-            QByteArray data;
-            const uchar *fmap = file.map(0, file.size());
-            if (!fmap) {
-                data = file.readAll();
-                fmap = (uchar *)data.constData();
-            }
-            const uchar *s = Json::skipBlanks(fmap, &len);
-            uchar qch = *s;
-            if (!s || (qch != '[' && qch != '{'))
+            // Month is being archived right now, plain file is still complete
+            if (!files.isEmpty() && files.last().section(QLatin1Char('.'), -2, -2) == month)
                 continue;
-            qch = (qch == '{' ? '}' : ']');
-            s++;
-            len--;
-            bool first = true;
-            while(s) {
-                s = Json::skipBlanks(s, &len);
-                if(len < 2 || (s && *s == qch))
-                    break;
-                if((!first && *s != ',') || (first && *s == ','))
-                    break;
-                first = false;
-                if(*s == ',') {
-                    s++;
-                    len--;
-                }
-                pointers.prepend(s);
-                if (!(s = Json::skipRecord(s, &len))) {
-                    pointers.removeFirst();
+            files << entry;
+        }
+        fileIndex = files.size() - 1;
+    }
+
+    // Prepends up to count messages older than already read ones to items
+    void readBackward(int count, MessageList &items)
+    {
+        if (!initialized)
+            init();
+
+        Message item;
+        while (!done && (count == -1 || items.size() < count)) {
+            if (!opened) {
+                if (fileIndex < 0) {
+                    done = true;
                     break;
                 }
+                const QString fileName = dir.filePath(files[fileIndex--]);
+                opened = reader.open(fileName, to);
+                // It may be archived since the list was built
+                if (!opened && !JsonHistoryArchive::isArchive(fileName))
+                    opened = reader.open(JsonHistoryArchive::archiveName(fileName), to);
+                continue;
             }
-            QVariant value;
-            for (int i = 0; i < pointers.size(); i++) {
-                value.clear();
-                s = pointers[i];
-                len = file.size() + 1 - (s - fmap);
-                Json::parseRecord(value, s, &len);
-                QVariantMap message = value.toMap();
-                Message item;
-                QVariantMap::iterator it = message.begin();
-                for (; it != message.end(); it++) {
-                    QString key = it.key();
-                    if(key == QLatin1String("datetime"))
-                        item.setTime(QDateTime::fromString(it.value().toString(), Qt::ISODate));
-                    else
-                        item.setProperty(key.toUtf8(), it.value());
-                }
-                if (item.time() >= to)
-                    continue;
-                if (item.time() < from) {
-                    handler.handle(items);
-                    return;
-                }
-                items.prepend(item);
-                if ((items.size() >= max_num) && (max_num != -1)) {
-                    handler.handle(items);
-                    return;
-                }
+            if (!reader.previous(item)) {
+                reader.close();
+                opened = false;
+                continue;
             }
+            if (to.isValid() && item.time() >= to)
+                continue;
+            if (from.isValid() && item.time() < from) {
+                done = true;
+                break;
+            }
+            items.prepend(item);
         }
+    }
+
+    JsonHistoryScope::Ptr scope;
+    Executor *executor;
+    History::ContactInfo contact;
+    QDateTime from;
+    QDateTime to;
+    QDir dir;
+    QStringList files;
+    int fileIndex;
+    JsonHistoryReverseReader reader;
+    bool initialized;
+    bool opened;
+    bool done;
+    QMutex lock;
+};
+
+class JsonHistoryStream : public History::Stream
+{
+public:
+    JsonHistoryStream(const std::shared_ptr<JsonHistoryReadState> &state) : m_state(state)
+    {
+    }
+
+    AsyncResult<MessageList> fetch(int count) override
+    {
+        AsyncResultHandler<MessageList> handler;
+        auto state = m_state;
+
+        state->executor->run([state, count, handler] () {
+            QMutexLocker locker(&state->lock);
+            state->scope->writer->flush();
+            MessageList items;
+            state->readBackward(count, items);
+            handler.handle(items);
+        }, Executor::InteractivePriority);
 
-        handler.handle(items);
-    });
+        return handler.result();
+    }
 
-    return handler.result();
+private:
+    std::shared_ptr<JsonHistoryReadState> m_state;
+};
+
+Message JsonHistoryScope::toMessage(const QVariantMap &record)
+{
+    Message item;
+    for (auto it = record.constBegin(); it != record.constEnd(); ++it) {
+        const QString &key = it.key();
+        if (key == QLatin1String("datetime")) {
+            const QByteArray time = it.value().toString().toLatin1();
+            item.setTime(JsonHistoryDecoder::parseTime(time.constData(), time.size()));
+        } else {
+            item.setProperty(key.toUtf8(), it.value());
+        }
+    }
+    return item;
 }
 
-AsyncResult<QVector<History::AccountInfo>> JsonHistory::accounts()
+AsyncResult<MessageList> JsonHistory::read(const ContactInfo &info, const QDateTime &from, const QDateTime &to, int max_num)
+{
+    auto scope = m_scope;
+
+    return runAsync(executor(), [scope, info, from, to, max_num] () -> MessageList {
+        scope->writer->flush();
+        JsonHistoryReadState state(scope, info, from, to);
+        MessageList items;
+        state.readBackward(max_num, items);
+        return items;
+    }, Executor::InteractivePriority);
+}
+
+History::StreamPtr JsonHistory::doReadStream(const ContactInfo &contact, const QDateTime &from, const QDateTime &to)
 {
-    AsyncResultHandler<QVector<AccountInfo>> handler;
+    auto state = std::make_shared<JsonHistoryReadState>(m_scope, contact, from, to);
+    state->executor = executor();
+    return StreamPtr(new JsonHistoryStream(state));
+}
 
-    runJob([handler] () {
+AsyncResult<QVector<History::AccountInfo>> JsonHistory::accounts()
+{
+    auto scope = m_scope;
+    return runAsync(executor(), [scope] () -> QVector<AccountInfo> {
         QVector<AccountInfo> result;
 
         QDir historyDir = SystemInfo::getDir(SystemInfo::HistoryDir);
         QStringList accounts = historyDir.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
-        const QStringList filter = QStringList() << QStringLiteral("*.*.json");
 
         foreach (QString account, accounts) {
-            QDir account_dir = historyDir.filePath(account);
-            if (account_dir.entryList(filter).isEmpty())
+            if (scope->manifest.isEmpty(historyDir.filePath(account)))
                 continue;
 
             AccountInfo info;
@@ -371,72 +499,59 @@ AsyncResult<QVector<History::AccountInfo>> JsonHistory::accounts()
             result << info;
         }
 
-        handler.handle(result);
-    });
-
-    return handler.result();
+        return result;
+    }, Executor::BackgroundPriority);
 }
 
 AsyncResult<QVector<History::ContactInfo>> JsonHistory::contacts(const AccountInfo &account)
 {
-    AsyncResultHandler<QVector<ContactInfo>> handler;
-
     auto scope = m_scope;
-    runJob([handler, scope, account] () {
+    return runAsync(executor(), [scope, account] () -> QVector<ContactInfo> {
         QVector<ContactInfo> result;
-        QSet<QString> used;
 
         QDir accountDir = scope->getAccountDir(account);
-        foreach (QString contact, accountDir.entryList(QDir::Files | QDir::NoDotAndDotDot)) {
+        foreach (const QString &contact, scope->manifest.contacts(accountDir)) {
             ContactInfo info;
             info.account = account.account;
             info.protocol = account.protocol;
-            info.contact = unquote(contact.section(QStringLiteral("."), 0, -3));
-
-            if (!used.contains(info.contact)) {
-                used.insert(info.contact);
-                result << info;
-            }
+            info.contact = contact;
+            result << info;
         }
 
-        handler.handle(result);
-    });
-
-    return handler.result();
+        return result;
+    }, Executor::BackgroundPriority);
 }
 
 AsyncResult<QList<QDate>> JsonHistory::months(const ContactInfo &contact, const QRegularExpression &regex)
 {
-    Q_UNUSED(regex);
-    AsyncResultHandler<QList<QDate>> handler;
-
     auto scope = m_scope;
-    runJob([handler, scope, contact] () {
+    return runAsync(executor(), [scope, contact, regex] () -> QList<QDate> {
+        scope->writer->flush();
         QList<QDate> result;
-        QSet<QString> used;
 
         QDir accountDir = scope->getAccountDir(contact);
-        QStringList filters = QStringList() << JsonHistory::quote(contact.contact) + QStringLiteral(".*");
-        QStringList filesNames = accountDir.entryList(filters, QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-
-        foreach (const QString &fileName, filesNames) {
-            QString date = fileName.section(QLatin1Char('.'), -2, -2 );
-            if (date.length() != 6 || used.contains(date))
-                continue;
-            used.insert(date);
-
-            int year = date.mid(0, 4).toInt();
-            int month = date.mid(4, 2).toInt();
-
-            result << QDate(year, month, 1);
+        QList<QDate> candidates;
+        if (regex.pattern().isEmpty() || !scope->index.months(contact, accountDir, regex, candidates))
+            return scope->manifest.months(accountDir, contact.contact);
+
+        // Index only narrows candidates, regex decides
+        foreach (const QDate &month, candidates) {
+            QSet<QDate> days;
+            scope->index.days(contact, accountDir, month, regex, days);
+            bool found = false;
+            JsonHistoryScope::readRecords(JsonHistoryScope::fileName(accountDir, contact, month),
+                                          [&] (const QVariantMap &message) {
+                if (found)
+                    return;
+                const QDate date = QDateTime::fromString(message.value("datetime").toString(), Qt::ISODate).date();
+                if (days.contains(date) && (!regex.isValid() || message.value("text").toString().contains(regex)))
+                    found = true;
+            });
+            if (found)
+                result << month;
         }
-
-        std::sort(result.begin(), result.end());
-
-        handler.handle(result);
-    });
-
-    return handler.result();
+        return result;
+    }, Executor::BackgroundPriority);
 }
 
 AsyncResult<QList<QDate>> JsonHistory::dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex)
@@ -444,75 +559,40 @@ AsyncResult<QList<QDate>> JsonHistory::dates(const ContactInfo &contact, const Q
     AsyncResultHandler<QList<QDate>> handler;
 
     auto scope = m_scope;
-    runJob([handler, scope, contact, month, regex] () {
+    executor()->run([handler, scope, contact, month, regex] () {
+        scope->writer->flush();
         QSet<QDate> result;
 
-        QFile file(scope->getFileName(contact, month));
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            handler.handle(result.toList());
-            return;
-        }
-
-        int len = file.size();
-        QByteArray data;
-        const uchar *fmap = file.map(0, file.size());
-        if (!fmap) {
-            data = file.readAll();
-            fmap = (uchar *)data.constData();
-        }
-        const uchar *s = Json::skipBlanks(fmap, &len);
-        QVariant val;
-        uchar qch = *s;
-        if (!s || (qch != '[' && qch != '{'))
-            return;
-        qch = (qch == '{' ? '}' : ']');
-        s++;
-        len--;
-        bool first = true;
-        while (s) {
-            val.clear();
-            s = Json::skipBlanks(s, &len);
-            if (len < 2 || (s && *s == qch))
-                break;
-            if ((!first && *s != ',') || (first && *s == ','))
-                break;
-            first = false;
-            if (*s == ',') {
-                s++;
-                len--;
-            }
-            if (!(s = Json::parseRecord(val, s, &len))) {
-                break;
-            } else {
-                const QVariantMap message = val.toMap();
+        QDir accountDir = scope->getAccountDir(contact);
+        QSet<QDate> candidates;
+        const bool indexed = scope->index.days(contact, accountDir, month, regex, candidates);
+
+        if (indexed && (regex.pattern().isEmpty() || candidates.isEmpty())) {
+            result = candidates;
+        } else {
+            // Match regex only against records of days which may contain it
+            JsonHistoryScope::readRecords(JsonHistoryScope::fileName(accountDir, contact, month),
+                                          [&] (const QVariantMap &message) {
                 const QDate date = QDateTime::fromString(message.value("datetime").toString(), Qt::ISODate).date();
+                if (result.contains(date) || (indexed && !candidates.contains(date)))
+                    return;
                 const QString text = message.value("text").toString();
 
                 if (!regex.isValid() || text.contains(regex))
                     result.insert(date);
-            }
+            });
         }
 
         QList<QDate> sortedResult = result.toList();
         std::sort(sortedResult.begin(), sortedResult.end());
 
         handler.handle(sortedResult);
-    });
+    }, Executor::BackgroundPriority);
 
     return handler.result();
 }
 
-void JsonHistory::showHistory(const ChatUnit *unit)
-{
-    unit = unit->getHistoryUnit();
-    if (m_historyWindow) {
-        m_historyWindow.data()->setUnit(unit);
-        m_historyWindow.data()->raise();
-    } else {
-		m_historyWindow = new Core::HistoryWindow(unit);
-		m_historyWindow.data()->show();
-	}
-}
+static const char hexDigits[] = "0123456789abcdef";
 
 QString JsonHistory::quote(const QString &str)
 {
@@ -527,46 +607,78 @@ QString JsonHistory::quote(const QString &str)
 /* 6 */ 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
 /* 7 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 0
 	};
-	QString result;
-	result.reserve(str.size() * 2); // I hope it's enough in most cases
-	const QChar *s = str.data();
-	while(!s->isNull())
-	{
-		if(s->unicode() < 0xff && true_chars[s->unicode()])
-			result += *s;
-		else
-		{
-			result += '%';
-			if(s->unicode() < 0x1000)
-				result += '0';
-			if(s->unicode() < 0x100)
-				result += '0';
-			if(s->unicode() < 0x10)
-				result += '0';
-			result += QString::number(s->unicode(), 16);
+	const int size = str.size();
+	const ushort *s = str.utf16();
+	int quoted = 0;
+	for (int i = 0; i < size; ++i) {
+		if (s[i] >= 128 || !true_chars[s[i]])
+			++quoted;
+	}
+	if (!quoted)
+		return str;
+
+	// Every quoted character becomes %XXXX
+	QString result(size + quoted * 4, Qt::Uninitialized);
+	QChar *d = result.data();
+	for (int i = 0; i < size; ++i) {
+		const ushort c = s[i];
+		if (c < 128 && true_chars[c]) {
+			*d++ = QChar(c);
+		} else {
+			*d++ = QLatin1Char('%');
+			*d++ = QLatin1Char(hexDigits[c >> 12]);
+			*d++ = QLatin1Char(hexDigits[(c >> 8) & 0xf]);
+			*d++ = QLatin1Char(hexDigits[(c >> 4) & 0xf]);
+			*d++ = QLatin1Char(hexDigits[c & 0xf]);
 		}
-		s++;
 	}
 	return result;
 }
 
+static inline int hexValue(ushort c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
 QString JsonHistory::unquote(const QString &str)
 {
-	QString result;
-	bool ok = false;
-	result.reserve(str.size()); // the worst variant
-	const QChar *s = str.data();
-	while(!s->isNull())
-	{
-		if(s->unicode() == L'%')
-		{
-			result += QChar(QString::fromRawData(++s, 4).toUShort(&ok, 16));
-			s += 3;
+	const int size = str.size();
+	const ushort *s = str.utf16();
+	int i = 0;
+	while (i < size && s[i] != '%')
+		++i;
+	if (i == size)
+		return str;
+
+	QString result(size, Qt::Uninitialized); // the worst variant
+	QChar *d = result.data();
+	for (int j = 0; j < i; ++j)
+		*d++ = QChar(s[j]);
+	while (i < size) {
+		if (s[i] == '%') {
+			int value = 0;
+			for (int j = 1; j <= 4; ++j) {
+				const int digit = i + j < size ? hexValue(s[i + j]) : -1;
+				if (digit < 0) {
+					value = -1;
+					break;
+				}
+				value = (value << 4) | digit;
+			}
+			// Malformed escapes are decoded to null character as before
+			*d++ = QChar(ushort(qMax(value, 0)));
+			i += 5;
+		} else {
+			*d++ = QChar(s[i++]);
 		}
-		else
-			result += *s;
-		s++;
 	}
+	result.resize(d - result.constData());
 	return result;
 }
 
@@ -27,17 +27,18 @@
 #define JSONHISTORY_H
 
 #include <qutim/history.h>
-#include <QRunnable>
+#include "jsonhistoryindex.h"
+#include "jsonhistorymanifest.h"
 #include <QDir>
-#include <QLinkedList>
-#include <QPointer>
+#include <QHash>
 #include <QMutex>
+#include <QScopedPointer>
 
 using namespace qutim_sdk_0_3;
 
 namespace Core
 {
-class HistoryWindow;
+class JsonHistoryWriter;
 
 class JsonHistoryScope
 {
@@ -48,44 +49,34 @@ public:
     QString getFileName(const Message &message) const;
     QString getFileName(const History::ContactInfo &info, const QDate &time) const;
     QDir getAccountDir(const History::AccountInfo &info) const;
+    QString quotedContact(const History::ContactInfo &info) const;
+    static QString fileName(const QDir &accountDir, const History::ContactInfo &info, const QDate &time);
+    static Message toMessage(const QVariantMap &record);
+    // Reads records of month file or of its archive, if month is archived
+    static bool readRecords(const QString &fileName, const std::function<void (const QVariantMap &)> &handler);
+    // Compresses month files older than month of before
+    void archive(const QDate &before);
+
+    JsonHistoryIndex index;
+    JsonHistoryManifest manifest;
+    QScopedPointer<JsonHistoryWriter> writer;
+    // Held while month files are written or archived
+    QMutex fileLock;
 
-    struct EndValue
-    {
-        EndValue(const QDateTime &t, uint e) : lastModified(t), end(e) {}
-        QDateTime lastModified;
-        uint end;
-    };
-
-    typedef QHash<QString, EndValue> EndCache;
-    bool hasRunnable;
-    EndCache cache;
-    QLinkedList<QPair<History::ContactInfo, Message>> queue;
-    QMutex mutex;
-};
-
-class JsonHistoryStoreJob : public QRunnable
-{
-public:
-    JsonHistoryStoreJob(JsonHistoryScope::Ptr scope);
-    void run() override;
-	
 private:
-    JsonHistoryScope::Ptr d;
-};
-
-class JsonHistoryJob : public QRunnable
-{
-public:
-    JsonHistoryJob(const std::function<void ()> &handler);
-    void run() override;
-
-private:
-    std::function<void ()> m_handler;
+    // Writer resolves paths for every flushed batch, so quoted names and
+    // already created account directories are remembered
+    mutable QMutex m_pathLock;
+    mutable QHash<QString, QString> m_accountDirs;
+    mutable QHash<QString, QString> m_quotedContacts;
 };
 
 class JsonHistory : public History
 {
     Q_OBJECT
+    Q_PROPERTY(int queueDepth READ queueDepth)
+    Q_PROPERTY(int lastFlushLatency READ lastFlushLatency)
+    Q_PROPERTY(int maxFlushLatency READ maxFlushLatency)
 public:
 	JsonHistory();
     virtual ~JsonHistory();
@@ -96,16 +87,24 @@ public:
     AsyncResult<QVector<ContactInfo>> contacts(const AccountInfo &account) override;
     AsyncResult<QList<QDate>> months(const ContactInfo &contact, const QRegularExpression &regex) override;
     AsyncResult<QList<QDate>> dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex) override;
-    void showHistory(const ChatUnit *unit) override;
 
 	static QString quote(const QString &str);
 	static QString unquote(const QString &str);
 
+    int queueDepth() const;
+    int lastFlushLatency() const;
+    int maxFlushLatency() const;
+
+protected:
+    void virtual_hook(int id, void *data) override;
+
 private slots:
 	void onHistoryActionTriggered(QObject *object);
 private:
+    void doStoreBatch(const ContactInfo &contact, const MessageList &messages);
+    StreamPtr doReadStream(const ContactInfo &contact, const QDateTime &from, const QDateTime &to);
+
     JsonHistoryScope::Ptr m_scope;
-	QPointer<HistoryWindow> m_historyWindow;
 };
 }
 
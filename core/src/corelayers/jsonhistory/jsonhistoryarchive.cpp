@@ -0,0 +1,273 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jsonhistoryarchive.h"
+#include <qutim/json.h>
+#include <qutim/debug.h>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QtEndian>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+static const char archiveMagic[] = "QHJZ";
+
+// Finds records of JsonHistory month file, returns false if it's broken
+static bool splitRecords(const QByteArray &data, QVector<QPair<int, int>> &records)
+{
+    const uchar *begin = reinterpret_cast<const uchar *>(data.constData());
+    int len = data.size();
+    const uchar *s = Json::skipBlanks(begin, &len);
+    if (!s || len < 1 || *s != '[')
+        return false;
+    ++s;
+    --len;
+    bool first = true;
+    while (s && len > 0) {
+        s = Json::skipBlanks(s, &len);
+        if (!s || len < 1 || *s == ']')
+            break;
+        if ((!first && *s != ',') || (first && *s == ','))
+            return false;
+        first = false;
+        if (*s == ',') {
+            ++s;
+            --len;
+            s = Json::skipBlanks(s, &len);
+            if (!s)
+                return false;
+        }
+        const uchar *start = s;
+        if (!(s = Json::skipRecord(s, &len)))
+            return false;
+        records.append(qMakePair(int(start - begin), int(s - start)));
+    }
+    return true;
+}
+
+static qint64 recordTime(const QByteArray &data, const QPair<int, int> &record)
+{
+    QVariant value;
+    int len = record.second;
+    Json::parseRecord(value, reinterpret_cast<const uchar *>(data.constData()) + record.first, &len);
+    const QDateTime time = QDateTime::fromString(value.toMap().value(QStringLiteral("datetime")).toString(), Qt::ISODate);
+    return time.isValid() ? time.toMSecsSinceEpoch() : 0;
+}
+
+JsonHistoryArchive::JsonHistoryArchive()
+{
+}
+
+JsonHistoryArchive::~JsonHistoryArchive()
+{
+    close();
+}
+
+bool JsonHistoryArchive::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray header = m_file.read(HeaderSize);
+    if (header.size() != HeaderSize || !header.startsWith(archiveMagic)) {
+        qWarning() << "Unknown history archive format:" << fileName;
+        close();
+        return false;
+    }
+    const uchar *h = reinterpret_cast<const uchar *>(header.constData());
+    const quint32 count = qFromLittleEndian<quint32>(h + 8);
+    const QByteArray table = m_file.read(qint64(count) * EntrySize);
+    if (qFromLittleEndian<quint32>(h + 4) != Version || table.size() != int(count * EntrySize)) {
+        qWarning() << "Broken history archive:" << fileName;
+        close();
+        return false;
+    }
+
+    m_entries.resize(count);
+    for (quint32 i = 0; i < count; ++i) {
+        const uchar *e = reinterpret_cast<const uchar *>(table.constData()) + i * EntrySize;
+        Entry &entry = m_entries[i];
+        entry.offset = qFromLittleEndian<quint64>(e);
+        entry.size = qFromLittleEndian<quint32>(e + 8);
+        entry.records = qFromLittleEndian<quint32>(e + 12);
+        entry.first = qFromLittleEndian<qint64>(e + 16);
+        entry.last = qFromLittleEndian<qint64>(e + 24);
+    }
+    return true;
+}
+
+void JsonHistoryArchive::close()
+{
+    m_file.close();
+    m_entries.clear();
+}
+
+int JsonHistoryArchive::frameCount() const
+{
+    return m_entries.size();
+}
+
+qint64 JsonHistoryArchive::firstTime(int frame) const
+{
+    return m_entries.at(frame).first;
+}
+
+qint64 JsonHistoryArchive::lastTime(int frame) const
+{
+    return m_entries.at(frame).last;
+}
+
+QByteArray JsonHistoryArchive::frame(int frame)
+{
+    const Entry &entry = m_entries.at(frame);
+    if (!m_file.seek(entry.offset))
+        return QByteArray();
+    const QByteArray data = m_file.read(entry.size);
+    if (data.size() != int(entry.size))
+        return QByteArray();
+    return qUncompress(data);
+}
+
+QString JsonHistoryArchive::archiveName(const QString &fileName)
+{
+    return fileName + QLatin1Char('z');
+}
+
+bool JsonHistoryArchive::isArchive(const QString &fileName)
+{
+    return fileName.endsWith(QStringLiteral(".jsonz"));
+}
+
+bool JsonHistoryArchive::create(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    file.close();
+
+    QVector<QPair<int, int>> records;
+    if (!splitRecords(data, records)) {
+        qWarning() << "Can't archive broken history file" << fileName;
+        return false;
+    }
+
+    // Frames of previous archive are copied as is
+    QVector<Entry> entries;
+    QList<QByteArray> frames;
+    const QString name = archiveName(fileName);
+    if (QFile::exists(name)) {
+        JsonHistoryArchive archive;
+        if (!archive.open(name))
+            return false;
+        for (int i = 0; i < archive.frameCount(); ++i) {
+            Entry entry = archive.m_entries.at(i);
+            archive.m_file.seek(entry.offset);
+            frames << archive.m_file.read(entry.size);
+            entries << entry;
+        }
+    }
+
+    for (int i = 0; i < records.size();) {
+        QByteArray text;
+        const int first = i;
+        while (i < records.size() && (text.isEmpty() || text.size() < FrameSize)) {
+            // Keep the layout of month file, so reverse reader finds records
+            text += text.isEmpty() ? " " : ",\n ";
+            text += data.mid(records.at(i).first, records.at(i).second);
+            ++i;
+        }
+        Entry entry;
+        entry.records = i - first;
+        entry.first = recordTime(data, records.at(first));
+        entry.last = recordTime(data, records.at(i - 1));
+        frames << qCompress(text);
+        entry.size = frames.last().size();
+        entries << entry;
+    }
+
+    QSaveFile out(name);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray header(HeaderSize + entries.size() * EntrySize, Qt::Uninitialized);
+    uchar *h = reinterpret_cast<uchar *>(header.data());
+    memcpy(h, archiveMagic, 4);
+    qToLittleEndian<quint32>(Version, h + 4);
+    qToLittleEndian<quint32>(entries.size(), h + 8);
+    qint64 offset = header.size();
+    for (int i = 0; i < entries.size(); ++i) {
+        uchar *e = h + HeaderSize + i * EntrySize;
+        qToLittleEndian<quint64>(offset, e);
+        qToLittleEndian<quint32>(entries.at(i).size, e + 8);
+        qToLittleEndian<quint32>(entries.at(i).records, e + 12);
+        qToLittleEndian<qint64>(entries.at(i).first, e + 16);
+        qToLittleEndian<qint64>(entries.at(i).last, e + 24);
+        offset += entries.at(i).size;
+    }
+    out.write(header);
+    foreach (const QByteArray &frame, frames)
+        out.write(frame);
+    if (!out.commit()) {
+        qWarning() << "Can't write history archive" << name << out.errorString();
+        return false;
+    }
+    return QFile::remove(fileName);
+}
+
+bool JsonHistoryArchive::extract(const QString &archiveName, const QString &fileName)
+{
+    JsonHistoryArchive archive;
+    if (!archive.open(archiveName))
+        return false;
+
+    QSaveFile out(fileName);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+    out.write("[\n");
+    for (int i = 0; i < archive.frameCount(); ++i) {
+        const QByteArray frame = archive.frame(i);
+        if (frame.isEmpty()) {
+            qWarning() << "Broken frame" << i << "of history archive" << archiveName;
+            return false;
+        }
+        if (i > 0)
+            out.write(",\n");
+        out.write(frame);
+    }
+    out.write("\n]");
+    if (!out.commit()) {
+        qWarning() << "Can't extract history archive" << archiveName << out.errorString();
+        return false;
+    }
+    archive.close();
+    return QFile::remove(archiveName);
+}
+
+}
@@ -0,0 +1,90 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSONHISTORYARCHIVE_H
+#define JSONHISTORYARCHIVE_H
+
+#include <QFile>
+#include <QVector>
+
+namespace Core
+{
+
+/**
+ * Compressed container for closed months of JsonHistory, stored next to
+ * the month file as "<contact>.<yyyyMM>.jsonz".
+ *
+ * Records are split into frames of about FrameSize bytes, every frame is
+ * compressed separately and the table of frames with their time ranges
+ * is kept right after the header. So reading the tail of an archived month
+ * decompresses only the last frame instead of the whole file.
+ *
+ * Frame holds records in the same layout as month file, but without
+ * enclosing brackets, so frame() returns text readable by any JsonHistory
+ * parser.
+ */
+class JsonHistoryArchive
+{
+public:
+    enum { Version = 1, HeaderSize = 12, EntrySize = 32, FrameSize = 64 * 1024 };
+
+    JsonHistoryArchive();
+    ~JsonHistoryArchive();
+
+    bool open(const QString &fileName);
+    void close();
+
+    int frameCount() const;
+    // Time of the first and the last records of frame in msecs since epoch
+    qint64 firstTime(int frame) const;
+    qint64 lastTime(int frame) const;
+    QByteArray frame(int frame);
+
+    static QString archiveName(const QString &fileName);
+    static bool isArchive(const QString &fileName);
+
+    // Compresses month file and removes it, records from already existing
+    // archive of the same month are kept before the new ones
+    static bool create(const QString &fileName);
+    // Unpacks archive back to month file, so it can be appended again
+    static bool extract(const QString &archiveName, const QString &fileName);
+
+private:
+    struct Entry
+    {
+        qint64 offset;
+        quint32 size;
+        quint32 records;
+        qint64 first;
+        qint64 last;
+    };
+
+    QFile m_file;
+    QVector<Entry> m_entries;
+};
+
+}
+
+#endif // JSONHISTORYARCHIVE_H
@@ -0,0 +1,385 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jsonhistorydecoder.h"
+#include <qutim/json.h>
+#include <QVector>
+#include <climits>
+#include <string.h>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+struct JsonCursor
+{
+    const uchar *s;
+    const uchar *end;
+
+    bool skipBlanks()
+    {
+        while (s < end && *s <= ' ')
+            ++s;
+        return s < end;
+    }
+
+    bool skipLiteral(const char *literal, int size)
+    {
+        if (end - s < size || memcmp(s, literal, size) != 0)
+            return false;
+        s += size;
+        return true;
+    }
+};
+
+enum DecoderKey { DateTimeKey = -2, UnknownKey = -1 };
+
+static inline int digit(uchar c)
+{
+    return c >= '0' && c <= '9' ? c - '0' : -1;
+}
+
+static inline int number(const char *s, int size)
+{
+    int result = 0;
+    for (int i = 0; i < size; ++i) {
+        const int value = digit(s[i]);
+        if (value < 0)
+            return -1;
+        result = result * 10 + value;
+    }
+    return result;
+}
+
+static bool readHex(JsonCursor &c, uint &code)
+{
+    if (c.end - c.s < 4)
+        return false;
+    code = 0;
+    for (int i = 0; i < 4; ++i) {
+        const uchar ch = *c.s++;
+        code <<= 4;
+        if (ch >= '0' && ch <= '9')
+            code |= ch - '0';
+        else if (ch >= 'a' && ch <= 'f')
+            code |= ch - 'a' + 10;
+        else if (ch >= 'A' && ch <= 'F')
+            code |= ch - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
+
+static void appendUtf8(QByteArray &out, uint code)
+{
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | (code >> 6));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += char(0xE0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    } else {
+        out += char(0xF0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3F));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+// Finds contents of string token, unescaped text is put to buffer only
+// if there are escape sequences, otherwise data points to the input
+static bool readString(JsonCursor &c, QByteArray &buffer, const char **data, int *size)
+{
+    if (c.s >= c.end || *c.s != '"')
+        return false;
+    const uchar *begin = ++c.s;
+    while (c.s < c.end && *c.s != '"' && *c.s != '\\')
+        ++c.s;
+    if (c.s >= c.end)
+        return false;
+    if (*c.s == '"') {
+        *data = reinterpret_cast<const char *>(begin);
+        *size = c.s - begin;
+        ++c.s;
+        return true;
+    }
+
+    buffer = QByteArray(reinterpret_cast<const char *>(begin), c.s - begin);
+    while (c.s < c.end) {
+        uchar ch = *c.s++;
+        if (ch == '"') {
+            *data = buffer.constData();
+            *size = buffer.size();
+            return true;
+        }
+        if (ch != '\\') {
+            buffer += char(ch);
+            continue;
+        }
+        if (c.s >= c.end)
+            return false;
+        ch = *c.s++;
+        switch (ch) {
+        case 'n': buffer += '\n'; break;
+        case 'r': buffer += '\r'; break;
+        case 't': buffer += '\t'; break;
+        case 'b': buffer += '\b'; break;
+        case 'f': buffer += '\f'; break;
+        case '"':
+        case '\\':
+        case '/':
+            buffer += char(ch);
+            break;
+        case 'u': {
+            uint code;
+            if (!readHex(c, code))
+                return false;
+            if (code >= 0xD800 && code < 0xDC00 && c.end - c.s >= 6 && c.s[0] == '\\' && c.s[1] == 'u') {
+                c.s += 2;
+                uint low;
+                if (!readHex(c, low))
+                    return false;
+                if (low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                } else {
+                    appendUtf8(buffer, code);
+                    code = low;
+                }
+            }
+            appendUtf8(buffer, code);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool readString(JsonCursor &c, QString &result)
+{
+    QByteArray buffer;
+    const char *data;
+    int size;
+    if (!readString(c, buffer, &data, &size))
+        return false;
+    result = QString::fromUtf8(data, size);
+    return true;
+}
+
+static bool readNumber(JsonCursor &c, QVariant &value)
+{
+    const uchar *begin = c.s;
+    bool integer = true;
+    if (c.s < c.end && *c.s == '-')
+        ++c.s;
+    while (c.s < c.end) {
+        const uchar ch = *c.s;
+        if (ch == '.' || ch == 'e' || ch == 'E' || ch == '+' || ch == '-')
+            integer = false;
+        else if (digit(ch) < 0)
+            break;
+        ++c.s;
+    }
+    if (c.s == begin)
+        return false;
+    const QByteArray text = QByteArray::fromRawData(reinterpret_cast<const char *>(begin), c.s - begin);
+    bool ok;
+    if (integer) {
+        const qlonglong result = text.toLongLong(&ok);
+        if (ok) {
+            if (result >= INT_MIN && result <= INT_MAX)
+                value = int(result);
+            else
+                value = result;
+            return true;
+        }
+    }
+    value = text.toDouble(&ok);
+    return ok;
+}
+
+static bool readValue(JsonCursor &c, QVariant &value)
+{
+    if (!c.skipBlanks())
+        return false;
+    switch (*c.s) {
+    case '"': {
+        QString result;
+        if (!readString(c, result))
+            return false;
+        value = result;
+        return true;
+    }
+    case 't':
+        value = true;
+        return c.skipLiteral("true", 4);
+    case 'f':
+        value = false;
+        return c.skipLiteral("false", 5);
+    case 'n':
+        value = QVariant();
+        return c.skipLiteral("null", 4);
+    case '{':
+    case '[': {
+        int length = c.end - c.s;
+        const uchar *next = Json::parseValue(value, c.s, &length);
+        if (!next)
+            return false;
+        c.s = next;
+        return true;
+    }
+    default:
+        return readNumber(c, value);
+    }
+}
+
+static int findKey(const char *data, int size)
+{
+    static const QVector<QByteArray> names = [] () {
+        QVector<QByteArray> result;
+        for (int i = 0; i <= Message::LastWellKnownProperty; ++i)
+            result << Message::propertyName(static_cast<Message::Property>(i));
+        return result;
+    }();
+    if (size == 8 && memcmp(data, "datetime", 8) == 0)
+        return DateTimeKey;
+    for (int i = 0; i < names.size(); ++i) {
+        const QByteArray &name = names.at(i);
+        if (name.size() == size && memcmp(name.constData(), data, size) == 0)
+            return i;
+    }
+    return UnknownKey;
+}
+
+const uchar *JsonHistoryDecoder::decode(const uchar *s, int length, Message &message)
+{
+    JsonCursor c = { s, s + length };
+    if (!c.skipBlanks() || *c.s != '{')
+        return 0;
+    ++c.s;
+    if (!c.skipBlanks())
+        return 0;
+    if (*c.s == '}')
+        return c.s + 1;
+
+    QByteArray keyBuffer;
+    forever {
+        const char *keyData;
+        int keySize;
+        if (!c.skipBlanks() || !readString(c, keyBuffer, &keyData, &keySize))
+            return 0;
+        if (!c.skipBlanks() || *c.s != ':')
+            return 0;
+        ++c.s;
+        if (!c.skipBlanks())
+            return 0;
+
+        const int key = findKey(keyData, keySize);
+        if ((key == Message::TextProperty || key == Message::HtmlProperty || key == DateTimeKey) && *c.s == '"') {
+            QByteArray buffer;
+            const char *data;
+            int size;
+            if (!readString(c, buffer, &data, &size))
+                return 0;
+            if (key == DateTimeKey)
+                message.setTime(parseTime(data, size));
+            else if (key == Message::TextProperty)
+                message.setText(QString::fromUtf8(data, size));
+            else
+                message.setHtml(QString::fromUtf8(data, size));
+        } else {
+            // Key may point to the input, copy it before reading further
+            const QByteArray name = key == UnknownKey ? QByteArray(keyData, keySize) : QByteArray();
+            QVariant value;
+            if (!readValue(c, value))
+                return 0;
+            if (key == DateTimeKey)
+                message.setTime(value.toDateTime());
+            else if (key == Message::InProperty)
+                message.setIncoming(value.toBool());
+            else if (key == UnknownKey)
+                message.setProperty(name.constData(), value);
+            else
+                message.setProperty(static_cast<Message::Property>(key), value);
+        }
+
+        if (!c.skipBlanks())
+            return 0;
+        if (*c.s == '}')
+            return c.s + 1;
+        if (*c.s != ',')
+            return 0;
+        ++c.s;
+    }
+}
+
+QDateTime JsonHistoryDecoder::parseTime(const char *s, int length)
+{
+    // yyyy-MM-ddThh:mm:ss with optional .zzz and Z or +hh:mm
+    if (length >= 19 && s[4] == '-' && s[7] == '-' && s[10] == 'T' && s[13] == ':' && s[16] == ':') {
+        const int year = number(s, 4);
+        const int month = number(s + 5, 2);
+        const int day = number(s + 8, 2);
+        const int hour = number(s + 11, 2);
+        const int minute = number(s + 14, 2);
+        const int second = number(s + 17, 2);
+        int msec = 0;
+        int pos = 19;
+        if (pos < length && s[pos] == '.') {
+            int digits = 0;
+            for (++pos; pos < length && digit(s[pos]) >= 0; ++pos, ++digits) {
+                if (digits < 3)
+                    msec = msec * 10 + digit(s[pos]);
+            }
+            for (; digits < 3; ++digits)
+                msec *= 10;
+        }
+        const QDate date(year, month, day);
+        const QTime time(hour, minute, second, msec);
+        if (year >= 0 && month >= 0 && day >= 0 && hour >= 0 && minute >= 0 && second >= 0
+                && date.isValid() && time.isValid()) {
+            if (pos == length)
+                return QDateTime(date, time, Qt::LocalTime);
+            if (pos + 1 == length && s[pos] == 'Z')
+                return QDateTime(date, time, Qt::UTC);
+            if (pos + 6 == length && (s[pos] == '+' || s[pos] == '-') && s[pos + 3] == ':') {
+                const int offsetHour = number(s + pos + 1, 2);
+                const int offsetMinute = number(s + pos + 4, 2);
+                if (offsetHour >= 0 && offsetMinute >= 0) {
+                    const int offset = (offsetHour * 60 + offsetMinute) * 60;
+                    return QDateTime(date, time, Qt::OffsetFromUTC, s[pos] == '-' ? -offset : offset);
+                }
+            }
+        }
+    }
+    return QDateTime::fromString(QString::fromLatin1(s, length), Qt::ISODate);
+}
+
+}
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSONHISTORYDECODER_H
+#define JSONHISTORYDECODER_H
+
+#include <qutim/message.h>
+#include <QDateTime>
+
+namespace Core
+{
+
+/**
+ * Decodes records of JsonHistory straight into Message, without building
+ * QVariantMap of the whole record first.
+ *
+ * Time, direction, text, html and well-known properties are set directly,
+ * only unknown keys go to dynamic properties. Nested objects and arrays
+ * are parsed by Json::parseValue.
+ */
+class JsonHistoryDecoder
+{
+public:
+    // Returns pointer right after the record or 0 if it's malformed
+    static const uchar *decode(const uchar *s, int length, qutim_sdk_0_3::Message &message);
+    // Parses dates written by QDateTime::toString(Qt::ISODate)
+    static QDateTime parseTime(const char *s, int length);
+};
+
+}
+
+#endif // JSONHISTORYDECODER_H
@@ -0,0 +1,444 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jsonhistoryindex.h"
+#include "jsonhistory.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <qutim/memoryaccounting.h>
+#include <qutim/debug.h>
+
+namespace Core
+{
+enum { IndexMagic = 0x51484958, IndexVersion = 1, CacheSize = 16 };
+
+static inline quint32 monthKey(const QDate &date)
+{
+    return date.year() * 100 + date.month();
+}
+
+static inline quint32 dayKey(const QDate &date)
+{
+    return date.year() * 10000 + date.month() * 100 + date.day();
+}
+
+static inline QDate dayFromKey(quint32 key)
+{
+    return QDate(key / 10000, key / 100 % 100, key % 100);
+}
+
+static inline QDate monthFromKey(quint32 key)
+{
+    return QDate(key / 100, key % 100, 1);
+}
+
+static inline quint64 trigramKey(const QString &token, int i)
+{
+    return quint64(token.at(i).unicode()) << 32 | quint64(token.at(i + 1).unicode()) << 16 | token.at(i + 2).unicode();
+}
+
+static QString indexFileName(const History::ContactInfo &contact, const QDir &accountDir)
+{
+    return accountDir.filePath(QStringLiteral("index/") + JsonHistory::quote(contact.contact) + QStringLiteral(".idx"));
+}
+
+JsonHistoryIndex::JsonHistoryIndex()
+{
+}
+
+QStringList JsonHistoryIndex::tokenize(const QString &text)
+{
+    QStringList result;
+    QString token;
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            token += c.toLower();
+        } else if (!token.isEmpty()) {
+            result << token;
+            token.clear();
+        }
+    }
+    if (!token.isEmpty())
+        result << token;
+    return result;
+}
+
+JsonHistoryIndex::ContactIndex &JsonHistoryIndex::load(const History::ContactInfo &contact, const QDir &accountDir)
+{
+    for (int i = 0; i < m_cache.size(); ++i) {
+        if (m_cache.at(i).contact == contact) {
+            m_cache.move(i, 0);
+            return m_cache.first().index;
+        }
+    }
+
+    while (m_cache.size() >= CacheSize) {
+        const Entry &last = m_cache.last();
+        if (last.index.dirty)
+            save(last);
+        m_cache.removeLast();
+    }
+
+    Entry entry;
+    entry.contact = contact;
+    entry.accountDir = accountDir;
+
+    QFile file(indexFileName(contact, accountDir));
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_0);
+        quint32 magic, version;
+        in >> magic >> version;
+        if (magic == IndexMagic && version == IndexVersion) {
+            quint32 count;
+            in >> count;
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                quint32 month;
+                Stamp stamp;
+                in >> month >> stamp.size >> stamp.modified;
+                entry.index.months.insert(month, stamp);
+            }
+            in >> entry.index.postings;
+        }
+        if (in.status() != QDataStream::Ok) {
+            entry.index.months.clear();
+            entry.index.postings.clear();
+        }
+    }
+
+    m_cache.prepend(entry);
+    ContactIndex &index = m_cache.first().index;
+    validate(index, contact, accountDir);
+    return index;
+}
+
+void JsonHistoryIndex::validate(ContactIndex &index, const History::ContactInfo &contact, const QDir &accountDir)
+{
+    const QString quoted = JsonHistory::quote(contact.contact);
+    const QStringList filters = QStringList() << quoted + QStringLiteral(".*.json") << quoted + QStringLiteral(".*.jsonz");
+    QSet<quint32> existing;
+    foreach (const QString &fileName, accountDir.entryList(filters, QDir::Files | QDir::NoDotAndDotDot, QDir::Name)) {
+        const QString date = fileName.section(QLatin1Char('.'), -2, -2);
+        if (date.length() != 6)
+            continue;
+        const quint32 month = date.toUInt();
+        // Plain file goes first and wins while month is being archived
+        if (existing.contains(month))
+            continue;
+        existing.insert(month);
+
+        const QFileInfo info(accountDir.filePath(fileName));
+        const Stamp stamp = index.months.value(month);
+        if (stamp.size != info.size() || stamp.modified != info.lastModified().toMSecsSinceEpoch())
+            reindex(index, month, info.filePath());
+    }
+
+    foreach (quint32 month, index.months.keys()) {
+        if (!existing.contains(month))
+            reindex(index, month, QString());
+    }
+}
+
+void JsonHistoryIndex::reindex(ContactIndex &index, quint32 month, const QString &fileName)
+{
+    const quint32 first = month * 100;
+    const quint32 last = month * 100 + 99;
+    for (auto it = index.postings.begin(); it != index.postings.end();) {
+        QSet<quint32> &days = it.value();
+        for (auto jt = days.begin(); jt != days.end();) {
+            if (*jt >= first && *jt <= last)
+                jt = days.erase(jt);
+            else
+                ++jt;
+        }
+        if (days.isEmpty()) {
+            it = index.postings.erase(it);
+            // Rebuilt on next search, words are rarely dropped
+            index.trigrams.clear();
+            index.hasTrigrams = false;
+        } else {
+            ++it;
+        }
+    }
+    index.months.remove(month);
+    index.dirty = true;
+
+    if (fileName.isEmpty())
+        return;
+
+    JsonHistoryScope::readRecords(fileName, [&index] (const QVariantMap &message) {
+        const QDate date = QDateTime::fromString(message.value(QStringLiteral("datetime")).toString(), Qt::ISODate).date();
+        const quint32 day = dayKey(date);
+        index.postings[QString()].insert(day);
+        foreach (const QString &token, tokenize(message.value(QStringLiteral("text")).toString()))
+            post(index, token, day);
+    });
+
+    const QFileInfo info(fileName);
+    Stamp &stamp = index.months[month];
+    stamp.size = info.size();
+    stamp.modified = info.lastModified().toMSecsSinceEpoch();
+}
+
+void JsonHistoryIndex::post(ContactIndex &index, const QString &token, quint32 day)
+{
+    auto it = index.postings.find(token);
+    if (it == index.postings.end()) {
+        it = index.postings.insert(token, QSet<quint32>());
+        if (index.hasTrigrams)
+            addTrigrams(index, token);
+    }
+    it->insert(day);
+}
+
+void JsonHistoryIndex::addTrigrams(ContactIndex &index, const QString &token)
+{
+    QSet<quint64> added;
+    for (int i = 0; i + 2 < token.size(); ++i) {
+        const quint64 key = trigramKey(token, i);
+        if (!added.contains(key)) {
+            added.insert(key);
+            index.trigrams[key] << token;
+        }
+    }
+}
+
+QStringList JsonHistoryIndex::words(ContactIndex &index, const QString &token, Match match)
+{
+    QStringList result;
+    if (match == ExactMatch) {
+        if (index.postings.contains(token))
+            result << token;
+        return result;
+    }
+
+    auto matches = [&token, match] (const QString &word) {
+        switch (match) {
+        case PrefixMatch:
+            return word.startsWith(token);
+        case SuffixMatch:
+            return word.endsWith(token);
+        default:
+            return !word.isEmpty() && word.contains(token);
+        }
+    };
+
+    if (token.size() < 3) {
+        // Too short for trigrams, such tokens match lots of words anyway
+        for (auto it = index.postings.constBegin(); it != index.postings.constEnd(); ++it) {
+            if (matches(it.key()))
+                result << it.key();
+        }
+        return result;
+    }
+
+    if (!index.hasTrigrams) {
+        for (auto it = index.postings.constBegin(); it != index.postings.constEnd(); ++it)
+            addTrigrams(index, it.key());
+        index.hasTrigrams = true;
+    }
+
+    // Every matching word contains all trigrams of token, so the rarest one
+    // gives the shortest list to check
+    const QStringList *rarest = 0;
+    for (int i = 0; i + 2 < token.size(); ++i) {
+        auto it = index.trigrams.constFind(trigramKey(token, i));
+        if (it == index.trigrams.constEnd())
+            return result;
+        if (!rarest || it->size() < rarest->size())
+            rarest = &it.value();
+    }
+    foreach (const QString &word, *rarest) {
+        if (matches(word))
+            result << word;
+    }
+    return result;
+}
+
+void JsonHistoryIndex::add(const History::ContactInfo &contact, const QDir &accountDir,
+                           const QDate &month, const QList<Message> &messages)
+{
+    QMutexLocker locker(&m_mutex);
+    ContactIndex &index = load(contact, accountDir);
+    const quint32 key = monthKey(month);
+
+    foreach (const Message &message, messages) {
+        QDate date = message.time().date();
+        if (!date.isValid())
+            date = QDate::currentDate();
+        const quint32 day = dayKey(date);
+        index.postings[QString()].insert(day);
+        foreach (const QString &token, tokenize(message.text()))
+            post(index, token, day);
+    }
+
+    // The file was just written by us, so remember it as indexed
+    const QFileInfo info(JsonHistoryScope::fileName(accountDir, contact, month));
+    Stamp &stamp = index.months[key];
+    stamp.size = info.size();
+    stamp.modified = info.lastModified().toMSecsSinceEpoch();
+    index.dirty = true;
+}
+
+void JsonHistoryIndex::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_cache.size(); ++i) {
+        Entry &entry = m_cache[i];
+        if (entry.index.dirty) {
+            save(entry);
+            entry.index.dirty = false;
+        }
+    }
+}
+
+qint64 JsonHistoryIndex::memoryUsage()
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 result = 0;
+    for (int i = 0; i < m_cache.size(); ++i)
+        result += memoryUsage(m_cache.at(i));
+    return result;
+}
+
+void JsonHistoryIndex::trim(qint64 target)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 usage = 0;
+    for (int i = 0; i < m_cache.size(); ++i)
+        usage += memoryUsage(m_cache.at(i));
+    while (usage > target && !m_cache.isEmpty()) {
+        const Entry &last = m_cache.last();
+        usage -= memoryUsage(last);
+        if (last.index.dirty)
+            save(last);
+        m_cache.removeLast();
+    }
+}
+
+qint64 JsonHistoryIndex::memoryUsage(const Entry &entry)
+{
+    // Hash nodes are counted as 32 bytes, set items as 16 ones
+    const ContactIndex &index = entry.index;
+    qint64 result = 64 + index.months.size() * 32;
+    for (auto it = index.postings.constBegin(); it != index.postings.constEnd(); ++it)
+        result += 32 + MemoryAccounting::stringSize(it.key()) + it->size() * 16;
+    // Words in trigram lists share data with postings keys
+    for (auto it = index.trigrams.constBegin(); it != index.trigrams.constEnd(); ++it)
+        result += 32 + it->size() * 8;
+    return result;
+}
+
+void JsonHistoryIndex::save(const Entry &entry)
+{
+    const ContactIndex &index = entry.index;
+    if (!entry.accountDir.exists(QStringLiteral("index")))
+        entry.accountDir.mkpath(QStringLiteral("index"));
+
+    QSaveFile file(indexFileName(entry.contact, entry.accountDir));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Can't save history index" << file.fileName();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(IndexMagic) << quint32(IndexVersion) << quint32(index.months.size());
+    for (auto it = index.months.constBegin(); it != index.months.constEnd(); ++it)
+        out << it.key() << it->size << it->modified;
+    out << index.postings;
+    file.commit();
+}
+
+bool JsonHistoryIndex::candidates(ContactIndex &index, const QRegularExpression &regex, QSet<quint32> &days)
+{
+    const QStringList tokens = tokenize(History::literal(regex));
+    if (tokens.isEmpty())
+        return false;
+
+    for (int i = 0; i < tokens.size(); ++i) {
+        // Searched text is a substring, so first token may be only an end
+        // of indexed word and last one only a beginning, the rest are whole
+        Match match = ExactMatch;
+        if (tokens.size() == 1)
+            match = SubstringMatch;
+        else if (i == 0)
+            match = SuffixMatch;
+        else if (i == tokens.size() - 1)
+            match = PrefixMatch;
+
+        QSet<quint32> tokenDays;
+        foreach (const QString &word, words(index, tokens.at(i), match))
+            tokenDays.unite(index.postings.value(word));
+        if (i == 0)
+            days = tokenDays;
+        else
+            days.intersect(tokenDays);
+        if (days.isEmpty())
+            break;
+    }
+    return true;
+}
+
+bool JsonHistoryIndex::months(const History::ContactInfo &contact, const QDir &accountDir,
+                              const QRegularExpression &regex, QList<QDate> &result)
+{
+    QMutexLocker locker(&m_mutex);
+    ContactIndex &index = load(contact, accountDir);
+    QSet<quint32> days;
+    if (!candidates(index, regex, days))
+        return false;
+
+    QSet<quint32> months;
+    foreach (quint32 day, days)
+        months.insert(day / 100);
+    foreach (quint32 month, months)
+        result << monthFromKey(month);
+    std::sort(result.begin(), result.end());
+    return true;
+}
+
+bool JsonHistoryIndex::days(const History::ContactInfo &contact, const QDir &accountDir,
+                            const QDate &month, const QRegularExpression &regex, QSet<QDate> &result)
+{
+    QMutexLocker locker(&m_mutex);
+    ContactIndex &index = load(contact, accountDir);
+    const quint32 key = monthKey(month);
+
+    QSet<quint32> days;
+    if (regex.pattern().isEmpty())
+        days = index.postings.value(QString());
+    else if (!candidates(index, regex, days))
+        return false;
+    foreach (quint32 day, days) {
+        if (day / 100 == key)
+            result.insert(dayFromKey(day));
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSONHISTORYINDEX_H
+#define JSONHISTORYINDEX_H
+
+#include <qutim/history.h>
+#include <QDir>
+#include <QMutex>
+#include <QSet>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+
+/**
+ * Inverted index of history words, token -> set of days the token was used.
+ * Null token is used for the set of all days with any message.
+ *
+ * It is kept per contact in "<account dir>/index/<contact>.idx" and covers
+ * all month files of the contact. Every month remembers size and modification
+ * time of the file it was built from, so months changed behind our back
+ * (histman import, manual editing) are reindexed on next access.
+ *
+ * Postings are intentionally coarse: they only tell which days may contain
+ * the searched text, the regular expression is still matched against the
+ * records of these days.
+ *
+ * Searched words may be parts of indexed ones, so they are looked up by
+ * trigrams of the words. Trigram map is built in memory on first search.
+ */
+class JsonHistoryIndex
+{
+public:
+    JsonHistoryIndex();
+
+    // Called by store job for each written batch
+    void add(const History::ContactInfo &contact, const QDir &accountDir,
+             const QDate &month, const QList<Message> &messages);
+    void sync();
+
+    // Approximate size of cached indexes, used by memory accounting
+    qint64 memoryUsage();
+    // Saves and drops least recently used indexes until it fits to target
+    void trim(qint64 target);
+
+    // Returns false if regex can't be answered by index. Result is a superset,
+    // callers have to match regex against records of returned days
+    bool months(const History::ContactInfo &contact, const QDir &accountDir,
+                const QRegularExpression &regex, QList<QDate> &result);
+    bool days(const History::ContactInfo &contact, const QDir &accountDir,
+              const QDate &month, const QRegularExpression &regex, QSet<QDate> &result);
+
+    static QStringList tokenize(const QString &text);
+
+private:
+    struct Stamp
+    {
+        Stamp() : size(-1), modified(-1) {}
+        qint64 size;
+        qint64 modified;
+    };
+
+    struct ContactIndex
+    {
+        ContactIndex() : dirty(false), hasTrigrams(false) {}
+        QHash<quint32, Stamp> months;
+        QHash<QString, QSet<quint32>> postings;
+        // Trigram -> words of postings containing it
+        QHash<quint64, QStringList> trigrams;
+        bool dirty;
+        bool hasTrigrams;
+    };
+
+    enum Match { ExactMatch, PrefixMatch, SuffixMatch, SubstringMatch };
+
+    ContactIndex &load(const History::ContactInfo &contact, const QDir &accountDir);
+    void validate(ContactIndex &index, const History::ContactInfo &contact, const QDir &accountDir);
+    void reindex(ContactIndex &index, quint32 month, const QString &fileName);
+    static void post(ContactIndex &index, const QString &token, quint32 day);
+    static void addTrigrams(ContactIndex &index, const QString &token);
+    static QStringList words(ContactIndex &index, const QString &token, Match match);
+    bool candidates(ContactIndex &index, const QRegularExpression &regex, QSet<quint32> &days);
+
+    struct Entry
+    {
+        History::ContactInfo contact;
+        QDir accountDir;
+        ContactIndex index;
+    };
+
+    void save(const Entry &entry);
+    static qint64 memoryUsage(const Entry &entry);
+
+    QList<Entry> m_cache;
+    QMutex m_mutex;
+};
+
+}
+
+#endif // JSONHISTORYINDEX_H
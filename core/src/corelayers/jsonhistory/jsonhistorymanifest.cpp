@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jsonhistorymanifest.h"
+#include "jsonhistory.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <qutim/debug.h>
+#include <algorithm>
+
+namespace Core
+{
+enum { ManifestMagic = 0x5148584d, ManifestVersion = 1 };
+
+static QString manifestFileName(const QDir &accountDir)
+{
+    return accountDir.filePath(QStringLiteral("index/manifest"));
+}
+
+static qint64 directoryTime(const QDir &dir)
+{
+    return QFileInfo(dir.absolutePath()).lastModified().toMSecsSinceEpoch();
+}
+
+JsonHistoryManifest::JsonHistoryManifest()
+{
+}
+
+void JsonHistoryManifest::add(const QDir &accountDir, const QString &contact, const QDate &month)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry &entry = load(accountDir);
+    QSet<quint32> &months = entry.contacts[contact];
+    const quint32 key = month.year() * 100 + month.month();
+    if (!months.contains(key)) {
+        months.insert(key);
+        entry.dirty = true;
+    }
+    // New month file has just been created by us, so there is nothing to rescan
+    const qint64 modified = directoryTime(accountDir);
+    if (entry.modified != modified) {
+        entry.modified = modified;
+        entry.dirty = true;
+    }
+}
+
+void JsonHistoryManifest::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->dirty) {
+            save(it.key(), it.value());
+            it->dirty = false;
+        }
+    }
+}
+
+bool JsonHistoryManifest::isEmpty(const QDir &accountDir)
+{
+    QMutexLocker locker(&m_mutex);
+    return load(accountDir).contacts.isEmpty();
+}
+
+QStringList JsonHistoryManifest::contacts(const QDir &accountDir)
+{
+    QMutexLocker locker(&m_mutex);
+    return load(accountDir).contacts.keys();
+}
+
+QList<QDate> JsonHistoryManifest::months(const QDir &accountDir, const QString &contact)
+{
+    QMutexLocker locker(&m_mutex);
+    QList<QDate> result;
+    foreach (quint32 key, load(accountDir).contacts.value(contact))
+        result << QDate(key / 100, key % 100, 1);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+JsonHistoryManifest::Entry &JsonHistoryManifest::load(const QDir &accountDir)
+{
+    const QString path = accountDir.absolutePath();
+    auto it = m_entries.find(path);
+    if (it == m_entries.end()) {
+        it = m_entries.insert(path, Entry());
+        QFile file(manifestFileName(accountDir));
+        if (file.open(QIODevice::ReadOnly)) {
+            QDataStream in(&file);
+            in.setVersion(QDataStream::Qt_5_0);
+            quint32 magic, version;
+            in >> magic >> version;
+            if (magic == ManifestMagic && version == ManifestVersion)
+                in >> it->modified >> it->contacts;
+            if (in.status() != QDataStream::Ok) {
+                it->modified = -1;
+                it->contacts.clear();
+            }
+        }
+    }
+
+    if (it->modified != directoryTime(accountDir))
+        rebuild(it.value(), accountDir);
+    return it.value();
+}
+
+void JsonHistoryManifest::rebuild(Entry &entry, const QDir &accountDir)
+{
+    entry.contacts.clear();
+    entry.modified = directoryTime(accountDir);
+    entry.dirty = true;
+
+    const QStringList filters = QStringList() << QStringLiteral("*.*.json") << QStringLiteral("*.*.jsonz");
+    foreach (const QString &fileName, accountDir.entryList(filters, QDir::Files | QDir::NoDotAndDotDot)) {
+        const QString date = fileName.section(QLatin1Char('.'), -2, -2);
+        if (date.length() != 6)
+            continue;
+        const QString contact = JsonHistory::unquote(fileName.section(QLatin1Char('.'), 0, -3));
+        entry.contacts[contact].insert(date.toUInt());
+    }
+}
+
+void JsonHistoryManifest::save(const QString &path, const Entry &entry)
+{
+    const QDir accountDir(path);
+    if (!accountDir.exists(QStringLiteral("index")))
+        accountDir.mkpath(QStringLiteral("index"));
+
+    QSaveFile file(manifestFileName(accountDir));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Can't save history manifest" << file.fileName();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(ManifestMagic) << quint32(ManifestVersion) << entry.modified << entry.contacts;
+    file.commit();
+}
+
+}
@@ -0,0 +1,79 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSONHISTORYMANIFEST_H
+#define JSONHISTORYMANIFEST_H
+
+#include <QDir>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+
+namespace Core
+{
+
+/**
+ * List of contacts and their months per account directory, so history
+ * window doesn't have to list and unquote thousands of month files.
+ *
+ * It is kept in "<account dir>/index/manifest" together with modification
+ * time of the account directory. Writer updates it for every written month,
+ * any other change of the directory (new month files from histman, removed
+ * files, archiving) changes the time and the manifest is rebuilt with one
+ * directory listing on next access.
+ */
+class JsonHistoryManifest
+{
+public:
+    JsonHistoryManifest();
+
+    // Called by writer for each written month file
+    void add(const QDir &accountDir, const QString &contact, const QDate &month);
+    void sync();
+
+    bool isEmpty(const QDir &accountDir);
+    QStringList contacts(const QDir &accountDir);
+    QList<QDate> months(const QDir &accountDir, const QString &contact);
+
+private:
+    struct Entry
+    {
+        Entry() : modified(-1), dirty(false) {}
+        qint64 modified;
+        QHash<QString, QSet<quint32>> contacts;
+        bool dirty;
+    };
+
+    Entry &load(const QDir &accountDir);
+    void rebuild(Entry &entry, const QDir &accountDir);
+    void save(const QString &path, const Entry &entry);
+
+    QHash<QString, Entry> m_entries;
+    QMutex m_mutex;
+};
+
+}
+
+#endif // JSONHISTORYMANIFEST_H
@@ -0,0 +1,232 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jsonhistoryreader.h"
+#include "jsonhistorydecoder.h"
+#include "jsonhistory.h"
+#include <qutim/json.h>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+static inline bool isBlank(uchar c)
+{
+    return c <= ' ';
+}
+
+JsonHistoryReverseReader::JsonHistoryReverseReader()
+    : m_map(0), m_begin(0), m_end(0), m_pos(0), m_scanned(false), m_frame(0)
+{
+}
+
+JsonHistoryReverseReader::~JsonHistoryReverseReader()
+{
+    close();
+}
+
+bool JsonHistoryReverseReader::open(const QString &fileName, const QDateTime &before)
+{
+    close();
+    if (JsonHistoryArchive::isArchive(fileName)) {
+        if (!m_archive.open(fileName))
+            return false;
+        m_frame = m_archive.frameCount();
+        if (before.isValid()) {
+            const qint64 msecs = before.toMSecsSinceEpoch();
+            while (m_frame > 0 && m_archive.firstTime(m_frame - 1) >= msecs)
+                --m_frame;
+        }
+        return nextFrame();
+    }
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() == 0)
+        return false;
+
+    m_map = m_file.map(0, m_file.size());
+    if (!m_map) {
+        m_data = m_file.readAll();
+        return setBuffer(reinterpret_cast<const uchar *>(m_data.constData()), m_data.size());
+    }
+    return setBuffer(m_map, m_file.size());
+}
+
+bool JsonHistoryReverseReader::setBuffer(const uchar *begin, qint64 size)
+{
+    m_records.clear();
+    m_scanned = false;
+    m_begin = begin;
+    m_end = m_begin + size;
+
+    const uchar *s = m_begin;
+    while (s < m_end && isBlank(*s))
+        ++s;
+    if (s == m_end || *s != '[')
+        return false;
+
+    // Skip closing bracket, it may be absent if file is being written now
+    m_pos = m_end;
+    while (m_pos > s && isBlank(*(m_pos - 1)))
+        --m_pos;
+    if (m_pos > s && *(m_pos - 1) == ']')
+        --m_pos;
+    while (m_pos > s && isBlank(*(m_pos - 1)))
+        --m_pos;
+    m_begin = s + 1;
+    return true;
+}
+
+bool JsonHistoryReverseReader::nextFrame()
+{
+    while (m_frame > 0) {
+        const QByteArray frame = m_archive.frame(--m_frame);
+        if (frame.isEmpty())
+            continue;
+        m_data = "[\n" + frame + "\n]";
+        if (setBuffer(reinterpret_cast<const uchar *>(m_data.constData()), m_data.size()))
+            return true;
+    }
+    return false;
+}
+
+void JsonHistoryReverseReader::close()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+    m_map = 0;
+    m_file.close();
+    m_data.clear();
+    m_begin = m_end = m_pos = 0;
+    m_records.clear();
+    m_scanned = false;
+    m_archive.close();
+    m_frame = 0;
+}
+
+bool JsonHistoryReverseReader::atBeginning() const
+{
+    return m_frame <= 0 && (m_scanned ? m_records.isEmpty() : m_pos <= m_begin);
+}
+
+bool JsonHistoryReverseReader::parse(const uchar *start, Message &message, const uchar **end)
+{
+    message = Message();
+    const uchar *s = JsonHistoryDecoder::decode(start, m_end - start, message);
+    if (!s) {
+        // Let k8json deal with anything unusual written by older versions
+        QVariant value;
+        int len = m_end - start;
+        s = Json::parseRecord(value, start, &len);
+        if (!s || value.type() != QVariant::Map)
+            return false;
+        message = JsonHistoryScope::toMessage(value.toMap());
+    }
+    while (s < m_end && isBlank(*s))
+        ++s;
+    *end = s;
+    return true;
+}
+
+bool JsonHistoryReverseReader::previous(Message &message)
+{
+    forever {
+        if (previousInBuffer(message))
+            return true;
+        if (!nextFrame())
+            return false;
+    }
+}
+
+bool JsonHistoryReverseReader::previousInBuffer(Message &message)
+{
+    if (m_scanned) {
+        while (!m_records.isEmpty()) {
+            const uchar *end;
+            if (parse(m_records.takeLast(), message, &end))
+                return true;
+        }
+        return false;
+    }
+
+    while (m_pos > m_begin) {
+        const uchar *s = m_pos - 1;
+        while (s >= m_begin + 3 && !(s[0] == '\n' && s[-1] == '{' && s[-2] == ' ' && s[-3] == '\n'))
+            --s;
+        if (s < m_begin + 3) {
+            fallback();
+            return previousInBuffer(message);
+        }
+
+        const uchar *start = s - 1;
+        const uchar *end;
+        if (!parse(start, message, &end) || end != m_pos) {
+            fallback();
+            return previousInBuffer(message);
+        }
+
+        // Move to the end of previous record
+        m_pos = start;
+        while (m_pos > m_begin && isBlank(*(m_pos - 1)))
+            --m_pos;
+        if (m_pos > m_begin && *(m_pos - 1) == ',')
+            --m_pos;
+        while (m_pos > m_begin && isBlank(*(m_pos - 1)))
+            --m_pos;
+        return true;
+    }
+    return false;
+}
+
+void JsonHistoryReverseReader::fallback()
+{
+    m_scanned = true;
+    m_records.clear();
+    int len = m_pos - m_begin;
+    const uchar *s = m_begin;
+    bool first = true;
+    while (s && len > 0) {
+        s = Json::skipBlanks(s, &len);
+        if (!s || len < 1 || *s == ']')
+            break;
+        if ((!first && *s != ',') || (first && *s == ','))
+            break;
+        first = false;
+        if (*s == ',') {
+            ++s;
+            --len;
+            s = Json::skipBlanks(s, &len);
+            if (!s)
+                break;
+        }
+        m_records.append(s);
+        if (!(s = Json::skipRecord(s, &len))) {
+            m_records.removeLast();
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSONHISTORYREADER_H
+#define JSONHISTORYREADER_H
+
+#include "jsonhistoryarchive.h"
+#include <QDateTime>
+#include <QFile>
+#include <qutim/message.h>
+#include <QVector>
+
+namespace Core
+{
+
+/**
+ * Reads records of JsonHistory month file from the end to the beginning.
+ *
+ * JsonHistory writes every record as " {\n ... \n }" and all line breaks
+ * inside of values are escaped, so the record boundaries can be found by
+ * scanning backward for "\n {\n" without parsing everything before them.
+ * Files of other layout are handled by collecting record offsets once with
+ * forward scan.
+ *
+ * Archived months are read frame by frame, frames with records not older
+ * than the "before" time passed to open() are not decompressed at all.
+ */
+class JsonHistoryReverseReader
+{
+public:
+    JsonHistoryReverseReader();
+    ~JsonHistoryReverseReader();
+
+    bool open(const QString &fileName, const QDateTime &before = QDateTime());
+    void close();
+    bool atBeginning() const;
+
+    // Returns false if there are no more records
+    bool previous(qutim_sdk_0_3::Message &message);
+
+private:
+    bool setBuffer(const uchar *begin, qint64 size);
+    bool nextFrame();
+    bool previousInBuffer(qutim_sdk_0_3::Message &message);
+    bool parse(const uchar *start, qutim_sdk_0_3::Message &message, const uchar **end);
+    void fallback();
+
+    QFile m_file;
+    QByteArray m_data;
+    uchar *m_map;
+    const uchar *m_begin;
+    const uchar *m_end;
+    const uchar *m_pos;
+    QVector<const uchar *> m_records;
+    bool m_scanned;
+    JsonHistoryArchive m_archive;
+    int m_frame;
+};
+
+}
+
+#endif // JSONHISTORYREADER_H
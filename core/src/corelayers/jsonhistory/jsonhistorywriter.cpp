@@ -0,0 +1,424 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jsonhistorywriter.h"
+#include "jsonhistory.h"
+#include "jsonhistoryarchive.h"
+#include <qutim/json.h>
+#include <qutim/debug.h>
+#include <qutim/metrics.h>
+#include <qutim/memoryaccounting.h>
+#include <QElapsedTimer>
+#include <QMap>
+
+#if defined(Q_OS_WIN)
+# include <windows.h>
+# include <io.h>
+#elif defined(Q_OS_UNIX)
+# include <unistd.h>
+#endif
+
+namespace Core
+{
+static Gauge *queueDepthGauge()
+{
+    static Gauge *gauge = Metrics::gauge("qutim_history_queue_depth", QStringLiteral("backend=\"json\""));
+    return gauge;
+}
+
+static qint64 batchSize(const MessageList &messages)
+{
+    qint64 result = 0;
+    foreach (const Message &message, messages)
+        result += MemoryAccounting::messageSize(message);
+    return result;
+}
+
+static void syncFile(QFile *file)
+{
+    file->flush();
+#if defined(Q_OS_WIN)
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file->handle())));
+#elif defined(Q_OS_UNIX)
+    ::fsync(file->handle());
+#endif
+}
+
+static void appendRecord(Json::Writer &out, const Message &message)
+{
+    out.append(" {\n", 3);
+    foreach (const QByteArray &name, message.dynamicPropertyNames()) {
+        const qint64 size = out.size();
+        out.append("  ", 2).quote(name).append(": ", 2);
+        if (!out.generate(message.property(name), 2)) {
+            out.truncate(size);
+            continue;
+        }
+        out.append(",\n", 2);
+    }
+    out.append("  \"datetime\": \"");
+    QDateTime time = message.time();
+    if (!time.isValid())
+        time = QDateTime::currentDateTime();
+    out.append(time.toString(Qt::ISODate).toLatin1());
+    out.append("\",\n  \"in\": ");
+    out.append(message.isIncoming() ? "true" : "false");
+    out.append(",\n  \"text\": ");
+    out.quote(message.text());
+    out.append(",\n  \"html\": ");
+    out.quote(message.html());
+    out.append("\n }", 3);
+//	It will produce something like this:
+//	{
+//	 "datetime": "2009-06-20T01:42:22",
+//	 "type": 1,
+//	 "in": true,
+//	 "text": "some cool text"
+//	}
+}
+
+JsonHistoryWriter::JsonHistoryWriter(JsonHistoryScope *scope, int flushInterval, int maxOpenFiles)
+    : m_scope(scope), m_flushInterval(flushInterval), m_maxOpenFiles(qMax(1, maxOpenFiles)),
+      m_batchBytes(0), m_quit(false), m_flushRequested(false), m_writing(false)
+{
+    m_statistics.queueDepth = 0;
+    m_statistics.lastFlushLatency = 0;
+    m_statistics.maxFlushLatency = 0;
+    m_statistics.flushCount = 0;
+    m_statistics.messageCount = 0;
+}
+
+JsonHistoryWriter::~JsonHistoryWriter()
+{
+    stop();
+}
+
+void JsonHistoryWriter::enqueue(const History::ContactInfo &contact, const Message &message)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue << qMakePair(contact, message);
+    m_statistics.queueDepth = m_queue.size();
+    queueDepthGauge()->set(m_queue.size());
+    if (m_queue.size() == 1)
+        m_condition.wakeOne();
+}
+
+void JsonHistoryWriter::enqueueBatch(const History::ContactInfo &contact, const MessageList &messages)
+{
+    if (messages.isEmpty())
+        return;
+    const qint64 size = batchSize(messages);
+    QMutexLocker locker(&m_mutex);
+    // Single batch is always accepted, even if it's larger than the limit
+    while (m_batchBytes > 0 && m_batchBytes + size > MaxBatchBytes && isRunning() && !m_quit) {
+        m_flushRequested = true;
+        m_condition.wakeOne();
+        m_batchesFreed.wait(&m_mutex);
+    }
+    m_batches << qMakePair(contact, messages);
+    m_batchBytes += size;
+    m_condition.wakeOne();
+}
+
+void JsonHistoryWriter::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!isRunning())
+        return;
+    while (!m_queue.isEmpty() || !m_batches.isEmpty() || m_writing) {
+        m_flushRequested = true;
+        m_condition.wakeOne();
+        m_flushed.wait(&m_mutex);
+    }
+}
+
+void JsonHistoryWriter::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_quit = true;
+        m_condition.wakeOne();
+    }
+    wait();
+}
+
+void JsonHistoryWriter::forget(const QString &fileName)
+{
+    for (int i = 0; i < m_handles.size(); ++i) {
+        if (m_handles.at(i).fileName == fileName) {
+            delete m_handles.at(i).file;
+            m_handles.removeAt(i);
+            return;
+        }
+    }
+}
+
+JsonHistoryWriter::Statistics JsonHistoryWriter::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_statistics;
+}
+
+void JsonHistoryWriter::run()
+{
+    QMutexLocker locker(&m_mutex);
+    forever {
+        while (m_queue.isEmpty() && m_batches.isEmpty() && !m_quit)
+            m_condition.wait(&m_mutex);
+        if (m_queue.isEmpty() && m_batches.isEmpty() && m_quit)
+            break;
+
+        // Give some time for other messages to come, so they are written together
+        QElapsedTimer timer;
+        timer.start();
+        while (!m_quit && !m_flushRequested) {
+            const qint64 left = m_flushInterval - timer.elapsed();
+            if (left <= 0)
+                break;
+            m_condition.wait(&m_mutex, left);
+        }
+
+        QList<Item> items;
+        items.reserve(m_queue.size());
+        for (const Item &item : m_queue)
+            items << item;
+        m_queue.clear();
+        QList<Batch> batches;
+        batches.swap(m_batches);
+        const qint64 merged = m_batchBytes;
+        m_statistics.queueDepth = 0;
+        queueDepthGauge()->set(0);
+        m_flushRequested = false;
+        m_writing = true;
+        locker.unlock();
+
+        timer.restart();
+        {
+            QMutexLocker fileLocker(&m_scope->fileLock);
+            // Batches are merged first, so realtime messages for the same months
+            // are appended after imported ones
+            if (!batches.isEmpty())
+                merge(batches);
+            if (!items.isEmpty())
+                write(items);
+        }
+        const int latency = timer.elapsed();
+
+        locker.relock();
+        if (!batches.isEmpty()) {
+            // Merged messages are released before producers are woken up
+            batches.clear();
+            m_batchBytes -= merged;
+            m_batchesFreed.wakeAll();
+        }
+        m_writing = false;
+        m_statistics.lastFlushLatency = latency;
+        m_statistics.maxFlushLatency = qMax(m_statistics.maxFlushLatency, latency);
+        m_statistics.flushCount++;
+        m_statistics.messageCount += items.size();
+        if (m_queue.isEmpty() && m_batches.isEmpty())
+            m_flushed.wakeAll();
+    }
+    locker.unlock();
+    {
+        QMutexLocker fileLocker(&m_scope->fileLock);
+        closeHandles();
+    }
+
+    locker.relock();
+    m_flushed.wakeAll();
+    m_batchesFreed.wakeAll();
+}
+
+void JsonHistoryWriter::write(const QList<Item> &items)
+{
+    // Group messages by file keeping their order within each group
+    QMap<QString, QList<Message>> groups;
+    QMap<QString, History::ContactInfo> contacts;
+    for (const Item &item : items) {
+        QDate date = item.second.time().date();
+        if (!date.isValid())
+            date = QDate::currentDate();
+        const QString fileName = m_scope->getFileName(item.first, date);
+        groups[fileName] << item.second;
+        contacts.insert(fileName, item.first);
+    }
+
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it) {
+        Handle *h = handle(it.key());
+        if (!h)
+            continue;
+
+        const QList<Message> &messages = it.value();
+        QByteArray data;
+        data.reserve(messages.size() * 256);
+        qint64 end;
+        {
+            Json::Writer out(&data);
+            out.append(h->end == 0 ? "[\n" : ",\n", 2);
+            for (int i = 0; i < messages.size(); ++i) {
+                if (i > 0)
+                    out.append(",\n", 2);
+                appendRecord(out, messages.at(i));
+            }
+            end = h->end + out.size();
+            out.append("\n]", 2);
+        }
+
+        h->file->seek(h->end);
+        if (h->file->write(data) != data.size()) {
+            qWarning() << "Can't write history to" << h->fileName << h->file->errorString();
+            h->end = -1;
+            continue;
+        }
+        if (h->file->size() > h->end + data.size())
+            h->file->resize(h->end + data.size());
+        syncFile(h->file);
+        h->end = end;
+
+        const History::ContactInfo contact = contacts.value(it.key());
+        const QDir accountDir = m_scope->getAccountDir(contact);
+        QDate month = messages.first().time().date();
+        if (!month.isValid())
+            month = QDate::currentDate();
+        m_scope->index.add(contact, accountDir, month, messages);
+        m_scope->manifest.add(accountDir, contact.contact, month);
+    }
+    m_scope->index.sync();
+    m_scope->manifest.sync();
+}
+
+void JsonHistoryWriter::merge(const QList<Batch> &batches)
+{
+    QMap<QString, MessageList> groups;
+    QMap<QString, History::ContactInfo> contacts;
+    for (const Batch &batch : batches) {
+        for (const Message &message : batch.second) {
+            QDate date = message.time().date();
+            if (!date.isValid())
+                continue;
+            const QString fileName = m_scope->getFileName(batch.first, date);
+            groups[fileName] << message;
+            contacts.insert(fileName, batch.first);
+        }
+    }
+
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
+        const QString &fileName = it.key();
+        MessageList existing;
+        if (QFile::exists(fileName)) {
+            JsonHistoryScope::readRecords(fileName, [&existing] (const QVariantMap &record) {
+                existing << JsonHistoryScope::toMessage(record);
+            });
+        }
+
+        const MessageList unique = History::merge(existing, it.value());
+        if (unique.size() == existing.size())
+            continue;
+
+        Handle *h = handle(fileName);
+        if (!h)
+            continue;
+
+        QByteArray data;
+        data.reserve(unique.size() * 256);
+        qint64 end;
+        {
+            Json::Writer out(&data);
+            out.append("[\n", 2);
+            for (int i = 0; i < unique.size(); ++i) {
+                if (i > 0)
+                    out.append(",\n", 2);
+                appendRecord(out, unique.at(i));
+            }
+            end = out.size();
+            out.append("\n]", 2);
+        }
+
+        h->file->seek(0);
+        if (h->file->write(data) != data.size()) {
+            qWarning() << "Can't write history to" << h->fileName << h->file->errorString();
+            h->end = -1;
+            continue;
+        }
+        h->file->resize(data.size());
+        syncFile(h->file);
+        h->end = end;
+
+        const History::ContactInfo contact = contacts.value(fileName);
+        const QDir accountDir = m_scope->getAccountDir(contact);
+        m_scope->index.add(contact, accountDir, unique.first().time().date(), unique);
+        m_scope->manifest.add(accountDir, contact.contact, unique.first().time().date());
+    }
+    m_scope->index.sync();
+    m_scope->manifest.sync();
+}
+
+JsonHistoryWriter::Handle *JsonHistoryWriter::handle(const QString &fileName)
+{
+    for (int i = 0; i < m_handles.size(); ++i) {
+        Handle &h = m_handles[i];
+        if (h.fileName != fileName)
+            continue;
+        // File was changed by somebody else, find its end again
+        if (h.end < 0 || (h.end > 0 ? h.file->size() != h.end + 2 : h.file->size() != 0))
+            h.end = h.file->size() == 0 ? 0 : m_scope->findEnd(*h.file);
+        m_handles.move(i, 0);
+        return &m_handles.first();
+    }
+
+    while (m_handles.size() >= m_maxOpenFiles) {
+        delete m_handles.last().file;
+        m_handles.removeLast();
+    }
+
+    // Messages for already archived month, unpack it to append them
+    const QString archiveName = JsonHistoryArchive::archiveName(fileName);
+    if (!QFile::exists(fileName) && QFile::exists(archiveName))
+        JsonHistoryArchive::extract(archiveName, fileName);
+
+    QFile *file = new QFile(fileName);
+    if (!file->open(QIODevice::ReadWrite)) {
+        qWarning() << "Can't open history file" << fileName << file->errorString();
+        delete file;
+        return 0;
+    }
+
+    Handle h;
+    h.fileName = fileName;
+    h.file = file;
+    h.end = file->size() == 0 ? 0 : m_scope->findEnd(*file);
+    m_handles.prepend(h);
+    return &m_handles.first();
+}
+
+void JsonHistoryWriter::closeHandles()
+{
+    for (const Handle &h : m_handles)
+        delete h.file;
+    m_handles.clear();
+}
+
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSONHISTORYWRITER_H
+#define JSONHISTORYWRITER_H
+
+#include <qutim/history.h>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QLinkedList>
+#include <QFile>
+
+namespace Core
+{
+class JsonHistoryScope;
+
+/**
+ * Dedicated thread which stores messages to JsonHistory files.
+ *
+ * Messages are collected for flushInterval milliseconds, so floods of
+ * conference messages end up as one write and one fsync per month file.
+ * Recently used files are kept open together with the offset of their
+ * closing bracket, so no file has to be rescanned on append.
+ */
+class JsonHistoryWriter : public QThread
+{
+    Q_OBJECT
+public:
+    struct Statistics
+    {
+        int queueDepth;
+        int lastFlushLatency;
+        int maxFlushLatency;
+        qint64 flushCount;
+        qint64 messageCount;
+    };
+
+    enum { MaxBatchBytes = 16 * 1024 * 1024 };
+
+    JsonHistoryWriter(JsonHistoryScope *scope, int flushInterval, int maxOpenFiles);
+    ~JsonHistoryWriter();
+
+    void enqueue(const History::ContactInfo &contact, const Message &message);
+    // Messages are merged into existing files instead of being appended.
+    // Blocks while queued batches hold more than MaxBatchBytes, so bulk
+    // imports are not buffered as a whole
+    void enqueueBatch(const History::ContactInfo &contact, const MessageList &messages);
+    // Wakes up the thread and blocks until everything queued is written
+    void flush();
+    void stop();
+    // Closes handle of file, which is going to be replaced. Caller must
+    // hold JsonHistoryScope::fileLock
+    void forget(const QString &fileName);
+
+    Statistics statistics() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Handle
+    {
+        QString fileName;
+        QFile *file;
+        qint64 end;
+    };
+
+    typedef QPair<History::ContactInfo, Message> Item;
+    typedef QPair<History::ContactInfo, MessageList> Batch;
+
+    void write(const QList<Item> &items);
+    void merge(const QList<Batch> &batches);
+    Handle *handle(const QString &fileName);
+    void closeHandles();
+
+    JsonHistoryScope *m_scope;
+    const int m_flushInterval;
+    const int m_maxOpenFiles;
+    QList<Handle> m_handles;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QWaitCondition m_flushed;
+    QWaitCondition m_batchesFreed;
+    QLinkedList<Item> m_queue;
+    QList<Batch> m_batches;
+    // Approximate size of queued and being merged batches
+    qint64 m_batchBytes;
+    bool m_quit;
+    bool m_flushRequested;
+    bool m_writing;
+    Statistics m_statistics;
+};
+
+}
+
+#endif // JSONHISTORYWRITER_H
@@ -31,12 +31,7 @@
 #include "qgraphicsscene.h"
 #include "qgraphicssceneevent.h"
 #include "qgraphicsview.h"
-#if (QT_VERSION < QT_VERSION_CHECK(4, 7, 0))
-#  include <QTime>
-typedef QTime QElapsedTimer;
-#else
-#  include <QElapsedTimer>
-#endif
+#include <QElapsedTimer>
 #include "qtscroller.h"
 #include "qtflickgesture_p.h"
 #include "qdebug.h"
@@ -313,7 +308,7 @@ private:
 */
 QtFlickGesture::QtFlickGesture(QObject *receiver_, Qt::MouseButton button, QObject *parent)
     : QGesture(parent), receiver(receiver_), receiverScroller(0), button(button),
-      macIgnoreWheel(false)
+      macIgnoreWheel(false), eventTimeOffset(0), hasEventTimeOffset(false)
 {
 	receiverScroller = (receiver && QtScroller::hasScroller(receiver.data())) ? QtScroller::scroller(receiver.data()) : 0;
 }
@@ -594,8 +589,21 @@ QGestureRecognizer::Result QtFlickGestureRecognizer::recognize(QGesture *state,
         } else if (receiverGraphicsObject) {
             point = receiverGraphicsObject->mapFromScene(point);
         }
+        // Delivery time jitters when events are queued or compressed, so
+        // velocity is sampled by device timestamps where platform has them.
+        // They are shifted to the monotonic clock once per gesture to keep
+        // deltas exact and fallback to delivery time possible.
+        qint64 timestamp = monotonicTimer.elapsed();
+        const ulong eventTime = me ? me->timestamp() : te ? te->timestamp() : 0;
+        if (eventTime) {
+            if (inputType == QtScroller::InputPress || !d->hasEventTimeOffset) {
+                d->eventTimeOffset = timestamp - qint64(eventTime);
+                d->hasEventTimeOffset = true;
+            }
+            timestamp = qint64(eventTime) + d->eventTimeOffset;
+        }
         // inform the scroller about the new event
-        scroller->handleInput(inputType, point, monotonicTimer.elapsed());
+        scroller->handleInput(inputType, point, timestamp);
     }
 
     // depending on the scroller state return the gesture state
@@ -67,6 +67,9 @@ private:
     // QWidget::mapFromGlobal is very expensive on X11, so we cache the global position of the widget
 	QPointer<QWidget> receiverWindow;
     QPoint receiverWindowPos;
+    // difference between monotonic clock and device timestamps of events
+    qint64 eventTimeOffset;
+    bool hasEventTimeOffset;
 
     static PressDelayHandler *pressDelayHandler;
 
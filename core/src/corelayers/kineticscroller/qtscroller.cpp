@@ -41,6 +41,8 @@
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QDesktopWidget>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QtCore/qmath.h>
 #include <qevent.h>
 #include <qnumeric.h>
@@ -189,7 +191,7 @@ class QScrollTimer : public QAbstractAnimation
 {
 public:
     QScrollTimer(QtScrollerPrivate *_d)
-        : d(_d), ignoreUpdate(false), skip(0)
+        : d(_d), ignoreUpdate(false), nextFrame(0), tolerance(0)
     { }
 
     int duration() const
@@ -197,6 +199,11 @@ public:
         return -1;
     }
 
+    bool isRunning() const
+    {
+        return state() == QAbstractAnimation::Running;
+    }
+
     void start()
     {
         // QAbstractAnimation::start() will immediately call
@@ -204,24 +211,39 @@ public:
         ignoreUpdate = true;
         QAbstractAnimation::start();
         ignoreUpdate = false;
-        skip = 0;
+        nextFrame = 0;
+
+        // animation ticks follow the screen refresh, so allow every frame
+        // to come up to half of refresh period earlier
+        QScreen *screen = QGuiApplication::primaryScreen();
+        const qreal refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : qreal(60);
+        tolerance = qreal(500) / refreshRate;
     }
 
 protected:
-    void updateCurrentTime(int /*currentTime*/)
+    void updateCurrentTime(int currentTime)
     {
-        if (!ignoreUpdate) {
-            if (++skip >= d->frameRateSkip()) {
-                skip = 0;
-                d->timerTick();
-            }
+        if (ignoreUpdate)
+            return;
+
+        // frames are picked by elapsed time and not by counting ticks,
+        // so pacing stays even if the driver is faster than 60 Hz or skips
+        const qreal interval = d->frameInterval();
+        if (interval > 0) {
+            if (currentTime < nextFrame - tolerance)
+                return;
+            nextFrame += interval;
+            if (nextFrame <= currentTime)
+                nextFrame = currentTime + interval;
         }
+        d->timerTick();
     }
 
 private:
     QtScrollerPrivate *d;
     bool ignoreUpdate;
-    int skip;
+    qreal nextFrame;
+    qreal tolerance;
 };
 
 /*!
@@ -1536,6 +1558,8 @@ void QtScrollerPrivate::handleDrag(const QPointF &position, qint64 timestamp)
 //    } else {
     dragDistance += deltaPixel;
 //    }
+    if (state == QtScroller::Dragging && dragDistance != QPointF(0, 0) && !scrollTimer->isRunning())
+        scrollTimer->start();
 //qScrollerDebug() << "######################" << deltaPixel << position.y() << lastPosition.y();
     if (canScrollX)
         lastPosition.setX(position.x());
@@ -1635,6 +1659,9 @@ void QtScrollerPrivate::timerEventWhileDragging()
 
         setContentPositionHelperDragging(-dragDistance);
         dragDistance = QPointF(0, 0);
+    } else {
+        // finger rests, handleDrag() restarts the timer on next move
+        scrollTimer->stop();
     }
 }
 
@@ -42,12 +42,7 @@
 #include <QQueue>
 #include <QSet>
 #include <QEasingCurve>
-#if (QT_VERSION < QT_VERSION_CHECK(4, 7, 0))
-#  include <QTime>
-typedef QTime QElapsedTimer;
-#else
-#  include <QElapsedTimer>
-#endif
+#include <QElapsedTimer>
 #include <QSizeF>
 #include <QPointF>
 #include <QRectF>
@@ -123,7 +118,8 @@ public:
     qreal nextSnapPos(qreal p, int dir, Qt::Orientation orientation);
     static qreal nextSegmentPosition(QQueue<ScrollSegment> &segments, qint64 now, qreal oldPos);
 
-    inline int frameRateSkip() const { return properties.d.data()->frameRate; }
+    // FrameRates values are divisors of 60 Hz, Standard means every animation tick
+    inline qreal frameInterval() const { return properties.d.data()->frameRate * qreal(1000) / qreal(60); }
 
     static const char *stateName(QtScroller::State state);
     static const char *inputName(QtScroller::Input input);
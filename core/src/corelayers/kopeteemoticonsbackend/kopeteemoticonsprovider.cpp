@@ -28,6 +28,16 @@
 #include <QDomDocument>
 #include <QDir>
 #include <QDebug>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QImageReader>
+#include <QSaveFile>
+#include <qutim/systeminfo.h>
+
+using namespace qutim_sdk_0_3;
+
+enum { CacheMagic = 0x4b454d43, CacheVersion = 1 };
 
 KopeteEmoticonsProvider::KopeteEmoticonsProvider(const QString& themePath)
 : m_theme_path(themePath)
@@ -49,6 +59,9 @@ KopeteEmoticonsProvider::KopeteEmoticonsProvider()
 
 void KopeteEmoticonsProvider::getThemeName()
 {
+	// Themes are listed often, so don't parse xml just for the title
+	if (readCache(true))
+		return;
 	QDir dir (m_theme_path);
 	QFile file(m_theme_path + "/emoticons.xml");
 	if (!file.open(QIODevice::ReadOnly))
@@ -66,8 +79,85 @@ void KopeteEmoticonsProvider::setThemePath(const QString& themePath)
 	getThemeName();
 }
 
+QString KopeteEmoticonsProvider::cacheFileName() const
+{
+	const QByteArray hash = QCryptographicHash::hash(m_theme_path.toUtf8(), QCryptographicHash::Sha1);
+	return SystemInfo::getDir(SystemInfo::ConfigDir).filePath(QLatin1String("cache/emoticons/")
+															  + QLatin1String(hash.toHex()));
+}
+
+bool KopeteEmoticonsProvider::readCache(bool nameOnly)
+{
+	QFile file(cacheFileName());
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	// Whole theme is read from single mapping without copying it
+	uchar *data = file.map(0, file.size());
+	if (!data)
+		return false;
+	const QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(data), file.size());
+	QDataStream in(raw);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, version;
+	QString path, name;
+	qint64 xmlModified, dirModified;
+	in >> magic >> version;
+	if (magic != CacheMagic || version != CacheVersion)
+		return false;
+	in >> path >> xmlModified >> dirModified >> name;
+	// Theme is changed if its emoticons.xml is edited or files are added or removed
+	if (in.status() != QDataStream::Ok
+			|| path != m_theme_path
+			|| xmlModified != QFileInfo(m_theme_path + "/emoticons.xml").lastModified().toMSecsSinceEpoch()
+			|| dirModified != QFileInfo(m_theme_path).lastModified().toMSecsSinceEpoch()) {
+		return false;
+	}
+	if (nameOnly) {
+		m_theme_name = name;
+		return true;
+	}
+
+	quint32 count;
+	in >> count;
+	QList<CachedEmoticon> emoticons;
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		CachedEmoticon emoticon;
+		in >> emoticon.path >> emoticon.size >> emoticon.codes;
+		emoticons << emoticon;
+	}
+	if (in.status() != QDataStream::Ok)
+		return false;
+
+	m_theme_name = name;
+	foreach (const CachedEmoticon &emoticon, emoticons)
+		appendEmoticon(emoticon.path, emoticon.size, emoticon.codes);
+	return true;
+}
+
+void KopeteEmoticonsProvider::writeCache(const QList<CachedEmoticon> &emoticons)
+{
+	const QString fileName = cacheFileName();
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint32(CacheMagic) << quint32(CacheVersion) << m_theme_path
+		<< QFileInfo(m_theme_path + "/emoticons.xml").lastModified().toMSecsSinceEpoch()
+		<< QFileInfo(m_theme_path).lastModified().toMSecsSinceEpoch()
+		<< m_theme_name << quint32(emoticons.size());
+	foreach (const CachedEmoticon &emoticon, emoticons)
+		out << emoticon.path << emoticon.size << emoticon.codes;
+	file.commit();
+}
+
 void KopeteEmoticonsProvider::loadTheme()
 {
+	if (readCache(false))
+		return;
+
 	QDir dir (m_theme_path);
 	QFileInfoList fileList = dir.entryInfoList(QDir::Files);
 	QMap<QString, QString> files;
@@ -89,6 +179,7 @@ void KopeteEmoticonsProvider::loadTheme()
 	QDomElement rootElement = doc.documentElement();
 	int emoticonCount = rootElement.childNodes().count();
 	QDomElement emoticon = rootElement.firstChild().toElement();
+	QList<CachedEmoticon> cached;
 	for (int i = 0; i < emoticonCount; ++i) {
 		if (emoticon.tagName() == QLatin1String("emoticon")) {
 			QString fileName = files.value(emoticon.attribute(QLatin1String("file")));
@@ -101,11 +192,20 @@ void KopeteEmoticonsProvider::loadTheme()
 						strings.append(emoticonString.text());
 					emoticonString = emoticonString.nextSibling().toElement();
 				}
-				appendEmoticon(fileName, strings);
+				QImageReader reader(fileName);
+				QSize size = reader.size();
+				if (!size.isValid())
+					size = reader.read().size();
+				if (size.isValid() && !strings.isEmpty()) {
+					CachedEmoticon entry = { fileName, size, strings };
+					cached << entry;
+					appendEmoticon(fileName, size, strings);
+				}
 			}
 		}
 		emoticon = emoticon.nextSibling().toElement();
 	}
+	writeCache(cached);
 }
 
 bool KopeteEmoticonsProvider::addEmoticon(const QString& imgPath, const QStringList& codes)
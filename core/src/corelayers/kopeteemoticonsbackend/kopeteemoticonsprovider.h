@@ -40,7 +40,18 @@ public:
 	void loadTheme();
 	void setThemePath(const QString& themePath);
 private:
+	struct CachedEmoticon
+	{
+		QString path;
+		QSize size;
+		QStringList codes;
+	};
+
 	void getThemeName();
+	QString cacheFileName() const;
+	// Loads theme compiled by previous loadTheme() if it's still up to date
+	bool readCache(bool nameOnly);
+	void writeCache(const QList<CachedEmoticon> &emoticons);
 	QString m_theme_name;
 	QString m_theme_path;
 };
@@ -0,0 +1,123 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "catalogtranslator.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <qutim/debug.h>
+
+namespace Core
+{
+CatalogTranslator::CatalogTranslator(QObject *parent) : QTranslator(parent)
+{
+}
+
+CatalogTranslator::~CatalogTranslator()
+{
+	// Translators refer to the mapped memory, so they go first
+	foreach (const Catalog &catalog, m_catalogs) {
+		delete catalog.translator;
+		delete catalog.file;
+	}
+}
+
+void CatalogTranslator::addCatalog(const QString &fileName)
+{
+	QMutexLocker locker(&m_mutex);
+	Catalog catalog;
+	catalog.fileName = fileName;
+	m_catalogs << catalog;
+	m_strings.clear();
+}
+
+QString CatalogTranslator::translate(const char *context, const char *sourceText,
+									 const char *disambiguation, int n) const
+{
+	QMutexLocker locker(&m_mutex);
+	QByteArray key(context);
+	key += '\0';
+	key += sourceText;
+	if (disambiguation) {
+		key += '\0';
+		key += disambiguation;
+	}
+
+	QHash<QByteArray, int>::const_iterator it = m_strings.constFind(key);
+	if (it != m_strings.constEnd()) {
+		if (it.value() < 0)
+			return QString();
+		return catalog(it.value())->translate(context, sourceText, disambiguation, n);
+	}
+
+	for (int i = 0; i < m_catalogs.size(); ++i) {
+		QTranslator *translator = catalog(i);
+		if (!translator)
+			continue;
+		const QString result = translator->translate(context, sourceText, disambiguation, n);
+		if (!result.isNull()) {
+			m_strings.insert(key, i);
+			return result;
+		}
+	}
+	m_strings.insert(key, -1);
+	return QString();
+}
+
+bool CatalogTranslator::isEmpty() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_catalogs.isEmpty();
+}
+
+QTranslator *CatalogTranslator::catalog(int index) const
+{
+	Catalog &catalog = m_catalogs[index];
+	if (catalog.loaded)
+		return catalog.translator;
+	catalog.loaded = true;
+
+	QFile *file = new QFile(catalog.fileName);
+	QTranslator *translator = new QTranslator;
+	const QString directory = QFileInfo(catalog.fileName).absolutePath();
+	bool ok = false;
+	if (file->open(QIODevice::ReadOnly)) {
+		// Mapped data must live as long as the translator does
+		if (uchar *data = file->map(0, file->size()))
+			ok = translator->load(data, int(file->size()), directory);
+		else
+			ok = translator->load(catalog.fileName);
+	}
+	if (!ok) {
+		qWarning() << "Can't load translation" << catalog.fileName;
+		delete translator;
+		delete file;
+		return 0;
+	}
+	catalog.file = file;
+	catalog.translator = translator;
+	return translator;
+}
+}
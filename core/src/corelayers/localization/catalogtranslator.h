@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef CATALOGTRANSLATOR_H
+#define CATALOGTRANSLATOR_H
+
+#include <QTranslator>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+
+class QFile;
+
+namespace Core
+{
+// Translator for set of .qm catalogs of one language, catalogs are memory
+// mapped only when some lookup reaches them and every found string
+// remembers its catalog, so the application walks one translator instead
+// of dozens of them
+class CatalogTranslator : public QTranslator
+{
+	Q_OBJECT
+public:
+	CatalogTranslator(QObject *parent = 0);
+	~CatalogTranslator();
+
+	// Catalogs added first are asked first
+	void addCatalog(const QString &fileName);
+
+	virtual QString translate(const char *context, const char *sourceText,
+							  const char *disambiguation = 0, int n = -1) const;
+	virtual bool isEmpty() const;
+
+private:
+	struct Catalog
+	{
+		Catalog() : file(0), translator(0), loaded(false) {}
+		QString fileName;
+		QFile *file;
+		QTranslator *translator;
+		bool loaded;
+	};
+
+	QTranslator *catalog(int index) const;
+
+	mutable QMutex m_mutex;
+	mutable QList<Catalog> m_catalogs;
+	// Index of catalog which has the string, -1 if there is no one
+	mutable QHash<QByteArray, int> m_strings;
+};
+}
+
+#endif // CATALOGTRANSLATOR_H
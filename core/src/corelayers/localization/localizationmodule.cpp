@@ -25,6 +25,7 @@
 
 #include "localizationmodule.h"
 #include "localizationsettings.h"
+#include "catalogtranslator.h"
 #include <qutim/settingslayer.h>
 #include <qutim/systeminfo.h>
 #include <qutim/icon.h>
@@ -150,19 +151,13 @@ void LocalizationModule::loadLanguage(const QStringList &langs)
 			translators << translator;
 		}
 	}
-	// And our local translations afterwords
+	// And our local translations afterwords, catalogs are loaded only
+	// when the first string is looked up in them
+	CatalogTranslator *catalogs = new CatalogTranslator(qApp);
 	foreach (const QDir &dir, paths) {
 		QStringList files = dir.entryList(QStringList() << "*.qm", QDir::Files);
-
-		foreach (const QString &file, files) {
-			QTranslator *translator = new QTranslator(qApp);
-			if (!translator->load(file, dir.absolutePath())) {
-				delete translator;
-			} else {
-				qApp->installTranslator(translator);
-				translators << translator;
-			}
-		}
+		foreach (const QString &file, files)
+			catalogs->addCatalog(dir.filePath(file));
 
 		files = dir.entryList(QStringList() << "*.rcc", QDir::Files);
 		foreach (const QString &file, files) {
@@ -170,6 +165,12 @@ void LocalizationModule::loadLanguage(const QStringList &langs)
 				authorsCache()->append(file);
 		}
 	}
+	if (catalogs->isEmpty()) {
+		delete catalogs;
+	} else {
+		qApp->installTranslator(catalogs);
+		translators << catalogs;
+	}
 }
 }
 
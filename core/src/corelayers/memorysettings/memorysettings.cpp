@@ -0,0 +1,148 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "memorysettings.h"
+#include <qutim/settingslayer.h>
+#include <qutim/icon.h>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QFormLayout>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTimer>
+
+namespace Core {
+
+enum { TopConsumers = 50 };
+
+static QString formatSize(qint64 bytes)
+{
+	if (bytes < 1024 * 1024)
+		return QCoreApplication::translate("MemorySettingsWidget", "%1 KiB").arg(bytes / 1024.0, 0, 'f', 1);
+	return QCoreApplication::translate("MemorySettingsWidget", "%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+MemorySettingsWidget::MemorySettingsWidget() :
+	m_changed(false)
+{
+	QVBoxLayout *layout = new QVBoxLayout(this);
+	m_usage = new QTreeWidget(this);
+	m_usage->setRootIsDecorated(false);
+	m_usage->setHeaderLabels(QStringList() << tr("Subsystem") << tr("Owner") << tr("Size"));
+	m_usage->header()->setSectionResizeMode(1, QHeaderView::Stretch);
+	layout->addWidget(m_usage);
+
+	QFormLayout *budgetsLayout = new QFormLayout();
+	for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i) {
+		const MemoryAccounting::Subsystem subsystem = static_cast<MemoryAccounting::Subsystem>(i);
+		QSpinBox *box = new QSpinBox(this);
+		box->setRange(0, 4096);
+		box->setSuffix(tr(" MiB"));
+		box->setSpecialValueText(tr("Unlimited"));
+		connect(box, SIGNAL(valueChanged(int)), SLOT(onChanged()));
+		budgetsLayout->addRow(tr("%1 limit:").arg(MemoryAccounting::subsystemTitle(subsystem)), box);
+		m_budgets[i] = box;
+	}
+	layout->addLayout(budgetsLayout);
+
+	QPushButton *trimButton = new QPushButton(tr("Apply limits now"), this);
+	connect(trimButton, SIGNAL(clicked()), SLOT(onTrimClicked()));
+	layout->addWidget(trimButton, 0, Qt::AlignRight);
+
+	m_usageTimer = new QTimer(this);
+	m_usageTimer->setInterval(5000);
+	connect(m_usageTimer, SIGNAL(timeout()), SLOT(updateUsage()));
+	m_usageTimer->start();
+	updateUsage();
+}
+
+void MemorySettingsWidget::clearState()
+{
+	m_changed = false;
+	setModified(false);
+}
+
+void MemorySettingsWidget::loadImpl()
+{
+	for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i) {
+		const qint64 budget = MemoryAccounting::budget(static_cast<MemoryAccounting::Subsystem>(i));
+		m_budgets[i]->setValue(int((budget + 1024 * 1024 - 1) / (1024 * 1024)));
+	}
+	clearState();
+}
+
+void MemorySettingsWidget::saveImpl()
+{
+	for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i) {
+		MemoryAccounting::setBudget(static_cast<MemoryAccounting::Subsystem>(i),
+									qint64(m_budgets[i]->value()) * 1024 * 1024);
+	}
+	clearState();
+}
+
+void MemorySettingsWidget::cancelImpl()
+{
+	loadImpl();
+}
+
+void MemorySettingsWidget::onChanged()
+{
+	if (!m_changed) {
+		m_changed = true;
+		setModified(true);
+	}
+}
+
+void MemorySettingsWidget::onTrimClicked()
+{
+	MemoryAccounting::enforceBudgets();
+	updateUsage();
+}
+
+void MemorySettingsWidget::updateUsage()
+{
+	m_usage->clear();
+	foreach (const MemoryAccounting::Entry &entry, MemoryAccounting::top(TopConsumers)) {
+		QTreeWidgetItem *item = new QTreeWidgetItem(m_usage);
+		item->setText(0, MemoryAccounting::subsystemTitle(entry.subsystem));
+		item->setText(1, entry.name);
+		item->setText(2, formatSize(entry.bytes));
+		item->setTextAlignment(2, Qt::AlignRight | Qt::AlignVCenter);
+	}
+}
+
+MemorySettings::MemorySettings()
+{
+	GeneralSettingsItem<MemorySettingsWidget> *item =
+			new GeneralSettingsItem<MemorySettingsWidget>(
+					Settings::General,
+					Icon("utilities-system-monitor"),
+					QT_TRANSLATE_NOOP("Settings","Memory usage")
+					);
+	Settings::registerItem(item);
+}
+
+} // namespace Core
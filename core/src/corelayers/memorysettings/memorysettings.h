@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef MEMORYSETTINGS_H
+#define MEMORYSETTINGS_H
+
+#include <qutim/settingswidget.h>
+#include <qutim/startupmodule.h>
+#include <qutim/memoryaccounting.h>
+
+class QTreeWidget;
+class QSpinBox;
+class QTimer;
+
+namespace Core {
+
+using namespace qutim_sdk_0_3;
+
+class MemorySettingsWidget : public SettingsWidget
+{
+	Q_OBJECT
+public:
+	MemorySettingsWidget();
+protected:
+	void clearState();
+	virtual void loadImpl();
+	virtual void saveImpl();
+	virtual void cancelImpl();
+private slots:
+	void onChanged();
+	void onTrimClicked();
+	void updateUsage();
+private:
+	QTreeWidget *m_usage;
+	QSpinBox *m_budgets[MemoryAccounting::SubsystemCount];
+	QTimer *m_usageTimer;
+	bool m_changed;
+};
+
+class MemorySettings : public QObject, public qutim_sdk_0_3::StartupModule
+{
+	Q_OBJECT
+	Q_INTERFACES(qutim_sdk_0_3::StartupModule)
+public:
+	MemorySettings();
+};
+
+} // namespace Core
+
+#endif // MEMORYSETTINGS_H
@@ -47,37 +47,45 @@ Factory::~Factory()
 
 Contact* Factory::addContact(const QString& id, const QVariantMap& data)
 {
-	QList<Contact*> contacts;
-	QVariantList items = data.value(QLatin1String("items")).toList();
-	foreach(QVariant item,items) {
-		QVariantMap map = item.toMap();
-		Protocol *proto = Protocol::all().value(map.value(QLatin1String("protocol")).toString());
-		if(!proto)
-			continue;
-		Account *account = proto->account(map.value(QLatin1String("account")).toString());
-		if(!account)
-			continue;
-		Contact *contact = qobject_cast<Contact*>(account->getUnit(map.value(QLatin1String("id")).toString()));
-		if(!contact)
-			continue;
-		contacts.append(contact);
-	}
-	if(!contacts.count())
-		return 0;
+	const QString protocolName = QStringLiteral("protocol");
+	const QString accountName = QStringLiteral("account");
+	const QString idName = QStringLiteral("id");
 
 	MetaContactImpl *metaContact = new MetaContactImpl(id);
 	metaContact->setContactName(data.value(QLatin1String("name")).toString());
 	metaContact->setContactAvatar(data.value(QLatin1String("avatar")).toString());
 	metaContact->setContactTags(data.value(QLatin1String("tags")).toStringList());
+	m_manager->m_contacts.insert(id, metaContact);
+
+	// Members of accounts which are not loaded yet are kept pending,
+	// so they are merged by the index as soon as they are created
+	QList<Contact*> contacts;
+	QVariantList items = data.value(QLatin1String("items")).toList();
+	foreach(const QVariant &item,items) {
+		QVariantMap map = item.toMap();
+		const QString protocolId = map.value(protocolName).toString();
+		const QString accountId = map.value(accountName).toString();
+		const QString contactId = map.value(idName).toString();
+		Contact *contact = 0;
+		if (Protocol *proto = Protocol::all().value(protocolId)) {
+			if (Account *account = proto->account(accountId))
+				contact = qobject_cast<Contact*>(account->getUnit(contactId));
+		}
+		if (contact)
+			contacts.append(contact);
+		else
+			metaContact->addPendingMember(Manager::memberKey(protocolId, accountId, contactId), map);
+	}
 	metaContact->addContacts(contacts);
 
-	emit m_manager->contactCreated(metaContact);
+	m_manager->m_hidden.insert(metaContact);
+	if (!contacts.isEmpty())
+		m_manager->showContact(metaContact);
 	return metaContact;
 }
 
 void Factory::serialize(Contact* contact, QVariantMap& data)
 {
-	qDebug() << Q_FUNC_INFO;
 	MetaContactImpl *metaContact = static_cast<MetaContactImpl*>(contact);
 	data.insert(QLatin1String("avatar"), metaContact->avatar());
 	data.insert(QLatin1String("name"),metaContact->name());
@@ -91,6 +99,8 @@ void Factory::serialize(Contact* contact, QVariantMap& data)
 		item.insert(QLatin1String("protocol"),contact->account()->protocol()->id());
 		contacts.append(item);
 	}
+	foreach(const QVariantMap &item, metaContact->pendingMembers())
+		contacts.append(item);
 	data.insert(QLatin1String("items"),contacts);
 }
 
@@ -33,8 +33,11 @@
 #include <qutim/servicemanager.h>
 #include "factory.h"
 #include <qutim/profile.h>
+#include <qutim/account.h>
+#include <qutim/chatsession.h>
 #include <QTimer>
 #include <QCoreApplication>
+#include <algorithm>
 
 namespace Core
 {
@@ -42,12 +45,22 @@ namespace MetaContacts
 {
 using namespace qutim_sdk_0_3;
 
+template <typename Callback>
+static void forEachTrigram(const QString &text, const Callback &callback)
+{
+	const ushort *data = text.utf16();
+	for (int i = 0; i + 2 < text.size(); ++i)
+		callback((quint64(data[i]) << 32) | (quint64(data[i + 1]) << 16) | quint64(data[i + 2]));
+}
+
 Manager::Manager() : 
 	m_storage(RosterStorage::instance()),
 	m_factory(new Factory(this)),
 	m_blockUpdate(false)
 {
 	connect(this, SIGNAL(contactCreated(qutim_sdk_0_3::Contact*)), SLOT(onContactCreated(qutim_sdk_0_3::Contact*)));
+	connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
+	        SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
 	QTimer::singleShot(0, this, SLOT(initActions()));
 	setContactsFactory(m_factory.data());
 	m_handler.reset(new MetaContactMessageHandler);
@@ -63,6 +76,12 @@ Manager::Manager() :
 
 Manager::~Manager()
 {
+	// Metacontacts unregister themselves from us during destruction
+	const QList<MetaContactImpl*> contacts = m_contacts.values() + m_hidden.toList();
+	m_contacts.clear();
+	m_members.clear();
+	m_hidden.clear();
+	qDeleteAll(contacts.toSet());
 }
 
 ChatUnit *Manager::getUnit(const QString &unitId, bool create)
@@ -76,13 +95,195 @@ ChatUnit *Manager::getUnit(const QString &unitId, bool create)
 	return contact;
 }
 
+void Manager::removeContact(MetaContactImpl *contact)
+{
+	if (m_contacts.value(contact->id()) == contact)
+		m_contacts.remove(contact->id());
+	m_hidden.remove(contact);
+	foreach (const QString &key, contact->pendingMembers().keys())
+		unindexMember(contact, key);
+}
+
+QString Manager::memberKey(const QString &protocol, const QString &account, const QString &id)
+{
+	return protocol + QLatin1Char('\n') + account + QLatin1Char('\n') + id;
+}
+
+QString Manager::memberKey(Contact *contact)
+{
+	Account *account = contact->account();
+	return memberKey(account->protocol()->id(), account->id(), contact->id());
+}
+
+void Manager::indexMember(MetaContactImpl *metaContact, const QString &key)
+{
+	m_members.insert(key, metaContact);
+}
+
+void Manager::unindexMember(MetaContactImpl *metaContact, const QString &key)
+{
+	QHash<QString, MetaContactImpl*>::iterator it = m_members.find(key);
+	if (it != m_members.end() && it.value() == metaContact)
+		m_members.erase(it);
+}
+
 void Manager::loadContacts()
 {
 	m_blockUpdate = true;
+	// Members which appear later are resolved by the index on their creation
+	foreach (Protocol *protocol, Protocol::all()) {
+		connect(protocol, SIGNAL(accountCreated(qutim_sdk_0_3::Account*)),
+		        SLOT(onAccountCreated(qutim_sdk_0_3::Account*)), Qt::UniqueConnection);
+		foreach (Account *account, protocol->accounts())
+			onAccountCreated(account);
+	}
 	m_storage->load(this);
 	m_blockUpdate = false;
 }
 
+void Manager::onAccountCreated(Account *account)
+{
+	if (account == this)
+		return;
+	connect(account, SIGNAL(contactCreated(qutim_sdk_0_3::Contact*)),
+	        SLOT(onMemberCreated(qutim_sdk_0_3::Contact*)), Qt::UniqueConnection);
+	// The only walk over the roster, later contacts are indexed on creation
+	foreach (Contact *contact, account->findChildren<Contact*>())
+		indexName(contact, contact->title());
+}
+
+void Manager::onMemberCreated(Contact *contact)
+{
+	indexName(contact, contact->title());
+	if (m_members.isEmpty())
+		return;
+	const QString key = memberKey(contact);
+	MetaContactImpl *metaContact = m_members.value(key);
+	if (!metaContact || metaContact->contacts().contains(contact))
+		return;
+	metaContact->resolvePendingMember(key, contact);
+	showContact(metaContact);
+}
+
+void Manager::onMemberTitleChanged(const QString &title)
+{
+	indexName(static_cast<Contact*>(sender()), title);
+}
+
+void Manager::onMemberDestroyed(QObject *object)
+{
+	Contact *contact = static_cast<Contact*>(object);
+	removeName(m_contactNames.take(contact), contact);
+}
+
+QString Manager::normalizedName(const QString &title)
+{
+	return title.toCaseFolded();
+}
+
+void Manager::indexName(Contact *contact, const QString &title)
+{
+	const QString name = normalizedName(title);
+	QHash<Contact*, QString>::iterator it = m_contactNames.find(contact);
+	if (it == m_contactNames.end()) {
+		m_contactNames.insert(contact, name);
+		connect(contact, SIGNAL(titleChanged(QString,QString)), SLOT(onMemberTitleChanged(QString)));
+		connect(contact, SIGNAL(destroyed(QObject*)), SLOT(onMemberDestroyed(QObject*)));
+	} else if (it.value() == name) {
+		return;
+	} else {
+		removeName(it.value(), contact);
+		it.value() = name;
+	}
+	insertName(name, contact);
+}
+
+void Manager::insertName(const QString &name, Contact *contact)
+{
+	if (!m_names.contains(name)) {
+		forEachTrigram(name, [this, &name] (quint64 trigram) {
+			m_trigrams[trigram].insert(name);
+		});
+	}
+	m_names.insert(name, contact);
+}
+
+void Manager::removeName(const QString &name, Contact *contact)
+{
+	if (m_names.remove(name, contact) == 0 || m_names.contains(name))
+		return;
+	forEachTrigram(name, [this, &name] (quint64 trigram) {
+		QHash<quint64, QSet<QString> >::iterator it = m_trigrams.find(trigram);
+		if (it != m_trigrams.end() && it->remove(name) && it->isEmpty())
+			m_trigrams.erase(it);
+	});
+}
+
+QList<Contact*> Manager::findContacts(const QString &text) const
+{
+	QList<Contact*> result;
+	const QString name = normalizedName(text);
+	if (name.isEmpty())
+		return result;
+
+	if (name.size() < 3) {
+		// Too short for trigrams, only titles starting with it are found
+		QMultiMap<QString, Contact*>::const_iterator it = m_names.lowerBound(name);
+		for (; it != m_names.constEnd() && it.key().startsWith(name); ++it)
+			result << it.value();
+		return result;
+	}
+
+	QList<const QSet<QString> *> postings;
+	bool missed = false;
+	forEachTrigram(name, [this, &postings, &missed] (quint64 trigram) {
+		QHash<quint64, QSet<QString> >::const_iterator it = m_trigrams.constFind(trigram);
+		if (it == m_trigrams.constEnd())
+			missed = true;
+		else
+			postings << &it.value();
+	});
+	if (missed)
+		return result;
+
+	std::sort(postings.begin(), postings.end(), [] (const QSet<QString> *a, const QSet<QString> *b) {
+		return a->size() < b->size();
+	});
+	QSet<QString> candidates = *postings.first();
+	for (int i = 1; i < postings.size() && !candidates.isEmpty(); ++i)
+		candidates.intersect(*postings.at(i));
+
+	// Trigrams only narrow the candidates, results are kept ordered by title
+	QStringList names = candidates.toList();
+	std::sort(names.begin(), names.end());
+	foreach (const QString &key, names) {
+		if (!key.contains(name))
+			continue;
+		QMultiMap<QString, Contact*>::const_iterator it = m_names.constFind(key);
+		for (; it != m_names.constEnd() && it.key() == key; ++it)
+			result << it.value();
+	}
+	return result;
+}
+
+void Manager::onSessionCreated(ChatSession *session)
+{
+	MetaContactImpl *contact = qobject_cast<MetaContactImpl*>(session->unit());
+	if (contact && session->unreadCount() == 0)
+		contact->setActiveContact();
+}
+
+void Manager::showContact(MetaContactImpl *contact)
+{
+	if (!m_hidden.remove(contact))
+		return;
+	// It's already in roster storage
+	const bool blockUpdate = m_blockUpdate;
+	m_blockUpdate = true;
+	emit contactCreated(contact);
+	m_blockUpdate = blockUpdate;
+}
+
 void Manager::onSplitTriggered(QObject *object)
 {
 	//TODO implement logic
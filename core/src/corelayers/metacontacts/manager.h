@@ -29,6 +29,8 @@
 #include <qutim/metacontactmanager.h>
 #include "metacontactimpl.h"
 #include "messagehandler.h"
+#include <QSet>
+#include <QMultiMap>
 
 namespace qutim_sdk_0_3 {
 class RosterStorage;
@@ -48,8 +50,16 @@ public:
 	Manager();
 	virtual ~Manager();
 	virtual qutim_sdk_0_3::ChatUnit *getUnit(const QString &unitId, bool create = false);
-	void removeContact(const QString &id) { m_contacts.remove(id); }
+	void removeContact(MetaContactImpl *contact);
 	virtual QString name() const;
+
+	static QString memberKey(const QString &protocol, const QString &account, const QString &id);
+	static QString memberKey(qutim_sdk_0_3::Contact *contact);
+	void indexMember(MetaContactImpl *metaContact, const QString &key);
+	void unindexMember(MetaContactImpl *metaContact, const QString &key);
+	// Contacts of all accounts whose titles contain @a text, case is ignored.
+	// Text shorter than three characters matches only the start of titles
+	QList<qutim_sdk_0_3::Contact*> findContacts(const QString &text) const;
 protected:
 	virtual void loadContacts();
 private slots:
@@ -57,8 +67,29 @@ private slots:
 	void onSplitTriggered(QObject*);
 	void onCreateTriggered(QObject*);
 	void onContactCreated(qutim_sdk_0_3::Contact*);
+	void onAccountCreated(qutim_sdk_0_3::Account *account);
+	void onMemberCreated(qutim_sdk_0_3::Contact *contact);
+	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
+	void onMemberTitleChanged(const QString &title);
+	void onMemberDestroyed(QObject *object);
 private:
+	void showContact(MetaContactImpl *contact);
+	static QString normalizedName(const QString &title);
+	void indexName(qutim_sdk_0_3::Contact *contact, const QString &title);
+	void insertName(const QString &name, qutim_sdk_0_3::Contact *contact);
+	void removeName(const QString &name, qutim_sdk_0_3::Contact *contact);
+
 	QHash<QString, MetaContactImpl*> m_contacts;
+	// Member key -> metacontact, including members not created yet
+	QHash<QString, MetaContactImpl*> m_members;
+	// Metacontacts without any created member are kept out of roster
+	QSet<MetaContactImpl*> m_hidden;
+	// Normalized title -> contacts of all accounts, it follows title changes,
+	// so merge candidates are found without walking every roster
+	QMultiMap<QString, qutim_sdk_0_3::Contact*> m_names;
+	QHash<qutim_sdk_0_3::Contact*, QString> m_contactNames;
+	// Trigram -> normalized titles containing it
+	QHash<quint64, QSet<QString> > m_trigrams;
 	qutim_sdk_0_3::RosterStorage *m_storage;
 	QScopedPointer<Factory> m_factory;
 	friend class Factory;
@@ -41,8 +41,9 @@ MetaContactMessageHandler::MetaContactMessageHandler()
 {
 }
 
-MessageHandlerAsyncResult MetaContactMessageHandler::doHandle(Message &message)
+MessageHandler::Result MetaContactMessageHandler::doHandleSync(Message &message, QString *reason)
 {
+	Q_UNUSED(reason);
 	if (message.isIncoming() && !qobject_cast<MetaContactImpl*>(message.chatUnit())) {
 		Q_ASSERT(message.chatUnit());
 		if (MetaContactImpl *contact = qobject_cast<MetaContactImpl*>(message.chatUnit()->metaContact())) {
@@ -58,7 +59,7 @@ MessageHandlerAsyncResult MetaContactMessageHandler::doHandle(Message &message)
 		}
 	}
 
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
 
 }
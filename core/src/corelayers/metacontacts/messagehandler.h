@@ -38,7 +38,7 @@ class MetaContactMessageHandler : public qutim_sdk_0_3::MessageHandler
 public:
 	MetaContactMessageHandler();
 protected:
-	qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
+	Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason) override;
 };
 
 }
@@ -53,14 +53,17 @@ bool contactLessThan(Contact *a, Contact *b)
 	return priority[a->status().type()] < priority[b->status().type()];
 }
 
-MetaContactImpl::MetaContactImpl(const QString &id) : m_id(id), m_activeContact(0)
+MetaContactImpl::MetaContactImpl(const QString &id)
+	: m_id(id), m_activeContact(0), m_statusSource(0), m_onlineCount(0)
 {
-	connect(ChatLayer::instance(),SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)), this, SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
 }
 
 MetaContactImpl::~MetaContactImpl()
 {
-	//			static_cast<Manager*>(account())->removeContact(m_id);
+	Manager *manager = static_cast<Manager*>(account());
+	manager->removeContact(this);
+	for (QHash<Contact*, QString>::const_iterator it = m_memberKeys.constBegin(); it != m_memberKeys.constEnd(); ++it)
+		manager->unindexMember(this, it.value());
 }
 
 QString MetaContactImpl::id() const
@@ -97,40 +100,70 @@ bool MetaContactImpl::sendMessage(const Message &message)
 
 void MetaContactImpl::addContact(Contact* contact, bool update)
 {
-	if (m_contacts.contains(contact) || (contact == this))
+	if (!appendContact(contact))
 		return;
 
-	if(update) {
-		QStringList previous = m_tags;
-		QStringList contactTags = contact->tags();
-		for (int i = 0; i < contactTags.size(); i++) {
-			if (!m_tags.contains(contactTags.at(i))) {
-				m_tags << contactTags.at(i);
-			}
-		}
-		emit tagsChanged(m_tags, previous);
-	}
+	if(update)
+		mergeTags(contact);
+
+	if (m_name.isEmpty())
+		resetName();
+
+	//setMenuOwner(contact); TODO, implement logic!
+		
+	if(update)
+		RosterStorage::instance()->updateContact(this);
+	setActiveContact();
+	resetStatus();
+}
+
+bool MetaContactImpl::appendContact(Contact *contact)
+{
+	if (m_contacts.contains(contact) || (contact == this))
+		return false;
+
+	const QString key = Manager::memberKey(contact);
+	m_pendingMembers.remove(key);
+	m_memberKeys.insert(contact, key);
+	static_cast<Manager*>(account())->indexMember(this, key);
 
 	m_contacts.append(contact);
 	MetaContact::addContact(contact);
 	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
-			SLOT(onContactStatusChanged()));
+			SLOT(onContactStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
 	connect(contact, SIGNAL(avatarChanged(QString)),
 			SLOT(setAvatar(QString)));
 	connect(contact, SIGNAL(chatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState,qutim_sdk_0_3::ChatUnit::ChatState)),
 			SIGNAL(chatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState,qutim_sdk_0_3::ChatUnit::ChatState)));
 	connect(contact, SIGNAL(destroyed(QObject*)),
 	        SLOT(onContactDeath(QObject*)));
+	return true;
+}
 
-	if (m_name.isEmpty())
-		resetName();
+void MetaContactImpl::mergeTags(Contact *contact)
+{
+	QStringList previous = m_tags;
+	QStringList contactTags = contact->tags();
+	for (int i = 0; i < contactTags.size(); i++) {
+		if (!m_tags.contains(contactTags.at(i))) {
+			m_tags << contactTags.at(i);
+		}
+	}
+	emit tagsChanged(m_tags, previous);
+}
 
-	//setMenuOwner(contact); TODO, implement logic!
-		
-	if(update)
-		RosterStorage::instance()->updateContact(this);
-	setActiveContact();
-	resetStatus();
+void MetaContactImpl::addPendingMember(const QString &key, const QVariantMap &item)
+{
+	m_pendingMembers.insert(key, item);
+	static_cast<Manager*>(account())->indexMember(this, key);
+}
+
+void MetaContactImpl::resolvePendingMember(const QString &key, Contact *contact)
+{
+	if (!m_pendingMembers.contains(key))
+		return;
+	// Membership is already stored, so there is nothing to save
+	addContacts(QList<Contact*>() << contact);
 }
 
 void MetaContactImpl::removeContact(Contact *contact, bool dead)
@@ -139,6 +172,9 @@ void MetaContactImpl::removeContact(Contact *contact, bool dead)
 	if (index == -1)
 		return;
 	m_contacts.removeAt(index);
+	static_cast<Manager*>(account())->unindexMember(this, m_memberKeys.take(contact));
+	if (contact == m_statusSource)
+		m_statusSource = 0;
 	if (!dead) {
 		MetaContact::removeContact(contact);
 		disconnect(contact, 0, this, 0);
@@ -183,6 +219,8 @@ void MetaContactImpl::resetName()
 void MetaContactImpl::resetStatus()
 {
 	if (m_contacts.isEmpty()) {
+		m_statusSource = 0;
+		m_onlineCount = 0;
 		if (m_status.type() == Status::Offline)
 			return;
 		Status previous = m_status;
@@ -190,17 +228,31 @@ void MetaContactImpl::resetStatus()
 		emit statusChanged(m_status, previous);
 		return;
 	}
-	Status previous = m_status;
-	Status contactStatus = m_activeContact->status();
-	if (contactStatus.type() == Status::Offline) {
-		for (int i = 0; i < m_contacts.size(); i++) {
-			if (m_contacts.at(i)->status().type() != Status::Offline) {
-				contactStatus = m_contacts.at(i)->status();
-				break;
-			}
+	m_onlineCount = 0;
+	for (int i = 0; i < m_contacts.size(); i++) {
+		if (m_contacts.at(i)->status().type() != Status::Offline)
+			++m_onlineCount;
+	}
+	updateStatus(statusSource());
+}
 
-		}
+Contact *MetaContactImpl::statusSource() const
+{
+	// Active member is shown unless it's offline while others are not
+	if (m_activeContact->status().type() != Status::Offline || !m_onlineCount)
+		return m_activeContact;
+	for (int i = 0; i < m_contacts.size(); i++) {
+		if (m_contacts.at(i)->status().type() != Status::Offline)
+			return m_contacts.at(i);
 	}
+	return m_activeContact;
+}
+
+void MetaContactImpl::updateStatus(Contact *source)
+{
+	m_statusSource = source;
+	Status previous = m_status;
+	Status contactStatus = source->status();
 	if (contactStatus.type() == m_status.type()
 			&& contactStatus.text() == m_status.text()) {
 		return;
@@ -226,9 +278,15 @@ void MetaContactImpl::resetStatus()
 	emit statusChanged(m_status, previous);
 }
 
-void MetaContactImpl::onContactStatusChanged()
+void MetaContactImpl::onContactStatusChanged(const Status &current, const Status &previous)
 {
-	resetStatus();
+	Contact *contact = static_cast<Contact*>(sender());
+	m_onlineCount += int(current.type() != Status::Offline) - int(previous.type() != Status::Offline);
+	// Changes of members which are not shown can't change our status
+	Contact *source = statusSource();
+	if (source != contact && source == m_statusSource)
+		return;
+	updateStatus(source);
 }
 
 void MetaContactImpl::setAvatar(const QString& path)
@@ -276,13 +334,31 @@ void MetaContactImpl::addContacts(QList<Contact*> contacts, bool remove)
 {
 	bool update = false;
 	if (remove) {
+		Manager *manager = static_cast<Manager*>(account());
+		for (QHash<Contact*, QString>::const_iterator it = m_memberKeys.constBegin(); it != m_memberKeys.constEnd(); ++it)
+			manager->unindexMember(this, it.value());
+		m_memberKeys.clear();
 		m_contacts.clear();
 		update = true;
 	}
 
+	// Name, status and storage are updated once for the whole batch
+	bool added = false;
 	foreach (Contact *contact, contacts) {
-		addContact(contact,update);
+		if (!appendContact(contact))
+			continue;
+		if (update)
+			mergeTags(contact);
+		added = true;
 	}
+	if (!added)
+		return;
+	if (m_name.isEmpty())
+		resetName();
+	if (update)
+		RosterStorage::instance()->updateContact(this);
+	setActiveContact();
+	resetStatus();
 }
 
 void MetaContactImpl::setContactAvatar(const QString& path)
@@ -324,13 +400,6 @@ void MetaContactImpl::setActiveContact(Contact* contact)
 	m_activeContact = m_contacts.at(0);
 }
 
-void MetaContactImpl::onSessionCreated(ChatSession *session)
-{
-	MetaContact *contact = qobject_cast<MetaContact*>(session->unit());
-	if (contact == this->metaContact() && session->unread().count() == 0)
-		setActiveContact();
-}
-
 void MetaContactImpl::onContactDeath(QObject *contact)
 {
 	removeContact(static_cast<Contact*>(contact), true);
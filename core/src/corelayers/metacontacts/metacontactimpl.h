@@ -61,6 +61,10 @@ public:
 	void setContactTags(const QStringList &tags);
 	void setActiveContact(Contact* contact = 0);
 	Contact* getActiveContact() { return m_activeContact; }
+	// Stored members whose accounts didn't create them yet
+	inline const QHash<QString, QVariantMap> &pendingMembers() const { return m_pendingMembers; }
+	void addPendingMember(const QString &key, const QVariantMap &item);
+	void resolvePendingMember(const QString &key, Contact *contact);
 public slots:
 	void setAvatar(const QString &path);
 protected:
@@ -68,9 +72,12 @@ protected:
 	void resetStatus();
 	void addContact(Contact* contact, bool update);
 	void removeContact(Contact *contact, bool dead);
+	bool appendContact(Contact *contact);
+	void mergeTags(Contact *contact);
+	Contact *statusSource() const;
+	void updateStatus(Contact *source);
 protected slots:
-	void onContactStatusChanged();
-	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
+	void onContactStatusChanged(const qutim_sdk_0_3::Status &current, const qutim_sdk_0_3::Status &previous);
 	void onContactDeath(QObject *contact);
 private:
 	virtual bool event(QEvent *ev);
@@ -81,6 +88,12 @@ private:
 	QList<Contact*> m_contacts;
 	QString m_lastAvatar;
 	Contact* m_activeContact;
+	// Member which status is shown and count of online members
+	Contact* m_statusSource;
+	int m_onlineCount;
+	QHash<QString, QVariantMap> m_pendingMembers;
+	// Index keys of members, they can't be built for dying ones
+	QHash<Contact*, QString> m_memberKeys;
 };
 }
 }
@@ -28,11 +28,11 @@
 #include <qutim/itemdelegate.h>
 #include <qutim/metacontact.h>
 #include <qutim/protocol.h>
-#include <qutim/accountmanager.h>
 #include <qutim/account.h>
 #include <qutim/debug.h>
 #include <qutim/avatarfilter.h>
 #include "metacontactimpl.h"
+#include "manager.h"
 
 namespace Core {
 namespace MetaContacts {
@@ -58,17 +58,12 @@ void Model::searchContacts(const QString& name)
 	if (name.isEmpty())
 		return;
 
-	QList<Contact*> contacts = getContacts();
-	foreach (Account *account, AccountManager::instance()->accounts()) {
-		foreach (Contact *contact, account->findChildren<Contact*>()) {
-			if (!contact->title().contains(name,Qt::CaseInsensitive))
-				continue;
-			if (contacts.contains(contact))
-				continue;
+	const QList<Contact*> contacts = getContacts();
+	Manager *manager = static_cast<Manager*>(MetaContactManager::instance());
+	foreach (Contact *contact, manager->findContacts(name)) {
+		if (!contacts.contains(contact))
 			addContact(contact, m_searchRoot);
-		}
 	}
-
 }
 
 void Model::setMetaContact(MetaContactImpl *metaContact)
@@ -27,24 +27,65 @@
 #include "ui_migrationstartpage.h"
 #include <QDir>
 #include <QFile>
-#include <QTime>
+#include <QThread>
 #include <QCoreApplication>
+#include <QTimerEvent>
+#include <QWizard>
 #include <QDebug>
 #include <QSettings>
 #include <QStringBuilder>
 #include <qutim/configbase.h>
 #include <qutim/systeminfo.h>
 #include <qutim/debug.h>
+#include <qutim/executor.h>
 
 namespace Core
 {
 using namespace qutim_sdk_0_3;
 
+struct HistoryImportState
+{
+	HistoryImportState() : jobs(0) {}
+
+	QAtomicInt total;
+	QAtomicInt copied;
+	QAtomicInt failed;
+	QAtomicInt finishedJobs;
+	int jobs;
+};
+
+// Runs in a worker thread, one job per account
+static void importAccountHistory(const QSharedPointer<HistoryImportState> &state,
+								 const QString &from, const QString &to)
+{
+	const QFileInfoList files = QDir(from).entryInfoList(QStringList("*.json"), QDir::Files);
+	state->total.fetchAndAddRelaxed(files.size());
+	const QDir target(to);
+	foreach (const QFileInfo &file, files) {
+		const QString targetPath = target.filePath(file.fileName());
+		// Never overwrite history of new version, so interrupted import is
+		// resumed from the first missed file. Half-copied file has temporary
+		// name and is not recognized by history backend
+		if (!QFile::exists(targetPath)) {
+			const QString partPath = targetPath + QLatin1String(".part");
+			QFile::remove(partPath);
+			if (!QFile::copy(file.absoluteFilePath(), partPath)
+					|| !QFile::rename(partPath, targetPath)) {
+				state->failed.ref();
+			}
+		}
+		state->copied.ref();
+	}
+	state->finishedJobs.ref();
+}
+
 MigrationStartPage::MigrationStartPage(QWidget *parent) :
 	QWizardPage(parent),
-	ui(new Ui::MigrationStartPage)
+	ui(new Ui::MigrationStartPage),
+	m_imported(false)
 {
 	ui->setupUi(this);
+	ui->progressBar->hide();
 	setTitle(tr("Migration wizard"));
 	setSubTitle(tr("qutIM has discovered configuration from 0.2 version, "
 				   "choose profile to import history and configuration from."));
@@ -159,10 +200,30 @@ void MigrationStartPage::on_profileBox_currentIndexChanged(int index)
 
 bool MigrationStartPage::validatePage()
 {
-	if (!ui->importBox->isChecked())
+	if (!ui->importBox->isChecked() || m_imported)
 		return true;
-	//	Firstly copy accounts
+	// Wizard is moved forward as soon as history is copied
+	if (m_import)
+		return false;
+
+	importAccounts();
+	if (!startHistoryImport()) {
+		m_imported = true;
+		return true;
+	}
+	ui->importBox->setEnabled(false);
+	ui->profileBox->setEnabled(false);
+	ui->accountsList->setEnabled(false);
+	ui->progressBar->setValue(0);
+	ui->progressBar->show();
+	m_progressTimer.start(100, this);
+	return false;
+}
+
+void MigrationStartPage::importAccounts()
+{
 	qDebug() << Q_FUNC_INFO << SystemInfo::getPath(SystemInfo::ConfigDir);
+	QHash<QString, QStringList> protocolAccounts;
 	for (int i = 0; i < ui->accountsList->count(); i++) {
 		QListWidgetItem *item = ui->accountsList->item(i);
 		if (item->checkState() != Qt::Checked)
@@ -189,42 +250,70 @@ bool MigrationStartPage::validatePage()
 					  % item->data(Qt::UserRole + 1).toString()
 					  % QLatin1Literal("/account"));
 		config.group("general").setValue("passwd", password, Config::Crypted);
-		config.sync();
-		config = Config(protocol);
-		ConfigGroup group = config.group("general");
-		QStringList accounts = group.value("accounts", QStringList())
-				<< item->data(Qt::UserRole + 1).toString();
+		protocolAccounts[protocol] << item->data(Qt::UserRole + 1).toString();
+	}
+	// Account lists are written once per protocol, the rest is saved
+	// by the usual delayed config saver
+	for (auto it = protocolAccounts.constBegin(); it != protocolAccounts.constEnd(); ++it) {
+		ConfigGroup group = Config(it.key()).group("general");
+		QStringList accounts = group.value("accounts", QStringList()) + it.value();
 		accounts.removeDuplicates();
 		group.setValue("accounts", accounts);
-		group.sync();
 	}
-	//	Then copy history of known protocols
+}
+
+bool MigrationStartPage::startHistoryImport()
+{
 	QDir historyDir = ui->profileBox->itemData(ui->profileBox->currentIndex()).toString() + "/history";
-	if (historyDir.exists()) {
-		QTime time;
-		time.start();
-		QDir newHistoryDir = SystemInfo::getDir(SystemInfo::HistoryDir);
-		foreach (const ProtoInfo &protocol, m_protos) {
-			QFileInfoList list = historyDir.entryInfoList(QStringList(protocol.history + ".*"),
-														  QDir::Dirs | QDir::NoDotAndDotDot);
-			foreach (const QFileInfo &info, list) {
-				QString account = info.fileName().section(".", 1);
-				newHistoryDir.mkpath(protocol.lower % "." % account);
-				foreach (const QFileInfo &file, QDir(info.absoluteFilePath())
-						 .entryInfoList(QStringList("*.json"), QDir::Files)) {
-					QFile::copy(file.absoluteFilePath(),
-								newHistoryDir.filePath(protocol.lower
-													   % "." % account
-													   % '/' % file.fileName()));
-				}
-			}
+	if (!historyDir.exists())
+		return false;
+
+	m_import = QSharedPointer<HistoryImportState>::create();
+	m_importTime.start();
+	Executor *executor = Executor::named(QStringLiteral("migration"), QThread::idealThreadCount());
+	QDir newHistoryDir = SystemInfo::getDir(SystemInfo::HistoryDir);
+	foreach (const ProtoInfo &protocol, m_protos) {
+		QFileInfoList list = historyDir.entryInfoList(QStringList(protocol.history + ".*"),
+													  QDir::Dirs | QDir::NoDotAndDotDot);
+		foreach (const QFileInfo &info, list) {
+			QString account = info.fileName().section(".", 1);
+			newHistoryDir.mkpath(protocol.lower % "." % account);
+			const QString from = info.absoluteFilePath();
+			const QString to = newHistoryDir.filePath(protocol.lower % "." % account);
+			QSharedPointer<HistoryImportState> state = m_import;
+			executor->run([state, from, to] () {
+				importAccountHistory(state, from, to);
+			}, Executor::BulkPriority);
+			++m_import->jobs;
 		}
-		qDebug() << "History was imported by " << time.elapsed() << "ms";
 	}
-	//	TODO: Copy styles and other stuff
+	if (!m_import->jobs) {
+		m_import.clear();
+		return false;
+	}
 	return true;
 }
 
+void MigrationStartPage::timerEvent(QTimerEvent *e)
+{
+	if (e->timerId() != m_progressTimer.timerId()) {
+		QWizardPage::timerEvent(e);
+		return;
+	}
+
+	ui->progressBar->setMaximum(qMax(1, m_import->total.load()));
+	ui->progressBar->setValue(m_import->copied.load());
+	if (m_import->finishedJobs.load() < m_import->jobs)
+		return;
+
+	m_progressTimer.stop();
+	m_imported = true;
+	qDebug() << "History was imported by" << m_importTime.elapsed() << "ms,"
+			 << m_import->copied.load() << "files," << m_import->failed.load() << "failed";
+	//	TODO: Copy styles and other stuff
+	wizard()->next();
+}
+
 void MigrationStartPage::changeEvent(QEvent *e)
 {
 	QWizardPage::changeEvent(e);
@@ -28,6 +28,9 @@
 
 #include <QWizardPage>
 #include <QDir>
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 namespace Ui {
     class MigrationStartPage;
@@ -35,6 +38,8 @@ namespace Ui {
 
 namespace Core
 {
+	struct HistoryImportState;
+
 	class MigrationStartPage : public QWizardPage
 	{
 		Q_OBJECT
@@ -60,10 +65,18 @@ namespace Core
 
 	protected:
 		void changeEvent(QEvent *e);
+		void timerEvent(QTimerEvent *e);
 
 	private:
+		void importAccounts();
+		bool startHistoryImport();
+
 		QList<ProtoInfo> m_protos;
 		Ui::MigrationStartPage *ui;
+		QSharedPointer<HistoryImportState> m_import;
+		QBasicTimer m_progressTimer;
+		QElapsedTimer m_importTime;
+		bool m_imported;
 	};
 }
 
@@ -30,6 +30,8 @@
 #include <qutim/utils.h>
 #include <qutim/account.h>
 #include <qutim/protocol.h>
+#include <qutim/config.h>
+#include <QDateTime>
 #include <QTimer>
 #include <QCoreApplication>
 
@@ -91,6 +93,9 @@ static QString toString(Notification::Type type, const QString &argument)
 	return title.arg(argument);
 }
 
+// Backends which disturb user for every notification, others only show some state
+static const char *loudBackends[] = { "Popup", "Sound", "Vibration", "Led" };
+
 static inline ChatUnit *getUnitForSession(QObject *obj)
 {
 	ChatUnit *unit = qobject_cast<ChatUnit*>(obj);
@@ -101,6 +106,23 @@ static inline ChatUnit *getUnitForSession(QObject *obj)
 
 NotificationFilterImpl::NotificationFilterImpl()
 {
+	Config cfg = Config().group("notification");
+	m_aggregationInterval = cfg.value("aggregationInterval", 3000);
+	m_staleInterval = cfg.value("staleInterval", 60);
+	cfg.beginGroup("rateLimits");
+	for (const char *type : loudBackends) {
+		cfg.beginGroup(QLatin1String(type));
+		RateLimit &limit = m_rateLimits[type];
+		limit.count = cfg.value("count", 3);
+		limit.interval = cfg.value("interval", 5000);
+		cfg.endGroup();
+	}
+	cfg.endGroup();
+
+	m_clock.start();
+	m_aggregationTimer.setInterval(qMax(100, m_aggregationInterval / 4));
+	connect(&m_aggregationTimer, SIGNAL(timeout()), SLOT(onAggregationTimeout()));
+
 	registerFilter(this, LowPriority);
 	connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
 			SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
@@ -219,6 +241,117 @@ void NotificationFilterImpl::filter(NotificationRequest &request)
 	default:
 		break;
 	}
+
+	if (!request.rejectionReasons().isEmpty())
+		return;
+
+	// Offline messages and history replays are not worth a popup or a sound
+	if (m_staleInterval > 0 && !message.text().isEmpty()
+	        && message.time().isValid()
+	        && message.time().secsTo(QDateTime::currentDateTime()) > m_staleInterval) {
+		blockLoudBackends(request);
+		return;
+	}
+
+	if (aggregate(request))
+		limitRate(request);
+}
+
+bool NotificationFilterImpl::aggregate(NotificationRequest &request)
+{
+	const Notification::Type type = request.type();
+	if (m_aggregationInterval <= 0
+	        || (type != Notification::IncomingMessage && type != Notification::ChatIncomingMessage)
+	        || request.property("aggregated", false)) {
+		return true;
+	}
+
+	QObject *object = request.object();
+	auto it = m_aggregations.find(object);
+	if (it == m_aggregations.end() || !it->object) {
+		// First message opens the window and is shown as is
+		Aggregation aggregation;
+		aggregation.object = object;
+		aggregation.started = m_clock.elapsed();
+		aggregation.count = 0;
+		m_aggregations.insert(object, aggregation);
+		if (!m_aggregationTimer.isActive())
+			m_aggregationTimer.start();
+		return true;
+	}
+
+	// Contact list and chat still see every message, only loud backends wait for the summary
+	it->last = request;
+	++it->count;
+	blockLoudBackends(request);
+	return false;
+}
+
+void NotificationFilterImpl::limitRate(NotificationRequest &request)
+{
+	const qint64 now = m_clock.elapsed();
+	for (auto it = m_rateLimits.begin(); it != m_rateLimits.end(); ++it) {
+		if (request.isBackendBlocked(it.key()))
+			continue;
+		RateLimit &limit = it.value();
+		while (!limit.sent.isEmpty() && now - limit.sent.head() >= limit.interval)
+			limit.sent.dequeue();
+		if (limit.sent.size() >= limit.count)
+			request.blockBackend(it.key());
+		else
+			limit.sent.enqueue(now);
+	}
+}
+
+void NotificationFilterImpl::blockLoudBackends(NotificationRequest &request)
+{
+	for (const char *type : loudBackends)
+		request.blockBackend(type);
+}
+
+void NotificationFilterImpl::onAggregationTimeout()
+{
+	const qint64 now = m_clock.elapsed();
+	QList<NotificationRequest> summaries;
+	for (auto it = m_aggregations.begin(); it != m_aggregations.end();) {
+		if (!it->object) {
+			it = m_aggregations.erase(it);
+			continue;
+		}
+		if (now - it->started < m_aggregationInterval) {
+			++it;
+			continue;
+		}
+		if (it->count == 0) {
+			it = m_aggregations.erase(it);
+			continue;
+		}
+
+		NotificationRequest request = it->last;
+		QSet<QByteArray> backends;
+		for (const char *type : loudBackends) {
+			if (!NotificationManager::isBackendEnabled(type))
+				continue;
+			backends.insert(type);
+		}
+		request.setBackends(backends);
+		request.setProperty("aggregated", true);
+		QString name = it->object->property("title").toString();
+		if (name.isEmpty())
+			name = it->object->property("id").toString();
+		request.setTitle(QObject::tr("%n new messages from %1", 0, it->count).arg(name));
+		summaries << request;
+
+		// Flood may continue, so keep the window until it becomes quiet
+		it->started = now;
+		it->count = 0;
+		++it;
+	}
+	if (m_aggregations.isEmpty())
+		m_aggregationTimer.stop();
+
+	foreach (NotificationRequest request, summaries)
+		request.send();
 }
 
 void NotificationFilterImpl::notificationCreated(Notification *notification)
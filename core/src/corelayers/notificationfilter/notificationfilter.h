@@ -32,6 +32,8 @@
 #include <qutim/chatsession.h>
 #include <QMultiHash>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QQueue>
 
 namespace Core {
 
@@ -57,7 +59,30 @@ private slots:
 	void onAccountStatusChanged(const qutim_sdk_0_3::Status &status,
 								const qutim_sdk_0_3::Status &previous);
 	void onAccountConnected();
+	void onAggregationTimeout();
 private:
+	bool aggregate(NotificationRequest &request);
+	void limitRate(NotificationRequest &request);
+	void blockLoudBackends(NotificationRequest &request);
+	struct Aggregation
+	{
+		QPointer<QObject> object;
+		NotificationRequest last;
+		qint64 started;
+		int count;
+	};
+	struct RateLimit
+	{
+		int count;
+		int interval;
+		QQueue<qint64> sent;
+	};
+	QHash<QObject*, Aggregation> m_aggregations;
+	QHash<QByteArray, RateLimit> m_rateLimits;
+	QElapsedTimer m_clock;
+	QTimer m_aggregationTimer;
+	int m_aggregationInterval;
+	int m_staleInterval;
 	typedef QMultiHash<ChatUnit*, QPointer<Notification> > Notifications;
 	Notifications m_notifications;
 	QHash<Account*, QTimer*> m_connectingAccounts;
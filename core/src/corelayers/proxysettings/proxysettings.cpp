@@ -30,6 +30,7 @@
 #include <qutim/icon.h>
 #include <qutim/protocol.h>
 #include <qutim/account.h>
+#include <qutim/networkaccess.h>
 #include <QFormLayout>
 #include <QStackedLayout>
 #include <QComboBox>
@@ -127,6 +128,7 @@ void ProxySettingsWidget::saveImpl()
 					manager->setProxy(account, proxy, settings);
 			}
 		}
+		NetworkAccess::updateProxy();
 	} else {
 		QNetworkProxy::setApplicationProxy(NetworkProxyManager::toNetworkProxy(settings));
 		// User changed proxy settings for the account.
@@ -106,9 +106,27 @@ IconLoaderImpl::IconLoaderImpl()
 	Settings::registerItem(m_settings.data());
 }
 
+void IconLoaderImpl::ensureIndex()
+{
+	// Theme may be changed by settings widget directly
+	const XdgIconTheme *theme = iconManager()->currentTheme();
+	const QString themeId = theme ? theme->id() : QString();
+	if (themeId == m_index.themeId())
+		return;
+	m_icons.clear();
+	m_index.load(themeId, QIcon::themeSearchPaths());
+}
+
 QIcon IconLoaderImpl::doLoadIcon(const QString &name)
 {
-	return iconManager()->getIcon(name);
+	ensureIndex();
+	QHash<QString, QIcon>::const_iterator it = m_icons.constFind(name);
+	if (it != m_icons.constEnd())
+		return it.value();
+	// Icons outside of the themes are still looked up by xdg manager
+	const QIcon icon = m_index.contains(name) ? m_index.icon(name) : iconManager()->getIcon(name);
+	m_icons.insert(name, icon);
+	return icon;
 }
 
 QMovie *IconLoaderImpl::doLoadMovie(const QString &name)
@@ -119,7 +137,10 @@ QMovie *IconLoaderImpl::doLoadMovie(const QString &name)
 
 QString IconLoaderImpl::doIconPath(const QString &name, uint iconSize)
 {
-	qDebug() << Q_FUNC_INFO << name << iconSize << iconManager()->currentTheme()->getIconPath(name, iconSize);
+	ensureIndex();
+	const QString path = m_index.iconPath(name, iconSize);
+	if (!path.isEmpty())
+		return path;
 	return iconManager()->currentTheme()->getIconPath(name, iconSize);
 }
 
@@ -152,6 +173,7 @@ void IconLoaderImpl::onSettingsChanged()
 	}
 	iconManager()->setCurrentTheme(theme->id());
     QIcon::setThemeName(theme->id());
+	ensureIndex();
 }
 
 void IconLoaderImpl::initSettings()
@@ -30,6 +30,7 @@
 #include <qutim/settingswidget.h>
 #include <qutim/settingslayer.h>
 #include <QComboBox>
+#include "iconthemeindex.h"
 
 using namespace qutim_sdk_0_3;
 
@@ -68,7 +69,12 @@ protected:
 	QString doMoviePath(const QString &name, uint iconSize);
 
 private:
+	void ensureIndex();
+
 	QScopedPointer<SettingsItem> m_settings;
+	IconThemeIndex m_index;
+	// Icons share their engines, so every name is decoded once
+	QHash<QString, QIcon> m_icons;
 };
 }
 
@@ -0,0 +1,304 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "iconthemeindex.h"
+#include <qutim/systeminfo.h>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QDir>
+#include <climits>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+enum { CacheMagic = 0x51494458, CacheVersion = 1 };
+
+static const char * const extensions[] = { ".png", ".svg", ".svgz", ".xpm" };
+enum { ExtensionsCount = sizeof(extensions) / sizeof(extensions[0]) };
+
+IconThemeIndex::IconThemeIndex()
+{
+}
+
+void IconThemeIndex::load(const QString &themeId, const QStringList &searchPaths)
+{
+	clear();
+	m_themeId = themeId;
+	m_searchPaths = searchPaths;
+	if (readCache())
+		return;
+	clear();
+	build();
+	writeCache();
+}
+
+void IconThemeIndex::clear()
+{
+	m_directories.clear();
+	m_files.clear();
+	m_stamps.clear();
+}
+
+QIcon IconThemeIndex::icon(const QString &name) const
+{
+	QIcon result;
+	const QVector<File> files = m_files.value(name);
+	// Scalable file goes first, so svg engine is used for the whole icon
+	for (int i = 0; i < files.size(); ++i) {
+		if (m_directories.at(files.at(i).directory).scalable)
+			result.addFile(filePath(name, files.at(i)));
+	}
+	for (int i = 0; i < files.size(); ++i) {
+		const Directory &directory = m_directories.at(files.at(i).directory);
+		if (!directory.scalable)
+			result.addFile(filePath(name, files.at(i)), QSize(directory.size, directory.size));
+	}
+	return result;
+}
+
+QString IconThemeIndex::iconPath(const QString &name, uint iconSize) const
+{
+	QHash<QString, QVector<File> >::const_iterator it = m_files.constFind(name);
+	if (it == m_files.constEnd())
+		return QString();
+
+	int best = -1;
+	int bestDistance = INT_MAX;
+	for (int i = 0; i < it->size(); ++i) {
+		const Directory &directory = m_directories.at(it->at(i).directory);
+		int distance;
+		if (iconSize == 0)
+			distance = directory.scalable ? 0 : 0xffff - directory.size;
+		else if (iconSize < directory.minSize)
+			distance = directory.minSize - iconSize;
+		else if (iconSize > directory.maxSize)
+			distance = iconSize - directory.maxSize;
+		else
+			distance = 0;
+		if (distance < bestDistance) {
+			best = i;
+			bestDistance = distance;
+		}
+	}
+	return filePath(name, it->at(best));
+}
+
+void IconThemeIndex::build()
+{
+	QStringList chain;
+	QStringList queue(m_themeId);
+	QHash<QString, int> owners;
+	forever {
+		// Every theme falls back to hicolor at the end
+		if (queue.isEmpty()) {
+			if (chain.contains(QLatin1String("hicolor")))
+				break;
+			queue << QLatin1String("hicolor");
+		}
+		const QString id = queue.takeFirst();
+		if (id.isEmpty() || chain.contains(id))
+			continue;
+		chain << id;
+		const int themeIndex = chain.size() - 1;
+
+		QStringList themeDirs;
+		QString indexFile;
+		foreach (const QString &searchPath, m_searchPaths) {
+			const QString themeDir = searchPath + QLatin1Char('/') + id;
+			addStamp(themeDir);
+			if (!QFileInfo(themeDir).isDir())
+				continue;
+			themeDirs << themeDir;
+			if (indexFile.isEmpty() && QFile::exists(themeDir + QLatin1String("/index.theme")))
+				indexFile = themeDir + QLatin1String("/index.theme");
+		}
+		if (indexFile.isEmpty())
+			continue;
+		addStamp(indexFile);
+
+		QSettings index(indexFile, QSettings::IniFormat);
+		const QStringList subdirs = index.value(QLatin1String("Icon Theme/Directories")).toStringList();
+		queue << index.value(QLatin1String("Icon Theme/Inherits")).toStringList();
+
+		foreach (const QString &subdir, subdirs) {
+			index.beginGroup(subdir);
+			const int size = index.value(QLatin1String("Size")).toInt();
+			const QString type = index.value(QLatin1String("Type"), QLatin1String("Threshold")).toString();
+			Directory directory;
+			directory.size = size;
+			directory.scalable = type == QLatin1String("Scalable");
+			if (type == QLatin1String("Fixed")) {
+				directory.minSize = size;
+				directory.maxSize = size;
+			} else if (directory.scalable) {
+				directory.minSize = index.value(QLatin1String("MinSize"), size).toInt();
+				directory.maxSize = index.value(QLatin1String("MaxSize"), size).toInt();
+			} else {
+				const int threshold = index.value(QLatin1String("Threshold"), 2).toInt();
+				directory.minSize = qMax(0, size - threshold);
+				directory.maxSize = size + threshold;
+			}
+			index.endGroup();
+
+			foreach (const QString &themeDir, themeDirs) {
+				directory.path = themeDir + QLatin1Char('/') + subdir;
+				addStamp(directory.path);
+				const QStringList files = QDir(directory.path).entryList(QDir::Files);
+				if (files.isEmpty())
+					continue;
+				const quint16 directoryIndex = m_directories.size();
+				m_directories << directory;
+				foreach (const QString &fileName, files) {
+					for (int i = 0; i < ExtensionsCount; ++i) {
+						const QLatin1String extension(extensions[i]);
+						if (!fileName.endsWith(extension))
+							continue;
+						const QString name = fileName.left(fileName.size() - extension.size());
+						// Icon of the theme itself hides ones from its parents
+						QHash<QString, int>::iterator owner = owners.find(name);
+						if (owner == owners.end())
+							owner = owners.insert(name, themeIndex);
+						else if (owner.value() != themeIndex)
+							break;
+						File file = { directoryIndex, quint8(i) };
+						m_files[name].append(file);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+QString IconThemeIndex::cacheFileName() const
+{
+	const QByteArray key = (m_themeId + QLatin1Char('\n') + m_searchPaths.join(QLatin1String("\n"))).toUtf8();
+	const QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+	return SystemInfo::getDir(SystemInfo::ConfigDir).filePath(QLatin1String("cache/icons/")
+															  + QLatin1String(hash.toHex()));
+}
+
+static qint64 modificationTime(const QString &path)
+{
+	const QFileInfo info(path);
+	return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+void IconThemeIndex::addStamp(const QString &path)
+{
+	Stamp stamp = { path, modificationTime(path) };
+	m_stamps << stamp;
+}
+
+bool IconThemeIndex::readCache()
+{
+	QFile file(cacheFileName());
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, version, count;
+	QString themeId;
+	QStringList searchPaths;
+	in >> magic >> version;
+	if (magic != CacheMagic || version != CacheVersion)
+		return false;
+	in >> themeId >> searchPaths >> count;
+	if (themeId != m_themeId || searchPaths != m_searchPaths)
+		return false;
+	// Installed or removed icons change modification time of their directories
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		Stamp stamp;
+		in >> stamp.path >> stamp.modified;
+		if (stamp.modified != modificationTime(stamp.path))
+			return false;
+		m_stamps << stamp;
+	}
+
+	in >> count;
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		Directory directory;
+		in >> directory.path >> directory.size >> directory.minSize >> directory.maxSize >> directory.scalable;
+		m_directories << directory;
+	}
+
+	in >> count;
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		QString name;
+		quint32 filesCount;
+		in >> name >> filesCount;
+		QVector<File> &files = m_files[name];
+		files.reserve(filesCount);
+		for (quint32 j = 0; j < filesCount && in.status() == QDataStream::Ok; ++j) {
+			File file;
+			in >> file.directory >> file.extension;
+			if (file.directory >= m_directories.size() || file.extension >= ExtensionsCount)
+				return false;
+			files << file;
+		}
+	}
+	return in.status() == QDataStream::Ok;
+}
+
+void IconThemeIndex::writeCache() const
+{
+	const QString fileName = cacheFileName();
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint32(CacheMagic) << quint32(CacheVersion) << m_themeId << m_searchPaths;
+
+	out << quint32(m_stamps.size());
+	foreach (const Stamp &stamp, m_stamps)
+		out << stamp.path << stamp.modified;
+
+	out << quint32(m_directories.size());
+	foreach (const Directory &directory, m_directories)
+		out << directory.path << directory.size << directory.minSize << directory.maxSize << directory.scalable;
+
+	out << quint32(m_files.size());
+	for (QHash<QString, QVector<File> >::const_iterator it = m_files.constBegin(); it != m_files.constEnd(); ++it) {
+		out << it.key() << quint32(it->size());
+		foreach (const File &file, *it)
+			out << file.directory << file.extension;
+	}
+	file.commit();
+}
+
+QString IconThemeIndex::filePath(const QString &name, const File &file) const
+{
+	return m_directories.at(file.directory).path + QLatin1Char('/') + name
+			+ QLatin1String(extensions[file.extension]);
+}
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef ICONTHEMEINDEX_H
+#define ICONTHEMEINDEX_H
+
+#include <QHash>
+#include <QIcon>
+#include <QStringList>
+#include <QVector>
+
+namespace Core
+{
+// Merged index of icon theme and all of its parents, it's built once by
+// scanning theme directories and then kept in the cache until any of them
+// is modified, so icons are found without touching the file system
+class IconThemeIndex
+{
+public:
+	IconThemeIndex();
+
+	void load(const QString &themeId, const QStringList &searchPaths);
+	QString themeId() const { return m_themeId; }
+
+	bool contains(const QString &name) const { return m_files.contains(name); }
+	QIcon icon(const QString &name) const;
+	QString iconPath(const QString &name, uint iconSize) const;
+
+private:
+	struct Directory
+	{
+		QString path;
+		quint16 size;
+		quint16 minSize;
+		quint16 maxSize;
+		bool scalable;
+	};
+	struct File
+	{
+		quint16 directory;
+		quint8 extension;
+	};
+	struct Stamp
+	{
+		QString path;
+		qint64 modified;
+	};
+
+	void clear();
+	void build();
+	QString cacheFileName() const;
+	bool readCache();
+	void writeCache() const;
+	void addStamp(const QString &path);
+	QString filePath(const QString &name, const File &file) const;
+
+	QString m_themeId;
+	QStringList m_searchPaths;
+	QVector<Directory> m_directories;
+	QHash<QString, QVector<File> > m_files;
+	QList<Stamp> m_stamps;
+};
+}
+
+#endif // ICONTHEMEINDEX_H
@@ -40,7 +40,8 @@ AbstractSearchForm::AbstractSearchForm(const QList<AbstractSearchFactory*> &fact
 									   QWidget *parent) :
 	QWidget(parent),
 	m_resultModel(new ResultModel(this)),
-	m_requestsModel(new RequestsListModel(factories, this))
+	m_requestsModel(new RequestsListModel(factories, this)),
+	m_done(true)
 {
 	setWindowIcon(icon);
 	setWindowTitle(title);
@@ -64,10 +65,10 @@ bool AbstractSearchForm::startSearch()
 		return false;
 	Q_ASSERT(m_currentRequest);
 	if (m_searchFieldsWidget) {
-		m_resultModel->beginResetModel();
-		m_currentRequest->start(m_searchFieldsWidget.data()->item());
-		m_resultModel->endResetModel();
+		// Results of the previous search must not be mixed with new ones
+		cancelSearch();
 		m_done = false;
+		m_resultModel->startRequest(m_searchFieldsWidget.data()->item());
 		return true;
 	}
 	return false;
@@ -84,6 +85,8 @@ bool AbstractSearchForm::cancelSearch()
 
 void AbstractSearchForm::setCurrentRequest(RequestPtr request)
 {
+	cancelSearch();
+	m_done = true;
 	if (m_currentRequest)
 		m_currentRequest->disconnect(this);
 	m_currentRequest = request;
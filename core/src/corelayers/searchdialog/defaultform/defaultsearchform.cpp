@@ -45,6 +45,8 @@ DefaultSearchForm::DefaultSearchForm(const QList<AbstractSearchFactory*> &factor
     ui.progressBar->setVisible(false);
     ui.resultView->setModel(resultModel());
     ui.resultView->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    // Columns are fitted to the visible page rather than to all results
+    ui.resultView->horizontalHeader()->setResizeContentsPrecision(100);
     ui.requestBox->setModel(requestsModel());
     connect(ui.searchButton, SIGNAL(clicked()), SLOT(startSearch()));
     connect(ui.cancelButton, SIGNAL(clicked()), SLOT(cancelSearch()));
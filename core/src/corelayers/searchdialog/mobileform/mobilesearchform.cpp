@@ -46,6 +46,8 @@ MobileSearchForm::MobileSearchForm(const QList<AbstractSearchFactory*> &factorie
 	ui.resultView->setModel(resultModel());
 	ui.resultView->setItemDelegate(new ItemDelegate(this));
 	ui.resultView->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+	// Columns are fitted to the visible page rather than to all results
+	ui.resultView->horizontalHeader()->setResizeContentsPrecision(100);
 	ui.requestBox->setModel(requestsModel());
 
 	m_action->setText(QT_TRANSLATE_NOOP("SearchForm","Search"));
@@ -26,10 +26,14 @@
 #include "resultmodel.h"
 #include <qutim/itemdelegate.h>
 
+#include <QTimerEvent>
+
 namespace Core {
 
+enum { PageSize = 200, InsertInterval = 100 };
+
 ResultModel::ResultModel(QObject *parent) :
-    QAbstractListModel(parent)
+    QAbstractListModel(parent), m_rowCount(0), m_limit(PageSize)
 {
 }
 
@@ -39,20 +43,33 @@ void ResultModel::setRequest(const RequestPtr &request)
     if (m_request)
         m_request->disconnect(this);
     m_request = request;
+    m_rowCount = 0;
+    m_limit = PageSize;
+    m_insertTimer.stop();
     if (m_request) {
-        connect(m_request.data(), SIGNAL(rowAboutToBeAdded(int)), SLOT(onRowAboutToBeAdded(int)));
-        connect(m_request.data(), SIGNAL(rowAdded(int)), SLOT(onRowAdded(int)));
+        connect(m_request.data(), SIGNAL(rowsAdded(int,int)), SLOT(onRowsAdded()));
+        connect(m_request.data(), SIGNAL(rowAdded(int)), SLOT(onRowsAdded()));
     }
     endResetModel();
+    if (m_request && m_request->rowCount() > 0)
+        onRowsAdded();
+}
+
+void ResultModel::startRequest(const DataItem &fields)
+{
+    beginResetModel();
+    m_rowCount = 0;
+    m_limit = PageSize;
+    m_insertTimer.stop();
+    m_request->start(fields);
+    endResetModel();
 }
 
 int ResultModel::rowCount(const QModelIndex &parent) const
 {
-    Q_UNUSED(parent);
-    if (m_request)
-        return m_request->rowCount();
-    else
+    if (parent.isValid())
         return 0;
+    return m_rowCount;
 }
 
 int ResultModel::columnCount(const QModelIndex &parent) const
@@ -95,16 +112,49 @@ QVariant ResultModel::headerData(int section, Qt::Orientation orientation, int r
     return QVariant();
 }
 
-void ResultModel::onRowAboutToBeAdded(int row)
+bool ResultModel::canFetchMore(const QModelIndex &parent) const
 {
-    beginInsertRows(QModelIndex(), row, row);
+    return !parent.isValid() && m_request && m_rowCount < m_request->rowCount();
 }
 
-void ResultModel::onRowAdded(int row)
+void ResultModel::fetchMore(const QModelIndex &parent)
 {
-    Q_UNUSED(row);
+    if (parent.isValid())
+        return;
+    m_limit = m_rowCount + PageSize;
+    insertPending();
+}
+
+void ResultModel::onRowsAdded()
+{
+    // Directory searches return thousands of rows, one by one
+    if (!m_insertTimer.isActive())
+        m_insertTimer.start(InsertInterval, this);
+}
+
+void ResultModel::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_insertTimer.timerId()) {
+        m_insertTimer.stop();
+        insertPending();
+    } else {
+        QAbstractListModel::timerEvent(event);
+    }
+}
+
+void ResultModel::insertPending()
+{
+    if (!m_request)
+        return;
+    const int count = qMin(m_request->rowCount(), m_limit);
+    if (count <= m_rowCount)
+        return;
+    const int first = m_rowCount;
+    beginInsertRows(QModelIndex(), first, count - 1);
+    m_rowCount = count;
     endInsertRows();
-    emit rowAdded(row);
+    for (int row = first; row < count; ++row)
+        emit rowAdded(row);
 }
 
 
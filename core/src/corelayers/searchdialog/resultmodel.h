@@ -27,6 +27,7 @@
 #define RESULTMODEL_H
 
 #include <QAbstractListModel>
+#include <QBasicTimer>
 #include <QPointer>
 #include "requestslistmodel.h"
 
@@ -39,18 +40,29 @@ public:
     explicit ResultModel(QObject *parent = 0);
     RequestPtr request() { return m_request; }
     void setRequest(const RequestPtr &request);
+    void startRequest(const DataItem &fields);
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
     virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
 signals:
     void rowAdded(int row);
+protected:
+    virtual void timerEvent(QTimerEvent *event);
 private slots:
-    void onRowAboutToBeAdded(int row);
-    void onRowAdded(int row);
+    void onRowsAdded();
 private:
+    void insertPending();
+
     friend class AbstractSearchForm;
     RequestPtr m_request;
+    // Views see only rows announced by the model, they are inserted
+    // by batches and no more than views have asked for
+    int m_rowCount;
+    int m_limit;
+    QBasicTimer m_insertTimer;
 };
 
 } // namespace Core
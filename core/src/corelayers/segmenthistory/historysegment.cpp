@@ -0,0 +1,365 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "historysegment.h"
+#include <QDataStream>
+#include <QtEndian>
+#include <qutim/debug.h>
+
+namespace Core
+{
+static const char dataMagic[] = "QHSG";
+static const char indexMagic[] = "QHSI";
+
+static QByteArray header(const char *magic)
+{
+    QByteArray result(magic, 4);
+    uchar version[4];
+    qToLittleEndian<quint32>(HistorySegment::Version, version);
+    result.append(reinterpret_cast<const char *>(version), 4);
+    return result;
+}
+
+static bool checkHeader(QFile &file, const char *magic)
+{
+    file.seek(0);
+    return file.read(HistorySegment::HeaderSize) == header(magic);
+}
+
+static bool isStorable(const QVariant &value)
+{
+    const int type = value.userType();
+    return value.isValid()
+            && type < QMetaType::User
+            && type != QMetaType::QObjectStar
+            && type != QMetaType::VoidStar;
+}
+
+// Reads records of data starting at offset and writes index entries for them,
+// returns position after the last complete record
+static qint64 scanRecords(QFile &data, qint64 offset, QByteArray &entries)
+{
+    const qint64 size = data.size();
+    uchar buffer[HistorySegment::EntrySize];
+    while (offset + 4 <= size) {
+        data.seek(offset);
+        QByteArray length = data.read(4);
+        if (length.size() != 4)
+            break;
+        const qint64 recordSize = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(length.constData()));
+        if (offset + 4 + recordSize > size)
+            break;
+        Message message;
+        if (!HistorySegment::decode(data.read(recordSize), message))
+            break;
+        qToLittleEndian<quint64>(offset, buffer);
+        qToLittleEndian<qint64>(message.time().toMSecsSinceEpoch(), buffer + 8);
+        entries.append(reinterpret_cast<const char *>(buffer), HistorySegment::EntrySize);
+        offset += 4 + recordSize;
+    }
+    return offset;
+}
+
+HistorySegment::HistorySegment(const QString &dataPath)
+    : m_data(dataPath), m_index(indexPath(dataPath)), m_map(0), m_count(0), m_dataEnd(0)
+{
+}
+
+HistorySegment::~HistorySegment()
+{
+    close();
+}
+
+QString HistorySegment::indexPath(const QString &dataPath)
+{
+    QString result = dataPath;
+    if (result.endsWith(QStringLiteral(".seg")))
+        result.chop(4);
+    return result + QStringLiteral(".idx");
+}
+
+bool HistorySegment::openForRead()
+{
+    close();
+    if (!m_data.open(QIODevice::ReadOnly) || !checkHeader(m_data, dataMagic))
+        return false;
+    return readIndex();
+}
+
+bool HistorySegment::readIndex()
+{
+    if (m_index.open(QIODevice::ReadOnly) && checkHeader(m_index, indexMagic)) {
+        const qint64 size = m_index.size();
+        m_count = (size - HeaderSize) / EntrySize;
+        if (m_count > 0)
+            m_map = m_index.map(0, HeaderSize + m_count * EntrySize);
+        if (!m_map && m_count > 0) {
+            m_index.seek(0);
+            m_indexData = m_index.read(HeaderSize + m_count * EntrySize);
+        }
+    } else {
+        m_count = 0;
+    }
+
+    // Index is written after the data, so after crash (or while somebody is
+    // appending right now) it may miss the tail of the records
+    qint64 offset = HeaderSize;
+    if (m_count > 0) {
+        m_data.seek(offsetAt(m_count - 1));
+        QByteArray length = m_data.read(4);
+        if (length.size() != 4)
+            return false;
+        offset = offsetAt(m_count - 1) + 4
+                + qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(length.constData()));
+    }
+    if (offset < m_data.size()) {
+        if (m_map) {
+            m_indexData = QByteArray(reinterpret_cast<const char *>(m_map), HeaderSize + m_count * EntrySize);
+            m_index.unmap(const_cast<uchar *>(m_map));
+            m_map = 0;
+        } else if (m_indexData.isEmpty()) {
+            m_indexData = header(indexMagic);
+        }
+        offset = scanRecords(m_data, offset, m_indexData);
+        m_count = (m_indexData.size() - HeaderSize) / EntrySize;
+    }
+    m_dataEnd = offset;
+    return true;
+}
+
+bool HistorySegment::openForAppend()
+{
+    close();
+    if (!m_data.open(QIODevice::ReadWrite) || !m_index.open(QIODevice::ReadWrite))
+        return false;
+
+    if (m_data.size() == 0) {
+        m_data.write(header(dataMagic));
+        m_index.resize(0);
+    } else if (!checkHeader(m_data, dataMagic)) {
+        qWarning() << "Unknown history segment format:" << m_data.fileName();
+        return false;
+    }
+    if (m_index.size() < HeaderSize || !checkHeader(m_index, indexMagic)) {
+        m_index.resize(0);
+        m_index.seek(0);
+        m_index.write(header(indexMagic));
+    }
+    return repairIndex();
+}
+
+bool HistorySegment::repairIndex()
+{
+    m_count = (m_index.size() - HeaderSize) / EntrySize;
+    m_index.resize(HeaderSize + m_count * EntrySize);
+
+    qint64 offset = HeaderSize;
+    while (m_count > 0) {
+        m_index.seek(HeaderSize + (m_count - 1) * EntrySize);
+        QByteArray entry = m_index.read(EntrySize);
+        const qint64 last = qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(entry.constData()));
+        m_data.seek(last);
+        QByteArray length = m_data.read(4);
+        if (length.size() == 4) {
+            const qint64 end = last + 4 + qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(length.constData()));
+            if (end <= m_data.size()) {
+                offset = end;
+                break;
+            }
+        }
+        // Entry points outside of the data, forget it
+        m_index.resize(HeaderSize + --m_count * EntrySize);
+    }
+
+    QByteArray entries;
+    m_dataEnd = scanRecords(m_data, offset, entries);
+    if (!entries.isEmpty()) {
+        m_index.seek(m_index.size());
+        m_index.write(entries);
+        m_count += entries.size() / EntrySize;
+    }
+    // Drop partially written record, if any
+    if (m_data.size() > m_dataEnd)
+        m_data.resize(m_dataEnd);
+    return true;
+}
+
+void HistorySegment::close()
+{
+    if (m_map)
+        m_index.unmap(const_cast<uchar *>(m_map));
+    m_map = 0;
+    m_indexData.clear();
+    m_count = 0;
+    m_dataEnd = 0;
+    m_data.close();
+    m_index.close();
+}
+
+int HistorySegment::count() const
+{
+    return m_count;
+}
+
+qint64 HistorySegment::offsetAt(int index) const
+{
+    const uchar *entries = m_map ? m_map : reinterpret_cast<const uchar *>(m_indexData.constData());
+    return qFromLittleEndian<quint64>(entries + HeaderSize + index * EntrySize);
+}
+
+qint64 HistorySegment::timeAt(int index) const
+{
+    const uchar *entries = m_map ? m_map : reinterpret_cast<const uchar *>(m_indexData.constData());
+    return qFromLittleEndian<qint64>(entries + HeaderSize + index * EntrySize + 8);
+}
+
+int HistorySegment::lowerBound(qint64 msecs) const
+{
+    // Messages are appended in chronological order, same as JsonHistory assumes
+    int first = 0;
+    int length = m_count;
+    while (length > 0) {
+        const int half = length / 2;
+        if (timeAt(first + half) < msecs) {
+            first += half + 1;
+            length -= half + 1;
+        } else {
+            length = half;
+        }
+    }
+    return first;
+}
+
+bool HistorySegment::messageAt(int index, Message &message)
+{
+    if (index < 0 || index >= m_count)
+        return false;
+    const qint64 offset = offsetAt(index);
+    if (!m_data.seek(offset))
+        return false;
+    QByteArray length = m_data.read(4);
+    if (length.size() != 4)
+        return false;
+    const qint64 size = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(length.constData()));
+    return decode(m_data.read(size), message);
+}
+
+bool HistorySegment::append(const QList<Message> &messages)
+{
+    if (!m_data.isOpen() || !m_data.isWritable())
+        return false;
+
+    QByteArray records;
+    QByteArray entries;
+    uchar buffer[EntrySize];
+    qint64 offset = m_dataEnd;
+    for (const Message &message : messages) {
+        const QByteArray record = encode(message);
+        qToLittleEndian<quint32>(record.size(), buffer);
+        records.append(reinterpret_cast<const char *>(buffer), 4);
+        records.append(record);
+
+        qToLittleEndian<quint64>(offset, buffer);
+        qToLittleEndian<qint64>(message.time().isValid()
+                                ? message.time().toMSecsSinceEpoch()
+                                : QDateTime::currentMSecsSinceEpoch(),
+                                buffer + 8);
+        entries.append(reinterpret_cast<const char *>(buffer), EntrySize);
+        offset += 4 + record.size();
+    }
+
+    m_data.seek(m_dataEnd);
+    if (m_data.write(records) != records.size()) {
+        m_data.resize(m_dataEnd);
+        return false;
+    }
+    m_data.flush();
+    m_dataEnd = offset;
+
+    m_index.seek(HeaderSize + m_count * EntrySize);
+    m_index.write(entries);
+    m_index.flush();
+    m_count += messages.size();
+    return true;
+}
+
+bool HistorySegment::clear()
+{
+    if (!m_data.isOpen() || !m_data.isWritable())
+        return false;
+    if (!m_data.resize(HeaderSize) || !m_index.resize(HeaderSize))
+        return false;
+    m_count = 0;
+    m_dataEnd = HeaderSize;
+    return true;
+}
+
+QByteArray HistorySegment::encode(const Message &message)
+{
+    QVariantMap properties;
+    foreach (const QByteArray &name, message.dynamicPropertyNames()) {
+        QVariant value = message.property(name);
+        if (isStorable(value))
+            properties.insert(QString::fromUtf8(name), value);
+    }
+
+    QDateTime time = message.time();
+    if (!time.isValid())
+        time = QDateTime::currentDateTime();
+
+    QByteArray result;
+    QDataStream out(&result, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << qint64(time.toMSecsSinceEpoch())
+        << message.isIncoming()
+        << message.text()
+        << message.html()
+        << properties;
+    return result;
+}
+
+bool HistorySegment::decode(const QByteArray &data, Message &message)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+    qint64 time;
+    bool incoming;
+    QString text;
+    QString html;
+    QVariantMap properties;
+    in >> time >> incoming >> text >> html >> properties;
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+        message.setProperty(it.key().toUtf8(), it.value());
+    message.setTime(QDateTime::fromMSecsSinceEpoch(time));
+    message.setIncoming(incoming);
+    message.setText(text);
+    message.setHtml(html);
+    return true;
+}
+
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef HISTORYSEGMENT_H
+#define HISTORYSEGMENT_H
+
+#include <qutim/message.h>
+#include <QFile>
+#include <QVector>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+
+/**
+ * One contact-month of history, kept as two files:
+ *
+ * @li "<contact>.<yyyyMM>.seg" - header followed by length-prefixed records
+ * @li "<contact>.<yyyyMM>.idx" - header followed by fixed-size entries, one
+ * per record, with record offset and timestamp
+ *
+ * Both files are append-only, so storing a message never touches already
+ * written data and reading the tail of a month is a binary search over the
+ * index and a few seeks.
+ */
+class HistorySegment
+{
+public:
+    enum { Version = 1, HeaderSize = 8, EntrySize = 16 };
+
+    HistorySegment(const QString &dataPath);
+    ~HistorySegment();
+
+    bool openForRead();
+    bool openForAppend();
+    void close();
+
+    int count() const;
+    qint64 offsetAt(int index) const;
+    qint64 timeAt(int index) const;
+    // Index of first record with time not less than msecs
+    int lowerBound(qint64 msecs) const;
+    bool messageAt(int index, Message &message);
+
+    bool append(const QList<Message> &messages);
+    // Drops all records of segment opened for append
+    bool clear();
+
+    static QString indexPath(const QString &dataPath);
+
+    static QByteArray encode(const Message &message);
+    static bool decode(const QByteArray &data, Message &message);
+
+private:
+    bool readIndex();
+    bool repairIndex();
+
+    QFile m_data;
+    QFile m_index;
+    const uchar *m_map;
+    QByteArray m_indexData;
+    int m_count;
+    qint64 m_dataEnd;
+};
+
+}
+
+#endif // HISTORYSEGMENT_H
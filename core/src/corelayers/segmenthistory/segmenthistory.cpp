@@ -0,0 +1,419 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "segmenthistory.h"
+#include "historysegment.h"
+#include <qutim/chatunit.h>
+#include <qutim/systeminfo.h>
+#include <qutim/icon.h>
+#include <qutim/debug.h>
+#include <qutim/executor.h>
+#include <qutim/metrics.h>
+#include <QMap>
+#include <algorithm>
+
+namespace Core
+{
+static Gauge *queueDepthGauge()
+{
+    static Gauge *gauge = Metrics::gauge("qutim_history_queue_depth", QStringLiteral("backend=\"segment\""));
+    return gauge;
+}
+
+SegmentHistoryStoreJob::SegmentHistoryStoreJob(SegmentHistoryScope::Ptr scope) : d(scope)
+{
+    d->hasRunnable = true;
+}
+
+void SegmentHistoryStoreJob::operator()()
+{
+    forever {
+        d->mutex.lock();
+        if (d->queue.isEmpty()) {
+            d->hasRunnable = false;
+            d->mutex.unlock();
+            break;
+        }
+        auto it = d->queue.begin();
+        QDate month = it->second.time().date();
+        month = QDate(month.year(), month.month(), 1);
+        auto firstContact = it->first;
+        QList<Message> messages;
+        while (it != d->queue.end()) {
+            QDate date = it->second.time().date();
+            if (firstContact == it->first
+                    && date.year() == month.year()
+                    && date.month() == month.month()) {
+                messages << it->second;
+                it = d->queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        queueDepthGauge()->set(d->queue.size());
+        d->mutex.unlock();
+
+        QMutexLocker locker(&d->fileMutex);
+        HistorySegment segment(d->getFileName(firstContact, month));
+        if (!segment.openForAppend() || !segment.append(messages))
+            qWarning() << "Can't store" << messages.size() << "messages to history of" << firstContact.contact;
+    }
+}
+
+static QDate monthFromFileName(const QString &fileName)
+{
+    const QString date = fileName.section(QLatin1Char('.'), -2, -2);
+    if (date.length() != 6)
+        return QDate();
+    return QDate(date.mid(0, 4).toInt(), date.mid(4, 2).toInt(), 1);
+}
+
+static QStringList segmentFiles(const QDir &dir, const QString &contact)
+{
+    const QStringList filters = QStringList() << SegmentHistory::quote(contact) + QStringLiteral(".*.seg");
+    return dir.entryList(filters, QDir::Readable | QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+}
+
+QString SegmentHistoryScope::getFileName(const History::ContactInfo &info, const QDate &time) const
+{
+    QDir accountDir = getAccountDir(info);
+    QString fileName = SegmentHistory::quote(info.contact);
+    fileName += (time.isValid() ? time : QDate::currentDate())
+            .toString(QStringLiteral(".yyyyMM.'seg'"));
+    return accountDir.filePath(fileName);
+}
+
+QDir SegmentHistoryScope::getAccountDir(const History::AccountInfo &info) const
+{
+    QDir historyDir = SystemInfo::getDir(SystemInfo::HistoryDir);
+    QString path = SegmentHistory::quote(info.protocol);
+    path += QLatin1Char('.');
+    path += SegmentHistory::quote(info.account);
+    if (!historyDir.exists(path))
+        historyDir.mkpath(path);
+    return historyDir.filePath(path);
+}
+
+SegmentHistory::SegmentHistory() : m_scope(new SegmentHistoryScope)
+{
+    ActionGenerator *gen = new ActionGenerator(Icon("view-history"),
+                                               QT_TRANSLATE_NOOP("Chat", "View History"),
+                                               this,
+                                               SLOT(onHistoryActionTriggered(QObject*)));
+    gen->setType(ActionTypeChatButton|ActionTypeContactList);
+    gen->setPriority(512);
+    MenuController::addAction<ChatUnit>(gen);
+    m_scope->hasRunnable = false;
+}
+
+SegmentHistory::~SegmentHistory()
+{
+}
+
+void SegmentHistory::store(const Message &message)
+{
+    if (!message.chatUnit())
+        return;
+
+    QMutexLocker locker(&m_scope->mutex);
+    m_scope->queue << qMakePair(info(message.chatUnit()), message);
+    queueDepthGauge()->set(m_scope->queue.size());
+    if (!m_scope->hasRunnable)
+        executor()->run(SegmentHistoryStoreJob(m_scope), Executor::BackgroundPriority);
+}
+
+void SegmentHistory::virtual_hook(int id, void *data)
+{
+    switch (id) {
+    case StoreBatchHook: {
+        StoreBatchArgument &argument = *reinterpret_cast<StoreBatchArgument*>(data);
+        doStoreBatch(argument.contact, argument.messages);
+        argument.handled = true;
+        break;
+    }
+    default:
+        History::virtual_hook(id, data);
+    }
+}
+
+void SegmentHistory::doStoreBatch(const ContactInfo &contact, const MessageList &messages)
+{
+    if (messages.isEmpty())
+        return;
+
+    auto scope = m_scope;
+    executor()->run([scope, contact, messages] () {
+        QMap<QDate, MessageList> months;
+        for (const Message &message : messages) {
+            const QDate date = message.time().date();
+            if (date.isValid())
+                months[QDate(date.year(), date.month(), 1)] << message;
+        }
+
+        QMutexLocker locker(&scope->fileMutex);
+        for (auto it = months.begin(); it != months.end(); ++it) {
+            const MessageList incoming = History::merge(MessageList(), it.value());
+
+            const QString fileName = scope->getFileName(contact, it.key());
+            HistorySegment segment(fileName);
+            if (!segment.openForAppend()) {
+                qWarning() << "Can't import" << incoming.size() << "messages to history of" << contact.contact;
+                continue;
+            }
+
+            // Usual import of a new month or of newer messages, nothing to merge
+            const qint64 first = incoming.first().time().toMSecsSinceEpoch();
+            if (segment.count() == 0 || segment.timeAt(segment.count() - 1) < first) {
+                segment.append(incoming);
+                continue;
+            }
+
+            MessageList existing;
+            existing.reserve(segment.count());
+            for (int i = 0; i < segment.count(); ++i) {
+                Message message;
+                if (segment.messageAt(i, message))
+                    existing << message;
+            }
+
+            const MessageList unique = History::merge(existing, incoming);
+            if (unique.size() == existing.size())
+                continue;
+
+            if (!segment.clear() || !segment.append(unique))
+                qWarning() << "Can't import" << incoming.size() << "messages to history of" << contact.contact;
+        }
+    }, Executor::BulkPriority);
+}
+
+AsyncResult<MessageList> SegmentHistory::read(const ContactInfo &info, const QDateTime &from, const QDateTime &to, int max_num)
+{
+    AsyncResultHandler<MessageList> handler;
+    auto scope = m_scope;
+
+    executor()->run([scope, info, from, to, max_num, handler] () {
+        QDir dir = scope->getAccountDir(info);
+        QStringList files = segmentFiles(dir, info.contact);
+        const QDate fromMonth = from.isValid() ? QDate(from.date().year(), from.date().month(), 1) : QDate();
+        const QDate toMonth = to.isValid() ? QDate(to.date().year(), to.date().month(), 1) : QDate();
+
+        MessageList items;
+        for (int i = files.size() - 1; i >= 0; --i) {
+            const QDate month = monthFromFileName(files[i]);
+            if (toMonth.isValid() && month > toMonth)
+                continue;
+            if (fromMonth.isValid() && month < fromMonth)
+                break;
+
+            HistorySegment segment(dir.filePath(files[i]));
+            if (!segment.openForRead())
+                continue;
+
+            int index = to.isValid() ? segment.lowerBound(to.toMSecsSinceEpoch()) : segment.count();
+            while (--index >= 0) {
+                if (from.isValid() && segment.timeAt(index) < from.toMSecsSinceEpoch()) {
+                    handler.handle(items);
+                    return;
+                }
+                Message item;
+                if (!segment.messageAt(index, item))
+                    continue;
+                items.prepend(item);
+                if (max_num != -1 && items.size() >= max_num) {
+                    handler.handle(items);
+                    return;
+                }
+            }
+        }
+
+        handler.handle(items);
+    }, Executor::InteractivePriority);
+
+    return handler.result();
+}
+
+AsyncResult<QVector<History::AccountInfo>> SegmentHistory::accounts()
+{
+    AsyncResultHandler<QVector<AccountInfo>> handler;
+
+    executor()->run([handler] () {
+        QVector<AccountInfo> result;
+
+        QDir historyDir = SystemInfo::getDir(SystemInfo::HistoryDir);
+        QStringList accounts = historyDir.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+        const QStringList filter = QStringList() << QStringLiteral("*.*.seg");
+
+        foreach (const QString &account, accounts) {
+            QDir accountDir = historyDir.filePath(account);
+            if (accountDir.entryList(filter).isEmpty())
+                continue;
+
+            AccountInfo info;
+            info.protocol = account.section(QStringLiteral("."), 0, 0);
+            info.account = unquote(account.section(QStringLiteral("."), 1));
+            result << info;
+        }
+
+        handler.handle(result);
+    }, Executor::BackgroundPriority);
+
+    return handler.result();
+}
+
+AsyncResult<QVector<History::ContactInfo>> SegmentHistory::contacts(const AccountInfo &account)
+{
+    AsyncResultHandler<QVector<ContactInfo>> handler;
+
+    auto scope = m_scope;
+    executor()->run([handler, scope, account] () {
+        QVector<ContactInfo> result;
+        QSet<QString> used;
+
+        QDir accountDir = scope->getAccountDir(account);
+        const QStringList filter = QStringList() << QStringLiteral("*.*.seg");
+        foreach (const QString &contact, accountDir.entryList(filter, QDir::Files | QDir::NoDotAndDotDot)) {
+            ContactInfo info;
+            info.account = account.account;
+            info.protocol = account.protocol;
+            info.contact = unquote(contact.section(QStringLiteral("."), 0, -3));
+
+            if (!used.contains(info.contact)) {
+                used.insert(info.contact);
+                result << info;
+            }
+        }
+
+        handler.handle(result);
+    }, Executor::BackgroundPriority);
+
+    return handler.result();
+}
+
+AsyncResult<QList<QDate>> SegmentHistory::months(const ContactInfo &contact, const QRegularExpression &regex)
+{
+    Q_UNUSED(regex);
+    AsyncResultHandler<QList<QDate>> handler;
+
+    auto scope = m_scope;
+    executor()->run([handler, scope, contact] () {
+        QList<QDate> result;
+
+        QDir accountDir = scope->getAccountDir(contact);
+        foreach (const QString &fileName, segmentFiles(accountDir, contact.contact)) {
+            QDate month = monthFromFileName(fileName);
+            if (month.isValid() && !result.contains(month))
+                result << month;
+        }
+
+        std::sort(result.begin(), result.end());
+
+        handler.handle(result);
+    }, Executor::BackgroundPriority);
+
+    return handler.result();
+}
+
+AsyncResult<QList<QDate>> SegmentHistory::dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex)
+{
+    AsyncResultHandler<QList<QDate>> handler;
+
+    auto scope = m_scope;
+    executor()->run([handler, scope, contact, month, regex] () {
+        QSet<QDate> result;
+
+        HistorySegment segment(scope->getFileName(contact, month));
+        if (segment.openForRead()) {
+            const bool filter = regex.isValid() && !regex.pattern().isEmpty();
+            for (int i = 0; i < segment.count(); ++i) {
+                const QDate date = QDateTime::fromMSecsSinceEpoch(segment.timeAt(i)).date();
+                // Only decode records of days which are not matched yet
+                if (result.contains(date))
+                    continue;
+                if (filter) {
+                    Message message;
+                    if (!segment.messageAt(i, message) || !message.text().contains(regex))
+                        continue;
+                }
+                result.insert(date);
+            }
+        }
+
+        QList<QDate> sortedResult = result.toList();
+        std::sort(sortedResult.begin(), sortedResult.end());
+
+        handler.handle(sortedResult);
+    }, Executor::BackgroundPriority);
+
+    return handler.result();
+}
+
+QString SegmentHistory::quote(const QString &str)
+{
+    const static bool true_chars[128] =
+    {// 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, A, B, C, D, E, F
+/* 0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/* 1 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/* 2 */ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
+/* 3 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0,
+/* 4 */ 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 5 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0,
+/* 6 */ 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 7 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 0
+    };
+    QString result;
+    result.reserve(str.size() * 2);
+    for (const QChar c : str) {
+        if (c.unicode() < 128 && true_chars[c.unicode()]) {
+            result += c;
+        } else {
+            result += QLatin1Char('%');
+            result += QString::number(c.unicode(), 16).rightJustified(4, QLatin1Char('0'));
+        }
+    }
+    return result;
+}
+
+QString SegmentHistory::unquote(const QString &str)
+{
+    QString result;
+    result.reserve(str.size());
+    for (int i = 0; i < str.size(); ++i) {
+        if (str.at(i) == QLatin1Char('%') && i + 4 < str.size()) {
+            result += QChar(str.mid(i + 1, 4).toUShort(0, 16));
+            i += 4;
+        } else {
+            result += str.at(i);
+        }
+    }
+    return result;
+}
+
+void SegmentHistory::onHistoryActionTriggered(QObject *object)
+{
+    ChatUnit *unit = qobject_cast<ChatUnit*>(object);
+    showHistory(unit);
+}
+
+}
@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef SEGMENTHISTORY_H
+#define SEGMENTHISTORY_H
+
+#include <qutim/history.h>
+#include <QDir>
+#include <QLinkedList>
+#include <QMutex>
+
+using namespace qutim_sdk_0_3;
+
+namespace Core
+{
+
+class SegmentHistoryScope
+{
+public:
+    typedef QSharedPointer<SegmentHistoryScope> Ptr;
+
+    QString getFileName(const History::ContactInfo &info, const QDate &time) const;
+    QDir getAccountDir(const History::AccountInfo &info) const;
+
+    bool hasRunnable;
+    QLinkedList<QPair<History::ContactInfo, Message>> queue;
+    QMutex mutex;
+    // Serializes writers of segment files
+    QMutex fileMutex;
+};
+
+class SegmentHistoryStoreJob
+{
+public:
+    SegmentHistoryStoreJob(SegmentHistoryScope::Ptr scope);
+    void operator()();
+
+private:
+    SegmentHistoryScope::Ptr d;
+};
+
+class SegmentHistory : public History
+{
+    Q_OBJECT
+public:
+    SegmentHistory();
+    virtual ~SegmentHistory();
+
+    void store(const Message &message) override;
+    AsyncResult<MessageList> read(const ContactInfo &info, const QDateTime &from, const QDateTime &to, int max_num) override;
+    AsyncResult<QVector<AccountInfo>> accounts() override;
+    AsyncResult<QVector<ContactInfo>> contacts(const AccountInfo &account) override;
+    AsyncResult<QList<QDate>> months(const ContactInfo &contact, const QRegularExpression &regex) override;
+    AsyncResult<QList<QDate>> dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex) override;
+
+    // Same escaping as JsonHistory uses, so both backends share directory layout
+    static QString quote(const QString &str);
+    static QString unquote(const QString &str);
+
+protected:
+    void virtual_hook(int id, void *data) override;
+
+private slots:
+    void onHistoryActionTriggered(QObject *object);
+private:
+    void doStoreBatch(const ContactInfo &contact, const MessageList &messages);
+
+    SegmentHistoryScope::Ptr m_scope;
+};
+}
+
+#endif // SEGMENTHISTORY_H
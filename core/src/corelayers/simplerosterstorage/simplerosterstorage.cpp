@@ -26,7 +26,9 @@
 #include "simplerosterstorage.h"
 #include <qutim/account.h>
 #include <qutim/contact.h>
+#include <qutim/config.h>
 #include <qutim/debug.h>
+#include <QPointer>
 
 namespace Core
 {
@@ -42,43 +44,211 @@ SimpleRosterStorage::~SimpleRosterStorage()
 
 // TODO: Delayed saving
 
+// Contacts of factories with schema are stored as list of values in schema
+// order, only fields unknown to schema are kept in "data" map
+static QVariantMap entry_data(const QVariantMap &entry, const RosterSchema *schema)
+{
+	QVariantMap data = entry.value(QStringLiteral("data")).toMap();
+	if (schema)
+		schema->unpack(entry.value(QStringLiteral("record")).toList(), data);
+	return data;
+}
+
+static void set_entry_data(QVariantMap &entry, const RosterSchema *schema, const QVariantMap &data)
+{
+	const QString dataName = QStringLiteral("data");
+	const QString recordName = QStringLiteral("record");
+	if (!schema) {
+		entry.remove(recordName);
+		entry.insert(dataName, data);
+		return;
+	}
+	QVariantMap rest;
+	entry.insert(recordName, schema->pack(data, &rest));
+	if (rest.isEmpty())
+		entry.remove(dataName);
+	else
+		entry.insert(dataName, rest);
+}
+
+static QVariantMap config_entry(Config &cfg)
+{
+	QVariantMap entry;
+	entry.insert(QStringLiteral("data"), cfg.value(QStringLiteral("data"), QVariantMap()));
+	entry.insert(QStringLiteral("record"), cfg.value(QStringLiteral("record"), QVariantList()));
+	return entry;
+}
+
+static void set_config_entry(Config &cfg, const QVariantMap &entry)
+{
+	const QString dataName = QStringLiteral("data");
+	const QString recordName = QStringLiteral("record");
+	if (entry.contains(dataName))
+		cfg.setValue(dataName, entry.value(dataName));
+	else
+		cfg.remove(dataName);
+	if (entry.contains(recordName))
+		cfg.setValue(recordName, entry.value(recordName));
+	else
+		cfg.remove(recordName);
+}
+
+// Stubs are stored in "stubs" array with the same indexes as "contacts" one,
+// "stubsVersion" tells the roster version they were written for
+static QVariantList pack_stub(const QString &id, const QVariantMap &data, Contact *contact,
+							  LazyContactsFactory *factory)
+{
+	RosterStub stub;
+	stub.id = id;
+	factory->fillStub(data, stub);
+	if (contact)
+		stub.status = contact->status();
+	return QVariantList() << stub.id << stub.name << stub.tags << int(stub.status.type())
+						  << stub.avatar << stub.flags;
+}
+
+static RosterStub unpack_stub(const QVariantList &values)
+{
+	RosterStub stub;
+	stub.id = values.value(0).toString();
+	stub.name = values.value(1).toString();
+	stub.tags = values.value(2).toStringList();
+	stub.status = Status(static_cast<Status::Type>(values.value(3).toInt()));
+	stub.avatar = values.value(4).toString();
+	stub.flags = values.value(5).toInt();
+	return stub;
+}
+
+static QVariantMap stub_entry(const QVariantList &stub)
+{
+	QVariantMap entry;
+	entry.insert(QStringLiteral("stub"), stub);
+	return entry;
+}
+
+// Config must be at roster group
+static void set_config_stub(Config &cfg, int index, const QVariantList &stub, const QString &version)
+{
+	cfg.beginArray(QStringLiteral("stubs"));
+	cfg.setArrayIndex(index);
+	if (stub.isEmpty())
+		cfg.remove(QStringLiteral("stub"));
+	else
+		cfg.setValue(QStringLiteral("stub"), stub);
+	cfg.endArray();
+	cfg.setValue(QStringLiteral("stubsVersion"), version);
+}
+
+QVariantMap SimpleRosterStorage::contactData(Account *account, const QString &id)
+{
+	ContactsFactory *factory = account->contactsFactory();
+	auto it = m_contexts.constFind(account);
+	if (!factory || it == m_contexts.constEnd())
+		return QVariantMap();
+	const int index = it->indexes.value(id, -1);
+	if (index < 0)
+		return QVariantMap();
+	// Lazy roster is loaded only with schema of the factory
+	Config cfg = account->config();
+	cfg.beginGroup(QStringLiteral("roster"));
+	cfg.beginArray(QStringLiteral("contacts"));
+	cfg.setArrayIndex(index);
+	return entry_data(config_entry(cfg), factory->schema());
+}
+
 QString SimpleRosterStorage::load(Account *account)
 {
 	ContactsFactory *factory = account->contactsFactory();
 	AccountContext &context = m_contexts[account];
 	Q_ASSERT(factory);
+	RosterTransaction transaction(account);
 	Config cfg = account->config();
 	cfg.beginGroup(QStringLiteral("roster"));
 	QString version = cfg.value(QStringLiteral("version"), QString());
 
 	const QString contactsName = QStringLiteral("contacts");
 	const QString idName = QStringLiteral("id");
-	const QString dataName = QStringLiteral("data");
+	const QString schemaName = QStringLiteral("schema");
+	const QString stubsName = QStringLiteral("stubs");
+	const QString stubsVersionName = QStringLiteral("stubsVersion");
 
-	{
-		QVariantList contacts = cfg.value(contactsName, QVariantList());
+	const RosterSchema storedSchema(cfg.value(schemaName, QStringList()));
+	const RosterSchema *schema = factory->schema();
+	const QStringList schemaKeys = schema ? schema->keys() : QStringList();
+	// Records are kept in order of the factory's schema, so roster is
+	// rewritten once if it has changed
+	const bool migrate = storedSchema.keys() != schemaKeys;
 
-		contacts.erase(std::remove_if(contacts.begin(), contacts.end(), [&idName] (const QVariant &data) {
-			QVariantMap map = data.toMap();
-			const QString id = map.value(idName).toString();
-			return id.isEmpty();
-		}), contacts.end());
-
-		cfg.setValue(contactsName, contacts);
+	LazyContactsFactory *lazyFactory = qobject_cast<LazyContactsFactory*>(factory);
+	if (lazyFactory && !migrate && cfg.hasChildKey(stubsVersionName)
+			&& cfg.value(stubsVersionName, QString()) == version) {
+		const QVariantList stubs = cfg.value(stubsName, QVariantList());
+		const int count = cfg.beginArray(contactsName);
+		cfg.endArray();
+		// Snapshot written by older version of storage is ignored
+		if (stubs.size() == count) {
+			const QString stubName = QStringLiteral("stub");
+			QList<RosterStub> list;
+			list.reserve(count);
+			for (int i = 0; i < count; i++) {
+				const QVariantList values = stubs.at(i).toMap().value(stubName).toList();
+				const RosterStub stub = unpack_stub(values);
+				if (stub.id.isEmpty()) {
+					context.freeIndexes.append(i);
+					continue;
+				}
+				context.indexes.insert(stub.id, i);
+				list << stub;
+			}
+			context.snapshot = true;
+			QPointer<SimpleRosterStorage> self(this);
+			QPointer<Account> guard(account);
+			lazyFactory->addStubs(list, [self, guard] (const QString &id) {
+				return self && guard ? self->contactData(guard, id) : QVariantMap();
+			});
+			return version;
+		}
 	}
 
-	int size = cfg.beginArray(contactsName);
-
-	for (int i = 0; i < size; i++) {
-		cfg.setArrayIndex(i);
-		const QString id = cfg.value(idName, QString());
-		const QVariantMap data = cfg.value(dataName, QVariantMap());
-		if (id.isEmpty()) {
-			context.freeIndexes.append(i);
-		} else {
-			Contact *contact = factory->addContact(id, data);
-			context.indexes.insert(contact, i);
+	// Read roster as a single value, so config doesn't have to build
+	// tree nodes for every contact's data
+	QVariantList contacts = cfg.value(contactsName, QVariantList());
+	const int size = contacts.size();
+
+	contacts.erase(std::remove_if(contacts.begin(), contacts.end(), [&idName] (const QVariant &data) {
+		return data.toMap().value(idName).toString().isEmpty();
+	}), contacts.end());
+
+	QVariantList stubs;
+	for (int i = 0; i < contacts.size(); i++) {
+		QVariantMap map = contacts.at(i).toMap();
+		const QString id = map.value(idName).toString();
+		const QVariantMap data = entry_data(map, &storedSchema);
+		if (migrate) {
+			set_entry_data(map, schema, data);
+			contacts[i] = map;
 		}
+		Contact *contact = factory->addContact(id, data);
+		context.indexes.insert(id, i);
+		if (lazyFactory)
+			stubs << stub_entry(pack_stub(id, data, contact, lazyFactory));
+	}
+
+	// Snapshot is built once, next loads create only stubs
+	if (lazyFactory) {
+		cfg.setValue(stubsName, stubs);
+		cfg.setValue(stubsVersionName, version);
+		context.snapshot = true;
+	}
+
+	// Rewrite roster only if it really has holes or another schema
+	if (contacts.size() != size || migrate)
+		cfg.setValue(contactsName, contacts);
+	if (migrate) {
+		if (schemaKeys.isEmpty())
+			cfg.remove(schemaName);
+		else
+			cfg.setValue(schemaName, schemaKeys);
 	}
 	return version;
 }
@@ -89,18 +259,25 @@ void SimpleRosterStorage::addContact(Contact *contact, const QString &version)
 	ContactsFactory *factory = account->contactsFactory();
 	AccountContext &context = m_contexts[account];
 	Q_ASSERT(factory);
-	Q_ASSERT(!context.indexes.contains(contact));
+	Q_ASSERT(!context.indexes.contains(contact->id()));
 	Config cfg = account->config();
 	cfg.beginGroup(QLatin1String("roster"));
 	cfg.setValue(QLatin1String("version"), version);
 	int size = cfg.beginArray(QLatin1String("contacts"));
 	int index = context.freeIndexes.isEmpty() ? size : context.freeIndexes.takeLast();
-	context.indexes.insert(contact, index);
+	context.indexes.insert(contact->id(), index);
 	cfg.setArrayIndex(index);
 	cfg.setValue(QLatin1String("id"), contact->id());
-	QVariantMap data = cfg.value(QLatin1String("data"), QVariantMap());
+	QVariantMap entry = config_entry(cfg);
+	QVariantMap data = entry_data(entry, factory->schema());
 	factory->serialize(contact, data);
-	cfg.setValue(QLatin1String("data"), data);
+	set_entry_data(entry, factory->schema(), data);
+	set_config_entry(cfg, entry);
+	cfg.endArray();
+	if (context.snapshot) {
+		LazyContactsFactory *lazyFactory = static_cast<LazyContactsFactory*>(factory);
+		set_config_stub(cfg, index, pack_stub(contact->id(), data, contact, lazyFactory), version);
+	}
 }
 
 void SimpleRosterStorage::updateContact(Contact *contact, const QString &version)
@@ -109,15 +286,23 @@ void SimpleRosterStorage::updateContact(Contact *contact, const QString &version
 	ContactsFactory *factory = account->contactsFactory();
 	AccountContext &context = m_contexts[account];
 	Q_ASSERT(factory);
-	Q_ASSERT(context.indexes.contains(contact));
+	Q_ASSERT(context.indexes.contains(contact->id()));
 	Config cfg = account->config();
 	cfg.beginGroup(QLatin1String("roster"));
 	cfg.setValue(QLatin1String("version"), version);
 	cfg.beginArray(QLatin1String("contacts"));
-	cfg.setArrayIndex(context.indexes.value(contact));
-	QVariantMap data = cfg.value(QLatin1String("data"), QVariantMap());
+	const int index = context.indexes.value(contact->id());
+	cfg.setArrayIndex(index);
+	QVariantMap entry = config_entry(cfg);
+	QVariantMap data = entry_data(entry, factory->schema());
 	factory->serialize(contact, data);
-	cfg.setValue(QLatin1String("data"), data);
+	set_entry_data(entry, factory->schema(), data);
+	set_config_entry(cfg, entry);
+	cfg.endArray();
+	if (context.snapshot) {
+		LazyContactsFactory *lazyFactory = static_cast<LazyContactsFactory*>(factory);
+		set_config_stub(cfg, index, pack_stub(contact->id(), data, contact, lazyFactory), version);
+	}
 }
 
 void SimpleRosterStorage::removeContact(Contact *contact, const QString &version)
@@ -126,16 +311,99 @@ void SimpleRosterStorage::removeContact(Contact *contact, const QString &version
 	ContactsFactory *factory = account->contactsFactory();
 	AccountContext &context = m_contexts[account];
 	Q_ASSERT(factory);
-	Q_ASSERT(context.indexes.contains(contact));
+	Q_ASSERT(context.indexes.contains(contact->id()));
 	Config cfg = account->config();
 	cfg.beginGroup(QLatin1String("roster"));
 	cfg.setValue(QLatin1String("version"), version);
 	cfg.beginArray(QLatin1String("contacts"));
-	int index = context.indexes.take(contact);
+	int index = context.indexes.take(contact->id());
 	cfg.setArrayIndex(index);
 	cfg.remove(QLatin1String("id"));
 	cfg.remove(QLatin1String("data"));
+	cfg.remove(QLatin1String("record"));
 	context.freeIndexes.append(index);
+	cfg.endArray();
+	if (context.snapshot)
+		set_config_stub(cfg, index, QVariantList(), version);
+}
+
+void SimpleRosterStorage::applyDiff(Account *account, const QList<Contact*> &added,
+									const QList<Contact*> &updated, const QList<Contact*> &removed,
+									const QString &version)
+{
+	ContactsFactory *factory = account->contactsFactory();
+	AccountContext &context = m_contexts[account];
+	Q_ASSERT(factory);
+	Config cfg = account->config();
+	cfg.beginGroup(QStringLiteral("roster"));
+	cfg.setValue(QStringLiteral("version"), version);
+	if (context.snapshot)
+		cfg.setValue(QStringLiteral("stubsVersion"), version);
+	if (added.isEmpty() && updated.isEmpty() && removed.isEmpty())
+		return;
+
+	const QString contactsName = QStringLiteral("contacts");
+	const QString idName = QStringLiteral("id");
+	const RosterSchema *schema = factory->schema();
+
+	const QString stubsName = QStringLiteral("stubs");
+	LazyContactsFactory *lazyFactory = context.snapshot ? static_cast<LazyContactsFactory*>(factory) : 0;
+
+	// Whole diff is applied to in-memory copy and written back by single setValue
+	QVariantList contacts = cfg.value(contactsName, QVariantList());
+	QVariantList stubs = lazyFactory ? cfg.value(stubsName, QVariantList()) : QVariantList();
+	if (lazyFactory) {
+		while (stubs.size() < contacts.size())
+			stubs.append(QVariantMap());
+	}
+	auto store = [&] (Contact *contact, int index) {
+		QVariantMap entry = contacts.at(index).toMap();
+		QVariantMap data = entry_data(entry, schema);
+		factory->serialize(contact, data);
+		entry.insert(idName, contact->id());
+		set_entry_data(entry, schema, data);
+		contacts[index] = entry;
+		if (lazyFactory)
+			stubs[index] = stub_entry(pack_stub(contact->id(), data, contact, lazyFactory));
+	};
+
+	foreach (Contact *contact, removed) {
+		auto it = context.indexes.find(contact->id());
+		if (it == context.indexes.end())
+			continue;
+		const int index = it.value();
+		context.indexes.erase(it);
+		if (index < contacts.size())
+			contacts[index] = QVariantMap();
+		if (lazyFactory && index < stubs.size())
+			stubs[index] = QVariantMap();
+		context.freeIndexes.append(index);
+	}
+
+	QList<Contact*> newContacts = added;
+	foreach (Contact *contact, updated) {
+		const int index = context.indexes.value(contact->id(), -1);
+		if (index < 0 || index >= contacts.size())
+			newContacts << contact;
+		else
+			store(contact, index);
+	}
+
+	foreach (Contact *contact, newContacts) {
+		int index = context.freeIndexes.isEmpty() ? contacts.size() : context.freeIndexes.takeLast();
+		if (index >= contacts.size()) {
+			index = contacts.size();
+			contacts.append(QVariantMap());
+			if (lazyFactory)
+				stubs.append(QVariantMap());
+		}
+		context.indexes.insert(contact->id(), index);
+		store(contact, index);
+	}
+
+	cfg.setValue(contactsName, contacts);
+	if (lazyFactory)
+		cfg.setValue(stubsName, stubs);
 }
 }
 
@@ -41,11 +41,20 @@ public:
 	virtual void addContact(qutim_sdk_0_3::Contact *contact, const QString &version = QString());
 	virtual void updateContact(qutim_sdk_0_3::Contact *contact, const QString &version = QString());
 	virtual void removeContact(qutim_sdk_0_3::Contact *contact, const QString &version = QString());
+	virtual void applyDiff(qutim_sdk_0_3::Account *account, const QList<qutim_sdk_0_3::Contact*> &added,
+						   const QList<qutim_sdk_0_3::Contact*> &updated, const QList<qutim_sdk_0_3::Contact*> &removed,
+						   const QString &version);
 private:
+	QVariantMap contactData(qutim_sdk_0_3::Account *account, const QString &id);
+
 	struct AccountContext
 	{
-		QMap<qutim_sdk_0_3::Contact*, int> indexes;
+		AccountContext() : snapshot(false) {}
+		// Keyed by id, as contacts may be created after the roster is loaded
+		QHash<QString, int> indexes;
 		QList<int> freeIndexes;
+		// Stubs of lazy factory are kept up to date together with the roster
+		bool snapshot;
 	};
 	QMap<qutim_sdk_0_3::Account*, AccountContext> m_contexts;
 };
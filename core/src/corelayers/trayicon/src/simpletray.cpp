@@ -92,8 +92,10 @@ SimpleTray::SimpleTray() :
 	}
 	m_activeAccount = 0;
 	m_showGeneratedIcon = false;
+	m_trayIconKey = 0;
+	m_unreadIcons.setMaxCost(16);
 	m_icon = new QSystemTrayIcon(this);
-	m_icon->setIcon(m_currentIcon = Icon(QLatin1String("qutim-offline")));
+	setTrayIcon(m_currentIcon = Icon(QLatin1String("qutim-offline")));
 	m_icon->show();
 	m_mailIcon                = Icon(QLatin1String("qutim-message-new"));
 	m_typingIcon              = Icon(QLatin1String("im-status-message-edit"));
@@ -187,7 +189,7 @@ void SimpleTray::onSessionDestroyed()
 {
 	ChatSession *session = static_cast<ChatSession*>(sender());
 	m_sessions.remove(session);
-	updateGeneratedIcon();
+	scheduleGeneratedIconUpdate();
 }
 
 void SimpleTray::onUnreadChanged(qutim_sdk_0_3::MessageList unread)
@@ -207,7 +209,7 @@ void SimpleTray::onUnreadChanged(qutim_sdk_0_3::MessageList unread)
 	else
 		m_sessions.insert(session, unread.count());
 
-	updateGeneratedIcon();
+	scheduleGeneratedIconUpdate();
 }
 
 void SimpleTray::onNotificationFinished()
@@ -260,10 +262,13 @@ void SimpleTray::handleNotification(Notification *notification)
 
 void SimpleTray::timerEvent(QTimerEvent *timer)
 {
-	if (timer->timerId() != m_iconTimer.timerId()) {
+	if (timer->timerId() == m_updateTimer.timerId()) {
+		m_updateTimer.stop();
+		updateGeneratedIcon();
+	} else if (timer->timerId() != m_iconTimer.timerId()) {
 		QObject::timerEvent(timer);
 	} else {
-		m_icon->setIcon(m_showGeneratedIcon ? m_generatedIcon : m_currentIcon);
+		setTrayIcon(m_showGeneratedIcon ? m_generatedIcon : m_currentIcon);
 		m_showGeneratedIcon = !m_showGeneratedIcon;
 	}
 }
@@ -285,9 +290,16 @@ QIcon SimpleTray::unreadIcon()
 		break;
 	}
 
-	QIcon icon;
-	generateIconSizes(m_mailIcon, icon, number);
-	return icon;
+	const QSize size = m_icon->geometry().size();
+	const quint64 key = (quint64(size.width() & 0xffff) << 48)
+	        | (quint64(size.height() & 0xffff) << 32) | quint32(number);
+	if (QIcon *cached = m_unreadIcons.object(key))
+		return *cached;
+
+	QIcon *icon = new QIcon;
+	generateIconSizes(m_mailIcon, *icon, number);
+	m_unreadIcons.insert(key, icon);
+	return *icon;
 }
 
 QIcon SimpleTray::getIconForNotification(Notification *notification)
@@ -348,20 +360,36 @@ void SimpleTray::generateIconSizes(const QIcon &backing, QIcon &icon, int number
 void SimpleTray::updateGeneratedIcon()
 {
 	Notification *notif = currentNotification();
+	m_updateTimer.stop();
 	if (!notif) {
 		if (m_iconTimer.isActive())
 			m_iconTimer.stop();
-		m_icon->setIcon(m_currentIcon);
+		setTrayIcon(m_currentIcon);
 		m_showGeneratedIcon = false;
 	} else if (m_showIcon) {
 		m_generatedIcon = getIconForNotification(notif);
 		if (!m_blink || m_showGeneratedIcon) {
-			m_icon->setIcon(m_generatedIcon);
+			setTrayIcon(m_generatedIcon);
 			m_showGeneratedIcon = true;
 		}
 	}
 }
 
+void SimpleTray::scheduleGeneratedIconUpdate()
+{
+	if (!m_updateTimer.isActive())
+		m_updateTimer.start(250, this);
+}
+
+void SimpleTray::setTrayIcon(const QIcon &icon)
+{
+	// Platform tray reuploads the whole icon on every change
+	if (icon.cacheKey() == m_trayIconKey)
+		return;
+	m_trayIconKey = icon.cacheKey();
+	m_icon->setIcon(icon);
+}
+
 Notification *SimpleTray::currentNotification()
 {
 	// Message notifications have highest priority
@@ -501,7 +529,7 @@ void SimpleTray::onAccountCreated(qutim_sdk_0_3::Account *account)
 			m_activeAccount = account;
 		m_currentIcon = iconForStatus(account->status());
 		if (!m_showGeneratedIcon)
-			m_icon->setIcon(m_currentIcon);
+			setTrayIcon(m_currentIcon);
 	}
 	validateProtocolActions();
 }
@@ -526,7 +554,7 @@ void SimpleTray::onStatusChanged(const qutim_sdk_0_3::Status &status)
 		}
 	}
 	if (!m_showGeneratedIcon)
-		m_icon->setIcon(m_currentIcon);
+		setTrayIcon(m_currentIcon);
 }
 
 void SimpleTray::validateProtocolActions()
@@ -35,6 +35,7 @@
 #include <QSystemTrayIcon>
 #include <QBasicTimer>
 #include <QPixmap>
+#include <QCache>
 #include <qutim/icon.h>
 
 namespace Core
@@ -82,6 +83,8 @@ private:
 	QIcon getIconForNotification(Notification *notification);
 	void generateIconSizes(const QIcon &backing, QIcon &icon, int number);
 	void updateGeneratedIcon();
+	void scheduleGeneratedIconUpdate();
+	void setTrayIcon(const QIcon &icon);
 	void validateProtocolActions();
 	Notification *currentNotification();
 private:
@@ -96,6 +99,11 @@ private:
 	QIcon m_currentIcon;
 	QIcon m_generatedIcon;
 	QBasicTimer m_iconTimer;
+	// Unread counter changes are coalesced to few icon updates per second
+	QBasicTimer m_updateTimer;
+	// Icons with unread counter painted, keyed by number and tray size
+	QCache<quint64, QIcon> m_unreadIcons;
+	qint64 m_trayIconKey;
 	QIcon m_mailIcon;
 	QIcon m_typingIcon;
 	QIcon m_chatUserJoinedIcon;
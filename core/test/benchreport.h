@@ -0,0 +1,155 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef BENCHREPORT_H
+#define BENCHREPORT_H
+
+#include <QCommandLineOption>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSysInfo>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+namespace Bench
+{
+
+// Machine readable results of one benchmark run, written by --json option.
+// Reports of different commits are compared by benchmarks/compare.py, so
+// names of results must stay the same from release to release.
+class Report
+{
+public:
+	enum Better { LowerIsBetter, HigherIsBetter };
+
+	explicit Report(const QString &benchmark) : m_benchmark(benchmark) {}
+
+	static QCommandLineOption option()
+	{
+		return QCommandLineOption(QStringLiteral("json"), QStringLiteral("Write machine readable results to the file."),
+		                          QStringLiteral("file"));
+	}
+
+	void setParameter(const QString &name, const QVariant &value)
+	{
+		m_parameters.insert(name, QJsonValue::fromVariant(value));
+	}
+
+	void add(const QString &name, double value, const QString &unit, Better better = LowerIsBetter)
+	{
+		QJsonObject result;
+		result.insert(QStringLiteral("value"), value);
+		result.insert(QStringLiteral("unit"), unit);
+		result.insert(QStringLiteral("better"), better == LowerIsBetter ? QStringLiteral("lower") : QStringLiteral("higher"));
+		m_results.insert(name, result);
+	}
+
+	// Median and 95th percentile of durations in milliseconds
+	void addSamples(const QString &name, QVector<qint64> nsecs)
+	{
+		if (nsecs.isEmpty())
+			return;
+		std::sort(nsecs.begin(), nsecs.end());
+		add(name + QStringLiteral("/p50"), nsecs.at(nsecs.size() / 2) / 1e6, QStringLiteral("ms"));
+		add(name + QStringLiteral("/p95"), nsecs.at(qMin(nsecs.size() - 1, nsecs.size() * 95 / 100)) / 1e6, QStringLiteral("ms"));
+	}
+
+	bool write(const QString &fileName) const
+	{
+		QJsonObject root;
+		root.insert(QStringLiteral("benchmark"), m_benchmark);
+		root.insert(QStringLiteral("commit"), commit());
+		root.insert(QStringLiteral("date"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+		root.insert(QStringLiteral("host"), host());
+		root.insert(QStringLiteral("parameters"), m_parameters);
+		root.insert(QStringLiteral("results"), m_results);
+		QFile file(fileName);
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			qCritical("Can't write report %s", qPrintable(fileName));
+			return false;
+		}
+		file.write(QJsonDocument(root).toJson());
+		return true;
+	}
+
+	static QString commit()
+	{
+		// Runner passes the commit explicitly, binaries may be built out of tree
+		const QString commit = QString::fromLatin1(qgetenv("QUTIM_BENCH_COMMIT"));
+		if (!commit.isEmpty())
+			return commit;
+		QProcess git;
+		git.setWorkingDirectory(QFileInfo(QStringLiteral(__FILE__)).absolutePath());
+		git.start(QStringLiteral("git"), QStringList() << QStringLiteral("rev-parse") << QStringLiteral("HEAD"));
+		if (!git.waitForFinished(5000) || git.exitCode() != 0)
+			return QString();
+		return QString::fromLatin1(git.readAllStandardOutput()).trimmed();
+	}
+
+	static QJsonObject host()
+	{
+		QJsonObject host;
+		host.insert(QStringLiteral("os"), QSysInfo::prettyProductName());
+		host.insert(QStringLiteral("kernel"), QSysInfo::kernelType() + QLatin1Char(' ') + QSysInfo::kernelVersion());
+		host.insert(QStringLiteral("arch"), QSysInfo::currentCpuArchitecture());
+		host.insert(QStringLiteral("cores"), QThread::idealThreadCount());
+		host.insert(QStringLiteral("qt"), QLatin1String(qVersion()));
+		// Only Linux tells more without platform specific code
+		const QByteArray cpu = procValue("/proc/cpuinfo", "model name");
+		if (!cpu.isEmpty())
+			host.insert(QStringLiteral("cpu"), QString::fromLatin1(cpu));
+		const QByteArray memory = procValue("/proc/meminfo", "MemTotal");
+		if (!memory.isEmpty())
+			host.insert(QStringLiteral("memory"), QString::fromLatin1(memory));
+		return host;
+	}
+
+private:
+	static QByteArray procValue(const char *fileName, const QByteArray &key)
+	{
+		QFile file(QLatin1String(fileName));
+		if (!file.open(QIODevice::ReadOnly))
+			return QByteArray();
+		foreach (const QByteArray &line, file.readAll().split('\n')) {
+			const int colon = line.indexOf(':');
+			if (colon > 0 && line.left(colon).trimmed() == key)
+				return line.mid(colon + 1).trimmed();
+		}
+		return QByteArray();
+	}
+
+	QString m_benchmark;
+	QJsonObject m_parameters;
+	QJsonObject m_results;
+};
+
+}
+
+#endif // BENCHREPORT_H
@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef BENCHUNITS_H
+#define BENCHUNITS_H
+
+#include <qutim/protocol.h>
+#include <qutim/account.h>
+#include <qutim/chatunit.h>
+#include <qutim/contact.h>
+
+namespace Bench
+{
+
+// Minimal protocol objects, so benchmarks feed messages with real chat
+// units without any network
+
+class BenchProtocol : public qutim_sdk_0_3::Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "bench")
+public:
+	QList<qutim_sdk_0_3::Account*> accounts() const override { return m_accounts; }
+	qutim_sdk_0_3::Account *account(const QString &id) const override
+	{
+		foreach (qutim_sdk_0_3::Account *account, m_accounts) {
+			if (account->id() == id)
+				return account;
+		}
+		return 0;
+	}
+
+	QList<qutim_sdk_0_3::Account*> m_accounts;
+
+private:
+	void loadAccounts() override {}
+};
+
+class BenchAccount : public qutim_sdk_0_3::Account
+{
+	Q_OBJECT
+public:
+	BenchAccount(const QString &id, qutim_sdk_0_3::Protocol *protocol) : Account(id, protocol) {}
+	qutim_sdk_0_3::ChatUnit *getUnit(const QString &, bool) override { return 0; }
+
+protected:
+	void doConnectToServer() override {}
+	void doDisconnectFromServer() override {}
+	void doStatusChange(const qutim_sdk_0_3::Status &) override {}
+};
+
+class BenchContact : public qutim_sdk_0_3::ChatUnit
+{
+	Q_OBJECT
+public:
+	BenchContact(const QString &id, qutim_sdk_0_3::Account *account) : ChatUnit(account), m_id(id) {}
+	QString id() const override { return m_id; }
+	bool sendMessage(const qutim_sdk_0_3::Message &) override { return true; }
+
+private:
+	QString m_id;
+};
+
+// Roster entry, which is changed by benchmark itself instead of a server
+class BenchRosterContact : public qutim_sdk_0_3::Contact
+{
+	Q_OBJECT
+public:
+	BenchRosterContact(const QString &id, const QString &name, qutim_sdk_0_3::Account *account)
+	    : Contact(account), m_id(id), m_name(name) {}
+	QString id() const override { return m_id; }
+	QString name() const override { return m_name; }
+	QStringList tags() const override { return m_tags; }
+	qutim_sdk_0_3::Status status() const override { return m_status; }
+	bool sendMessage(const qutim_sdk_0_3::Message &) override { return true; }
+	bool isInList() const override { return true; }
+	void setInList(bool) override {}
+
+	void setTags(const QStringList &tags) override
+	{
+		const QStringList previous = m_tags;
+		m_tags = tags;
+		emit tagsChanged(m_tags, previous);
+	}
+
+	void setStatus(qutim_sdk_0_3::Status::Type type)
+	{
+		const qutim_sdk_0_3::Status previous = m_status;
+		m_status.setType(type);
+		emit statusChanged(m_status, previous);
+	}
+
+private:
+	QString m_id;
+	QString m_name;
+	QStringList m_tags;
+	qutim_sdk_0_3::Status m_status;
+};
+
+}
+
+#endif // BENCHUNITS_H
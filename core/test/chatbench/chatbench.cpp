@@ -0,0 +1,366 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+// Benchmark of the way of incoming and outgoing messages from protocol to
+// chat view. Chat layer, view factory and message handlers are loaded from
+// built plugins, as the application does, synthetic messages are appended
+// to a session one by one and every message is waited for until it passed
+// through the handler chain and the view processed its events.
+
+#include "../benchunits.h"
+#include "../benchreport.h"
+#include <qutim/chatsession.h>
+#include <qutim/extensioninfo.h>
+#include <qutim/messagehandler.h>
+#include <qutim/history.h>
+#include <qutim/plugin.h>
+#include <qutim/servicemanager.h>
+#include <qutim/metaobjectbuilder.h>
+#include <qutim/adiumchat/chatsessionimpl.h>
+#include <qutim/adiumchat/chatviewfactory.h>
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QPluginLoader>
+#include <QTextStream>
+#include <QWidget>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#if defined(__GLIBC__)
+// Every allocation goes through malloc, both of operator new and of Qt
+// containers, so wrapping it counts all of them
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static std::atomic<quint64> allocationCount(0);
+
+extern "C" void *malloc(size_t size)
+{
+	++allocationCount;
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+	++allocationCount;
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+	++allocationCount;
+	return __libc_realloc(ptr, size);
+}
+
+# define CHATBENCH_ALLOCATIONS
+#endif
+
+using namespace qutim_sdk_0_3;
+using namespace Bench;
+
+namespace ChatBench
+{
+
+static quint64 allocations()
+{
+#ifdef CHATBENCH_ALLOCATIONS
+	return allocationCount.load();
+#else
+	return 0;
+#endif
+}
+
+// Deterministic generator, so runs with different plugins are comparable
+class Random
+{
+public:
+	Random(quint64 seed) : m_state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+	quint32 next()
+	{
+		m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return quint32(m_state >> 33);
+	}
+	int bounded(int max) { return int(next() % quint32(max)); }
+	bool chance(int percent) { return bounded(100) < percent; }
+
+private:
+	quint64 m_state;
+};
+
+static QString text(Random &random, int index)
+{
+	static const char * const words[] = {
+		"hello", "how", "are", "you", "ok", "lol", "see", "this", "tomorrow",
+		"привет", "как", "дела", "nick", "build", "works", "again", ":)", ";-)"
+	};
+	const int count = random.chance(90) ? 1 + random.bounded(12) : 40 + random.bounded(160);
+	QString result;
+	for (int i = 0; i < count; ++i) {
+		if (i > 0)
+			result += QLatin1Char(' ');
+		result += QString::fromUtf8(words[random.bounded(sizeof(words) / sizeof(words[0]))]);
+	}
+	// Links are to a closed local port, so url preview fails fast
+	if (random.chance(10))
+		result += QStringLiteral(" http://127.0.0.1:1/page%1").arg(index % 64);
+	if (random.chance(5))
+		result += QStringLiteral(" <b>&amp;</b>");
+	return result;
+}
+
+struct Options
+{
+	QString pluginDir;
+	QString view;
+	QStringList handlers;
+	int messages;
+	int warmup;
+	quint64 seed;
+};
+
+class PluginSet
+{
+public:
+	~PluginSet()
+	{
+		foreach (Plugin *plugin, m_loaded)
+			plugin->unload();
+	}
+
+	Plugin *open(const QString &dir, const QString &name)
+	{
+		QPluginLoader *loader = new QPluginLoader(QDir(dir).filePath(name), qApp);
+		Plugin *plugin = qobject_cast<Plugin*>(loader->instance());
+		if (!plugin) {
+			qCritical("Can't open plugin %s: %s", qPrintable(name), qPrintable(loader->errorString()));
+			return 0;
+		}
+		plugin->init();
+		return plugin;
+	}
+
+	// Makes extension of plugin implementation of the service
+	bool setService(Plugin *plugin, const QByteArray &service)
+	{
+		foreach (const ExtensionInfo &info, plugin->avaiableExtensions()) {
+			if (MetaObjectBuilder::info(info.generator()->metaObject(), "Service") == service)
+				return ServiceManager::setImplementation(service, info);
+		}
+		qCritical("%s doesn't implement %s", plugin->metaObject()->className(), service.constData());
+		return false;
+	}
+
+	bool load(Plugin *plugin)
+	{
+		if (!plugin->load())
+			return false;
+		m_loaded << plugin;
+		return true;
+	}
+
+private:
+	QList<Plugin*> m_loaded;
+};
+
+class Samples
+{
+public:
+	Samples() : m_allocations(0) {}
+
+	void add(qint64 nsecs, quint64 allocations)
+	{
+		m_times << nsecs;
+		m_allocations += allocations;
+	}
+
+	QString summary(qint64 totalNsecs) const
+	{
+		if (m_times.isEmpty())
+			return QStringLiteral("no messages");
+		QVector<qint64> times = m_times;
+		std::sort(times.begin(), times.end());
+#ifdef CHATBENCH_ALLOCATIONS
+		const QString allocations = QString::number(m_allocations / quint64(times.size()));
+#else
+		const QString allocations = QStringLiteral("n/a");
+#endif
+		return QStringLiteral("%1 msg/s, p50 %2 ms, p99 %3 ms, max %4 ms, %5 allocations/msg")
+		        .arg(qint64(times.size() * 1e9 / qMax<qint64>(1, totalNsecs)))
+		        .arg(times.at(times.size() / 2) / 1e6, 0, 'f', 3)
+		        .arg(times.at(qMin(times.size() - 1, times.size() * 99 / 100)) / 1e6, 0, 'f', 3)
+		        .arg(times.last() / 1e6, 0, 'f', 3)
+		        .arg(allocations);
+	}
+
+	void report(Report &report, const QString &name, qint64 totalNsecs) const
+	{
+		if (m_times.isEmpty())
+			return;
+		report.add(name + QStringLiteral("/rate"), m_times.size() * 1e9 / qMax<qint64>(1, totalNsecs),
+		           QStringLiteral("msg/s"), Report::HigherIsBetter);
+		report.addSamples(name, m_times);
+#ifdef CHATBENCH_ALLOCATIONS
+		report.add(name + QStringLiteral("/allocations"), double(m_allocations) / m_times.size(), QStringLiteral("allocations/msg"));
+#endif
+	}
+
+private:
+	QVector<qint64> m_times;
+	quint64 m_allocations;
+};
+
+}
+
+using namespace ChatBench;
+
+int main(int argc, char *argv[])
+{
+	// Views are laid out and painted, but never shown on a screen
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+	app.setApplicationName(QStringLiteral("chatbench"));
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QStringLiteral("Measures cost of messages from chat session to rendered view."));
+	parser.addHelpOption();
+	QCommandLineOption pluginDirOption(QStringLiteral("plugin-dir"), QStringLiteral("Directory with built plugins."),
+	                                   QStringLiteral("path"), app.applicationDirPath() + QStringLiteral("/../lib/qutim/plugins"));
+	QCommandLineOption viewOption(QStringLiteral("view"), QStringLiteral("Chat view plugin: textchat, adiumwebview or qmlchat."),
+	                              QStringLiteral("name"), QStringLiteral("textchat"));
+	QCommandLineOption handlersOption(QStringLiteral("handlers"), QStringLiteral("Comma separated message handler plugins, offtherecord enables OTR."),
+	                                  QStringLiteral("list"), QStringLiteral("antispam,highlighter,urlpreview"));
+	QCommandLineOption messagesOption(QStringLiteral("messages"), QStringLiteral("Measured messages."), QStringLiteral("n"), QStringLiteral("5000"));
+	QCommandLineOption warmupOption(QStringLiteral("warmup"), QStringLiteral("Messages sent before measuring."), QStringLiteral("n"), QStringLiteral("200"));
+	QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed of generated messages."), QStringLiteral("n"), QStringLiteral("1"));
+	const QCommandLineOption jsonOption = Report::option();
+	parser.addOptions(QList<QCommandLineOption>() << pluginDirOption << viewOption << handlersOption
+	                  << messagesOption << warmupOption << seedOption << jsonOption);
+	parser.process(app);
+
+	Options options;
+	options.pluginDir = parser.value(pluginDirOption);
+	options.view = parser.value(viewOption);
+	options.handlers = parser.value(handlersOption).split(QLatin1Char(','), QString::SkipEmptyParts);
+	options.messages = qMax(1, parser.value(messagesOption).toInt());
+	options.warmup = qMax(0, parser.value(warmupOption).toInt());
+	options.seed = parser.value(seedOption).toULongLong();
+
+	PluginSet plugins;
+	Plugin *chatLayer = plugins.open(options.pluginDir, QStringLiteral("adiumchat"));
+	Plugin *view = plugins.open(options.pluginDir, options.view);
+	if (!chatLayer || !view
+	        || !plugins.setService(view, "ChatViewFactory")
+	        || !plugins.setService(chatLayer, "ChatLayer")) {
+		return 2;
+	}
+	foreach (const QString &name, options.handlers) {
+		Plugin *plugin = plugins.open(options.pluginDir, name);
+		if (!plugin || !plugins.load(plugin)) {
+			qCritical("Can't load message handler %s", qPrintable(name));
+			return 2;
+		}
+	}
+
+	BenchProtocol protocol;
+	BenchAccount *account = new BenchAccount(QStringLiteral("me@bench.example.org"), &protocol);
+	protocol.m_accounts << account;
+	BenchContact *contact = new BenchContact(QStringLiteral("friend@bench.example.org"), account);
+
+	ChatSession *session = ChatLayer::get(contact, true);
+	Core::AdiumChat::ChatSessionImpl *impl = qobject_cast<Core::AdiumChat::ChatSessionImpl*>(session);
+	Core::AdiumChat::ChatViewFactory *factory = ServiceManager::getByName<Core::AdiumChat::ChatViewFactory*>("ChatViewFactory");
+	if (!impl || !factory) {
+		qCritical("Chat layer is not initialized");
+		return 2;
+	}
+	QScopedPointer<QWidget> widget(factory->createViewWidget());
+	if (Core::AdiumChat::ChatViewWidget *viewWidget = qobject_cast<Core::AdiumChat::ChatViewWidget*>(widget.data()))
+		viewWidget->setViewController(impl->controller());
+	widget->resize(640, 480);
+	widget->show();
+
+	Random random(options.seed);
+	Samples incoming, outgoing;
+	qint64 totalIncoming = 0, totalOutgoing = 0;
+	for (int i = 0; i < options.warmup + options.messages; ++i) {
+		Message message(text(random, i));
+		message.setChatUnit(contact);
+		message.setIncoming(random.chance(80));
+		message.setTime(QDateTime::currentDateTime());
+		// History isn't part of the measurement
+		if (!History::instance())
+			message.setProperty(Message::StoreProperty, false);
+
+		bool done = false;
+		const quint64 allocationsBefore = allocations();
+		QElapsedTimer timer;
+		timer.start();
+		session->append(message, [&done] (quint64, const Message &, const QString &) {
+			done = true;
+		});
+		while (!done)
+			app.processEvents(QEventLoop::WaitForMoreEvents);
+		// Let the view handle layout and paint requests of the message
+		app.processEvents();
+		const qint64 elapsed = timer.nsecsElapsed();
+
+		if (i < options.warmup)
+			continue;
+		if (message.isIncoming()) {
+			incoming.add(elapsed, allocations() - allocationsBefore);
+			totalIncoming += elapsed;
+		} else {
+			outgoing.add(elapsed, allocations() - allocationsBefore);
+			totalOutgoing += elapsed;
+		}
+	}
+
+	QTextStream out(stdout);
+	out << "view: " << options.view << ", handlers: " << options.handlers.join(QStringLiteral(", ")) << endl;
+	out << "  incoming: " << incoming.summary(totalIncoming) << endl;
+	out << "  outgoing: " << outgoing.summary(totalOutgoing) << endl;
+
+	widget.reset();
+	delete session;
+
+	if (parser.isSet(jsonOption)) {
+		Report report(QStringLiteral("chat"));
+		report.setParameter(QStringLiteral("view"), options.view);
+		report.setParameter(QStringLiteral("handlers"), options.handlers.join(QLatin1Char(',')));
+		report.setParameter(QStringLiteral("messages"), options.messages);
+		report.setParameter(QStringLiteral("seed"), options.seed);
+		incoming.report(report, QStringLiteral("incoming"), totalIncoming);
+		outgoing.report(report, QStringLiteral("outgoing"), totalOutgoing);
+		if (!report.write(parser.value(jsonOption)))
+			return 2;
+	}
+	return 0;
+}
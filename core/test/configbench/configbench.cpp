@@ -0,0 +1,284 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+// Benchmark of JSON parser and generator of libqutim and of config backends.
+// Synthetic profile looks like the one of a few accounts with big rosters:
+// groups of scalar settings and arrays of contact records. Every backend
+// saves and loads it from temporary directory, then Config API is measured
+// on top of it. Loaded trees must be equal to the generated one, exit code
+// is non-zero otherwise.
+
+#include "../../src/corelayers/jsonconfig/jsonconfigbackend.h"
+#include "../../src/corelayers/binaryconfig/binaryconfigbackend.h"
+#include "../benchreport.h"
+#include <qutim/config.h>
+#include <qutim/json.h>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <functional>
+
+using namespace qutim_sdk_0_3;
+
+namespace ConfigBench
+{
+
+using namespace Bench;
+
+// Deterministic generator, so every run gets the same profile
+class Random
+{
+public:
+	Random(quint64 seed) : m_state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+	quint32 next()
+	{
+		m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return quint32(m_state >> 33);
+	}
+	int bounded(int max) { return int(next() % quint32(max)); }
+
+private:
+	quint64 m_state;
+};
+
+struct Options
+{
+	int groups;
+	int keys;
+	int contacts;
+	int iterations;
+	quint64 seed;
+};
+
+struct Backend
+{
+	const char *name;
+	const char *suffix;
+	std::function<ConfigBackend *()> create;
+};
+
+static QVariantMap generate(const Options &options)
+{
+	Random random(options.seed);
+	QVariantMap root;
+	for (int g = 0; g < options.groups; ++g) {
+		QVariantMap group;
+		for (int k = 0; k < options.keys; ++k) {
+			const QString key = QStringLiteral("key%1").arg(k);
+			switch (random.bounded(4)) {
+			case 0:
+				group.insert(key, random.bounded(2) == 1);
+				break;
+			case 1:
+				group.insert(key, random.bounded(1 << 30));
+				break;
+			case 2:
+				group.insert(key, random.bounded(100000) / 100.0);
+				break;
+			default:
+				group.insert(key, QString::fromUtf8("значение %1 of \"%2\"").arg(k).arg(random.next()));
+				break;
+			}
+		}
+		if (g % 10 == 0) {
+			QVariantList contacts;
+			for (int c = 0; c < options.contacts; ++c) {
+				QVariantMap contact;
+				contact.insert(QStringLiteral("id"), QStringLiteral("contact%1@bench.example.org").arg(c));
+				contact.insert(QStringLiteral("name"), QString::fromUtf8("Контакт %1").arg(random.next()));
+				contact.insert(QStringLiteral("tags"), QStringList() << QStringLiteral("Group %1").arg(c % 20));
+				contact.insert(QStringLiteral("flags"), random.bounded(256));
+				contacts << contact;
+			}
+			group.insert(QStringLiteral("contacts"), contacts);
+		}
+		root.insert(QStringLiteral("group%1").arg(g), group);
+	}
+	return root;
+}
+
+static double rate(qint64 bytes, qint64 nsecs)
+{
+	return bytes * 1e9 / qMax<qint64>(1, nsecs) / (1 << 20);
+}
+
+static double perCall(qint64 nsecs, qint64 calls)
+{
+	return nsecs / 1e3 / qMax<qint64>(1, calls);
+}
+
+static bool runJson(const QVariantMap &data, const Options &options, QTextStream &out, Report &report)
+{
+	QElapsedTimer timer;
+	QByteArray json;
+	timer.start();
+	for (int i = 0; i < options.iterations; ++i)
+		json = Json::generate(data);
+	const qint64 generateTime = timer.nsecsElapsed();
+
+	QVariant parsed;
+	timer.start();
+	for (int i = 0; i < options.iterations; ++i)
+		parsed = Json::parse(json);
+	const qint64 parseTime = timer.nsecsElapsed();
+
+	const qint64 bytes = qint64(json.size()) * options.iterations;
+	out << "json: " << json.size() / 1024 << " KiB, generate "
+	    << QString::number(rate(bytes, generateTime), 'f', 1) << " MiB/s, parse "
+	    << QString::number(rate(bytes, parseTime), 'f', 1) << " MiB/s" << endl;
+	report.add(QStringLiteral("json/generate"), rate(bytes, generateTime), QStringLiteral("MiB/s"), Report::HigherIsBetter);
+	report.add(QStringLiteral("json/parse"), rate(bytes, parseTime), QStringLiteral("MiB/s"), Report::HigherIsBetter);
+
+	// Json has no distinct integer and double types, so the tree is compared
+	// after the second round trip
+	if (Json::generate(parsed) != json) {
+		out << "  MISMATCH: parsed tree differs from generated one" << endl;
+		return false;
+	}
+	return true;
+}
+
+static bool runBackend(const Backend &backend, const QVariantMap &data, const Options &options,
+                       const QDir &dir, QTextStream &out, Report &report)
+{
+	const QString fileName = dir.filePath(QStringLiteral("profile.") + QLatin1String(backend.suffix));
+	QScopedPointer<ConfigBackend> writer(backend.create());
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < options.iterations; ++i)
+		writer->save(fileName, data);
+	const qint64 saveTime = timer.nsecsElapsed();
+	const qint64 size = QFileInfo(fileName).size();
+
+	// Every load is done by new backend, as the first one after start
+	QVariant loaded;
+	timer.start();
+	for (int i = 0; i < options.iterations; ++i) {
+		QScopedPointer<ConfigBackend> reader(backend.create());
+		loaded = reader->load(fileName);
+	}
+	const qint64 loadTime = timer.nsecsElapsed();
+
+	// Config API over loaded tree, values are read the way settings are
+	qint64 reads = 0;
+	Config config(fileName, writer.data());
+	timer.start();
+	for (int i = 0; i < options.iterations; ++i) {
+		for (int g = 0; g < options.groups; ++g) {
+			Config group = config.group(QStringLiteral("group%1").arg(g));
+			for (int k = 0; k < options.keys; ++k, ++reads)
+				(void) group.value(QStringLiteral("key%1").arg(k), QVariant());
+		}
+	}
+	const qint64 readTime = timer.nsecsElapsed();
+
+	qint64 writes = 0;
+	timer.start();
+	for (int i = 0; i < options.iterations; ++i) {
+		for (int g = 0; g < options.groups; ++g) {
+			Config group = config.group(QStringLiteral("group%1").arg(g));
+			for (int k = 0; k < options.keys; k += 10, ++writes)
+				group.setValue(QStringLiteral("key%1").arg(k), i);
+		}
+	}
+	const qint64 writeTime = timer.nsecsElapsed();
+
+	const qint64 bytes = size * options.iterations;
+	out << backend.name << ": " << size / 1024 << " KiB, save "
+	    << QString::number(rate(bytes, saveTime), 'f', 1) << " MiB/s, load "
+	    << QString::number(rate(bytes, loadTime), 'f', 1) << " MiB/s, value() "
+	    << QString::number(perCall(readTime, reads), 'f', 3) << " us, setValue() "
+	    << QString::number(perCall(writeTime, writes), 'f', 3) << " us" << endl;
+
+	const QString prefix = QLatin1String(backend.name) + QLatin1Char('/');
+	report.add(prefix + QStringLiteral("size"), size / 1024.0, QStringLiteral("KiB"));
+	report.add(prefix + QStringLiteral("save"), rate(bytes, saveTime), QStringLiteral("MiB/s"), Report::HigherIsBetter);
+	report.add(prefix + QStringLiteral("load"), rate(bytes, loadTime), QStringLiteral("MiB/s"), Report::HigherIsBetter);
+	report.add(prefix + QStringLiteral("value"), perCall(readTime, reads), QStringLiteral("us"));
+	report.add(prefix + QStringLiteral("setValue"), perCall(writeTime, writes), QStringLiteral("us"));
+
+	if (Json::generate(loaded) != Json::generate(data)) {
+		out << "  MISMATCH: loaded tree differs from saved one" << endl;
+		return false;
+	}
+	return true;
+}
+
+}
+
+using namespace ConfigBench;
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setApplicationName(QStringLiteral("configbench"));
+
+	const Backend backends[] = {
+		{ "json", "json", [] () -> ConfigBackend * { return new Core::JsonConfigBackend; } },
+		{ "binary", "qcfg", [] () -> ConfigBackend * { return new Core::BinaryConfigBackend; } }
+	};
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QStringLiteral("Measures JSON parser and config backends."));
+	parser.addHelpOption();
+	QCommandLineOption groupsOption(QStringLiteral("groups"), QStringLiteral("Top-level groups."), QStringLiteral("n"), QStringLiteral("50"));
+	QCommandLineOption keysOption(QStringLiteral("keys"), QStringLiteral("Keys per group."), QStringLiteral("n"), QStringLiteral("100"));
+	QCommandLineOption contactsOption(QStringLiteral("contacts"), QStringLiteral("Contact records in every tenth group."), QStringLiteral("n"), QStringLiteral("500"));
+	QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("Repeats of every operation."), QStringLiteral("n"), QStringLiteral("10"));
+	QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed of generated profile."), QStringLiteral("n"), QStringLiteral("1"));
+	const QCommandLineOption jsonOption = Report::option();
+	parser.addOptions(QList<QCommandLineOption>() << groupsOption << keysOption << contactsOption
+	                  << iterationsOption << seedOption << jsonOption);
+	parser.process(app);
+
+	Options options;
+	options.groups = qMax(1, parser.value(groupsOption).toInt());
+	options.keys = qMax(1, parser.value(keysOption).toInt());
+	options.contacts = qMax(0, parser.value(contactsOption).toInt());
+	options.iterations = qMax(1, parser.value(iterationsOption).toInt());
+	options.seed = parser.value(seedOption).toULongLong();
+
+	Report report(QStringLiteral("config"));
+	report.setParameter(QStringLiteral("groups"), options.groups);
+	report.setParameter(QStringLiteral("keys"), options.keys);
+	report.setParameter(QStringLiteral("contacts"), options.contacts);
+	report.setParameter(QStringLiteral("iterations"), options.iterations);
+	report.setParameter(QStringLiteral("seed"), options.seed);
+
+	QTextStream out(stdout);
+	QTemporaryDir dir;
+	const QVariantMap data = generate(options);
+	bool failed = !runJson(data, options, out, report);
+	for (const Backend &backend : backends)
+		failed |= !runBackend(backend, data, options, QDir(dir.path()), out, report);
+
+	if (parser.isSet(jsonOption) && !report.write(parser.value(jsonOption)))
+		return 2;
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+// Benchmark of the contact list model with the status comparator. Rosters
+// of synthetic accounts are loaded as one roster update each, as protocols
+// do after login, then contacts change statuses and tags, the whole model
+// is walked the way a view does and contacts are searched by text.
+
+#include "../../src/corelayers/contactmodel/src/contactlistgroupmodel.h"
+#include "../../src/corelayers/comparators/statuscomparator.h"
+#include "../benchunits.h"
+#include "../benchreport.h"
+#include <qutim/extensioninfo.h>
+#include <qutim/servicemanager.h>
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+
+using namespace qutim_sdk_0_3;
+
+namespace ContactBench
+{
+
+using namespace Bench;
+
+// Deterministic generator, so every run gets the same rosters and changes
+class Random
+{
+public:
+	Random(quint64 seed) : m_state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+	quint32 next()
+	{
+		m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return quint32(m_state >> 33);
+	}
+	int bounded(int max) { return int(next() % quint32(max)); }
+
+private:
+	quint64 m_state;
+};
+
+struct Options
+{
+	int accounts;
+	int contacts;
+	int tags;
+	int changes;
+	int samples;
+	quint64 seed;
+};
+
+static QStringList randomTags(Random &random, const Options &options)
+{
+	QStringList tags;
+	tags << QStringLiteral("Group %1").arg(random.bounded(options.tags));
+	// Some contacts are in two groups at once
+	if (random.bounded(10) == 0)
+		tags << QStringLiteral("Group %1").arg(random.bounded(options.tags));
+	tags.removeDuplicates();
+	return tags;
+}
+
+// Visits every row as view does on first show, returns number of rows
+static int walk(const QAbstractItemModel &model, const QModelIndex &parent)
+{
+	int result = 0;
+	for (int row = 0, count = model.rowCount(parent); row < count; ++row) {
+		const QModelIndex index = model.index(row, 0, parent);
+		(void) model.data(index, Qt::DisplayRole);
+		(void) model.data(index, Qt::DecorationRole);
+		result += 1 + walk(model, index);
+	}
+	return result;
+}
+
+static double rate(qint64 count, qint64 nsecs)
+{
+	return count * 1e9 / qMax<qint64>(1, nsecs);
+}
+
+}
+
+using namespace ContactBench;
+
+int main(int argc, char *argv[])
+{
+	// Model creates icons, but no windows are shown
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+	app.setApplicationName(QStringLiteral("contactbench"));
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QStringLiteral("Measures contact list model on big rosters."));
+	parser.addHelpOption();
+	QCommandLineOption accountsOption(QStringLiteral("accounts"), QStringLiteral("Number of accounts."), QStringLiteral("n"), QStringLiteral("3"));
+	QCommandLineOption contactsOption(QStringLiteral("contacts"), QStringLiteral("Contacts per account."), QStringLiteral("n"), QStringLiteral("2000"));
+	QCommandLineOption tagsOption(QStringLiteral("tags"), QStringLiteral("Groups per account."), QStringLiteral("n"), QStringLiteral("30"));
+	QCommandLineOption changesOption(QStringLiteral("changes"), QStringLiteral("Status and tag changes."), QStringLiteral("n"), QStringLiteral("20000"));
+	QCommandLineOption samplesOption(QStringLiteral("samples"), QStringLiteral("Walks and searches."), QStringLiteral("n"), QStringLiteral("20"));
+	QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed of generated rosters."), QStringLiteral("n"), QStringLiteral("1"));
+	const QCommandLineOption jsonOption = Report::option();
+	parser.addOptions(QList<QCommandLineOption>() << accountsOption << contactsOption << tagsOption
+	                  << changesOption << samplesOption << seedOption << jsonOption);
+	parser.process(app);
+
+	Options options;
+	options.accounts = qMax(1, parser.value(accountsOption).toInt());
+	options.contacts = qMax(1, parser.value(contactsOption).toInt());
+	options.tags = qMax(1, parser.value(tagsOption).toInt());
+	options.changes = qMax(1, parser.value(changesOption).toInt());
+	options.samples = qMax(1, parser.value(samplesOption).toInt());
+	options.seed = parser.value(seedOption).toULongLong();
+
+	ServiceManager::setImplementation("ContactComparator",
+	                                  ExtensionInfo(QT_TRANSLATE_NOOP("Bench", "Status comparator"),
+	                                                LocalizedString(),
+	                                                new GeneralGenerator<Core::StatusComparator>()));
+
+	Random random(options.seed);
+	BenchProtocol protocol;
+	QVector<BenchRosterContact*> contacts;
+	ContactListGroupModel model;
+	QElapsedTimer timer;
+
+	// Roster is loaded by accounts as one update, like after login
+	timer.start();
+	for (int a = 0; a < options.accounts; ++a) {
+		BenchAccount *account = new BenchAccount(QStringLiteral("account%1@bench.example.org").arg(a), &protocol);
+		protocol.m_accounts << account;
+		QMetaObject::invokeMethod(&model, "onAccountCreated", Q_ARG(qutim_sdk_0_3::Account*, account), Q_ARG(bool, true));
+		account->beginRosterUpdate();
+		for (int c = 0; c < options.contacts; ++c) {
+			BenchRosterContact *contact = new BenchRosterContact(QStringLiteral("contact%1@account%2").arg(c).arg(a),
+			                                                     QStringLiteral("Contact %1").arg(random.next()), account);
+			contact->setTags(randomTags(random, options));
+			if (random.bounded(3) == 0)
+				contact->setStatus(Status::Online);
+			contacts << contact;
+			emit account->contactCreated(contact);
+		}
+		account->endRosterUpdate();
+	}
+	app.processEvents();
+	const qint64 loadTime = timer.nsecsElapsed();
+
+	static const Status::Type types[] = { Status::Online, Status::Away, Status::DND, Status::NA, Status::Offline };
+	timer.start();
+	for (int i = 0; i < options.changes; ++i) {
+		contacts.at(random.bounded(contacts.size()))->setStatus(types[random.bounded(5)]);
+		// Statuses come by network packets, so events are handled between some of them
+		if (i % 64 == 0)
+			app.processEvents();
+	}
+	app.processEvents();
+	const qint64 statusTime = timer.nsecsElapsed();
+
+	const int tagChanges = qMax(1, options.changes / 10);
+	timer.start();
+	for (int i = 0; i < tagChanges; ++i) {
+		contacts.at(random.bounded(contacts.size()))->setTags(randomTags(random, options));
+		if (i % 64 == 0)
+			app.processEvents();
+	}
+	app.processEvents();
+	const qint64 tagsTime = timer.nsecsElapsed();
+
+	QVector<qint64> walks;
+	int rows = 0;
+	for (int i = 0; i < options.samples; ++i) {
+		timer.start();
+		rows = walk(model, QModelIndex());
+		walks << timer.nsecsElapsed();
+	}
+
+	QVector<qint64> searches;
+	int found = 0;
+	for (int i = 0; i < options.samples; ++i) {
+		const QString text = QString::number(random.next() % 1000);
+		timer.start();
+		found += model.searchContacts(text).size();
+		searches << timer.nsecsElapsed();
+	}
+
+	timer.start();
+	qDeleteAll(contacts);
+	app.processEvents();
+	const qint64 removeTime = timer.nsecsElapsed();
+
+	std::sort(walks.begin(), walks.end());
+	std::sort(searches.begin(), searches.end());
+
+	QTextStream out(stdout);
+	out << "roster: " << options.accounts << " accounts x " << options.contacts << " contacts, "
+	    << rows << " rows" << endl;
+	out << "  load:    " << qint64(loadTime / 1e6) << " ms (" << qint64(rate(contacts.size(), loadTime)) << " contacts/s)" << endl;
+	out << "  status:  " << qint64(rate(options.changes, statusTime)) << " changes/s" << endl;
+	out << "  tags:    " << qint64(rate(tagChanges, tagsTime)) << " changes/s" << endl;
+	out << "  walk:    " << QString::number(walks.at(walks.size() / 2) / 1e6, 'f', 2) << " ms median" << endl;
+	out << "  search:  " << QString::number(searches.at(searches.size() / 2) / 1e6, 'f', 3) << " ms median, "
+	    << found / options.samples << " candidates" << endl;
+	out << "  remove:  " << qint64(removeTime / 1e6) << " ms" << endl;
+
+	if (parser.isSet(jsonOption)) {
+		Report report(QStringLiteral("contacts"));
+		report.setParameter(QStringLiteral("accounts"), options.accounts);
+		report.setParameter(QStringLiteral("contacts"), options.contacts);
+		report.setParameter(QStringLiteral("tags"), options.tags);
+		report.setParameter(QStringLiteral("changes"), options.changes);
+		report.setParameter(QStringLiteral("seed"), options.seed);
+		report.add(QStringLiteral("load"), rate(contacts.size(), loadTime), QStringLiteral("contacts/s"), Report::HigherIsBetter);
+		report.add(QStringLiteral("status"), rate(options.changes, statusTime), QStringLiteral("changes/s"), Report::HigherIsBetter);
+		report.add(QStringLiteral("tags"), rate(tagChanges, tagsTime), QStringLiteral("changes/s"), Report::HigherIsBetter);
+		report.addSamples(QStringLiteral("walk"), walks);
+		report.addSamples(QStringLiteral("search"), searches);
+		report.add(QStringLiteral("remove"), removeTime / 1e6, QStringLiteral("ms"));
+		if (!report.write(parser.value(jsonOption)))
+			return 2;
+	}
+
+	qDeleteAll(protocol.m_accounts);
+	return 0;
+}
@@ -0,0 +1,501 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+// Benchmark and conformance check of History backends. Every backend stores
+// the same synthetic profile into its own temporary history directory, then
+// is recreated and queried the way chat and history windows do. Results of
+// all backends are compared with the first one, exit code is non-zero if
+// they differ.
+
+#include "../../src/corelayers/jsonhistory/jsonhistory.h"
+#include "../../src/corelayers/segmenthistory/segmenthistory.h"
+#include "../../../plugins/sqlhistory/sqlengine.h"
+#include "../benchunits.h"
+#include "../benchreport.h"
+#include <qutim/executor.h>
+#include <qutim/systeminfo.h>
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <algorithm>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+LIBQUTIM_EXPORT QVector<QDir> *system_info_dirs();
+}
+
+using namespace qutim_sdk_0_3;
+
+namespace HistoryBench
+{
+
+using namespace Bench;
+
+// Word, which is put into some messages to be searched for
+static const char Needle[] = "quasarneedle";
+// Messages are sent from 9:00 to 21:00
+static const int DaySeconds = 12 * 60 * 60;
+
+// Deterministic generator, so every run and backend gets the same profile
+class Random
+{
+public:
+	Random(quint64 seed) : m_state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+	quint32 next()
+	{
+		m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return quint32(m_state >> 33);
+	}
+	int bounded(int max) { return int(next() % quint32(max)); }
+	bool chance(int percent) { return bounded(100) < percent; }
+
+private:
+	quint64 m_state;
+};
+
+static QString word(Random &random)
+{
+	static const char * const syllables[] = {
+		"ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "zo", "pe", "bar", "qu",
+		"при", "вет", "да", "ко", "ну", "сто", "ма"
+	};
+	const int count = 1 + random.bounded(4);
+	QString result;
+	for (int i = 0; i < count; ++i)
+		result += QString::fromUtf8(syllables[random.bounded(sizeof(syllables) / sizeof(syllables[0]))]);
+	return result;
+}
+
+// Most messages are short, a few are long pastes. Some contain characters
+// which have to be escaped by storages.
+static QString text(Random &random)
+{
+	const int kind = random.bounded(100);
+	int words;
+	if (kind < 60)
+		words = 1 + random.bounded(6);
+	else if (kind < 90)
+		words = 7 + random.bounded(24);
+	else if (kind < 99)
+		words = 30 + random.bounded(90);
+	else
+		words = 300 + random.bounded(300);
+
+	QString result;
+	for (int i = 0; i < words; ++i) {
+		if (i > 0)
+			result += random.chance(3) ? QLatin1Char('\n') : QLatin1Char(' ');
+		result += word(random);
+		if (random.chance(5))
+			result += QLatin1Char(',');
+		else if (random.chance(1))
+			result += QStringLiteral(" \"C:\\path\\") + word(random) + QLatin1Char('"');
+	}
+	if (random.chance(1))
+		result += QLatin1Char(' ') + QLatin1String(Needle);
+	return result;
+}
+
+struct Options
+{
+	int accounts;
+	int contacts;
+	int months;
+	int messages;
+	int samples;
+	quint64 seed;
+	bool import;
+};
+
+struct ContactData
+{
+	History::ContactInfo info;
+	ChatUnit *unit;
+	MessageList messages;
+};
+
+struct Profile
+{
+	QVector<ContactData> contacts;
+	// Messages of all contacts in time order, as if they came live
+	QVector<QPair<int, int>> timeline;
+	int total;
+};
+
+static void generate(Profile &profile, BenchProtocol *protocol, const Options &options)
+{
+	Random random(options.seed);
+	const QDate today = QDate::currentDate();
+	const QDate firstMonth = QDate(today.year(), today.month(), 1).addMonths(-options.months);
+
+	for (int a = 0; a < options.accounts; ++a) {
+		BenchAccount *account = new BenchAccount(QStringLiteral("user%1@bench.example.org").arg(a), protocol);
+		protocol->m_accounts << account;
+		for (int c = 0; c < options.contacts; ++c) {
+			ContactData data;
+			data.unit = new BenchContact(QStringLiteral("contact%1@bench.example.org").arg(c), account);
+			data.info = History::info(data.unit);
+			for (int m = 0; m < options.months; ++m) {
+				// Json history keeps local time with seconds precision, so
+				// times are unique whole seconds of daytime, away from DST
+				// switches
+				const QDate month = firstMonth.addMonths(m);
+				QVector<int> offsets;
+				offsets.reserve(options.messages);
+				for (int i = 0; i < options.messages; ++i)
+					offsets << random.bounded(month.daysInMonth() * DaySeconds - options.messages);
+				std::sort(offsets.begin(), offsets.end());
+				for (int i = 0; i < offsets.size(); ++i) {
+					const int offset = offsets.at(i) + i;
+					Message message(text(random));
+					message.setChatUnit(data.unit);
+					message.setIncoming(random.chance(50));
+					message.setTime(QDateTime(month.addDays(offset / DaySeconds), QTime(9, 0))
+					                .addSecs(offset % DaySeconds));
+					data.messages << message;
+				}
+			}
+			profile.contacts << data;
+		}
+	}
+
+	profile.total = 0;
+	for (int c = 0; c < profile.contacts.size(); ++c) {
+		for (int i = 0; i < profile.contacts.at(c).messages.size(); ++i)
+			profile.timeline << qMakePair(c, i);
+		profile.total += profile.contacts.at(c).messages.size();
+	}
+	std::stable_sort(profile.timeline.begin(), profile.timeline.end(),
+	                 [&profile] (const QPair<int, int> &a, const QPair<int, int> &b) {
+		return profile.contacts.at(a.first).messages.at(a.second).time()
+		        < profile.contacts.at(b.first).messages.at(b.second).time();
+	});
+}
+
+template <typename T>
+static T wait(AsyncResult<T> result)
+{
+	T value;
+	QEventLoop loop;
+	// Result may be ready already, so connect from inside of the loop
+	QTimer::singleShot(0, &loop, [&loop, &result, &value] () {
+		result.connect(&loop, [&loop, &value] (const T &data) {
+			value = data;
+			loop.quit();
+		});
+	});
+	loop.exec();
+	return value;
+}
+
+class Samples
+{
+public:
+	void add(const QElapsedTimer &timer) { m_values << timer.nsecsElapsed(); }
+
+	QString summary() const
+	{
+		if (m_values.isEmpty())
+			return QStringLiteral("no calls");
+		QVector<qint64> values = m_values;
+		std::sort(values.begin(), values.end());
+		return QStringLiteral("median %1 ms, p95 %2 ms, max %3 ms (%4 calls)")
+		        .arg(toMsecs(values.at(values.size() / 2)), 0, 'f', 2)
+		        .arg(toMsecs(values.at(qMin(values.size() - 1, values.size() * 95 / 100))), 0, 'f', 2)
+		        .arg(toMsecs(values.last()), 0, 'f', 2)
+		        .arg(values.size());
+	}
+
+	static double toMsecs(qint64 nsecs) { return nsecs / 1e6; }
+	const QVector<qint64> &values() const { return m_values; }
+
+private:
+	QVector<qint64> m_values;
+};
+
+// Resident memory in KiB or -1 if it's unknown on this system
+static qint64 residentMemory()
+{
+	QFile file(QStringLiteral("/proc/self/status"));
+	if (!file.open(QIODevice::ReadOnly))
+		return -1;
+	foreach (const QByteArray &line, file.readAll().split('\n')) {
+		if (line.startsWith("VmRSS:"))
+			return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+	}
+	return -1;
+}
+
+static QString memory(qint64 kbytes)
+{
+	if (kbytes < 0)
+		return QStringLiteral("n/a");
+	return QStringLiteral("%1 MiB").arg(kbytes / 1024.0, 0, 'f', 1);
+}
+
+static qint64 diskUsage(const QString &path)
+{
+	qint64 size = 0;
+	QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+	while (it.hasNext()) {
+		it.next();
+		size += it.fileInfo().size();
+	}
+	return size;
+}
+
+static QString contactKey(const History::ContactInfo &info)
+{
+	return info.protocol + QLatin1Char('/') + info.account + QLatin1Char('/') + info.contact;
+}
+
+// Answers of one backend, every section is compared line by line
+typedef QMap<QString, QStringList> Results;
+
+struct Backend
+{
+	const char *name;
+	std::function<History *()> create;
+};
+
+static Results run(const Backend &backend, const Profile &profile, const Options &options,
+                   QTextStream &out, Report &report)
+{
+	Results results;
+	QTemporaryDir dir;
+	(*system_info_dirs())[SystemInfo::HistoryDir] = QDir(dir.path());
+
+	const qint64 initialMemory = residentMemory();
+	History *history = backend.create();
+	Executor *executor = history->executor();
+
+	QElapsedTimer timer;
+	timer.start();
+	if (options.import) {
+		foreach (const ContactData &contact, profile.contacts)
+			history->storeBatch(contact.info, contact.messages);
+	} else {
+		for (const QPair<int, int> &item : profile.timeline)
+			history->store(profile.contacts.at(item.first).messages.at(item.second));
+	}
+	// Backends write asynchronously, written data is guaranteed only
+	// after backend is destroyed and its jobs are finished
+	delete history;
+	executor->waitForDone();
+	const qint64 storeTime = qMax<qint64>(1, timer.elapsed());
+	const qint64 storeMemory = residentMemory();
+
+	history = backend.create();
+	Samples listing, reads, searches;
+
+	timer.start();
+	const QVector<History::AccountInfo> accounts = wait(history->accounts());
+	QStringList contactKeys;
+	foreach (const History::AccountInfo &account, accounts) {
+		results[QStringLiteral("accounts")] << account.protocol + QLatin1Char('/') + account.account;
+		foreach (const History::ContactInfo &contact, wait(history->contacts(account)))
+			contactKeys << contactKey(contact);
+	}
+	listing.add(timer);
+	results[QStringLiteral("accounts")].sort();
+	contactKeys.sort();
+	results[QStringLiteral("contacts")] = contactKeys;
+
+	QRegularExpression search(QLatin1Char('(') + QRegularExpression::escape(QLatin1String(Needle)) + QLatin1Char(')'),
+	                          QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption);
+	const int step = qMax(1, profile.contacts.size() / qMax(1, options.samples));
+	for (int c = 0; c < profile.contacts.size(); c += step) {
+		const History::ContactInfo &info = profile.contacts.at(c).info;
+		const QString key = contactKey(info);
+
+		timer.start();
+		const MessageList last = wait(history->read(info, QDateTime(), QDateTime(), 50));
+		reads.add(timer);
+		QStringList &lines = results[QStringLiteral("read ") + key];
+		foreach (const Message &message, last) {
+			lines << QString::number(message.time().toMSecsSinceEpoch())
+			         + (message.isIncoming() ? QStringLiteral(" in ") : QStringLiteral(" out "))
+			         + message.text();
+		}
+
+		QStringList &months = results[QStringLiteral("months ") + key];
+		foreach (const QDate &month, wait(history->months(info, QRegularExpression())))
+			months << month.toString(QStringLiteral("yyyy-MM"));
+
+		// Months may be reported by index as candidates only, so just
+		// matched dates are compared
+		timer.start();
+		QStringList &dates = results[QStringLiteral("search ") + key];
+		foreach (const QDate &month, wait(history->months(info, search))) {
+			foreach (const QDate &date, wait(history->dates(info, month, search)))
+				dates << date.toString(Qt::ISODate);
+		}
+		searches.add(timer);
+	}
+	const qint64 queryMemory = residentMemory();
+	delete history;
+	executor->waitForDone();
+	const qint64 disk = diskUsage(dir.path());
+
+	out << backend.name << ": " << profile.total << " messages "
+	    << (options.import ? "imported" : "stored") << " in " << storeTime << " ms ("
+	    << profile.total * 1000 / storeTime << " msg/s), "
+	    << QString::number(disk / 1048576.0, 'f', 1) << " MiB on disk" << endl;
+	out << "  accounts/contacts: " << listing.summary() << endl;
+	out << "  read last 50:      " << reads.summary() << endl;
+	out << "  search:            " << searches.summary() << endl;
+	out << "  memory:            " << memory(initialMemory) << " before, "
+	    << memory(storeMemory) << " after store, " << memory(queryMemory) << " after queries" << endl;
+
+	const QString prefix = QLatin1String(backend.name) + QLatin1Char('/');
+	report.add(prefix + QStringLiteral("store"), profile.total * 1000.0 / storeTime, QStringLiteral("msg/s"), Report::HigherIsBetter);
+	report.add(prefix + QStringLiteral("disk"), disk / 1048576.0, QStringLiteral("MiB"));
+	report.addSamples(prefix + QStringLiteral("listing"), listing.values());
+	report.addSamples(prefix + QStringLiteral("read"), reads.values());
+	report.addSamples(prefix + QStringLiteral("search"), searches.values());
+	if (queryMemory >= 0 && initialMemory >= 0)
+		report.add(prefix + QStringLiteral("memory"), (queryMemory - initialMemory) / 1024.0, QStringLiteral("MiB"));
+	return results;
+}
+
+// Returns description of the first difference or empty string
+static QString compare(const Results &expected, const Results &actual)
+{
+	QStringList keys = expected.keys() + actual.keys();
+	keys.removeDuplicates();
+	keys.sort();
+	foreach (const QString &key, keys) {
+		const QStringList a = expected.value(key);
+		const QStringList b = actual.value(key);
+		for (int i = 0; i < qMax(a.size(), b.size()); ++i) {
+			const QString left = a.value(i, QStringLiteral("<missing>"));
+			const QString right = b.value(i, QStringLiteral("<missing>"));
+			if (left != right)
+				return QStringLiteral("%1, line %2:\n    expected: %3\n    actual:   %4")
+				        .arg(key).arg(i + 1).arg(left.left(200), right.left(200));
+		}
+	}
+	return QString();
+}
+
+}
+
+using namespace HistoryBench;
+
+int main(int argc, char *argv[])
+{
+	// Backends create actions with icons, but no windows are shown
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+	app.setApplicationName(QStringLiteral("historybench"));
+
+	const Backend backends[] = {
+		{ "json", [] () -> History * { return new Core::JsonHistory; } },
+		{ "segment", [] () -> History * { return new Core::SegmentHistory; } },
+		{ "sql", [] () -> History * { return new SqlHistoryNamespace::SqlEngine; } }
+	};
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QStringLiteral("Measures history backends and checks that they return identical results."));
+	parser.addHelpOption();
+	QCommandLineOption backendsOption(QStringLiteral("backends"), QStringLiteral("Comma separated backends, the first one is reference."),
+	                                  QStringLiteral("list"), QStringLiteral("json,segment,sql"));
+	QCommandLineOption accountsOption(QStringLiteral("accounts"), QStringLiteral("Number of accounts."), QStringLiteral("n"), QStringLiteral("2"));
+	QCommandLineOption contactsOption(QStringLiteral("contacts"), QStringLiteral("Contacts per account."), QStringLiteral("n"), QStringLiteral("25"));
+	QCommandLineOption monthsOption(QStringLiteral("months"), QStringLiteral("Months of history."), QStringLiteral("n"), QStringLiteral("12"));
+	QCommandLineOption messagesOption(QStringLiteral("messages"), QStringLiteral("Messages per contact and month."), QStringLiteral("n"), QStringLiteral("200"));
+	QCommandLineOption samplesOption(QStringLiteral("samples"), QStringLiteral("Contacts queried by read and search."), QStringLiteral("n"), QStringLiteral("20"));
+	QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed of generated profile."), QStringLiteral("n"), QStringLiteral("1"));
+	QCommandLineOption importOption(QStringLiteral("import"), QStringLiteral("Store by storeBatch() instead of store()."));
+	const QCommandLineOption jsonOption = Report::option();
+	parser.addOptions(QList<QCommandLineOption>() << backendsOption << accountsOption << contactsOption
+	                  << monthsOption << messagesOption << samplesOption << seedOption << importOption << jsonOption);
+	parser.process(app);
+
+	Options options;
+	options.accounts = qMax(1, parser.value(accountsOption).toInt());
+	options.contacts = qMax(1, parser.value(contactsOption).toInt());
+	options.months = qMax(1, parser.value(monthsOption).toInt());
+	options.messages = qMax(1, parser.value(messagesOption).toInt());
+	options.samples = qMax(1, parser.value(samplesOption).toInt());
+	options.seed = parser.value(seedOption).toULongLong();
+	options.import = parser.isSet(importOption);
+
+	QList<const Backend *> selected;
+	foreach (const QString &name, parser.value(backendsOption).split(QLatin1Char(','), QString::SkipEmptyParts)) {
+		const Backend *backend = std::find_if(std::begin(backends), std::end(backends), [&name] (const Backend &item) {
+			return name == QLatin1String(item.name);
+		});
+		if (backend == std::end(backends)) {
+			qCritical("Unknown history backend: %s", qPrintable(name));
+			return 2;
+		}
+		selected << backend;
+	}
+
+	QTextStream out(stdout);
+	BenchProtocol protocol;
+	Profile profile;
+	generate(profile, &protocol, options);
+	out << "profile: " << options.accounts << " accounts x " << options.contacts << " contacts x "
+	    << options.months << " months x " << options.messages << " messages" << endl;
+
+	Report report(QStringLiteral("history"));
+	report.setParameter(QStringLiteral("accounts"), options.accounts);
+	report.setParameter(QStringLiteral("contacts"), options.contacts);
+	report.setParameter(QStringLiteral("months"), options.months);
+	report.setParameter(QStringLiteral("messages"), options.messages);
+	report.setParameter(QStringLiteral("seed"), options.seed);
+	report.setParameter(QStringLiteral("import"), options.import);
+
+	bool failed = false;
+	Results reference;
+	for (int i = 0; i < selected.size(); ++i) {
+		const Results results = run(*selected.at(i), profile, options, out, report);
+		if (i == 0) {
+			reference = results;
+			continue;
+		}
+		const QString difference = compare(reference, results);
+		if (!difference.isEmpty()) {
+			out << "  MISMATCH with " << selected.first()->name << ": " << difference << endl;
+			failed = true;
+		}
+	}
+
+	qDeleteAll(protocol.m_accounts);
+	if (parser.isSet(jsonOption) && !report.write(parser.value(jsonOption)))
+		return 2;
+	return failed ? 1 : 0;
+}
+
@@ -69,9 +69,34 @@ var client = (function() {
         clientId = id;
 
         window.onload = function() {
-            var socket = new WebSocket(wsUri);
+            var separator = wsUri.indexOf('?') < 0 ? '?' : '&';
+            var socket = new WebSocket(wsUri + separator + 'framing=batch');
+            socket.binaryType = 'arraybuffer';
             console.log('creating websocket');
 
+            // Server packs several messages into one binary frame, split
+            // them back before handing to the web channel
+            var transport = {
+                send: function(data) {
+                    socket.send(data);
+                },
+                onmessage: undefined
+            };
+            socket.onmessage = function(message) {
+                var data = message.data;
+                if (typeof data === 'string') {
+                    transport.onmessage(message);
+                    return;
+                }
+                var bytes = new Uint8Array(data);
+                var text = '';
+                for (var offset = 0; offset < bytes.length; offset += 8192)
+                    text += String.fromCharCode.apply(null, bytes.subarray(offset, offset + 8192));
+                var messages = decodeURIComponent(escape(text)).split('\n');
+                for (var i = 0; i < messages.length; ++i)
+                    transport.onmessage({ data: messages[i] });
+            };
+
             socket.onclose = function() {
                 console.error("web channel closed");
             };
@@ -79,7 +104,7 @@ var client = (function() {
                 console.error("web channel error: " + error);
             };
             socket.onopen = function() {
-                webChannel = new QWebChannel(socket, function(channel) {
+                webChannel = new QWebChannel(transport, function(channel) {
                     connection = channel.objects.client;
 
                     function createRealCallback(name) {
@@ -64,6 +64,7 @@ public:
 	void setSession(qutim_sdk_0_3::ChatSession *session);
 	WebKitMessageViewStyle *style();
 	void appendMessage(const qutim_sdk_0_3::Message &msg);
+	void appendMessages(const qutim_sdk_0_3::MessageList &messages);
 	bool eventFilter(QObject *obj, QEvent *);
 	bool isPreview() const;
 	void setPreview(bool preview);
@@ -86,6 +87,7 @@ protected:
 	void setPage(QWebPage *page);
 	void clearFocusClass();
 	bool isContentSimiliar(const qutim_sdk_0_3::Message &a, const qutim_sdk_0_3::Message &b);
+	QString scriptForMessage(const qutim_sdk_0_3::Message &msg, bool willAddMoreContentObjects);
 	void loadSettings(bool onFly);
 	void loadHistory();
 	
@@ -114,6 +116,10 @@ private:
 	QStringList m_pendingScripts;
 	qutim_sdk_0_3::Message m_last;
 	qutim_sdk_0_3::Message m_topic;
+	// Messages appended while history is being read
+	qutim_sdk_0_3::MessageList m_pendingMessages;
+	bool m_historyPending;
+	int m_historyGeneration;
 };
 
 #endif // WEBKITMESSAGEVIEWCONTROLLER_H
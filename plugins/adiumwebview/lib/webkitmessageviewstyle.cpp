@@ -30,6 +30,8 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QFile>
+#include <QHash>
+#include <QVector>
 #include <QDebug>
 #include <QVariantMap>
 #include <QUrl>
@@ -44,6 +46,55 @@
 
 using namespace qutim_sdk_0_3;
 
+enum WebKitTemplateKeyword
+{
+	LiteralKeyword,
+	TimeKeyword,
+	TimeFormatKeyword,
+	MessageIdKeyword,
+	ShortTimeKeyword,
+	UserIconsKeyword,
+	MessageClassesKeyword,
+	SenderColorKeyword,
+	MessageDirectionKeyword,
+	UserIconPathKeyword,
+	ServiceKeyword,
+	ServiceIconPathKeyword,
+	VariantKeyword,
+	StatusKeyword,
+	StatusSenderKeyword,
+	StatusPhraseKeyword,
+	SenderScreenNameKeyword,
+	SenderPrefixKeyword,
+	SenderKeyword,
+	SenderDisplayNameKeyword,
+	MessageKeyword,
+	TopicKeyword
+};
+
+struct WebKitTemplateToken
+{
+	WebKitTemplateKeyword keyword;
+	// Literal text, format of %time{x}% or the keyword itself for the rest
+	QString text;
+};
+
+// Content template split once into literals and keyword slots, so every
+// message is rendered by a single linear pass
+class WebKitMessageTemplate
+{
+public:
+	WebKitMessageTemplate() : literalSize(0), hasStatusPhrase(false) {}
+
+	void compile(const QString &html);
+	void clear();
+	bool isEmpty() const { return tokens.isEmpty(); }
+
+	QVector<WebKitTemplateToken> tokens;
+	int literalSize;
+	bool hasStatusPhrase;
+};
+
 class WebKitMessageViewStylePrivate
 {
 public:
@@ -73,6 +124,20 @@ public:
 	QString actionInHTML;
 	QString actionOutHTML;
 	
+	//Compiled content templates
+	WebKitMessageTemplate topicTemplate;
+	WebKitMessageTemplate actionInTemplate;
+	WebKitMessageTemplate actionOutTemplate;
+	WebKitMessageTemplate contentInTemplate;
+	WebKitMessageTemplate nextContentInTemplate;
+	WebKitMessageTemplate contentOutTemplate;
+	WebKitMessageTemplate nextContentOutTemplate;
+	WebKitMessageTemplate contextInTemplate;
+	WebKitMessageTemplate nextContextInTemplate;
+	WebKitMessageTemplate contextOutTemplate;
+	WebKitMessageTemplate nextContextOutTemplate;
+	WebKitMessageTemplate statusTemplate;
+	
 	//Style settings
 	bool allowsCustomBackground;
 	bool transparentDefaultBackground;
@@ -162,6 +227,94 @@ static QString escapeString(const QString &text)
 	return text.toHtmlEscaped().replace(QLatin1Char('%'), QLatin1String("&#37;"));
 }
 
+static QHash<QString, WebKitTemplateKeyword> buildTemplateKeywords()
+{
+	QHash<QString, WebKitTemplateKeyword> keywords;
+	keywords.insert(QStringLiteral("time"), TimeKeyword);
+	keywords.insert(QStringLiteral("messageId"), MessageIdKeyword);
+	keywords.insert(QStringLiteral("shortTime"), ShortTimeKeyword);
+	keywords.insert(QStringLiteral("userIcons"), UserIconsKeyword);
+	keywords.insert(QStringLiteral("messageClasses"), MessageClassesKeyword);
+	keywords.insert(QStringLiteral("senderColor"), SenderColorKeyword);
+	keywords.insert(QStringLiteral("messageDirection"), MessageDirectionKeyword);
+	keywords.insert(QStringLiteral("userIconPath"), UserIconPathKeyword);
+	keywords.insert(QStringLiteral("service"), ServiceKeyword);
+	keywords.insert(QStringLiteral("serviceIconPath"), ServiceIconPathKeyword);
+	keywords.insert(QStringLiteral("variant"), VariantKeyword);
+	keywords.insert(QStringLiteral("status"), StatusKeyword);
+	keywords.insert(QStringLiteral("statusSender"), StatusSenderKeyword);
+	keywords.insert(QStringLiteral("statusPhrase"), StatusPhraseKeyword);
+	keywords.insert(QStringLiteral("senderScreenName"), SenderScreenNameKeyword);
+	keywords.insert(QStringLiteral("senderPrefix"), SenderPrefixKeyword);
+	keywords.insert(QStringLiteral("sender"), SenderKeyword);
+	keywords.insert(QStringLiteral("senderDisplayName"), SenderDisplayNameKeyword);
+	keywords.insert(QStringLiteral("message"), MessageKeyword);
+	keywords.insert(QStringLiteral("topic"), TopicKeyword);
+	return keywords;
+}
+
+void WebKitMessageTemplate::compile(const QString &html)
+{
+	static const QHash<QString, WebKitTemplateKeyword> keywords = buildTemplateKeywords();
+	clear();
+	
+	WebKitTemplateToken literal = { LiteralKeyword, QString() };
+	const int size = html.size();
+	int i = 0;
+	while (i < size) {
+		if (html.at(i) == QLatin1Char('%')) {
+			int end = i + 1;
+			while (end < size && html.at(end).isLetter())
+				++end;
+			WebKitTemplateToken token = { LiteralKeyword, QString() };
+			int next = -1;
+			if (end < size && html.at(end) == QLatin1Char('{')
+			        && html.midRef(i + 1, end - i - 1) == QLatin1String("time")) {
+				//%time{x}% is a timestamp formatted like x
+				const int close = html.indexOf(QLatin1String("}%"), end + 1);
+				if (close != -1) {
+					token.keyword = TimeFormatKeyword;
+					token.text = html.mid(end + 1, close - end - 1);
+					next = close + 2;
+				}
+			} else if (end < size && html.at(end) == QLatin1Char('%')) {
+				const QString name = html.mid(i + 1, end - i - 1);
+				QHash<QString, WebKitTemplateKeyword>::const_iterator it = keywords.constFind(name);
+				if (it != keywords.constEnd()) {
+					token.keyword = it.value();
+					token.text = html.mid(i, end - i + 1);
+					hasStatusPhrase |= (token.keyword == StatusPhraseKeyword);
+					next = end + 1;
+				}
+			}
+			if (next != -1) {
+				if (!literal.text.isEmpty()) {
+					literalSize += literal.text.size();
+					tokens << literal;
+					literal.text.clear();
+				}
+				tokens << token;
+				i = next;
+				continue;
+			}
+		}
+		literal.text += html.at(i);
+		++i;
+	}
+	if (!literal.text.isEmpty()) {
+		literalSize += literal.text.size();
+		tokens << literal;
+	}
+	tokens.squeeze();
+}
+
+void WebKitMessageTemplate::clear()
+{
+	tokens.clear();
+	literalSize = 0;
+	hasStatusPhrase = false;
+}
+
 WebKitMessageViewStyle::WebKitMessageViewStyle() : d_ptr(new WebKitMessageViewStylePrivate)
 {
 	Q_D(WebKitMessageViewStyle);
@@ -843,17 +996,31 @@ void WebKitMessageViewStyle::loadTemplates()
 	}
 	d->fileTransferHTML.replace(QLatin1String("Download %fileName%"),
 	                            QObject::tr("Download %fileName%"));
+	
+	//Parse keywords once instead of searching for them in every message
+	d->topicTemplate.compile(d->topicHTML);
+	d->actionInTemplate.compile(d->actionInHTML);
+	d->actionOutTemplate.compile(d->actionOutHTML);
+	d->contentInTemplate.compile(d->contentInHTML);
+	d->nextContentInTemplate.compile(d->nextContentInHTML);
+	d->contentOutTemplate.compile(d->contentOutHTML);
+	d->nextContentOutTemplate.compile(d->nextContentOutHTML);
+	d->contextInTemplate.compile(d->contextInHTML);
+	d->nextContextInTemplate.compile(d->nextContextInHTML);
+	d->contextOutTemplate.compile(d->contextOutHTML);
+	d->nextContextOutTemplate.compile(d->nextContextOutHTML);
+	d->statusTemplate.compile(d->statusHTML);
 }
 
 QString WebKitMessageViewStyle::templateForContent(const qutim_sdk_0_3::Message &message, bool contentIsSimilar)
 {
 	Q_D(WebKitMessageViewStyle);
-	QString result;
+	const WebKitMessageTemplate *result;
 	
 	// Get the correct result for what we're inserting
 	
 	if (message.property("topic", false)) {
-		result = d->topicHTML;
+		result = &d->topicTemplate;
 	// FIXME: Implement file transfer support
 //	} else if (content.pro == IContent::FileTranfser) {
 //		result = d->fileTransferHTML;
@@ -861,28 +1028,28 @@ QString WebKitMessageViewStyle::templateForContent(const qutim_sdk_0_3::Message
 		bool isAction = message.html().startsWith(QLatin1String("/me "), Qt::CaseInsensitive);
 		if (isAction && hasAction()) {
 			if (!message.isIncoming())
-				result = d->actionOutHTML;
+				result = &d->actionOutTemplate;
 			else
-				result = d->actionInHTML;
+				result = &d->actionInTemplate;
 		} else if (message.property("history", false)) {
 			if (!message.isIncoming())
-				result = contentIsSimilar ? d->nextContextOutHTML : d->contextOutHTML;
+				result = contentIsSimilar ? &d->nextContextOutTemplate : &d->contextOutTemplate;
 			else
-				result = contentIsSimilar ? d->nextContextInHTML : d->contextInHTML;
+				result = contentIsSimilar ? &d->nextContextInTemplate : &d->contextInTemplate;
 		} else {
 			if (!message.isIncoming())
-				result = contentIsSimilar ? d->nextContentOutHTML : d->contentOutHTML;
+				result = contentIsSimilar ? &d->nextContentOutTemplate : &d->contentOutTemplate;
 			else
-				result = contentIsSimilar ? d->nextContentInHTML : d->contentInHTML;
+				result = contentIsSimilar ? &d->nextContentInTemplate : &d->contentInTemplate;
 		} 
 	} else {
-		result = d->statusHTML;
+		result = &d->statusTemplate;
 	} 
 	
-	if (!result.isEmpty())
-		fillKeywords(result, message, contentIsSimilar);
+	if (result->isEmpty())
+		return QString();
 	
-	return result;
+	return fillKeywords(*result, message, contentIsSimilar);
 }
 
 WebKitMessageViewStyle::UnitData WebKitMessageViewStyle::getSourceData(const qutim_sdk_0_3::Message &message)
@@ -897,7 +1064,7 @@ WebKitMessageViewStyle::UnitData WebKitMessageViewStyle::getSourceData(const qut
     return result;
 }
 
-QString &WebKitMessageViewStyle::fillKeywords(QString &inString, const qutim_sdk_0_3::Message &message, bool contentIsSimilar)
+QString WebKitMessageViewStyle::fillKeywords(const WebKitMessageTemplate &messageTemplate, const qutim_sdk_0_3::Message &message, bool contentIsSimilar)
 {
 	Q_D(WebKitMessageViewStyle);
 	UnitData contentSource = getSourceData(message);
@@ -923,25 +1090,18 @@ QString &WebKitMessageViewStyle::fillKeywords(QString &inString, const qutim_sdk
 	bool isService = message.property("service", false);
 	bool isTopic = message.property("topic", false);
 	bool isAutoreply = message.property("autoreply", false);
+	bool isMessage = isTopic || !isService;
 	
-	//Replacements applicable to any AIContentObject
-	inString.replace(QLatin1String("%time%"), convertTimeDate(d->timeStampFormatter, date));
 	QString messageId = message.property("messageId").toString();
 	if (messageId.isEmpty())
 		messageId = QString::number(message.id());
-	inString.replace(QLatin1String("%messageId%"), QLatin1String("message") + messageId);
-	inString.replace(QLatin1String("%shortTime%"), date.toString(Qt::SystemLocaleShortDate));
 	
-	// FIXME: Implement
-//	inString.replace(QLatin1String("%senderStatusIcon%"), QUrl)
+	// FIXME: Implement %senderStatusIcon%
 //	if ([inString rangeOfString:@"%senderStatusIcon%"].location != NSNotFound) {
 //		//Only cache the status icon to disk if the message style will actually use it
 //		[inString replaceKeyword:@"%senderStatusIcon%"
 //					  withString:[self statusIconPathForListObject:theSource]];
 //	}
-
-	
-	inString.replace(QLatin1String("%userIcons%"), QLatin1String(d->showUserIcons ? "showIcons" : "hideIcons"));
 	
 	// Known classes:
 	// "mention" == highlight
@@ -958,7 +1118,7 @@ QString &WebKitMessageViewStyle::fillKeywords(QString &inString, const qutim_sdk
 		displayClasses << QLatin1String("autoreply");
 	if (message.property("mention", false))
 		displayClasses << QLatin1String("mention");
-	if (!isTopic && isService) {
+	if (!isMessage) {
 		displayClasses << QLatin1String("status");
 		// Implement more logic way
 		// May be status messages should provide information about previous and current statuses?
@@ -969,68 +1129,24 @@ QString &WebKitMessageViewStyle::fillKeywords(QString &inString, const qutim_sdk
 		displayClasses << QLatin1String("message");
 		displayClasses << QLatin1String(message.isIncoming() ? "incoming" : "outgoing");
 	}
-	inString.replace(QLatin1String("%messageClasses%"), QLatin1String(contentIsSimilar ? "consecutive " : "") + displayClasses.join(QLatin1String(" ")));
-	
-	inString.replace(QLatin1String("%senderColor%"), WebKitColorsAdditions::representedColorForObject(contentSource.id, validSenderColors()));
-	
-	inString.replace(QLatin1String("%messageDirection%"), QLatin1String(message.text().isRightToLeft() ? "rtl" : "ltr"));
 	
-	//Replaces %time{x}% with a timestamp formatted like x (using NSDateFormatter)
-	const QStringMatcher matcher(QLatin1String("%time{"));
-	const int matcherSize = matcher.pattern().size();
-	const QStringMatcher endMatcher(QLatin1String("}%"));
-	const int endMatcherSize = endMatcher.pattern().size();
-	int range = 0;
-	do {
-		range = matcher.indexIn(inString, range);
-		if (range != -1) {
-			int endRange = endMatcher.indexIn(inString, range + matcherSize);
-			if (endRange != -1) {
-				QString timeFormat = inString.mid(range + matcherSize, endRange - range - matcherSize);
-				QString time = convertTimeDate(timeFormat, date);
-				inString.replace(range, endRange + endMatcherSize - range, time);
-				range = range + time.size();
-			}
-		}
-	} while (range != -1);
+	//Use content.source directly rather than the potentially-metaContact theSource
+	QString senderDisplay = contentSource.title;
+	if (isAutoreply) {
+		senderDisplay += " ";
+		senderDisplay += QObject::tr("(Autoreply)");
+	}
 	
-	QString userIconPath;
-	if (d->showUserIcons)
-		userIconPath = urlFromFilePath(theSource.avatar);
-	if (userIconPath.isEmpty())
-		userIconPath = QLatin1String(message.isIncoming() ? "Incoming/buddy_icon.png" : "Outgoing/buddy_icon.png");
-	inString.replace(QLatin1String("%userIconPath%"), userIconPath);
+	// Status phrase replaces the message if style shows it
+	QString statusPhrase;
+	if (!isMessage)
+		statusPhrase = message.property("statusPhrase", QString());
+	bool replacedStatusPhrase = !statusPhrase.isEmpty() && messageTemplate.hasStatusPhrase;
 	
-	// Implement the way to get shortDescription and icon path for service icons
-	QString service = message.chatUnit() ? message.chatUnit()->account()->protocol()->id() : QString();
-	inString.replace(QLatin1String("%service%"), escapeString(service));
-	inString.replace(QLatin1String("%serviceIconPath%"), QString() /*content.chat->account.protocol.iconPath*/);
-	inString.replace(QLatin1String("%variant%"), activeVariantPath());
+	// Add support for %textbackgroundcolor{alpha?}%
+	// Background should be caught from content's html
 
-	bool replacedStatusPhrase = false;
-	//message stuff
-	if (isTopic || !isService) {
-		//Use content.source directly rather than the potentially-metaContact theSource
-		QString formattedUID = contentSource.id;
-		QString displayName = contentSource.title;
-		
-		inString.replace(QLatin1String("%status%"), QString());
-		inString.replace(QLatin1String("%senderScreenName%"), escapeString(formattedUID));
-		// Should be used as %, @, + or something like irc's channel statuses
-		inString.replace(QLatin1String("%senderPrefix%"), message.property("senderPrefix", QString()));
-		QString senderDisplay = displayName;
-		if (isAutoreply) {
-			senderDisplay += " ";
-			senderDisplay += QObject::tr("(Autoreply)");
-		}
-		inString.replace(QLatin1String("%sender%"), escapeString(senderDisplay));
-		// Should be server-side display name if possible
-		inString.replace(QLatin1String("%senderDisplayName%"), escapeString(displayName));
-
-		// Add support for %textbackgroundcolor{alpha?}%
-		// Background should be caught from content's html
-
-		// FIXME: Add support
+	// FIXME: Add support
 //		if ([content isKindOfClass:[ESFileTransfer class]]) { //file transfers are an AIContentMessage subclass
 		
 //			ESFileTransfer *transfer = (ESFileTransfer *)content;
@@ -1061,31 +1177,109 @@ QString &WebKitMessageViewStyle::fillKeywords(QString &inString, const qutim_sdk
 //						  withString:[NSString stringWithFormat:@"client.handleFileTransfer('Cancel', '%@')", fileTransferID]];
 //		}
 
-		//Message (must do last)
-		inString.replace(QLatin1String("%message%"), htmlEncodedMessage);
-		
-		// Topic replacement (if applicable)
-		if (isTopic && inString.contains(QLatin1String("%topic%"))) {
-			inString.replace(QLatin1String("%topic%"),
-			                 QString::fromLatin1(TOPIC_INDIVIDUAL_WRAPPER).arg(htmlEncodedMessage));
-		}		
-	} else {
-		inString.replace(QLatin1String("%status%"), escapeString(message.property("status", QString())));
-		inString.replace(QLatin1String("%statusSender%"), QString());
-		inString.replace(QLatin1String("%senderScreenName%"), QString());
-		inString.replace(QLatin1String("%senderPrefix%"), QString());
-		inString.replace(QLatin1String("%sender%"), QString());
-		QString statusPhrase = message.property("statusPhrase", QString());
-		if (!statusPhrase.isEmpty() && inString.contains(QLatin1String("%statusPhrase%"))) {
-			inString.replace(QLatin1String("%statusPhrase%"), escapeString(statusPhrase));
-			replacedStatusPhrase = true;
+	QString result;
+	result.reserve(messageTemplate.literalSize + htmlEncodedMessage.size() * 2);
+	foreach (const WebKitTemplateToken &token, messageTemplate.tokens) {
+		switch (token.keyword) {
+		case LiteralKeyword:
+			result += token.text;
+			break;
+		case TimeKeyword:
+			result += convertTimeDate(d->timeStampFormatter, date);
+			break;
+		case TimeFormatKeyword:
+			result += convertTimeDate(token.text, date);
+			break;
+		case MessageIdKeyword:
+			result += QLatin1String("message");
+			result += messageId;
+			break;
+		case ShortTimeKeyword:
+			result += date.toString(Qt::SystemLocaleShortDate);
+			break;
+		case UserIconsKeyword:
+			result += QLatin1String(d->showUserIcons ? "showIcons" : "hideIcons");
+			break;
+		case MessageClassesKeyword:
+			if (contentIsSimilar)
+				result += QLatin1String("consecutive ");
+			result += displayClasses.join(QLatin1String(" "));
+			break;
+		case SenderColorKeyword:
+			result += WebKitColorsAdditions::representedColorForObject(contentSource.id, validSenderColors());
+			break;
+		case MessageDirectionKeyword:
+			result += QLatin1String(message.text().isRightToLeft() ? "rtl" : "ltr");
+			break;
+		case UserIconPathKeyword: {
+			QString userIconPath;
+			if (d->showUserIcons)
+				userIconPath = urlFromFilePath(theSource.avatar);
+			if (userIconPath.isEmpty())
+				userIconPath = QLatin1String(message.isIncoming() ? "Incoming/buddy_icon.png" : "Outgoing/buddy_icon.png");
+			result += userIconPath;
+			break;
+		}
+		case ServiceKeyword:
+			// Implement the way to get shortDescription and icon path for service icons
+			if (message.chatUnit())
+				result += escapeString(message.chatUnit()->account()->protocol()->id());
+			break;
+		case ServiceIconPathKeyword:
+			// content.chat->account.protocol.iconPath
+			break;
+		case VariantKeyword:
+			result += activeVariantPath();
+			break;
+		case StatusKeyword:
+			if (!isMessage)
+				result += escapeString(message.property("status", QString()));
+			break;
+		case StatusSenderKeyword:
+			if (isMessage)
+				result += token.text;
+			break;
+		case StatusPhraseKeyword:
+			if (statusPhrase.isEmpty())
+				result += token.text;
+			else
+				result += escapeString(statusPhrase);
+			break;
+		case SenderScreenNameKeyword:
+			if (isMessage)
+				result += escapeString(contentSource.id);
+			break;
+		case SenderPrefixKeyword:
+			// Should be used as %, @, + or something like irc's channel statuses
+			if (isMessage)
+				result += message.property("senderPrefix", QString());
+			break;
+		case SenderKeyword:
+			if (isMessage)
+				result += escapeString(senderDisplay);
+			break;
+		case SenderDisplayNameKeyword:
+			// Should be server-side display name if possible
+			if (isMessage)
+				result += escapeString(contentSource.title);
+			else
+				result += token.text;
+			break;
+		case MessageKeyword:
+			if (!replacedStatusPhrase)
+				result += htmlEncodedMessage;
+			break;
+		case TopicKeyword:
+			// Topic replacement (if applicable)
+			if (isTopic)
+				result += QString::fromLatin1(TOPIC_INDIVIDUAL_WRAPPER).arg(htmlEncodedMessage);
+			else
+				result += token.text;
+			break;
 		}
-		
-		//Message (must do last)
-		inString.replace(QLatin1String("%message%"), replacedStatusPhrase ? QString() : htmlEncodedMessage);
 	}
 
-    return inString;
+	return result;
 }
 
 QString WebKitMessageViewStyle::pathForResource(const QString &name, const QString &directory)
@@ -1165,6 +1359,19 @@ void WebKitMessageViewStyle::releaseResources()
 	d->actionHTML.clear();
 	d->actionInHTML.clear();
 	d->actionOutHTML.clear();
+	
+	d->topicTemplate.clear();
+	d->actionInTemplate.clear();
+	d->actionOutTemplate.clear();
+	d->contentInTemplate.clear();
+	d->nextContentInTemplate.clear();
+	d->contentOutTemplate.clear();
+	d->nextContentOutTemplate.clear();
+	d->contextInTemplate.clear();
+	d->nextContextInTemplate.clear();
+	d->contextOutTemplate.clear();
+	d->nextContextOutTemplate.clear();
+	d->statusTemplate.clear();
 		
 	d->customBackgroundPath.clear();
 	d->customBackgroundColor = QColor();
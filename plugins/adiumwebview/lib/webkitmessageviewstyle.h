@@ -41,6 +41,7 @@ class Message;
 }
 
 class WebKitMessageViewStylePrivate;
+class WebKitMessageTemplate;
 
 class ADIUMWEBVIEW_EXPORT WebKitMessageViewStyle : public QObject
 {
@@ -123,7 +124,7 @@ private:
 	void loadTemplates();
 	void releaseResources();
 	UnitData getSourceData(const qutim_sdk_0_3::Message &message);
-	QString &fillKeywords(QString &inString, const qutim_sdk_0_3::Message &message, bool contentIsSimilar);
+	QString fillKeywords(const WebKitMessageTemplate &messageTemplate, const qutim_sdk_0_3::Message &message, bool contentIsSimilar);
     QString &injectScript(QString &inString, const QString &id, const QString &wsUri);
 	QString &fillKeywordsForBaseTemplate(QString &inString, qutim_sdk_0_3::ChatSession *session);
 	QString stringWithFormat(const QString &str, const QStringList &args);
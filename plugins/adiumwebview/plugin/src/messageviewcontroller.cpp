@@ -62,10 +62,10 @@ bool MessageViewController::isContentSimiliar(const Message &a, const Message &b
 void MessageViewController::append(const qutim_sdk_0_3::Message &msg)
 {
     Message copy = msg;
-    QString html = UrlParser::parseUrls(copy.html(), UrlParser::Html);
     copy.setProperty("messageId", msg.id());
+    // Links and emoticons (except for topic) are parsed once per message
+    copy.setHtml(msg.formattedHtml());
     if (msg.property("topic", false)) {
-        copy.setHtml(html);
         m_topic = copy;
         if (!m_isLoading)
             updateTopic();
@@ -73,9 +73,6 @@ void MessageViewController::append(const qutim_sdk_0_3::Message &msg)
     }
     if (msg.property("firstFocus", false))
         clearFocusClass();
-    // We don't want emoticons in topic
-    html = Emoticons::theme().parseEmoticons(html);
-    copy.setHtml(html);
     bool similiar = isContentSimiliar(m_last, msg);
     QString script = m_style.scriptForAppendingContent(copy, similiar, false, false);
     m_last = msg;
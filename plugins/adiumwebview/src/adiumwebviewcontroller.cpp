@@ -97,7 +97,7 @@ void WebViewLoaderLoop::onPageDestroyed()
 Q_GLOBAL_STATIC(WebViewLoaderLoop, loaderLoop)
 
 WebViewController::WebViewController(bool isPreview) :
-    m_isLoading(false), m_isPreview(isPreview)
+    m_isLoading(false), m_isPreview(isPreview), m_historyPending(false), m_historyGeneration(0)
 {
     m_topic.setProperty("topic", true);
     setNetworkAccessManager(new WebKitNetworkAccessManager(this));
@@ -149,25 +149,44 @@ bool WebViewController::isContentSimiliar(const Message &a, const Message &b)
 
 void WebViewController::appendMessage(const qutim_sdk_0_3::Message &msg)
 {
+    QString script = scriptForMessage(msg, false);
+    if (!script.isEmpty())
+        evaluateJavaScript(script);
+}
+
+void WebViewController::appendMessages(const qutim_sdk_0_3::MessageList &messages)
+{
+    // Evaluate the whole batch at once and scroll only after the last message
+    QString script;
+    for (int i = 0; i < messages.size(); ++i)
+        script += scriptForMessage(messages.at(i), i + 1 < messages.size());
+    if (!script.isEmpty())
+        evaluateJavaScript(script);
+}
+
+QString WebViewController::scriptForMessage(const Message &msg, bool willAddMoreContentObjects)
+{
+    // History goes above messages received while it is being read
+    if (m_historyPending && !msg.property("history", false) && !msg.property("topic", false)) {
+        m_pendingMessages << msg;
+        return QString();
+    }
     Message copy = msg;
-    QString html = UrlParser::parseUrls(copy.html(), UrlParser::Html);
     copy.setProperty("messageId", msg.id());
+    // Links and emoticons (except for topic) are parsed once per message
+    copy.setHtml(msg.formattedHtml());
     if (msg.property("topic", false)) {
-        copy.setHtml(html);
         m_topic = copy;
         if (!m_isLoading)
             updateTopic();
-        return;
+        return QString();
     }
     if (msg.property("firstFocus", false))
         clearFocusClass();
-    // We don't want emoticons in topic
-    html = Emoticons::theme().parseEmoticons(html);
-    copy.setHtml(html);
     bool similiar = isContentSimiliar(m_last, msg);
-    QString script = m_style.scriptForAppendingContent(copy, similiar, false, false);
+    QString script = m_style.scriptForAppendingContent(copy, similiar, willAddMoreContentObjects, false);
     m_last = msg;
-    evaluateJavaScript(script);
+    return script;
 }
 
 void WebViewController::clearChat()
@@ -385,16 +404,29 @@ void WebViewController::onSettingsSaved()
 void WebViewController::loadHistory()
 {
     Config config = Config(QLatin1String("appearance")).group(QLatin1String("chat/history"));
-	int max_num = config.value(QLatin1String("maxDisplayMessages"), 5);
-    MessageList messages = History::instance()->readSync(m_session.data()->unit(), max_num);
-    foreach (Message mess, messages) {
-        mess.setProperty("silent", true);
-        mess.setProperty("store", false);
-        mess.setProperty("history", true);
-        if (!mess.chatUnit()) //TODO FIXME
-            mess.setChatUnit(m_session.data()->unit());
-        m_session.data()->append(mess);
-    }
+    int max_num = config.value(QLatin1String("maxDisplayMessages"), 5);
+    const int generation = ++m_historyGeneration;
+    m_historyPending = true;
+    m_pendingMessages.clear();
+    History::instance()->read(m_session.data()->unit(), max_num).connect(this, [this, generation] (const MessageList &result) {
+        if (generation != m_historyGeneration || !m_session)
+            return;
+        MessageList messages = result;
+        for (int i = 0; i < messages.size(); ++i) {
+            Message &mess = messages[i];
+            mess.setProperty("silent", true);
+            mess.setProperty("store", false);
+            mess.setProperty("history", true);
+            if (!mess.chatUnit()) //TODO FIXME
+                mess.setChatUnit(m_session.data()->unit());
+        }
+        m_session.data()->append(messages);
+        m_historyPending = false;
+        MessageList pending;
+        qSwap(pending, m_pendingMessages);
+        if (!pending.isEmpty())
+            appendMessages(pending);
+    });
 }
 
 void WebViewController::onLoadFinished()
@@ -69,6 +69,7 @@ public:
 	virtual void setChatSession(qutim_sdk_0_3::ChatSession *session);
 	virtual qutim_sdk_0_3::ChatSession *getSession() const;
 	virtual void appendMessage(const qutim_sdk_0_3::Message &msg);
+	virtual void appendMessages(const qutim_sdk_0_3::MessageList &messages);
 	virtual void clearChat();
 	virtual QString quote();
 	WebKitMessageViewStyle *style();
@@ -89,6 +90,7 @@ public slots:
 protected:
 	void clearFocusClass();
 	bool isContentSimiliar(const qutim_sdk_0_3::Message &a, const qutim_sdk_0_3::Message &b);
+	QString scriptForMessage(const qutim_sdk_0_3::Message &msg, bool willAddMoreContentObjects);
 	void loadSettings(bool onFly);
 	void loadHistory();
 	
@@ -110,6 +112,10 @@ private:
 	QStringList m_pendingScripts;
 	qutim_sdk_0_3::Message m_last;
 	qutim_sdk_0_3::Message m_topic;
+	// Messages appended while history is being read
+	qutim_sdk_0_3::MessageList m_pendingMessages;
+	bool m_historyPending;
+	int m_historyGeneration;
 };
 
 } // namespace Adium
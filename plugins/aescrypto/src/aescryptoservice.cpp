@@ -29,6 +29,11 @@
 namespace AesCrypto
 {
 
+	// Values are stored as independent CBC messages of 15 bytes each, so every
+	// block of them is AES(piece + padding ^ iv) and all of them can be processed
+	// by single ECB pass without key setup per piece
+	enum { PieceSize = 15, BlockSize = 16 };
+
 	AesCryptoService::AesCryptoService()
 	{
 		static QCA::Initializer qca_init;
@@ -39,13 +44,154 @@ namespace AesCrypto
 								   "a54d2bb6f0d24fbfbb3c58a977edc50f");
 		m_cipher_enc = 0;
 		m_cipher_dec = 0;
+		m_ecb_enc = 0;
+		m_ecb_dec = 0;
+	}
+
+	AesCryptoService::~AesCryptoService()
+	{
+		delete m_cipher_enc;
+		delete m_cipher_dec;
+		delete m_ecb_enc;
+		delete m_ecb_dec;
 	}
 
 	QVariant AesCryptoService::cryptImpl(const QVariant &valueVar) const
 	{
 		QByteArray value = dataFromVariant(valueVar);
+		// Ciphers are replaced by setPassword, so they are checked under the lock
+		QMutexLocker locker(&m_mutex);
 		if(!m_cipher_enc)
 			return value;
+		return cryptData(value);
+	}
+
+	QVariant AesCryptoService::decryptImpl(const QVariant &valueVar) const
+	{
+		QMutexLocker locker(&m_mutex);
+		if(!m_cipher_dec)
+			return variantFromData(valueVar.toByteArray());
+		bool ok;
+		QByteArray result = decryptData(valueVar.toByteArray(), &ok);
+		return ok ? variantFromData(result) : QVariant(result);
+	}
+
+	QVariantList AesCryptoService::cryptListImpl(const QVariantList &values) const
+	{
+		QVariantList result;
+		result.reserve(values.size());
+		// Pieces never cross borders of values, so they are padded one by one
+		QByteArray padded;
+		QVector<int> sizes;
+		sizes.reserve(values.size());
+		foreach (const QVariant &value, values) {
+			const QByteArray bytes = dataFromVariant(value);
+			sizes << bytes.size();
+			padded += pad(bytes.constData(), bytes.size());
+		}
+		QByteArray blocks;
+		{
+			QMutexLocker locker(&m_mutex);
+			if (!m_ecb_enc) {
+				locker.unlock();
+				foreach (const QVariant &value, values)
+					result << cryptImpl(value);
+				return result;
+			}
+			blocks = cryptBlocks(padded);
+		}
+		int offset = 0;
+		foreach (int size, sizes) {
+			const int length = (size + PieceSize - 1) / PieceSize * BlockSize;
+			result << QVariant(blocks.mid(offset, length));
+			offset += length;
+		}
+		return result;
+	}
+
+	QVariantList AesCryptoService::decryptListImpl(const QVariantList &values) const
+	{
+		QVariantList result;
+		result.reserve(values.size());
+		QByteArray data;
+		foreach (const QVariant &value, values) {
+			const QByteArray bytes = value.toByteArray();
+			// Broken values are left for the generic path
+			if (bytes.size() % BlockSize == 0)
+				data += bytes;
+		}
+		QByteArray plain;
+		{
+			QMutexLocker locker(&m_mutex);
+			if (!m_ecb_dec) {
+				locker.unlock();
+				foreach (const QVariant &value, values)
+					result << decryptImpl(value);
+				return result;
+			}
+			plain = decryptBlocks(data, 0);
+		}
+		int offset = 0;
+		foreach (const QVariant &value, values) {
+			const QByteArray bytes = value.toByteArray();
+			if (bytes.size() % BlockSize != 0) {
+				result << decryptImpl(value);
+				continue;
+			}
+			bool ok = !plain.isEmpty() || bytes.isEmpty();
+			QByteArray piece = ok ? unpad(plain.constData() + offset, bytes.size(), &ok) : QByteArray();
+			offset += bytes.size();
+			result << (ok ? variantFromData(piece) : QVariant(piece));
+		}
+		return result;
+	}
+
+	QByteArray AesCryptoService::pad(const char *data, int size) const
+	{
+		const QByteArray iv = m_iv.toByteArray();
+		QByteArray result;
+		result.reserve((size + PieceSize - 1) / PieceSize * BlockSize);
+		for (int i = 0; i < size; i += PieceSize) {
+			const int length = qMin(int(PieceSize), size - i);
+			const char padding = char(BlockSize - length);
+			for (int j = 0; j < BlockSize; ++j) {
+				const char c = j < length ? data[i + j] : padding;
+				result += char(c ^ iv.at(j));
+			}
+		}
+		return result;
+	}
+
+	QByteArray AesCryptoService::unpad(const char *data, int size, bool *ok) const
+	{
+		const QByteArray iv = m_iv.toByteArray();
+		QByteArray result;
+		result.reserve(size / BlockSize * PieceSize);
+		for (int i = 0; i < size; i += BlockSize) {
+			char block[BlockSize];
+			for (int j = 0; j < BlockSize; ++j)
+				block[j] = data[i + j] ^ iv.at(j);
+			const int padding = uchar(block[BlockSize - 1]);
+			if (padding < 1 || padding > BlockSize) {
+				*ok = false;
+				return result;
+			}
+			for (int j = BlockSize - padding; j < BlockSize; ++j) {
+				if (uchar(block[j]) != padding) {
+					*ok = false;
+					return result;
+				}
+			}
+			result.append(block, BlockSize - padding);
+		}
+		*ok = true;
+		return result;
+	}
+
+	QByteArray AesCryptoService::cryptData(const QByteArray &value) const
+	{
+		if (m_ecb_enc)
+			return cryptBlocks(pad(value.constData(), value.size()));
 		QByteArray result;
 		for(int i = 0x0; i < value.size(); i += 0xf)
 		{
@@ -59,39 +205,83 @@ namespace AesCrypto
 		return result;
 	}
 
-	QVariant AesCryptoService::decryptImpl(const QVariant &valueVar) const
+	QByteArray AesCryptoService::decryptData(const QByteArray &value, bool *ok) const
 	{
-		if(!m_cipher_dec)
-			return variantFromData(valueVar.toByteArray());
-//		qDebug() << m_cipher_enc->blockSize() << m_cipher_enc->keyLength().minimum() << m_cipher_enc->keyLength().maximum();
-		QByteArray value = valueVar.toByteArray();
+		if (m_ecb_dec && value.size() % BlockSize == 0) {
+			const QByteArray blocks = decryptBlocks(value, ok);
+			if (!*ok)
+				return QByteArray();
+			return unpad(blocks.constData(), blocks.size(), ok);
+		}
 		QByteArray result;
 		for(int i = 0x0; i < value.size(); i += 0x10)
 		{
 			m_cipher_dec->clear();
 			QCA::SecureArray arg = value.mid(i, 0x10);
 			m_cipher_dec->update(arg);
-			if(!m_cipher_dec->ok())
+			if(!m_cipher_dec->ok()) {
+				*ok = false;
 				return result;
+			}
 			result += m_cipher_dec->final().toByteArray();
 		}
-		return variantFromData(result);
+		*ok = true;
+		return result;
+	}
+
+	QByteArray AesCryptoService::cryptBlocks(const QByteArray &value) const
+	{
+		if (value.isEmpty())
+			return value;
+		QByteArray result = m_ecb_enc->update(value).toByteArray();
+		return m_ecb_enc->ok() ? result : QByteArray();
+	}
+
+	QByteArray AesCryptoService::decryptBlocks(const QByteArray &value, bool *ok) const
+	{
+		if (value.isEmpty()) {
+			if (ok)
+				*ok = true;
+			return value;
+		}
+		QByteArray result = m_ecb_dec->update(value).toByteArray();
+		const bool success = m_ecb_dec->ok() && result.size() == value.size();
+		if (ok)
+			*ok = success;
+		return success ? result : QByteArray();
 	}
 
 	void AesCryptoService::setPassword(const QString &password, const QVariant &data)
 	{
 		Q_UNUSED(data);
+		QMutexLocker locker(&m_mutex);
 		// Pass in utf-8
 		QByteArray pass = password.toUtf8();
 		// 64 bit sault
 		pass += QByteArray::fromHex("5b225931d924bb30");
 		m_key = QCA::Hash("sha256").hash(pass).toByteArray();
+		delete m_cipher_enc;
+		delete m_cipher_dec;
+		delete m_ecb_enc;
+		delete m_ecb_dec;
 		m_cipher_enc = new QCA::Cipher(QString("aes256"),QCA::Cipher::CBC,
 									   QCA::Cipher::DefaultPadding,
 									   QCA::Encode, m_key, m_iv);
 		m_cipher_dec = new QCA::Cipher(QString("aes256"),QCA::Cipher::CBC,
 									   QCA::Cipher::DefaultPadding,
 									   QCA::Decode, m_key, m_iv);
+		// The provider (OpenSSL usually) uses AES-NI or ARMv8 instructions by itself
+		if (QCA::isSupported("aes256-ecb")) {
+			m_ecb_enc = new QCA::Cipher(QString("aes256"), QCA::Cipher::ECB,
+										QCA::Cipher::NoPadding,
+										QCA::Encode, m_key);
+			m_ecb_dec = new QCA::Cipher(QString("aes256"), QCA::Cipher::ECB,
+										QCA::Cipher::NoPadding,
+										QCA::Decode, m_key);
+		} else {
+			m_ecb_enc = 0;
+			m_ecb_dec = 0;
+		}
 	}
 
 	QVariant AesCryptoService::generateData(const QString &profile) const
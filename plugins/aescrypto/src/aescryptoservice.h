@@ -27,6 +27,8 @@
 
 #include <qutim/cryptoservice.h>
 #include <QtCrypto>
+#include <QMutex>
+#include <QVector>
 
 using namespace qutim_sdk_0_3;
 
@@ -37,16 +39,29 @@ namespace AesCrypto
 		Q_OBJECT
 	public:
 		AesCryptoService();
+		~AesCryptoService();
 	protected:
 		virtual QVariant cryptImpl(const QVariant &value) const;
 		virtual QVariant decryptImpl(const QVariant &value) const;
+		virtual QVariantList cryptListImpl(const QVariantList &values) const;
+		virtual QVariantList decryptListImpl(const QVariantList &values) const;
 		virtual void setPassword(const QString &password, const QVariant &data);
 		virtual QVariant generateData(const QString &profile) const;
 	private:
+		QByteArray pad(const char *data, int size) const;
+		QByteArray unpad(const char *data, int size, bool *ok) const;
+		QByteArray cryptData(const QByteArray &value) const;
+		QByteArray decryptData(const QByteArray &value, bool *ok) const;
+		QByteArray cryptBlocks(const QByteArray &value) const;
+		QByteArray decryptBlocks(const QByteArray &value, bool *ok) const;
 		QCA::SymmetricKey m_key;
 		QCA::InitializationVector m_iv;
 		QCA::Cipher *m_cipher_enc;
 		QCA::Cipher *m_cipher_dec;
+		// Stateless ciphers with expanded key, created once per password
+		QCA::Cipher *m_ecb_enc;
+		QCA::Cipher *m_ecb_dec;
+		mutable QMutex m_mutex;
 	};
 }
 
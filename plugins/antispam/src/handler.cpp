@@ -27,6 +27,7 @@
 #include "handler.h"
 #include "settingswidget.h"
 #include <qutim/contact.h>
+#include <qutim/account.h>
 #include <qutim/config.h>
 #include <qutim/authorizationdialog.h>
 #include <qutim/notification.h>
@@ -38,29 +39,34 @@ namespace Antispam {
 using namespace qutim_sdk_0_3;
 using namespace Authorization;
 
-#define ANTISPAM_PROPERTY "antispamInfo"
+// Question is not repeated to the same sender more often
+static const qint64 QuestionInterval = 5 * 60;
 
-struct Info
+Handler::Handler() : m_authorization("AuthorizationService")
 {
-	typedef QSharedPointer<Info> Ptr;
-	
-	Info() : trusted(false) {}
-	
-	bool trusted;
-	QDateTime lastQuestionTime;
-};
-
+	connect(ServiceManager::instance(), SIGNAL(serviceChanged(QByteArray,QObject*,QObject*)),
+	        SLOT(onServiceChanged(QByteArray)));
+	loadSettings();
 }
 
-Q_DECLARE_METATYPE(Antispam::Info::Ptr)
+Handler::~Handler()
+{
+	qDeleteAll(m_caches);
+}
 
-namespace Antispam {
+SenderCache *Handler::cache(Account *account)
+{
+	SenderCache *&cache = m_caches[account];
+	if (!cache) {
+		cache = new SenderCache;
+		connect(account, SIGNAL(destroyed(QObject*)), SLOT(onAccountDestroyed(QObject*)));
+	}
+	return cache;
+}
 
-Handler::Handler() : m_authorization("AuthorizationService")
+void Handler::onAccountDestroyed(QObject *account)
 {
-	connect(ServiceManager::instance(), SIGNAL(serviceChanged(QByteArray,QObject*,QObject*)),
-	        SLOT(onServiceChanged(QByteArray)));
-	loadSettings();
+	delete m_caches.take(account);
 }
 
 void Handler::loadSettings()
@@ -82,31 +88,27 @@ void Handler::loadSettings()
 }
 
 
-MessageHandlerAsyncResult Handler::doHandle(Message &message)
+MessageHandler::Result Handler::doHandleSync(Message &message, QString *reason)
 {
 	if (!m_enabled || message.property("service", false)) {
-		return makeAsyncResult(Accept, QString());
+		return Accept;
     }
 
 	Contact *contact = qobject_cast<Contact*>(message.chatUnit()->buddy());
 	if (!contact || contact->isInList()) {
-		return makeAsyncResult(Accept, QString());
+		return Accept;
     }
 	
-	Info::Ptr info = contact->property(ANTISPAM_PROPERTY).value<Info::Ptr>();
-	if (info.isNull()) {
-		info = Info::Ptr::create();
-		contact->setProperty(ANTISPAM_PROPERTY, qVariantFromValue(info));
-	}
-	
-	if (info->trusted) {
-		return makeAsyncResult(Accept, QString());
+	SenderCache *senders = cache(contact->account());
+	const QString id = contact->id();
+	if (senders->isTrusted(id)) {
+		return Accept;
     }
 	
 	if (!message.isIncoming()) {
 		if (!message.property("autoreply", false))
-			info->trusted = true;
-		return makeAsyncResult(Accept, QString());
+			senders->trust(id);
+		return Accept;
 	}
 
 	//check message body
@@ -115,24 +117,25 @@ MessageHandlerAsyncResult Handler::doHandle(Message &message)
 			Message message(m_success);
 			message.setChatUnit(contact);
 			contact->sendMessage(message);
-			info->trusted = true;
-			return makeAsyncResult(Accept, QString());
+			senders->trust(id);
+			return Accept;
 		}
 	}
 
-	if (info->lastQuestionTime.isValid()
-	        && qAbs(info->lastQuestionTime.secsTo(QDateTime::currentDateTime())) < 5 * 60) {
-		return makeAsyncResult(Reject, QString());
+	const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+	const qint64 lastQuestion = senders->lastQuestion(id);
+	if (lastQuestion && qAbs(now - lastQuestion) < QuestionInterval) {
+		return Reject;
 	}
 	Message replyMessage(m_question);
 	replyMessage.setChatUnit(contact);
 	replyMessage.setProperty("autoreply", true);
 	contact->sendMessage(replyMessage);
-	info->lastQuestionTime = QDateTime::currentDateTime();
-	QString reason = tr("Message from %1 blocked on suspicion of spam.").
+	senders->setLastQuestion(id, now);
+	*reason = tr("Message from %1 blocked on suspicion of spam.").
 				   arg(contact->title());
 
-	return makeAsyncResult(Error, reason);
+	return Error;
 }
 
 bool Handler::eventFilter(QObject *obj, QEvent *event)
@@ -145,19 +148,15 @@ bool Handler::eventFilter(QObject *obj, QEvent *event)
 			pseudoMessage.setChatUnit(reply->contact());
 			pseudoMessage.setIncoming(false);
 
-            bool accepted = true;
-
-			doHandle(pseudoMessage).connect(this, [&accepted, reply] (Result result, const QString &reason) {
-                if (Error == result) {
-                    NotificationRequest request(Notification::BlockedMessage);
-                    request.setObject(reply->contact());
-                    request.setText(reason);
-                    request.send();
-                }
-                accepted = (result == Accept);
-            });
+			Result result = doHandleSync(pseudoMessage, &reason);
+			if (Error == result) {
+				NotificationRequest request(Notification::BlockedMessage);
+				request.setObject(reply->contact());
+				request.setText(reason);
+				request.send();
+			}
 
-			if (accepted)
+			if (result == Accept)
 				return true;
 		}
 	}
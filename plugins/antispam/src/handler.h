@@ -29,8 +29,13 @@
 
 #include <qutim/messagehandler.h>
 #include <qutim/servicemanager.h>
+#include "sendercache.h"
 #include <QStringList>
 
+namespace qutim_sdk_0_3 {
+class Account;
+}
+
 namespace Antispam {
 
 class Handler : public QObject, public qutim_sdk_0_3::MessageHandler
@@ -38,24 +43,29 @@ class Handler : public QObject, public qutim_sdk_0_3::MessageHandler
 	Q_OBJECT
 public:
     explicit Handler();
+	~Handler();
 
 public slots:
 	void loadSettings();
 
 protected:
 	bool eventFilter(QObject *obj, QEvent *event);
-	qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
+	Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason) override;
 
 protected slots:
 	void onServiceChanged(const QByteArray &name);
+	void onAccountDestroyed(QObject *account);
 
 private:
+	SenderCache *cache(qutim_sdk_0_3::Account *account);
+
 	bool m_enabled;
 	bool m_handleAuth;
 	QString m_question;
 	QString m_success;
 	QStringList m_answers;
 	qutim_sdk_0_3::ServicePointer<QObject> m_authorization;
+	QHash<QObject*, SenderCache*> m_caches;
 };
 
 } // namespace Antispam
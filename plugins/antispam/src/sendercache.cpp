@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "sendercache.h"
+#include <QHash>
+#include <string.h>
+
+namespace Antispam {
+
+SenderCache::SenderCache()
+	: m_bloom(BloomBits), m_bloomCount(0), m_trusted(MaxTrusted)
+{
+	memset(m_challenges, 0, sizeof(m_challenges));
+}
+
+bool SenderCache::isTrusted(const QString &id)
+{
+	// Bloom filter has false positives only, so exact ids are checked too
+	return testBloom(hash(id)) && m_trusted.object(id);
+}
+
+void SenderCache::trust(const QString &id)
+{
+	m_trusted.insert(id, new bool(true));
+	// Rebuild filter when evicted ids start to add noticeable noise
+	if (++m_bloomCount > 2 * MaxTrusted) {
+		m_bloom.fill(false);
+		m_bloomCount = 0;
+		foreach (const QString &trusted, m_trusted.keys()) {
+			addToBloom(hash(trusted));
+			++m_bloomCount;
+		}
+	} else {
+		addToBloom(hash(id));
+	}
+}
+
+qint64 SenderCache::lastQuestion(const QString &id) const
+{
+	const quint64 key = hash(id);
+	const int slot = challengeSlot(key);
+	return m_challenges[slot].hash == key ? m_challenges[slot].time : 0;
+}
+
+void SenderCache::setLastQuestion(const QString &id, qint64 time)
+{
+	const quint64 key = hash(id);
+	Challenge &challenge = m_challenges[challengeSlot(key)];
+	challenge.hash = key;
+	challenge.time = time;
+}
+
+quint64 SenderCache::hash(const QString &id)
+{
+	return (quint64(qHash(id, 0x9e3779b9u)) << 32) | qHash(id, 0x85ebca6bu);
+}
+
+void SenderCache::addToBloom(quint64 hash)
+{
+	const uint step = uint(hash >> 32) | 1;
+	uint bit = uint(hash);
+	for (int i = 0; i < BloomHashes; ++i, bit += step)
+		m_bloom.setBit(bit & (BloomBits - 1));
+}
+
+bool SenderCache::testBloom(quint64 hash) const
+{
+	const uint step = uint(hash >> 32) | 1;
+	uint bit = uint(hash);
+	for (int i = 0; i < BloomHashes; ++i, bit += step) {
+		if (!m_bloom.testBit(bit & (BloomBits - 1)))
+			return false;
+	}
+	return true;
+}
+
+int SenderCache::challengeSlot(quint64 hash) const
+{
+	// Two candidate slots, the one of this sender or the oldest one is used
+	const int first = int(hash % ChallengeSlots);
+	const int second = int((hash >> 32) % ChallengeSlots);
+	if (m_challenges[first].hash == hash)
+		return first;
+	if (m_challenges[second].hash == hash)
+		return second;
+	return m_challenges[first].time <= m_challenges[second].time ? first : second;
+}
+
+} // namespace Antispam
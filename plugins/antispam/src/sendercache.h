@@ -0,0 +1,78 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef ANTISPAM_SENDERCACHE_H
+#define ANTISPAM_SENDERCACHE_H
+
+#include <QBitArray>
+#include <QCache>
+#include <QString>
+
+namespace Antispam {
+
+// Per-account state of senders which are not in contact list. Senders
+// which passed the check are remembered by bloom filter backed by LRU
+// of their ids, so most of unknown ones are rejected by a few bit tests.
+// Times of questions live in fixed-size table, so spam wave from
+// thousands of senders doesn't grow memory usage.
+class SenderCache
+{
+public:
+	SenderCache();
+
+	bool isTrusted(const QString &id);
+	void trust(const QString &id);
+
+	// Seconds since epoch of the last question sent to id or 0
+	qint64 lastQuestion(const QString &id) const;
+	void setLastQuestion(const QString &id, qint64 time);
+
+private:
+	enum {
+		BloomBits = 1 << 16,
+		BloomHashes = 4,
+		MaxTrusted = 4096,
+		ChallengeSlots = 1024
+	};
+	struct Challenge
+	{
+		quint64 hash;
+		qint64 time;
+	};
+
+	static quint64 hash(const QString &id);
+	void addToBloom(quint64 hash);
+	bool testBloom(quint64 hash) const;
+	int challengeSlot(quint64 hash) const;
+
+	QBitArray m_bloom;
+	int m_bloomCount;
+	QCache<QString, bool> m_trusted;
+	Challenge m_challenges[ChallengeSlots];
+};
+
+} // namespace Antispam
+
+#endif // ANTISPAM_SENDERCACHE_H
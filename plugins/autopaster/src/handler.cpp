@@ -36,10 +36,23 @@
 #include <qutim/config.h>
 #include <qutim/chatsession.h>
 #include <qutim/json.h>
+#include <qutim/networkaccess.h>
 
 using namespace qutim_sdk_0_3;
 
+// Stops at \a count lines, so huge pastes aren't scanned up to the end
+static bool hasLines(const QString &text, int count)
+{
+	int lines = 1;
+	for (const QChar *it = text.constData(), *end = it + text.size(); lines < count && it != end; ++it) {
+		if (*it == QLatin1Char('\n'))
+			++lines;
+	}
+	return lines >= count;
+}
+
 AutoPasterHandler::AutoPasterHandler() :
+	m_activeUploads(0),
 	m_dialog(QStringLiteral("autopaster")),
 	m_settings(QStringLiteral("autopaster"),
 			   Settings::Plugin,
@@ -123,7 +136,15 @@ MessageHandlerAsyncResult AutoPasterHandler::doHandle(Message &message)
 	if (!message.isIncoming()
 			&& !message.property("service", false)
 			&& !message.property("history", false)
-			&& message.text().count('\n') + 1 >= m_lineCount) {
+			&& hasLines(message.text(), m_lineCount)) {
+
+		// Reject early instead of making several copies of multi-MB text
+		// only to be refused by the paste service
+		if (m_maxSize > 0 && message.text().size() > m_maxSize) {
+			return makeAsyncResult(Error, QCoreApplication::translate(
+									   "AutoPaster",
+									   "Message is too large to be sent to paste service"));
+		}
 
 		QueueItem item = {
 			MessageHandlerAsyncResult::Handler(),
@@ -156,37 +177,61 @@ void AutoPasterHandler::readSettings()
 	m_autoSubmit = cfg.value(QLatin1String("autoSubmit"), false);
 	m_defaultLocation = qBound(0, cfg.value(QLatin1String("defaultLocation"), 0), m_pasters.size() - 1);
 	m_lineCount = cfg.value(QLatin1String("lineCount"), 5);
+	m_maxUploads = qMax(1, cfg.value(QLatin1String("maxUploads"), 2));
+	// In characters, zero disables the limit
+	m_maxSize = cfg.value(QLatin1String("maxSize"), 4 * 1024 * 1024);
 
 	emit currentPasterIndexChanged(m_defaultLocation);
 }
 
 void AutoPasterHandler::upload(QueueItem item, PasterInterface *paster, const QString &syntax)
 {
-	QNetworkReply *reply = paster->send(&m_manager, item.message->text(), syntax);
+	Upload upload = { item, paster, syntax };
+	m_uploads << upload;
+	startUploads();
+}
+
+void AutoPasterHandler::startUploads()
+{
+	// All uploads go through the shared manager, so they reuse its
+	// connections to the paste services
+	while (m_activeUploads < m_maxUploads && !m_uploads.isEmpty()) {
+		const Upload upload = m_uploads.takeFirst();
+		QNetworkReply *reply = upload.paster->send(NetworkAccess::manager(), upload.item.message->text(), upload.syntax);
+		++m_activeUploads;
+
+		connect(reply, &QNetworkReply::finished, this, [this, upload, reply] () {
+			finishUpload(upload, reply);
+		});
+	}
+}
 
-	connect(reply, &QNetworkReply::finished, this, [item, paster, reply] () {
-		reply->deleteLater();
+void AutoPasterHandler::finishUpload(const Upload &upload, QNetworkReply *reply)
+{
+	reply->deleteLater();
+	--m_activeUploads;
 
-		QString errorString;
+	QString errorString;
 
-		if (reply->error() == QNetworkReply::NoError) {
-			QString url = paster->handle(reply, &errorString).toString();
+	if (reply->error() == QNetworkReply::NoError) {
+		QString url = upload.paster->handle(reply, &errorString).toString();
 
-			if (errorString.isEmpty()) {
-				item.message->setText(url);
-				item.handler.handle(Accept, QString());
-				return;
-			}
-		} else {
-			errorString = reply->errorString();
+		if (errorString.isEmpty()) {
+			upload.item.message->setText(url);
+			upload.item.handler.handle(Accept, QString());
+			startUploads();
+			return;
 		}
+	} else {
+		errorString = reply->errorString();
+	}
 
-		const QString reason = QCoreApplication::translate(
-								   "AutoPaster",
-								   "Failed to send message to paste service, service reported error: %1")
-							   .arg(errorString);
-		item.handler.handle(Error, reason);
-	});
+	const QString reason = QCoreApplication::translate(
+							   "AutoPaster",
+							   "Failed to send message to paste service, service reported error: %1")
+						   .arg(errorString);
+	upload.item.handler.handle(Error, reason);
+	startUploads();
 }
 
 void AutoPasterHandler::upload(const QString &pasterName, const QString &syntax)
@@ -73,13 +73,26 @@ private:
 		qutim_sdk_0_3::Message *message;
 	};
 
+	struct Upload
+	{
+		QueueItem item;
+		PasterInterface *paster;
+		QString syntax;
+	};
+
 	void upload(QueueItem item, PasterInterface *paster, const QString &syntax);
+	void startUploads();
+	void finishUpload(const Upload &upload, QNetworkReply *reply);
 
-	QNetworkAccessManager m_manager;
 	qutim_sdk_0_3::QuickDialog m_dialog;
 	qutim_sdk_0_3::QmlSettingsItem m_settings;
 	QList<PasterInterface*> m_pasters;
 	QQueue<QueueItem> m_queue;
+	// Uploads waiting for a free slot, at most m_maxUploads run at once
+	QQueue<Upload> m_uploads;
+	int m_activeUploads;
+	int m_maxUploads;
+	int m_maxSize;
 
 	bool m_autoSubmit;
 	int m_lineCount;
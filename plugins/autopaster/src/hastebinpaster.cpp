@@ -1,5 +1,6 @@
 #include "hastebinpaster.h"
 #include <qutim/json.h>
+#include <qutim/networkaccess.h>
 
 using namespace qutim_sdk_0_3;
 
@@ -15,7 +16,7 @@ QString HastebinPaster::name()
 QNetworkReply *HastebinPaster::send(QNetworkAccessManager *manager, const QString &content, const QString &syntax)
 {
 	Q_UNUSED(syntax);
-	QNetworkRequest request(QUrl(QLatin1String("http://hastebin.com/documents")));
+	QNetworkRequest request = NetworkAccess::request(QUrl(QLatin1String("http://hastebin.com/documents")));
 	request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
 	return manager->post(request, content.toUtf8());
 }
@@ -1,6 +1,7 @@
 #include "kdepaster.h"
 #include <qutim/json.h>
-#include <QUrlQuery>
+#include <qutim/networkaccess.h>
+#include <QUrl>
 
 using namespace qutim_sdk_0_3;
 
@@ -15,15 +16,15 @@ QString KdePaster::name()
 
 QNetworkReply *KdePaster::send(QNetworkAccessManager *manager, const QString &content, const QString &syntax)
 {
-	QNetworkRequest request(QUrl(QStringLiteral("http://paste.kde.org/api/json/create")));
+	QNetworkRequest request = NetworkAccess::request(QUrl(QStringLiteral("http://paste.kde.org/api/json/create")));
 	request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/x-www-form-urlencoded"));
 
-    QUrlQuery data;
-	data.addQueryItem(QStringLiteral("data"), content);
-	data.addQueryItem(QStringLiteral("language"), syntax);
-	data.addQueryItem(QStringLiteral("private"), QStringLiteral("true"));
+	// Encode the body directly, QUrlQuery keeps a few more copies of the content
+	QByteArray data = "data=" + QUrl::toPercentEncoding(content);
+	data += "&language=" + QUrl::toPercentEncoding(syntax);
+	data += "&private=true";
 
-	return manager->post(request, data.query(QUrl::FullyEncoded).toLatin1());
+	return manager->post(request, data);
 }
 
 QUrl KdePaster::handle(QNetworkReply *reply, QString *error)
@@ -1,5 +1,8 @@
 #include "ubuntupaster.h"
 #include <QHttpMultiPart>
+#include <qutim/networkaccess.h>
+
+using namespace qutim_sdk_0_3;
 
 UbuntuPaster::UbuntuPaster()
 {
@@ -17,7 +20,7 @@ QNetworkReply *UbuntuPaster::send(QNetworkAccessManager *manager, const QString
 	appendPart(multi, "syntax", syntax.toUtf8());
 	appendPart(multi, "content", content.toUtf8());
 
-	QNetworkRequest request(QUrl(QLatin1String("http://paste.ubuntu.com")));
+	QNetworkRequest request = NetworkAccess::request(QUrl(QLatin1String("http://paste.ubuntu.com")));
 	QNetworkReply *reply = manager->post(request, multi);
 	multi->setParent(reply);
 	return reply;
@@ -103,12 +103,13 @@ void AutoReplyMessageHandler::updateText(QString &text, const QDateTime &backTim
 	}
 }
 
-MessageHandlerAsyncResult AutoReplyMessageHandler::doHandle(Message &message)
+MessageHandler::Result AutoReplyMessageHandler::doHandleSync(Message &message, QString *reason)
 {
+	Q_UNUSED(reason);
 	if (message.property("service", false)
 			|| message.property("autoreply", false)
 			|| qobject_cast<Conference*>(message.chatUnit())) {
-		return makeAsyncResult(Accept, QString());
+		return Accept;
 	}
 	QMutableListIterator<CacheItem> it(m_cache);
 	while (it.hasNext()) {
@@ -116,7 +117,7 @@ MessageHandlerAsyncResult AutoReplyMessageHandler::doHandle(Message &message)
         if (item.time.secsTo(QDateTime::currentDateTime()) > m_plugin->deltaTime()) {
 			it.remove();
 		} else if (item.unit == message.chatUnit()) {
-			return makeAsyncResult(Accept, QString());
+			return Accept;
         }
 	}
     if (message.isIncoming() && m_plugin->isActive() && !m_plugin->replyText().isEmpty()) {
@@ -130,5 +131,5 @@ MessageHandlerAsyncResult AutoReplyMessageHandler::doHandle(Message &message)
 		m_cache << cacheItem;
 		qApp->postEvent(m_plugin, new AutoReplyMessageEvent(replyMessage));
     }
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
@@ -60,8 +60,10 @@ void AutoReplyPlugin::onSettingsChanged()
 		if (!message.isEmpty())
 			setReplyText(message);
 	} else if (!m_button) {
-		if (m_idleManager)
+		if (m_idleManager) {
 			QObject::disconnect(m_idleManager.data(), 0, this, 0);
+			setIdleThresholds(QList<int>());
+		}
 		m_button.reset(new AutoReplyButtonGenerator(this));
 		if (form) {
 			QMetaObject::invokeMethod(form, "addAction",
@@ -82,8 +84,10 @@ bool AutoReplyPlugin::unload()
 		m_settingsItem.reset();
 		m_handler.reset(0);
 		setReplyText(QString());
-		if (m_idleManager)
+		if (m_idleManager) {
 			QObject::disconnect(m_idleManager.data(), 0, this, 0);
+			setIdleThresholds(QList<int>());
+		}
 		m_button.reset(0);
 	}
 	return true;
@@ -148,8 +152,18 @@ void AutoReplyPlugin::onServiceChanged(const QByteArray &name)
 {
 	if (name != "Idle")
 		return;
-	if (m_idleManager)
-		connect(m_idleManager.data(), SIGNAL(secondsIdle(int)), SLOT(onSecondsIdle(int)));
+	if (m_idleManager) {
+		connect(m_idleManager.data(), SIGNAL(secondsIdle(int)), SLOT(onSecondsIdle(int)),
+		        Qt::UniqueConnection);
+		setIdleThresholds(QList<int>() << m_idleTimeOut);
+	}
+}
+
+void AutoReplyPlugin::setIdleThresholds(const QList<int> &thresholds)
+{
+	// Idle service checks idle time only around thresholds of its watchers
+	QMetaObject::invokeMethod(m_idleManager.data(), "setThresholds",
+	                          Q_ARG(QObject*, this), Q_ARG(QList<int>, thresholds));
 }
 
 void AutoReplyPlugin::onActionToggled(bool active)
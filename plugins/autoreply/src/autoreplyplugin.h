@@ -47,6 +47,8 @@ private slots:
 	void onServiceChanged(const QByteArray &name);
 
 private:
+	void setIdleThresholds(const QList<int> &thresholds);
+
 	QScopedPointer<AutoReplyMessageHandler> m_handler;
 	QScopedPointer<qutim_sdk_0_3::SettingsItem> m_settingsItem;
 	qutim_sdk_0_3::ServicePointer<QObject> m_idleManager;
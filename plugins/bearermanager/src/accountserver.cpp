@@ -1,43 +1,70 @@
 #include "accountserver.h"
-#include <QTimer>
+#include "reconnectscheduler.h"
+#include <qutim/config.h>
 
 namespace Bearer {
 
 using namespace qutim_sdk_0_3;
 
-AccountServer::AccountServer(qutim_sdk_0_3::Account *account)
-    : QObject(account), m_account(account), m_online(false)
+AccountServer::AccountServer(qutim_sdk_0_3::Account *account, ReconnectScheduler *scheduler)
+    : QObject(account), m_account(account), m_scheduler(scheduler), m_online(false)
 {
     Config config = account->config();
     Status status = config.value("lastStatus", Status(Status::Online));
+    m_priority = config.group(QStringLiteral("bearer")).value(QStringLiteral("priority"), 0);
 
     qDebug() << account->id() << "is created with status" << status;
 
-    m_timer.setInterval(5 * 1000);
-    connect(&m_timer, &QTimer::timeout, this, &AccountServer::updateState);
-
     account->setUserStatus(status);
 
-    connect(account, &Account::stateChanged, this, [this, account] (Account::State state) {
-        if (state == Account::Disconnected && m_online && !m_timer.isActive())
-            m_timer.start();
-        else if (state == Account::Connected && m_timer.isActive())
-            m_timer.stop();
-
-        updateState();
+    connect(account, &Account::stateChanged, this, [this] (Account::State state) {
+        // Scheduler is already gone on shutdown
+        if (!m_scheduler)
+            return;
+        if (state == Account::Connected) {
+            m_scheduler->connected(this);
+        } else if (state == Account::Disconnected) {
+            m_scheduler->disconnected(this);
+            // Connection was lost or attempt failed, retry after backoff
+            if (m_online && wantOnline())
+                m_scheduler->schedule(this, true);
+        }
     });
 }
 
+AccountServer::~AccountServer()
+{
+    if (m_scheduler)
+        m_scheduler->cancel(this);
+}
+
+qutim_sdk_0_3::Account *AccountServer::account() const
+{
+    return m_account;
+}
+
+int AccountServer::priority() const
+{
+    return m_priority;
+}
+
 void AccountServer::setOnline(bool online)
 {
     qDebug() << m_account->id() << "online:" << online;
 
     m_online = online;
 
+    if (!m_online && m_scheduler)
+        m_scheduler->cancel(this);
     updateState();
+}
 
-    if (m_online && isDisconnected() && !m_timer.isActive())
-        m_timer.start();
+void AccountServer::connectNow()
+{
+    if (m_online && wantOnline() && isDisconnected())
+        m_account->connectToServer();
+    else
+        m_scheduler->disconnected(this);
 }
 
 bool AccountServer::wantOnline() const
@@ -57,8 +84,8 @@ bool AccountServer::isDisconnected() const
 
 void AccountServer::updateState()
 {
-    if (m_online && wantOnline() && isDisconnected())
-        m_account->connectToServer();
+    if (m_online && wantOnline() && isDisconnected() && m_scheduler)
+        m_scheduler->schedule(this, false);
     else if (!m_online && isConnected())
         m_account->disconnectFromServer();
 }
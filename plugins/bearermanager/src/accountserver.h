@@ -2,17 +2,25 @@
 #define BEARER_ACCOUNTSERVER_H
 
 #include <qutim/account.h>
-#include <QTimer>
+#include <QPointer>
 
 namespace Bearer {
 
+class ReconnectScheduler;
+
 class AccountServer : public QObject
 {
     Q_OBJECT
 public:
-    explicit AccountServer(qutim_sdk_0_3::Account *account);
+    AccountServer(qutim_sdk_0_3::Account *account, ReconnectScheduler *scheduler);
+    ~AccountServer();
 
+    qutim_sdk_0_3::Account *account() const;
+    // Accounts with higher priority connect first
+    int priority() const;
     void setOnline(bool isOnline);
+    // Called by scheduler when it's the account's turn
+    void connectNow();
 
 protected:
     bool wantOnline() const;
@@ -21,9 +29,10 @@ protected:
     void updateState();
 
 private:
-    QTimer m_timer;
-    bool m_online;
     qutim_sdk_0_3::Account *m_account;
+    QPointer<ReconnectScheduler> m_scheduler;
+    bool m_online;
+    int m_priority;
 };
 
 } // namespace Bearer
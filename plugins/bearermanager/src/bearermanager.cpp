@@ -26,6 +26,7 @@
 
 #include "bearermanager.h"
 #include "accountserver.h"
+#include "reconnectscheduler.h"
 
 #include <QNetworkConfigurationManager>
 #include <QNetworkConfiguration>
@@ -43,7 +44,8 @@
 using namespace qutim_sdk_0_3;
 
 BearerManager::BearerManager() :
-    m_isOnline(false), m_confManager(new QNetworkConfigurationManager(this))
+    m_isOnline(false), m_confManager(new QNetworkConfigurationManager(this)),
+    m_scheduler(new Bearer::ReconnectScheduler(this))
 {
 }
 
@@ -64,7 +66,7 @@ bool BearerManager::load()
 
     auto onAccountAdded = [this] (Account *account) {
         Q_ASSERT(account->property(BEARER_PROPERTY).isNull());
-        Bearer::AccountServer *server = new Bearer::AccountServer(account);
+        Bearer::AccountServer *server = new Bearer::AccountServer(account, m_scheduler);
         connect(this, &BearerManager::onlineStateChanged,
                 server, &Bearer::AccountServer::setOnline);
         account->setProperty(BEARER_PROPERTY, QVariant::fromValue(server));
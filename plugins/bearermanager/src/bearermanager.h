@@ -38,6 +38,7 @@
 typedef QHash<qutim_sdk_0_3::Account*, qutim_sdk_0_3::Status> StatusHash;
 
 class ManagerSettings;
+namespace Bearer { class ReconnectScheduler; }
 class QNetworkConfigurationManager;
 class BearerManager : public qutim_sdk_0_3::Plugin
 {
@@ -62,6 +63,7 @@ private:
 
 	bool m_isOnline;
     QNetworkConfigurationManager *m_confManager;
+    Bearer::ReconnectScheduler *m_scheduler;
 };
 
 #endif // BEARERMANAGER_H
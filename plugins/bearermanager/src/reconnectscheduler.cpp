@@ -0,0 +1,167 @@
+#include "reconnectscheduler.h"
+#include "accountserver.h"
+#include <qutim/account.h>
+#include <qutim/chatsession.h>
+#include <qutim/config.h>
+#include <QTimerEvent>
+#include <algorithm>
+
+namespace Bearer {
+
+using namespace qutim_sdk_0_3;
+
+enum {
+    BaseDelay = 2000,
+    MaxDelay = 5 * 60 * 1000,
+    SettleTime = 3000,
+    StableTime = 60 * 1000
+};
+
+static bool hasOpenChats(AccountServer *server)
+{
+    foreach (ChatSession *session, ChatLayer::instance()->sessions()) {
+        if (session->unit() && session->unit()->account() == server->account())
+            return true;
+    }
+    return false;
+}
+
+ReconnectScheduler::ReconnectScheduler(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    m_maxConnecting = qMax(1, Config().group(QStringLiteral("bearer")).value(QStringLiteral("maxConnecting"), 2));
+}
+
+void ReconnectScheduler::schedule(AccountServer *server, bool failed)
+{
+    m_active.remove(server);
+    m_settle.remove(server);
+    m_stable.remove(server);
+
+    int delay;
+    if (failed) {
+        const int attempts = ++m_attempts[server];
+        delay = backoff(attempts);
+    } else {
+        // Accounts woken up by the same network change are spread by
+        // connection slots, so they connect in order of their priority
+        delay = 0;
+    }
+    m_due.insert(server, m_clock.elapsed() + delay);
+    // Let all accounts scheduled at this pass take part in ordering
+    m_timer.start(0, this);
+}
+
+void ReconnectScheduler::cancel(AccountServer *server)
+{
+    m_due.remove(server);
+    m_attempts.remove(server);
+    m_active.remove(server);
+    m_settle.remove(server);
+    m_stable.remove(server);
+    process();
+}
+
+void ReconnectScheduler::connected(AccountServer *server)
+{
+    const qint64 now = m_clock.elapsed();
+    m_active.insert(server);
+    m_settle.insert(server, now + SettleTime);
+    m_stable.insert(server, now + StableTime);
+    process();
+}
+
+void ReconnectScheduler::disconnected(AccountServer *server)
+{
+    m_active.remove(server);
+    m_settle.remove(server);
+    m_stable.remove(server);
+    process();
+}
+
+int ReconnectScheduler::backoff(int attempts) const
+{
+    qint64 delay = BaseDelay;
+    for (int i = 1; i < attempts && delay < MaxDelay; ++i)
+        delay *= 2;
+    delay = qMin<qint64>(delay, MaxDelay);
+    // Random factor from 0.75 to 1.25, so accounts don't retry in lockstep
+    return int(delay * (75 + qrand() % 51) / 100);
+}
+
+void ReconnectScheduler::process()
+{
+    const qint64 now = m_clock.elapsed();
+
+    for (auto it = m_settle.begin(); it != m_settle.end();) {
+        if (it.value() <= now) {
+            m_active.remove(it.key());
+            it = m_settle.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_stable.begin(); it != m_stable.end();) {
+        if (it.value() <= now) {
+            m_attempts.remove(it.key());
+            it = m_stable.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QList<AccountServer *> ready;
+    for (auto it = m_due.constBegin(); it != m_due.constEnd(); ++it) {
+        if (it.value() <= now)
+            ready << it.key();
+    }
+    if (!ready.isEmpty() && m_active.size() < m_maxConnecting) {
+        QHash<AccountServer *, bool> chats;
+        foreach (AccountServer *server, ready)
+            chats.insert(server, hasOpenChats(server));
+        std::sort(ready.begin(), ready.end(), [this, &chats] (AccountServer *a, AccountServer *b) {
+            if (a->priority() != b->priority())
+                return a->priority() > b->priority();
+            if (chats.value(a) != chats.value(b))
+                return chats.value(a);
+            return m_due.value(a) < m_due.value(b);
+        });
+        for (int i = 0; i < ready.size() && m_active.size() < m_maxConnecting; ++i) {
+            AccountServer *server = ready.at(i);
+            m_due.remove(server);
+            m_active.insert(server);
+            server->connectNow();
+        }
+    }
+
+    // Wake up at the nearest deadline, due connections wait for a free slot
+    qint64 next = -1;
+    auto consider = [&next] (qint64 deadline) {
+        if (next < 0 || deadline < next)
+            next = deadline;
+    };
+    foreach (qint64 deadline, m_settle)
+        consider(deadline);
+    foreach (qint64 deadline, m_stable)
+        consider(deadline);
+    if (m_active.size() < m_maxConnecting) {
+        foreach (qint64 deadline, m_due)
+            consider(deadline);
+    }
+
+    if (next < 0)
+        m_timer.stop();
+    else
+        m_timer.start(int(qMax<qint64>(0, next - now)), this);
+}
+
+void ReconnectScheduler::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_timer.timerId())
+        process();
+    else
+        QObject::timerEvent(event);
+}
+
+} // namespace Bearer
@@ -0,0 +1,57 @@
+#ifndef BEARER_RECONNECTSCHEDULER_H
+#define BEARER_RECONNECTSCHEDULER_H
+
+#include <QObject>
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+
+namespace Bearer {
+
+class AccountServer;
+
+/*
+ * Decides when accounts connect to their servers.
+ *
+ * At most "bearer/maxConnecting" accounts are connecting at once, account
+ * keeps its slot for a few seconds after login, so its roster, avatars and
+ * autojoins don't compete with the next one. Accounts go in order of
+ * their "bearer/priority", then ones with open chats go first. So at
+ * startup the most important accounts come online before the rest of
+ * them even if all are scheduled at once. Failed attempts are retried with jittered exponential backoff,
+ * which is reset once connection has been stable for a minute.
+ */
+class ReconnectScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ReconnectScheduler(QObject *parent = 0);
+
+    // Schedules the connection, after failure it's delayed by backoff
+    void schedule(AccountServer *server, bool failed);
+    void cancel(AccountServer *server);
+    void connected(AccountServer *server);
+    void disconnected(AccountServer *server);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    void process();
+    int backoff(int attempts) const;
+
+    QHash<AccountServer *, qint64> m_due;
+    QHash<AccountServer *, int> m_attempts;
+    // Accounts which own connection slots
+    QSet<AccountServer *> m_active;
+    QHash<AccountServer *, qint64> m_settle;
+    QHash<AccountServer *, qint64> m_stable;
+    QBasicTimer m_timer;
+    QElapsedTimer m_clock;
+    int m_maxConnecting;
+};
+
+} // namespace Bearer
+
+#endif // BEARER_RECONNECTSCHEDULER_H
@@ -30,6 +30,14 @@
 #include <qutim/settingslayer.h>
 #include <qutim/icon.h>
 
+enum {
+	// Contacts asked for birthdays by one bulk request
+	UpdateBatchSize = 25,
+	// Birthdays change rarely, unknown ones are asked more often
+	KnownRefreshDays = 30,
+	UnknownRefreshDays = 7
+};
+
 static bool isStatusOnline(const Status &status)
 {
 	Status::Type type = status.type();
@@ -43,6 +51,16 @@ BirthdayUpdater::BirthdayUpdater(Account *account, InfoRequestFactory *factory,
 	m_updateFails(0)
 {
 	m_factory = account->infoRequestFactory();
+
+	Config cfg = account->config(QLatin1String("storedBirthdays"));
+	foreach (const QString &id, cfg.childGroups()) {
+		cfg.beginGroup(id);
+		Entry &entry = m_index[id];
+		entry.birthday = cfg.value(QLatin1String("birthday"), QDate());
+		entry.lastUpdate = cfg.value(QLatin1String("lastUpdateDate"), QDate());
+		cfg.endGroup();
+	}
+
 	m_updateTimer.setInterval(30000);
 	connect(&m_updateTimer, SIGNAL(timeout()), SLOT(onUpdateNext()));
 	connect(account, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
@@ -59,27 +77,37 @@ void BirthdayUpdater::update(Contact *contact)
 	m_waitingUpdate.push_back(contact);
 }
 
+void BirthdayUpdater::setBirthday(const QString &id, const QDate &birthday, const QDate &current)
+{
+	Entry &entry = m_index[id];
+	entry.birthday = birthday;
+	entry.lastUpdate = current;
+
+	Config cfg = m_account->config(QLatin1String("storedBirthdays"));
+	cfg.beginGroup(id);
+	cfg.setValue(QLatin1String("birthday"), birthday);
+	cfg.setValue(QLatin1String("lastUpdateDate"), current);
+	cfg.endGroup();
+}
+
 void BirthdayUpdater::onUpdateNext()
 {
-	Contact *contact = 0;
+	QList<QObject*> contacts;
 	QMutableListIterator<QPointer<Contact> > itr(m_waitingUpdate);
-	while (itr.hasNext()) {
-		if (!itr.next()) {
+	while (itr.hasNext() && contacts.size() < UpdateBatchSize) {
+		Contact *contact = itr.next().data();
+		if (!contact) {
 			itr.remove();
 			continue;
 		}
-		contact = itr.value().data();
 		InfoRequestFactory::SupportLevel level = m_factory->supportLevel(contact);
 		if (level >= InfoRequestFactory::ReadOnly) {
-			m_updateFails = 0;
+			contacts << contact;
 			itr.remove();
-			break;
-		} else {
-			contact = NULL;
 		}
 	}
 	
-	if (!contact) {
+	if (contacts.isEmpty()) {
 		if (++m_updateFails >= 30) {
 			// We have been trying to update the contacts for a long time now.
 			// Maybe their protocol is not supported information requests
@@ -90,12 +118,14 @@ void BirthdayUpdater::onUpdateNext()
 		}
 		return;
 	}
+	m_updateFails = 0;
 	
 	static QSet<QString> hints = QSet<QString>() << "birthday";
-	InfoRequest *request = m_factory->createrDataFormRequest(contact);
-	connect(request, SIGNAL(stateChanged(qutim_sdk_0_3::InfoRequest::State)),
-			SLOT(onRequestStateChanged(qutim_sdk_0_3::InfoRequest::State)));
-	request->requestData(hints);
+	foreach (InfoRequest *request, m_factory->createDataFormRequests(contacts)) {
+		connect(request, SIGNAL(stateChanged(qutim_sdk_0_3::InfoRequest::State)),
+				SLOT(onRequestStateChanged(qutim_sdk_0_3::InfoRequest::State)));
+		request->requestData(hints);
+	}
 	if (m_waitingUpdate.isEmpty())
 		m_updateTimer.stop();
 }
@@ -209,24 +239,18 @@ void BirthdayReminder::onAccountDestroyed(QObject *obj)
 
 void BirthdayReminder::onContactCreated(qutim_sdk_0_3::Contact *contact)
 {
-	QDate currentDate = QDate::currentDate();
 	Account *acc = contact->account();
-	Config cfg = acc->config(QLatin1String("storedBirthdays"));
 	BirthdayUpdater *updater = m_accounts.value(acc);
 	Q_ASSERT(updater);
-	checkContact(contact, updater, acc->infoRequestFactory(), cfg, currentDate);
+	checkContact(contact, updater, acc->infoRequestFactory(), QDate::currentDate());
 }
 
 void BirthdayReminder::onBirthdayUpdated(Contact *contact, const QDate &birthday)
 {
 	QDate current = QDate::currentDate();
 	checkContactBirthday(contact, birthday, current);
-	
-	Config cfg = contact->account()->config(QLatin1String("storedBirthdays"));
-	cfg.beginGroup(contact->id());
-	cfg.setValue(QLatin1String("birthday"), birthday);
-	cfg.setValue(QLatin1String("lastUpdateDate"), current);
-	cfg.endGroup();
+	if (BirthdayUpdater *updater = m_accounts.value(contact->account()))
+		updater->setBirthday(contact->id(), birthday, current);
 }
 
 void BirthdayReminder::onNotificationTimeout()
@@ -287,25 +311,23 @@ void BirthdayReminder::checkContactBirthday(Contact *contact, const QDate &birth
 
 void BirthdayReminder::checkAccount(Account *account, BirthdayUpdater *updater, InfoRequestFactory *factory)
 {
-	Config cfg = account->config(QLatin1String("storedBirthdays"));
+	const QDate currentDate = QDate::currentDate();
 	foreach (Contact *contact, account->findChildren<Contact*>())
-		checkContact(contact, updater, factory, cfg, QDate::currentDate());
+		checkContact(contact, updater, factory, currentDate);
 }
 
 void BirthdayReminder::checkContact(Contact *contact, BirthdayUpdater *updater,
-									InfoRequestFactory *factory, Config &cfg,
-									const QDate &currentDate)
+									InfoRequestFactory *factory, const QDate &currentDate)
 {
 	if (factory->supportLevel(contact) == InfoRequestFactory::NotSupported)
 		return;
 	
-	cfg.beginGroup(contact->id());
-	checkContactBirthday(contact, cfg.value(QLatin1String("birthday"), QDate()), currentDate);
-	QDate lastUpdate = cfg.value(QLatin1String("lastUpdateDate"), QDate());
-	int daysSinceLastUpdate = lastUpdate.daysTo(currentDate);
-	if (daysSinceLastUpdate < 0 || daysSinceLastUpdate > 3)
+	const BirthdayUpdater::Entry entry = updater->entry(contact->id());
+	checkContactBirthday(contact, entry.birthday, currentDate);
+	int daysSinceLastUpdate = entry.lastUpdate.daysTo(currentDate);
+	int refreshDays = entry.birthday.isValid() ? KnownRefreshDays : UnknownRefreshDays;
+	if (!entry.lastUpdate.isValid() || daysSinceLastUpdate < 0 || daysSinceLastUpdate > refreshDays)
 		updater->update(contact);
-	cfg.endGroup();
 }
 
 QUTIM_EXPORT_PLUGIN(BirthdayReminder)
@@ -32,6 +32,7 @@
 #include <qutim/contact.h>
 #include <qutim/inforequest.h>
 #include <QTimer>
+#include <QDate>
 
 using namespace qutim_sdk_0_3;
 
@@ -39,8 +40,17 @@ class BirthdayUpdater : public QObject
 {
 	Q_OBJECT
 public:
+	struct Entry
+	{
+		QDate birthday;
+		QDate lastUpdate;
+	};
+
 	BirthdayUpdater(Account *account, InfoRequestFactory *factory, QObject *parent = 0);
 	void update(Contact *contact);
+	// Birthdays are loaded from account config once and kept in memory
+	Entry entry(const QString &id) const { return m_index.value(id); }
+	void setBirthday(const QString &id, const QDate &birthday, const QDate &current);
 signals:
 	void birthdayUpdated(Contact *contact, const QDate &birthday);
 private slots:
@@ -52,6 +62,7 @@ private:
 	Account *m_account;
 	InfoRequestFactory *m_factory;
 	QList<QPointer<Contact> > m_waitingUpdate;
+	QHash<QString, Entry> m_index;
 	quint8 m_updateFails;
 	QTimer m_updateTimer;
 };
@@ -77,7 +88,7 @@ private:
 	void checkContactBirthday(Contact *contact, const QDate &birthday, const QDate &current);
 	void checkAccount(Account *account, BirthdayUpdater *updater, InfoRequestFactory *factory);
 	void checkContact(Contact *contact, BirthdayUpdater *updater, InfoRequestFactory *factory,
-					  Config &cfg, const QDate &currentDate);
+					  const QDate &currentDate);
 private:
 	QHash<Account*, BirthdayUpdater*> m_accounts;
 	QTimer m_notificationTimer;
@@ -59,15 +59,16 @@ void BlogImproverHandler::loadSettings()
     //m_pstoTag.setPattern("[*] ([^*,<]+(, [^*,<]+)*)");
 }
 
-MessageHandlerAsyncResult BlogImproverHandler::doHandle(Message &message)
+MessageHandler::Result BlogImproverHandler::doHandleSync(Message &message, QString *reason)
 {
+	Q_UNUSED(reason);
     if (message.isIncoming())
-        return makeAsyncResult(Accept, QString());
+        return Accept;
 
     ChatSession *session = ChatLayer::get(message.chatUnit(), false);
     HtmlLinker linker(session);
     if (!linker.isValid())
-        return makeAsyncResult(Accept, QString());
+        return Accept;
 
 	static QLatin1Literal jids[] = {
 		QLatin1Literal("p@point.im"),
@@ -104,7 +105,7 @@ MessageHandlerAsyncResult BlogImproverHandler::doHandle(Message &message)
         break;
 	}
 
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
 
 void BlogImproverHandler::handlePsto(Message &message, const HtmlLinker &linker)
@@ -55,7 +55,7 @@ public:
 	};
 
 protected:
-    qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
+    Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason) override;
 public slots:
 	void loadSettings();
 private:
@@ -31,6 +31,7 @@
 #include <qutim/notification.h>
 #include <qutim/chatsession.h>
 #include <qutim/systeminfo.h>
+#include <qutim/metrics.h>
 #include <QDebug>
 #include <QNetworkRequest>
 #include <QNetworkReply>
@@ -45,6 +46,7 @@
 #define GET_ACCOUNTS_URL (QLatin1String("api/getAccounts"))
 #define MODIFY_ROSTER_URL (QLatin1String("api/modifyRoster"))
 #define APPEND_MESSAGE_URL (QLatin1String("api/appendMessages"))
+#define REPORT_METRICS_URL (QLatin1String("api/reportMetrics"))
 
 #define DO_NOT_CHECK_SERVER_CERTIFICATE
 
@@ -182,7 +184,7 @@ void ActionList::remove(Action *action)
 }
 
 NetworkManager::NetworkManager(QObject *parent) :
-    QNetworkAccessManager(parent), m_answersReply(0), m_currentReply(0)
+    QNetworkAccessManager(parent), m_answersReply(0), m_currentReply(0), m_metricsReply(0)
 {
     connect(this, SIGNAL(finished(QNetworkReply*)),
             SLOT(onReplyFinished(QNetworkReply*)));
@@ -231,6 +233,8 @@ void NetworkManager::timerEvent(QTimerEvent *event)
 {
 	if (event->timerId() == m_timer.timerId())
 		onTimer();
+	else if (event->timerId() == m_metricsTimer.timerId())
+		sendMetrics();
 	else
 		QNetworkAccessManager::timerEvent(event);
 }
@@ -249,6 +253,12 @@ void NetworkManager::loadSettings(bool init, bool *changed)
 		*changed = false;
 	m_username = username;
 	m_base = base;
+	// Seconds between metrics reports, they are not sent by default
+	const int metricsInterval = config.value("metricsInterval", 0);
+	if (metricsInterval > 0)
+		m_metricsTimer.start(metricsInterval * 1000, this);
+	else
+		m_metricsTimer.stop();
 	if (init)
 		loadActions();
 }
@@ -387,6 +397,13 @@ void NetworkManager::updateAnswers()
 void NetworkManager::onReplyFinished(QNetworkReply *reply)
 {
 	reply->deleteLater();
+	if (reply == m_metricsReply) {
+		// Reports are periodic, so failed one is just skipped
+		m_metricsReply = 0;
+		if (reply->error() != QNetworkReply::NoError)
+			debug() << "Can't report metrics:" << reply->errorString();
+		return;
+	}
 	debug() << Q_FUNC_INFO << reply->errorString() << reply->error() << reply->rawHeaderPairs();
 	if (reply->error() != QNetworkReply::NoError
 	        && reply->error() != QNetworkReply::AuthenticationRequiredError) {
@@ -623,6 +640,16 @@ void NetworkManager::storeActions()
 		cache.remove(i);
 }
 
+void NetworkManager::sendMetrics()
+{
+	if (m_base.isEmpty() || m_metricsReply)
+		return;
+	QVariantMap data;
+	data.insert("time", QDateTime::currentMSecsSinceEpoch() / 1000);
+	data.insert("metrics", Metrics::toMap());
+	m_metricsReply = post(m_base.resolved(QUrl(REPORT_METRICS_URL)), Json::generate(data));
+}
+
 void NetworkManager::onTimer()
 {
 	m_timer.stop();
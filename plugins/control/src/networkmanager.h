@@ -171,6 +171,7 @@ protected:
 	void loadActions();
 	void storeActions();
 	void onTimer();
+	void sendMetrics();
 
 signals:
 	void answersChanged(const QStringList &answers);
@@ -183,6 +184,7 @@ private:
 	QSslCertificate m_remoteCertificate;
 	QSslKey m_privateKey;
 	QBasicTimer m_timer;
+	QBasicTimer m_metricsTimer;
 	QString m_username;
 	QUrl m_base;
 	QStringList m_answers;
@@ -190,6 +192,7 @@ private:
 	QStringList m_localAnswers;
 	QNetworkReply *m_answersReply;
 	QNetworkReply *m_currentReply;
+	QNetworkReply *m_metricsReply;
 	ActionList m_actions;
 };
 
@@ -329,7 +329,7 @@ void RosterManager::connectContact(Contact *contact)
 	        SLOT(onContactInListChanged(bool)));
 }
 
-MessageHandler::Result RosterManager::doHandle(Message &message, QString *reason)
+MessageHandler::Result RosterManager::doHandleSync(Message &message, QString *reason)
 {
 	Q_UNUSED(reason);
 	if (message.property("service", false))
@@ -65,7 +65,7 @@ protected slots:
 protected:
 	void connectAccount(qutim_sdk_0_3::Account *account);
 	void connectContact(qutim_sdk_0_3::Contact *contact);
-	virtual Result doHandle(qutim_sdk_0_3::Message &message, QString *reason);
+	virtual Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason);
 	void onStarted();
 	
 private:
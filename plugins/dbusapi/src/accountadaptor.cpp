@@ -34,6 +34,8 @@
 
 Q_GLOBAL_STATIC(AccountPathHash, accountHash)
 
+extern int dbus_batch_interval;
+
 const AccountPathHash &AccountAdaptor::hash()
 {
 	return *accountHash();
@@ -58,8 +60,13 @@ AccountAdaptor::AccountAdaptor(const QDBusConnection &dbus, const QDBusObjectPat
 	connect(account, SIGNAL(conferenceCreated(qutim_sdk_0_3::Conference*)),
 			this, SLOT(onConferenceCreated(qutim_sdk_0_3::Conference*)));
 	accountHash()->insert(account, m_path);
-	foreach (Contact *contact, qFindChildren<Contact*>(account))
+	m_statusTimer.setSingleShot(true);
+	m_statusTimer.setInterval(dbus_batch_interval);
+	connect(&m_statusTimer, SIGNAL(timeout()), this, SLOT(flushStatuses()));
+	foreach (Contact *contact, qFindChildren<Contact*>(account)) {
 		ChatUnitAdaptor::ensurePath(m_dbus, contact);
+		watchContact(contact);
+	}
 }
 
 AccountAdaptor::~AccountAdaptor()
@@ -84,6 +91,7 @@ QStringList AccountAdaptor::contacts() const
 void AccountAdaptor::onContactCreated(Contact *contact)
 {
 	QDBusObjectPath path = ChatUnitAdaptor::ensurePath(m_dbus, contact);
+	watchContact(contact);
 	emit contactCreated(path, contact->id());
 }
 
@@ -93,3 +101,36 @@ void AccountAdaptor::onConferenceCreated(Conference *conference)
 	emit contactCreated(path, conference->id());
 }
 
+
+void AccountAdaptor::watchContact(Contact *contact)
+{
+	connect(contact, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
+			this, SLOT(onContactStatusChanged()), Qt::UniqueConnection);
+}
+
+void AccountAdaptor::onContactStatusChanged()
+{
+	Contact *contact = static_cast<Contact*>(sender());
+	if (m_changedSet.contains(contact))
+		return;
+	m_changedSet.insert(contact);
+	m_changedContacts << contact;
+	if (!m_statusTimer.isActive())
+		m_statusTimer.start();
+}
+
+void AccountAdaptor::flushStatuses()
+{
+	QList<QDBusObjectPath> contacts;
+	QList<Status> statuses;
+	foreach (const QPointer<Contact> &contact, m_changedContacts) {
+		if (!contact)
+			continue;
+		contacts << ChatUnitAdaptor::ensurePath(m_dbus, contact.data());
+		statuses << contact->status();
+	}
+	m_changedContacts.clear();
+	m_changedSet.clear();
+	if (!contacts.isEmpty())
+		emit contactStatusesChanged(contacts, statuses);
+}
@@ -30,6 +30,10 @@
 #include <QDBusObjectPath>
 #include <QDBusConnection>
 #include <qutim/account.h>
+#include <qutim/contact.h>
+#include <QPointer>
+#include <QTimer>
+#include <QSet>
 
 using namespace qutim_sdk_0_3;
 
@@ -61,14 +65,25 @@ signals:
 	void nameChanged(const QString &current, const QString &previous);
 	void statusChanged(const qutim_sdk_0_3::Status &current, const qutim_sdk_0_3::Status &previous);
 	void contactCreated(const QDBusObjectPath &path, const QString &id);
+	// Coalesced status changes of account's contacts, every contact is
+	// reported once per batch interval with its latest status
+	void contactStatusesChanged(const QList<QDBusObjectPath> &contacts,
+								const QList<qutim_sdk_0_3::Status> &statuses);
 private slots:
 	void onContactCreated(qutim_sdk_0_3::Contact *contact);
 	void onConferenceCreated(qutim_sdk_0_3::Conference *conference);
+	void onContactStatusChanged();
+	void flushStatuses();
 private:
+	void watchContact(Contact *contact);
+
 	QDBusConnection m_dbus;
 	Account *m_account;
 	QDBusObjectPath m_path;
 	QDBusObjectPath m_protocolPath;
+	QList<QPointer<Contact> > m_changedContacts;
+	QSet<Contact*> m_changedSet;
+	QTimer m_statusTimer;
 };
 
 #endif // ACCOUNTADAPTOR_H
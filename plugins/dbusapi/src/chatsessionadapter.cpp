@@ -29,6 +29,8 @@
 Q_GLOBAL_STATIC(ChatSessionPathHash, chatSessionHash)
 Q_GLOBAL_STATIC_WITH_ARGS(int, counter, (0))
 
+extern int dbus_batch_interval;
+
 const ChatSessionPathHash &ChatSessionAdapter::hash()
 {
 	return *chatSessionHash();
@@ -46,8 +48,11 @@ QDBusObjectPath ChatSessionAdapter::ensurePath(QDBusConnection dbus, ChatSession
 }
 
 ChatSessionAdapter::ChatSessionAdapter(const QDBusConnection &dbus, ChatSession *session) :
-		QDBusAbstractAdaptor(session), m_session(session), m_dbus(dbus)
+		QDBusAbstractAdaptor(session), m_session(session), m_dbus(dbus), m_history(HistorySize)
 {
+	m_flushTimer.setSingleShot(true);
+	m_flushTimer.setInterval(dbus_batch_interval);
+	connect(&m_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
 	m_path = QDBusObjectPath(QLatin1String("/ChatSession/") + QString::number(*counter()));
 	(*counter())++;
 	chatSessionHash()->insert(session, m_path);
@@ -98,16 +103,51 @@ void ChatSessionAdapter::removeContact(const QDBusObjectPath &buddyPath)
 		m_session->removeContact(buddy);
 }
 
+MessageList ChatSessionAdapter::messagesSince(quint64 id) const
+{
+	MessageList result;
+	for (int i = m_history.firstIndex(); i <= m_history.lastIndex(); ++i) {
+		const Message &message = m_history.at(i);
+		if (message.id() > id)
+			result << message;
+	}
+	return result;
+}
+
+quint64 ChatSessionAdapter::lastMessageId() const
+{
+	return m_history.isEmpty() ? 0 : m_history.last().id();
+}
+
 void ChatSessionAdapter::onMessageReceived(qutim_sdk_0_3::Message *message)
 {
+	remember(*message);
 	emit messageReceived(*message);
 }
 
 void ChatSessionAdapter::onMessageSent(qutim_sdk_0_3::Message *message)
 {
+	remember(*message);
 	emit messageSent(*message);
 }
 
+void ChatSessionAdapter::remember(const Message &message)
+{
+	m_history.append(message);
+	m_pending << message;
+	if (!m_flushTimer.isActive())
+		m_flushTimer.start();
+}
+
+void ChatSessionAdapter::flush()
+{
+	if (m_pending.isEmpty())
+		return;
+	MessageList messages;
+	qSwap(messages, m_pending);
+	emit messagesAppended(messages);
+}
+
 void ChatSessionAdapter::onContactAdded(qutim_sdk_0_3::Buddy *buddy)
 {
 	QDBusObjectPath path = ChatUnitAdaptor::ensurePath(m_dbus, buddy);
@@ -30,6 +30,8 @@
 #include <QDBusAbstractAdaptor>
 #include <QDBusObjectPath>
 #include <QDBusConnection>
+#include <QContiguousCache>
+#include <QTimer>
 
 using namespace qutim_sdk_0_3;
 
@@ -63,10 +65,17 @@ public slots:
 	inline qint64 appendMessage(const QString &text);
 	inline void activate() { setActive(true); }
 	inline void markRead(quint64 id) { m_session->markRead(id); }
+	// Returns remembered messages with greater id, so client may catch up
+	// after missing some signals. Only the last HistorySize ones are kept
+	qutim_sdk_0_3::MessageList messagesSince(quint64 id) const;
+	quint64 lastMessageId() const;
 	
 signals:
 	void messageReceived(const qutim_sdk_0_3::Message &message);
 	void messageSent(const qutim_sdk_0_3::Message &message);
+	// Both received and sent messages, which were appended during the last
+	// batch interval, use it instead of per-message signals during floods
+	void messagesAppended(const qutim_sdk_0_3::MessageList &messages);
 	void contactAdded(const QDBusObjectPath &buddy, const QString &id);
 	void contactRemoved(const QDBusObjectPath &buddy, const QString &id);
 	void activated(bool active);
@@ -77,11 +86,18 @@ private slots:
 	void onMessageSent(qutim_sdk_0_3::Message *message);
 	void onContactAdded(qutim_sdk_0_3::Buddy *c);
 	void onContactRemoved(qutim_sdk_0_3::Buddy *c);
+	void flush();
 	
 private:
+	enum { HistorySize = 256 };
+	void remember(const Message &message);
+
 	ChatSession *m_session;
 	QDBusConnection m_dbus;
 	QDBusObjectPath m_path;
+	QContiguousCache<Message> m_history;
+	MessageList m_pending;
+	QTimer m_flushTimer;
 };
 
 qint64 ChatSessionAdapter::appendMessage(qutim_sdk_0_3::Message &message)
@@ -27,6 +27,7 @@
 #include "protocoladaptor.h"
 #include "chatlayeradapter.h"
 #include "chatunitadaptor.h"
+#include "metricsadaptor.h"
 #include <QApplication>
 #include <QDBusError>
 #include <QDBusArgument>
@@ -34,6 +35,7 @@
 #include <qutim/protocol.h>
 #include <qutim/account.h>
 #include <qutim/event.h>
+#include <qutim/config.h>
 #include <QDebug>
 
 QDBusArgument &operator<<(QDBusArgument &argument, const Status &status)
@@ -95,6 +97,10 @@ QDBusArgument &operator<<(QDBusArgument &argument, const Message &msg)
 	if (first) {
 		first = false;
 	} else {
+		argument.beginMapEntry();
+		argument << QString::fromLatin1("id") << QDBusVariant(qulonglong(msg.id()));
+		argument.endMapEntry();
+
 		argument.beginMapEntry();
 		argument << QString::fromLatin1("time") << QDBusVariant(msg.time());
 		argument.endMapEntry();
@@ -132,7 +138,9 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, Message &msg)
 	while (!argument.atEnd()) {
 		argument.beginMapEntry();
 		argument >> key >> value;
-		msg.setProperty(key.toLatin1(), value);
+		// Id is assigned by qutIM itself
+		if (key != QLatin1String("id"))
+			msg.setProperty(key.toLatin1(), value);
 		argument.endMapEntry();
 	}
 	argument.endMap();
@@ -140,8 +148,10 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, Message &msg)
 }
 
 quint16 dbus_adaptor_event_id = 0;
+// Batched signals are flushed at most once per this many milliseconds
+int dbus_batch_interval = 100;
 
-DBusPlugin::DBusPlugin() : m_dbus(0)
+DBusPlugin::DBusPlugin() : m_dbus(0), m_metrics(0)
 {
 }
 
@@ -166,7 +176,9 @@ bool DBusPlugin::load()
 		return false;
 	}
 	dbus_adaptor_event_id = Event::registerType("dbus-adaptors-request");
+	dbus_batch_interval = qMax(0, Config(QLatin1String("dbus")).value(QLatin1String("batchInterval"), 100));
 	qDBusRegisterMetaType<Status>();
+	qDBusRegisterMetaType<QList<Status> >();
 	qDBusRegisterMetaType<Message>();
 	qDBusRegisterMetaType<MessageList>();
 	qDBusRegisterMetaType<QList<QDBusObjectPath> >();
@@ -181,6 +193,9 @@ bool DBusPlugin::load()
 	new ChatLayerAdapter(*m_dbus);
 	m_dbus->registerObject("/ChatLayer", ChatLayer::instance(), QDBusConnection::ExportAdaptors);
 	m_dbus->registerObject("/App", qApp, QDBusConnection::ExportAllContents);
+	m_metrics = new QObject(this);
+	new MetricsAdaptor(m_metrics);
+	m_dbus->registerObject("/Metrics", m_metrics, QDBusConnection::ExportAdaptors);
 	return true;
 }
 
@@ -191,6 +206,8 @@ bool DBusPlugin::unload()
 	m_dbus->unregisterService("org.qutim");
 	delete m_dbus;
 	m_dbus = 0;
+	delete m_metrics;
+	m_metrics = 0;
 	return true;
 }
 
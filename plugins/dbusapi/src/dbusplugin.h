@@ -41,6 +41,7 @@ public:
 	virtual bool unload();
 private:
 	QDBusConnection *m_dbus;
+	QObject *m_metrics;
 };
 
 #endif // DBUSPLUGIN_H
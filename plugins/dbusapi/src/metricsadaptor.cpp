@@ -0,0 +1,58 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "metricsadaptor.h"
+#include <qutim/metrics.h>
+#include <qutim/memoryaccounting.h>
+
+using namespace qutim_sdk_0_3;
+
+MetricsAdaptor::MetricsAdaptor(QObject *parent) :
+		QDBusAbstractAdaptor(parent)
+{
+}
+
+QString MetricsAdaptor::text() const
+{
+	return QString::fromUtf8(Metrics::toText());
+}
+
+QVariantMap MetricsAdaptor::values() const
+{
+	return Metrics::toMap();
+}
+
+QVariantList MetricsAdaptor::memoryUsage(int count) const
+{
+	QVariantList result;
+	foreach (const MemoryAccounting::Entry &entry, MemoryAccounting::top(count)) {
+		QVariantMap map;
+		map.insert(QStringLiteral("subsystem"), MemoryAccounting::subsystemId(entry.subsystem));
+		map.insert(QStringLiteral("name"), entry.name);
+		map.insert(QStringLiteral("bytes"), entry.bytes);
+		result << map;
+	}
+	return result;
+}
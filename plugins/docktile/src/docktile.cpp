@@ -86,7 +86,7 @@ void DockTile::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
 	m_menu->insertAction(m_sessionSeparator, action);
 	setMenu(m_menu.data());
 
-	connect(session, SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)), SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+	connect(session, SIGNAL(unreadCountChanged(int)), SLOT(onUnreadChanged()));
 	connect(session, SIGNAL(destroyed()), SLOT(onSessionDestroyed()));
 }
 
@@ -98,7 +98,7 @@ void DockTile::onSessionDestroyed()
 	m_sessions.remove(session);
 }
 
-void DockTile::onUnreadChanged(const qutim_sdk_0_3::MessageList &)
+void DockTile::onUnreadChanged()
 {
 	int unread = calculateUnread();
 	if (unread)
@@ -111,7 +111,7 @@ int DockTile::calculateUnread() const
 {
 	int unread = 0;
 	foreach (ChatSession *session, m_sessions.keys()) {
-		unread += session->unread().count();
+		unread += session->unreadCount();
 	}
 	return unread;
 }
@@ -18,7 +18,7 @@ private slots:
 	void onSessionTriggered();
 	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
 	void onSessionDestroyed();
-	void onUnreadChanged(const qutim_sdk_0_3::MessageList &unread);
+	void onUnreadChanged();
 	int calculateUnread() const;
 private:
 	QScopedPointer<QMenu> m_menu;
@@ -26,42 +26,116 @@
 #include "formulahandler.h"
 #include <qutim/debug.h>
 #include <QUrl>
-#include <QTextDocument>
+#include <QSharedPointer>
 
 using namespace qutim_sdk_0_3;
 
+// Calls callback for every $$...$$ with offsets of the opening and right
+// after the closing delimiters, html is read only once
+template <typename Callback>
+static void scanEquations(const QString &html, Callback callback)
+{
+	const QChar *data = html.constData();
+	const int size = html.size();
+	int start = -1;
+	for (int i = 0; i + 1 < size; ++i) {
+		if (data[i] != QLatin1Char('$') || data[i + 1] != QLatin1Char('$'))
+			continue;
+		if (start < 0) {
+			start = i;
+		} else {
+			if (i > start + 2)
+				callback(start, i + 2);
+			start = -1;
+		}
+		++i;
+	}
+}
+
+static inline QString equationText(const QString &html, int from, int to)
+{
+	// html is already escaped
+	return unescape(html.mid(from + 2, to - from - 4));
+}
+
 FormulaHandler::FormulaHandler()
 {
-	m_regexp.setPatternSyntax(QRegExp::RegExp);
-	m_regexp.setPattern(QLatin1String("\\$\\$(.*)\\$\\$"));
-	m_regexp.setMinimal(true);
-	Q_ASSERT(m_regexp.isValid());
 }
 
-MessageHandlerAsyncResult FormulaHandler::doHandle(Message &message)
+MessageHandler::Result FormulaHandler::doHandleSync(Message &message, QString *reason)
 {
-	int index = 0;
-	int lastIndex = 0;
+	Q_UNUSED(reason);
 	const QString html = message.html();
+	bool found = false;
+	if (!missingEquations(html, &found).isEmpty())
+		return Pending;
+	if (found)
+		message.setHtml(rewrite(html));
+	return Accept;
+}
+
+MessageHandlerAsyncResult FormulaHandler::doHandle(Message &message)
+{
+	const QStringList missing = missingEquations(message.html());
+	if (missing.isEmpty()) {
+		message.setHtml(rewrite(message.html()));
+		return makeAsyncResult(Accept, QString());
+	}
+
+	// Message is shown once all its equations are rendered, failed ones
+	// are left for the remote service
+	MessageHandlerAsyncResult::Handler handler;
+	QSharedPointer<int> remaining = QSharedPointer<int>::create(missing.size());
+	Message *target = &message;
+	foreach (const QString &equation, missing) {
+		m_renderer.render(equation, [this, handler, remaining, target] (bool) {
+			if (--*remaining == 0) {
+				target->setHtml(rewrite(target->html()));
+				handler.handle(Accept, QString());
+			}
+		});
+	}
+	return handler.result();
+}
+
+QStringList FormulaHandler::missingEquations(const QString &html, bool *found)
+{
+	QStringList missing;
+	scanEquations(html, [this, &html, &missing, found] (int from, int to) {
+		if (found)
+			*found = true;
+		const QString equation = equationText(html, from, to);
+		if (m_renderer.canRender(equation) && !m_renderer.isCached(equation) && !missing.contains(equation))
+			missing << equation;
+	});
+	return missing;
+}
+
+QString FormulaHandler::rewrite(const QString &html)
+{
 	QString newHtml;
 	newHtml.reserve(html.size());
-    while ((index = m_regexp.indexIn(html, index)) >= 0) {
-		html.midRef(lastIndex, index - lastIndex).appendTo(&newHtml);
-		// html is already escaped
-		const QString equation = m_regexp.cap(0);
-		const QString url = QLatin1String("http://latex.codecogs.com/png.latex?")
-		                    + QUrl::toPercentEncoding(unescape(m_regexp.cap(1)));
+	int lastIndex = 0;
+	scanEquations(html, [this, &html, &newHtml, &lastIndex] (int from, int to) {
+		html.midRef(lastIndex, from - lastIndex).appendTo(&newHtml);
+		const QStringRef equation = html.midRef(from, to - from);
+		const QString text = equationText(html, from, to);
+		QString url;
+		if (m_renderer.isCached(text)) {
+			url = QString::fromLatin1(QUrl::fromLocalFile(m_renderer.fileName(text)).toEncoded());
+		} else {
+			url = QLatin1String("http://latex.codecogs.com/png.latex?")
+					+ QString::fromLatin1(QUrl::toPercentEncoding(text));
+		}
 		newHtml += QLatin1String("<img src=\"");
 		newHtml += url;
-		newHtml += QLatin1String("\"alt=\"");
-		newHtml += equation;
+		newHtml += QLatin1String("\" alt=\"");
+		equation.appendTo(&newHtml);
 		newHtml += QLatin1String("\" title=\"");
-		newHtml += equation;
+		equation.appendTo(&newHtml);
 		newHtml += QLatin1String("\">");
-		index += m_regexp.cap(0).length();
-		lastIndex = index;
-    }
+		lastIndex = to;
+	});
 	html.midRef(lastIndex, html.size() - lastIndex).appendTo(&newHtml);
-	message.setHtml(newHtml);
-	return makeAsyncResult(Accept, QString());
+	return newHtml;
 }
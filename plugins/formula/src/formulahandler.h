@@ -27,16 +27,20 @@
 #define FORMULAHANDLER_H
 
 #include <qutim/messagehandler.h>
-#include <QRegExp>
+#include "formularenderer.h"
 
 class FormulaHandler : public qutim_sdk_0_3::MessageHandler
 {
 public:
 	FormulaHandler();
 
+	Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason) override;
 	qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
 private:
-	QRegExp m_regexp;
+	QStringList missingEquations(const QString &html, bool *found = 0);
+	QString rewrite(const QString &html);
+
+	FormulaRenderer m_renderer;
 };
 
 #endif // FORMULAHANDLER_H
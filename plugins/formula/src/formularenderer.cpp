@@ -0,0 +1,226 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "formularenderer.h"
+#include <qutim/systeminfo.h>
+#include <qutim/debug.h>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTimerEvent>
+
+using namespace qutim_sdk_0_3;
+
+enum { RenderTimeout = 10000 };
+
+FormulaRenderer::FormulaRenderer()
+	: m_process(0), m_tempDir(0), m_timeoutTimer(0)
+{
+	m_cacheDir = SystemInfo::getDir(SystemInfo::ConfigDir).filePath(QStringLiteral("cache/formula"));
+	m_latex = QStandardPaths::findExecutable(QStringLiteral("latex"));
+	m_dvipng = QStandardPaths::findExecutable(QStringLiteral("dvipng"));
+	if (!isAvailable())
+		qDebug() << "latex or dvipng is not found, equations are rendered by remote service";
+}
+
+FormulaRenderer::~FormulaRenderer()
+{
+	if (m_process) {
+		m_process->kill();
+		m_process->waitForFinished(1000);
+	}
+	delete m_tempDir;
+}
+
+bool FormulaRenderer::isAvailable() const
+{
+	return !m_latex.isEmpty() && !m_dvipng.isEmpty();
+}
+
+bool FormulaRenderer::canRender(const QString &equation) const
+{
+	static const char * const forbidden[] = {
+		"\\input", "\\include", "\\openin", "\\openout", "\\read", "\\write",
+		"\\immediate", "\\catcode", "\\csname", "\\def", "\\let", "\\newcommand",
+		"\\renewcommand", "\\usepackage", "\\special", "\\end", "^^", "$"
+	};
+	for (const char *command : forbidden) {
+		if (equation.contains(QLatin1String(command)))
+			return false;
+	}
+	return isAvailable();
+}
+
+QString FormulaRenderer::fileName(const QString &equation) const
+{
+	const QByteArray hash = QCryptographicHash::hash(equation.toUtf8(), QCryptographicHash::Sha1);
+	return m_cacheDir.filePath(QLatin1String(hash.toHex()) + QStringLiteral(".png"));
+}
+
+bool FormulaRenderer::isCached(const QString &equation) const
+{
+	if (m_cached.contains(equation))
+		return true;
+	if (!QFile::exists(fileName(equation)))
+		return false;
+	m_cached.insert(equation);
+	return true;
+}
+
+void FormulaRenderer::render(const QString &equation, const Callback &callback)
+{
+	auto it = m_callbacks.find(equation);
+	if (it == m_callbacks.end()) {
+		it = m_callbacks.insert(equation, QList<Callback>());
+		m_queue << equation;
+	}
+	it->append(callback);
+	if (m_current.isEmpty())
+		startNext();
+}
+
+void FormulaRenderer::startNext()
+{
+	if (m_queue.isEmpty())
+		return;
+	m_current = m_queue.takeFirst();
+	if (isCached(m_current)) {
+		finish(true);
+		return;
+	}
+
+	m_tempDir = new QTemporaryDir;
+	QFile file(m_tempDir->path() + QStringLiteral("/formula.tex"));
+	if (!m_tempDir->isValid() || !file.open(QIODevice::WriteOnly)) {
+		finish(false);
+		return;
+	}
+	file.write("\\documentclass[12pt]{article}\n"
+			   "\\usepackage{amsmath}\n"
+			   "\\usepackage{amssymb}\n"
+			   "\\pagestyle{empty}\n"
+			   "\\begin{document}\n"
+			   "$\\displaystyle ");
+	file.write(m_current.toUtf8());
+	file.write("$\n\\end{document}\n");
+	file.close();
+
+	m_timeoutTimer = startTimer(RenderTimeout);
+	startProcess(m_latex, QStringList()
+				 << QStringLiteral("-interaction=nonstopmode")
+				 << QStringLiteral("-halt-on-error")
+				 << QStringLiteral("-no-shell-escape")
+				 << QStringLiteral("formula.tex"),
+				 [this] (bool ok) {
+		if (ok)
+			runDvipng();
+		else
+			finish(false);
+	});
+}
+
+void FormulaRenderer::runDvipng()
+{
+	m_cacheDir.mkpath(QStringLiteral("."));
+	const QString partName = fileName(m_current) + QStringLiteral(".part");
+
+	startProcess(m_dvipng, QStringList()
+				 << QStringLiteral("-T") << QStringLiteral("tight")
+				 << QStringLiteral("-D") << QStringLiteral("120")
+				 << QStringLiteral("-bg") << QStringLiteral("Transparent")
+				 << QStringLiteral("-o") << partName
+				 << QStringLiteral("formula.dvi"),
+				 [this, partName] (bool ok) {
+		// Partially written image must never be taken for cached one
+		ok = ok && QFile::rename(partName, fileName(m_current));
+		if (!ok)
+			QFile::remove(partName);
+		finish(ok);
+	});
+}
+
+void FormulaRenderer::startProcess(const QString &program, const QStringList &arguments, const Callback &callback)
+{
+	QProcess *process = new QProcess(this);
+	m_process = process;
+	process->setWorkingDirectory(m_tempDir->path());
+	process->setProcessChannelMode(QProcess::MergedChannels);
+	auto done = [this, process, callback] (bool ok) {
+		if (m_process != process)
+			return;
+		m_process = 0;
+		process->deleteLater();
+		callback(ok);
+	};
+	connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+			this, [this, process, done] (int code, QProcess::ExitStatus status) {
+		const bool ok = status == QProcess::NormalExit && code == 0;
+		if (!ok && m_process == process)
+			m_output = QString::fromLocal8Bit(process->readAll());
+		done(ok);
+	});
+	connect(process, &QProcess::errorOccurred,
+			this, [this, process, done] (QProcess::ProcessError error) {
+		if (error != QProcess::FailedToStart)
+			return;
+		if (m_process == process)
+			m_output = process->errorString();
+		done(false);
+	});
+	process->start(program, arguments);
+}
+
+void FormulaRenderer::finish(bool ok)
+{
+	if (m_timeoutTimer) {
+		killTimer(m_timeoutTimer);
+		m_timeoutTimer = 0;
+	}
+	delete m_tempDir;
+	m_tempDir = 0;
+	if (!ok)
+		qWarning() << "Failed to render equation" << m_current << m_output;
+	m_output.clear();
+
+	// Equations requested by callbacks are queued until the current one is cleared
+	const QList<Callback> callbacks = m_callbacks.take(m_current);
+	for (const Callback &callback : callbacks)
+		callback(ok);
+	m_current.clear();
+	startNext();
+}
+
+void FormulaRenderer::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != m_timeoutTimer) {
+		QObject::timerEvent(event);
+		return;
+	}
+	// Finished handler reports the failure
+	if (m_process)
+		m_process->kill();
+}
@@ -0,0 +1,80 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef FORMULARENDERER_H
+#define FORMULARENDERER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QDir>
+#include <functional>
+
+class QProcess;
+class QTemporaryDir;
+
+// Renders equations to png files by local latex and dvipng, results are
+// cached in the profile by hash of the equation
+class FormulaRenderer : public QObject
+{
+	Q_OBJECT
+public:
+	typedef std::function<void (bool)> Callback;
+
+	FormulaRenderer();
+	~FormulaRenderer();
+
+	bool isAvailable() const;
+	// Equations able to read or write files are never passed to latex
+	bool canRender(const QString &equation) const;
+	QString fileName(const QString &equation) const;
+	bool isCached(const QString &equation) const;
+	void render(const QString &equation, const Callback &callback);
+
+protected:
+	void timerEvent(QTimerEvent *event);
+
+private:
+	void startNext();
+	void runDvipng();
+	void startProcess(const QString &program, const QStringList &arguments, const Callback &callback);
+	void finish(bool ok);
+
+	QDir m_cacheDir;
+	QString m_latex;
+	QString m_dvipng;
+	QStringList m_queue;
+	QHash<QString, QList<Callback> > m_callbacks;
+	mutable QSet<QString> m_cached;
+	QString m_current;
+	// Output of the failed tool, reported once the equation is given up
+	QString m_output;
+	QProcess *m_process;
+	QTemporaryDir *m_tempDir;
+	int m_timeoutTimer;
+};
+
+#endif // FORMULARENDERER_H
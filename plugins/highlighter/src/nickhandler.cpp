@@ -43,15 +43,100 @@ void NickHandler::loadSettings()
 	cfg.beginGroup("highlighter");
 
 	m_enableAutoHighlights = cfg.value("enableAutoHighlights", true);
-	m_regexps.clear();
+	QList<QRegExp> regexps;
 	int count = cfg.beginArray(QLatin1String("regexps"));
 	for (int i = 0; i < count; i++) {
 		cfg.setArrayIndex(i);
 		QRegExp regExp = cfg.value(QLatin1String("regexp"), QRegExp());
 
-		m_regexps << regExp;
+		regexps << regExp;
 	}
 	cfg.endGroup();
+	compile(regexps);
+}
+
+static QString wildcardPattern(const QString &wildcard, bool escapes)
+{
+	QString result;
+	for (int i = 0; i < wildcard.size(); ++i) {
+		const QChar c = wildcard.at(i);
+		if (c == QLatin1Char('*')) {
+			result += QLatin1String(".*");
+		} else if (c == QLatin1Char('?')) {
+			result += QLatin1Char('.');
+		} else if (c == QLatin1Char('\\') && escapes && i + 1 < wildcard.size()) {
+			result += QRegularExpression::escape(wildcard.at(++i));
+		} else if (c == QLatin1Char('[')) {
+			const int end = wildcard.indexOf(QLatin1Char(']'), i + 2);
+			if (end < 0)
+				return QString();
+			QString set = wildcard.mid(i + 1, end - i - 1);
+			if (set.startsWith(QLatin1Char('!')))
+				set[0] = QLatin1Char('^');
+			result += QLatin1Char('[') + set.replace(QLatin1String("\\"), QLatin1String("\\\\")) + QLatin1Char(']');
+			i = end;
+		} else {
+			result += QRegularExpression::escape(c);
+		}
+	}
+	return result;
+}
+
+// Returns pattern for QRegularExpression matching substrings the same way
+// as QRegExp does or null string if there is no such simple conversion
+static QString convertPattern(const QRegExp &regexp)
+{
+	QString pattern;
+	switch (regexp.patternSyntax()) {
+	case QRegExp::FixedString:
+		pattern = QRegularExpression::escape(regexp.pattern());
+		break;
+	case QRegExp::Wildcard:
+	case QRegExp::WildcardUnix:
+		pattern = wildcardPattern(regexp.pattern(), regexp.patternSyntax() == QRegExp::WildcardUnix);
+		break;
+	case QRegExp::RegExp:
+	case QRegExp::RegExp2:
+		pattern = regexp.pattern();
+		// Back references would point to wrong groups in the alternation
+		if (pattern.contains(QRegularExpression(QStringLiteral("\\\\[1-9]"))))
+			return QString();
+		break;
+	default:
+		return QString();
+	}
+	if (pattern.isEmpty() || !QRegularExpression(pattern).isValid())
+		return QString();
+	return (regexp.caseSensitivity() == Qt::CaseInsensitive ? QLatin1String("(?i:") : QLatin1String("(?:"))
+			+ pattern + QLatin1Char(')');
+}
+
+void NickHandler::compile(const QList<QRegExp> &regexps)
+{
+	m_regexps.clear();
+	QStringList patterns;
+	foreach (const QRegExp &regexp, regexps) {
+		if (regexp.isEmpty() || !regexp.isValid())
+			continue;
+		const QString pattern = convertPattern(regexp);
+		if (pattern.isNull())
+			m_regexps << regexp;
+		else
+			patterns << pattern;
+	}
+
+	m_matcher = QRegularExpression();
+	if (patterns.isEmpty())
+		return;
+	m_matcher.setPattern(patterns.join(QLatin1Char('|')));
+	// QRegExp has no special meaning for line breaks
+	m_matcher.setPatternOptions(QRegularExpression::DotMatchesEverythingOption);
+	if (!m_matcher.isValid()) {
+		m_matcher = QRegularExpression();
+		m_regexps = regexps;
+		return;
+	}
+	m_matcher.optimize();
 }
 
 static bool isWord(QChar ch)
@@ -59,44 +144,48 @@ static bool isWord(QChar ch)
 	return ch.isLetterOrNumber() || ch.isMark() || ch == QLatin1Char('_');
 }
 
-MessageHandlerAsyncResult NickHandler::doHandle(Message &message)
+MessageHandler::Result NickHandler::doHandleSync(Message &message, QString *reason)
 {
+	Q_UNUSED(reason);
 	if(!message.isIncoming())
-		return makeAsyncResult(Accept, QString());
+		return Accept;
 
 	Conference *conference = qobject_cast<Conference*>(message.chatUnit());
 	if (!conference)
-		return makeAsyncResult(Accept, QString());
+		return Accept;
 
 	Buddy *me = conference->me();
 	if (!me)
-		return makeAsyncResult(Accept, QString());
+		return Accept;
 
 	const QString myNick = me->name();
+	const QString text = message.text();
 
-	if (m_enableAutoHighlights) {
-		const QString text = message.text();
+	if (m_enableAutoHighlights && !myNick.isEmpty()) {
 		int pos = 0;
 		while ((pos = text.indexOf(myNick, pos, Qt::CaseInsensitive)) != -1) {
 			if ((pos == 0 || !isWord(text.at(pos - 1)))
 					&& (pos + myNick.size() == text.size() || !isWord(text.at(pos + myNick.size())))) {
 				message.setProperty("mention", true);
-				return makeAsyncResult(Accept, QString());
+				return Accept;
 			}
 			++pos;
 		}
 	}
 
-	if (m_regexps.size()) {
-		for (int i = 0; i < m_regexps.size(); ++i) {
-			if (message.text().contains(m_regexps.at(i))) {
-				message.setProperty("mention", true);
-				return makeAsyncResult(Accept, QString());
-			}
+	if (!m_matcher.pattern().isEmpty() && m_matcher.match(text).hasMatch()) {
+		message.setProperty("mention", true);
+		return Accept;
+	}
+
+	for (int i = 0; i < m_regexps.size(); ++i) {
+		if (text.contains(m_regexps.at(i))) {
+			message.setProperty("mention", true);
+			return Accept;
 		}
 	}
 
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
 
 } // namespace Highlighter
@@ -30,6 +30,7 @@
 #define HIGHLIGHTER_MESSAGEHANDLER_H
 #include <qutim/messagehandler.h>
 #include <QRegExp>
+#include <QRegularExpression>
 #include <QLatin1String>
 #include <QStringRef>
 #include <QTextDocument>
@@ -45,11 +46,16 @@ class NickHandler : public QObject, public qutim_sdk_0_3::MessageHandler
 public:
 	explicit NickHandler();
 protected:
-	qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
+	Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason) override;
 public slots:
 	void loadSettings();
 private:
+	void compile(const QList<QRegExp> &regexps);
+
 	bool m_enableAutoHighlights;
+	// All patterns are compiled to single alternation, only the ones
+	// which can't be converted are matched by QRegExp one by one
+	QRegularExpression m_matcher;
 	QList<QRegExp> m_regexps;
 };
 
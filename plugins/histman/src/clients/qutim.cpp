@@ -350,6 +350,23 @@ void qutim::loadMessages(const QString &path)
 		loadJson(lists[2]);
 }
 
+void qutim::loadLegacyMessages(const QString &path)
+{
+	int num = 0;
+	Types types;
+	QVector<QFileInfoList> lists(2);
+	if(guessXml(path, lists[0], num))
+		types |= Xml;
+	if(guessBin(path, lists[1], num))
+		types |= Bin;
+	setMaxValue(num);
+	m_value = 0;
+	if(types & Xml)
+		loadXml(lists[0]);
+	if(types & Bin)
+		loadBin(lists[1]);
+}
+
 bool qutim::validate(const QString &path)
 {
 	int num = 0;
@@ -53,6 +53,8 @@ public:
 	static QString unquote(const QString &str);
 	void loadJson(const QFileInfoList &files);
 	virtual void loadMessages(const QString &path);
+	// Loads only formats of old qutIM versions, which aren't readable by History
+	void loadLegacyMessages(const QString &path);
 	virtual bool validate(const QString &path);
 	virtual QString name();
 	virtual QIcon icon();
@@ -42,11 +42,14 @@ void DumpHistoryPageHelper::run()
 {
 	if(m_parent->m_state == DumpHistoryPage::LoadingHistory)
 	{
-		m_parent->m_parent->getQutIM()->loadMessages(SystemInfo::getPath(SystemInfo::HistoryDir));
+		// Current history is read month by month while saving, so only
+		// files of old formats have to be merged in memory
+		m_parent->m_parent->getQutIM()->loadLegacyMessages(SystemInfo::getPath(SystemInfo::HistoryDir));
+		m_parent->m_parent->mergeMessages();
 	}
 	else if(m_parent->m_state == DumpHistoryPage::SavingHistory)
 	{
-		m_parent->m_parent->saveMessages(m_parent->m_format);
+		m_parent->m_parent->saveMessages();
 	}
 }
 
@@ -62,16 +65,12 @@ DumpHistoryPage::DumpHistoryPage(HistoryManagerWindow *parent) :
 	connect(m_parent, SIGNAL(valueChanged(int)), m_ui->mergeProgressBar, SLOT(setValue(int)));
 	connect(m_parent, SIGNAL(saveMaxValueChanged(int)), m_ui->dumpProgressBar, SLOT(setMaximum(int)));
 	connect(m_parent, SIGNAL(saveValueChanged(int)), m_ui->dumpProgressBar, SLOT(setValue(int)));
-	m_format = 0;
 	m_helper = new DumpHistoryPageHelper(this);
 	connect(m_helper, SIGNAL(finished()), this, SLOT(completed()));
 	setTitle(tr("Dumping"));
 //	GeneratorList gens = moduleGenerators<HistoryExporter>();
 //	Q_REGISTER_EVENT(event_exports, EventExporters);
 //	qutim_sdk_0_2::Event(event_exports, 1, &m_clients_list).send();
-	m_ui->label_3->hide();
-	m_ui->binaryRadioButton->hide();
-	m_ui->jsonRadioButton->hide();
 }
 
 DumpHistoryPage::~DumpHistoryPage()
@@ -82,22 +81,8 @@ DumpHistoryPage::~DumpHistoryPage()
 void DumpHistoryPage::initializePage()
 {
 	m_state = PreInit;
-//	QFileInfoList files;
-//	int num = 0;
 	m_ui->mergeProgressBar->setValue(0);
 	m_ui->dumpProgressBar->setValue(0);
-	m_ui->binaryRadioButton->setEnabled(true);
-	m_ui->jsonRadioButton->setEnabled(true);
-//	if(m_parent->getQutIM()->guessJson(profile_path, files, num))
-//	{
-		m_ui->jsonRadioButton->setChecked(true);
-		m_ui->binaryRadioButton->setChecked(false);
-//	}
-//	else
-//	{
-//		m_ui->binaryRadioButton->setChecked(true);
-//		m_ui->jsonRadioButton->setChecked(false);
-//	}
 	setButtonText(QWizard::FinishButton, m_parent->dumpStr());
 	setSubTitle(tr("Last step. Click 'Dump' to start dumping process."));//tr("Choose appropriate format of history, binary is default qutIM format nowadays."));
 }
@@ -117,10 +102,7 @@ bool DumpHistoryPage::validatePage()
 		return true;
 	setSubTitle(tr("Manager merges history, it make take several minutes."));
 	setButtonText(QWizard::FinishButton, m_parent->finishStr());
-	m_ui->binaryRadioButton->setEnabled(false);
-	m_ui->jsonRadioButton->setEnabled(false);
 	m_state = LoadingHistory;
-	m_format = m_ui->jsonRadioButton->isChecked() ? 'j' : 'b';
 	emit completeChanged();
 	m_parent->button(QWizard::BackButton)->setEnabled(false);
 	m_parent->button(QWizard::CancelButton)->setEnabled(false);
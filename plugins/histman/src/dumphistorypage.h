@@ -76,7 +76,6 @@ private:
     Ui::DumpHistoryPage *m_ui;
 	HistoryManagerWindow *m_parent;
 	State m_state;
-	char m_format;
 	friend class DumpHistoryPageHelper;
 	DumpHistoryPageHelper *m_helper;
 //	QList<HistoryExporter *> m_clients_list;
@@ -34,41 +34,18 @@
 #include <qutim/account.h>
 #include <qutim/protocol.h>
 #include <qutim/systeminfo.h>
+#include <qutim/history.h>
+#include <qutim/executor.h>
 #include <QLabel>
 #include <QTextDocument>
 #include <QComboBox>
+#include <QThread>
+#include <QAtomicInteger>
 
 using namespace qutim_sdk_0_3;
 
 namespace HistoryManager {
 
-int inline compare_datetime_helper(const QDateTime &dt1, const QDateTime &dt2)
-{
-	QDateTime dtu1 = dt1.toUTC();
-	QDateTime dtu2 = dt2.toUTC();
-	QDate d1 = dtu1.date();
-	QDate d2 = dtu2.date();
-	if(d1 == d2)
-		return dtu2.time().secsTo(dtu1.time());
-	else
-		return d2.daysTo(d1);
-}
-
-bool compare_message_helper(const Message &msg1, const Message &msg2)
-{
-	int cmp_d = compare_datetime_helper(msg1.time(), msg2.time());
-	if(!cmp_d)
-	{
-		int cmp_m = msg1.text().compare(msg2.text());
-		if(!cmp_m)
-			return msg1.isIncoming() && !msg2.isIncoming();
-		else
-			return cmp_m < 0;
-	}
-	else
-		return cmp_d < 0;
-}
-
 HistoryManagerWindow::HistoryManagerWindow(QWidget *parent) :
 	QWizard(parent)
 {
@@ -104,17 +81,35 @@ void HistoryManagerWindow::appendMessage(const Message &message)
 {
 	m_is_dumping = false;
 	Q_ASSERT(m_contact);
+	// Messages are sorted and deduplicated in mergeMessages, when everything is loaded
 	QDate date = message.time().date();
 	qint64 month_id = date.year() * 100 + date.month();
-	qutim_sdk_0_3::MessageList &month = m_contact->operator [](month_id);
-	int position = qLowerBound(month.begin(), month.end(), message, compare_message_helper) - month.begin();
-	if(month.size() != position
-	   && month[position].time() == message.time()
-	   && month[position].isIncoming() == message.isIncoming()
-	   && month[position].text() == message.text())
-		return;
+	m_contact->operator [](month_id).append(message);
 	m_message_num++;
-	month.insert(position, message);
+}
+
+void HistoryManagerWindow::mergeMessages()
+{
+	QList<MessageList *> months;
+	for (auto protocol = m_protocols.begin(); protocol != m_protocols.end(); ++protocol)
+		for (auto account = protocol->begin(); account != protocol->end(); ++account)
+			for (auto contact = account->begin(); contact != account->end(); ++contact)
+				for (auto month = contact->begin(); month != contact->end(); ++month)
+					months << &month.value();
+
+	// Every contact-month is independent, so they are sorted in parallel
+	QAtomicInteger<quint64> total(0);
+	{
+		Executor executor(QStringLiteral("histman"), qMax(1, QThread::idealThreadCount()));
+		foreach (MessageList *month, months) {
+			executor.run([month, &total] () {
+				*month = History::merge(MessageList(), *month);
+				total.fetchAndAddRelaxed(month->size());
+			}, Executor::BulkPriority);
+		}
+		executor.waitForDone();
+	}
+	m_message_num = total.load();
 }
 
 void HistoryManagerWindow::setProtocol(const QString &protocol)
@@ -177,102 +172,31 @@ ConfigWidget HistoryManagerWindow::createAccountWidget(const QString &protocol)
 	return ConfigWidget(label, combo);
 }
 
-QString quoteByFormat(const QString &text, char format)
+void HistoryManagerWindow::saveMessages()
 {
-	if(format == 'j')
-		return qutim::quote(text);
-	else if(format == 'b')
-		return QLatin1String(text.toUtf8().toHex());
-	return text;
-}
-
-void HistoryManagerWindow::saveMessages(char format)
-{
-	if(format != 'b' && format != 'j')
-		return;
-	int total_count = 0;
+	int total = 0;
+	for (auto protocol = m_protocols.constBegin(); protocol != m_protocols.constEnd(); ++protocol)
+		for (auto account = protocol->constBegin(); account != protocol->constEnd(); ++account)
+			for (auto contact = account->constBegin(); contact != account->constEnd(); ++contact)
+				total += contact->size();
+	emit saveMaxValueChanged(total);
+
+	// Backends merge every batch with stored history and skip duplicates,
+	// so imported months are passed as is
+	History *history = History::instance();
 	int num = 0;
-	foreach(const Protocol &protocol, m_protocols)
-		foreach(const Account &account, protocol)
-			foreach(const Contact &contact, account)
-				total_count += contact.size();
-	emit saveMaxValueChanged(total_count);
-	QDir dir = SystemInfo::getDir(SystemInfo::HistoryDir);
-	if(!dir.exists())
-		dir.mkpath(dir.absolutePath());
-
-	QHash<QString, Protocol>::const_iterator protocol = m_protocols.constBegin();
-	for(; protocol != m_protocols.constEnd(); protocol++)
-	{
-		QHash<QString,Account>::const_iterator account = protocol.value().constBegin();
-		for(; account != protocol.value().constEnd(); account++)
-		{
-			QString account_path = protocol.key();
-			account_path += ".";
-			account_path += quoteByFormat(account.key(), format);
-			if(!dir.exists(account_path))
-				dir.mkdir(account_path);
-			QDir account_dir = dir.filePath(account_path);
-			QHash<QString,Contact>::const_iterator contact = account.value().constBegin();
-			for(; contact != account.value().constEnd(); contact++)
-			{
-				QMap<qint64,MessageList>::const_iterator month = contact.value().constBegin();
-				for(; month != contact.value().constEnd(); month++)
-				{
+	for (auto protocol = m_protocols.begin(); protocol != m_protocols.end(); ++protocol) {
+		for (auto account = protocol->begin(); account != protocol->end(); ++account) {
+			for (auto contact = account->begin(); contact != account->end(); ++contact) {
+				History::ContactInfo info;
+				info.protocol = protocol.key();
+				info.account = account.key();
+				info.contact = contact.key();
+				for (auto month = contact->begin(); month != contact->end(); ++month) {
+					history->storeBatch(info, month.value());
+					// Imported month isn't needed anymore
+					month->clear();
 					emit saveValueChanged(++num);
-					QString filename = quoteByFormat(contact.key(), format);
-					filename += ".";
-					filename += QString::number(month.key());
-//					if(format == 'j')
-						filename += ".json";
-//					else
-//						filename += ".log";
-					QFile file(account_dir.filePath(filename));
-//					if(format == 'j')
-					{
-						if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
-							continue;
-						file.write("[\n");
-						bool first = true;
-						foreach(const Message &message, month.value())
-						{
-							if(first)
-								first = false;
-							else
-								file.write(",\n");
-							file.write(" {\n");
-							foreach(const QByteArray &name, message.dynamicPropertyNames())
-							{
-								QByteArray data;
-								if(!Json::generate(data, message.property(name), 2))
-									continue;
-								file.write("  ");
-								file.write(Json::quote(QString::fromUtf8(name)).toUtf8());
-								file.write(": ");
-								file.write(data);
-								file.write(",\n");
-							}
-							file.write("  \"datetime\": \"");
-							QDateTime time = message.time();
-							if(!time.isValid())
-								time = QDateTime::currentDateTime();
-							file.write(time.toString(Qt::ISODate).toLatin1());
-							file.write("\",\n  \"in\": ");
-							file.write(message.isIncoming() ? "true" : "false");
-							file.write(",\n  \"text\": ");
-							file.write(Json::quote(message.text()).toUtf8());
-							file.write("\n }");
-						}
-						file.write("\n]");
-					}
-//					else if(format == 'b')
-//					{
-//						if(!file.open(QIODevice::WriteOnly))
-//							continue;
-//						QDataStream out(&file);
-//						foreach(const Message &msg, month.value())
-//							out << msg.time << msg.type << msg.in << msg.text;
-//					}
 				}
 			}
 		}
@@ -61,7 +61,9 @@ public:
 	inline HistoryImporter *getCurrentClient() const { return m_current_client; }
 	inline qutim *getQutIM() const { return m_qutim; }
 	inline quint64 getMessageNum() const { return m_message_num; }
-	void saveMessages(char format);
+	// Sorts loaded messages and drops duplicates, must be called after import
+	void mergeMessages();
+	void saveMessages();
 	QString finishStr() { if(m_finish.isEmpty()) m_finish = buttonText(QWizard::FinishButton); return m_finish; }
 	QString nextStr() { if(m_next.isEmpty()) m_next = buttonText(QWizard::NextButton); return m_next; }
 	QString dumpStr() { return m_dump; }
@@ -42,6 +42,7 @@ void ImportHistoryPageHepler::run()
 	QTime t;
 	t.start();
 	m_parent->m_parent->getCurrentClient()->loadMessages(m_path);
+	m_parent->m_parent->mergeMessages();
 	m_time = t.elapsed();
 }
 
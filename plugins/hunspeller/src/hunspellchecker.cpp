@@ -41,6 +41,7 @@ HunSpellChecker::HunSpellChecker() :
 {
 	Q_ASSERT(!self);
 	self = this;
+	setProperty("threadSafe", true);
 
 #ifdef Q_WS_WIN
 	m_dictPath = QCoreApplication::applicationDirPath() + "/dicts/";
@@ -64,6 +65,7 @@ HunSpellChecker::~HunSpellChecker()
 
 bool HunSpellChecker::isCorrect(const QString &word) const
 {
+	QMutexLocker locker(&m_mutex);
 	if (!m_speller)
 		return true; //unnecessary underline all words
 	return m_speller->spell(convert(word));
@@ -71,6 +73,7 @@ bool HunSpellChecker::isCorrect(const QString &word) const
 
 QStringList HunSpellChecker::suggest(const QString &word) const
 {
+	QMutexLocker locker(&m_mutex);
 	if(!m_speller)
 		return QStringList();
 	char **selection;
@@ -84,6 +87,7 @@ QStringList HunSpellChecker::suggest(const QString &word) const
 
 void HunSpellChecker::store(const QString &word) const
 {
+	QMutexLocker locker(&m_mutex);
 	if (!m_speller)
 		return;
 	m_speller->add(convert(word));
@@ -117,6 +121,7 @@ QStringList HunSpellChecker::languages() const
 
 void HunSpellChecker::loadSettings(QString lang)
 {
+	QMutexLocker locker(&m_mutex);
 	if (m_speller)
 		delete m_speller;
 	if (lang == QLatin1String("system"))
@@ -129,6 +134,7 @@ void HunSpellChecker::loadSettings(QString lang)
 	} else {
 		m_speller = 0;
 	}
+	locker.unlock();
 	emit dictionaryChanged();
 }
 
@@ -30,6 +30,7 @@
 #include <qutim/spellchecker.h>
 #include <hunspell/hunspell.hxx>
 #include <QObject>
+#include <QMutex>
 
 using namespace qutim_sdk_0_3;
 
@@ -49,6 +50,8 @@ public:
 	void loadSettings(QString lang);
 	QByteArray convert(const QString &word) const;
 private:
+	// Words are checked by worker threads too
+	mutable QMutex m_mutex;
 	Hunspell *m_speller;
 	QString m_dictPath;
 	QTextCodec *m_codec;
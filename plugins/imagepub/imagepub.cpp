@@ -141,50 +141,57 @@ void imagepubPlugin::actionStart()
 
 		uploadwidget->setStatus(tr("Choose file for upload to")+"\n"+serv_name);
 		QString filepath = QFileDialog::getOpenFileName(uploadwidget, tr("Choose file"), settings.value("main/lastdir").toString(), serv_filefilter);
-		QFile file(filepath);
-		fileinfo.setFile(file);
-		QString boundary = "AaB03x";
+		QFile *file = new QFile(filepath);
+		fileinfo.setFile(*file);
 		QString filename = fileinfo.fileName();
 		if (filepath.isEmpty()) {
+			delete file;
 			uploadwidget->setStatus(tr("Canceled"));
 			removeUploadWidget();
 		}
 		else if (fileinfo.size()==0) {
+			delete file;
 			uploadwidget->setStatus(tr("File size is null"));
 		}
-		else if (file.open(QIODevice::ReadOnly)) {
+		else if (file->open(QIODevice::ReadOnly)) {
 			settings.setValue("main/lastdir", fileinfo.dir().path());
-			QByteArray mpData;
+			// File is streamed by multipart itself instead of being read into memory
+			QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
 
 			if (serv_postdata.length()>0) {
 				foreach (QString poststr, serv_postdata.split("&")) {
 					QStringList postpair = poststr.split("=");
-					mpData.append("--" + boundary + "\r\n");
-					mpData.append("Content-Disposition: form-data; name=\"" + postpair[0] + "\"\r\n");
-					mpData.append("\r\n" + postpair[1] + "\r\n");
+					QHttpPart part;
+					part.setHeader(QNetworkRequest::ContentDispositionHeader,
+								   "form-data; name=\"" + postpair[0] + "\"");
+					part.setBody(postpair.value(1).toUtf8());
+					multiPart->append(part);
 				}
 			}
 
-			mpData.append("--" + boundary + "\r\n");
-			mpData.append("Content-Disposition: form-data; name=\"" + serv_fileinput + "\"; filename=\"" + filename.toUtf8() + "\"\r\n");
-			mpData.append("Content-Transfer-Encoding: binary\r\n");
-			mpData.append("\r\n");
-			mpData.append(file.readAll());
-			mpData.append("\r\n--" + boundary + "--\r\n");
-			file.close();
+			QHttpPart filePart;
+			filePart.setHeader(QNetworkRequest::ContentDispositionHeader,
+							   QByteArray("form-data; name=\"" + serv_fileinput.toUtf8()
+										  + "\"; filename=\"" + filename.toUtf8() + "\""));
+			filePart.setRawHeader("Content-Transfer-Encoding", "binary");
+			filePart.setBodyDevice(file);
+			file->setParent(multiPart);
+			multiPart->append(filePart);
 
 			netreq.setRawHeader("User-Agent", "qutIM ImagePub plugin");
-			netreq.setRawHeader("Content-Type", "multipart/form-data, boundary=" + boundary.toLatin1());
 			netreq.setRawHeader("Cache-Control", "no-cache");
 			netreq.setRawHeader("Accept", "*/*");
-			netreq.setRawHeader("Content-Length", QString::number(mpData.length()).toLatin1());
 
 			uploadwidget->setFilename(filename);
 			uploadwidget->timeStart();
 
-			QNetworkReply* netrp = netman->post(netreq, mpData);
+			QNetworkReply* netrp = netman->post(netreq, multiPart);
+			multiPart->setParent(netrp);
 			connect(netrp, SIGNAL(uploadProgress(qint64, qint64)), uploadwidget, SLOT(progress(qint64, qint64)));
 		}
+		else {
+			delete file;
+		}
 	}
 }
 
@@ -45,9 +45,14 @@ uploadDialog::~uploadDialog()
 void uploadDialog::timeStart() {
 	ui.progressBar->setValue(0);
 	utime.start();
+	ptime = QTime();
 }
 
 void uploadDialog::progress(qint64 cBytes, qint64 totalBytes) {
+	// Progress is reported for every written block, labels are updated a few times per second
+	if (cBytes < totalBytes && !ptime.isNull() && ptime.elapsed() < 250)
+		return;
+	ptime.start();
 	ui.labelStatus->setText(tr("Uploading..."));
 	ui.labelProgress->setText(QString(tr("Progress: %1 / %2")).arg(QString::number(cBytes)).arg(QString::number(totalBytes)));
 	ui.progressBar->setMaximum(totalBytes);
@@ -45,6 +45,7 @@ private:
 	Ui::uploadDialogClass ui;
 	QDesktopWidget desktop;
 	QTime utime;
+	QTime ptime;
 
 signals:
 	void canceled();
@@ -6,7 +6,7 @@ namespace KineticPopups {
 using namespace qutim_sdk_0_3;
 
 NotifyList::NotifyList(QObject *parent) :
-    QObject(parent)
+    QAbstractListModel(parent)
 {
     m_backend = Backend::instance();
 
@@ -19,28 +19,58 @@ NotifyList::NotifyList(QObject *parent) :
     }
 }
 
-QQmlListProperty<Notify> NotifyList::notifies()
+int NotifyList::count() const
 {
-    return QQmlListProperty<Notify>(this, this, nullptr, list_count, list_at, nullptr);
+    return m_notifies.size();
 }
 
-int NotifyList::list_count(QQmlListProperty<Notify> *list)
+Notify *NotifyList::get(int index) const
 {
-    return static_cast<NotifyList *>(list->object)->m_notifies.size();
+    return m_notifies.value(index);
 }
 
-Notify *NotifyList::list_at(QQmlListProperty<Notify> *list, int index)
+int NotifyList::rowCount(const QModelIndex &parent) const
 {
-    return static_cast<NotifyList *>(list->object)->m_notifies.at(index);
+    return parent.isValid() ? 0 : m_notifies.size();
+}
+
+QVariant NotifyList::data(const QModelIndex &index, int role) const
+{
+    Notify *notify = m_notifies.value(index.row());
+    if (!notify)
+        return QVariant();
+
+    switch (role) {
+    case NotifyRole:
+        return QVariant::fromValue<QObject *>(notify);
+    case Qt::DisplayRole:
+    case TitleRole:
+        return notify->title();
+    case TextRole:
+        return notify->text();
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> NotifyList::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(NotifyRole, "notify");
+    roles.insert(TitleRole, "title");
+    roles.insert(TextRole, "text");
+    return roles;
 }
 
 void NotifyList::onNotificationAdded(Notification *notification)
 {
     Notify *notify = new Notify(notification);
 
+    beginInsertRows(QModelIndex(), m_notifies.size(), m_notifies.size());
     m_notifies << notify;
+    endInsertRows();
     emit notifyAdded(notify);
-    emit notifiesChanged();
+    emit countChanged(m_notifies.size());
 }
 
 void NotifyList::onNotificationRemoved(Notification *notification)
@@ -48,9 +78,11 @@ void NotifyList::onNotificationRemoved(Notification *notification)
     for (int i = 0; i < m_notifies.size(); ++i) {
         Notify *notify = m_notifies.at(i);
         if (notify->notification() == notification) {
+            beginRemoveRows(QModelIndex(), i, i);
             m_notifies.removeAt(i);
+            endRemoveRows();
             emit notifyRemoved(notify);
-            emit notifiesChanged();
+            emit countChanged(m_notifies.size());
 
             notify->deleteLater();
             --i;
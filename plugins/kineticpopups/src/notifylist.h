@@ -1,32 +1,41 @@
 #ifndef KINETICPOPUPS_NOTIFYLIST_H
 #define KINETICPOPUPS_NOTIFYLIST_H
 
-#include <QObject>
-#include <QQmlListProperty>
+#include <QAbstractListModel>
+#include <QPointer>
 #include "notify.h"
 
 namespace KineticPopups {
 
 class Backend;
 
-class NotifyList : public QObject
+// Rows are changed one by one, so views update only affected delegates
+class NotifyList : public QAbstractListModel
 {
     Q_OBJECT
-    Q_PROPERTY(QQmlListProperty<KineticPopups::Notify> notifies READ notifies NOTIFY notifiesChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
 public:
+    enum Roles {
+        NotifyRole = Qt::UserRole,
+        TitleRole,
+        TextRole
+    };
+
     explicit NotifyList(QObject *parent = 0);
 
-    QQmlListProperty<Notify> notifies();
+    int count() const;
+    Q_INVOKABLE KineticPopups::Notify *get(int index) const;
 
-protected:
-    static int list_count(QQmlListProperty<Notify> *list);
-    static Notify *list_at(QQmlListProperty<Notify> *list, int index);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
 
+protected:
     void onNotificationAdded(qutim_sdk_0_3::Notification *notification);
     void onNotificationRemoved(qutim_sdk_0_3::Notification *notification);
 
 signals:
-    void notifiesChanged();
+    void countChanged(int count);
     void notifyAdded(Notify *notify);
     void notifyRemoved(Notify *notify);
     
@@ -40,9 +40,12 @@ Window {
             function show() {
                 hideAnimation.stop();
                 showAnimation.start();
+                if (timeout.timeout > 0)
+                    timeoutTimer.restart();
             }
             
             function hide() {
+                timeoutTimer.stop();
                 showAnimation.stop();
                 hideAnimation.start();
             }
@@ -78,10 +81,7 @@ Window {
                     value: false
                 }
                 ScriptAction {
-                    script: {
-                        popup.window.destroy()
-                        popup.destroy()
-                    }
+                    script: Logic.releasePopup(popup)
                 }
             }
 
@@ -103,13 +103,9 @@ Window {
             }
 
             Timer {
-                interval: {
-                    if(timeout.timeout > 0)
-                        return timeout.timeout
-                    else stop();
-                }
+                id: timeoutTimer
+                interval: timeout.timeout
                 repeat: false
-                running: true
                 onTriggered: Logic.removePopup(popup)
             }
 
@@ -126,6 +122,6 @@ Window {
         onNotifyRemoved: Logic.removePopup(notify)
     }
 
-    Component.onCompleted: Logic.init(list.notifies)
+    Component.onCompleted: Logic.init(list)
     Component.onDestruction: Logic.deinit()
 }
@@ -192,6 +192,15 @@ Window {
         return false;
     }
     
+    // Popup windows are pooled, so they are cleaned instead of destroyed
+    function reset() {
+        window.notifies = [];
+        body.text = "";
+        subject.text = "";
+        actions.model = null;
+        image.source = "images/qutim.svg";
+    }
+
     function removeAll() {
         var notifies = window.notifies;
         window.notifies = [];
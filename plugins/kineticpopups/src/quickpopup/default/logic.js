@@ -1,7 +1,13 @@
 var popups = [];
+// Hidden popups ready to be shown with another notify
+var pool = [];
+// Notifies waiting for a free place on the screen
+var queue = [];
 
 var MARGIN = 20;
 var DURATION = 600;
+var POOL_SIZE = 4;
+var MAX_VISIBLE = 5;
 
 function relayoutItems() {
     var x = root.screenWidth;
@@ -26,8 +32,24 @@ function relayoutItems() {
     }
 }
 
-function addPopup(notify) {
-    var popup = animationComponent.createObject();
+function takePopup() {
+    if (pool.length)
+        return pool.pop();
+    return animationComponent.createObject();
+}
+
+function releasePopup(popup) {
+    popup.window.reset();
+    if (pool.length < POOL_SIZE) {
+        pool.push(popup);
+    } else {
+        popup.window.destroy();
+        popup.destroy();
+    }
+}
+
+function showPopup(notify) {
+    var popup = takePopup();
     popup.window.addNotify(notify);
 
     popups.push(popup);
@@ -35,9 +57,28 @@ function addPopup(notify) {
     popup.show();
 }
 
+function showQueued() {
+    while (queue.length && popups.length < MAX_VISIBLE)
+        showPopup(queue.shift());
+}
+
+function addPopup(notify) {
+    if (popups.length >= MAX_VISIBLE)
+        queue.push(notify);
+    else
+        showPopup(notify);
+}
+
 function removePopup(notify) {
     console.log('Notification removed: ', notify ? notify.title : undefined)
 
+    for (var j = 0; j < queue.length; ++j) {
+        if (queue[j] === notify) {
+            queue.splice(j, 1);
+            --j;
+        }
+    }
+
     for (var i = 0; i < popups.length; ++i) {
         var popup = popups[i];
         if (popup === notify) {
@@ -54,30 +95,33 @@ function removePopup(notify) {
     }
 
     relayoutItems();
+    showQueued();
 }
 
-function init(notifies) {
+function init(list) {
     var i;
-    
-    for (i = 0; i < notifies.length; ++i) {
-        var notify = notifies[i];
-        var popup = animationComponent.createObject();
-        popup.window.addNotify(notify);
 
-        popups.push(popup);
-    }
-    relayoutItems();
-    
-    for (i = 0; i < popups.length; ++i)
-        popups[i].show();
+    for (i = 0; i < POOL_SIZE; ++i)
+        pool.push(animationComponent.createObject());
+
+    for (i = 0; i < list.count; ++i)
+        addPopup(list.get(i));
+}
+
+function destroyPopup(popup) {
+    popup.window.notifies = [];
+    popup.window.destroy();
+    popup.destroy();
 }
 
 function deinit() {
-    for (var i = 0; i < popups.length; ++i) {
-        var popup = popups[i];
-        popup.window.notifies = [];
-        popup.window.destroy();
-        popup.destroy();
-    }
+    var i;
+
+    for (i = 0; i < popups.length; ++i)
+        destroyPopup(popups[i]);
+    for (i = 0; i < pool.length; ++i)
+        destroyPopup(pool[i]);
     popups = [];
+    pool = [];
+    queue = [];
 }
@@ -64,7 +64,7 @@ QVariant LinuxIntegration::doProcess(SystemIntegration::Operation act, const QVa
 		QAbstractSocket *socket = qobject_cast<QAbstractSocket*>(data.value<QObject*>());
 		if (socket) {
 			connect(socket, SIGNAL(connected()), SLOT(onSocketConnected()), Qt::UniqueConnection);
-			keepAliveSocket(socket->socketDescriptor());
+			keepAliveSocket(socket);
 		}
 	}
 	return QVariant();
@@ -84,22 +84,32 @@ bool LinuxIntegration::canHandle(SystemIntegration::Operation operation) const
 void LinuxIntegration::onSocketConnected()
 {
 	QAbstractSocket *socket = sender_cast<QAbstractSocket*>(sender());
-	keepAliveSocket(socket->socketDescriptor());
+	keepAliveSocket(socket);
 }
 
-void LinuxIntegration::keepAliveSocket(int fd)
+static int keepAliveValue(QAbstractSocket *socket, const char *name, int defaultValue)
 {
+	// Set by SocketOptions from the account's config, zero means default
+	const int value = socket->property(name).toInt();
+	return value > 0 ? value : defaultValue;
+}
+
+void LinuxIntegration::keepAliveSocket(QAbstractSocket *socket)
+{
+	const int fd = socket->socketDescriptor();
 	if (fd == -1)
 		return;
 	int enableKeepAlive = 1;
 	setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enableKeepAlive, sizeof(enableKeepAlive));
 
-	int maxIdle = 15; // seconds
+	int maxIdle = keepAliveValue(socket, "keepAliveIdle", 15); // seconds
 	setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &maxIdle, sizeof(maxIdle));
 
-	int count = 3;  // send up to 3 keepalive packets out, then disconnect if no response
+	// send up to 3 keepalive packets out, then disconnect if no response
+	int count = keepAliveValue(socket, "keepAliveCount", 3);
 	setsockopt(fd, SOL_TCP, TCP_KEEPCNT, &count, sizeof(count));
 
-	int interval = 2;   // send a keepalive packet out every 2 seconds (after the idle period)
+	// send a keepalive packet out every 2 seconds (after the idle period)
+	int interval = keepAliveValue(socket, "keepAliveInterval", 2);
 	setsockopt(fd, SOL_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
 }
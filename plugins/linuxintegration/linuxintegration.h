@@ -44,7 +44,7 @@ protected:
 private slots:
 	void onSocketConnected();
 private:
-	static void keepAliveSocket(int fd);
+	static void keepAliveSocket(QAbstractSocket *socket);
 };
 
 #endif // LINUXINTEGRATION_H
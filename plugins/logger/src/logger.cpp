@@ -22,54 +22,33 @@
 ** $QUTIM_END_LICENSE$
 **
 ****************************************************************************/
-// I don't like msvc's "safe" functions, so I force silence
-#define _CRT_SECURE_NO_DEPRECATE
-
 #include "logger.h"
+#include "logwriter.h"
 #include <qutim/config.h>
 #include <qutim/systeminfo.h>
 #include <qutim/debug.h>
-#include <cstdio>
-#include <QTime>
+#include <cstdlib>
 #include <qutim/icon.h>
 #include <QCheckBox>
 
 namespace Logger
 {
-using namespace std;
-static FILE *logfile = NULL;
-//ofstream logfile;
+static QAtomicPointer<LogWriter> writer;
+// Number of threads inside the handler, writer is deleted only when none is
+static QAtomicInt handlerUsers;
 
-void SimpleLoggingHandler(QtMsgType type, const QMessageLogContext &log, const QString &msgData)
+// Messages are only queued here, formatting and file IO happen in the writer thread
+void AsyncLoggingHandler(QtMsgType type, const QMessageLogContext &context, const QString &msgData)
 {
-	Q_UNUSED(log)
-	if (!logfile) {
+	handlerUsers.fetchAndAddOrdered(1);
+	if (LogWriter *current = writer.loadAcquire()) {
+		current->append(type, context, msgData);
 		if (type == QtFatalMsg)
-			abort();
-		return;
+			current->flush();
 	}
-	QByteArray currentTime = QTime::currentTime().toString().toLatin1();
-	QByteArray msg = msgData.toUtf8();
-	switch (type) {
-	default:
-	case QtDebugMsg:
-		fprintf(logfile, "%s Debug: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() << " Debug: " << msg << "\n";
-		break;
-	case QtCriticalMsg:
-		fprintf(logfile, "%s Critical: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() << " Critical: " << msg << "\n";
-		break;
-	case QtWarningMsg:
-		fprintf(logfile, "%s Warning: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() << " Warning: " << msg << "\n";
-		break;
-	case QtFatalMsg:
-		fprintf(logfile, "%s Fatal: %s\n", currentTime.constData(), msg.constData());
-//		logfile << QTime::currentTime().toString().toLatin1().data() <<  " Fatal: " << msg << "\n";
+	handlerUsers.fetchAndAddOrdered(-1);
+	if (type == QtFatalMsg)
 		abort();
-	}
-	fflush(stdin);
 }
 
 void LoggerPlugin::init()
@@ -91,8 +70,11 @@ bool LoggerPlugin::load()
 	QString path = config.value(QLatin1String("path"),
 								SystemInfo::getPath(SystemInfo::ConfigDir).append("/qutim.log"));
 	bool enable = config.value(QLatin1String("enable"), false);
+	LogWriter *current = new LogWriter;
+	writer.storeRelease(current);
 	reloadSettings();
-	qInstallMessageHandler(SimpleLoggingHandler);
+	current->start(QThread::LowPriority);
+	qInstallMessageHandler(AsyncLoggingHandler);
 	qDebug() << tr("New session started, happy debuging ^_^");
 
 	AutoSettingsItem *settingsItem = new AutoSettingsItem(Settings::Plugin,
@@ -120,30 +102,20 @@ void LoggerPlugin::reloadSettings()
 	QString path = config.value(QLatin1String("path"),
 								SystemInfo::getPath(SystemInfo::ConfigDir).append("/qutim.log"));
 	bool enable = config.value(QLatin1String("enable"), true);
-	if (enable && !logfile) {
-		QFileInfo fileInfo(path);
-		if (maxFileSize != -1 && fileInfo.size() > maxFileSize)
-			logfile = fopen(path.toLocal8Bit(), "w");
-//			logfile.open(path.toLocal8Bit(), ios::out | ios::trunc);
-		else
-			logfile = fopen(path.toLocal8Bit(), "a");
-//			logfile.open(path.toLocal8Bit(), ios::app);
-	} else if (!enable && logfile) {
-		fflush(logfile);
-		fclose(logfile);
-		logfile = NULL;
-	}
+	if (LogWriter *current = writer.loadAcquire())
+		current->setFile(path, maxFileSize, enable);
 }
 
 bool LoggerPlugin::unload()
 {
 	if (m_settingsItem) {
-		if (logfile) {
-			fflush(logfile);
-			fclose(logfile);
-			logfile = NULL;
-		}
+		// Stop new writes first, other threads may still be inside the handler
+		LogWriter *current = writer.fetchAndStoreOrdered(NULL);
 		qInstallMessageHandler(NULL);
+		while (handlerUsers.fetchAndAddOrdered(0))
+			QThread::yieldCurrentThread();
+		current->stop();
+		delete current;
 		Settings::removeItem(m_settingsItem);
 		m_settingsItem = 0;
 		return true;
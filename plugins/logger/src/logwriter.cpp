@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "logwriter.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+
+namespace Logger
+{
+
+enum { RecentCount = 512, MaxLogFiles = 3, DrainInterval = 250 };
+
+LogRing::LogRing()
+{
+}
+
+bool LogRing::push(LogEntry &entry)
+{
+	const uint head = m_head.load();
+	if (head - uint(m_tail.loadAcquire()) >= uint(Capacity)) {
+		dropped.ref();
+		return false;
+	}
+	LogEntry &slot = m_entries[head % Capacity];
+	slot.time = entry.time;
+	slot.type = entry.type;
+	slot.category = entry.category;
+	qSwap(slot.message, entry.message);
+	m_head.storeRelease(head + 1);
+	return true;
+}
+
+bool LogRing::pop(LogEntry &entry)
+{
+	const uint tail = m_tail.load();
+	if (tail == uint(m_head.loadAcquire()))
+		return false;
+	LogEntry &slot = m_entries[tail % Capacity];
+	entry.time = slot.time;
+	entry.type = slot.type;
+	entry.category = slot.category;
+	entry.message.clear();
+	qSwap(entry.message, slot.message);
+	m_tail.storeRelease(tail + 1);
+	return true;
+}
+
+bool LogRing::isEmpty() const
+{
+	return m_tail.load() == m_head.loadAcquire();
+}
+
+LogWriter::LogWriter() : m_running(1), m_fileEnabled(0), m_maxFileSize(-1), m_recent(RecentCount), m_recentIndex(0)
+{
+}
+
+LogWriter::~LogWriter()
+{
+	stop();
+}
+
+void LogWriter::setFile(const QString &path, qint64 maxFileSize, bool enabled)
+{
+	QMutexLocker locker(&m_writeMutex);
+	drain();
+	if (m_file.isOpen())
+		m_file.close();
+	m_path = path;
+	m_maxFileSize = maxFileSize;
+	m_fileEnabled.storeRelease(enabled);
+	if (!enabled)
+		return;
+	if (maxFileSize != -1 && QFileInfo(path).size() > maxFileSize)
+		rotate();
+	m_file.setFileName(path);
+	m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+LogRing *LogWriter::localRing()
+{
+	if (RingHolder *holder = m_local.localData())
+		return holder->ring.data();
+	RingHolder *holder = new RingHolder;
+	holder->ring = LogRingPtr::create();
+	{
+		QMutexLocker locker(&m_ringsMutex);
+		m_rings << holder->ring;
+	}
+	m_local.setLocalData(holder);
+	return holder->ring.data();
+}
+
+void LogWriter::append(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+	// Only warnings and errors are kept for crash dump, if nothing is logged
+	if (type == QtDebugMsg && !m_fileEnabled.loadAcquire())
+		return;
+	LogEntry entry;
+	entry.time = QDateTime::currentMSecsSinceEpoch();
+	entry.type = type;
+	entry.category = context.category;
+	entry.message = message;
+	localRing()->push(entry);
+	if (type != QtDebugMsg)
+		m_wakeUp.wakeOne();
+}
+
+void LogWriter::flush()
+{
+	QMutexLocker locker(&m_writeMutex);
+	drain();
+	if (!m_file.isOpen())
+		dumpRecent();
+}
+
+void LogWriter::stop()
+{
+	if (!isRunning())
+		return;
+	m_running.storeRelease(0);
+	m_wakeUp.wakeOne();
+	wait();
+	// Regular shutdown, so nothing is dumped for disabled file
+	QMutexLocker locker(&m_writeMutex);
+	drain();
+}
+
+void LogWriter::run()
+{
+	while (m_running.loadAcquire()) {
+		m_wakeUpMutex.lock();
+		m_wakeUp.wait(&m_wakeUpMutex, DrainInterval);
+		m_wakeUpMutex.unlock();
+		QMutexLocker locker(&m_writeMutex);
+		drain();
+	}
+}
+
+void LogWriter::drain()
+{
+	QList<LogRingPtr> rings;
+	{
+		QMutexLocker locker(&m_ringsMutex);
+		rings = m_rings;
+	}
+	m_batch.clear();
+	LogEntry entry;
+	foreach (const LogRingPtr &ring, rings) {
+		while (ring->pop(entry))
+			m_batch << entry;
+		if (int dropped = ring->dropped.fetchAndStoreRelaxed(0)) {
+			entry.type = QtWarningMsg;
+			entry.category = "logger";
+			entry.message = QString::fromLatin1("%1 messages were dropped").arg(dropped);
+			m_batch << entry;
+		}
+		if (ring->orphaned.loadAcquire() && ring->isEmpty()) {
+			QMutexLocker locker(&m_ringsMutex);
+			m_rings.removeOne(ring);
+		}
+	}
+	if (m_batch.isEmpty())
+		return;
+	// Rings are drained one by one, so restore the global order
+	std::stable_sort(m_batch.begin(), m_batch.end(), [] (const LogEntry &a, const LogEntry &b) {
+		return a.time < b.time;
+	});
+	foreach (const LogEntry &entry, m_batch)
+		write(entry);
+	if (m_file.isOpen()) {
+		m_file.flush();
+		if (m_maxFileSize != -1 && m_file.size() > m_maxFileSize) {
+			m_file.close();
+			rotate();
+			m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+		}
+	}
+}
+
+void LogWriter::write(const LogEntry &entry)
+{
+	const char *type;
+	switch (entry.type) {
+	default:
+	case QtDebugMsg:
+		type = " Debug: ";
+		break;
+	case QtWarningMsg:
+		type = " Warning: ";
+		break;
+	case QtCriticalMsg:
+		type = " Critical: ";
+		break;
+	case QtFatalMsg:
+		type = " Fatal: ";
+		break;
+	}
+	QByteArray &line = m_recent[m_recentIndex];
+	m_recentIndex = (m_recentIndex + 1) % RecentCount;
+	line = QDateTime::fromMSecsSinceEpoch(entry.time).time().toString(QLatin1String("hh:mm:ss.zzz")).toLatin1();
+	line += type;
+	if (entry.category && *entry.category) {
+		line += '[';
+		line += entry.category;
+		line += "] ";
+	}
+	line += entry.message.toUtf8();
+	line += '\n';
+	if (m_file.isOpen())
+		m_file.write(line);
+}
+
+void LogWriter::rotate()
+{
+	for (int i = MaxLogFiles - 1; i > 0; --i) {
+		const QString to = m_path + QLatin1Char('.') + QString::number(i);
+		const QString from = i > 1 ? m_path + QLatin1Char('.') + QString::number(i - 1) : m_path;
+		QFile::remove(to);
+		QFile::rename(from, to);
+	}
+}
+
+void LogWriter::dumpRecent()
+{
+	// File logging is disabled, but last messages are still worth saving
+	// if the application is going down
+	if (m_path.isEmpty())
+		return;
+	QFile dump(m_path + QLatin1String(".crash"));
+	if (!dump.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return;
+	for (int i = 0; i < RecentCount; ++i)
+		dump.write(m_recent.at((m_recentIndex + i) % RecentCount));
+}
+
+}
@@ -0,0 +1,119 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QThread>
+#include <QThreadStorage>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QVector>
+
+namespace Logger
+{
+
+struct LogEntry
+{
+	qint64 time;
+	QtMsgType type;
+	// Categories are QUTIM_PLUGIN_NAME literals, so pointer is enough
+	const char *category;
+	QString message;
+};
+
+// Single producer, single consumer queue, one per logging thread
+class LogRing
+{
+public:
+	enum { Capacity = 1024 };
+
+	LogRing();
+	bool push(LogEntry &entry);
+	bool pop(LogEntry &entry);
+	bool isEmpty() const;
+
+	QAtomicInt dropped;
+	QAtomicInt orphaned;
+private:
+	QAtomicInt m_head;
+	QAtomicInt m_tail;
+	LogEntry m_entries[Capacity];
+};
+
+typedef QSharedPointer<LogRing> LogRingPtr;
+
+class LogWriter : public QThread
+{
+public:
+	LogWriter();
+	~LogWriter();
+
+	// Disabled file is only written if the application crashes, debug
+	// messages are dropped without queueing then
+	void setFile(const QString &path, qint64 maxFileSize, bool enabled);
+	void append(QtMsgType type, const QMessageLogContext &context, const QString &message);
+	// Writes everything pending synchronously, used right before abort
+	void flush();
+	void stop();
+
+protected:
+	void run();
+
+private:
+	struct RingHolder
+	{
+		LogRingPtr ring;
+		~RingHolder() { ring->orphaned.storeRelease(1); }
+	};
+
+	LogRing *localRing();
+	void drain();
+	void write(const LogEntry &entry);
+	void rotate();
+	void dumpRecent();
+
+	QThreadStorage<RingHolder *> m_local;
+	QMutex m_ringsMutex;
+	QList<LogRingPtr> m_rings;
+	// Only one consumer may drain rings at once
+	QMutex m_writeMutex;
+	QWaitCondition m_wakeUp;
+	QMutex m_wakeUpMutex;
+	QAtomicInt m_running;
+	QAtomicInt m_fileEnabled;
+	QFile m_file;
+	QString m_path;
+	qint64 m_maxFileSize;
+	QVector<QByteArray> m_recent;
+	int m_recentIndex;
+	QVector<LogEntry> m_batch;
+};
+
+}
+
+#endif // LOGWRITER_H
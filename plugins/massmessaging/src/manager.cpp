@@ -55,7 +55,18 @@ public:
 	}
 };
 
-Manager::Manager(QObject* parent): QObject(parent)
+enum {
+	// Accounts are fed while their queue is drained within this time
+	MaxQueueAhead = 1000,
+	// Don't block the event loop for too long with one account
+	MaxBurst = 32,
+	MaxRetries = 5,
+	RetryDelay = 2000,
+	MaxRetryDelay = 60000
+};
+
+Manager::Manager(QObject* parent): QObject(parent),
+	m_interval(15000), m_total(0), m_completed(0), m_failed(0)
 {
 	m_model =  new QStandardItemModel(this);
 }
@@ -67,7 +78,7 @@ QAbstractItemModel* Manager::model() const
 void Manager::reload()
 {
 	m_model->clear();
-	m_receivers.clear();
+	m_queues.clear();
 	m_contacts.clear();
 	foreach(Protocol *proto, Protocol::all()) {
 		QStandardItem *proto_item = new MessagingItem(proto->id());
@@ -94,40 +105,39 @@ void Manager::reload()
 	}
 }
 
-QString Manager::parseText(const QString& msg, Contact* c)
-{
-	QString parsed_message = msg;
-	parsed_message.replace("{receiver}",c->title());
-	parsed_message.replace("{sender}",c->account()->name());
-	parsed_message.replace("{time}",QTime::currentTime().toString());
-	return parsed_message;
-}
-
-
 void Manager::start(const QString &message, int interval)
 {
-	m_message = message;
+	m_template = MessageTemplate(message);
+	m_interval = qMax(0, interval);
+	m_queues.clear();
+	m_total = m_completed = m_failed = 0;
+	m_lastReceiver.clear();
 	foreach (QStandardItem *item, m_contacts) {
 		Qt::CheckState state = static_cast<Qt::CheckState>(item->data(Qt::CheckStateRole).value<int>());
-		if (state == Qt::Checked)
-			m_receivers.enqueue(item);
-	}
-	m_total_item_count = m_receivers.count();
-	if (m_receivers.count()) {
-		m_timer.start(interval, this);
-		QTimerEvent ev(m_timer.timerId());
-		timerEvent(&ev);
+		if (state != Qt::Checked)
+			continue;
+		if (Contact *c = item->data(Qt::UserRole).value<Contact *>()) {
+			AccountQueue &queue = m_queues[c->account()];
+			queue.account = c->account();
+			queue.contacts.enqueue(c);
+			++m_total;
+		}
 	}
-	else
+	if (m_queues.isEmpty()) {
 		emit finished(false);
-
+		return;
+	}
+	m_clock.start();
+	processQueues();
 }
+
 void Manager::stop()
 {
 	m_timer.stop();
-	m_receivers.clear();
+	m_queues.clear();
 	emit finished(true);
 }
+
 Manager::~Manager()
 {
 
@@ -136,25 +146,72 @@ Manager::~Manager()
 void Manager::timerEvent(QTimerEvent* ev)
 {
 	if (ev->timerId() == m_timer.timerId()) {
-		if (m_receivers.count()) {
-			QStandardItem *item = m_receivers.dequeue();
-			if (Contact *c = item->data(Qt::UserRole).value<Contact *>()) {
-				Message msg (parseText(m_message,c));
-				c->sendMessage(msg);
-				emit update(m_total_item_count - m_receivers.count(),
-							m_total_item_count,
-							c->title());
+		m_timer.stop();
+		processQueues();
+		return;
+	}
+	QObject::timerEvent(ev);
+}
+
+void Manager::processQueues()
+{
+	const qint64 now = m_clock.elapsed();
+	qint64 next = -1;
+	for (QHash<Account*, AccountQueue>::iterator it = m_queues.begin(); it != m_queues.end();) {
+		AccountQueue &queue = it.value();
+		if (!queue.account) {
+			m_failed += queue.contacts.size();
+			it = m_queues.erase(it);
+			continue;
+		}
+		for (int sent = 0; !queue.contacts.isEmpty() && queue.nextTime <= now; ++sent) {
+			const QVariant delay = queue.account->property("sendDelay");
+			if (delay.isValid() && delay.toInt() > MaxQueueAhead) {
+				queue.nextTime = now + delay.toInt() - MaxQueueAhead;
+				break;
+			}
+			if (sent >= MaxBurst)
+				break;
+			Contact *c = queue.contacts.head();
+			if (!c) {
+				queue.contacts.dequeue();
+				++m_failed;
+				continue;
+			}
+			if (c->sendMessage(Message(m_template.expand(c)))) {
+				queue.contacts.dequeue();
+				queue.retries = 0;
+				++m_completed;
+				m_lastReceiver = c->title();
+				if (!delay.isValid())
+					queue.nextTime = now + m_interval;
+			} else if (++queue.retries > MaxRetries) {
+				queue.contacts.dequeue();
+				queue.retries = 0;
+				++m_failed;
+			} else {
+				queue.nextTime = now + qMin(RetryDelay << (queue.retries - 1), int(MaxRetryDelay));
 			}
-			if (!m_receivers.count())
-				stop();
 		}
-		else
-			stop();
+		if (queue.contacts.isEmpty()) {
+			it = m_queues.erase(it);
+			continue;
+		}
+		next = next < 0 ? queue.nextTime : qMin(next, queue.nextTime);
+		++it;
 	}
-	QObject::timerEvent(ev);
+
+	const double rate = now > 0 ? m_completed * 60000.0 / now : 0;
+	emit update(m_completed, m_failed, m_total, rate, m_lastReceiver);
+
+	if (m_queues.isEmpty()) {
+		emit finished(m_failed == 0);
+		return;
+	}
+	m_timer.start(int(qMax<qint64>(0, next - now)), this);
 }
 
 bool Manager::currentState()
 {
-	return m_timer.isActive();
+	return m_timer.isActive() || !m_queues.isEmpty();
 }
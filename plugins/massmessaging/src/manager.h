@@ -28,16 +28,29 @@
 
 #include <QObject>
 #include <QQueue>
+#include <QHash>
+#include <QPointer>
 #include <QBasicTimer>
+#include <QElapsedTimer>
 #include "messaging.h"
+#include "messagetemplate.h"
 
 class QStandardItem;
 class QAbstractItemModel;
 class QStandardItemModel;
 namespace qutim_sdk_0_3 {
+class Account;
 class Contact;
 }
 
+/**
+ * Every account has its own queue, queues are sent concurrently.
+ *
+ * Accounts, which know their outgoing rate limits, report them by "sendDelay"
+ * property: msecs until a message sent now leaves the client. Such accounts
+ * are fed while the delay is short, others get one message per interval.
+ * Messages refused by protocol are retried with exponential backoff.
+ */
 class Manager : public QObject
 {
     Q_OBJECT
@@ -47,22 +60,37 @@ public:
     QAbstractItemModel *model() const;
 public slots:
     void reload();
+    // Interval is used for accounts without rate information
     void start(const QString &message, int interval = 15000);
     void stop();
     bool currentState();
 signals:
-    void update (const uint &completed, const uint &total, const QString &text);
+    // Emitted at most once per pass over the queues, rate is messages per minute
+    void update(int completed, int failed, int total, double rate, const QString &receiver);
     void finished(bool ok);
 private:
+    struct AccountQueue
+    {
+        AccountQueue() : nextTime(0), retries(0) {}
+        QPointer<Account> account;
+        QQueue<QPointer<Contact> > contacts;
+        qint64 nextTime;
+        int retries;
+    };
+
     virtual void timerEvent(QTimerEvent* ev);
-    QString parseText(const QString &msg,Contact *c);
+    void processQueues();
     QList<QStandardItem *> m_contacts;
-    QQueue<QStandardItem *> m_receivers;
+    QHash<Account*, AccountQueue> m_queues;
     QStandardItemModel *m_model;
-    QBasicTimer m_timer; //just simple
-    int m_total_item_count;
-    QString m_message;
+    QBasicTimer m_timer;
+    QElapsedTimer m_clock;
+    MessageTemplate m_template;
+    int m_interval;
+    int m_total;
+    int m_completed;
+    int m_failed;
+    QString m_lastReceiver;
 };
 
 #endif // MANAGER_H
-
@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "messagetemplate.h"
+#include <qutim/contact.h>
+#include <qutim/account.h>
+#include <QTime>
+
+using namespace qutim_sdk_0_3;
+
+MessageTemplate::MessageTemplate() : m_literalSize(0)
+{
+}
+
+MessageTemplate::MessageTemplate(const QString &text) : m_literalSize(0)
+{
+	static const struct { const char *name; Type type; } placeholders[] = {
+		{ "{receiver}", Receiver },
+		{ "{sender}", Sender },
+		{ "{time}", Time }
+	};
+
+	int literalStart = 0;
+	for (int i = 0; i < text.size(); ++i) {
+		if (text.at(i) != QLatin1Char('{'))
+			continue;
+		for (const auto &placeholder : placeholders) {
+			const QLatin1String name(placeholder.name);
+			if (!text.midRef(i).startsWith(name))
+				continue;
+			if (i > literalStart) {
+				Part part = { Literal, text.mid(literalStart, i - literalStart) };
+				m_parts << part;
+				m_literalSize += part.text.size();
+			}
+			Part part = { placeholder.type, QString() };
+			m_parts << part;
+			i += name.size() - 1;
+			literalStart = i + 1;
+			break;
+		}
+	}
+	if (literalStart < text.size()) {
+		Part part = { Literal, text.mid(literalStart) };
+		m_parts << part;
+		m_literalSize += part.text.size();
+	}
+}
+
+QString MessageTemplate::expand(Contact *contact) const
+{
+	QString result;
+	result.reserve(m_literalSize + 64);
+	foreach (const Part &part, m_parts) {
+		switch (part.type) {
+		case Literal:
+			result += part.text;
+			break;
+		case Receiver:
+			result += contact->title();
+			break;
+		case Sender:
+			result += contact->account()->name();
+			break;
+		case Time:
+			result += QTime::currentTime().toString();
+			break;
+		}
+	}
+	return result;
+}
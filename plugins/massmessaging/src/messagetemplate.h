@@ -2,8 +2,7 @@
 **
 ** qutIM - instant messenger
 **
-** Copyright © 2008 Rustam Chakin <qutim.develop@gmail.com>
-** Copyright © 2011 Alexander Kazarin <boiler@co.ru>
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
 **
 *****************************************************************************
 **
@@ -24,40 +23,34 @@
 **
 ****************************************************************************/
 
-#ifndef SQLHISTORYSETTINGS_H
-#define SQLHISTORYSETTINGS_H
+#ifndef MESSAGETEMPLATE_H
+#define MESSAGETEMPLATE_H
 
-#include <QtGui/QWidget>
-#include "ui_historysettings.h"
+#include <QString>
+#include <QVector>
 
-namespace SqlHistoryNamespace {
+namespace qutim_sdk_0_3 {
+class Contact;
+}
 
-class SqlHistorySettings : public QWidget
+// Text with {receiver}, {sender} and {time} placeholders, parsed once
+class MessageTemplate
 {
-    Q_OBJECT
-
 public:
-	SqlHistorySettings(const QString &profile_name,QWidget *parent = 0);
-	~SqlHistorySettings();
-    void loadSettings();
-    void saveSettings();
-    
-private slots:
-	void widgetStateChanged() { changed = true; emit settingsChanged(); }
-	void boxSqlEngineChanged(int);
+	MessageTemplate();
+	explicit MessageTemplate(const QString &text);
 
-signals:
-  	void settingsChanged();
-    void settingsSaved();
+	QString expand(qutim_sdk_0_3::Contact *contact) const;
 
 private:
-	Ui::SqlHistorySettingsClass ui;
-    bool changed;
-    QString m_profile_name;
-
+	enum Type { Literal, Receiver, Sender, Time };
+	struct Part
+	{
+		Type type;
+		QString text;
+	};
+	QVector<Part> m_parts;
+	int m_literalSize;
 };
 
-}
-
-#endif // SQLHISTORYSETTINGS_H
-
+#endif // MESSAGETEMPLATE_H
@@ -52,7 +52,7 @@ MessagingDialog::MessagingDialog() : ui(new Ui::Dialog)
 
 	connect(ui->sendButton,SIGNAL(clicked(bool)),SLOT(onSendButtonClicked()));
 	connect(m_manager,SIGNAL(finished(bool)),SLOT(onManagerFinished(bool)));
-	connect(m_manager,SIGNAL(update(uint,uint,QString)),SLOT(updateProgressBar(uint,uint,QString)));
+	connect(m_manager,SIGNAL(update(int,int,int,double,QString)),SLOT(updateProgressBar(int,int,int,double,QString)));
 }
 
 void MessagingDialog::onSendButtonClicked()
@@ -68,17 +68,19 @@ void MessagingDialog::onSendButtonClicked()
 		m_manager->stop();
 }
 
-void MessagingDialog::updateProgressBar(const uint& completed, const uint& total, const QString& message)
+void MessagingDialog::updateProgressBar(int completed, int failed, int total, double rate, const QString &message)
 {
 	ui->progressBar->setMaximum(total);
-	ui->progressBar->setValue(completed);
+	ui->progressBar->setValue(completed + failed);
 	ui->progressBar->setFormat(tr("Sending message to %1: %v/%m").arg(message));
-	ui->progressBar->setToolTip(tr("Sending message to %1").arg(message));
-	//progressHint->setText(tr("Sending messages: (%2/%3)").arg(completed).arg(total));
-	int secs = (total-completed)*ui->intervalEdit->text().toInt();
-	QTime time;
-	time = time.addSecs(secs);
-	setWindowTitle(tr("Sending message to %1 (%2/%3), time remains: %4").arg(message).arg(completed).arg(total).arg(time.toString()));
+	ui->progressBar->setToolTip(tr("Sending message to %1, %n failed", 0, failed).arg(message));
+	// Remaining time is estimated by measured throughput
+	QTime time(0, 0);
+	if (rate > 0)
+		time = time.addSecs(int((total - completed - failed) * 60 / rate));
+	setWindowTitle(tr("Sending message to %1 (%2/%3, %4 per minute), time remains: %5")
+				   .arg(message).arg(completed).arg(total)
+				   .arg(rate, 0, 'f', 1).arg(time.toString()));
 }
 
 MessagingDialog::~MessagingDialog()
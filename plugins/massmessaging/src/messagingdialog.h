@@ -40,7 +40,7 @@ public:
 	MessagingDialog();
 	~MessagingDialog();
 public slots:
-	void updateProgressBar(const uint &completed, const uint &total, const QString &message);
+	void updateProgressBar(int completed, int failed, int total, double rate, const QString &message);
 private slots:
 	void onSendButtonClicked();
 	void onManagerFinished(bool ok);
@@ -43,6 +43,18 @@ namespace nowplaying {
 		QUrl location;
 	};
 
+	inline bool operator ==(const TrackInfo &a, const TrackInfo &b)
+	{
+		return a.artist == b.artist && a.title == b.title && a.album == b.album
+				&& a.time == b.time && a.trackNumber == b.trackNumber
+				&& a.location == b.location;
+	}
+
+	inline bool operator !=(const TrackInfo &a, const TrackInfo &b)
+	{
+		return !(a == b);
+	}
+
 } 
 }
 
@@ -75,6 +75,8 @@ namespace nowplaying {
 
 	void IcqTuneStatus::removeStatus()
 	{
+		if (currentMessage.isEmpty())
+			return;
 		currentMessage = QString();
 		Event ev(icqChangeXstatusEvent);
 		qApp->sendEvent(m_account, &ev);
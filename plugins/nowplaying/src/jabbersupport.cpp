@@ -63,12 +63,19 @@ namespace nowplaying {
 			tune.insert("title", info.title);
 		if (config.uri)
 			tune.insert("uri", info.location.toString());
+		// Only published fields matter, so changes of hidden ones are not sent
+		if (tune == m_tune)
+			return;
+		m_tune = tune;
 		Event ev(jabberPersonalEvent, "tune", tune, true);
 		qApp->sendEvent(m_account, &ev);
 	}
 
 	void JabberTuneStatus::removeStatus()
 	{
+		if (m_tune.isEmpty())
+			return;
+		m_tune.clear();
 		Event ev(jabberPersonalEvent, "tune", QVariantHash(), true);
 		qApp->sendEvent(m_account, &ev);
 	}
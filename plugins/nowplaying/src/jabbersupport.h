@@ -27,6 +27,7 @@
 
 #include "accounttunestatus.h"
 #include <QHash>
+#include <QVariant>
 
 namespace Ui {
 	class JabberSettings;
@@ -62,6 +63,7 @@ namespace nowplaying {
 	private:
 		JabberSettings m_settings;
 		JabberTuneStatus *m_jabberFactory;
+		QVariantHash m_tune;
 		quint16 jabberPersonalEvent;
 	};
 
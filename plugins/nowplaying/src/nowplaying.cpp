@@ -32,6 +32,7 @@
 #include <qutim/event.h>
 #include <qutim/servicemanager.h>
 #include <QVariantMap>
+#include <QTimerEvent>
 
 namespace qutim_sdk_0_3
 {
@@ -41,8 +42,12 @@ namespace nowplaying
 
 NowPlaying *NowPlaying::self;
 
+// Players emit a burst of changes while tracks are skipped, only the state
+// which stays for this interval is published to accounts
+enum { UpdateDelay = 1500 };
+
 NowPlaying::NowPlaying() :
-	m_player(0), m_isWorking(false)
+	m_player(0), m_pendingPlaying(false), m_currentPlaying(false), m_isWorking(false)
 {
 	Q_ASSERT(!self);
 	self = this;
@@ -122,7 +127,9 @@ bool NowPlaying::eventFilter(QObject *obj, QEvent *ev)
 		static const quint16 trackInfoId = TrackInfoEvent::eventId();
 		static const quint16 stateId = StateEvent::eventId();
 		if (static_cast<Event*>(ev)->id == trackInfoId) {
-			setStatuses(static_cast<TrackInfoEvent*>(ev)->trackInfo());
+			m_pendingInfo = static_cast<TrackInfoEvent*>(ev)->trackInfo();
+			m_pendingPlaying = true;
+			scheduleUpdate();
 			return true;
 		} else if (static_cast<Event*>(ev)->id == stateId) {
 			playingStatusChanged(static_cast<StateEvent*>(ev)->isPlaying());
@@ -221,21 +228,49 @@ void NowPlaying::stopStartActionTrigged()
 
 void NowPlaying::playingStatusChanged(bool isPlaying)
 {
-	if(!isPlaying)
-		clearStatuses();
-	else
+	if (!isPlaying) {
+		m_pendingPlaying = false;
+		scheduleUpdate();
+	} else {
 		m_player->requestTrackInfo();
+	}
+}
+
+void NowPlaying::scheduleUpdate()
+{
+	m_updateTimer.start(UpdateDelay, this);
+}
+
+void NowPlaying::timerEvent(QTimerEvent *ev)
+{
+	if (ev->timerId() != m_updateTimer.timerId()) {
+		Plugin::timerEvent(ev);
+		return;
+	}
+	m_updateTimer.stop();
+	if (!m_pendingPlaying)
+		clearStatuses();
+	else if (!m_currentPlaying || m_pendingInfo != m_currentInfo)
+		setStatuses(m_pendingInfo);
 }
 
 void NowPlaying::setStatuses(const TrackInfo &info)
 {
 	debug() << info.location.toString();
+	m_currentInfo = info;
+	m_currentPlaying = true;
 	foreach (AccountTuneStatus *account, m_accounts)
 		account->setStatus(info);
 }
 
 void NowPlaying::clearStatuses()
 {
+	m_updateTimer.stop();
+	m_pendingPlaying = false;
+	if (!m_currentPlaying)
+		return;
+	m_currentPlaying = false;
+	m_currentInfo = TrackInfo();
 	foreach (AccountTuneStatus *account, m_accounts)
 		account->removeStatus();
 }
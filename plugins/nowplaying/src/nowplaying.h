@@ -31,6 +31,7 @@
 #include <qutim/actiongenerator.h>
 #include <qutim/config.h>
 #include <QHash>
+#include <QBasicTimer>
 
 namespace qutim_sdk_0_3 {
 
@@ -91,6 +92,8 @@ public:
 	bool isWorking() { return m_isWorking; }
 	static NowPlaying *instance() { Q_ASSERT(self); return self; }
 	virtual bool eventFilter(QObject *obj, QEvent *ev);
+protected:
+	virtual void timerEvent(QTimerEvent *ev);
 public slots:
 	void loadSettings();
 	void setState(bool isWorking);
@@ -103,6 +106,7 @@ private slots:
 private:
 	void initPlayer(const QString &playerName, PlayerFactory *factory = 0);
 	void clearStatuses();
+	void scheduleUpdate();
 private:
 	StopStartActionGenerator* m_stopStartAction;
 	QList<HookPointer<PlayerFactory> > m_playerFactories;
@@ -111,6 +115,11 @@ private:
 	QString m_playerId;
 	QHash<Protocol*, AccountTuneStatus*> m_factories;
 	QList<AccountTuneStatus*> m_accounts;
+	QBasicTimer m_updateTimer;
+	TrackInfo m_pendingInfo;
+	TrackInfo m_currentInfo;
+	bool m_pendingPlaying;
+	bool m_currentPlaying;
 	bool m_isWorking;
 	bool m_forAllAccounts;
 	static NowPlaying *self;
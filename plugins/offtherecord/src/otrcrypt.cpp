@@ -219,6 +219,12 @@ bool OTRCrypt::load()
 	                         QT_TRANSLATE_NOOP("OTRCrypt", "OTR Messaging")));
 	m_settingsItem->connect(SIGNAL(saved()), this, SLOT(loadSettings()));
 	Settings::registerItem(m_settingsItem.data());
+	// New accounts get their keys in background, so the first private
+	// conversation doesn't wait for generation
+	foreach (Protocol *protocol, Protocol::all()) {
+		connect(protocol, SIGNAL(accountCreated(qutim_sdk_0_3::Account*)),
+		        SLOT(onAccountCreated(qutim_sdk_0_3::Account*)));
+	}
 	return true;
 }
 
@@ -229,6 +235,8 @@ bool OTRCrypt::unload()
 	m_preHandler.reset(0);
 	m_postHandler.reset(0);
 	m_action.reset(0);
+	foreach (Protocol *protocol, Protocol::all())
+		disconnect(protocol, 0, this, 0);
 	qDeleteAll(m_closures);
 	m_closures.clear();
 	qDeleteAll(m_connections);
@@ -246,6 +254,14 @@ void OTRCrypt::loadSettings()
 	m_notify = config.value("notify", true);
 }
 
+void OTRCrypt::onAccountCreated(Account *account)
+{
+	OtrMessaging *otr = connectionForPolicy(-1);
+	if (otr->getPolicy() == PolicyOff)
+		return;
+	otr->generateKey(account->id(), account->protocol()->id(), false);
+}
+
 OTRCrypt *OTRCrypt::instance()
 {
 	return self;
@@ -68,6 +68,9 @@ public slots:
 	void loadSettings();
 	void onActionTriggered(QAction *action);
 
+private slots:
+	void onAccountCreated(qutim_sdk_0_3::Account *account);
+
 private:
 	QScopedPointer<OtrActionGenerator> m_action;
 	QScopedPointer<OtrMessagePreHandler> m_preHandler;
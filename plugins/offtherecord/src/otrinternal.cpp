@@ -29,7 +29,9 @@
 #include <qutim/systeminfo.h>
 #include <qutim/buddy.h>
 #include <qutim/chatsession.h>
-#include <QtConcurrentRun>
+#include <qutim/executor.h>
+#include <qutim/asyncresult.h>
+#include <QPointer>
 #include <QtDebug>
 #include <QInputDialog>
 
@@ -41,6 +43,18 @@ static const QString OTR_FINGERPRINTS_FILE = "otr.fingerprints";
 static const QString OTR_KEYS_FILE = "otr.keys";
 static const QString OTR_INSTAG_FILE = "otr.instance";
 
+/**
+* Delay of fingerprints file write, changes made meanwhile are written
+* at once.
+*/
+static const int OTR_FINGERPRINTS_WRITE_DELAY = 2000;
+
+/**
+* Keys being generated, shared by all OtrInternal instances as they
+* share the user state.
+*/
+static QSet<QString> generatingKeys;
+
 //-----------------------------------------------------------------------------
 
 // libotr 4.0 compat
@@ -121,9 +135,12 @@ OtrInternal::OtrInternal(OtrSupport::Policy &policy,
                          OtrlUserState userstate)
     : m_userstate(),
       m_uiOps(),
-      m_otrPolicy(policy),
-      m_mutex()
+      m_otrPolicy(policy)
 {
+    m_fingerprintsTimer.setSingleShot(true);
+    m_fingerprintsTimer.setInterval(OTR_FINGERPRINTS_WRITE_DELAY);
+    connect(&m_fingerprintsTimer, SIGNAL(timeout()), SLOT(flushFingerprints()));
+
 	QDir shareDir = SystemInfo::getDir(SystemInfo::ConfigDir);
 	m_keysFile = shareDir.filePath(OTR_KEYS_FILE);
 	m_instagFile = shareDir.filePath(OTR_INSTAG_FILE);
@@ -159,6 +176,8 @@ OtrInternal::OtrInternal(OtrSupport::Policy &policy,
 
 OtrInternal::~OtrInternal()
 {
+    if (m_fingerprintsTimer.isActive())
+        flushFingerprints();
 }
 
 //-----------------------------------------------------------------------------
@@ -696,56 +715,75 @@ void OtrInternal::create_privkey(const char *accountname,
                                  const char *protocol)
 {
     Q_ASSERT(m_userstate);
+    generateKey(QString::fromUtf8(accountname), QString::fromUtf8(protocol), true);
+}
 
-    if(!m_mutex.tryLock(10))
+void OtrInternal::generateKey(const QString &accountName, const QString &protocolName,
+                              bool interactive)
+{
+    const QByteArray accountname = accountName.toUtf8();
+    const QByteArray protocol = protocolName.toUtf8();
+    const QString id = protocolName + QLatin1Char('/') + accountName;
+    if (generatingKeys.contains(id)
+            || otrl_privkey_find(m_userstate, accountname.constData(), protocol.constData())) {
         return;
-
-    QMessageBox infoMb(QMessageBox::Information, tr("qutim-otr"),
-                       tr("Generating keys for account %1\nThis may take a while.\nPlease, move mouse and use keyoard to decrease generation time.").arg(QString(accountname)),
-                       QMessageBox::Ok, NULL,
-                       Qt::Dialog | Qt::MSWindowsFixedSizeDialogHint);
-    infoMb.button(QMessageBox::Ok)->setEnabled(false);
-    infoMb.button(QMessageBox::Ok)->setText(tr("please wait..."));
-    infoMb.setWindowModality(Qt::NonModal);
-    infoMb.setModal(false);
-    infoMb.show();
-	Protocol *protocolObject = Protocol::all().value(QString::fromUtf8(protocol));
-	Account *account = protocolObject->account(QString::fromUtf8(accountname));
-	OTRCrypt::instance()->disableAccount(account);
-    {
-		QByteArray keysFile = m_keysFile.toLocal8Bit();
-		QEventLoop loop;
-		QFutureWatcher<gcry_error_t> watcher;
-		connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
-		QFuture<gcry_error_t> future = QtConcurrent::run(otrl_privkey_generate,
-		                                                 m_userstate,
-		                                                 keysFile.constData(),
-		                                                 accountname,
-		                                                 protocol);
-		watcher.setFuture(future);
-		loop.exec();
-	}
-	OTRCrypt::instance()->enableAccount(account);
-    m_mutex.unlock();
-    infoMb.button(QMessageBox::Ok)->setEnabled(true);
-    infoMb.button(QMessageBox::Ok)->setText("Ok");
-
-    char fingerprint[45];
-    if (otrl_privkey_fingerprint(m_userstate, fingerprint, accountname,
-                                 protocol) == NULL)
-    {
-        QMessageBox failMb(QMessageBox::Critical, tr("qutim-otr"),
-                           tr("Failed to generate key for account %1\nThe OTR Plugin will not work.").arg(QString(accountname)),
-                           QMessageBox::Ok, NULL,
-                           Qt::Dialog | Qt::MSWindowsFixedSizeDialogHint);
-        failMb.exec();
     }
-    else
-    {
-        infoMb.setText(tr("The fingerprint for account %1 is\n").arg(QString(accountname)) + QString(fingerprint));
+    generatingKeys.insert(id);
+
+    QPointer<QMessageBox> infoMb;
+    if (interactive) {
+        infoMb = new QMessageBox(QMessageBox::Information, tr("qutim-otr"),
+                                 tr("Generating keys for account %1\nThis may take a while.\nPlease, move mouse and use keyoard to decrease generation time.").arg(accountName),
+                                 QMessageBox::Ok, NULL,
+                                 Qt::Dialog | Qt::MSWindowsFixedSizeDialogHint);
+        infoMb->setAttribute(Qt::WA_DeleteOnClose);
+        infoMb->button(QMessageBox::Ok)->setEnabled(false);
+        infoMb->button(QMessageBox::Ok)->setText(tr("please wait..."));
+        infoMb->setWindowModality(Qt::NonModal);
+        infoMb->setModal(false);
+        infoMb->show();
     }
-    infoMb.exec();
-
+    Protocol *protocolObject = Protocol::all().value(protocolName);
+    QPointer<Account> account = protocolObject ? protocolObject->account(accountName) : 0;
+    if (account)
+        OTRCrypt::instance()->disableAccount(account);
+
+    // Key is generated for separate user state, as the shared one is used
+    // by GUI thread meanwhile. Single worker serializes writes of the file.
+    const QByteArray keysFile = m_keysFile.toLocal8Bit();
+    AsyncResultHandler<gcry_error_t> handler;
+    Executor::named(QStringLiteral("OTR"), 1)->run([keysFile, accountname, protocol, handler] () {
+        OtrlUserState userstate = otrl_userstate_create();
+        otrl_privkey_read(userstate, keysFile.constData());
+        const gcry_error_t err = otrl_privkey_generate(userstate, keysFile.constData(),
+                                                       accountname.constData(), protocol.constData());
+        otrl_userstate_free(userstate);
+        handler.handle(err);
+    }, interactive ? Executor::InteractivePriority : Executor::BackgroundPriority);
+
+    handler.result().connect(this, [this, id, keysFile, accountname, protocol, account, infoMb] (gcry_error_t) {
+        generatingKeys.remove(id);
+        otrl_privkey_read(m_userstate, keysFile.constData());
+        if (account && OTRCrypt::instance())
+            OTRCrypt::instance()->enableAccount(account);
+
+        char fingerprint[45];
+        if (otrl_privkey_fingerprint(m_userstate, fingerprint, accountname.constData(),
+                                     protocol.constData()) == NULL) {
+            if (infoMb)
+                infoMb->close();
+            QMessageBox *failMb = new QMessageBox(QMessageBox::Critical, tr("qutim-otr"),
+                                                  tr("Failed to generate key for account %1\nThe OTR Plugin will not work.").arg(QString::fromUtf8(accountname)),
+                                                  QMessageBox::Ok, NULL,
+                                                  Qt::Dialog | Qt::MSWindowsFixedSizeDialogHint);
+            failMb->setAttribute(Qt::WA_DeleteOnClose);
+            failMb->show();
+        } else if (infoMb) {
+            infoMb->button(QMessageBox::Ok)->setEnabled(true);
+            infoMb->button(QMessageBox::Ok)->setText("Ok");
+            infoMb->setText(tr("The fingerprint for account %1 is\n").arg(QString::fromUtf8(accountname)) + QString(fingerprint));
+        }
+    });
 }
 
 void OtrInternal::create_instag(const char *accountname,
@@ -968,6 +1006,13 @@ void OtrInternal::requestAuth(TreeModelItem &item, bool agree, QString answer, Q
 
 void OtrInternal::write_fingerprints()
 {
+    if (!m_fingerprintsTimer.isActive())
+        m_fingerprintsTimer.start();
+}
+
+void OtrInternal::flushFingerprints()
+{
+    m_fingerprintsTimer.stop();
     otrl_privkey_write_fingerprints(m_userstate,
                                     m_fingerprintFile.toStdString().c_str());
 }
@@ -27,6 +27,7 @@
 #include <QtGui>
 #include <QSemaphore>
 #include <QMutex>
+#include <QTimer>
 
 #include "otrmessaging.h"
 
@@ -95,6 +96,12 @@ public:
     void respondSMP(ConnContext *context, TreeModelItem &item, const QString &secret, bool initiate);
     void requestAuth(TreeModelItem &item, bool agree, QString answer = 0, QString question = 0);
 
+    /**
+    * Generates private key for the account by worker thread unless there
+    * is one already, @a interactive shows progress and fingerprint.
+    */
+    void generateKey(const QString &account, const QString &protocol, bool interactive);
+
 
     /*** otr callback functions ***/
     OtrlPolicy policy(ConnContext *context);
@@ -155,6 +162,9 @@ public:
     static void cb_log_message(void *opdata, const char *message);
     static int cb_max_message_size(void *opdata, ConnContext *context);
 
+private slots:
+    void flushFingerprints();
+
 private:
 
     /**
@@ -187,7 +197,10 @@ private:
     */
     OtrSupport::Policy& m_otrPolicy;
 
-    QMutex m_mutex;
+    /**
+    * Fingerprints are written once per batch of changes.
+    */
+    QTimer m_fingerprintsTimer;
 };
 
 // ---------------------------------------------------------------------------
@@ -30,10 +30,11 @@
 
 using namespace qutim_sdk_0_3;
 
-MessageHandlerAsyncResult OtrMessagePreHandler::doHandle(Message &message)
+MessageHandler::Result OtrMessagePreHandler::doHandleSync(Message &message, QString *reason)
 {
+	Q_UNUSED(reason);
     if (message.property("service", false) || message.property("history", false)) {
-		return makeAsyncResult(Accept, QString());
+		return Accept;
     }
 
 	if (message.isIncoming())
@@ -41,7 +42,7 @@ MessageHandlerAsyncResult OtrMessagePreHandler::doHandle(Message &message)
 	else
 		encrypt(message);
 
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
 
 void OtrMessagePreHandler::encrypt(Message &message)
@@ -85,7 +86,7 @@ void OtrMessagePreHandler::decrypt(Message &message)
     }
 }
 
-MessageHandlerAsyncResult OtrMessagePostHandler::doHandle(Message &message)
+MessageHandler::Result OtrMessagePostHandler::doHandleSync(Message &message, QString *reason)
 {
 	Q_UNUSED(reason);
 	if (message.isIncoming()) {
@@ -93,11 +94,11 @@ MessageHandlerAsyncResult OtrMessagePostHandler::doHandle(Message &message)
 			message.setText(message.text().section(QLatin1Char('\n'), 1));
 			message.setProperty("hide", true);
 			message.setProperty("store", false);
-			return makeAsyncResult(Accept, QString());
+			return Accept;
 		}
 	} else {
         if (message.property("service", false) || message.property("history", false)) {
-			return makeAsyncResult(Accept, QString());
+			return Accept;
         }
 		QString text = message.property("__otr__text", QString());
 		QString html = message.property("__otr__html", QString());
@@ -110,5 +111,5 @@ MessageHandlerAsyncResult OtrMessagePostHandler::doHandle(Message &message)
 		}
 	}
 
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
@@ -38,6 +38,11 @@ void OtrMessaging::requestAuth(TreeModelItem &item, bool agree, QString answer,
     m_impl->requestAuth(item,agree,answer,question);
 }
 
+void OtrMessaging::generateKey(const QString &account, const QString &protocol, bool interactive)
+{
+    m_impl->generateKey(account, protocol, interactive);
+}
+
 //-----------------------------------------------------------------------------
 
 OtrMessaging::~OtrMessaging()
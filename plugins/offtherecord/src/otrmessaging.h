@@ -214,6 +214,11 @@ public:
     // TODO: check this function
     void requestAuth(TreeModelItem &item, bool agree, QString answer = QString(), QString question = QString());
 
+    /**
+    * Generate private key for the account in background if there is none.
+    */
+    void generateKey(const QString &account, const QString &protocol, bool interactive);
+
 
 private:
     Policy    m_otrPolicy;
@@ -46,6 +46,8 @@
 #include <QLatin1Literal>
 #include "settings/olddelegatesettings.h"
 
+enum { LayoutCacheSize = 2048 };
+
 bool contactInfoLessThan(const QVariantHash &a, const QVariantHash &b) {
 	QString priority = QLatin1String("priorityInContactList");
 	int p1 = a.value(priority).toInt();
@@ -85,6 +87,7 @@ ContactListItemDelegate::ContactListItemDelegate(QObject *parent) : QAbstractIte
 //	Settings::registerItem(m_settings.data());
 	m_margin = 1;
 	m_styleType = LightStyle;
+	m_layouts.setMaxCost(LayoutCacheSize);
 	reloadSettings();
 	Q_UNUSED(QT_TRANSLATE_NOOP("ContactList", "qutIM 0.2 style"));
 }
@@ -99,6 +102,8 @@ void ContactListItemDelegate::paint(QPainter *painter, const QStyleOptionViewIte
 	QStyleOptionViewItemV4 option(option2);
 	ContactItemType type = static_cast<ContactItemType>(index.data(ItemTypeRole).toInt());
 	Status status = index.data(StatusRole).value<Status>();
+	RowLayout fallback;
+	RowLayout *layout = rowLayout(index, &fallback);
 
 	const QWidget *widget = getWidget(option);
 	const QTreeView *treeView = qobject_cast<const QTreeView*>(widget);
@@ -326,7 +331,7 @@ void ContactListItemDelegate::paint(QPainter *painter, const QStyleOptionViewIte
 		if (m_showFlags & ShowAvatars) {
 			QString avatar = index.data(AvatarRole).toString();
 			if (!avatar.isEmpty()) {
-				QPixmap pixmap = AvatarFilter::icon(avatar).pixmap(m_avatarSize);
+				QPixmap pixmap = AvatarFilter(QSize(m_avatarSize, m_avatarSize)).pixmap(avatar);
 				pixmaps << pixmap;
 				height = pixmap.height();
 			}
@@ -343,31 +348,37 @@ void ContactListItemDelegate::paint(QPainter *painter, const QStyleOptionViewIte
 
 	QRect title_rect = rect;
 	if (m_showFlags & ShowExtendedInfoIcons) {
-		QHash<QString, QVariantHash> extStatuses = status.extendedInfos();
+		if (!layout->extIconsReady) {
+			QHash<QString, QVariantHash> extStatuses = status.extendedInfos();
+
+			QList<QVariantHash> list;
+			foreach (const QVariantHash &data, extStatuses) {
+				QList<QVariantHash>::iterator search_it =
+						qLowerBound(list.begin(), list.end(), data, contactInfoLessThan);
+				list.insert(search_it,data);
+			}
 
-		QList<QVariantHash> list;
-		foreach (const QVariantHash &data, extStatuses) {
-			QList<QVariantHash>::iterator search_it =
-					qLowerBound(list.begin(), list.end(), data, contactInfoLessThan);
-			list.insert(search_it,data);
+			QString icon = QLatin1String("icon");
+			QString showIcon = QLatin1String("showIcon");
+			QString id = QLatin1String("id");
+
+			foreach (const QVariantHash &hash, list) {
+				QVariant extIconVar = hash.value(icon);
+				QIcon icon;
+				if (extIconVar.canConvert<ExtensionIcon>())
+					icon = extIconVar.value<ExtensionIcon>().toIcon();
+				else if (extIconVar.canConvert(QVariant::Icon))
+					icon = extIconVar.value<QIcon>();
+				QPixmap pixmap = icon.pixmap(m_extIconSize, QIcon::Normal, QIcon::On);
+				if (!hash.value(showIcon,true).toBool() || pixmap.isNull())
+					continue;
+				if (!m_extInfo.value(hash.value(id).toString(), true))
+					continue;
+				layout->extIcons << pixmap;
+			}
+			layout->extIconsReady = true;
 		}
-
-		QString icon = QLatin1String("icon");
-		QString showIcon = QLatin1String("showIcon");
-		QString id = QLatin1String("id");
-
-		foreach (const QVariantHash &hash, list) {
-			QVariant extIconVar = hash.value(icon);
-			QIcon icon;
-			if (extIconVar.canConvert<ExtensionIcon>())
-				icon = extIconVar.value<ExtensionIcon>().toIcon();
-			else if (extIconVar.canConvert(QVariant::Icon))
-				icon = extIconVar.value<QIcon>();
-			QPixmap pixmap = icon.pixmap(m_extIconSize, QIcon::Normal, QIcon::On);
-			if (!hash.value(showIcon,true).toBool() || pixmap.isNull())
-				continue;
-			if (!m_extInfo.value(hash.value(id).toString(), true))
-				continue;
+		foreach (const QPixmap &pixmap, layout->extIcons) {
 			title_rect.adjust(0, 0, -m_extIconSize - m_margin * 2, 0);
 			painter->drawPixmap(QRect(title_rect.topRight(), QSize(m_extIconSize, m_extIconSize)), pixmap);
 		}
@@ -375,41 +386,42 @@ void ContactListItemDelegate::paint(QPainter *painter, const QStyleOptionViewIte
 	}
 
 	title_rect.adjust(0, 0, -m_margin, 0);
-	QString text = index.data(Qt::DisplayRole).toString();
-	if (type == TagType) {
-		QString count = index.data(ContactsCountRole).toString();
-		QString online_count = index.data(OnlineContactsCountRole).toString();
-
-		text = text % QLatin1Literal(" (")
-				% online_count
-				% QLatin1Char('/')
-				% count
-				% QLatin1Char(')');
+	// Text is elided again only if row is changed or resized
+	if (layout->titleWidth != title_rect.width() || layout->titleFont != font) {
+		QString text = index.data(Qt::DisplayRole).toString();
+		if (type == TagType) {
+			QString count = index.data(ContactsCountRole).toString();
+			QString online_count = index.data(OnlineContactsCountRole).toString();
+
+			text = text % QLatin1Literal(" (")
+					% online_count
+					% QLatin1Char('/')
+					% count
+					% QLatin1Char(')');
+		}
+		layout->title = fontMetrics.elidedText(text, Qt::ElideRight, title_rect.width());
+		layout->titleWidth = title_rect.width();
+		layout->titleFont = font;
 	}
-	QSize itemSize = QSize(title_rect.width(), fontMetrics.height());
-	text = fontMetrics.elidedText(text, Qt::ElideRight, itemSize.width());
 	if (fontMetrics.height() > height)
 		height = fontMetrics.height();
-	int deltaWidth = itemSize.width() - fontMetrics.width(text);
-	if (type == SeparatorType && deltaWidth > 0) {
-		itemSize.setWidth(itemSize.width() - deltaWidth);
-		deltaWidth /= 2;
-		rect.adjust(deltaWidth, 0, 0, 0);
-	}
 	painter->setFont(font);
 	painter->setPen(fontColor);
-	painter->drawText(title_rect, text);
+	painter->drawText(title_rect, layout->title);
 
-	QString statusText = status.text();
-	bool isStatusText = (m_showFlags & ShowStatusText) && !statusText.isEmpty();
+	bool isStatusText = (m_showFlags & ShowStatusText) && !status.text().isEmpty();
 	if (isStatusText) {
 		painter->setFont(statusFont);
 		painter->setPen(statusColor);
-		fontMetrics = QFontMetrics(statusFont);
 		status_rect.adjust(0, height + m_margin, 0, 0);
-		statusText = statusText.remove(QLatin1Char('\n'));
-		statusText = fontMetrics.elidedText(statusText, Qt::ElideRight, status_rect.width());
-		painter->drawText(status_rect, Qt::AlignTop, statusText);
+		if (layout->statusWidth != status_rect.width() || layout->statusFont != statusFont) {
+			QString statusText = status.text();
+			statusText = statusText.remove(QLatin1Char('\n'));
+			layout->statusText = QFontMetrics(statusFont).elidedText(statusText, Qt::ElideRight, status_rect.width());
+			layout->statusWidth = status_rect.width();
+			layout->statusFont = statusFont;
+		}
+		painter->drawText(status_rect, Qt::AlignTop, layout->statusText);
 	}
 	
 	// done
@@ -418,13 +430,17 @@ void ContactListItemDelegate::paint(QPainter *painter, const QStyleOptionViewIte
 
 QSize ContactListItemDelegate::sizeHint(const QStyleOptionViewItem &option2, const QModelIndex &index) const
 {
-	QStyleOptionViewItemV4 option(option2);
-	ContactItemType type = static_cast<ContactItemType>(index.data(ItemTypeRole).toInt());
-	Status status = index.data(StatusRole).value<Status>();
-
 	QVariant value = index.data(Qt::SizeHintRole);
 	if (value.isValid())
 		return value.value<QSize>();
+	RowLayout fallback;
+	RowLayout *layout = rowLayout(index, &fallback);
+	if (layout->height >= 0 && layout->hintFont == option2.font)
+		return QSize(option2.rect.width(), layout->height);
+
+	QStyleOptionViewItemV4 option(option2);
+	ContactItemType type = static_cast<ContactItemType>(index.data(ItemTypeRole).toInt());
+	Status status = index.data(StatusRole).value<Status>();
 	QStyleOptionViewItem opt = option;
 
 	QVariant font = index.data(Qt::FontRole);
@@ -480,10 +496,27 @@ QSize ContactListItemDelegate::sizeHint(const QStyleOptionViewItem &option2, con
 	}
 
 	height += 2 * m_margin;
+	layout->height = height;
+	layout->hintFont = option2.font;
 
 	return QSize(opt.rect.width(), height);
 }
 
+ContactListItemDelegate::RowLayout *ContactListItemDelegate::rowLayout(const QModelIndex &index, RowLayout *fallback) const
+{
+	// Models without revisions can't tell when the row changes, so nothing is cached for them
+	bool ok = false;
+	const quint32 revision = index.data(RevisionRole).toUInt(&ok);
+	if (!ok || !revision)
+		return fallback;
+	RowLayout *layout = m_layouts.object(revision);
+	if (!layout) {
+		layout = new RowLayout;
+		m_layouts.insert(revision, layout);
+	}
+	return layout;
+}
+
 QWidget *ContactListItemDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
 	Q_UNUSED(option);
@@ -746,6 +779,8 @@ bool ContactListItemDelegate::setThemeStyle(const QString &name)
 		delete q;
 
 	m_styleType	= LightStyle;
+	// Cached layouts depend on fonts and sizes of the style
+	m_layouts.clear();
 
 	if(name.isEmpty())
 		return false;
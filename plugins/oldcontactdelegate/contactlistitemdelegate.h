@@ -38,6 +38,7 @@
 #include <QFont>
 #include <QVector>
 #include <QHash>
+#include <QCache>
 #include <QVariant>
 #include <qutim/debug.h>
 #include <qutim/status.h>
@@ -63,7 +64,9 @@ enum ContactItemRole
 	AvatarRole,
 	ItemTypeRole,
 	AccountRole,
-	Color
+	Color,
+	// Same value as in contact model
+	RevisionRole = Qt::UserRole + 19
 };
 Q_DECLARE_FLAGS(ContactItemRoles,ContactItemRole)
 enum ContactItemType
@@ -161,6 +164,24 @@ private:
 	QAbstractItemView *getContactListView();
 	inline void setFlag(ShowFlags flag, bool on = true);
 private:
+	// Results of text measuring for a single revision of a row
+	struct RowLayout
+	{
+		RowLayout() : height(-1), extIconsReady(false), titleWidth(-1), statusWidth(-1) {}
+		int height;
+		QFont hintFont;
+		bool extIconsReady;
+		QList<QPixmap> extIcons;
+		int titleWidth;
+		QFont titleFont;
+		QString title;
+		int statusWidth;
+		QFont statusFont;
+		QString statusText;
+	};
+	RowLayout *rowLayout(const QModelIndex &index, RowLayout *fallback) const;
+	mutable QCache<quint32, RowLayout> m_layouts;
+
 	struct StyleVar
 	{
 		StyleVar() :
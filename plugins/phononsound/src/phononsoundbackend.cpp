@@ -28,6 +28,8 @@
 #include <qutim/systemintegration.h>
 #endif
 
+enum { MaxVoices = 3 };
+
 PhononSoundBackend::PhononSoundBackend()
 {
 	// FIXME
@@ -51,14 +53,26 @@ PhononSoundBackend::PhononSoundBackend()
 
 void PhononSoundBackend::playSound(const QString &filename)
 {
-	PathData data;
-	data.mediaObject = new Phonon::MediaObject(this);
-	data.mediaObject->setCurrentSource(Phonon::MediaSource(filename));
-	data.audioOutput = new Phonon::AudioOutput(Phonon::MusicCategory, this);
-	data.path = Phonon::createPath(data.mediaObject, data.audioOutput);
-	connect(data.mediaObject, SIGNAL(finished()), this, SLOT(finishedPlaying()));
-	m_cache.insert(data.mediaObject, data);
-	data.mediaObject->play();
+	Voice *voice = 0;
+	for (int i = 0; i < m_voices.size() && !voice; ++i) {
+		if (!m_voices.at(i).busy)
+			voice = &m_voices[i];
+	}
+	if (!voice) {
+		// All voices are busy, it's better to skip the sound than to mix too many
+		if (m_voices.size() >= MaxVoices)
+			return;
+		Voice data;
+		data.mediaObject = new Phonon::MediaObject(this);
+		data.audioOutput = new Phonon::AudioOutput(Phonon::MusicCategory, this);
+		data.path = Phonon::createPath(data.mediaObject, data.audioOutput);
+		connect(data.mediaObject, SIGNAL(finished()), this, SLOT(finishedPlaying()));
+		m_voices << data;
+		voice = &m_voices.last();
+	}
+	voice->busy = true;
+	voice->mediaObject->setCurrentSource(Phonon::MediaSource(filename));
+	voice->mediaObject->play();
 }
 
 QStringList PhononSoundBackend::supportedFormats()
@@ -69,9 +83,10 @@ QStringList PhononSoundBackend::supportedFormats()
 void PhononSoundBackend::finishedPlaying()
 {
 	Phonon::MediaObject *mediaObject = qobject_cast<Phonon::MediaObject*>(sender());
-	PathData path = m_cache.take(mediaObject);
-	path.path.disconnect();
-	path.mediaObject->deleteLater();
-	path.audioOutput->deleteLater();
+	for (int i = 0; i < m_voices.size(); ++i) {
+		if (m_voices.at(i).mediaObject == mediaObject) {
+			m_voices[i].busy = false;
+			break;
+		}
+	}
 }
-
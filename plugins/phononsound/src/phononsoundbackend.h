@@ -44,14 +44,16 @@ public:
 public slots:
 	void finishedPlaying();
 private:
-	struct PathData
+	struct Voice
 	{
 		Phonon::MediaObject *mediaObject;
 		Phonon::AudioOutput *audioOutput;
 		Phonon::Path path;
+		bool busy;
 	};
 
-	QMap<QObject*, PathData> m_cache;
+	// Outputs are reused, so a burst of notifications doesn't create new pipelines
+	QList<Voice> m_voices;
 	QStringList m_formats;
 };
 
@@ -28,14 +28,55 @@
 #include <qutim/debug.h>
 #include <qutim/config.h>
 #include <qutim/thememanager.h>
+#include <qutim/systeminfo.h>
 #include <QVBoxLayout>
+#include <QQmlEngine>
+#include <QQmlNetworkAccessManagerFactory>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QMutex>
+#include <QSet>
 
 using namespace qutim_sdk_0_3;
 
+// Preview images are kept in disk cache, so reopened dialog only revalidates
+// them by ETag or modification time instead of downloading them again
+class PackageNetworkFactory : public QQmlNetworkAccessManagerFactory
+{
+public:
+	QNetworkAccessManager *create(QObject *parent)
+	{
+		QNetworkAccessManager *manager = new QNetworkAccessManager(parent);
+		// QNetworkDiskCache can't be shared, so managers of different threads
+		// take different directories
+		QMutexLocker locker(&m_mutex);
+		int slot = 0;
+		while (m_slots.contains(slot))
+			++slot;
+		m_slots.insert(slot);
+		QNetworkDiskCache *cache = new QNetworkDiskCache(manager);
+		cache->setCacheDirectory(SystemInfo::getDir(SystemInfo::ConfigDir)
+		                         .filePath(QLatin1String("cache/plugman/images-") + QString::number(slot)));
+		cache->setMaximumCacheSize(10 * 1024 * 1024);
+		manager->setCache(cache);
+		QObject::connect(manager, &QObject::destroyed, [this, slot] () {
+			QMutexLocker locker(&m_mutex);
+			m_slots.remove(slot);
+		});
+		return manager;
+	}
+private:
+	QMutex m_mutex;
+	QSet<int> m_slots;
+};
+
+Q_GLOBAL_STATIC(PackageNetworkFactory, networkFactory)
+
 PackageDownloadDialog::PackageDownloadDialog(const QStringList &categories, const QString &path) :
 	m_view(new DeclarativeView(this))
 {
 	m_view->setResizeMode(DeclarativeView::SizeRootObjectToView);
+	m_view->engine()->setNetworkAccessManagerFactory(networkFactory());
 
 	QVBoxLayout *layout = new QVBoxLayout(this);
 	layout->addWidget(m_view);
@@ -28,14 +28,33 @@
 #include <QNetworkReply>
 #include <QPixmap>
 #include <QDirIterator>
+#include <QTemporaryFile>
+#include <QCache>
+#include <QTimer>
 #include <qutim/debug.h>
 #include <qutim/systeminfo.h>
 #include <qutim/jsonfile.h>
+#include <qutim/networkaccess.h>
 #include <attica/downloaditem.h>
 
 using namespace Attica;
 using namespace qutim_sdk_0_3;
 
+enum { ContentsCacheTimeout = 10 * 60 };
+
+struct CachedContents
+{
+	Content::List contents;
+	QDateTime received;
+};
+
+typedef QCache<QString, CachedContents> ContentsCache;
+typedef QCache<QString, QPixmap> PreviewCache;
+// Pages stay valid while the dialog is reopened during the session
+Q_GLOBAL_STATIC_WITH_ARGS(ContentsCache, contentsCache, (64))
+// Thumbnails by url, cost is in kilobytes
+Q_GLOBAL_STATIC_WITH_ARGS(PreviewCache, previewCache, (8 * 1024))
+
 PackageEngine::PackageEngine(QObject *parent)
 	: QObject(parent)
 {
@@ -50,6 +69,19 @@ PackageEngine::PackageEngine(QObject *parent)
 //	}
 	m_idCounter = (qint64(qrand()) << 32) | quint32(qrand());
 
+	// Categories rarely change, so cached ones are used until provider answers
+	JsonFile categoriesFile(cacheFileName(QLatin1String("categories.json")));
+	QVariant categories;
+	if (categoriesFile.load(categories)) {
+		foreach (const QVariant &var, categories.toList()) {
+			const QVariantMap data = var.toMap();
+			Category category;
+			category.setId(data.value(QLatin1String("id")).toString());
+			category.setName(data.value(QLatin1String("name")).toString());
+			m_categories << category;
+		}
+	}
+
 	const QString fileName = SystemInfo::getDir(SystemInfo::ShareDir)
 							 .filePath(QLatin1String("packages.json"));
 	JsonFile file(fileName);
@@ -128,6 +160,13 @@ bool PackageEngine::isInitialized()
 	return !m_categories.isEmpty();
 }
 
+QString PackageEngine::cacheFileName(const QString &name) const
+{
+	QDir dir = SystemInfo::getDir(SystemInfo::ConfigDir);
+	dir.mkpath(QLatin1String("cache/plugman"));
+	return dir.filePath(QLatin1String("cache/plugman/") + name);
+}
+
 void PackageEngine::onProviderAdded(Attica::Provider provider)
 {
 	m_provider = provider;
@@ -135,32 +174,77 @@ void PackageEngine::onProviderAdded(Attica::Provider provider)
 	ListJob<Category> *job = provider.requestCategories();
 	connect(job, SIGNAL(finished(Attica::BaseJob*)), this, SLOT(onCategoriesJobFinished(Attica::BaseJob*)));
 	job->start();
+	while (!m_pendingRequests.isEmpty())
+		startContentJob(m_pendingRequests.takeFirst());
 }
 
 void PackageEngine::onCategoriesJobFinished(Attica::BaseJob *baseJob)
 {
 	baseJob->deleteLater();
 	ListJob<Category> *job = static_cast<ListJob<Category>*>(baseJob);
-	m_categories = job->itemList();
+	const bool wasInitialized = isInitialized();
+	const Category::List categories = job->itemList();
+	if (categories.isEmpty() && wasInitialized)
+		return;
+	m_categories = categories;
+	QVariantList cached;
 	for (int j = 0; j < m_categories.size(); j++) {
 		debug() << j << m_categories[j].name();
+		QVariantMap data;
+		data.insert(QLatin1String("id"), m_categories[j].id());
+		data.insert(QLatin1String("name"), m_categories[j].name());
+		cached << data;
 	}
 //	[23:25:57] "23" "Emoticon Theme" 
 //	[23:25:57] "24" "Kopete Style 0.11" 
 //	[23:25:57] "26" "Kopete Style 0.12+" 
-	emit engineInitialized();
-	
+	JsonFile file(cacheFileName(QLatin1String("categories.json")));
+	file.save(cached);
+	if (!wasInitialized)
+		emit engineInitialized();
 }
 
 qint64 PackageEngine::requestContents(const Attica::Category::List &categories, const QString &search,
 									  Attica::Provider::SortMode mode, uint page, uint pageSize)
 {
-	ListJob<Content> *contentJob = m_provider.searchContents(categories, search, mode, page, pageSize);
+	ContentRequest request;
+	request.id = m_idCounter++;
+	request.categories = categories;
+	request.search = search;
+	request.mode = mode;
+	request.page = page;
+	request.pageSize = pageSize;
+	QStringList ids;
+	foreach (const Category &category, categories)
+		ids << category.id();
+	request.key = ids.join(QLatin1String(",")) + QLatin1Char('\n') + search + QLatin1Char('\n')
+	        + QString::number(mode) + QLatin1Char(':') + QString::number(page)
+	        + QLatin1Char(':') + QString::number(pageSize);
+
+	const CachedContents *cached = contentsCache()->object(request.key);
+	if (cached && cached->received.secsTo(QDateTime::currentDateTimeUtc()) < ContentsCacheTimeout) {
+		const Content::List contents = cached->contents;
+		const qint64 id = request.id;
+		// Callers expect contents to be received after the id is returned
+		QTimer::singleShot(0, this, [this, contents, id] () {
+			handleContents(contents, id);
+		});
+	} else if (!m_provider.isValid()) {
+		m_pendingRequests << request;
+	} else {
+		startContentJob(request);
+	}
+	return request.id;
+}
+
+void PackageEngine::startContentJob(const ContentRequest &request)
+{
+	ListJob<Content> *contentJob = m_provider.searchContents(request.categories, request.search,
+	                                                         request.mode, request.page, request.pageSize);
 	connect(contentJob, SIGNAL(finished(Attica::BaseJob*)), this, SLOT(onContentJobFinished(Attica::BaseJob*)));
-	qint64 id = m_idCounter++;
-	contentJob->setProperty("jobId", id);
+	contentJob->setProperty("jobId", request.id);
+	contentJob->setProperty("cacheKey", request.key);
 	contentJob->start();
-	return id;
 }
 
 Category::List PackageEngine::resolveCategories(const QStringList &categoriesNames) const
@@ -179,7 +263,18 @@ void PackageEngine::onContentJobFinished(Attica::BaseJob *baseJob)
 {
 	baseJob->deleteLater();
 	ListJob<Content> *job = static_cast<ListJob<Content>*>(baseJob);
-	Content::List contents = job->itemList();
+	const Content::List contents = job->itemList();
+	if (job->metadata().error() == Metadata::NoError) {
+		CachedContents *cached = new CachedContents;
+		cached->contents = contents;
+		cached->received = QDateTime::currentDateTimeUtc();
+		contentsCache()->insert(job->property("cacheKey").toString(), cached);
+	}
+	handleContents(contents, job->property("jobId").toLongLong());
+}
+
+void PackageEngine::handleContents(const Attica::Content::List &contents, qint64 id)
+{
 	PackageEntry::List list;
 	for (int i = 0; i < contents.size(); ++i) {
 		const Content &content = contents.at(i);
@@ -194,7 +289,6 @@ void PackageEngine::onContentJobFinished(Attica::BaseJob *baseJob)
 		}
 		list.append(entry);
 	}
-	qint64 id = job->property("jobId").toLongLong();
 	debug() << Q_FUNC_INFO;
 	emit contentsReceived(list, id);
 }
@@ -235,9 +329,21 @@ void PackageEngine::install(const PackageEntry &entry, const QString &path)
 void PackageEngine::loadPreview(const PackageEntry &entry)
 {
 	Attica::Content content = entry.content();
-	QNetworkRequest request(QUrl::fromUserInput(content.smallPreviewPicture()));
-	QNetworkReply *reply = m_networkManager.get(request);
+	const QString url = content.smallPreviewPicture();
+	if (const QPixmap *pixmap = previewCache()->object(url)) {
+		const QString id = content.id();
+		const QPixmap preview = *pixmap;
+		QTimer::singleShot(0, this, [this, id, preview] () {
+			emit previewLoaded(id, preview);
+		});
+		return;
+	}
+	QNetworkRequest request = NetworkAccess::request(QUrl::fromUserInput(url));
+	// Disk cache revalidates stale previews by ETag or modification time
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+	QNetworkReply *reply = NetworkAccess::manager()->get(request);
 	reply->setProperty("contentId", content.id());
+	reply->setProperty("previewUrl", url);
 	connect(reply, SIGNAL(finished()), SLOT(onPreviewRequestFinished()));
 }
 
@@ -247,10 +353,19 @@ void PackageEngine::onDownloadJobFinished(Attica::BaseJob *baseJob)
 	ItemJob<DownloadItem> *job = static_cast<ItemJob<DownloadItem>*>(baseJob);
 	DownloadItem item = job->result();
 	debug() << item.url();
-	QNetworkRequest request(item.url());
-	QNetworkReply *reply = m_networkManager.get(request);
+	QNetworkRequest request = NetworkAccess::request(item.url());
+	QNetworkReply *reply = NetworkAccess::manager()->get(request);
 	reply->setProperty("path", job->property("path"));
 	reply->setProperty("contentId", job->property("contentId"));
+	// Archive is written to disk as it arrives instead of being kept in memory
+	QTemporaryFile *file = new QTemporaryFile(QDir::temp().filePath(QLatin1String("qutim-plugman-XXXXXX")), reply);
+	if (!file->open()) {
+		critical() << "Can't create temporary file for" << item.url();
+		reply->abort();
+	}
+	connect(reply, &QNetworkReply::readyRead, file, [reply, file] () {
+		file->write(reply->readAll());
+	});
 	connect(reply, SIGNAL(finished()), this, SLOT(onNetworkRequestFinished()));
 }
 
@@ -261,6 +376,10 @@ void PackageEngine::onPreviewRequestFinished()
 	Q_ASSERT(reply);
 	QString id = reply->property("contentId").toString();
 	QPixmap pixmap = QPixmap::fromImage(QImage::fromData(reply->readAll()));
+	if (!pixmap.isNull()) {
+		const int cost = qMax(1, pixmap.width() * pixmap.height() * pixmap.depth() / 8 / 1024);
+		previewCache()->insert(reply->property("previewUrl").toString(), new QPixmap(pixmap), cost);
+	}
 	emit previewLoaded(id, pixmap);
 }
 
@@ -270,15 +389,17 @@ void PackageEngine::onNetworkRequestFinished()
 	reply->deleteLater();
 	Q_ASSERT(reply);
 	QString mimeType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
-	QString fileName = QDir::temp().filePath(reply->url().path().section('/', -1, -1));
+	QTemporaryFile *archive = reply->findChild<QTemporaryFile*>();
 	PackageEntry entry = m_entries[reply->property("contentId").toString()];
+	if (reply->error() != QNetworkReply::NoError || !archive || !archive->isOpen()) {
+		critical() << "Can't download package" << reply->url() << reply->errorString();
+		return;
+	}
+	archive->write(reply->readAll());
+	archive->flush();
+	const QString fileName = archive->fileName();
 	debug() << Q_FUNC_INFO;
 	debug() << mimeType << fileName;
-	{
-		QFile file(fileName);
-		file.open(QIODevice::WriteOnly);
-		file.write(reply->readAll());
-	}
 	
 	QDir tmp = QDir::temp();
 	QString subpath = QLatin1String("qutim-plugman-") + QString::number(qrand());
@@ -330,7 +451,6 @@ void PackageEngine::onNetworkRequestFinished()
 	entry.setStatus(PackageEntry::Installed);
 	entry.setInstalledFiles(files);
 	entry.setInstalledVersion(entry.content().version());
-	QFile::remove(fileName);
 	emit entryChanged(entry.id());
 }
 
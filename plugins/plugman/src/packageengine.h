@@ -26,7 +26,7 @@
 #ifndef PACKAGEENGINE_H
 #define PACKAGEENGINE_H
 
-#include <QNetworkAccessManager>
+#include <QNetworkReply>
 #include <attica/content.h>
 #include <attica/provider.h>
 #include <attica/providermanager.h>
@@ -65,9 +65,24 @@ private slots:
 	void onNetworkRequestFinished();
 	
 private:
+	struct ContentRequest
+	{
+		qint64 id;
+		QString key;
+		Attica::Category::List categories;
+		QString search;
+		Attica::Provider::SortMode mode;
+		uint page;
+		uint pageSize;
+	};
+
+	void startContentJob(const ContentRequest &request);
+	void handleContents(const Attica::Content::List &contents, qint64 id);
+	QString cacheFileName(const QString &name) const;
+
 	qint64 m_idCounter;
+	QList<ContentRequest> m_pendingRequests;
 	Attica::Category::List m_categories;
-	QNetworkAccessManager m_networkManager;
 	QHash<QString, PackageEntry> m_entries;
 	Attica::ProviderManager m_manager;
 	Attica::Provider m_provider;
@@ -70,7 +70,7 @@ bool PlugmanArchive::extract(const QString &file, const QString &path, QString *
     archive_read_support_compression_all(arc);
     archive_read_support_format_all(arc);
     struct archive_entry *entry;
-    if ((r = archive_read_open_file(arc, QFile::encodeName(file).constData(), 10240))) {
+    if ((r = archive_read_open_file(arc, QFile::encodeName(file).constData(), 64 * 1024))) {
         *error = QString::fromLocal8Bit(archive_error_string(arc));
         return false;
     }
@@ -170,6 +170,25 @@ Rectangle {
 			if (!myMessage.isIncoming || needSlide)
 				messageView.currentIndex = messageView.count - 1;
 		}
+		onMessagesAppended: {
+			var hasOutgoing = false;
+			var needSlide = controller.session.active && messageView.currentIndex === messageView.count - 1;
+			for (var i = 0; i < messages.length; i++) {
+				var myMessage = messages[i];
+				var index = messageModel.count-1;
+				myMessage.append = false;
+				myMessage.body = controller.parseEmoticons(myMessage.body);
+				if (index !== -1) {
+					var prevMessage = messageModel.get(index);
+					if ((prevMessage.sender === myMessage.sender) && !(prevMessage.action || prevMessage.service))
+						myMessage.append = true;
+				}
+				messageModel.append(myMessage);
+				hasOutgoing = hasOutgoing || !myMessage.isIncoming;
+			}
+			if (hasOutgoing || needSlide)
+				messageView.currentIndex = messageView.count - 1;
+		}
 		onMessageDelivered: {
             for (var i = messageModel.count-1;i !== -1;i--) {
                 if (messageModel.get(i).messageId === messageId) {
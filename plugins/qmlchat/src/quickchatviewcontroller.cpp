@@ -34,6 +34,7 @@
 #include <QQmlContext>
 #include <QQmlEngine>
 #include <QQmlProperty>
+#include <QMetaMethod>
 #include <qutim/conference.h>
 #include <qutim/history.h>
 #include <qutim/emoticons.h>
@@ -93,7 +94,7 @@ static QVariant messageToVariant(const Message &mes)
 }
 
 QuickChatController::QuickChatController(QObject *parent) :
-	QObject(parent)
+	QObject(parent), m_historyPending(false), m_historyGeneration(0)
 {
 }
 
@@ -101,13 +102,41 @@ QuickChatController::~QuickChatController()
 {
 }
 
+bool QuickChatController::deferMessage(const Message &msg)
+{
+	// History goes above messages received while it is being read
+	if (!m_historyPending || msg.property("history", false))
+		return false;
+	m_pendingMessages << msg;
+	return true;
+}
+
 void QuickChatController::appendMessage(const qutim_sdk_0_3::Message& msg)
 {
-	if (msg.text().isEmpty())
+	if (msg.text().isEmpty() || deferMessage(msg))
 		return;
 	emit messageAppended(messageToVariant(msg));
 }
 
+void QuickChatController::appendMessages(const qutim_sdk_0_3::MessageList &messages)
+{
+	// Themes without batch handler still receive messages one by one
+	static const QMetaMethod signal = QMetaMethod::fromSignal(&QuickChatController::messagesAppended);
+	if (!isSignalConnected(signal)) {
+		foreach (const Message &msg, messages)
+			appendMessage(msg);
+		return;
+	}
+	QVariantList list;
+	list.reserve(messages.size());
+	foreach (const Message &msg, messages) {
+		if (!msg.text().isEmpty() && !deferMessage(msg))
+			list << messageToVariant(msg);
+	}
+	if (!list.isEmpty())
+		emit messagesAppended(list);
+}
+
 void QuickChatController::clearChat()
 {
 	emit clearChatField();
@@ -123,15 +152,28 @@ void QuickChatController::loadHistory()
 	qDebug() << Q_FUNC_INFO;
 	Config config = Config(QStringLiteral("appearance")).group(QStringLiteral("chat/history"));
 	int max_num = 50 + config.value(QStringLiteral("maxDisplayMessages"), 5);
-    MessageList messages = History::instance()->readSync(m_session.data()->getUnit(), max_num);
-	foreach (Message mess, messages) {
-		mess.setProperty("silent", true);
-		mess.setProperty("store", false);
-		mess.setProperty("history", true);
-		if (!mess.chatUnit()) //TODO FIXME
-			mess.setChatUnit(m_session.data()->getUnit());
-		m_session.data()->append(mess);
-	}
+	const int generation = ++m_historyGeneration;
+	m_historyPending = true;
+	m_pendingMessages.clear();
+	History::instance()->read(m_session.data()->getUnit(), max_num).connect(this, [this, generation] (const MessageList &result) {
+		if (generation != m_historyGeneration || !m_session)
+			return;
+		MessageList messages = result;
+		for (int i = 0; i < messages.size(); ++i) {
+			Message &mess = messages[i];
+			mess.setProperty("silent", true);
+			mess.setProperty("store", false);
+			mess.setProperty("history", true);
+			if (!mess.chatUnit()) //TODO FIXME
+				mess.setChatUnit(m_session.data()->getUnit());
+		}
+		m_session.data()->append(messages);
+		m_historyPending = false;
+		MessageList pending;
+		qSwap(pending, m_pendingMessages);
+		if (!pending.isEmpty())
+			appendMessages(pending);
+	});
 }
 
 void QuickChatController::setChatSession(ChatSession *session)
@@ -47,6 +47,7 @@ public:
 	virtual void setChatSession(qutim_sdk_0_3::ChatSession *session);
 	virtual qutim_sdk_0_3::ChatSession *getSession() const;
 	virtual void appendMessage(const qutim_sdk_0_3::Message &msg);
+	virtual void appendMessages(const qutim_sdk_0_3::MessageList &messages);
 	virtual void clearChat();
     Q_INVOKABLE QString parseEmoticons(const QString &) const;
     QQuickItem *item() const;
@@ -61,6 +62,7 @@ protected:
 	bool eventFilter(QObject *, QEvent *);
 signals:
 	void messageAppended(const QVariant &message);
+	void messagesAppended(const QVariantList &messages);
 	void messageDelivered(quint64 messageId);
 	void clearChatField();
 	void sessionChanged(QObject *);
@@ -68,8 +70,13 @@ signals:
     void itemChanged(QQuickItem *item);
 
 private:
+	bool deferMessage(const qutim_sdk_0_3::Message &msg);
 	QPointer<qutim_sdk_0_3::ChatSession> m_session;
     QPointer<QQuickItem> m_item;
+	// Messages appended while history is being read
+	qutim_sdk_0_3::MessageList m_pendingMessages;
+	bool m_historyPending;
+	int m_historyGeneration;
 };
 
 } // namespace AdiumChat
@@ -0,0 +1,135 @@
+import QtQuick 2.3
+import QtQuick.Controls 1.2
+import org.qutim 0.4 as Base
+
+Rectangle {
+    id: root
+    color: "transparent"
+
+    readonly property QtObject session: chatSession
+    readonly property QtObject messages: session.model
+    property string topic: ""
+
+    onSessionChanged: session.loadHistory()
+
+    signal appendTextRequested(string text)
+    signal appendNickRequested(string nick)
+
+    function copy() {
+        var item = listView.currentItem;
+        if (item)
+            item.copy();
+    }
+
+    Connections {
+        target: session
+        onMessageAppended: {
+            if (message.property("topic", false))
+                root.topic = message.html;
+        }
+        onAppendTextRequested: root.appendTextRequested(text)
+        onAppendNickRequested: root.appendNickRequested(nick)
+    }
+
+    Base.ControlledMenu {
+        id: menu
+    }
+
+    ScrollView {
+        id: scrollView
+        anchors.fill: parent
+        frameVisible: false
+
+        ListView {
+            id: listView
+            model: root.messages
+            // Only visible delegates and one screen around them are alive,
+            // the rest are destroyed and created again on demand
+            cacheBuffer: height
+            boundsBehavior: Flickable.StopAtBounds
+
+            onAtYEndChanged: if (!moving) root.messages.followEnd = atYEnd
+            onMovementEnded: root.messages.followEnd = atYEnd
+            onContentYChanged: {
+                if (contentY - originY < height && root.messages.canFetchOlder)
+                    root.messages.fetchOlder();
+            }
+            onCountChanged: if (root.messages.followEnd) positionViewAtEnd()
+
+            delegate: Item {
+                id: delegateItem
+                width: listView.width
+                height: body.y + body.height + 2
+
+                function copy() {
+                    body.copy();
+                }
+
+                Text {
+                    id: nickItem
+                    anchors {
+                        top: parent.top
+                        left: parent.left
+                        margins: 4
+                    }
+                    visible: !appending
+                    height: visible ? implicitHeight : 0
+                    textFormat: Text.PlainText
+                    font.bold: true
+                    text: senderName
+                    color: incoming ? "#ff6600" : "#0078ff"
+                    renderType: Text.NativeRendering
+
+                    MouseArea {
+                        anchors.fill: parent
+                        acceptedButtons: Qt.LeftButton | Qt.RightButton
+                        cursorShape: Qt.PointingHandCursor
+                        onClicked: {
+                            if (mouse.button === Qt.LeftButton) {
+                                root.session.appendNick(senderName);
+                            } else if (contact) {
+                                menu.controller = contact;
+                                menu.popup();
+                            }
+                        }
+                    }
+                }
+
+                Text {
+                    anchors {
+                        top: parent.top
+                        right: parent.right
+                        margins: 4
+                    }
+                    visible: !appending
+                    color: "gray"
+                    text: Qt.formatDateTime(time, '(hh:mm:ss)')
+                    renderType: Text.NativeRendering
+                }
+
+                TextEdit {
+                    id: body
+                    anchors {
+                        left: parent.left
+                        right: parent.right
+                        top: nickItem.bottom
+                        leftMargin: 4
+                        rightMargin: 4
+                        topMargin: appending ? 0 : 4
+                    }
+                    readOnly: true
+                    selectByMouse: true
+                    textFormat: TextEdit.RichText
+                    wrapMode: TextEdit.WrapAtWordBoundaryOrAnywhere
+                    text: formattedHtml
+                    color: service ? "gray" : (action ? "#8b008b" : "black")
+                    opacity: delivered ? 1 : 0.6
+                    renderType: Text.NativeRendering
+
+                    onLinkActivated: Qt.openUrlExternally(link)
+                    onActiveFocusChanged: if (activeFocus) listView.currentIndex = index
+                }
+            }
+        }
+    }
+}
@@ -81,7 +81,12 @@ QTextDocument *ChatChannel::getInputField()
 void ChatChannel::markRead(quint64 id)
 {
 	if (id == Q_UINT64_C(0xffffffffffffffff)) {
+		if (m_unread.isEmpty())
+			return;
+		const quint64 first = m_unread.first().id();
+		const quint64 last = m_unread.last().id();
 		m_unread.clear();
+		emit unreadRemoved(first, last);
 		emit unreadChanged(m_unread);
 		emit unreadCountChanged(m_unread.count());
 		return;
@@ -89,6 +94,7 @@ void ChatChannel::markRead(quint64 id)
 	for (int i = 0; i < m_unread.size(); ++i) {
 		if (m_unread.at(i).id() == id) {
 			m_unread.removeAt(i);
+			emit unreadRemoved(id, id);
 			emit unreadChanged(m_unread);
 			emit unreadCountChanged(m_unread.count());
 			return;
@@ -101,11 +107,6 @@ qutim_sdk_0_3::MessageList ChatChannel::unread() const
 	return m_unread;
 }
 
-int ChatChannel::unreadCount() const
-{
-	return m_unread.count();
-}
-
 void ChatChannel::addContact(qutim_sdk_0_3::Buddy *c)
 {
 	m_units->addUnit(c);
@@ -146,6 +147,7 @@ void ChatChannel::close()
 
 void ChatChannel::clear()
 {
+	m_model->clear();
     emit clearRequested();
 }
 
@@ -264,6 +266,7 @@ qint64 ChatChannel::doAppendMessage(qutim_sdk_0_3::Message &message)
 	
 	if ((!isActive() && !service) && message.isIncoming()) {
 		m_unread.append(message);
+		emit unreadAdded(message);
 		emit unreadChanged(m_unread);
 		emit unreadCountChanged(m_unread.count());
 	}
@@ -271,6 +274,7 @@ qint64 ChatChannel::doAppendMessage(qutim_sdk_0_3::Message &message)
 	if (!message.property("silent", false) && !isActive())
 		Notification::send(message);
 	
+	m_model->append(message);
 	emit messageAppended(message);
 	return message.id();
 }
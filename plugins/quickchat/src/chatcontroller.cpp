@@ -6,7 +6,6 @@
 #include <qutim/account.h>
 #include <qutim/conference.h>
 #include <qutim/history.h>
-#include <qutim/emoticons.h>
 #include <qutim/notification.h>
 #include <qutim/servicemanager.h>
 #include <qutim/chatsession.h>
@@ -17,7 +16,7 @@ namespace QuickChat
 using namespace qutim_sdk_0_3;
 
 ChatController::ChatController()
-    : m_session(nullptr)
+    : m_session(nullptr), m_historyPending(false), m_historyGeneration(0)
 {
     m_id = QUuid::createUuid().toString();
     m_client = ScriptClient::instance();
@@ -83,11 +82,16 @@ bool ChatController::isContentSimiliar(const Message &a, const Message &b)
 
 void ChatController::onMessageAppended(const qutim_sdk_0_3::Message &msg)
 {
+    // History goes above messages received while it is being read
+    if (m_historyPending && !msg.property("history", false)) {
+        m_pendingMessages << msg;
+        return;
+    }
     Message copy = msg;
-    QString html = UrlParser::parseUrls(copy.html(), UrlParser::Html);
     copy.setProperty("messageId", msg.id());
+    // Links and emoticons (except for topic) are parsed once per message
+    copy.setHtml(msg.formattedHtml());
     if (msg.property("topic", false)) {
-        copy.setHtml(html);
         m_topic = copy;
 //        if (!m_isLoading)
 //            updateTopic();
@@ -95,9 +99,6 @@ void ChatController::onMessageAppended(const qutim_sdk_0_3::Message &msg)
     }
     if (msg.property("firstFocus", false))
         clearFocusClass();
-    // We don't want emoticons in topic
-    html = Emoticons::theme().parseEmoticons(html);
-    copy.setHtml(html);
     bool similiar = isContentSimiliar(m_last, msg);
     QString script = m_style.scriptForAppendingContent(copy, similiar, false, false);
     m_last = msg;
@@ -233,15 +234,30 @@ void ChatController::loadHistory()
 {
     Config config = Config(QLatin1String("appearance")).group(QLatin1String("chat/history"));
     int max_num = config.value(QLatin1String("maxDisplayMessages"), 5);
-    MessageList messages = History::instance()->readSync(m_session->unit(), max_num);
-    foreach (Message mess, messages) {
-        mess.setProperty("silent", true);
-        mess.setProperty("store", false);
-        mess.setProperty("history", true);
-        if (!mess.chatUnit()) //TODO FIXME
-            mess.setChatUnit(m_session->unit());
-        m_session->append(mess);
+    const int generation = ++m_historyGeneration;
+    m_pendingMessages.clear();
+    if (!m_session) {
+        m_historyPending = false;
+        return;
     }
+    m_historyPending = true;
+    History::instance()->read(m_session->unit(), max_num).connect(this, [this, generation] (const MessageList &messages) {
+        if (generation != m_historyGeneration || !m_session)
+            return;
+        foreach (Message mess, messages) {
+            mess.setProperty("silent", true);
+            mess.setProperty("store", false);
+            mess.setProperty("history", true);
+            if (!mess.chatUnit()) //TODO FIXME
+                mess.setChatUnit(m_session->unit());
+            m_session->append(mess);
+        }
+        m_historyPending = false;
+        MessageList pending;
+        qSwap(pending, m_pendingMessages);
+        foreach (const Message &mess, pending)
+            onMessageAppended(mess);
+    });
 }
 
 QString ChatController::scriptForFontUpdate()
@@ -81,6 +81,10 @@ private:
     QStringList m_pendingScripts;
     qutim_sdk_0_3::Message m_last;
     qutim_sdk_0_3::Message m_topic;
+    // Messages appended while history is being read
+    qutim_sdk_0_3::MessageList m_pendingMessages;
+    bool m_historyPending;
+    int m_historyGeneration;
 };
 
 } // namespace QuickChat
@@ -29,6 +29,8 @@
 #include <qutim/chatunit.h>
 #include <qutim/chatsession.h>
 #include <qutim/conference.h>
+#include <qutim/config.h>
+#include <qutim/history.h>
 #include <QDateTime>
 
 namespace QuickChat
@@ -47,41 +49,168 @@ enum {
 	HtmlRole,
 	ActionRole,
 	ServiceRole,
-	AppendingRole
+	AppendingRole,
+	MessageRole,
+	FormattedHtmlRole
 };
 
-ChatMessageModel::ChatMessageModel(QObject *parent) :
-    QAbstractListModel(parent)
+ChatMessageModel::ChatMessageModel(ChatSession *session) :
+    QAbstractListModel(session), m_session(session), m_generation(0),
+    m_followEnd(true), m_canFetchOlder(true), m_loading(false)
 {
-	parent->installEventFilter(this);
+	Config config(QStringLiteral("appearance"));
+	config.beginGroup(QStringLiteral("quickchat"));
+	m_windowSize = qMax(1, config.value(QStringLiteral("windowSize"), 200));
+	m_prefetchSize = qMax(1, config.value(QStringLiteral("prefetchSize"), 50));
+	session->installEventFilter(this);
 }
 
-void ChatMessageModel::append(qutim_sdk_0_3::Message &msg)
+void ChatMessageModel::append(const qutim_sdk_0_3::Message &msg)
 {
-	beginInsertRows(QModelIndex(), m_messages.size(), m_messages.size());
-	m_messages << msg;
+	if (msg.property("topic", false))
+		return;
+	// Messages usually come in order, so look for the place from the end
+	int index = m_items.size();
+	while (index > 0 && msg.time() < m_items.at(index - 1).message.time())
+		--index;
+	Item item = { msg, msg.isIncoming() };
+	beginInsertRows(QModelIndex(), index, index);
+	m_items.insert(index, item);
 	endInsertRows();
+	if (index + 1 < m_items.size()) {
+		// Grouping of the next message may be changed
+		const QModelIndex next = createIndex(index + 1, 0);
+		emit dataChanged(next, next, QVector<int>() << AppendingRole);
+	}
+	trim();
+}
+
+void ChatMessageModel::clear()
+{
+	++m_generation;
+	beginResetModel();
+	m_items.clear();
+	endResetModel();
+	setLoading(false);
+	setCanFetchOlder(true);
 }
 
 bool ChatMessageModel::eventFilter(QObject *obj, QEvent *ev)
 {
 	if (ev->type() == MessageReceiptEvent::eventType()) {
 		MessageReceiptEvent *event = static_cast<MessageReceiptEvent*>(ev);
+		for (int i = m_items.size() - 1; i >= 0; --i) {
+			if (m_items.at(i).message.id() == event->id()) {
+				m_items[i].delivered = event->success();
+				const QModelIndex index = createIndex(i, 0);
+				emit dataChanged(index, index, QVector<int>() << DeliveredRole);
+				break;
+			}
+		}
 	}
 	return QAbstractListModel::eventFilter(obj, ev);
 }
 
+bool ChatMessageModel::followEnd() const
+{
+	return m_followEnd;
+}
+
+void ChatMessageModel::setFollowEnd(bool followEnd)
+{
+	if (m_followEnd == followEnd)
+		return;
+	m_followEnd = followEnd;
+	emit followEndChanged(followEnd);
+	trim();
+}
+
+bool ChatMessageModel::canFetchOlder() const
+{
+	return m_canFetchOlder;
+}
+
+bool ChatMessageModel::isLoading() const
+{
+	return m_loading;
+}
+
+void ChatMessageModel::fetchOlder()
+{
+	if (m_loading || !m_canFetchOlder || !m_session || !m_session->unit())
+		return;
+	const QDateTime to = m_items.isEmpty() ? QDateTime::currentDateTime() : m_items.first().message.time();
+	const int generation = m_generation;
+	setLoading(true);
+	auto result = History::instance()->read(m_session->unit(), to, m_prefetchSize);
+	result.connect(this, [this, generation] (MessageList messages) {
+		if (generation != m_generation)
+			return;
+		setLoading(false);
+		if (messages.size() < m_prefetchSize)
+			setCanFetchOlder(false);
+		QList<Item> items;
+		items.reserve(messages.size());
+		for (Message &message : messages) {
+			if (!m_items.isEmpty() && message.time() >= m_items.first().message.time())
+				continue;
+			message.setProperty("history", true);
+			if (!message.chatUnit()) //TODO FIXME
+				message.setChatUnit(m_session->unit());
+			Item item = { message, true };
+			items << item;
+		}
+		if (items.isEmpty())
+			return;
+		beginInsertRows(QModelIndex(), 0, items.size() - 1);
+		m_items = items + m_items;
+		endInsertRows();
+		const QModelIndex next = createIndex(items.size(), 0);
+		if (items.size() < m_items.size())
+			emit dataChanged(next, next, QVector<int>() << AppendingRole);
+	});
+}
+
+void ChatMessageModel::trim()
+{
+	// Drop the oldest messages only while user looks at the end of conversation,
+	// otherwise they would jump out of the view
+	if (!m_followEnd || m_items.size() <= m_windowSize)
+		return;
+	const int count = m_items.size() - m_windowSize;
+	beginRemoveRows(QModelIndex(), 0, count - 1);
+	m_items.erase(m_items.begin(), m_items.begin() + count);
+	endRemoveRows();
+	setCanFetchOlder(true);
+}
+
+void ChatMessageModel::setCanFetchOlder(bool canFetchOlder)
+{
+	if (m_canFetchOlder == canFetchOlder)
+		return;
+	m_canFetchOlder = canFetchOlder;
+	emit canFetchOlderChanged(canFetchOlder);
+}
+
+void ChatMessageModel::setLoading(bool loading)
+{
+	if (m_loading == loading)
+		return;
+	m_loading = loading;
+	emit loadingChanged(loading);
+}
+
 int ChatMessageModel::rowCount(const QModelIndex &parent) const
 {
 	Q_UNUSED(parent);
-	return m_messages.size();
+	return m_items.size();
 }
 
 QVariant ChatMessageModel::data(const QModelIndex &index, int role) const
 {
-	if (index.row() < 0 || index.row() >= m_messages.size())
+	if (index.row() < 0 || index.row() >= m_items.size())
 		return QVariant();
-	const Message &msg = m_messages[index.row()];
+	const Message &msg = m_items[index.row()].message;
 	switch (role) {
 	case IdRole:
 		return msg.id();
@@ -103,26 +232,32 @@ QVariant ChatMessageModel::data(const QModelIndex &index, int role) const
 	}
 	case TimeRole:
 		return msg.time();
+	case IncomingRole:
+		return msg.isIncoming();
 	case UnitRole:
 		return qVariantFromValue<QObject*>(msg.chatUnit());
 	case SenderNameRole:
 		return createSenderName(msg);
 	case DeliveredRole:
-		return false;
+		return m_items[index.row()].delivered;
 	case HtmlRole:
 		return msg.property("html");
 	case ActionRole:
-		return msg.property("action", false);
+		return msg.property("action", false) || msg.isAction();
 	case ServiceRole:
 		return msg.property("service", false);
 	case AppendingRole:
 		if (index.row() > 0) {
-			const Message &prev = m_messages[index.row() - 1];
+			const Message &prev = m_items[index.row() - 1].message;
 			return prev.isIncoming() == msg.isIncoming()
 			        && prev.time().date() == msg.time().date()
 			        && createSenderName(prev) == createSenderName(msg);
 		}
 		return false;
+	case MessageRole:
+		return QVariant::fromValue(msg);
+	case FormattedHtmlRole:
+		return msg.formattedHtml();
 	default:
 		return QVariant();
     }
@@ -146,9 +281,10 @@ QHash<int, QByteArray> ChatMessageModel::roleNames() const
     roleNames.insert(ActionRole, "action");
     roleNames.insert(ServiceRole, "service");
     roleNames.insert(AppendingRole, "appending");
+    roleNames.insert(MessageRole, "message");
+    roleNames.insert(FormattedHtmlRole, "formattedHtml");
     return roleNames;
 }
-
 QString ChatMessageModel::createSenderName(const Message &msg) const
 {
 	QString senderName = msg.property("senderName",QString());
@@ -27,18 +27,36 @@
 #define CHATMESSAGEMODEL_H
 
 #include <QAbstractListModel>
+#include <QPointer>
 #include <qutim/message.h>
 
+namespace qutim_sdk_0_3
+{
+class ChatSession;
+}
+
 namespace QuickChat
 {
+// Keeps only a window of the conversation, older messages are fetched
+// from history by pages while the view is scrolled back
 class ChatMessageModel : public QAbstractListModel
 {
     Q_OBJECT
+    Q_PROPERTY(bool followEnd READ followEnd WRITE setFollowEnd NOTIFY followEndChanged)
+    Q_PROPERTY(bool canFetchOlder READ canFetchOlder NOTIFY canFetchOlderChanged)
+    Q_PROPERTY(bool loading READ isLoading NOTIFY loadingChanged)
 public:
-    explicit ChatMessageModel(QObject *parent = 0);
+    explicit ChatMessageModel(qutim_sdk_0_3::ChatSession *session);
 
-	void append(qutim_sdk_0_3::Message &msg);
+	void append(const qutim_sdk_0_3::Message &msg);
+	void clear();
 	bool eventFilter(QObject *, QEvent *);
+
+	bool followEnd() const;
+	void setFollowEnd(bool followEnd);
+	bool canFetchOlder() const;
+	bool isLoading() const;
+	Q_INVOKABLE void fetchOlder();
 	
 	// QAbstractListModel
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
@@ -46,21 +64,30 @@ public:
     QHash<int, QByteArray> roleNames() const;
 	
 signals:
-
-public slots:
+	void followEndChanged(bool followEnd);
+	void canFetchOlderChanged(bool canFetchOlder);
+	void loadingChanged(bool loading);
 
 private:
+	void trim();
+	void setCanFetchOlder(bool canFetchOlder);
+	void setLoading(bool loading);
 	QString createSenderName(const qutim_sdk_0_3::Message &msg) const;
 	struct Item
 	{
-		QString plainText;
-		QString richText;
+		qutim_sdk_0_3::Message message;
+		bool delivered;
 	};
 	QList<Item> m_items;
-
-	QList<qutim_sdk_0_3::Message> m_messages;
+	QPointer<qutim_sdk_0_3::ChatSession> m_session;
+	int m_windowSize;
+	int m_prefetchSize;
+	// Increased by clear() to drop replies of outdated history requests
+	int m_generation;
+	bool m_followEnd;
+	bool m_canFetchOlder;
+	bool m_loading;
 };
 }
 
 #endif // CHATMESSAGEMODEL_H
-
@@ -36,6 +36,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QDebug>
+#include <QUrlQuery>
 
 #include <QtWebSockets/QWebSocket>
 
@@ -45,10 +46,22 @@
     The transport delegates all messages received over the QWebSocket over its
     textMessageReceived signal. Analogously, all calls to sendTextMessage will
     be send over the QWebSocket to the remote client.
+
+    Clients which connect with \c{framing=batch} query item receive messages
+    in binary frames instead, each frame holds newline separated compact JSON
+    documents of all messages sent during one event loop iteration. While the
+    socket has more than MaxBytesInFlight of unwritten data new messages are
+    only queued, so a flood is coalesced into few large frames.
 */
 
 namespace QuickChat {
 
+enum {
+    MaxBytesInFlight = 256 * 1024,
+    // Client which doesn't read anything is dropped instead of growing our memory
+    MaxPendingBytes = 16 * 1024 * 1024
+};
+
 /*!
     Construct the transport object and wrap the given socket.
 
@@ -57,9 +70,20 @@ namespace QuickChat {
 WebSocketTransport::WebSocketTransport(QWebSocket *socket)
 : QWebChannelAbstractTransport(socket)
 , m_socket(socket)
+, m_pendingCount(0)
+, m_bytesInFlight(0)
 {
+    const QUrlQuery query(socket->requestUrl());
+    m_batched = query.queryItemValue(QStringLiteral("framing")) == QLatin1String("batch");
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    connect(&m_flushTimer, &QTimer::timeout, this, &WebSocketTransport::flush);
+
     connect(socket, &QWebSocket::textMessageReceived,
             this, &WebSocketTransport::textMessageReceived);
+    connect(socket, &QWebSocket::bytesWritten,
+            this, &WebSocketTransport::onBytesWritten);
 }
 
 /*!
@@ -71,12 +95,51 @@ WebSocketTransport::~WebSocketTransport()
 }
 
 /*!
-    Serialize the JSON message and send it as a text message via the WebSocket to the client.
+    Serialize the JSON message and send it as a text message via the WebSocket to the client,
+    or queue it for the next binary frame if the client supports batches.
 */
 void WebSocketTransport::sendMessage(const QJsonObject &message)
 {
     QJsonDocument doc(message);
-    m_socket->sendTextMessage(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+    const QByteArray data = doc.toJson(QJsonDocument::Compact);
+    if (!m_batched) {
+        m_socket->sendTextMessage(QString::fromUtf8(data));
+        return;
+    }
+
+    if (m_pendingCount > 0)
+        m_pending += '\n';
+    m_pending += data;
+    ++m_pendingCount;
+
+    if (m_pending.size() > MaxPendingBytes) {
+        qWarning() << "WebSocket client doesn't read messages, closing connection";
+        m_pending.clear();
+        m_pendingCount = 0;
+        m_socket->close(QWebSocketProtocol::CloseCodeTooMuchData);
+        return;
+    }
+
+    if (m_bytesInFlight < MaxBytesInFlight && !m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void WebSocketTransport::onBytesWritten(qint64 bytes)
+{
+    m_bytesInFlight = qMax<qint64>(0, m_bytesInFlight - bytes);
+    if (m_pendingCount > 0 && m_bytesInFlight < MaxBytesInFlight && !m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void WebSocketTransport::flush()
+{
+    if (m_pendingCount == 0 || m_bytesInFlight >= MaxBytesInFlight)
+        return;
+
+    QByteArray data;
+    qSwap(data, m_pending);
+    m_pendingCount = 0;
+    m_bytesInFlight += m_socket->sendBinaryMessage(data);
 }
 
 /*!
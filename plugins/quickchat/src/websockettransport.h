@@ -35,6 +35,7 @@
 #define WEBSOCKETTRANSPORT_H
 
 #include <QWebChannelAbstractTransport>
+#include <QTimer>
 
 class QWebSocket;
 
@@ -51,9 +52,16 @@ public:
 
 private Q_SLOTS:
     void textMessageReceived(const QString &message);
+    void onBytesWritten(qint64 bytes);
+    void flush();
 
 private:
     QWebSocket *m_socket;
+    QTimer m_flushTimer;
+    QByteArray m_pending;
+    int m_pendingCount;
+    qint64 m_bytesInFlight;
+    bool m_batched;
 };
 
 } // namespace QuickChat
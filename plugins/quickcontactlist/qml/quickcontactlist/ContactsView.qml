@@ -10,37 +10,49 @@ ListView {
         name: "ContactModel"
     }
 
-    property Component accountItem: Text {
-        text: title + " (contact)"
-    }
-    property Component groupItem: Text {
-        text: title + " (group)"
-    }
-    property Component contactItem: Text {
-        text: title + " (contact)"
+    ContactListModel {
+        id: listModel
+        sourceModel: contactModel.object
     }
 
-    function componentByType(type) {
-        if (type === Constants.ACCOUNT)
-            return accountItem;
-        if (type === Constants.GROUP)
-            return groupItem;
-        if (type === Constants.CONTACT)
-            return contactItem;
-        return undefined;
-    }
-    
-    VisualDataModel {
-        id: rootModel
-        model: contactModel.object
-        delegate: ListView {
-            header: componentByType(itemType)
+    model: listModel
+    section.property: "section"
+
+    delegate: Loader {
+        id: delegate
+
+        property Component accountItem: Text {
+            text: title + " (account)"
+        }
+        property Component groupItem: Text {
+            text: title + " (group)"
+            MouseArea {
+                anchors.fill: parent
+                onClicked: listModel.setCollapsed(index, !collapsed)
+            }
+        }
+        property Component contactItem: Row {
+            spacing: 4
+            Image {
+                width: 16
+                height: 16
+                sourceSize: Qt.size(16, 16)
+                source: statusIcon
+            }
+            Text {
+                text: title
+            }
+        }
+
+        x: depth * 12
+        sourceComponent: {
+            if (itemType === Constants.ACCOUNT)
+                return accountItem;
+            if (itemType === Constants.GROUP)
+                return groupItem;
+            if (itemType === Constants.CONTACT)
+                return contactItem;
+            return undefined;
         }
-//        ItemDelegate {
-//            view: root
-//            rootIndex: rootModel.modelIndex(index)
-//        }
     }
-    
-    model: rootModel
 }
@@ -28,8 +28,12 @@
 #include <QPixmap>
 #include <QNetworkRequest>
 #include <QNetworkReply>
-#include <QHttpMultiPart>
 #include <qutim/config.h>
+#include <qutim/networkaccess.h>
+#include <qutim/executor.h>
+#include <qutim/asyncresult.h>
+#include <QImageWriter>
+#include <QFileInfo>
 #include <QDesktopWidget>
 #if defined Q_OS_WIN
 #include <windows.h>
@@ -40,7 +44,7 @@
 #endif
 Shoter::Shoter(QWidget *parent) :
 	QMainWindow(parent),
-	ui(new Ui::Screenshoter)
+	ui(new Ui::Screenshoter), m_generation(0), m_sendPending(false)
 {
 	ui->setupUi(this);
 	QObject::connect(ui->btnCancel,  SIGNAL(clicked()),  this,  SLOT(onButtonCancelClicked()));
@@ -65,8 +69,6 @@ Shoter::Shoter(QWidget *parent) :
 	ui->btnShot->setToolTip("Ctrl+R");
 	m_linkLabel.setTextFormat(Qt::PlainText);
 	m_linkLabel.installEventFilter(this);
-	m_manager = new QNetworkAccessManager(this);
-	QObject::connect(m_manager,  SIGNAL(finished(QNetworkReply*)),  this,  SLOT(finishedSlot(QNetworkReply*)));
 	readSettings();
 }
 
@@ -78,55 +80,50 @@ Shoter::~Shoter()
 
 void Shoter::onButtonSendClicked()
 {
-	/*Create file */
-	QDate date = QDate::currentDate();
-	QString name_file = date.toString();
-	QString savedFile = name_file+".png";
-	QTemporaryFile file;
-	file.setFileName(savedFile);
-	if (!m_screenshot.save(&file)) {
-		qDebug("file is not saved");
-		exit(1);
+	// Encoding started right after the shot may be still in progress
+	if (m_encoded.isEmpty()) {
+		m_sendPending = true;
+		m_linkLabel.setText(tr(" Encoding..."));
+		return;
 	}
-	// qDebug()<<file.fileName();
-	QFile *openFile = new QFile(savedFile);
-	openFile->open(QIODevice::ReadOnly);
-	QHttpMultiPart *multi = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+	m_sendPending = false;
+
+	const QString fileName = QDate::currentDate().toString() + QLatin1Char('.') + m_encodedFormat;
+	const QByteArray contentType = "image/" + m_encodedFormat.toLatin1();
+	qutim_sdk_0_3::NetworkUpload::FormFields fields;
+	QByteArray fileField;
+	QString url;
 	/* Upload to ipix.su */
 	if (ui->comboBox->currentIndex()== 0) {
-		QHttpPart file;
-		file.setHeader(QNetworkRequest::ContentTypeHeader,QVariant("image/png"));
-		file.setHeader(QNetworkRequest::ContentDispositionHeader,QVariant("form-data; name=\"file\"; filename=\""+savedFile+"\""));
-		file.setBodyDevice(openFile);
-		openFile->setParent(multi);
-		multi->append(file);
-		this->upload("http://ipix.su/api/upload",multi);
+		fileField = "file";
+		url = QLatin1String("http://ipix.su/api/upload");
 		/* upload to pix.academ.org */
 	} else if (ui->comboBox->currentIndex() == 1) {
-		QHttpPart action;
-		action.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("name=\"action\""));
-		action.setBody("upload_image");
-		QHttpPart image;
-		image.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("image/png"));
-		image.setHeader(QNetworkRequest::ContentDispositionHeader,
-						QVariant("form-data; name=\"image\"; filename=\""+savedFile+"\""));
-		image.setBodyDevice(openFile);
-		openFile->setParent(multi);
-		multi->append(action);
-		multi->append(image);
-		upload("http://pix.academ.org", multi);
+		fields << qMakePair(QByteArray("action"), QByteArray("upload_image"));
+		fileField = "image";
+		url = QLatin1String("http://pix.academ.org");
 		/* Upload to ompldr.org*/
 	} else if (ui->comboBox->currentIndex() == 2) {
-		QHttpPart file1;
-		file1.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("image/png"));
-		file1.setHeader(QNetworkRequest::ContentDispositionHeader,
-						QVariant("form-data; name=\"file1\"; filename=\""+savedFile+"\""));
-		file1.setBodyDevice(openFile);
-		openFile->setParent(multi);
-		multi->append(file1);
-		upload("http://ompldr.org/upload", multi);
+		fileField = "file1";
+		url = QLatin1String("http://ompldr.org/upload");
+	} else {
+		return;
 	}
+
+	// Encoded bytes are sent from memory, nothing is written to disk
+	m_buffer.close();
+	m_buffer.setData(m_encoded);
+	m_buffer.open(QIODevice::ReadOnly);
+	if (!m_upload) {
+		m_upload = new qutim_sdk_0_3::NetworkUpload(qutim_sdk_0_3::NetworkAccess::manager(), this);
+		connect(m_upload, SIGNAL(finished(QNetworkReply*)), SLOT(finishedSlot(QNetworkReply*)));
+		connect(m_upload, SIGNAL(progress(qint64,qint64)), SLOT(upProgress(qint64,qint64)));
+	}
+	m_upload->setRequest(qutim_sdk_0_3::NetworkAccess::request(QUrl(url)), "POST");
+	m_upload->setMultipart(fileField, fileName, fields, contentType);
+	m_upload->start(&m_buffer);
 }
+
 void Shoter::onButtonCancelClicked()
 {
 	writeSettings();
@@ -134,9 +131,11 @@ void Shoter::onButtonCancelClicked()
 }
 void Shoter::finishedSlot(QNetworkReply *reply)
 {
-	reply->deleteLater();
 	QString labelText;
-	if (reply->error() == QNetworkReply::NoError) {
+	if (!reply) {
+		m_pal.setColor(QPalette::WindowText,Qt::red);
+		labelText = tr(" Can't send the screenshot");
+	} else if (reply->error() == QNetworkReply::NoError) {
 		QByteArray bytes = reply->readAll();
 		QString string(bytes);
 		QStringList list;
@@ -185,6 +184,14 @@ void Shoter::onPushSaveClicked()
 {
 	QString file_on_disk = QFileDialog::getSaveFileName(this, tr("Save File"),
 														tr("untitled.png"), tr("Images(*.png *.xpm *.jpg)"));
+	if (file_on_disk.isEmpty())
+		return;
+	// Already encoded data is reused when it has requested format
+	if (!m_encoded.isEmpty() && QFileInfo(file_on_disk).suffix().toLower() == m_encodedFormat) {
+		QFile file(file_on_disk);
+		if (file.open(QIODevice::WriteOnly) && file.write(m_encoded) == m_encoded.size())
+			return;
+	}
 	m_screenshot.save(file_on_disk);
 }
 
@@ -246,15 +253,6 @@ void Shoter::writeSettings()
 	p_settings.endGroup();
 }
 
-void Shoter::upload(const QString &hostUrl,  QHttpMultiPart *multipart)
-{
-	QUrl url(hostUrl);
-	QNetworkRequest request(url);
-	QNetworkReply *r = m_manager->post(request,  multipart);
-	multipart->setParent(r);
-	QObject::connect(r,  SIGNAL(uploadProgress(qint64,  qint64)),  this,  SLOT(upProgress(qint64,  qint64)));
-}
-
 void Shoter::shot(WId pwid)
 {
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
@@ -263,6 +261,55 @@ void Shoter::shot(WId pwid)
 	m_screenshot = QGuiApplication::primaryScreen()->grabWindow(pwid);
 #endif 
 	setScreenShot();
+	encode();
+}
+
+void Shoter::encode()
+{
+	using namespace qutim_sdk_0_3;
+	if (m_upload)
+		m_upload->abort();
+	m_encoded.clear();
+	const int generation = ++m_generation;
+
+	Config config;
+	config.beginGroup(QLatin1String("Screenshoter"));
+	QByteArray format = config.value(QLatin1String("format"), QString::fromLatin1("png")).toLatin1().toLower();
+	// Compression level is 0-9 like zlib, it's converted to quality of QImageWriter
+	const int compression = config.value(QLatin1String("compression"), -1);
+	const int quality = compression < 0 ? -1 : 100 - qBound(0, compression, 9) * 100 / 9;
+	config.endGroup();
+	if (!QImageWriter::supportedImageFormats().contains(format))
+		format = "png";
+	m_encodedFormat = QString::fromLatin1(format);
+
+	// QPixmap can't be used outside of GUI thread, QImage is shared implicitly
+	const QImage image = m_screenshot.toImage();
+	AsyncResultHandler<QByteArray> handler;
+	Executor::named(QStringLiteral("Screenshoter"), 1)->run([image, format, quality, handler] () {
+		QByteArray data;
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::WriteOnly);
+		QImageWriter writer(&buffer, format);
+		writer.setQuality(quality);
+		if (!writer.write(image))
+			data.clear();
+		handler.handle(data);
+	}, Executor::InteractivePriority);
+
+	handler.result().connect(this, [this, generation] (const QByteArray &data) {
+		if (generation != m_generation)
+			return;
+		m_encoded = data;
+		if (m_sendPending) {
+			if (m_encoded.isEmpty()) {
+				m_sendPending = false;
+				finishedSlot(0);
+			} else {
+				onButtonSendClicked();
+			}
+		}
+	});
 }
 
 void Shoter::startShoter()
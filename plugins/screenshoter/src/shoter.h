@@ -30,9 +30,11 @@
 #include <QtGui>
 #include <QPixmap>
 #include <QNetworkReply>
-#include <QNetworkAccessManager>
 #include "ui_screenshoter.h"
 #include <QProgressBar>
+#include <QBuffer>
+#include <QPointer>
+#include <qutim/networkupload.h>
 
 class Shoter :public QMainWindow
 {
@@ -62,17 +64,22 @@ private slots:
 
 private:
 	Ui::Screenshoter *ui;
-	void upload(const QString &hostUrl, QHttpMultiPart *multipart);
 	void shot(WId pwid);
+	void encode();
 	void writeSettings();
 	void startDrg();
 	QPixmap m_screenshot;
+	QByteArray m_encoded;
+	QString m_encodedFormat;
+	QBuffer m_buffer;
+	QPointer<qutim_sdk_0_3::NetworkUpload> m_upload;
+	int m_generation;
+	bool m_sendPending;
 	QLabel m_linkLabel;
 	QPoint m_DragPos;
 	QProgressBar m_progressBar;
 	QMimeData *m_MimeData;
 	QPalette m_pal;
-	QNetworkAccessManager *m_manager;
 };
 
 #endif  // SHOTER_H
@@ -0,0 +1,162 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "scripthandlerworker.h"
+#include "scriptprogramcache.h"
+#include <qutim/chatunit.h>
+#include <qutim/debug.h>
+#include <QCoreApplication>
+#include <QScriptEngine>
+#include <QPointer>
+#include <QHash>
+
+namespace qutim_sdk_0_3
+{
+ScriptHandlerWorker::ScriptHandlerWorker()
+    : QThread(QCoreApplication::instance()), m_quit(false)
+{
+}
+
+ScriptHandlerWorker::~ScriptHandlerWorker()
+{
+	m_mutex.lock();
+	m_quit = true;
+	m_condition.wakeOne();
+	m_mutex.unlock();
+	wait();
+}
+
+ScriptHandlerWorker *ScriptHandlerWorker::instance()
+{
+	static QPointer<ScriptHandlerWorker> worker;
+	if (!worker) {
+		worker = new ScriptHandlerWorker;
+		worker->start(QThread::LowPriority);
+	}
+	return worker.data();
+}
+
+void ScriptHandlerWorker::handle(const QString &source, const QVariantMap &message,
+                                 const Callback &callback)
+{
+	Job job;
+	job.source = source;
+	job.message = message;
+	job.callback = callback;
+	job.invoker = Detail::AsyncInvoker::current();
+
+	QMutexLocker locker(&m_mutex);
+	m_queue << job;
+	if (m_queue.size() == 1)
+		m_condition.wakeOne();
+}
+
+QVariantMap ScriptHandlerWorker::toVariant(const Message &message)
+{
+	QVariantMap map;
+	foreach (const QByteArray &name, message.dynamicPropertyNames()) {
+		// Only plain values can be passed to another engine
+		const QVariant value = message.property(name);
+		if (value.userType() < QMetaType::User)
+			map.insert(QString::fromUtf8(name), value);
+	}
+	map.insert(QStringLiteral("text"), message.text());
+	map.insert(QStringLiteral("html"), message.html());
+	map.insert(QStringLiteral("incoming"), message.isIncoming());
+	map.insert(QStringLiteral("time"), message.time());
+	map.insert(QStringLiteral("id"), message.id());
+	if (ChatUnit *unit = message.chatUnit())
+		map.insert(QStringLiteral("unit"), unit->id());
+	return map;
+}
+
+void ScriptHandlerWorker::apply(Message &message, const QVariantMap &original, const QVariantMap &changed)
+{
+	for (auto it = changed.constBegin(); it != changed.constEnd(); ++it) {
+		const QString &key = it.key();
+		if (original.value(key) == it.value())
+			continue;
+		if (key == QLatin1String("text"))
+			message.setText(it->toString());
+		else if (key == QLatin1String("html"))
+			message.setHtml(it->toString());
+		else if (key != QLatin1String("incoming") && key != QLatin1String("time")
+		         && key != QLatin1String("id") && key != QLatin1String("unit"))
+			message.setProperty(key.toUtf8(), it.value());
+	}
+}
+
+void ScriptHandlerWorker::run()
+{
+	QScriptEngine engine;
+	QHash<QString, QScriptValue> functions;
+	QScriptValue that = engine.newObject();
+	that.setProperty(QStringLiteral("Accept"), MessageHandler::Accept, QScriptValue::ReadOnly);
+	that.setProperty(QStringLiteral("Reject"), MessageHandler::Reject, QScriptValue::ReadOnly);
+	that.setProperty(QStringLiteral("Error"), MessageHandler::Error, QScriptValue::ReadOnly);
+
+	forever {
+		QMutexLocker locker(&m_mutex);
+		while (m_queue.isEmpty() && !m_quit)
+			m_condition.wait(&m_mutex);
+		if (m_quit)
+			break;
+		const Job job = m_queue.takeFirst();
+		locker.unlock();
+
+		QScriptValue &function = functions[job.source];
+		if (!function.isFunction()) {
+			function = engine.evaluate(ScriptProgramCache::source(job.source));
+			if (engine.hasUncaughtException()) {
+				debug() << "Threaded message handler can't be compiled:"
+				        << engine.uncaughtException().toString();
+				engine.clearExceptions();
+			}
+		}
+
+		MessageHandler::Result result = MessageHandler::Accept;
+		QVariantMap changed = job.message;
+		if (function.isFunction()) {
+			QScriptValue message = engine.toScriptValue(job.message);
+			QScriptValue ret = function.call(that, QScriptValueList() << message);
+			if (engine.hasUncaughtException()) {
+				debug() << engine.uncaughtException().toString()
+				        << engine.uncaughtExceptionBacktrace();
+				engine.clearExceptions();
+			} else {
+				// Pending can't be reported by handler which already runs asynchronously
+				if (ret.isNumber() && ret.toInt32() != MessageHandler::Pending)
+					result = static_cast<MessageHandler::Result>(ret.toInt32());
+				changed = message.toVariant().toMap();
+			}
+		}
+
+		const Callback callback = job.callback;
+		job.invoker->post([callback, result, changed] () {
+			callback(result, changed);
+		});
+	}
+}
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef SCRIPTHANDLERWORKER_H
+#define SCRIPTHANDLERWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QLinkedList>
+#include <QVariantMap>
+#include <qutim/messagehandler.h>
+#include <functional>
+
+namespace qutim_sdk_0_3
+{
+/**
+ * Thread with its own QScriptEngine, which runs message handlers registered
+ * as threaded ones. Such handler is recompiled from its source inside the
+ * worker engine, so it can't reach closures or objects of the plugin engine.
+ * It receives plain copy of the message and may change text, html and
+ * dynamic properties, everything else is read-only for it.
+ */
+class ScriptHandlerWorker : public QThread
+{
+	Q_OBJECT
+public:
+	typedef std::function<void (MessageHandler::Result, const QVariantMap &)> Callback;
+
+	static ScriptHandlerWorker *instance();
+	~ScriptHandlerWorker();
+
+	// Callback is called in the thread, which has called this method
+	void handle(const QString &source, const QVariantMap &message, const Callback &callback);
+
+	static QVariantMap toVariant(const Message &message);
+	static void apply(Message &message, const QVariantMap &original, const QVariantMap &changed);
+
+protected:
+	void run() override;
+
+private:
+	ScriptHandlerWorker();
+
+	struct Job
+	{
+		QString source;
+		QVariantMap message;
+		Callback callback;
+		Detail::AsyncInvoker *invoker;
+	};
+
+	QMutex m_mutex;
+	QWaitCondition m_condition;
+	QLinkedList<Job> m_queue;
+	bool m_quit;
+};
+}
+
+#endif // SCRIPTHANDLERWORKER_H
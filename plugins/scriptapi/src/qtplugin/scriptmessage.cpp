@@ -28,6 +28,7 @@
 #include "scriptmessagepropertyiterator.h"
 #include <QScriptEngine>
 #include <QScriptValueIterator>
+#include <qutim/chatunit.h>
 #include <qutim/debug.h>
 
 namespace qutim_sdk_0_3
@@ -110,7 +111,12 @@ QScriptValue createMessage(QScriptContext *context, QScriptEngine *engine)
 ScriptMessage::ScriptMessage(QScriptEngine *engine) : QScriptClass(engine)
 {
 	debug() << Q_FUNC_INFO;
-	m_incoming = engine->toStringHandle(QLatin1String("incoming"));
+	m_fields[IncomingField] = engine->toStringHandle(QLatin1String("incoming"));
+	m_fields[TextField] = engine->toStringHandle(QLatin1String("text"));
+	m_fields[HtmlField] = engine->toStringHandle(QLatin1String("html"));
+	m_fields[TimeField] = engine->toStringHandle(QLatin1String("time"));
+	m_fields[ChatUnitField] = engine->toStringHandle(QLatin1String("chatUnit"));
+	m_fields[IdField] = engine->toStringHandle(QLatin1String("id"));
 	ScriptEngineData::data(engine)->message = this;
 	qScriptRegisterMetaType(engine, messageToScriptValue, messageFromScriptValue);
 	qScriptRegisterMetaType(engine, messagePtrToScriptValue, messagePtrFromScriptValue);
@@ -130,19 +136,36 @@ QScriptClass::QueryFlags ScriptMessage::queryProperty(const QScriptValue &object
                                                       QueryFlags flags, uint *id)
 {
 	Q_UNUSED(object);
-	Q_UNUSED(name);
 	Q_UNUSED(flags);
-	Q_UNUSED(id);
+	*id = DynamicField;
+	for (int i = DynamicField + 1; i < FieldCount; ++i) {
+		if (name == m_fields[i]) {
+			*id = i;
+			break;
+		}
+	}
 	return HandlesReadAccess | HandlesWriteAccess;
 }
 
 QScriptValue ScriptMessage::property(const QScriptValue &object, const QScriptString &name, uint id)
 {
-	Q_UNUSED(id);
 	Message *msg = message_get_value(object);
-	if (name == m_incoming)
+	switch (id) {
+	case IncomingField:
 		return msg->isIncoming();
-	return engine()->toScriptValue(msg->property(name.toString().toUtf8()));
+	case TextField:
+		return msg->text();
+	case HtmlField:
+		return msg->html();
+	case TimeField:
+		return engine()->newDate(msg->time());
+	case ChatUnitField:
+		return engine()->toScriptValue(msg->chatUnit());
+	case IdField:
+		return double(msg->id());
+	default:
+		return engine()->toScriptValue(msg->property(name.toString().toUtf8()));
+	}
 }
 /*
 var conference = qutim.protocol("jabber").account("euroelessar@jabber.ru").unit("talks@conference.qutim.org", false);
@@ -153,12 +176,28 @@ conference.sendMessage(msg);
 void ScriptMessage::setProperty(QScriptValue &object, const QScriptString &name,
                                 uint id, const QScriptValue &value)
 {
-	Q_UNUSED(id);
 	Message *msg = message_get_value(object);
-	if (name == m_incoming)
+	switch (id) {
+	case IncomingField:
 		msg->setIncoming(value.toBool());
-	else
+		break;
+	case TextField:
+		msg->setText(value.toString());
+		break;
+	case HtmlField:
+		msg->setHtml(value.toString());
+		break;
+	case TimeField:
+		msg->setTime(value.toDateTime());
+		break;
+	case ChatUnitField:
+		msg->setChatUnit(qobject_cast<ChatUnit*>(value.toQObject()));
+		break;
+	case IdField:
+		break;
+	default:
 		msg->setProperty(name.toString().toUtf8(), value.toVariant());
+	}
 }
 
 QScriptValue::PropertyFlags ScriptMessage::propertyFlags(const QScriptValue &object,
@@ -166,8 +205,7 @@ QScriptValue::PropertyFlags ScriptMessage::propertyFlags(const QScriptValue &obj
 {
 	Q_UNUSED(object);
 	Q_UNUSED(name);
-	Q_UNUSED(id);
-	return 0;
+	return id == IdField ? QScriptValue::ReadOnly : QScriptValue::PropertyFlags(0);
 }
 
 QScriptClassPropertyIterator *ScriptMessage::newIterator(const QScriptValue &object)
@@ -52,7 +52,20 @@ public:
 	virtual QString name() const;
 	
 private:
-	QScriptString m_incoming;
+	// Well-known fields are resolved once in queryProperty and then are
+	// accessed directly by id, without going through QMetaProperty lookup
+	enum Field
+	{
+		DynamicField,
+		IncomingField,
+		TextField,
+		HtmlField,
+		TimeField,
+		ChatUnitField,
+		IdField,
+		FieldCount
+	};
+	QScriptString m_fields[FieldCount];
 	QScriptValue m_prototype;
 };
 }
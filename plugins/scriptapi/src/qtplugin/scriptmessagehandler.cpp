@@ -25,6 +25,7 @@
 
 #include "scriptmessagehandler.h"
 #include "scriptenginedata.h"
+#include "scripthandlerworker.h"
 #include <QScriptEngine>
 
 namespace qutim_sdk_0_3
@@ -36,24 +37,50 @@ public:
 
 	ScriptMessageHandlerObject() {}
 	
-	virtual Result doHandle(Message &message, QString *)
+	virtual Result doHandleSync(Message &message, QString *)
 	{
+		if (!m_source.isEmpty())
+			return Pending;
 		if (m_handler.isFunction()) {
 			QScriptValueList args;
-			args << m_that.engine()->toScriptValue(qVariantFromValue(&message));
+			args << m_that.engine()->toScriptValue(&message);
 			QScriptValue ret = m_handler.call(m_that, args);
 			if (ret.isNumber())
 				return static_cast<Result>(ret.toInt32());
 		}
 		return Accept;
 	}
+
+	virtual MessageHandlerAsyncResult doHandle(Message &message)
+	{
+		if (m_source.isEmpty())
+			return MessageHandler::doHandle(message);
+		// Message is owned by the chain, which is alive until result is handled
+		AsyncResultHandler<Result, QString> handler;
+		Message *target = &message;
+		const QVariantMap original = ScriptHandlerWorker::toVariant(message);
+		ScriptHandlerWorker::instance()->handle(m_source, original,
+		                                        [handler, target, original] (Result result, const QVariantMap &changed) {
+			ScriptHandlerWorker::apply(*target, original, changed);
+			handler.handle(result, QString());
+		});
+		return handler.result();
+	}
 	
 	void setThat(const QScriptValue &that) { m_that = that; }
 	QScriptValue handler() { return m_handler; }
 	void setHandler(const QScriptValue &handler) { m_handler = handler; }
+	void setThreaded(bool threaded)
+	{
+		m_source.clear();
+		if (threaded && m_handler.isFunction())
+			m_source = QLatin1Char('(') + m_handler.toString() + QLatin1Char(')');
+	}
 private:
 	QScriptValue m_that;
 	QScriptValue m_handler;
+	// Source of the handler if it is run by ScriptHandlerWorker
+	QString m_source;
 };
 
 ScriptMessageHandlerObject::Ptr get_value(const QScriptValue &obj)
@@ -77,8 +104,12 @@ QScriptValue messageHandlerRegister(QScriptContext *context, QScriptEngine *engi
 	int priority = MessageHandler::NormalPriortity;
 	if (context->argument(0).isNumber())
 		priority = context->argument(0).toInt32();
-	if (MessageHandler *handler = get_value(context->thisObject()).data())
-		MessageHandler::registerHandler(handler, QLatin1String("SomeScript"), priority, priority);
+	// handler.register(priority, true) moves it to the worker thread
+	ScriptMessageHandlerObject::Ptr handler = get_value(context->thisObject());
+	if (handler) {
+		handler->setThreaded(context->argument(1).toBool());
+		MessageHandler::registerHandler(handler.data(), QLatin1String("SomeScript"), priority, priority);
+	}
 	return engine->undefinedValue();
 }
 
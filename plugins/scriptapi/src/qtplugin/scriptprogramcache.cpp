@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "scriptprogramcache.h"
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTextStream>
+
+namespace qutim_sdk_0_3
+{
+enum { MaxSources = 256 };
+
+struct ScriptProgramCacheData
+{
+	struct FileEntry
+	{
+		QScriptProgram program;
+		qint64 size;
+		qint64 modified;
+	};
+
+	ScriptProgramCacheData() : sources(MaxSources) {}
+
+	QMutex mutex;
+	QHash<QString, FileEntry> files;
+	QCache<QString, QScriptProgram> sources;
+};
+
+Q_GLOBAL_STATIC(ScriptProgramCacheData, cacheData)
+
+QScriptProgram ScriptProgramCache::file(const QString &fileName)
+{
+	ScriptProgramCacheData *d = cacheData();
+	const QFileInfo info(fileName);
+	const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+
+	QMutexLocker locker(&d->mutex);
+	auto it = d->files.constFind(fileName);
+	if (it != d->files.constEnd() && it->size == info.size() && it->modified == modified)
+		return it->program;
+	locker.unlock();
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return QScriptProgram();
+	QTextStream stream(&file);
+	ScriptProgramCacheData::FileEntry entry;
+	entry.program = QScriptProgram(stream.readAll(), fileName);
+	entry.size = info.size();
+	entry.modified = modified;
+
+	locker.relock();
+	d->files.insert(fileName, entry);
+	return entry.program;
+}
+
+QScriptProgram ScriptProgramCache::source(const QString &sourceCode, const QString &fileName)
+{
+	ScriptProgramCacheData *d = cacheData();
+	const QString key = fileName + QLatin1Char('\0') + sourceCode;
+	QMutexLocker locker(&d->mutex);
+	if (QScriptProgram *program = d->sources.object(key))
+		return *program;
+	QScriptProgram *program = new QScriptProgram(sourceCode, fileName);
+	d->sources.insert(key, program);
+	return *program;
+}
+}
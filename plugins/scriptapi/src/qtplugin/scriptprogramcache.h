@@ -0,0 +1,50 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef SCRIPTPROGRAMCACHE_H
+#define SCRIPTPROGRAMCACHE_H
+
+#include <QScriptProgram>
+
+namespace qutim_sdk_0_3
+{
+/**
+ * Process wide cache of compiled scripts. QScriptProgram does not depend on
+ * engine, so every engine which loads the same file or evaluates the same
+ * snippet shares one parsed program. Thread-safe.
+ */
+class ScriptProgramCache
+{
+public:
+	// Returns null program if file can't be read, file is reread only
+	// when its size or modification time changes
+	static QScriptProgram file(const QString &fileName);
+	// Cache of small inline snippets, least recently used ones are dropped
+	static QScriptProgram source(const QString &sourceCode,
+	                             const QString &fileName = QString());
+};
+}
+
+#endif // SCRIPTPROGRAMCACHE_H
@@ -103,7 +103,7 @@ void messageFromScriptValue(const QScriptValue &obj, Message &mes)
 QScriptValue messagePtrToScriptValue(QScriptEngine *engine, Message * const &mes)
 {
 	QScriptValue data = engine->newVariant(qVariantFromValue(mes));
-	QScriptValue obj = engine->newObject(new ScriptMessageClass(engine), data);
+	QScriptValue obj = engine->newObject(static_cast<ScriptEngine*>(engine)->messageClass(), data);
 	return obj;
 }
 
@@ -334,7 +334,7 @@ QScriptValue settingsGetSetValue(QScriptContext *ctxt, QScriptEngine *e)
 }
 
 ScriptEngine::ScriptEngine(const QString &name, QObject *parent) :
-		QScriptEngine(parent), m_name(name)
+		QScriptEngine(parent), m_name(name), m_messageClass(new ScriptMessageClass(this))
 {
 	connect(this, SIGNAL(signalHandlerException(QScriptValue)),
 			this, SLOT(onException(QScriptValue)));
@@ -357,6 +357,11 @@ ScriptEngine::ScriptEngine(const QString &name, QObject *parent) :
 	globalObject().setProperty("client", client);
 }
 
+ScriptEngine::~ScriptEngine()
+{
+	delete m_messageClass;
+}
+
 void ScriptEngine::initApi()
 {
 	QScriptValue client = globalObject().property("client");
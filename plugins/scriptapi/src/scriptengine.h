@@ -28,17 +28,23 @@
 
 #include <QScriptEngine>
 
+class ScriptMessageClass;
+
 class ScriptEngine : public QScriptEngine
 {
 	Q_OBJECT
 public:
     explicit ScriptEngine(const QString &name, QObject *parent = 0);
+	~ScriptEngine();
 	void initApi();
 	inline QString name() const { return m_name; }
+	// Shared by all Message objects of this engine
+	inline ScriptMessageClass *messageClass() const { return m_messageClass; }
 private slots:
 	void onException(const QScriptValue &exception);
 private:
 	QString m_name;
+	ScriptMessageClass *m_messageClass;
 };
 
 #endif // SCRIPTENGINE_H
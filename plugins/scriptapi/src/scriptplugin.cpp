@@ -26,6 +26,7 @@
 #include "scriptplugin.h"
 #include "scriptengine.h"
 #include "scriptpluginwrapper.h"
+#include "qtplugin/scriptprogramcache.h"
 #include <QDebug>
 #include <QLatin1Literal>
 #include <qutim/thememanager.h>
@@ -61,7 +62,7 @@ ScriptMessageHandler::ScriptMessageHandler(ScriptPlugin *parent)
 	m_engine->importExtension(QLatin1String("qutim"));
 }
 
-MessageHandler::Result ScriptMessageHandler::doHandle(Message &message, QString *reason)
+MessageHandler::Result ScriptMessageHandler::doHandleSync(Message &message, QString *reason)
 {
 	Q_UNUSED(reason);
 	if (message.isIncoming())
@@ -80,7 +81,8 @@ MessageHandler::Result ScriptMessageHandler::doHandle(Message &message, QString
 				first = false;
 				openContext(message.chatUnit());
 			}
-			QString result = m_engine->evaluate(regexp.cap(1)).toString();
+			// Same snippets tend to be used again and again, so parse them once
+			QString result = m_engine->evaluate(ScriptProgramCache::source(regexp.cap(1))).toString();
 			debug() << regexp.cap(1) << result;
 			text.replace(pos, regexp.matchedLength(), result);
 	        pos += result.length();
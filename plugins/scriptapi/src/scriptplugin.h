@@ -41,7 +41,7 @@ class ScriptMessageHandler : public qutim_sdk_0_3::MessageHandler
 {
 public:
 	ScriptMessageHandler(ScriptPlugin *parent);
-	virtual Result doHandle(qutim_sdk_0_3::Message &message, QString *reason);
+	virtual Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason);
 	
 	void openContext(ChatUnit *unit);
 	void closeContext();
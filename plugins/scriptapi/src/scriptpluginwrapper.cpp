@@ -25,10 +25,9 @@
 
 #include "scriptpluginwrapper.h"
 #include "scriptengine.h"
+#include "qtplugin/scriptprogramcache.h"
 #include <qutim/thememanager.h>
 #include <qutim/debug.h>
-#include <QFile>
-#include <QTextStream>
 
 using namespace qutim_sdk_0_3;
 
@@ -73,12 +72,12 @@ ScriptPluginWrapper::~ScriptPluginWrapper()
 void ScriptPluginWrapper::init()
 {
 	m_engine = new ScriptEngine(m_name, this);
-	QFile scriptFile(ThemeManager::path(QLatin1String("scripts"), m_name) + QLatin1String("/plugin.js"));
-	debug() << Q_FUNC_INFO << scriptFile.fileName();
-	if (!scriptFile.open(QIODevice::ReadOnly))
+	const QString fileName = ThemeManager::path(QLatin1String("scripts"), m_name) + QLatin1String("/plugin.js");
+	debug() << Q_FUNC_INFO << fileName;
+	QScriptProgram program = ScriptProgramCache::file(fileName);
+	if (program.isNull())
 		return;
-	QTextStream stream(&scriptFile);
-	m_engine->evaluate(stream.readAll());
+	m_engine->evaluate(program);
 	debug() << m_engine->uncaughtException().toString() << m_engine->uncaughtExceptionLineNumber();
 	QScriptValue plugin = m_engine->globalObject().property("plugin");
 	setInfo(qscriptvalue_cast<LocalizedString>(plugin.property("name")),
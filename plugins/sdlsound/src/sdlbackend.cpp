@@ -33,7 +33,9 @@ enum SDLAudioDefinitions
     SSLAudioRate = 22050,
     SDLAudioFormat = MIX_DEFAULT_FORMAT,
     SDLAudioChannels = 2,
-    SDLAudioBuffers = 8192
+    SDLAudioBuffers = 8192,
+    // Burst of notifications shouldn't turn into a cacophony
+    SDLMaxVoices = 4
 };
 
 typedef QMap<int, SDLSoundData*> SDLChannelsMap;
@@ -86,6 +88,7 @@ SDLSoundBackend::SDLSoundBackend()
         qCritical() << "Unable to open audio for SDL";
         return;
     }
+    Mix_AllocateChannels(SDLMaxVoices);
     Mix_ChannelFinished(channelFinished);
 }
 
@@ -93,6 +96,8 @@ SDLSoundBackend::~SDLSoundBackend()
 {
     Mix_HaltChannel(-1);
     m_cache.clear();
+    qDeleteAll(m_preloaded);
+    m_preloaded.clear();
     SDL_Quit();
 }
 
@@ -101,15 +106,28 @@ void SDLSoundBackend::channelFinished(int channel)
     channelsMap()->remove(channel);
 }
 
-void SDLSoundBackend::playSound(const QString &filename)
+SDLSoundData *SDLSoundBackend::sample(const QString &filename)
 {
+    if (SDLSoundData *data = m_preloaded.value(filename))
+        return data;
     SDLSoundData *data = m_cache.object(filename);
     if (!data) {
         data = new SDLSoundData(filename);
         m_cache.insert(filename, data);
     }
+    return data;
+}
+
+void SDLSoundBackend::playSound(const QString &filename)
+{
+    SDLSoundData *data = sample(filename);
     if (!data->chunk)
         return;
+    // Same sound many times at once is just louder, not more informative
+    foreach (SDLSoundData *playing, *channelsMap()) {
+        if (playing == data)
+            return;
+    }
     int channel = Mix_PlayChannel(-1, data->chunk, 0);
     if (channel != -1)
         channelsMap()->insert(channel, data);
@@ -120,3 +138,23 @@ QStringList SDLSoundBackend::supportedFormats()
     return QStringList(QLatin1String("wav"));
 }
 
+void SDLSoundBackend::virtual_hook(int type, void *data)
+{
+    if (type != PreloadSoundsHook) {
+        SoundBackend::virtual_hook(type, data);
+        return;
+    }
+    const QStringList &files = *reinterpret_cast<const QStringList*>(data);
+    QHash<QString, SDLSoundData*> preloaded;
+    foreach (const QString &file, files) {
+        SDLSoundData *sample = m_preloaded.take(file);
+        if (!sample)
+            sample = m_cache.take(file);
+        if (!sample)
+            sample = new SDLSoundData(file);
+        preloaded.insert(file, sample);
+    }
+    qDeleteAll(m_preloaded);
+    m_preloaded = preloaded;
+}
+
@@ -45,8 +45,13 @@ public:
     QStringList supportedFormats();
 
     static void channelFinished(int channel);
+protected:
+    void virtual_hook(int type, void *data);
 private:
+    SDLSoundData *sample(const QString &filename);
     QCache<QString, SDLSoundData> m_cache;
+    // Samples of current theme, decoded once and kept while theme is used
+    QHash<QString, SDLSoundData*> m_preloaded;
 };
 
 #endif // SDLSOUNDBACKEND_H
@@ -24,225 +24,625 @@
 ****************************************************************************/
 
 #include "sqlengine.h"
-#include "historywindow.h"
-#include "historysettings.h"
-#include <qutim/iconmanagerinterface.h>
+#include <qutim/chatunit.h>
+#include <qutim/systeminfo.h>
+#include <qutim/menucontroller.h>
+#include <qutim/icon.h>
+#include <qutim/debug.h>
+#include <qutim/executor.h>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QThread>
+#include <QThreadStorage>
+#include <QDataStream>
+#include <QSet>
+#include <algorithm>
+#include <limits>
 
 namespace SqlHistoryNamespace {
 
-SqlEngine::SqlEngine()
-{
-	m_settings_widget = 0;
-	m_save_history = m_show_recent_messages = true;
-	m_max_num = 4;
-}
+enum {
+	// Messages stored by one transaction of writer job
+	BatchSize = 512,
+	// Imports commit periodically, so writer isn't blocked for long
+	ImportTransactionSize = 4096,
+	BusyTimeout = 10000
+};
 
-bool SqlEngine::init(PluginSystemInterface *)
+enum Statement
+{
+	InsertMessage,
+	FindMessage,
+	FindContact,
+	InsertContact,
+	ReadMessages,
+	SelectAccounts,
+	SelectContacts,
+	SelectMonths,
+	SelectDays,
+	SelectTexts,
+	MatchTexts,
+	StatementCount
+};
+
+static const char * const statements[StatementCount] = {
+	"insert into messages (contact, time, incoming, text, html, properties) values (?, ?, ?, ?, ?, ?)",
+	"select 1 from messages where contact = ? and time = ? and incoming = ? and text = ? limit 1",
+	"select id from contacts where protocol = ? and account = ? and contact = ?",
+	"insert into contacts (protocol, account, contact) values (?, ?, ?)",
+	"select time, incoming, text, html, properties from messages"
+	" where contact = ? and time >= ? and time < ? order by time desc limit ?",
+	"select distinct protocol, account from contacts",
+	"select contact from contacts where protocol = ? and account = ?",
+	"select distinct strftime('%Y%m', time / 1000, 'unixepoch', 'localtime') from messages where contact = ?",
+	"select distinct date(time / 1000, 'unixepoch', 'localtime') from messages"
+	" where contact = ? and time >= ? and time < ?",
+	"select time, text from messages where contact = ? and time >= ? and time < ?",
+	"select messages.time, messages.text from messages_fts join messages on messages.id = messages_fts.rowid"
+	" where messages_fts match ? and messages.contact = ? and messages.time >= ? and messages.time < ?"
+};
+
+static const char * const schema[] = {
+	"create table if not exists contacts (id integer primary key, protocol text not null,"
+	" account text not null, contact text not null, unique (protocol, account, contact))",
+	"create table if not exists messages (id integer primary key, contact integer not null,"
+	" time integer not null, incoming integer not null, text text, html text, properties blob)",
+	"create index if not exists messages_contact_time on messages (contact, time)"
+};
+
+class Connection
+{
+	Q_DISABLE_COPY(Connection)
+public:
+	Connection(const QString &fileName);
+	~Connection();
+
+	bool isOpen() const { return m_open; }
+	bool hasFts() const { return m_fts; }
+
+	// Statements are prepared once and reused by all following calls
+	QSqlQuery &query(Statement statement);
+	bool exec(QSqlQuery &query);
+	bool exec(const char *sql);
+
+	bool begin() { return exec("begin immediate"); }
+	bool commit() { return exec("commit"); }
+
+	qint64 contactId(const History::ContactInfo &contact, bool create);
+	bool insert(qint64 contact, const Message &message);
+
+private:
+	void initFts();
+
+	QString m_name;
+	QSqlDatabase m_db;
+	bool m_open;
+	bool m_fts;
+	QHash<QString, qint64> m_contacts;
+	QSqlQuery *m_queries[StatementCount];
+};
+
+Connection::Connection(const QString &fileName)
+	: m_name(QStringLiteral("sqlhistory-%1").arg(quintptr(QThread::currentThread()), 0, 16)),
+	  m_open(false), m_fts(false)
 {
-	m_name = "sql";
-	m_version = "0.1.0";
-	return true;
+	std::fill(m_queries, m_queries + StatementCount, static_cast<QSqlQuery*>(0));
+
+	m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_name);
+	m_db.setDatabaseName(fileName);
+	m_db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=%1").arg(int(BusyTimeout)));
+	if (!m_db.open()) {
+		qWarning() << "Can't open history database" << fileName << m_db.lastError().text();
+		return;
+	}
+
+	// Readers don't block the writer and commits don't wait for fsync
+	exec("pragma journal_mode = wal");
+	exec("pragma synchronous = normal");
+
+	m_open = begin();
+	for (const char *sql : schema)
+		m_open = m_open && exec(sql);
+	if (m_open)
+		initFts();
+	m_open = m_open && commit();
 }
 
-void SqlEngine::release()
+Connection::~Connection()
 {
-	m_history_hash.clear();
-	db.close();
+	for (QSqlQuery *query : m_queries)
+		delete query;
+	m_db.close();
+	m_db = QSqlDatabase();
+	QSqlDatabase::removeDatabase(m_name);
 }
 
-void SqlEngine::setProfileName(const QString &profile_name)
+void Connection::initFts()
 {
-	SystemsCity::instance().setProfileName(profile_name);
+	// Trigram tokenizer makes FTS index usable for substring search, which
+	// is what history window asks for. It needs SQLite 3.34, so without it
+	// search just scans messages of the contact.
+	bool triggerExists = false;
+	{
+		QSqlQuery query(m_db);
+		query.exec(QStringLiteral("select 1 from sqlite_master where type = 'trigger' and name = 'messages_fts_insert'"));
+		triggerExists = query.next();
+	}
 
-	QSettings settings(QSettings::defaultFormat(), QSettings::UserScope, "qutim/qutim."+SystemsCity::ProfileName(), "sqlhistory");
-	m_save_history = settings.value("save", true).toBool();
-	m_show_recent_messages = settings.value("showrecent", true).toBool();
-	m_max_num = settings.value("recentcount", 4).toUInt();
+	QSqlQuery query(m_db);
+	m_fts = query.exec(QStringLiteral("create virtual table if not exists messages_fts using fts5"
+	                                  " (text, content = 'messages', content_rowid = 'id', tokenize = 'trigram')"))
+	        && query.exec(QStringLiteral("select rowid from messages_fts limit 1"));
+	if (!m_fts) {
+		// Keep the database writable by SQLite without FTS5 support
+		exec("drop trigger if exists messages_fts_insert");
+		return;
+	}
+	if (triggerExists)
+		return;
 
-	QString createtable_query;
-	if (settings.value("sqlengine").toString()=="sqlite") {
-		QString dbpath = SystemsCity::PluginSystem()->getProfilePath();
-		if(dbpath.endsWith(QDir::separator())) dbpath.chop(1);
-		dbpath += QDir::separator();
-		dbpath += "history.db";
+	// Index is either new or messages were stored without it
+	m_fts = exec("create trigger messages_fts_insert after insert on messages begin"
+	             " insert into messages_fts (rowid, text) values (new.id, new.text); end")
+	        && exec("insert into messages_fts (messages_fts) values ('rebuild')");
+}
 
-		db = QSqlDatabase::addDatabase("QSQLITE");
-		db.setDatabaseName(dbpath);
-		createtable_query = "create table history (id integer primary key autoincrement,"
-			   "datetime int(16),"
-			   "protocol varchar(16),"
-			   "account varchar(64),"
-			   "type int(1),"
-			   "direction int(1),"
-			   "itemname varchar(64),"
-			   "text text )";
-	}
-	else if (settings.value("sqlengine").toString()=="mysql") {
-		settings.beginGroup("mysql");
-		db = QSqlDatabase::addDatabase("QMYSQL");
-		db.setHostName(settings.value("host", "localhost").toString());
-		db.setPort(settings.value("port", "3306").toInt());
-		db.setUserName(settings.value("login").toString());
-		db.setPassword(settings.value("password").toString());
-		db.setDatabaseName(settings.value("dbname").toString());
-		settings.endGroup();
-		createtable_query = "create table if not exists `history` (`id` int(9) PRIMARY KEY auto_increment,"
-			   "datetime int(16),"
-			   "protocol varchar(16),"
-			   "account varchar(64),"
-			   "type int(1),"
-			   "direction int(1),"
-			   "itemname varchar(64),"
-			   "text text );";
+QSqlQuery &Connection::query(Statement statement)
+{
+	QSqlQuery *&query = m_queries[statement];
+	if (!query) {
+		query = new QSqlQuery(m_db);
+		query->setForwardOnly(true);
+		if (!query->prepare(QLatin1String(statements[statement])))
+			qWarning() << "Can't prepare history query" << query->lastError().text();
 	}
+	return *query;
+}
 
-	if (!db.open()) qDebug()<<"SQL History"<<"Database open error";
+bool Connection::exec(QSqlQuery &query)
+{
+	if (query.exec())
+		return true;
+	qWarning() << "History query failed" << query.lastError().text();
+	return false;
+}
 
-	if (!createtable_query.isEmpty()) {
-		QSqlQuery query;
-		query.exec(createtable_query);
+bool Connection::exec(const char *sql)
+{
+	QSqlQuery query(m_db);
+	if (query.exec(QLatin1String(sql)))
+		return true;
+	qWarning() << "History query failed" << sql << query.lastError().text();
+	return false;
+}
+
+qint64 Connection::contactId(const History::ContactInfo &contact, bool create)
+{
+	if (!m_open)
+		return -1;
+
+	const QString key = contact.protocol + QChar(0) + contact.account + QChar(0) + contact.contact;
+	const auto it = m_contacts.constFind(key);
+	if (it != m_contacts.constEnd())
+		return it.value();
+
+	qint64 id = -1;
+	QSqlQuery &find = query(FindContact);
+	find.bindValue(0, contact.protocol);
+	find.bindValue(1, contact.account);
+	find.bindValue(2, contact.contact);
+	if (exec(find) && find.next())
+		id = find.value(0).toLongLong();
+	find.finish();
+
+	if (id < 0 && create) {
+		QSqlQuery &insert = query(InsertContact);
+		insert.bindValue(0, contact.protocol);
+		insert.bindValue(1, contact.account);
+		insert.bindValue(2, contact.contact);
+		if (exec(insert))
+			id = insert.lastInsertId().toLongLong();
+		insert.finish();
 	}
 
+	// Missed contacts may be created by other connection later
+	if (id >= 0)
+		m_contacts.insert(key, id);
+	return id;
 }
 
-void SqlEngine::loadSettings()
+static bool isStorable(const QVariant &value)
 {
+	const int type = value.userType();
+	return value.isValid()
+	        && type < QMetaType::User
+	        && type != QMetaType::QObjectStar
+	        && type != QMetaType::VoidStar;
 }
 
-void SqlEngine::setLayerInterface( LayerType type, LayerInterface *layer_interface)
+static qint64 messageTime(const Message &message)
 {
-	LayersCity::instance().setLayerInterface(type, layer_interface);
+	const QDateTime time = message.time();
+	return (time.isValid() ? time : QDateTime::currentDateTime()).toMSecsSinceEpoch();
 }
 
-void SqlEngine::saveLayerSettings()
+bool Connection::insert(qint64 contact, const Message &message)
 {
-	if ( m_settings_widget )
-		m_settings_widget->saveSettings();
-	loadSettings();
+	QVariantMap properties;
+	foreach (const QByteArray &name, message.dynamicPropertyNames()) {
+		QVariant value = message.property(name);
+		if (isStorable(value))
+			properties.insert(QString::fromUtf8(name), value);
+	}
+
+	QByteArray data;
+	if (!properties.isEmpty()) {
+		QDataStream out(&data, QIODevice::WriteOnly);
+		out.setVersion(QDataStream::Qt_5_0);
+		out << properties;
+	}
+
+	QSqlQuery &insert = query(InsertMessage);
+	insert.bindValue(0, contact);
+	insert.bindValue(1, messageTime(message));
+	insert.bindValue(2, int(message.isIncoming()));
+	insert.bindValue(3, message.text());
+	insert.bindValue(4, message.html());
+	insert.bindValue(5, data);
+	return exec(insert);
 }
 
-QList<SettingsStructure> SqlEngine::getLayerSettingsList()
+static Message toMessage(const QSqlQuery &query)
 {
-	m_settings.clear();
-	if ( !m_settings_widget )
-	{
-		m_settings_widget = new SqlHistorySettings(SystemsCity::ProfileName());
-		m_settings_item = new QTreeWidgetItem;
-		m_settings_item->setText(0,QObject::tr("History"));
-		m_settings_item->setIcon(0,Icon("history"));
-		SettingsStructure tmp_struct;
-		tmp_struct.settings_item = m_settings_item;
-		tmp_struct.settings_widget = m_settings_widget;
-		m_settings.append(tmp_struct);
+	Message message;
+	const QByteArray data = query.value(4).toByteArray();
+	if (!data.isEmpty()) {
+		QDataStream in(data);
+		in.setVersion(QDataStream::Qt_5_0);
+		QVariantMap properties;
+		in >> properties;
+		for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+			message.setProperty(it.key().toUtf8(), it.value());
 	}
-	return m_settings;
+	message.setTime(QDateTime::fromMSecsSinceEpoch(query.value(0).toLongLong()));
+	message.setIncoming(query.value(1).toBool());
+	message.setText(query.value(2).toString());
+	message.setHtml(query.value(3).toString());
+	return message;
 }
 
-void SqlEngine::removeLayerSettings()
+// Connections can't be shared between threads, so every worker of the
+// executor opens its own one on the first job
+static QThreadStorage<Connection*> connections;
+
+static Connection *connection(const SqlEngineScope &scope)
 {
-	if ( m_settings_widget )
-	{
-		delete m_settings_widget;
-		m_settings_widget = 0;
-		delete m_settings_item;
-		m_settings_item = 0;
-	}
+	if (!connections.hasLocalData())
+		connections.setLocalData(new Connection(scope.fileName));
+	return connections.localData();
 }
 
-void SqlEngine::openWindow(const TreeModelItem &item)
+static inline qint64 lowerBound(const QDateTime &time)
 {
-	QString identification = QString("%1.%2.%3").arg(item.m_protocol_name).arg(item.m_account_name).arg(item.m_item_name);
-	if(!m_history_windows.value(identification))
-	{
-		TreeModelItem tmp = item;
-		tmp.m_item_name = m_history_hash.value(identification, item.m_item_name);
-		m_history_windows.insert(identification, QPointer<HistoryWindow>(new HistoryWindow(tmp, this)));
-	}
+	return time.isValid() ? time.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
 }
 
-uint SqlEngine::findEnd(QFile &file)
+static inline qint64 upperBound(const QDateTime &time)
 {
-	return 0;
+	return time.isValid() ? time.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
 }
 
-bool SqlEngine::storeMessage(const HistoryItem &item)
+// Returns FTS query for patterns, which are plain escaped strings, as
+// HistoryWindow builds them, or empty string if index can't help
+static QString ftsQuery(const QRegularExpression &regex)
 {
-	if (!m_save_history) return false;
+	QString literal = History::literal(regex);
 
-	QSqlQuery query;
-	query.prepare("insert into history (datetime, protocol, account, type, direction, itemname, text) "
-				  "values (?, ?, ?, ?, ?, ?, ?);");
+	// Trigrams can't find shorter strings
+	if (literal.size() < 3)
+		return QString();
+	literal.replace(QLatin1Char('"'), QStringLiteral("\"\""));
+	return QLatin1Char('"') + literal + QLatin1Char('"');
+}
+
+static QSet<QDate> matchedDays(Connection *db, qint64 contact, qint64 from, qint64 to,
+                               const QRegularExpression &regex)
+{
+	QSet<QDate> result;
+	const QString fts = db->hasFts() ? ftsQuery(regex) : QString();
+	QSqlQuery &query = db->query(fts.isEmpty() ? SelectTexts : MatchTexts);
+	int index = 0;
+	if (!fts.isEmpty())
+		query.bindValue(index++, fts);
+	query.bindValue(index++, contact);
+	query.bindValue(index++, from);
+	query.bindValue(index++, to);
+	if (db->exec(query)) {
+		// Index only narrows candidates, regex decides
+		while (query.next()) {
+			const QDate date = QDateTime::fromMSecsSinceEpoch(query.value(0).toLongLong()).date();
+			if (!result.contains(date) && query.value(1).toString().contains(regex))
+				result.insert(date);
+		}
+	}
+	query.finish();
+	return result;
+}
 
-	query.addBindValue(item.m_time.toTime_t());
-	query.addBindValue(item.m_user.m_protocol_name);
-	query.addBindValue(item.m_user.m_account_name);
-	query.addBindValue(item.m_type);
-	query.addBindValue(item.m_in ? 1 : 0);
-	query.addBindValue(item.m_from);
-	query.addBindValue(item.m_message);
+SqlEngineStoreJob::SqlEngineStoreJob(SqlEngineScope::Ptr scope) : d(scope)
+{
+	d->hasRunnable = true;
+}
 
-	if (query.exec()) return true;
-	else {
-		qDebug()<<"SQL History"<<"insert error";
+void SqlEngineStoreJob::operator()()
+{
+	Connection *db = connection(*d);
+	forever {
+		QList<QPair<History::ContactInfo, Message>> batch;
+		d->mutex.lock();
+		while (!d->queue.isEmpty() && batch.size() < BatchSize)
+			batch << d->queue.takeFirst();
+		if (batch.isEmpty()) {
+			d->hasRunnable = false;
+			d->mutex.unlock();
+			break;
+		}
+		d->mutex.unlock();
+
+		bool ok = db->isOpen() && db->begin();
+		for (int i = 0; ok && i < batch.size(); ++i) {
+			const qint64 contact = db->contactId(batch.at(i).first, true);
+			ok = contact >= 0 && db->insert(contact, batch.at(i).second);
+		}
+		if (ok)
+			ok = db->commit();
+		else if (db->isOpen())
+			db->exec("rollback");
+		if (!ok)
+			qWarning() << "Can't store" << batch.size() << "messages to history";
 	}
+}
 
-	return false;
+SqlEngine::SqlEngine() : m_scope(new SqlEngineScope)
+{
+	QDir historyDir = SystemInfo::getDir(SystemInfo::HistoryDir);
+	if (!historyDir.exists())
+		historyDir.mkpath(QStringLiteral("."));
+	m_scope->fileName = historyDir.filePath(QStringLiteral("history.sqlite"));
+	m_scope->hasRunnable = false;
+
+	ActionGenerator *gen = new ActionGenerator(Icon("view-history"),
+	                                           QT_TRANSLATE_NOOP("Chat", "View History"),
+	                                           this,
+	                                           SLOT(onHistoryActionTriggered(QObject*)));
+	gen->setType(ActionTypeChatButton|ActionTypeContactList);
+	gen->setPriority(512);
+	MenuController::addAction<ChatUnit>(gen);
 }
 
-QList<HistoryItem> SqlEngine::getMessages(const TreeModelItem &item, const QDateTime &last_time)
+SqlEngine::~SqlEngine()
 {
-	QList<HistoryItem> items;
-	if (!m_show_recent_messages) return items;
+}
 
-	QString strquery ="select datetime, protocol, account, type, direction, itemname, text from history";
-			strquery += " where datetime < "+QString::number(last_time.toTime_t());
-			strquery += " and protocol='"+item.m_protocol_name+"'";
-			strquery += " and account='"+item.m_account_name+"'";
-			strquery += " and itemname='"+item.m_item_name+"'";
-			strquery += " order by datetime desc limit "+QString::number(m_max_num);
-	QSqlQuery query(strquery);
+void SqlEngine::store(const Message &message)
+{
+	if (!message.chatUnit())
+		return;
 
-	while (query.next()) {
-		HistoryItem hitem;
-		hitem.m_user = item;
-		hitem.m_time = QDateTime::fromTime_t(query.value(0).toUInt());
-		hitem.m_from = query.value(5).toString();
-		hitem.m_in = (query.value(4).toUInt()==0) ? false : true;
-		hitem.m_message =  query.value(6).toString();
-		items.prepend(hitem);
-	}
+	QMutexLocker locker(&m_scope->mutex);
+	m_scope->queue << qMakePair(info(message.chatUnit()), message);
+	if (!m_scope->hasRunnable)
+		executor()->run(SqlEngineStoreJob(m_scope), Executor::BackgroundPriority);
+}
 
-	return items;
+void SqlEngine::virtual_hook(int id, void *data)
+{
+	switch (id) {
+	case StoreBatchHook: {
+		StoreBatchArgument &argument = *reinterpret_cast<StoreBatchArgument*>(data);
+		doStoreBatch(argument.contact, argument.messages);
+		argument.handled = true;
+		break;
+	}
+	default:
+		History::virtual_hook(id, data);
+	}
 }
 
-QString SqlEngine::quote(const QString &str)
+void SqlEngine::doStoreBatch(const ContactInfo &contact, const MessageList &messages)
 {
-	QString result = str;
-	result.replace("'", "\\'");
-	return result;
+	if (messages.isEmpty())
+		return;
+
+	auto scope = m_scope;
+	executor()->run([scope, contact, messages] () {
+		Connection *db = connection(*scope);
+		bool ok = db->isOpen() && db->begin();
+		const qint64 id = ok ? db->contactId(contact, true) : -1;
+		ok = ok && id >= 0;
+
+		QSqlQuery &find = db->query(FindMessage);
+		int pending = 0;
+		for (int i = 0; ok && i < messages.size(); ++i) {
+			const Message &message = messages.at(i);
+			find.bindValue(0, id);
+			find.bindValue(1, messageTime(message));
+			find.bindValue(2, int(message.isIncoming()));
+			find.bindValue(3, message.text());
+			const bool duplicate = db->exec(find) && find.next();
+			find.finish();
+			if (duplicate)
+				continue;
+			ok = db->insert(id, message);
+			// Long imports are split, so other writers aren't blocked for long
+			if (ok && ++pending == ImportTransactionSize) {
+				ok = db->commit() && db->begin();
+				pending = 0;
+			}
+		}
+		if (ok)
+			ok = db->commit();
+		else if (db->isOpen())
+			db->exec("rollback");
+		if (!ok)
+			qWarning() << "Can't import" << messages.size() << "messages to history of" << contact.contact;
+	}, Executor::BulkPriority);
 }
 
-QString SqlEngine::unquote(const QString &str)
+AsyncResult<MessageList> SqlEngine::read(const ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num)
 {
-	QString result;
-	return result;
+	AsyncResultHandler<MessageList> handler;
+	auto scope = m_scope;
+
+	executor()->run([scope, contact, from, to, max_num, handler] () {
+		MessageList items;
+		Connection *db = connection(*scope);
+		const qint64 id = db->contactId(contact, false);
+		if (id >= 0) {
+			QSqlQuery &query = db->query(ReadMessages);
+			query.bindValue(0, id);
+			query.bindValue(1, lowerBound(from));
+			query.bindValue(2, upperBound(to));
+			query.bindValue(3, max_num);
+			if (db->exec(query)) {
+				while (query.next())
+					items << toMessage(query);
+			}
+			query.finish();
+			std::reverse(items.begin(), items.end());
+		}
+		handler.handle(items);
+	}, Executor::InteractivePriority);
+
+	return handler.result();
 }
 
-QString SqlEngine::getFileName(const HistoryItem &item) const
+AsyncResult<QVector<History::AccountInfo>> SqlEngine::accounts()
 {
-	QString file;
-	return file;
+	AsyncResultHandler<QVector<AccountInfo>> handler;
+	auto scope = m_scope;
+
+	executor()->run([scope, handler] () {
+		QVector<AccountInfo> result;
+		Connection *db = connection(*scope);
+		if (db->isOpen()) {
+			QSqlQuery &query = db->query(SelectAccounts);
+			if (db->exec(query)) {
+				while (query.next()) {
+					AccountInfo info;
+					info.protocol = query.value(0).toString();
+					info.account = query.value(1).toString();
+					result << info;
+				}
+			}
+			query.finish();
+		}
+		handler.handle(result);
+	}, Executor::BackgroundPriority);
+
+	return handler.result();
 }
 
-QDir SqlEngine::getAccountDir(const TreeModelItem &item) const
+AsyncResult<QVector<History::ContactInfo>> SqlEngine::contacts(const AccountInfo &account)
 {
-	return QDir();
+	AsyncResultHandler<QVector<ContactInfo>> handler;
+	auto scope = m_scope;
+
+	executor()->run([scope, handler, account] () {
+		QVector<ContactInfo> result;
+		Connection *db = connection(*scope);
+		if (db->isOpen()) {
+			QSqlQuery &query = db->query(SelectContacts);
+			query.bindValue(0, account.protocol);
+			query.bindValue(1, account.account);
+			if (db->exec(query)) {
+				while (query.next()) {
+					ContactInfo info;
+					info.protocol = account.protocol;
+					info.account = account.account;
+					info.contact = query.value(0).toString();
+					result << info;
+				}
+			}
+			query.finish();
+		}
+		handler.handle(result);
+	}, Executor::BackgroundPriority);
+
+	return handler.result();
 }
 
-void SqlEngine::setHistory(const TreeModelItem &item)
+AsyncResult<QList<QDate>> SqlEngine::months(const ContactInfo &contact, const QRegularExpression &regex)
 {
+	AsyncResultHandler<QList<QDate>> handler;
+	auto scope = m_scope;
+
+	executor()->run([scope, handler, contact, regex] () {
+		QSet<QDate> result;
+		Connection *db = connection(*scope);
+		const qint64 id = db->contactId(contact, false);
+		if (id >= 0 && regex.isValid() && !regex.pattern().isEmpty()) {
+			foreach (const QDate &date, matchedDays(db, id, lowerBound(QDateTime()), upperBound(QDateTime()), regex))
+				result.insert(QDate(date.year(), date.month(), 1));
+		} else if (id >= 0) {
+			QSqlQuery &query = db->query(SelectMonths);
+			query.bindValue(0, id);
+			if (db->exec(query)) {
+				while (query.next()) {
+					const QString month = query.value(0).toString();
+					result.insert(QDate(month.leftRef(4).toInt(), month.midRef(4, 2).toInt(), 1));
+				}
+			}
+			query.finish();
+		}
+
+		QList<QDate> sortedResult = result.toList();
+		std::sort(sortedResult.begin(), sortedResult.end());
+		handler.handle(sortedResult);
+	}, Executor::BackgroundPriority);
+
+	return handler.result();
+}
 
+AsyncResult<QList<QDate>> SqlEngine::dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex)
+{
+	AsyncResultHandler<QList<QDate>> handler;
+	auto scope = m_scope;
+
+	executor()->run([scope, handler, contact, month, regex] () {
+		QSet<QDate> result;
+		Connection *db = connection(*scope);
+		const qint64 id = db->contactId(contact, false);
+		const QDate first(month.year(), month.month(), 1);
+		const qint64 from = QDateTime(first).toMSecsSinceEpoch();
+		const qint64 to = QDateTime(first.addMonths(1)).toMSecsSinceEpoch();
+		if (id >= 0 && regex.isValid() && !regex.pattern().isEmpty()) {
+			result = matchedDays(db, id, from, to, regex);
+		} else if (id >= 0) {
+			QSqlQuery &query = db->query(SelectDays);
+			query.bindValue(0, id);
+			query.bindValue(1, from);
+			query.bindValue(2, to);
+			if (db->exec(query)) {
+				while (query.next())
+					result.insert(QDate::fromString(query.value(0).toString(), Qt::ISODate));
+			}
+			query.finish();
+		}
+
+		QList<QDate> sortedResult = result.toList();
+		std::sort(sortedResult.begin(), sortedResult.end());
+		handler.handle(sortedResult);
+	}, Executor::BackgroundPriority);
+
+	return handler.result();
 }
 
+void SqlEngine::onHistoryActionTriggered(QObject *object)
+{
+	ChatUnit *unit = qobject_cast<ChatUnit*>(object);
+	showHistory(unit);
 }
 
+}
@@ -24,58 +24,65 @@
 ****************************************************************************/
 
 #ifndef SQLENGINE_H
-#define SQLNENGINE_H
+#define SQLENGINE_H
 
-#include <qutim/plugininterface.h>
-#include <qutim/layerinterface.h>
-#include <qutim/layerscity.h>
-#include <QDir>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-
-using namespace qutim_sdk_0_2;
+#include <qutim/history.h>
+#include <QLinkedList>
+#include <QMutex>
 
 namespace SqlHistoryNamespace {
 
-class HistoryWindow;
-class SqlHistorySettings;
+using namespace qutim_sdk_0_3;
 
-class SqlEngine : public HistoryLayerInterface
+class SqlEngineScope
 {
+public:
+	typedef QSharedPointer<SqlEngineScope> Ptr;
+
+	QString fileName;
+	bool hasRunnable;
+	QLinkedList<QPair<History::ContactInfo, Message>> queue;
+	QMutex mutex;
+};
+
+class SqlEngineStoreJob
+{
+public:
+	SqlEngineStoreJob(SqlEngineScope::Ptr scope);
+	void operator()();
+
+private:
+	SqlEngineScope::Ptr d;
+};
+
+// History backend, which keeps all messages in single SQLite database
+// in WAL mode. Every worker thread of the executor has own connection
+// with prepared statements, writes are batched into transactions.
+class SqlEngine : public History
+{
+	Q_OBJECT
 public:
 	SqlEngine();
-	virtual bool init(PluginSystemInterface *plugin_system);
-	virtual void release();
-	virtual void setProfileName(const QString &profile_name);
-	void loadSettings();
-	virtual void setLayerInterface( LayerType type, LayerInterface *layer_interface);
-	virtual void saveLayerSettings();
-	virtual QList<SettingsStructure> getLayerSettingsList();
-	virtual void removeLayerSettings();
-	virtual void saveGuiSettingsPressed() {}
-	virtual void removeGuiLayerSettings() {}
-	virtual void openWindow(const TreeModelItem &item);
-	uint findEnd(QFile &file);
-	virtual bool storeMessage(const HistoryItem &item);
-	virtual QList<HistoryItem> getMessages(const TreeModelItem &item, const QDateTime &last_time);
-	QString getFileName(const HistoryItem &item) const;
-	QDir getAccountDir(const TreeModelItem &item) const;
-	static QString quote(const QString &str);
-	static QString unquote(const QString &str);
-	void setHistory(const TreeModelItem &item);
-  inline const QString &getHistoryPath() const { return NULL; }
+	virtual ~SqlEngine();
+
+	void store(const Message &message) override;
+	AsyncResult<MessageList> read(const ContactInfo &contact, const QDateTime &from, const QDateTime &to, int max_num) override;
+	AsyncResult<QVector<AccountInfo>> accounts() override;
+	AsyncResult<QVector<ContactInfo>> contacts(const AccountInfo &account) override;
+	AsyncResult<QList<QDate>> months(const ContactInfo &contact, const QRegularExpression &regex) override;
+	AsyncResult<QList<QDate>> dates(const ContactInfo &contact, const QDate &month, const QRegularExpression &regex) override;
+
+protected:
+	void virtual_hook(int id, void *data) override;
+
+private slots:
+	void onHistoryActionTriggered(QObject *object);
 private:
-	QHash<QString, QString> m_history_hash;
-	QHash<QString, QPointer<HistoryWindow> > m_history_windows;
-	SqlHistorySettings *m_settings_widget;
-	QTreeWidgetItem *m_settings_item;
-	bool m_save_history;
-	bool m_show_recent_messages;
-	quint16 m_max_num;
-	QSqlDatabase db;
+	void doStoreBatch(const ContactInfo &contact, const MessageList &messages);
+
+	SqlEngineScope::Ptr m_scope;
 };
 
 }
 
 #endif // SQLENGINE_H
-
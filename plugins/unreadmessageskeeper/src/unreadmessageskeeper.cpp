@@ -28,6 +28,10 @@
 #include <qutim/account.h>
 #include <qutim/protocol.h>
 #include <qutim/history.h>
+#include <QTimerEvent>
+#include <QPointer>
+
+enum { FlushInterval = 5000 };
 
 void UnreadMessagesKeeper::init()
 {
@@ -63,13 +67,18 @@ bool UnreadMessagesKeeper::load()
 					continue;
 				int count = cfg.value(id,0);
                 if (count) {
-					ChatSession *s = ChatLayer::get(u,true);
-                    MessageList list = History::instance()->readSync(u, count);
-					foreach(Message m,list) {
-						m.setProperty("store",false);
-						m.setProperty("fake",true); //mega spike
-						s->appendMessage(m);
-					}
+					// Unread messages are restored when they are read, startup doesn't wait for disk
+					QPointer<ChatUnit> unit = u;
+					History::instance()->read(u, count).connect(this, [unit] (const MessageList &list) {
+						if (!unit)
+							return;
+						ChatSession *s = ChatLayer::get(unit.data(), true);
+						foreach(Message m,list) {
+							m.setProperty("store",false);
+							m.setProperty("fake",true); //mega spike
+							s->appendMessage(m);
+						}
+					});
 				}
 			}
 			cfg.endGroup();
@@ -81,28 +90,56 @@ bool UnreadMessagesKeeper::load()
 
 bool UnreadMessagesKeeper::unload()
 {
+	flush();
 	return true;
 }
 
+void UnreadMessagesKeeper::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_flushTimer.timerId())
+		flush();
+	else
+		Plugin::timerEvent(event);
+}
+
 void UnreadMessagesKeeper::sessionCreated(qutim_sdk_0_3::ChatSession* session)
 {
-	connect(session,SIGNAL(unreadChanged(qutim_sdk_0_3::MessageList)),SLOT(onUnreadChanged(qutim_sdk_0_3::MessageList)));
+	connect(session,SIGNAL(unreadCountChanged(int)),SLOT(onUnreadCountChanged(int)));
 }
 
-void UnreadMessagesKeeper::onUnreadChanged(const qutim_sdk_0_3::MessageList &list)
+void UnreadMessagesKeeper::onUnreadCountChanged(int count)
 {
 	ChatSession *s = qobject_cast<ChatSession*>(sender());
 	ChatUnit *u = s->getUnit();
 	Account *a = u->account();
-	Config cfg("unreadmessages");
-
-	cfg.beginGroup(a->protocol()->id());
-	cfg.beginGroup(a->id());
+	m_pending[a->protocol()->id()][a->id()].insert(u->id(), count);
+	if (!m_flushTimer.isActive())
+		m_flushTimer.start(FlushInterval, this);
+}
 
-	cfg.setValue(u->id(),list.count());
+void UnreadMessagesKeeper::flush()
+{
+	m_flushTimer.stop();
+	if (m_pending.isEmpty())
+		return;
 
-	cfg.endGroup();
-	cfg.endGroup();
+	Config cfg("unreadmessages");
+	for (auto protocol = m_pending.constBegin(); protocol != m_pending.constEnd(); ++protocol) {
+		cfg.beginGroup(protocol.key());
+		for (auto account = protocol->constBegin(); account != protocol->constEnd(); ++account) {
+			cfg.beginGroup(account.key());
+			for (auto unit = account->constBegin(); unit != account->constEnd(); ++unit) {
+				if (unit.value())
+					cfg.setValue(unit.key(), unit.value());
+				else
+					cfg.remove(unit.key());
+			}
+			cfg.endGroup();
+		}
+		cfg.endGroup();
+	}
+	cfg.sync();
+	m_pending.clear();
 }
 
 QUTIM_EXPORT_PLUGIN(UnreadMessagesKeeper)
@@ -28,6 +28,8 @@
 #define urlpreviewPLUGIN_H
 #include <qutim/plugin.h>
 #include <qutim/chatsession.h>
+#include <QBasicTimer>
+#include <QHash>
 
 namespace qutim_sdk_0_3 {
 class ChatSession;
@@ -46,10 +48,18 @@ public:
 	virtual void init();
 	virtual bool load();
 	virtual bool unload();
+protected:
+	void timerEvent(QTimerEvent *event);
 private slots:
 	void sessionCreated(qutim_sdk_0_3::ChatSession*);
-	void onUnreadChanged(const qutim_sdk_0_3::MessageList &list);
+	void onUnreadCountChanged(int count);
 private:
+	void flush();
+	// Counts are written at most once per interval, protocol -> account -> unit
+	typedef QHash<QString, int> UnitCounts;
+	typedef QHash<QString, UnitCounts> AccountCounts;
+	QHash<QString, AccountCounts> m_pending;
+	QBasicTimer m_flushTimer;
 };
 
 #endif
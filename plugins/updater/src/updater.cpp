@@ -29,11 +29,14 @@
 #include <qutim/debug.h>
 #include <qutim/systeminfo.h>
 #include <qutim/json.h>
+#include <qutim/networkaccess.h>
 #include <QTimerEvent>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QtConcurrent/QtConcurrentFilter>
 #include <QCryptographicHash>
+#include <QDateTime>
+#include <QSet>
 #include <QTimer>
 
 #define BASE_URL "http://qutim.org/client_stuff/icons"
@@ -55,8 +58,7 @@ void UpdaterPlugin::init()
 
 bool UpdaterPlugin::load()
 {
-	m_manager.reset(new QNetworkAccessManager);
-	connect(m_manager.data(), SIGNAL(finished(QNetworkReply*)), SLOT(onReplyFinished(QNetworkReply*)));
+	m_replies.reset(new QObject);
 	m_watcher.reset(new QFutureWatcher<FileInfo>());
 	connect(m_watcher.data(), SIGNAL(finished()), this, SLOT(onCheckFinished()));
 	
@@ -69,7 +71,8 @@ bool UpdaterPlugin::load()
 
 bool UpdaterPlugin::unload()
 {
-	m_manager.reset(0);
+	// Deletes and so aborts replies in progress
+	m_replies.reset(0);
 	if (m_watcher->isRunning()) {
 		connect(m_watcher.data(), SIGNAL(canceled()), m_watcher.data(), SLOT(deleteLater()));
 		m_watcher->cancel();
@@ -78,6 +81,8 @@ bool UpdaterPlugin::unload()
 		m_watcher.reset(0);
 	}
 	m_queue.clear();
+	m_checkList.clear();
+	clearDownloads();
 	m_timer.stop();
 	return true;
 }
@@ -95,8 +100,17 @@ void UpdaterPlugin::updateIcons()
 {
 	if (m_watcher->isRunning())
 		return;
-	QNetworkRequest request(QUrl(QLatin1String(BASE_URL "/cache.json")));
-	m_manager->get(request);
+	get(QUrl(QLatin1String(BASE_URL "/cache.json")));
+}
+
+QNetworkReply *UpdaterPlugin::get(const QUrl &url)
+{
+	QNetworkReply *reply = NetworkAccess::manager()->get(NetworkAccess::request(url));
+	reply->setParent(m_replies.data());
+	connect(reply, &QNetworkReply::finished, m_replies.data(), [this, reply] () {
+		onReplyFinished(reply);
+	});
+	return reply;
 }
 
 void UpdaterPlugin::onReplyFinished(QNetworkReply *reply)
@@ -108,6 +122,7 @@ void UpdaterPlugin::onReplyFinished(QNetworkReply *reply)
 		dir.mkpath(QLatin1String(ICONS_PATH));
 		if (!dir.cd(QLatin1String(ICONS_PATH)))
 			return;
+		m_verified = Config(QLatin1String("updater")).value(QLatin1String("verified"), QVariantMap());
 		QVariantMap root = Json::parse(reply->readAll()).toMap();
 		QVariantList icons = root.value(QLatin1String("icons")).toList();
 		FileInfo::List fileInfos;
@@ -118,66 +133,177 @@ void UpdaterPlugin::onReplyFinished(QNetworkReply *reply)
 			info.md5 = icon.value(QLatin1String("md5")).toByteArray();
 			info.fileName = icon.value(QLatin1String("fileName")).toString();
 			info.filePath = dir.filePath(info.fileName);
+			const QVariantList stamp = m_verified.value(info.fileName).toList();
+			info.verifiedSize = stamp.value(0, -1).toLongLong();
+			info.verifiedModified = stamp.value(1, -1).toLongLong();
+			info.verifiedSha1 = stamp.value(2).toByteArray();
 			fileInfos << info;
 		}
+		m_checkList = fileInfos;
 		m_watcher->setFuture(QtConcurrent::filtered(fileInfos, &FileInfo::isInvalid));
+		return;
+	}
+
+	onReadyRead(reply);
+	Download *download = m_downloads.take(reply);
+	if (!download)
+		return;
+	const QString host = url.host();
+	if (--m_hostRequests[host] <= 0)
+		m_hostRequests.remove(host);
+	qDebug() << "Received" << download->info.filePath;
+	finishDownload(download, reply->error() == QNetworkReply::NoError);
+
+	if (!m_queue.isEmpty())
+		QTimer::singleShot(0, this, SLOT(requestNextUrl()));
+	else if (m_downloads.isEmpty())
+		onDownloadsFinished();
+}
+
+void UpdaterPlugin::onReadyRead(QNetworkReply *reply)
+{
+	Download *download = m_downloads.value(reply);
+	if (!download)
+		return;
+	const QByteArray data = reply->readAll();
+	download->md5.addData(data);
+	download->sha1.addData(data);
+	download->file.write(data);
+}
+
+void UpdaterPlugin::finishDownload(Download *download, bool ok)
+{
+	const FileInfo &info = download->info;
+	if (ok && (download->md5.result().toHex() != info.md5
+	           || download->sha1.result().toHex() != info.sha1)) {
+		qWarning() << "Checksum mismatch for" << info.fileName;
+		ok = false;
+	}
+	if (ok && download->file.commit()) {
+		m_verified.insert(info.fileName, info.stamp());
 	} else {
-		QString filePath = reply->property("filePath").toString();
-		qDebug() << "Received" << filePath;
-		if (reply->error() == QNetworkReply::NoError) {
-			QFileInfo fileInfo(filePath);
-			QDir().mkpath(fileInfo.absolutePath());
-			QFile file(filePath);
-			if (file.open(QFile::WriteOnly)) {
-				file.write(reply->readAll());
-				file.close();
-			}
-		}
-		if (m_queue.isEmpty()) {
-			// Now we should force IconEngine to update icon's cache
-			QDir dir = SystemInfo::getDir(SystemInfo::ShareDir);
-			dir.cd(QLatin1String("icons"));
-			QFile file(dir.filePath(QLatin1String("temporary-") + QString::number(qrand())));
-			file.open(QFile::WriteOnly);
-			file.write("123");
-			file.flush();
-			file.close();
-			file.remove();
-		} else {
-			QTimer::singleShot(0, this, SLOT(requestNextUrl()));
-		}
+		download->file.cancelWriting();
 	}
+	delete download;
+}
+
+void UpdaterPlugin::clearDownloads()
+{
+	foreach (Download *download, m_downloads)
+		download->file.cancelWriting();
+	qDeleteAll(m_downloads);
+	m_downloads.clear();
+	m_hostRequests.clear();
+}
+
+void UpdaterPlugin::onDownloadsFinished()
+{
+	Config(QLatin1String("updater")).setValue(QLatin1String("verified"), m_verified);
+
+	// Now we should force IconEngine to update icon's cache
+	QDir dir = SystemInfo::getDir(SystemInfo::ShareDir);
+	dir.cd(QLatin1String("icons"));
+	QFile file(dir.filePath(QLatin1String("temporary-") + QString::number(qrand())));
+	file.open(QFile::WriteOnly);
+	file.write("123");
+	file.flush();
+	file.close();
+	file.remove();
 }
 
 void UpdaterPlugin::onCheckFinished()
 {
+	QSet<QString> invalid;
 	foreach (const FileInfo &info, m_watcher->future()) {
-		QUrl url(QLatin1String(BASE_URL "/") + info.fileName);
-		m_queue.enqueue(qMakePair(url, info.filePath));
+		invalid.insert(info.fileName);
+		m_queue.enqueue(info);
+	}
+	// Remember files which were valid, so they are not rehashed next time
+	foreach (const FileInfo &info, m_checkList) {
+		if (invalid.contains(info.fileName))
+			continue;
+		m_verified.insert(info.fileName, info.stamp());
 	}
+	m_checkList.clear();
 	if (!m_queue.isEmpty())
 		requestNextUrl();
+	else
+		Config(QLatin1String("updater")).setValue(QLatin1String("verified"), m_verified);
 }
 
 void UpdaterPlugin::requestNextUrl()
 {
-	if (m_queue.isEmpty())
-		return;
-	qDebug() << "Request" << m_queue.head().first;
-	QNetworkRequest request(m_queue.head().first);
-	m_manager->get(request)->setProperty("filePath", m_queue.head().second);
-	m_queue.dequeue();
+	// Files of the same host share few connections, others go in parallel
+	for (int i = 0; i < m_queue.size();) {
+		const FileInfo &info = m_queue.at(i);
+		const QUrl url(QLatin1String(BASE_URL "/") + info.fileName);
+		int &requests = m_hostRequests[url.host()];
+		if (requests >= MaxRequestsPerHost) {
+			++i;
+			continue;
+		}
+
+		Download *download = new Download(info);
+		m_queue.removeAt(i);
+		QDir().mkpath(QFileInfo(download->info.filePath).absolutePath());
+		if (!download->file.open(QIODevice::WriteOnly)) {
+			qWarning() << "Can't write" << download->info.filePath;
+			delete download;
+			continue;
+		}
+
+		qDebug() << "Request" << url;
+		++requests;
+		QNetworkReply *reply = get(url);
+		m_downloads.insert(reply, download);
+		connect(reply, &QNetworkReply::readyRead, m_replies.data(), [this, reply] () {
+			onReadyRead(reply);
+		});
+	}
+	if (m_queue.isEmpty() && m_downloads.isEmpty())
+		onDownloadsFinished();
+}
+
+UpdaterPlugin::Download::Download(const FileInfo &info)
+	: info(info), file(info.filePath),
+	  md5(QCryptographicHash::Md5), sha1(QCryptographicHash::Sha1)
+{
+}
+
+QVariantList UpdaterPlugin::FileInfo::stamp() const
+{
+	const QFileInfo fileInfo(filePath);
+	return QVariantList()
+	        << fileInfo.size()
+	        << fileInfo.lastModified().toMSecsSinceEpoch()
+	        << sha1;
 }
 
 bool UpdaterPlugin::FileInfo::isInvalid() const
 {
 	QFile file(filePath);
+	const QFileInfo fileInfo(file);
+	if (!fileInfo.exists())
+		return true;
+	if (verifiedSha1 == sha1
+	        && verifiedSize == fileInfo.size()
+	        && verifiedModified == fileInfo.lastModified().toMSecsSinceEpoch()) {
+		return false;
+	}
 	if (!file.open(QFile::ReadOnly))
 		return true;
-	QByteArray fileData = file.readAll();
-	if (md5 != QCryptographicHash::hash(fileData, QCryptographicHash::Md5).toHex())
+	// Both hashes are computed in a single pass over the file
+	QCryptographicHash md5Hash(QCryptographicHash::Md5);
+	QCryptographicHash sha1Hash(QCryptographicHash::Sha1);
+	char buffer[64 * 1024];
+	qint64 read;
+	while ((read = file.read(buffer, sizeof(buffer))) > 0) {
+		md5Hash.addData(buffer, read);
+		sha1Hash.addData(buffer, read);
+	}
+	if (md5 != md5Hash.result().toHex())
 		return true;
-	if (sha1 != QCryptographicHash::hash(fileData, QCryptographicHash::Sha1).toHex())
+	if (sha1 != sha1Hash.result().toHex())
 		return true;
 	return false;
 }
@@ -32,6 +32,9 @@
 #include <QBasicTimer>
 #include <QQueue>
 #include <QUrl>
+#include <QHash>
+#include <QSaveFile>
+#include <QCryptographicHash>
 
 namespace qutim_sdk_0_3
 {
@@ -61,23 +64,52 @@ private slots:
 	void requestNextUrl();
 
 private:
+	enum { MaxRequestsPerHost = 4 };
+
 	struct FileInfo
 	{
 		typedef QList<FileInfo> List;
 		bool isInvalid() const;
+		QVariantList stamp() const;
 		
 		QByteArray sha1;
 		QByteArray md5;
 		QString filePath;
 		QString fileName;
+		// Stamp of the last verified copy, file is not reread if it matches
+		qint64 verifiedSize;
+		qint64 verifiedModified;
+		QByteArray verifiedSha1;
+	};
+
+	// File is written and hashed while data arrives
+	struct Download
+	{
+		Download(const FileInfo &info);
+
+		FileInfo info;
+		QSaveFile file;
+		QCryptographicHash md5;
+		QCryptographicHash sha1;
 	};
 	
 	FileInfo::List checkList(const FileInfo::List &original);
+	QNetworkReply *get(const QUrl &url);
+	void onReadyRead(QNetworkReply *reply);
+	void finishDownload(Download *download, bool ok);
+	void clearDownloads();
+	void onDownloadsFinished();
 
 	QBasicTimer m_timer;
 	QScopedPointer<QFutureWatcher<FileInfo> > m_watcher;
-	QScopedPointer<QNetworkAccessManager> m_manager;
-	QQueue<QPair<QUrl, QString> > m_queue;
+	// Parent of replies in progress
+	QScopedPointer<QObject> m_replies;
+	FileInfo::List m_checkList;
+	QQueue<FileInfo> m_queue;
+	QHash<QNetworkReply*, Download*> m_downloads;
+	QHash<QString, int> m_hostRequests;
+	// File name to (size, modification time, sha1) of verified files
+	QVariantMap m_verified;
 };
 }
 
@@ -32,8 +32,8 @@
 #include <qutim/chatsession.h>
 #include <qutim/utils.h>
 #include <qutim/json.h>
+#include <qutim/networkaccess.h>
 
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QTextDocument>
@@ -45,21 +45,31 @@ namespace UrlPreview {
 
 using namespace qutim_sdk_0_3;
 
+enum {
+	MaxRequestsPerHost = 2,
+	SaveCacheInterval = 30000
+};
+
 UrlHandler::UrlHandler() :
-	m_netman(new QNetworkAccessManager(this))
+	m_uid(0)
 {
-	connect(m_netman, SIGNAL(authenticationRequired(QNetworkReply*,QAuthenticator*)),
-			SLOT(authenticationRequired(QNetworkReply*,QAuthenticator*))
-			);
-	connect(m_netman, SIGNAL(finished(QNetworkReply*)),
-			SLOT(netmanFinished(QNetworkReply*))
-			);
-	connect(m_netman, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)),
-			SLOT(netmanSslErrors(QNetworkReply*,QList<QSslError>))
-			);
+	m_saveTimer.setSingleShot(true);
+	m_saveTimer.setInterval(SaveCacheInterval);
+	connect(&m_saveTimer, SIGNAL(timeout()), SLOT(saveCache()));
+	m_cache.load();
 	loadSettings();
 }
 
+UrlHandler::~UrlHandler()
+{
+	m_cache.save();
+}
+
+void UrlHandler::saveCache()
+{
+	m_cache.save();
+}
+
 void UrlHandler::loadSettings()
 {
 	Config cfg;
@@ -92,14 +102,16 @@ void UrlHandler::loadSettings()
 	m_enableHTML5Video = cfg.value("HTML5Video", true);
 	m_enableYandexRichContent = cfg.value("yandexRichContent", true);
 	m_exceptionList = cfg.value("exceptionList", QStringList());
+	m_cache.setTimeToLive(qint64(cfg.value("cacheTimeToLive", 24 * 60 * 60)) * 1000);
 	cfg.endGroup();
 }
 
-MessageHandlerAsyncResult UrlHandler::doHandle(Message &message)
+MessageHandler::Result UrlHandler::doHandleSync(Message &message, QString *reason)
 {
+	Q_UNUSED(reason);
 	ChatSession *session = ChatLayer::get(message.chatUnit(), false);
     if (!session || !session->property("supportJavaScript").toBool()) {
-		return makeAsyncResult(Accept, QString());
+		return Accept;
     }
 
 	const QString originalHtml = message.html();
@@ -109,17 +121,16 @@ MessageHandlerAsyncResult UrlHandler::doHandle(Message &message)
 		if (token.url.isEmpty()) {
 			html += token.text.toString();
 		} else {
-			static int uid = 1;
 			QString link = token.url;
-			checkLink(token.text, link, message.chatUnit(), uid++);
+			checkLink(token.text, link, message.chatUnit());
 			html += link;
 		}
 	}
 	message.setHtml(html);
-	return makeAsyncResult(Accept, QString());
+	return Accept;
 }
 
-void UrlHandler::checkLink(const QStringRef &originalLink, QString &link, ChatUnit *from, qint64 id)
+void UrlHandler::checkLink(const QStringRef &originalLink, QString &link, ChatUnit *from)
 {
 	const char *entitiesIn[] = { "&quot;", "&gt;", "&lt;", "&amp;" };
 	const char *entitiesOut[] = { "\"", ">", "<", "&" };
@@ -162,37 +173,120 @@ void UrlHandler::checkLink(const QStringRef &originalLink, QString &link, ChatUn
 		}
 	}
 
-	const QString uid = QString::number(id);
+	const QString key = PreviewCache::normalize(url);
+	const QString uid = QString::number(++m_uid);
 
-	QNetworkRequest request;
-	request.setUrl(QUrl(link));
-	request.setRawHeader("Ranges", "bytes=0-0");
-	QNetworkReply *reply = m_netman->head(request);
-	reply->setProperty("uid", uid);
-	reply->setProperty("unit", qVariantFromValue<ChatUnit *>(from));
+	QString html;
+	if (m_cache.find(key, &html)) {
+		link = QString::fromLatin1("%1 <span class='urlpreview' id='urlpreview%2'>%3</span> ")
+			   .arg(originalLink.toString(), uid, html);
+		return;
+	}
 
 	link = QString::fromLatin1("%1 <span class='urlpreview' id='urlpreview%2'></span> ")
            .arg(originalLink.toString(), uid);
+
+	const Waiter waiter = { from, uid };
+	QHash<QString, QList<Waiter>>::iterator it = m_waiters.find(key);
+	if (it != m_waiters.end()) {
+		it->append(waiter);
+		return;
+	}
+	m_waiters[key] << waiter;
+
+	Request request;
+	request.request = NetworkAccess::request(QUrl(link));
+	request.request.setRawHeader("Ranges", "bytes=0-0");
+	request.key = key;
+	request.richContent = false;
+	sendRequest(request);
+}
+
+void UrlHandler::sendRequest(const Request &request)
+{
+	const QString host = request.request.url().host();
+	int &running = m_running[host];
+	if (running >= MaxRequestsPerHost) {
+		m_queued[host].enqueue(request);
+		return;
+	}
+	++running;
+
+	QNetworkReply *reply;
+	if (request.richContent) {
+		reply = NetworkAccess::manager()->get(request.request);
+		reply->setProperty("yandexRCA", true);
+		reply->setProperty("fallback", request.fallback);
+	} else {
+		reply = NetworkAccess::manager()->head(request.request);
+	}
+	connect(reply, &QNetworkReply::finished, this, [this, reply] () { netmanFinished(reply); });
+	reply->setProperty("key", request.key);
+	reply->setProperty("host", host);
+}
+
+void UrlHandler::releaseHost(QNetworkReply *reply)
+{
+	const QString host = reply->property("host").toString();
+	QHash<QString, int>::iterator running = m_running.find(host);
+	if (running == m_running.end())
+		return;
+	--*running;
+
+	QHash<QString, QQueue<Request>>::iterator queued = m_queued.find(host);
+	if (queued == m_queued.end()) {
+		if (*running <= 0)
+			m_running.erase(running);
+		return;
+	}
+	const Request request = queued->dequeue();
+	if (queued->isEmpty())
+		m_queued.erase(queued);
+	sendRequest(request);
+}
+
+void UrlHandler::showPreview(const QString &key, const QString &html)
+{
+	if (html.isEmpty())
+		return;
+	foreach (const Waiter &waiter, m_waiters.value(key)) {
+		if (waiter.unit)
+			updateData(waiter.unit.data(), waiter.uid, html);
+	}
+}
+
+void UrlHandler::finishPreview(const QString &key, const QString &html, bool cacheable)
+{
+	showPreview(key, html);
+	m_waiters.remove(key);
+	// Network failures may be temporary, so they are asked again next time
+	if (cacheable) {
+		m_cache.insert(key, html);
+		if (!m_saveTimer.isActive())
+			m_saveTimer.start();
+	}
 }
 
 void UrlHandler::netmanFinished(QNetworkReply *reply)
 {
 	reply->deleteLater();
+	releaseHost(reply);
+
+	const QString key = reply->property("key").toString();
+	const bool cacheable = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid();
 
 	if (reply->property("yandexRCA").toBool()) {
 		QVariantMap data = Json::parse(reply->readAll()).toMap();
 
+		QString html = reply->property("fallback").toString();
 		if (data.contains("title") || data.contains("content")) {
-			QString html = m_yandexRichContentTemplate;
+			html = m_yandexRichContentTemplate;
 			html.replace("%URL%", data.value("finalurl").toString());
 			html.replace("%IMAGE%", data.value("img").toList().value(0).toString());
 			html.replace("%TITLE%", data.value("title").toString().replace("\n", "<br/>"));
 			html.replace("%CONTENT%", data.value("content").toString().replace("\n", "<br/>"));
-
-			updateData(reply->property("unit").value<ChatUnit *>(),
-					   reply->property("uid").toString(),
-					   html);
 		}
+		finishPreview(key, html, cacheable);
 		return;
 	}
 
@@ -227,10 +321,10 @@ void UrlHandler::netmanFinished(QNetworkReply *reply)
 			size = hrx.cap(1).toInt();
 	}
 
-	if (type.isNull())
+	if (type.isNull()) {
+		finishPreview(key, QString(), cacheable);
 		return;
-
-	QString uid = reply->property("uid").toString();
+	}
 
 	QString pstr;
 	bool showPreviewHead = true;
@@ -270,6 +364,8 @@ void UrlHandler::netmanFinished(QNetworkReply *reply)
 		pstr.replace("%SIZE%", QString::number(size));
 	}
 
+	Request richContent;
+	richContent.richContent = false;
 	if (m_enableYandexRichContent &&
 			(type == QLatin1String("text/html")
 			 || type == QLatin1String("text/xhtml")
@@ -282,11 +378,9 @@ void UrlHandler::netmanFinished(QNetworkReply *reply)
         rcaUrl.setQuery(yaquery);
         //rcaUrl.addEncodedQueryItem("key", "svV1bfH1");
         //rcaUrl.addEncodedQueryItem("url", url.toUtf8().toPercentEncoding("", "+"));
-		QNetworkRequest request(rcaUrl);
-		QNetworkReply *rcaReply = m_netman->get(request);
-		rcaReply->setProperty("yandexRCA", true);
-		rcaReply->setProperty("uid", reply->property("uid"));
-		rcaReply->setProperty("unit", reply->property("unit"));
+		richContent.request = NetworkAccess::request(rcaUrl);
+		richContent.key = key;
+		richContent.richContent = true;
 	}
 
 	if (showPreviewHead) {
@@ -300,15 +394,19 @@ void UrlHandler::netmanFinished(QNetworkReply *reply)
 	if (type.contains(typerx) && 0 < size && size < m_maxFileSize && m_enableImagesPreview) {
 		QString amsg = m_imageTemplate;
 		amsg.replace("%URL%", url);
-		amsg.replace("%UID%", uid);
 		amsg.replace("%MAXW%", QString::number(m_maxImageSize.width()));
 		amsg.replace("%MAXH%", QString::number(m_maxImageSize.height()));
 		pstr += amsg;
 	}	
 
-	updateData(reply->property("unit").value<ChatUnit *>(),
-			   uid,
-			   pstr);
+	if (richContent.richContent) {
+		// Keep waiters until rich content is known, show the rest meanwhile
+		richContent.fallback = pstr;
+		showPreview(key, pstr);
+		sendRequest(richContent);
+		return;
+	}
+	finishPreview(key, pstr, cacheable);
 }
 
 void UrlHandler::updateData(ChatUnit *unit, const QString &uid, const QString &html)
@@ -324,14 +422,4 @@ void UrlHandler::updateData(ChatUnit *unit, const QString &uid, const QString &h
 	QMetaObject::invokeMethod(session, "evaluateJavaScript", Q_ARG(QString, js));
 }
 
-void UrlHandler::authenticationRequired(QNetworkReply *, QAuthenticator *)
-{
-
-}
-
-void UrlHandler::netmanSslErrors(QNetworkReply *, const QList<QSslError> &)
-{
-
-}
-
 } // namespace UrlPreview
@@ -27,15 +27,17 @@
 
 #ifndef URLPREVIEW_MESSAGEHANDLER_H
 #define URLPREVIEW_MESSAGEHANDLER_H
+#include "previewcache.h"
 #include <qutim/messagehandler.h>
-#include <QSslError>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QQueue>
 #include <QSize>
 #include <QStringList>
+#include <QTimer>
 
 
-class QNetworkAccessManager;
 class QNetworkReply;
-class QAuthenticator;
 namespace UrlPreview {
 
 enum PreviewFlag
@@ -52,23 +54,40 @@ class UrlHandler : public QObject, public qutim_sdk_0_3::MessageHandler
     Q_OBJECT
 public:
 	explicit UrlHandler();
+	~UrlHandler();
 
 protected:
-	qutim_sdk_0_3::MessageHandlerAsyncResult doHandle(qutim_sdk_0_3::Message &message) override;
+	Result doHandleSync(qutim_sdk_0_3::Message &message, QString *reason) override;
 
 public slots:
 	void loadSettings();
 
 private slots:
 	void netmanFinished(QNetworkReply *);
-	void authenticationRequired(QNetworkReply *, QAuthenticator *);
-	void netmanSslErrors(QNetworkReply *, const QList<QSslError> &);
+	void saveCache();
 
 private:
-	void checkLink(const QStringRef &originalLink, QString &url, qutim_sdk_0_3::ChatUnit *from, qint64 id);
+	struct Waiter
+	{
+		QPointer<qutim_sdk_0_3::ChatUnit> unit;
+		QString uid;
+	};
+	struct Request
+	{
+		QNetworkRequest request;
+		QString key;
+		// Preview shown if rich content request gives nothing
+		QString fallback;
+		bool richContent;
+	};
+
+	void checkLink(const QStringRef &originalLink, QString &url, qutim_sdk_0_3::ChatUnit *from);
+	void sendRequest(const Request &request);
+	void releaseHost(QNetworkReply *reply);
+	void showPreview(const QString &key, const QString &html);
+	void finishPreview(const QString &key, const QString &html, bool cacheable);
 	void updateData(qutim_sdk_0_3::ChatUnit *unit, const QString &uid, const QString &html);
 
-	QNetworkAccessManager *m_netman;
 	PreviewFlags m_flags;
 	QString m_template;
 	QString m_imageTemplate;
@@ -84,6 +103,13 @@ private:
 	bool m_enableHTML5Video;
 	bool m_enableYandexRichContent;
 	QStringList m_exceptionList;
+	quint64 m_uid;
+	PreviewCache m_cache;
+	QTimer m_saveTimer;
+	// Links being previewed by normalized url, all of them share one request
+	QHash<QString, QList<Waiter>> m_waiters;
+	QHash<QString, int> m_running;
+	QHash<QString, QQueue<Request>> m_queued;
 };
 
 } // namespace UrlPreview
@@ -0,0 +1,157 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "previewcache.h"
+#include <qutim/systeminfo.h>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace UrlPreview {
+
+using namespace qutim_sdk_0_3;
+
+enum {
+	CacheMagic = 0x55505243,
+	CacheVersion = 1,
+	// Bound of memory taken by cached previews, also bounds the file
+	MaxCacheCost = 2 * 1024 * 1024,
+	EntryOverhead = 64
+};
+
+static const qint64 DefaultTimeToLive = 24 * 60 * 60 * 1000;
+
+static QString cacheFileName()
+{
+	return SystemInfo::getDir(SystemInfo::ConfigDir).filePath(QStringLiteral("cache/urlpreview.dat"));
+}
+
+PreviewCache::PreviewCache()
+	: m_entries(MaxCacheCost), m_timeToLive(DefaultTimeToLive), m_dirty(false)
+{
+}
+
+bool PreviewCache::find(const QString &key, QString *html)
+{
+	Entry *entry = m_entries.object(key);
+	if (!entry)
+		return false;
+	if (entry->expires < QDateTime::currentMSecsSinceEpoch()) {
+		m_entries.remove(key);
+		m_dirty = true;
+		return false;
+	}
+	*html = entry->html;
+	return true;
+}
+
+void PreviewCache::insert(const QString &key, const QString &html)
+{
+	Entry *entry = new Entry;
+	entry->html = html;
+	entry->expires = QDateTime::currentMSecsSinceEpoch() + m_timeToLive;
+	m_entries.insert(key, entry, cost(key, *entry));
+	m_dirty = true;
+}
+
+void PreviewCache::setTimeToLive(qint64 msecs)
+{
+	m_timeToLive = msecs > 0 ? msecs : DefaultTimeToLive;
+}
+
+void PreviewCache::load()
+{
+	QFile file(cacheFileName());
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, version, count;
+	in >> magic >> version >> count;
+	if (magic != CacheMagic || version != CacheVersion)
+		return;
+
+	const qint64 now = QDateTime::currentMSecsSinceEpoch();
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		QString key;
+		Entry entry;
+		in >> key >> entry.html >> entry.expires;
+		if (in.status() != QDataStream::Ok || entry.expires < now)
+			continue;
+		m_entries.insert(key, new Entry(entry), cost(key, entry));
+	}
+	m_dirty = false;
+}
+
+void PreviewCache::save()
+{
+	if (!m_dirty)
+		return;
+	const QString fileName = cacheFileName();
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	const qint64 now = QDateTime::currentMSecsSinceEpoch();
+	QList<QString> keys;
+	foreach (const QString &key, m_entries.keys()) {
+		if (m_entries.object(key)->expires >= now)
+			keys << key;
+	}
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint32(CacheMagic) << quint32(CacheVersion) << quint32(keys.size());
+	foreach (const QString &key, keys) {
+		const Entry *entry = m_entries.object(key);
+		out << key << entry->html << entry->expires;
+	}
+	if (file.commit())
+		m_dirty = false;
+}
+
+QString PreviewCache::normalize(const QUrl &url)
+{
+	// Scheme and host are already lower cased by QUrl
+	QUrl result = url.adjusted(QUrl::RemoveFragment | QUrl::NormalizePathSegments);
+	if ((result.scheme() == QLatin1String("http") && result.port() == 80)
+			|| (result.scheme() == QLatin1String("https") && result.port() == 443)) {
+		result.setPort(-1);
+	}
+	if (!result.host().isEmpty() && result.path().isEmpty())
+		result.setPath(QStringLiteral("/"));
+	return result.toString(QUrl::FullyEncoded);
+}
+
+int PreviewCache::cost(const QString &key, const Entry &entry)
+{
+	return (key.size() + entry.html.size()) * int(sizeof(QChar)) + EntryOverhead;
+}
+
+} // namespace UrlPreview
@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef URLPREVIEW_PREVIEWCACHE_H
+#define URLPREVIEW_PREVIEWCACHE_H
+
+#include <QCache>
+#include <QString>
+#include <QUrl>
+
+namespace UrlPreview {
+
+/*
+ * Previews already built for links, so the same link pasted again or
+ * shown once more by history reload is previewed without any request.
+ * Entries are evicted by the total size and by age, and are kept between
+ * sessions in the config directory.
+ */
+class PreviewCache
+{
+public:
+	PreviewCache();
+
+	// Html is empty for links which have nothing to be previewed
+	bool find(const QString &key, QString *html);
+	void insert(const QString &key, const QString &html);
+	void setTimeToLive(qint64 msecs);
+	bool isDirty() const { return m_dirty; }
+
+	void load();
+	void save();
+
+	static QString normalize(const QUrl &url);
+
+private:
+	struct Entry
+	{
+		QString html;
+		qint64 expires;
+	};
+	static int cost(const QString &key, const Entry &entry);
+
+	QCache<QString, Entry> m_entries;
+	qint64 m_timeToLive;
+	bool m_dirty;
+};
+
+} // namespace UrlPreview
+
+#endif // URLPREVIEW_PREVIEWCACHE_H
@@ -26,17 +26,20 @@
 #include "waccount.h"
 #include "wprotocol.h"
 #include <qutim/thememanager.h>
+#include <qutim/networkaccess.h>
+#include <qutim/servicemanager.h>
 #include <QTextDocument>
 #include <QStringBuilder>
+#include <QWidget>
 #include <QDebug>
 
-WAccount::WAccount(WProtocol *protocol) : Account(QLatin1String("Weather"), protocol)
+WAccount::WAccount(WProtocol *protocol) : Account(QLatin1String("Weather"), protocol),
+	m_refreshPending(false)
 {
 	m_settings = new GeneralSettingsItem<WSettings>(Settings::Plugin, QIcon(":/icons/weather.png"),
 	                                                QT_TRANSLATE_NOOP("Weather", "Weather"));
 	m_settings->connect(SIGNAL(saved()), this, SLOT(loadSettings()));
 	Settings::registerItem(m_settings);
-	connect(&m_manager, SIGNAL(finished(QNetworkReply*)), SLOT(onNetworkReply(QNetworkReply*)));
 	loadSettings();
 }
 
@@ -89,6 +92,10 @@ void WAccount::doStatusChange(const Status &status)
 
 void WAccount::update(WContact *contact, bool needMessage)
 {
+	// Periodic refresh is skipped while previous one is still in flight
+	if (!needMessage && m_updating.contains(contact->id()))
+		return;
+	m_updating.insert(contact->id());
 	QUrl url(QLatin1String("http://forecastfox3.accuweather.com/adcbin/forecastfox3/current-conditions.asp"));
 	QUrlQuery q;
 	q.addQueryItem(QLatin1String("location"), contact->id());
@@ -97,10 +104,15 @@ void WAccount::update(WContact *contact, bool needMessage)
 	if (!langId.isEmpty())
 		q.addQueryItem(QLatin1String("langid"), langId);
 	url.setQuery(q);
-	QNetworkRequest request(url);
+	QNetworkRequest request = NetworkAccess::request(url);
 	request.setOriginatingObject(contact);
-	QNetworkReply *reply = m_manager.get(request);
+	// Periodic updates are served from disk cache while it is fresh according
+	// to http headers, explicit requests always go to the server
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+	                     needMessage ? QNetworkRequest::AlwaysNetwork : QNetworkRequest::PreferNetwork);
+	QNetworkReply *reply = get(request);
 	reply->setProperty("needMessage", needMessage);
+	reply->setProperty("contactId", contact->id());
 }
 
 void WAccount::getForecast(WContact *contact)
@@ -111,22 +123,57 @@ void WAccount::getForecast(WContact *contact)
 	QString langId = WManager::currentLangId();
 	if (!langId.isEmpty())
 		url.addQueryItem(QLatin1String("langid"), langId);
-	QNetworkRequest request(QUrl::fromEncoded(url.query(QUrl::FullyEncoded).toUtf8()));
+	QNetworkRequest request = NetworkAccess::request(QUrl::fromEncoded(url.query(QUrl::FullyEncoded).toUtf8()));
 	request.setOriginatingObject(contact);
-	QNetworkReply *reply = m_manager.get(request);
+	QNetworkReply *reply = get(request);
 	reply->setProperty("needMessage", true);
 }
 
 void WAccount::timerEvent(QTimerEvent *event)
 {
 	if (event->timerId() == m_timer.timerId()) {
-		foreach (WContact *contact, m_contacts)
-			update(contact, false);
+		// Nobody sees the statuses while contact list is hidden, so refresh
+		// is postponed until it's shown again
+		QWidget *widget = contactListWidget();
+		if (widget && !widget->isVisible())
+			m_refreshPending = true;
+		else
+			updateAll();
 		return;
 	}
 	return Account::timerEvent(event);
 }
 
+bool WAccount::eventFilter(QObject *obj, QEvent *event)
+{
+	if (obj == m_contactList && event->type() == QEvent::Show && m_refreshPending) {
+		m_refreshPending = false;
+		updateAll();
+	}
+	return Account::eventFilter(obj, event);
+}
+
+void WAccount::updateAll()
+{
+	// Forecastfox service accepts only one location per request, so they
+	// are sent separately and share connection and http cache of NetworkAccess
+	foreach (WContact *contact, m_contacts)
+		update(contact, false);
+}
+
+QWidget *WAccount::contactListWidget()
+{
+	if (!m_contactList) {
+		QObject *contactList = ServiceManager::getByName("ContactList");
+		if (!contactList)
+			return 0;
+		m_contactList = contactList->property("widget").value<QWidget*>();
+		if (m_contactList)
+			m_contactList->installEventFilter(this);
+	}
+	return m_contactList;
+}
+
 void WAccount::loadSettings()
 {
 	Config config = Config(QLatin1String("weather"));
@@ -145,9 +192,17 @@ void WAccount::loadSettings()
 	loadContacts();
 }
 
+QNetworkReply *WAccount::get(const QNetworkRequest &request)
+{
+	QNetworkReply *reply = NetworkAccess::manager()->get(request);
+	connect(reply, &QNetworkReply::finished, this, [this, reply] () { onNetworkReply(reply); });
+	return reply;
+}
+
 void WAccount::onNetworkReply(QNetworkReply *reply)
 {
 	reply->deleteLater();
+	m_updating.remove(reply->property("contactId").toString());
 	WContact *contact = qobject_cast<WContact*>(reply->request().originatingObject());
 	if (!contact)
 		return;
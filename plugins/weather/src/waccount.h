@@ -30,7 +30,9 @@
 #include "wsettings.h"
 #include <qutim/account.h>
 #include <qutim/settingslayer.h>
-#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+#include <QSet>
 
 using namespace qutim_sdk_0_3;
 
@@ -62,20 +64,26 @@ public:
 	void getForecast(WContact *contact);
 	
 	void timerEvent(QTimerEvent *event);
+	bool eventFilter(QObject *obj, QEvent *event);
 
 private slots:
 	void loadSettings();
 	void onNetworkReply(QNetworkReply *reply);
 
 private:
+	QNetworkReply *get(const QNetworkRequest &request);
 	void fillStrings(QString &text, QString &html, const QDomElement &element, const QString &prefix);
 	QString loadResourceFile(const QString &fileName);
 	void loadContacts();
+	void updateAll();
+	QWidget *contactListWidget();
 
 	SettingsItem *m_settings;
 	QHash< QString, WContact * > m_contacts;
 	QBasicTimer m_timer;
-	QNetworkAccessManager m_manager;
+	QPointer<QWidget> m_contactList;
+	QSet<QString> m_updating;
+	bool m_refreshPending;
 
 	// settings
 	bool m_showStatusRow;
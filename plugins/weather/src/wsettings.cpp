@@ -25,15 +25,12 @@
 
 #include "wsettings.h"
 #include "wmanager.h"
+#include <qutim/networkaccess.h>
 
 WSettings::WSettings()
 {
 	ui.setupUi(this);
 
-	m_networkManager = new QNetworkAccessManager();
-	connect(m_networkManager, SIGNAL(finished(QNetworkReply*)),
-	        SLOT(searchFinished(QNetworkReply*)));
-
 	QFocusEvent focusEvent(QEvent::FocusOut);
 	eventFilter(ui.searchEdit, &focusEvent);
 	ui.searchEdit->installEventFilter(this);
@@ -143,7 +140,8 @@ void WSettings::on_searchButton_clicked()
 		q.addQueryItem(QLatin1String("langid"), langId);
 	q.addQueryItem(QLatin1String("location"), ui.searchEdit->currentText());
 	url.setQuery(q);
-	m_networkManager->get(QNetworkRequest(url));
+	QNetworkReply *reply = NetworkAccess::manager()->get(NetworkAccess::request(url));
+	connect(reply, &QNetworkReply::finished, this, [this, reply] () { searchFinished(reply); });
 	ui.addButton->setEnabled(false);
 }
 
@@ -75,7 +75,6 @@ private slots:
 private:
 	Ui::WSettingsClass ui;
 
-	QNetworkAccessManager *m_networkManager;
 	QList<QPointer<WListItem>> m_items;
 };
 
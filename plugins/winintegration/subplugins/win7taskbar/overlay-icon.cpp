@@ -29,6 +29,7 @@
 #include <qutim/config.h>
 #include <QPainter>
 #include <QFont>
+#include <QTimerEvent>
 #include <qt_windows.h>
 
 #include <QtWinExtras/QWinTaskbarButton>
@@ -37,25 +38,62 @@
 using namespace qutim_sdk_0_3;
 
 WOverlayIcon::WOverlayIcon()
+	: m_unreadChats(0), m_unreadConfs(0), m_shownKey(UnknownKey)
 {
 	reloadSettings();
 	connect(WinIntegration::instance(), SIGNAL(reloadSettigs()), SLOT(reloadSettings()));
 }
 
 void WOverlayIcon::onUnreadChanged(unsigned unreadChats, unsigned unreadConfs)
+{
+	m_unreadChats = unreadChats;
+	m_unreadConfs = unreadConfs;
+	if (!m_updateTimer.isActive())
+		m_updateTimer.start(UpdateInterval, this);
+}
+
+void WOverlayIcon::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_updateTimer.timerId()) {
+		m_updateTimer.stop();
+		updateOverlay();
+		return;
+	}
+	QObject::timerEvent(event);
+}
+
+void WOverlayIcon::updateOverlay()
 {
 	if (!(WinIntegration::oneOfChatWindows()))
 		return;
+	quint32 key = 0;
+	quint32 count = m_unreadChats + (cfg_addConfs ? m_unreadConfs : 0);
+	bool confsOnly = m_unreadConfs && !m_unreadChats;
+	if (m_unreadChats + m_unreadConfs)
+		key = ((cfg_displayNumber ? count : 0) << 2) | (confsOnly ? 2 : 0) | 1;
+	if (key == m_shownKey)
+		return;
+	m_shownKey = key;
+
 	QWinTaskbarButton button;
 	button.setWindow(WinIntegration::oneOfChatWindows()->windowHandle());
-	if (!(unreadChats + unreadConfs)) {
+	if (!key) {
 		button.clearOverlayIcon();
 		return;
 	}
-	quint32 count = unreadChats + (cfg_addConfs ? unreadConfs : 0);
+	if (!m_icons.contains(key)) {
+		if (m_icons.size() >= MaxCachedIcons)
+			m_icons.clear();
+		m_icons.insert(key, overlayIcon(count, confsOnly));
+	}
+	button.setOverlayIcon(m_icons.value(key));
+}
+
+QPixmap WOverlayIcon::overlayIcon(quint32 count, bool confsOnly)
+{
 	QPixmap icon;
 	int height = GetSystemMetrics(SM_CXSMICON);
-	if (unreadConfs && !unreadChats)
+	if (confsOnly)
 		icon = Icon("winoverlay-mail-message")   .pixmap(height, height);
 	else
 		icon = Icon("winoverlay-mail-unread-new").pixmap(height, height);
@@ -71,7 +109,7 @@ void WOverlayIcon::onUnreadChanged(unsigned unreadChats, unsigned unreadConfs)
 		painter.setPen(Qt::darkBlue);
 		painter.drawText(QRect(0, 0, 16, 16), Qt::AlignCenter, QString::number(count));
 	}
-	button.setOverlayIcon(icon);
+	return icon;
 }
 
 void WOverlayIcon::reloadSettings()
@@ -84,10 +122,16 @@ void WOverlayIcon::reloadSettings()
 	cfg_addConfs      = cfg.value("oi_addNewConfMsgNumber", false);
 	cfg_displayNumber = cfg.value("oi_showNewMsgNumber",    true);
 	cfg_enabled       = cfg.value("oi_enabled",             true);
+	// Settings change look of icons, so they have to be composed again
+	m_icons.clear();
+	m_shownKey = UnknownKey;
 	if (cfg_enabled) {
 		connect(WinIntegration::instance(), SIGNAL(unreadChanged(uint,uint)), this, SLOT(onUnreadChanged(uint,uint)), Qt::UniqueConnection);
+		if (m_unreadChats + m_unreadConfs && !m_updateTimer.isActive())
+			m_updateTimer.start(UpdateInterval, this);
 	} else {
 		disconnect(WinIntegration::instance(), SIGNAL(unreadChanged(uint,uint)), this, SLOT(onUnreadChanged(uint,uint)));
+		m_updateTimer.stop();
 		button.clearOverlayIcon();
 	}
 }
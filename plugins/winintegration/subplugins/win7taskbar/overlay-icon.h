@@ -27,6 +27,9 @@
 #define WOVERLAYICON_H
 
 #include <QObject>
+#include <QBasicTimer>
+#include <QHash>
+#include <QPixmap>
 
 class WOverlayIcon : public QObject
 {
@@ -39,7 +42,23 @@ public slots:
 	void onUnreadChanged(unsigned chats, unsigned confs);
 	void reloadSettings();
 
+protected:
+	void timerEvent(QTimerEvent *event);
+
 private:
+	void updateOverlay();
+	QPixmap overlayIcon(quint32 count, bool confsOnly);
+
+	// Floods change unread counters many times per second, while taskbar
+	// button is updated at most once per UpdateInterval
+	enum { UpdateInterval = 500, MaxCachedIcons = 32 };
+	static const quint32 UnknownKey = 0xffffffff;
+	QBasicTimer m_updateTimer;
+	QHash<quint32, QPixmap> m_icons;
+	unsigned m_unreadChats;
+	unsigned m_unreadConfs;
+	// Key of shown icon, 0 if there is no overlay
+	quint32 m_shownKey;
 	bool cfg_displayNumber;
 	bool cfg_addConfs;
 	bool cfg_enabled;
@@ -75,6 +75,7 @@ WThumbnailsProvider::WThumbnailsProvider(WThumbnails *parent)
 	grView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 	grView->setVerticalScrollBarPolicy  (Qt::ScrollBarAlwaysOff);
 	parentThumbs = parent;
+	livePreviewDirty = true;
 	onUnreadChanged(0, 0);
 }
 
@@ -87,6 +88,12 @@ void WThumbnailsProvider::onUnreadChanged(unsigned chats, unsigned confs)
 {
 	this->unreadChats = chats;
 	this->unreadConfs = confs;
+	livePreviewDirty = true;
+}
+
+void WThumbnailsProvider::invalidateLivePreview()
+{
+	livePreviewDirty = true;
 }
 
 void WThumbnailsProvider::onUnreadChanged(qutim_sdk_0_3::MessageList list)
@@ -118,6 +125,7 @@ void WThumbnailsProvider::onUnreadChanged(qutim_sdk_0_3::MessageList list)
 			result += "<div>" + title + " (" + QString::number(unread) + ")</div>";
 	}
 	textUnreadAuthorsList->setHtml(result);
+	livePreviewDirty = true;
 }
 
 QPixmap WThumbnailsProvider::IconicPreview(unsigned, QWidget *, QSize size)
@@ -158,11 +166,19 @@ QPixmap WThumbnailsProvider::LivePreview(unsigned, QWidget *)
 
 void WThumbnailsProvider::prepareLivePreview()
 {
-	if (!parentThumbs->currentWindow())
+	QWidget *window = parentThumbs->currentWindow();
+	if (!window)
+		return;
+	// Rendering of whole chat window is expensive, so it's done only if
+	// its content could change since the last time
+	if (!livePreviewDirty && livePreview.size() == window->size()
+			&& livePreviewAge.isValid() && livePreviewAge.elapsed() < LIVE_PREVIEW_LIFETIME)
 		return;
-	livePreview = QPixmap(parentThumbs->currentWindow()->size());
+	livePreview = QPixmap(window->size());
 	livePreview.fill(QColor(0, 0, 0, 0)); // hack
-	parentThumbs->currentWindow()->render(&livePreview); // TODO: make better rendering quality somehow (just look on semitransparent icons)…
+	window->render(&livePreview); // TODO: make better rendering quality somehow (just look on semitransparent icons)…
+	livePreviewDirty = false;
+	livePreviewAge.start();
 }
 
 void WThumbnailsProvider::onSessionDestroyed(QObject *s)
@@ -29,6 +29,7 @@
 #include <WinThings/TaskbarPreviews.h>
 #include <QGraphicsView>
 #include <QList>
+#include <QElapsedTimer>
 #include <qutim/chatsession.h>
 
 namespace qutim_sdk_0_3
@@ -54,6 +55,8 @@ class WThumbnailsProvider : public PreviewProvider
 	QGraphicsView *grView;
 	QPixmap  sceneBgImage;
 	QPixmap  livePreview;
+	QElapsedTimer livePreviewAge;
+	bool     livePreviewDirty;
 	QSize    currentBgSize;
 	SessionsList sessions;
 	unsigned unreadChats, unreadConfs;
@@ -67,6 +70,7 @@ public:
 	QPixmap IconicPreview(unsigned tabid, QWidget *owner, QSize);
 	QPixmap LivePreview  (unsigned tabid, QWidget *owner);
 	void updateNumbers   (unsigned confs, unsigned chats);
+	void invalidateLivePreview();
 
 public slots:
 	void reloadSettings();
@@ -87,6 +91,9 @@ public slots:
 #define AUTHORS_LIST_X  10
 #define AUTHORS_LIST_Y  62
 #define ICON_SIZE       64
+// Live preview is rendered again after this time even if nothing is known
+// to change, as messages may arrive to already read chats
+#define LIVE_PREVIEW_LIFETIME 5000
 
 #endif // THUMBNAILSRENDERER_H
 
@@ -30,6 +30,7 @@
 #include <qutim/chatsession.h>
 #include <qutim/config.h>
 #include <QTimer>
+#include <QTimerEvent>
 
 using namespace qutim_sdk_0_3;
 
@@ -56,6 +57,7 @@ WThumbnails::~WThumbnails()
 void WThumbnails::onChatwindowDestruction(QObject *)
 {
 	TaskbarPreviews::tabsClear();
+	refreshTimer.stop();
 	tabId      = 0;
 	chatWindow = 0;
 }
@@ -80,13 +82,25 @@ void WThumbnails::onSessionActivated(bool)
 		connect(chatWindow, SIGNAL(destroyed(QObject*)), SLOT(onChatwindowDestruction(QObject*)));
 	} else {
 		TaskbarPreviews::tabSetTitle(tabId, chatWindow->windowTitle());
+		pp->invalidateLivePreview();
 		QTimer::singleShot(0, pp, SLOT(prepareLivePreview()));
 	}
 }
 
 void WThumbnails::onUnreadChanged(unsigned, unsigned)
 {
-	TaskbarPreviews::tabPreviewsRefresh(tabId);
+	if (!refreshTimer.isActive())
+		refreshTimer.start(RefreshInterval, this);
+}
+
+void WThumbnails::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == refreshTimer.timerId()) {
+		refreshTimer.stop();
+		TaskbarPreviews::tabPreviewsRefresh(tabId);
+		return;
+	}
+	QObject::timerEvent(event);
 }
 
 QWidget *WThumbnails::currentWindow()
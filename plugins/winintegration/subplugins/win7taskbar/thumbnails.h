@@ -27,6 +27,7 @@
 #define THUMBNAILS_H
 
 #include <QObject>
+#include <QBasicTimer>
 
 namespace qutim_sdk_0_3
 {
@@ -50,7 +51,13 @@ public slots:
 	void onUnreadChanged(unsigned, unsigned);
 	void reloadSetting();
 
+protected:
+	void timerEvent(QTimerEvent *event);
+
 private:
+	// Previews are refreshed at most once per RefreshInterval during floods
+	enum { RefreshInterval = 500 };
+	QBasicTimer refreshTimer;
 	QWidget *chatWindow;
 	unsigned tabId;
 	WThumbnailsProvider *pp;
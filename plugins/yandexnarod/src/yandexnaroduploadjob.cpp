@@ -67,7 +67,8 @@ void YandexNarodUploadJob::doSend()
 
 void YandexNarodUploadJob::doStop()
 {
-	// TODO: Implement
+	if (m_upload)
+		m_upload->abort();
 }
 
 void YandexNarodUploadJob::doReceive()
@@ -116,14 +117,20 @@ void YandexNarodUploadJob::uploadFile(const QUrl &url)
 	}
 
 	YandexRequest request(url);
-	request.setRawHeader("Content-Length", QByteArray::number(m_data->size()));
 	request.setRawHeader("Content-Type", "application/octet-stream");
 	request.setRawHeader("Expect", "100-continue");
 
-	QNetworkReply *putReply = YandexNarodFactory::networkManager()->put(request, m_data);
-	connect(putReply, SIGNAL(finished()), this, SLOT(onUploadFinished()));
-	connect(putReply, SIGNAL(uploadProgress(qint64,qint64)),
-			this, SLOT(onUploadProgress(qint64,qint64)));
+	// WebDAV of Yandex.Disk doesn't accept Content-Range, so the file is sent
+	// at once and the upload is restarted after network failures
+	if (!m_upload) {
+		m_upload = new NetworkUpload(YandexNarodFactory::networkManager(), this);
+		connect(m_upload, SIGNAL(finished(QNetworkReply*)),
+				this, SLOT(onUploadFinished(QNetworkReply*)));
+		connect(m_upload, SIGNAL(progress(qint64,qint64)),
+				this, SLOT(onUploadProgress(qint64,qint64)));
+	}
+	m_upload->setRequest(request, "PUT");
+	m_upload->start(m_data);
 }
 
 bool YandexNarodUploadJob::checkReply(QNetworkReply *reply)
@@ -232,11 +239,14 @@ void YandexNarodUploadJob::onUploadProgress(qint64 bytesSent, qint64 bytesTotal)
 	setFileProgress(bytesSent);
 }
 
-void YandexNarodUploadJob::onUploadFinished()
+void YandexNarodUploadJob::onUploadFinished(QNetworkReply *reply)
 {
-	QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
-	Q_ASSERT(reply);
-	reply->deleteLater();
+	if (!reply) {
+		setState(Error);
+		setError(IOError);
+		setErrorString(tr("Could not read file %1").arg(fileName()));
+		return;
+	}
 
 	if (!checkReply(reply))
 		return;
@@ -37,6 +37,7 @@
 #include <QTimer>
 #include <qutim/contact.h>
 #include <qutim/filetransfer.h>
+#include <qutim/networkupload.h>
 
 using namespace qutim_sdk_0_3;
 class YandexNarodFactory;
@@ -56,7 +57,7 @@ public slots:
 	void onDirectoryChecked();
 	void onDirectoryCreated();
 	void onUploadProgress(qint64 bytesSent, qint64 bytesTotal);
-	void onUploadFinished();
+	void onUploadFinished(QNetworkReply *reply);
 	void onPublishFinished();
 private:
 	void sendImpl();
@@ -64,6 +65,7 @@ private:
 	bool checkReply(QNetworkReply *reply);
 private:
 	QPointer<QIODevice> m_data;
+	QPointer<NetworkUpload> m_upload;
 };
 
 #endif
@@ -30,6 +30,7 @@ struct AstralContactPrivate
 	ContactPtr impl;
 	Status status;
 	QStringList tags;
+	QString avatar;
 };
 
 AstralContact::AstralContact(AstralAccount *acc, const ContactPtr &impl) : qutim_sdk_0_3::Contact(acc), p(new AstralContactPrivate)
@@ -68,6 +69,19 @@ QString AstralContact::name() const
 	return p->impl->alias();
 }
 
+QString AstralContact::avatar() const
+{
+	return p->avatar;
+}
+
+void AstralContact::setAvatar(const QString &path)
+{
+	if (p->avatar == path)
+		return;
+	p->avatar = path;
+	emit avatarChanged(path);
+}
+
 const ContactPtr &AstralContact::ptr()
 {
 	return p->impl;
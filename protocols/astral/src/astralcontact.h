@@ -59,6 +59,8 @@ public:
 	virtual QStringList tags() const;
 	virtual QString name() const;
 	virtual Status status() const;
+	virtual QString avatar() const;
+	void setAvatar(const QString &path);
 	virtual bool sendMessage(const qutim_sdk_0_3::Message &message);
 	virtual void setName(const QString &name);
 	virtual void setTags(const QStringList &tags);
@@ -31,6 +31,8 @@
 #include <TelepathyQt4/PendingContacts>
 #include <TelepathyQt4/PendingOperation>
 #include <TelepathyQt4/PendingReady>
+#include <qutim/config.h>
+#include <QFile>
 
 struct AstralRosterPrivate
 {
@@ -41,6 +43,14 @@ struct AstralRosterPrivate
 	QHash<ContactPtr, QPointer<AstralContact> > contactsByPtr;
 };
 
+static Features astral_contact_features()
+{
+	// All attributes are fetched by single GetContactAttributes call
+	return Features() << Tp::Contact::FeatureAlias
+					  << Tp::Contact::FeatureAvatarToken
+					  << Tp::Contact::FeatureSimplePresence;
+}
+
 AstralRoster::AstralRoster(AstralAccount *acc, ConnectionPtr conn) : p(new AstralRosterPrivate)
 {
 	p->conn = conn;
@@ -61,28 +71,95 @@ void AstralRoster::onConnectionReady(Tp::PendingOperation *op)
 		return;
 	}
 
-//	PendingReady *pr = qobject_cast<PendingReady *>(op);
-//	ConnectionPtr conn = ConnectionPtr(qobject_cast<Connection *>(pr->object()));
-//	p->manager = conn->contactManager();
-//	connect(conn->contactManager(),
-//			SIGNAL(presencePublicationRequested(const Tp::Contacts &)),
-//			SLOT(onPresencePublicationRequested(const Tp::Contacts &)));
-
-	qDebug() << "Connection ready";
-//	RosterItem *item;
-//	bool exists;
+	p->manager = p->conn->contactManager();
+	QList<ContactPtr> contacts;
 	foreach (const ContactPtr &contact_ptr, p->manager->allKnownContacts())
 	{
 		AstralContact *contact = new AstralContact(p->account, contact_ptr);
 		p->contacts.insert(contact->id(), contact);
+		p->contactsByPtr.insert(contact_ptr, contact);
 		p->account->contactCreated(contact);
-//		qDebug() << contact->id() << contact->alias() << contact->groups();
-//        exists = false;
-//        item = createItemForContact(contact, exists);
-//        if (!exists) {
-//            connect(item, SIGNAL(changed()), SLOT(updateActions()));
-//        }
+		contacts << contact_ptr;
 	}
+	// Ask for aliases, avatar tokens and presences of the whole roster at once
+	// instead of per contact calls. Later presence changes come by the bulk
+	// PresencesChanged signal, which ContactManager dispatches to contacts.
+	PendingContacts *pending = p->manager->upgradeContacts(contacts, astral_contact_features());
+	connect(pending, SIGNAL(finished(Tp::PendingOperation*)),
+			SLOT(onContactsUpgraded(Tp::PendingOperation*)));
+}
+
+void AstralRoster::onContactsUpgraded(Tp::PendingOperation *op)
+{
+	if (op->isError()) {
+		qWarning() << "Cannot retrieve contact attributes" << op->errorMessage();
+		return;
+	}
+	PendingContacts *pending = qobject_cast<PendingContacts *>(op);
+	Config cfg = p->account->config(QLatin1String("avatars"));
+	QList<ContactPtr> outdated;
+	foreach (const ContactPtr &contact_ptr, pending->contacts()) {
+		AstralContact *contact = p->contactsByPtr.value(contact_ptr);
+		if (!contact)
+			continue;
+		connect(contact_ptr.data(), SIGNAL(avatarTokenChanged(QString)),
+				SLOT(onAvatarTokenChanged(QString)));
+		connect(contact_ptr.data(), SIGNAL(avatarDataChanged(Tp::AvatarData)),
+				SLOT(onAvatarDataChanged(Tp::AvatarData)));
+		const QString token = contact_ptr->avatarToken();
+		cfg.beginGroup(contact->id());
+		const QString path = cfg.value(QLatin1String("path"), QString());
+		// Avatar is downloaded again only if its token differs from cached one
+		if (!token.isEmpty() && token == cfg.value(QLatin1String("token"), QString())
+				&& QFile::exists(path)) {
+			contact->setAvatar(path);
+		} else if (!token.isEmpty()) {
+			outdated << contact_ptr;
+		}
+		cfg.endGroup();
+	}
+	requestAvatars(outdated);
+}
+
+void AstralRoster::onAvatarTokenChanged(const QString &token)
+{
+	Tp::Contact *impl = qobject_cast<Tp::Contact *>(sender());
+	AstralContact *contact = impl ? p->contactsByPtr.value(ContactPtr(impl)) : 0;
+	if (!contact)
+		return;
+	Config cfg = p->account->config(QLatin1String("avatars"));
+	cfg.beginGroup(contact->id());
+	if (token == cfg.value(QLatin1String("token"), QString()))
+		return;
+	if (token.isEmpty()) {
+		cfg.endGroup();
+		cfg.remove(contact->id());
+		contact->setAvatar(QString());
+		return;
+	}
+	cfg.endGroup();
+	requestAvatars(QList<ContactPtr>() << contact->ptr());
+}
+
+void AstralRoster::onAvatarDataChanged(const Tp::AvatarData &avatar)
+{
+	Tp::Contact *impl = qobject_cast<Tp::Contact *>(sender());
+	AstralContact *contact = impl ? p->contactsByPtr.value(ContactPtr(impl)) : 0;
+	if (!contact)
+		return;
+	Config cfg = p->account->config(QLatin1String("avatars"));
+	cfg.beginGroup(contact->id());
+	cfg.setValue(QLatin1String("token"), impl->avatarToken());
+	cfg.setValue(QLatin1String("path"), avatar.fileName);
+	cfg.endGroup();
+	contact->setAvatar(avatar.fileName);
+}
+
+void AstralRoster::requestAvatars(const QList<ContactPtr> &contacts)
+{
+	// Single RequestAvatars call for all contacts, data comes by AvatarRetrieved
+	if (!contacts.isEmpty())
+		p->manager->requestContactAvatars(contacts);
 }
 
 AstralContact *AstralRoster::contact(const QString &id)
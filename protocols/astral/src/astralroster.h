@@ -48,8 +48,12 @@ private slots:
 //	void onRemoveActionTriggered(bool);
 //	void onBlockActionTriggered(bool);
 	void onContactRetrieved(Tp::PendingOperation *op);
+	void onContactsUpgraded(Tp::PendingOperation *op);
+	void onAvatarTokenChanged(const QString &token);
+	void onAvatarDataChanged(const Tp::AvatarData &avatar);
 //	void updateActions();
 private:
+	void requestAvatars(const QList<ContactPtr> &contacts);
 	QScopedPointer<AstralRosterPrivate> p;
 };
 
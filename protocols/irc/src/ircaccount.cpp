@@ -40,6 +40,8 @@ namespace irc {
 
 QHash<QString, QString> IrcAccountPrivate::logMsgColors;
 
+enum { MaxInternedStrings = 65536 };
+
 IrcContact *IrcAccountPrivate::newContact(const QString &nick, const QString &host)
 {
 	IrcContact *contact = new IrcContact(q, nick, host);
@@ -49,6 +51,19 @@ IrcContact *IrcAccountPrivate::newContact(const QString &nick, const QString &ho
 	return contact;
 }
 
+QString IrcAccountPrivate::intern(const QString &str)
+{
+	if (str.isEmpty())
+		return str;
+	QSet<QString>::const_iterator it = strings.constFind(str);
+	if (it != strings.constEnd())
+		return *it;
+	if (strings.size() >= MaxInternedStrings)
+		strings.clear();
+	strings.insert(str);
+	return str;
+}
+
 IrcAccount::IrcAccount(const QString &network) :
 	Account(network, IrcProtocol::instance()), d(new IrcAccountPrivate)
 {
@@ -76,6 +91,7 @@ void IrcAccount::doDisconnectFromServer()
 {
 	d->conn->disconnectFromHost(false);
 	resetGroupChatManager();
+	d->strings.clear();
 }
 
 void IrcAccount::doStatusChange(const Status &status)
@@ -104,6 +120,11 @@ void IrcAccount::setAvatar(const QString &avatar)
 	emit avatarChanged(avatar);
 }
 
+int IrcAccount::sendDelay() const
+{
+	return d->conn->sendDelay();
+}
+
 ChatUnit *IrcAccount::getUnitForSession(ChatUnit *unit)
 {
 	if (IrcChannelParticipant *participant = qobject_cast<IrcChannelParticipant*>(unit)) {
@@ -265,8 +286,8 @@ ChatSession *IrcAccount::activeSession() const
 
 void IrcAccount::log(const QString &msg, bool addToActiveSession, const QString &type) const
 {
-	QString plainText = IrcProtocol::ircFormatToPlainText(msg);
-	QString html = IrcProtocol::ircFormatToHtml(msg);
+	QString plainText, html;
+	IrcProtocol::ircFormat(msg, &plainText, &html);
 	// Add to an active session.
 	if (addToActiveSession) {
 		ChatSession *session = activeSession();
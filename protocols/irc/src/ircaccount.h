@@ -47,6 +47,7 @@ class IrcAccount: public Account
 {
 	Q_OBJECT
 	Q_PROPERTY(QString avatar READ avatar WRITE setAvatar NOTIFY avatarChanged)
+	Q_PROPERTY(int sendDelay READ sendDelay)
 public:
 	IrcAccount(const QString &network);
 	virtual ~IrcAccount();
@@ -54,6 +55,8 @@ public:
 	virtual QString name() const;
 	QString avatar();
 	void setAvatar(const QString &avatar);
+	// Msecs until a message sent now leaves the client
+	int sendDelay() const;
 	virtual ChatUnit *getUnitForSession(ChatUnit *unit);
 	virtual ChatUnit *getUnit(const QString &unitId, bool create = false);
 	IrcChannel *getChannel(const QString &name, bool create = false);
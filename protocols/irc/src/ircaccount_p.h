@@ -29,6 +29,7 @@
 
 #include "ircaccount.h"
 #include <QEvent>
+#include <QSet>
 #include "irccontact.h"
 #include "ircgroupchatmanager.h"
 #include "ui/ircconsole.h"
@@ -52,6 +53,8 @@ class IrcAccountPrivate
 public:
 	IrcContact *newContact(const QString &nick, const QString &host);
 	void removeOldCommands();
+	// Host parts are shared by many participants of large channels
+	QString intern(const QString &str);
 	friend class IrcAccount;
 	IrcAccount *q;
 	IrcConnection *conn;
@@ -63,6 +66,7 @@ public:
 	QString avatar;
 	QScopedPointer<IrcGroupChatManager> groupManager;
 	QList<LastCommand> lastCommands;
+	QSet<QString> strings;
 
 	static QHash<QString, QString> logMsgColors;
 };
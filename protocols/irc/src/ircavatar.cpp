@@ -32,6 +32,7 @@
 #include <QDir>
 #include <QCryptographicHash>
 #include <qutim/systeminfo.h>
+#include <qutim/avatarstore.h>
 
 Q_DECLARE_METATYPE(QPointer<qutim_sdk_0_3::irc::IrcContact>)
 
@@ -45,6 +46,8 @@ IrcAvatar::IrcAvatar(QObject *parent) :
 	QObject(parent)
 {
 	m_ctcpCmds << "AVATAR";
+	connect(&m_manager, SIGNAL(finished(QNetworkReply*)),
+			this, SLOT(avatarReceived(QNetworkReply*)));
 }
 
 void IrcAvatar::requestAvatar(IrcContact *contact)
@@ -75,18 +78,12 @@ void IrcAvatar::handleCtcpResponse(IrcAccount *account, const QString &sender, c
 	QPointer<IrcContact> contact = account->getContact(sender, senderHost);
 	if (!contact)
 		return;
-	QDir configDir = SystemInfo::getDir(SystemInfo::ConfigDir);
-	QDir dir(configDir.path() + "/avatars/irc/");
-	if (!dir.exists())
-		configDir.mkpath("avatars/irc/");
-	QByteArray avatarHash = QCryptographicHash::hash(avatarUrlStr.toUtf8(), QCryptographicHash::Md5).toHex();
-	QString avatarPath = dir.path() + "/" + avatarHash;
-	if (!QFileInfo(avatarPath).exists()) {
-		QNetworkAccessManager *manager = new QNetworkAccessManager(this);
-		connect(manager, SIGNAL(finished(QNetworkReply*)),
-				this, SLOT(avatarReceived(QNetworkReply*)));
-		QNetworkReply *reply = manager->get(QNetworkRequest(avatarUrl));
-		reply->setProperty("avatarPath", avatarPath);
+	// The same url may be announced by users of different networks
+	QString alias = QLatin1String("url:") + avatarUrl.toString(QUrl::FullyEncoded);
+	QString avatarPath = AvatarStore::path(alias);
+	if (avatarPath.isEmpty()) {
+		QNetworkReply *reply = m_manager.get(QNetworkRequest(avatarUrl));
+		reply->setProperty("avatarAlias", alias);
 		reply->setProperty("contact", QVariant::fromValue(contact));
 	} else {
 		contact.data()->setAvatar(avatarPath);
@@ -95,18 +92,17 @@ void IrcAvatar::handleCtcpResponse(IrcAccount *account, const QString &sender, c
 
 void IrcAvatar::avatarReceived(QNetworkReply *reply)
 {
-	if (reply->rawHeader("Content-Length").toInt() < 256000) {
-		QPointer<IrcContact> contact = reply->property("contact").value<QPointer<IrcContact> >();
-		if (!contact)
-			return;
-		QString avatarPath = reply->property("avatarPath").toString();
-		QFile file(avatarPath);
-		if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-			file.write(reply->readAll());
-			file.close();
-			contact.data()->setAvatar(avatarPath);
-		}
+	reply->deleteLater();
+	if (reply->error() != QNetworkReply::NoError
+			|| reply->rawHeader("Content-Length").toInt() >= 256000) {
+		return;
 	}
+	QPointer<IrcContact> contact = reply->property("contact").value<QPointer<IrcContact> >();
+	if (!contact)
+		return;
+	QString avatarPath = AvatarStore::store(reply->read(256000), reply->property("avatarAlias").toString());
+	if (!avatarPath.isEmpty())
+		contact.data()->setAvatar(avatarPath);
 }
 
 
@@ -28,6 +28,7 @@
 #include "ircaccount_p.h"
 #include <qutim/chatsession.h>
 #include <QDateTime>
+#include <QStringBuilder>
 
 namespace qutim_sdk_0_3 {
 
@@ -40,6 +41,7 @@ IrcChannel::IrcChannel(IrcAccount *account, const QString &name) :
 	d->me = 0;
 	d->autojoin = false;
 	d->reconnect = false;
+	d->sessionDeferred = false;
 }
 
 IrcChannel::~IrcChannel()
@@ -217,43 +219,93 @@ void IrcChannel::onContactQuit(const QString &message)
 	handlePart(user->name(), message);
 }
 
+IrcChannelParticipant *IrcChannel::createParticipant(const QString &nick, const QString &host, bool isMe)
+{
+	ParticipantPointer user = ParticipantPointer(new IrcChannelParticipant(this, nick, host));
+	if (isMe) {
+		connect(user, SIGNAL(nameChanged(QString,QString)), SLOT(onMyNickChanged(QString)));
+		d->me = user;
+	} else {
+		connect(user, SIGNAL(nameChanged(QString,QString)), SLOT(onParticipantNickChanged(QString,QString)));
+		connect(user, SIGNAL(quit(QString)), SLOT(onContactQuit(QString)));
+		d->users.insert(nick, user);
+	}
+	return user;
+}
+
+void IrcChannel::addParticipants(const QList<Buddy*> &participants)
+{
+	ChatSession *session = ChatLayer::instance()->getSession(this, !d->sessionDeferred);
+	if (!session)
+		return;
+	session->addContacts(participants);
+	session->activate();
+}
+
 void IrcChannel::handleUserList(const QStringList &users)
 {
-	ChatSession *session = ChatLayer::instance()->getSession(this, true);
+	d->pendingNames << users;
+}
+
+void IrcChannel::handleEndOfUserList()
+{
+	static QSet<QChar> flags = QSet<QChar>() << '+' << '%' << '@';
+	QStringList users;
+	qSwap(users, d->pendingNames);
+	QList<Buddy*> added;
 	QString myNick = account()->name();
 	foreach (QString userNick, users) {
-		static QSet<QChar> flags = QSet<QChar>() << '+' << '%' << '@';
 		Q_ASSERT(!userNick.isEmpty());
 		QChar flag = userNick.at(0);
 		bool isFlag = flags.contains(flag);
 		if (isFlag)
 			userNick = userNick.mid(1);
 		bool isMe = userNick == myNick;
-		if (isMe && d->me) {
-			if (isFlag)
-				d->me->setFlag(flag);
-			continue;
-		}
-		if (!isMe && d->users.contains(userNick)) {
-			if (isFlag)
-				d->users.value(userNick)->setFlag(flag);
-			continue;
-		}
-		ParticipantPointer user = ParticipantPointer(new IrcChannelParticipant(this, userNick, QString()));
-		if (isMe) {
-			connect(user, SIGNAL(nameChanged(QString,QString)), SLOT(onMyNickChanged(QString)));
-			d->me = user;
-		} else {
-			connect(user, SIGNAL(nameChanged(QString,QString)), SLOT(onParticipantNickChanged(QString,QString)));
-			connect(user, SIGNAL(quit(QString)), SLOT(onContactQuit(QString)));
-			d->users.insert(userNick, user);
+		ParticipantPointer user = isMe ? d->me : d->users.value(userNick);
+		if (!user) {
+			user = createParticipant(userNick, QString(), isMe);
+			added << user;
 		}
 		if (isFlag)
 			user->setFlag(flag);
-		if (session)
-			session->addContact(user);
 	}
-	session->activate();
+	addParticipants(added);
+}
+
+void IrcChannel::handleWhoReply(const QString &nick, const QString &user, const QString &host,
+								const QString &flags, const QString &realName)
+{
+	IrcWhoReply reply;
+	reply.nick = nick;
+	reply.hostMask = user % QLatin1Char('@') % host;
+	reply.flags = flags;
+	reply.realName = realName;
+	d->pendingWho << reply;
+}
+
+void IrcChannel::handleEndOfWho()
+{
+	QList<IrcWhoReply> replies;
+	qSwap(replies, d->pendingWho);
+	QList<Buddy*> added;
+	QString myNick = account()->name();
+	foreach (const IrcWhoReply &reply, replies) {
+		bool isMe = reply.nick == myNick;
+		ParticipantPointer user = isMe ? d->me : d->users.value(reply.nick);
+		if (!user) {
+			user = createParticipant(reply.nick, reply.hostMask, isMe);
+			added << user;
+		} else if (IrcContact *contact = user->contact()) {
+			contact->setHostMask(reply.hostMask);
+		}
+		if (IrcContact *contact = user->contact())
+			contact->setRealName(reply.realName);
+		// Flags are like "H*@", only channel ones are interesting
+		foreach (const QChar &flag, reply.flags)
+			user->setFlag(flag);
+	}
+	if (!added.isEmpty())
+		addParticipants(added);
 }
 
 void IrcChannel::handleJoin(const QString &nick, const QString &host)
@@ -261,10 +313,7 @@ void IrcChannel::handleJoin(const QString &nick, const QString &host)
 	if (nick == account()->name()) { // We have been connected to the channel.
 		setJoined(true);
 	} else if (!d->users.contains(nick)) { // Someone has joined the channel.
-		ParticipantPointer user = ParticipantPointer(new IrcChannelParticipant(this, nick, host));
-		connect(user, SIGNAL(nameChanged(QString,QString)), SLOT(onParticipantNickChanged(QString,QString)));
-		connect(user, SIGNAL(quit(QString)), SLOT(onContactQuit(QString)));
-		d->users.insert(nick, user);
+		ParticipantPointer user = createParticipant(nick, host, false);
 		ChatSession *session = ChatLayer::instance()->getSession(this, false);
 		if (session)
 			session->addContact(user);
@@ -434,9 +483,50 @@ void IrcChannel::clear(ChatSession *session)
 		delete user;
 	}
 	d->users.clear();
+	d->pendingNames.clear();
+	d->pendingWho.clear();
 	setJoined(false);
 }
 
+void IrcChannel::setSessionDeferred(bool deferred)
+{
+	if (deferred && ChatLayer::get(this, false))
+		deferred = false;
+	if (d->sessionDeferred == deferred)
+		return;
+	d->sessionDeferred = deferred;
+	if (deferred) {
+		connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
+				SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
+	} else {
+		disconnect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
+				   this, SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
+		d->deferredMessages.clear();
+	}
+}
+
+bool IrcChannel::deferMessage(const Message &message)
+{
+	// Highlights open the channel as usual
+	if (!d->sessionDeferred || message.text().contains(account()->name(), Qt::CaseInsensitive))
+		return false;
+	if (d->deferredMessages.size() >= 100)
+		d->deferredMessages.removeFirst();
+	d->deferredMessages << message;
+	return true;
+}
+
+void IrcChannel::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
+{
+	if (session->unit() != this)
+		return;
+	MessageList messages;
+	qSwap(messages, d->deferredMessages);
+	setSessionDeferred(false);
+	if (!messages.isEmpty())
+		session->append(messages);
+}
+
 }
 
 } // namespace qutim_sdk_0_3::irc
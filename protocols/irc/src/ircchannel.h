@@ -70,9 +70,16 @@ private slots:
 	void onMyNickChanged(const QString &nick);
 	void onParticipantNickChanged(const QString &nick, const QString &oldNick);
 	void onContactQuit(const QString &message);
+	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
 private:
 	void setBookmarkName(const QString &name);
 	void handleUserList(const QStringList &users);
+	void handleEndOfUserList();
+	void handleWhoReply(const QString &nick, const QString &user, const QString &host,
+						const QString &flags, const QString &realName);
+	void handleEndOfWho();
+	IrcChannelParticipant *createParticipant(const QString &nick, const QString &host, bool isMe);
+	void addParticipants(const QList<Buddy*> &participants);
 	void handleJoin(const QString &nick, const QString &host);
 	void handlePart(const QString &nick, const QString &message);
 	void handleKick(const QString &nick, const QString &by, const QString &message);
@@ -84,6 +91,8 @@ private:
 	void addSystemMessage(const QString &message, const QString &sender = QString(),
 						  Notification::Type type = Notification::System);
 	void clear(ChatSession *session);
+	void setSessionDeferred(bool deferred);
+	bool deferMessage(const Message &message);
 
 	friend class IrcConnection;
 	friend class IrcGroupChatManager;
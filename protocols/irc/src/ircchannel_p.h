@@ -34,6 +34,14 @@ namespace irc {
 
 typedef IrcChannelParticipant* ParticipantPointer;
 
+struct IrcWhoReply
+{
+	QString nick;
+	QString hostMask;
+	QString flags;
+	QString realName;
+};
+
 class IrcChannelPrivate
 {
 public:
@@ -45,6 +53,12 @@ public:
 	QString lastPassword;
 	QString bookmarkName;
 	bool reconnect;
+	// NAMES and WHO replies are applied at once when the list ends
+	QStringList pendingNames;
+	QList<IrcWhoReply> pendingWho;
+	// Autojoined channel the user has not opened yet
+	bool sessionDeferred;
+	MessageList deferredMessages;
 };
 
 }
@@ -32,17 +32,20 @@
 #include "ircavatar.h"
 #include "ircwhoisreplieshandler.h"
 #include "ircstandartctcphandler.h"
+#include "ircmessage.h"
 #include <QHostInfo>
 #include <QTextCodec>
 #include <QRegExp>
 #include <QDateTime>
+#include <QPointer>
 #include <qutim/objectgenerator.h>
 #include <qutim/chatsession.h>
 #include <qutim/networkproxy.h>
+#include <qutim/sslcontext.h>
 #include <qutim/dataforms.h>
 #include <qutim/notification.h>
 #include <qutim/passworddialog.h>
-#include <qutim/systemintegration.h>
+#include <qutim/socketoptions.h>
 
 namespace qutim_sdk_0_3 {
 
@@ -50,13 +53,18 @@ namespace irc {
 
 static QRegExp ctcpRx("^\\001(\\S+)( (.*)|)\\001");
 
+enum { MaxReplyCode = 1000 };
+
 IrcConnection::IrcConnection(IrcAccount *account, QObject *parent) :
-	QObject(parent), m_hostLookupId(0)
+	QObject(parent), m_hostLookupId(0), m_floodTime(0), m_floodBurst(10000),
+	m_floodLinePenalty(2000), m_floodBytesPerSecond(120)
 {
+	m_floodClock.start();
 	m_socket = new QSslSocket(this);
 	m_socket->setProxy(NetworkProxyManager::toNetworkProxy(NetworkProxyManager::settings(account)));
 	m_account = account;
-	m_messagesTimer.setInterval(500);
+	m_metrics = SocketMetrics(account);
+	m_messagesTimer.setSingleShot(true);
 	connect(&m_messagesTimer, SIGNAL(timeout()), SLOT(sendNextMessage()));
 	connect(m_socket, SIGNAL(readyRead()), SLOT(readData()));
 	connect(m_socket, SIGNAL(stateChanged(QAbstractSocket::SocketState)), SLOT(stateChanged(QAbstractSocket::SocketState)));
@@ -80,6 +88,8 @@ IrcConnection::IrcConnection(IrcAccount *account, QObject *parent) :
 		<< 005  // RPL_BOUNCE
 		<< 353  // RPL_NAMREPLY
 		<< 366  // RPL_ENDOFNAMES
+		<< 352  // RPL_WHOREPLY
+		<< 315  // RPL_ENDOFWHO
 		<< "PING"
 		<< "PRIVMSG"
 		<< "JOIN"
@@ -111,6 +121,7 @@ IrcConnection::IrcConnection(IrcAccount *account, QObject *parent) :
 
 IrcConnection::~IrcConnection()
 {
+	m_metrics.queued(-(m_messagesQueue.size() + m_lowPriorityMessagesQueue.size()));
 }
 
 void IrcConnection::connectToNetwork()
@@ -121,8 +132,27 @@ void IrcConnection::connectToNetwork()
 
 void IrcConnection::registerHandler(IrcServerMessageHandler *handler)
 {
-	foreach (const IrcCommand &cmd, handler->cmds())
-		m_handlers.insert(cmd.value(), handler);
+	foreach (const IrcCommand &cmd, handler->cmds()) {
+		Handlers *list;
+		if (cmd.code() > 0 && cmd.code() < MaxReplyCode) {
+			if (m_numericHandlers.isEmpty())
+				m_numericHandlers.resize(MaxReplyCode);
+			list = &m_numericHandlers[cmd.code()];
+		} else {
+			list = &m_commandHandlers[cmd.value()];
+		}
+		// Latest registered handler goes first
+		list->prepend(handler);
+	}
+}
+
+const IrcConnection::Handlers &IrcConnection::handlers(const IrcCommand &cmd) const
+{
+	static const Handlers empty;
+	if (cmd.code() > 0 && cmd.code() < MaxReplyCode)
+		return m_numericHandlers.isEmpty() ? empty : m_numericHandlers.at(cmd.code());
+	QHash<QString, Handlers>::ConstIterator it = m_commandHandlers.constFind(cmd.value());
+	return it == m_commandHandlers.constEnd() ? empty : it.value();
 }
 
 void IrcConnection::registerCtcpHandler(IrcCtcpHandler *handler)
@@ -141,11 +171,21 @@ void IrcConnection::handleMessage(IrcAccount *account, const QString &name,  con
 	}
 	if (cmd == 1 || cmd == 2 || cmd == 3 || cmd == 4) { // WELCOME
 		if (status == Status::Connecting) {
-			account->resetGroupChatManager(account->d->groupManager.data());
+			IrcGroupChatManager *manager = account->d->groupManager.data();
+			account->resetGroupChatManager(manager);
 			account->setState(Account::Connected);
 			foreach (IrcChannel *channel, account->d->channels) {
 				if (channel->d->autojoin || channel->d->reconnect) {
-					channel->join();
+					// Channels which were not open last time don't get a window
+					// until the user opens them
+					if (!channel->d->reconnect && !manager->hadOpenSession(channel->id()))
+						channel->setSessionDeferred(true);
+					QPointer<IrcChannel> guard(channel);
+					manager->scheduleJoin(channel->id(), [guard] () -> Conference * {
+						if (guard)
+							guard.data()->join();
+						return guard.data();
+					});
 					channel->d->reconnect = false;
 				}
 			}
@@ -175,6 +215,28 @@ void IrcConnection::handleMessage(IrcAccount *account, const QString &name,  con
 		IrcChannel *channel = m_account->getChannel(channelName, false);
 		if (channel)
 			channel->handleUserList(params.value(3).split(' ', QString::SkipEmptyParts));
+	} else if (cmd == 366) { // RPL_ENDOFNAMES
+		IrcChannel *channel = m_account->getChannel(params.value(1), false);
+		if (channel)
+			channel->handleEndOfUserList();
+	} else if (cmd == 352) { // RPL_WHOREPLY
+		// <me> <channel> <user> <host> <server> <nick> <flags> :<hopcount> <real name>
+		IrcChannel *channel = m_account->getChannel(params.value(1), false);
+		if (channel) {
+			channel->handleWhoReply(params.value(5), params.value(2), params.value(3),
+									params.value(6), params.value(7).section(' ', 1));
+		}
+		if (m_account->isUserInputtedCommand("WHO")) {
+			QStringList list = params;
+			list.removeFirst();
+			account->log(list.join(" "), true, "WHO");
+		}
+	} else if (cmd == 315) { // RPL_ENDOFWHO
+		IrcChannel *channel = m_account->getChannel(params.value(1), false);
+		if (channel)
+			channel->handleEndOfWho();
+		if (m_account->isUserInputtedCommand("WHO", true))
+			account->log(params.value(2), true, "WHO");
 	} else if (cmd == "PING") {
 		QString server = params.value(0);
 		server = server.mid(0, server.indexOf(' '));
@@ -340,13 +402,17 @@ void IrcConnection::handleMessage(IrcAccount *account, const QString &name,  con
 void IrcConnection::send(QString command, bool highPriority)
 {
 	if (!command.isEmpty()) {
-		if (highPriority)
+		const qint64 queued = m_floodClock.nsecsElapsed() / 1000;
+		if (highPriority) {
 			m_messagesQueue.push_back(command);
-		else
+			m_messagesQueueTimes.push_back(queued);
+		} else {
 			m_lowPriorityMessagesQueue.push_back(command);
+			m_lowPriorityMessagesQueueTimes.push_back(queued);
+		}
+		m_metrics.queued(1);
 		if (!m_messagesTimer.isActive())
-			m_messagesTimer.start();
-		sendNextMessage();
+			sendNextMessage();
 	}
 }
 
@@ -421,6 +487,11 @@ void IrcConnection::loadSettings()
 	if (!m_codec)
 		m_codec = QTextCodec::codecForName("utf8");
 	Q_ASSERT(m_codec);
+	// Defaults follow RFC 1459 servers: two seconds per line plus one more
+	// per 120 bytes, with up to ten seconds of burst
+	m_floodBurst = cfg.value("floodBurst", 10000);
+	m_floodLinePenalty = cfg.value("floodLinePenalty", 2000);
+	m_floodBytesPerSecond = cfg.value("floodBytesPerSecond", 120);
 #ifndef QUTIM_MOBILE_UI
 	m_autoRequestWhois = cfg.value("autoRequestWhois", true);
 #else
@@ -454,6 +525,7 @@ void IrcConnection::tryConnectToNextServer()
 			m_socket->setPeerVerifyMode(QSslSocket::QueryPeer);
 		else
 			m_socket->setPeerVerifyMode(QSslSocket::VerifyPeer);
+		SslContext::prepare(m_socket, server.hostName, server.port);
 		m_socket->connectToHostEncrypted(server.hostName, server.port);
 	} else {
 		m_hostLookupId = QHostInfo::lookupHost(server.hostName, this, SLOT(hostFound(QHostInfo)));
@@ -489,31 +561,65 @@ void IrcConnection::tryNextNick()
 
 void IrcConnection::sendNextMessage()
 {
-	uint currentTime = QDateTime::currentDateTime().toTime_t();
-	if (currentTime - m_lastMessageTime <= 2)
-		return;
-
-	QString command;
-	if (!m_messagesQueue.isEmpty())
-		command = m_messagesQueue.takeFirst();
-	else if (!m_lowPriorityMessagesQueue.isEmpty())
-		command = m_lowPriorityMessagesQueue.takeFirst();
-	else
-		return;
-
-	QByteArray data = m_codec->fromUnicode(command) + "\r\n";
-	qDebug() << ">>>>" << data.trimmed();
-	m_socket->write(data);
+	const qint64 now = m_floodClock.elapsed();
+	m_floodTime = qMax(m_floodTime, now);
+
+	// Send all lines allowed by the penalty timer at once
+	QByteArray data;
+	int lines = 0;
+	const qint64 sent = m_floodClock.nsecsElapsed() / 1000;
+	while (m_floodTime - now <= m_floodBurst) {
+		QString command;
+		qint64 queued;
+		if (!m_messagesQueue.isEmpty()) {
+			command = m_messagesQueue.takeFirst();
+			queued = m_messagesQueueTimes.takeFirst();
+		} else if (!m_lowPriorityMessagesQueue.isEmpty()) {
+			command = m_lowPriorityMessagesQueue.takeFirst();
+			queued = m_lowPriorityMessagesQueueTimes.takeFirst();
+		} else {
+			break;
+		}
+		m_metrics.dequeued(sent - queued);
+		++lines;
+		const QByteArray line = m_codec->fromUnicode(command) + "\r\n";
+		m_floodTime += m_floodLinePenalty;
+		if (m_floodBytesPerSecond > 0)
+			m_floodTime += line.size() * 1000 / m_floodBytesPerSecond;
+		data += line;
+	}
+	if (!data.isEmpty()) {
+		qDebug() << ">>>>" << data.trimmed();
+		m_socket->write(data);
+		m_metrics.sent(data.size(), lines);
+	}
 
-	m_lastMessageTime = QDateTime::currentDateTime().toTime_t();
 	if (m_messagesQueue.isEmpty() && m_lowPriorityMessagesQueue.isEmpty())
 		m_messagesTimer.stop();
+	else
+		m_messagesTimer.start(int(m_floodTime - now - m_floodBurst));
+}
+
+int IrcConnection::sendDelay() const
+{
+	// Replay the penalty timer over already queued lines
+	const qint64 now = m_floodClock.elapsed();
+	qint64 time = qMax(m_floodTime, now);
+	foreach (const QStringList *queue, QList<const QStringList*>() << &m_messagesQueue << &m_lowPriorityMessagesQueue) {
+		foreach (const QString &command, *queue) {
+			time = qMax(time, now + m_floodBurst);
+			time += m_floodLinePenalty;
+			if (m_floodBytesPerSecond > 0)
+				time += (command.size() + 2) * 1000 / m_floodBytesPerSecond;
+		}
+	}
+	return int(qMax<qint64>(0, time - now - m_floodBurst));
 }
 
 void IrcConnection::handleTextMessage(const QString &from, const QString &fromHost, const QString &to, const QString &text)
 {
-	QString plainText = IrcProtocol::ircFormatToPlainText(text);
-	QString html = IrcProtocol::ircFormatToHtml(text);
+	QString plainText, html;
+	IrcProtocol::ircFormat(text, &plainText, &html);
 	bool isPrivate = (to == m_nick);
 	Message msg(plainText);
 	msg.setIncoming(true);
@@ -531,10 +637,12 @@ void IrcConnection::handleTextMessage(const QString &from, const QString &fromHo
 			channelIsNotJoinedError("PRIVMSG", to);
 			return;
 		}
-		session = ChatLayer::instance()->getSession(channel, true);
 		msg.setChatUnit(channel);
 		msg.setProperty("senderName", from);
 		msg.setProperty("senderId", from);
+		if (channel->deferMessage(msg))
+			return;
+		session = ChatLayer::instance()->getSession(channel, true);
 	}
 	session->appendMessage(msg);
 }
@@ -553,39 +661,20 @@ void IrcConnection::channelIsNotJoinedError(const QString &cmd, const QString &c
 
 void IrcConnection::readData()
 {
+	IrcMessage message;
 	while (m_socket->canReadLine()) {
-		QString msg = m_codec->toUnicode(m_socket->readLine());
-		qDebug() << "<<<<" << msg.trimmed();
-		static QRegExp rx("^(:([^\\s!@]+|)(\\S+|)\\s+|)(\\w+|\\d{3})(\\s+(.*)|)");
-		if (rx.indexIn(msg) == 0) {
-			QString params = rx.cap(6);
-			QStringList paramList;
-			static QRegExp paramRx("(:[^\\r\\n]*|[^\\s\\r\\n]+)");
-			int pos = 0;
-			forever {
-				pos = paramRx.indexIn(params, pos);
-				Q_ASSERT(paramRx.matchedLength());
-				if (pos < 0)
-					break;
-				QString param = paramRx.cap(1);
-				if (param.startsWith(':')) {
-					paramList << param.mid(1);
-					break;
-				} else {
-					paramList << param;
-				}
-				pos += paramRx.matchedLength();
-			}
-			QString name = rx.cap(2);
-			QString host = rx.cap(3);
-			if (host.startsWith('!'))
-				host = host.mid(1);
-			IrcCommand cmd(rx.cap(4));
-			bool handled = false;
-			foreach (IrcServerMessageHandler *handler, m_handlers.values(cmd)) {
-				handled = true;
-				handler->handleMessage(m_account, name, host, cmd, paramList);
-			}
+		const QByteArray line = m_socket->readLine();
+		m_metrics.received(line.size(), 1);
+		qDebug() << "<<<<" << line.trimmed();
+		if (message.parse(line)) {
+			QStringList paramList = message.params(m_codec);
+			QString name = m_codec->toUnicode(message.name());
+			QString host = m_codec->toUnicode(message.host());
+			IrcCommand cmd(QString::fromLatin1(message.command()));
+			const Handlers &list = handlers(cmd);
+			const bool handled = !list.isEmpty();
+			for (int i = 0; i < list.size(); ++i)
+				list.at(i)->handleMessage(m_account, name, host, cmd, paramList);
 			if (!handled) {
 				if (cmd.code() >= 400 && cmd.code() <= 502) { // Error
 					m_account->log(paramList.last(), true, "ERROR");
@@ -605,7 +694,7 @@ void IrcConnection::stateChanged(QAbstractSocket::SocketState state)
 {
     qWarning() << "New connection state:" << state;
 	if (state == QAbstractSocket::ConnectedState) {
-		SystemIntegration::keepAlive(m_socket);
+		SocketOptions::load(m_account).apply(m_socket);
 		IrcServer server = m_servers.at(m_currentServer);
 		if (server.protectedByPassword) {
 			if (m_passDialog) {
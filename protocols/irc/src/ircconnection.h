@@ -32,6 +32,10 @@
 #include "ircaccount.h"
 #include <QSslSocket>
 #include <QTimer>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <qutim/metrics.h>
 
 class QHostInfo;
 
@@ -73,10 +77,14 @@ public:
 	bool autoRequestWhois() const { return m_autoRequestWhois; }
 	void handleTextMessage(const QString &from, const QString &fromHost, const QString &to, const QString &text);
 	QStringList supportedCtcpTags() { return m_ctcpHandlers.keys(); }
+	// Msecs until a line queued now is sent because of flood control
+	int sendDelay() const;
 private:
 	void tryConnectToNextServer();
 	void tryNextNick();
 	void channelIsNotJoinedError(const QString &cmd, const QString &channel, bool reply = true);
+	typedef QVector<IrcServerMessageHandler*> Handlers;
+	const Handlers &handlers(const IrcCommand &cmd) const;
 private slots:
 	void readData();
 	void stateChanged(QAbstractSocket::SocketState);
@@ -88,7 +96,9 @@ private slots:
 	void passwordEntered(const QString &password, bool remember);
 private:
 	QSslSocket *m_socket;
-	QMultiMap<QString, IrcServerMessageHandler*> m_handlers;
+	// Dispatch tables, numeric replies are indexed by their code
+	QVector<Handlers> m_numericHandlers;
+	QHash<QString, Handlers> m_commandHandlers;
 	QMultiMap<QString, IrcCtcpHandler*> m_ctcpHandlers;
 	IrcAccount *m_account;
 	QList<IrcServer> m_servers;
@@ -102,10 +112,20 @@ private:
 	int m_hostLookupId;
 	QStringList m_messagesQueue;
 	QStringList m_lowPriorityMessagesQueue;
+	// Microseconds of m_floodClock when the lines were queued
+	QList<qint64> m_messagesQueueTimes;
+	QList<qint64> m_lowPriorityMessagesQueueTimes;
 	QTimer m_messagesTimer;
-	uint m_lastMessageTime; // unix time when the last message had been sent
+	// Flood control: every sent line moves m_floodTime forward by its penalty,
+	// lines are sent while it is at most m_floodBurst msecs ahead of now
+	QElapsedTimer m_floodClock;
+	qint64 m_floodTime;
+	int m_floodBurst;
+	int m_floodLinePenalty;
+	int m_floodBytesPerSecond;
 	bool m_autoRequestWhois;
 	QPointer<PasswordDialog> m_passDialog;
+	SocketMetrics m_metrics;
 };
 
 } } // namespace qutim_sdk_0_3::irc
@@ -98,10 +98,12 @@ QString IrcContact::avatar() const
 
 Status IrcContact::status() const
 {
-	Status status;
-	status.setType(d->awayMsg.isEmpty() ? Status::Online : Status::Away);
+	if (d->awayMsg.isEmpty())
+		return Status(Status::Online);
+	// Channel participants ask it often, and most away statuses are the same
+	Status status(Status::Away);
 	status.setText(d->awayMsg);
-	return status;
+	return Status::intern(status);
 }
 
 void IrcContact::setAvatar(const QString &avatar)
@@ -190,13 +192,14 @@ void IrcContact::setHostMask(const QString &host)
 {
 	if (d->hostMask == host || host.isEmpty())
 		return;
-	d->hostMask = host;
+	IrcAccountPrivate *p = account()->d.data();
+	d->hostMask = p->intern(host);
 	int pos = host.indexOf('@');
 	if (pos != -1) {
-		d->hostUser = host.mid(0, pos);
+		d->hostUser = p->intern(host.mid(0, pos));
 		setHost(host, ++pos);
 	} else {
-		d->hostUser = host;
+		d->hostUser = d->hostMask;
 		d->domain = QString();
 		d->host = QString();
 	}
@@ -206,11 +209,12 @@ void IrcContact::setHost(const QString &host, int pos)
 {
 	static QRegExp ipRx("\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}$");
 	int hostPos = ipRx.indexIn(host, pos) == -1 ? host.indexOf('.') : -1;
+	IrcAccountPrivate *p = account()->d.data();
 	if (hostPos != -1) {
-		d->domain = host.mid(pos, hostPos-pos);
-		d->host = host.mid(hostPos+1);
+		d->domain = p->intern(host.mid(pos, hostPos-pos));
+		d->host = p->intern(host.mid(hostPos+1));
 	} else {
-		d->domain = host.mid(pos);
+		d->domain = p->intern(host.mid(pos));
 		d->host = QString();
 	}
 }
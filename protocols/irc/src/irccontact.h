@@ -66,6 +66,7 @@ private slots:
 private:
 	friend class IrcContactPrivate;
 	friend class IrcChannelParticipant;
+	friend class IrcChannel;
 	friend class IrcConnection;
 	friend class IrcAccount;
 	friend class IrcWhoisRepliesHandler;
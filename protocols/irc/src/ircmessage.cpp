@@ -0,0 +1,155 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "ircmessage.h"
+#include <QTextCodec>
+
+namespace qutim_sdk_0_3 {
+
+namespace irc {
+
+static inline QByteArray view(const char *begin, const char *end)
+{
+	return QByteArray::fromRawData(begin, end - begin);
+}
+
+static inline const char *skipSpaces(const char *p, const char *end)
+{
+	while (p != end && *p == ' ')
+		++p;
+	return p;
+}
+
+static inline const char *findChar(const char *p, const char *end, char c)
+{
+	while (p != end && *p != c)
+		++p;
+	return p;
+}
+
+IrcMessage::IrcMessage()
+{
+}
+
+bool IrcMessage::parse(const QByteArray &line)
+{
+	m_tags.clear();
+	m_prefix.clear();
+	m_name.clear();
+	m_host.clear();
+	m_command.clear();
+	m_params.clear();
+
+	const char *p = line.constData();
+	const char *end = p + line.size();
+	while (end != p && (end[-1] == '\n' || end[-1] == '\r'))
+		--end;
+
+	if (p != end && *p == '@') {
+		const char *tagsEnd = findChar(++p, end, ' ');
+		while (p < tagsEnd) {
+			const char *tagEnd = findChar(p, tagsEnd, ';');
+			const char *keyEnd = findChar(p, tagEnd, '=');
+			if (keyEnd != p) {
+				m_tags << Tag(view(p, keyEnd),
+				              keyEnd == tagEnd ? QByteArray() : view(keyEnd + 1, tagEnd));
+			}
+			p = tagEnd + (tagEnd != tagsEnd);
+		}
+		p = skipSpaces(tagsEnd, end);
+	}
+
+	if (p != end && *p == ':') {
+		const char *prefixEnd = findChar(++p, end, ' ');
+		m_prefix = view(p, prefixEnd);
+		const char *nameEnd = p;
+		while (nameEnd != prefixEnd && *nameEnd != '!' && *nameEnd != '@')
+			++nameEnd;
+		m_name = view(p, nameEnd);
+		if (nameEnd != prefixEnd && *nameEnd == '!')
+			++nameEnd;
+		m_host = view(nameEnd, prefixEnd);
+		p = skipSpaces(prefixEnd, end);
+	}
+
+	const char *commandEnd = findChar(p, end, ' ');
+	if (commandEnd == p)
+		return false;
+	m_command = view(p, commandEnd);
+
+	p = skipSpaces(commandEnd, end);
+	while (p != end) {
+		if (*p == ':') {
+			m_params << view(p + 1, end);
+			break;
+		}
+		const char *paramEnd = findChar(p, end, ' ');
+		m_params << view(p, paramEnd);
+		p = skipSpaces(paramEnd, end);
+	}
+	return true;
+}
+
+QByteArray IrcMessage::tag(const QByteArray &key) const
+{
+	foreach (const Tag &tag, m_tags) {
+		if (tag.first != key)
+			continue;
+		if (!tag.second.contains('\\'))
+			return tag.second;
+		// Unescape value as described by IRCv3 message-tags
+		QByteArray value;
+		value.reserve(tag.second.size());
+		for (int i = 0; i < tag.second.size(); ++i) {
+			char c = tag.second.at(i);
+			if (c == '\\' && ++i < tag.second.size()) {
+				c = tag.second.at(i);
+				switch (c) {
+				case ':': c = ';'; break;
+				case 's': c = ' '; break;
+				case 'r': c = '\r'; break;
+				case 'n': c = '\n'; break;
+				default: break;
+				}
+			} else if (c == '\\') {
+				break;
+			}
+			value += c;
+		}
+		return value;
+	}
+	return QByteArray();
+}
+
+QStringList IrcMessage::params(QTextCodec *codec) const
+{
+	QStringList result;
+	result.reserve(m_params.size());
+	foreach (const QByteArray &param, m_params)
+		result << codec->toUnicode(param);
+	return result;
+}
+
+} } // namespace qutim_sdk_0_3::irc
@@ -0,0 +1,67 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef IRCMESSAGE_H
+#define IRCMESSAGE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+
+class QTextCodec;
+
+namespace qutim_sdk_0_3 {
+
+namespace irc {
+
+// Parser of a single IRC (IRCv3) line. Parsed parts refer to the data of
+// the line without copying it, so the line must outlive the message.
+class IrcMessage
+{
+public:
+	typedef QPair<QByteArray, QByteArray> Tag;
+	IrcMessage();
+	bool parse(const QByteArray &line);
+	const QList<Tag> &tags() const { return m_tags; }
+	QByteArray tag(const QByteArray &key) const;
+	const QByteArray &prefix() const { return m_prefix; }
+	const QByteArray &name() const { return m_name; }
+	const QByteArray &host() const { return m_host; }
+	const QByteArray &command() const { return m_command; }
+	const QList<QByteArray> &params() const { return m_params; }
+	QStringList params(QTextCodec *codec) const;
+private:
+	QList<Tag> m_tags;
+	QByteArray m_prefix;
+	QByteArray m_name;
+	QByteArray m_host;
+	QByteArray m_command;
+	QList<QByteArray> m_params;
+};
+
+} } // namespace qutim_sdk_0_3::irc
+
+#endif // IRCMESSAGE_H
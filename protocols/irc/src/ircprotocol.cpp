@@ -37,8 +37,8 @@
 #include <qutim/settingslayer.h>
 #include <qutim/icon.h>
 #include <QStringList>
-#include <QRegExp>
 #include <QTextDocument>
+#include <algorithm>
 
 Q_DECLARE_METATYPE(qutim_sdk_0_3::irc::IrcAccount*)
 
@@ -182,121 +182,149 @@ void IrcProtocol::removeCommandAlias(IrcCommandAlias *alias)
 	}
 }
 
-static QRegExp formatRx("(\\002|\\037|\\026|\\017|\\003((\\d{0,2})(,\\d{1,2}|)|))");
+static const char * const mircColors[] = {
+	"white",
+	"black",
+	"blue",
+	"green",
+	"#FA5A5A", //lightred
+	"brown",
+	"purple",
+	"orange",
+	"yellow",
+	"lightgreen",
+	"cyan",
+	"lightcyan",
+	"lightblue",
+	"pink",
+	"grey",
+	"lightgrey"
+};
+
+enum FormatTag { BoldTag, UnderlinedTag, ItalicTag, ColorTag, FormatTagCount };
+static const char * const openingTags[] = { "<b>", "<u>", "<i>" };
+static const char * const closingTags[] = { "</b>", "</u>", "</i>", "</span>" };
+
+static inline bool isMircDigit(QChar c)
+{
+	return c.unicode() >= '0' && c.unicode() <= '9';
+}
 
-QString IrcProtocolPrivate::getColorByMircCode(const QString &code)
+static inline int readMircColor(const QChar *data, int size, int &pos)
 {
-	static QStringList colors = QStringList()
-								<< "white"
-								<< "black"
-								<< "blue"
-								<< "green"
-								<< "#FA5A5A" //lightred
-								<< "brown"
-								<< "purple"
-								<< "orange"
-								<< "yellow"
-								<< "lightgreen"
-								<< "cyan"
-								<< "lightcyan"
-								<< "lightblue"
-								<< "pink"
-								<< "grey"
-								<< "lightgrey";
-	bool ok;
-	int c = code.toInt(&ok);
-	if (ok)
-		return colors.value(c);
-	else
-		return QString();
+	int color = -1;
+	for (int digits = 0; digits < 2 && pos < size && isMircDigit(data[pos]); ++digits)
+		color = qMax(color, 0) * 10 + data[pos++].unicode() - '0';
+	return color;
+}
+
+static inline const char *mircColor(int code)
+{
+	return code >= 0 && code < int(sizeof(mircColors) / sizeof(mircColors[0])) ? mircColors[code] : 0;
 }
 
-QString IrcProtocol::ircFormatToHtml(const QString &msg_helper)
+void IrcProtocol::ircFormat(const QString &msg, QString *plainText, QString *html)
 {
 	// \002 bold
 	// \037 underlined
 	// \026 italic
 	// \017 normal
 	// \003xx,xx color
-	QString msg = msg_helper.toHtmlEscaped();
-	QString result;
-	result.reserve(msg.size() + 20);
-	QStringList resettingTags; // list of tags for resetting format
-	bool bold = false;
-	bool underlined = false;
-	bool italic = false;
-	int pos = 0, oldPos = 0;
-	while ((pos = formatRx.indexIn(msg, pos)) != -1) {
-		QString tmp = msg.mid(oldPos, pos - oldPos);
-		result += tmp;
-		QChar f = formatRx.cap(1).at(0);
-		if (f == '\002') { // bold
-			if (!bold) {
-				result += "<b>";
-				resettingTags.prepend("</b>");
+	if (plainText) {
+		plainText->clear();
+		plainText->reserve(msg.size());
+	}
+	if (html) {
+		html->clear();
+		html->reserve(msg.size() + 20);
+	}
+	// Opened tags, they are closed from the last one on resetting format
+	int tags[FormatTagCount];
+	int tagCount = 0;
+	const QChar *data = msg.constData();
+	const int size = msg.size();
+	for (int pos = 0; pos < size;) {
+		const QChar c = data[pos++];
+		switch (c.unicode()) {
+		case '\002':
+		case '\037':
+		case '\026': {
+			if (!html)
+				break;
+			const int tag = c.unicode() == '\002' ? BoldTag : (c.unicode() == '\037' ? UnderlinedTag : ItalicTag);
+			int index = std::find(tags, tags + tagCount, tag) - tags;
+			if (index == tagCount) {
+				html->append(QLatin1String(openingTags[tag]));
+				tags[tagCount++] = tag;
 			} else {
-				result += "</b>";
-				resettingTags.removeOne("</b>");
+				html->append(QLatin1String(closingTags[tag]));
+				std::copy(tags + index + 1, tags + tagCount--, tags + index);
 			}
-			bold = !bold;
-		} else if (f == '\037') { // underlined
-			if (!underlined) {
-				result += "<u>";
-				resettingTags.prepend("</u>");
-			} else {
-				result += "</u>";
-				resettingTags.removeOne("</u>");
+			break;
+		}
+		case '\017':
+			while (html && tagCount > 0)
+				html->append(QLatin1String(closingTags[tags[--tagCount]]));
+			break;
+		case '\003': {
+			const int fontColor = readMircColor(data, size, pos);
+			int backgroundColor = -1;
+			if (pos + 1 < size && data[pos] == QLatin1Char(',') && isMircDigit(data[pos + 1])) {
+				++pos;
+				backgroundColor = readMircColor(data, size, pos);
 			}
-			underlined = !underlined;
-		} else if (f == '\026') { // italic
-			if (!italic) {
-				result += "<i>";
-				resettingTags.prepend("</i>");
-			} else {
-				result += "</i>";
-				resettingTags.removeOne("</i>");
+			if (!html || !IrcProtocolPrivate::enableColoring)
+				break;
+			// Resetting all colors
+			int index = std::find(tags, tags + tagCount, int(ColorTag)) - tags;
+			if (index != tagCount) {
+				html->append(QLatin1String(closingTags[ColorTag]));
+				std::copy(tags + index + 1, tags + tagCount--, tags + index);
 			}
-			italic = !italic;
-		} else if (f == '\017') { // normal
-			result += resettingTags.join("");
-			resettingTags.clear();
-		} else { // color
-			if (IrcProtocolPrivate::enableColoring) {
-				QString fontColor = IrcProtocolPrivate::getColorByMircCode(formatRx.cap(3));
-				QString backgroundColor = IrcProtocolPrivate::getColorByMircCode(formatRx.cap(4).mid(1));
-				// Resetting all colors
-				if (resettingTags.removeOne("</font>"))
-					result += "</font>";
-				if (!fontColor.isEmpty() || !backgroundColor.isEmpty()) {
-					result += "<span style=\"";
-					if (!fontColor.isEmpty())
-						result += "color: " + fontColor + ";";
-					if (!backgroundColor.isEmpty())
-						result += "background-color: " + backgroundColor + ";";
-					result += "\">";
-					resettingTags.prepend("</font>");
-				}
+			const char *fontName = mircColor(fontColor);
+			const char *backgroundName = mircColor(backgroundColor);
+			if (fontName || backgroundName) {
+				html->append(QLatin1String("<span style=\""));
+				if (fontName)
+					html->append(QLatin1String("color: ")).append(QLatin1String(fontName)).append(QLatin1Char(';'));
+				if (backgroundName)
+					html->append(QLatin1String("background-color: ")).append(QLatin1String(backgroundName)).append(QLatin1Char(';'));
+				html->append(QLatin1String("\">"));
+				tags[tagCount++] = ColorTag;
 			}
+			break;
+		}
+		default:
+			if (plainText)
+				plainText->append(c);
+			if (!html)
+				break;
+			if (c == QLatin1Char('<'))
+				html->append(QLatin1String("&lt;"));
+			else if (c == QLatin1Char('>'))
+				html->append(QLatin1String("&gt;"));
+			else if (c == QLatin1Char('&'))
+				html->append(QLatin1String("&amp;"));
+			else if (c == QLatin1Char('"'))
+				html->append(QLatin1String("&quot;"));
+			else
+				html->append(c);
+			break;
 		}
-		pos += formatRx.matchedLength();
-		oldPos = pos;
 	}
-	QString tmp = msg.mid(oldPos);
-	result += tmp;
+}
+
+QString IrcProtocol::ircFormatToHtml(const QString &msg)
+{
+	QString result;
+	ircFormat(msg, 0, &result);
 	return result;
 }
 
 QString IrcProtocol::ircFormatToPlainText(const QString &msg)
 {
 	QString result;
-	result.reserve(msg.size());
-	int pos = 0, oldPos = 0;
-	while ((pos = formatRx.indexIn(msg, pos)) != -1) {
-		result += msg.mid(oldPos, pos - oldPos);
-		pos += formatRx.matchedLength();
-		oldPos = pos;
-	}
-	result += msg.mid(oldPos);
+	ircFormat(msg, &result, 0);
 	return result;
 }
 
@@ -58,6 +58,8 @@ public:
 	static void registerCommandAlias(IrcCommandAlias *alias);
 	static void removeCommandAlias(const QString &name);
 	static void removeCommandAlias(IrcCommandAlias *alias);
+	// Converts mIRC formatting codes by one pass, either output may be null
+	static void ircFormat(const QString &msg, QString *plainText, QString *html);
 	static QString ircFormatToHtml(const QString &msg);
 	static QString ircFormatToPlainText(const QString &msg);
 public slots:
@@ -34,6 +34,7 @@
 #include "muc/jmucuser.h"
 #include <qutim/systeminfo.h>
 #include <qutim/debug.h>
+#include <qutim/avatarstore.h>
 #include <qutim/event.h>
 #include <qutim/dataforms.h>
 #include <qutim/libqutim_version.h>
@@ -123,21 +124,53 @@ void JAccountPrivate::_q_connected()
 //		currentPGPKeyId = pgpKeyId;
 //		emit q->pgpKeyIdChanged(currentPGPKeyId);
 //	}
+	markLoginPhase("online");
+	debug() << "Login timings, ms:" << loginTimings;
+	q->setProperty("loginTimings", loginTimings);
 	applyStatus(q->userStatus());
-	conferenceManager.data()->syncBookmarks();
-	q->resetGroupChatManager(conferenceManager.data()->bookmarkManager());	
+	JBookmarkManager *bookmarkManager = conferenceManager.data()->bookmarkManager();
+	bookmarkManager->startAutojoin();
+	q->resetGroupChatManager(bookmarkManager);
 	client->setPingInterval(q->config().group("general").value("pingInterval", 30000));
 }
 
+void JAccountPrivate::_q_stream_connected()
+{
+	markLoginPhase("stream");
+	// Privacy lists are requested at the same moment and the roster right
+	// before, so bookmarks go in the same write instead of waiting for both
+	conferenceManager.data()->syncBookmarks();
+}
+
+void JAccountPrivate::_q_bookmarks_loaded()
+{
+	markLoginPhase("bookmarks");
+}
+
 void JAccountPrivate::onPasswordReceived(const QString &password)
 {
     client->setPassword(password);
-    client->connectToServer();
+    startLogin();
+}
+
+void JAccountPrivate::startLogin()
+{
+	loginTimings.clear();
+	loginTimer.start();
+	client->connectToServer();
+}
+
+void JAccountPrivate::markLoginPhase(const char *phase)
+{
+	if (!loginTimer.isValid() || loginTimings.contains(QLatin1String(phase)))
+		return;
+	loginTimings.insert(QLatin1String(phase), loginTimer.elapsed());
 }
 
 void JAccountPrivate::_q_on_module_loaded(int i)
 {
 	qDebug() << Q_FUNC_INFO << loadedModules << i << q_func()->sender();
+	markLoginPhase(i == 1 ? "roster" : "privacy");
 	loadedModules |= i;
 	if (loadedModules == 3)
 		_q_connected();
@@ -188,6 +221,7 @@ void JAccountPrivate::_q_disconnected(Jreen::Client::DisconnectReason reason)
 
 	q->resetGroupChatManager(0);
 	loadedModules = 0;
+	loginTimer.invalidate();
 
 	q->setState(Account::Disconnected, statusReason);
 }
@@ -203,6 +237,7 @@ void JAccountPrivate::_q_init_extensions(const QSet<QString> &features)
 	//			ext->init(q,params);
 	//		}
 	//	}
+	markLoginPhase("features");
 	roster->load();
 }
 
@@ -212,6 +247,8 @@ JAccount::JAccount(const QString &id) :
 {
 	Q_D(JAccount);
 	d->client.reset(new Client(id));
+	d->streamMetrics.metrics = SocketMetrics(this);
+	d->client->addXmlStreamHandler(&d->streamMetrics);
 	connect(d->client.data(), SIGNAL(disconnected(Jreen::Client::DisconnectReason)),
 			this, SLOT(_q_disconnected(Jreen::Client::DisconnectReason)));
 	connect(d->client.data(), SIGNAL(serverFeaturesReceived(QSet<QString>)),
@@ -249,12 +286,15 @@ JAccount::JAccount(const QString &id) :
 	d->signalMapper.setMapping(d->roster, 1);
 	d->signalMapper.setMapping(d->privacyManager, 2);
 	connect(d->client.data(), SIGNAL(connected()), d->privacyManager, SLOT(request()));
+	connect(d->client.data(), SIGNAL(connected()), this, SLOT(_q_stream_connected()));
 	connect(&d->signalMapper, SIGNAL(mapped(int)), this, SLOT(_q_on_module_loaded(int)));
 	
 	d->roster->loadFromStorage();
 
 	connect(d->conferenceManager.data(), SIGNAL(conferenceCreated(qutim_sdk_0_3::Conference*)),
 			this, SIGNAL(conferenceCreated(qutim_sdk_0_3::Conference*)));
+	connect(d->conferenceManager.data()->bookmarkManager(), SIGNAL(serverBookmarksChanged()),
+			this, SLOT(_q_bookmarks_loaded()));
 
 	foreach (const ObjectGenerator *gen, ObjectGenerator::module<JabberExtension>()) {
 		if (JabberExtension *ext = gen->generate<JabberExtension>()) {
@@ -443,7 +483,7 @@ void JAccount::doConnectToServer()
 			}
 		});
     } else {
-        d->client->connectToServer();
+        d->startLogin();
 	}
 }
 
@@ -465,9 +505,7 @@ void JAccount::doStatusChange(const Status &status)
 
 QString JAccount::getAvatarPath()
 {
-	return QString("%1/avatars/%2")
-			.arg(SystemInfo::getPath(SystemInfo::ConfigDir))
-			.arg(protocol()->id());
+	return AvatarStore::directory();
 }
 
 void JAccount::setAvatarHex(const QString &hex)
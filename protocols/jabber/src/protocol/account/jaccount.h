@@ -113,6 +113,8 @@ private:
 	
 	Q_PRIVATE_SLOT(d_func(),void _q_set_nick(const QString &nick))
 	Q_PRIVATE_SLOT(d_func(),void _q_connected())
+	Q_PRIVATE_SLOT(d_func(),void _q_stream_connected())
+	Q_PRIVATE_SLOT(d_func(),void _q_bookmarks_loaded())
 	Q_PRIVATE_SLOT(d_func(),void _q_disconnected(Jreen::Client::DisconnectReason))
 	Q_PRIVATE_SLOT(d_func(),void _q_init_extensions(const QSet<QString> &features))
 	Q_PRIVATE_SLOT(d_func(),void _q_on_module_loaded(int i))
@@ -35,7 +35,9 @@
 #include "../../sdk/jabber.h"
 #include <QSignalMapper>
 #include <QNetworkProxy>
+#include <QElapsedTimer>
 #include <qutim/servicemanager.h>
+#include <qutim/metrics.h>
 #include <qutim/keychain.h>
 
 namespace Jreen
@@ -47,6 +49,19 @@ namespace Jabber {
 
 typedef QHash<QString, QHash<QString, QString> > Identities;
 
+// Jreen owns the socket, so traffic is counted at the XML stream, that is
+// after TLS and stream compression are removed
+class JStreamMetrics : public Jreen::XmlStreamHandler
+{
+public:
+	void handleStreamBegin() {}
+	void handleStreamEnd() {}
+	void handleIncomingData(const char *, qint64 size) { metrics.received(size); }
+	void handleOutgoingData(const char *, qint64 size) { metrics.sent(size, 0); }
+
+	SocketMetrics metrics;
+};
+
 class JAccountPrivate
 {
 	Q_DECLARE_PUBLIC(JAccount)
@@ -54,6 +69,8 @@ public:
 	inline JAccountPrivate(JAccount *q) : q_ptr(q) {}
 	inline ~JAccountPrivate() {}
 
+	// Declared before the client, which keeps pointer to it till the end
+	JStreamMetrics streamMetrics;
 	//Jreen
 	QScopedPointer<Jreen::Client> client;
 	QNetworkProxy proxy;
@@ -77,6 +94,9 @@ public:
 	QSignalMapper signalMapper;
 	int loadedModules;
 	int priority;
+	// Time since connection start, for login latency reports
+	QElapsedTimer loginTimer;
+	QVariantMap loginTimings;
 	
 	void applyStatus(const Status &status);
 	void setPresence(Jreen::Presence);
@@ -85,7 +105,11 @@ public:
 	void _q_init_extensions(const QSet<QString> &features);
 	void _q_on_module_loaded(int i);
 	void _q_connected();
+	void _q_stream_connected();
+	void _q_bookmarks_loaded();
 	void onPasswordReceived(const QString &password);
+	void startLogin();
+	void markLoginPhase(const char *phase);
 
 	//old code
 	Identities identities;
@@ -25,8 +25,10 @@
 #include "jbookmarkmanager.h"
 #include "jmucmanager.h"
 #include "../jaccount.h"
+#include <qutim/conference.h>
 #include <qutim/dataforms.h>
 #include <qutim/notification.h>
+#include <qutim/cryptoservice.h>
 #include <qutim/debug.h>
 
 namespace Jabber
@@ -39,6 +41,8 @@ struct JBookmarkManagerPrivate
 	QList<Bookmark::Conference> bookmarks;
 	QList<Bookmark::Conference> recent;
 	bool isLoaded;
+	bool autojoinAllowed;
+	bool autojoined;
 	bool storeAtServer;
 };
 
@@ -48,6 +52,8 @@ JBookmarkManager::JBookmarkManager(JAccount *account) :
 {
 	p->account = account;
 	p->isLoaded = false;
+	p->autojoinAllowed = false;
+	p->autojoined = false;
 	p->storage = new BookmarkStorage(account->client());
 	p->storage->setPrivateXml(account->privateXml());
 	p->storage->setPubSubManager(account->pubSubManager());
@@ -87,19 +93,40 @@ void JBookmarkManager::onBookmarksReceived(const Jreen::Bookmark::Ptr &bookmark)
 	//			configBookmarks.setValue("url", QString::fromStdString(item.url));
 	//			++num;
 	//		}
-	if (!p->isLoaded) {
-		foreach (Bookmark::Conference bookmark, p->bookmarks) {
-			qDebug() << "check bookmark:" << bookmark.jid().full() << bookmark.autojoin();
-			if (bookmark.autojoin())
-				p->account->conferenceManager()->join(bookmark.jid(),
-													  bookmark.nick(),
-													  bookmark.password());
-		}
-	}
 	p->isLoaded = true;
+	if (p->autojoinAllowed)
+		autojoin();
 	emit serverBookmarksChanged();
 }
 
+void JBookmarkManager::startAutojoin()
+{
+	p->autojoinAllowed = true;
+	if (p->isLoaded)
+		autojoin();
+}
+
+void JBookmarkManager::autojoin()
+{
+	if (p->autojoined)
+		return;
+	p->autojoined = true;
+	JAccount *account = p->account;
+	foreach (const Bookmark::Conference &bookmark, p->bookmarks) {
+		qDebug() << "check bookmark:" << bookmark.jid().full() << bookmark.autojoin();
+		if (!bookmark.autojoin())
+			continue;
+		const QString id = bookmark.jid().bare();
+		// Rooms which were not open last time are joined in background
+		const bool openSession = hadOpenSession(id);
+		scheduleJoin(id, [account, bookmark, id, openSession] () -> qutim_sdk_0_3::Conference * {
+			JMUCManager *manager = account->conferenceManager();
+			manager->join(bookmark.jid(), bookmark.nick(), bookmark.password(), openSession);
+			return qobject_cast<qutim_sdk_0_3::Conference *>(manager->muc(id));
+		});
+	}
+}
+
 QList<Bookmark::Conference> JBookmarkManager::bookmarksList() const
 {
 	return p->bookmarks;
@@ -166,6 +193,8 @@ void JBookmarkManager::sync()
 QList<Bookmark::Conference> JBookmarkManager::readFromCache(const QString &type)
 {
 	QList<Bookmark::Conference> list;
+	QVariantList passwords;
+	QList<int> indexes;
 	Config config = p->account->config();
 	int count = config.beginArray(type);
     for (int num = 0; num < count; num++) {
@@ -174,10 +203,18 @@ QList<Bookmark::Conference> JBookmarkManager::readFromCache(const QString &type)
         bookmark.setName(configBookmark.value("name", QString()));
         bookmark.setJid(configBookmark.value("conference", QString()));
         bookmark.setNick(configBookmark.value("nick", QString()));
-        bookmark.setPassword(configBookmark.value("password", QString(), Config::Crypted));
+        const QVariant password = configBookmark.value("password");
+        if (!password.isNull()) {
+            passwords << password;
+            indexes << list.size();
+        }
         bookmark.setAutojoin(configBookmark.value("autojoin", false));
 		list << bookmark;
 	}
+	// Passwords are decrypted at once instead of one by one
+	passwords = CryptoService::decryptList(passwords);
+	for (int i = 0; i < indexes.size(); ++i)
+		list[indexes.at(i)].setPassword(passwords.at(i).toString());
 	return list;
 }
 
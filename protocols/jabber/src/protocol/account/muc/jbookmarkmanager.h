@@ -59,6 +59,9 @@ public:
 	void saveRecent(const QString &conference, const QString &nick, const QString &password);
 	bool removeBookmark(const Jreen::Bookmark::Conference &bookmark);
 	void sync();
+	// Bookmarks may come before the account is ready, so autojoin
+	// waits for this call
+	void startAutojoin();
 	void clearRecent();
 	DataItem fields(const Jreen::Bookmark::Conference &bookmark, bool isBookmark = true) const;
 
@@ -79,6 +82,7 @@ protected:
 	void writeToCache(const QString &type, const QList<Jreen::Bookmark::Conference> &list);
 	void saveToServer();
 private:
+	void autojoin();
 	QScopedPointer<JBookmarkManagerPrivate> p;
 };
 }
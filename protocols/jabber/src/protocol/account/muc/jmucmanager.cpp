@@ -167,7 +167,8 @@ void JMUCManager::bookmarksChanged()
 	}
 }
 
-void JMUCManager::join(const QString &conference, const QString &nick, const QString &password)
+void JMUCManager::join(const QString &conference, const QString &nick, const QString &password,
+					   bool openSession)
 {
 	Q_D(JMUCManager);
 	JMUCSession *room = d->rooms.value(conference, 0);
@@ -205,6 +206,8 @@ void JMUCManager::join(const QString &conference, const QString &nick, const QSt
 			}
 		}
 		d->rooms.insert(conference, room);
+		if (!openSession)
+			room->setSessionDeferred(true);
 		Jreen::PrivacyManager *manager = d->account->privacyManager();
 		emit conferenceCreated(room);
 		d->roomsToConnect << room;
@@ -216,9 +219,11 @@ void JMUCManager::join(const QString &conference, const QString &nick, const QSt
 	}
 	//		p->account->client()->registerPresenceHandler(JID(conference.toStdString()),
 	//													  p->account->connection()->softwareDetection());
-	ChatSession *session = ChatLayer::get(room, true);
-	connect(session, SIGNAL(destroyed()), room, SIGNAL(initClose()));
-	connect(room, SIGNAL(initClose()), SLOT(closeMUCSession()));
+	if (openSession)
+		room->setSessionDeferred(false);
+	if (ChatSession *session = ChatLayer::get(room, openSession))
+		connect(session, SIGNAL(destroyed()), room, SIGNAL(initClose()), Qt::UniqueConnection);
+	connect(room, SIGNAL(initClose()), SLOT(closeMUCSession()), Qt::UniqueConnection);
 	//	I think that it should be called by plugins, but not by protocol itself,
 	//	because it's rather slow method due to a lot of gui initialization
 	//	session->activate();
@@ -59,7 +59,8 @@ public:
 	qutim_sdk_0_3::ChatUnit *muc(const Jreen::JID &jid);
 	JBookmarkManager *bookmarkManager();
 	void syncBookmarks();
-	void join(const QString &conference, const QString &nick = QString(), const QString &password = QString());
+	void join(const QString &conference, const QString &nick = QString(), const QString &password = QString(),
+			  bool openSession = true);
 	void setPresenceToRooms(const Jreen::Presence &presence);
 	void leave(const QString &room);
 	bool event(QEvent *event);
@@ -65,10 +65,22 @@ namespace Jabber
 class JMUCSessionPrivate
 {
 public:
+	struct PendingParticipant
+	{
+		QString nick;
+		Jreen::Presence presence;
+		MUCRoom::Affiliation affiliation;
+		MUCRoom::Role role;
+		Jreen::JID realJid;
+	};
+
 	void removeUser(JMUCSession *session, JMUCUser *user);
 	JMUCUser *addUser(JMUCSession *session, const QString &nick);
 	JMUCUser *getUser(const QString &nick);
 	bool containsUser(const QString &nick);
+	void bufferParticipant(const Jreen::Presence &presence, const Jreen::MUCRoom::Participant *participant);
+	void flushParticipants(JMUCSession *session);
+	void deferMessage(const qutim_sdk_0_3::Message &message);
 	
 	QPointer<JAccount> account;
 	QList<Jreen::MessageFilter*> filters;
@@ -86,8 +98,17 @@ public:
 	bool isError;
 	QDateTime lastMessage;
 	QString *thread;
+	// Presences of occupants are buffered until our own one arrives,
+	// so participants of large rooms are created at once
+	bool joinBurst;
+	QList<PendingParticipant> pendingParticipants;
+	QHash<QString, int> pendingIndexes;
+	bool sessionDeferred;
+	MessageList deferredMessages;
 };
 
+enum { MaxDeferredMessages = 100 };
+
 void JMUCSessionPrivate::removeUser(JMUCSession *conference, JMUCUser *user)
 {
 	if (ChatSession *session = ChatLayer::get(conference, false))
@@ -127,6 +148,51 @@ bool JMUCSessionPrivate::containsUser(const QString &nick)
 	return (user && user->presenceType() != Presence::Unavailable);
 }
 
+void JMUCSessionPrivate::bufferParticipant(const Jreen::Presence &presence,
+										   const Jreen::MUCRoom::Participant *participant)
+{
+	const QString nick = presence.from().resource();
+	int index = pendingIndexes.value(nick, -1);
+	if (index < 0) {
+		index = pendingParticipants.size();
+		pendingIndexes.insert(nick, index);
+		pendingParticipants.append(PendingParticipant());
+		pendingParticipants.last().nick = nick;
+	}
+	PendingParticipant &pending = pendingParticipants[index];
+	pending.presence = presence;
+	pending.affiliation = participant->affiliation();
+	pending.role = participant->role();
+	pending.realJid = participant->realJID();
+}
+
+void JMUCSessionPrivate::flushParticipants(JMUCSession *session)
+{
+	QList<Buddy*> added;
+	added.reserve(pendingParticipants.size());
+	foreach (const PendingParticipant &pending, pendingParticipants) {
+		if (pending.presence.subtype() == Presence::Unavailable || getUser(pending.nick))
+			continue;
+		JMUCUser *user = addUser(session, pending.nick);
+		user->setStatus(pending.presence);
+		user->setMUCAffiliationAndRole(pending.affiliation, pending.role);
+		if (pending.realJid.isValid())
+			user->setRealJid(pending.realJid);
+		added << user;
+	}
+	pendingParticipants.clear();
+	pendingIndexes.clear();
+	if (ChatSession *chatSession = ChatLayer::get(session, false))
+		chatSession->addContacts(added);
+}
+
+void JMUCSessionPrivate::deferMessage(const qutim_sdk_0_3::Message &message)
+{
+	if (deferredMessages.size() >= MaxDeferredMessages)
+		deferredMessages.removeFirst();
+	deferredMessages << message;
+}
+
 JMUCSession::JMUCSession(const Jreen::JID &room, const QString &password, JAccount *account) :
 	Conference(account), d_ptr(new JMUCSessionPrivate)
 {
@@ -154,6 +220,8 @@ JMUCSession::JMUCSession(const Jreen::JID &room, const QString &password, JAccou
 	//		d->room->setPassword(password);
 	d->isError = false;
 	d->thread = 0;
+	d->joinBurst = false;
+	d->sessionDeferred = false;
 	d->title = room.bare();
 	loadSettings();
 }
@@ -214,6 +282,9 @@ void JMUCSession::doJoin()
 	Q_D(JMUCSession);
 	if(isJoined() || !d->account.data()->client()->isConnected())
 		return;
+	d->pendingParticipants.clear();
+	d->pendingIndexes.clear();
+	d->joinBurst = true;
 	d->room->join();
 	emit joined();
 }
@@ -352,6 +423,17 @@ void JMUCSession::onParticipantPresence(const Jreen::Presence &presence,
 	Notification::Type notificationType = Notification::System;
 	QString nick = presence.from().resource();
 	bool isSelf = nick == d->room->nick();
+	if (d->joinBurst) {
+		if (!isSelf && !participant->isBanned() && !participant->isKicked()
+				&& !participant->isNickChanged()) {
+			// Join messages aren't shown before the room is joined anyway
+			d->bufferParticipant(presence, participant);
+			return;
+		}
+		d->flushParticipants(this);
+		if (isSelf)
+			d->joinBurst = false;
+	}
 	QString text;
 	if (participant->isBanned() || participant->isKicked()) {
 		QString reason = participant->reason();
@@ -514,7 +596,6 @@ void JMUCSession::onMessage(Jreen::Message msg, bool priv)
 		if (user)
 			coreMsg.setProperty("senderId", user->id());
 		coreMsg.setIncoming(msg.from().resource() != d->room->nick());
-		ChatSession *chatSession = ChatLayer::get(this, true);
 		DelayedDelivery::Ptr when = msg.when();
 		if (when) {
 			coreMsg.setProperty("history", true);
@@ -522,23 +603,30 @@ void JMUCSession::onMessage(Jreen::Message msg, bool priv)
 		} else {
 			coreMsg.setTime(d->lastMessage);
 		}
-		if (!coreMsg.isIncoming() && !when) {
-			QHash<QString, quint64>::iterator it = d->messages.find(msg.id());
-			if (it != d->messages.end()) {
-				qApp->postEvent(chatSession, new qutim_sdk_0_3::MessageReceiptEvent(it.value(), true));
-				d->messages.erase(it);
-                return;
-			}
-			coreMsg.setProperty("donotsend", true);
-			
-			// Send "info" that message is received, yeah, that's a hack
-			qApp->postEvent(chatSession, new qutim_sdk_0_3::MessageReceiptEvent(coreMsg.id(), true), Qt::LowEventPriority);
-		}
 		if (!msg.subject().isEmpty()) {
 			coreMsg.setProperty("topic", true);
 			coreMsg.setProperty("subject", msg.subject());
 		}
-		chatSession->appendMessage(coreMsg);
+		// Highlights still open the room, everything else waits for the user
+		if (d->sessionDeferred && coreMsg.isIncoming()
+				&& (when || !coreMsg.text().contains(d->room->nick(), Qt::CaseInsensitive))) {
+			d->deferMessage(coreMsg);
+		} else {
+			ChatSession *chatSession = ChatLayer::get(this, true);
+			if (!coreMsg.isIncoming() && !when) {
+				QHash<QString, quint64>::iterator it = d->messages.find(msg.id());
+				if (it != d->messages.end()) {
+					qApp->postEvent(chatSession, new qutim_sdk_0_3::MessageReceiptEvent(it.value(), true));
+					d->messages.erase(it);
+					return;
+				}
+				coreMsg.setProperty("donotsend", true);
+
+				// Send "info" that message is received, yeah, that's a hack
+				qApp->postEvent(chatSession, new qutim_sdk_0_3::MessageReceiptEvent(coreMsg.id(), true), Qt::LowEventPriority);
+			}
+			chatSession->appendMessage(coreMsg);
+		}
 		if (!msg.subject().isEmpty() && d->topic != msg.subject()) {
 			QString oldTopic = d->topic;
 			d->topic = msg.subject();
@@ -580,12 +668,16 @@ void JMUCSession::onServiceMessage(const Jreen::Message &msg)
 	}
 	if (!msg.subject().isEmpty())
 		return;
-	ChatSession *chatSession = ChatLayer::get(this, true);
 	qutim_sdk_0_3::Message coreMsg(msg.body());
 	coreMsg.setChatUnit(this);
 	coreMsg.setProperty("service",true);
 	coreMsg.setProperty("silent", true);
 	coreMsg.setIncoming(true);
+	if (d->sessionDeferred) {
+		d->deferMessage(coreMsg);
+		return;
+	}
+	ChatSession *chatSession = ChatLayer::get(this, true);
 	chatSession->appendMessage(coreMsg);
 }
 
@@ -739,7 +831,14 @@ void JMUCSession::closeConfigDialog()
 void JMUCSession::joinedChanged()
 {
 	Q_D(JMUCSession);
+	if (d->joinBurst && d->room->isJoined()) {
+		d->joinBurst = false;
+		d->flushParticipants(this);
+	}
 	if (!d->room->isJoined()) {
+		d->joinBurst = false;
+		d->pendingParticipants.clear();
+		d->pendingIndexes.clear();
 		//remove users
 		const Presence presence(Presence::Unavailable, JID());
 		foreach (JMUCUser *user, d->users) {
@@ -753,6 +852,37 @@ void JMUCSession::joinedChanged()
 	setJoined(d->room->isJoined());
 }
 
+void JMUCSession::setSessionDeferred(bool deferred)
+{
+	Q_D(JMUCSession);
+	if (deferred && ChatLayer::get(this, false))
+		deferred = false;
+	if (d->sessionDeferred == deferred)
+		return;
+	d->sessionDeferred = deferred;
+	if (deferred) {
+		connect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
+				SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
+	} else {
+		disconnect(ChatLayer::instance(), SIGNAL(sessionCreated(qutim_sdk_0_3::ChatSession*)),
+				   this, SLOT(onSessionCreated(qutim_sdk_0_3::ChatSession*)));
+		d->deferredMessages.clear();
+	}
+}
+
+void JMUCSession::onSessionCreated(qutim_sdk_0_3::ChatSession *session)
+{
+	Q_D(JMUCSession);
+	if (session->unit() != this)
+		return;
+	MessageList messages;
+	qSwap(messages, d->deferredMessages);
+	setSessionDeferred(false);
+	connect(session, SIGNAL(destroyed()), this, SIGNAL(initClose()), Qt::UniqueConnection);
+	if (!messages.isEmpty())
+		session->append(messages);
+}
+
 bool JMUCSession::enabledConfiguring()
 {
 	//TODO add signal configuring changed
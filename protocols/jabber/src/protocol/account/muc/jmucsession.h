@@ -78,6 +78,9 @@ public:
 	void setConferenceTopic(const QString &topic);
 	void invite(qutim_sdk_0_3::Contact *contact, const QString &reason = QString());
 	void handleDeath(const QString &name);
+	// Chat session of the room is not created until the user opens it,
+	// incoming messages are kept until then
+	void setSessionDeferred(bool deferred);
 protected:
 	void loadSettings();
 	virtual void doJoin();
@@ -120,6 +123,7 @@ public slots:
 private slots:
 	void closeConfigDialog();
 	void joinedChanged();
+	void onSessionCreated(qutim_sdk_0_3::ChatSession *session);
 signals:
 	void nickChanged(const QString &nick);
 	void initClose();
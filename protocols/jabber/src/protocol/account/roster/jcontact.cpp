@@ -284,12 +284,13 @@ bool JContact::hasResource(const QString &resource)
 
 void JContact::addResource(const QString &resource)
 {
-	JContactResource *res = new JContactResource(this, resource);
+	JRoster *roster = static_cast<JAccount*>(account())->roster();
+	JContactResource *res = new JContactResource(this, roster->intern(resource));
 	connect(res, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
 			SLOT(resourceStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
 	connect(res,SIGNAL(chatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState,qutim_sdk_0_3::ChatUnit::ChatState)),
 			this,SIGNAL(chatStateChanged(qutim_sdk_0_3::ChatUnit::ChatState,qutim_sdk_0_3::ChatUnit::ChatState)));
-	d_func()->resources.insert(resource, res);
+	d_func()->resources.insert(res->name(), res);
 	emit lowerUnitAdded(res);
 }
 
@@ -300,6 +301,18 @@ void JContact::setStatus(const Jreen::Presence presence)
 	Jreen::Presence::Type type = presence.subtype();
 
 	Q_D(JContact);
+	if (!error && type != Jreen::Presence::Unavailable && !resource.isEmpty()) {
+		// Presences are often resent with nothing visible changed, e.g. for
+		// new vcard hash, so keep them away from the contact status
+		JContactResource *contactResource = d->resources.value(resource);
+		if (contactResource && contactResource->isSamePresence(presence)) {
+			contactResource->blockSignals(true);
+			contactResource->setStatus(presence);
+			contactResource->blockSignals(false);
+			return;
+		}
+	}
+
 	Status oldStatus = status();
 	if ((type == Jreen::Presence::Unavailable || error) && resource.isEmpty()) {
 		qDeleteAll(d->resources);
@@ -363,7 +376,7 @@ void JContact::recalcStatus()
 		itr.next();
 		status.setExtendedInfo(itr.key(), itr.value());
 	}
-	d->status = status;
+	d->status = Status::intern(status);
 }
 
 void JContact::fillMaxResource()
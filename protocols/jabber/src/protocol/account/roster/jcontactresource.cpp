@@ -36,6 +36,7 @@
 #include <jreen/chatstate.h>
 #include <jreen/message.h>
 #include <jreen/client.h>
+#include <jreen/capabilities.h>
 #ifdef JABBER_HAVE_MULTIMEDIA
 # include <jreen/experimental/jinglemanager.h>
 #endif
@@ -156,6 +157,22 @@ void JContactResource::setStatus(const Jreen::Presence presence)
 	emit statusChanged(status(), current);
 }
 
+bool JContactResource::isSamePresence(const Jreen::Presence &presence) const
+{
+	Q_D(const JContactResource);
+	const Jreen::Presence &current = d->presence;
+	if (current.subtype() != presence.subtype()
+			|| current.priority() != presence.priority()
+			|| current.status() != presence.status()) {
+		return false;
+	}
+	Jreen::Capabilities::Ptr currentCaps = current.payload<Jreen::Capabilities>();
+	Jreen::Capabilities::Ptr caps = presence.payload<Jreen::Capabilities>();
+	if (!currentCaps || !caps)
+		return !currentCaps && !caps;
+	return currentCaps->ver() == caps->ver() && currentCaps->node() == caps->node();
+}
+
 Status JContactResource::status() const
 {
 	Q_D(const JContactResource);
@@ -74,6 +74,8 @@ public:
 	Jreen::Presence::Type presenceType() const;
 	Jreen::Presence presence() const;
 	void setStatus(const Jreen::Presence presence);
+	// Show, status text, priority and caps are the same as current ones
+	bool isSamePresence(const Jreen::Presence &presence) const;
 	Status status() const;
 	virtual bool event(QEvent *ev);
 	QSet<QString> features() const;
@@ -31,6 +31,7 @@
 #include "../muc/jmucmanager.h"
 #include "../../../sdk/jabber.h"
 #include <qutim/debug.h>
+#include <qutim/outgoingmessagequeue.h>
 #include <jreen/receipt.h>
 #include <jreen/client.h>
 #include <jreen/chatstate.h>
@@ -51,21 +52,25 @@ JMessageReceiptFilter::JMessageReceiptFilter(JAccount *account, Jreen::MessageSe
 
 void JMessageReceiptFilter::filter(Jreen::Message &message)
 {
+	if(message.containsPayload<Jreen::Error>())
+		return;
 	Jreen::Receipt *receipt = message.payload<Jreen::Receipt>().data();
+	Jreen::ChatState *state = message.payload<Jreen::ChatState>().data();
+	// Most messages carry neither, so don't look up the unit for them
+	if (!receipt && !state)
+		return;
 	ChatUnit *unit = m_account->conferenceManager()->muc(message.from());
 	if (!unit)
 		unit = m_account->roster()->contact(message.from(), true);
-	qDebug() << Q_FUNC_INFO << unit << message.from();
-	if(message.containsPayload<Jreen::Error>())
-		return;
 	if(receipt) {
 		if(receipt->type() == Jreen::Receipt::Received) {
 			QString id = receipt->id();
 			if(id.isEmpty())
 				id = message.id(); //for slowpoke client such as Miranda			
-			if(unit)
+			OutgoingMessageQueue *queue = m_account->messageSessionManager()->queue();
+			if(!queue->acknowledge(id.toULongLong()) && unit)
 				qApp->postEvent(ChatLayer::get(unit),
-								new qutim_sdk_0_3::MessageReceiptEvent(id.toUInt(), true));
+								new qutim_sdk_0_3::MessageReceiptEvent(id.toULongLong(), true));
 		} else {
 			//TODO send this request only when message marked as read
 			Jreen::Message request(Jreen::Message::Chat,
@@ -78,7 +83,6 @@ void JMessageReceiptFilter::filter(Jreen::Message &message)
 			m_account->client()->send(request);
 		}
 	}
-	Jreen::ChatState *state = message.payload<Jreen::ChatState>().data();
 	if(state) {
 		if(unit)
 			unit->setChatState(static_cast<qutim_sdk_0_3::ChatUnit::ChatState>(state->state()));
@@ -120,8 +124,24 @@ public:
 	JMessageSessionManagerPrivate(JMessageSessionManager *q) : q_ptr(q) {}
 	JMessageSessionManager *q_ptr;
 	JAccount *account;
+	OutgoingMessageQueue *queue;
 };
 
+// Receipt is requested always, but only some clients answer to it
+static bool expectsReceipt(ChatUnit *unit)
+{
+	const QLatin1String feature("urn:xmpp:receipts");
+	if (JContactResource *resource = qobject_cast<JContactResource*>(unit))
+		return resource->checkFeature(feature);
+	if (JContact *contact = qobject_cast<JContact*>(unit)) {
+		foreach (JContactResource *resource, contact->resources()) {
+			if (resource->checkFeature(feature))
+				return true;
+		}
+	}
+	return false;
+}
+
 JMessageSessionManager::JMessageSessionManager(JAccount *account) :
 	Jreen::MessageSessionManager(account->client()),
 	d_ptr(new JMessageSessionManagerPrivate(this))
@@ -135,6 +155,14 @@ JMessageSessionManager::JMessageSessionManager(JAccount *account) :
 	types.append(Jreen::Message::Invalid);
 
 	registerMessageSessionHandler(new JMessageSessionHandler(account),types);
+
+	d->queue = new OutgoingMessageQueue(account, [this] (const qutim_sdk_0_3::Message &message) {
+		ChatUnit *unit = const_cast<ChatUnit*>(message.chatUnit());
+		send(unit, message);
+		return expectsReceipt(unit) ? OutgoingMessageQueue::SendAwaitingReceipt
+									: OutgoingMessageQueue::SendDone;
+	}, this);
+	d->queue->setPersistent(true);
 }
 
 JMessageSessionManager::~JMessageSessionManager()
@@ -148,7 +176,20 @@ void JMessageSessionManager::handleMessage(const Jreen::Message &message)
 	return Jreen::MessageSessionManager::handleMessage(message);
 }
 
+OutgoingMessageQueue *JMessageSessionManager::queue() const
+{
+	return d_func()->queue;
+}
+
 void JMessageSessionManager::sendMessage(qutim_sdk_0_3::ChatUnit *unit, const qutim_sdk_0_3::Message &message)
+{
+	// Message may belong to the session's unit, but is addressed to the resource
+	qutim_sdk_0_3::Message copy = message;
+	copy.setChatUnit(unit);
+	d_func()->queue->append(copy);
+}
+
+void JMessageSessionManager::send(qutim_sdk_0_3::ChatUnit *unit, const qutim_sdk_0_3::Message &message)
 {
 	JID jid = unit->id();
 	Jreen::MessageSession *s = session(jid, Jreen::Message::Chat, true);
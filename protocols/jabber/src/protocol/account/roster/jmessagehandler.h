@@ -35,6 +35,7 @@ namespace qutim_sdk_0_3
 {
 class ChatUnit;
 class Message;
+class OutgoingMessageQueue;
 }
 
 namespace Jabber
@@ -73,7 +74,9 @@ class JMessageSessionManager : public Jreen::MessageSessionManager
 public:
 	JMessageSessionManager(JAccount *account);
 	virtual ~JMessageSessionManager();
+	// Messages go through the account's outgoing queue
 	void sendMessage(qutim_sdk_0_3::ChatUnit *unit, const qutim_sdk_0_3::Message &message);
+	qutim_sdk_0_3::OutgoingMessageQueue *queue() const;
 public slots:
 	virtual void handleMessage(const Jreen::Message &message);
 	
@@ -81,6 +84,7 @@ signals:
 	void messageEcnrypted(quint64 messageId);
 	
 private:
+	void send(qutim_sdk_0_3::ChatUnit *unit, const qutim_sdk_0_3::Message &message);
 	QScopedPointer<JMessageSessionManagerPrivate> d_ptr;
 };
 }
@@ -42,6 +42,9 @@
 #include "jaccountresource.h"
 #include <qutim/debug.h>
 #include <qutim/rosterstorage.h>
+#include <qutim/contactstore.h>
+#include <qutim/memoryaccounting.h>
+#include <qutim/protocol.h>
 #include <QApplication>
 #include <jreen/pgpencrypted.h>
 //Jreen
@@ -53,13 +56,20 @@
 namespace Jabber
 {
 
-class JRosterPrivate : public ContactsFactory
+class JRosterPrivate : public LazyContactsFactory
 {
 //	Q_OBJECT
 public:
 	JRosterPrivate(JRoster *q) : q_ptr(q) {}
 	Contact *addContact(const QString &id, const QVariantMap &data);
 	void serialize(Contact *contact, QVariantMap &data);
+	const RosterSchema *schema() const;
+	void addStubs(const QList<RosterStub> &stubs, const DataLoader &loader);
+	void fillStub(const QVariantMap &data, RosterStub &stub);
+	JContact *materialize(ContactStore::Handle handle);
+	// Same as contacts.value(), but creates not yet materialized roster contacts
+	JContact *findContact(const QString &id);
+	void materializeSmallRoster();
 	
 	JAccount *account;
 	JRoster *q_ptr;
@@ -71,39 +81,125 @@ public:
 	bool ignoreChanges;
 	bool atMetaLoad;
 	bool atMetaSync;
+	// Roster diff received at login is passed to storage at once
+	bool atLoad;
+	QList<Contact*> addedContacts;
+	QList<Contact*> updatedContacts;
+	QList<Contact*> removedContacts;
+	QSet<QString> strings;
+	// All roster items, huge rosters materialize only used contacts
+	ContactStore store;
+	int lazyThreshold;
 };
 
+enum { MaxInternedStrings = 4096 };
+
 static QEvent::Type metaContactSyncType()
 {
 	static QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
 	return type;
 }
 
+enum RosterField { AvatarField, NameField, TagsField, SubscriptionField };
+
+const RosterSchema *JRosterPrivate::schema() const
+{
+	static const RosterSchema schema(QStringList()
+									 << QStringLiteral("avatar")
+									 << QStringLiteral("name")
+									 << QStringLiteral("tags")
+									 << QStringLiteral("s10n"));
+	return &schema;
+}
+
 Contact *JRosterPrivate::addContact(const QString &id, const QVariantMap &data)
 {
+	const RosterSchema *fields = schema();
+	const ContactStore::Handle handle = store.insert(id);
+	store.setAvatar(handle, data.value(fields->key(AvatarField)).toString());
+	store.setName(handle, data.value(fields->key(NameField)).toString());
+	store.setTags(handle, data.value(fields->key(TagsField)).toStringList());
+	store.setFlags(handle, data.value(fields->key(SubscriptionField)).toInt());
+//	contact->setPGPKeyId(data.value(QLatin1String("pgpKeyId")).toString());
+	// Contacts are created by loadFromStorage() or on demand for huge rosters
+	return 0;
+}
+
+void JRosterPrivate::addStubs(const QList<RosterStub> &stubs, const DataLoader &loader)
+{
+	// Stubs contain every stored field, so loader isn't needed
+	Q_UNUSED(loader);
+	foreach (const RosterStub &stub, stubs) {
+		const ContactStore::Handle handle = store.insert(stub.id);
+		store.setAvatar(handle, stub.avatar);
+		store.setName(handle, stub.name);
+		store.setTags(handle, stub.tags);
+		store.setFlags(handle, stub.flags);
+	}
+}
+
+void JRosterPrivate::fillStub(const QVariantMap &data, RosterStub &stub)
+{
+	const RosterSchema *fields = schema();
+	stub.avatar = data.value(fields->key(AvatarField)).toString();
+	stub.name = data.value(fields->key(NameField)).toString();
+	stub.tags = data.value(fields->key(TagsField)).toStringList();
+	stub.flags = data.value(fields->key(SubscriptionField)).toInt();
+}
+
+JContact *JRosterPrivate::materialize(ContactStore::Handle handle)
+{
+	const QString id = store.id(handle);
 	JContact *contact = new JContact(id, account);
 	QObject::connect(contact, SIGNAL(destroyed(QObject*)), q_ptr, SLOT(onContactDestroyed(QObject*)));
-	contact->setAvatar(data.value(QLatin1String("avatar")).toString());
+	contact->setAvatar(store.avatar(handle));
 	contact->setContactInList(true);
-	contact->setContactName(data.value(QLatin1String("name")).toString());
-	contact->setContactTags(data.value(QLatin1String("tags")).toStringList());
-	int s10n = data.value(QLatin1String("s10n")).toInt();
-	contact->setContactSubscription(static_cast<Jreen::RosterItem::SubscriptionType>(s10n));
-//	contact->setPGPKeyId(data.value(QLatin1String("pgpKeyId")).toString());
+	contact->setContactName(store.name(handle));
+	contact->setContactTags(store.tags(handle));
+	contact->setContactSubscription(static_cast<Jreen::RosterItem::SubscriptionType>(store.flags(handle)));
 	contacts.insert(id, contact);
 	emit account->contactCreated(contact);
+
+	// Metacontacts are received before lazy contacts are created
+	auto it = metacontacts.constFind(id);
+	if (!atMetaLoad && it != metacontacts.constEnd()) {
+		atMetaLoad = true;
+		if (MetaContact *metaContact = qobject_cast<MetaContact*>(MetaContactManager::instance()->getUnit(it->tag(), true)))
+			metaContact->addContact(contact);
+		atMetaLoad = false;
+	}
 	return contact;
 }
 
+JContact *JRosterPrivate::findContact(const QString &id)
+{
+	if (JContact *contact = contacts.value(id))
+		return contact;
+	const ContactStore::Handle handle = store.find(id);
+	if (handle == ContactStore::InvalidHandle)
+		return 0;
+	return static_cast<JContact*>(store.materialize(handle));
+}
+
+void JRosterPrivate::materializeSmallRoster()
+{
+	if (lazyThreshold > 0 && store.count() > lazyThreshold)
+		return;
+	RosterTransaction transaction(account);
+	foreach (ContactStore::Handle handle, store.handles())
+		store.materialize(handle);
+}
+
 void JRosterPrivate::serialize(Contact *generalContact, QVariantMap &data)
 {
 	JContact *contact = qobject_cast<JContact*>(generalContact);
 	if (!contact)
 		return;
-	data.insert(QLatin1String("avatar"), contact->avatarHash());
-	data.insert(QLatin1String("name"), contact->name());
-	data.insert(QLatin1String("tags"), contact->tags());
-	data.insert(QLatin1String("s10n"), contact->subscription());
+	const RosterSchema *fields = schema();
+	data.insert(fields->key(AvatarField), contact->avatarHash());
+	data.insert(fields->key(NameField), contact->name());
+	data.insert(fields->key(TagsField), contact->tags());
+	data.insert(fields->key(SubscriptionField), contact->subscription());
 //	data.insert(QLatin1String("pgpKeyId"), contact->pgpKeyId());
 }
 
@@ -121,6 +217,16 @@ JRoster::JRoster(JAccount *account) :
 	d->metaStorage->setPrivateXml(d->account->privateXml());
 	d->atMetaLoad = false;
 	d->atMetaSync = false;
+	d->atLoad = false;
+	d->store.setFactory([d] (ContactStore::Handle handle) -> Contact* {
+		return d->materialize(handle);
+	});
+	// Offline contacts of bigger rosters are created only once they are needed
+	Config cfg = account->protocol()->config(QStringLiteral("general"));
+	d->lazyThreshold = cfg.value(QStringLiteral("lazyRosterThreshold"), 5000);
+	MemoryAccounting::add(MemoryAccounting::ContactList, this, QStringLiteral("jabber roster"), [d] () {
+		return d->store.memoryUsage();
+	});
 	connect(d->metaStorage, SIGNAL(metaContactsReceived(Jreen::MetaContactStorage::ItemList)),
 	        SLOT(onMetaContactsReceived(Jreen::MetaContactStorage::ItemList)));
 	connect(d->account->client(),SIGNAL(presenceReceived(Jreen::Presence)),
@@ -142,12 +248,12 @@ void JRoster::loadFromStorage()
 	QList<Jreen::RosterItem::Ptr> items;
 	d->ignoreChanges = true;
 	QString version = d->storage->load(d->account);
-	QHashIterator<QString, JContact*> contacts = d->contacts;
-	while (contacts.hasNext()) {
-		contacts.next();
-		JContact *contact = contacts.value();
+	d->materializeSmallRoster();
+	foreach (ContactStore::Handle handle, d->store.handles()) {
+		const Jreen::RosterItem::SubscriptionType s10n
+				= static_cast<Jreen::RosterItem::SubscriptionType>(d->store.flags(handle));
 		items << Jreen::RosterItem::Ptr(new Jreen::RosterItem(
-				contact->id(), contact->name(), contact->tags(), contact->subscription()));
+				d->store.id(handle), d->store.name(handle), d->store.tags(handle), s10n));
 	}
 	fillRoster(version, items);
 	d->ignoreChanges = false;
@@ -166,7 +272,10 @@ void JRoster::onItemAdded(QSharedPointer<Jreen::RosterItem> item)
 	JContact *contact = static_cast<JContact*>(JRoster::contact(item->jid(), true));
 	Q_ASSERT(contact);
 	fillContact(contact, item);
-	d->storage->addContact(contact, version());
+	if (d->atLoad)
+		d->addedContacts << contact;
+	else
+		d->storage->addContact(contact, version());
 	if(d->showNotifications) {
 		NotificationRequest request(Notification::System);
 		request.setObject(contact);
@@ -179,9 +288,14 @@ void JRoster::onItemUpdated(QSharedPointer<Jreen::RosterItem> item)
 	Q_D(JRoster);
 	if (d->ignoreChanges)
 		return;
-	if (JContact *contact = d->contacts.value(item->jid())) {
-		fillContact(contact, item);
-		d->storage->updateContact(contact, version());
+	// Storage needs the contact, so changed roster item is materialized
+	if (JContact *contact = d->findContact(item->jid())) {
+		if (!fillContact(contact, item))
+			return;
+		if (d->atLoad)
+			d->updatedContacts << contact;
+		else
+			d->storage->updateContact(contact, version());
 	}
 }
 
@@ -190,10 +304,15 @@ void JRoster::onItemRemoved(const QString &jid)
 	Q_D(JRoster);
 	if (d->ignoreChanges)
 		return;
-	JContact *contact = d->contacts.take(jid);
+	JContact *contact = d->findContact(jid);
 	if(!contact)
 		return;
-	d->storage->removeContact(contact, version());
+	d->contacts.remove(jid);
+	d->store.remove(d->store.find(jid));
+	if (d->atLoad)
+		d->removedContacts << contact;
+	else
+		d->storage->removeContact(contact, version());
 	contact->setContactInList(false);
 	contact->setContactSubscription(Jreen::RosterItem::None);
 	if(d->showNotifications) {
@@ -207,9 +326,16 @@ void JRoster::onItemRemoved(const QString &jid)
 void JRoster::onLoaded(const QList<QSharedPointer<Jreen::RosterItem> > &items)
 {
 	Q_D(JRoster);
+	RosterTransaction transaction(d->account);
 	d->showNotifications = false;
+	d->atLoad = true;
 	AbstractRoster::onLoaded(items);
+	d->atLoad = false;
 	d->showNotifications = true;
+	d->storage->applyDiff(d->account, d->addedContacts, d->updatedContacts, d->removedContacts, version());
+	d->addedContacts.clear();
+	d->updatedContacts.clear();
+	d->removedContacts.clear();
 	d->metaStorage->requestMetaContacts();
 }
 
@@ -224,6 +350,20 @@ JContact *JRoster::createContact(const Jreen::JID &id)
 	return contact;
 }
 
+QString JRoster::intern(const QString &str)
+{
+	Q_D(JRoster);
+	if (str.isEmpty())
+		return str;
+	QSet<QString>::const_iterator it = d->strings.constFind(str);
+	if (it != d->strings.constEnd())
+		return *it;
+	if (d->strings.size() >= MaxInternedStrings)
+		d->strings.clear();
+	d->strings.insert(str);
+	return str;
+}
+
 ChatUnit *JRoster::contact(const Jreen::JID &jid, bool create)
 {
 	Q_D(JRoster);
@@ -231,7 +371,7 @@ ChatUnit *JRoster::contact(const Jreen::JID &jid, bool create)
 	if (bare == d->account->client()->jid().bare())
 		bare = jid.full();
 	QString resourceId = jid.resource();
-	JContact *contact = d->contacts.value(bare);
+	JContact *contact = d->findContact(bare);
 	if (!resourceId.isEmpty()) {
 		if (!contact) {
 			if (create)
@@ -267,15 +407,27 @@ QList<JContactResource *> JRoster::resources() const
 	return result;
 }
 
-void JRoster::fillContact(JContact *contact, QSharedPointer<Jreen::RosterItem> item)
+bool JRoster::fillContact(JContact *contact, QSharedPointer<Jreen::RosterItem> item)
 {
 	QString name = item->name();
-	contact->setContactName(name);
 	QStringList tags = item->groups();
+	const bool changed = contact->name() != name
+			|| contact->tags() != tags
+			|| !contact->isInList()
+			|| contact->subscription() != item->subscription();
+	contact->setContactName(name);
 	contact->setContactTags(tags);
 	if (!contact->isInList())
 		contact->setContactInList(true);
 	contact->setContactSubscription(item->subscription());
+
+	Q_D(JRoster);
+	const ContactStore::Handle handle = d->store.insert(contact->id());
+	d->store.setName(handle, name);
+	d->store.setTags(handle, tags);
+	d->store.setFlags(handle, item->subscription());
+	d->store.setContact(handle, contact);
+	return changed;
 }
 
 void JRoster::handleNewPresence(Jreen::Presence presence)
@@ -303,8 +455,13 @@ void JRoster::handleNewPresence(Jreen::Presence presence)
 		d->account->d_func()->setPresence(presence);
 	else if (self.bare() == from.bare())
 		handleSelfPresence(presence);
-	else if (JContact *c = d->contacts.value(from.bare()))
+	else if (presence.subtype() == Jreen::Presence::Unavailable) {
+		// Not materialized contacts are offline already
+		if (JContact *c = d->contacts.value(from.bare()))
+			c->setStatus(presence);
+	} else if (JContact *c = d->findContact(from.bare())) {
 		c->setStatus(presence);
+	}
 }
 
 void JRoster::handleSelfPresence(Jreen::Presence presence)
@@ -370,18 +527,19 @@ void JRoster::onNewMessage(Jreen::Message message)
 	//temporary
 	ChatUnit *chatUnit = 0;
 	ChatUnit *unitForSession = 0;
-	ChatUnit *muc = d->account->conferenceManager()->muc(message.from().bareJID());
+	const Jreen::JID from = message.from();
+	ChatUnit *muc = d->account->conferenceManager()->muc(from.bareJID());
 	if (muc) {
 		JMUCSession *session = static_cast<JMUCSession*>(muc);
-		chatUnit = session->findParticipant(message.from().resource());
+		chatUnit = session->findParticipant(from.resource());
 		unitForSession = chatUnit;
 	} else {
-		JContact *contact = d->contacts.value(message.from().full());
+		JContact *contact = d->contacts.value(from.full());
 		if (!contact)
-			contact = d->contacts.value(message.from().bare());
-		chatUnit = contact ? JRoster::contact(message.from(), false) : 0;
+			contact = d->findContact(from.bare());
+		chatUnit = contact ? JRoster::contact(from, false) : 0;
 		if (!contact) {
-			contact = static_cast<JContact*>(JRoster::contact(message.from(),true));
+			contact = static_cast<JContact*>(JRoster::contact(from, true));
 			contact->setInList(false);
 			if(Jreen::Nickname::Ptr nick = message.payload<Jreen::Nickname>())
 				contact->setName(nick->nick());
@@ -415,7 +573,10 @@ void JRoster::onMessageDecrypted(ChatUnit *chatUnit, ChatUnit *unitForSession, c
 	else
 		coreMessage.setTime(QDateTime::currentDateTime());
 	coreMessage.setText(message.body());
-	coreMessage.setProperty("subject",message.subject());
+	// Most messages have no subject, don't grow their property map for nothing
+	const QString subject = message.subject();
+	if (!subject.isEmpty())
+		coreMessage.setProperty("subject", subject);
 	coreMessage.setChatUnit(chatUnit);
 	coreMessage.setIncoming(true);
 //	if (message.payload<Jreen::PGPEncrypted>())
@@ -428,7 +589,7 @@ void JRoster::handleSubscription(Jreen::Presence subscription)
 	Q_D(JRoster);
 	QString bare = subscription.from().bare();
 	QString name;
-	JContact *contact = d->contacts.value(bare);
+	JContact *contact = d->findContact(bare);
 	if (contact) {
 		name = contact->name();
 	} else {
@@ -513,8 +674,14 @@ void JRoster::onMetaContactsReceived(const Jreen::MetaContactStorage::ItemList &
 	QSet<QString> removedContacts = QSet<QString>::fromList(d->metacontacts.keys());
 	foreach (const Jreen::MetaContactStorage::Item &item, items) {
 		JContact *contact = d->contacts.value(item.jid().bare());
-        if (!contact)
+        if (!contact) {
+            // Metacontact is applied once lazy contact is materialized
+            if (d->store.find(item.jid().bare()) != ContactStore::InvalidHandle) {
+                removedContacts.remove(item.jid().bare());
+                d->metacontacts.insert(item.jid().bare(), item);
+            }
             continue;
+        }
         MetaContact *metaContact = qobject_cast<MetaContact*>(contact->metaContact());
 		removedContacts.remove(item.jid().bare());
         if (metaContact && metaContact->id() == item.tag())
@@ -526,11 +693,13 @@ void JRoster::onMetaContactsReceived(const Jreen::MetaContactStorage::ItemList &
 		d->metacontacts.insert(contact->id(), item);
     }
 	foreach (const QString &jid, removedContacts) {
+		d->metacontacts.remove(jid);
 		JContact *contact = d->contacts.value(jid);
+		if (!contact)
+			continue;
 		MetaContact *metaContact = qobject_cast<MetaContact*>(contact->metaContact());
 		Q_ASSERT(metaContact);
 		metaContact->removeContact(contact);
-		d->metacontacts.remove(jid);
 	}
 	d->atMetaLoad = false;
 }
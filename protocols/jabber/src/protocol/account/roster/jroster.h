@@ -53,6 +53,8 @@ public:
 	virtual ~JRoster();
 	void loadFromStorage();
 	bool ignoreChanges() const;
+	// Shares equal strings like resource names between contacts
+	QString intern(const QString &str);
 	ChatUnit *contact(const Jreen::JID &id, bool create = false);
 	ChatUnit *selfContact(const QString &id);
 	QList<JContactResource*> resources() const;
@@ -72,7 +74,7 @@ protected:
 	virtual void onItemUpdated(QSharedPointer<Jreen::RosterItem> item);
 	virtual void onItemRemoved(const QString &jid);
 	virtual void onLoaded(const QList<QSharedPointer<Jreen::RosterItem> > &items);
-	void fillContact(JContact *contact, QSharedPointer<Jreen::RosterItem> item);
+	bool fillContact(JContact *contact, QSharedPointer<Jreen::RosterItem> item);
 	void handleSelfPresence(Jreen::Presence presence);
 	void syncMetaContacts();
 protected slots:
@@ -39,6 +39,9 @@
 #include <qutim/json.h>
 #include <jreen/error.h>
 #include <QUrl>
+#include <QDateTime>
+#include <QTimerEvent>
+#include <algorithm>
 
 using namespace qutim_sdk_0_3;
 using namespace gloox;
@@ -54,13 +57,40 @@ QString fromConfigNode(QString node)
 	return node.replace(QLatin1String("%2F"), QChar(QLatin1Char('/')));
 }
 	
-JSoftwareDetection::JSoftwareDetection(JAccount *account) : QObject(account)
+enum {
+	MaxCachedNodes = 2000,
+	CacheSaveDelay = 5000,
+	// Usage time is stored with a day precision to not rewrite the cache
+	// on every login
+	LastUsedPrecision = 24 * 60 * 60
+};
+
+// Capabilities of client versions don't depend on account, so all of
+// them share one cache which keeps least recently seen nodes out
+class JSoftwareCache : public QObject
+{
+public:
+	typedef JSoftwareDetection::SoftwareInfo SoftwareInfo;
+
+	JSoftwareCache();
+	SoftwareInfo *find(const QString &node);
+	void insert(const QString &node, const SoftwareInfo &info);
+	void changed(const QString &node);
+	void sync();
+protected:
+	void timerEvent(QTimerEvent *ev);
+private:
+	void evict();
+	JSoftwareDetection::SoftwareInfoHash m_hash;
+	QSet<QString> m_changed;
+	QSet<QString> m_removed;
+	QBasicTimer m_timer;
+};
+
+Q_GLOBAL_STATIC(JSoftwareCache, softwareCache)
+
+JSoftwareCache::JSoftwareCache()
 {
-	m_account = account;
-	Jreen::Client *client = account->client();
-	connect(client,SIGNAL(presenceReceived(Jreen::Presence)),SLOT(handlePresence(Jreen::Presence)));
-	
-	
 	Config cache(QLatin1String("jabberhash"));
 	cache.beginGroup(QLatin1String("softwareInfo"));
 	foreach (const QString &node, cache.childGroups()) {
@@ -70,43 +100,123 @@ JSoftwareDetection::JSoftwareDetection(JAccount *account) : QObject(account)
 		info.name = cache.value(QLatin1String("name"), QString());
 		info.version = cache.value(QLatin1String("version"), QString());
 		info.os = cache.value(QLatin1String("os"), QString());
-		info.icon = getClientIcon(info.name);
-		info.description = getClientDescription(info.name, info.version, info.os);
+		info.icon = JSoftwareDetection::getClientIcon(info.name);
+		info.description = JSoftwareDetection::getClientDescription(info.name, info.version, info.os);
+		info.finished = cache.value(QLatin1String("finished"), !info.os.isEmpty());
+		info.lastUsed = cache.value(QLatin1String("lastUsed"), 0u);
+		cache.endGroup();
 		if (info.name.isEmpty() && info.version.isEmpty() && node.contains(QLatin1String("qutim.org"))) {
 			// Temporary fix
 			continue;
 		}
-		info.finished = cache.value(QLatin1String("finished"), !info.os.isEmpty());
 		m_hash.insert(fromConfigNode(node), info);
-		cache.endGroup();
 	}
+	if (m_hash.size() > MaxCachedNodes)
+		evict();
 }
 
-JSoftwareDetection::~JSoftwareDetection()
+JSoftwareCache::SoftwareInfo *JSoftwareCache::find(const QString &node)
 {
+	JSoftwareDetection::SoftwareInfoHash::iterator it = m_hash.find(node);
+	if (it == m_hash.end())
+		return 0;
+	const uint now = QDateTime::currentDateTime().toTime_t();
+	if (now - it->lastUsed > LastUsedPrecision) {
+		it->lastUsed = now;
+		changed(node);
+	}
+	return &*it;
 }
 
-// TODO: Move to some singletone
-void JSoftwareDetection::timerEvent(QTimerEvent *ev)
+void JSoftwareCache::insert(const QString &node, const SoftwareInfo &info)
 {
-	if (ev->timerId() == m_timer.timerId()) {
-		m_timer.stop();
-		Config cache(QLatin1String("jabberhash"));
-		cache.beginGroup(QLatin1String("softwareInfo"));
-		for (int i = 0; i < m_recent.size(); i++) {
-			const SoftwareInfo info = m_hash.value(m_recent[i]);
-			cache.beginGroup(toConfigNode(m_recent[i]));
-			cache.setValue(QLatin1String("features"), QStringList(info.features.toList()));
-			cache.setValue(QLatin1String("name"), info.name);
-			cache.setValue(QLatin1String("version"), info.version);
-			cache.setValue(QLatin1String("os"), info.os);
-			cache.setValue(QLatin1String("finished"), info.finished);
-			cache.endGroup();
-		}
-		m_recent.clear();
-	} else {
-		QObject::timerEvent(ev);
+	if (node.isEmpty())
+		return;
+	SoftwareInfo &value = m_hash[node];
+	value = info;
+	value.lastUsed = QDateTime::currentDateTime().toTime_t();
+	m_removed.remove(node);
+	changed(node);
+	if (m_hash.size() > MaxCachedNodes)
+		evict();
+}
+
+void JSoftwareCache::changed(const QString &node)
+{
+	m_changed.insert(node);
+	if (!m_timer.isActive())
+		m_timer.start(CacheSaveDelay, this);
+}
+
+void JSoftwareCache::evict()
+{
+	// Drop a tenth at once, so the scan isn't repeated for every new node
+	QVector<QPair<uint, QString> > nodes;
+	nodes.reserve(m_hash.size());
+	for (JSoftwareDetection::SoftwareInfoHash::const_iterator it = m_hash.constBegin();
+		 it != m_hash.constEnd(); ++it) {
+		nodes << qMakePair(it->lastUsed, it.key());
 	}
+	std::sort(nodes.begin(), nodes.end());
+	const int count = m_hash.size() - MaxCachedNodes * 9 / 10;
+	for (int i = 0; i < count; ++i) {
+		const QString &node = nodes.at(i).second;
+		m_hash.remove(node);
+		m_changed.remove(node);
+		m_removed.insert(node);
+	}
+	if (!m_timer.isActive())
+		m_timer.start(CacheSaveDelay, this);
+}
+
+void JSoftwareCache::sync()
+{
+	m_timer.stop();
+	if (m_changed.isEmpty() && m_removed.isEmpty())
+		return;
+	Config cache(QLatin1String("jabberhash"));
+	cache.beginGroup(QLatin1String("softwareInfo"));
+	foreach (const QString &node, m_removed)
+		cache.remove(toConfigNode(node));
+	foreach (const QString &node, m_changed) {
+		JSoftwareDetection::SoftwareInfoHash::const_iterator it = m_hash.constFind(node);
+		if (it == m_hash.constEnd())
+			continue;
+		const SoftwareInfo &info = *it;
+		cache.beginGroup(toConfigNode(node));
+		cache.setValue(QLatin1String("features"), QStringList(info.features.toList()));
+		cache.setValue(QLatin1String("name"), info.name);
+		cache.setValue(QLatin1String("version"), info.version);
+		cache.setValue(QLatin1String("os"), info.os);
+		cache.setValue(QLatin1String("finished"), info.finished);
+		cache.setValue(QLatin1String("lastUsed"), info.lastUsed);
+		cache.endGroup();
+	}
+	cache.endGroup();
+	m_changed.clear();
+	m_removed.clear();
+}
+
+void JSoftwareCache::timerEvent(QTimerEvent *ev)
+{
+	if (ev->timerId() == m_timer.timerId())
+		sync();
+	else
+		QObject::timerEvent(ev);
+}
+
+JSoftwareDetection::JSoftwareDetection(JAccount *account) : QObject(account)
+{
+	m_account = account;
+	Jreen::Client *client = account->client();
+	connect(client,SIGNAL(presenceReceived(Jreen::Presence)),SLOT(handlePresence(Jreen::Presence)));
+	// Load the cache before the first presence comes
+	softwareCache();
+}
+
+JSoftwareDetection::~JSoftwareDetection()
+{
+	softwareCache()->sync();
 }
 
 void JSoftwareDetection::handlePresence(const Jreen::Presence &presence)
@@ -145,10 +255,8 @@ void JSoftwareDetection::handlePresence(const Jreen::Presence &presence)
 			} else {
 				node = caps->node() + '#' + caps->ver();
 				unit->setProperty("node", node);
-				SoftwareInfoHash::iterator it = m_hash.find(node);
-//				qDebug() << "find from hash" << m_hash.count();
-				if (it != m_hash.end()) {
-					SoftwareInfo &info = *it;
+				if (SoftwareInfo *cached = softwareCache()->find(node)) {
+					SoftwareInfo &info = *cached;
 					resource->setFeatures(info.features);
 //					qDebug() << info.name;
 					if (!info.finished) {
@@ -163,12 +271,25 @@ void JSoftwareDetection::handlePresence(const Jreen::Presence &presence)
 		}
 
 		setClientInfo(resource, "", "unknown-client");
-		Jreen::Disco::Item discoItem(presence.from(), node, QString());
-		Jreen::DiscoReply *reply = m_account->client()->disco()->requestInfo(discoItem);
-		connect(reply, SIGNAL(finished()), SLOT(onInfoRequestFinished()));
+		if (!node.isEmpty()) {
+			// Resources of the same client version announce the same node,
+			// only the first of them is asked
+			QStringList &waiting = m_pendingInfo[node];
+			waiting << jid;
+			if (waiting.size() > 1)
+				return;
+		}
+		requestInfo(presence.from(), node);
 	}
 }
 
+void JSoftwareDetection::requestInfo(const Jreen::JID &jid, const QString &node)
+{
+	Jreen::Disco::Item discoItem(jid, node, QString());
+	Jreen::DiscoReply *reply = m_account->client()->disco()->requestInfo(discoItem);
+	connect(reply, SIGNAL(finished()), SLOT(onInfoRequestFinished()));
+}
+
 void JSoftwareDetection::requestSoftware(const Jreen::JID &jid)
 {
 	Jreen::IQ iq(Jreen::IQ::Get, jid);
@@ -185,11 +306,9 @@ void JSoftwareDetection::onSoftwareRequestFinished(const Jreen::IQ &iq)
 		ChatUnit *unit = m_account->getUnit(iq.from().full(), false);
 		if (JContactResource *resource = qobject_cast<JContactResource*>(unit)) {
 			QString node = resource->property("node").toString();
-			SoftwareInfoHash::iterator it = m_hash.find(node);
-			if (it != m_hash.end()) {
-				SoftwareInfo &info = (*it);
-				info.finished = true;
-				updateCache(node, info, true);
+			if (SoftwareInfo *info = softwareCache()->find(node)) {
+				info->finished = true;
+				softwareCache()->changed(node);
 			}
 		}
 		return;
@@ -204,16 +323,15 @@ void JSoftwareDetection::onSoftwareRequestFinished(const Jreen::IQ &iq)
 			QString icon = getClientIcon(software);;
 			QString client = getClientDescription(software, softwareVersion, os);
 			updateClientData(resource, client, software, softwareVersion, os, icon);
-			SoftwareInfoHash::iterator it = m_hash.find(node);
-			if (it != m_hash.end()) {
-				SoftwareInfo &info = (*it);
+			if (SoftwareInfo *cached = softwareCache()->find(node)) {
+				SoftwareInfo &info = *cached;
 				info.finished = true;
 				info.name = software;
 				info.version = softwareVersion;
 //				info.os = os;
 				info.icon = icon;
 				info.description = client;
-				updateCache(node, info, true);
+				softwareCache()->changed(node);
 			}
 		}
 	}
@@ -224,11 +342,22 @@ void JSoftwareDetection::onInfoRequestFinished()
 	Jreen::DiscoReply *reply = qobject_cast<Jreen::DiscoReply*>(sender());
 	Q_ASSERT(reply);
 	
-	if (reply->error())
-		return;
-	
 	const Jreen::Disco::Item item = reply->item();
-	const QString node = reply->item().node();
+	const QString node = item.node();
+
+	if (reply->error()) {
+		// Try the next resource with the same node, if there is any
+		QHash<QString, QStringList>::iterator it = m_pendingInfo.find(node);
+		if (it != m_pendingInfo.end()) {
+			it->removeOne(item.jid().full());
+			if (it->isEmpty())
+				m_pendingInfo.erase(it);
+			else
+				requestInfo(it->first(), node);
+		}
+		return;
+	}
+
 	const Jreen::DataForm::Ptr form = item.form();
 	const QString jid = item.jid().full();
 
@@ -269,14 +398,20 @@ void JSoftwareDetection::onInfoRequestFinished()
 		}
 	}
 
-	updateCache(node, info);
+	softwareCache()->insert(node, info);
 
-	if (JContactResource *unit = qobject_cast<JContactResource*>(m_account->getUnit(jid, false))) {
+	QStringList jids = m_pendingInfo.take(node);
+	if (!jids.contains(jid))
+		jids << jid;
+	foreach (const QString &resourceJid, jids) {
+		JContactResource *unit = qobject_cast<JContactResource*>(m_account->getUnit(resourceJid, false));
+		if (!unit)
+			continue;
 		if (unit->property("node").isNull())
 			unit->setProperty("node", node);
 
 		if (!info.finished) {
-			requestSoftware(jid);
+			requestSoftware(resourceJid);
 		} else {
 			updateClientData(unit, info.description, info.name, info.version, info.os, info.icon);
 		}
@@ -284,17 +419,6 @@ void JSoftwareDetection::onInfoRequestFinished()
 	}
 }
 
-void JSoftwareDetection::updateCache(const QString &node, const SoftwareInfo &info, bool fixed)
-{
-	if (node.isEmpty())
-		return;
-	if (!fixed)
-		m_hash.insert(node, info);
-	m_recent << node;
-	if (!m_timer.isActive())
-		m_timer.start(5000, this);
-}
-
 void JSoftwareDetection::updateClientData(JContactResource *resource, const QString &client,
 										  const QString &software, const QString &softwareVersion,
 										  const QString &os, const QString &icon)
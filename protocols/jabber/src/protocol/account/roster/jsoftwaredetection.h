@@ -56,7 +56,7 @@ class JSoftwareDetection : public QObject
 public:
 	struct SoftwareInfo
 	{
-		SoftwareInfo() : finished(false) {}
+		SoftwareInfo() : finished(false), lastUsed(0) {}
 		QSet<QString> features;
 		QString name;
 		QString version;
@@ -64,32 +64,31 @@ public:
 		QString icon;
 		QString description;
 		bool finished;
+		uint lastUsed;
 	};
 	typedef QHash<QString, SoftwareInfo> SoftwareInfoHash;
 
 	JSoftwareDetection(JAccount *account);
 	~JSoftwareDetection();
 	
-protected:
-	void timerEvent(QTimerEvent *ev);
 protected slots:
 	void handlePresence(const Jreen::Presence &presence);
 	void onSoftwareRequestFinished(const Jreen::IQ &iq);
 	void onInfoRequestFinished();
 private:
 	void requestSoftware(const Jreen::JID &jid);
-	void updateCache(const QString &node, const SoftwareInfo &info, bool fixed = false);
+	void requestInfo(const Jreen::JID &jid, const QString &node);
 	void updateClientData(JContactResource *resource, const QString &client,
 						  const QString &software, const QString &softwareVersion,
 						  const QString &os, const QString &clientIcon);
 	void setClientInfo(JContactResource *resource, const QString &client, const QString &clientIcon);
-	QString getClientDescription(const QString &software, const QString &softwareVersion, const QString &os);
-	QString getClientIcon(const QString &software);
+	static QString getClientDescription(const QString &software, const QString &softwareVersion, const QString &os);
+	static QString getClientIcon(const QString &software);
 private:
+	friend class JSoftwareCache;
 	JAccount *m_account;
-	QHash<QString, SoftwareInfo> m_hash;
-	QStringList m_recent;
-	QBasicTimer m_timer;
+	// Resources waiting for disco#info of the same caps node
+	QHash<QString, QStringList> m_pendingInfo;
 };
 }
 
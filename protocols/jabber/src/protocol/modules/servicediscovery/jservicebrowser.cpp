@@ -24,8 +24,8 @@
 ****************************************************************************/
 #include <QMovie>
 #include <QStringBuilder>
-#include <QObjectCleanupHandler>
 #include "jservicebrowser.h"
+#include "jservicemodel.h"
 #include "ui_jservicebrowser.h"
 // qutIM
 #include <qutim/iconloader.h>
@@ -43,7 +43,6 @@
 namespace Jabber
 {
 using namespace qutim_sdk_0_3;
-enum { ItemRole = Qt::UserRole + 1};
 
 JServiceBrowserModule::JServiceBrowserModule()
 {
@@ -70,12 +69,10 @@ void JServiceBrowserModule::showWindow()
 struct JServiceBrowserPrivate
 {
 	Account *account;
-	Jreen::Disco *disco;
-	QObjectCleanupHandler cleanupHandler;
+	JServiceModel *model;
 	Ui::ServiceBrowser *ui;
 	QMenu *contextMenu;
 	bool isConference;
-	int searchCount;
 	bool showFeatures;
 	Jreen::Disco::Item currentMenuItem;
 };
@@ -84,13 +81,17 @@ JServiceBrowser::JServiceBrowser(Account *account, bool isConference, QWidget *p
 	: QWidget(parent), p(new JServiceBrowserPrivate)
 {
 	Jreen::Client *client = qobject_cast<Jreen::Client*>(account->property("client"));
-	p->disco = client->disco();
 	p->account = account;
 	p->isConference = isConference; //WTF ? Oo
-	p->searchCount = 0;
+	p->model = new JServiceModel(account, client->disco(), this);
+	p->model->setConferenceMode(isConference);
 	p->ui = new Ui::ServiceBrowser();
 	p->contextMenu = new QMenu();
 	p->ui->setupUi(this);
+	// Rows of huge conference lists are laid out only when they are shown
+	p->ui->serviceTree->setUniformRowHeights(true);
+	p->ui->serviceTree->setModel(p->model);
+	connect(p->model, SIGNAL(pendingCountChanged(int)), SLOT(onPendingCountChanged(int)));
 	setWindowTitle(tr("Search service"));
 	p->ui->serviceServer->installEventFilter(this);
 	p->ui->serviceServer->setDuplicatesEnabled(false);
@@ -108,13 +109,12 @@ JServiceBrowser::JServiceBrowser(Account *account, bool isConference, QWidget *p
 	connect(p->ui->actionExecute, SIGNAL(triggered()), this, SLOT(onExecute()));
 	connect(p->ui->actionJoin, SIGNAL(triggered()), this, SLOT(onJoin()));
 	connect(p->ui->actionAdd, SIGNAL(triggered()), this, SLOT(onAddToRoster()));
-	connect(p->ui->serviceTree, SIGNAL(itemExpanded(QTreeWidgetItem*)),
-			SLOT(getItems(QTreeWidgetItem*)));
 	connect(p->ui->filterLine, SIGNAL(textEdited(const QString&)),
 			SLOT(filterItem(const QString&)));
 	connect(p->ui->serviceTree, SIGNAL(customContextMenuRequested(QPoint)),
 			SLOT(showContextMenu(QPoint)));
-	connect(p->ui->serviceTree, SIGNAL(itemSelectionChanged()), SLOT(showFeatures()));
+	connect(p->ui->serviceTree->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)),
+			SLOT(showFeatures()));
 	p->ui->serviceTree->setColumnWidth(0, p->ui->serviceTree->width());
 	/*QMovie *movie = new QMovie(p->ui->labelLoader);
   movie->setFileName("loader");
@@ -147,138 +147,16 @@ void JServiceBrowser::searchServer(const QString &server)
 	on_searchButton_clicked();
 }
 
-void JServiceBrowser::getInfo(QTreeWidgetItem *item)
+void JServiceBrowser::onPendingCountChanged(int count)
 {
-	Jreen::Disco::Item di = item->data(0, ItemRole).value<Jreen::Disco::Item>();
-	Jreen::DiscoReply *reply = p->disco->requestInfo(di);
-	reply->setProperty("item", qVariantFromValue(item));
-	p->cleanupHandler.add(reply);
-	connect(reply, SIGNAL(infoReceived(Jreen::Disco::Item)),
-	        SLOT(onInfoReceived(Jreen::Disco::Item)));
-	connect(reply, SIGNAL(error(Jreen::Error::Ptr)),
-	        SLOT(onError(Jreen::Error::Ptr)));
-	p->searchCount++;
-	p->ui->labelLoader->setVisible(true);
-}
-
-void JServiceBrowser::getItems(QTreeWidgetItem *item)
-{
-	Jreen::Disco::Item di = item->data(0, ItemRole).value<Jreen::Disco::Item>();
-	if (!item->childCount() && (di.actions() & Jreen::Disco::Item::ActionExpand)) {
-		Jreen::DiscoReply *reply = p->disco->requestItems(di);
-		reply->setProperty("item", qVariantFromValue(item));
-		p->cleanupHandler.add(reply);
-		connect(reply, SIGNAL(itemsReceived(Jreen::Disco::ItemList)),
-		        SLOT(onItemsReceived(Jreen::Disco::ItemList)));
-		connect(reply, SIGNAL(error(Jreen::Error::Ptr)),
-		        SLOT(onError(Jreen::Error::Ptr)));
-	}
-}
-
-void JServiceBrowser::onInfoReceived(const Jreen::Disco::Item &di)
-{
-	QTreeWidgetItem *item = sender()->property("item").value<QTreeWidgetItem*>();
-	Q_ASSERT(item);
-	item->setData(0, ItemRole, qVariantFromValue(di));
-	if (p->isConference && (di.hasIdentity("conference") || di.hasIdentity("server")))
-		item->setHidden(false);
-	if (!di.name().isEmpty())
-		item->setText(0, di.name());
-	else
-		item->setText(0, di.jid());
-	item->setIcon(0, Icon(serviceIcon(di)));
-	QString tooltip;
-	tooltip = QLatin1Literal("<b>") % di.name() % QLatin1Literal("</b> (")
-			% di.jid().full() % QLatin1Literal(")<br/>");
-	QString type = tr("type: ");
-	QString category = tr("category: ");
-	if (!di.identities().isEmpty()) {
-		tooltip += QLatin1Literal("<br/><b>") % tr("Identities:") % QLatin1Literal("</b><br/>");
-		foreach(Jreen::Disco::Identity identity, di.identities()) {
-			Jreen::Disco::Item tmp;
-			tmp.setJid(tmp.jid());
-			tmp.addIdentity(identity);
-			QString img = IconLoader::iconPath(serviceIcon(tmp), 16);
-			tooltip += QLatin1Literal("<img src='") % img % QLatin1Literal("'> ")
-					% identity.name() % QLatin1Literal(" (") % category
-					% identity.category() % QLatin1Literal(", ") % type
-					% identity.type() % QLatin1Literal(")<br/>");
-		}
-	}
-	item->setToolTip(0, tooltip);
-	if (di.actions() & Jreen::Disco::Item::ActionExpand)
-		item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-	QTreeWidgetItem *parent = item->parent();
-	if (parent && parent->isHidden()) {
-		if (item->text(0).contains(p->ui->filterLine->text(), Qt::CaseInsensitive)) {
-			QList<QTreeWidgetItem*> items;
-			items << item;
-			setBranchVisible(items);
-		} else {
-			item->setHidden(true);
-		}
-	}
-	if (!--p->searchCount)
-		p->ui->labelLoader->setVisible(false);
-}
-
-void JServiceBrowser::onItemsReceived(const Jreen::Disco::ItemList &items)
-{
-	QTreeWidgetItem *parentItem = sender()->property("item").value<QTreeWidgetItem*>();
-	Q_ASSERT(parentItem);
-	if (!parentItem || parentItem->childCount())
-		return;
-	if (items.isEmpty())
-		parentItem->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicator);
-	foreach (const Jreen::Disco::Item &di, items) {
-		QTreeWidgetItem *item = new QTreeWidgetItem(parentItem);
-		if (p->isConference)
-			item->setHidden(true);
-		if (!di.name().isEmpty())
-			item->setText(0, di.name());
-		else
-			item->setText(0, di.jid());
-		item->setExpanded(false);
-		item->setData(0, ItemRole, qVariantFromValue(di));
-		getInfo(item);
-	}
-	parentItem->setExpanded(true);
-}
-
-void JServiceBrowser::onError(const Jreen::Error::Ptr &error)
-{
-	QTreeWidgetItem *item = sender()->property("item").value<QTreeWidgetItem*>();
-	Q_ASSERT(item);
-	item->setDisabled(true);
-	item->setToolTip(0, item->toolTip(0) + error->conditionText());
-	if (!--p->searchCount)
-		p->ui->labelLoader->setVisible(false);
-}
-
-void clean_item(QTreeWidgetItem *item)
-{
-	for (int i = item->childCount(); i < 0; i--) {
-		QTreeWidgetItem *child = item->child(0);
-		clean_item(child);
-		item->removeChild(child);
-		delete child;
-	}
+	p->ui->labelLoader->setVisible(count > 0);
 }
 
 void JServiceBrowser::on_searchButton_clicked()
 {
 	disconnect(p->ui->serviceServer, SIGNAL(currentIndexChanged(int)), this, SLOT(on_searchButton_clicked()));
-	p->searchCount = 0;
-	clean_item(p->ui->serviceTree->invisibleRootItem());
-	p->ui->serviceTree->clear();
-	p->cleanupHandler.clear();
 	QString server(p->ui->serviceServer->currentText());
-	QTreeWidgetItem *item = new QTreeWidgetItem(p->ui->serviceTree);
-	item->setText(0, server);
-	Jreen::Disco::Item di;
-	di.setJid(p->ui->serviceServer->currentText());
-	item->setData(0, ItemRole, qVariantFromValue(di));
-	getInfo(item);
+	p->model->setServer(server);
 	p->ui->serviceServer->removeItem(p->ui->serviceServer->findText(server));
 	p->ui->serviceServer->insertItem(0, server);
 	p->ui->serviceServer->setCurrentIndex(0);
@@ -294,10 +172,10 @@ void JServiceBrowser::on_searchButton_clicked()
 void JServiceBrowser::showContextMenu(const QPoint &pos)
 {
 	p->contextMenu->clear();
-	QTreeWidgetItem *item = p->ui->serviceTree->itemAt(pos);
-	if (!item)
+	const QModelIndex index = p->ui->serviceTree->indexAt(pos);
+	if (!index.isValid())
 		return;
-	Jreen::Disco::Item di = item->data(0, ItemRole).value<Jreen::Disco::Item>();
+	Jreen::Disco::Item di = p->model->item(index);
 	p->currentMenuItem = di;
 	if (di.actions() & Jreen::Disco::Item::ActionJoin)
 		p->contextMenu->addAction(p->ui->actionJoin);
@@ -336,11 +214,10 @@ bool JServiceBrowser::eventFilter(QObject *obj, QEvent *event)
 
 void JServiceBrowser::showFeatures()
 {
-	QTreeWidgetItem *item = !p->ui->serviceTree->selectedItems().isEmpty()
-			? p->ui->serviceTree->selectedItems().first() : 0;
-	if (!item)
+	const QModelIndexList indexes = p->ui->serviceTree->selectionModel()->selectedIndexes();
+	if (indexes.isEmpty())
 		return;
-	Jreen::Disco::Item di = item->data(0, ItemRole).value<Jreen::Disco::Item>();
+	Jreen::Disco::Item di = p->model->item(indexes.first());
 	QString featuresText;
 	if (!di.features().isEmpty()) {
 		featuresText = QLatin1Literal("<b>") % tr("Features:") % QLatin1Literal("</b><br/>");
@@ -352,44 +229,6 @@ void JServiceBrowser::showFeatures()
 	p->ui->featuresView->setHtml(featuresText);
 }
 
-QString JServiceBrowser::serviceIcon(const Jreen::Disco::Item &di)
-{
-	if (di.identities().isEmpty())
-		return QString();
-	QString service_icon;
-	if (di.hasIdentity("server")) {
-		service_icon = "network-server";
-	} else if (di.hasIdentity("conference", "text")) {
-		if (Jreen::JID(di.jid()).node().isEmpty())
-			service_icon = "conference-server";
-		else if (Jreen::JID(di.jid()).resource().isEmpty())
-			service_icon = "conference";
-		else
-			service_icon = "conference-user";
-	} else if (di.hasIdentity("conference", "irc")) {
-		service_icon = "im-irc-gateway";
-	} else if (di.hasIdentity("gateway", "icq")) {
-		service_icon = "im-icq-gateway";
-	} else if (di.hasIdentity("gateway", "aim")) {
-		service_icon = "im-aim-gateway";
-	} else if (di.hasIdentity("gateway", "mrim")) {
-		service_icon = "im-mrim-gateway";
-	} else if (di.hasIdentity("gateway", "msn")) {
-		service_icon = "im-msn-gateway";
-	} else if (di.hasIdentity("gateway", "xmpp")) {
-		service_icon = "im-jabber-gateway";
-	} else if (di.hasIdentity("gateway")) {
-		service_icon = "im-default-gateway";
-	} else if (di.hasIdentity("directory")) {
-		service_icon = "edit-find-user";
-	} else if (di.hasIdentity("automation")) {
-		service_icon = "utilities-terminal";
-	} else {
-		service_icon = "defaultservice";
-	}
-	return service_icon;
-}
-
 /*void JServiceBrowser::on_registerButton_clicked()
  {
   QTreeWidgetItem *item = p->ui->serviceTree->currentItem();
@@ -426,56 +265,13 @@ QString JServiceBrowser::serviceIcon(const Jreen::Disco::Item &di)
 
 void JServiceBrowser::filterItem(const QString &mask)
 {
-	Q_UNUSED(mask);
-	setItemVisible(p->ui->serviceTree->invisibleRootItem(), true);
-	QList<QTreeWidgetItem*> visibleItems;
-	visibleItems = findItems(p->ui->serviceTree->invisibleRootItem(), p->ui->filterLine->text());
-	setBranchVisible(visibleItems);
-}
-
-void JServiceBrowser::setBranchVisible(QList<QTreeWidgetItem*> items)
-{
-	int count = items.count();
-	int num = 0;
-	while (num < count) {
-		QTreeWidgetItem *item = items[num]->parent();
-		if (item && !items.contains(item)) {
-			items.append(item);
-			count++;
-		}
-		num++;
-	}
-	foreach(QTreeWidgetItem* item, items)
-		item->setHidden(false);
-}
-
-QList<QTreeWidgetItem*> JServiceBrowser::findItems(QTreeWidgetItem *item, const QString &text)
-{
-	QList<QTreeWidgetItem*> list;
-	int count = item->childCount();
-	for (int pos = 0; pos < count; pos++) {
-		if (text.isEmpty() || item->child(pos)->text(0).contains(text, Qt::CaseInsensitive)) {
-			list << item->child(pos);
-			list << findItems(item->child(pos), "");
-		} else if (item->child(pos)->childCount()) {
-			list << findItems(item->child(pos), text);
-		}
-	}
-	return list;
-}
-
-void JServiceBrowser::setItemVisible(QTreeWidgetItem *item, bool visibility)
-{
-	item->setHidden(visibility);
-	int count = item->childCount();
-	for (int pos = 0; pos < count; pos++)
-		setItemVisible(item->child(pos), visibility);
+	p->model->setFilter(mask);
 }
 
 void JServiceBrowser::on_clearButton_clicked()
 {
 	p->ui->filterLine->clear();
-	filterItem("");
+	filterItem(QString());
 }
 
 void JServiceBrowser::onExecute()
@@ -26,7 +26,6 @@
 #define JSERVICEBROWSER_H
 
 #include <QWidget>
-#include <QTreeWidgetItem>
 #include <QKeyEvent>
 #include <qutim/icon.h>
 #include "../../../sdk/jabber.h"
@@ -61,7 +60,6 @@ public:
 	JServiceBrowser(qutim_sdk_0_3::Account *account, bool isConference = false, QWidget *parent = 0);
 	~JServiceBrowser();
 private slots:
-	void getItems(QTreeWidgetItem *item);
 	void showContextMenu(const QPoint &pos);
 	void showFeatures();
 	void filterItem(const QString &mask);
@@ -71,9 +69,7 @@ private slots:
 	void onExecute();
 	void onJoin();
 	void onAddToRoster();
-	void onInfoReceived(const Jreen::Disco::Item &item);
-	void onItemsReceived(const Jreen::Disco::ItemList &items);
-	void onError(const Jreen::Error::Ptr &error);
+	void onPendingCountChanged(int count);
 	/*void on_registerButton_clicked();
    void on_searchFormButton_clicked();
    void on_executeButton_clicked();
@@ -82,11 +78,6 @@ private slots:
 protected:
 	bool eventFilter(QObject *obj, QEvent *event);
 	void searchServer(const QString &server);
-	void getInfo(QTreeWidgetItem *item);
-	void setItemVisible(QTreeWidgetItem *item, bool visibility);
-	QList<QTreeWidgetItem *> findItems(QTreeWidgetItem *item, const QString &text);
-	void setBranchVisible(QList<QTreeWidgetItem *> items);
-	QString serviceIcon(const Jreen::Disco::Item &di);
 private:
 	QScopedPointer<JServiceBrowserPrivate> p;
 signals:
@@ -100,7 +91,5 @@ signals:
 };
 }
 
-Q_DECLARE_METATYPE(QTreeWidgetItem*)
-
 #endif // JSERVICEBROWSER_H
 
@@ -0,0 +1,582 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jservicemodel.h"
+#include <QCache>
+#include <QDateTime>
+#include <QStringBuilder>
+#include <QTimerEvent>
+#include <QCoreApplication>
+#include <qutim/account.h>
+#include <qutim/icon.h>
+#include <qutim/iconloader.h>
+
+namespace Jabber
+{
+using namespace qutim_sdk_0_3;
+
+enum {
+	MaxOutstandingRequests = 8,
+	MaxQueuedRequests = 256,
+	// Seconds while disco results are reused by other browser windows
+	CacheTimeout = 10 * 60
+};
+
+struct JServiceNode
+{
+	enum State { None, Queued, Requested, Received, Failed };
+
+	JServiceNode(const Jreen::Disco::Item &item, JServiceNode *parent, int index)
+		: item(item), parent(parent), index(index), row(-1), info(None), items(None), matches(true)
+	{
+		updateText();
+	}
+	~JServiceNode() { qDeleteAll(children); }
+
+	void updateText()
+	{
+		text = (item.name().isEmpty() ? item.jid().full() : item.name()).toCaseFolded();
+	}
+
+	Jreen::Disco::Item item;
+	JServiceNode *parent;
+	QVector<JServiceNode*> children;
+	// Children shown by the filter, ordered by index
+	QVector<JServiceNode*> visible;
+	// Position in parent's children and visible lists
+	int index;
+	int row;
+	// Case folded name used by the filter
+	QString text;
+	QString error;
+	State info;
+	State items;
+	// Node or any of its descendants contains the filter
+	bool matches;
+};
+
+struct JDiscoCache
+{
+	JDiscoCache() : infos(20000), items(50000) {}
+
+	struct Info
+	{
+		Jreen::Disco::Item item;
+		QDateTime received;
+	};
+	struct Items
+	{
+		Jreen::Disco::ItemList items;
+		QDateTime received;
+	};
+
+	QCache<QString, Info> infos;
+	// Cost is the number of items
+	QCache<QString, Items> items;
+};
+
+Q_GLOBAL_STATIC(JDiscoCache, discoCache)
+
+template <typename T>
+static T *freshEntry(QCache<QString, T> &cache, const QString &key)
+{
+	T *entry = cache.object(key);
+	if (entry && entry->received.secsTo(QDateTime::currentDateTimeUtc()) < CacheTimeout)
+		return entry;
+	return 0;
+}
+
+static bool rowLessThan(const JServiceNode *node, int index)
+{
+	return node->index < index;
+}
+
+JServiceModel::JServiceModel(Account *account, Jreen::Disco *disco, QObject *parent)
+	: QAbstractItemModel(parent), m_account(account), m_disco(disco),
+	  m_root(new JServiceNode(Jreen::Disco::Item(), 0, 0)), m_conferenceMode(false)
+{
+}
+
+JServiceModel::~JServiceModel()
+{
+	qDeleteAll(m_replies.keys());
+	delete m_root;
+}
+
+void JServiceModel::setConferenceMode(bool conferenceMode)
+{
+	m_conferenceMode = conferenceMode;
+}
+
+void JServiceModel::clear()
+{
+	qDeleteAll(m_replies.keys());
+	m_replies.clear();
+	m_queue.clear();
+	m_queueTimer.stop();
+	delete m_root;
+	m_root = new JServiceNode(Jreen::Disco::Item(), 0, 0);
+}
+
+void JServiceModel::setServer(const QString &server)
+{
+	beginResetModel();
+	clear();
+	Jreen::Disco::Item item;
+	item.setJid(server);
+	JServiceNode *node = new JServiceNode(item, m_root, 0);
+	m_root->children << node;
+	filterNode(m_root, false, false);
+	endResetModel();
+	queueInfo(node);
+	emit pendingCountChanged(pendingCount());
+}
+
+void JServiceModel::setFilter(const QString &filter)
+{
+	const QString folded = filter.toCaseFolded();
+	if (folded == m_filter)
+		return;
+	// Longer filter can only hide rows, so subtrees without matches are skipped
+	const bool narrowing = folded.contains(m_filter);
+	m_filter = folded;
+	refilter(narrowing);
+}
+
+Jreen::Disco::Item JServiceModel::item(const QModelIndex &index) const
+{
+	JServiceNode *node = this->node(index);
+	return node ? node->item : Jreen::Disco::Item();
+}
+
+JServiceNode *JServiceModel::node(const QModelIndex &index) const
+{
+	return index.isValid() ? static_cast<JServiceNode*>(index.internalPointer()) : 0;
+}
+
+QModelIndex JServiceModel::indexOf(JServiceNode *node) const
+{
+	if (!node || node == m_root)
+		return QModelIndex();
+	for (JServiceNode *it = node; it != m_root; it = it->parent) {
+		if (!isListed(it))
+			return QModelIndex();
+	}
+	return createIndex(node->row, 0, node);
+}
+
+bool JServiceModel::isListed(JServiceNode *node) const
+{
+	const QVector<JServiceNode*> &visible = node->parent->visible;
+	return node->row >= 0 && node->row < visible.size() && visible.at(node->row) == node;
+}
+
+bool JServiceModel::isShown(JServiceNode *node) const
+{
+	if (!m_conferenceMode || node->parent == m_root)
+		return true;
+	return node->info == JServiceNode::Received
+	        && (node->item.hasIdentity(QLatin1String("conference"))
+	            || node->item.hasIdentity(QLatin1String("server")));
+}
+
+bool JServiceModel::isIncluded(JServiceNode *node) const
+{
+	// Descendants of matched items are shown too
+	if (m_filter.isEmpty())
+		return true;
+	for (; node != m_root; node = node->parent) {
+		if (node->text.contains(m_filter))
+			return true;
+	}
+	return false;
+}
+
+bool JServiceModel::filterNode(JServiceNode *node, bool included, bool narrowing)
+{
+	bool matches = m_filter.isEmpty() || (node != m_root && node->text.contains(m_filter));
+	included = included || matches;
+	node->visible.clear();
+	foreach (JServiceNode *child, node->children) {
+		bool childMatches = false;
+		if (!narrowing || child->matches || included)
+			childMatches = filterNode(child, included, narrowing);
+		else
+			child->matches = false;
+		matches = matches || childMatches;
+		if ((included || childMatches) && isShown(child)) {
+			child->row = node->visible.size();
+			node->visible << child;
+		}
+	}
+	node->matches = matches;
+	return matches;
+}
+
+void JServiceModel::refilter(bool narrowing)
+{
+	// Layout change keeps expanded and selected rows of the view
+	emit layoutAboutToBeChanged();
+	const QModelIndexList from = persistentIndexList();
+	QVector<JServiceNode*> nodes;
+	nodes.reserve(from.size());
+	foreach (const QModelIndex &index, from)
+		nodes << node(index);
+	filterNode(m_root, false, narrowing);
+	QModelIndexList to;
+	foreach (JServiceNode *node, nodes)
+		to << indexOf(node);
+	changePersistentIndexList(from, to);
+	emit layoutChanged();
+}
+
+QModelIndex JServiceModel::index(int row, int column, const QModelIndex &parent) const
+{
+	JServiceNode *parentNode = parent.isValid() ? node(parent) : m_root;
+	if (column != 0 || row < 0 || row >= parentNode->visible.size())
+		return QModelIndex();
+	return createIndex(row, 0, parentNode->visible.at(row));
+}
+
+QModelIndex JServiceModel::parent(const QModelIndex &index) const
+{
+	JServiceNode *node = this->node(index);
+	if (!node || node->parent == m_root)
+		return QModelIndex();
+	return createIndex(node->parent->row, 0, node->parent);
+}
+
+int JServiceModel::rowCount(const QModelIndex &parent) const
+{
+	if (parent.column() > 0)
+		return 0;
+	JServiceNode *parentNode = parent.isValid() ? node(parent) : m_root;
+	return parentNode->visible.size();
+}
+
+int JServiceModel::columnCount(const QModelIndex &parent) const
+{
+	Q_UNUSED(parent);
+	return 1;
+}
+
+bool JServiceModel::hasChildren(const QModelIndex &parent) const
+{
+	JServiceNode *parentNode = parent.isValid() ? node(parent) : m_root;
+	if (parentNode == m_root || parentNode->items == JServiceNode::Received)
+		return !parentNode->visible.isEmpty();
+	return parentNode->item.actions() & Jreen::Disco::Item::ActionExpand;
+}
+
+bool JServiceModel::canFetchMore(const QModelIndex &parent) const
+{
+	JServiceNode *parentNode = node(parent);
+	return parentNode && parentNode->items == JServiceNode::None
+	        && (parentNode->item.actions() & Jreen::Disco::Item::ActionExpand);
+}
+
+void JServiceModel::fetchMore(const QModelIndex &parent)
+{
+	JServiceNode *parentNode = node(parent);
+	if (!canFetchMore(parent))
+		return;
+	if (JDiscoCache::Items *cached = freshEntry(discoCache()->items, cacheKey(parentNode->item))) {
+		setItems(parentNode, cached->items);
+		return;
+	}
+	parentNode->items = JServiceNode::Requested;
+	Jreen::DiscoReply *reply = m_disco->requestItems(parentNode->item);
+	m_replies.insert(reply, parentNode);
+	connect(reply, SIGNAL(itemsReceived(Jreen::Disco::ItemList)),
+	        SLOT(onItemsReceived(Jreen::Disco::ItemList)));
+	connect(reply, SIGNAL(error(Jreen::Error::Ptr)),
+	        SLOT(onError(Jreen::Error::Ptr)));
+	emit pendingCountChanged(pendingCount());
+}
+
+QVariant JServiceModel::data(const QModelIndex &index, int role) const
+{
+	JServiceNode *node = this->node(index);
+	if (!node)
+		return QVariant();
+	// Rows are asked for data only while they are painted
+	if (node->info == JServiceNode::None)
+		queueInfo(node);
+	const Jreen::Disco::Item &di = node->item;
+	switch (role) {
+	case Qt::DisplayRole:
+		return di.name().isEmpty() ? di.jid().full() : di.name();
+	case Qt::DecorationRole:
+		return node->info == JServiceNode::Received ? Icon(serviceIcon(di)) : QVariant();
+	case ItemRole:
+		return qVariantFromValue(di);
+	case Qt::ToolTipRole: {
+		QString tooltip;
+		tooltip = QLatin1Literal("<b>") % di.name() % QLatin1Literal("</b> (")
+		        % di.jid().full() % QLatin1Literal(")<br/>");
+		const QString type = QCoreApplication::translate("Jabber::JServiceBrowser", "type: ");
+		const QString category = QCoreApplication::translate("Jabber::JServiceBrowser", "category: ");
+		if (!di.identities().isEmpty()) {
+			tooltip += QLatin1Literal("<br/><b>")
+			        % QCoreApplication::translate("Jabber::JServiceBrowser", "Identities:")
+			        % QLatin1Literal("</b><br/>");
+			foreach (const Jreen::Disco::Identity &identity, di.identities()) {
+				Jreen::Disco::Item tmp;
+				tmp.setJid(di.jid());
+				tmp.addIdentity(identity);
+				QString img = IconLoader::iconPath(serviceIcon(tmp), 16);
+				tooltip += QLatin1Literal("<img src='") % img % QLatin1Literal("'> ")
+				        % identity.name() % QLatin1Literal(" (") % category
+				        % identity.category() % QLatin1Literal(", ") % type
+				        % identity.type() % QLatin1Literal(")<br/>");
+			}
+		}
+		return tooltip + node->error;
+	}
+	default:
+		return QVariant();
+	}
+}
+
+Qt::ItemFlags JServiceModel::flags(const QModelIndex &index) const
+{
+	JServiceNode *node = this->node(index);
+	if (!node)
+		return Qt::NoItemFlags;
+	if (node->info == JServiceNode::Failed || node->items == JServiceNode::Failed)
+		return Qt::NoItemFlags;
+	return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+QString JServiceModel::cacheKey(const Jreen::Disco::Item &item) const
+{
+	return m_account->id() % QLatin1Char('\n') % item.jid().full()
+	        % QLatin1Char('\n') % item.node();
+}
+
+void JServiceModel::queueInfo(JServiceNode *node) const
+{
+	node->info = JServiceNode::Queued;
+	m_queue << node;
+	// Rows scrolled away long ago are forgotten and queued again when shown
+	if (m_queue.size() > MaxQueuedRequests)
+		m_queue.takeFirst()->info = JServiceNode::None;
+	if (!m_queueTimer.isActive())
+		m_queueTimer.start(0, const_cast<JServiceModel*>(this));
+}
+
+void JServiceModel::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_queueTimer.timerId()) {
+		m_queueTimer.stop();
+		processQueue();
+		return;
+	}
+	QAbstractItemModel::timerEvent(event);
+}
+
+void JServiceModel::processQueue()
+{
+	while (!m_queue.isEmpty() && m_replies.size() < MaxOutstandingRequests) {
+		JServiceNode *node = m_queue.takeLast();
+		if (JDiscoCache::Info *cached = freshEntry(discoCache()->infos, cacheKey(node->item))) {
+			setInfo(node, cached->item);
+			continue;
+		}
+		node->info = JServiceNode::Requested;
+		Jreen::DiscoReply *reply = m_disco->requestInfo(node->item);
+		m_replies.insert(reply, node);
+		connect(reply, SIGNAL(infoReceived(Jreen::Disco::Item)),
+		        SLOT(onInfoReceived(Jreen::Disco::Item)));
+		connect(reply, SIGNAL(error(Jreen::Error::Ptr)),
+		        SLOT(onError(Jreen::Error::Ptr)));
+	}
+	emit pendingCountChanged(pendingCount());
+}
+
+void JServiceModel::onInfoReceived(const Jreen::Disco::Item &item)
+{
+	Jreen::DiscoReply *reply = static_cast<Jreen::DiscoReply*>(sender());
+	reply->deleteLater();
+	JServiceNode *node = m_replies.take(reply);
+	if (!node)
+		return;
+	JDiscoCache::Info *cached = new JDiscoCache::Info;
+	cached->item = item;
+	cached->received = QDateTime::currentDateTimeUtc();
+	discoCache()->infos.insert(cacheKey(node->item), cached);
+	setInfo(node, item);
+	processQueue();
+}
+
+void JServiceModel::setInfo(JServiceNode *node, const Jreen::Disco::Item &info)
+{
+	const QString name = node->item.name();
+	node->item = info;
+	if (info.name().isEmpty())
+		node->item.setName(name);
+	node->updateText();
+	node->info = JServiceNode::Received;
+	const QModelIndex index = indexOf(node);
+	if (index.isValid()) {
+		emit dataChanged(index, index);
+	} else if (!isListed(node) && isShown(node) && isIncluded(node)) {
+		// Conference became known or new name matches the filter
+		showNode(node);
+	}
+}
+
+void JServiceModel::showNode(JServiceNode *node)
+{
+	JServiceNode *parent = node->parent;
+	const QModelIndex parentIndex = indexOf(parent);
+	if (parent != m_root && !parentIndex.isValid()) {
+		// Whole branch has to appear, it's simpler to filter it again
+		refilter(false);
+		return;
+	}
+	QVector<JServiceNode*> &visible = parent->visible;
+	const int row = qLowerBound(visible.begin(), visible.end(), node->index, rowLessThan) - visible.begin();
+	beginInsertRows(parentIndex, row, row);
+	visible.insert(row, node);
+	for (int i = row; i < visible.size(); ++i)
+		visible.at(i)->row = i;
+	filterNode(node, isIncluded(node), false);
+	endInsertRows();
+}
+
+void JServiceModel::onItemsReceived(const Jreen::Disco::ItemList &items)
+{
+	Jreen::DiscoReply *reply = static_cast<Jreen::DiscoReply*>(sender());
+	reply->deleteLater();
+	JServiceNode *node = m_replies.take(reply);
+	if (!node)
+		return;
+	JDiscoCache::Items *cached = new JDiscoCache::Items;
+	cached->items = items;
+	cached->received = QDateTime::currentDateTimeUtc();
+	discoCache()->items.insert(cacheKey(node->item), cached, qMax(1, items.size()));
+	setItems(node, items);
+	processQueue();
+}
+
+void JServiceModel::setItems(JServiceNode *node, const Jreen::Disco::ItemList &items)
+{
+	node->items = JServiceNode::Received;
+	node->children.reserve(items.size());
+	for (int i = 0; i < items.size(); ++i)
+		node->children << new JServiceNode(items.at(i), node, i);
+
+	// Only children of the expanded item are filtered
+	const bool included = isIncluded(node);
+	QVector<JServiceNode*> visible;
+	bool matches = false;
+	foreach (JServiceNode *child, node->children) {
+		const bool childMatches = filterNode(child, included, false);
+		matches = matches || childMatches;
+		if ((included || childMatches) && isShown(child)) {
+			child->row = visible.size();
+			visible << child;
+		}
+	}
+	// Keep narrowing filter from skipping the branch with new matches
+	for (JServiceNode *it = node; matches && it; it = it->parent)
+		it->matches = true;
+
+	const QModelIndex index = indexOf(node);
+	if (!index.isValid() && node != m_root) {
+		node->visible = visible;
+	} else if (!visible.isEmpty()) {
+		beginInsertRows(index, 0, visible.size() - 1);
+		node->visible = visible;
+		endInsertRows();
+	} else if (index.isValid()) {
+		// Expand indicator is hidden now
+		emit dataChanged(index, index);
+	}
+	if (m_conferenceMode) {
+		foreach (JServiceNode *child, node->children)
+			queueInfo(child);
+	}
+	emit pendingCountChanged(pendingCount());
+}
+
+void JServiceModel::onError(const Jreen::Error::Ptr &error)
+{
+	Jreen::DiscoReply *reply = static_cast<Jreen::DiscoReply*>(sender());
+	reply->deleteLater();
+	JServiceNode *node = m_replies.take(reply);
+	if (!node)
+		return;
+	if (node->info == JServiceNode::Requested)
+		node->info = JServiceNode::Failed;
+	else
+		node->items = JServiceNode::Failed;
+	node->error = error->conditionText();
+	const QModelIndex index = indexOf(node);
+	if (index.isValid())
+		emit dataChanged(index, index);
+	processQueue();
+}
+
+QString JServiceModel::serviceIcon(const Jreen::Disco::Item &di)
+{
+	if (di.identities().isEmpty())
+		return QString();
+	QString service_icon;
+	if (di.hasIdentity("server")) {
+		service_icon = "network-server";
+	} else if (di.hasIdentity("conference", "text")) {
+		if (Jreen::JID(di.jid()).node().isEmpty())
+			service_icon = "conference-server";
+		else if (Jreen::JID(di.jid()).resource().isEmpty())
+			service_icon = "conference";
+		else
+			service_icon = "conference-user";
+	} else if (di.hasIdentity("conference", "irc")) {
+		service_icon = "im-irc-gateway";
+	} else if (di.hasIdentity("gateway", "icq")) {
+		service_icon = "im-icq-gateway";
+	} else if (di.hasIdentity("gateway", "aim")) {
+		service_icon = "im-aim-gateway";
+	} else if (di.hasIdentity("gateway", "mrim")) {
+		service_icon = "im-mrim-gateway";
+	} else if (di.hasIdentity("gateway", "msn")) {
+		service_icon = "im-msn-gateway";
+	} else if (di.hasIdentity("gateway", "xmpp")) {
+		service_icon = "im-jabber-gateway";
+	} else if (di.hasIdentity("gateway")) {
+		service_icon = "im-default-gateway";
+	} else if (di.hasIdentity("directory")) {
+		service_icon = "edit-find-user";
+	} else if (di.hasIdentity("automation")) {
+		service_icon = "utilities-terminal";
+	} else {
+		service_icon = "defaultservice";
+	}
+	return service_icon;
+}
+
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JSERVICEMODEL_H
+#define JSERVICEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QBasicTimer>
+#include <QVector>
+#include <QHash>
+#include <jreen/disco.h>
+
+namespace qutim_sdk_0_3
+{
+class Account;
+}
+
+namespace Jabber
+{
+struct JServiceNode;
+
+// Tree of disco items, info of items is requested only when their rows are
+// shown and the number of outstanding requests is limited
+class JServiceModel : public QAbstractItemModel
+{
+	Q_OBJECT
+public:
+	enum { ItemRole = Qt::UserRole + 1 };
+
+	JServiceModel(qutim_sdk_0_3::Account *account, Jreen::Disco *disco, QObject *parent = 0);
+	~JServiceModel();
+
+	// Shows only conferences and servers, info of all items is requested then
+	void setConferenceMode(bool conferenceMode);
+	void setServer(const QString &server);
+	void setFilter(const QString &filter);
+	QString filter() const { return m_filter; }
+	Jreen::Disco::Item item(const QModelIndex &index) const;
+	int pendingCount() const { return m_replies.size() + m_queue.size(); }
+
+	static QString serviceIcon(const Jreen::Disco::Item &item);
+
+	QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+	QModelIndex parent(const QModelIndex &index) const;
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+	bool canFetchMore(const QModelIndex &parent) const;
+	void fetchMore(const QModelIndex &parent);
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	Qt::ItemFlags flags(const QModelIndex &index) const;
+
+signals:
+	void pendingCountChanged(int count);
+
+protected:
+	void timerEvent(QTimerEvent *event);
+
+private slots:
+	void onInfoReceived(const Jreen::Disco::Item &item);
+	void onItemsReceived(const Jreen::Disco::ItemList &items);
+	void onError(const Jreen::Error::Ptr &error);
+
+private:
+	JServiceNode *node(const QModelIndex &index) const;
+	QModelIndex indexOf(JServiceNode *node) const;
+	// Node is in visible list of its parent
+	bool isListed(JServiceNode *node) const;
+	bool isShown(JServiceNode *node) const;
+	bool isIncluded(JServiceNode *node) const;
+	bool filterNode(JServiceNode *node, bool included, bool narrowing);
+	void refilter(bool narrowing);
+	void queueInfo(JServiceNode *node) const;
+	void processQueue();
+	void setInfo(JServiceNode *node, const Jreen::Disco::Item &info);
+	void setItems(JServiceNode *node, const Jreen::Disco::ItemList &items);
+	void showNode(JServiceNode *node);
+	void clear();
+	QString cacheKey(const Jreen::Disco::Item &item) const;
+
+	qutim_sdk_0_3::Account *m_account;
+	Jreen::Disco *m_disco;
+	JServiceNode *m_root;
+	QString m_filter;
+	bool m_conferenceMode;
+	// Most recently shown rows are requested first
+	mutable QVector<JServiceNode*> m_queue;
+	mutable QBasicTimer m_queueTimer;
+	QHash<Jreen::DiscoReply*, JServiceNode*> m_replies;
+};
+}
+
+#endif // JSERVICEMODEL_H
@@ -117,14 +117,16 @@ public:
 	Jreen::JID jid;
 	Jreen::VCard::Ptr vcard;
 	Jreen::VCardManager *manager;
+	JVCardCache *cache;
 };
 
-JInfoRequest::JInfoRequest(Jreen::VCardManager *manager, QObject *object)
+JInfoRequest::JInfoRequest(JVCardManager *manager, QObject *object)
 	: InfoRequest(object), d_ptr(new JInfoRequestPrivate)
 {
 	Q_D(JInfoRequest);
 	d->jid = object->property("id").toString();
-	d->manager = manager;
+	d->manager = manager->m_manager;
+	d->cache = manager->m_cache.data();
 }
 
 JInfoRequest::~JInfoRequest()
@@ -135,7 +137,7 @@ void JInfoRequest::setFetchedVCard(const Jreen::VCard::Ptr &vcard)
 {
 	Q_D(JInfoRequest);
 	d->vcard = vcard;
-	if (state() == InfoRequest::Requesting)
+	if (state() == InfoRequest::Requesting || state() == InfoRequest::LoadedFromCache)
 		setState(InfoRequest::RequestDone);
 }
 
@@ -143,10 +145,20 @@ void JInfoRequest::doRequest(const QSet<QString> &hints)
 {
 	Q_D(JInfoRequest);
 	Q_UNUSED(hints);
+	// Cached vCard is shown at once, the server is asked only if it can
+	// have something newer
+	const QString jid = d->jid.full();
+	if (Jreen::VCard::Ptr vcard = d->cache->vcard(jid)) {
+		d->vcard = vcard;
+		setState(InfoRequest::LoadedFromCache);
+		if (d->cache->isActual(jid, object()->property("photoHash").toString()))
+			return;
+	}
 	Jreen::VCardReply *reply = d->manager->fetch(d->jid);
 	connect(reply, SIGNAL(vCardFetched(Jreen::VCard::Ptr,Jreen::JID)),
 	        SLOT(setFetchedVCard(Jreen::VCard::Ptr)));
-	setState(InfoRequest::Requesting);
+	if (state() != InfoRequest::LoadedFromCache)
+		setState(InfoRequest::Requesting);
 }
 
 void JInfoRequest::doUpdate(const DataItem &dataItem)
@@ -526,10 +538,13 @@ void JInfoRequest::onStoreFinished()
 {
 	Jreen::VCardReply *reply = qobject_cast<Jreen::VCardReply*>(sender());
 	Q_ASSERT(reply);
-	if (reply->error())
+	if (reply->error()) {
 		setState(Error);
-	else
+	} else {
+		Q_D(JInfoRequest);
+		d->cache->insert(d->jid.full(), d->vcard, JVCardManager::ensurePhoto(d->vcard->photo()));
 		setState(Updated);
+	}
 }
 
 
@@ -74,7 +74,7 @@ public:
 		Features
 	};
 
-	JInfoRequest(Jreen::VCardManager *manager, QObject *object);
+	JInfoRequest(JVCardManager *manager, QObject *object);
 	~JInfoRequest();
 
 protected slots:
@@ -0,0 +1,267 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "jvcardcache.h"
+#include <qutim/account.h>
+#include <qutim/protocol.h>
+#include <qutim/avatarstore.h>
+#include <QStringBuilder>
+#include <QImageReader>
+#include <QFile>
+#include <QUrl>
+
+namespace Jabber
+{
+using namespace qutim_sdk_0_3;
+
+// vCard is fetched again sometimes even if the photo is the same, people
+// change their names, phones and so on without changing avatars
+enum { MaxAge = 7 * 24 * 60 * 60 };
+
+template <typename T>
+static int types(const T &item, const QList<typename T::Type> &known)
+{
+	int result = 0;
+	for (int i = 0; i < known.size(); ++i) {
+		if (item.testType(known.at(i)))
+			result |= 1 << i;
+	}
+	return result;
+}
+
+template <typename T>
+static void setTypes(T &item, const QList<typename T::Type> &known, int value)
+{
+	for (int i = 0; i < known.size(); ++i) {
+		if (value & (1 << i))
+			item.setType(known.at(i), true);
+	}
+}
+
+static QList<Jreen::VCard::Telephone::Type> phoneTypes()
+{
+	return QList<Jreen::VCard::Telephone::Type>()
+			<< Jreen::VCard::Telephone::Home
+			<< Jreen::VCard::Telephone::Work
+			<< Jreen::VCard::Telephone::Cell;
+}
+
+static QList<Jreen::VCard::EMail::Type> emailTypes()
+{
+	return QList<Jreen::VCard::EMail::Type>()
+			<< Jreen::VCard::EMail::Home
+			<< Jreen::VCard::EMail::Work;
+}
+
+static QList<Jreen::VCard::Address::Type> addressTypes()
+{
+	return QList<Jreen::VCard::Address::Type>()
+			<< Jreen::VCard::Address::Home
+			<< Jreen::VCard::Address::Work;
+}
+
+JVCardCache::JVCardCache(Account *account)
+	: m_config(account->protocol()->id() % QLatin1Char('.') % account->id() % QLatin1Literal("/vcards"))
+{
+}
+
+Jreen::VCard::Ptr JVCardCache::vcard(const QString &jid, QString *photoHash, QDateTime *received) const
+{
+	const Entry *cached = entry(jid);
+	if (photoHash)
+		*photoHash = cached ? cached->photoHash : QString();
+	if (received)
+		*received = cached ? cached->received : QDateTime();
+	return cached ? cached->vcard : Jreen::VCard::Ptr();
+}
+
+bool JVCardCache::isActual(const QString &jid, const QString &photoHash) const
+{
+	const Entry *cached = entry(jid);
+	if (!cached || cached->photoHash != photoHash)
+		return false;
+	// Avatar could be removed from the store, it's restored by refetching
+	if (!photoHash.isEmpty() && !AvatarStore::contains(photoHash))
+		return false;
+	return cached->received.secsTo(QDateTime::currentDateTimeUtc()) < MaxAge;
+}
+
+void JVCardCache::insert(const QString &jid, const Jreen::VCard::Ptr &vcard, const QString &photoHash)
+{
+	if (!vcard)
+		return;
+	Entry &cached = m_entries[jid];
+	cached.vcard = vcard;
+	cached.photoHash = photoHash;
+	cached.received = QDateTime::currentDateTimeUtc();
+
+	QVariantMap data = toVariant(vcard);
+	data.insert(QStringLiteral("photoHash"), photoHash);
+	data.insert(QStringLiteral("received"), cached.received);
+	m_config.setValue(key(jid), data);
+}
+
+void JVCardCache::remove(const QString &jid)
+{
+	m_entries.remove(jid);
+	m_config.remove(key(jid));
+}
+
+const JVCardCache::Entry *JVCardCache::entry(const QString &jid) const
+{
+	QHash<QString, Entry>::const_iterator it = m_entries.constFind(jid);
+	if (it != m_entries.constEnd())
+		return &*it;
+
+	const QVariantMap data = m_config.value(key(jid), QVariantMap());
+	if (data.isEmpty())
+		return 0;
+	Entry cached;
+	cached.photoHash = data.value(QStringLiteral("photoHash")).toString();
+	cached.received = data.value(QStringLiteral("received")).toDateTime();
+	cached.vcard = fromVariant(data, cached.photoHash);
+	return &*m_entries.insert(jid, cached);
+}
+
+QString JVCardCache::key(const QString &jid)
+{
+	// Config splits keys by slashes, full jids of conference members have ones
+	return QString::fromLatin1(QUrl::toPercentEncoding(jid, "@"));
+}
+
+QVariantMap JVCardCache::toVariant(const Jreen::VCard::Ptr &vcard)
+{
+	QVariantMap data;
+	data.insert(QStringLiteral("nick"), vcard->nickname());
+	data.insert(QStringLiteral("formattedName"), vcard->formattedName());
+	data.insert(QStringLiteral("firstName"), vcard->name().given());
+	data.insert(QStringLiteral("middleName"), vcard->name().middle());
+	data.insert(QStringLiteral("lastName"), vcard->name().family());
+	data.insert(QStringLiteral("birthday"), vcard->birthday().date());
+	data.insert(QStringLiteral("homepage"), vcard->url().toString());
+	data.insert(QStringLiteral("about"), vcard->desc());
+	data.insert(QStringLiteral("orgName"), vcard->organization().name());
+	data.insert(QStringLiteral("orgUnits"), vcard->organization().units());
+	data.insert(QStringLiteral("title"), vcard->title());
+	data.insert(QStringLiteral("role"), vcard->role());
+
+	QVariantList phones;
+	foreach (const Jreen::VCard::Telephone &phone, vcard->telephones()) {
+		QVariantMap item;
+		item.insert(QStringLiteral("number"), phone.number());
+		item.insert(QStringLiteral("types"), types(phone, phoneTypes()));
+		phones << item;
+	}
+	data.insert(QStringLiteral("phones"), phones);
+
+	QVariantList emails;
+	foreach (const Jreen::VCard::EMail &email, vcard->emails()) {
+		QVariantMap item;
+		item.insert(QStringLiteral("email"), email.userId());
+		item.insert(QStringLiteral("types"), types(email, emailTypes()));
+		emails << item;
+	}
+	data.insert(QStringLiteral("emails"), emails);
+
+	QVariantList addresses;
+	foreach (const Jreen::VCard::Address &address, vcard->addresses()) {
+		QVariantMap item;
+		item.insert(QStringLiteral("country"), address.country());
+		item.insert(QStringLiteral("region"), address.region());
+		item.insert(QStringLiteral("city"), address.locality());
+		item.insert(QStringLiteral("postcode"), address.postCode());
+		item.insert(QStringLiteral("street"), address.street());
+		item.insert(QStringLiteral("extendedAddress"), address.extendedAddress());
+		item.insert(QStringLiteral("postbox"), address.postBox());
+		item.insert(QStringLiteral("types"), types(address, addressTypes()));
+		addresses << item;
+	}
+	data.insert(QStringLiteral("addresses"), addresses);
+	return data;
+}
+
+Jreen::VCard::Ptr JVCardCache::fromVariant(const QVariantMap &data, const QString &photoHash)
+{
+	Jreen::VCard::Ptr vcard = Jreen::VCard::Ptr::create();
+	vcard->setNickname(data.value(QStringLiteral("nick")).toString());
+	vcard->setFormattedName(data.value(QStringLiteral("formattedName")).toString());
+	vcard->setName(data.value(QStringLiteral("lastName")).toString(),
+				   data.value(QStringLiteral("firstName")).toString(),
+				   data.value(QStringLiteral("middleName")).toString());
+	vcard->setBirthday(data.value(QStringLiteral("birthday")).toDate());
+	vcard->setUrl(QUrl(data.value(QStringLiteral("homepage")).toString()));
+	vcard->setDesc(data.value(QStringLiteral("about")).toString());
+	vcard->setOrganization(data.value(QStringLiteral("orgName")).toString(),
+						   data.value(QStringLiteral("orgUnits")).toStringList());
+	vcard->setTitle(data.value(QStringLiteral("title")).toString());
+	vcard->setRole(data.value(QStringLiteral("role")).toString());
+
+	foreach (const QVariant &value, data.value(QStringLiteral("phones")).toList()) {
+		const QVariantMap item = value.toMap();
+		Jreen::VCard::Telephone phone;
+		phone.setNumber(item.value(QStringLiteral("number")).toString());
+		setTypes(phone, phoneTypes(), item.value(QStringLiteral("types")).toInt());
+		vcard->addTelephone(phone);
+	}
+	foreach (const QVariant &value, data.value(QStringLiteral("emails")).toList()) {
+		const QVariantMap item = value.toMap();
+		Jreen::VCard::EMail email;
+		email.setUserId(item.value(QStringLiteral("email")).toString());
+		setTypes(email, emailTypes(), item.value(QStringLiteral("types")).toInt());
+		vcard->addEmail(email);
+	}
+	foreach (const QVariant &value, data.value(QStringLiteral("addresses")).toList()) {
+		const QVariantMap item = value.toMap();
+		Jreen::VCard::Address address;
+		address.setCountry(item.value(QStringLiteral("country")).toString());
+		address.setRegion(item.value(QStringLiteral("region")).toString());
+		address.setLocality(item.value(QStringLiteral("city")).toString());
+		address.setPostCode(item.value(QStringLiteral("postcode")).toString());
+		address.setStreet(item.value(QStringLiteral("street")).toString());
+		address.setExtendedAddress(item.value(QStringLiteral("extendedAddress")).toString());
+		address.setPostBox(item.value(QStringLiteral("postbox")).toString());
+		setTypes(address, addressTypes(), item.value(QStringLiteral("types")).toInt());
+		vcard->addAdress(address);
+	}
+
+	// Photo itself lives in the avatar store, it's not duplicated in the cache
+	if (!photoHash.isEmpty()) {
+		QFile file(AvatarStore::path(photoHash));
+		if (file.open(QIODevice::ReadOnly)) {
+			QByteArray format = QImageReader(&file).format().toLower();
+			file.seek(0);
+			if (format == "jpg")
+				format = "jpeg";
+			else if (format == "svg")
+				format = "svg+xml";
+			Jreen::VCard::Photo photo;
+			photo.setData(file.readAll(), format.isEmpty() ? QString() : QLatin1String("image/" + format));
+			vcard->setPhoto(photo);
+		}
+	}
+	return vcard;
+}
+
+}
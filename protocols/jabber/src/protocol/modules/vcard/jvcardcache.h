@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef JVCARDCACHE_H
+#define JVCARDCACHE_H
+
+#include <QHash>
+#include <QDateTime>
+#include <jreen/vcard.h>
+#include <qutim/config.h>
+
+namespace qutim_sdk_0_3
+{
+class Account;
+}
+
+namespace Jabber
+{
+
+// Persistent vCards of account's contacts, every vCard is remembered with the
+// photo hash it had, so it needs to be fetched again only when the hash
+// announced by presence differs
+class JVCardCache
+{
+public:
+	JVCardCache(qutim_sdk_0_3::Account *account);
+
+	Jreen::VCard::Ptr vcard(const QString &jid, QString *photoHash = 0, QDateTime *received = 0) const;
+	// Cached vCard is not older than the limit and has the same photo hash
+	bool isActual(const QString &jid, const QString &photoHash) const;
+	void insert(const QString &jid, const Jreen::VCard::Ptr &vcard, const QString &photoHash);
+	void remove(const QString &jid);
+
+private:
+	struct Entry
+	{
+		Jreen::VCard::Ptr vcard;
+		QString photoHash;
+		QDateTime received;
+	};
+
+	const Entry *entry(const QString &jid) const;
+	static QString key(const QString &jid);
+	static QVariantMap toVariant(const Jreen::VCard::Ptr &vcard);
+	static Jreen::VCard::Ptr fromVariant(const QVariantMap &data, const QString &photoHash);
+
+	mutable qutim_sdk_0_3::Config m_config;
+	// vCards are parsed from the config on first use
+	mutable QHash<QString, Entry> m_entries;
+};
+
+}
+
+#endif // JVCARDCACHE_H
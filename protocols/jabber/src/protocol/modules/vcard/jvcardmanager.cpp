@@ -35,16 +35,20 @@
 #include <qutim/systeminfo.h>
 #include <qutim/chatunit.h>
 #include <qutim/conference.h>
+#include <qutim/avatarstore.h>
 #include <jreen/vcard.h>
 #include <jreen/vcardupdate.h>
 #include <jreen/iq.h>
 #include <jreen/client.h>
 #include <QCryptographicHash>
 #include <QMetaProperty>
+#include <QTimerEvent>
 
 namespace Jabber
 {
 
+enum { FetchInterval = 250 };
+
 static bool isStatusOnline(const Status &status)
 {
 	Status::Type type = status.type();
@@ -64,7 +68,26 @@ void JVCardManager::onConnected()
 	m_manager->fetch(m_client->jid().bareJID());
 }
 
-#define AVATAR_PATH SystemInfo::getPath(SystemInfo::ConfigDir) + QLatin1String("/avatars/jabber")
+void JVCardManager::queueFetch(const QString &jid)
+{
+	if (m_fetchQueue.contains(jid))
+		return;
+	m_fetchQueue << jid;
+	if (!m_fetchTimer.isActive())
+		m_fetchTimer.start(FetchInterval, this);
+}
+
+void JVCardManager::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != m_fetchTimer.timerId()) {
+		InfoRequestFactory::timerEvent(event);
+		return;
+	}
+	if (!m_fetchQueue.isEmpty() && isStatusOnline(m_account->status()))
+		m_manager->fetch(m_fetchQueue.takeFirst());
+	if (m_fetchQueue.isEmpty())
+		m_fetchTimer.stop();
+}
 
 QString JVCardManager::ensurePhoto(const Jreen::VCard::Photo &photo, QString *photoPath)
 {
@@ -74,16 +97,10 @@ QString JVCardManager::ensurePhoto(const Jreen::VCard::Photo &photo, QString *ph
 		photoPath = &tmp;
 	photoPath->clear();
 	if (!photo.data().isEmpty()) {
-		avatarHash = QCryptographicHash::hash(photo.data(), QCryptographicHash::Sha1).toHex();
-		QDir dir(AVATAR_PATH);
-		if (!dir.exists())
-			dir.mkpath(dir.absolutePath());
-		*photoPath = dir.absoluteFilePath(avatarHash);
-		QFile file(*photoPath);
-		if (file.open(QIODevice::WriteOnly)) {
-			file.write(photo.data());
-			file.close();
-		}
+		// XEP-0153 hash is sha1 of the data, the same the shared store uses
+		*photoPath = AvatarStore::store(photo.data());
+		if (!photoPath->isEmpty())
+			avatarHash = AvatarStore::hash(photo.data());
 	}
 	return avatarHash;
 }
@@ -91,6 +108,8 @@ QString JVCardManager::ensurePhoto(const Jreen::VCard::Photo &photo, QString *ph
 void JVCardManager::onVCardReceived(const Jreen::VCard::Ptr &vcard, const Jreen::JID &jid)
 {
 	const QString avatarHash = ensurePhoto(vcard->photo());
+	m_fetchQueue.removeOne(jid.full());
+	m_cache->insert(jid.full(), vcard, avatarHash);
 	QList<QObject*> objects;
 	if (QObject *unit = m_account->unit(jid.full(), false))
 		objects << unit;
@@ -143,11 +162,15 @@ void JVCardManager::onVCardUpdateDetected(const Jreen::JID &jid, const Jreen::VC
 		QMetaProperty property = meta->property(index);
 		if (property.read(unit).toString() == update->photoHash())
 			return;
-		QDir dir(AVATAR_PATH);
-		if (!update->photoHash().isEmpty() && dir.exists(update->photoHash()))
+		const bool hasAvatar = update->photoHash().isEmpty()
+				|| AvatarStore::contains(update->photoHash());
+		if (hasAvatar)
 			property.write(unit, update->photoHash());
-		else if (m_autoLoad)
-			m_manager->fetch(unit->id());
+		if (!m_autoLoad)
+			return;
+		// Known avatar is enough unless the cached vCard has become outdated
+		if (!hasAvatar || (m_cache->vcard(unit->id()) && !m_cache->isActual(unit->id(), update->photoHash())))
+			queueFetch(unit->id());
 	}
 }
 
@@ -164,6 +187,7 @@ void JVCardManager::init(qutim_sdk_0_3::Account *account)
 	m_autoLoad = config.value("getavatars", true);
 	m_client = qobject_cast<Jreen::Client*>(account->property("client"));
 	m_manager = new Jreen::VCardManager(m_client);
+	m_cache.reset(new JVCardCache(account));
 	connect(m_account, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
 			SLOT(onAccountStatusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)));
 	connect(m_manager, SIGNAL(vCardFetched(Jreen::VCard::Ptr,Jreen::JID)),
@@ -189,10 +213,10 @@ JVCardManager::SupportLevel JVCardManager::supportLevel(QObject *object)
 InfoRequest *JVCardManager::createrDataFormRequest(QObject *object)
 {
 	if (m_account == object) {
-		return new JInfoRequest(m_manager, m_account);
+		return new JInfoRequest(this, m_account);
 	} else if (ChatUnit *unit = qobject_cast<ChatUnit*>(object)) {
 		if (unit->account() == m_account)
-			return new JInfoRequest(m_manager, unit);
+			return new JInfoRequest(this, unit);
 	}
 	return 0;
 }
@@ -233,6 +257,11 @@ void JVCardManager::onAccountStatusChanged(const qutim_sdk_0_3::Status &status,
 	else
 		return;
 
+	if (!isOnline) {
+		m_fetchQueue.clear();
+		m_fetchTimer.stop();
+	}
+
 	SupportLevel level = supported ? ReadWrite : Unavailable;
 	setSupportLevel(m_account, level);
 
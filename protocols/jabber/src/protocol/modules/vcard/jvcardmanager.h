@@ -28,11 +28,14 @@
 
 #include <QObject>
 #include <QSharedPointer>
+#include <QBasicTimer>
+#include <QStringList>
 #include <jreen/vcardmanager.h>
 #include <qutim/inforequest.h>
 #include <qutim/status.h>
 #include <qutim/chatunit.h>
 #include "../../../sdk/jabber.h"
+#include "jvcardcache.h"
 
 namespace Jabber
 {
@@ -57,6 +60,7 @@ protected: // InformationRequestFactory stuff
 	virtual InfoRequest *createrDataFormRequest(QObject *object);
 	virtual bool startObserve(QObject *object);
 	virtual bool stopObserve(QObject *object);
+	virtual void timerEvent(QTimerEvent *event);
 
 protected slots:
 	void onConnected();
@@ -66,12 +70,19 @@ protected slots:
 								const qutim_sdk_0_3::Status &previous);
 	
 private:
+	void queueFetch(const QString &jid);
+
 	friend class JInfoRequest;
 	bool m_autoLoad;
 	qutim_sdk_0_3::Account *m_account;
 	Jreen::Client *m_client;
 	Jreen::VCardManager *m_manager;
 	QSet<qutim_sdk_0_3::ChatUnit*> m_observedUnits;
+	QScopedPointer<JVCardCache> m_cache;
+	// Avatar updates come in bursts after login, so vCards are fetched
+	// one by one instead of flooding the server
+	QStringList m_fetchQueue;
+	QBasicTimer m_fetchTimer;
 };
 
 }
@@ -0,0 +1,247 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestaccount.h"
+#include "loadtestprotocol.h"
+#include "loadtestcontact.h"
+#include "loadtestroom.h"
+#include "loadtestfiletransfer.h"
+#include <qutim/chatsession.h>
+#include <qutim/message.h>
+#include <qutim/debug.h>
+#include <QDateTime>
+#include <QTimerEvent>
+
+using namespace qutim_sdk_0_3;
+
+LoadTestAccount::LoadTestAccount(const QString &id, int index, const LoadTestScenario &scenario,
+                                 LoadTestProtocol *protocol)
+	: Account(id, protocol), m_scenario(scenario), m_random(scenario.seed * 1000003 + index),
+	  m_ticks(0), m_presenceDebt(0), m_messageDebt(0), m_roomMessageDebt(0),
+	  m_churnDebt(0), m_transferDebt(0), m_sent(0)
+{
+}
+
+LoadTestAccount::~LoadTestAccount()
+{
+	qDeleteAll(m_rooms);
+	qDeleteAll(m_roster);
+}
+
+ChatUnit *LoadTestAccount::getUnit(const QString &unitId, bool create)
+{
+	Q_UNUSED(create);
+	if (ChatUnit *unit = m_contacts.value(unitId))
+		return unit;
+	foreach (LoadTestRoom *room, m_rooms) {
+		if (room->id() == unitId)
+			return room;
+	}
+	return nullptr;
+}
+
+bool LoadTestAccount::sent(const Message &message)
+{
+	Q_UNUSED(message);
+	if (state() != Connected)
+		return false;
+	++m_sent;
+	return true;
+}
+
+void LoadTestAccount::doConnectToServer()
+{
+	m_connectTimer.start(m_scenario.connectDelay, this);
+}
+
+void LoadTestAccount::doDisconnectFromServer()
+{
+	m_reconnectTimer.stop();
+	setOffline(Status::ByUser);
+}
+
+void LoadTestAccount::doStatusChange(const Status &status)
+{
+	// Effective status follows user one by Account itself
+	Q_UNUSED(status);
+}
+
+void LoadTestAccount::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_tickTimer.timerId()) {
+		tick();
+	} else if (event->timerId() == m_connectTimer.timerId()) {
+		m_connectTimer.stop();
+		onConnected();
+	} else if (event->timerId() == m_reconnectTimer.timerId()) {
+		// Bearer manager may be absent in headless runs, so the account comes
+		// back by itself if nobody has reconnected it during downtime
+		m_reconnectTimer.stop();
+		if (state() == Disconnected && userStatus() != Status::Offline)
+			connectToServer();
+	} else {
+		Account::timerEvent(event);
+	}
+}
+
+void LoadTestAccount::loadRoster()
+{
+	beginRosterUpdate();
+	m_roster.reserve(m_scenario.contacts);
+	for (int i = 0; i < m_scenario.contacts; ++i) {
+		const QString contactId = QStringLiteral("contact%1@%2").arg(i).arg(id());
+		QStringList tags;
+		if (m_scenario.tags > 0)
+			tags << QStringLiteral("Group %1").arg(i % m_scenario.tags);
+		LoadTestContact *contact = new LoadTestContact(contactId, QStringLiteral("Contact %1").arg(i), tags, this);
+		m_contacts.insert(contactId, contact);
+		m_roster << contact;
+		emit contactCreated(contact);
+	}
+	endRosterUpdate();
+
+	for (int i = 0; i < m_scenario.rooms; ++i) {
+		LoadTestRoom *room = new LoadTestRoom(QStringLiteral("room%1@%2").arg(i).arg(id()),
+		                                      QStringLiteral("Room %1").arg(i), this);
+		m_rooms << room;
+		emit conferenceCreated(room);
+	}
+}
+
+void LoadTestAccount::onConnected()
+{
+	if (m_roster.isEmpty() && m_rooms.isEmpty())
+		loadRoster();
+	setState(Connected);
+
+	// Initial presences come as one burst like after real login
+	beginRosterUpdate();
+	foreach (LoadTestContact *contact, m_roster) {
+		if (m_random.chance(m_scenario.online))
+			contact->setStatusInternal(Status::Online);
+	}
+	endRosterUpdate();
+	foreach (LoadTestRoom *room, m_rooms)
+		room->join();
+
+	m_ticks = 0;
+	m_tickTimer.start(m_scenario.tick, this);
+}
+
+void LoadTestAccount::setOffline(Status::ChangeReason reason)
+{
+	m_connectTimer.stop();
+	m_tickTimer.stop();
+	foreach (LoadTestRoom *room, m_rooms)
+		room->leave();
+	beginRosterUpdate();
+	foreach (LoadTestContact *contact, m_roster)
+		contact->setStatusInternal(Status::Offline);
+	endRosterUpdate();
+	setState(Disconnected, reason);
+}
+
+void LoadTestAccount::tick()
+{
+	++m_ticks;
+	const double seconds = m_scenario.tick / 1000.0;
+
+	if (m_scenario.reconnectInterval > 0
+	        && m_ticks * m_scenario.tick >= m_scenario.reconnectInterval * qint64(1000)) {
+		debug() << id() << "drops connection for" << m_scenario.reconnectDowntime << "seconds";
+		setOffline(Status::ByNetworkError);
+		m_reconnectTimer.start(m_scenario.reconnectDowntime * 1000, this);
+		return;
+	}
+
+	m_presenceDebt += m_scenario.presenceRate * seconds;
+	for (; m_presenceDebt >= 1; m_presenceDebt -= 1)
+		changePresence();
+
+	m_messageDebt += m_scenario.messageRate * seconds;
+	for (; m_messageDebt >= 1; m_messageDebt -= 1)
+		receiveMessage();
+
+	if (!m_rooms.isEmpty()) {
+		m_roomMessageDebt += m_scenario.roomMessageRate * seconds;
+		for (; m_roomMessageDebt >= 1; m_roomMessageDebt -= 1)
+			m_rooms.at(m_random.bounded(m_rooms.size()))->receiveMessage();
+
+		m_churnDebt += m_scenario.roomChurn * seconds;
+		for (; m_churnDebt >= 1; m_churnDebt -= 1)
+			m_rooms.at(m_random.bounded(m_rooms.size()))->churn();
+	}
+
+	m_transferDebt += m_scenario.transferRate * seconds;
+	for (; m_transferDebt >= 1; m_transferDebt -= 1)
+		offerFile();
+}
+
+void LoadTestAccount::changePresence()
+{
+	static const Status::Type types[] = {
+		Status::Online, Status::Online, Status::Away, Status::NA,
+		Status::DND, Status::FreeChat, Status::Offline, Status::Offline
+	};
+	LoadTestContact *contact = randomContact(false);
+	if (!contact)
+		return;
+	const Status::Type type = types[m_random.bounded(int(sizeof(types) / sizeof(types[0])))];
+	contact->setStatusInternal(type, m_random.chance(30) ? m_random.text() : QString());
+}
+
+void LoadTestAccount::receiveMessage()
+{
+	LoadTestContact *contact = randomContact(true);
+	if (!contact)
+		return;
+	Message message(m_random.text());
+	message.setChatUnit(contact);
+	message.setIncoming(true);
+	message.setTime(QDateTime::currentDateTime());
+	ChatLayer::get(contact, true)->appendMessage(message);
+}
+
+void LoadTestAccount::offerFile()
+{
+	LoadTestFileTransferFactory *factory = LoadTestFileTransferFactory::instance();
+	LoadTestContact *contact = randomContact(true);
+	if (!factory || !contact)
+		return;
+	factory->offer(contact, m_scenario.transferSize, m_scenario.autoAccept);
+}
+
+LoadTestContact *LoadTestAccount::randomContact(bool online)
+{
+	if (m_roster.isEmpty())
+		return nullptr;
+	// A few probes are enough for any sane share of online contacts
+	for (int i = 0; i < 8; ++i) {
+		LoadTestContact *contact = m_roster.at(m_random.bounded(m_roster.size()));
+		if (!online || contact->status() != Status::Offline)
+			return contact;
+	}
+	return nullptr;
+}
@@ -0,0 +1,90 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTACCOUNT_H
+#define LOADTESTACCOUNT_H
+
+#include "loadtestscenario.h"
+#include <qutim/account.h>
+#include <QBasicTimer>
+#include <QHash>
+#include <QVector>
+
+class LoadTestProtocol;
+class LoadTestContact;
+class LoadTestRoom;
+
+// Simulated account, all its events are generated by fixed ticks, so the
+// same scenario and seed give the same sequence of events at any speed
+class LoadTestAccount : public qutim_sdk_0_3::Account
+{
+	Q_OBJECT
+public:
+	LoadTestAccount(const QString &id, int index, const LoadTestScenario &scenario, LoadTestProtocol *protocol);
+	~LoadTestAccount();
+
+	qutim_sdk_0_3::ChatUnit *getUnit(const QString &unitId, bool create = false) override;
+
+	const LoadTestScenario &scenario() const { return m_scenario; }
+	LoadTestRandom &random() { return m_random; }
+	// Outgoing messages are accepted at once
+	bool sent(const qutim_sdk_0_3::Message &message);
+
+protected:
+	void doConnectToServer() override;
+	void doDisconnectFromServer() override;
+	void doStatusChange(const qutim_sdk_0_3::Status &status) override;
+	void timerEvent(QTimerEvent *event) override;
+
+private:
+	void loadRoster();
+	void onConnected();
+	void setOffline(qutim_sdk_0_3::Status::ChangeReason reason);
+	void tick();
+	void changePresence();
+	void receiveMessage();
+	void offerFile();
+	LoadTestContact *randomContact(bool online);
+
+	LoadTestScenario m_scenario;
+	LoadTestRandom m_random;
+	QHash<QString, LoadTestContact*> m_contacts;
+	// Same contacts in creation order, random picks must not depend on hashing
+	QVector<LoadTestContact*> m_roster;
+	QVector<LoadTestRoom*> m_rooms;
+	QBasicTimer m_connectTimer;
+	QBasicTimer m_tickTimer;
+	QBasicTimer m_reconnectTimer;
+	qint64 m_ticks;
+	// Fractional parts of events carried over to next ticks
+	double m_presenceDebt;
+	double m_messageDebt;
+	double m_roomMessageDebt;
+	double m_churnDebt;
+	double m_transferDebt;
+	qint64 m_sent;
+};
+
+#endif // LOADTESTACCOUNT_H
@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestcontact.h"
+#include "loadtestaccount.h"
+
+using namespace qutim_sdk_0_3;
+
+LoadTestContact::LoadTestContact(const QString &id, const QString &name, const QStringList &tags,
+                                 LoadTestAccount *account)
+	: Contact(account), m_id(id), m_name(name), m_tags(tags),
+	  m_status(Status::instance(Status::Offline, "loadtest")), m_inList(true)
+{
+}
+
+LoadTestContact::~LoadTestContact()
+{
+}
+
+QString LoadTestContact::id() const
+{
+	return m_id;
+}
+
+QString LoadTestContact::name() const
+{
+	return m_name;
+}
+
+QStringList LoadTestContact::tags() const
+{
+	return m_tags;
+}
+
+Status LoadTestContact::status() const
+{
+	return m_status;
+}
+
+bool LoadTestContact::sendMessage(const Message &message)
+{
+	// Nobody is on the other side, outgoing messages are only counted
+	return m_status != Status::Offline && static_cast<LoadTestAccount*>(account())->sent(message);
+}
+
+void LoadTestContact::setName(const QString &name)
+{
+	if (m_name == name)
+		return;
+	const QString previous = m_name;
+	m_name = name;
+	emit nameChanged(m_name, previous);
+}
+
+void LoadTestContact::setTags(const QStringList &tags)
+{
+	if (m_tags == tags)
+		return;
+	const QStringList previous = m_tags;
+	m_tags = tags;
+	emit tagsChanged(m_tags, previous);
+}
+
+bool LoadTestContact::isInList() const
+{
+	return m_inList;
+}
+
+void LoadTestContact::setInList(bool inList)
+{
+	if (m_inList == inList)
+		return;
+	m_inList = inList;
+	emit inListChanged(inList);
+}
+
+void LoadTestContact::setStatusInternal(Status::Type type, const QString &text)
+{
+	if (m_status == type && m_status.text() == text)
+		return;
+	const Status previous = m_status;
+	m_status = Status::instance(type, "loadtest");
+	m_status.setText(text);
+	emit statusChanged(m_status, previous);
+}
@@ -0,0 +1,61 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTCONTACT_H
+#define LOADTESTCONTACT_H
+
+#include <qutim/contact.h>
+#include <qutim/status.h>
+
+class LoadTestAccount;
+
+class LoadTestContact : public qutim_sdk_0_3::Contact
+{
+	Q_OBJECT
+public:
+	LoadTestContact(const QString &id, const QString &name, const QStringList &tags, LoadTestAccount *account);
+	~LoadTestContact();
+
+	QString id() const override;
+	QString name() const override;
+	QStringList tags() const override;
+	qutim_sdk_0_3::Status status() const override;
+	bool sendMessage(const qutim_sdk_0_3::Message &message) override;
+	void setName(const QString &name) override;
+	void setTags(const QStringList &tags) override;
+	bool isInList() const override;
+	void setInList(bool inList) override;
+
+	void setStatusInternal(qutim_sdk_0_3::Status::Type type, const QString &text = QString());
+
+private:
+	QString m_id;
+	QString m_name;
+	QStringList m_tags;
+	qutim_sdk_0_3::Status m_status;
+	bool m_inList;
+};
+
+#endif // LOADTESTCONTACT_H
@@ -0,0 +1,172 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestfiletransfer.h"
+#include "loadtestaccount.h"
+#include "loadtestcontact.h"
+#include <QDir>
+#include <QFile>
+#include <QTimerEvent>
+
+using namespace qutim_sdk_0_3;
+
+enum { ChunksPerSecond = 10 };
+
+static QPointer<LoadTestFileTransferFactory> self;
+
+LoadTestFileTransferJob::LoadTestFileTransferJob(ChatUnit *unit, Direction direction, FileTransferFactory *factory)
+	: FileTransferJob(unit, direction, factory), m_done(0), m_size(0), m_speed(1)
+{
+	if (LoadTestAccount *account = qobject_cast<LoadTestAccount*>(unit->account()))
+		m_speed = account->scenario().transferSpeed;
+}
+
+LoadTestFileTransferJob::~LoadTestFileTransferJob()
+{
+	if (!m_temporaryFile.isEmpty())
+		QFile::remove(m_temporaryFile);
+}
+
+void LoadTestFileTransferJob::offer(qint64 size, bool autoAccept)
+{
+	static int counter = 0;
+	const QString fileName = QStringLiteral("loadtest-%1.bin").arg(++counter);
+	init(1, size, fileName);
+	FileTransferInfo info;
+	info.setFileName(fileName);
+	info.setFileSize(size);
+	setFileInfo(0, info);
+	if (autoAccept) {
+		// Data is garbage, so nobody needs the file after the transfer
+		m_temporaryFile = QDir::temp().filePath(fileName);
+		setProperty("localPath", m_temporaryFile);
+		accept();
+	}
+}
+
+void LoadTestFileTransferJob::doSend()
+{
+	start();
+}
+
+void LoadTestFileTransferJob::doStop()
+{
+	finish(Error);
+}
+
+void LoadTestFileTransferJob::doReceive()
+{
+	start();
+}
+
+void LoadTestFileTransferJob::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != m_timer.timerId()) {
+		FileTransferJob::timerEvent(event);
+		return;
+	}
+	const qint64 chunk = qMin(qMax<qint64>(1, m_speed / ChunksPerSecond), m_size - m_done);
+	if (direction() == Incoming) {
+		if (m_device->write(QByteArray(int(chunk), 'x')) != chunk) {
+			setError(IOError);
+			finish(Error);
+			return;
+		}
+	} else if (m_device->read(chunk).size() != chunk) {
+		setError(IOError);
+		finish(Error);
+		return;
+	}
+	m_done += chunk;
+	setFileProgress(m_done);
+	if (m_done >= m_size)
+		finish(Finished);
+}
+
+void LoadTestFileTransferJob::start()
+{
+	m_device = setCurrentIndex(0);
+	const QIODevice::OpenMode mode = direction() == Incoming ? QIODevice::WriteOnly : QIODevice::ReadOnly;
+	if (!m_device || (!m_device->isOpen() && !m_device->open(mode))) {
+		setError(IOError);
+		finish(Error);
+		return;
+	}
+	m_size = fileSize();
+	m_done = 0;
+	setState(Started);
+	m_timer.start(1000 / ChunksPerSecond, this);
+}
+
+void LoadTestFileTransferJob::finish(State state)
+{
+	m_timer.stop();
+	if (m_device)
+		m_device->close();
+	setState(state);
+}
+
+LoadTestFileTransferFactory::LoadTestFileTransferFactory()
+	: FileTransferFactory(tr("Load test"), 0)
+{
+	self = this;
+}
+
+LoadTestFileTransferFactory::~LoadTestFileTransferFactory()
+{
+}
+
+LoadTestFileTransferFactory *LoadTestFileTransferFactory::instance()
+{
+	return self.data();
+}
+
+bool LoadTestFileTransferFactory::checkAbility(ChatUnit *unit)
+{
+	return qobject_cast<LoadTestContact*>(unit);
+}
+
+bool LoadTestFileTransferFactory::startObserve(ChatUnit *unit)
+{
+	return qobject_cast<LoadTestContact*>(unit);
+}
+
+bool LoadTestFileTransferFactory::stopObserve(ChatUnit *unit)
+{
+	return qobject_cast<LoadTestContact*>(unit);
+}
+
+FileTransferJob *LoadTestFileTransferFactory::create(ChatUnit *unit)
+{
+	if (!checkAbility(unit))
+		return nullptr;
+	return new LoadTestFileTransferJob(unit, FileTransferJob::Outgoing, this);
+}
+
+void LoadTestFileTransferFactory::offer(LoadTestContact *contact, qint64 size, bool autoAccept)
+{
+	LoadTestFileTransferJob *job = new LoadTestFileTransferJob(contact, FileTransferJob::Incoming, this);
+	job->offer(size, autoAccept);
+}
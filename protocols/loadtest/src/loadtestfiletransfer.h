@@ -0,0 +1,82 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTFILETRANSFER_H
+#define LOADTESTFILETRANSFER_H
+
+#include <qutim/filetransfer.h>
+#include <QBasicTimer>
+#include <QPointer>
+
+class LoadTestContact;
+
+// Moves synthetic data with speed of the scenario, so transfer manager and
+// its views see the same progress and state changes as with real protocols
+class LoadTestFileTransferJob : public qutim_sdk_0_3::FileTransferJob
+{
+	Q_OBJECT
+public:
+	LoadTestFileTransferJob(qutim_sdk_0_3::ChatUnit *unit, Direction direction,
+	                        qutim_sdk_0_3::FileTransferFactory *factory);
+	~LoadTestFileTransferJob();
+
+	void offer(qint64 size, bool autoAccept);
+
+protected:
+	void doSend() override;
+	void doStop() override;
+	void doReceive() override;
+	void timerEvent(QTimerEvent *event) override;
+
+private:
+	void start();
+	void finish(State state);
+
+	QBasicTimer m_timer;
+	QPointer<QIODevice> m_device;
+	qint64 m_done;
+	qint64 m_size;
+	qint64 m_speed;
+	QString m_temporaryFile;
+};
+
+class LoadTestFileTransferFactory : public qutim_sdk_0_3::FileTransferFactory
+{
+	Q_OBJECT
+public:
+	LoadTestFileTransferFactory();
+	~LoadTestFileTransferFactory();
+	static LoadTestFileTransferFactory *instance();
+
+	bool checkAbility(qutim_sdk_0_3::ChatUnit *unit) override;
+	bool startObserve(qutim_sdk_0_3::ChatUnit *unit) override;
+	bool stopObserve(qutim_sdk_0_3::ChatUnit *unit) override;
+	qutim_sdk_0_3::FileTransferJob *create(qutim_sdk_0_3::ChatUnit *unit) override;
+
+	// Incoming file from @a contact, accepted ones are written to temporary directory
+	void offer(LoadTestContact *contact, qint64 size, bool autoAccept);
+};
+
+#endif // LOADTESTFILETRANSFER_H
@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestplugin.h"
+#include "loadtestprotocol.h"
+#include "loadtestfiletransfer.h"
+
+using namespace qutim_sdk_0_3;
+
+LoadTestPlugin::LoadTestPlugin()
+{
+}
+
+void LoadTestPlugin::init()
+{
+	setInfo(QT_TRANSLATE_NOOP("Plugin", "Load test"),
+	        QT_TRANSLATE_NOOP("Plugin", "Fake protocol generating configurable load for benchmarks"),
+	        PLUGIN_VERSION(0, 0, 1, 0));
+	addExtension(QT_TRANSLATE_NOOP("Plugin", "Load test"),
+	             QT_TRANSLATE_NOOP("Plugin", "Fake protocol generating configurable load for benchmarks"),
+	             new GeneralGenerator<LoadTestProtocol>());
+	addExtension(QT_TRANSLATE_NOOP("Plugin", "Load test file transfer"),
+	             QT_TRANSLATE_NOOP("Plugin", "Synthetic file transfers of load test protocol"),
+	             new SingletonGenerator<LoadTestFileTransferFactory, FileTransferFactory>());
+}
+
+bool LoadTestPlugin::load()
+{
+	return true;
+}
+
+bool LoadTestPlugin::unload()
+{
+	return false;
+}
+
+QUTIM_EXPORT_PLUGIN(LoadTestPlugin)
@@ -0,0 +1,43 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTPLUGIN_H
+#define LOADTESTPLUGIN_H
+
+#include <qutim/plugin.h>
+
+class LoadTestPlugin : public qutim_sdk_0_3::Plugin
+{
+	Q_OBJECT
+	Q_PLUGIN_METADATA(IID "org.qutim.Plugin")
+	Q_CLASSINFO("DebugName", "LoadTest")
+public:
+	LoadTestPlugin();
+	void init();
+	bool load();
+	bool unload();
+};
+
+#endif // LOADTESTPLUGIN_H
@@ -0,0 +1,79 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestprotocol.h"
+#include "loadtestaccount.h"
+#include <qutim/statusactiongenerator.h>
+#include <qutim/debug.h>
+
+using namespace qutim_sdk_0_3;
+
+LoadTestProtocol::LoadTestProtocol()
+{
+}
+
+LoadTestProtocol::~LoadTestProtocol()
+{
+	qDeleteAll(m_accounts);
+}
+
+QList<Account*> LoadTestProtocol::accounts() const
+{
+	QList<Account*> result;
+	foreach (LoadTestAccount *account, m_accounts)
+		result << account;
+	return result;
+}
+
+Account *LoadTestProtocol::account(const QString &id) const
+{
+	foreach (LoadTestAccount *account, m_accounts) {
+		if (account->id() == id)
+			return account;
+	}
+	return nullptr;
+}
+
+void LoadTestProtocol::loadAccounts()
+{
+	Status status(Status::Online);
+	status.initIcon("loadtest");
+	MenuController::addAction<LoadTestAccount>(new StatusActionGenerator(status));
+	status.setType(Status::Away);
+	status.initIcon("loadtest");
+	MenuController::addAction<LoadTestAccount>(new StatusActionGenerator(status));
+	status.setType(Status::Offline);
+	status.initIcon("loadtest");
+	MenuController::addAction<LoadTestAccount>(new StatusActionGenerator(status));
+
+	const LoadTestScenario scenario = LoadTestScenario::load();
+	debug() << "Load test scenario:" << scenario.accounts << "accounts with"
+	        << scenario.contacts << "contacts and" << scenario.rooms << "rooms";
+	for (int i = 0; i < scenario.accounts; ++i) {
+		LoadTestAccount *account = new LoadTestAccount(QStringLiteral("load%1").arg(i), i, scenario, this);
+		m_accounts << account;
+		emit accountCreated(account);
+	}
+}
@@ -0,0 +1,52 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTPROTOCOL_H
+#define LOADTESTPROTOCOL_H
+
+#include <qutim/protocol.h>
+
+class LoadTestAccount;
+
+// Accounts aren't stored in config, all of them are created from scenario
+// on every start
+class LoadTestProtocol : public qutim_sdk_0_3::Protocol
+{
+	Q_OBJECT
+	Q_CLASSINFO("Protocol", "loadtest")
+public:
+	LoadTestProtocol();
+	~LoadTestProtocol();
+
+	QList<qutim_sdk_0_3::Account*> accounts() const override;
+	qutim_sdk_0_3::Account *account(const QString &id) const override;
+
+private:
+	void loadAccounts() override;
+
+	QList<LoadTestAccount*> m_accounts;
+};
+
+#endif // LOADTESTPROTOCOL_H
@@ -0,0 +1,160 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestroom.h"
+#include "loadtestaccount.h"
+#include <qutim/chatsession.h>
+#include <qutim/message.h>
+#include <QDateTime>
+
+using namespace qutim_sdk_0_3;
+
+LoadTestParticipant::LoadTestParticipant(const QString &nick, LoadTestRoom *room)
+	: Buddy(room->account()), m_id(room->id() + QLatin1Char('/') + nick), m_nick(nick), m_room(room)
+{
+	setParent(room);
+}
+
+QString LoadTestParticipant::id() const
+{
+	return m_id;
+}
+
+QString LoadTestParticipant::name() const
+{
+	return m_nick;
+}
+
+Status LoadTestParticipant::status() const
+{
+	return Status::instance(Status::Online, "loadtest");
+}
+
+bool LoadTestParticipant::sendMessage(const Message &message)
+{
+	return static_cast<LoadTestAccount*>(account())->sent(message);
+}
+
+ChatUnit *LoadTestParticipant::upperUnit()
+{
+	return m_room;
+}
+
+LoadTestRoom::LoadTestRoom(const QString &id, const QString &title, LoadTestAccount *account)
+	: Conference(account), m_id(id), m_title(title), m_me(nullptr), m_lastNick(0)
+{
+}
+
+LoadTestRoom::~LoadTestRoom()
+{
+}
+
+QString LoadTestRoom::id() const
+{
+	return m_id;
+}
+
+QString LoadTestRoom::title() const
+{
+	return m_title;
+}
+
+Buddy *LoadTestRoom::me() const
+{
+	return m_me;
+}
+
+bool LoadTestRoom::sendMessage(const Message &message)
+{
+	return isJoined() && static_cast<LoadTestAccount*>(account())->sent(message);
+}
+
+void LoadTestRoom::churn()
+{
+	if (!isJoined() || m_participants.isEmpty())
+		return;
+	LoadTestAccount *account = static_cast<LoadTestAccount*>(this->account());
+	const int index = account->random().bounded(m_participants.size());
+	LoadTestParticipant *participant = m_participants.at(index);
+	m_participants.remove(index);
+	if (ChatSession *session = ChatLayer::get(this, false))
+		session->removeContact(participant);
+	participant->deleteLater();
+
+	participant = addParticipant();
+	if (ChatSession *session = ChatLayer::get(this, false))
+		session->addContact(participant);
+}
+
+void LoadTestRoom::receiveMessage()
+{
+	if (!isJoined() || m_participants.isEmpty())
+		return;
+	LoadTestAccount *account = static_cast<LoadTestAccount*>(this->account());
+	LoadTestParticipant *sender = m_participants.at(account->random().bounded(m_participants.size()));
+	Message message(account->random().text());
+	message.setChatUnit(this);
+	message.setIncoming(true);
+	message.setTime(QDateTime::currentDateTime());
+	message.setProperty("senderName", sender->name());
+	message.setProperty("senderId", sender->id());
+	ChatLayer::get(this, true)->appendMessage(message);
+}
+
+void LoadTestRoom::doJoin()
+{
+	LoadTestAccount *account = static_cast<LoadTestAccount*>(this->account());
+	m_me = new LoadTestParticipant(account->name(), this);
+	emit meChanged(m_me);
+	QList<Buddy*> participants;
+	participants << m_me;
+	for (int i = account->scenario().participants; i > 0; --i)
+		participants << addParticipant();
+	setJoined(true);
+	// Big rooms are joined by one batch as every real protocol does after names list
+	ChatLayer::get(this, true)->addContacts(participants);
+}
+
+void LoadTestRoom::doLeave()
+{
+	if (ChatSession *session = ChatLayer::get(this, false)) {
+		session->removeContact(m_me);
+		foreach (LoadTestParticipant *participant, m_participants)
+			session->removeContact(participant);
+	}
+	qDeleteAll(m_participants);
+	m_participants.clear();
+	delete m_me;
+	m_me = nullptr;
+	emit meChanged(nullptr);
+	setJoined(false);
+}
+
+LoadTestParticipant *LoadTestRoom::addParticipant()
+{
+	LoadTestParticipant *participant = new LoadTestParticipant(QStringLiteral("user%1").arg(++m_lastNick), this);
+	m_participants << participant;
+	return participant;
+}
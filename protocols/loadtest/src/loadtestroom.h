@@ -0,0 +1,84 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTROOM_H
+#define LOADTESTROOM_H
+
+#include <qutim/conference.h>
+#include <qutim/status.h>
+#include <QVector>
+
+class LoadTestAccount;
+class LoadTestRoom;
+
+class LoadTestParticipant : public qutim_sdk_0_3::Buddy
+{
+	Q_OBJECT
+public:
+	LoadTestParticipant(const QString &nick, LoadTestRoom *room);
+
+	QString id() const override;
+	QString name() const override;
+	qutim_sdk_0_3::Status status() const override;
+	bool sendMessage(const qutim_sdk_0_3::Message &message) override;
+	qutim_sdk_0_3::ChatUnit *upperUnit() override;
+
+private:
+	QString m_id;
+	QString m_nick;
+	LoadTestRoom *m_room;
+};
+
+class LoadTestRoom : public qutim_sdk_0_3::Conference
+{
+	Q_OBJECT
+public:
+	LoadTestRoom(const QString &id, const QString &title, LoadTestAccount *account);
+	~LoadTestRoom();
+
+	QString id() const override;
+	QString title() const override;
+	qutim_sdk_0_3::Buddy *me() const override;
+	bool sendMessage(const qutim_sdk_0_3::Message &message) override;
+
+	// Removes random participant and adds a new one while room is joined
+	void churn();
+	void receiveMessage();
+
+protected:
+	void doJoin() override;
+	void doLeave() override;
+
+private:
+	LoadTestParticipant *addParticipant();
+
+	QString m_id;
+	QString m_title;
+	LoadTestParticipant *m_me;
+	QVector<LoadTestParticipant*> m_participants;
+	int m_lastNick;
+};
+
+#endif // LOADTESTROOM_H
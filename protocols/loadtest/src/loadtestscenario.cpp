@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "loadtestscenario.h"
+#include <qutim/config.h>
+#include <QStringList>
+
+using namespace qutim_sdk_0_3;
+
+LoadTestScenario::LoadTestScenario()
+	: seed(1), accounts(1), tick(100), connectDelay(500),
+	  contacts(100), tags(10), online(30),
+	  presenceRate(1), messageRate(0.1),
+	  rooms(1), participants(20), roomMessageRate(0.5), roomChurn(0.1),
+	  transferRate(0), transferSize(1024 * 1024), transferSpeed(256 * 1024), autoAccept(true),
+	  reconnectInterval(0), reconnectDowntime(10)
+{
+}
+
+LoadTestScenario LoadTestScenario::load()
+{
+	const QString path = QString::fromLocal8Bit(qgetenv("QUTIM_LOADTEST_SCENARIO"));
+	Config config(path.isEmpty() ? QStringLiteral("loadtest") : path);
+
+	LoadTestScenario scenario;
+	scenario.seed = config.value(QStringLiteral("seed"), scenario.seed);
+	scenario.accounts = qMax(0, config.value(QStringLiteral("accounts"), scenario.accounts));
+	scenario.tick = qMax(10, config.value(QStringLiteral("tick"), scenario.tick));
+	scenario.connectDelay = qMax(0, config.value(QStringLiteral("connectDelay"), scenario.connectDelay));
+
+	Config group = config.group(QStringLiteral("roster"));
+	scenario.contacts = qMax(0, group.value(QStringLiteral("contacts"), scenario.contacts));
+	scenario.tags = qMax(0, group.value(QStringLiteral("tags"), scenario.tags));
+	scenario.online = qBound(0, group.value(QStringLiteral("online"), scenario.online), 100);
+
+	group = config.group(QStringLiteral("presence"));
+	scenario.presenceRate = group.value(QStringLiteral("rate"), scenario.presenceRate);
+
+	group = config.group(QStringLiteral("messages"));
+	scenario.messageRate = group.value(QStringLiteral("rate"), scenario.messageRate);
+
+	group = config.group(QStringLiteral("rooms"));
+	scenario.rooms = qMax(0, group.value(QStringLiteral("count"), scenario.rooms));
+	scenario.participants = qMax(0, group.value(QStringLiteral("participants"), scenario.participants));
+	scenario.roomMessageRate = group.value(QStringLiteral("rate"), scenario.roomMessageRate);
+	scenario.roomChurn = group.value(QStringLiteral("churn"), scenario.roomChurn);
+
+	group = config.group(QStringLiteral("transfers"));
+	scenario.transferRate = group.value(QStringLiteral("rate"), scenario.transferRate);
+	scenario.transferSize = qMax<qint64>(1, group.value(QStringLiteral("size"), scenario.transferSize));
+	scenario.transferSpeed = qMax<qint64>(1, group.value(QStringLiteral("speed"), scenario.transferSpeed));
+	scenario.autoAccept = group.value(QStringLiteral("autoAccept"), scenario.autoAccept);
+
+	group = config.group(QStringLiteral("reconnect"));
+	scenario.reconnectInterval = qMax(0, group.value(QStringLiteral("interval"), scenario.reconnectInterval));
+	scenario.reconnectDowntime = qMax(0, group.value(QStringLiteral("downtime"), scenario.reconnectDowntime));
+	return scenario;
+}
+
+QString LoadTestRandom::text()
+{
+	static const char * const words[] = {
+		"hello", "how", "are", "you", "ok", "lol", "see", "this", "tomorrow",
+		"привет", "как", "дела", "build", "works", "again", "http://qutim.org", ":)", ";-)"
+	};
+	const int count = int(sizeof(words) / sizeof(words[0]));
+	QStringList result;
+	for (int i = 1 + bounded(12); i > 0; --i)
+		result << QString::fromUtf8(words[bounded(count)]);
+	return result.join(QLatin1Char(' '));
+}
@@ -0,0 +1,101 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOADTESTSCENARIO_H
+#define LOADTESTSCENARIO_H
+
+#include <QString>
+
+// Load description shared by all simulated accounts. It's read from the file
+// named by QUTIM_LOADTEST_SCENARIO environment variable or from "loadtest"
+// config of the profile, any config backend format fits:
+//
+// {
+//     "seed": 1, "accounts": 4, "tick": 100, "connectDelay": 500,
+//     "roster": { "contacts": 500, "tags": 20, "online": 30 },
+//     "presence": { "rate": 20 },
+//     "messages": { "rate": 0.5 },
+//     "rooms": { "count": 3, "participants": 50, "rate": 2, "churn": 0.2 },
+//     "transfers": { "rate": 0.01, "size": 1048576, "speed": 262144, "autoAccept": true },
+//     "reconnect": { "interval": 600, "downtime": 10 }
+// }
+//
+// Rates are events per second of one account, sizes are in bytes, speed is
+// in bytes per second, tick and connectDelay are in milliseconds, reconnect
+// ones are in seconds. Zero rate or interval disables the kind of events.
+struct LoadTestScenario
+{
+	LoadTestScenario();
+	static LoadTestScenario load();
+
+	quint64 seed;
+	int accounts;
+	int tick;
+	int connectDelay;
+
+	int contacts;
+	int tags;
+	// Percent of contacts being online after connect
+	int online;
+
+	double presenceRate;
+	double messageRate;
+
+	int rooms;
+	int participants;
+	double roomMessageRate;
+	// Participants leaving and joining per second
+	double roomChurn;
+
+	double transferRate;
+	qint64 transferSize;
+	qint64 transferSpeed;
+	bool autoAccept;
+
+	int reconnectInterval;
+	int reconnectDowntime;
+};
+
+// Deterministic generator, so runs with the same seed produce the same load
+class LoadTestRandom
+{
+public:
+	LoadTestRandom(quint64 seed = 0) : m_state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+	quint32 next()
+	{
+		m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return quint32(m_state >> 33);
+	}
+	int bounded(int max) { return max > 0 ? int(next() % quint32(max)) : 0; }
+	bool chance(int percent) { return bounded(100) < percent; }
+
+	QString text();
+
+private:
+	quint64 m_state;
+};
+
+#endif // LOADTESTSCENARIO_H
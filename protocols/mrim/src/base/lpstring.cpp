@@ -42,7 +42,10 @@ quint32 LPString::read(const QByteArray& arr, quint32 pos, bool unicode)
     quint32 len = ByteUtils::readUint32(arr,pos);
     m_str.clear();
     m_unicode = unicode;
-    m_arr = arr.mid(pos+sizeof(len),len); 
+    // Packet body may be a view of connection's buffer, so data is always copied
+    const qint64 begin = qint64(pos) + sizeof(len);
+    len = qBound<qint64>(0, arr.size() - begin, len);
+    m_arr = QByteArray(arr.constData() + begin, len);
     return m_arr.length() + sizeof(len);
 }
 
@@ -60,12 +63,18 @@ LPString* LPString::readFrom(const QByteArray& arr, quint32 pos, bool unicode)
     return str;
 }
 
+static QTextCodec *lpsCodec(bool unicode)
+{
+    static QTextCodec *unicodeCodec = QTextCodec::codecForName("UTF-16LE");
+    static QTextCodec *cp1251Codec = QTextCodec::codecForName("CP1251");
+    return unicode ? unicodeCodec : cp1251Codec;
+}
+
 QByteArray LPString::toByteArray(const QString& str, bool unicode)
 {
     QByteArray arr;
     
-    QString codepage = (unicode) ? "UTF-16LE" : "CP1251";
-    QTextCodec* codec = QTextCodec::codecForName(codepage.toLocal8Bit());
+    QTextCodec* codec = lpsCodec(unicode);
     
     if (codec != 0)
     {
@@ -84,8 +93,7 @@ QString LPString::toString(const QByteArray& arr, bool unicode)
 {
     QString str;
 
-    QString codepage = (unicode) ? "UTF-16LE" : "CP1251";
-    QTextCodec* codec = QTextCodec::codecForName(codepage.toLocal8Bit());
+    QTextCodec* codec = lpsCodec(unicode);
 
     if (codec != NULL)
     {
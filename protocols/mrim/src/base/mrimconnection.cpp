@@ -32,7 +32,9 @@
 #include <QApplication>
 
 #include <qutim/notification.h>
-#include <qutim/systemintegration.h>
+#include <qutim/metrics.h>
+#include <qutim/socketoptions.h>
+#include <qutim/tcpsocket.h>
 
 #include "proto.h"
 #include "utils.h"
@@ -50,8 +52,8 @@ typedef QMap<quint32,PacketHandler*> QHandlersMap;
 struct MrimConnectionPrivate
 {
     MrimConnectionPrivate(MrimAccount *acc)
-        : account(acc), imSocket(new QTcpSocket), srvReqSocket(new QTcpSocket), readyReadTimer(new QTimer),
-          pingTimer(new QTimer)
+        : account(acc), imSocket(new TcpSocket), srvReqSocket(new TcpSocket), readyReadTimer(new QTimer),
+          pingTimer(new QTimer), readOffset(0)
     {
         readyReadTimer->setSingleShot(true);
         readyReadTimer->setInterval(0);
@@ -62,20 +64,31 @@ struct MrimConnectionPrivate
     inline QTcpSocket *SrvReqSocket() const { return srvReqSocket.data(); }
     inline QTimer *ReadyReadTimer() const   { return readyReadTimer.data(); }
 
+    void write(MrimPacket &packet)
+    {
+        const qint64 written = packet.writeTo(IMSocket());
+        if (written > 0)
+            metrics.sent(written);
+    }
+
     QString imHost;
     quint32 imPort;
     MrimAccount *account;
     MrimPacket   readPacket;
+    // Incoming data, packets are parsed right here without copying
+    QByteArray readBuffer;
+    int readOffset;
     MrimUserAgent    selfID;
 	MrimStatus status;
 
-    QScopedPointer<QTcpSocket> imSocket;
-    QScopedPointer<QTcpSocket> srvReqSocket;
+    QScopedPointer<TcpSocket> imSocket;
+    QScopedPointer<TcpSocket> srvReqSocket;
     QScopedPointer<QTimer> readyReadTimer;
     QScopedPointer<QTimer> pingTimer;
     QHandlersMap handlers;
     QList<quint32> handledTypes;
     MrimMessages *messages;
+    SocketMetrics metrics;
 };
 
 MrimConnection::MrimConnection(MrimAccount *account) : p(new MrimConnectionPrivate(account))
@@ -88,6 +101,9 @@ MrimConnection::MrimConnection(MrimAccount *account) : p(new MrimConnectionPriva
     connect(p->IMSocket(),SIGNAL(readyRead()),this,SLOT(readyRead()));
     connect(p->ReadyReadTimer(),SIGNAL(timeout()),this,SLOT(readyRead()));
     connect(p->pingTimer.data(),SIGNAL(timeout()),this,SLOT(sendPing()));
+    p->metrics = SocketMetrics(account);
+    p->imSocket->setMetrics(p->metrics);
+    p->srvReqSocket->setMetrics(p->metrics);
     registerPacketHandler(this);
     MrimUserAgent qutimAgent(QApplication::applicationName(),QApplication::applicationVersion(),
 							 "(git)",PROTO_VERSION_MAJOR,PROTO_VERSION_MINOR); //TODO: real build version
@@ -141,7 +157,7 @@ void MrimConnection::connected()
 {
     QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
     Q_ASSERT(socket);
-	SystemIntegration::keepAlive(socket);
+	SocketOptions::load(p->account).apply(socket);
 
     bool connected = false;
 
@@ -178,6 +194,11 @@ void MrimConnection::disconnected()
     Q_ASSERT(socket);
 
     debug()<<"Disconnected from server"<<qPrintable( Utils::toHostPortPair(socket->peerAddress(),socket->peerPort()) );
+    if (socket == p->IMSocket())
+    {
+        p->readBuffer.clear();
+        p->readOffset = 0;
+    }
 
     if (socket == p->SrvReqSocket())
     {
@@ -306,10 +327,11 @@ MrimConnection::ConnectionState MrimConnection::state() const
 
 void MrimConnection::readyRead()
 {    
-    QTcpSocket *socket = (p->IMSocket()->bytesAvailable()) ? p->IMSocket() : p->SrvReqSocket();
+    const bool hasBuffered = p->readOffset < p->readBuffer.size();
+    QTcpSocket *socket = (p->IMSocket()->bytesAvailable() || hasBuffered) ? p->IMSocket() : p->SrvReqSocket();
     Q_ASSERT(socket);
 
-    if (socket->bytesAvailable() <= 0) //windows hack?
+    if (socket->bytesAvailable() <= 0 && !hasBuffered) //windows hack?
     {
         return;
     }
@@ -323,27 +345,74 @@ void MrimConnection::readyRead()
     }
     else
     {
-        if (p->readPacket.readFrom(*socket))
-        {
-            if (p->readPacket.isFinished())
-            {
-                processPacket();
-                p->readPacket.clear();
-            }
-        }
-        else
-        {
-            close();
-        }
+        readPackets(socket);
+        return;
+    }
 
-        if (p->readPacket.lastError() != MrimPacket::NoError)
+    if (socket->bytesAvailable())
+    {//run next read round
+        p->readyReadTimer->start();
+    }
+}
+
+void MrimConnection::readPackets(QTcpSocket *socket)
+{
+    enum { MaxPacketsPerRound = 256 };
+
+    if (p->readOffset == p->readBuffer.size())
+    {//keeps allocated memory
+        p->readBuffer.resize(0);
+        p->readOffset = 0;
+    }
+    else if (p->readOffset > p->readBuffer.size() / 2)
+    {
+        p->readBuffer.remove(0, p->readOffset);
+        p->readOffset = 0;
+    }
+    const int oldSize = p->readBuffer.size();
+    const qint64 available = socket->bytesAvailable();
+    p->readBuffer.resize(oldSize + available);
+    const qint64 bytesRead = socket->read(p->readBuffer.data() + oldSize, available);
+    if (bytesRead < 0)
+    {
+        p->readBuffer.resize(oldSize);
+        close();
+        return;
+    }
+    p->readBuffer.resize(oldSize + bytesRead);
+    p->metrics.received(bytesRead);
+
+    int packets = 0;
+    while (packets < MaxPacketsPerRound)
+    {
+        const int used = p->readPacket.readFrom(p->readBuffer.constData() + p->readOffset,
+                                                p->readBuffer.size() - p->readOffset);
+        if (used < 0)
         {
 			debug(DebugVerbose)<<"Error while reading packet:" << p->readPacket.lastErrorString() ;
+            p->readPacket.clear();
+            p->readBuffer.clear();
+            p->readOffset = 0;
+            close();
+            return;
+        }
+        if (used == 0)
+            break;
+        p->readOffset += used;
+        ++packets;
+        p->metrics.received(0, 1);
+        processPacket();
+        p->readPacket.clear();
+        if (!socket->isOpen())
+        {//closed by a handler
+            p->readBuffer.clear();
+            p->readOffset = 0;
+            return;
         }
     }
 
-    if (socket->bytesAvailable())
-    {//run next read round
+    if (socket->bytesAvailable() || packets == MaxPacketsPerRound)
+    {//let the event loop breathe between rounds
         p->readyReadTimer->start();
     }
 }
@@ -399,7 +468,7 @@ void MrimConnection::sendStatusPacket()
 	packet.append(p->account->id());
 	packet.append(protoFeatures());
 	packet.append(p->selfID.toString());
-	packet.writeTo(p->IMSocket());
+	p->write(packet);
 }
 
 void MrimConnection::sendGreetings()
@@ -407,7 +476,7 @@ void MrimConnection::sendGreetings()
     MrimPacket hello(MrimPacket::Compose);
     hello.setMsgType(MRIM_CS_HELLO);
     hello.setBody("");
-    hello.writeTo(p->IMSocket());
+    p->write(hello);
 }
 
 void MrimConnection::login()
@@ -429,7 +498,7 @@ void MrimConnection::login()
     login << 0; //NULL
 #endif
     login << QString("%1 %2;").arg(QApplication::applicationName()).arg(QApplication::applicationVersion());
-    login.writeTo(p->IMSocket());
+    p->write(login);
 }
 
 void MrimConnection::sendPing()
@@ -443,7 +512,7 @@ void MrimConnection::sendPing()
     MrimPacket ping(MrimPacket::Compose);
     ping.setMsgType(MRIM_CS_PING);
     ping.setBody("");
-    ping.writeTo(p->IMSocket());
+    p->write(ping);
 }
 
 Status MrimConnection::setStatus(const Status &status)
@@ -482,6 +551,6 @@ void MrimConnection::loginRejected(const QString &reason)
 
 void MrimConnection::sendPacket(MrimPacket &packet)
 {
-    packet.writeTo(p->IMSocket());
+    p->write(packet);
 }
 
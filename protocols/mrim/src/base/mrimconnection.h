@@ -105,6 +105,7 @@ protected slots:
 
 protected:
     virtual bool processPacket();
+    void readPackets(QTcpSocket *socket);
 	void sendStatusPacket();
     virtual void sendGreetings();
     virtual void login();
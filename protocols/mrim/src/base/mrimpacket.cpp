@@ -59,15 +59,33 @@ void MrimPacket::setHeader(const QByteArray& header)
 		m_header.magic = 0xBADBEEF;
 		return;
 	}
-	QDataStream in(header);
-	in.setByteOrder(QDataStream::LittleEndian);
-	in >> m_header.magic;
-	in >> m_header.proto;
-	in >> m_header.seq;
-	in >> m_header.msg;
-	in >> m_header.dlen;
-	in >> m_header.from;
-	in >> m_header.fromport;
+	parseHeader(header.constData());
+}
+
+void MrimPacket::parseHeader(const char *data)
+{
+	const uchar *src = reinterpret_cast<const uchar*>(data);
+	m_header.magic = qFromLittleEndian<quint32>(src);
+	m_header.proto = qFromLittleEndian<quint32>(src + 4);
+	m_header.seq = qFromLittleEndian<quint32>(src + 8);
+	m_header.msg = qFromLittleEndian<quint32>(src + 12);
+	m_header.dlen = qFromLittleEndian<quint32>(src + 16);
+	m_header.from = qFromLittleEndian<quint32>(src + 20);
+	m_header.fromport = qFromLittleEndian<quint32>(src + 24);
+}
+
+void MrimPacket::writeHeader(char *data) const
+{
+	uchar *dst = reinterpret_cast<uchar*>(data);
+	qToLittleEndian<quint32>(m_header.magic, dst);
+	qToLittleEndian<quint32>(m_header.proto, dst + 4);
+	qToLittleEndian<quint32>(m_header.seq, dst + 8);
+	qToLittleEndian<quint32>(m_header.msg, dst + 12);
+	qToLittleEndian<quint32>(m_header.dlen, dst + 16);
+	qToLittleEndian<quint32>(m_header.from, dst + 20);
+	qToLittleEndian<quint32>(m_header.fromport, dst + 24);
+	// The rest is reserved
+	qMemSet(dst + 28, 0, HEADER_SIZE - 28);
 }
 
 void MrimPacket::setHeader(const mrim_packet_header_t& header)
@@ -115,22 +133,9 @@ void MrimPacket::setSequence(quint32 seq)
 
 QByteArray MrimPacket::toByteArray()
 {
-	QByteArray data;
-	{
-		QDataStream stream(&data, QIODevice::WriteOnly);
-		stream.setByteOrder(QDataStream::LittleEndian);
-		stream << m_header.magic;
-		stream << m_header.proto;
-		stream << m_header.seq;
-		stream << m_header.msg;
-		stream << m_header.dlen;
-		stream << m_header.from;
-		stream << m_header.fromport;
-	}
-	int oldSize = data.size();
-	data.resize(HEADER_SIZE);
-	qMemSet(data.data() + oldSize, 0, data.size() - oldSize);
-	data += m_body;
+	QByteArray data(HEADER_SIZE + m_body.size(), Qt::Uninitialized);
+	writeHeader(data.data());
+	qMemCopy(data.data() + HEADER_SIZE, m_body.constData(), m_body.size());
 	return data;
 }
 
@@ -180,6 +185,25 @@ bool MrimPacket::readFrom(QIODevice& device)
 	return true;
 }
 
+int MrimPacket::readFrom(const char *data, int size)
+{
+	Q_ASSERT(mode() == Receive);
+	if (size < HEADER_SIZE)
+		return 0;
+	parseHeader(data);
+	if (!isHeaderCorrect()) {
+		setError(HeaderCorrupted);
+		return -1;
+	}
+	if (size - HEADER_SIZE < int(dataLength()))
+		return 0;
+	m_body = QByteArray::fromRawData(data + HEADER_SIZE, dataLength());
+	m_currBodyPos = 0;
+	m_bytesLeft = 0;
+	setState(Finished);
+	return HEADER_SIZE + dataLength();
+}
+
 QString MrimPacket::errorString(PacketError errCode)
 {
 	switch (errCode)
@@ -215,7 +239,9 @@ void MrimPacket::append( LPString &lpStr )
 
 void MrimPacket::append( const quint32 &num )
 {
-	m_body.append(ByteUtils::toByteArray(num));
+	uchar data[sizeof(quint32)];
+	qToLittleEndian(num, data);
+	m_body.append(reinterpret_cast<const char*>(data), sizeof(data));
 	m_header.dlen = m_body.length();
 }
 
@@ -223,7 +249,14 @@ qint64 MrimPacket::writeTo(QIODevice *device, bool waitForWritten)
 {
 	Q_ASSERT(mode() == Compose);
 	Q_ASSERT(device);
-	qint64 written = device->write(toByteArray());
+	// Socket copies data to its own buffer, so there is no need to join them
+	char header[HEADER_SIZE];
+	writeHeader(header);
+	qint64 written = device->write(header, HEADER_SIZE);
+	if (written == HEADER_SIZE && !m_body.isEmpty()) {
+		const qint64 bodyWritten = device->write(m_body);
+		written = bodyWritten < 0 ? bodyWritten : written + bodyWritten;
+	}
 	
 	if (waitForWritten)
 	{
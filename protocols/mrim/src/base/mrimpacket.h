@@ -104,6 +104,9 @@ public:
 
     //Receive mode
     bool readFrom(QIODevice& device);
+    // Parses the packet in place, body stays a view of the buffer until clear().
+    // Returns number of used bytes, 0 if the packet isn't complete yet or -1 on error
+    int readFrom(const char *data, int size);
     qint32 readTo(LPString &str, bool unicode = false);
     qint32 readTo(QString *str, bool unicode = false);
     qint32 readTo(quint32 &num);
@@ -129,6 +132,8 @@ public:
 
 private:
     void initHeader();
+    void parseHeader(const char *data);
+    void writeHeader(char *data) const;
     void setState(PacketState newState);
     void setError(PacketError errCode);
 
@@ -42,10 +42,7 @@ QByteArray ByteUtils::toByteArray(const quint32 UL)
 
 quint32 ByteUtils::toUint32(const QByteArray& arr)
 {
-    bool ok;
-    quint32 res = arr.toHex().toULong(&ok,16);
-    res = qToBigEndian(res);
-    return res;
+    return readUint32(arr, 0);
 }
 
 quint32 ByteUtils::readUint32(QIODevice& buffer)
@@ -55,7 +52,9 @@ quint32 ByteUtils::readUint32(QIODevice& buffer)
 
 quint32 ByteUtils::readUint32(const QByteArray& arr, quint32 pos)
 {
-    return toUint32(arr.mid(pos,4));
+    if (quint64(pos) + sizeof(quint32) > quint64(arr.size()))
+        return 0;
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(arr.constData() + pos));
 }
 
 LPString* ByteUtils::readLPS(QIODevice& device, bool unicode)
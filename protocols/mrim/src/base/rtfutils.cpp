@@ -25,30 +25,510 @@
 
 #include <QtEndian>
 #include <QBuffer>
+#include <QTextCodec>
+#include <QHash>
+#include <QVector>
+#include <algorithm>
+#include <string.h>
+#include <ctype.h>
 
 #ifndef NO_RTF_SUPPORT
-#include "../3rdparty/rtf/rtftextreader.h"
 
 #include "protoutils.h"
 #include "rtfutils.h"
 
+namespace {
+
+enum RtfControl
+{
+    ControlPar,
+    ControlLine,
+    ControlTab,
+    ControlChar,
+    ControlBold,
+    ControlItalic,
+    ControlUnderline,
+    ControlUnderlineNone,
+    ControlPlain,
+    ControlAnsiCodepage,
+    ControlFont,
+    ControlFontCharset,
+    ControlFontTable,
+    ControlUnicode,
+    ControlUnicodeSkip,
+    ControlBinary,
+    ControlSkipDestination
+};
+
+struct RtfControlWord
+{
+    const char *name;
+    RtfControl control;
+    const char *text; // UTF-8 replacement for ControlChar
+};
+
+// Must be sorted by name, it's searched by binary search
+static const RtfControlWord rtfControlWords[] = {
+    { "ansicpg", ControlAnsiCodepage, 0 },
+    { "author", ControlSkipDestination, 0 },
+    { "b", ControlBold, 0 },
+    { "bin", ControlBinary, 0 },
+    { "bullet", ControlChar, "\xE2\x80\xA2" },
+    { "buptim", ControlSkipDestination, 0 },
+    { "colortbl", ControlSkipDestination, 0 },
+    { "comment", ControlSkipDestination, 0 },
+    { "creatim", ControlSkipDestination, 0 },
+    { "doccomm", ControlSkipDestination, 0 },
+    { "emdash", ControlChar, "\xE2\x80\x94" },
+    { "emspace", ControlChar, "\xE2\x80\x83" },
+    { "endash", ControlChar, "\xE2\x80\x93" },
+    { "enspace", ControlChar, "\xE2\x80\x82" },
+    { "f", ControlFont, 0 },
+    { "fcharset", ControlFontCharset, 0 },
+    { "fonttbl", ControlFontTable, 0 },
+    { "footer", ControlSkipDestination, 0 },
+    { "footnote", ControlSkipDestination, 0 },
+    { "header", ControlSkipDestination, 0 },
+    { "i", ControlItalic, 0 },
+    { "info", ControlSkipDestination, 0 },
+    { "keywords", ControlSkipDestination, 0 },
+    { "ldblquote", ControlChar, "\xE2\x80\x9C" },
+    { "line", ControlLine, 0 },
+    { "lquote", ControlChar, "\xE2\x80\x98" },
+    { "operator", ControlSkipDestination, 0 },
+    { "par", ControlPar, 0 },
+    { "pict", ControlSkipDestination, 0 },
+    { "plain", ControlPlain, 0 },
+    { "printim", ControlSkipDestination, 0 },
+    { "private1", ControlSkipDestination, 0 },
+    { "rdblquote", ControlChar, "\xE2\x80\x9D" },
+    { "revtim", ControlSkipDestination, 0 },
+    { "rquote", ControlChar, "\xE2\x80\x99" },
+    { "stylesheet", ControlSkipDestination, 0 },
+    { "subject", ControlSkipDestination, 0 },
+    { "tab", ControlTab, 0 },
+    { "title", ControlSkipDestination, 0 },
+    { "u", ControlUnicode, 0 },
+    { "uc", ControlUnicodeSkip, 0 },
+    { "ul", ControlUnderline, 0 },
+    { "ulnone", ControlUnderlineNone, 0 }
+};
+
+static const RtfControlWord *findControlWord(const char *name)
+{
+    const RtfControlWord *begin = rtfControlWords;
+    const RtfControlWord *end = rtfControlWords + sizeof(rtfControlWords) / sizeof(rtfControlWords[0]);
+    const RtfControlWord *it = std::lower_bound(begin, end, name,
+                                                [] (const RtfControlWord &word, const char *name) {
+        return strcmp(word.name, name) < 0;
+    });
+    return (it != end && !strcmp(it->name, name)) ? it : 0;
+}
+
+static int charsetCodepage(int charset)
+{
+    switch (charset) {
+    case 0: return 1252;
+    case 128: return 932;
+    case 129: return 949;
+    case 134: return 936;
+    case 136: return 950;
+    case 161: return 1253;
+    case 162: return 1254;
+    case 177: return 1255;
+    case 178: return 1256;
+    case 186: return 1257;
+    case 204: return 1251;
+    case 222: return 874;
+    case 238: return 1250;
+    default: return 0;
+    }
+}
+
+static QTextCodec *codepageCodec(int codepage)
+{
+    static QHash<int, QTextCodec*> codecs;
+    QHash<int, QTextCodec*>::const_iterator it = codecs.constFind(codepage);
+    if (it != codecs.constEnd())
+        return it.value();
+    QTextCodec *codec = QTextCodec::codecForName("cp" + QByteArray::number(codepage));
+    if (!codec)
+        codec = QTextCodec::codecForName("windows-" + QByteArray::number(codepage));
+    codecs.insert(codepage, codec);
+    return codec;
+}
+
+// Single pass converter, RTF of Mail.Ru messages is simple enough
+// to be translated to html right away
+class RtfConverter
+{
+public:
+    RtfConverter(QTextCodec *defaultCodec, QString *plainText, QString *html);
+    void convert(const QByteArray &rtf);
+
+private:
+    struct State
+    {
+        bool bold;
+        bool italic;
+        bool underline;
+        bool skip;
+        bool fontTable;
+        int unicodeSkip;
+        QTextCodec *codec;
+    };
+
+    void control(const char *word, bool hasParameter, int parameter, const char *&ptr, const char *end);
+    void addByte(char byte);
+    void addChar(QChar ch);
+    void addText(const QString &text);
+    void addNewLine();
+    void flush();
+    void applyFormat();
+
+    QTextCodec *m_defaultCodec;
+    QString *m_text;
+    QString *m_html;
+    State m_state;
+    QVector<State> m_stack;
+    QByteArray m_pending;
+    QHash<int, QTextCodec*> m_fonts;
+    int m_currentFont;
+    int m_newLines;
+    int m_skipChars;
+    bool m_formatOpened;
+    bool m_appliedBold;
+    bool m_appliedItalic;
+    bool m_appliedUnderline;
+    bool m_lastSpace;
+};
+
+RtfConverter::RtfConverter(QTextCodec *defaultCodec, QString *plainText, QString *html) :
+    m_defaultCodec(defaultCodec), m_text(plainText), m_html(html), m_currentFont(0),
+    m_newLines(0), m_skipChars(0), m_formatOpened(false), m_appliedBold(false),
+    m_appliedItalic(false), m_appliedUnderline(false), m_lastSpace(false)
+{
+    m_state.bold = false;
+    m_state.italic = false;
+    m_state.underline = false;
+    m_state.skip = false;
+    m_state.fontTable = false;
+    m_state.unicodeSkip = 1;
+    m_state.codec = defaultCodec;
+}
+
+void RtfConverter::convert(const QByteArray &rtf)
+{
+    const char *ptr = rtf.constData();
+    const char *end = ptr + rtf.size();
+    char word[32];
+
+    while (ptr != end) {
+        const char c = *ptr++;
+        switch (c) {
+        case '{':
+            flush();
+            m_stack.append(m_state);
+            break;
+        case '}':
+            flush();
+            if (m_stack.isEmpty())
+                return;
+            m_state = m_stack.last();
+            m_stack.removeLast();
+            break;
+        case '\r':
+        case '\n':
+            break;
+        case '\\': {
+            if (ptr == end)
+                return;
+            const char next = *ptr;
+            if (next == '\'') {
+                // Hex encoded byte of the current codepage
+                if (end - ptr < 3)
+                    return;
+                bool ok;
+                const int byte = QByteArray(ptr + 1, 2).toInt(&ok, 16);
+                ptr += 3;
+                if (ok)
+                    addByte(char(byte));
+            } else if (!isalpha(uchar(next))) {
+                ++ptr;
+                switch (next) {
+                case '\\':
+                case '{':
+                case '}':
+                    addByte(next);
+                    break;
+                case '~':
+                    addChar(QChar(0xA0));
+                    break;
+                case '_':
+                    addChar(QLatin1Char('-'));
+                    break;
+                case '*':
+                    // Ignorable destinations are never shown
+                    flush();
+                    m_state.skip = true;
+                    break;
+                case '\r':
+                case '\n':
+                    addNewLine();
+                    break;
+                default:
+                    break;
+                }
+            } else {
+                int length = 0;
+                while (ptr != end && isalpha(uchar(*ptr))) {
+                    if (length < int(sizeof(word)) - 1)
+                        word[length++] = *ptr;
+                    ++ptr;
+                }
+                word[length] = '\0';
+                bool hasParameter = false;
+                bool negative = false;
+                int parameter = 0;
+                if (ptr != end && *ptr == '-') {
+                    negative = true;
+                    ++ptr;
+                }
+                while (ptr != end && isdigit(uchar(*ptr))) {
+                    hasParameter = true;
+                    parameter = parameter * 10 + (*ptr - '0');
+                    ++ptr;
+                }
+                if (negative)
+                    parameter = -parameter;
+                // Space is a part of control word
+                if (ptr != end && *ptr == ' ')
+                    ++ptr;
+                control(word, hasParameter, parameter, ptr, end);
+            }
+            break;
+        }
+        default:
+            addByte(c);
+            break;
+        }
+    }
+    flush();
+}
+
+void RtfConverter::control(const char *name, bool hasParameter, int parameter,
+                           const char *&ptr, const char *end)
+{
+    const RtfControlWord *word = findControlWord(name);
+    if (!word)
+        return;
+    if (word->control == ControlBinary) {
+        // Binary data is never text
+        ptr += qBound<qint64>(0, parameter, end - ptr);
+        return;
+    }
+    if (m_state.skip && word->control != ControlFontCharset && word->control != ControlFont)
+        return;
+
+    flush();
+    switch (word->control) {
+    case ControlPar:
+    case ControlLine:
+        addNewLine();
+        break;
+    case ControlTab:
+        addChar(QLatin1Char('\t'));
+        break;
+    case ControlChar:
+        addText(QString::fromUtf8(word->text));
+        break;
+    case ControlBold:
+        m_state.bold = !hasParameter || parameter;
+        break;
+    case ControlItalic:
+        m_state.italic = !hasParameter || parameter;
+        break;
+    case ControlUnderline:
+        m_state.underline = !hasParameter || parameter;
+        break;
+    case ControlUnderlineNone:
+        m_state.underline = false;
+        break;
+    case ControlPlain:
+        m_state.bold = m_state.italic = m_state.underline = false;
+        break;
+    case ControlAnsiCodepage:
+        if (QTextCodec *codec = codepageCodec(parameter))
+            m_state.codec = m_defaultCodec = codec;
+        break;
+    case ControlFont:
+        if (m_state.fontTable) {
+            m_currentFont = parameter;
+        } else if (!m_state.skip) {
+            m_state.codec = m_fonts.value(parameter, m_defaultCodec);
+        }
+        break;
+    case ControlFontCharset:
+        if (m_state.fontTable) {
+            if (QTextCodec *codec = codepageCodec(charsetCodepage(parameter)))
+                m_fonts.insert(m_currentFont, codec);
+        }
+        break;
+    case ControlFontTable:
+        // Font names are not text, but charsets of fonts are needed
+        m_state.fontTable = true;
+        m_state.skip = true;
+        break;
+    case ControlUnicode:
+        addChar(QChar(ushort(parameter < 0 ? parameter + 65536 : parameter)));
+        m_skipChars = m_state.unicodeSkip;
+        break;
+    case ControlUnicodeSkip:
+        m_state.unicodeSkip = qMax(0, parameter);
+        break;
+    case ControlSkipDestination:
+        m_state.skip = true;
+        break;
+    case ControlBinary:
+        break;
+    }
+}
+
+void RtfConverter::addByte(char byte)
+{
+    if (m_state.skip)
+        return;
+    if (m_skipChars > 0) {
+        // Fallback representation of the preceding \u character
+        --m_skipChars;
+        return;
+    }
+    m_pending.append(byte);
+}
+
+void RtfConverter::flush()
+{
+    if (m_pending.isEmpty())
+        return;
+    QTextCodec *codec = m_state.codec ? m_state.codec : m_defaultCodec;
+    addText(codec ? codec->toUnicode(m_pending) : QString::fromLatin1(m_pending));
+    m_pending.clear();
+}
+
+void RtfConverter::addNewLine()
+{
+    // Trailing paragraphs are not shown, so new lines are added lazily
+    ++m_newLines;
+}
+
+void RtfConverter::applyFormat()
+{
+    if (m_appliedBold == m_state.bold && m_appliedItalic == m_state.italic
+            && m_appliedUnderline == m_state.underline) {
+        return;
+    }
+    if (m_formatOpened)
+        m_html->append(QLatin1String("</span>"));
+    m_appliedBold = m_state.bold;
+    m_appliedItalic = m_state.italic;
+    m_appliedUnderline = m_state.underline;
+    m_formatOpened = m_appliedBold || m_appliedItalic || m_appliedUnderline;
+    if (!m_formatOpened)
+        return;
+    m_html->append(QLatin1String("<span style=\""));
+    if (m_appliedBold)
+        m_html->append(QLatin1String("font-weight:bold;"));
+    if (m_appliedItalic)
+        m_html->append(QLatin1String("font-style:italic;"));
+    if (m_appliedUnderline)
+        m_html->append(QLatin1String("text-decoration:underline;"));
+    m_html->append(QLatin1String("\">"));
+}
+
+void RtfConverter::addChar(QChar ch)
+{
+    addText(QString(ch));
+}
+
+void RtfConverter::addText(const QString &text)
+{
+    if (text.isEmpty() || m_state.skip)
+        return;
+    for (; m_newLines > 0; --m_newLines) {
+        m_text->append(QLatin1Char('\n'));
+        m_html->append(QLatin1String("<br />"));
+        m_lastSpace = false;
+    }
+    m_text->append(text);
+    applyFormat();
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar ch = text.at(i);
+        const bool space = ch == QLatin1Char(' ');
+        switch (ch.unicode()) {
+        case '<':
+            m_html->append(QLatin1String("&lt;"));
+            break;
+        case '>':
+            m_html->append(QLatin1String("&gt;"));
+            break;
+        case '&':
+            m_html->append(QLatin1String("&amp;"));
+            break;
+        case '"':
+            m_html->append(QLatin1String("&quot;"));
+            break;
+        case '\t':
+            m_html->append(QLatin1String("&nbsp;&nbsp;&nbsp;&nbsp;"));
+            break;
+        case ' ':
+            // Keeps sequences of spaces as they are
+            if (m_lastSpace)
+                m_html->append(QLatin1String("&nbsp;"));
+            else
+                m_html->append(ch);
+            break;
+        default:
+            m_html->append(ch);
+            break;
+        }
+        m_lastSpace = space;
+    }
+}
+
+}
+
 class RtfPrivate
 {
 public:
-    RtfTextReader *reader;
+    QTextCodec *codec;
 };
 
 Rtf::Rtf(const char *defaultEncoding) :
     p(new RtfPrivate)
 {
-    p->reader = new RtfTextReader(defaultEncoding);
+    p->codec = QTextCodec::codecForName(defaultEncoding);
 }
 
 Rtf::~Rtf() {
-    delete p->reader;
 }
 
-void Rtf::parse(RtfTextReader *reader, const QString& rtfMsg, QString *plainText, QString *html)
+void Rtf::convert(const QByteArray &rtf, QTextCodec *defaultCodec, QString *plainText, QString *html)
+{
+    QString text;
+    QString body;
+    RtfConverter converter(defaultCodec, &text, &body);
+    converter.convert(rtf);
+    if (plainText)
+        *plainText = text;
+    if (html) {
+        html->reserve(body.size() + 13);
+        *html = QLatin1String("<span>");
+        html->append(body);
+        html->append(QLatin1String("</span>"));
+    }
+}
+
+void Rtf::parse(const QString& rtfMsg, QString *plainText, QString *html)
 {
 	QByteArray unbased = QByteArray::fromBase64(rtfMsg.toLatin1());
     QByteArray arr;
@@ -58,27 +538,15 @@ void Rtf::parse(RtfTextReader *reader, const QString& rtfMsg, QString *plainText
     QByteArray uncompressed = qUncompress(arr);
 
     QBuffer buf;
-    buf.open(QIODevice::ReadWrite);
-    buf.write(uncompressed);
-    buf.seek(0);
+    buf.setBuffer(&uncompressed);
+    buf.open(QIODevice::ReadOnly);
     quint32 numLps = ByteUtils::readUint32(buf);
 
     if (numLps > 1) {
         QByteArray rtfMsg = ByteUtils::readArray(buf);
         QString color = ByteUtils::readString(buf);//not used now
         Q_UNUSED(color);
-        reader->readDocument(rtfMsg);
-		if (plainText)
-			*plainText = reader->getText();
-		if (html) {
-			QString plainHtml = reader->getHtml();
-			int index = plainHtml.indexOf(QLatin1String("<body"));
-			int lastIndex = plainHtml.lastIndexOf(QLatin1String("</body"));
-			*html = QLatin1String("<span");
-			// length of "<body" is equal to 5
-			html->append(plainHtml.midRef(index + 5, lastIndex - index - 5));
-			html->append(QLatin1String("</span>"));
-		}
+        convert(rtfMsg, p->codec, plainText, html);
     } else {
 		if (plainText)
 			plainText->clear();
@@ -87,10 +555,4 @@ void Rtf::parse(RtfTextReader *reader, const QString& rtfMsg, QString *plainText
 	}
 }
 
-void Rtf::parse(const QString& rtfMsg, QString *plainText, QString *html)
-{
-    parse(p->reader, rtfMsg, plainText, html);
-}
-
 #endif //NO_RTF_SUPPORT
-
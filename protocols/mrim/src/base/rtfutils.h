@@ -29,7 +29,7 @@
 #include <QScopedPointer>
 #include <QString>
 
-class RtfTextReader;
+class QTextCodec;
 class RtfPrivate;
 
 class Rtf
@@ -38,7 +38,8 @@ public:
     Rtf(const char *defaultEncoding = "utf-8");
     ~Rtf();
 
-    static void parse(RtfTextReader *reader, const QString& rtfMsg, QString *plainText, QString *html);
+    // Converts RTF document to plain text and html in single pass
+    static void convert(const QByteArray &rtf, QTextCodec *defaultCodec, QString *plainText, QString *html);
     void parse(const QString& rtfMsg, QString *plainText, QString *html);
 
 private:
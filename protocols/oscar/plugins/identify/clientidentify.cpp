@@ -112,44 +112,85 @@ ClientIdentify::~ClientIdentify()
 {
 }
 
+enum { MaxCachedFingerprints = 1024 };
+
+bool ClientIdentify::Fingerprint::operator==(const Fingerprint &o) const
+{
+	return proto == o.proto && info == o.info && extInfo == o.extInfo
+	        && extStatusInfo == o.extStatusInfo && hasPort == o.hasPort
+	        && hasAuthCookie == o.hasAuthCookie && caps == o.caps;
+}
+
+uint qHash(const ClientIdentify::Fingerprint &fingerprint)
+{
+	uint h = qHash(fingerprint.proto) ^ qHash(fingerprint.info)
+	        ^ (qHash(fingerprint.extInfo) << 1) ^ (qHash(fingerprint.extStatusInfo) << 2)
+	        ^ (uint(fingerprint.hasPort) << 3) ^ (uint(fingerprint.hasAuthCookie) << 4);
+	foreach (const oscar::Capability &capability, fingerprint.caps)
+		h = 31 * h + capability.hash();
+	return h;
+}
+
+static QHash<Capability, ClientIdentify::CapabilityFlags> capabilityFlags()
+{
+	QHash<Capability, ClientIdentify::CapabilityFlags> flags;
+	flags.insert(ICQ_CAPABILITY_RTFxMSGS, rtf_support);
+	flags.insert(ICQ_CAPABILITY_TYPING, typing_support);
+	flags.insert(ICQ_CAPABILITY_AIMCHAT, aim_chat_support);
+	flags.insert(ICQ_CAPABILITY_AIMIMAGE, aim_image_support);
+	flags.insert(ICQ_CAPABILITY_XTRAZ, xtraz_support);
+	flags.insert(ICQ_CAPABILITY_UTF8, utf8_support);
+	flags.insert(ICQ_CAPABILITY_AIMSENDFILE, sendfile_support);
+	flags.insert(ICQ_CAPABILITY_DIRECT, direct_support);
+	flags.insert(ICQ_CAPABILITY_AIMICON, icon_support);
+	flags.insert(ICQ_CAPABILITY_AIMGETFILE, getfile_support);
+	flags.insert(ICQ_CAPABILITY_SRVxRELAY, srvrelay_support);
+	flags.insert(ICQ_CAPABILITY_AVATAR, avatar_support);
+	return flags;
+}
+
 void ClientIdentify::identify(IcqContact *contact)
 {
-	m_client_id.clear();
+	const DirectConnectionInfo &dcInfo = contact->dcInfo();
+	Fingerprint fingerprint;
+	fingerprint.caps = contact->capabilities();
+	fingerprint.proto = dcInfo.protocol_version;
+	fingerprint.info = dcInfo.info_utime;
+	fingerprint.extInfo = dcInfo.extinfo_utime;
+	fingerprint.extStatusInfo = dcInfo.extstatus_utime;
+	fingerprint.hasPort = dcInfo.port;
+	fingerprint.hasAuthCookie = dcInfo.auth_cookie;
+
+	QHash<Fingerprint, Result>::ConstIterator it = m_cache.constFind(fingerprint);
+	if (it != m_cache.constEnd()) {
+		m_client_id = it->clientId;
+		m_client_icon = it->clientIcon;
+		return;
+	}
+
 	m_contact = contact;
-	m_client_caps = contact->capabilities();
-	m_client_proto = contact->dcInfo().protocol_version;
-	m_info = contact->dcInfo().info_utime;
-	m_ext_info = contact->dcInfo().extinfo_utime;
-	m_ext_status_info = contact->dcInfo().extstatus_utime;
+	m_client_caps = fingerprint.caps;
+	m_client_proto = fingerprint.proto;
+	m_info = fingerprint.info;
+	m_ext_info = fingerprint.extInfo;
+	m_ext_status_info = fingerprint.extStatusInfo;
+	identifyClient();
+
+	if (m_cache.size() >= MaxCachedFingerprints)
+		m_cache.clear();
+	Result &result = m_cache[fingerprint];
+	result.clientId = m_client_id;
+	result.clientIcon = m_client_icon;
+}
+
+void ClientIdentify::identifyClient()
+{
+	static const QHash<Capability, CapabilityFlags> flags = capabilityFlags();
+	m_client_id.clear();
 	m_flags = 0;
 
-	foreach(const oscar::Capability &capability, m_client_caps)
-	{
-		if (capability.match(ICQ_CAPABILITY_RTFxMSGS))
-			m_flags |= rtf_support;
-		else if (capability.match(ICQ_CAPABILITY_TYPING))
-			m_flags |= typing_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMCHAT))
-			m_flags |= aim_chat_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMIMAGE))
-			m_flags |= aim_image_support;
-		else if (capability.match(ICQ_CAPABILITY_XTRAZ))
-			m_flags |= xtraz_support;
-		else if (capability.match(ICQ_CAPABILITY_UTF8))
-			m_flags |= utf8_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMSENDFILE))
-			m_flags |= sendfile_support;
-		else if (capability.match(ICQ_CAPABILITY_DIRECT))
-			m_flags |= direct_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMICON))
-			m_flags |= icon_support;
-		else if (capability.match(ICQ_CAPABILITY_AIMGETFILE))
-			m_flags |= getfile_support;
-		else if (capability.match(ICQ_CAPABILITY_SRVxRELAY))
-			m_flags |= srvrelay_support;
-		else if (capability.match(ICQ_CAPABILITY_AVATAR))
-			m_flags |= avatar_support;
-	}
+	foreach (const oscar::Capability &capability, m_client_caps)
+		m_flags |= flags.value(capability);
 
 	// There may be some x-statuses info here.. remove all of them.
 	// TODO:
@@ -28,6 +28,7 @@
 #define CLIENTIDENTIFY_H_
 
 #include <QList>
+#include <QHash>
 #include <QByteArray>
 #include "../../src/capability.h"
 #include "../../src/oscarroster.h"
@@ -139,6 +140,26 @@ private:
 	void identify_StrIcq();
 	void identify_NaimIcq();
 private:
+	// Everything identify() depends on, so equal fingerprints give equal clients
+	struct Fingerprint
+	{
+		oscar::Capabilities caps;
+		quint16 proto;
+		quint32 info;
+		quint32 extInfo;
+		quint32 extStatusInfo;
+		bool hasPort;
+		bool hasAuthCookie;
+		bool operator==(const Fingerprint &o) const;
+	};
+	friend uint qHash(const Fingerprint &fingerprint);
+	struct Result
+	{
+		QString clientId;
+		ExtensionIcon clientIcon;
+	};
+	void identifyClient();
+	QHash<Fingerprint, Result> m_cache;
 	IcqContact *m_contact;
 	oscar::Capabilities m_client_caps;
 	quint16 m_client_proto;
@@ -298,6 +298,14 @@ void XStatusHandler::processTlvs2711(IcqContact *contact, Capability guid, quint
 {
     QString message = data.read<QString, quint32>(LittleEndian);
     Q_ASSERT(guid == MSG_XSTRAZ_SCRIPT && type == xtrazNotify);
+    // Contacts answer every auto request with the same payload while their
+    // xstatus is not changed, such answers are dropped before parsing
+    const uint hash = qHash(message);
+    const QVariant lastHash = contact->property("xtrazHash");
+    if (lastHash.isValid() && lastHash.toUInt() == hash) {
+        debug() << "Skipped unchanged xtraz response from" << contact->id();
+        return;
+    }
     Xtraz xtraz(message);
     if (xtraz.type() == Xtraz::Request) {
         XtrazRequest request = xtraz.request();
@@ -317,6 +325,7 @@ void XStatusHandler::processTlvs2711(IcqContact *contact, Capability guid, quint
             return;
         }
         setXstatus(contact, response.value("title"), response.value("desc"));
+        contact->setProperty("xtrazHash", hash);
     }
 }
 
@@ -324,6 +333,7 @@ void XStatusHandler::statusChanged(IcqContact *contact, Status &status, const TL
 {
     if (status.type() == Status::Offline) {
         status.removeExtendedInfo("xstatus"); // Offline contacts cannot have xstatus
+        contact->setProperty("xtrazHash", QVariant());
         return;
     }
     SessionDataItemMap statusNoteData(tlvs.value(0x1D));
@@ -339,11 +349,21 @@ void XStatusHandler::statusChanged(IcqContact *contact, Status &status, const TL
     }
     XStatus xstatus = findXStatus(contact, moodIndex);
     if (!xstatus.name.isEmpty()) {
-        setXstatus(status, xstatus.value, xstatus.icon);
+        // Keep title and description received for the same xstatus, the answer
+        // on the auto request will be dropped as unchanged one
+        QVariantHash previous = contact->status().extendedInfo("xstatus");
+        if (contact->property("xtrazHash").isValid()
+                && previous.value("icon").value<ExtensionIcon>().name() == xstatus.icon.name()) {
+            status.setExtendedInfo("xstatus", previous);
+        } else {
+            contact->setProperty("xtrazHash", QVariant());
+            setXstatus(status, xstatus.value, xstatus.icon);
+        }
         if (m_xstatusAutoRequest)
             XStatusRequester::updateXStatus(contact);
     } else {
         status.removeExtendedInfo("xstatus");
+        contact->setProperty("xtrazHash", QVariant());
     }
     foreach (const Capability &cap, contact->capabilities()) {
         if (qipstatuses.contains(cap)) {
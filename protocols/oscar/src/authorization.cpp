@@ -149,11 +149,20 @@ void Authorization::onGrantAuthClicked(QObject *object)
 {
 	Q_ASSERT(qobject_cast<IcqContact*>(object) != 0);
 	IcqContact *contact = reinterpret_cast<IcqContact*>(object);
-	SNAC snac(ListsFamily, ListsGrantAuth);
-	snac.append<quint8>(contact->id());
-	snac.append<quint16>(QString()); // reason length
-	snac.append<quint16>(0); // unknown
-	contact->account()->connection()->send(snac);
+	grantAuthorization(QList<IcqContact*>() << contact);
+}
+
+void Authorization::grantAuthorization(const QList<IcqContact*> &contacts)
+{
+	// Protocol has no bulk grant, so SNACs are only queued by connection
+	// at once and are sent according to rate limits of the account
+	foreach (IcqContact *contact, contacts) {
+		SNAC snac(ListsFamily, ListsGrantAuth);
+		snac.append<quint8>(contact->id());
+		snac.append<quint16>(QString()); // reason length
+		snac.append<quint16>(0); // unknown
+		contact->account()->connection()->send(snac);
+	}
 }
 
 void Authorization::onAuthChanged(IcqContact *contact, bool auth)
@@ -33,6 +33,8 @@ namespace qutim_sdk_0_3 {
 
 namespace oscar {
 
+class IcqContact;
+
 class AuthorizeActionGenerator : public ActionGenerator
 {
 public:
@@ -49,6 +51,7 @@ class Authorization : public QObject, public SNACHandler, public FeedbagItemHand
 public:
     Authorization();
 	static Authorization *instance() { Q_ASSERT(self); return self; }
+	void grantAuthorization(const QList<IcqContact*> &contacts);
 protected:
 	void handleSNAC(AbstractConnection *conn, const SNAC &snac);
 	bool handleFeedbagItem(Feedbag *feedbag, const FeedbagItem &item, Feedbag::ModifyType type, FeedbagError error);
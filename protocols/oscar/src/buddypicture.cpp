@@ -27,6 +27,8 @@
 #include "qutim/systeminfo.h"
 #include "qutim/protocol.h"
 #include <qutim/debug.h>
+#include <qutim/avatarstore.h>
+#include <qutim/metrics.h>
 #include "icqaccount_p.h"
 #include "sessiondataitem.h"
 #include <QSet>
@@ -35,6 +37,8 @@
 #include <QImage>
 #include <QNetworkProxy>
 #include <QCryptographicHash>
+#include <QStringBuilder>
+#include <QTimerEvent>
 
 namespace qutim_sdk_0_3 {
 
@@ -42,8 +46,12 @@ namespace oscar {
 
 QByteArray BuddyPicture::emptyHash = QByteArray::fromHex("0201d20472");
 
+// Avatar service connection is closed after this time without requests
+// and is established again by the next one
+enum { ServiceIdleTimeout = 120000 };
+
 BuddyPicture::BuddyPicture(IcqAccount *account, QObject *parent) :
-	AbstractConnection(account, parent), m_avatars(false), m_startup(true)
+	AbstractConnection(account, parent), m_avatars(false), m_startup(true), m_serviceRequested(false)
 {
 	updateSettings();
 	m_infos << SNACInfo(ServiceFamily, ServerRedirectService)
@@ -57,16 +65,22 @@ BuddyPicture::BuddyPicture(IcqAccount *account, QObject *parent) :
 	account->registerRosterPlugin(this);
 	connect(account, SIGNAL(settingsUpdated()), this, SLOT(updateSettings()));
 
+	// Hashes were kept in account config before the shared store appeared
 	Config cfg = account->config("avatars");
-	QStringList removedIds;
-	QMapIterator<QString,QVariant> it(cfg.value("hashes", QVariantMap()));
-	while (it.hasNext()) {
-		IcqContact *contact = account->getContact(it.next().key());
-		if (!contact || !setAvatar(contact, QByteArray::fromHex(it.value().toString().toLatin1())))
-			removedIds << it.key();
+	QVariantMap legacy = cfg.value("hashes", QVariantMap());
+	if (!legacy.isEmpty()) {
+		for (QVariantMap::const_iterator it = legacy.constBegin(); it != legacy.constEnd(); ++it)
+			AvatarStore::bind(bindingKey(it.key()), alias(QByteArray::fromHex(it.value().toString().toLatin1())));
+		cfg.remove("hashes");
+	}
+
+	QHash<QString, QString> bindings = AvatarStore::bindings(bindingKey(QString()));
+	for (QHash<QString, QString>::const_iterator it = bindings.constBegin(); it != bindings.constEnd(); ++it) {
+		IcqContact *contact = account->getContact(it.key());
+		QByteArray hash = QByteArray::fromHex(it.value().mid(6).toLatin1());
+		if (!contact || !setAvatar(contact, hash))
+			AvatarStore::bind(bindingKey(it.key()), QString());
 	}
-	for (int i = 0; i < removedIds.size(); i++)
-		cfg.remove(removedIds.at(i));
 	m_startup = false;
 }
 
@@ -85,10 +99,32 @@ void BuddyPicture::sendUpdatePicture(QObject *reqObject, quint16 id, quint8 flag
 	snac.append<quint16>(id);
 	snac.append<quint8>(flags);
 	snac.append<quint8>(hash);
-	if (state() == Connected)
+	sendServiceSnac(reqObject, snac);
+}
+
+void BuddyPicture::sendServiceSnac(QObject *key, const SNAC &snac)
+{
+	if (state() == Connected) {
 		send(snac);
-	else
-		m_history.insert(reqObject, snac);
+		m_idleTimer.start(ServiceIdleTimeout, this);
+	} else {
+		// Requests wait for the single service connection being established
+		m_history.insert(key, snac);
+		requestService();
+	}
+}
+
+void BuddyPicture::requestService()
+{
+	if (!m_avatars || m_serviceRequested || state() != Unconnected)
+		return;
+	AbstractConnection *conn = account()->connection();
+	if (conn->state() != Connected)
+		return;
+	SNAC snac(ServiceFamily, ServiceClientNewService);
+	snac.append<quint16>(AvatarFamily);
+	conn->send(snac);
+	m_serviceRequested = true;
 }
 
 void BuddyPicture::setAccountAvatar(const QString &avatar)
@@ -126,6 +162,7 @@ void BuddyPicture::handleSNAC(AbstractConnection *conn, const SNAC &snac)
 			foreach (SNAC snac, m_history)
 				send(snac);
 			m_history.clear();
+			m_idleTimer.start(ServiceIdleTimeout, this);
 		}
 	} else {
 		if (snac.family() == ServiceFamily && snac.subtype() == ServerRedirectService) {
@@ -134,15 +171,14 @@ void BuddyPicture::handleSNAC(AbstractConnection *conn, const SNAC &snac)
 			if (id == AvatarFamily) {
 				QList<QByteArray> list = tlvs.value(0x05).data().split(':');
 				m_cookie = tlvs.value(0x06).data();
+				m_serviceRequested = false;
 				socket()->connectToHost(list.at(0), list.size() > 1 ? atoi(list.at(1).constData()) : 5190);
 			}
 		} else if (snac.family() == ServiceFamily && snac.subtype() == ServiceServerAsksServices) {
-			if (m_avatars) {
-				// Requesting avatar service
-				SNAC snac(ServiceFamily, ServiceClientNewService);
-				snac.append<quint16>(AvatarFamily);
-				conn->send(snac);
-			}
+			// New BOS session, so older service request will never be answered.
+			// Connection is opened in advance as avatars are requested on login.
+			m_serviceRequested = false;
+			requestService();
 		}
 	}
 	switch ((snac.family() << 16) | snac.subtype()) {
@@ -161,6 +197,7 @@ void BuddyPicture::handleSNAC(AbstractConnection *conn, const SNAC &snac)
 		QByteArray image = snac.read<QByteArray, quint16>();
 		qDebug() << "BuddyPicture: avatar of" << obj->property("name") << "received";
 		saveImage(obj, image, hash);
+		m_idleTimer.start(ServiceIdleTimeout, this);
 		break;
 	}
 	case ServiceFamily << 16 | ServiceServerExtstatus: { // account avatar changed
@@ -175,7 +212,7 @@ void BuddyPicture::handleSNAC(AbstractConnection *conn, const SNAC &snac)
 					SNAC snac(AvatarFamily, AvatarUploadRequest);
 					snac.append<quint16>(1); // reference number ?
 					snac.append<quint16>(m_accountAvatar);
-					send(snac);
+					sendServiceSnac(this, snac);
 				}
 				setAvatar(account(), hash);
 			}
@@ -250,10 +287,31 @@ void BuddyPicture::statusChanged(IcqContact *contact, Status &status, const TLVM
 
 void BuddyPicture::onDisconnect()
 {
-	m_history.clear();
-	m_avatarHash.clear();
-	m_accountAvatar.clear();
+	m_idleTimer.stop();
 	AbstractConnection::onDisconnect();
+	// Service connection may be closed while the account is still online,
+	// pending requests are sent by the new one then
+	if (m_history.isEmpty() || account()->connection()->state() != Connected) {
+		m_history.clear();
+		m_avatarHash.clear();
+		m_accountAvatar.clear();
+	} else {
+		requestService();
+	}
+}
+
+void BuddyPicture::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_idleTimer.timerId()) {
+		m_idleTimer.stop();
+		if (state() == Connected && m_history.isEmpty() && m_avatarHash.isEmpty()) {
+			static Counter *closes = Metrics::counter("qutim_oscar_idle_service_closes_total", QStringLiteral("service=\"buddypicture\""));
+			closes->add();
+			disconnectFromHost();
+		}
+		return;
+	}
+	AbstractConnection::timerEvent(event);
 }
 
 void BuddyPicture::updateSettings()
@@ -272,6 +330,16 @@ QString BuddyPicture::getAvatarDir() const
 			.arg(account()->protocol()->id());
 }
 
+QString BuddyPicture::bindingKey(const QString &id) const
+{
+	return account()->protocol()->id() % QLatin1Char('/') % account()->id() % QLatin1Char('/') % id;
+}
+
+QString BuddyPicture::alias(const QByteArray &hash)
+{
+	return QLatin1String("oscar:") + QString::fromLatin1(hash.toHex());
+}
+
 bool BuddyPicture::setAvatar(QObject *obj, const QByteArray &hash)
 {
 	if (obj->property("iconHash").toByteArray() == hash)
@@ -281,11 +349,19 @@ bool BuddyPicture::setAvatar(QObject *obj, const QByteArray &hash)
 		updateData(obj, hash, "");
 		return true;
 	} else {
-		QFileInfo file(getAvatarDir() + hash.toHex());
-		if (file.exists()) {
+		QString path = AvatarStore::path(alias(hash));
+		if (path.isEmpty()) {
+			// Move avatar from the old per protocol cache to the shared store
+			QFile file(getAvatarDir() + hash.toHex());
+			if (file.open(QIODevice::ReadOnly)) {
+				path = AvatarStore::store(file.readAll(), alias(hash));
+				file.remove();
+			}
+		}
+		if (!path.isEmpty()) {
 			qDebug() << "BuddyPicture:" << obj->property("name") << "has avatar and it is already in cache:" <<
 					hash.toHex();
-			updateData(obj, hash, file.filePath());
+			updateData(obj, hash, path);
 			return true;
 		}
 	}
@@ -301,23 +377,15 @@ void BuddyPicture::updateData(QObject *obj, const QByteArray &hash, const QStrin
 	} else {
 		obj->setProperty("avatar", path);
 	}
-	if (!m_startup) {
-		Config cfg = account()->config("avatars").group("hashes");
-		cfg.setValue(obj->property("id").toString(), QString::fromLatin1(hash.toHex()));
-	}
+	if (!m_startup)
+		AvatarStore::bind(bindingKey(obj->property("id").toString()), alias(hash));
 }
 
 void BuddyPicture::saveImage(QObject *obj, const QByteArray &image, const QByteArray &hash)
 {
 	if (!image.isEmpty()) {
-		QString imagePath = getAvatarDir();
-		QDir dir(imagePath);
-		if (!dir.exists())
-			dir.mkpath(imagePath);
-		imagePath += hash.toHex();
-		QFile iconFile(imagePath);
-		if (!iconFile.exists() && iconFile.open(QIODevice::WriteOnly)) {
-			iconFile.write(image);
+		QString imagePath = AvatarStore::store(image, alias(hash));
+		if (!imagePath.isEmpty()) {
 			updateData(obj, hash, imagePath);
 			qDebug() << "BuddyPicture: avatar of" << obj->property("name") << "stored in cache";
 		}
@@ -31,6 +31,7 @@
 #include "snachandler.h"
 #include "feedbag.h"
 #include "oscarroster.h"
+#include <QBasicTimer>
 
 namespace qutim_sdk_0_3 {
 
@@ -68,13 +69,18 @@ protected:
 	virtual bool handleFeedbagItem(Feedbag *feedbag, const FeedbagItem &item, Feedbag::ModifyType type, FeedbagError error);
 	virtual void statusChanged(IcqContact *contact, Status &status, const TLVMap &tlvs);
 	void onDisconnect();
+	void timerEvent(QTimerEvent *event);
 private slots:
 	void updateSettings();
 private:
 	inline QString getAvatarDir() const;
+	inline QString bindingKey(const QString &id) const;
+	static inline QString alias(const QByteArray &hash);
 	inline bool setAvatar(QObject *obj, const QByteArray &hash);
 	inline void updateData(QObject *obj, const QByteArray &hash, const QString &path);
 	void saveImage(QObject *obj, const QByteArray &image, const QByteArray &hash);
+	void sendServiceSnac(QObject *key, const SNAC &snac);
+	void requestService();
 private:
 	QHash<QObject*, SNAC> m_history;
 	bool m_is_connected;
@@ -83,6 +89,9 @@ private:
 	QByteArray m_accountAvatar;
 	QByteArray m_avatarHash;
 	bool m_startup;
+	// Service was asked from BOS and the redirect is not handled yet
+	bool m_serviceRequested;
+	QBasicTimer m_idleTimer;
 	static QByteArray emptyHash;
 };
 
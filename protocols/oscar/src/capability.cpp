@@ -185,9 +185,14 @@ Capabilities::const_iterator Capabilities::find(const Capability &capability, qu
 {
 	if (len == UpToFirstZero)
 		len = capability.nonZeroLength();
+	// First four bytes are data1, so compare it directly before converting
+	// both capabilities to byte order
+	const bool checkData1 = len >= 4;
 	const_iterator itr = constBegin();
 	const const_iterator end_itr = constEnd();
 	for (; itr != end_itr; ++itr) {
+		if (checkData1 && itr->data1 != capability.data1)
+			continue;
 		if (itr->match(capability, len))
 			break;
 	}
@@ -29,12 +29,17 @@
 #include <QCoreApplication>
 #include <QNetworkProxy>
 #include <qutim/networkproxy.h>
-#include <qutim/systemintegration.h>
+#include <qutim/socketoptions.h>
 
 namespace qutim_sdk_0_3 {
 
 namespace oscar {
 
+// Limits of packets handled per single readyRead, so the event loop
+// still gets control during roster download or offline messages replay
+enum { MaxFlapsPerRead = 64, MaxReadTime = 20 /* msec */ };
+enum { MaxRateTimeDiff = 86400000, MaxCoalescedSnacSize = 0x1f00 };
+
 ProtocolError::ProtocolError(const SNAC &snac)
 {
 	m_code = snac.read<qint16>();
@@ -109,6 +114,13 @@ OscarRate::OscarRate(const SNAC &sn, AbstractConnection *conn) :
 	update(sn);
 }
 
+OscarRate::~OscarRate()
+{
+	const int queued = m_highPriorityQueue.size() + m_lowPriorityQueue.size();
+	if (queued > 0)
+		m_conn->d_func()->metrics.queued(-queued);
+}
+
 void OscarRate::update(const SNAC &sn)
 {
 	m_windowSize = sn.read<quint32>();
@@ -128,28 +140,78 @@ void OscarRate::update(const SNAC &sn)
 #else
 	sn.skipData(1);
 #endif
-	m_time = QDateTime::currentDateTime().addMSecs(-qint32(m_lastTimeDiff));
+	if (!m_clock.isValid())
+		m_clock.start();
+	m_lastSendTime = m_clock.elapsed() - m_lastTimeDiff;
 	m_defaultPriority = (m_clearLevel + m_maxLevel) / 2;
 }
 
 void OscarRate::send(const SNAC &snac, bool priority)
 {
-	QQueue<SNAC> &queue = priority ? m_highPriorityQueue : m_lowPriorityQueue;
-	queue.enqueue(snac);
-	if (!m_timer.isActive()) {
+	QQueue<QueuedSnac> &queue = priority ? m_highPriorityQueue : m_lowPriorityQueue;
+	if (!coalesce(queue, snac)) {
+		const QueuedSnac queued = { snac, m_clock.nsecsElapsed() / 1000 };
+		queue.enqueue(queued);
+		AbstractConnectionPrivate *d = m_conn->d_func();
+		d->initMetrics();
+		d->metrics.queued(1);
+	}
+	// Recalculate the wake up time, it's lower for high priority packets
+	if (!m_timer.isActive() || priority)
 		sendNextPackets();
-		if (!queue.isEmpty())
-			m_timer.start(500, this);
+}
+
+bool OscarRate::coalesce(QQueue<QueuedSnac> &queue, const SNAC &snac)
+{
+	if (queue.isEmpty() || snac.family() != ListsFamily)
+		return false;
+	SNAC &last = queue.last().snac;
+	if (last.family() != ListsFamily)
+		return false;
+	// Two queued modification transactions are joined into single one
+	if (last.subtype() == ListsCliModifyEnd && snac.subtype() == ListsCliModifyStart) {
+		queue.removeLast();
+		m_conn->d_func()->metrics.queued(-1);
+		return true;
+	}
+	// Server acknowledges every item of the modification separately, so
+	// items of the same operation may share one packet
+	if (last.subtype() != snac.subtype()
+	        || (snac.subtype() != ListsAddToList
+	            && snac.subtype() != ListsUpdateGroup
+	            && snac.subtype() != ListsRemoveFromList)
+	        || last.data().size() + snac.data().size() > MaxCoalescedSnacSize) {
+		return false;
 	}
+	last.append(snac.data());
+	return true;
 }
 
 bool OscarRate::testRate(bool priority)
 {
-	quint32 timeDiff = getTimeDiff(QDateTime::currentDateTime());
-	quint32 newLevel = (m_currentLevel * (m_windowSize - 1) + timeDiff) / m_windowSize;
+	quint32 newLevel = nextLevel(m_currentLevel, timeDiff());
 	return newLevel > (priority ? m_clearLevel : m_defaultPriority);
 }
 
+qint64 OscarRate::drainTime() const
+{
+	// Replay sendNextPackets assuming every packet is sent as soon as possible
+	quint32 level = m_currentLevel;
+	quint32 diff = timeDiff();
+	qint64 total = 0;
+	for (int i = 0; i < 2; ++i) {
+		const int count = i == 0 ? m_highPriorityQueue.size() : m_lowPriorityQueue.size();
+		const quint32 threshold = i == 0 ? m_clearLevel : m_defaultPriority;
+		for (int j = 0; j < count; ++j) {
+			const qint64 wait = waitTime(level, diff, threshold);
+			total += wait;
+			level = qMin(nextLevel(level, diff + wait), m_maxLevel);
+			diff = 0;
+		}
+	}
+	return total;
+}
+
 void OscarRate::timerEvent(QTimerEvent *event)
 {
 	if (event->timerId() == m_timer.timerId())
@@ -159,10 +221,9 @@ void OscarRate::timerEvent(QTimerEvent *event)
 void OscarRate::sendNextPackets()
 {
 	Q_ASSERT(!m_highPriorityQueue.isEmpty() || !m_lowPriorityQueue.isEmpty());
-	QDateTime dateTime = QDateTime::currentDateTime();
-	quint32 timeDiff = getTimeDiff(dateTime);
+	const qint64 now = m_clock.elapsed();
+	quint32 diff = timeDiff();
 
-	quint32 newLevel;
 	forever {
 		bool priority = !m_highPriorityQueue.isEmpty();
 		if (!priority && m_lowPriorityQueue.isEmpty()) {
@@ -170,27 +231,39 @@ void OscarRate::sendNextPackets()
 			break;
 		}
 
-		newLevel = (m_currentLevel * (m_windowSize - 1) + timeDiff) / m_windowSize;
-		if (newLevel < (priority ? m_clearLevel : m_defaultPriority))
+		const quint32 threshold = priority ? m_clearLevel : m_defaultPriority;
+		const quint32 newLevel = nextLevel(m_currentLevel, diff);
+		if (newLevel < threshold) {
+			// Wake up exactly when the level allows to send the next packet
+			m_timer.start(int(waitTime(m_currentLevel, diff, threshold)), Qt::PreciseTimer, this);
 			break;
+		}
 
-		SNAC snac = priority ? m_highPriorityQueue.dequeue() : m_lowPriorityQueue.dequeue();
-		m_lastTimeDiff = timeDiff;
-		m_time = dateTime;
-		timeDiff = 0;
+		QueuedSnac queued = priority ? m_highPriorityQueue.dequeue() : m_lowPriorityQueue.dequeue();
+		m_conn->d_func()->metrics.dequeued(m_clock.nsecsElapsed() / 1000 - queued.queued);
+		m_lastTimeDiff = diff;
+		m_lastSendTime = now;
+		diff = 0;
 		m_currentLevel = qMin(newLevel, m_maxLevel);
-		m_conn->sendSnac(snac);
+		m_conn->sendSnac(queued.snac);
 	}
 }
 
-quint32 OscarRate::getTimeDiff(const QDateTime &dateTime)
+quint32 OscarRate::timeDiff() const
 {
-	if (dateTime.date() == m_time.date())
-		return m_time.time().msecsTo(dateTime.time());
-	else if (m_time.daysTo(dateTime) == 1)
-		return 86400000 - m_time.time().msec() + dateTime.time().msec();
-	else // That should never happen
-		return 86400000;
+	return quint32(qBound<qint64>(0, m_clock.elapsed() - m_lastSendTime, MaxRateTimeDiff));
+}
+
+qint64 OscarRate::waitTime(quint32 level, quint32 timeDiff, quint32 threshold) const
+{
+	// nextLevel(level, timeDiff + wait) >= threshold
+	const qint64 wait = qint64(threshold) * m_windowSize - qint64(level) * (m_windowSize - 1) - timeDiff;
+	return qBound<qint64>(0, wait, MaxRateTimeDiff);
+}
+
+quint32 OscarRate::nextLevel(quint32 level, quint32 timeDiff) const
+{
+	return (level * (m_windowSize - 1) + timeDiff) / m_windowSize;
 }
 
 AbstractConnection::AbstractConnection(IcqAccount *account, QObject *parent) :
@@ -248,8 +321,10 @@ void AbstractConnection::registerHandler(SNACHandler *handler)
 {
 	Q_D(AbstractConnection);
 	QList<SNACInfo> infos = handler->infos();
-	foreach(const SNACInfo &info, infos)
-		d->handlers.insertMulti((info.first << 16) | info.second, handler);
+	foreach(const SNACInfo &info, infos) {
+		// Last registered handler goes first, as it was with QMultiMap
+		d->handlers[(info.first << 16) | info.second].prepend(handler);
+	}
 }
 
 void AbstractConnection::disconnectFromHost(bool force)
@@ -283,6 +358,21 @@ const Socket *AbstractConnection::socket() const
 	return d_func()->socket;
 };
 
+quint64 AbstractConnection::receivedPackets() const
+{
+	return d_func()->receivedFlaps;
+}
+
+int AbstractConnection::packetsPerSecond() const
+{
+	return d_func()->packetsPerSecond;
+}
+
+qint64 AbstractConnection::backlogSize() const
+{
+	return d_func()->socket->bytesAvailable();
+}
+
 AbstractConnection::ConnectionError AbstractConnection::error()
 {
 	return d_func()->error;
@@ -455,7 +545,10 @@ void AbstractConnection::send(FLAP &flap)
 	Q_D(AbstractConnection);
 	flap.setSeqNum(d->seqNum());
 	//debug(VeryVerbose) << "FLAP:" << flap.toByteArray().toHex().constData();
-	d->socket->write(flap);
+	const QByteArray data = flap.toByteArray();
+	d->socket->write(data);
+	d->initMetrics();
+	d->metrics.sent(data.size());
 	//d->socket->flush();
 }
 
@@ -465,6 +558,15 @@ bool AbstractConnection::testRate(quint16 family, quint16 subtype, bool priority
 	return rate ? rate->testRate(priority) : true;
 }
 
+qint64 AbstractConnection::queueDrainTime(quint16 family, quint16 subtype) const
+{
+	Q_D(const AbstractConnection);
+	OscarRate *rate = d->ratesHash.value(family << 16 | subtype);
+	if (!rate)
+		rate = d->rates.value(1);
+	return rate ? rate->drainTime() : 0;
+}
+
 quint32 AbstractConnection::sendSnac(SNAC &snac)
 {
 	Q_D(AbstractConnection);
@@ -684,13 +786,13 @@ void AbstractConnection::processSnac()
 					  .arg(snac.family(), 4, 16, QChar('0'))
 					  .arg(snac.subtype(), 4, 16, QChar('0'))
 					  .arg(metaObject()->className());
-	bool found = false;
-	foreach(SNACHandler *handler, d->handlers.values((snac.family() << 16)| snac.subtype())) {
-		found = true;
+	// Shared copy keeps the list valid even if some handler registers another one
+	const QVector<SNACHandler*> list = d->handlers.value((snac.family() << 16) | snac.subtype());
+	for (int i = 0; i < list.size(); ++i) {
 		snac.resetState();
-		handler->handleSNAC(this, snac);
+		list.at(i)->handleSNAC(this, snac);
 	}
-	if (!found) {
+	if (list.isEmpty()) {
 		qWarning() << QString("No handlers for SNAC(0x%1, 0x%2) in %3")
 					 .arg(snac.family(), 4, 16, QChar('0'))
 					 .arg(snac.subtype(), 4, 16, QChar('0'))
@@ -705,41 +807,74 @@ void AbstractConnection::readData()
 		qDebug() << "readyRead emmited but the socket is empty";
 		return;
 	}
-	if (d->flap.readData(d->socket)) {
-		if (d->flap.isFinished()) {
-			switch (d->flap.channel()) {
-			case 0x01:
-				processNewConnection();
-				break;
-			case 0x02:
-				processSnac();
-				break;
-			case 0x04:
-				processCloseConnection();
-				break;
-			default:
-				qDebug() << "Unknown shac channel" << hex << d->flap.channel();
-			case 0x03:
-				break;
-			case 0x05:
-				qDebug() << "Connection alive!";
-				break;
-			}
-			d->flap.clear();
+	QElapsedTimer timer;
+	timer.start();
+	d->initMetrics();
+	const qint64 available = d->socket->bytesAvailable();
+	int flaps = 0;
+	while (d->socket->bytesAvailable() > 0) {
+		if (!d->flap.readData(d->socket)) {
+			qCritical() << "Strange situation at" << Q_FUNC_INFO << ":" << __LINE__;
+			d->socket->close();
+			return;
 		}
-		// Just give a chance to other parts of qutIM to do something if needed
-		if (d->socket->bytesAvailable())
-			QTimer::singleShot(0, this, SLOT(readData()));
-	} else {
-		qCritical() << "Strange situation at" << Q_FUNC_INFO << ":" << __LINE__;
-		d->socket->close();
+		if (!d->flap.isFinished())
+			continue;
+		switch (d->flap.channel()) {
+		case 0x01:
+			processNewConnection();
+			break;
+		case 0x02:
+			processSnac();
+			break;
+		case 0x04:
+			processCloseConnection();
+			break;
+		default:
+			qDebug() << "Unknown shac channel" << hex << d->flap.channel();
+		case 0x03:
+			break;
+		case 0x05:
+			qDebug() << "Connection alive!";
+			break;
+		}
+		d->flap.clear();
+		++d->receivedFlaps;
+		if (++flaps >= MaxFlapsPerRead || timer.elapsed() >= MaxReadTime)
+			break;
 	}
+	d->metrics.received(available - d->socket->bytesAvailable(), flaps);
+	d->updatePacketRate();
+	// Just give a chance to other parts of qutIM to do something if needed
+	if (d->socket->bytesAvailable())
+		QTimer::singleShot(0, this, SLOT(readData()));
+}
+
+void AbstractConnectionPrivate::initMetrics()
+{
+	if (!metrics.isValid())
+		metrics = SocketMetrics(account);
+}
+
+void AbstractConnectionPrivate::updatePacketRate()
+{
+	if (!rateTimer.isValid()) {
+		rateTimer.start();
+		rateFlaps = receivedFlaps;
+		return;
+	}
+	const qint64 elapsed = rateTimer.elapsed();
+	if (elapsed < 1000)
+		return;
+	packetsPerSecond = (receivedFlaps - rateFlaps) * 1000 / elapsed;
+	rateFlaps = receivedFlaps;
+	rateTimer.restart();
 }
 
 void AbstractConnection::stateChanged(QAbstractSocket::SocketState state)
 {
 	if (state == QAbstractSocket::ConnectedState)
-		SystemIntegration::keepAlive(d_func()->socket);
+		SocketOptions::load(d_func()->account).apply(d_func()->socket);
 
 	qWarning() << "New connection state" << state << this->metaObject()->className();
 	if (state == QAbstractSocket::UnconnectedState) {
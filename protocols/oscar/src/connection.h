@@ -161,6 +161,8 @@ public:
 	void send(SNAC &snac, bool priority = true);
 	void sendSnac(quint16 family, quint16 subtype, bool priority = true);
 	bool testRate(quint16 family, quint16 subtype, bool priority = true);
+	// Projected time in msecs till packets queued for this snac's rate class are sent
+	qint64 queueDrainTime(quint16 family, quint16 subtype) const;
 	virtual void disconnectFromHost(bool force = false);
 	const QHostAddress &externalIP() const;
 	const QList<quint16> &servicesList();
@@ -173,6 +175,9 @@ public:
 	const ClientInfo &clientInfo();
 	bool isSslEnabled();
 	State state() const;
+	quint64 receivedPackets() const;
+	int packetsPerSecond() const;
+	qint64 backlogSize() const;
 	void registerInitializationSnacs(const QList<SNACInfo> &snacs, bool append = true);
 	void registerInitializationSnac(quint16 family, quint16 subtype);
 signals:
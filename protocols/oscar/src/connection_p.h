@@ -31,7 +31,10 @@
 #include "icqaccount.h"
 #include <QTimer>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QQueue>
+#include <QVector>
+#include <qutim/metrics.h>
 
 namespace qutim_sdk_0_3 {
 
@@ -44,18 +47,28 @@ class OscarRate: public QObject
 	Q_OBJECT
 public:
 	OscarRate(const SNAC &sn, AbstractConnection *conn);
-	virtual ~OscarRate() {}
+	virtual ~OscarRate();
 	void update(const SNAC &sn);
 	quint16 groupId() { return m_groupId; }
 	void send(const SNAC &snac, bool priority);
 	bool isEmpty() { return m_windowSize <= 1; }
 	bool testRate(bool priority);
 	bool startTimeout();
+	qint64 drainTime() const;
 protected:
 	void timerEvent(QTimerEvent *event);
 private:
+	struct QueuedSnac
+	{
+		SNAC snac;
+		// Microseconds of m_clock
+		qint64 queued;
+	};
 	void sendNextPackets();
-	quint32 getTimeDiff(const QDateTime &dateTime);
+	bool coalesce(QQueue<QueuedSnac> &queue, const SNAC &snac);
+	quint32 timeDiff() const;
+	qint64 waitTime(quint32 level, quint32 timeDiff, quint32 threshold) const;
+	quint32 nextLevel(quint32 level, quint32 timeDiff) const;
 private:
 	quint16 m_groupId;
 	quint32 m_windowSize;
@@ -69,9 +82,11 @@ private:
 	quint32 m_disconnectLevel;
 	quint8 m_currentState;
 #endif
-	QDateTime m_time;
-	QQueue<SNAC> m_lowPriorityQueue;
-	QQueue<SNAC> m_highPriorityQueue;
+	// Monotonic clock, m_lastSendTime is measured by it
+	QElapsedTimer m_clock;
+	qint64 m_lastSendTime;
+	QQueue<QueuedSnac> m_lowPriorityQueue;
+	QQueue<QueuedSnac> m_highPriorityQueue;
 	QBasicTimer m_timer;
 	quint32 m_defaultPriority;
 	AbstractConnection *m_conn;
@@ -80,11 +95,15 @@ private:
 class AbstractConnectionPrivate
 {
 public:
+	AbstractConnectionPrivate() : receivedFlaps(0), rateFlaps(0), packetsPerSecond(0) {}
+	void initMetrics();
 	inline quint16 seqNum() { return seqnum++; }
+	void updatePacketRate();
 	inline quint32 nextId() { return id++; }
 	Socket *socket;
 	FLAP flap;
-	QMultiMap<quint32, SNACHandler*> handlers;
+	// (family << 16 | subtype) -> handlers in dispatch order, built at registration
+	QHash<quint32, QVector<SNACHandler*> > handlers;
 	quint16 seqnum;
 	quint32 id;
 	ClientInfo clientInfo;
@@ -98,6 +117,11 @@ public:
 	AbstractConnection::State state;
 	QSet<SNACInfo> initSnacs; // Snacs that are allowed when initializing connection
 	QTimer aliveTimer;
+	quint64 receivedFlaps;
+	quint64 rateFlaps;
+	int packetsPerSecond;
+	QElapsedTimer rateTimer;
+	SocketMetrics metrics;
 };
 
 } } // namespace qutim_sdk_0_3::oscar
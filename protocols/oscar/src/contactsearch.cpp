@@ -66,7 +66,7 @@ void OscarContactSearch::start(const DataItem &fields)
 	Status::Type status = m_account->status().type();
 	MetaInfoValuesHash values = MetaField::dataItemToHash(fields);
 	if (status >= Status::Online && status <= Status::Invisible) {
-		Q_ASSERT(!m_request);
+		// New search supersedes the running one, its results are dropped
 		m_request.reset(new FindContactsMetaRequest(m_account, values));
 		connect(m_request.data(), SIGNAL(contactFound(FindContactsMetaRequest::FoundContact)),
 				SLOT(onNewContact(FindContactsMetaRequest::FoundContact)));
@@ -165,9 +165,8 @@ Contact *OscarContactSearch::contact(int row)
 void OscarContactSearch::onNewContact(const FindContactsMetaRequest::FoundContact &contact)
 {
 	int row = m_contacts.count();
-	emit rowAboutToBeAdded(row);
 	m_contacts.push_back(contact);
-	emit rowAdded(row);
+	emit rowsAdded(row, row);
 }
 
 void OscarContactSearch::onDone(bool ok)
@@ -27,8 +27,8 @@
 #include "icqcontact.h"
 #include "icqaccount_p.h"
 #include "icq_global.h"
+#include "cookietable_p.h"
 #include <QDateTime>
-#include <QTimer>
 
 namespace qutim_sdk_0_3 {
 
@@ -40,7 +40,6 @@ public:
 	CookiePrivate(quint64 _id = 0):
 		id(_id), member(0)
 	{
-		timer.setSingleShot(true);
 	}
 
 	quint64 id;
@@ -48,7 +47,6 @@ public:
 	IcqAccount *account;
 	mutable QObject *receiver;
 	mutable QLatin1String member;
-	mutable QTimer timer;
 };
 
 Cookie::Cookie(bool generate):
@@ -104,12 +102,9 @@ void Cookie::lock(QObject *receiver, const char *member, int msec) const
 	Q_D(const Cookie);
 	Q_ASSERT(d->account);
 	Q_ASSERT(!isEmpty());
-	d->account->d_func()->cookies.insert(d->id, *this);
-	d->timer.setProperty("cookieId", d->id);
-	QObject::connect(&d->timer, SIGNAL(timeout()), d->account, SLOT(onCookieTimeout()));
 	d->receiver = receiver;
 	d->member = QLatin1String(member);
-	d->timer.start(msec);
+	d->account->d_func()->cookies.insert(*this, msec);
 }
 
 bool Cookie::unlock() const
@@ -118,7 +113,6 @@ bool Cookie::unlock() const
 	Q_ASSERT(d->account);
 	Cookie cookie = d->account->d_func()->cookies.take(d->id);
 	if (!cookie.isEmpty()) {
-		cookie.d_func()->timer.stop();
 		d->receiver = 0;
 		d->member = QLatin1String(0);
 		return true;
@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "cookietable_p.h"
+#include <QMetaMethod>
+#include <QTimerEvent>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+CookieTable::CookieTable() :
+	m_wheel(WheelSize), m_current(0)
+{
+}
+
+CookieTable::~CookieTable()
+{
+}
+
+void CookieTable::insert(const Cookie &cookie, int msec)
+{
+	take(cookie.id());
+	// One tick more, so cookie never expires earlier than it was asked
+	const int ticks = qMax(msec, 0) / TickInterval + 1;
+	Entry entry;
+	entry.cookie = cookie;
+	entry.slot = (m_current + ticks) % WheelSize;
+	entry.rounds = (ticks - 1) / WheelSize;
+	m_entries.insert(cookie.id(), entry);
+	m_wheel[entry.slot].insert(cookie.id());
+	if (!m_timer.isActive())
+		m_timer.start(TickInterval, this);
+}
+
+Cookie CookieTable::take(quint64 id)
+{
+	QHash<quint64, Entry>::iterator it = m_entries.find(id);
+	if (it == m_entries.end())
+		return Cookie();
+	Cookie cookie = it->cookie;
+	m_wheel[it->slot].remove(id);
+	m_entries.erase(it);
+	if (m_entries.isEmpty())
+		m_timer.stop();
+	return cookie;
+}
+
+void CookieTable::timerEvent(QTimerEvent *ev)
+{
+	if (ev->timerId() != m_timer.timerId()) {
+		QObject::timerEvent(ev);
+		return;
+	}
+	m_current = (m_current + 1) % WheelSize;
+	QList<Cookie> expired;
+	QSet<quint64> &slot = m_wheel[m_current];
+	for (QSet<quint64>::iterator it = slot.begin(); it != slot.end();) {
+		Entry &entry = m_entries[*it];
+		if (entry.rounds > 0) {
+			--entry.rounds;
+			++it;
+		} else {
+			expired << entry.cookie;
+			m_entries.remove(*it);
+			it = slot.erase(it);
+		}
+	}
+	if (m_entries.isEmpty())
+		m_timer.stop();
+	// Receivers may lock new cookies, so they are called after the wheel is updated
+	foreach (const Cookie &cookie, expired)
+		expire(cookie);
+}
+
+void CookieTable::expire(Cookie cookie)
+{
+	QObject *receiver = cookie.receiver();
+	const char *member = cookie.member();
+	if (receiver && member) {
+		const QMetaObject *metaObject = receiver->metaObject();
+		int index = metaObject->indexOfMethod(QMetaObject::normalizedSignature(member));
+		if (index != -1) {
+			metaObject->method(index).invoke(receiver, Qt::AutoConnection, Q_ARG(Cookie, cookie));
+		}
+	}
+}
+
+} } // namespace qutim_sdk_0_3::oscar
@@ -0,0 +1,77 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef COOKIETABLE_P_H
+#define COOKIETABLE_P_H
+
+#include "cookie.h"
+#include <QBasicTimer>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+// Locked cookies of an account. Timeouts are kept in a hashed timing wheel
+// driven by single timer, so insert, remove and expire are O(1) regardless
+// of the number of outstanding cookies.
+class CookieTable : public QObject
+{
+	Q_OBJECT
+public:
+	enum {
+		WheelSize = 64,
+		TickInterval = 500,
+		// Senders should wait while the table is full
+		MaxCookies = 256
+	};
+	CookieTable();
+	~CookieTable();
+	void insert(const Cookie &cookie, int msec);
+	Cookie take(quint64 id);
+	bool contains(quint64 id) const { return m_entries.contains(id); }
+	int count() const { return m_entries.count(); }
+	bool isFull() const { return m_entries.count() >= MaxCookies; }
+protected:
+	void timerEvent(QTimerEvent *ev);
+private:
+	void expire(Cookie cookie);
+	struct Entry
+	{
+		Cookie cookie;
+		int slot;
+		int rounds;
+	};
+	QHash<quint64, Entry> m_entries;
+	QVector<QSet<quint64> > m_wheel;
+	int m_current;
+	QBasicTimer m_timer;
+};
+
+} } // namespace qutim_sdk_0_3::oscar
+
+#endif // COOKIETABLE_P_H
@@ -43,6 +43,7 @@ enum ByteOrder
 
 class TLV;
 class TLVMap;
+class DataUnitView;
 
 class LIBOSCAR_EXPORT DataUnit
 {
@@ -54,6 +55,7 @@ public:
 	operator QByteArray() const { return data(); }
 	void setData(const QByteArray &data) { m_data = data; m_state = 0; }
 	inline QByteArray readData(uint size) const;
+	inline DataUnitView readView(uint size) const;
 	inline void skipData(uint num) const { m_state = qMin<uint>(m_state + num, m_data.size()); }
 	inline void resetState() const { m_state = 0; }
 	inline uint dataSize() const { return m_data.size() > m_state ? m_data.size() - m_state : 0; }
@@ -99,6 +101,16 @@ private:
 	mutable int m_state;
 };
 
+// Unit over the data of another unit without copying it. It is valid only
+// while the original data is alive and unmodified, so it fits for parsing
+// inside of a handler, but not for storing.
+class DataUnitView : public DataUnit
+{
+public:
+	DataUnitView() {}
+	DataUnitView(const char *data, int size) : DataUnit(QByteArray::fromRawData(data, size)) {}
+};
+
 QByteArray DataUnit::readData(uint size) const
 {
 	QByteArray str;
@@ -108,6 +120,14 @@ QByteArray DataUnit::readData(uint size) const
 	return str;
 }
 
+DataUnitView DataUnit::readView(uint size) const
+{
+	size = qMin(dataSize(), size);
+	DataUnitView view(m_data.constData() + m_state, size);
+	m_state += size;
+	return view;
+}
+
 
 QByteArray DataUnit::readAll() const
 {
@@ -363,6 +383,21 @@ struct fromDataUnitHelper<DataUnit, false>
 	}
 };
 
+template<>
+struct fromDataUnitHelper<DataUnitView, false>
+{
+	template<class L>
+	static inline DataUnitView fromByteArray(const DataUnit &d, L count, ByteOrder)
+	{
+		return d.readView(count);
+	}
+
+	static inline DataUnitView fromByteArray(const DataUnit &d)
+	{
+		return d.readView(d.dataSize());
+	}
+};
+
 template<typename T>
 T DataUnit::read() const
 {
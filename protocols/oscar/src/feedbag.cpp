@@ -29,6 +29,7 @@
 #include "oscarconnection.h"
 #include "icqaccount.h"
 #include <qutim/protocol.h>
+#include <qutim/rosterstorage.h>
 #include <qutim/debug.h>
 #include <QCoreApplication>
 #include <QQueue>
@@ -41,6 +42,9 @@ namespace qutim_sdk_0_3 {
 
 namespace oscar {
 
+// Keeps acks of a single modification SNAC reasonably small
+enum { MaxItemsPerSnac = 100 };
+
 QString getCompressedName(quint16 type, const QString &name)
 {
 	QString compressedName;
@@ -116,6 +120,7 @@ struct FeedbagGroup
 
 typedef QHash<QPair<quint16, quint16>, FeedbagItem> AllItemsHash;
 typedef QHash<quint16, FeedbagGroup> GroupHash;
+typedef QHash<QPair<quint16, QString>, QSet<quint16> > GroupsByNameHash;
 
 
 struct FeedbagRootGroup : public FeedbagGroup
@@ -132,8 +137,14 @@ public:
 	    : account(acc), conn(static_cast<OscarConnection*>(acc->connection())), q_ptr(q) {}
 	void handleItem(FeedbagItem &item, Feedbag::ModifyType type, FeedbagError error);
 	FeedbagGroup *findGroup(quint16 id);
+	void insertItem(const FeedbagItem &item);
+	void removeItem(const FeedbagItem &item);
+	void insertTemporaryBuddy(const FeedbagItem &item);
+	void clearTemporaryBuddies();
 	quint16 generateId() const;
 	void finishLoading();
+	int queuedAdditions(quint16 type) const;
+	bool isIdQueued(quint16 type, quint16 id) const;
 	static QEvent::Type updateEvent();
 	FeedbagItemPrivate *getFeedbagItemPrivate(const SNAC &snac);
 	void updateList();
@@ -142,6 +153,10 @@ public:
 	AllItemsHash itemsById;
 	QHash<quint16, QSet<quint16> > itemsByType;
 	QHash<QString, FeedbagItem> temporaryBuddies;
+	// Buddy name to ids of the groups containing it
+	GroupsByNameHash groupsByName;
+	// Item ids of temporaryBuddies with number of buddies sharing them
+	QHash<quint16, int> temporaryBuddyIds;
 	
 	QList<FeedbagItem> itemsList;
 	FeedbagRootGroup root;
@@ -231,9 +246,8 @@ void FeedbagItemPrivate::send(const FeedbagItem &item, Feedbag::ModifyType opera
 			break;
 		}
 	}
-	if (item.type() == SsiBuddy) {
-		d->temporaryBuddies.insert(getCompressedName(SsiBuddy, item.name()), item);
-	}
+	if (item.type() == SsiBuddy)
+		d->insertTemporaryBuddy(item);
 	d->modifyQueue.append(FeedbagQueueItem(item, operation));
 }
 
@@ -270,7 +284,7 @@ bool FeedbagItemPrivate::isSendingAllowed(const FeedbagItem &item, Feedbag::Modi
 	}
 	if (operation == Feedbag::Add) {
 		quint16 limit = d->limits.value(item.type());
-		if (limit > 0 && d->itemsByType.value(item.type()).size() >= limit) {
+		if (limit > 0 && d->itemsByType.value(item.type()).size() + d->queuedAdditions(item.type()) >= limit) {
 			qWarning() << "Limit for feedbag item type" << item.type() << "exceeded";
 			return false;
 		}
@@ -535,25 +549,11 @@ void FeedbagPrivate::handleItem(FeedbagItem &item, Feedbag::ModifyType type, Fee
 	} else {
 		if (type == Feedbag::Remove) {
 			item.d->isInList = false;
-			itemsById.remove(id);
-			if (item.type() == SsiGroup) {
-				root.regulars.remove(item.groupId());
-			} else {
-				FeedbagGroup *group = findGroup(item.groupId());
-				Q_ASSERT(!group->item.isNull());
-				group->hashByName.remove(item.pairName());
-			}
+			removeItem(item);
 		} else {
 			item.d->isInList = true;
-			itemsById.insert(id, item);
-			FeedbagGroup *group = findGroup(item.groupId());
-			if (item.type() == SsiGroup) {
-				group->item = item;
-				root.hashByName.insert(item.pairName(), item.groupId());
-			} else {
-				Q_ASSERT(!group->item.isNull());
-				group->hashByName.insert(item.pairName(), item.itemId());
-			}
+			Q_ASSERT(item.type() == SsiGroup || !findGroup(item.groupId())->item.isNull());
+			insertItem(item);
 		}
 	}
 	
@@ -635,6 +635,98 @@ FeedbagGroup *FeedbagPrivate::findGroup(quint16 id)
 	return &root.regulars[id];
 }
 
+void FeedbagPrivate::insertItem(const FeedbagItem &item)
+{
+	itemsById.insert(item.pairId(), item);
+	itemsByType[item.type()].insert(item.d->id());
+	FeedbagGroup *group = findGroup(item.groupId());
+	if (item.type() == SsiGroup) {
+		group->item = item;
+		root.hashByName.insert(item.pairName(), item.groupId());
+	} else {
+		group->hashByName.insert(item.pairName(), item.itemId());
+		if (item.groupId() != 0)
+			groupsByName[item.pairName()].insert(item.groupId());
+	}
+}
+
+void FeedbagPrivate::removeItem(const FeedbagItem &item)
+{
+	itemsById.remove(item.pairId());
+	QHash<quint16, QSet<quint16> >::Iterator typeIt = itemsByType.find(item.type());
+	if (typeIt != itemsByType.end()) {
+		typeIt->remove(item.d->id());
+		if (typeIt->isEmpty())
+			itemsByType.erase(typeIt);
+	}
+	if (item.type() == SsiGroup) {
+		GroupHash::Iterator it = root.regulars.find(item.groupId());
+		if (it == root.regulars.end())
+			return;
+		// Buddies are not reachable any more through the removed group
+		for (ItemsNameHash::ConstIterator jt = it->hashByName.constBegin();
+		     jt != it->hashByName.constEnd(); ++jt) {
+			GroupsByNameHash::Iterator groups = groupsByName.find(jt.key());
+			if (groups == groupsByName.end())
+				continue;
+			groups->remove(item.groupId());
+			if (groups->isEmpty())
+				groupsByName.erase(groups);
+		}
+		root.regulars.erase(it);
+	} else {
+		FeedbagGroup *group = findGroup(item.groupId());
+		Q_ASSERT(!group->item.isNull());
+		group->hashByName.remove(item.pairName());
+		GroupsByNameHash::Iterator groups = groupsByName.find(item.pairName());
+		if (groups != groupsByName.end()) {
+			groups->remove(item.groupId());
+			if (groups->isEmpty())
+				groupsByName.erase(groups);
+		}
+	}
+}
+
+void FeedbagPrivate::insertTemporaryBuddy(const FeedbagItem &item)
+{
+	const QString name = getCompressedName(SsiBuddy, item.name());
+	QHash<QString, FeedbagItem>::Iterator it = temporaryBuddies.find(name);
+	if (it != temporaryBuddies.end()) {
+		QHash<quint16, int>::Iterator idIt = temporaryBuddyIds.find(it->itemId());
+		if (idIt != temporaryBuddyIds.end() && --idIt.value() == 0)
+			temporaryBuddyIds.erase(idIt);
+		it.value() = item;
+	} else {
+		temporaryBuddies.insert(name, item);
+	}
+	++temporaryBuddyIds[item.itemId()];
+}
+
+void FeedbagPrivate::clearTemporaryBuddies()
+{
+	temporaryBuddies.clear();
+	temporaryBuddyIds.clear();
+}
+
+int FeedbagPrivate::queuedAdditions(quint16 type) const
+{
+	int count = 0;
+	foreach (const FeedbagQueueItem &queueItem, modifyQueue) {
+		if (queueItem.type == Feedbag::Add && queueItem.item.type() == type)
+			++count;
+	}
+	return count;
+}
+
+bool FeedbagPrivate::isIdQueued(quint16 type, quint16 id) const
+{
+	foreach (const FeedbagQueueItem &queueItem, modifyQueue) {
+		if (queueItem.type == Feedbag::Add && queueItem.item.pairId() == qMakePair(type, id))
+			return true;
+	}
+	return false;
+}
+
 quint16 FeedbagPrivate::generateId() const
 {
 	return rand() & 0x7fff; //0x03e6;
@@ -668,7 +760,7 @@ FeedbagItemPrivate *FeedbagPrivate::getFeedbagItemPrivate(const SNAC &snac)
 		return 0;
 	}
 	FeedbagItemPrivate *item = new FeedbagItemPrivate(q_func(), itemType, itemId, groupId, recordName);
-	item->tlvs = snac.read<DataUnit, quint16>().read<TLVMap>();
+	item->tlvs = snac.read<DataUnitView, quint16>().read<TLVMap>();
 	return item;
 }
 
@@ -695,7 +787,7 @@ void FeedbagPrivate::updateList()
 {
 	if (modifyQueue.isEmpty())
 		return;
-	temporaryBuddies.clear();
+	clearTemporaryBuddies();
 	conn->sendSnac(ListsFamily, ListsCliModifyStart);
 //	qStableSort(modifyQueue.begin(), modifyQueue.end(), feedbagItemLessThan);
 	SNAC snac;
@@ -706,17 +798,19 @@ void FeedbagPrivate::updateList()
 		if (item)
 			qDebug() << item->type << item->item;
 		QByteArray data = item ? item->item.d->data(item->type) : QByteArray();
-		if (!item || item->type != snac.subtype() || !snac.canAppend(data.size())) {
+		if (!item || item->type != snac.subtype() || !snac.canAppend(data.size())
+				|| items.size() >= MaxItemsPerSnac) {
 			if (!items.isEmpty()) {
 				itemsForRequests.append(items);
 				items.clear();
 				conn->send(snac);
 			}
-			if (item) {
+			if (item)
 				snac = SNAC(ListsFamily, item->type);
-				items.append(*item);
-			}
 		}
+		// Server acks every item of the SNAC by its own error code
+		if (item)
+			items.append(*item);
 		snac.append(data);
 	}
 	conn->sendSnac(ListsFamily, ListsCliModifyEnd);
@@ -731,6 +825,7 @@ void FeedbagPrivate::updateFeedbagList()
 	qSwap(allItems, itemsById);
 	itemsById.reserve(upToDateItems.size());
 	const FeedbagError noError(FeedbagError::NoError);
+	RosterTransaction transaction(account);
 	foreach (FeedbagItem item, upToDateItems) {
 		const QPair<quint16, quint16> id = item.pairId();
 		FeedbagItem oldItem = allItems.take(id);
@@ -770,15 +865,7 @@ Feedbag::Feedbag(IcqAccount *acc):
 		if (item.isNull())
 			continue;
 		item.d->feedbag = this;
-		d->itemsById.insert(item.pairId(), item);
-		d->itemsByType[item.type()].insert(item.d->id());
-		FeedbagGroup *group = d->findGroup(item.groupId());
-		if (item.type() == SsiGroup) {
-			group->item = item;
-			d->root.hashByName.insert(item.pairName(), item.groupId());
-		} else {
-			group->hashByName.insert(item.pairName(), item.itemId());
-		}
+		d->insertItem(item);
 	}
 	cfg.endGroup();
 	connect(acc, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
@@ -893,10 +980,11 @@ QList<FeedbagItem> Feedbag::items(quint16 type, const QString &name, ItemLoadFla
 	qDebug() << Q_FUNC_INFO << __LINE__ << type << name << flags;
 	if (!(flags & DontLoadLocal)) {
 		if (type == SsiBuddy) {
-			for (GroupHash::Iterator it = d->root.regulars.begin();
-				 it != d->root.regulars.end(); ++it) {
-				ItemsNameHash::ConstIterator jt = it.value().hashByName.constFind(qMakePair(type, uniqueName));
-				if (jt != it.value().hashByName.constEnd()) {
+			const QPair<quint16, QString> pairName = qMakePair(type, uniqueName);
+			foreach (quint16 groupId, d->groupsByName.value(pairName)) {
+				const FeedbagGroup &group = d->root.regulars.value(groupId);
+				ItemsNameHash::ConstIterator jt = group.hashByName.constFind(pairName);
+				if (jt != group.hashByName.constEnd()) {
 					const quint16 id = jt.value();
 					FeedbagItem item = d->itemsById.value(qMakePair(type, id));
 					if (!item.isNull()) {
@@ -961,12 +1049,7 @@ bool Feedbag::containsItem(quint16 type, const QString &name) const
 {
 	const QString uniqueName = getCompressedName(type, name);
 	if (type == SsiBuddy) {
-		for (GroupHash::Iterator it = d->root.regulars.begin();
-		     it != d->root.regulars.end(); ++it) {
-			if (it.value().hashByName.contains(qMakePair(type, uniqueName)))
-				return true;
-		}
-		return false;
+		return d->groupsByName.contains(qMakePair(type, uniqueName));
 	} else {
 		return d->root.hashByName.contains(qMakePair(type, uniqueName));
 	}
@@ -978,17 +1061,11 @@ quint16 Feedbag::uniqueItemId(quint16 type) const
 		quint16 id = d->generateId();
 		if (d->itemsById.contains(qMakePair(type, id)))
 			continue;
-		if (type == SsiBuddy) {
-			bool ok = true;
-			foreach (const FeedbagItem &item, d->temporaryBuddies) {
-				if (item.itemId() == id) {
-					ok = false;
-					break;
-				}
-			}
-			if (!ok)
-				continue;
-		}
+		if (type == SsiBuddy && d->temporaryBuddyIds.contains(id))
+			continue;
+		// Items added by the same batch are not in the list yet
+		if (d->isIdQueued(type, id))
+			continue;
 		return id;
 	}
 }
@@ -1092,14 +1169,18 @@ void Feedbag::handleSNAC(AbstractConnection *conn, const SNAC &sn)
 			d->lastUpdateTime = sn.read<quint32>();
 			d->updateFeedbagList();
 			d->account->config().remove("feedbag"); // TODO: remove it.
-			Config cfg = config();
-			cfg.remove("feedbag");
-			cfg = cfg.group("feedbag");
+			// Update only changed part of the cache instead of rewriting it
+			Config cfg = config().group("feedbag");
 			cfg.setValue("lastUpdateTime", d->lastUpdateTime);
 			cfg.beginGroup("cache");
+			QSet<QString> staleItems = cfg.childKeys().toSet();
 			foreach (const FeedbagItem &item, d->itemsById) {
-				cfg.setValue(item.d->configId(), QVariant::fromValue(item));
+				const QString id = item.d->configId();
+				staleItems.remove(id);
+				cfg.setValue(id, QVariant::fromValue(item));
 			}
+			foreach (const QString &id, staleItems)
+				cfg.remove(id);
 			cfg.endGroup();
 			d->finishLoading();
 		}
@@ -1147,7 +1228,7 @@ void Feedbag::handleSNAC(AbstractConnection *conn, const SNAC &sn)
 		break;
 	// Server sends SSI service limitations to client
 	case ListsFamily << 16 | ListsSrvReplyLists: {
-		TLVMap tlvs = sn.read<TLVMap>();
+		TLVMapView tlvs = sn.read<TLVMapView>();
 		if (tlvs.contains(0x04)) {
 			DataUnit data = tlvs.value(0x04);
 			while (data.dataSize() >= 2)
@@ -1163,7 +1244,7 @@ void Feedbag::statusChanged(const qutim_sdk_0_3::Status &current, const qutim_sd
 	if (current == Status::Offline && previous != Status::Offline) {
 		d->modifyQueue.clear();
 		d->itemsForRequests.clear();
-		d->temporaryBuddies.clear();
+		d->clearTemporaryBuddies();
 		d->itemsList.clear();
 	}
 }
@@ -313,6 +313,11 @@ bool IcqAccount::isHtmlEnabled() const
 	return d_func()->htmlEnabled;
 }
 
+int IcqAccount::sendDelay() const
+{
+	return int(connection()->queueDrainTime(MessageFamily, MessageSrvSend));
+}
+
 void IcqAccount::updateSettings()
 {
 	Q_D(IcqAccount);
@@ -351,25 +356,4 @@ void IcqAccount::onContactRemoved()
 	Q_ASSERT(itr != endItr);
 }
 
-void IcqAccount::onCookieTimeout()
-{
-	Q_D(IcqAccount);
-	Q_ASSERT(qobject_cast<QTimer*>(sender()));
-	QTimer *timer = static_cast<QTimer*>(sender());
-	quint64 id = timer->property("cookieId").value<quint64>();
-	Q_ASSERT(id != 0);
-	Cookie cookie = d->cookies.take(id);
-	Q_ASSERT(!cookie.isEmpty());
-	QObject *receiver = cookie.receiver();
-	const char *member = cookie.member();
-	if (receiver && member) {
-		const QMetaObject *metaObject = receiver->metaObject();
-		int index = metaObject->indexOfMethod(QMetaObject::normalizedSignature(member));
-		if (index != -1) {
-			metaObject->method(index).invoke(receiver, Qt::AutoConnection, Q_ARG(Cookie, cookie));
-		}
-	}
-	// cookie.unlock(); // Commented out as this cookie is already unlocked
-}
-
 } } // namespace qutim_sdk_0_3::oscar
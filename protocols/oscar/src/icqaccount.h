@@ -48,6 +48,7 @@ class LIBOSCAR_EXPORT IcqAccount: public Account
 	Q_DECLARE_PRIVATE(IcqAccount)
 	Q_PROPERTY(QString avatar WRITE setAvatar READ avatar NOTIFY avatarChanged)
 	Q_PROPERTY(bool htmlEnabled READ isHtmlEnabled WRITE setHtmlEnabled NOTIFY htmlEnabledChanged)
+	Q_PROPERTY(int sendDelay READ sendDelay)
 public:
 	IcqAccount(const QString &uin);
 	virtual ~IcqAccount();
@@ -75,6 +76,8 @@ public:
 	void registerRosterPlugin(RosterPlugin *plugin);
 	void setProxy(const QNetworkProxy &proxy);
 	bool isHtmlEnabled() const;
+	// Msecs until a message sent now leaves the client, according to server rates
+	int sendDelay() const;
 
 signals:
 	void avatarChanged(const QString &avatar);
@@ -89,7 +92,6 @@ public slots:
 
 private slots:
 	void onContactRemoved();
-	void onCookieTimeout();
 protected:
 	void finishLogin();
 private:
@@ -100,6 +102,7 @@ private:
 	friend class IcqProtocol;
 	friend class IcqContact;
 	friend class MessagesHandler;
+	friend class MessageSender;
 	QScopedPointer<IcqAccountPrivate> d_ptr;
 	bool m_htmlEnabled;
 };
@@ -29,6 +29,7 @@
 
 #include "icqaccount.h"
 #include "messages_p.h"
+#include "cookietable_p.h"
 #include <QTimer>
 #include "buddypicture.h"
 #include <qutim/passworddialog.h>
@@ -65,7 +66,7 @@ public:
 	QString name;
 	QString avatar;
 	bool htmlEnabled;
-	QHash<quint64, Cookie> cookies;
+	CookieTable cookies;
 	Capabilities caps;
 	QHash<QString, Capability> typedCaps;
 	OscarStatus lastStatus;
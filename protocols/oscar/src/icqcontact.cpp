@@ -329,7 +329,7 @@ void IcqContact::setStatus(const Status &status, bool notification)
 {
 	Q_D(IcqContact);
 	Status previous = d->status;
-	d->status = status;
+	d->status = Status::intern(status);
 	if (status == Status::Offline) {
 		d->clearCapabilities();
 		emit capabilitiesChanged(Capabilities());
@@ -345,7 +345,7 @@ void IcqContact::setStatus(const Status &status, bool notification)
 		NotificationRequest request(this, status, previous);
 		request.send();
 	}
-	emit statusChanged(status, previous);
+	emit statusChanged(d->status, previous);
 }
 
 ChatUnit::ChatState IcqContact::chatState() const
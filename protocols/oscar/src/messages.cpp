@@ -35,6 +35,7 @@
 #include <qutim/notification.h>
 #include <QHostAddress>
 #include <QApplication>
+#include <QCache>
 
 namespace qutim_sdk_0_3 {
 
@@ -42,6 +43,10 @@ namespace oscar {
 
 using namespace Util;
 
+// Server usually ends the replay by 0x0042 in a moment, the timeout just
+// guards against servers which never send it
+enum { OfflineMessagesTimeout = 15000 };
+
 Channel1MessageData::Channel1MessageData(const QString &message, Channel1Codec charset)
 {
 	init(fromUnicode(message, charset), charset);
@@ -278,7 +283,7 @@ void MessagesHandler::handleSNAC(AbstractConnection *conn, const SNAC &sn)
 		break;
 	}
 	case ExtensionsFamily << 16 | ExtensionsMetaSrvReply: {
-		TLVMap tlvs = sn.read<TLVMap>();
+		TLVMapView tlvs = sn.read<TLVMapView>();
 		if (tlvs.contains(0x01)) {
 			DataUnit data(tlvs.value(0x01));
 			data.skipData(6); // skip length field + my uin
@@ -289,6 +294,8 @@ void MessagesHandler::handleSNAC(AbstractConnection *conn, const SNAC &sn)
 				// It seems it's not used anymore.
 				break;
 			case (0x0042):
+				// End of offline messages.
+				flushOfflineMessages(conn->account());
 				// Delete offline messages from the server.
 				sendMetaInfoRequest(conn->account(), 0x003E);
 				break;
@@ -312,7 +319,11 @@ void MessagesHandler::loginFinished()
 	IcqAccount *account = qobject_cast<IcqAccount*>(sender());
 	Q_ASSERT(account);
 	// Offline messages request
+	m_offlineMessages.insert(account, OfflineMessages());
 	sendMetaInfoRequest(account, 0x003C);
+	QTimer::singleShot(OfflineMessagesTimeout, account, [this, account] () {
+		flushOfflineMessages(account);
+	});
 }
 
 void MessagesHandler::settingsUpdated()
@@ -327,11 +338,30 @@ void MessagesHandler::accountAdded(Account *account)
 	Q_ASSERT(qobject_cast<IcqAccount*>(account));
 	connect(account, SIGNAL(loginFinished()), SLOT(loginFinished()));
 	connect(account, SIGNAL(settingsUpdated()), SLOT(settingsUpdated()));
+	connect(account, SIGNAL(destroyed(QObject*)), SLOT(accountDestroyed(QObject*)));
 	AbstractConnection *conn = static_cast<IcqAccount*>(account)->connection();
 	conn->registerInitializationSnac(MessageFamily, MessageCliReqIcbm);
 	conn->registerInitializationSnac(MessageFamily, MessageCliSetParams);
 }
 
+void MessagesHandler::accountDestroyed(QObject *object)
+{
+	m_offlineMessages.remove(static_cast<IcqAccount*>(object));
+}
+
+void MessagesHandler::flushOfflineMessages(IcqAccount *account)
+{
+	QHash<IcqAccount*, OfflineMessages>::iterator itr = m_offlineMessages.find(account);
+	if (itr == m_offlineMessages.end())
+		return;
+	OfflineMessages messages = *itr;
+	m_offlineMessages.erase(itr);
+	for (int i = 0; i < messages.size(); ++i) {
+		if (ChatSession *session = messages.at(i).first.data())
+			session->append(messages.at(i).second);
+	}
+}
+
 void MessagesHandler::handleMessage(IcqAccount *account, const SNAC &snac)
 {
 	quint64 cookie = snac.read<quint64>();
@@ -346,7 +376,7 @@ void MessagesHandler::handleMessage(IcqAccount *account, const SNAC &snac)
 	quint16 warning = snac.read<quint16>();
 	Q_UNUSED(warning);
 	snac.skipData(2); // unused number of tlvs
-	TLVMap tlvs = snac.read<TLVMap>();
+	TLVMapView tlvs = snac.read<TLVMapView>();
 	QString message;
 	switch (channel) {
 	case 0x0001: // message
@@ -388,7 +418,19 @@ void MessagesHandler::handleMessage(IcqAccount *account, const SNAC &snac)
 		} else {
 			m.setText(message);
 		}
-		session->appendMessage(m);
+		QHash<IcqAccount*, OfflineMessages>::iterator itr = m_offlineMessages.find(account);
+		// Only offline messages have the time they were sent at
+		if (itr != m_offlineMessages.end() && tlvs.contains(0x0016)) {
+			OfflineMessages &messages = *itr;
+			int i = 0;
+			while (i < messages.size() && messages.at(i).first.data() != session)
+				++i;
+			if (i == messages.size())
+				messages << qMakePair(QPointer<ChatSession>(session), MessageList());
+			messages[i].second << m;
+		} else {
+			session->appendMessage(m);
+		}
 	} else if (!contact->isInList()) {
 		contact->deleteLater();
 	}
@@ -419,7 +461,7 @@ QString MessagesHandler::handleChannel1Message(IcqContact *contact, const TLVMap
 	QString message;
 	if (tlvs.contains(0x0002)) {
 		DataUnit data(tlvs.value(0x0002));
-		TLVMap msg_tlvs = data.read<TLVMap>();
+		TLVMapView msg_tlvs = data.read<TLVMapView>();
 		if (msg_tlvs.contains(0x0501))
 			qWarning() << "Message has" << msg_tlvs.value(0x0501).data().toHex().constData() << "caps";
 		foreach(const TLV &tlv, msg_tlvs.values(0x0101))
@@ -462,7 +504,7 @@ QString MessagesHandler::handleChannel2Message(IcqContact *contact, const TLVMap
 				qDebug() << "Abort messages on channel 2 is ignored";
 				return QString();
 			}
-			TLVMap tlvs = data.read<TLVMap>();
+			TLVMapView tlvs = data.read<TLVMapView>();
 			quint16 ack = tlvs.value(0x0A).read<quint16>();
 			if (contact) {
 				if (tlvs.contains(0x03))
@@ -661,8 +703,7 @@ bool MessageSender::appendMessage(IcqContact *contact, const Message &message)
 	MessageData msgData(contact, message);
 	if (msgData.msgs.count() > 4)
 		return false; // Message is too long
-	if (m_messages.isEmpty() &&
-		m_account->connection()->testRate(MessageFamily, MessageSrvSend, true))
+	if (m_messages.isEmpty() && canSend())
 	{
 		Q_ASSERT(!m_messagesTimer.isActive());
 		sendMessage(msgData);
@@ -678,7 +719,7 @@ bool MessageSender::appendMessage(IcqContact *contact, const Message &message)
 void MessageSender::sendMessage()
 {
 	QList<MessageData>::iterator itr = m_messages.begin();
-	if (m_account->connection()->testRate(MessageFamily, MessageSrvSend, true)) {
+	if (canSend()) {
 		sendMessage(*itr);
 		if (itr->msgs.isEmpty())
 			m_messages.takeFirst();
@@ -687,6 +728,14 @@ void MessageSender::sendMessage()
 	}
 }
 
+bool MessageSender::canSend()
+{
+	// Messages wait in the queue while too many of them are not acknowledged
+	if (m_account->d_func()->cookies.isFull())
+		return false;
+	return m_account->connection()->testRate(MessageFamily, MessageSrvSend, true);
+}
+
 MessageSender::MessageData::MessageData(IcqContact *contact_, const Message &message_) :
 	contact(contact_), message(message_)
 {
@@ -756,6 +805,33 @@ static QList<QByteArray> splitMessage(const QByteArray &message, quint16 maxLen,
 	return list;
 }
 
+enum EncodingMode
+{
+	Channel1Utf16,
+	Channel2Utf8,
+	Channel2Ascii
+};
+
+struct EncodedMessage
+{
+	QList<QByteArray> msgs;
+	quint8 channel;
+	bool utfEnabled;
+};
+
+// Key is encoding mode with mib of ascii codec and the text
+typedef QPair<qint64, QString> EncodedMessageKey;
+
+/*
+ The same text sent to many contacts is encoded and split only once,
+ recipient-specific parts of packets are built by sendMessage().
+ */
+static QCache<EncodedMessageKey, EncodedMessage> *encodedMessages()
+{
+	static QCache<EncodedMessageKey, EncodedMessage> cache(256 * 1024);
+	return &cache;
+}
+
 void MessageSender::prepareMessage(IcqContact *contact, MessageSender::MessageData &data, const Message &message)
 {
 	IcqContactPrivate *d = contact->d_func();
@@ -765,18 +841,39 @@ void MessageSender::prepareMessage(IcqContact *contact, MessageSender::MessageDa
 		msgText = message.property("html").toString();
 	if (msgText.isEmpty())
 		msgText = message.text();
-	if (!(d->flags & srvrelay_support)) {
+
+	EncodingMode mode = !(d->flags & srvrelay_support) ? Channel1Utf16
+					  : (d->flags & utf8_support) ? Channel2Utf8 : Channel2Ascii;
+	qint64 codecKey = mode == Channel2Ascii ? Util::asciiCodec()->mibEnum() : 0;
+	EncodedMessageKey key((codecKey << 8) | mode, msgText);
+	if (EncodedMessage *cached = encodedMessages()->object(key)) {
+		data.msgs = cached->msgs;
+		data.channel = cached->channel;
+		data.utfEnabled = cached->utfEnabled;
+		return;
+	}
+
+	if (mode == Channel1Utf16) {
 		QByteArray buf = Channel1MessageData::fromUnicode(msgText, CodecUtf16Be);
 		data.msgs = splitMessage(buf, 2542); // Max: 2543
 		data.channel = 1;
 		data.utfEnabled = false;
 	} else {
-		data.msgs = (d->flags & utf8_support)
+		data.msgs = mode == Channel2Utf8
 					? splitMessage(Util::utf8Codec()->fromUnicode(msgText), 7857, sf_utf8 | sf_appendNull)
 					: splitMessage(Util::asciiCodec()->fromUnicode(msgText), 7898, sf_appendNull);
 		data.channel = 2;
-		data.utfEnabled = d->flags & utf8_support;
+		data.utfEnabled = mode == Channel2Utf8;
 	}
+
+	EncodedMessage *encoded = new EncodedMessage;
+	encoded->msgs = data.msgs;
+	encoded->channel = data.channel;
+	encoded->utfEnabled = data.utfEnabled;
+	int cost = msgText.size() * 2;
+	foreach (const QByteArray &msg, data.msgs)
+		cost += msg.size();
+	encodedMessages()->insert(key, encoded, cost);
 }
 
 void MessageSender::sendMessage(MessageData &message)
@@ -28,6 +28,7 @@
 
 #include "messages.h"
 #include <qutim/chatsession.h>
+#include <QPointer>
 
 namespace qutim_sdk_0_3 {
 
@@ -48,7 +49,10 @@ private slots:
 	void loginFinished();
 	void settingsUpdated();
 	void accountAdded(qutim_sdk_0_3::Account *account);
+	void accountDestroyed(QObject *object);
 private:
+	typedef QList<QPair<QPointer<ChatSession>, MessageList> > OfflineMessages;
+	void flushOfflineMessages(IcqAccount *account);
 	void handleMessage(IcqAccount *account, const SNAC &snac);
 	void handleResponse(IcqAccount *account, const SNAC &snac);
 	QString handleChannel1Message(IcqContact *contact, const TLVMap &tlvs);
@@ -61,6 +65,9 @@ private:
 	QMultiHash<Capability, MessagePlugin *> m_msg_plugins;
 	QMultiHash<Tlv2711Type, Tlv2711Plugin *> m_tlvs2711Plugins;
 	bool m_detectCodec;
+	// Offline messages replayed after login are collected per session
+	// till the end of the replay and are appended to the chats at once
+	QHash<IcqAccount*, OfflineMessages> m_offlineMessages;
 };
 
 class MessageSender : public QObject
@@ -85,6 +92,7 @@ private:
 		quint64 id;
 	};
 	static void prepareMessage(IcqContact *contact, MessageData &data, const Message &message);
+	bool canSend();
 	void sendMessage(MessageData &message);
 	QList<MessageData> m_messages;
 	QTimer m_messagesTimer;
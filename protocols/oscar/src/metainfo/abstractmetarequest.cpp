@@ -108,9 +108,7 @@ void AbstractMetaRequest::sendRequest(quint16 type, const DataUnit &extendData)
 	tlvData.append<quint16>(data.data().size(), LittleEndian);
 	tlvData.append(data.data());
 	snac.appendTLV(1, tlvData);
-	MetaInfo::instance().addRequest(const_cast<AbstractMetaRequest*>(this));
-	d->account->connection()->send(snac);
-	d->timer.start();
+	MetaInfo::instance().sendRequest(const_cast<AbstractMetaRequest*>(this), snac);
 }
 
 void AbstractMetaRequest::close(bool ok, ErrorType error, const QString &errorString)
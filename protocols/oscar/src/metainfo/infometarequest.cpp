@@ -27,6 +27,9 @@
 #include "../icqaccount.h"
 #include "../icqcontact.h"
 #include "metafields_p.h"
+#include "metainfo_p.h"
+#include "metainfocache_p.h"
+#include <qutim/metrics.h>
 #include <QDate>
 
 namespace qutim_sdk_0_3 {
@@ -85,6 +88,8 @@ QVariant ShortInfoMetaRequest::value(MetaField value, const QVariant &def) const
 void ShortInfoMetaRequest::send() const
 {
 	Q_D(const ShortInfoMetaRequest);
+	if (sendCached(false))
+		return;
 	DataUnit data;
 	data.append<quint32>(d->uin, LittleEndian);
 	sendRequest(0x04ba, data);
@@ -94,6 +99,60 @@ ShortInfoMetaRequest::ShortInfoMetaRequest()
 {
 }
 
+bool ShortInfoMetaRequest::sendCached(bool full) const
+{
+	Q_D(const ShortInfoMetaRequest);
+	ShortInfoMetaRequest *that = const_cast<ShortInfoMetaRequest*>(this);
+	// Own info may be changed by the user, so it's always asked from the server
+	if (d->uin == d->account->id().toUInt())
+		return false;
+	MetaInfoCache *cache = MetaInfo::instance().cache(d->account);
+	if (cache->find(d->uin, full, that->d_func()->values)) {
+		// Callers connect to done() after send(), so don't emit it right now
+		QMetaObject::invokeMethod(that, "onCacheHit", Qt::QueuedConnection);
+		return true;
+	}
+	if (ShortInfoMetaRequest *request = cache->runningRequest(d->uin, full)) {
+		that->d_func()->runningRequest = request;
+		connect(request, SIGNAL(done(bool)), that, SLOT(onRunningRequestDone(bool)));
+		if (full) {
+			connect(request, SIGNAL(infoUpdated(State)), that, SIGNAL(infoUpdated(State)));
+		}
+		return true;
+	}
+	cache->addRunningRequest(d->uin, full, that);
+	return false;
+}
+
+void ShortInfoMetaRequest::onCacheHit()
+{
+	Q_D(ShortInfoMetaRequest);
+	if (d->errorType != NoError)
+		return;
+	static Counter *hits = Metrics::counter("qutim_oscar_info_cache_hits_total");
+	hits->add();
+	close(true);
+}
+
+void ShortInfoMetaRequest::onRunningRequestDone(bool ok)
+{
+	Q_D(ShortInfoMetaRequest);
+	ShortInfoMetaRequest *request = d->runningRequest.data();
+	d->runningRequest.clear();
+	if (!request || d->errorType != NoError)
+		return;
+	if (ok) {
+		d->values = request->values();
+		close(true);
+	} else {
+		// The request was never registered, so close(false) would not emit done()
+		d->ok = false;
+		d->errorType = request->errorType();
+		d->errorString = request->errorString();
+		emit done(false);
+	}
+}
+
 bool ShortInfoMetaRequest::handleData(quint16 type, const DataUnit &data)
 {
 	Q_D(ShortInfoMetaRequest);
@@ -112,6 +171,8 @@ bool ShortInfoMetaRequest::handleData(quint16 type, const DataUnit &data)
 	}
 	qDebug() << d->uin << "short info:";
 	d->dump();
+	if (d->uin != d->account->id().toUInt())
+		MetaInfo::instance().cache(d->account)->insert(d->uin, false, d->values);
 	close(true);
 	return true;
 }
@@ -249,6 +310,8 @@ FullInfoMetaRequest::FullInfoMetaRequest(IcqContact *contact) :
 void FullInfoMetaRequest::send() const
 {
 	Q_D(const FullInfoMetaRequest);
+	if (sendCached(true))
+		return;
 	DataUnit data;
 	data.append<quint32>(d->uin, LittleEndian);
 	sendRequest(0x04b2, data);
@@ -294,6 +357,8 @@ bool FullInfoMetaRequest::handleData(quint16 type, const DataUnit &data)
 	}
 	emit infoUpdated(static_cast<State>(type));
 	if (type == StateAffilations) {
+		if (d->uin != d->account->id().toUInt())
+			MetaInfo::instance().cache(d->account)->insert(d->uin, true, d->values);
 		close(true);
 		qDebug() << d->uin << "full info:";
 		d->dump();
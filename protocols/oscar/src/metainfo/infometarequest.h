@@ -52,6 +52,10 @@ public:
 protected:
 	ShortInfoMetaRequest();
 	virtual bool handleData(quint16 type, const DataUnit &data);
+	bool sendCached(bool full) const;
+private slots:
+	void onCacheHit();
+	void onRunningRequestDone(bool ok);
 };
 
 class LIBOSCAR_EXPORT FullInfoMetaRequest : public ShortInfoMetaRequest
@@ -28,6 +28,7 @@
 
 #include "infometarequest.h"
 #include "abstractmetarequest_p.h"
+#include <QPointer>
 
 namespace qutim_sdk_0_3 {
 
@@ -38,6 +39,7 @@ class ShortInfoMetaRequestPrivate : public AbstractMetaRequestPrivate
 public:
 	MetaInfoValuesHash values;
 	quint32 uin;
+	QPointer<ShortInfoMetaRequest> runningRequest;
 	inline void readString(MetaFieldEnum value, const DataUnit &data);
 	inline void readFlag(MetaFieldEnum value, const DataUnit &data);
 	void dump();
@@ -29,6 +29,7 @@
 #include "../icqprotocol.h"
 #include "../oscarconnection.h"
 #include "metafields_p.h"
+#include "metainfocache_p.h"
 #include <QStringList>
 #include <QDate>
 #include <QEventLoop>
@@ -39,11 +40,17 @@ namespace oscar {
 
 MetaInfo *MetaInfo::self = 0;
 
+// Requests are sent by portions, so a scan over the whole contact list
+// does not hit the rate limits and starve the other services
+enum { MaxRunningRequests = 4, MaxQueueDrainTime = 1000 };
+
 MetaInfo::MetaInfo() :
 	m_sequence(0)
 {
 	Q_ASSERT(!self);
 	self = this;
+	m_queueTimer.setSingleShot(true);
+	connect(&m_queueTimer, SIGNAL(timeout()), this, SLOT(processQueues()));
 	m_infos << SNACInfo(ExtensionsFamily, ExtensionsMetaSrvReply)
 		<< SNACInfo(ExtensionsFamily, ExtensionsMetaError);
 	connect(IcqProtocol::instance(), SIGNAL(accountCreated(qutim_sdk_0_3::Account*)),
@@ -107,13 +114,82 @@ void MetaInfo::addRequest(AbstractMetaRequest *request)
 
 bool MetaInfo::removeRequest(AbstractMetaRequest *request)
 {
-	return m_requests.remove(request->id()) > 0;
+	if (m_requests.remove(request->id()) == 0)
+		return false;
+	IcqAccount *account = request->account();
+	QHash<IcqAccount*, RequestQueue>::iterator itr = m_queues.find(account);
+	if (itr != m_queues.end()) {
+		RequestQueue &queue = *itr;
+		if (!queue.running.remove(request)) {
+			for (int i = 0; i < queue.pending.size(); ++i) {
+				if (queue.pending.at(i).first == request) {
+					queue.pending.removeAt(i);
+					break;
+				}
+			}
+		}
+		processQueue(account, queue);
+	}
+	return true;
+}
+
+void MetaInfo::sendRequest(AbstractMetaRequest *request, const SNAC &snac)
+{
+	addRequest(request);
+	IcqAccount *account = request->account();
+	RequestQueue &queue = m_queues[account];
+	queue.pending << qMakePair(request, snac);
+	processQueue(account, queue);
+}
+
+MetaInfoCache *MetaInfo::cache(IcqAccount *account)
+{
+	MetaInfoCache *&cache = m_caches[account];
+	if (!cache)
+		cache = new MetaInfoCache(account);
+	return cache;
+}
+
+void MetaInfo::processQueues()
+{
+	QHash<IcqAccount*, RequestQueue>::iterator itr = m_queues.begin();
+	for (; itr != m_queues.end(); ++itr)
+		processQueue(itr.key(), *itr);
+}
+
+void MetaInfo::processQueue(IcqAccount *account, RequestQueue &queue)
+{
+	if (account->status() == Status::Offline)
+		return;
+	AbstractConnection *conn = account->connection();
+	while (!queue.pending.isEmpty() && queue.running.size() < MaxRunningRequests) {
+		qint64 drainTime = conn->queueDrainTime(ExtensionsFamily, ExtensionsMetaCliRequest);
+		if (drainTime > MaxQueueDrainTime) {
+			int delay = drainTime - MaxQueueDrainTime;
+			if (!m_queueTimer.isActive() || m_queueTimer.remainingTime() > delay)
+				m_queueTimer.start(delay);
+			return;
+		}
+		QPair<AbstractMetaRequest*, SNAC> pending = queue.pending.takeFirst();
+		queue.running.insert(pending.first);
+		conn->send(pending.second);
+		pending.first->d_func()->timer.start();
+	}
 }
 
 void MetaInfo::onNewAccount(qutim_sdk_0_3::Account *account)
 {
 	connect(account, SIGNAL(statusChanged(qutim_sdk_0_3::Status,qutim_sdk_0_3::Status)),
 			this, SLOT(onAccountStatusChanged(qutim_sdk_0_3::Status)));
+	connect(account, SIGNAL(destroyed(QObject*)), this, SLOT(onAccountDestroyed(QObject*)));
+}
+
+void MetaInfo::onAccountDestroyed(QObject *object)
+{
+	// Cache itself is a child of the account
+	IcqAccount *account = static_cast<IcqAccount*>(object);
+	m_caches.remove(account);
+	m_queues.remove(account);
 }
 
 void MetaInfo::onAccountStatusChanged(const qutim_sdk_0_3::Status &status)
@@ -30,11 +30,14 @@
 #include <QTimer>
 #include "abstractmetarequest_p.h"
 #include "../snachandler.h"
+#include "../snac.h"
 
 namespace qutim_sdk_0_3 {
 
 namespace oscar {
 
+class MetaInfoCache;
+
 class MetaInfo: public QObject, public SNACHandler
 {
 	Q_OBJECT
@@ -46,13 +49,27 @@ public:
 	void handleSNAC(AbstractConnection *conn, const SNAC &snac);
 	void addRequest(AbstractMetaRequest *request);
 	bool removeRequest(AbstractMetaRequest *request);
+	// Sends the request as soon as the account has a free slot for it
+	void sendRequest(AbstractMetaRequest *request, const SNAC &snac);
 	quint16 nextId() { return ++m_sequence; }
+	MetaInfoCache *cache(IcqAccount *account);
 private slots:
 	void onNewAccount(qutim_sdk_0_3::Account *account);
 	void onAccountStatusChanged(const qutim_sdk_0_3::Status &status);
+	void onAccountDestroyed(QObject *object);
+	void processQueues();
 private:
+	struct RequestQueue
+	{
+		QList<QPair<AbstractMetaRequest*, SNAC> > pending;
+		QSet<AbstractMetaRequest*> running;
+	};
+	void processQueue(IcqAccount *account, RequestQueue &queue);
 	quint16 m_sequence;
 	QHash<quint16, AbstractMetaRequest*> m_requests;
+	QHash<IcqAccount*, RequestQueue> m_queues;
+	QHash<IcqAccount*, MetaInfoCache*> m_caches;
+	QTimer m_queueTimer;
 	static MetaInfo *self;
 };
 
@@ -0,0 +1,189 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#include "metainfocache_p.h"
+#include "infometarequest.h"
+#include "../icqaccount.h"
+#include <qutim/systeminfo.h>
+#include <qutim/protocol.h>
+#include <qutim/config.h>
+#include <qutim/debug.h>
+#include <QDataStream>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+enum { CacheMagic = 0x4f4d4943, CacheVersion = 1, SaveDelay = 30000 };
+
+QDataStream &operator<<(QDataStream &out, const Category &category)
+{
+	return out << category.category << category.keyword;
+}
+
+QDataStream &operator>>(QDataStream &in, Category &category)
+{
+	return in >> category.category >> category.keyword;
+}
+
+MetaInfoCache::MetaInfoCache(IcqAccount *account) :
+	QObject(account)
+{
+	static bool streamOperatorsRegistered = false;
+	if (!streamOperatorsRegistered) {
+		qRegisterMetaTypeStreamOperators<CategoryList>("qutim_sdk_0_3::oscar::CategoryList");
+		streamOperatorsRegistered = true;
+	}
+	// Three days by default, personal info is rarely changed
+	m_ttl = account->protocol()->config("general").value("metaInfoCacheTtl", 3 * 24 * 60 * 60) * qint64(1000);
+	m_fileName = QString("%1/cache/%2/%3.metainfo")
+			.arg(SystemInfo::getPath(SystemInfo::ConfigDir))
+			.arg(account->protocol()->id())
+			.arg(account->id());
+	m_saveTimer.setInterval(SaveDelay);
+	m_saveTimer.setSingleShot(true);
+	connect(&m_saveTimer, SIGNAL(timeout()), this, SLOT(save()));
+	load();
+}
+
+MetaInfoCache::~MetaInfoCache()
+{
+	if (m_saveTimer.isActive())
+		save();
+}
+
+bool MetaInfoCache::find(quint32 uin, bool full, MetaInfoValuesHash &values) const
+{
+	QHash<quint32, Entry>::const_iterator itr = m_entries.constFind(uin);
+	if (itr == m_entries.constEnd() || (full && !itr->full) || !isFresh(*itr))
+		return false;
+	values = itr->values;
+	return true;
+}
+
+void MetaInfoCache::insert(quint32 uin, bool full, const MetaInfoValuesHash &values)
+{
+	Entry &entry = m_entries[uin];
+	if (!full && entry.full && isFresh(entry)) {
+		// Short answer only refreshes the fields it knows about
+		for (MetaInfoValuesHash::const_iterator itr = values.constBegin(); itr != values.constEnd(); ++itr)
+			entry.values.insert(itr.key(), itr.value());
+	} else {
+		entry.values = values;
+		entry.time = QDateTime::currentMSecsSinceEpoch();
+		entry.full = full;
+	}
+	if (!m_saveTimer.isActive())
+		m_saveTimer.start();
+}
+
+ShortInfoMetaRequest *MetaInfoCache::runningRequest(quint32 uin, bool full) const
+{
+	ShortInfoMetaRequest *request = m_fullRequests.value(uin).data();
+	if (!request || request->isDone() || request->errorType() != AbstractMetaRequest::NoError) {
+		if (full)
+			return 0;
+		request = m_shortRequests.value(uin).data();
+		if (!request || request->isDone() || request->errorType() != AbstractMetaRequest::NoError)
+			return 0;
+	}
+	return request;
+}
+
+void MetaInfoCache::addRunningRequest(quint32 uin, bool full, ShortInfoMetaRequest *request)
+{
+	if (full)
+		m_fullRequests.insert(uin, request);
+	else
+		m_shortRequests.insert(uin, request);
+}
+
+bool MetaInfoCache::isFresh(const Entry &entry) const
+{
+	return QDateTime::currentMSecsSinceEpoch() - entry.time < m_ttl;
+}
+
+void MetaInfoCache::load()
+{
+	QFile file(m_fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+	quint32 magic, version, count;
+	in >> magic >> version >> count;
+	if (magic != CacheMagic || version != CacheVersion)
+		return;
+	for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+		quint32 uin, fieldsCount;
+		Entry entry;
+		in >> uin >> entry.time >> entry.full >> fieldsCount;
+		for (quint32 j = 0; j < fieldsCount && in.status() == QDataStream::Ok; ++j) {
+			qint32 field;
+			QVariant value;
+			in >> field >> value;
+			entry.values.insert(field, value);
+		}
+		if (isFresh(entry))
+			m_entries.insert(uin, entry);
+	}
+	if (in.status() != QDataStream::Ok) {
+		qWarning() << "Meta info cache is corrupted" << file.fileName();
+		m_entries.clear();
+	}
+}
+
+void MetaInfoCache::save()
+{
+	m_saveTimer.stop();
+	for (QHash<quint32, Entry>::iterator itr = m_entries.begin(); itr != m_entries.end();) {
+		if (isFresh(*itr))
+			++itr;
+		else
+			itr = m_entries.erase(itr);
+	}
+
+	QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+	QSaveFile file(m_fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qWarning() << "Can't save meta info cache" << m_fileName;
+		return;
+	}
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << quint32(CacheMagic) << quint32(CacheVersion) << quint32(m_entries.size());
+	for (QHash<quint32, Entry>::const_iterator itr = m_entries.constBegin(); itr != m_entries.constEnd(); ++itr) {
+		out << itr.key() << itr->time << itr->full << quint32(itr->values.size());
+		for (MetaInfoValuesHash::const_iterator jtr = itr->values.constBegin(); jtr != itr->values.constEnd(); ++jtr)
+			out << qint32(jtr.key().value()) << jtr.value();
+	}
+	file.commit();
+}
+
+} } // namespace qutim_sdk_0_3::oscar
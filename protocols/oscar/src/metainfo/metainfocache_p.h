@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef METAINFOCACHE_P_H
+#define METAINFOCACHE_P_H
+
+#include "metafield.h"
+#include <QPointer>
+#include <QTimer>
+
+namespace qutim_sdk_0_3 {
+
+namespace oscar {
+
+class IcqAccount;
+class ShortInfoMetaRequest;
+
+// Keeps meta info of contacts of one account between sessions, so repeated
+// lookups of the same uins are not sent to the server again
+class MetaInfoCache : public QObject
+{
+	Q_OBJECT
+public:
+	MetaInfoCache(IcqAccount *account);
+	~MetaInfoCache();
+	bool find(quint32 uin, bool full, MetaInfoValuesHash &values) const;
+	void insert(quint32 uin, bool full, const MetaInfoValuesHash &values);
+	// Returns not finished request for the uin which answer is enough for
+	// a request of the given kind
+	ShortInfoMetaRequest *runningRequest(quint32 uin, bool full) const;
+	void addRunningRequest(quint32 uin, bool full, ShortInfoMetaRequest *request);
+private slots:
+	void save();
+private:
+	struct Entry
+	{
+		MetaInfoValuesHash values;
+		qint64 time;
+		bool full;
+	};
+	bool isFresh(const Entry &entry) const;
+	void load();
+	QString m_fileName;
+	QHash<quint32, Entry> m_entries;
+	QHash<quint32, QPointer<ShortInfoMetaRequest> > m_shortRequests;
+	QHash<quint32, QPointer<ShortInfoMetaRequest> > m_fullRequests;
+	qint64 m_ttl;
+	QTimer m_saveTimer;
+};
+
+} } // namespace qutim_sdk_0_3::oscar
+
+#endif // METAINFOCACHE_P_H
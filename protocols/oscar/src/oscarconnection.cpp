@@ -33,6 +33,7 @@
 #include "sessiondataitem.h"
 #include "metainfo/infometarequest.h"
 #include <qutim/objectgenerator.h>
+#include <qutim/sslcontext.h>
 #include <qutim/notification.h>
 #include <QHostInfo>
 #include <QBuffer>
@@ -178,6 +179,7 @@ void OscarConnection::connectToBOSS(const QString &host, quint16 port, const QBy
 		s->abort();
 #if defined(OSCAR_SSL_SUPPORT)
 	if (isSslEnabled()) {
+		SslContext::prepare(socket(), host, port);
 		socket()->connectToHostEncrypted(host, port);
 	} else
 #endif
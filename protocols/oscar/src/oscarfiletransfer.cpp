@@ -34,6 +34,13 @@
 #include <QDir>
 #include <QTimer>
 #include <QApplication>
+#include <QMutex>
+#include <QDateTime>
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#  include <arm_neon.h>
+#endif
 
 namespace qutim_sdk_0_3 {
 
@@ -43,6 +50,9 @@ QHash<quint16, OftServer*> OftFileTransferFactory::m_servers;
 bool OftFileTransferFactory::m_allowAnyPort;
 
 const int BUFFER_SIZE = 4096;
+// Files are checksummed by mapping such windows one by one
+const qint64 CHECKSUM_WINDOW_SIZE = 16 * 1024 * 1024;
+const int CHECKSUM_CACHE_SIZE = 64;
 using namespace Util;
 
 OftHeader::OftHeader() :
@@ -431,33 +441,151 @@ void OftServer::onTimeout()
 	close();
 }
 
+struct OftChecksumCacheEntry
+{
+	qint64 size;
+	qint64 modified;
+	quint32 checksum;
+};
+
+typedef QHash<QPair<QString, qint64>, OftChecksumCacheEntry> OftChecksumCache;
+Q_GLOBAL_STATIC(OftChecksumCache, checksumCache)
+Q_GLOBAL_STATIC(QMutex, checksumCacheMutex)
+
 OftChecksumThread::OftChecksumThread(QIODevice *f, int b) :
 	file(f), bytes(b)
 {
+	if (QFile *qfile = qobject_cast<QFile*>(f))
+		path = qfile->fileName();
 }
 
-quint32 OftChecksumThread::chunkChecksum(const char *buffer, int len, quint32 oldChecksum, int offset)
+OftChecksumThread::OftChecksumThread(const QString &p, int b) :
+	file(0), path(p), bytes(b)
 {
-	// code adapted from miranda's oft_calc_checksum
-	quint32 checksum = (oldChecksum >> 16) & 0xffff;
-	for (int i = 0; i < len; i++)
-	{
-		quint16 val = buffer[i];
-		//quint32 oldchecksum = checksum;
-		if (((i + offset) & 1) == 0)
-			val = val << 8;
-		if (checksum < val)
-			checksum -= val + 1;
-		else // simulate carry
-			checksum -= val;
+}
+
+void OftChecksumThread::prefetch(const QString &path)
+{
+	OftChecksumThread *thread = new OftChecksumThread(path);
+	connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+	thread->start(QThread::LowPriority);
+}
+
+// Sums of bytes at even and odd positions of the buffer
+static void oftByteSums(const uchar *data, int len, quint64 *even, quint64 *odd)
+{
+	quint64 evenSum = 0;
+	quint64 oddSum = 0;
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+	__m128i evenAcc = zero;
+	__m128i oddAcc = zero;
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		evenAcc = _mm_add_epi64(evenAcc, _mm_sad_epu8(_mm_and_si128(v, mask), zero));
+		oddAcc = _mm_add_epi64(oddAcc, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+	}
+	quint64 lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), evenAcc);
+	evenSum = lanes[0] + lanes[1];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), oddAcc);
+	oddSum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+	const uint16x8_t mask = vdupq_n_u16(0x00ff);
+	uint64x2_t evenAcc = vdupq_n_u64(0);
+	uint64x2_t oddAcc = vdupq_n_u64(0);
+	for (; i + 16 <= len; i += 16) {
+		const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(data + i));
+		evenAcc = vpadalq_u32(evenAcc, vpaddlq_u16(vandq_u16(v, mask)));
+		oddAcc = vpadalq_u32(oddAcc, vpaddlq_u16(vshrq_n_u16(v, 8)));
+	}
+	evenSum = vgetq_lane_u64(evenAcc, 0) + vgetq_lane_u64(evenAcc, 1);
+	oddSum = vgetq_lane_u64(oddAcc, 0) + vgetq_lane_u64(oddAcc, 1);
+#endif
+	for (; i + 1 < len; i += 2) {
+		evenSum += data[i];
+		oddSum += data[i + 1];
 	}
+	if (i < len)
+		evenSum += data[i];
+	*even = evenSum;
+	*odd = oddSum;
+}
+
+quint32 OftChecksumThread::chunkChecksum(const char *buffer, int len, quint32 oldChecksum, int offset)
+{
+	// Miranda's oft_calc_checksum subtracts big-endian words one by one,
+	// borrowing one more on every wrap. That is subtraction modulo 2^32-1
+	// with result never equal to 2^32-1, so the whole chunk is subtracted
+	// at once and the result is bit exact with per byte loop.
+	quint64 even;
+	quint64 odd;
+	oftByteSums(reinterpret_cast<const uchar*>(buffer), len, &even, &odd);
+	if (offset & 1)
+		qSwap(even, odd);
+	const quint64 modulo = Q_UINT64_C(0xffffffff);
+	const quint64 sum = ((even << 8) + odd) % modulo;
+	quint32 checksum = quint32((((oldChecksum >> 16) & 0xffff) + modulo - sum) % modulo);
 	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
 	checksum = ((checksum & 0x0000ffff) + (checksum >> 16));
 	return (quint32)checksum << 16;
 }
 
+quint32 OftChecksumThread::fileChecksum(const QString &fileName, qint64 bytes)
+{
+	const QFileInfo info(fileName);
+	if (bytes <= 0 || bytes > info.size())
+		bytes = info.size();
+	const QPair<QString, qint64> key(info.absoluteFilePath(), bytes);
+	const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+	{
+		QMutexLocker locker(checksumCacheMutex());
+		OftChecksumCache::ConstIterator it = checksumCache()->constFind(key);
+		if (it != checksumCache()->constEnd() && it->size == info.size() && it->modified == modified)
+			return it->checksum;
+	}
+
+	quint32 checksum = 0xFFFF0000;
+	QFile file(info.absoluteFilePath());
+	if (!file.open(QIODevice::ReadOnly))
+		return checksum;
+	qint64 pos = 0;
+	while (pos < bytes) {
+		qint64 len = qMin(CHECKSUM_WINDOW_SIZE, bytes - pos);
+		if (uchar *data = file.map(pos, len)) {
+			checksum = chunkChecksum(reinterpret_cast<const char*>(data), len, checksum, pos & 1);
+			file.unmap(data);
+		} else {
+			// Not every file system allows mapping
+			file.seek(pos);
+			const QByteArray data = file.read(len);
+			if (data.isEmpty())
+				return 0xFFFF0000;
+			checksum = chunkChecksum(data.constData(), data.size(), checksum, pos & 1);
+			len = data.size();
+		}
+		pos += len;
+	}
+
+	QMutexLocker locker(checksumCacheMutex());
+	if (checksumCache()->size() >= CHECKSUM_CACHE_SIZE)
+		checksumCache()->clear();
+	OftChecksumCacheEntry &entry = (*checksumCache())[key];
+	entry.size = info.size();
+	entry.modified = modified;
+	entry.checksum = checksum;
+	return checksum;
+}
+
 void OftChecksumThread::run()
 {
+	if (!path.isEmpty()) {
+		emit done(fileChecksum(path, bytes));
+		return;
+	}
+
 	quint32 checksum = 0xFFFF0000;
 	QByteArray data;
 	data.reserve(BUFFER_SIZE);
@@ -469,6 +597,8 @@ void OftChecksumThread::run()
 		file->open(QIODevice::ReadOnly);
 	while (totalRead < bytes) {
 		data = file->read(qMin(BUFFER_SIZE, bytes - totalRead));
+		if (data.isEmpty())
+			break;
 		checksum = chunkChecksum(data.constData(), data.size(), checksum, totalRead);
 		totalRead += data.size();
 		//QApplication::processEvents(); // This call causes crashes
@@ -480,6 +610,7 @@ void OftChecksumThread::run()
 
 OftConnection::OftConnection(IcqContact *contact, Direction direction, quint64 cookie, OftFileTransferFactory *manager, bool forceProxy) :
 	FileTransferJob(contact, direction, manager),
+	m_pumpChecksum(0xFFFF0000),
 	m_transfer(manager),
 	m_contact(contact),
 	m_account(contact->account()),
@@ -492,6 +623,9 @@ OftConnection::OftConnection(IcqContact *contact, Direction direction, quint64 c
 
 OftConnection::~OftConnection()
 {
+	// Worker thread must not touch the device being destroyed
+	if (m_pump)
+		m_pump.data()->stop();
 	m_transfer->removeConnection(this);
 }
 
@@ -545,6 +679,8 @@ void OftConnection::doReceive()
 
 void OftConnection::close(bool error)
 {
+	if (m_pump)
+		m_pump.data()->stop();
 	if (m_socket) {
 		if (!error)
 			m_socket.data()->close();
@@ -771,43 +907,59 @@ void OftConnection::onNewData()
 	}
 	if (m_socket.data()->bytesAvailable() <= 0)
 		return;
+	if (!m_pump || !m_pump.data()->isActive()) {
+		FileTransferPump *pump = createPump();
+		// Received checksum is calculated by the pump's thread as well
+		m_pumpChecksum = m_header.receivedChecksum;
+		pump->setObserver([this] (const char *data, qint64 size, qint64 offset) {
+			m_pumpChecksum = OftChecksumThread::chunkChecksum(data, size, m_pumpChecksum, offset);
+		});
+		pump->receive(m_data.data(), m_header.bytesReceived, m_header.size - m_header.bytesReceived);
+	}
 	QByteArray buf = m_socket.data()->read(m_header.size - m_header.bytesReceived);
-	m_header.receivedChecksum =
-			OftChecksumThread::chunkChecksum(buf.constData(), buf.size(),
-											 m_header.receivedChecksum,
-											 m_header.bytesReceived);
 	m_header.bytesReceived += buf.size();
-	m_data.data()->write(buf);
-	setFileProgress(m_header.bytesReceived);
-	if (m_header.bytesReceived == m_header.size) {
+	m_pump.data()->write(buf);
+	if (m_header.bytesReceived == m_header.size)
 		disconnect(m_socket.data(), SIGNAL(newData()), this, SLOT(onNewData()));
-		m_data.reset();
-		m_header.type = OftDone;
-		--m_header.filesLeft;
-		m_header.writeData(m_socket.data());
-		m_socket.data()->dataReaded();
-		if (m_header.filesLeft == 0) {
-			setState(Finished);
-		}
+}
+
+FileTransferPump *OftConnection::createPump()
+{
+	delete m_pump.data();
+	FileTransferPump *pump = new FileTransferPump(this, m_socket.data());
+	connect(pump, SIGNAL(finished()), SLOT(onPumpFinished()));
+	connect(pump, SIGNAL(error(qutim_sdk_0_3::FileTransferJob::ErrorType)),
+			SLOT(onPumpError(qutim_sdk_0_3::FileTransferJob::ErrorType)));
+	m_pump = pump;
+	return pump;
+}
+
+void OftConnection::onPumpFinished()
+{
+	m_data.reset();
+	if (direction() == Outgoing) {
+		m_header.bytesReceived = m_header.size;
+		return;
+	}
+	m_header.receivedChecksum = m_pumpChecksum;
+	m_header.type = OftDone;
+	--m_header.filesLeft;
+	m_header.writeData(m_socket.data());
+	m_socket.data()->dataReaded();
+	if (m_header.filesLeft == 0) {
+		setState(Finished);
 	}
 }
 
-void OftConnection::onSendData()
+void OftConnection::onPumpError(FileTransferJob::ErrorType error)
 {
-	if (!m_data && m_socket.data()->bytesToWrite())
+	if (error == NetworkError) {
+		close();
 		return;
-	QByteArray buf = m_data.data()->read(BUFFER_SIZE);
-	m_header.receivedChecksum =
-			OftChecksumThread::chunkChecksum(buf.constData(), buf.size(),
-											 m_header.receivedChecksum,
-											 m_header.bytesReceived);
-	m_header.bytesReceived += buf.size();
-	m_socket.data()->write(buf);
-	setFileProgress(m_header.bytesReceived);
-	if (m_header.bytesReceived == m_header.size) {
-		disconnect(m_socket.data(), SIGNAL(bytesWritten(qint64)), this, SLOT(onSendData()));
-		m_data.reset();
 	}
+	doStop();
+	setState(Error);
+	setError(error);
 }
 
 void OftConnection::startFileSending()
@@ -847,6 +999,11 @@ void OftConnection::startFileSendingImpl(quint32 checksum)
 	m_header.writeData(m_socket.data());
 	m_header.filesLeft = filesCount() - currentIndex();
 	setState(Started);
+	// Checksum goes in the prompt, so the next file can't be sent without it.
+	// Compute it while the receiver downloads the current one.
+	const int next = currentIndex() + 1;
+	if (next < filesCount())
+		OftChecksumThread::prefetch(baseDir().absoluteFilePath(info(next).fileName()));
 }
 
 void OftConnection::startFileReceiving(const int index)
@@ -1025,9 +1182,10 @@ void OftConnection::onHeaderReaded()
 		case OftAcknowledge: {	// receiver are waiting file
 			m_socket.data()->dataReaded();
 			if (m_data.data()->open(QFile::ReadOnly)) {
-				connect(m_socket.data(), SIGNAL(bytesWritten(qint64)), this, SLOT(onSendData()));
 				setState(Started);
-				onSendData();
+				// Resumed transfer starts from the position receiver has asked for
+				createPump()->send(m_data.data(), m_header.bytesReceived,
+								   m_header.size - m_header.bytesReceived);
 			} else {
 				close();
 			}
@@ -181,13 +181,19 @@ class OftChecksumThread : public QThread
 	Q_OBJECT
 public:
 	OftChecksumThread(QIODevice *file, int bytes = 0);
+	OftChecksumThread(const QString &path, int bytes = 0);
 	static quint32 chunkChecksum(const char *buffer, int len, quint32 checksum, int offset);
+	// Checksum of first bytes of the file, cached by path, size and modification time
+	static quint32 fileChecksum(const QString &path, qint64 bytes = 0);
+	// Computes checksum in background, so later request for it is served from cache
+	static void prefetch(const QString &path);
 protected:
 	void run();
 signals:
 	void done(quint32 checksum);
 private:
 	QIODevice *file;
+	QString path;
 	int bytes;
 };
 
@@ -214,6 +220,7 @@ private:
 	void startFileSending();
 	void startFileReceiving(const int index);
 	void startFileReceivingImpl(bool resume);
+	FileTransferPump *createPump();
 private slots:
 	void close() { close(true); }
 	void startNextStage();
@@ -222,7 +229,8 @@ private slots:
 	void onError(QAbstractSocket::SocketError);
 	void onHeaderReaded();
 	void onNewData();
-	void onSendData();
+	void onPumpFinished();
+	void onPumpError(qutim_sdk_0_3::FileTransferJob::ErrorType error);
 	void startFileSendingImpl(quint32 checksum);
 	void startFileReceivingImpl(quint32 checksum);
 	void resumeFileReceivingImpl(quint32 checksum);
@@ -232,6 +240,9 @@ private:
 	QPointer<OftSocket> m_socket;
 	QPointer<OftServer> m_server;
 	QScopedPointer<QIODevice> m_data;
+	QPointer<FileTransferPump> m_pump;
+	// Written by the pump's thread only while it's receiving
+	quint32 m_pumpChecksum;
 	OftFileTransferFactory *m_transfer;
 	QPointer<IcqContact> m_contact;
 	QPointer<IcqAccount> m_account;
@@ -279,7 +279,7 @@ void Roster::handleUserOnline(IcqAccount *account, const SNAC &snac)
 		return;
 	quint16 warning_level = snac.read<quint16>();
 	Q_UNUSED(warning_level);
-	TLVMap tlvs = snac.read<TLVMap, quint16>();
+	TLVMapView tlvs = snac.read<TLVMapView, quint16>();
 	// status.
 	Status oldStatus = contact->status();
 	quint16 statusId = 0;
@@ -380,7 +380,7 @@ void Roster::handleUserOffline(IcqAccount *account, const SNAC &snac)
 		return;
 	quint16 warning_level = snac.read<quint16>();
 	Q_UNUSED(warning_level);
-	TLVMap tlvs = snac.read<TLVMap, quint16>();
+	TLVMapView tlvs = snac.read<TLVMapView, quint16>();
 	//tlvs.value(0x0001); // User class
 	contact->d_func()->clearCapabilities();
 	OscarStatus status = contact->status();
@@ -76,11 +76,23 @@ void PrivacyLists::onModifyPrivateList(QAction *action, QObject *object)
 	quint16 type = action->property("itemType").toInt();
 	Q_ASSERT(qobject_cast<IcqContact*>(object) != 0);
 	IcqContact *contact = reinterpret_cast<IcqContact*>(object);
-	FeedbagItem item = contact->account()->feedbag()->item(type, contact->id(), 0, Feedbag::GenerateId);
-	if (item.isInList())
-		item.remove();
-	else
-		item.add();
+	bool add = !contact->account()->feedbag()->containsItem(type, contact->id());
+	modifyList(type, QList<IcqContact*>() << contact, add);
+}
+
+void PrivacyLists::modifyList(quint16 type, const QList<IcqContact*> &contacts, bool add)
+{
+	// Feedbag collects all changes made before returning to the event loop
+	// and sends them between single pair of modification start and end
+	foreach (IcqContact *contact, contacts) {
+		FeedbagItem item = contact->account()->feedbag()->item(type, contact->id(), 0, Feedbag::GenerateId);
+		if (item.isInList() == add)
+			continue;
+		if (add)
+			item.add();
+		else
+			item.remove();
+	}
 }
 
 static LocalizedString visibilityToString(Visibility visibility)
@@ -36,6 +36,7 @@ class Contact;
 namespace oscar {
 
 class IcqAccount;
+class IcqContact;
 
 enum Visibility
 {
@@ -86,6 +87,9 @@ public:
 	static PrivacyLists *instance() { Q_ASSERT(self); return self; }
 	bool handleFeedbagItem(Feedbag *feedbag, const FeedbagItem &item, Feedbag::ModifyType type, FeedbagError error);
 	void setVisibility(IcqAccount *account, int visibility);
+	// Adds or removes contacts of single account to visible, invisible or ignore list
+	// by one feedbag transaction
+	void modifyList(quint16 type, const QList<IcqContact*> &contacts, bool add);
 	Visibility getCurrentMode(IcqAccount *account, bool invisibleMode);
 protected:
 	bool eventFilter(QObject *obj, QEvent *e);
@@ -59,7 +59,7 @@ SNAC SNAC::fromByteArray(const QByteArray &d)
 	snac.m_data = data.readAll();
 	if (snac.m_flags & 0x8000) {
 		// Some unknown data
-		int offset = snac.read<quint16>() + 2; // sizeof(quint16)
+		int offset = qMin(snac.read<quint16>() + 2, snac.m_data.size()); // sizeof(quint16)
 		snac.m_data = QByteArray::fromRawData(snac.m_data.constData() + offset,
 		                                      snac.m_data.size() - offset);
 	}
@@ -77,6 +77,11 @@ private:
 	TLVMap::iterator insert(quint16 type, const TLV &data);
 };
 
+// TLVs of the map refer to the data they were read from, see DataUnitView
+class TLVMapView : public TLVMap
+{
+};
+
 
 TLV::TLV(quint16 type)
 {
@@ -214,6 +219,46 @@ struct fromDataUnitHelper<TLVMap>
 	}
 };
 
+template<>
+struct fromDataUnitHelper<TLVMapView>
+{
+	static inline TLV readTLV(const DataUnit &d, ByteOrder bo)
+	{
+		TLV tlv(0xffff);
+		if (d.dataSize() < 4)
+			return tlv;
+		tlv.setType(d.read<quint16>(bo));
+		if (d.dataSize() < 2)
+			tlv.setType(0xffff);
+		else
+			tlv.setData(d.read<DataUnitView, quint16>(bo).data());
+		return tlv;
+	}
+	static inline TLVMapView fromByteArray(const DataUnit &d, ByteOrder bo = BigEndian)
+	{
+		TLVMapView tlvs;
+		forever {
+			TLV tlv = readTLV(d, bo);
+			if (tlv.type() == 0xffff)
+				return tlvs;
+			tlvs.insert(tlv);
+		}
+		return tlvs;
+	}
+	template<class L>
+	static inline TLVMapView fromByteArray(const DataUnit &d, L count, ByteOrder bo = BigEndian)
+	{
+		TLVMapView tlvs;
+		for (L i = 0; i < count; i++) {
+			TLV tlv = readTLV(d, bo);
+			if (tlv.type() == 0xffff)
+				return tlvs;
+			tlvs.insert(tlv);
+		}
+		return tlvs;
+	}
+};
+
 template<>
 struct toDataUnitHelper<TLV>
 {
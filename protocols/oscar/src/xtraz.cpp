@@ -503,6 +503,9 @@ Xtraz::Xtraz(const QString &message) :
 				notify = xml.readElementText();
 			else if (xml.name() == "RES")
 				response = xml.readElementText();
+			// Nothing else is used, so the rest of the payload is not read
+			if (!response.isEmpty() || (!query.isEmpty() && !notify.isEmpty()))
+				break;
 		}
 	}
 	if (!query.isEmpty() && !notify.isEmpty()) {
@@ -174,6 +174,7 @@ QuetzalAccount::QuetzalAccount(PurpleAccount *account, QuetzalProtocol *protocol
 		Account(quetzal_fix_id(protocol, account->username), protocol)
 {
 	m_isLoading = false;
+	m_rosterBuffering = false;
 	m_account = account;
 	m_account->ui_data = this;
 	fillStatusActions();
@@ -188,6 +189,7 @@ QuetzalAccount::QuetzalAccount(const QString &id, QuetzalProtocol *protocol) : A
 {
 	Q_ASSERT(!"Shouldn't use this constructor");
 	m_isLoading = false;
+	m_rosterBuffering = false;
 	Config cfg = config();
 	QString purpleId = id;
 	if (protocol->id() == QLatin1String("irc")) {
@@ -370,6 +372,10 @@ static void quetzal_save_chat(const char *key, const char *value, Config *cfg)
 
 void QuetzalAccount::timerEvent(QTimerEvent *ev)
 {
+	if (m_rosterTimer.timerId() == ev->timerId()) {
+		flushRoster();
+		return;
+	}
 	if (m_chatTimer.timerId() != ev->timerId())
 		return Account::timerEvent(ev);
 	m_chatTimer.stop();
@@ -453,6 +459,8 @@ void QuetzalAccount::remove(PurpleBuddy *buddy)
 	debug() << Q_FUNC_INFO << __LINE__ << contact;
 	if (!contact)
 		return;
+	if (m_pendingUpdates.value(contact) == buddy)
+		m_pendingUpdates.remove(contact);
 	if (contact->removeBuddy(buddy) == 0) {
 		// Test it
 		return;
@@ -537,10 +545,18 @@ void QuetzalAccount::setStatusChanged(PurpleStatus *status)
 	Account::setStatus(stat);
 }
 
+// Roster is considered received when no updates come for this time
+enum { RosterQuietTime = 500, RosterMaxDelay = 10000 };
+
 void QuetzalAccount::handleSigningOn()
 {
 	Status oldStatus = status();
 	Account::setStatus(Status(Status::Connecting));
+	if (!m_rosterBuffering) {
+		m_rosterBuffering = true;
+		beginRosterUpdate();
+	}
+	m_signedOnTime.invalidate();
 }
 
 void QuetzalAccount::handleSignedOn()
@@ -548,10 +564,38 @@ void QuetzalAccount::handleSignedOn()
 	setStatusChanged(purple_account_get_active_status(m_account));
 	if (PURPLE_PLUGIN_PROTOCOL_INFO(m_account->gc->prpl)->chat_info)
 		resetGroupChatManager(new QuetzalJoinChatManager(this));
+	// Most of protocols send roster and presences right after signing on
+	m_signedOnTime.start();
+	if (m_rosterBuffering)
+		m_rosterTimer.start(RosterQuietTime, this);
+}
+
+bool QuetzalAccount::deferUpdate(QuetzalContact *contact, PurpleBuddy *buddy)
+{
+	if (!m_rosterBuffering)
+		return false;
+	m_pendingUpdates.insert(contact, buddy);
+	if (m_signedOnTime.isValid() && m_signedOnTime.elapsed() < RosterMaxDelay)
+		m_rosterTimer.start(RosterQuietTime, this);
+	return true;
+}
+
+void QuetzalAccount::flushRoster()
+{
+	m_rosterTimer.stop();
+	QHash<QuetzalContact *, PurpleBuddy *> updates;
+	qSwap(updates, m_pendingUpdates);
+	for (auto it = updates.constBegin(); it != updates.constEnd(); ++it)
+		it.key()->update(it.value());
+	if (m_rosterBuffering) {
+		m_rosterBuffering = false;
+		endRosterUpdate();
+	}
 }
 
 void QuetzalAccount::handleSignedOff()
 {
+	flushRoster();
 	Status oldStatus = status();
 	Account::setStatus(Status(Status::Offline));
 	resetGroupChatManager(0);
@@ -31,6 +31,7 @@
 #include "quetzalcontact.h"
 #include <qutim/rosterstorage.h>
 #include <QBasicTimer>
+#include <QElapsedTimer>
 
 using namespace qutim_sdk_0_3;
 
@@ -71,6 +72,8 @@ public:
 	void handleSigningOn();
 	void handleSignedOn();
 	void handleSignedOff();
+	// Returns false if update should be applied immediately
+	bool deferUpdate(QuetzalContact *contact, PurpleBuddy *buddy);
 	QObject *requestPassword(PurpleRequestFields *fields, PurpleRequestFieldsCb okCb,
 							 PurpleRequestFieldsCb cancelCb, void *userData);
 	PurpleAccount *purple();
@@ -81,6 +84,7 @@ protected:
 	void fillStatusActions();
 	MenuController::ActionList dynamicActions() const;
 	void fillPassword(const QuetzalAccountPasswordInfo &info, const QString &password);
+	void flushRoster();
 
 private slots:
 	void showJoinGroupChat();
@@ -92,6 +96,11 @@ private:
 	PurpleAccount *m_account;
 	bool m_isLoading;
 	QBasicTimer m_chatTimer;
+	// libpurple callbacks received during login are applied as one roster update
+	QHash<QuetzalContact *, PurpleBuddy *> m_pendingUpdates;
+	QBasicTimer m_rosterTimer;
+	QElapsedTimer m_signedOnTime;
+	bool m_rosterBuffering;
 	friend class QuetzalContactsFactory;
 };
 
@@ -86,7 +86,10 @@ void quetzal_update(PurpleBuddyList *list, PurpleBlistNode *node)
 	if (PURPLE_BLIST_NODE_IS_BUDDY(node)) {
 		QObject *obj = reinterpret_cast<QObject *>(node->ui_data);
 		if (QuetzalContact *contact = qobject_cast<QuetzalContact *>(obj)) {
-			contact->update(PURPLE_BUDDY(node));
+			PurpleBuddy *buddy = PURPLE_BUDDY(node);
+			QuetzalAccount *account = reinterpret_cast<QuetzalAccount *>(buddy->account->ui_data);
+			if (!account || !account->deferUpdate(contact, buddy))
+				contact->update(buddy);
 		}
 	} else if (PURPLE_BLIST_NODE_IS_GROUP(node)) {
 		// TODO: handle group name changes
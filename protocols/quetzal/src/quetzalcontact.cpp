@@ -165,7 +165,7 @@ Status quetzal_get_status(PurplePresence *presence)
 
 
 QuetzalContact::QuetzalContact(PurpleBuddy *buddy) :
-	Contact(reinterpret_cast<QuetzalAccount *>(buddy->account->ui_data))
+	Contact(reinterpret_cast<QuetzalAccount *>(buddy->account->ui_data)), m_icon(0)
 {
 //	PurpleBlistNode *node = &buddy->node;
 	m_id = buddy->name;
@@ -260,6 +260,12 @@ void QuetzalContact::ensureAvatarPath()
 	QString path;
 	PurpleBuddy *buddy = m_buddies.first();
 	PurpleBuddyIcon *icon = purple_buddy_icons_find(buddy->account, buddy->name);
+	// Most of updates are presence ones, so the path is built only for new icons
+	const QByteArray checksum = icon ? QByteArray(purple_buddy_icon_get_checksum(icon)) : QByteArray();
+	if (icon == m_icon && checksum == m_iconChecksum && (icon || m_avatarPath.isEmpty()))
+		return;
+	m_icon = icon;
+	m_iconChecksum = checksum;
 	if (icon) {
 		char *str = purple_buddy_icon_get_full_path(icon);
 		if (str) {
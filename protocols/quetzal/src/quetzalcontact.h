@@ -69,6 +69,8 @@ private:
 	Status m_status;
 	QStringList m_tags;
 	QString m_avatarPath;
+	PurpleBuddyIcon *m_icon;
+	QByteArray m_iconChecksum;
 	QString m_id;
 	QString m_name;
 	QList<PurpleBuddy*> m_buddies;
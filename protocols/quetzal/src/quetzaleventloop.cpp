@@ -25,22 +25,41 @@
 
 #include "quetzaleventloop.h"
 #include <qutim/debug.h>
-#include <QTimerEvent>
 #include <QThread>
 #include <QCoreApplication>
 #include <QVariant>
-#include <QTimer>
-
-Q_DECLARE_METATYPE(int*)
+#include <algorithm>
+#ifdef Q_OS_LINUX
+# include <sys/epoll.h>
+# include <errno.h>
+#endif
 
 using namespace qutim_sdk_0_3;
 
+enum {
+	// Timers due this close to the earliest one are run at the same wakeup
+	CoalesceSlack = 10,
+	MaxEpollEvents = 64
+};
+
 QuetzalEventLoop *QuetzalEventLoop::m_self = NULL;
 
 QuetzalEventLoop::QuetzalEventLoop(QObject *parent):
-		QObject(parent), m_socketId(0)
+		QObject(parent), m_timerId(0), m_wakeupDeadline(-1),
+		m_socketId(0), m_epollFd(-1), m_epollNotifier(NULL)
 {
-	qRegisterMetaType<int*>("int*");
+	m_clock.start();
+	m_wakeup.setSingleShot(true);
+	connect(&m_wakeup, SIGNAL(timeout()), this, SLOT(onTimeout()));
+#ifdef Q_OS_LINUX
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epollFd >= 0) {
+		m_epollNotifier = new QSocketNotifier(m_epollFd, QSocketNotifier::Read, this);
+		connect(m_epollNotifier, SIGNAL(activated(int)), this, SLOT(onSocket(int)));
+	} else {
+		warning() << "Can't create epoll instance, errno" << errno;
+	}
+#endif
 }
 
 QuetzalEventLoop *QuetzalEventLoop::instance()
@@ -51,68 +70,112 @@ QuetzalEventLoop *QuetzalEventLoop::instance()
 	return m_self;
 }
 
-//static GSourceFunc quetzal_accounts_save_cb = NULL;
-
 uint QuetzalEventLoop::addTimer(guint interval, GSourceFunc function, gpointer data)
 {
-//	// This hook is used for plugin to know when accounts's data should be saved
-//	if (!quetzal_accounts_save_cb && interval == 5000)
-//		quetzal_accounts_save_cb = function;
-	bool isMainThread = QThread::currentThread() == qApp->thread();
-	int id = -1;
-	if (isMainThread) {
-		id = QObject::startTimer(interval);
-	} else {
-		QMetaObject::invokeMethod(this, "startTimer", Qt::BlockingQueuedConnection,
-								  Q_ARG(int, interval), Q_ARG(int*, &id));
-	}
 	QMutexLocker locker(&m_timerMutex);
-	m_timers.insert(id, new TimerInfo(function, data));
-	return static_cast<uint>(id);
-}
+	do {
+		++m_timerId;
+	} while (!m_timerId || m_timers.contains(m_timerId));
+	const guint id = m_timerId;
+	m_timers.insert(id, new TimerInfo(function, data, interval));
+	TimerEntry entry = { m_clock.elapsed() + interval, id };
+	m_timerHeap.push_back(entry);
+	std::push_heap(m_timerHeap.begin(), m_timerHeap.end());
+	locker.unlock();
 
-void QuetzalEventLoop::startTimer(int interval, int *id)
-{
-	QMutexLocker locker(&m_timerMutex);
-	*id = QObject::startTimer(interval);
+	if (QThread::currentThread() == thread())
+		rearm();
+	else
+		QMetaObject::invokeMethod(this, "rearm", Qt::QueuedConnection);
+	return id;
 }
 
 gboolean QuetzalEventLoop::removeTimer(guint handle)
 {
 	Q_ASSERT(QThread::currentThread() == qApp->thread());
-	int id = static_cast<int>(handle);
 	QMutexLocker locker(&m_timerMutex);
-	QMap<int, TimerInfo *>::iterator it = m_timers.find(id);
+	QHash<guint, TimerInfo *>::iterator it = m_timers.find(handle);
 	if (it == m_timers.end())
 		return FALSE;
-	killTimer(id);
 	delete it.value();
 	m_timers.erase(it);
+
+	// Heap entries of removed timers are skipped lazily, but drop them all
+	// once they start to dominate
+	if (m_timerHeap.size() > 2 * size_t(m_timers.size()) + 64) {
+		std::vector<TimerEntry>::iterator end = m_timerHeap.begin();
+		for (std::vector<TimerEntry>::iterator jt = m_timerHeap.begin(); jt != m_timerHeap.end(); ++jt) {
+			if (m_timers.contains(jt->id))
+				*end++ = *jt;
+		}
+		m_timerHeap.erase(end, m_timerHeap.end());
+		std::make_heap(m_timerHeap.begin(), m_timerHeap.end());
+	}
 	return TRUE;
 }
 
-void QuetzalEventLoop::timerEvent(QTimerEvent *event)
+void QuetzalEventLoop::rearm()
 {
-	m_timerMutex.lock();
-	QMap<int, TimerInfo *>::iterator it = m_timers.find(event->timerId());
-	if (it == m_timers.end()) {
-		m_timerMutex.unlock();
+	QMutexLocker locker(&m_timerMutex);
+	while (!m_timerHeap.empty() && !m_timers.contains(m_timerHeap.front().id)) {
+		std::pop_heap(m_timerHeap.begin(), m_timerHeap.end());
+		m_timerHeap.pop_back();
+	}
+	if (m_timerHeap.empty()) {
+		m_wakeup.stop();
+		m_wakeupDeadline = -1;
 		return;
 	}
-	TimerInfo info = *it.value();
+	const qint64 deadline = m_timerHeap.front().deadline;
+	if (m_wakeup.isActive() && m_wakeupDeadline <= deadline)
+		return;
+	m_wakeupDeadline = deadline;
+	m_wakeup.start(qMax<qint64>(0, deadline - m_clock.elapsed()));
+}
+
+void QuetzalEventLoop::onTimeout()
+{
+	m_wakeupDeadline = -1;
+
+	// Take all due timers first, so the ones rescheduled with zero
+	// interval are run at the next wakeup instead of looping here
+	std::vector<TimerEntry> due;
+	m_timerMutex.lock();
+	const qint64 limit = m_clock.elapsed() + CoalesceSlack;
+	while (!m_timerHeap.empty() && m_timerHeap.front().deadline <= limit) {
+		due.push_back(m_timerHeap.front());
+		std::pop_heap(m_timerHeap.begin(), m_timerHeap.end());
+		m_timerHeap.pop_back();
+	}
 	m_timerMutex.unlock();
-//	if (info.function == quetzal_accounts_save_cb)
-//		purple_blist_schedule_save();
-	gboolean result = (*info.function)(info.data);
-	if (!result) {
+
+	for (size_t i = 0; i < due.size(); ++i) {
+		const guint id = due[i].id;
+		m_timerMutex.lock();
+		TimerInfo *info = m_timers.value(id);
+		if (!info) {
+			m_timerMutex.unlock();
+			continue;
+		}
+		const TimerInfo copy = *info;
+		m_timerMutex.unlock();
+
+		const gboolean result = (*copy.function)(copy.data);
+
 		QMutexLocker locker(&m_timerMutex);
-		it = m_timers.find(event->timerId());
+		QHash<guint, TimerInfo *>::iterator it = m_timers.find(id);
 		if (it == m_timers.end())
-			return;
-		killTimer(it.key());
-		delete it.value();
-		m_timers.erase(it);
+			continue;
+		if (result) {
+			TimerEntry entry = { m_clock.elapsed() + it.value()->interval, id };
+			m_timerHeap.push_back(entry);
+			std::push_heap(m_timerHeap.begin(), m_timerHeap.end());
+		} else {
+			delete it.value();
+			m_timers.erase(it);
+		}
 	}
+	rearm();
 }
 
 guint QuetzalEventLoop::addIO(int fd, PurpleInputCondition cond, PurpleInputFunction func, gpointer user_data)
@@ -123,30 +186,42 @@ guint QuetzalEventLoop::addIO(int fd, PurpleInputCondition cond, PurpleInputFunc
 		return m_socketId++;
 	}
 
-	QSocketNotifier::Type type;
-	if (cond & PURPLE_INPUT_READ)
-		type = QSocketNotifier::Read;
-	else
-		type = QSocketNotifier::Write;
+	const guint id = m_socketId++;
+	QSocketNotifier *socket = NULL;
+	if (!m_epollNotifier) {
+		QSocketNotifier::Type type;
+		if (cond & PURPLE_INPUT_READ)
+			type = QSocketNotifier::Read;
+		else
+			type = QSocketNotifier::Write;
 
-	QSocketNotifier *socket = new QSocketNotifier(fd, type, this);
-	socket->setProperty("quetzal_id", m_socketId);
-	connect(socket, SIGNAL(activated(int)), this, SLOT(onSocket(int)));
+		socket = new QSocketNotifier(fd, type, this);
+		socket->setProperty("quetzal_id", id);
+		connect(socket, SIGNAL(activated(int)), this, SLOT(onSocket(int)));
+	}
 
-	m_files.insert(m_socketId, new FileInfo(fd, socket, cond, func, user_data));
-	socket->setEnabled(true);
-	return m_socketId++;
+	m_files.insert(id, new FileInfo(fd, socket, cond, func, user_data));
+	m_fdWatches.insert(fd, id);
+	if (socket)
+		socket->setEnabled(true);
+	else
+		updateWatch(fd);
+	return id;
 }
 
 gboolean QuetzalEventLoop::removeIO(guint handle)
 {
 	Q_ASSERT(QThread::currentThread() == qApp->thread());
-	QMap<uint, FileInfo *>::iterator it = m_files.find(handle);
+	QHash<guint, FileInfo *>::iterator it = m_files.find(handle);
 	if (it == m_files.end())
 		return FALSE;
 	FileInfo *info = it.value();
-	info->socket->deleteLater();
+	if (info->socket)
+		info->socket->deleteLater();
 	m_files.erase(it);
+	m_fdWatches.remove(info->fd, handle);
+	if (m_epollNotifier)
+		updateWatch(info->fd);
 	delete info;
 	return TRUE;
 }
@@ -158,11 +233,85 @@ int QuetzalEventLoop::getIOError(int fd, int *error)
 	return 0;
 }
 
+void QuetzalEventLoop::updateWatch(int fd)
+{
+#ifdef Q_OS_LINUX
+	// Watches being dispatched are left out, so nested event loops
+	// started by their callbacks don't spin on the same descriptor
+	quint32 events = 0;
+	QMultiHash<int, guint>::const_iterator it = m_fdWatches.constFind(fd);
+	for (; it != m_fdWatches.constEnd() && it.key() == fd; ++it) {
+		FileInfo *info = m_files.value(it.value());
+		if (info->busy)
+			continue;
+		if (info->cond & PURPLE_INPUT_READ)
+			events |= EPOLLIN;
+		if (info->cond & PURPLE_INPUT_WRITE)
+			events |= EPOLLOUT;
+	}
+
+	epoll_event event;
+	event.events = events;
+	event.data.u64 = 0;
+	event.data.fd = fd;
+	QHash<int, quint32>::iterator jt = m_fdEvents.find(fd);
+	if (jt == m_fdEvents.end()) {
+		if (!events)
+			return;
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0)
+			m_fdEvents.insert(fd, events);
+		else
+			warning() << "Can't watch file descriptor" << fd << "errno" << errno;
+	} else if (!events) {
+		// Descriptor may be already closed, nothing to care about then
+		epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, &event);
+		m_fdEvents.erase(jt);
+	} else if (jt.value() != events) {
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event) == 0)
+			jt.value() = events;
+	}
+#else
+	Q_UNUSED(fd);
+#endif
+}
+
+void QuetzalEventLoop::dispatchIO(int fd, PurpleInputCondition cond)
+{
+	// Callbacks may add and remove any watches, so look them up every time
+	const QList<guint> ids = m_fdWatches.values(fd);
+	foreach (guint id, ids) {
+		FileInfo *info = m_files.value(id);
+		if (!info || info->busy || !(info->cond & cond))
+			continue;
+		info->busy = true;
+		updateWatch(fd);
+		(*info->func)(info->data, fd, static_cast<PurpleInputCondition>(info->cond & cond));
+		if (m_files.contains(id))
+			info->busy = false;
+	}
+	updateWatch(fd);
+}
+
 void QuetzalEventLoop::onSocket(int fd)
 {
+#ifdef Q_OS_LINUX
+	if (sender() == m_epollNotifier) {
+		epoll_event events[MaxEpollEvents];
+		const int count = epoll_wait(m_epollFd, events, MaxEpollEvents, 0);
+		for (int i = 0; i < count; ++i) {
+			int cond = 0;
+			if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				cond |= PURPLE_INPUT_READ;
+			if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+				cond |= PURPLE_INPUT_WRITE;
+			dispatchIO(events[i].data.fd, static_cast<PurpleInputCondition>(cond));
+		}
+		return;
+	}
+#endif
 	QSocketNotifier *socket = qobject_cast<QSocketNotifier *>(sender());
 	guint id = socket->property("quetzal_id").toUInt();
-	QMap<uint, FileInfo *>::iterator it = m_files.find(id);
+	QHash<guint, FileInfo *>::iterator it = m_files.find(id);
 	if (it != m_files.end()) {
 		FileInfo *info = it.value();
 		socket->setEnabled(false);
@@ -28,29 +28,43 @@
 
 #include <QSocketNotifier>
 #include <purple.h>
-#include <QMap>
+#include <QHash>
 #include <QMutex>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <vector>
 
 class QAction;
 
+// All libpurple timers are kept in one min-heap served by single QTimer,
+// on Linux all IO watches are multiplexed by epoll behind single notifier
 class QuetzalEventLoop : public QObject
 {
 	Q_OBJECT
 	struct TimerInfo
 	{
-		TimerInfo(GSourceFunc f, gpointer d) : function(f), data(d) {}
+		TimerInfo(GSourceFunc f, gpointer d, guint i) : function(f), data(d), interval(i) {}
 		GSourceFunc function;
 		gpointer data;
+		guint interval;
+	};
+	struct TimerEntry
+	{
+		qint64 deadline;
+		guint id;
+		// Makes std::push_heap build min-heap
+		bool operator <(const TimerEntry &o) const { return deadline > o.deadline; }
 	};
 	struct FileInfo
 	{
 		FileInfo(int fd_, QSocketNotifier *s, PurpleInputCondition c, PurpleInputFunction f, gpointer d) :
-				fd(fd_), socket(s), cond(c), func(f), data(d) {}
+				fd(fd_), socket(s), cond(c), func(f), data(d), busy(false) {}
 		int fd;
 		QSocketNotifier *socket;
 		PurpleInputCondition cond;
 		PurpleInputFunction func;
 		gpointer data;
+		bool busy;
 	};
 
 public:
@@ -60,24 +74,36 @@ public:
 	guint addIO(int fd, PurpleInputCondition cond, PurpleInputFunction func, gpointer user_data);
 	gboolean removeIO(guint handle);
 	int getIOError(int fd, int *error);
-	Q_INVOKABLE void startTimer(int interval, int *id);
 public slots:
 	void onAction(QAction *action);
-protected:
-	virtual void timerEvent(QTimerEvent *event);
 private slots:
+	void onTimeout();
+	void rearm();
 	void onSocket(int fd);
 
 private:
 	explicit QuetzalEventLoop(QObject *parent = 0);
+	void dispatchIO(int fd, PurpleInputCondition cond);
+	void updateWatch(int fd);
 	static QuetzalEventLoop *m_self;
+
 	QMutex m_timerMutex;
-	QMap<int, TimerInfo *> m_timers;
-	QMap<guint, FileInfo *> m_files;
+	QHash<guint, TimerInfo *> m_timers;
+	std::vector<TimerEntry> m_timerHeap;
+	guint m_timerId;
+	QElapsedTimer m_clock;
+	QTimer m_wakeup;
+	qint64 m_wakeupDeadline;
+
+	QHash<guint, FileInfo *> m_files;
+	// Watches by descriptor, libpurple may watch one fd several times
+	QMultiHash<int, guint> m_fdWatches;
+	QHash<int, quint32> m_fdEvents;
 	guint m_socketId;
+	int m_epollFd;
+	QSocketNotifier *m_epollNotifier;
 };
 
 extern PurpleEventLoopUiOps quetzal_eventloop_uiops;
 
 #endif // QUETZALEVENTLOOP_H
-
@@ -22,95 +22,292 @@
 ** $QUTIM_END_LICENSE$
 **
 ****************************************************************************/
-//#include "quetzalfiletransfer.h"
-//#include "quetzalaccount.h"
-//#include "quetzalcontact.h"
-//#include <QtPlugin>
-//
-//QuetzalFileTransfer::QuetzalFileTransfer()
-//{
-//}
-//
-//bool QuetzalFileTransfer::check(ChatUnit *unit)
-//{
-//	return !!qobject_cast<QuetzalContact *>(unit);
-//}
-//
-//FileTransferEngine *QuetzalFileTransfer::create(ChatUnit *unit)
-//{
-//	if (QuetzalContact *contact = qobject_cast<QuetzalContact *>(unit))
-//	{
-//		return new QuetzalFileTransferEngine(contact, FileTransferEngine::Send, this);
-//	}
-//	return 0;
-//}
-//
-//FileTransferEngine::Direction cast(PurpleXferType type)
-//{
-//	switch (type)
-//	{
-//	 case PURPLE_XFER_SEND:
-//		 return FileTransferEngine::Send;
-//	 case PURPLE_XFER_RECEIVE:
-//		 return FileTransferEngine::Receive;
-//	 default:
-//		 return static_cast<FileTransferEngine::Direction>(-1);
-//	}
-//}
-//
-//static void quetzal_xfer_new_xfer(PurpleXfer *xfer)
-//{
-//	QuetzalAccount *acc = reinterpret_cast<QuetzalAccount *>(xfer->account->ui_data);
-//	QuetzalContact *contact = qobject_cast<QuetzalContact *>(acc->getUnit(xfer->who, false));
-//	if (!contact)
-//		return;
-////	xfer->
-//	new QuetzalFileTransferEngine(xfer);
-//}
-//
-//static void quetzal_xfer_destroy(PurpleXfer *xfer)
-//{
-//	reinterpret_cast<QuetzalFileTransferEngine*>(xfer->ui_ops)->deleteLater();
-//}
-//
-//static void quetzal_xfer_add_xfer(PurpleXfer *xfer)
-//{
-//}
-//
-//static void quetzal_xfer_update_progress(PurpleXfer *xfer, double percent)
-//{
-//}
-//
-//static void quetzal_xfer_cancel_local(PurpleXfer *xfer)
-//{
-//}
-//
-//static void quetzal_xfer_cancel_remote(PurpleXfer *xfer)
-//{
-//}
-//
-//
-//PurpleXferUiOps quetzal_xfer_uiops =
-//{
-//	quetzal_xfer_new_xfer,
-//	quetzal_xfer_destroy,
-//	quetzal_xfer_add_xfer,
-//	quetzal_xfer_update_progress,
-//	quetzal_xfer_cancel_local,
-//	quetzal_xfer_cancel_remote
-//};
-//
-//Q_EXTERN_C Q_DECL_EXPORT void Q_STANDARD_CALL
-//purple_xfer_request(PurpleXfer *xfer)
-//{
-//	g_return_if_fail(xfer != NULL);
-//	g_return_if_fail(xfer->ops.init != NULL);
-//
-//	purple_xfer_ref(xfer);
-//	if (xfer->type == PURPLE_XFER_RECEIVE) {
-//
-//	} else {
-//		// Is it really possible?
-//	}
-//}
 
+#include "quetzalfiletransfer.h"
+#include "quetzalaccount.h"
+#include "quetzalcontact.h"
+#include <qutim/debug.h>
+#include <QFile>
+#include <QSet>
+
+extern void *quetzal_request_guard_new(QObject *obj);
+extern void quetzal_request_close(PurpleRequestType type, QObject *dialog);
+
+enum { ProgressInterval = 250 };
+
+// Every alive xfer, so request of file for one of them can be recognized
+static QSet<PurpleXfer*> quetzal_xfers;
+// Job waiting for xfer created by serv_send_file
+static QuetzalFileTransferJob *quetzal_pending_job = 0;
+static QPointer<QuetzalFileTransferFactory> quetzal_xfer_factory;
+
+QuetzalFileTransferJob::QuetzalFileTransferJob(ChatUnit *unit, Direction direction,
+											   FileTransferFactory *factory)
+	: FileTransferJob(unit, direction, factory), m_xfer(0), m_okCb(0), m_cancelCb(0), m_userData(0)
+{
+}
+
+QuetzalFileTransferJob::~QuetzalFileTransferJob()
+{
+	if (m_request && m_cancelCb)
+		m_cancelCb(m_userData, NULL);
+	if (m_xfer) {
+		m_xfer->ui_data = NULL;
+		if (!purple_xfer_is_completed(m_xfer) && !purple_xfer_is_canceled(m_xfer))
+			purple_xfer_cancel_local(m_xfer);
+		purple_xfer_unref(m_xfer);
+	}
+}
+
+QuetzalFileTransferJob *QuetzalFileTransferJob::get(PurpleXfer *xfer)
+{
+	return reinterpret_cast<QuetzalFileTransferJob*>(xfer->ui_data);
+}
+
+void QuetzalFileTransferJob::setXfer(PurpleXfer *xfer)
+{
+	Q_ASSERT(!m_xfer);
+	m_xfer = xfer;
+	m_xfer->ui_data = this;
+	purple_xfer_ref(m_xfer);
+}
+
+void QuetzalFileTransferJob::initIncoming()
+{
+	const QString fileName = QString::fromUtf8(purple_xfer_get_filename(m_xfer));
+	const qint64 size = purple_xfer_get_size(m_xfer);
+	init(1, size, fileName);
+	FileTransferInfo info;
+	info.setFileName(fileName);
+	info.setFileSize(size);
+	setFileInfo(0, info);
+}
+
+void QuetzalFileTransferJob::setRequest(QObject *request, GCallback okCb, GCallback cancelCb,
+										void *userData)
+{
+	m_request = request;
+	m_okCb = reinterpret_cast<PurpleRequestFileCb>(okCb);
+	m_cancelCb = reinterpret_cast<PurpleRequestFileCb>(cancelCb);
+	m_userData = userData;
+}
+
+void QuetzalFileTransferJob::handleProgress()
+{
+	if (!m_xfer)
+		return;
+	if (state() == Initiation)
+		setState(Started);
+	if (purple_xfer_is_completed(m_xfer)) {
+		m_progressTimer.stop();
+		updateProgress();
+		setState(Finished);
+	} else if (!m_progressTimer.isActive()) {
+		// libpurple reports every read chunk, so it is enough to look
+		// at counters a few times per second
+		m_progressTimer.start(ProgressInterval, this);
+	}
+}
+
+void QuetzalFileTransferJob::handleCancel(bool local)
+{
+	m_progressTimer.stop();
+	if (state() == Finished || state() == Error)
+		return;
+	setError(local ? Canceled : NetworkError);
+	setState(Error);
+}
+
+void QuetzalFileTransferJob::handleDestroy()
+{
+	m_progressTimer.stop();
+	m_xfer = 0;
+	if (state() != Finished && state() != Error) {
+		setError(NetworkError);
+		setState(Error);
+	}
+}
+
+void QuetzalFileTransferJob::doSend()
+{
+	QuetzalAccount *account = qobject_cast<QuetzalAccount*>(chatUnit()->account());
+	PurpleConnection *gc = account ? purple_account_get_connection(account->purple()) : 0;
+	if (!gc) {
+		setError(NetworkError);
+		setState(Error);
+		return;
+	}
+	// libpurple opens and reads the file by itself
+	const QString path = baseDir().absoluteFilePath(info(0).fileName());
+	quetzal_pending_job = this;
+	serv_send_file(gc, chatUnit()->id().toUtf8().constData(), QFile::encodeName(path).constData());
+	quetzal_pending_job = 0;
+	if (!m_xfer) {
+		setError(NotSupported);
+		setState(Error);
+	}
+}
+
+void QuetzalFileTransferJob::doStop()
+{
+	m_progressTimer.stop();
+	if (m_request) {
+		QObject *request = m_request.data();
+		m_request.clear();
+		if (m_cancelCb)
+			m_cancelCb(m_userData, NULL);
+		quetzal_request_close(PURPLE_REQUEST_FILE, request);
+	} else if (m_xfer && !purple_xfer_is_completed(m_xfer) && !purple_xfer_is_canceled(m_xfer)) {
+		purple_xfer_cancel_local(m_xfer);
+	}
+}
+
+void QuetzalFileTransferJob::doReceive()
+{
+	if (!m_request)
+		return;
+	// Only path is needed, file itself is written by libpurple
+	QFile *file = qobject_cast<QFile*>(setCurrentIndex(0));
+	if (!file) {
+		setError(IOError);
+		setState(Error);
+		return;
+	}
+	const QByteArray path = QFile::encodeName(file->fileName());
+	file->close();
+	QObject *request = m_request.data();
+	m_request.clear();
+	if (m_okCb)
+		m_okCb(m_userData, path.constData());
+	quetzal_request_close(PURPLE_REQUEST_FILE, request);
+}
+
+void QuetzalFileTransferJob::timerEvent(QTimerEvent *ev)
+{
+	if (ev->timerId() == m_progressTimer.timerId()) {
+		// Next update_progress from libpurple starts the timer again
+		m_progressTimer.stop();
+		updateProgress();
+		return;
+	}
+	FileTransferJob::timerEvent(ev);
+}
+
+void QuetzalFileTransferJob::updateProgress()
+{
+	if (m_xfer)
+		setFileProgress(purple_xfer_get_bytes_sent(m_xfer));
+}
+
+QuetzalFileTransferFactory::QuetzalFileTransferFactory()
+	: FileTransferFactory(tr("Quetzal"), 0)
+{
+	quetzal_xfer_factory = this;
+}
+
+bool QuetzalFileTransferFactory::checkAbility(ChatUnit *unit)
+{
+	QuetzalAccount *account = qobject_cast<QuetzalAccount*>(unit->account());
+	if (!account || !qobject_cast<QuetzalContact*>(unit))
+		return false;
+	PurpleConnection *gc = purple_account_get_connection(account->purple());
+	if (!gc || purple_connection_get_state(gc) != PURPLE_CONNECTED)
+		return false;
+	PurplePluginProtocolInfo *prpl = PURPLE_PLUGIN_PROTOCOL_INFO(gc->prpl);
+	if (!prpl || !prpl->send_file)
+		return false;
+	return !prpl->can_receive_file || prpl->can_receive_file(gc, unit->id().toUtf8().constData());
+}
+
+bool QuetzalFileTransferFactory::startObserve(ChatUnit *unit)
+{
+	return qobject_cast<QuetzalContact*>(unit);
+}
+
+bool QuetzalFileTransferFactory::stopObserve(ChatUnit *unit)
+{
+	return qobject_cast<QuetzalContact*>(unit);
+}
+
+FileTransferJob *QuetzalFileTransferFactory::create(ChatUnit *unit)
+{
+	if (!checkAbility(unit))
+		return 0;
+	return new QuetzalFileTransferJob(unit, FileTransferJob::Outgoing, this);
+}
+
+void *quetzal_xfer_request_file(const char *filename, GCallback okCb, GCallback cancelCb,
+								void *userData)
+{
+	Q_UNUSED(filename);
+	PurpleXfer *xfer = reinterpret_cast<PurpleXfer*>(userData);
+	if (!quetzal_xfer_factory || !quetzal_xfers.contains(xfer)
+			|| purple_xfer_get_type(xfer) != PURPLE_XFER_RECEIVE || xfer->ui_data) {
+		return 0;
+	}
+	QuetzalAccount *account = reinterpret_cast<QuetzalAccount*>(xfer->account->ui_data);
+	ChatUnit *unit = account ? account->getUnit(QString::fromUtf8(xfer->who), true) : 0;
+	if (!unit)
+		return 0;
+	QuetzalFileTransferJob *job = new QuetzalFileTransferJob(unit, FileTransferJob::Incoming,
+															 quetzal_xfer_factory.data());
+	QObject *request = new QObject(job);
+	job->setXfer(xfer);
+	job->setRequest(request, okCb, cancelCb, userData);
+	job->initIncoming();
+	return quetzal_request_guard_new(request);
+}
+
+static void quetzal_xfer_new(PurpleXfer *xfer)
+{
+	quetzal_xfers.insert(xfer);
+	if (quetzal_pending_job && purple_xfer_get_type(xfer) == PURPLE_XFER_SEND)
+		quetzal_pending_job->setXfer(xfer);
+}
+
+static void quetzal_xfer_destroy(PurpleXfer *xfer)
+{
+	quetzal_xfers.remove(xfer);
+	if (QuetzalFileTransferJob *job = QuetzalFileTransferJob::get(xfer))
+		job->handleDestroy();
+}
+
+static void quetzal_xfer_add(PurpleXfer *xfer)
+{
+	Q_UNUSED(xfer);
+}
+
+static void quetzal_xfer_update_progress(PurpleXfer *xfer, double percent)
+{
+	Q_UNUSED(percent);
+	if (QuetzalFileTransferJob *job = QuetzalFileTransferJob::get(xfer))
+		job->handleProgress();
+}
+
+static void quetzal_xfer_cancel_local(PurpleXfer *xfer)
+{
+	if (QuetzalFileTransferJob *job = QuetzalFileTransferJob::get(xfer))
+		job->handleCancel(true);
+}
+
+static void quetzal_xfer_cancel_remote(PurpleXfer *xfer)
+{
+	if (QuetzalFileTransferJob *job = QuetzalFileTransferJob::get(xfer))
+		job->handleCancel(false);
+}
+
+PurpleXferUiOps quetzal_xfer_uiops =
+{
+	quetzal_xfer_new,
+	quetzal_xfer_destroy,
+	quetzal_xfer_add,
+	quetzal_xfer_update_progress,
+	quetzal_xfer_cancel_local,
+	quetzal_xfer_cancel_remote,
+	// No ui_write, ui_read and data_not_sent, so libpurple moves data
+	// between socket and local file itself
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
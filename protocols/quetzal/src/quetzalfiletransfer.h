@@ -22,47 +22,64 @@
 ** $QUTIM_END_LICENSE$
 **
 ****************************************************************************/
-//#ifndef QUETZALFILETRANSFER_H
-//#define QUETZALFILETRANSFER_H
-//
-//#include <purple.h>
-//#include <qutim/filetransfer.h>
-//#include "quetzalcontact.h"
-//
-//using namespace qutim_sdk_0_3;
-//class QuetzalFileTransfer;
-//
-//class QuetzalFileTransferEngine : public FileTransferEngine
-//{
-//	Q_OBJECT
-//public:
-//	QuetzalFileTransferEngine(QuetzalContact *, Direction, QuetzalFileTransfer *);
-//	virtual int progress() const;
-//	virtual int currentFile() const;
-//	virtual QStringList files() const;
-//	virtual QStringList remoteFiles() const;
-//	virtual void setFiles(const QStringList &);
-//	virtual qint64 totalSize() const;
-//	virtual qint64 fileSize() const;
-//	virtual int localPort() const;
-//	virtual int remotePort() const;
-//	virtual QHostAddress remoteAddress() const;
-//	Direction direction() const;
-//	virtual State state() const;
-//	virtual void start();
-//	virtual void cancel();
-//};
-//
-//class QuetzalFileTransfer : public FileTransferFactory
-//{
-//	Q_OBJECT
-//public:
-//    QuetzalFileTransfer();
-//	virtual bool check(ChatUnit *unit);
-//	virtual FileTransferEngine *create(ChatUnit *unit);
-//};
-//
-//extern PurpleXferUiOps quetzal_xfer_uiops;
-//
-//#endif // QUETZALFILETRANSFER_H
 
+#ifndef QUETZALFILETRANSFER_H
+#define QUETZALFILETRANSFER_H
+
+#include <purple.h>
+#include <qutim/filetransfer.h>
+#include <QBasicTimer>
+#include <QPointer>
+
+using namespace qutim_sdk_0_3;
+
+// libpurple reads and writes local files by itself, so data of the transfer
+// never passes through Qt. Job only mirrors state and progress of the xfer.
+class QuetzalFileTransferJob : public FileTransferJob
+{
+	Q_OBJECT
+public:
+	QuetzalFileTransferJob(ChatUnit *unit, Direction direction, FileTransferFactory *factory);
+	~QuetzalFileTransferJob();
+
+	static QuetzalFileTransferJob *get(PurpleXfer *xfer);
+	void setXfer(PurpleXfer *xfer);
+	// Fills file info of incoming job by its xfer
+	void initIncoming();
+	void setRequest(QObject *request, GCallback okCb, GCallback cancelCb, void *userData);
+	void handleProgress();
+	void handleCancel(bool local);
+	void handleDestroy();
+protected:
+	virtual void doSend();
+	virtual void doStop();
+	virtual void doReceive();
+	virtual void timerEvent(QTimerEvent *ev);
+private:
+	void updateProgress();
+	PurpleXfer *m_xfer;
+	QBasicTimer m_progressTimer;
+	QPointer<QObject> m_request;
+	PurpleRequestFileCb m_okCb;
+	PurpleRequestFileCb m_cancelCb;
+	void *m_userData;
+};
+
+class QuetzalFileTransferFactory : public FileTransferFactory
+{
+	Q_OBJECT
+public:
+	QuetzalFileTransferFactory();
+	virtual bool checkAbility(ChatUnit *unit);
+	virtual bool startObserve(ChatUnit *unit);
+	virtual bool stopObserve(ChatUnit *unit);
+	virtual FileTransferJob *create(ChatUnit *unit);
+};
+
+// Takes file request of incoming xfer, returns 0 for any other request
+void *quetzal_xfer_request_file(const char *filename, GCallback okCb, GCallback cancelCb,
+								void *userData);
+
+extern PurpleXferUiOps quetzal_xfer_uiops;
+
+#endif // QUETZALFILETRANSFER_H
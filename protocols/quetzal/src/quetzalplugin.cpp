@@ -33,6 +33,7 @@
 #include "quetzaljoinchatdialog.h"
 #include "quetzalblist.h"
 #include "quetzalnotify.h"
+#include "quetzalfiletransfer.h"
 #include <qutim/event.h>
 #include <qutim/systeminfo.h>
 #include <purple.h>
@@ -550,6 +551,7 @@ static void quetzal_ui_init(void)
 	purple_blist_set_ui_ops(&quetzal_blist_uiops);
 	purple_accounts_set_ui_ops(&quetzal_accounts_uiops);
 	purple_request_set_ui_ops(&quetzal_request_uiops);
+	purple_xfers_set_ui_ops(&quetzal_xfer_uiops);
 
 	Event("quetzal-ui-ops-inited").send();
 }
@@ -696,6 +698,9 @@ void QuetzalPlugin::init()
 			return;
 	}
 	initLibPurple();
+	addExtension(QT_TRANSLATE_NOOP("Plugin", "Quetzal file transfer"),
+				 QT_TRANSLATE_NOOP("Plugin", "File transfers of libpurple protocols"),
+				 new SingletonGenerator<QuetzalFileTransferFactory, FileTransferFactory>());
 	QByteArray imPrefix("im-");
 	for(GList *it = purple_plugins_get_protocols(); it != NULL; it = it->next)
 	{
@@ -38,6 +38,7 @@
 #include <cstdarg>
 #include "quetzalfiledialog.h"
 #include "quetzalaccount.h"
+#include "quetzalfiletransfer.h"
 
 using namespace qutim_sdk_0_3;
 
@@ -226,6 +227,9 @@ void *quetzal_request_file(const char *title, const char *filename,
 	Q_UNUSED(account);
 	Q_UNUSED(who);
 	Q_UNUSED(conv);
+	// Incoming files are accepted by file transfer manager
+	if (void *handle = quetzal_xfer_request_file(filename, ok_cb, cancel_cb, user_data))
+		return handle;
 	QFileInfo info = QString(filename);
 	QFileDialog *dialog = new QFileDialog;
 	new QuetzalFileDialog(title, info.absolutePath(), ok_cb, cancel_cb, user_data, dialog);
@@ -0,0 +1,521 @@
+/****************************************************************************
+**
+** qutIM - instant messenger
+**
+** Copyright © 2014 Ruslan Nigmatullin <euroelessar@yandex.ru>
+**
+*****************************************************************************
+**
+** $QUTIM_BEGIN_LICENSE$
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/.
+** $QUTIM_END_LICENSE$
+**
+****************************************************************************/
+
+// Replay benchmark of protocol parsers. Captured server to client streams
+// are fed through the same read loops as the connections use, from a device
+// which hands data out in portions as a socket does on every readyRead.
+// Corpus directory contains "oscar", "mrim" and "irc" subdirectories with
+// one raw stream per file, see --write-seeds for the synthetic ones.
+//
+// Every stream is replayed at once and in small portions, parse results must
+// not depend on that, exit code is non-zero otherwise. Built with qbs property
+// parserbench.fuzzTarget set to a protocol name this file is a libFuzzer
+// target instead, which accepts the same corpus.
+
+#include "../../oscar/src/flap.h"
+#include "../../oscar/src/snac.h"
+#include "../../mrim/src/base/mrimpacket.h"
+#include "../../mrim/src/base/lpstring.h"
+#include "../../irc/src/ircmessage.h"
+#include "../../../core/test/benchreport.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTextCodec>
+#include <QTextStream>
+#include <string.h>
+
+using namespace qutim_sdk_0_3;
+
+namespace ParserBench
+{
+
+// Typical TCP segment and the one which splits every header
+enum { SegmentSize = 1460, SmallPortion = 7 };
+
+// Data arrives by portions, nothing is available before receive()
+class ReplayDevice : public QIODevice
+{
+public:
+	ReplayDevice(const QByteArray &data, int portion)
+		: m_data(data), m_portion(portion), m_pos(0), m_arrived(0)
+	{
+		open(ReadOnly | Unbuffered);
+	}
+
+	bool receive()
+	{
+		if (m_arrived >= m_data.size())
+			return false;
+		m_arrived = qMin(m_data.size(), m_arrived + m_portion);
+		return true;
+	}
+	bool isSequential() const { return true; }
+	qint64 bytesAvailable() const { return m_arrived - m_pos + QIODevice::bytesAvailable(); }
+	bool canReadLine() const
+	{
+		return memchr(m_data.constData() + m_pos, '\n', m_arrived - m_pos)
+				|| QIODevice::canReadLine();
+	}
+
+protected:
+	qint64 readData(char *data, qint64 maxSize)
+	{
+		const int size = int(qMin<qint64>(maxSize, m_arrived - m_pos));
+		memcpy(data, m_data.constData() + m_pos, size);
+		m_pos += size;
+		return size;
+	}
+	qint64 readLineData(char *data, qint64 maxSize)
+	{
+		const char *begin = m_data.constData() + m_pos;
+		const char *end = static_cast<const char *>(memchr(begin, '\n', m_arrived - m_pos));
+		const qint64 size = end ? end - begin + 1 : m_arrived - m_pos;
+		return readData(data, qMin(size, maxSize));
+	}
+	qint64 writeData(const char *, qint64) { return -1; }
+
+private:
+	QByteArray m_data;
+	int m_portion;
+	int m_pos;
+	int m_arrived;
+};
+
+struct Counters
+{
+	Counters() : packets(0), fields(0), checksum(0), failed(false) {}
+	bool operator==(const Counters &o) const
+	{
+		return packets == o.packets && fields == o.fields
+				&& checksum == o.checksum && failed == o.failed;
+	}
+	bool operator!=(const Counters &o) const { return !operator==(o); }
+	void add(quint32 value) { checksum = checksum * 31 + value; }
+	void add(const QString &value) { add(qHash(value)); ++fields; }
+
+	qint64 packets;
+	qint64 fields;
+	quint32 checksum;
+	bool failed;
+};
+
+// Mirrors AbstractConnection::readData, SNACs are walked as their handlers do
+class OscarReplay
+{
+public:
+	bool readData(QIODevice *device, Counters &counters)
+	{
+		using namespace oscar;
+		while (device->bytesAvailable() > 0) {
+			if (!m_flap.readData(device))
+				return false;
+			if (!m_flap.isFinished())
+				continue;
+			counters.add(m_flap.channel());
+			if (m_flap.channel() == 0x02) {
+				const SNAC snac = SNAC::fromByteArray(m_flap.data());
+				counters.add(snac.family() << 16 | snac.subtype());
+				readTlvs(snac, counters);
+			} else if (m_flap.channel() == 0x01 || m_flap.channel() == 0x04) {
+				const DataUnit data(m_flap.data());
+				if (m_flap.channel() == 0x01)
+					counters.add(data.read<quint32>());
+				readTlvs(data, counters);
+			}
+			m_flap.clear();
+			++counters.packets;
+		}
+		return true;
+	}
+
+private:
+	static void readTlvs(const oscar::DataUnit &data, Counters &counters)
+	{
+		const oscar::TLVMapView tlvs = data.read<oscar::TLVMapView>();
+		for (oscar::TLVMap::const_iterator it = tlvs.constBegin(); it != tlvs.constEnd(); ++it) {
+			counters.add(it.key());
+			counters.add(qHash(it->data()));
+			++counters.fields;
+		}
+	}
+
+	oscar::FLAP m_flap;
+};
+
+// Mirrors MrimConnection::readPackets, messages and statuses are read as
+// MrimMessages and MrimRoster do, other packets as a sequence of numbers
+class MrimReplay
+{
+public:
+	MrimReplay() : m_offset(0) {}
+
+	bool readData(QIODevice *device, Counters &counters)
+	{
+		if (m_offset == m_buffer.size()) {
+			m_buffer.resize(0);
+			m_offset = 0;
+		} else if (m_offset > m_buffer.size() / 2) {
+			m_buffer.remove(0, m_offset);
+			m_offset = 0;
+		}
+		const int oldSize = m_buffer.size();
+		const qint64 available = device->bytesAvailable();
+		m_buffer.resize(oldSize + available);
+		const qint64 bytesRead = device->read(m_buffer.data() + oldSize, available);
+		m_buffer.resize(oldSize + qMax<qint64>(bytesRead, 0));
+
+		forever {
+			const int used = m_packet.readFrom(m_buffer.constData() + m_offset, m_buffer.size() - m_offset);
+			if (used < 0)
+				return false;
+			if (used == 0)
+				return true;
+			m_offset += used;
+			++counters.packets;
+			processPacket(counters);
+			m_packet.clear();
+		}
+	}
+
+private:
+	void processPacket(Counters &counters)
+	{
+		counters.add(m_packet.msgType());
+		quint32 number = 0;
+		QString string;
+		switch (m_packet.msgType()) {
+		case MRIM_CS_MESSAGE_ACK: {
+			quint32 flags = 0;
+			m_packet.readTo(number);
+			m_packet.readTo(flags);
+			m_packet.readTo(&string);
+			counters.add(string);
+			m_packet.readTo(&string, !(flags & MESSAGE_FLAG_CP1251));
+			counters.add(string);
+			break;
+		}
+		case MRIM_CS_USER_STATUS:
+			m_packet.readTo(number);
+			for (int i = 0; i < 4; ++i) {
+				m_packet.readTo(&string, i == 1 || i == 2);
+				counters.add(string);
+			}
+			break;
+		default:
+			while (!m_packet.atEnd()) {
+				m_packet.readTo(number);
+				counters.add(number);
+			}
+			break;
+		}
+	}
+
+	MrimPacket m_packet;
+	QByteArray m_buffer;
+	int m_offset;
+};
+
+// Mirrors IrcConnection::readData without dispatching to handlers
+class IrcReplay
+{
+public:
+	IrcReplay() : m_codec(QTextCodec::codecForName("utf-8")) {}
+
+	bool readData(QIODevice *device, Counters &counters)
+	{
+		irc::IrcMessage message;
+		while (device->canReadLine()) {
+			const QByteArray line = device->readLine();
+			if (!message.parse(line))
+				continue;
+			++counters.packets;
+			counters.add(m_codec->toUnicode(message.name()));
+			counters.add(m_codec->toUnicode(message.host()));
+			counters.add(QString::fromLatin1(message.command()));
+			foreach (const irc::IrcMessage::Tag &tag, message.tags())
+				counters.add(qHash(tag.first) ^ qHash(tag.second));
+			foreach (const QString &param, message.params(m_codec))
+				counters.add(param);
+		}
+		return true;
+	}
+
+private:
+	QTextCodec *m_codec;
+};
+
+template <typename Replay>
+static Counters replay(const QByteArray &data, int portion)
+{
+	Replay parser;
+	ReplayDevice device(data, portion);
+	Counters counters;
+	while (device.receive()) {
+		if (!parser.readData(&device, counters)) {
+			counters.failed = true;
+			break;
+		}
+	}
+	return counters;
+}
+
+static Counters replay(const QString &protocol, const QByteArray &data, int portion)
+{
+	if (protocol == QLatin1String("oscar"))
+		return replay<OscarReplay>(data, portion);
+	else if (protocol == QLatin1String("mrim"))
+		return replay<MrimReplay>(data, portion);
+	return replay<IrcReplay>(data, portion);
+}
+
+static void silentMessageHandler(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+} // namespace ParserBench
+
+using namespace ParserBench;
+
+#if defined(PARSERBENCH_FUZZ_OSCAR) || defined(PARSERBENCH_FUZZ_MRIM) || defined(PARSERBENCH_FUZZ_IRC)
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	static QCoreApplication app(*argc, *argv);
+	qInstallMessageHandler(silentMessageHandler);
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+#if defined(PARSERBENCH_FUZZ_OSCAR)
+	typedef OscarReplay Replay;
+#elif defined(PARSERBENCH_FUZZ_MRIM)
+	typedef MrimReplay Replay;
+#else
+	typedef IrcReplay Replay;
+#endif
+	const QByteArray input = QByteArray::fromRawData(reinterpret_cast<const char *>(data), int(size));
+	const Counters whole = replay<Replay>(input, qMax(1, input.size()));
+	const Counters split = replay<Replay>(input, SmallPortion);
+	if (whole != split)
+		abort();
+	return 0;
+}
+
+#else
+
+static QByteArray oscarSeed()
+{
+	using namespace oscar;
+	QByteArray result;
+	quint16 sequence = 0;
+	FLAP hello(0x01);
+	hello.setSeqNum(sequence++);
+	hello.append<quint32>(0x00000001);
+	result += hello.toByteArray();
+	for (int i = 0; i < 64; ++i) {
+		// Incoming ICBM on channel one, a few flagged ones carry extra block
+		SNAC snac(0x0004, 0x0007);
+		snac.setFlags(i % 8 == 0 ? 0x8000 : 0);
+		if (snac.flags() & 0x8000) {
+			snac.append<quint16>(4);
+			snac.append<quint32>(i);
+		}
+		snac.append(TLV(0x0001, QByteArray::number(100000 + i)));
+		snac.append(TLV(0x0002, QString::fromUtf8("сообщение номер %1").arg(i).toUtf8()));
+		snac.append(TLV(0x0003, QByteArray(i * 17 % 700, 'x')));
+		FLAP flap(0x02);
+		flap.setSeqNum(sequence++);
+		flap.append(snac.toByteArray());
+		result += flap.toByteArray();
+	}
+	FLAP alive(0x05);
+	alive.setSeqNum(sequence++);
+	result += alive.toByteArray();
+	FLAP close(0x04);
+	close.setSeqNum(sequence++);
+	close.append(TLV(0x0009, QByteArray("bye")));
+	result += close.toByteArray();
+	return result;
+}
+
+static QByteArray mrimSeed()
+{
+	QByteArray result;
+	quint32 sequence = 1;
+	for (int i = 0; i < 64; ++i) {
+		MrimPacket packet(MrimPacket::Compose);
+		packet.setSequence(sequence++);
+		if (i % 4 == 3) {
+			packet.setMsgType(MRIM_CS_USER_STATUS);
+			packet.append(quint32(1));
+			packet.append(QStringLiteral("status_chat"));
+			packet.append(QString::fromUtf8("Статус %1").arg(i), true);
+			packet.append(QStringLiteral("description"), true);
+			packet.append(QStringLiteral("user%1@mail.ru").arg(i));
+		} else {
+			packet.setMsgType(MRIM_CS_MESSAGE_ACK);
+			packet.append(quint32(i));
+			packet.append(quint32(i % 2 ? MESSAGE_FLAG_CP1251 : 0));
+			packet.append(QStringLiteral("user%1@mail.ru").arg(i));
+			packet.append(QString::fromUtf8("привет %1 ").arg(i).repeated(1 + i % 13), i % 2 == 0);
+		}
+		result += packet.toByteArray();
+	}
+	return result;
+}
+
+static QByteArray ircSeed()
+{
+	QByteArray result;
+	result += ":irc.example.org 001 bench :Welcome to the network bench\r\n";
+	result += ":irc.example.org 353 bench = #bench :bench @op +voice user1 user2\r\n";
+	for (int i = 0; i < 64; ++i) {
+		if (i % 8 == 0)
+			result += "@time=2014-01-01T10:00:00.000Z;account=user :";
+		else
+			result += ":";
+		result += "user" + QByteArray::number(i % 5) + "!~user@host.example.org PRIVMSG #bench :";
+		result += QString::fromUtf8("сообщение ").toUtf8().repeated(1 + i % 9) + "\r\n";
+	}
+	result += "PING :irc.example.org\r\n";
+	return result;
+}
+
+static bool writeSeeds(const QDir &dir)
+{
+	const QPair<QString, QByteArray> seeds[] = {
+		qMakePair(QStringLiteral("oscar"), oscarSeed()),
+		qMakePair(QStringLiteral("mrim"), mrimSeed()),
+		qMakePair(QStringLiteral("irc"), ircSeed())
+	};
+	for (const QPair<QString, QByteArray> &seed : seeds) {
+		QFile file(dir.filePath(seed.first + QStringLiteral("/synthetic.dump")));
+		if (!dir.mkpath(seed.first) || !file.open(QIODevice::WriteOnly) || file.write(seed.second) != seed.second.size())
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QStringLiteral("Replay benchmark of oscar, mrim and irc parsers"));
+	parser.addHelpOption();
+	QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("Replays of every stream"), QStringLiteral("count"), QStringLiteral("20"));
+	QCommandLineOption portionOption(QStringLiteral("portion"), QStringLiteral("Bytes per readyRead"), QStringLiteral("bytes"), QString::number(SegmentSize));
+	QCommandLineOption seedsOption(QStringLiteral("write-seeds"), QStringLiteral("Write synthetic corpus and exit"));
+	parser.addOption(iterationsOption);
+	parser.addOption(portionOption);
+	parser.addOption(seedsOption);
+	const QCommandLineOption jsonOption = Bench::Report::option();
+	parser.addOption(jsonOption);
+	parser.addPositionalArgument(QStringLiteral("corpus"), QStringLiteral("Directories with oscar, mrim and irc subdirectories"));
+	parser.process(app);
+
+	QTextStream out(stdout);
+	if (parser.positionalArguments().isEmpty())
+		parser.showHelp(1);
+	if (parser.isSet(seedsOption)) {
+		if (!writeSeeds(QDir(parser.positionalArguments().first()))) {
+			out << "Can't write seeds" << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	qInstallMessageHandler(silentMessageHandler);
+	const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+	const int portion = qMax(1, parser.value(portionOption).toInt());
+	int result = 0;
+	Bench::Report report(QStringLiteral("parser"));
+	report.setParameter(QStringLiteral("iterations"), iterations);
+	report.setParameter(QStringLiteral("portion"), portion);
+
+	out << QStringLiteral("%1 %2 %3 %4 %5")
+	       .arg(QStringLiteral("protocol"), -8)
+	       .arg(QStringLiteral("streams"), 8)
+	       .arg(QStringLiteral("MiB/s"), 10)
+	       .arg(QStringLiteral("packets/s"), 12)
+	       .arg(QStringLiteral("failed"), 7) << endl;
+
+	foreach (const QString &protocol, QStringList() << "oscar" << "mrim" << "irc") {
+		QList<QByteArray> streams;
+		foreach (const QString &corpus, parser.positionalArguments()) {
+			const QDir dir(QDir(corpus).filePath(protocol));
+			foreach (const QFileInfo &info, dir.entryInfoList(QDir::Files, QDir::Name)) {
+				QFile file(info.filePath());
+				if (file.open(QIODevice::ReadOnly))
+					streams << file.readAll();
+			}
+		}
+		if (streams.isEmpty())
+			continue;
+
+		qint64 bytes = 0;
+		qint64 packets = 0;
+		int failed = 0;
+		foreach (const QByteArray &stream, streams) {
+			const Counters whole = replay(protocol, stream, qMax(1, stream.size()));
+			const Counters split = replay(protocol, stream, SmallPortion);
+			if (whole != split) {
+				out << protocol << ": stream of " << stream.size() << " bytes is parsed"
+				    << " differently when split, " << whole.packets << " vs "
+				    << split.packets << " packets" << endl;
+				result = 1;
+			}
+			failed += whole.failed;
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; ++i) {
+			foreach (const QByteArray &stream, streams) {
+				packets += replay(protocol, stream, portion).packets;
+				bytes += stream.size();
+			}
+		}
+		const double seconds = qMax<qint64>(timer.nsecsElapsed(), 1) / 1e9;
+
+		out << QStringLiteral("%1 %2 %3 %4 %5")
+		       .arg(protocol, -8)
+		       .arg(streams.size(), 8)
+		       .arg(bytes / seconds / (1 << 20), 10, 'f', 1)
+		       .arg(packets / seconds, 12, 'f', 0)
+		       .arg(failed, 7) << endl;
+		report.add(protocol + QStringLiteral("/throughput"), bytes / seconds / (1 << 20),
+		           QStringLiteral("MiB/s"), Bench::Report::HigherIsBetter);
+		report.add(protocol + QStringLiteral("/packets"), packets / seconds,
+		           QStringLiteral("packets/s"), Bench::Report::HigherIsBetter);
+	}
+	if (parser.isSet(jsonOption) && !report.write(parser.value(jsonOption)))
+		return 2;
+	return result;
+}
+
+#endif
@@ -27,6 +27,7 @@
 #include <qutim/chatunit.h>
 #include <qutim/passworddialog.h>
 #include <qutim/systemintegration.h>
+#include <qutim/avatarstore.h>
 
 #include "vcontact.h"
 #include "vprotocol.h"
@@ -42,6 +43,7 @@
 
 #include <QWebView>
 #include <QWebFrame>
+#include <QFile>
 
 const static int qutimId = 1865463;
 
@@ -128,6 +130,14 @@ VContact *VAccount::me() const
 void VAccount::downloadAvatar(VContact *contact)
 {
 	QUrl url = contact->buddy()->photoSource(VK_PHOTO_SOURCE);
+	if (url.isEmpty())
+		return;
+	const QString alias = QLatin1String("url:") + url.toString(QUrl::FullyEncoded);
+	const QString stored = AvatarStore::path(alias);
+	if (!stored.isEmpty()) {
+		contact->setAvatar(stored);
+		return;
+	}
 	QString path = contentDownloader()->download(url);
 	m_contentRecieversHash.insert(path, contact);
 }
@@ -227,8 +237,15 @@ void VAccount::onError(Vreen::Client::Error error)
 void VAccount::onContentDownloaded(const QString &path)
 {
 	VContact *c = m_contentRecieversHash.take(path);
-	if (c)
-		c->setAvatar(path);
+	if (!c)
+		return;
+	// Shared store deduplicates avatars of contacts known by several accounts
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+	const QUrl url = c->buddy()->photoSource(VK_PHOTO_SOURCE);
+	const QString stored = AvatarStore::store(file.readAll(), QLatin1String("url:") + url.toString(QUrl::FullyEncoded));
+	c->setAvatar(stored.isEmpty() ? path : stored);
 }
 
 void VAccount::onClientStateChanged(Vreen::Client::State state)
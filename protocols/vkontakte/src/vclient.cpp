@@ -23,11 +23,65 @@
 **
 ****************************************************************************/
 #include "vclient.h"
+#include <vreen/reply.h>
+#include <qutim/json.h>
+#include <QDateTime>
+#include <QStringList>
+#include <qmath.h>
+
+using namespace qutim_sdk_0_3;
+
+enum {
+	// Time to collect calls before sending them
+	BatchWindow = 50,
+	// VK refuses execute with more API calls than this
+	MaxBatchSize = 25,
+	// Requests allowed per second and burst size
+	RequestsPerSecond = 3,
+	CacheTimeout = 5 * 60 * 1000,
+	CacheSize = 512
+};
+
+static bool isCacheable(const QString &method)
+{
+	static const QStringList methods = QStringList()
+			<< QLatin1String("users.get")
+			<< QLatin1String("getProfiles")
+			<< QLatin1String("friends.get")
+			<< QLatin1String("places.getCities")
+			<< QLatin1String("places.getCountries");
+	return methods.contains(method);
+}
+
+static QString cacheKey(const QString &method, const QVariantMap &args)
+{
+	// QVariantMap is ordered, so equal requests give equal keys
+	QString key = method;
+	for (QVariantMap::const_iterator it = args.constBegin(); it != args.constEnd(); ++it) {
+		key += QLatin1Char('&');
+		key += it.key();
+		key += QLatin1Char('=');
+		key += it.value().toString();
+	}
+	return key;
+}
+
+void VReply::deliver()
+{
+	emit resultReady(m_response);
+	deleteLater();
+}
 
 VClient::VClient(const QString &login, QObject *parent) :
-    Vreen::Client(parent)
+	Vreen::Client(parent),
+	m_cache(CacheSize),
+	m_tokens(RequestsPerSecond)
 {
-    setLogin(login);
+	setLogin(login);
+	m_flushTimer.setSingleShot(true);
+	m_tokenTimer.start();
+	connect(&m_flushTimer, SIGNAL(timeout()), SLOT(flushQueue()));
+	connect(this, SIGNAL(onlineStateChanged(bool)), SLOT(onOnlineStateChanged(bool)));
 }
 
 QObject *VClient::request(const QString &method, const QVariantMap &args)
@@ -35,3 +89,148 @@ QObject *VClient::request(const QString &method, const QVariantMap &args)
     return Vreen::Client::request(method, args);
 }
 
+VReply *VClient::queueRequest(const QString &method, const QVariantMap &args)
+{
+	VReply *reply = new VReply(this);
+	QString key;
+	if (isCacheable(method)) {
+		key = cacheKey(method, args);
+		if (CacheEntry *entry = m_cache.object(key)) {
+			if (QDateTime::currentMSecsSinceEpoch() - entry->timestamp < CacheTimeout) {
+				reply->m_response = entry->response;
+				QMetaObject::invokeMethod(reply, "deliver", Qt::QueuedConnection);
+				return reply;
+			}
+			m_cache.remove(key);
+		}
+		// Same request is already on its way, just wait for it
+		if (PendingCallPtr call = m_sharedCalls.value(key)) {
+			call->replies << reply;
+			return reply;
+		}
+	}
+
+	PendingCallPtr call(new PendingCall);
+	call->method = method;
+	call->args = args;
+	call->cacheKey = key;
+	call->replies << reply;
+	if (!key.isEmpty())
+		m_sharedCalls.insert(key, call);
+	m_queue << call;
+	if (!m_flushTimer.isActive())
+		m_flushTimer.start(BatchWindow);
+	return reply;
+}
+
+bool VClient::takeToken()
+{
+	m_tokens = qMin<double>(RequestsPerSecond,
+							m_tokens + m_tokenTimer.restart() * RequestsPerSecond / 1000.0);
+	if (m_tokens < 1)
+		return false;
+	m_tokens -= 1;
+	return true;
+}
+
+void VClient::flushQueue()
+{
+	if (m_queue.isEmpty())
+		return;
+	if (!takeToken()) {
+		m_flushTimer.start(qCeil((1 - m_tokens) * 1000 / RequestsPerSecond));
+		return;
+	}
+
+	QList<PendingCallPtr> batch = m_queue.mid(0, MaxBatchSize);
+	m_queue.erase(m_queue.begin(), m_queue.begin() + batch.size());
+
+	Vreen::Reply *reply;
+	if (batch.size() == 1) {
+		reply = Vreen::Client::request(batch.first()->method, batch.first()->args);
+	} else {
+		QByteArray code = "return [";
+		for (int i = 0; i < batch.size(); ++i) {
+			if (i)
+				code += ',';
+			code += "API.";
+			code += batch.at(i)->method.toUtf8();
+			code += '(';
+			code += Json::generate(batch.at(i)->args);
+			code += ')';
+		}
+		code += "];";
+		QVariantMap args;
+		args.insert(QLatin1String("code"), QString::fromUtf8(code));
+		reply = Vreen::Client::request(QLatin1String("execute"), args);
+	}
+	m_batches.insert(reply, batch);
+	connect(reply, SIGNAL(resultReady(QVariant)), SLOT(onBatchFinished()));
+	connect(reply, SIGNAL(destroyed(QObject*)), SLOT(onBatchDestroyed(QObject*)));
+
+	if (!m_queue.isEmpty())
+		m_flushTimer.start(BatchWindow);
+}
+
+void VClient::onBatchFinished()
+{
+	Vreen::Reply *reply = static_cast<Vreen::Reply*>(sender());
+	QList<PendingCallPtr> batch = m_batches.take(reply);
+	disconnect(reply, SIGNAL(destroyed(QObject*)), this, SLOT(onBatchDestroyed(QObject*)));
+	reply->deleteLater();
+
+	QVariantList results;
+	if (batch.size() == 1)
+		results << reply->response();
+	else
+		results = reply->response().toList();
+	for (int i = 0; i < batch.size(); ++i) {
+		// Failed calls inside of execute are reported as false
+		const QVariant result = results.value(i);
+		const bool ok = i < results.size()
+				&& !(result.type() == QVariant::Bool && !result.toBool());
+		finishCall(batch.at(i), result, ok);
+	}
+}
+
+void VClient::onBatchDestroyed(QObject *object)
+{
+	foreach (const PendingCallPtr &call, m_batches.take(object))
+		finishCall(call, QVariant(), false);
+}
+
+void VClient::onOnlineStateChanged(bool isOnline)
+{
+	if (isOnline)
+		return;
+	m_flushTimer.stop();
+	m_cache.clear();
+	QList<PendingCallPtr> queue;
+	qSwap(queue, m_queue);
+	foreach (const PendingCallPtr &call, queue)
+		finishCall(call, QVariant(), false);
+}
+
+void VClient::finishCall(const PendingCallPtr &call, const QVariant &response, bool ok)
+{
+	if (!call->cacheKey.isEmpty()) {
+		m_sharedCalls.remove(call->cacheKey);
+		if (ok) {
+			CacheEntry *entry = new CacheEntry;
+			entry->response = response;
+			entry->timestamp = QDateTime::currentMSecsSinceEpoch();
+			m_cache.insert(call->cacheKey, entry);
+		}
+	}
+	foreach (const QPointer<VReply> &reply, call->replies) {
+		if (!reply)
+			continue;
+		if (ok) {
+			reply->m_response = response;
+			emit reply->resultReady(response);
+		} else {
+			emit reply->error();
+		}
+		reply->deleteLater();
+	}
+}
@@ -25,6 +25,29 @@
 #ifndef VCLIENT_H
 #define VCLIENT_H
 #include <vreen/client.h>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QTimer>
+
+class VClient;
+
+class VReply : public QObject
+{
+	Q_OBJECT
+public:
+	QVariant response() const { return m_response; }
+signals:
+	void resultReady(const QVariant &response);
+	void error();
+private slots:
+	void deliver();
+private:
+	explicit VReply(QObject *parent) : QObject(parent) {}
+	QVariant m_response;
+	friend class VClient;
+};
 
 class VClient : public Vreen::Client
 {
@@ -32,6 +55,39 @@ class VClient : public Vreen::Client
 public:
 	explicit VClient(const QString &login, QObject *parent = 0);
 	Q_INVOKABLE QObject *request(const QString &method, const QVariantMap &args = QVariantMap());
+	// Calls queued within short window are sent together as single execute
+	// request, responses of idempotent methods are cached for a while
+	VReply *queueRequest(const QString &method, const QVariantMap &args = QVariantMap());
+private slots:
+	void flushQueue();
+	void onBatchFinished();
+	void onBatchDestroyed(QObject *object);
+	void onOnlineStateChanged(bool isOnline);
+private:
+	struct PendingCall
+	{
+		QString method;
+		QVariantMap args;
+		QString cacheKey;
+		QList<QPointer<VReply> > replies;
+	};
+	typedef QSharedPointer<PendingCall> PendingCallPtr;
+	struct CacheEntry
+	{
+		QVariant response;
+		qint64 timestamp;
+	};
+
+	bool takeToken();
+	void finishCall(const PendingCallPtr &call, const QVariant &response, bool ok);
+
+	QList<PendingCallPtr> m_queue;
+	QHash<QString, PendingCallPtr> m_sharedCalls;
+	QHash<QObject*, QList<PendingCallPtr> > m_batches;
+	QCache<QString, CacheEntry> m_cache;
+	QTimer m_flushTimer;
+	QElapsedTimer m_tokenTimer;
+	double m_tokens;
 };
 
 #endif // VCLIENT_H
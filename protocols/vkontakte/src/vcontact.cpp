@@ -130,36 +130,52 @@ QString VContact::activity() const
 
 void VContact::handleMessage(const Vreen::Message &msg)
 {
-	if (!msg.isIncoming() && m_unreachedMessagesCount) {
-		m_pendingMessages.append(msg);
-		return;
-	}
+	handleMessages(Vreen::MessageList() << msg);
+}
 
-	SentMessagesList::iterator i = m_sentMessages.begin();
-	for (; i != m_sentMessages.end(); ++i) {
-		if (i->second == msg.id()) {
-			ChatSession *s = ChatLayer::get(this);
-			qApp->postEvent(s, new MessageReceiptEvent(i->first, true));
-			m_sentMessages.removeAt(i - m_sentMessages.begin());
-			return;
+void VContact::handleMessages(const Vreen::MessageList &messages)
+{
+	qutim_sdk_0_3::MessageList coreMessages;
+	Vreen::IdList readIds;
+	qutim_sdk_0_3::ChatSession *s = ChatLayer::get(this);
+	foreach (const Vreen::Message &msg, messages) {
+		if (!msg.isIncoming() && m_unreachedMessagesCount) {
+			m_pendingMessages.append(msg);
+			continue;
 		}
-	}
-
-	qutim_sdk_0_3::Message coreMessage(msg.body().replace("<br>", "\n"));
-	coreMessage.setChatUnit(this);
-	coreMessage.setIncoming(msg.isIncoming());
-	coreMessage.setProperty("mid", msg.id());
-	coreMessage.setProperty("subject", msg.subject());
 
-	qutim_sdk_0_3::ChatSession *s = ChatLayer::get(this);
-	if (msg.isIncoming()) {
-		if (!s->isActive())
-			m_unreadMessages.append(coreMessage);
-		else
-			chatSession()->markMessagesAsRead(Vreen::IdList() << msg.id(), true);
-	} else
-		coreMessage.setProperty("history", true);
-	s->appendMessage(coreMessage);
+		bool isReceipt = false;
+		SentMessagesList::iterator i = m_sentMessages.begin();
+		for (; i != m_sentMessages.end(); ++i) {
+			if (i->second == msg.id()) {
+				qApp->postEvent(s, new MessageReceiptEvent(i->first, true));
+				m_sentMessages.erase(i);
+				isReceipt = true;
+				break;
+			}
+		}
+		if (isReceipt)
+			continue;
+
+		qutim_sdk_0_3::Message coreMessage(msg.body().replace("<br>", "\n"));
+		coreMessage.setChatUnit(this);
+		coreMessage.setIncoming(msg.isIncoming());
+		coreMessage.setProperty("mid", msg.id());
+		coreMessage.setProperty("subject", msg.subject());
+
+		if (msg.isIncoming()) {
+			if (!s->isActive())
+				m_unreadMessages.append(coreMessage);
+			else
+				readIds << msg.id();
+		} else
+			coreMessage.setProperty("history", true);
+		coreMessages << coreMessage;
+	}
+	if (!readIds.isEmpty())
+		chatSession()->markMessagesAsRead(readIds, true);
+	if (!coreMessages.isEmpty())
+		s->append(coreMessages);
 }
 
 Vreen::Client *VContact::client() const
@@ -287,10 +303,9 @@ void VContact::onMessageSent(const QVariant &)
 	}
 
 	if (!m_unreachedMessagesCount) {
-		foreach (Vreen::Message msg, m_pendingMessages) {
-			handleMessage(msg);
-		}
-		m_pendingMessages.clear();
+		Vreen::MessageList pending;
+		qSwap(pending, m_pendingMessages);
+		handleMessages(pending);
 	}
 }
 
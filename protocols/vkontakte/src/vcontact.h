@@ -58,6 +58,7 @@ public:
 	QString activity() const;
 
 	void handleMessage(const Vreen::Message &message);
+	void handleMessages(const Vreen::MessageList &messages);
 	Vreen::Client *client() const;
 	Vreen::Buddy *buddy() const;
 	VAccount *account();
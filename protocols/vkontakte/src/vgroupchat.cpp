@@ -76,24 +76,37 @@ VContact *VGroupChat::contact(int uid)
 
 void VGroupChat::handleMessage(const Vreen::Message &msg)
 {
-	if (!msg.fromId()) {
-		Vreen::Reply *reply = m_account->client()->getMessage(msg.id());
-		connect(reply, SIGNAL(resultReady(QVariant)), SLOT(onMessageGet(QVariant)));
-	} else {
+	handleMessages(Vreen::MessageList() << msg);
+}
+
+void VGroupChat::handleMessages(const Vreen::MessageList &messages)
+{
+	qutim_sdk_0_3::MessageList coreMessages;
+	Vreen::IdList readIds;
+	QStringList missingIds;
+	ChatSession *s = ChatLayer::get(this);
+	foreach (const Vreen::Message &msg, messages) {
+		if (!msg.fromId()) {
+			missingIds << QString::number(msg.id());
+			continue;
+		}
 		if (!msg.isIncoming() && m_unreachedMessagesCount) {
 			m_pendingMessages.append(msg);
-			return;
+			continue;
 		}
 
+		bool isReceipt = false;
 		SentMessagesList::iterator i = m_sentMessages.begin();
 		for (; i != m_sentMessages.end(); ++i) {
 			if (i->second == msg.id()) {
-				ChatSession *s = ChatLayer::get(this);
 				qApp->postEvent(s, new MessageReceiptEvent(i->first, true));
-				m_sentMessages.removeAt(i - m_sentMessages.begin());
-				return;
+				m_sentMessages.erase(i);
+				isReceipt = true;
+				break;
 			}
 		}
+		if (isReceipt)
+			continue;
 
 		qutim_sdk_0_3::Message coreMessage(msg.body().replace("<br>", "\n"));
 		coreMessage.setChatUnit(this);
@@ -106,15 +119,27 @@ void VGroupChat::handleMessage(const Vreen::Message &msg)
 		coreMessage.setProperty("senderName", from->name());
 		coreMessage.setProperty("senderId", from->id());
 
-		ChatSession *s = ChatLayer::get(this);
 		if (msg.isIncoming()) {
 			if (!s->isActive())
 				m_unreadMessages.append(coreMessage);
 			else
-				chatSession()->markMessagesAsRead(Vreen::IdList() << msg.id(), true);
+				readIds << msg.id();
 		} else
 			coreMessage.setProperty("history", true);
-		s->appendMessage(coreMessage);
+		coreMessages << coreMessage;
+	}
+	if (!readIds.isEmpty())
+		chatSession()->markMessagesAsRead(readIds, true);
+	if (!coreMessages.isEmpty())
+		s->append(coreMessages);
+
+	if (!missingIds.isEmpty()) {
+		// Bodies of all incomplete messages are fetched by one request
+		QVariantMap args;
+		args.insert(QLatin1String("mids"), missingIds.join(QLatin1String(",")));
+		VClient *client = static_cast<VClient*>(m_account->client());
+		VReply *reply = client->queueRequest(QLatin1String("messages.getById"), args);
+		connect(reply, SIGNAL(resultReady(QVariant)), SLOT(onMessageGet(QVariant)));
 	}
 }
 
@@ -244,9 +269,7 @@ void VGroupChat::onMessageGet(const QVariant &response)
 	QVariantList list = response.toList();
 	if (list.count()) {
 		Q_UNUSED(list.takeFirst());
-		Vreen::MessageList messageList = Vreen::Message::fromVariantList(list, m_account->client());
-		foreach (Vreen::Message msg, messageList)
-			handleMessage(msg);
+		handleMessages(Vreen::Message::fromVariantList(list, m_account->client()));
 	}
 }
 
@@ -262,10 +285,9 @@ void VGroupChat::onMessageSent(const QVariant &response)
 	}
 
 	if (!m_unreachedMessagesCount) {
-		foreach (Vreen::Message msg, m_pendingMessages) {
-			handleMessage(msg);
-		}
-		m_pendingMessages.clear();
+		Vreen::MessageList pending;
+		qSwap(pending, m_pendingMessages);
+		handleMessages(pending);
 	}
 }
 
@@ -54,6 +54,7 @@ public:
 	Vreen::GroupChatSession *chatSession() const;
 public slots:
 	void handleMessage(const Vreen::Message &message);
+	void handleMessages(const Vreen::MessageList &messages);
 protected:
 	virtual void doJoin();
 	virtual void doLeave();
@@ -26,6 +26,7 @@
 #include "vinforequest.h"
 #include "vaccount.h"
 #include "vcontact.h"
+#include "vclient.h"
 #include <qutim/json.h>
 #include <QNetworkReply>
 #include <QDate>
@@ -181,10 +182,10 @@ VInfoRequest::VInfoRequest(QObject *parent) :
 {
 	if (VAccount *account = qobject_cast<VAccount*>(parent)) {
 		m_id = QString::number(account->uid());
-		m_client = account->client();
+		m_client = static_cast<VClient*>(account->client());
 	} else if (VContact *contact = qobject_cast<VContact*>(parent)) {
 		m_id = contact->id();
-		m_client = static_cast<VAccount*>(contact->account())->client();
+		m_client = static_cast<VClient*>(static_cast<VAccount*>(contact->account())->client());
 	}
 	Q_ASSERT(m_client);
 }
@@ -238,9 +239,10 @@ void VInfoRequest::doRequest(const QSet<QString> &hints)
 	data.insert("fields",
 				"uid,first_name,last_name,nickname,sex,bdate,city,"
 				"country,photo_medium,has_mobile,contacts,education");
-	Vreen::Reply *reply = m_client->request("getProfiles", data);
+	VReply *reply = m_client->queueRequest("getProfiles", data);
 	connect(this, SIGNAL(canceled()), reply, SLOT(deleteLater()));
 	connect(reply, SIGNAL(resultReady(QVariant)), this, SLOT(onRequestFinished()));
+	connect(reply, SIGNAL(error()), this, SLOT(onRequestFailed()));
 	setState(InfoRequest::Requesting);
 }
 
@@ -258,7 +260,7 @@ void VInfoRequest::doCancel()
 
 void VInfoRequest::onRequestFinished()
 {
-	Vreen::Reply *reply = qobject_cast<Vreen::Reply*>(sender());
+	VReply *reply = qobject_cast<VReply*>(sender());
 	m_data = reply->response().toList().value(0).toMap();
 	ensureAddress(Country);
 	ensureAddress(City);
@@ -266,6 +268,11 @@ void VInfoRequest::onRequestFinished()
 		setState(InfoRequest::RequestDone);
 }
 
+void VInfoRequest::onRequestFailed()
+{
+	setState(InfoRequest::Error);
+}
+
 struct FuncPointerHelper
 {
 	NameMapper *mapper;
@@ -273,7 +280,7 @@ struct FuncPointerHelper
 
 void VInfoRequest::onAddressEnsured()
 {
-	Vreen::Reply *reply = qobject_cast<Vreen::Reply*>(sender());
+	VReply *reply = qobject_cast<VReply*>(sender());
 	QString field = reply->property("field").toString();
 	qptrdiff tmp = reply->property("mapper").value<qptrdiff>();
 	FuncPointerHelper *helper = reinterpret_cast<FuncPointerHelper*>(tmp);
@@ -287,6 +294,15 @@ void VInfoRequest::onAddressEnsured()
 		setState(InfoRequest::RequestDone);
 }
 
+void VInfoRequest::onAddressFailed()
+{
+	VReply *reply = qobject_cast<VReply*>(sender());
+	delete reinterpret_cast<FuncPointerHelper*>(reply->property("mapper").value<qptrdiff>());
+	m_unknownCount--;
+	if (m_unknownCount == 0)
+		setState(InfoRequest::RequestDone);
+}
+
 void VInfoRequest::ensureAddress(DataType type)
 {
 	QString method;
@@ -316,11 +332,12 @@ void VInfoRequest::ensureAddress(DataType type)
         data.insert(QLatin1String("country"), QString::number(id));
 		FuncPointerHelper *helper = new FuncPointerHelper;
 		helper->mapper = mapper;
-		Vreen::Reply *reply = m_client->request(method, data);
+		VReply *reply = m_client->queueRequest(method, data);
 		reply->setProperty("field", field);
 		reply->setProperty("mapper", reinterpret_cast<qptrdiff>(helper));
 		connect(this, SIGNAL(canceled()), reply, SLOT(deleteLater()));
 		connect(reply, SIGNAL(resultReady(QVariant)), this, SLOT(onAddressEnsured()));
+		connect(reply, SIGNAL(error()), this, SLOT(onAddressFailed()));
 		m_unknownCount++;
 	}
 }
@@ -30,11 +30,8 @@
 #include <qutim/status.h>
 #include <QSet>
 
-namespace Vreen {
-class Client;
-} //namespace Vreen
-
 class VConnection;
+class VClient;
 class VAccount;
 class VContact;
 
@@ -86,7 +83,9 @@ signals:
 	void canceled();
 private slots:
 	void onRequestFinished();
+	void onRequestFailed();
 	void onAddressEnsured();
+	void onAddressFailed();
 private:
 	void ensureAddress(DataType type);
 	void addItem(DataType type, qutim_sdk_0_3::DataItem &group, const QVariant &data) const;
@@ -94,7 +93,7 @@ private:
 	{ addItem(type, group, m_data.value(QLatin1String(name))); }
 	
 	QString m_id;
-	Vreen::Client *m_client;
+	VClient *m_client;
 	int m_unknownCount;
 	QVariantMap m_data;
 };
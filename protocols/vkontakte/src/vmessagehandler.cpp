@@ -1,6 +1,111 @@
 #include "vmessagehandler.h"
+#include "vaccount.h"
+#include "vclient.h"
+#include "vcontact.h"
+#include "vgroupchat.h"
+#include "vroster.h"
+#include <QStringList>
+#include <QDebug>
 
-VMessageHandler::VMessageHandler(QObject *parent) :
-    QObject(parent)
+VMessageHandler::VMessageHandler(VAccount *account, VRoster *roster) :
+	QObject(roster),
+	m_account(account),
+	m_roster(roster)
 {
+	// All events of one long-poll response arrive at once, so zero
+	// interval is enough to collect them
+	m_flushTimer.setSingleShot(true);
+	m_flushTimer.setInterval(0);
+	connect(&m_flushTimer, SIGNAL(timeout()), SLOT(flush()));
+}
+
+void VMessageHandler::addMessage(const Vreen::Message &message)
+{
+	m_queue << message;
+	if (!m_flushTimer.isActive())
+		m_flushTimer.start();
+}
+
+void VMessageHandler::flush()
+{
+	Vreen::MessageList messages;
+	qSwap(messages, m_queue);
+
+	// Long-poll doesn't tell authors of group chat messages, such messages
+	// are fetched by single messages.getById for the whole burst
+	QStringList missingIds;
+	foreach (const Vreen::Message &msg, messages) {
+		if (msg.chatId() && !msg.fromId())
+			missingIds << QString::number(msg.id());
+	}
+	if (missingIds.isEmpty()) {
+		deliver(messages);
+		return;
+	}
+
+	QVariantMap args;
+	args.insert(QLatin1String("mids"), missingIds.join(QLatin1String(",")));
+	VClient *client = static_cast<VClient*>(m_account->client());
+	VReply *reply = client->queueRequest(QLatin1String("messages.getById"), args);
+	connect(reply, SIGNAL(resultReady(QVariant)), SLOT(onBodiesReceived(QVariant)));
+	connect(reply, SIGNAL(error()), SLOT(onBodiesFailed()));
+	m_fetching.insert(reply, messages);
+}
+
+void VMessageHandler::onBodiesReceived(const QVariant &response)
+{
+	Vreen::MessageList messages = m_fetching.take(sender());
+	QVariantList list = response.toList();
+	if (!list.isEmpty())
+		list.removeFirst();
+	QHash<int, Vreen::Message> bodies;
+	foreach (const Vreen::Message &msg, Vreen::Message::fromVariantList(list, m_account->client()))
+		bodies.insert(msg.id(), msg);
+
+	// Order of the stream is kept, only incomplete messages are replaced
+	for (int i = 0; i < messages.size(); ++i) {
+		QHash<int, Vreen::Message>::const_iterator it = bodies.constFind(messages.at(i).id());
+		if (it != bodies.constEnd())
+			messages[i] = it.value();
+	}
+	deliver(messages);
+}
+
+void VMessageHandler::onBodiesFailed()
+{
+	// Group chats will try to fetch incomplete messages by themselves
+	deliver(m_fetching.take(sender()));
+}
+
+void VMessageHandler::deliver(const Vreen::MessageList &messages)
+{
+	QList<int> contactIds;
+	QList<int> chatIds;
+	QHash<int, Vreen::MessageList> contactMessages;
+	QHash<int, Vreen::MessageList> chatMessages;
+	foreach (const Vreen::Message &msg, messages) {
+		if (int id = msg.chatId()) {
+			Vreen::MessageList &list = chatMessages[id];
+			if (list.isEmpty())
+				chatIds << id;
+			list << msg;
+		} else {
+			int id = msg.isIncoming() ? msg.fromId() : msg.toId();
+			Vreen::MessageList &list = contactMessages[id];
+			if (list.isEmpty())
+				contactIds << id;
+			list << msg;
+		}
+	}
+
+	foreach (int id, chatIds) {
+		if (VGroupChat *c = m_roster->groupChat(id))
+			c->handleMessages(chatMessages.value(id));
+	}
+	foreach (int id, contactIds) {
+		if (VContact *c = m_roster->contact(id))
+			c->handleMessages(contactMessages.value(id));
+		else
+			qWarning() << "Unable to find reciever with id in roster" << id;
+	}
 }
@@ -2,17 +2,37 @@
 #define VMESSAGEHANDLER_H
 
 #include <QObject>
+#include <QTimer>
+#include <vreen/message.h>
 
+class VAccount;
+class VRoster;
+
+// Collects long-poll messages and passes them to contacts and group
+// chats in batches, so that reconnect bursts don't cost a request and
+// an append per event
 class VMessageHandler : public QObject
 {
 	Q_OBJECT
 public:
-	explicit VMessageHandler(QObject *parent = 0);
-
-signals:
+	explicit VMessageHandler(VAccount *account, VRoster *roster);
 
 public slots:
+	void addMessage(const Vreen::Message &message);
+
+private slots:
+	void flush();
+	void onBodiesReceived(const QVariant &response);
+	void onBodiesFailed();
+
+private:
+	void deliver(const Vreen::MessageList &messages);
 
+	VAccount *m_account;
+	VRoster *m_roster;
+	QTimer m_flushTimer;
+	Vreen::MessageList m_queue;
+	QHash<QObject*, Vreen::MessageList> m_fetching;
 };
 
 #endif // VMESSAGEHANDLER_H
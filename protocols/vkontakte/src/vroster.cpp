@@ -27,6 +27,8 @@
 #include "vcontact.h"
 #include "vaccount.h"
 #include "vgroupchat.h"
+#include "vclient.h"
+#include "vmessagehandler.h"
 
 #include <vreen/roster.h>
 #include <vreen/longpoll.h>
@@ -45,10 +47,26 @@ class VRosterFactory : public ContactsFactory
 public:
 	VRosterFactory(VAccount *account, VRoster *roster) :
 		account(account), roster(roster),
-		addContactGuard(false)
+		addContactGuard(false),
+		messageHandler(0)
 	{
 		rosterUpdater.setInterval(90000);
 		roster->connect(&rosterUpdater, SIGNAL(timeout()), account->client()->roster(), SLOT(sync()));
+
+		// Stored properties of buddies are resolved once instead of building
+		// key strings for every contact
+		const QMetaObject *meta = &Vreen::Buddy::staticMetaObject;
+		QStringList keys;
+		for (int i = 0; i != meta->propertyCount(); i++) {
+			QMetaProperty property = meta->property(i);
+			QString name = QLatin1String(property.name());
+			if (name.startsWith(QLatin1String("_q_"))) {
+				keys << name.mid(3);
+				properties << i;
+			}
+		}
+		keys << QStringLiteral("friend");
+		rosterSchema = RosterSchema(keys);
 	}
 
 	virtual Contact *addContact(const QString &id, const QVariantMap &data)
@@ -58,12 +76,25 @@ public:
 		c->buddy()->setIsFriend(data.value("friend").toBool());
 		return c;
 	}
+	virtual const RosterSchema *schema() const
+	{
+		return &rosterSchema;
+	}
 	virtual void serialize(Contact *obj, QVariantMap &data) {
 		VContact *contact = qobject_cast<VContact*>(obj);
 		if (!contact)
 			return;
 		Vreen::Buddy *buddy = contact->buddy();
 		const QMetaObject *meta = buddy->metaObject();
+		if (meta == &Vreen::Buddy::staticMetaObject) {
+			for (int i = 0; i != properties.size(); i++) {
+				QMetaProperty property = meta->property(properties.at(i));
+				if (property.isStored(buddy))
+					data.insert(rosterSchema.key(i), property.read(buddy));
+			}
+			data.insert(rosterSchema.key(properties.size()), buddy->isFriend());
+			return;
+		}
 		for (int i = 0; i != meta->propertyCount(); i++) {
 			QMetaProperty property = meta->property(i);
 			QString name = property.name();
@@ -77,11 +108,15 @@ public:
 
 	VAccount *account;
 	VRoster *roster;
+	RosterSchema rosterSchema;
+	// Indexes of stored properties of Vreen::Buddy in schema order
+	QVector<int> properties;
 	ServicePointer<RosterStorage> storage;
 	QHash<int, VContact*> contactHash;
 	QHash<int, VGroupChat*> groupChatHash;
 	bool addContactGuard;
 	QTimer rosterUpdater;
+	VMessageHandler *messageHandler;
 
 	QString loadRoster();
 };
@@ -91,6 +126,7 @@ VRoster::VRoster(VAccount *account) : QObject(account),
 {
 	account->setContactsFactory(p.data());
 	p->loadRoster();
+	p->messageHandler = new VMessageHandler(account, this);
 
     auto roster = p->account->client()->roster();
 
@@ -100,7 +136,8 @@ VRoster::VRoster(VAccount *account) : QObject(account),
 	connect(p->account->client(), SIGNAL(onlineStateChanged(bool)), SLOT(onOnlineChanged(bool)));
 
 	Vreen::LongPoll *poll = p->account->client()->longPoll();
-	connect(poll, SIGNAL(messageAdded(Vreen::Message)), SLOT(onMessageAdded(Vreen::Message)));
+	connect(poll, SIGNAL(messageAdded(Vreen::Message)),
+			p->messageHandler, SLOT(addMessage(Vreen::Message)));
 	connect(poll, SIGNAL(contactTyping(int, int)), SLOT(onContactTyping(int, int)));
 
     /// new style
@@ -164,10 +201,32 @@ void VRoster::onAddBuddy(Vreen::Buddy *buddy)
 	if (!p->contactHash.value(buddy->id())) {
 		createContact(buddy);
 		if (!buddy->isFriend())
-			buddy->update(QStringList() << VK_COMMON_FIELDS);
+			requestProfile(buddy->id());
 	}
 }
 
+void VRoster::requestProfile(int id)
+{
+	// Profiles of several buddies come in one batch instead of a request per buddy
+	QVariantMap args;
+	args.insert(QLatin1String("uids"), QString::number(id));
+	args.insert(QLatin1String("fields"), (QStringList() << VK_COMMON_FIELDS).join(QLatin1String(",")));
+	VClient *client = static_cast<VClient*>(p->account->client());
+	VReply *reply = client->queueRequest(QLatin1String("getProfiles"), args);
+	reply->setProperty("buddyId", id);
+	connect(reply, SIGNAL(resultReady(QVariant)), SLOT(onProfileReceived(QVariant)));
+}
+
+void VRoster::onProfileReceived(const QVariant &response)
+{
+	int id = sender()->property("buddyId").toInt();
+	VContact *c = contact(id);
+	if (!c)
+		return;
+	Vreen::Contact::fill(c->buddy(), response.toList().value(0).toMap());
+	p->storage.data()->updateContact(c);
+}
+
 void VRoster::onBuddyUpdated(Vreen::Buddy *buddy)
 {
 	VContact *c = contact(buddy->id());
@@ -190,23 +249,6 @@ void VRoster::onOnlineChanged(bool isOnline)
 		p->rosterUpdater.stop();
 }
 
-void VRoster::onMessageAdded(const Vreen::Message &msg)
-{
-	if (msg.chatId()) {
-		int id = msg.chatId();
-		VGroupChat *c = groupChat(id);
-		if (c)
-			c->handleMessage(msg);
-	} else {
-		int id = msg.isIncoming() ? msg.fromId() : msg.toId();
-		VContact *c = contact(id);
-		if (c)
-			c->handleMessage(msg);
-		else
-            qWarning() << "Unable to find reciever with id in roster" << id;
-	}
-}
-
 void VRoster::onContactDestroyed(QObject *obj)
 {
 	p->contactHash.remove(p->contactHash.key(static_cast<VContact*>(obj)));
@@ -248,7 +290,7 @@ void VRoster::onMessagesRecieved(const QVariant &response)
                                                                      p->account->client());
         foreach (Vreen::Message msg, msgList) {
             if (msg.isUnread() && msg.isIncoming()) {
-                onMessageAdded(msg);
+                p->messageHandler->addMessage(msg);
             }
             if (msg.chatId())
                 groupChat(msg.chatId());
@@ -68,12 +68,14 @@ private slots:
 	void onAddBuddy(Vreen::Buddy *buddy);
 	void onBuddyUpdated(Vreen::Buddy *buddy);
 	void onBuddyRemoved(int id);
+	void onProfileReceived(const QVariant &response);
 	void onOnlineChanged(bool isOnline);
 	void onMessagesRecieved(const QVariant &response);
-	void onMessageAdded(const Vreen::Message &msg);
 	void onContactTyping(int userId, int chatId);
     void onRosterSyncFinished(bool success);
 private:
+	void requestProfile(int id);
+
 	QScopedPointer<VRosterFactory> p;
 };
 
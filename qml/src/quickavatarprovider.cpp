@@ -1,14 +1,13 @@
 #include "quickavatarprovider.h"
-#include <QDebug>
-#include <qutim/icon.h>
+#include "quickimagecache.h"
 #include <QUrlQuery>
-#include <qutim/avatarfilter.h>
 
 namespace qutim_sdk_0_3 {
 
 QuickAvatarProvider::QuickAvatarProvider()
-    : QQuickImageProvider(QQuickImageProvider::Pixmap)
 {
+    // Cache has to be created at GUI thread
+    QuickImageCache::instance();
 }
 
 /*!
@@ -20,7 +19,7 @@ QuickAvatarProvider::QuickAvatarProvider()
  *     source: "image://avatar/path?size=64&name=icon-name"
  * }
  */
-QPixmap QuickAvatarProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize)
+QQuickImageResponse *QuickAvatarProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
 {
     const QUrl url(QStringLiteral("file:///") + id);
     const QUrlQuery query(url.query());
@@ -28,25 +27,17 @@ QPixmap QuickAvatarProvider::requestPixmap(const QString &id, QSize *size, const
     const QString iconName = query.queryItemValue(QStringLiteral("name"));
     const QString iconSize = query.queryItemValue(QStringLiteral("size"));
 
-    QSize tmp;
-    if (!size)
-        size = &tmp;
-
+    QSize size;
     bool ok = false;
     int iconSizeValue = iconSize.toInt(&ok);
     if (ok)
-        *size = QSize(iconSizeValue, iconSizeValue);
+        size = QSize(iconSizeValue, iconSizeValue);
     else if (requestedSize.width() > 0)
-        *size = requestedSize;
+        size = requestedSize;
     else
-        *size = QSize(128, 128);
-
-    QIcon icon = Icon(iconName);
-
-    if (filePath.size() > 1)
-        icon = AvatarFilter::icon(filePath, icon);
+        size = QSize(128, 128);
 
-    return icon.pixmap(*size);
+    return QuickImageCache::instance()->request(filePath.size() > 1 ? filePath : QString(), iconName, size);
 }
 
 } // namespace qutim_sdk_0_3
@@ -5,12 +5,12 @@
 
 namespace qutim_sdk_0_3 {
 
-class QuickAvatarProvider : public QQuickImageProvider
+class QuickAvatarProvider : public QQuickAsyncImageProvider
 {
 public:
     QuickAvatarProvider();
 
-    QPixmap requestPixmap(const QString &id, QSize *size, const QSize &requestedSize);
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize);
 };
 
 } // namespace qutim_sdk_0_3
@@ -5,20 +5,21 @@
 namespace qutim_sdk_0_3 {
 
 QuickConfig::QuickConfig(QObject *parent) :
-    QObject(parent)
+    QObject(parent), m_generation(0)
 {
 	setObjectName(QStringLiteral("QuickConfig"));
 }
 
+QuickConfig::~QuickConfig()
+{
+    flush();
+}
+
 void QuickConfig::setPath(const QString &path)
 {
     if (m_path != path) {
         m_path = path;
-        m_config = Config(path);
-        
-        if (!m_group.isEmpty())
-            m_config.beginGroup(m_group);
-        
+        reset(Config(path));
         emit pathChanged();
     }
 }
@@ -31,12 +32,13 @@ QString QuickConfig::path() const
 void QuickConfig::setGroup(const QString &group)
 {
     if (m_group != group) {
+        // Values of old group are written before the config is changed
+        flush();
         if (!m_group.isEmpty())
             m_config.endGroup();
         
         m_group = group;
-        if (!group.isEmpty())
-            m_config.beginGroup(group);
+        reset(m_config);
     }
 }
 
@@ -56,14 +58,11 @@ void QuickConfig::setObject(QObject *object)
         m_object = object;
 
         if (Account *account = qobject_cast<Account *>(m_object))
-            m_config = account->config();
+            reset(account->config());
         else if (Protocol *protocol = qobject_cast<Protocol *>(m_object))
-            m_config = protocol->config();
+            reset(protocol->config());
         else
-            m_config = Config(m_path);
-
-        if (!m_group.isEmpty())
-            m_config.beginGroup(m_group);
+            reset(Config(m_path));
 
         emit objectChanged(object);
     }
@@ -71,29 +70,41 @@ void QuickConfig::setObject(QObject *object)
 
 QVariant QuickConfig::value(const QString &name, const QVariant &defaultValue)
 {
-    return m_config.value(name, defaultValue);
+    const QVariant value = currentValue(m_groups.join(QLatin1Char('/')), name);
+    return value.isValid() ? value : defaultValue;
 }
 
 void QuickConfig::setValue(const QString &name, const QVariant &value)
 {
-    m_config.setValue(name, value);
+    queueValue(m_groups.join(QLatin1Char('/')), name, value);
 }
 
 void QuickConfig::beginGroup(const QString &name)
 {
-    m_config.beginGroup(name);
+    m_groups.append(name);
 }
 
 void QuickConfig::endGroup()
 {
-	m_config.endGroup();
+    if (!m_groups.isEmpty())
+        m_groups.removeLast();
 }
 
 void QuickConfig::forceSync()
 {
+    flush();
 	m_config.sync();
 }
 
+void QuickConfig::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_flushTimer.timerId()) {
+        flush();
+        return;
+    }
+    QObject::timerEvent(event);
+}
+
 void QuickConfig::classBegin()
 {
 }
@@ -104,6 +115,11 @@ void QuickConfig::componentComplete()
 }
 
 void QuickConfig::syncProperties(QObject *object)
+{
+    syncProperties(object, QString());
+}
+
+void QuickConfig::syncProperties(QObject *object, const QString &group)
 {
     const QMetaObject * const base = object == this ? &staticMetaObject : &QObject::staticMetaObject;
     const QMetaObject * const actual = object->metaObject();
@@ -111,6 +127,7 @@ void QuickConfig::syncProperties(QObject *object)
     int propertiesCount = actual->propertyCount();
     for (int index = base->propertyCount(); index < propertiesCount; ++index) {
         QMetaProperty property = actual->property(index);
+        const QString name = QLatin1String(property.name());
         QVariant defaultValue = property.read(object);
         QMetaType type(property.userType());
 
@@ -120,25 +137,108 @@ void QuickConfig::syncProperties(QObject *object)
                 qWarning() << "QuickConfig: null value at" << this << ", property:" << property.name();
                 continue;
             }
-            m_config.beginGroup(QLatin1String(property.name()));
-            syncProperties(subObject);
-            m_config.endGroup();
+            syncProperties(subObject, group.isEmpty() ? name : group + QLatin1Char('/') + name);
             continue;
         }
 
-        QVariant actualValue = m_config.value(QLatin1String(property.name()), defaultValue);
-        property.write(object, actualValue);
+        QVariant actualValue = cachedValue(group, name);
+        property.write(object, actualValue.isValid() ? actualValue : defaultValue);
 
-        new QuickConfigListener(m_path, m_group, property, object, this);
+        new QuickConfigListener(group, property, object, this);
 
-        m_config.listen(property.name(), object, [object, property, defaultValue] (const QVariant &value) {
+        // Only this property is notified, other bindings of the config aren't touched
+        const QString valueKey = key(group, name);
+        const int generation = m_generation;
+        groupConfig(group).listen(name, object, [this, generation, valueKey, object, property, defaultValue] (const QVariant &value) {
+            if (generation != m_generation)
+                return;
+            // Cache is updated first, so listener doesn't write the value back
+            m_values.insert(valueKey, value);
             property.write(object, value.isValid() ? value : defaultValue);
         });
     }
 }
 
-QuickConfigListener::QuickConfigListener(const QString &path, const QString &group, const QMetaProperty &property, QObject *object, QuickConfig *parent)
-    : QObject(parent), m_path(path), m_group(group), m_property(property), m_object(object)
+void QuickConfig::reset(const Config &config)
+{
+    flush();
+    m_config = config;
+    if (!m_group.isEmpty())
+        m_config.beginGroup(m_group);
+    m_groupConfigs.clear();
+    m_values.clear();
+    ++m_generation;
+}
+
+Config QuickConfig::groupConfig(const QString &group)
+{
+    auto it = m_groupConfigs.constFind(group);
+    if (it != m_groupConfigs.constEnd())
+        return it.value();
+
+    // Config::group() resolves the group once and leaves m_config's own levels as they were
+    Config config = group.isEmpty() ? m_config : m_config.group(group);
+    m_groupConfigs.insert(group, config);
+    return config;
+}
+
+QString QuickConfig::key(const QString &group, const QString &name)
+{
+    return group + QLatin1Char('/') + name;
+}
+
+QVariant QuickConfig::cachedValue(const QString &group, const QString &name)
+{
+    const QString valueKey = key(group, name);
+    auto it = m_values.constFind(valueKey);
+    if (it != m_values.constEnd())
+        return it.value();
+
+    Config config = groupConfig(group);
+    const QVariant value = config.value(name, QVariant());
+    m_values.insert(valueKey, value);
+
+    const int generation = m_generation;
+    config.listen(name, this, [this, generation, valueKey, name] (const QVariant &value) {
+        if (generation != m_generation)
+            return;
+        m_values.insert(valueKey, value);
+        emit valueChanged(name, value);
+    });
+    return value;
+}
+
+QVariant QuickConfig::currentValue(const QString &group, const QString &name)
+{
+    auto it = m_pendingValues.constFind(key(group, name));
+    if (it != m_pendingValues.constEnd())
+        return it->value;
+    return cachedValue(group, name);
+}
+
+void QuickConfig::queueValue(const QString &group, const QString &name, const QVariant &value)
+{
+    const PendingValue pending = { group, name, value };
+    m_pendingValues.insert(key(group, name), pending);
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start(0, this);
+}
+
+void QuickConfig::flush()
+{
+    m_flushTimer.stop();
+    if (m_pendingValues.isEmpty())
+        return;
+    QHash<QString, PendingValue> values;
+    qSwap(values, m_pendingValues);
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+        m_values.insert(it.key(), it->value);
+        groupConfig(it->group).setValue(it->name, it->value);
+    }
+}
+
+QuickConfigListener::QuickConfigListener(const QString &group, const QMetaProperty &property, QObject *object, QuickConfig *parent)
+    : QObject(parent), m_group(group), m_property(property), m_object(object)
 {
     static int slotIndex = staticMetaObject.indexOfMethod("onPropertyChanged()");
     QMetaMethod slot = staticMetaObject.method(slotIndex);
@@ -147,10 +247,13 @@ QuickConfigListener::QuickConfigListener(const QString &path, const QString &gro
 
 void QuickConfigListener::onPropertyChanged()
 {
-    QVariant value = m_property.read(m_object);
-    Config config(m_path);
-    config.beginGroup(m_group);
-    config.setValue(QLatin1String(m_property.name()), value);
+    QuickConfig *config = static_cast<QuickConfig*>(parent());
+    const QString name = QLatin1String(m_property.name());
+    const QVariant value = m_property.read(m_object);
+    // Property was just set from config, there is nothing to write
+    if (config->currentValue(m_group, name) == value)
+        return;
+    config->queueValue(m_group, name, value);
 }
 
 } // namespace qutim_sdk_0_3
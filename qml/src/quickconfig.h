@@ -5,6 +5,7 @@
 #include <QQmlParserStatus>
 #include <QPointer>
 #include <QMetaProperty>
+#include <QBasicTimer>
 #include "config.h"
 
 namespace qutim_sdk_0_3 {
@@ -18,6 +19,7 @@ class QuickConfig : public QObject, public QQmlParserStatus
     Q_PROPERTY(QString group READ group WRITE setGroup NOTIFY groupChanged)
 public:
     explicit QuickConfig(QObject *parent = 0);
+    ~QuickConfig();
     
     void setPath(const QString &path);
     QString path() const;
@@ -35,6 +37,7 @@ public:
 
 public slots:
     QVariant value(const QString &name, const QVariant &defaultValue);
+    // Values are written to config at the next event loop iteration
     void setValue(const QString &name, const QVariant &value);
     
     void beginGroup(const QString &name);
@@ -48,25 +51,56 @@ signals:
     void groupChanged();
     
     void objectChanged(QObject* arg);
+    // Emitted for names previously read by value() once they are changed
+    void valueChanged(const QString &name, const QVariant &value);
+
+protected:
+    void timerEvent(QTimerEvent *event);
 
 private:
+    friend class QuickConfigListener;
+
+    struct PendingValue
+    {
+        QString group;
+        QString name;
+        QVariant value;
+    };
+
+    void reset(const Config &config);
+    void syncProperties(QObject *object, const QString &group);
+    Config groupConfig(const QString &group);
+    static QString key(const QString &group, const QString &name);
+    QVariant cachedValue(const QString &group, const QString &name);
+    QVariant currentValue(const QString &group, const QString &name);
+    void queueValue(const QString &group, const QString &name, const QVariant &value);
+    void flush();
+
     Config m_config;
     QString m_path;
     QString m_group;
     QPointer<QObject> m_object;
+    // Groups opened by beginGroup() from QML
+    QStringList m_groups;
+    // Resolved groups and values are kept till config is replaced
+    QHash<QString, Config> m_groupConfigs;
+    QHash<QString, QVariant> m_values;
+    QHash<QString, PendingValue> m_pendingValues;
+    QBasicTimer m_flushTimer;
+    // Listeners of replaced configs check it to ignore notifications
+    int m_generation;
 };
 
 class QuickConfigListener : public QObject
 {
     Q_OBJECT
 public:
-    QuickConfigListener(const QString &path, const QString &group, const QMetaProperty &property, QObject *object, QuickConfig *parent);
+    QuickConfigListener(const QString &group, const QMetaProperty &property, QObject *object, QuickConfig *parent);
 
 public slots:
     void onPropertyChanged();
 
 private:
-    QString m_path;
     QString m_group;
     QMetaProperty m_property;
     QObject *m_object;
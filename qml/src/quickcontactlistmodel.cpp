@@ -0,0 +1,308 @@
+#include "quickcontactlistmodel.h"
+#include <QStringBuilder>
+#include <QSet>
+#include <algorithm>
+
+namespace qutim_sdk_0_3 {
+
+// Values of ContactListItemType of the contact model
+enum { TagType = 100, ContactType = 101, AccountType = 102 };
+
+QuickContactListModel::QuickContactListModel(QObject *parent)
+    : QAbstractListModel(parent),
+      m_itemTypeRole(-1), m_contactRole(-1), m_idRole(-1), m_nameRole(-1),
+      m_revisionRole(-1), m_statusIconNameRole(-1), m_iconSourceRole(-1)
+{
+}
+
+QObject *QuickContactListModel::sourceModel() const
+{
+    return m_source.data();
+}
+
+void QuickContactListModel::setSourceModel(QObject *object)
+{
+    QAbstractItemModel *source = qobject_cast<QAbstractItemModel*>(object);
+    if (m_source == source)
+        return;
+    if (m_source)
+        disconnect(m_source.data(), 0, this, 0);
+
+    beginResetModel();
+    m_source = source;
+    m_items.clear();
+    m_roleNames.clear();
+    m_itemTypeRole = m_contactRole = m_idRole = m_nameRole = -1;
+    m_revisionRole = m_statusIconNameRole = m_iconSourceRole = -1;
+    if (source) {
+        m_roleNames = source->roleNames();
+        m_itemTypeRole = m_roleNames.key("itemType", -1);
+        m_contactRole = m_roleNames.key("contact", -1);
+        m_idRole = m_roleNames.key("itemId", -1);
+        m_nameRole = m_roleNames.key("name", -1);
+        m_revisionRole = m_roleNames.key("revision", -1);
+        m_statusIconNameRole = m_roleNames.key("statusIconName", -1);
+        m_iconSourceRole = m_roleNames.key("iconSource", -1);
+        m_roleNames.insert(DepthRole, "depth");
+        m_roleNames.insert(SectionRole, "section");
+        m_roleNames.insert(StatusIconRole, "statusIcon");
+        m_roleNames.insert(AvatarUrlRole, "avatarUrl");
+
+        // Everything is applied as a diff, so resets and layout changes are as cheap as others
+        connect(source, &QAbstractItemModel::dataChanged, this, &QuickContactListModel::scheduleSync);
+        connect(source, &QAbstractItemModel::rowsInserted, this, &QuickContactListModel::scheduleSync);
+        connect(source, &QAbstractItemModel::rowsRemoved, this, &QuickContactListModel::scheduleSync);
+        connect(source, &QAbstractItemModel::rowsMoved, this, &QuickContactListModel::scheduleSync);
+        connect(source, &QAbstractItemModel::layoutChanged, this, &QuickContactListModel::scheduleSync);
+        connect(source, &QAbstractItemModel::modelReset, this, &QuickContactListModel::scheduleSync);
+        connect(source, &QObject::destroyed, this, &QuickContactListModel::scheduleSync);
+
+        collect(QModelIndex(), QString(), QString(), 0, m_items);
+        for (int i = 0; i < m_items.size(); ++i)
+            fill(m_items[i]);
+    }
+    endResetModel();
+
+    emit sourceModelChanged(source);
+    emit countChanged(m_items.size());
+}
+
+int QuickContactListModel::count() const
+{
+    return m_items.size();
+}
+
+int QuickContactListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant QuickContactListModel::data(const QModelIndex &index, int role) const
+{
+    if (index.parent().isValid() || index.row() < 0 || index.row() >= m_items.size())
+        return QVariant();
+    const Item &item = m_items.at(index.row());
+    switch (role) {
+    case DepthRole:
+        return item.depth;
+    case SectionRole:
+        return item.section;
+    case StatusIconRole:
+        return item.statusIcon;
+    case AvatarUrlRole:
+        return item.avatarUrl;
+    default:
+        return item.index.data(role);
+    }
+}
+
+QHash<int, QByteArray> QuickContactListModel::roleNames() const
+{
+    return m_roleNames;
+}
+
+void QuickContactListModel::setCollapsed(int row, bool collapsed)
+{
+    if (!m_source || row < 0 || row >= m_items.size())
+        return;
+    const QModelIndex index = m_items.at(row).index;
+    if (index.isValid()) {
+        QMetaObject::invokeMethod(m_source.data(), collapsed ? "collapse" : "expand",
+                                  Q_ARG(QModelIndex, index));
+    }
+}
+
+void QuickContactListModel::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_syncTimer.timerId()) {
+        sync();
+        return;
+    }
+    QAbstractListModel::timerEvent(event);
+}
+
+void QuickContactListModel::scheduleSync()
+{
+    if (!m_syncTimer.isActive())
+        m_syncTimer.start(0, this);
+}
+
+void QuickContactListModel::sync()
+{
+    m_syncTimer.stop();
+    QVector<Item> items;
+    if (m_source)
+        collect(QModelIndex(), QString(), QString(), 0, items);
+    const int previousCount = m_items.size();
+    apply(items);
+    if (previousCount != m_items.size())
+        emit countChanged(m_items.size());
+}
+
+void QuickContactListModel::collect(const QModelIndex &parent, const QString &parentKey,
+                                    const QString &section, int depth, QVector<Item> &items) const
+{
+    const int count = m_source->rowCount(parent);
+    for (int row = 0; row < count; ++row) {
+        const QModelIndex index = m_source->index(row, 0, parent);
+        const int type = index.data(m_itemTypeRole).toInt();
+        QString id;
+        if (type == ContactType)
+            id = QString::number(quintptr(index.data(m_contactRole).value<QObject*>()), 16);
+        else if (type == TagType)
+            id = index.data(m_nameRole).toString();
+        else
+            id = index.data(m_idRole).toString();
+
+        Item item;
+        item.key = parentKey % QLatin1Char('/') % QString::number(type) % QLatin1Char(':') % id;
+        item.index = index;
+        item.revision = index.data(m_revisionRole);
+        item.depth = depth;
+        item.section = depth == 0 ? index.data(Qt::DisplayRole).toString() : section;
+        item.filled = false;
+        items.append(item);
+
+        collect(index, item.key, item.section, depth + 1, items);
+    }
+}
+
+void QuickContactListModel::fill(Item &item) const
+{
+    item.filled = true;
+    const QString iconName = item.index.data(m_statusIconNameRole).toString();
+    item.statusIcon = iconName.isEmpty() ? QString() : QStringLiteral("image://xdg/") + iconName;
+    item.avatarUrl = item.index.data(m_iconSourceRole).toString();
+}
+
+void QuickContactListModel::apply(QVector<Item> &items)
+{
+    QHash<QString, int> positions;
+    positions.reserve(items.size());
+    for (int i = 0; i < items.size(); ++i)
+        positions.insert(items.at(i).key, i);
+
+    // Removed rows go first, runs of them are removed at once
+    for (int i = m_items.size() - 1; i >= 0; --i) {
+        if (positions.contains(m_items.at(i).key))
+            continue;
+        const int last = i;
+        while (i > 0 && !positions.contains(m_items.at(i - 1).key))
+            --i;
+        beginRemoveRows(QModelIndex(), i, last);
+        m_items.erase(m_items.begin() + i, m_items.begin() + last + 1);
+        endRemoveRows();
+    }
+
+    QSet<QString> existing;
+    existing.reserve(m_items.size());
+    for (int i = 0; i < m_items.size(); ++i)
+        existing.insert(m_items.at(i).key);
+    // Rows which keep their relative order don't move, others are moved
+    // right after already placed predecessor, new ones are inserted there
+    const QSet<QString> stable = stableKeys(m_items, positions);
+
+    auto findRow = [this] (const QString &key, int from) {
+        for (int row = from; row < m_items.size(); ++row) {
+            if (m_items.at(row).key == key)
+                return row;
+        }
+        for (int row = 0; row < from && row < m_items.size(); ++row) {
+            if (m_items.at(row).key == key)
+                return row;
+        }
+        return -1;
+    };
+
+    // Row of the last placed item
+    int placed = -1;
+    for (int i = 0; i < items.size();) {
+        const QString &key = items.at(i).key;
+        if (!existing.contains(key)) {
+            int last = i;
+            while (last + 1 < items.size() && !existing.contains(items.at(last + 1).key))
+                ++last;
+            beginInsertRows(QModelIndex(), placed + 1, placed + 1 + last - i);
+            for (int j = i; j <= last; ++j) {
+                fill(items[j]);
+                m_items.insert(++placed, items.at(j));
+            }
+            endInsertRows();
+            i = last + 1;
+            continue;
+        }
+
+        const int row = findRow(key, placed + 1);
+        const int destination = placed + 1;
+        if (stable.contains(key) || row == destination) {
+            placed = row;
+        } else {
+            beginMoveRows(QModelIndex(), row, row, QModelIndex(), destination);
+            const Item item = m_items.at(row);
+            m_items.remove(row);
+            placed = row < destination ? destination - 1 : destination;
+            m_items.insert(placed, item);
+            endMoveRows();
+        }
+        ++i;
+    }
+    Q_ASSERT(m_items.size() == items.size());
+
+    // Rows are in place now, so only changed ones are updated
+    int changedFirst = -1;
+    for (int i = 0; i <= items.size(); ++i) {
+        bool changed = false;
+        if (i < items.size()) {
+            Item &item = items[i];
+            const Item &current = m_items.at(i);
+            if (!item.filled) {
+                if (current.filled && item.revision.isValid() && current.revision == item.revision) {
+                    item.filled = true;
+                    item.statusIcon = current.statusIcon;
+                    item.avatarUrl = current.avatarUrl;
+                } else {
+                    fill(item);
+                    changed = true;
+                }
+            }
+            changed = changed || current.depth != item.depth || current.section != item.section;
+            m_items[i] = item;
+        }
+        if (changed && changedFirst < 0) {
+            changedFirst = i;
+        } else if (!changed && changedFirst >= 0) {
+            emit dataChanged(index(changedFirst), index(i - 1));
+            changedFirst = -1;
+        }
+    }
+}
+
+QSet<QString> QuickContactListModel::stableKeys(const QVector<Item> &current, const QHash<QString, int> &positions)
+{
+    // Longest increasing subsequence of target positions of current rows
+    QVector<int> sequence;
+    sequence.reserve(current.size());
+    for (int i = 0; i < current.size(); ++i)
+        sequence.append(positions.value(current.at(i).key));
+
+    QVector<int> tails;
+    QVector<int> previous(sequence.size(), -1);
+    for (int i = 0; i < sequence.size(); ++i) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), i, [&sequence] (int tail, int value) {
+            return sequence.at(tail) < sequence.at(value);
+        });
+        if (it != tails.begin())
+            previous[i] = *(it - 1);
+        if (it == tails.end())
+            tails.append(i);
+        else
+            *it = i;
+    }
+
+    QSet<QString> result;
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = previous.at(i))
+        result.insert(current.at(i).key);
+    return result;
+}
+
+} // namespace qutim_sdk_0_3
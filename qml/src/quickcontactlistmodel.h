@@ -0,0 +1,93 @@
+#ifndef QUTIM_SDK_0_3_QUICKCONTACTLISTMODEL_H
+#define QUTIM_SDK_0_3_QUICKCONTACTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QBasicTimer>
+
+namespace qutim_sdk_0_3 {
+
+/*
+ * Flat list of the tree contact model for QML views. Accounts, tags and
+ * contacts of expanded nodes follow each other with their depth.
+ *
+ * Changes of the source model, including its layout changes and resets
+ * after sorting and filtering, are collected till the next event loop
+ * iteration and applied as minimal set of row removals, moves and
+ * insertions, so delegates of untouched rows are kept.
+ */
+class QuickContactListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QObject* sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+public:
+    enum Role
+    {
+        DepthRole = Qt::UserRole + 0x100,
+        // Title of the top level item, for ListView.section
+        SectionRole,
+        // image://xdg/ url of status icon
+        StatusIconRole,
+        // image://avatar/ url of avatar with status overlay
+        AvatarUrlRole
+    };
+
+    explicit QuickContactListModel(QObject *parent = 0);
+
+    QObject *sourceModel() const;
+    void setSourceModel(QObject *sourceModel);
+    int count() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    QHash<int, QByteArray> roleNames() const;
+
+    Q_INVOKABLE void setCollapsed(int row, bool collapsed);
+
+signals:
+    void sourceModelChanged(QObject *sourceModel);
+    void countChanged(int count);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    struct Item
+    {
+        QString key;
+        QPersistentModelIndex index;
+        QVariant revision;
+        int depth;
+        QString section;
+        // Precomputed roles are valid only if it's set
+        bool filled;
+        QString statusIcon;
+        QString avatarUrl;
+    };
+
+    void scheduleSync();
+    void sync();
+    void collect(const QModelIndex &parent, const QString &parentKey, const QString &section,
+                 int depth, QVector<Item> &items) const;
+    void fill(Item &item) const;
+    void apply(QVector<Item> &items);
+    static QSet<QString> stableKeys(const QVector<Item> &current, const QHash<QString, int> &positions);
+
+    QPointer<QAbstractItemModel> m_source;
+    QHash<int, QByteArray> m_roleNames;
+    int m_itemTypeRole;
+    int m_contactRole;
+    int m_idRole;
+    int m_nameRole;
+    int m_revisionRole;
+    int m_statusIconNameRole;
+    int m_iconSourceRole;
+    QVector<Item> m_items;
+    QBasicTimer m_syncTimer;
+};
+
+} // namespace qutim_sdk_0_3
+
+#endif // QUTIM_SDK_0_3_QUICKCONTACTLISTMODEL_H
@@ -0,0 +1,196 @@
+#include "quickimagecache.h"
+#include <qutim/icon.h>
+#include <qutim/config.h>
+#include <qutim/executor.h>
+#include <qutim/memoryaccounting.h>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QImageReader>
+#include <QPainter>
+#include <QStringBuilder>
+
+namespace qutim_sdk_0_3 {
+
+#if defined(QUTIM_MOBILE_UI) && !defined(Q_WS_MAEMO_5)
+enum { AvatarRadius = 15 };
+#else
+enum { AvatarRadius = 5 };
+#endif
+
+QuickImageResponse::QuickImageResponse(const QuickImageRequest &request)
+    : m_request(request)
+{
+}
+
+QQuickTextureFactory *QuickImageResponse::textureFactory() const
+{
+    return QQuickTextureFactory::textureFactoryForImage(m_image);
+}
+
+void QuickImageResponse::finish(const QImage &image)
+{
+    m_image = image;
+    emit finished();
+}
+
+QuickImageCache *QuickImageCache::instance()
+{
+    static QuickImageCache *self = new QuickImageCache;
+    return self;
+}
+
+QuickImageCache::QuickImageCache()
+{
+    // Queued calls for icons have to be executed at GUI thread
+    moveToThread(QCoreApplication::instance()->thread());
+
+    // Budget is in kilobytes, the same units images cost is counted in
+    Config cfg = Config().group(QStringLiteral("appearance"));
+    m_images.setMaxCost(qMax(1024, cfg.value(QStringLiteral("quickImageCacheSize"), 8192)));
+
+    MemoryAccounting::add(MemoryAccounting::AvatarsCache, this, QStringLiteral("quick images"), [this] () {
+        QMutexLocker locker(&m_mutex);
+        return qint64(m_images.totalCost()) * 1024;
+    }, [this] (qint64 target) {
+        QMutexLocker locker(&m_mutex);
+        // Lowering of max cost evicts least recently used images
+        const int maxCost = m_images.maxCost();
+        m_images.setMaxCost(int(target / 1024));
+        m_images.setMaxCost(maxCost);
+    });
+}
+
+QQuickImageResponse *QuickImageCache::request(const QString &path, const QString &iconName, const QSize &size)
+{
+    QuickImageRequest request;
+    request.path = path;
+    request.iconName = iconName;
+    request.size = size;
+    request.modified = -1;
+    if (!path.isEmpty()) {
+        const QFileInfo info(path);
+        if (info.exists())
+            request.modified = info.lastModified().toMSecsSinceEpoch();
+    }
+    request.key = QString::number(size.width())
+            % QLatin1Char('_')
+            % QString::number(size.height())
+            % QLatin1Char('_')
+            % iconName
+            % QLatin1Char('_')
+            % path;
+
+    QuickImageResponse *response = new QuickImageResponse(request);
+    {
+        QMutexLocker locker(&m_mutex);
+        if (Entry *entry = m_images.object(request.key)) {
+            if (entry->modified == request.modified) {
+                // Connections to finished() are made after we return, so it's queued too
+                finish(response, entry->image);
+                return response;
+            }
+            m_images.remove(request.key);
+        }
+    }
+
+    if (request.modified < 0)
+        QMetaObject::invokeMethod(this, "loadIcon", Qt::QueuedConnection, Q_ARG(QObject*, response));
+    else if (!iconName.isEmpty())
+        QMetaObject::invokeMethod(this, "loadOverlay", Qt::QueuedConnection, Q_ARG(QObject*, response));
+    else
+        render(response, QImage());
+    return response;
+}
+
+void QuickImageCache::loadOverlay(QObject *object)
+{
+    QuickImageResponse *response = static_cast<QuickImageResponse*>(object);
+    const QuickImageRequest &request = response->request();
+    // Overlay is drawn the same way as AvatarFilter does it
+    const QSize overlaySize = request.size / (request.size.width() <= 16 ? 1.3 : 2);
+    render(response, Icon(request.iconName).pixmap(overlaySize).toImage());
+}
+
+void QuickImageCache::loadIcon(QObject *object)
+{
+    QuickImageResponse *response = static_cast<QuickImageResponse*>(object);
+    const QuickImageRequest &request = response->request();
+    Icon icon(request.iconName);
+    QImage image;
+    if (!icon.isNull())
+        image = icon.pixmap(request.size).toImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    insert(request, image);
+    finish(response, image);
+}
+
+void QuickImageCache::render(QuickImageResponse *response, const QImage &overlay)
+{
+    // Engine deletes response only after it's finished, so it's safe to use it at worker
+    QuickImageCache *self = this;
+    Executor::named(QStringLiteral("avatars"))->run([self, response, overlay] () {
+        const QImage image = renderAvatar(response->request(), overlay);
+        if (image.isNull()) {
+            // Broken avatar, the icon is shown instead as AvatarFilter does
+            QMetaObject::invokeMethod(self, "loadIcon", Qt::QueuedConnection, Q_ARG(QObject*, response));
+            return;
+        }
+        self->insert(response->request(), image);
+        finish(response, image);
+    });
+}
+
+QImage QuickImageCache::renderAvatar(const QuickImageRequest &request, const QImage &overlay)
+{
+    const QSize &size = request.size;
+    QImageReader reader(request.path);
+    const QSize imageSize = reader.size();
+    QImage image;
+    if (imageSize.isValid()) {
+        const int cropSize = qMin(imageSize.width(), imageSize.height());
+        reader.setClipRect(QRect(0, 0, cropSize, cropSize));
+        if (cropSize > size.width() * 2)
+            reader.setScaledSize(size * 2);
+        image = reader.read();
+    } else {
+        image = reader.read();
+        const int cropSize = qMin(image.width(), image.height());
+        image = image.copy(0, 0, cropSize, cropSize);
+    }
+    if (image.isNull())
+        return image;
+    image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QImage result(size, QImage::Format_ARGB32_Premultiplied);
+    result.fill(Qt::transparent);
+    QPainter painter(&result);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(image);
+    painter.drawRoundedRect(QRectF(0, 0, size.width() - 1, size.height() - 1), AvatarRadius, AvatarRadius);
+    if (!overlay.isNull()) {
+        const QSize overlaySize = overlay.size() / overlay.devicePixelRatio();
+        painter.drawImage(QRect(QPoint(size.width() - overlaySize.width(),
+                                       size.height() - overlaySize.height()),
+                                overlaySize), overlay);
+    }
+    painter.end();
+    return result;
+}
+
+void QuickImageCache::insert(const QuickImageRequest &request, const QImage &image)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry *entry = new Entry;
+    entry->image = image;
+    entry->modified = request.modified;
+    m_images.insert(request.key, entry, qMax(1, image.byteCount() / 1024));
+}
+
+void QuickImageCache::finish(QuickImageResponse *response, const QImage &image)
+{
+    QMetaObject::invokeMethod(response, "finish", Qt::QueuedConnection, Q_ARG(QImage, image));
+}
+
+} // namespace qutim_sdk_0_3
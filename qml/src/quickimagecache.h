@@ -0,0 +1,78 @@
+#ifndef QUTIM_SDK_0_3_QUICKIMAGECACHE_H
+#define QUTIM_SDK_0_3_QUICKIMAGECACHE_H
+
+#include <QQuickImageProvider>
+#include <QCache>
+#include <QMutex>
+#include <QImage>
+
+namespace qutim_sdk_0_3 {
+
+struct QuickImageRequest
+{
+    QString key;
+    // Avatar path, empty for plain icons
+    QString path;
+    QString iconName;
+    QSize size;
+    // Modification time of the avatar, cached image is valid only for it
+    qint64 modified;
+};
+
+class QuickImageResponse : public QQuickImageResponse
+{
+    Q_OBJECT
+public:
+    QuickImageResponse(const QuickImageRequest &request);
+
+    const QuickImageRequest &request() const { return m_request; }
+    QQuickTextureFactory *textureFactory() const;
+
+    // Invoked by queued call at response's thread, emits finished()
+    Q_INVOKABLE void finish(const QImage &image);
+
+private:
+    const QuickImageRequest m_request;
+    QImage m_image;
+};
+
+/*
+ * Images of avatar and icon providers shared by all QML engines.
+ * Avatars are decoded and composed with their overlays by worker threads,
+ * icon engines are not thread-safe, so icons are rasterized once at GUI
+ * thread. Entries are keyed by path, size and overlay icon, avatars are
+ * rendered again as soon as their file is modified.
+ */
+class QuickImageCache : public QObject
+{
+    Q_OBJECT
+public:
+    static QuickImageCache *instance();
+
+    // Thread-safe, is called by QML image loader threads
+    QQuickImageResponse *request(const QString &path, const QString &iconName, const QSize &size);
+
+private slots:
+    void loadOverlay(QObject *response);
+    void loadIcon(QObject *response);
+
+private:
+    QuickImageCache();
+    void render(QuickImageResponse *response, const QImage &overlay);
+    static QImage renderAvatar(const QuickImageRequest &request, const QImage &overlay);
+    void insert(const QuickImageRequest &request, const QImage &image);
+    static void finish(QuickImageResponse *response, const QImage &image);
+
+    struct Entry
+    {
+        QImage image;
+        qint64 modified;
+    };
+
+    QMutex m_mutex;
+    QCache<QString, Entry> m_images;
+};
+
+} // namespace qutim_sdk_0_3
+
+#endif // QUTIM_SDK_0_3_QUICKIMAGECACHE_H
@@ -1,11 +1,12 @@
 #include "quickimageprovider.h"
-#include <qutim/icon.h>
+#include "quickimagecache.h"
 
 namespace qutim_sdk_0_3 {
 
 QuickImageProvider::QuickImageProvider()
-    : QQuickImageProvider(QQuickImageProvider::Pixmap)
 {
+    // Cache has to be created at GUI thread
+    QuickImageCache::instance();
 }
 
 /*!
@@ -17,13 +18,12 @@ QuickImageProvider::QuickImageProvider()
  *     source: "image://xdg/icon-name?size=64"
  * }
  */
-QPixmap QuickImageProvider::requestPixmap(const QString &id, QSize *size, const QSize &requestedSize)
+QQuickImageResponse *QuickImageProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
 {
     QString iconName = id.section('/', 0, 0);
 
     bool validIconSize = false;
     int iconSize = id.section('/', 1, 1).toInt(&validIconSize);
-    Icon icon = Icon(iconName);
 
     QSize finalSize;
     if (validIconSize)
@@ -33,10 +33,7 @@ QPixmap QuickImageProvider::requestPixmap(const QString &id, QSize *size, const
     else
         finalSize = QSize(128, 128);
 
-    if (size)
-        *size = finalSize;
-
-    return icon.pixmap(finalSize);
+    return QuickImageCache::instance()->request(QString(), iconName, finalSize);
 }
 
 } // namespace qutim_sdk_0_3
@@ -10,6 +10,7 @@
 #include "quickmenucontainer.h"
 #include "quickactionextender.h"
 #include "quickthememanager.h"
+#include "quickcontactlistmodel.h"
 #include <qutim/notification.h>
 #include <qutim/chatsession.h>
 #include <qqml.h>
@@ -62,6 +63,7 @@ void QuickPlugin::registerTypes(const char *uri)
     qmlRegisterType<QuickMenuContainer>("org.qutim", 0, 4, "MenuContainer");
     qmlRegisterType<QuickActionExtender>("org.qutim", 0, 4, "ActionListExtender");
     qmlRegisterType<QuickThemeManager>("org.qutim", 0, 4, "ThemeManager");
+    qmlRegisterType<QuickContactListModel>("org.qutim", 0, 4, "ContactListModel");
     qmlRegisterUncreatableType<ChatUnit>("org.qutim", 0, 4, "ChatUnit", "ChatUnit is pure virtual class");
     qmlRegisterUncreatableType<ChatSession>("org.qutim", 0, 4, "ChatSession", "ChatSession is pure virtual class");
     qmlRegisterUncreatableType<MenuController>("org.qutim", 0, 4, "MenuController", "MenuController is pure virtual class");